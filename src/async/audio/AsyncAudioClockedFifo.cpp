@@ -0,0 +1,414 @@
+/**
+@file   AsyncAudioClockedFifo.cpp
+@brief  A FIFO that output fixed size audio blocks on a shared clock tick
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains an audio FIFO that buffer incoming audio and output it in
+blocks of a fixed size, one block for each tick of a timer that is shared by
+all FIFOs using the same block time.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+#include <cassert>
+#include <algorithm>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncTimer.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioClockedFifo.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+  // A late timer will make the ticker catch up by ticking more than once but
+  // at most this many times
+#define MAX_CATCHUP_TICKS 5
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+/**
+ * A timer that is shared between all FIFOs that use the same block time. The
+ * timer is only running when at least one of the FIFOs have audio to output.
+ */
+class AudioClockedFifo::Ticker : public sigc::trackable
+{
+  public:
+    static Ticker *acquire(unsigned block_time)
+    {
+      Ticker *&ticker = tickers[block_time];
+      if (ticker == 0)
+      {
+        ticker = new Ticker(block_time);
+      }
+      ++ticker->refcnt;
+      return ticker;
+    }
+
+    static void release(Ticker *ticker)
+    {
+      assert(ticker->refcnt > 0);
+      if (--ticker->refcnt > 0)
+      {
+        return;
+      }
+      tickers.erase(ticker->block_time);
+      if (ticker->in_tick)
+      {
+        ticker->delete_pending = true;
+      }
+      else
+      {
+        delete ticker;
+      }
+    }
+
+    void addFifo(AudioClockedFifo *fifo)
+    {
+      fifos.push_back(fifo);
+    }
+
+    void removeFifo(AudioClockedFifo *fifo)
+    {
+      vector<AudioClockedFifo*>::iterator it =
+        find(fifos.begin(), fifos.end(), fifo);
+      assert(it != fifos.end());
+      *it = 0;
+    }
+
+    void start(void)
+    {
+      if (!timer.isEnabled())
+      {
+        clock_gettime(CLOCK_MONOTONIC, &next_tick);
+        addBlockTime(next_tick);
+        timer.setEnable(true);
+      }
+    }
+
+  private:
+    typedef map<unsigned, Ticker*> TickerMap;
+
+    static TickerMap            tickers;
+
+    unsigned                    block_time;
+    Timer                       timer;
+    vector<AudioClockedFifo*>   fifos;
+    int                         refcnt;
+    struct timespec             next_tick;
+    bool                        in_tick;
+    bool                        delete_pending;
+
+    Ticker(unsigned block_time)
+      : block_time(block_time), timer(block_time, Timer::TYPE_PERIODIC, false),
+        refcnt(0), in_tick(false), delete_pending(false)
+    {
+      timer.expired.connect(mem_fun(*this, &Ticker::onTimerExpired));
+    }
+
+    void addBlockTime(struct timespec &ts)
+    {
+      ts.tv_nsec += 1000000L * block_time;
+      ts.tv_sec += ts.tv_nsec / 1000000000L;
+      ts.tv_nsec %= 1000000000L;
+    }
+
+    void onTimerExpired(Timer *t)
+    {
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      int ticks = 0;
+      while ((ticks < MAX_CATCHUP_TICKS) &&
+             ((next_tick.tv_sec < now.tv_sec) ||
+              ((next_tick.tv_sec == now.tv_sec) &&
+               (next_tick.tv_nsec <= now.tv_nsec))))
+      {
+        addBlockTime(next_tick);
+        ++ticks;
+      }
+      if (ticks == MAX_CATCHUP_TICKS)
+      {
+          // We have been stalled for a long time so restart the clock
+        next_tick = now;
+        addBlockTime(next_tick);
+      }
+
+      in_tick = true;
+      bool busy = false;
+      for (int i=0; i<ticks; ++i)
+      {
+        busy = false;
+          // The vector may grow while ticking so do not use iterators
+        for (size_t idx=0; idx<fifos.size(); ++idx)
+        {
+          if ((fifos[idx] != 0) && fifos[idx]->tick())
+          {
+            busy = true;
+          }
+        }
+        if (!busy || delete_pending)
+        {
+          break;
+        }
+      }
+      in_tick = false;
+
+      if (delete_pending)
+      {
+        delete this;
+        return;
+      }
+
+      fifos.erase(remove(fifos.begin(), fifos.end(),
+                         static_cast<AudioClockedFifo*>(0)),
+                  fifos.end());
+
+      if (!busy)
+      {
+        timer.setEnable(false);
+      }
+    }
+
+    Ticker(const Ticker&);
+    Ticker& operator=(const Ticker&);
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+AudioClockedFifo::Ticker::TickerMap AudioClockedFifo::Ticker::tickers;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+AudioClockedFifo::AudioClockedFifo(int sample_rate, unsigned block_time,
+                                   unsigned max_blocks)
+  : ticker(0), block_size(sample_rate * block_time / 1000), head(0), tail(0),
+    fill(0), do_flush(false), is_flushing(false), input_stopped(false),
+    output_stopped(false)
+{
+  assert(block_size > 0);
+  assert(max_blocks > 0);
+  buf.resize(max_blocks * block_size);
+  ticker = Ticker::acquire(block_time);
+  ticker->addFifo(this);
+} /* AudioClockedFifo::AudioClockedFifo */
+
+
+AudioClockedFifo::~AudioClockedFifo(void)
+{
+  ticker->removeFifo(this);
+  Ticker::release(ticker);
+} /* AudioClockedFifo::~AudioClockedFifo */
+
+
+int AudioClockedFifo::writeSamples(const float *samples, int count)
+{
+  assert(count > 0);
+
+  do_flush = false;
+  is_flushing = false;
+
+  int written = 0;
+  while ((written < count) && (fill < buf.size()))
+  {
+    unsigned cnt = min(static_cast<unsigned>(count - written),
+                       min(static_cast<unsigned>(buf.size()) - fill,
+                           static_cast<unsigned>(buf.size()) - head));
+    copy(samples + written, samples + written + cnt, buf.begin() + head);
+    head = (head + cnt) % buf.size();
+    fill += cnt;
+    written += cnt;
+  }
+
+  if (written == 0)
+  {
+    input_stopped = true;
+  }
+
+  if (fill >= static_cast<unsigned>(block_size))
+  {
+    ticker->start();
+  }
+
+  return written;
+} /* AudioClockedFifo::writeSamples */
+
+
+void AudioClockedFifo::flushSamples(void)
+{
+  if (fill == 0)
+  {
+    is_flushing = true;
+    sinkFlushSamples();
+  }
+  else
+  {
+    do_flush = true;
+    ticker->start();
+  }
+} /* AudioClockedFifo::flushSamples */
+
+
+void AudioClockedFifo::resumeOutput(void)
+{
+  if (output_stopped)
+  {
+    output_stopped = false;
+    ticker->start();
+  }
+} /* AudioClockedFifo::resumeOutput */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+void AudioClockedFifo::allSamplesFlushed(void)
+{
+  if (is_flushing)
+  {
+    is_flushing = false;
+    sourceAllSamplesFlushed();
+  }
+} /* AudioClockedFifo::allSamplesFlushed */
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+bool AudioClockedFifo::tick(void)
+{
+  if (output_stopped ||
+      ((fill < static_cast<unsigned>(block_size)) && !do_flush))
+  {
+    return false;
+  }
+
+    // Write one block, which may be split in two parts at the end of the
+    // ring buffer
+  unsigned to_write = min(fill, static_cast<unsigned>(block_size));
+  while (to_write > 0)
+  {
+    unsigned cnt = min(to_write, static_cast<unsigned>(buf.size()) - tail);
+    int written = sinkWriteSamples(&buf[tail], cnt);
+    tail = (tail + written) % buf.size();
+    fill -= written;
+    to_write -= written;
+    if (written < static_cast<int>(cnt))
+    {
+      output_stopped = true;
+      break;
+    }
+  }
+
+  if (input_stopped && (fill < buf.size()))
+  {
+    input_stopped = false;
+    sourceResumeOutput();
+  }
+
+  if (do_flush && (fill == 0) && !output_stopped)
+  {
+    do_flush = false;
+    is_flushing = true;
+    sinkFlushSamples();
+  }
+
+  return (fill >= static_cast<unsigned>(block_size)) ||
+         (do_flush && (fill > 0));
+} /* AudioClockedFifo::tick */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,223 @@
+/**
+@file   AsyncAudioClockedFifo.h
+@brief  A FIFO that output fixed size audio blocks on a shared clock tick
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains an audio FIFO that buffer incoming audio and output it in
+blocks of a fixed size, one block for each tick of a timer that is shared by
+all FIFOs using the same block time.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_CLOCKED_FIFO_INCLUDED
+#define ASYNC_AUDIO_CLOCKED_FIFO_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSink.h>
+#include <AsyncAudioSource.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	An audio FIFO that output fixed size blocks on a clock tick
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class is used in an audio pipe to make the audio after it move in blocks
+of a fixed size, one block per clock tick. All AudioClockedFifo objects that
+use the same block time share one timer, so the audio in all of them is
+processed on the same tick. This give a predictable block size and CPU load
+for everything downstream of the FIFO, at the cost of up to one block time of
+extra latency.
+
+Incoming audio is buffered until a full block is available. A partial last
+block is written out when the source flush the stream. If the sink cannot take
+a whole block, the rest is written on a later tick. When the FIFO is full,
+the source is stopped until there is room again.
+*/
+class AudioClockedFifo : public AudioSink, public AudioSource
+{
+  public:
+    /**
+     * @brief 	Constuctor
+     * @param 	sample_rate The sample rate of the audio
+     * @param 	block_time  The time, in milliseconds, between ticks
+     * @param 	max_blocks  The size of the FIFO, in blocks
+     */
+    AudioClockedFifo(int sample_rate, unsigned block_time=20,
+                     unsigned max_blocks=4);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~AudioClockedFifo(void);
+
+    /**
+     * @brief   Get the block size
+     * @return  Returns the number of samples written on each tick
+     */
+    int blockSize(void) const { return block_size; }
+
+    /**
+     * @brief 	Write samples into this audio sink
+     * @param 	samples The buffer containing the samples
+     * @param 	count The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     *
+     * This function is used to write audio into this audio sink. If it
+     * returns 0, no more samples should be written until the resumeOutput
+     * function in the source have been called.
+     * This function is normally only called from a connected source object.
+     */
+    virtual int writeSamples(const float *samples, int count);
+
+    /**
+     * @brief 	Tell the sink to flush the previously written samples
+     *
+     * This function is used to tell the sink to flush previously written
+     * samples. When done flushing, the sink should call the
+     * sourceAllSamplesFlushed function.
+     * This function is normally only called from a connected source object.
+     */
+    virtual void flushSamples(void);
+
+    /**
+     * @brief Resume audio output to the sink
+     *
+     * This function will be called when the registered audio sink is ready
+     * to accept more samples. The output is resumed on the next tick.
+     * This function is normally only called from a connected sink object.
+     */
+    virtual void resumeOutput(void);
+
+  protected:
+    /**
+     * @brief The registered sink has flushed all samples
+     *
+     * This function will be called when all samples have been flushed in the
+     * registered sink.
+     * This function is normally only called from a connected sink object.
+     */
+    virtual void allSamplesFlushed(void);
+
+  private:
+    class Ticker;
+
+    Ticker              *ticker;
+    int                 block_size;
+    std::vector<float>  buf;
+    unsigned            head;
+    unsigned            tail;
+    unsigned            fill;
+    bool                do_flush;
+    bool                is_flushing;
+    bool                input_stopped;
+    bool                output_stopped;
+
+    AudioClockedFifo(const AudioClockedFifo&);
+    AudioClockedFifo& operator=(const AudioClockedFifo&);
+    bool tick(void);
+
+};  /* class AudioClockedFifo */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_CLOCKED_FIFO_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -33,6 +33,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
 
 
 /****************************************************************************
@@ -73,6 +76,10 @@ using namespace Async;
 // DC offset to prevent denormal
 static const double DC_OFFSET = 1.0E-25;
 
+  // The gain reduction is calculated once per block of this many samples
+  // and linearly interpolated in between
+static const int GAIN_BLOCK_SIZE = 4;
+
 
 
 
@@ -107,6 +114,24 @@ static inline double dB2lin( double dB )
   return exp( dB * DB_2_LOG );
 }
 
+// linear -> dB conversion using a fast log2 approximation. The exponent is
+// taken directly from the float and a third order polynomial is used for the
+// mantissa. The maximum error is less than 0.001 dB.
+static inline float fastLin2dB( float lin )
+{
+    // 20 * log10( 2 )
+  static const float LOG2_2_DB = 6.0205999132796239f;
+  uint32_t bits;
+  memcpy(&bits, &lin, sizeof(bits));
+  float e = static_cast<float>(static_cast<int>((bits >> 23) & 0xff) - 127);
+  bits = (bits & 0x007fffff) | 0x3f800000;
+  float m;
+  memcpy(&m, &bits, sizeof(m));
+  float log2_m = (m - 1.0f) * (2.5292642f + m * (-1.5853303f +
+                                m * (0.5798329f - 0.0847547f * m)));
+  return (e + log2_m) * LOG2_2_DB;
+}
+
 
 
 /****************************************************************************
@@ -134,7 +159,7 @@ static inline double dB2lin( double dB )
 
 AudioCompressor::AudioCompressor(void)
   : threshdB_(0.0), ratio_(1.0), output_gain(1.0),att_(10.0), rel_(100.0),
-    envdB_(DC_OFFSET)
+    envdB_(DC_OFFSET), gr_(1.0)
 {
 } /* AudioCompressor::AudioCompressor */
 
@@ -185,6 +210,7 @@ void AudioCompressor::setOutputGain(float gain)
 void AudioCompressor::reset(void)
 {
   envdB_ = DC_OFFSET;
+  gr_ = 1.0;
 } /* AudioCompressor::reset */
 
 
@@ -197,59 +223,60 @@ void AudioCompressor::reset(void)
 
 void AudioCompressor::processSamples(float *dest, const float *src, int count)
 {
-  //double max_sample = 0.0;
-  for (int i=0; i<count; ++i)
+  for (int pos=0; pos<count; pos+=GAIN_BLOCK_SIZE)
   {
-    double rect = fabs(src[i]);	// rectify input
-
-    /* if desired, one could use another EnvelopeDetector to smooth
-     * the rectified signal.
-     */
-
-    rect += DC_OFFSET;			// add DC offset to avoid log( 0 )
-    double keydB = lin2dB( rect );	// convert linear -> dB
-
-    // threshold
-    double overdB = keydB - threshdB_;	// delta over threshold
-    if ( overdB < 0.0 )
-	    overdB = 0.0;
+    int cnt = std::min(GAIN_BLOCK_SIZE, count - pos);
 
-    // attack/release
-
-    overdB += DC_OFFSET;		// add DC offset to avoid denormal
-
-    if ( overdB > envdB_ )
-    {
-      att_.run( overdB, envdB_ );		// attack
-    }
-    else
+      // The envelope is tracked for each sample
+    for (int i=pos; i<pos+cnt; ++i)
     {
-      rel_.run( overdB, envdB_ );		// release
+        // rectify input and add DC offset to avoid log( 0 )
+      float rect = fabsf(src[i]) + static_cast<float>(DC_OFFSET);
+      double keydB = fastLin2dB( rect );	// convert linear -> dB
+
+      // threshold
+      double overdB = keydB - threshdB_;	// delta over threshold
+      if ( overdB < 0.0 )
+        overdB = 0.0;
+
+      // attack/release
+
+      overdB += DC_OFFSET;		// add DC offset to avoid denormal
+
+      if ( overdB > envdB_ )
+      {
+        att_.run( overdB, envdB_ );	// attack
+      }
+      else
+      {
+        rel_.run( overdB, envdB_ );	// release
+      }
     }
 
-    overdB = envdB_ - DC_OFFSET;		// subtract DC offset
-    //cout << overdB << endl;
-
     /* Regarding the DC offset: In this case, since the offset is added before 
      * the attack/release processes, the envelope will never fall below the offset,
      * thereby avoiding denormals. However, to prevent the offset from causing
      * constant gain reduction, we must subtract it from the envelope, yielding
      * a minimum value of 0dB.
      */
+    double overdB = envdB_ - DC_OFFSET;	// subtract DC offset
 
-    // transfer function
+      // transfer function, evaluated once per block
     double gr = overdB * ( ratio_ - 1.0 );    // gain reduction (dB)
     gr = dB2lin( gr );			      // convert dB -> linear
 
-    // output gain
-    dest[i] = output_gain * src[i] * gr;      // apply gain reduction to input
-    
-    //if (fabs(dest[i]) > max_sample)
-    //  max_sample = dest[i];
+      // Apply the gain reduction, interpolated from the end of the last
+      // block, and the output gain to the input
+    float gain = output_gain * gr_;
+    float gain_step = output_gain * (gr - gr_) / cnt;
+    for (int i=pos; i<pos+cnt; ++i)
+    {
+      gain += gain_step;
+      dest[i] = src[i] * gain;
+    }
+    gr_ = gr;
   }
   
-  //cout << "max_sample=" << max_sample << endl;
-  
 } /* AudioCompressor::writeSamples */
 
 
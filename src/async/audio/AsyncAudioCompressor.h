@@ -44,6 +44,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncAudioProcessor.h>
+#include <AsyncAudioSampleRate.h>
 
 
 
@@ -163,6 +164,10 @@ Use this audio pipe class to do compression on an audio stream. Compression
 is a method to reduce the dynamic range of an audio signal. After it has been
 compressed it can be amplified to get a more audible end result.
 
+The envelope is tracked for every sample but the gain reduction is only
+calculated for small blocks of samples and interpolated in between. A fast
+approximation is used for the conversion of the signal level to dB.
+
 This audio pipe component is mostly untested and is based on some ripped off
 code which I really have not checked how it performs or if it works at all...
 */
@@ -238,6 +243,7 @@ class AudioCompressor : public AudioProcessor
 
     // runtime variables
     double envdB_;			// over-threshold envelope (dB)
+    double gr_;				// last gain reduction (linear)
     
     AudioCompressor(const AudioCompressor&);
     AudioCompressor& operator=(const AudioCompressor&);
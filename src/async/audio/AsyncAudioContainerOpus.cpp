@@ -48,6 +48,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include "AsyncAudioSampleRate.h"
 #include "AsyncAudioContainerOpus.h"
 #include "AsyncAudioEncoder.h"
 
@@ -108,6 +109,7 @@ using namespace Async;
  ****************************************************************************/
 
 AudioContainerOpus::AudioContainerOpus(void)
+  : m_ogg(1)
 {
   m_enc = AudioEncoder::create("OPUS");
   assert(m_enc != 0);
@@ -117,11 +119,10 @@ AudioContainerOpus::AudioContainerOpus(void)
   setHandler(m_enc);
   m_enc->writeEncodedSamples.connect(
       sigc::mem_fun(*this, &AudioContainerOpus::onWriteEncodedSamples));
+  m_enc->flushEncodedSamples.connect(
+      sigc::mem_fun(*this, &AudioContainerOpus::onFlushEncodedSamples));
 
-  //int ret = ogg_stream_init(&m_ogg_stream, m_ogg_serial++);
-  int ret = ogg_stream_init(&m_ogg_stream, 1);
-  assert(ret == 0);
-  ret = writeOggOpusHeader();
+  writeOggOpusHeader();
 } /* AudioContainerOpus::AudioContainerOpus */
 
 
@@ -130,8 +131,6 @@ AudioContainerOpus::~AudioContainerOpus(void)
   clearHandler();
   delete m_enc;
   m_enc = 0;
-  int ret = ogg_stream_clear(&m_ogg_stream);
-  assert(ret == 0);
 } /* AudioContainerOpus::~AudioContainerOpus */
 
 
@@ -139,31 +138,8 @@ void AudioContainerOpus::endStream(void)
 {
   m_enc->flushSamples();
 
-    // Assemble nil Ogg page
-  oggpack_buffer oggbuf;
-  oggpack_writeinit(&oggbuf);
-  oggpackWriteString(&oggbuf, "OggS", 0);             // Magic Signature
-  oggpack_write(&oggbuf, 0x00, 8);                    // Stream structure rev
-  oggpack_write(&oggbuf, 0x04, 8);                    // EOS flag
-  oggpack_write(&oggbuf, 0xffffffff, 32);             // Absolute granule pos
-  oggpack_write(&oggbuf, 0xffffffff, 32);             // Absolute granule pos
-  oggpack_write(&oggbuf, m_ogg_stream.serialno, 32);  // Stream serial number
-  oggpack_write(&oggbuf, m_ogg_stream.pageno, 32);    // Page sequence no
-  oggpack_write(&oggbuf, 0, 32);                      // Page checksum
-  oggpack_write(&oggbuf, 0, 8);                       // Page segments
-
-  ogg_page page;
-  page.header = oggpack_get_buffer(&oggbuf);
-  page.header_len = oggpack_bytes(&oggbuf);
-  page.body = 0;
-  page.body_len = 0;
-  ogg_page_checksum_set(&page);
-
-  m_block.clear();
-  writePage(page, m_block);
-  writeBlock(m_block.data(), m_block.size());
-
-  oggpack_writeclear(&oggbuf);
+  m_ogg.flush(true);
+  writePages();
 } /* AudioContainerOpus::endStream */
 
 
@@ -183,73 +159,29 @@ void AudioContainerOpus::endStream(void)
 
 void AudioContainerOpus::onWriteEncodedSamples(const void *data, int len)
 {
-  //std::cout << "### AudioContainerOpus::onWriteEncodedSamples: len="
-  //          << len << std::endl;
-
-  //if (m_packet.packet == nullptr)
-  //{
-  //  int ret = ogg_stream_init(&m_ogg_stream, m_ogg_serial++);
-  //  assert(ret == 0);
-  //  writeOggOpusHeader();
-
-  //  m_packet.packet = reinterpret_cast<unsigned char*>(malloc(len));
-  //  assert(m_packet.packet != nullptr);
-  //  std::memcpy(m_packet.packet, data, len);
-  //  m_packet.bytes = len;
-  //  m_packet.b_o_s = 0;
-  //  m_packet.e_o_s = 0;
-  //  m_packet.granulepos = 48000 * FRAME_SIZE / 1000;
-  //  m_packet.packetno = 2;
-  //  return;
-  //}
-
-  m_packet.packet = const_cast<unsigned char*>(
-      reinterpret_cast<const unsigned char*>(data));
-  m_packet.bytes = len;
-  //m_packet.b_o_s = 0;
-  //m_packet.e_o_s = 0;
   if (len > 0)
   {
-    m_packet.granulepos += 48000 * FRAME_SIZE / 1000;
+    m_granulepos += 48000 * FRAME_SIZE / 1000;
   }
-  m_packet.packetno += 1;
-
-  if (ogg_stream_packetin(&m_ogg_stream, &m_packet) != 0)
+  if (!m_ogg.addPacket(data, len, m_granulepos))
   {
     std::cerr << "*** ERROR: Could not add Ogg packet to stream" << std::endl;
     return;
   }
-  m_pending_packets += 1;
-
-  //free(m_packet.packet);
-  //m_packet.packet = reinterpret_cast<unsigned char*>(malloc(len));
-  //assert(m_packet.packet != nullptr);
-  //std::memcpy(m_packet.packet, data, len);
-  //m_packet.bytes = len;
-  ////m_packet.b_o_s = 0;
-  ////m_packet.e_o_s = 0;
-  //m_packet.granulepos += 48000 * FRAME_SIZE / 1000;
-  //m_packet.packetno += 1;
-
-  ogg_page page;
-  while ((ogg_stream_pageout(&m_ogg_stream, &page) != 0) ||
-         (((m_pending_packets >= 5) || m_packet.e_o_s) &&
-          (ogg_stream_flush(&m_ogg_stream, &page) != 0)))
-  {
-    m_block.clear();
-    writePage(page, m_block);
-    writeBlock(m_block.data(), m_block.size());
-    assert(ogg_page_packets(&page) <= m_pending_packets);
-    m_pending_packets -= ogg_page_packets(&page);
-  }
-
-  if (ogg_stream_check(&m_ogg_stream) != 0)
-  {
-    printf("### Ogg stream error\n");
-  }
+  writePages();
 } /* AudioContainerOpus::onWriteEncodedSamples */
 
 
+void AudioContainerOpus::onFlushEncodedSamples(void)
+{
+    // Write the last, partially filled, page directly so that a listener of
+    // a realtime stream get all audio at the end of a transmission
+  m_ogg.flush();
+  writePages();
+  m_enc->allEncodedSamplesFlushed();
+} /* AudioContainerOpus::onFlushEncodedSamples */
+
+
 void AudioContainerOpus::oggpackWriteString(oggpack_buffer* oggbuf,
                                             const char *str, int lenbits)
 {
@@ -277,25 +209,18 @@ void AudioContainerOpus::oggpackWriteCommentList(oggpack_buffer* oggbuf,
 } /* AudioContainerOpus::oggpackWriteCommentList */
 
 
-bool AudioContainerOpus::writePage(const ogg_page& page, std::vector<char>& buf)
+void AudioContainerOpus::writePages(void)
 {
-  //std::cout << "### Writing Ogg/Opus page:"
-  //          << " serialno=" << ogg_page_serialno(&page)
-  //          << " pageno=" << ogg_page_pageno(&page)
-  //          << " gpos=" << ogg_page_granulepos(&page)
-  //          << " cont=" << ogg_page_continued(&page)
-  //          << " pkts=" << ogg_page_packets(&page)
-  //          << " bos=" << ogg_page_bos(&page)
-  //          << " eos=" << ogg_page_eos(&page)
-  //          << " ver=" << ogg_page_version(&page)
-  //          << std::endl;
-  buf.insert(buf.end(), page.header, page.header + page.header_len);
-  if (page.body_len > 0)
+    // Each finished page is stored in one contiguous buffer so it can be
+    // handed out directly without copying
+  const std::vector<struct iovec>& pages = m_ogg.pages();
+  for (std::vector<struct iovec>::const_iterator it = pages.begin();
+       it != pages.end(); ++it)
   {
-    buf.insert(buf.end(), page.body, page.body + page.body_len);
+    writeBlock(static_cast<const char*>(it->iov_base), it->iov_len);
   }
-  return true;
-} /* AudioContainerOpus::writePage */
+  m_ogg.releasePages();
+} /* AudioContainerOpus::writePages */
 
 
 bool AudioContainerOpus::writeOggOpusHeader(void)
@@ -313,33 +238,15 @@ bool AudioContainerOpus::writeOggOpusHeader(void)
   oggpack_write(&oggbuf, 0, 16);                    // Output Gain
   oggpack_write(&oggbuf, 0, 8);                     // Mapping Family
 
-    // Put Opus ID Header in an Ogg packet and add it to the stream
-  ogg_packet oggpkt;
-  oggpkt.packet = oggpack_get_buffer(&oggbuf);
-  oggpkt.bytes = oggpack_bytes(&oggbuf);
-  oggpkt.b_o_s = 1;
-  oggpkt.e_o_s = 0;
-  oggpkt.granulepos = 0;
-  oggpkt.packetno = 0;
-  if (ogg_stream_packetin(&m_ogg_stream, &oggpkt) != 0)
+    // The Opus ID Header must be alone in the first page of the stream
+  if (!m_ogg.addPacket(oggpack_get_buffer(&oggbuf), oggpack_bytes(&oggbuf), 0))
   {
     std::cerr << "*** ERROR: Could not add Ogg packet to stream" << std::endl;
+    oggpack_writeclear(&oggbuf);
     return false;
   }
   oggpack_writeclear(&oggbuf);
-
-    // Flush the stream, get the Opus ID Header Ogg page and send it
-  ogg_page page;
-  if (ogg_stream_flush(&m_ogg_stream, &page) == 0)
-  {
-    std::cerr << "*** ERROR: Added Ogg packet produced no page" << std::endl;
-    return false;
-  }
-  if (!writePage(page, m_header))
-  {
-    std::cout << "### Ogg Header: ogg_stream_flush" << std::endl;
-    return false;
-  }
+  m_ogg.flush();
 
     // Assemble Opus Comment Header buffer
   oggpack_writeinit(&oggbuf);
@@ -354,29 +261,27 @@ bool AudioContainerOpus::writeOggOpusHeader(void)
       "GENRE=Ham Radio"
       });
 
-    // Put Opus Comment Header in an Ogg packet and add it to the stream
-  oggpkt.packet = oggpack_get_buffer(&oggbuf);
-  oggpkt.bytes = oggpack_bytes(&oggbuf);
-  oggpkt.b_o_s = 0;
-  oggpkt.e_o_s = 0;
-  oggpkt.granulepos = 0;
-  oggpkt.packetno = 1;
-  if (ogg_stream_packetin(&m_ogg_stream, &oggpkt) != 0)
+    // The Opus Comment Header must finish a page of its own as well
+  if (!m_ogg.addPacket(oggpack_get_buffer(&oggbuf), oggpack_bytes(&oggbuf), 0))
   {
     std::cerr << "*** ERROR: Could not add Ogg packet to stream" << std::endl;
+    oggpack_writeclear(&oggbuf);
+    m_ogg.releasePages();
     return false;
   }
   oggpack_writeclear(&oggbuf);
+  m_ogg.flush();
 
-    // Flush the stream, get the Opus Comment Header Ogg pages and send them
-  while (ogg_stream_flush(&m_ogg_stream, &page) != 0)
+    // Store the header pages so that they can be written to the beginning of
+    // the file
+  const std::vector<struct iovec>& pages = m_ogg.pages();
+  for (std::vector<struct iovec>::const_iterator it = pages.begin();
+       it != pages.end(); ++it)
   {
-    //std::cout << "### Comment Header: ogg_stream_flush" << std::endl;
-    if (!writePage(page, m_header))
-    {
-      return false;
-    }
+    const char* page = static_cast<const char*>(it->iov_base);
+    m_header.insert(m_header.end(), page, page + it->iov_len);
   }
+  m_ogg.releasePages();
 
   return true;
 } /* AudioContainerOpus::writeOggOpusHeader */
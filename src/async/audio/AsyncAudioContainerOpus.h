@@ -50,6 +50,7 @@ An example of how to use the Async::AudioContainer class
  ****************************************************************************/
 
 #include <AsyncAudioContainer.h>
+#include <AsyncOggPageWriter.h>
 
 
 /****************************************************************************
@@ -187,23 +188,19 @@ class AudioContainerOpus : public AudioContainer
     static constexpr const size_t FRAME_SIZE = 20;
 
     Async::AudioEncoder*          m_enc;
-    ogg_stream_state              m_ogg_stream;
-    ogg_packet                    m_packet{0};
-    //int                           m_ogg_serial      = 1;
-    int                           m_pending_packets = 0;
-    AudioContainer*               m_container       = nullptr;
+    OggPageWriter                 m_ogg;
+    int64_t                       m_granulepos      = 0;
     std::vector<char>             m_header;
-    std::vector<char>             m_block;
 
     AudioContainerOpus(const AudioContainerOpus&);
     AudioContainerOpus& operator=(const AudioContainerOpus&);
-    void onWriteBlock(const char *buf, size_t len);
     void onWriteEncodedSamples(const void *data, int len);
+    void onFlushEncodedSamples(void);
     void oggpackWriteString(oggpack_buffer* oggbuf,
                             const char *str, int lenbits=32);
     void oggpackWriteCommentList(oggpack_buffer* oggbuf,
                                  const std::vector<const char*> &comments);
-    bool writePage(const ogg_page& page, std::vector<char>& buf);
+    void writePages(void);
     bool writeOggOpusHeader(void);
 
 };  /* class AudioContainerOpus */
@@ -48,6 +48,7 @@ An example of how to use the Async::AudioContainer class
  ****************************************************************************/
 
 #include <AsyncAudioContainer.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
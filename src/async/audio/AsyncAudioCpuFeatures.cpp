@@ -0,0 +1,314 @@
+/**
+@file   AsyncAudioCpuFeatures.cpp
+@brief  Runtime detection of the SIMD features used by the DSP kernels
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains the implementation of the AudioCpuFeatures class.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioCpuFeatures.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ASYNC_CPU_X86
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ASYNC_CPU_NEON
+#endif
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static vector<AudioCpuFeatures::SelectFunc>& dispatchers(void);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+bool AudioCpuFeatures::initialized = false;
+unsigned AudioCpuFeatures::enabled_features = 0;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+unsigned AudioCpuFeatures::detected(void)
+{
+  unsigned features = 0;
+
+#ifdef ASYNC_CPU_X86
+  __builtin_cpu_init();
+  features |= __builtin_cpu_supports("sse") ? SSE : 0;
+  features |= __builtin_cpu_supports("sse2") ? SSE2 : 0;
+  features |= __builtin_cpu_supports("avx") ? AVX : 0;
+  features |= __builtin_cpu_supports("avx2") ? AVX2 : 0;
+  features |= __builtin_cpu_supports("fma") ? FMA : 0;
+  features |= __builtin_cpu_supports("avx512f") ? AVX512F : 0;
+#endif
+
+    // The NEON kernels are only compiled in when the compiler target
+    // guarantee NEON support so no runtime check is needed
+#ifdef ASYNC_CPU_NEON
+  features |= NEON;
+#endif
+
+  return features;
+} /* AudioCpuFeatures::detected */
+
+
+bool AudioCpuFeatures::setLimit(const std::string& limit)
+{
+  unsigned mask = 0;
+  if (!limitMask(limit, &mask))
+  {
+    return false;
+  }
+  initialized = true;
+  enabled_features = detected() & mask;
+
+  const vector<SelectFunc> &funcs = dispatchers();
+  for (vector<SelectFunc>::const_iterator it = funcs.begin();
+       it != funcs.end(); ++it)
+  {
+    (*it)();
+  }
+
+  return true;
+} /* AudioCpuFeatures::setLimit */
+
+
+std::string AudioCpuFeatures::toString(unsigned features)
+{
+  static const struct
+  {
+    Feature     feature;
+    const char *name;
+  } names[] =
+  {
+    { SSE, "sse" }, { SSE2, "sse2" }, { AVX, "avx" }, { AVX2, "avx2" },
+    { FMA, "fma" }, { AVX512F, "avx512f" }, { NEON, "neon" }
+  };
+
+  string str;
+  for (size_t i=0; i<sizeof(names)/sizeof(*names); ++i)
+  {
+    if ((features & names[i].feature) != 0)
+    {
+      if (!str.empty())
+      {
+        str += " ";
+      }
+      str += names[i].name;
+    }
+  }
+  return str.empty() ? string("none") : str;
+} /* AudioCpuFeatures::toString */
+
+
+void AudioCpuFeatures::addDispatcher(SelectFunc select)
+{
+  vector<SelectFunc> &funcs = dispatchers();
+  if (find(funcs.begin(), funcs.end(), select) == funcs.end())
+  {
+    funcs.push_back(select);
+  }
+} /* AudioCpuFeatures::addDispatcher */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void AudioCpuFeatures::init(void)
+{
+  initialized = true;
+  enabled_features = detected();
+
+  const char *limit = getenv("ASYNC_AUDIO_SIMD");
+  if (limit != 0)
+  {
+    unsigned mask = 0;
+    if (limitMask(limit, &mask))
+    {
+      enabled_features &= mask;
+    }
+    else
+    {
+      cerr << "*** WARNING: Unknown SIMD limit \"" << limit
+           << "\" in environment variable ASYNC_AUDIO_SIMD" << endl;
+    }
+  }
+} /* AudioCpuFeatures::init */
+
+
+bool AudioCpuFeatures::limitMask(const std::string& limit, unsigned *mask)
+{
+  static const unsigned SSE_MASK = SSE;
+  static const unsigned SSE2_MASK = SSE_MASK | SSE2;
+  static const unsigned AVX_MASK = SSE2_MASK | AVX;
+  static const unsigned AVX2_MASK = AVX_MASK | AVX2 | FMA;
+  static const unsigned AVX512_MASK = AVX2_MASK | AVX512F;
+
+  if (limit.empty() || (limit == "native"))
+  {
+    *mask = ~0U;
+  }
+  else if (limit == "scalar")
+  {
+    *mask = 0;
+  }
+  else if (limit == "sse")
+  {
+    *mask = SSE_MASK;
+  }
+  else if (limit == "sse2")
+  {
+    *mask = SSE2_MASK;
+  }
+  else if (limit == "avx")
+  {
+    *mask = AVX_MASK;
+  }
+  else if (limit == "avx2")
+  {
+    *mask = AVX2_MASK;
+  }
+  else if (limit == "avx512")
+  {
+    *mask = AVX512_MASK;
+  }
+  else if (limit == "neon")
+  {
+    *mask = NEON;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+} /* AudioCpuFeatures::limitMask */
+
+
+
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+/*
+ * A function local static is used so that kernel families may register
+ * during static initialization of other translation units
+ */
+static vector<AudioCpuFeatures::SelectFunc>& dispatchers(void)
+{
+  static vector<AudioCpuFeatures::SelectFunc> funcs;
+  return funcs;
+} /* dispatchers */
+
+
+
+/*
+ * This file has not been truncated
+ */
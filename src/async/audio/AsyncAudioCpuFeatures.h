@@ -0,0 +1,233 @@
+/**
+@file   AsyncAudioCpuFeatures.h
+@brief  Runtime detection of the SIMD features used by the DSP kernels
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that detect which SIMD instruction sets the
+running CPU support and that keep track of the DSP kernel dispatchers so that
+they can be rebound when the allowed instruction sets are changed.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_CPU_FEATURES_INCLUDED
+#define ASYNC_AUDIO_CPU_FEATURES_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <string>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Runtime detection of the SIMD features used by the DSP kernels
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+Distribution packages are built for a baseline instruction set so the SIMD
+kernels are compiled using function target attributes and selected at
+runtime. Each kernel family ask this class which features that may be used
+when it bind its function pointers. A kernel family always have a plain C++
+implementation that is used when no SIMD feature is allowed. That
+implementation is the reference that the other kernels are compared against.
+
+The features that may be used can be limited, e.g. to compare the SIMD
+kernels with the reference implementation or to work around a problem on a
+specific CPU. The limit is set using the environment variable
+ASYNC_AUDIO_SIMD or by calling setLimit, which is typically done from a
+configuration variable. The per family environment variables, like
+ASYNC_AUDIO_DOTPROD, are still honoured within the limit.
+
+A kernel family register its select function using addDispatcher the first
+time it bind its kernels. When the limit is changed all registered select
+functions are called again. Changing the limit is not thread safe so it
+should be done at startup, before any audio is processed.
+*/
+class AudioCpuFeatures
+{
+  public:
+    /**
+     * @brief The SIMD features that the kernels may use
+     */
+    typedef enum
+    {
+      SSE     = 0x0001, ///< x86 SSE
+      SSE2    = 0x0002, ///< x86 SSE2
+      AVX     = 0x0004, ///< x86 AVX
+      AVX2    = 0x0008, ///< x86 AVX2
+      FMA     = 0x0010, ///< x86 FMA3
+      AVX512F = 0x0020, ///< x86 AVX-512 foundation
+      NEON    = 0x0100  ///< ARM NEON
+    } Feature;
+
+    /**
+     * @brief A function that select the kernels for one kernel family
+     */
+    typedef void (*SelectFunc)(void);
+
+    /**
+     * @brief   Check if a feature may be used by the kernels
+     * @param   feature The feature to check
+     * @return  Returns \em true if the CPU support the feature and it is
+     *          within the limit
+     */
+    static bool has(Feature feature)
+    {
+      return (enabled() & feature) != 0;
+    }
+
+    /**
+     * @brief   Get the features supported by the CPU
+     * @return  Returns a bitmask of Feature values
+     */
+    static unsigned detected(void);
+
+    /**
+     * @brief   Get the features that the kernels may use
+     * @return  Returns a bitmask of Feature values
+     */
+    static unsigned enabled(void)
+    {
+      if (!initialized)
+      {
+        init();
+      }
+      return enabled_features;
+    }
+
+    /**
+     * @brief   Limit the features that the kernels may use
+     * @param   limit The highest instruction set to use
+     * @return  Returns \em true on success or \em false if the limit is
+     *          not recognized
+     *
+     * The limit is one of "scalar", "sse", "sse2", "avx", "avx2", "avx512",
+     * "neon" or "native". A limit include the lower instruction sets of the
+     * same architecture, so "avx2" allow SSE, SSE2, AVX, AVX2 and FMA.
+     * "native", or an empty string, remove the limit and "scalar" force the
+     * reference implementations. All registered kernel families are rebound.
+     */
+    static bool setLimit(const std::string& limit);
+
+    /**
+     * @brief   Get a printable list of features
+     * @param   features A bitmask of Feature values
+     * @return  Returns the feature names separated by space or "none"
+     */
+    static std::string toString(unsigned features);
+
+    /**
+     * @brief   Register the select function of a kernel family
+     * @param   select The function that bind the kernels for the family
+     *
+     * The select function is called again each time the limit is changed.
+     * Registering the same function more than once is harmless.
+     */
+    static void addDispatcher(SelectFunc select);
+
+  private:
+    static bool     initialized;
+    static unsigned enabled_features;
+
+    static void init(void);
+    static bool limitMask(const std::string& limit, unsigned *mask);
+
+    AudioCpuFeatures(void);
+};  /* class AudioCpuFeatures */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_CPU_FEATURES_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -28,6 +28,8 @@ ANY KIND. See http://www.dspguru.com/wol.htm for more information.
  ****************************************************************************/
 
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -45,6 +47,8 @@ ANY KIND. See http://www.dspguru.com/wol.htm for more information.
  ****************************************************************************/
 
 #include "AsyncAudioDecimator.h"
+#include "AsyncAudioDotProduct.h"
+#include "AsyncAudioFixedPoint.h"
 
 
 
@@ -108,17 +112,49 @@ using namespace Async;
 
 AudioDecimator::AudioDecimator(int decimation_factor,
       	      	      	       const float *filter_coeff, int taps)
-  : factor_M(decimation_factor), H_size(taps), p_H(filter_coeff)
+  : factor_M(decimation_factor), p_Z(0), H_size(taps), p_H(0), q_Z(0),
+    q_H(0), q_scale(0.0f)
 {
   setInputOutputSampleRate(factor_M, 1);
-  p_Z = new float[H_size];
-  memset(p_Z, 0, H_size * sizeof(*p_Z));
+
+    // The coefficients are stored in reverse order so that each output
+    // sample is the dot product of the coefficients and a contiguous part
+    // of the delay line where the oldest sample comes first
+  p_H = new float[H_size];
+  std::reverse_copy(filter_coeff, filter_coeff + H_size, p_H);
+
+    // The delay line hold the last H_size-1 input samples followed by room
+    // for one chunk of new samples
+  chunk_size = std::max(CHUNK_SIZE / factor_M, 1) * factor_M;
+  const int z_size = H_size - 1 + chunk_size;
+
+  if (AudioFixedPoint::enabled())
+  {
+    int shift = AudioFixedPoint::coeffShift(p_H, H_size);
+    q_H = new int16_t[H_size];
+    for (int i=0; i<H_size; ++i)
+    {
+      q_H[i] = static_cast<int16_t>(lrintf(ldexpf(p_H[i], shift)));
+    }
+    q_scale = ldexpf(1.0f / AudioFixedPoint::Q15_ONE, -shift);
+    q_Z = new int16_t[z_size];
+    memset(q_Z, 0, z_size * sizeof(*q_Z));
+    delete [] p_H;
+    p_H = 0;
+    return;
+  }
+
+  p_Z = new float[z_size];
+  memset(p_Z, 0, z_size * sizeof(*p_Z));
 } /* AudioDecimator::AudioDecimator */
 
 
 AudioDecimator::~AudioDecimator(void)
 {
+  delete [] q_Z;
+  delete [] q_H;
   delete [] p_Z;
+  delete [] p_H;
 } /* AudioDecimator::~AudioDecimator */
 
 
@@ -139,27 +175,42 @@ void AudioDecimator::processSamples(float *dest, const float *src, int count)
     // this implementation assumes num_inp is a multiple of factor_M
   assert(count % factor_M == 0);
 
+  const int hist_size = H_size - 1;
   int num_out = 0;
   while (count >= factor_M)
   {
-      // shift Z delay line up to make room for next samples
-    memmove(p_Z + factor_M, p_Z, (H_size - factor_M) * sizeof(float));
-
-      // copy next samples from input buffer to bottom of Z delay line
-    for (int tap = factor_M - 1; tap >= 0; tap--)
+      // copy next chunk of samples from input buffer to the end of the
+      // delay line
+    int chunk_cnt = std::min(count, chunk_size);
+    if (q_H != 0)
     {
-      p_Z[tap] = *src++;
+      AudioFixedPoint::floatToQ15(q_Z + hist_size, src, chunk_cnt);
+      for (int pos = factor_M - 1; pos < chunk_cnt; pos += factor_M)
+      {
+        *dest++ = q_scale *
+          AudioFixedPoint::dotProduct(q_H, q_Z + pos, H_size);
+        num_out++;
+      }
+      memmove(q_Z, q_Z + chunk_cnt, hist_size * sizeof(*q_Z));
+      src += chunk_cnt;
+      count -= chunk_cnt;
+      continue;
     }
-    count -= factor_M;
 
-      // calculate FIR sum
-    float sum = 0.0;
-    for (int tap = 0; tap < H_size; tap++)
+    memcpy(p_Z + hist_size, src, chunk_cnt * sizeof(float));
+    src += chunk_cnt;
+    count -= chunk_cnt;
+
+      // calculate FIR sums. The newest sample for output n is located at
+      // p_Z[hist_size + (n+1)*factor_M - 1].
+    for (int pos = factor_M - 1; pos < chunk_cnt; pos += factor_M)
     {
-      sum += p_H[tap] * p_Z[tap];
+      *dest++ = AudioDotProduct::calc(p_H, p_Z + pos, H_size);
+      num_out++;
     }
-    *dest++ = sum;     /* store sum and point to next output */
-    num_out++;
+
+      // move the last hist_size samples to the start of the delay line
+    memmove(p_Z, p_Z + chunk_cnt, hist_size * sizeof(float));
   }
 
   //printf("num_out=%d  count=%d  factor_M=%d\n", num_out, count, factor_M);
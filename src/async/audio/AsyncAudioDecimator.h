@@ -29,6 +29,7 @@ ANY KIND. See http://www.dspguru.com/wol.htm for more information.
  *
  ****************************************************************************/
 
+#include <stdint.h>
 
 
 /****************************************************************************
@@ -147,10 +148,16 @@ class AudioDecimator : public AudioProcessor
 
     
   private:
+    static const int CHUNK_SIZE = 256;
+
     const int 	factor_M;
     float     	*p_Z;
     int       	H_size;
-    const float *p_H;
+    float       *p_H;
+    int         chunk_size;
+    int16_t     *q_Z;
+    int16_t     *q_H;
+    float       q_scale;
     
     AudioDecimator(const AudioDecimator&);
     AudioDecimator& operator=(const AudioDecimator&);
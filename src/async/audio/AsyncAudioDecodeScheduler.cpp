@@ -0,0 +1,294 @@
+/**
+@file   AsyncAudioDecodeScheduler.cpp
+@brief  Decode audio packets from many streams in batches
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <algorithm>
+#include <cstring>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncTimer.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioDecoder.h"
+#include "AsyncAudioDecodeScheduler.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+namespace {
+  struct DecoderLess
+  {
+    template <class Packet>
+    bool operator()(const Packet& a, const Packet& b) const
+    {
+      return a.dec < b.dec;
+    }
+  };
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+AudioDecodeScheduler *AudioDecodeScheduler::the_instance = 0;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+AudioDecodeScheduler *AudioDecodeScheduler::instance(void)
+{
+  if (the_instance == 0)
+  {
+    the_instance = new AudioDecodeScheduler;
+  }
+  return the_instance;
+} /* AudioDecodeScheduler::instance */
+
+
+AudioDecodeScheduler::~AudioDecodeScheduler(void)
+{
+  delete process_timer;
+  the_instance = 0;
+} /* AudioDecodeScheduler::~AudioDecodeScheduler */
+
+
+void AudioDecodeScheduler::writeEncodedSamples(AudioDecoder *dec,
+                                               const void *buf, int size)
+{
+  queuePacket(dec, buf, size);
+} /* AudioDecodeScheduler::writeEncodedSamples */
+
+
+void AudioDecodeScheduler::flushEncodedSamples(AudioDecoder *dec)
+{
+  queuePacket(dec, 0, -1);
+} /* AudioDecodeScheduler::flushEncodedSamples */
+
+
+void AudioDecodeScheduler::setNeeded(AudioDecoder *dec, bool is_needed)
+{
+  vector<AudioDecoder*>::iterator it =
+    find(not_needed.begin(), not_needed.end(), dec);
+  if (is_needed && (it != not_needed.end()))
+  {
+    not_needed.erase(it);
+  }
+  else if (!is_needed && (it == not_needed.end()))
+  {
+    not_needed.push_back(dec);
+  }
+} /* AudioDecodeScheduler::setNeeded */
+
+
+void AudioDecodeScheduler::cancel(AudioDecoder *dec)
+{
+  for (Packets::iterator it=pending.begin(); it!=pending.end(); ++it)
+  {
+    if (it->dec == dec)
+    {
+      it->dec = 0;
+    }
+  }
+  for (Packets::iterator it=processing.begin(); it!=processing.end(); ++it)
+  {
+    if (it->dec == dec)
+    {
+      it->dec = 0;
+    }
+  }
+  setNeeded(dec, true);
+} /* AudioDecodeScheduler::cancel */
+
+
+void AudioDecodeScheduler::processPending(void)
+{
+  process_timer->setEnable(false);
+  if (pending.empty())
+  {
+    return;
+  }
+
+    // Swap in the pending batch so that new packets written while
+    // decoding end up in the next batch
+  processing.swap(pending);
+  processing_data.swap(pending_data);
+
+    // Group the packets per decoder, keeping the order within each stream
+  stable_sort(processing.begin(), processing.end(), DecoderLess());
+
+  for (size_t i=0; i<processing.size(); ++i)
+  {
+    const Packet& pkt = processing[i];
+    AudioDecoder *dec = pkt.dec;
+    if (dec == 0)
+    {
+      continue;
+    }
+    if (pkt.size < 0)
+    {
+      dec->flushEncodedSamples();
+    }
+    else if (isNeeded(dec))
+    {
+      dec->writeEncodedSamples(&processing_data[pkt.offset], pkt.size);
+      ++decoded_cnt;
+    }
+    else
+    {
+      ++dropped_cnt;
+    }
+  }
+
+  processing.clear();
+  processing_data.clear();
+} /* AudioDecodeScheduler::processPending */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+AudioDecodeScheduler::AudioDecodeScheduler(void)
+  : process_timer(0), decoded_cnt(0), dropped_cnt(0)
+{
+  process_timer = new Timer(0);
+  process_timer->setEnable(false);
+  process_timer->expired.connect(
+      mem_fun(*this, &AudioDecodeScheduler::processTimerExpired));
+} /* AudioDecodeScheduler::AudioDecodeScheduler */
+
+
+void AudioDecodeScheduler::queuePacket(AudioDecoder *dec, const void *buf,
+                                       int size)
+{
+  Packet pkt;
+  pkt.dec = dec;
+  pkt.offset = pending_data.size();
+  pkt.size = size;
+  if (size > 0)
+  {
+    const uint8_t *data = reinterpret_cast<const uint8_t*>(buf);
+    pending_data.insert(pending_data.end(), data, data + size);
+  }
+  pending.push_back(pkt);
+
+    // The timer expires when the main loop has handled all file descriptor
+    // activity for this iteration
+  if (!process_timer->isEnabled())
+  {
+    process_timer->setEnable(true);
+  }
+} /* AudioDecodeScheduler::queuePacket */
+
+
+void AudioDecodeScheduler::processTimerExpired(Timer *t)
+{
+  processPending();
+} /* AudioDecodeScheduler::processTimerExpired */
+
+
+bool AudioDecodeScheduler::isNeeded(AudioDecoder *dec) const
+{
+  return find(not_needed.begin(), not_needed.end(), dec) == not_needed.end();
+} /* AudioDecodeScheduler::isNeeded */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,242 @@
+/**
+@file   AsyncAudioDecodeScheduler.h
+@brief  Decode audio packets from many streams in batches
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_DECODE_SCHEDULER_INCLUDED
+#define ASYNC_AUDIO_DECODE_SCHEDULER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+#include <vector>
+#include <stdint.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class AudioDecoder;
+class Timer;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Decode audio packets from many streams in batches
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+When many network audio streams are received, like from a lot of voter
+satellite receivers, each packet is normally decoded directly in the network
+callback that received it. This class instead collects all packets received
+during one main loop iteration and then decode them in one batch, stream by
+stream. Since all packets for a decoder are decoded after each other, the
+decoder state stays in the CPU cache. A stream can also be marked as not
+needed, which makes the scheduler drop its packets instead of decoding them.
+
+There is one scheduler object for the whole application which is accessed
+using the instance function. Packets for a decoder are always decoded in the
+order they were written, and a flush request is handled in order with the
+packets.
+*/
+class AudioDecodeScheduler : public sigc::trackable
+{
+  public:
+    /**
+     * @brief   Get the scheduler instance
+     * @return  Returns the one and only scheduler object
+     *
+     * The scheduler object is created the first time this function is
+     * called.
+     */
+    static AudioDecodeScheduler *instance(void);
+
+    /**
+     * @brief   Destructor
+     */
+    ~AudioDecodeScheduler(void);
+
+    /**
+     * @brief   Queue encoded samples for decoding
+     * @param   dec  The decoder to use
+     * @param   buf  The buffer containing the encoded samples
+     * @param   size The size of the buffer
+     *
+     * The data is copied so the buffer may be reused directly after this
+     * function returns. The samples will be written to the decoder when the
+     * current main loop iteration is done.
+     */
+    void writeEncodedSamples(AudioDecoder *dec, const void *buf, int size);
+
+    /**
+     * @brief   Queue a flush request for a decoder
+     * @param   dec The decoder to flush
+     *
+     * The flushEncodedSamples function of the decoder will be called after
+     * all previously queued packets for the decoder have been decoded.
+     */
+    void flushEncodedSamples(AudioDecoder *dec);
+
+    /**
+     * @brief   Tell the scheduler if the output from a decoder is needed
+     * @param   dec The decoder
+     * @param   is_needed Set to \em false to drop packets instead of decoding
+     *
+     * Packets for a decoder that is not needed are thrown away when the
+     * batch is processed. Flush requests are still passed on. Decoders are
+     * needed by default.
+     */
+    void setNeeded(AudioDecoder *dec, bool is_needed);
+
+    /**
+     * @brief   Remove all queued packets for a decoder
+     * @param   dec The decoder
+     *
+     * This function must be called before a decoder that has been used with
+     * the scheduler is deleted.
+     */
+    void cancel(AudioDecoder *dec);
+
+    /**
+     * @brief   Decode all queued packets now
+     */
+    void processPending(void);
+
+    /**
+     * @brief   Get the number of packets that have been decoded
+     * @return  Returns the total number of decoded packets
+     */
+    uint64_t decodedCount(void) const { return decoded_cnt; }
+
+    /**
+     * @brief   Get the number of dropped packets
+     * @return  Returns the total number of packets that have been thrown
+     *          away since the decoder was not needed
+     */
+    uint64_t droppedCount(void) const { return dropped_cnt; }
+
+  private:
+    struct Packet
+    {
+      AudioDecoder* dec;
+      size_t        offset;
+      int           size;     // -1 for a flush request
+    };
+    typedef std::vector<Packet>   Packets;
+    typedef std::vector<uint8_t>  Buffer;
+
+    static AudioDecodeScheduler *the_instance;
+
+    Timer *                     process_timer;
+    Packets                     pending;
+    Buffer                      pending_data;
+    Packets                     processing;
+    Buffer                      processing_data;
+    std::vector<AudioDecoder*>  not_needed;
+    uint64_t                    decoded_cnt;
+    uint64_t                    dropped_cnt;
+
+    AudioDecodeScheduler(void);
+    AudioDecodeScheduler(const AudioDecodeScheduler&);
+    AudioDecodeScheduler& operator=(const AudioDecodeScheduler&);
+    void queuePacket(AudioDecoder *dec, const void *buf, int size);
+    void processTimerExpired(Timer *t);
+    bool isNeeded(AudioDecoder *dec) const;
+
+};  /* class AudioDecodeScheduler */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_DECODE_SCHEDULER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
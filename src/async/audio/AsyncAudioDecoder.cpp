@@ -181,6 +181,35 @@ AudioDecoder *AudioDecoder::create(const std::string &name)
  *
  ****************************************************************************/
 
+float *AudioDecoder::decodeBuffer(int count)
+{
+  float *buf = sinkWriteBuffer(count);
+  m_sink_buffer_used = (buf != 0);
+  if (buf == 0)
+  {
+    if (m_dec_buf.size() < static_cast<size_t>(count))
+    {
+      m_dec_buf.resize(count);
+    }
+    buf = &m_dec_buf[0];
+  }
+  return buf;
+} /* AudioDecoder::decodeBuffer */
+
+
+void AudioDecoder::writeDecodedSamples(int count)
+{
+  if (m_sink_buffer_used)
+  {
+    m_sink_buffer_used = false;
+    sinkCommitSamples(count);
+  }
+  else if (count > 0)
+  {
+    sinkWriteSamples(&m_dec_buf[0], count);
+  }
+} /* AudioDecoder::writeDecodedSamples */
+
 
 
 /****************************************************************************
@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <string>
+#include <vector>
 #include <sigc++/sigc++.h>
 
 
@@ -109,6 +110,11 @@ namespace Async
 @date   2008-10-06
 
 This is the base class for an audio decoder.
+
+A decoder implementation should use the decodeBuffer and writeDecodedSamples
+functions to output the decoded samples. If the connected sink provide a
+buffer of its own, e.g. an AudioFifo, the samples are then decoded directly
+into that buffer so that they do not have to be copied.
 */
 class AudioDecoder : public AudioSource, public sigc::trackable
 {
@@ -128,7 +134,7 @@ class AudioDecoder : public AudioSource, public sigc::trackable
     /**
      * @brief 	Default constuctor
      */
-    AudioDecoder(void) {}
+    AudioDecoder(void) : m_sink_buffer_used(false) {}
   
     /**
      * @brief 	Destructor
@@ -159,6 +165,22 @@ class AudioDecoder : public AudioSource, public sigc::trackable
      * @param 	size The size of the buffer
      */
     virtual void writeEncodedSamples(void *buf, int size) = 0;
+
+    /**
+     * @brief 	Write encoded samples received after a packet loss
+     * @param 	buf  Buffer containing encoded samples
+     * @param 	size The size of the buffer
+     *
+     * Call this function instead of writeEncodedSamples for the first packet
+     * received after a packet has been lost. Decoders that support forward
+     * error correction can then recover the lost audio from the redundant
+     * data in the given packet before decoding it. The default is to just
+     * decode the packet.
+     */
+    virtual void writeEncodedSamplesAfterLoss(void *buf, int size)
+    {
+      writeEncodedSamples(buf, size);
+    }
     
     /**
      * @brief Call this function when all encoded samples have been received
@@ -189,9 +211,29 @@ class AudioDecoder : public AudioSource, public sigc::trackable
      * This function is normally only called from a connected sink object.
      */
     virtual void allSamplesFlushed(void) { allEncodedSamplesFlushed(); }
+
+    /**
+     * @brief   Get a buffer to decode samples into
+     * @param   count The maximum number of samples that will be decoded
+     * @return  Returns a buffer with room for count samples
+     *
+     * The returned buffer is a buffer in the connected sink if it provide
+     * one or else an internal buffer. The decoded samples must be written
+     * using writeDecodedSamples before anything else is written to the sink.
+     */
+    float *decodeBuffer(int count);
+
+    /**
+     * @brief   Write the samples decoded into the buffer from decodeBuffer
+     * @param   count The number of decoded samples, may be zero
+     */
+    void writeDecodedSamples(int count);
     
     
   private:
+    std::vector<float>  m_dec_buf;
+    bool                m_sink_buffer_used;
+
     AudioDecoder(const AudioDecoder&);
     AudioDecoder& operator=(const AudioDecoder&);
     
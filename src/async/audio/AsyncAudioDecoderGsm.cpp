@@ -49,6 +49,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncAudioDecoderGsm.h"
+#include "AsyncAudioSampleOps.h"
+#ifdef ASYNC_AUDIO_PROFILING
+#include "AsyncAudioPerfCounters.h"
+#endif
 
 
 
@@ -134,14 +138,18 @@ void AudioDecoderGsm::writeEncodedSamples(void *buf, int size)
     if (frame_len == sizeof(frame))
     {
       gsm_signal s16_samples[FRAME_SAMPLE_CNT];
-      gsm_decode(gsmh, frame, s16_samples);
-    
-      float samples[FRAME_SAMPLE_CNT];
-      for (int j=0; j<FRAME_SAMPLE_CNT; ++j)
       {
-        samples[j] = static_cast<float>(s16_samples[j]) / 32768.0;
+#ifdef ASYNC_AUDIO_PROFILING
+        static AudioPerfCounters::Stage *perf_stage =
+            AudioPerfCounters::stage("gsm decode");
+        AudioPerfCounters::Probe probe(perf_stage, FRAME_SAMPLE_CNT);
+#endif
+        gsm_decode(gsmh, frame, s16_samples);
       }
-      sinkWriteSamples(samples, FRAME_SAMPLE_CNT);
+    
+      float *samples = decodeBuffer(FRAME_SAMPLE_CNT);
+      AudioSampleOps::s16ToFloat(samples, s16_samples, FRAME_SAMPLE_CNT);
+      writeDecodedSamples(FRAME_SAMPLE_CNT);
       frame_len = 0;
     }
   }
@@ -154,10 +154,10 @@ class AudioDecoderNull : public AudioDecoder
       uint16_t cnt = static_cast<uint16_t>(ptr[0]);
       cnt |= static_cast<uint16_t>(ptr[1]) << 8;
 
-        // Allocate a zeroed out buffer and write it to the sink
-      float samples[cnt];
+        // Write a zeroed out buffer to the sink
+      float *samples = decodeBuffer(cnt);
       std::memset(samples, 0, cnt * sizeof(*samples));
-      sinkWriteSamples(samples, cnt);
+      writeDecodedSamples(cnt);
     }
 
   protected:
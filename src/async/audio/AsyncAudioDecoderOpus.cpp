@@ -52,7 +52,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include "AsyncAudioSampleRate.h"
 #include "AsyncAudioDecoderOpus.h"
+#ifdef ASYNC_AUDIO_PROFILING
+#include "AsyncAudioPerfCounters.h"
+#endif
 
 
 
@@ -225,15 +229,19 @@ void AudioDecoderOpus::writeEncodedSamples(void *buf, int size)
     return;
   }
   //cout << "### frame_cnt=" << frame_cnt << " frame_size=" << frame_size;
-  float samples[frame_cnt*frame_size];
-  frame_size = opus_decode_float(dec, packet, size, samples,
-                                 frame_cnt*frame_size, 0);
-  //cout << " " << frame_size << endl;
-  if (frame_size > 0)
+  float *samples = decodeBuffer(frame_cnt*frame_size);
   {
-    sinkWriteSamples(samples, frame_size);
+#ifdef ASYNC_AUDIO_PROFILING
+    static AudioPerfCounters::Stage *perf_stage =
+        AudioPerfCounters::stage("opus decode");
+    AudioPerfCounters::Probe probe(perf_stage, frame_cnt*frame_size);
+#endif
+    frame_size = opus_decode_float(dec, packet, size, samples,
+                                   frame_cnt*frame_size, 0);
   }
-  else if (frame_size < 0)
+  //cout << " " << frame_size << endl;
+  writeDecodedSamples((frame_size > 0) ? frame_size : 0);
+  if (frame_size < 0)
   {
     cerr << "**** ERROR: Opus decoder error: " << opus_strerror(frame_size)
          << endl;
@@ -241,6 +249,32 @@ void AudioDecoderOpus::writeEncodedSamples(void *buf, int size)
 } /* AudioDecoderOpus::writeEncodedSamples */
 
 
+void AudioDecoderOpus::writeEncodedSamplesAfterLoss(void *buf, int size)
+{
+  unsigned char *packet = reinterpret_cast<unsigned char *>(buf);
+
+    // The lost packet is assumed to be as long as this one. With several
+    // frames per packet, the part not covered by the FEC data is concealed.
+  int lost_size = opus_packet_get_nb_samples(packet, size,
+                                             INTERNAL_SAMPLE_RATE);
+  if (lost_size > 0)
+  {
+    float *samples = decodeBuffer(lost_size);
+    int cnt;
+    {
+#ifdef ASYNC_AUDIO_PROFILING
+      static AudioPerfCounters::Stage *perf_stage =
+          AudioPerfCounters::stage("opus decode fec");
+      AudioPerfCounters::Probe probe(perf_stage, lost_size);
+#endif
+      cnt = opus_decode_float(dec, packet, size, samples, lost_size, 1);
+    }
+    writeDecodedSamples((cnt > 0) ? cnt : 0);
+  }
+  writeEncodedSamples(buf, size);
+} /* AudioDecoderOpus::writeEncodedSamplesAfterLoss */
+
+
 
 /****************************************************************************
  *
@@ -166,6 +166,17 @@ class AudioDecoderOpus : public AudioDecoder
      * @param 	size The size of the buffer
      */
     virtual void writeEncodedSamples(void *buf, int size);
+
+    /**
+     * @brief 	Write encoded samples received after a packet loss
+     * @param 	buf  Buffer containing encoded samples
+     * @param 	size The size of the buffer
+     *
+     * The lost frame is recovered using the inband FEC data in the given
+     * packet, if the remote encoder have FEC enabled. Otherwise the Opus
+     * packet loss concealment is used to fill in the lost audio.
+     */
+    virtual void writeEncodedSamplesAfterLoss(void *buf, int size);
     
 
   protected:
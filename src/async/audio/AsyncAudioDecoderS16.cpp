@@ -50,6 +50,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncAudioDecoderS16.h"
+#include "AsyncAudioSampleOps.h"
 
 
 
@@ -127,12 +128,9 @@ void AudioDecoderS16::writeEncodedSamples(void *buf, int size)
 {
   int16_t *s16_samples = reinterpret_cast<int16_t *>(buf);
   int count = size / sizeof(int16_t);
-  float samples[count];
-  for (int i=0; i<count; ++i)
-  {
-    samples[i] = static_cast<float>(s16_samples[i]) / 32768.0;
-  }
-  sinkWriteSamples(samples, count);
+  float *samples = decodeBuffer(count);
+  AudioSampleOps::s16ToFloat(samples, s16_samples, count);
+  writeDecodedSamples(count);
 } /* AudioDecoderS16::writeEncodedSamples */
 
 
@@ -50,7 +50,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include "AsyncAudioSampleRate.h"
 #include "AsyncAudioDecoderSpeex.h"
+#ifdef ASYNC_AUDIO_PROFILING
+#include "AsyncAudioPerfCounters.h"
+#endif
 
 
 
@@ -87,6 +91,8 @@ using namespace Async;
  *
  ****************************************************************************/
 
+static int decodeFrame(void *dec_state, SpeexBits *bits, float *samples,
+                       int frame_size);
 
 
 /****************************************************************************
@@ -115,11 +121,8 @@ using namespace Async;
 AudioDecoderSpeex::AudioDecoderSpeex(void)
 {
   speex_bits_init(&bits);
-#if INTERNAL_SAMPLE_RATE == 16000
-  dec_state = speex_decoder_init(&speex_wb_mode);
-#else
-  dec_state = speex_decoder_init(&speex_nb_mode);
-#endif
+  dec_state = speex_decoder_init(
+      (INTERNAL_SAMPLE_RATE == 16000) ? &speex_wb_mode : &speex_nb_mode);
   speex_decoder_ctl(dec_state, SPEEX_GET_FRAME_SIZE, &frame_size);
   
   //enableEnhancer(false);
@@ -180,11 +183,11 @@ void AudioDecoderSpeex::writeEncodedSamples(void *buf, int size)
   char *ptr = (char *)buf;
   
   speex_bits_read_from(&bits, ptr, size);
-  float samples[frame_size];
+  float *samples = decodeBuffer(frame_size);
 #if SPEEX_MAJOR > 1 || (SPEEX_MAJOR == 1 && SPEEX_MINOR >= 1)
-  while (speex_decode(dec_state, &bits, samples) == 0)
+  while (decodeFrame(dec_state, &bits, samples, frame_size) == 0)
 #else
-  while ((speex_decode(dec_state, &bits, samples) == 0) &&
+  while ((decodeFrame(dec_state, &bits, samples, frame_size) == 0) &&
          (speex_bits_remaining(&bits) > 0))
 #endif
   {
@@ -192,8 +195,10 @@ void AudioDecoderSpeex::writeEncodedSamples(void *buf, int size)
     {
       samples[i] = samples [i] / 32767.0;
     }
-    sinkWriteSamples(samples, frame_size);
+    writeDecodedSamples(frame_size);
+    samples = decodeBuffer(frame_size);
   }
+  writeDecodedSamples(0);
 } /* AudioDecoderSpeex::writeEncodedSamples */
 
 
@@ -212,6 +217,17 @@ void AudioDecoderSpeex::writeEncodedSamples(void *buf, int size)
  *
  ****************************************************************************/
 
+static int decodeFrame(void *dec_state, SpeexBits *bits, float *samples,
+                       int frame_size)
+{
+#ifdef ASYNC_AUDIO_PROFILING
+  static AudioPerfCounters::Stage *perf_stage =
+      AudioPerfCounters::stage("speex decode");
+  AudioPerfCounters::Probe probe(perf_stage, frame_size);
+#endif
+  return speex_decode(dec_state, bits, samples);
+} /* decodeFrame */
+
 
 
 /*
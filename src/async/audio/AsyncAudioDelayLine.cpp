@@ -35,6 +35,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cstring>
 #include <cmath>
 #include <algorithm>
+#include <map>
+#include <vector>
 
 
 /****************************************************************************
@@ -51,6 +53,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include "AsyncAudioSampleRate.h"
+#include "AsyncAudioSampleOps.h"
 #include "AsyncAudioDelayLine.h"
 
 
@@ -113,13 +117,27 @@ using namespace Async;
  *
  ****************************************************************************/
 
-AudioDelayLine::AudioDelayLine(int length_ms)
-  : size(length_ms * INTERNAL_SAMPLE_RATE / 1000), ptr(0), flush_cnt(0),
-    is_muted(false), mute_cnt(0), last_clear(0), fade_gain(0), fade_len(0),
-    fade_pos(0), fade_dir(0)
+AudioDelayLine::AudioDelayLine(int length_ms, bool store_s16)
+  : buf(0), buf16(0), size(length_ms * INTERNAL_SAMPLE_RATE / 1000), mask(0),
+    ptr(0), flush_cnt(0), is_muted(false), mute_cnt(0), last_clear(0),
+    fade_gain(0), fade_len(0), fade_pos(0), fade_dir(0)
 {
-  buf = new float[size];
-  memset(buf, 0, size * sizeof(*buf));
+  unsigned buf_size = 1;
+  while (buf_size < static_cast<unsigned>(size))
+  {
+    buf_size <<= 1;
+  }
+  mask = buf_size - 1;
+  if (store_s16)
+  {
+    buf16 = new int16_t[buf_size];
+    memset(buf16, 0, buf_size * sizeof(*buf16));
+  }
+  else
+  {
+    buf = new float[buf_size];
+    memset(buf, 0, buf_size * sizeof(*buf));
+  }
   clear();
   setFadeTime(DEFAULT_FADE_TIME);
 } /* AudioDelayLine::AudioDelayLine */
@@ -127,14 +145,13 @@ AudioDelayLine::AudioDelayLine(int length_ms)
 
 AudioDelayLine::~AudioDelayLine(void)
 {
-  delete [] fade_gain;
   delete [] buf;
+  delete [] buf16;
 } /* AudioDelayLine::~AudioDelayLine */
 
 
 void AudioDelayLine::setFadeTime(int time_ms)
 {
-  delete [] fade_gain;
   fade_gain = 0;
   
   if (time_ms <= 0)
@@ -147,12 +164,7 @@ void AudioDelayLine::setFadeTime(int time_ms)
 
   fade_len = time_ms * INTERNAL_SAMPLE_RATE / 1000;
   fade_pos = min(fade_pos, fade_len-1);
-  fade_gain = new float[fade_len];
-  for (int i=0; i<fade_len-1; ++i)
-  {
-    fade_gain[i] = pow(2.0f, -15.0f * (static_cast<float>(i) / fade_len));
-  }
-  fade_gain[fade_len-1] = 0;
+  fade_gain = fadeTable(fade_len);
 } /* AudioDelayLine::setFadeTime  */
 
 
@@ -168,12 +180,7 @@ void AudioDelayLine::mute(bool do_mute, int time_ms)
   {
     fade_pos = 0; // Reset fade gain
     fade_dir = 1; // Fade out
-    ptr = (ptr + size - mute_ext) % size;
-    for (int i=0; i<mute_ext; ++i)
-    {
-      ptr = (ptr < size-1) ? ptr+1 : 0;
-      buf[ptr] *= currentFadeGain();
-    }
+    fadeBlock(ptr + size - mute_ext, mute_ext);
     is_muted = true;
     mute_cnt = 0;
   }
@@ -206,12 +213,7 @@ void AudioDelayLine::clear(int time_ms)
 
   //fade_pos = 0; // Reset fade gain
   fade_dir = 1; // Fade out
-  ptr = (ptr + size - count) % size;
-  for (int i=0; i<count; ++i)
-  {
-    ptr = (ptr < size-1) ? ptr+1 : 0;
-    buf[ptr] *= currentFadeGain();
-  }
+  fadeBlock(ptr + size - count, count);
 
   if (!is_muted)
   {
@@ -230,25 +232,34 @@ int AudioDelayLine::writeSamples(const float *samples, int count)
   
   count = min(count, size);
   float output[count];
-  int out_ptr = ptr;
-  for (int i=0; i<count; ++i)
-  {
-    output[i] = buf[out_ptr];
-    out_ptr = (out_ptr < size-1) ? out_ptr+1 : 0;
-  }
+  readBlock(output, ptr, count);
 
   int written = sinkWriteSamples(output, count);
 
-  for (int i=0; i<written; ++i)
+    // The incoming samples are stored behind the newest sample in the delay
+    // line. The output buffer is reused to apply the fade.
+  int pos = 0;
+  while (pos < written)
   {
-    buf[ptr] = samples[i] * currentFadeGain();
-    if (is_muted && (mute_cnt > 0) && (--mute_cnt == 0))
+    int cnt = written - pos;
+    bool unmute = false;
+    if (is_muted && (mute_cnt > 0))
+    {
+      unmute = (cnt >= mute_cnt);
+      cnt = min(cnt, mute_cnt);
+      mute_cnt -= cnt;
+    }
+    memcpy(output + pos, samples + pos, cnt * sizeof(*output));
+    applyFade(output + pos, cnt);
+    if (unmute)
     {
       fade_dir = -1; // Fade in
       is_muted = false;
     }
-    ptr = (ptr < size-1) ? ptr+1 : 0;
+    pos += cnt;
   }
+  writeBlock(ptr + size, output, written);
+  ptr += written;
   
   return written;
   
@@ -312,21 +323,12 @@ void AudioDelayLine::writeRemainingSamples(void)
   while ((written > 0) && (flush_cnt > 0))
   {
     int count = min(512, flush_cnt);
-    
-    int out_ptr = ptr;
-    for (int i=0; i<count; ++i)
-    {
-      output[i] = buf[out_ptr];
-      out_ptr = (out_ptr < size-1) ? out_ptr+1 : 0;
-    }
+    readBlock(output, ptr, count);
 
     written = sinkWriteSamples(output, count);
 
-    for (int i=0; i<written; ++i)
-    {
-      buf[ptr] = 0;
-      ptr = (ptr < size-1) ? ptr+1 : 0;
-    }
+    zeroBlock(ptr + size, written);
+    ptr += written;
 
     flush_cnt -= written;
   }
@@ -338,6 +340,153 @@ void AudioDelayLine::writeRemainingSamples(void)
 } /* AudioDelayLine::writeRemainingSamples */
 
 
+void AudioDelayLine::readBlock(float *dest, unsigned pos, int count) const
+{
+  pos &= mask;
+  int first = min(count, static_cast<int>(mask + 1 - pos));
+  if (buf != 0)
+  {
+    memcpy(dest, buf + pos, first * sizeof(*dest));
+    memcpy(dest + first, buf, (count - first) * sizeof(*dest));
+  }
+  else
+  {
+    AudioSampleOps::s16ToFloat(dest, buf16 + pos, first);
+    AudioSampleOps::s16ToFloat(dest + first, buf16, count - first);
+  }
+} /* AudioDelayLine::readBlock */
+
+
+void AudioDelayLine::writeBlock(unsigned pos, const float *src, int count)
+{
+  pos &= mask;
+  int first = min(count, static_cast<int>(mask + 1 - pos));
+  if (buf != 0)
+  {
+    memcpy(buf + pos, src, first * sizeof(*src));
+    memcpy(buf, src + first, (count - first) * sizeof(*src));
+  }
+  else
+  {
+    memset(buf16 + pos, 0, first * sizeof(*buf16));
+    memset(buf16, 0, (count - first) * sizeof(*buf16));
+    AudioSampleOps::mixFloatToS16(buf16 + pos, src, first);
+    AudioSampleOps::mixFloatToS16(buf16, src + first, count - first);
+  }
+} /* AudioDelayLine::writeBlock */
+
+
+void AudioDelayLine::zeroBlock(unsigned pos, int count)
+{
+  pos &= mask;
+  int first = min(count, static_cast<int>(mask + 1 - pos));
+  if (buf != 0)
+  {
+    memset(buf + pos, 0, first * sizeof(*buf));
+    memset(buf, 0, (count - first) * sizeof(*buf));
+  }
+  else
+  {
+    memset(buf16 + pos, 0, first * sizeof(*buf16));
+    memset(buf16, 0, (count - first) * sizeof(*buf16));
+  }
+} /* AudioDelayLine::zeroBlock */
+
+
+void AudioDelayLine::fadeBlock(unsigned pos, int count)
+{
+  float tmp[BLOCK_SIZE];
+  while (count > 0)
+  {
+    int cnt = min(count, static_cast<int>(BLOCK_SIZE));
+    readBlock(tmp, pos, cnt);
+    applyFade(tmp, cnt);
+    writeBlock(pos, tmp, cnt);
+    pos += cnt;
+    count -= cnt;
+  }
+} /* AudioDelayLine::fadeBlock */
+
+
+void AudioDelayLine::applyFade(float *samples, int count)
+{
+  if (fade_gain == 0)
+  {
+    return;
+  }
+
+  while (count > 0)
+  {
+    if (fade_dir == 0)
+    {
+        // Not fading so the gain is constant, either one or zero
+      float gain = fade_gain[fade_pos];
+      if (gain != 1.0f)
+      {
+        for (int i=0; i<count; ++i)
+        {
+          samples[i] *= gain;
+        }
+      }
+      return;
+    }
+
+    int cnt;
+    if (fade_dir > 0)
+    {
+      cnt = min(count, max(0, fade_len - 1 - fade_pos));
+      const float *gain = fade_gain + fade_pos;
+      for (int i=0; i<cnt; ++i)
+      {
+        samples[i] *= gain[i];
+      }
+      fade_pos += cnt;
+      if (fade_pos >= fade_len - 1)
+      {
+        fade_dir = 0;
+        fade_pos = fade_len - 1;
+      }
+    }
+    else
+    {
+      cnt = min(count, fade_pos);
+      const float *gain = fade_gain + fade_pos;
+      for (int i=0; i<cnt; ++i)
+      {
+        samples[i] *= gain[-i];
+      }
+      fade_pos -= cnt;
+      if (fade_pos <= 0)
+      {
+        fade_dir = 0;
+        fade_pos = 0;
+      }
+    }
+    samples += cnt;
+    count -= cnt;
+  }
+} /* AudioDelayLine::applyFade */
+
+
+const float *AudioDelayLine::fadeTable(int len)
+{
+    // The tables are never freed. There will only be a few different fade
+    // lengths in use.
+  static map<int, vector<float> > tables;
+  vector<float> &table = tables[len];
+  if (table.empty())
+  {
+    table.resize(len);
+    for (int i=0; i<len-1; ++i)
+    {
+      table[i] = pow(2.0f, -15.0f * (static_cast<float>(i) / len));
+    }
+    table[len-1] = 0;
+  }
+  return &table[0];
+} /* AudioDelayLine::fadeTable */
+
+
 
 /*
  * This file has not been truncated
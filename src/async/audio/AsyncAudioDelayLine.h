@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <stdint.h>
 
 
 /****************************************************************************
@@ -113,6 +114,11 @@ the specified amount of time. This can be useful if you want to mute audio
 based on a slow detector. With a delay line you have the possibility to
 mute audio that have passed the detector but have not yet passed through the
 delay line.
+
+The samples are stored in a ring buffer which size is a power of two so that
+samples can be copied in and out in contiguous blocks. Long delay lines may
+optionally store the samples as 16 bit integers to halve the memory usage.
+The fade curves are shared between all delay lines using the same fade time.
 */
 class AudioDelayLine : public Async::AudioSink, public Async::AudioSource
 {
@@ -120,8 +126,12 @@ class AudioDelayLine : public Async::AudioSink, public Async::AudioSource
     /**
      * @brief Constuctor
      * @param length_ms The length in milliseconds of the delay line
+     * @param store_s16 Set to \em true to store the samples as 16 bit integers
+     *
+     * When storing the samples as 16 bit integers, samples outside of the
+     * range -1.0 to 1.0 will be clipped.
      */
-    explicit AudioDelayLine(int length_ms);
+    explicit AudioDelayLine(int length_ms, bool store_s16=false);
   
     /**
      * @brief 	Destructor
@@ -208,15 +218,18 @@ class AudioDelayLine : public Async::AudioSink, public Async::AudioSource
     
   private:
     static const int DEFAULT_FADE_TIME = 10; // 10ms default fade time
+    static const int BLOCK_SIZE = 256;
 
     float	*buf;
+    int16_t	*buf16;
     int		size;
-    int		ptr;
+    unsigned	mask;
+    unsigned	ptr;
     int		flush_cnt;
     bool	is_muted;
     int		mute_cnt;
     int		last_clear;
-    float	*fade_gain;
+    const float	*fade_gain;
     int		fade_len;
     int		fade_pos;
     int		fade_dir;
@@ -224,31 +237,12 @@ class AudioDelayLine : public Async::AudioSink, public Async::AudioSource
     AudioDelayLine(const AudioDelayLine&);
     AudioDelayLine& operator=(const AudioDelayLine&);
     void writeRemainingSamples(void);
-
-    inline float currentFadeGain(void)
-    {
-      if (fade_gain == 0)
-      {
-        return 1.0f;
-      }
-      
-      float gain = fade_gain[fade_pos];
-      fade_pos += fade_dir;
-      
-      if ((fade_dir > 0) && (fade_pos >= fade_len-1))
-      {
-        fade_dir = 0;
-        fade_pos = fade_len-1;
-      }
-      else if ((fade_dir < 0) && (fade_pos <= 0))
-      {
-        fade_dir = 0;
-        fade_pos = 0;
-      }
-      
-      return gain;
-      
-    } /* AudioDelayLine::currentFadeGain  */
+    void readBlock(float *dest, unsigned pos, int count) const;
+    void writeBlock(unsigned pos, const float *src, int count);
+    void zeroBlock(unsigned pos, int count);
+    void fadeBlock(unsigned pos, int count);
+    void applyFade(float *samples, int count);
+    static const float *fadeTable(int len);
 
 };  /* class AudioDelayLine */
 
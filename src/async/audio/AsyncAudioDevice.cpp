@@ -59,6 +59,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "AsyncAudioIO.h"
 #include "AsyncAudioDevice.h"
 #include "AsyncAudioDeviceFactory.h"
+#include "AsyncAudioSampleOps.h"
+#include "AsyncAudioLatencyTrace.h"
 
 
 /****************************************************************************
@@ -253,7 +255,8 @@ void AudioDevice::close(void)
 
 
 AudioDevice::AudioDevice(const string& dev_name)
-  : dev_name(dev_name), current_mode(MODE_NONE), use_count(0)
+  : dev_name(dev_name), current_mode(MODE_NONE), use_count(0),
+    dev_block_size_hint(0), dev_block_count_hint(0)
 {
 } /* AudioDevice::AudioDevice */
 
@@ -266,19 +269,27 @@ AudioDevice::~AudioDevice(void)
 void AudioDevice::putBlocks(int16_t *buf, int frame_cnt)
 {
   //printf("putBlocks: frame_cnt=%d\n", frame_cnt);
+
+    // Sampled blocks carry their capture time for latency tracing. The
+    // first sample of the block was captured a block length ago.
+  AudioLatencyTrace::Scope latency_scope(AudioLatencyTrace::newCaptureMark(
+        static_cast<unsigned>(1000000ULL * frame_cnt / sample_rate)));
+
   float samples[frame_cnt];
   for (int ch=0; ch<channels; ch++)
   {
-    for (int i=0; i<frame_cnt; i++)
-    {
-        // no divisions in index calculation (embedded system performance !!!)
-      samples[i] = static_cast<float>(buf[i * channels + ch]) / 32768.0;
-    }
+      // Only convert the channels that someone is listening to
+    bool converted = false;
     list<AudioIO*>::iterator it;
     for (it=aios.begin(); it!=aios.end(); ++it)
     {
       if ((*it)->channel() == ch)
       {
+        if (!converted)
+        {
+          AudioSampleOps::s16ToFloat(samples, buf + ch, frame_cnt, channels);
+          converted = true;
+        }
         (*it)->audioRead(samples, frame_cnt);
       }
     }
@@ -286,12 +297,116 @@ void AudioDevice::putBlocks(int16_t *buf, int frame_cnt)
 } /* AudioDevice::putBlocks */
 
 
+void AudioDevice::putPlanarBlocks(float *buf, int frame_cnt)
+{
+  AudioLatencyTrace::Scope latency_scope(AudioLatencyTrace::newCaptureMark(
+        static_cast<unsigned>(1000000ULL * frame_cnt / sample_rate)));
+
+  list<AudioIO*>::iterator it;
+  for (it=aios.begin(); it!=aios.end(); ++it)
+  {
+    int ch = (*it)->channel();
+    if ((ch >= 0) && (ch < channels))
+    {
+      (*it)->audioRead(buf + ch * frame_cnt, frame_cnt);
+    }
+  }
+} /* AudioDevice::putPlanarBlocks */
+
+
 int AudioDevice::getBlocks(int16_t *buf, int block_cnt)
 {
   unsigned block_size = writeBlocksize();
-  unsigned frames_to_write = block_cnt * block_size;
-  memset(buf, 0, channels * frames_to_write * sizeof(*buf));
+  memset(buf, 0, channels * block_cnt * block_size * sizeof(*buf));
+
+  bool do_flush = false;
+  unsigned frames_to_write = framesToWrite(block_cnt, do_flush);
+
+    // If there are no frames to write, bail out and wait for an AudioIO
+    // object to provide us with some.
+  if (frames_to_write == 0)
+  {
+    return 0;
+  }
+  
+    // Fill the sample buffer with samples from the non-idle AudioIO objects.
+  list<AudioIO*>::iterator it;
+  for (it=aios.begin(); it!=aios.end(); ++it)
+  {
+    if (!(*it)->isIdle())
+    {
+      int channel = (*it)->channel();
+      float tmp[frames_to_write];
+      int samples_read = (*it)->readSamples(tmp, frames_to_write);
+      AudioSampleOps::mixFloatToS16(buf + channel, tmp, samples_read,
+                                    channels);
+    }
+  }  
+      
+    // If flushing and the number of frames to write is not an even
+    // multiple of the frag size, round the number of frags to write
+    // up. The end of the buffer is already zeroed out.
+  if (do_flush && (frames_to_write % block_size > 0))
+  {
+    frames_to_write /= block_size;
+    frames_to_write = (frames_to_write + 1) * block_size;
+  }
   
+  return frames_to_write / block_size;
+  
+} /* AudioDevice::getBlocks */
+
+
+int AudioDevice::getBlocks(float *buf, int block_cnt)
+{
+  unsigned block_size = writeBlocksize();
+  memset(buf, 0, channels * block_cnt * block_size * sizeof(*buf));
+
+  bool do_flush = false;
+  unsigned frames_to_write = framesToWrite(block_cnt, do_flush);
+  if (frames_to_write == 0)
+  {
+    return 0;
+  }
+
+  list<AudioIO*>::iterator it;
+  for (it=aios.begin(); it!=aios.end(); ++it)
+  {
+    if (!(*it)->isIdle())
+    {
+      float *dst = buf + (*it)->channel();
+      float tmp[frames_to_write];
+      int samples_read = (*it)->readSamples(tmp, frames_to_write);
+      for (int i=0; i<samples_read; ++i)
+      {
+        dst[i * channels] += tmp[i];
+      }
+    }
+  }
+
+  if (do_flush && (frames_to_write % block_size > 0))
+  {
+    frames_to_write /= block_size;
+    frames_to_write = (frames_to_write + 1) * block_size;
+  }
+
+  return frames_to_write / block_size;
+
+} /* AudioDevice::getBlocks */
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+unsigned AudioDevice::framesToWrite(int block_cnt, bool &do_flush)
+{
+  unsigned block_size = writeBlocksize();
+  unsigned frames_to_write = block_cnt * block_size;
+
     // Loop through all AudioIO objects and find out if they have any
     // samples to write and how many. The non-flushing AudioIO object with
     // the least number of samples will decide how many samples can be
@@ -299,7 +414,7 @@ int AudioDevice::getBlocks(int16_t *buf, int block_cnt)
     // object with the most number of samples will decide how many samples
     // get written.
   list<AudioIO*>::iterator it;
-  bool do_flush = true;
+  do_flush = true;
   unsigned int max_samples_in_fifo = 0;
   for (it=aios.begin(); it!=aios.end(); ++it)
   {
@@ -327,9 +442,6 @@ int AudioDevice::getBlocks(int16_t *buf, int block_cnt)
     frames_to_write = max_samples_in_fifo;
   }
 
-  //printf("### frames_to_write=%d  do_flush=%s  fragsize=%u\n",
-  //	 frames_to_write, do_flush ? "TRUE" : "FALSE", fragsize);
-  
     // If not flushing, make sure the number of frames to write is an even
     // multiple of the frag size.
   if (!do_flush)
@@ -337,62 +449,10 @@ int AudioDevice::getBlocks(int16_t *buf, int block_cnt)
     frames_to_write /= block_size;
     frames_to_write *= block_size;
   }
-  
-    // If there are no frames to write, bail out and wait for an AudioIO
-    // object to provide us with some.
-  if (frames_to_write == 0)
-  {
-    return 0;
-  }
-  
-    // Fill the sample buffer with samples from the non-idle AudioIO objects.
-  for (it=aios.begin(); it!=aios.end(); ++it)
-  {
-    if (!(*it)->isIdle())
-    {
-      int channel = (*it)->channel();
-      float tmp[frames_to_write];
-      int samples_read = (*it)->readSamples(tmp, frames_to_write);
-      for (int i=0; i<samples_read; ++i)
-      {
-	int buf_pos = i * channels + channel;
-	float sample = 32767.0 * tmp[i] + buf[buf_pos];
-	if (sample > 32767)
-	{
-	  buf[buf_pos] = 32767;
-	}
-	else if (sample < -32767)
-	{
-	  buf[buf_pos] = -32767;
-	}
-	else
-	{
-	  buf[buf_pos] = static_cast<int16_t>(sample);
-	}
-      }
-    }
-  }  
-      
-    // If flushing and the number of frames to write is not an even
-    // multiple of the frag size, round the number of frags to write
-    // up. The end of the buffer is already zeroed out.
-  if (do_flush && (frames_to_write % block_size > 0))
-  {
-    frames_to_write /= block_size;
-    frames_to_write = (frames_to_write + 1) * block_size;
-  }
-  
-  return frames_to_write / block_size;
-  
-} /* AudioDevice::getBlocks */
 
+  return frames_to_write;
 
-
-/****************************************************************************
- *
- * Private member functions
- *
- ****************************************************************************/
+} /* AudioDevice::framesToWrite */
 
 
 /*
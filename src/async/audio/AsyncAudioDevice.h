@@ -49,6 +49,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -229,6 +230,33 @@ class AudioDevice : public sigc::trackable
 
     static int getChannels(void) { return channels; }
 
+    /**
+     * @brief 	Set the block size to use for this audio device only
+     * @param 	size  The block size in samples per channel or 0 to use the
+     *                global setting
+     *
+     * Use this function to override the global block size, set using
+     * setBlocksize, for this audio device. The setting is used the next time
+     * the audio device is opened.
+     */
+    void setDeviceBlocksize(int size)
+    {
+      dev_block_size_hint = (size <= 0) ? 0 : size;
+    }
+
+    /**
+     * @brief 	Set the block count to use for this audio device only
+     * @param 	count The block count or 0 to use the global setting
+     *
+     * Use this function to override the global block count, set using
+     * setBlockCount, for this audio device. The setting is used the next time
+     * the audio device is opened.
+     */
+    void setDeviceBlockCount(int count)
+    {
+      dev_block_count_hint = (count <= 0) ? 0 : count;
+    }
+
     /**
      * @brief 	Check if the audio device has full duplex capability
      * @return	Returns \em true if the device has full duplex capability
@@ -321,12 +349,56 @@ class AudioDevice : public sigc::trackable
      */
     virtual void closeDevice(void) = 0;
 
+    /**
+     * @brief 	Get the block size to use when opening this device
+     * @return	Returns the block size hint in samples per channel
+     */
+    int blocksizeHint(void) const
+    {
+      return (dev_block_size_hint > 0) ? dev_block_size_hint : block_size_hint;
+    }
+
+    /**
+     * @brief 	Get the block count to use when opening this device
+     * @return	Returns the block count hint
+     */
+    int blockCountHint(void) const
+    {
+      return (dev_block_count_hint > 0) ?
+        dev_block_count_hint : block_count_hint;
+    }
+
     void putBlocks(int16_t *buf, int frame_cnt);
     int getBlocks(int16_t *buf, int block_cnt);
+
+    /**
+     * @brief   Deliver captured audio that is already split into channels
+     * @param   buf       The samples, frame_cnt samples for each channel
+     * @param   frame_cnt The number of frames in the buffer
+     *
+     * This function is used by devices that do the sample conversion and the
+     * channel splitting outside of the main thread. The samples must be
+     * scaled to the range -1.0 to 1.0 and stored one channel after the other,
+     * starting with channel 0.
+     */
+    void putPlanarBlocks(float *buf, int frame_cnt);
+
+    /**
+     * @brief   Get mixed audio to write to the device as float samples
+     * @param   buf       The buffer to store the interleaved samples in
+     * @param   block_cnt The maximum number of blocks to get
+     * @return  Returns the number of blocks stored in the buffer
+     *
+     * This is the same as the 16 bit version but the mixed samples are
+     * stored as floats in the range -1.0 to 1.0, unclipped. It is used by
+     * devices that do the conversion to the device format outside of the main
+     * thread.
+     */
+    int getBlocks(float *buf, int block_cnt);
     
     
   private:
-    static const int  DEFAULT_SAMPLE_RATE = INTERNAL_SAMPLE_RATE;
+    static const int  DEFAULT_SAMPLE_RATE = AudioSampleRate::DEFAULT;
     static const int  DEFAULT_CHANNELS = 2;
     static const int  DEFAULT_BLOCK_COUNT_HINT = 4;
     static const int  DEFAULT_BLOCK_SIZE_HINT = 256; // Samples/channel/block
@@ -336,6 +408,10 @@ class AudioDevice : public sigc::trackable
     Mode      	      	current_mode;
     int       	      	use_count;
     std::list<AudioIO*> aios;
+    int                 dev_block_size_hint;
+    int                 dev_block_count_hint;
+
+    unsigned framesToWrite(int block_cnt, bool &do_flush);
 
 };  /* class AudioDevice */
 
@@ -36,10 +36,16 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <sigc++/sigc++.h>
 #include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <errno.h>
 #include <iostream>
 #include <sstream>
 #include <cmath>
 #include <cstring>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -49,6 +55,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncFdWatch.h>
+#include <AsyncTimer.h>
+#include <AsyncAudioThreadFifo.h>
+#include <AsyncAudioSampleOps.h>
+#include <AsyncMetrics.h>
+#include <AsyncThreadScheduling.h>
 
 
 /****************************************************************************
@@ -80,6 +91,8 @@ using namespace sigc;
  *
  ****************************************************************************/
 
+#define XRUN_REPORT_INTERVAL  10000
+
 
 
 /****************************************************************************
@@ -158,6 +171,102 @@ class AudioDeviceAlsa::AlsaWatch : public sigc::trackable
 };
 
 
+/*
+ * Receive captured audio from the I/O thread, in the main thread. The I/O
+ * thread has already converted the samples to float and split them into
+ * channels so each block hold rec_block_size samples for channel 0, followed
+ * by the samples for channel 1 and so on.
+ */
+class AudioDeviceAlsa::CaptureSink : public AudioSink
+{
+  public:
+    explicit CaptureSink(AudioDeviceAlsa *dev) : dev(dev) {}
+
+    virtual int writeSamples(const float *samples, int count)
+    {
+      const size_t block_len = dev->rec_block_size * channels;
+      buf.insert(buf.end(), samples, samples + count);
+      size_t pos = 0;
+      while (buf.size() - pos >= block_len)
+      {
+        dev->putPlanarBlocks(&buf[pos], dev->rec_block_size);
+        pos += block_len;
+      }
+      buf.erase(buf.begin(), buf.begin() + pos);
+      return count;
+    }
+
+    virtual void flushSamples(void)
+    {
+      sourceAllSamplesFlushed();
+    }
+
+  private:
+    AudioDeviceAlsa     *dev;
+    std::vector<float>  buf;
+};
+
+
+/*
+ * Feed audio from the AudioIO objects to the I/O thread, in the main thread.
+ * One block at a time is fetched and held until the FIFO has room for it.
+ */
+class AudioDeviceAlsa::PlaybackSource : public AudioSource
+{
+  public:
+    explicit PlaybackSource(AudioDeviceAlsa *dev)
+      : dev(dev), pending_pos(0) {}
+
+    void fill(void)
+    {
+      size_t written = 0;
+      for (;;)
+      {
+        if (pending_pos < pending.size())
+        {
+          int cnt = sinkWriteSamples(&pending[pending_pos],
+                                     pending.size() - pending_pos);
+          pending_pos += cnt;
+          written += cnt;
+          if (pending_pos < pending.size())
+          {
+            break;
+          }
+        }
+
+        float buf[dev->play_block_size * channels];
+        if (dev->getBlocks(buf, 1) == 0)
+        {
+          break;
+        }
+        pending.assign(buf, buf + dev->play_block_size * channels);
+        pending_pos = 0;
+      }
+      if (written > 0)
+      {
+        dev->wakeupIoThread();
+      }
+    }
+
+    int pendingFrames(void) const
+    {
+      return (pending.size() - pending_pos) / channels;
+    }
+
+    virtual void resumeOutput(void)
+    {
+      fill();
+    }
+
+    virtual void allSamplesFlushed(void) {}
+
+  private:
+    AudioDeviceAlsa     *dev;
+    std::vector<float>  pending;
+    size_t              pending_pos;
+};
+
+
 /****************************************************************************
  *
  * Prototypes
@@ -194,8 +303,15 @@ AudioDeviceAlsa::AudioDeviceAlsa(const std::string& dev_name)
   : AudioDevice(dev_name), play_block_size(0), play_block_count(0),
     rec_block_size(0), rec_block_count(0), play_handle(0), 
     rec_handle(0), play_watch(0), rec_watch(0), duplex(false),
-    zerofill_on_underflow(true)
+    zerofill_on_underflow(true), use_mmap(false), play_mmap(false),
+    rec_mmap(false), rt_prio(-1), io_thread_running(false),
+    io_thread_quit(false), play_idle(false), rec_fifo(0), play_fifo(0),
+    capture_sink(0), playback_src(0), xrun_timer(0), rec_xrun_cnt(0),
+    play_xrun_cnt(0), reported_rec_xrun_cnt(0), reported_play_xrun_cnt(0),
+    reported_rec_overrun_cnt(0)
 {
+  io_wakeup_pipe[0] = io_wakeup_pipe[1] = -1;
+
   assert(AudioDeviceAlsa_creator_registered);
 
   char *zerofill_str = getenv("ASYNC_AUDIO_ALSA_ZEROFILL");
@@ -204,6 +320,24 @@ AudioDeviceAlsa::AudioDeviceAlsa(const std::string& dev_name)
     istringstream(zerofill_str) >> zerofill_on_underflow;
   }
 
+  char *mmap_str = getenv("ASYNC_AUDIO_ALSA_MMAP");
+  if (mmap_str != 0)
+  {
+    istringstream(mmap_str) >> use_mmap;
+  }
+
+  char *rt_prio_str = getenv("ASYNC_AUDIO_ALSA_RT_PRIO");
+  if (rt_prio_str != 0)
+  {
+    rt_prio = 0;
+    istringstream(rt_prio_str) >> rt_prio;
+  }
+  else if (ThreadScheduling::isConfigured(ThreadScheduling::ROLE_AUDIO_IO))
+  {
+      // Use an I/O thread, scheduled according to the AUDIO_IO thread role
+    rt_prio = 0;
+  }
+
   snd_pcm_t *play, *capture;
 
     // Open the device to check its duplex capability
@@ -220,6 +354,9 @@ AudioDeviceAlsa::AudioDeviceAlsa(const std::string& dev_name)
     }
     snd_pcm_close(play);
   }
+
+  Metrics::instance().collect.connect(
+      mem_fun(*this, &AudioDeviceAlsa::writeMetrics));
 } /* AudioDeviceAlsa::AudioDeviceAlsa */
 
 
@@ -251,7 +388,11 @@ bool AudioDeviceAlsa::isFullDuplexCapable(void)
 void AudioDeviceAlsa::audioToWriteAvailable(void)
 {
   //printf("AudioDeviceAlsa::audioToWriteAvailable\n");
-  if (play_watch)
+  if (playback_src != 0)
+  {
+    playback_src->fill();
+  }
+  else if (play_watch)
   {
     play_watch->setEnabled(true);
   }
@@ -260,7 +401,11 @@ void AudioDeviceAlsa::audioToWriteAvailable(void)
 
 void AudioDeviceAlsa::flushSamples(void)
 {
-  if (play_watch)
+  if (playback_src != 0)
+  {
+    playback_src->fill();
+  }
+  else if (play_watch)
   {
     play_watch->setEnabled(true);
   }  
@@ -282,7 +427,12 @@ int AudioDeviceAlsa::samplesToWrite(void) const
   int samples_to_write = (play_block_count * play_block_size) - space_avail;
   if (samples_to_write < 0)
   {
-    return 0;
+    samples_to_write = 0;
+  }
+  if (playback_src != 0)
+  {
+    samples_to_write += play_fifo->samplesInFifo(true) / channels +
+                        playback_src->pendingFrames();
   }
   return samples_to_write;
 
@@ -312,7 +462,8 @@ bool AudioDeviceAlsa::openDevice(Mode mode)
       return false;
     }
 
-    if (!initParams(play_handle))
+    play_mmap = use_mmap;
+    if (!initParams(play_handle, play_mmap))
     {
       closeDevice();
       return false;
@@ -324,10 +475,20 @@ bool AudioDeviceAlsa::openDevice(Mode mode)
       return false;
     }
 
-    play_watch = new AlsaWatch(play_handle);
-    play_watch->activity.connect(
-            mem_fun(*this, &AudioDeviceAlsa::writeSpaceAvailable));
-    play_watch->setEnabled(true);
+    if (rt_prio < 0)
+    {
+      play_watch = new AlsaWatch(play_handle);
+      play_watch->activity.connect(
+              mem_fun(*this, &AudioDeviceAlsa::writeSpaceAvailable));
+      play_watch->setEnabled(true);
+    }
+    else
+    {
+      play_fifo = new AudioThreadFifo(
+          play_block_count * play_block_size * channels);
+      playback_src = new PlaybackSource(this);
+      playback_src->registerSink(play_fifo);
+    }
 
     if (!startPlayback(play_handle))
     {
@@ -349,7 +510,8 @@ bool AudioDeviceAlsa::openDevice(Mode mode)
       return false;
     }
 
-    if (!initParams(rec_handle))
+    rec_mmap = use_mmap;
+    if (!initParams(rec_handle, rec_mmap))
     {
       closeDevice();
       return false;
@@ -361,9 +523,23 @@ bool AudioDeviceAlsa::openDevice(Mode mode)
       return false;
     }
 
-    rec_watch = new AlsaWatch(rec_handle);
-    rec_watch->activity.connect(
-            mem_fun(*this, &AudioDeviceAlsa::audioReadHandler));
+    if (rt_prio < 0)
+    {
+      rec_watch = new AlsaWatch(rec_handle);
+      rec_watch->activity.connect(
+              mem_fun(*this, &AudioDeviceAlsa::audioReadHandler));
+    }
+    else
+    {
+        // Buffer up to one second of audio if the main thread is busy. The
+        // size is a whole number of blocks so that audio dropped on overrun
+        // is dropped in whole blocks, keeping the channels apart.
+      int blocks = (sample_rate + rec_block_size - 1) / rec_block_size;
+      rec_fifo = new AudioThreadFifo(blocks * rec_block_size * channels);
+      rec_fifo->setOverwrite(true);
+      capture_sink = new CaptureSink(this);
+      rec_fifo->registerSink(capture_sink);
+    }
 
     if (!startCapture(rec_handle))
     {
@@ -373,6 +549,15 @@ bool AudioDeviceAlsa::openDevice(Mode mode)
     }
   }
 
+  if ((rt_prio >= 0) && !startIoThread())
+  {
+    closeDevice();
+    return false;
+  }
+
+  xrun_timer = new Timer(XRUN_REPORT_INTERVAL, Timer::TYPE_PERIODIC);
+  xrun_timer->expired.connect(mem_fun(*this, &AudioDeviceAlsa::reportXruns));
+
   return true;
 
 } /* AudioDeviceAlsa::openDevice */
@@ -380,6 +565,20 @@ bool AudioDeviceAlsa::openDevice(Mode mode)
 
 void AudioDeviceAlsa::closeDevice(void)
 {
+  stopIoThread();
+
+  delete xrun_timer;
+  xrun_timer = 0;
+
+  delete playback_src;
+  playback_src = 0;
+  delete play_fifo;
+  play_fifo = 0;
+  delete rec_fifo;
+  rec_fifo = 0;
+  delete capture_sink;
+  capture_sink = 0;
+
   if (play_handle != 0)
   {
     snd_pcm_close(play_handle);
@@ -419,6 +618,7 @@ void AudioDeviceAlsa::audioReadHandler(FdWatch *watch, unsigned short revents)
   int frames_avail = snd_pcm_avail_update(rec_handle);
   if (frames_avail < 0)
   {
+    ++rec_xrun_cnt;
     if (!startCapture(rec_handle))
     {
       watch->setEnabled(false);
@@ -433,12 +633,45 @@ void AudioDeviceAlsa::audioReadHandler(FdWatch *watch, unsigned short revents)
     frames_avail /= rec_block_size;
     frames_avail *= rec_block_size;
 
+    if (rec_mmap)
+    {
+        // Convert the samples directly from the ALSA ring buffer
+      while (frames_avail > 0)
+      {
+        int16_t *buf;
+        snd_pcm_uframes_t offset;
+        snd_pcm_sframes_t frames = mmapBegin(rec_handle, &buf, &offset,
+                                             frames_avail);
+        if (frames > 0)
+        {
+          putBlocks(buf, frames);
+          frames = mmapCommit(rec_handle, offset, frames);
+        }
+        if (frames < 0)
+        {
+          ++rec_xrun_cnt;
+          if (!startCapture(rec_handle))
+          {
+            watch->setEnabled(false);
+          }
+          return;
+        }
+        if (frames == 0)
+        {
+          break;
+        }
+        frames_avail -= frames;
+      }
+      return;
+    }
+
     int16_t buf[frames_avail * channels];
     memset(buf, 0, sizeof(buf));
 
     int frames_read = snd_pcm_readi(rec_handle, buf, frames_avail);
     if (frames_read < 0)
     {
+      ++rec_xrun_cnt;
       if (!startCapture(rec_handle))
       {
         watch->setEnabled(false);
@@ -471,6 +704,7 @@ void AudioDeviceAlsa::writeSpaceAvailable(FdWatch *watch, unsigned short revents
       // Bail out if there's an error
     if (space_avail < 0)
     {
+      ++play_xrun_cnt;
       if (!startPlayback(play_handle))
       {
         watch->setEnabled(false);
@@ -487,14 +721,40 @@ void AudioDeviceAlsa::writeSpaceAvailable(FdWatch *watch, unsigned short revents
     }
 
     int16_t buf[space_avail * channels];
-        
-    int blocks_avail = getBlocks(buf, blocks_to_read);
+    int16_t *dest = buf;
+    snd_pcm_uframes_t offset = 0;
+    if (play_mmap)
+    {
+        // Write the samples directly into the ALSA ring buffer if there is
+        // room for at least one block before it wraps
+      int16_t *area;
+      snd_pcm_sframes_t frames = mmapBegin(play_handle, &area, &offset,
+                                           blocks_to_read * play_block_size);
+      if (frames < 0)
+      {
+        ++play_xrun_cnt;
+        if (!startPlayback(play_handle))
+        {
+          watch->setEnabled(false);
+          return;
+        }
+        continue;
+      }
+      if (frames >= play_block_size)
+      {
+        dest = area;
+        blocks_to_read = frames / play_block_size;
+      }
+    }
+
+    int blocks_avail = getBlocks(dest, blocks_to_read);
     if (blocks_avail == 0) 
     {
       if (zerofill_on_underflow)
       {
         blocks_avail = 1;
-        memset(buf, 0, blocks_avail * play_block_size);
+        memset(dest, 0, blocks_avail * play_block_size * channels *
+                        sizeof(*dest));
       }
       else
       {
@@ -504,12 +764,15 @@ void AudioDeviceAlsa::writeSpaceAvailable(FdWatch *watch, unsigned short revents
     }
     
     int frames_to_write = blocks_avail * play_block_size;
-    int frames_written = snd_pcm_writei(play_handle, buf, frames_to_write);
+    int frames_written = (dest != buf)
+        ? mmapCommit(play_handle, offset, frames_to_write)
+        : writeFrames(play_handle, play_mmap, buf, frames_to_write);
     //printf("frames_avail=%d  blocks_avail=%d  blocks_gotten=%d "
     //       "frames_written=%d\n", (int)frames_avail, blocks_avail,
     //       blocks_gotten, (int)frames_written);
     if (frames_written < 0)
     {
+      ++play_xrun_cnt;
       if (!startPlayback(play_handle))
       {
         watch->setEnabled(false);
@@ -535,7 +798,7 @@ void AudioDeviceAlsa::writeSpaceAvailable(FdWatch *watch, unsigned short revents
 }
 
 
-bool AudioDeviceAlsa::initParams(snd_pcm_t *pcm_handle)
+bool AudioDeviceAlsa::initParams(snd_pcm_t *pcm_handle, bool &mmap)
 {
   snd_pcm_hw_params_t *hw_params;
 
@@ -558,8 +821,22 @@ bool AudioDeviceAlsa::initParams(snd_pcm_t *pcm_handle)
     return false;
   }
 
-  err = snd_pcm_hw_params_set_access(pcm_handle, hw_params,
-				     SND_PCM_ACCESS_RW_INTERLEAVED);
+  if (mmap)
+  {
+    err = snd_pcm_hw_params_set_access(pcm_handle, hw_params,
+                                       SND_PCM_ACCESS_MMAP_INTERLEAVED);
+    if (err < 0)
+    {
+      cerr << "*** WARNING: The ALSA device \"" << dev_name << "\" does "
+              "not support mmap access. Using read/write access instead.\n";
+      mmap = false;
+    }
+  }
+  if (!mmap)
+  {
+    err = snd_pcm_hw_params_set_access(pcm_handle, hw_params,
+                                       SND_PCM_ACCESS_RW_INTERLEAVED);
+  }
   if (err < 0)
   {
     cerr << "*** ERROR: Set access type failed: "
@@ -612,7 +889,7 @@ bool AudioDeviceAlsa::initParams(snd_pcm_t *pcm_handle)
     return false;
   }
 
-  snd_pcm_uframes_t period_size = block_size_hint;
+  snd_pcm_uframes_t period_size = blocksizeHint();
   err = snd_pcm_hw_params_set_period_size_near(pcm_handle, hw_params,
 					       &period_size, 0);
   if (err < 0)
@@ -624,7 +901,7 @@ bool AudioDeviceAlsa::initParams(snd_pcm_t *pcm_handle)
     return false;
   }
   
-  snd_pcm_uframes_t buffer_size = block_count_hint * block_size_hint;
+  snd_pcm_uframes_t buffer_size = blockCountHint() * blocksizeHint();
   err = snd_pcm_hw_params_set_buffer_size_near(pcm_handle, hw_params,
 					       &buffer_size);
   if (err < 0)
@@ -791,6 +1068,503 @@ bool AudioDeviceAlsa::startCapture(snd_pcm_t *pcm_handle)
 } /* AudioDeviceAlsa::startCapture */
 
 
+snd_pcm_sframes_t AudioDeviceAlsa::mmapBegin(snd_pcm_t *pcm_handle,
+                                             int16_t **buf,
+                                             snd_pcm_uframes_t *offset,
+                                             snd_pcm_uframes_t frames)
+{
+  const snd_pcm_channel_area_t *areas;
+  int err = snd_pcm_mmap_begin(pcm_handle, &areas, offset, &frames);
+  if (err < 0)
+  {
+    return err;
+  }
+
+    // Interleaved access so all channels share the area of the first one
+  *buf = reinterpret_cast<int16_t *>(
+      static_cast<char *>(areas[0].addr) + areas[0].first / 8) +
+    *offset * channels;
+  return frames;
+} /* AudioDeviceAlsa::mmapBegin */
+
+
+snd_pcm_sframes_t AudioDeviceAlsa::mmapCommit(snd_pcm_t *pcm_handle,
+                                              snd_pcm_uframes_t offset,
+                                              snd_pcm_uframes_t frames)
+{
+  snd_pcm_sframes_t ret = snd_pcm_mmap_commit(pcm_handle, offset, frames);
+  if (ret < 0)
+  {
+    return ret;
+  }
+  if (static_cast<snd_pcm_uframes_t>(ret) != frames)
+  {
+    return -EPIPE;
+  }
+
+    // Unlike snd_pcm_writei, committing audio to the ring buffer does not
+    // start the playback when the start threshold is reached
+  if ((pcm_handle == play_handle) &&
+      (snd_pcm_state(pcm_handle) == SND_PCM_STATE_PREPARED))
+  {
+    snd_pcm_sframes_t space_avail = snd_pcm_avail_update(pcm_handle);
+    if ((space_avail >= 0) &&
+        (space_avail <= play_block_size))
+    {
+      int err = snd_pcm_start(pcm_handle);
+      if (err < 0)
+      {
+        return err;
+      }
+    }
+  }
+
+  return ret;
+} /* AudioDeviceAlsa::mmapCommit */
+
+
+snd_pcm_sframes_t AudioDeviceAlsa::readFrames(snd_pcm_t *pcm_handle,
+                                              bool mmap, int16_t *buf,
+                                              snd_pcm_uframes_t frames)
+{
+  if (!mmap)
+  {
+    return snd_pcm_readi(pcm_handle, buf, frames);
+  }
+
+  snd_pcm_uframes_t frames_read = 0;
+  while (frames_read < frames)
+  {
+    int16_t *area;
+    snd_pcm_uframes_t offset;
+    snd_pcm_sframes_t cnt = mmapBegin(pcm_handle, &area, &offset,
+                                      frames - frames_read);
+    if (cnt <= 0)
+    {
+      return (cnt < 0) ? cnt : frames_read;
+    }
+    memcpy(buf + frames_read * channels, area, cnt * channels * sizeof(*buf));
+    cnt = mmapCommit(pcm_handle, offset, cnt);
+    if (cnt < 0)
+    {
+      return cnt;
+    }
+    frames_read += cnt;
+  }
+  return frames_read;
+} /* AudioDeviceAlsa::readFrames */
+
+
+snd_pcm_sframes_t AudioDeviceAlsa::writeFrames(snd_pcm_t *pcm_handle,
+                                               bool mmap, const int16_t *buf,
+                                               snd_pcm_uframes_t frames)
+{
+  if (!mmap)
+  {
+    return snd_pcm_writei(pcm_handle, buf, frames);
+  }
+
+  snd_pcm_uframes_t frames_written = 0;
+  while (frames_written < frames)
+  {
+    int16_t *area;
+    snd_pcm_uframes_t offset;
+    snd_pcm_sframes_t cnt = mmapBegin(pcm_handle, &area, &offset,
+                                      frames - frames_written);
+    if (cnt <= 0)
+    {
+      return (cnt < 0) ? cnt : frames_written;
+    }
+    memcpy(area, buf + frames_written * channels,
+           cnt * channels * sizeof(*buf));
+    cnt = mmapCommit(pcm_handle, offset, cnt);
+    if (cnt < 0)
+    {
+      return cnt;
+    }
+    frames_written += cnt;
+  }
+  return frames_written;
+} /* AudioDeviceAlsa::writeFrames */
+
+
+bool AudioDeviceAlsa::startIoThread(void)
+{
+  if (pipe(io_wakeup_pipe) != 0)
+  {
+    cerr << "*** ERROR: Could not create the ALSA I/O thread wakeup pipe: "
+         << strerror(errno) << endl;
+    return false;
+  }
+  fcntl(io_wakeup_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(io_wakeup_pipe[1], F_SETFL, O_NONBLOCK);
+
+  io_thread_quit = false;
+  play_idle = false;
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  if (rt_prio > 0)
+  {
+      // Lock all memory to avoid page faults in the realtime thread
+    static bool memory_locked = false;
+    if (!memory_locked && (mlockall(MCL_CURRENT | MCL_FUTURE) != 0))
+    {
+      cerr << "*** WARNING: Could not lock memory for the ALSA I/O thread: "
+           << strerror(errno) << endl;
+    }
+    memory_locked = true;
+
+    sched_param param;
+    param.sched_priority = std::max(sched_get_priority_min(SCHED_FIFO),
+        std::min(rt_prio, sched_get_priority_max(SCHED_FIFO)));
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+  }
+  int err = pthread_create(&io_thread, &attr, ioThreadFunc, this);
+  if ((err == EPERM) && (rt_prio > 0))
+  {
+    cerr << "*** WARNING: Not permitted to run the ALSA I/O thread for "
+         << "device \"" << dev_name << "\" with realtime priority. "
+         << "Using normal scheduling.\n";
+    err = pthread_create(&io_thread, 0, ioThreadFunc, this);
+  }
+  pthread_attr_destroy(&attr);
+  if (err != 0)
+  {
+    cerr << "*** ERROR: Could not start the ALSA I/O thread: "
+         << strerror(err) << endl;
+    ::close(io_wakeup_pipe[0]);
+    ::close(io_wakeup_pipe[1]);
+    io_wakeup_pipe[0] = io_wakeup_pipe[1] = -1;
+    return false;
+  }
+  io_thread_running = true;
+
+  return true;
+} /* AudioDeviceAlsa::startIoThread */
+
+
+void AudioDeviceAlsa::stopIoThread(void)
+{
+  if (io_thread_running)
+  {
+    io_thread_quit = true;
+    char ch = 0;
+    ssize_t ret = write(io_wakeup_pipe[1], &ch, 1);
+    (void)ret;
+    pthread_join(io_thread, 0);
+    io_thread_running = false;
+  }
+
+  if (io_wakeup_pipe[0] >= 0)
+  {
+    ::close(io_wakeup_pipe[0]);
+    ::close(io_wakeup_pipe[1]);
+    io_wakeup_pipe[0] = io_wakeup_pipe[1] = -1;
+  }
+} /* AudioDeviceAlsa::stopIoThread */
+
+
+void AudioDeviceAlsa::wakeupIoThread(void)
+{
+    // The I/O thread only need to be woken up if it has stopped polling
+    // the playback device due to lack of audio
+  if (play_idle.exchange(false))
+  {
+    char ch = 0;
+    ssize_t ret = write(io_wakeup_pipe[1], &ch, 1);
+    (void)ret;
+  }
+} /* AudioDeviceAlsa::wakeupIoThread */
+
+
+void *AudioDeviceAlsa::ioThreadFunc(void *arg)
+{
+  AudioDeviceAlsa *dev = static_cast<AudioDeviceAlsa*>(arg);
+  if (dev->rt_prio <= 0)
+  {
+      // A realtime priority given in ASYNC_AUDIO_ALSA_RT_PRIO take precedence
+      // over the thread role configuration
+    ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_AUDIO_IO);
+  }
+  dev->ioThread();
+  return 0;
+} /* AudioDeviceAlsa::ioThreadFunc */
+
+
+void AudioDeviceAlsa::ioThread(void)
+{
+    // Poll descriptors are ordered: wakeup pipe, capture, playback
+  std::vector<pollfd> pfds(1);
+  pfds[0].fd = io_wakeup_pipe[0];
+  pfds[0].events = POLLIN;
+  size_t play_pfd_idx = 1;
+  if (rec_handle != 0)
+  {
+    int nfds = snd_pcm_poll_descriptors_count(rec_handle);
+    pfds.resize(1 + nfds);
+    snd_pcm_poll_descriptors(rec_handle, &pfds[1], nfds);
+    play_pfd_idx = pfds.size();
+  }
+  if (play_handle != 0)
+  {
+    int nfds = snd_pcm_poll_descriptors_count(play_handle);
+    pfds.resize(play_pfd_idx + nfds);
+    snd_pcm_poll_descriptors(play_handle, &pfds[play_pfd_idx], nfds);
+  }
+
+  std::vector<int16_t> rec_buf(rec_block_count * rec_block_size * channels);
+  std::vector<float> rec_fbuf(rec_buf.size());
+  int rec_buf_frames = 0;
+  std::vector<int16_t> play_buf(play_block_count * play_block_size * channels);
+  std::vector<float> play_fbuf(play_buf.size());
+
+    // A negative playback timeout means that the playback device should be
+    // polled, a positive value that audio is awaited for at most that many
+    // milliseconds and zero that audio is awaited until woken up. The state
+    // is reevaluated on each turn since capture events also end the poll.
+  int play_timeout = (play_handle != 0) ? -1 : 0;
+  while (!io_thread_quit)
+  {
+    size_t nfds = (play_timeout < 0) ? pfds.size() : play_pfd_idx;
+    int ret = poll(&pfds[0], nfds, (play_timeout > 0) ? play_timeout : -1);
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      cerr << "*** ERROR: poll failed in the ALSA I/O thread: "
+           << strerror(errno) << endl;
+      break;
+    }
+
+    if (pfds[0].revents & POLLIN)
+    {
+      char buf[64];
+      while (read(io_wakeup_pipe[0], buf, sizeof(buf)) > 0) {}
+      if (play_handle != 0)
+      {
+        play_timeout = -1;
+      }
+    }
+
+    if ((rec_handle != 0) && (pfds[1].fd >= 0) &&
+        !ioThreadCapture(rec_buf, rec_fbuf, rec_buf_frames))
+    {
+        // Unrecoverable error. Stop polling the capture device.
+      for (size_t i=1; i<play_pfd_idx; ++i)
+      {
+        pfds[i].fd = -1;
+      }
+    }
+
+    if (play_timeout != 0)
+    {
+      play_timeout = ioThreadPlayback(play_buf, play_fbuf);
+    }
+  }
+} /* AudioDeviceAlsa::ioThread */
+
+
+bool AudioDeviceAlsa::ioThreadCapture(std::vector<int16_t> &buf,
+                                      std::vector<float> &fbuf,
+                                      int &buf_frames)
+{
+  snd_pcm_sframes_t frames_avail = snd_pcm_avail_update(rec_handle);
+  if (frames_avail < 0)
+  {
+    ++rec_xrun_cnt;
+    return startCapture(rec_handle);
+  }
+
+  if (frames_avail < rec_block_size)
+  {
+    return true;
+  }
+  frames_avail /= rec_block_size;
+  frames_avail *= rec_block_size;
+  frames_avail = std::min(frames_avail,
+      static_cast<snd_pcm_sframes_t>(buf.size() / channels - buf_frames));
+
+  snd_pcm_sframes_t frames_read = readFrames(rec_handle, rec_mmap,
+                                             &buf[buf_frames * channels],
+                                             frames_avail);
+  if (frames_read < 0)
+  {
+    buf_frames = 0;
+    ++rec_xrun_cnt;
+    return startCapture(rec_handle);
+  }
+  buf_frames += frames_read;
+
+    // Convert and split whole blocks into channels so that the main thread
+    // can hand them directly to the AudioIO objects. A partial block, if the
+    // device returned less than asked for, is kept until the next turn.
+  int block_cnt = buf_frames / rec_block_size;
+  const int block_len = rec_block_size * channels;
+  for (int b=0; b<block_cnt; ++b)
+  {
+    const int16_t *src = &buf[b * block_len];
+    float *dst = &fbuf[b * block_len];
+    for (int ch=0; ch<channels; ++ch)
+    {
+      AudioSampleOps::s16ToFloat(dst + ch * rec_block_size, src + ch,
+                                 rec_block_size, channels);
+    }
+  }
+  if (block_cnt > 0)
+  {
+    rec_fifo->writeSamples(&fbuf[0], block_cnt * block_len);
+  }
+
+  int frames_left = buf_frames - block_cnt * rec_block_size;
+  if (frames_left > 0)
+  {
+    memmove(&buf[0], &buf[block_cnt * block_len],
+            frames_left * channels * sizeof(buf[0]));
+  }
+  buf_frames = frames_left;
+
+  return true;
+} /* AudioDeviceAlsa::ioThreadCapture */
+
+
+int AudioDeviceAlsa::ioThreadPlayback(std::vector<int16_t> &buf,
+                                      std::vector<float> &fbuf)
+{
+  const int buffer_size = play_block_count * play_block_size;
+  for (;;)
+  {
+    snd_pcm_sframes_t space_avail = snd_pcm_avail_update(play_handle);
+    if (space_avail < 0)
+    {
+      ++play_xrun_cnt;
+      if (!startPlayback(play_handle))
+      {
+        return 0;
+      }
+      continue;
+    }
+
+    int blocks_to_write = space_avail / play_block_size;
+    if (blocks_to_write == 0)
+    {
+      return -1;
+    }
+    int frames_to_write = std::min(blocks_to_write * play_block_size,
+                                   buffer_size);
+
+    int frames = play_fifo->readSamples(&fbuf[0], frames_to_write * channels)
+                 / channels;
+    if (frames > 0)
+    {
+      memset(&buf[0], 0, frames * channels * sizeof(buf[0]));
+      AudioSampleOps::mixFloatToS16(&buf[0], &fbuf[0], frames * channels);
+    }
+    else
+    {
+        // No audio available. Wait for the main thread to wake us up. If
+        // zerofill is enabled, only write zeros when the device is about to
+        // run dry so that we do not add latency to audio that is on its way.
+      int frames_queued = buffer_size - space_avail;
+      if (zerofill_on_underflow && (frames_queued <= play_block_size))
+      {
+        frames = play_block_size;
+        memset(&buf[0], 0, frames * channels * sizeof(buf[0]));
+      }
+      else
+      {
+        play_idle = true;
+        if (!play_fifo->empty())
+        {
+          play_idle = false;
+          continue;
+        }
+        if (!zerofill_on_underflow)
+        {
+          return 0;
+        }
+        return std::max(1, static_cast<int>(
+              1000LL * (frames_queued - play_block_size) / sample_rate));
+      }
+    }
+
+    snd_pcm_sframes_t frames_written = writeFrames(play_handle, play_mmap,
+                                                   &buf[0], frames);
+    if (frames_written < 0)
+    {
+      ++play_xrun_cnt;
+      if (!startPlayback(play_handle))
+      {
+        return 0;
+      }
+      continue;
+    }
+
+    if (frames < frames_to_write)
+    {
+      return -1;
+    }
+  }
+} /* AudioDeviceAlsa::ioThreadPlayback */
+
+
+void AudioDeviceAlsa::reportXruns(Timer *t)
+{
+  unsigned long rec_xruns = rec_xrun_cnt;
+  if (rec_xruns != reported_rec_xrun_cnt)
+  {
+    cerr << "*** WARNING: " << (rec_xruns - reported_rec_xrun_cnt)
+         << " capture overrun(s) on ALSA device \"" << dev_name << "\" ("
+         << rec_xruns << " in total)\n";
+    reported_rec_xrun_cnt = rec_xruns;
+  }
+
+  unsigned long play_xruns = play_xrun_cnt;
+  if (play_xruns != reported_play_xrun_cnt)
+  {
+    cerr << "*** WARNING: " << (play_xruns - reported_play_xrun_cnt)
+         << " playback underrun(s) on ALSA device \"" << dev_name << "\" ("
+         << play_xruns << " in total)\n";
+    reported_play_xrun_cnt = play_xruns;
+  }
+
+  if (rec_fifo != 0)
+  {
+    unsigned long rec_overruns = rec_fifo->overrunCount();
+    if (rec_overruns != reported_rec_overrun_cnt)
+    {
+      cerr << "*** WARNING: Captured audio from ALSA device \"" << dev_name
+           << "\" was dropped since the main thread did not keep up ("
+           << rec_overruns << " times in total)\n";
+      reported_rec_overrun_cnt = rec_overruns;
+    }
+  }
+} /* AudioDeviceAlsa::reportXruns */
+
+
+void AudioDeviceAlsa::writeMetrics(MetricsWriter& writer)
+{
+  MetricsWriter::Labels labels(Metrics::labels("device", dev_name));
+  labels["direction"] = "capture";
+  writer.counter("async_audio_xruns", "Number of audio device xruns",
+                 labels, rec_xrun_cnt);
+  labels["direction"] = "playback";
+  writer.counter("async_audio_xruns", "Number of audio device xruns",
+                 labels, play_xrun_cnt);
+  if (rec_fifo != 0)
+  {
+    writer.counter("async_audio_capture_dropped",
+        "Number of times captured audio was dropped since the main thread "
+        "did not keep up", Metrics::labels("device", dev_name),
+        rec_fifo->overrunCount());
+  }
+} /* AudioDeviceAlsa::writeMetrics */
+
+
 /*
  * This file has not been truncated
  */
@@ -37,6 +37,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <alsa/asoundlib.h>
+#include <pthread.h>
+
+#include <atomic>
+#include <vector>
 
 
 /****************************************************************************
@@ -80,6 +84,9 @@ namespace Async
  *
  ****************************************************************************/
 
+class AudioThreadFifo;
+class Timer;
+class MetricsWriter;
 
 
 /****************************************************************************
@@ -113,6 +120,22 @@ This class implements the low level interface to an Alsa audio device. This
 class is not intended to be used by the end user of the Async library. It is
 used by the Async::AudioIO class, which is the Async API frontend for using
 audio in an application.
+
+If the environment variable ASYNC_AUDIO_ALSA_RT_PRIO is set, the PCM devices
+are serviced by a dedicated I/O thread instead of by the main event loop.
+The value is the SCHED_FIFO priority to run the thread with, or 0 to run it
+with normal scheduling. The thread exchanges audio with the main thread
+through lock-free FIFOs so that a busy main loop does not cause ALSA
+overruns or underruns. Each device get its own thread, which also do the
+conversion between the 16 bit device format and float and the splitting of
+captured audio into channels. Sites with many sound cards can thereby make
+use of more than one CPU core.
+
+If the environment variable ASYNC_AUDIO_ALSA_MMAP is set to 1, the PCM
+devices are accessed through the mmap interface. Audio is then converted
+directly from and to the ALSA ring buffer in the main loop, without going
+through an intermediate buffer. If a device does not support mmap access the
+normal read/write access is used.
 */
 class AudioDeviceAlsa : public AudioDevice
 {
@@ -187,6 +210,8 @@ class AudioDeviceAlsa : public AudioDevice
 
   private:
     class       AlsaWatch;
+    class       CaptureSink;
+    class       PlaybackSource;
     int         play_block_size;
     int         play_block_count;
     int         rec_block_size;
@@ -197,16 +222,56 @@ class AudioDeviceAlsa : public AudioDevice
     AlsaWatch   *rec_watch;
     bool        duplex;
     bool        zerofill_on_underflow;
+    bool        use_mmap;
+    bool        play_mmap;
+    bool        rec_mmap;
+    int         rt_prio;
+    bool        io_thread_running;
+    pthread_t   io_thread;
+    int         io_wakeup_pipe[2];
+    std::atomic<bool> io_thread_quit;
+    std::atomic<bool> play_idle;
+    AudioThreadFifo *rec_fifo;
+    AudioThreadFifo *play_fifo;
+    CaptureSink *capture_sink;
+    PlaybackSource *playback_src;
+    Timer       *xrun_timer;
+    std::atomic<unsigned long> rec_xrun_cnt;
+    std::atomic<unsigned long> play_xrun_cnt;
+    unsigned long reported_rec_xrun_cnt;
+    unsigned long reported_play_xrun_cnt;
+    unsigned long reported_rec_overrun_cnt;
 
     AudioDeviceAlsa(const AudioDeviceAlsa&);
     AudioDeviceAlsa& operator=(const AudioDeviceAlsa&);
     void audioReadHandler(FdWatch *watch, unsigned short revents);
     void writeSpaceAvailable(FdWatch *watch, unsigned short revents);
-    bool initParams(snd_pcm_t *pcm_handle);
+    bool initParams(snd_pcm_t *pcm_handle, bool &mmap);
     bool getBlockAttributes(snd_pcm_t *pcm_handle, int &block_size,
                             int &period_size);
     bool startPlayback(snd_pcm_t *pcm_handle);
     bool startCapture(snd_pcm_t *pcm_handle);
+    snd_pcm_sframes_t mmapBegin(snd_pcm_t *pcm_handle, int16_t **buf,
+                                snd_pcm_uframes_t *offset,
+                                snd_pcm_uframes_t frames);
+    snd_pcm_sframes_t mmapCommit(snd_pcm_t *pcm_handle,
+                                 snd_pcm_uframes_t offset,
+                                 snd_pcm_uframes_t frames);
+    snd_pcm_sframes_t readFrames(snd_pcm_t *pcm_handle, bool mmap,
+                                 int16_t *buf, snd_pcm_uframes_t frames);
+    snd_pcm_sframes_t writeFrames(snd_pcm_t *pcm_handle, bool mmap,
+                                  const int16_t *buf,
+                                  snd_pcm_uframes_t frames);
+    bool startIoThread(void);
+    void stopIoThread(void);
+    void wakeupIoThread(void);
+    static void *ioThreadFunc(void *arg);
+    void ioThread(void);
+    bool ioThreadCapture(std::vector<int16_t> &buf, std::vector<float> &fbuf,
+                         int &buf_frames);
+    int ioThreadPlayback(std::vector<int16_t> &buf, std::vector<float> &fbuf);
+    void reportXruns(Timer *t);
+    void writeMetrics(MetricsWriter& writer);
     
 };  /* class AudioDeviceAlsa */
 
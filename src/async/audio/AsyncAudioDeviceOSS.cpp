@@ -284,10 +284,10 @@ bool AudioDeviceOSS::openDevice(Mode mode)
     }
   }
   
-  int size = (block_size_hint <= 0) ? 1 :
-	     block_size_hint * channels * sizeof(int16_t);
+  int size = (blocksizeHint() <= 0) ? 1 :
+	     blocksizeHint() * channels * sizeof(int16_t);
   int frag_size_log2 = static_cast<int>(log2(size));
-  arg  = (block_count_hint << 16) | frag_size_log2;
+  arg  = (blockCountHint() << 16) | frag_size_log2;
   if (ioctl(fd, SNDCTL_DSP_SETFRAGMENT, &arg) == -1)
   {
     perror("SNDCTL_DSP_SETFRAGMENT ioctl failed");
@@ -0,0 +1,568 @@
+/**
+@file   AsyncAudioDeviceShm.cpp
+@brief  Handle streaming of audio samples via shared memory
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+Implements an "audio interface" that stream samples through a shared memory
+ring buffer. This can be used to pass audio between processes on the same
+host, like SvxLink, RemoteTrx and external DSP applications, with low latency.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <climits>
+#include <ctime>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncFdWatch.h>
+#include <AsyncThreadScheduling.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioDeviceShm.h"
+#include "AsyncAudioDeviceFactory.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+/*
+ * The header at the start of the shared memory object. The sample data
+ * follow directly after the header. Positions are counted in frames from
+ * the creation of the ring and are always a multiple of the block size.
+ */
+struct Async::AudioDeviceShm::Ring
+{
+  std::atomic<uint32_t> magic;
+  uint32_t              version;
+  uint32_t              sample_rate;
+  uint32_t              channels;
+  uint32_t              block_frames;
+  uint32_t              capacity_frames;
+  std::atomic<uint32_t> seq;              // Futex word, bumped on each write
+  std::atomic<uint32_t> waiters;
+  std::atomic<uint64_t> write_pos;
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static long futex(std::atomic<uint32_t> *addr, int op, uint32_t val,
+                  const struct timespec *timeout);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+REGISTER_AUDIO_DEVICE_TYPE("shm", AudioDeviceShm);
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+int AudioDeviceShm::readBlocksize(void)
+{
+  return block_size;
+} /* AudioDeviceShm::readBlocksize */
+
+
+int AudioDeviceShm::writeBlocksize(void)
+{
+  return block_size;
+} /* AudioDeviceShm::writeBlocksize */
+
+
+bool AudioDeviceShm::isFullDuplexCapable(void)
+{
+  return false;
+} /* AudioDeviceShm::isFullDuplexCapable */
+
+
+void AudioDeviceShm::audioToWriteAvailable(void)
+{
+  if (!pace_timer->isEnabled())
+  {
+    audioWriteHandler();
+  }
+} /* AudioDeviceShm::audioToWriteAvailable */
+
+
+void AudioDeviceShm::flushSamples(void)
+{
+  if (!pace_timer->isEnabled())
+  {
+    audioWriteHandler();
+  }
+} /* AudioDeviceShm::flushSamples */
+
+
+int AudioDeviceShm::samplesToWrite(void) const
+{
+  return 0;
+} /* AudioDeviceShm::samplesToWrite */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+AudioDeviceShm::AudioDeviceShm(const string& dev_name)
+  : AudioDevice(dev_name), block_size(0), ring(0), ring_size(0),
+    ring_data(0), read_pos(0), pace_timer(0), notifier_rd(-1),
+    notifier_wr(-1), notifier_watch(0), waiter_running(false),
+    waiter_stop(false), notify_pending(false)
+{
+  assert(AudioDeviceShm_creator_registered);
+  int pace_interval = 1000 * blocksizeHint() / sampleRate();
+  block_size = pace_interval * sampleRate() / 1000;
+
+  pace_timer = new Timer(pace_interval, Timer::TYPE_PERIODIC);
+  pace_timer->setEnable(false);
+  pace_timer->expired.connect(
+      sigc::hide(mem_fun(*this, &AudioDeviceShm::audioWriteHandler)));
+} /* AudioDeviceShm::AudioDeviceShm */
+
+
+AudioDeviceShm::~AudioDeviceShm(void)
+{
+  closeDevice();
+  delete pace_timer;
+} /* AudioDeviceShm::~AudioDeviceShm */
+
+
+bool AudioDeviceShm::openDevice(Mode mode)
+{
+  if (ring != 0)
+  {
+    closeDevice();
+  }
+
+  switch (mode)
+  {
+    case MODE_RDWR:
+      cerr << "*** ERROR: The shared memory audio device (" << devName()
+           << ") cannot be opened for both reading and writing. Use a "
+              "separate ring for each direction.\n";
+      return false;
+
+    case MODE_RD:
+    case MODE_WR:
+      break;
+
+    case MODE_NONE:
+      return true;
+  }
+
+  if (!mapRing())
+  {
+    return false;
+  }
+
+  block_size = ring->block_frames;
+  if (mode == MODE_WR)
+  {
+    pace_timer->setTimeout(1000 * block_size / sampleRate());
+  }
+  else
+  {
+      // Start reading at the current write position, that is, only new audio
+      // will be received
+    read_pos = ring->write_pos.load(std::memory_order_acquire);
+    if (!startWaiter())
+    {
+      closeDevice();
+      return false;
+    }
+  }
+
+  return true;
+
+} /* AudioDeviceShm::openDevice */
+
+
+void AudioDeviceShm::closeDevice(void)
+{
+  pace_timer->setEnable(false);
+  stopWaiter();
+  if (ring != 0)
+  {
+    munmap(ring, ring_size);
+    ring = 0;
+    ring_size = 0;
+    ring_data = 0;
+  }
+} /* AudioDeviceShm::closeDevice */
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+bool AudioDeviceShm::mapRing(void)
+{
+  string shm_name("/" + devName());
+  const uint32_t capacity_frames = RING_BLOCKS * block_size;
+  ring_size = sizeof(Ring) + sizeof(int16_t) * channels * capacity_frames;
+
+    // The first process to open the ring create and initialize it. The magic
+    // is written last so that other processes know when the ring is ready.
+  bool created = true;
+  int fd = shm_open(shm_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0666);
+  if ((fd < 0) && (errno == EEXIST))
+  {
+    created = false;
+    fd = shm_open(shm_name.c_str(), O_RDWR, 0);
+  }
+  if (fd < 0)
+  {
+    cerr << "*** ERROR: Could not open shared memory audio device ("
+         << devName() << "): " << strerror(errno) << endl;
+    return false;
+  }
+
+  if (created)
+  {
+    if (ftruncate(fd, ring_size) != 0)
+    {
+      cerr << "*** ERROR: Could not set size of shared memory audio device ("
+           << devName() << "): " << strerror(errno) << endl;
+      ::close(fd);
+      shm_unlink(shm_name.c_str());
+      return false;
+    }
+  }
+  else
+  {
+      // Wait a short while for the creating process to set the size
+    struct stat st;
+    for (int i=0; i<100; ++i)
+    {
+      if ((fstat(fd, &st) == 0) && (st.st_size >= (off_t)sizeof(Ring)))
+      {
+        break;
+      }
+      usleep(1000);
+    }
+    if ((fstat(fd, &st) != 0) || (st.st_size < (off_t)sizeof(Ring)))
+    {
+      cerr << "*** ERROR: The shared memory audio device (" << devName()
+           << ") has not been initialized\n";
+      ::close(fd);
+      return false;
+    }
+    ring_size = st.st_size;
+  }
+
+  void *mem = mmap(0, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (mem == MAP_FAILED)
+  {
+    cerr << "*** ERROR: Could not map shared memory audio device ("
+         << devName() << "): " << strerror(errno) << endl;
+    return false;
+  }
+  ring = static_cast<Ring *>(mem);
+  ring_data = reinterpret_cast<int16_t *>(ring + 1);
+
+  if (created)
+  {
+    ring->version = RING_VERSION;
+    ring->sample_rate = sampleRate();
+    ring->channels = channels;
+    ring->block_frames = block_size;
+    ring->capacity_frames = capacity_frames;
+    ring->seq = 0;
+    ring->waiters = 0;
+    ring->write_pos = 0;
+    ring->magic.store(RING_MAGIC, std::memory_order_release);
+  }
+  else
+  {
+    for (int i=0; i<100; ++i)
+    {
+      if (ring->magic.load(std::memory_order_acquire) == RING_MAGIC)
+      {
+        break;
+      }
+      usleep(1000);
+    }
+    const char *errmsg = 0;
+    if (ring->magic.load(std::memory_order_acquire) != RING_MAGIC)
+    {
+      errmsg = "has not been initialized";
+    }
+    else if (ring->version != RING_VERSION)
+    {
+      errmsg = "has an unsupported version";
+    }
+    else if ((ring->sample_rate != (uint32_t)sampleRate()) ||
+             (ring->channels != (uint32_t)channels))
+    {
+      errmsg = "use another sample rate or channel count";
+    }
+    else if (ring_size < sizeof(Ring) +
+             sizeof(int16_t) * ring->channels * ring->capacity_frames)
+    {
+      errmsg = "is truncated";
+    }
+    if (errmsg != 0)
+    {
+      cerr << "*** ERROR: The shared memory audio device (" << devName()
+           << ") " << errmsg << endl;
+      munmap(ring, ring_size);
+      ring = 0;
+      ring_data = 0;
+      return false;
+    }
+  }
+
+  return true;
+
+} /* AudioDeviceShm::mapRing */
+
+
+bool AudioDeviceShm::startWaiter(void)
+{
+  int fd[2];
+  if (pipe(fd) != 0)
+  {
+    cerr << "*** ERROR: Could not create pipe: " << strerror(errno) << endl;
+    return false;
+  }
+  notifier_rd = fd[0];
+  notifier_wr = fd[1];
+  fcntl(notifier_rd, F_SETFL, fcntl(notifier_rd, F_GETFL) | O_NONBLOCK);
+  fcntl(notifier_wr, F_SETFL, fcntl(notifier_wr, F_GETFL) | O_NONBLOCK);
+  notifier_watch = new FdWatch(notifier_rd, FdWatch::FD_WATCH_RD);
+  notifier_watch->activity.connect(
+      mem_fun(*this, &AudioDeviceShm::notificationReceived));
+
+  waiter_stop = false;
+  notify_pending = false;
+  int err = pthread_create(&waiter_thread, NULL, waiterThread, this);
+  if (err != 0)
+  {
+    cerr << "*** ERROR: Could not create shared memory audio waiter thread: "
+         << strerror(err) << endl;
+    return false;
+  }
+  waiter_running = true;
+  return true;
+} /* AudioDeviceShm::startWaiter */
+
+
+void AudioDeviceShm::stopWaiter(void)
+{
+  if (waiter_running)
+  {
+      // The wakeup is sent to all waiters on the ring. Readers in other
+      // processes will just see a spurious wakeup.
+    waiter_stop = true;
+    ring->seq.fetch_add(1, std::memory_order_release);
+    futex(&ring->seq, FUTEX_WAKE, INT_MAX, 0);
+    pthread_join(waiter_thread, NULL);
+    waiter_running = false;
+  }
+  delete notifier_watch;
+  notifier_watch = 0;
+  if (notifier_rd != -1)
+  {
+    ::close(notifier_rd);
+    notifier_rd = -1;
+  }
+  if (notifier_wr != -1)
+  {
+    ::close(notifier_wr);
+    notifier_wr = -1;
+  }
+} /* AudioDeviceShm::stopWaiter */
+
+
+void *AudioDeviceShm::waiterThread(void *data)
+{
+  ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_AUDIO_IO);
+  AudioDeviceShm *dev = static_cast<AudioDeviceShm *>(data);
+  Ring *ring = dev->ring;
+  uint32_t seq = ring->seq.load(std::memory_order_acquire);
+  while (!dev->waiter_stop)
+  {
+      // The timeout is only a safety net in case a wakeup is lost, e.g. if
+      // the writer die while updating the waiter count
+    struct timespec timeout = { 0, 100000000 };
+    ring->waiters.fetch_add(1);
+    futex(&ring->seq, FUTEX_WAIT, seq, &timeout);
+    ring->waiters.fetch_sub(1);
+    uint32_t new_seq = ring->seq.load(std::memory_order_acquire);
+    if ((new_seq != seq) && !dev->notify_pending.exchange(true))
+    {
+      char c = 0;
+      if (write(dev->notifier_wr, &c, 1) != 1)
+      {
+        dev->notify_pending = false;
+      }
+    }
+    seq = new_seq;
+  }
+  return NULL;
+} /* AudioDeviceShm::waiterThread */
+
+
+void AudioDeviceShm::notificationReceived(FdWatch *w)
+{
+  char buf[64];
+  while (read(w->fd(), buf, sizeof(buf)) > 0)
+  {
+  }
+  notify_pending = false;
+  audioReadHandler();
+} /* AudioDeviceShm::notificationReceived */
+
+
+void AudioDeviceShm::audioReadHandler(void)
+{
+  assert(ring != 0);
+  const uint64_t capacity = ring->capacity_frames;
+  uint64_t write_pos = ring->write_pos.load(std::memory_order_acquire);
+  if (write_pos - read_pos > capacity - block_size)
+  {
+      // We have fallen too far behind and the writer may already be
+      // overwriting the oldest blocks. Skip ahead to half a ring behind.
+    read_pos = write_pos - (capacity / block_size / 2) * block_size;
+  }
+  while (read_pos < write_pos)
+  {
+      // The blocks in the ring are handed directly to the device layer
+    int16_t *block = ring_data + (read_pos % capacity) * channels;
+    putBlocks(block, block_size);
+    read_pos += block_size;
+  }
+} /* AudioDeviceShm::audioReadHandler */
+
+
+void AudioDeviceShm::audioWriteHandler(void)
+{
+  assert(ring != 0);
+  assert(mode() == MODE_WR);
+
+    // Write the block directly into the ring. The readers see the block
+    // when the write position is updated.
+  uint64_t write_pos = ring->write_pos.load(std::memory_order_relaxed);
+  int16_t *block = ring_data + (write_pos % ring->capacity_frames) * channels;
+  if (getBlocks(block, 1) == 0)
+  {
+    pace_timer->setEnable(false);
+    return;
+  }
+  ring->write_pos.store(write_pos + block_size, std::memory_order_release);
+  ring->seq.fetch_add(1);
+  if (ring->waiters.load() > 0)
+  {
+    futex(&ring->seq, FUTEX_WAKE, INT_MAX, 0);
+  }
+
+  pace_timer->setEnable(true);
+
+} /* AudioDeviceShm::audioWriteHandler */
+
+
+static long futex(std::atomic<uint32_t> *addr, int op, uint32_t val,
+                  const struct timespec *timeout)
+{
+  return syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), op, val,
+                 timeout, NULL, 0);
+} /* futex */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,248 @@
+/**
+@file   AsyncAudioDeviceShm.h
+@brief  Handle streaming of audio samples via shared memory
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+Implements an "audio interface" that stream samples through a shared memory
+ring buffer. This can be used to pass audio between processes on the same
+host, like SvxLink, RemoteTrx and external DSP applications, with low latency.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_DEVICE_SHM_INCLUDED
+#define ASYNC_AUDIO_DEVICE_SHM_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include <string>
+#include <atomic>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncTimer.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioDevice.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class FdWatch;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	An audio device that stream samples through shared memory
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This audio device type pass audio between processes on the same host using a
+ring buffer in POSIX shared memory. The device is specified as "shm:name"
+where name is the name of the shared memory object. The ring is created by
+the first process that open it.
+
+A ring carry audio in one direction. One process may open it for writing and
+any number of processes may open it for reading, each reader keeping its own
+read position. The writer never wait for the readers. A reader that fall more
+than a ring length behind will skip ahead and loose audio.
+
+Readers are woken up using a futex in the shared memory. A helper thread in
+each reading process wait on the futex and notify the main thread through a
+pipe so that the audio is handled in the normal event loop.
+*/
+class AudioDeviceShm : public Async::AudioDevice
+{
+  public:
+    /**
+     * @brief 	Constuctor
+     * @param 	dev_name  The name of the device to associate this object with
+     */
+    explicit AudioDeviceShm(const std::string& dev_name);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~AudioDeviceShm(void);
+
+    /**
+     * @brief 	Find out what the read (recording) blocksize is set to
+     * @return	Returns the currently set blocksize in samples per channel
+     */
+    virtual int readBlocksize(void);
+
+    /**
+     * @brief 	Find out what the write (playback) blocksize is set to
+     * @return	Returns the currently set blocksize in samples per channel
+     */
+    virtual int writeBlocksize(void);
+
+    /**
+     * @brief 	Check if the audio device has full duplex capability
+     * @return	Returns \em true if the device has full duplex capability
+     *	      	or else \em false
+     *
+     * A shared memory ring only carry audio in one direction so a separate
+     * device have to be used for each direction.
+     */
+    virtual bool isFullDuplexCapable(void);
+
+    /**
+     * @brief 	Tell the audio device handler that there are audio to be
+     *	      	written in the buffer
+     */
+    virtual void audioToWriteAvailable(void);
+
+    /**
+     * @brief	Tell the audio device to flush its buffers
+     */
+    virtual void flushSamples(void);
+
+    /**
+     * @brief 	Find out how many samples there are in the output buffer
+     * @return	Returns the number of samples in the output buffer on
+     *          success or -1 on failure.
+     *
+     * Samples are available to the readers as soon as they have been written
+     * to the ring so this function always return 0.
+     */
+    virtual int samplesToWrite(void) const;
+
+
+  protected:
+    /**
+     * @brief 	Open the audio device
+     * @param 	mode The mode to open the audio device in (See AudioIO::Mode)
+     * @return	Returns \em true on success or else \em false
+     */
+    virtual bool openDevice(Mode mode);
+
+    /**
+     * @brief 	Close the audio device
+     */
+    virtual void closeDevice(void);
+
+
+  private:
+    struct Ring;
+
+    static const uint32_t RING_MAGIC    = 0x53564152; // "SVAR"
+    static const uint32_t RING_VERSION  = 1;
+    static const unsigned RING_BLOCKS   = 64;
+
+    int                   block_size;
+    Ring *                ring;
+    size_t                ring_size;
+    int16_t *             ring_data;
+    uint64_t              read_pos;
+    Async::Timer *        pace_timer;
+    int                   notifier_rd;
+    int                   notifier_wr;
+    Async::FdWatch *      notifier_watch;
+    pthread_t             waiter_thread;
+    bool                  waiter_running;
+    std::atomic<bool>     waiter_stop;
+    std::atomic<bool>     notify_pending;
+
+    AudioDeviceShm(const AudioDeviceShm&);
+    AudioDeviceShm& operator=(const AudioDeviceShm&);
+    bool mapRing(void);
+    bool startWaiter(void);
+    void stopWaiter(void);
+    static void *waiterThread(void *data);
+    void notificationReceived(Async::FdWatch *w);
+    void audioReadHandler(void);
+    void audioWriteHandler(void);
+
+};  /* class AudioDeviceShm */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_DEVICE_SHM_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -193,7 +193,7 @@ AudioDeviceUDP::AudioDeviceUDP(const string& dev_name)
     read_buf_pos(0), port(0)
 {
   assert(AudioDeviceUDP_creator_registered);
-  int pace_interval = 1000 * block_size_hint / sampleRate();
+  int pace_interval = 1000 * blocksizeHint() / sampleRate();
   block_size = pace_interval * sampleRate() / 1000;
 
   read_buf = new int16_t[block_size * channels];
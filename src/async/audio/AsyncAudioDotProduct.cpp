@@ -0,0 +1,326 @@
+/**
+@file   AsyncAudioDotProduct.cpp
+@brief  Vectorized dot product kernels for the audio filters
+@author Tobias Blomberg / SM0SVX
+@date   2020-05-17
+
+This file contains the implementation of the AudioDotProduct class which
+select the best dot product kernel for the running CPU.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ASYNC_DOTPROD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ASYNC_DOTPROD_NEON
+#include <arm_neon.h>
+#endif
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioDotProduct.h"
+#include "AsyncAudioCpuFeatures.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static float dot_scalar(const float *a, const float *b, int len);
+#ifdef ASYNC_DOTPROD_X86
+static float dot_sse(const float *a, const float *b, int len)
+  __attribute__((target("sse")));
+static float dot_avx(const float *a, const float *b, int len)
+  __attribute__((target("avx")));
+#endif
+#ifdef ASYNC_DOTPROD_NEON
+static float dot_neon(const float *a, const float *b, int len);
+#endif
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+AudioDotProduct::Kernel AudioDotProduct::kernel =
+    AudioDotProduct::selectKernel;
+const char *AudioDotProduct::kernel_name = 0;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+const char *AudioDotProduct::kernelName(void)
+{
+  if (kernel_name == 0)
+  {
+    init();
+  }
+  return kernel_name;
+} /* AudioDotProduct::kernelName */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+float AudioDotProduct::selectKernel(const float *a, const float *b, int len)
+{
+  init();
+  return kernel(a, b, len);
+} /* AudioDotProduct::selectKernel */
+
+
+void AudioDotProduct::init(void)
+{
+  AudioCpuFeatures::addDispatcher(init);
+
+  const char *force = getenv("ASYNC_AUDIO_DOTPROD");
+  if (force == 0)
+  {
+    force = "";
+  }
+
+#ifdef ASYNC_DOTPROD_X86
+  bool has_avx = AudioCpuFeatures::has(AudioCpuFeatures::AVX);
+  bool has_sse = AudioCpuFeatures::has(AudioCpuFeatures::SSE);
+  if (has_avx && ((*force == 0) || (strcmp(force, "avx") == 0)))
+  {
+    kernel_name = "avx";
+    kernel = dot_avx;
+    return;
+  }
+  if (has_sse && (strcmp(force, "scalar") != 0))
+  {
+    kernel_name = "sse";
+    kernel = dot_sse;
+    return;
+  }
+#endif
+
+#ifdef ASYNC_DOTPROD_NEON
+  if (AudioCpuFeatures::has(AudioCpuFeatures::NEON) &&
+      (strcmp(force, "scalar") != 0))
+  {
+    kernel_name = "neon";
+    kernel = dot_neon;
+    return;
+  }
+#endif
+
+  kernel_name = "scalar";
+  kernel = dot_scalar;
+} /* AudioDotProduct::init */
+
+
+
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+static float dot_scalar(const float *a, const float *b, int len)
+{
+    // Four partial sums are used to break the dependency chain so that the
+    // compiler is free to keep more multiplications in flight
+  float sum0 = 0.0f, sum1 = 0.0f, sum2 = 0.0f, sum3 = 0.0f;
+  int i = 0;
+  for (; i + 4 <= len; i += 4)
+  {
+    sum0 += a[i] * b[i];
+    sum1 += a[i+1] * b[i+1];
+    sum2 += a[i+2] * b[i+2];
+    sum3 += a[i+3] * b[i+3];
+  }
+  for (; i < len; ++i)
+  {
+    sum0 += a[i] * b[i];
+  }
+  return (sum0 + sum1) + (sum2 + sum3);
+} /* dot_scalar */
+
+
+#ifdef ASYNC_DOTPROD_X86
+static float dot_sse(const float *a, const float *b, int len)
+{
+  __m128 acc0 = _mm_setzero_ps();
+  __m128 acc1 = _mm_setzero_ps();
+  int i = 0;
+  for (; i + 8 <= len; i += 8)
+  {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+    acc1 = _mm_add_ps(acc1,
+                      _mm_mul_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4)));
+  }
+  for (; i + 4 <= len; i += 4)
+  {
+    acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+  }
+  float part[4];
+  _mm_storeu_ps(part, _mm_add_ps(acc0, acc1));
+  float sum = (part[0] + part[1]) + (part[2] + part[3]);
+  for (; i < len; ++i)
+  {
+    sum += a[i] * b[i];
+  }
+  return sum;
+} /* dot_sse */
+
+
+static float dot_avx(const float *a, const float *b, int len)
+{
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int i = 0;
+  for (; i + 16 <= len; i += 16)
+  {
+    acc0 = _mm256_add_ps(acc0,
+        _mm256_mul_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)));
+    acc1 = _mm256_add_ps(acc1,
+        _mm256_mul_ps(_mm256_loadu_ps(a+i+8), _mm256_loadu_ps(b+i+8)));
+  }
+  for (; i + 8 <= len; i += 8)
+  {
+    acc0 = _mm256_add_ps(acc0,
+        _mm256_mul_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)));
+  }
+  acc0 = _mm256_add_ps(acc0, acc1);
+  __m128 acc = _mm_add_ps(_mm256_castps256_ps128(acc0),
+                          _mm256_extractf128_ps(acc0, 1));
+  float part[4];
+  _mm_storeu_ps(part, acc);
+  float sum = (part[0] + part[1]) + (part[2] + part[3]);
+  for (; i < len; ++i)
+  {
+    sum += a[i] * b[i];
+  }
+  return sum;
+} /* dot_avx */
+#endif /* ASYNC_DOTPROD_X86 */
+
+
+#ifdef ASYNC_DOTPROD_NEON
+static float dot_neon(const float *a, const float *b, int len)
+{
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  int i = 0;
+  for (; i + 8 <= len; i += 8)
+  {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a+i), vld1q_f32(b+i));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(a+i+4), vld1q_f32(b+i+4));
+  }
+  for (; i + 4 <= len; i += 4)
+  {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a+i), vld1q_f32(b+i));
+  }
+  float part[4];
+  vst1q_f32(part, vaddq_f32(acc0, acc1));
+  float sum = (part[0] + part[1]) + (part[2] + part[3]);
+  for (; i < len; ++i)
+  {
+    sum += a[i] * b[i];
+  }
+  return sum;
+} /* dot_neon */
+#endif /* ASYNC_DOTPROD_NEON */
+
+
+/*
+ * This file has not been truncated
+ */
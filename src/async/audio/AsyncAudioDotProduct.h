@@ -0,0 +1,168 @@
+/**
+@file   AsyncAudioDotProduct.h
+@brief  Vectorized dot product kernels for the audio filters
+@author Tobias Blomberg / SM0SVX
+@date   2020-05-17
+
+This file contains a small helper class that calculate the dot product of two
+float vectors using the best SIMD instruction set that is available on the
+running CPU. It is used by the FIR filters in the audio decimator and
+interpolator.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_DOT_PRODUCT_INCLUDED
+#define ASYNC_AUDIO_DOT_PRODUCT_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Calculate dot products using the best available SIMD kernel
+@author Tobias Blomberg / SM0SVX
+@date   2020-05-17
+
+This class select a dot product kernel at runtime depending on what the CPU
+support. On x86 the SSE or AVX instruction sets are used and on ARM NEON is
+used if the code was compiled with NEON support. A plain C++ implementation is
+used as a fallback.
+
+The kernel may be forced by setting the environment variable
+ASYNC_AUDIO_DOTPROD to one of "scalar", "sse", "avx" or "neon". If the given
+kernel is not available, the default selection is used. Only the features
+enabled in AudioCpuFeatures are used.
+
+Since the summation order differ between the kernels, the results may differ
+slightly in the least significant bits.
+*/
+class AudioDotProduct
+{
+  public:
+    /**
+     * @brief   Calculate the dot product of two vectors
+     * @param   a   The first vector
+     * @param   b   The second vector
+     * @param   len The number of elements in each vector
+     * @return  Returns the sum of a[i]*b[i] for all i
+     */
+    static float calc(const float *a, const float *b, int len)
+    {
+      return kernel(a, b, len);
+    }
+
+    /**
+     * @brief   Get the name of the selected kernel
+     * @return  Returns the name of the kernel, e.g. "avx"
+     */
+    static const char *kernelName(void);
+
+  private:
+    typedef float (*Kernel)(const float *a, const float *b, int len);
+
+    static Kernel      kernel;
+    static const char *kernel_name;
+
+    static float selectKernel(const float *a, const float *b, int len);
+    static void init(void);
+
+    AudioDotProduct(void);
+};  /* class AudioDotProduct */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_DOT_PRODUCT_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <cassert>
 
 
 /****************************************************************************
@@ -181,6 +182,20 @@ AudioEncoder *AudioEncoder::create(const std::string &name)
  *
  ****************************************************************************/
 
+void AudioEncoder::sendEncodedPacket(size_t size)
+{
+  assert(m_packet.m_offset + size <= m_packet.m_buf.size());
+  m_packet.m_size = size;
+  if (!writeEncodedPacket.empty())
+  {
+    writeEncodedPacket(m_packet);
+  }
+  if (!writeEncodedSamples.empty())
+  {
+    writeEncodedSamples(m_packet.data(), size);
+  }
+} /* AudioEncoder::sendEncodedPacket */
+
 
 
 /****************************************************************************
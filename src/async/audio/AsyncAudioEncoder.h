@@ -35,7 +35,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <sigc++/sigc++.h>
+#include <cassert>
+#include <cstddef>
 #include <string>
+#include <vector>
 
 
 /****************************************************************************
@@ -109,10 +112,83 @@ namespace Async
 @date   2008-10-06
 
 This is the base class for implementing an audio encoder.
+
+The encoded frames are emitted through two signals. The writeEncodedSamples
+signal pass a pointer to the encoded bytes which the receiver have to copy if
+it want to keep them. The writeEncodedPacket signal instead pass a reference
+to a packet object owned by the encoder. The encoder write the frame directly
+into the packet buffer, leaving room in front of it for protocol headers, so
+a network consumer can add its headers and send the whole packet without
+copying the audio data. Use setPacketHeadroom to reserve that room. The packet
+buffer is reused for each frame so when the signal handler return the
+content is no longer valid.
 */
 class AudioEncoder : public AudioSink, public sigc::trackable
 {
   public:
+    /**
+     * @brief   An encoded frame with room for protocol headers
+     *
+     * The payload, that is the encoded audio frame, is placed at an offset
+     * into the buffer. Headers are added in front of the payload using the
+     * prepend function, innermost header first.
+     */
+    class Packet
+    {
+      public:
+        Packet(void) : m_offset(0), m_begin(0), m_size(0) {}
+
+        /**
+         * @brief   Get a pointer to the payload
+         * @return  Returns a pointer to the encoded frame
+         */
+        char *data(void) { return &m_buf[m_offset]; }
+
+        /**
+         * @brief   Get the size of the payload
+         * @return  Returns the size of the encoded frame in bytes
+         */
+        size_t size(void) const { return m_size; }
+
+        /**
+         * @brief   Make room for a header in front of the packet
+         * @param   len The size of the header
+         * @return  Returns a pointer to where the header should be written
+         *
+         * The total size of all prepended headers must not be larger than
+         * the headroom set by AudioEncoder::setPacketHeadroom.
+         */
+        char *prepend(size_t len)
+        {
+          assert(len <= m_begin);
+          m_begin -= len;
+          return &m_buf[m_begin];
+        }
+
+        /**
+         * @brief   Get a pointer to the start of the packet
+         * @return  Returns a pointer to the first prepended header
+         */
+        char *begin(void) { return &m_buf[m_begin]; }
+
+        /**
+         * @brief   Get the size of the packet including prepended headers
+         * @return  Returns the total size of the packet in bytes
+         */
+        size_t totalSize(void) const
+        {
+          return m_offset - m_begin + m_size;
+        }
+
+      private:
+        std::vector<char> m_buf;
+        size_t            m_offset;
+        size_t            m_begin;
+        size_t            m_size;
+
+        friend class AudioEncoder;
+    };
+
     /**
      * @brief   Check if a specific encoder is available
      * @param   name The name of the encoder to look for
@@ -167,6 +243,18 @@ class AudioEncoder : public AudioSink, public sigc::trackable
      * This function is normally only called from a connected source object.
      */
     virtual void flushSamples(void) { flushEncodedSamples(); }
+
+    /**
+     * @brief   Set the room to reserve for headers in front of each packet
+     * @param   headroom The number of bytes to reserve
+     *
+     * This function should be called before any samples are written to the
+     * encoder. The payload offset is rounded up to a multiple of eight bytes.
+     */
+    void setPacketHeadroom(size_t headroom)
+    {
+      m_packet.m_offset = (headroom + 7) & ~static_cast<size_t>(7);
+    }
     
     /**
      * @brief 	A signal emitted when encoded samples are available
@@ -174,6 +262,16 @@ class AudioEncoder : public AudioSink, public sigc::trackable
      * @param 	size The size of the buffer
      */
     sigc::signal<void,const void *,int> writeEncodedSamples;
+
+    /**
+     * @brief   A signal emitted when an encoded packet is available
+     * @param   packet The packet containing the encoded frame
+     *
+     * The packet is owned by the encoder and is only valid until the signal
+     * handler return. The handler may prepend headers to the packet. This
+     * signal is emitted before the writeEncodedSamples signal.
+     */
+    sigc::signal<void,Packet&> writeEncodedPacket;
     
     /**
      * @brief This signal is emitted when the source calls flushSamples
@@ -182,8 +280,33 @@ class AudioEncoder : public AudioSink, public sigc::trackable
     
   
   protected:
-    
+    /**
+     * @brief   Get a buffer to encode the next frame into
+     * @param   max_size The maximum size of the encoded frame
+     * @return  Returns a pointer to the payload area of the packet buffer
+     *
+     * The buffer is valid until the next call to this function.
+     */
+    char *packetBuffer(size_t max_size)
+    {
+      if (m_packet.m_buf.size() < m_packet.m_offset + max_size)
+      {
+        m_packet.m_buf.resize(m_packet.m_offset + max_size);
+      }
+      m_packet.m_begin = m_packet.m_offset;
+      m_packet.m_size = 0;
+      return m_packet.data();
+    }
+
+    /**
+     * @brief   Emit the frame written into the packet buffer
+     * @param   size The size of the encoded frame
+     */
+    void sendEncodedPacket(size_t size);
+
   private:
+    Packet  m_packet;
+
     AudioEncoder(const AudioEncoder&);
     AudioEncoder& operator=(const AudioEncoder&);
     
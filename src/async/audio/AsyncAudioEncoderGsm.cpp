@@ -33,6 +33,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <stdint.h>
+#include <cstring>
 
 
 /****************************************************************************
@@ -50,6 +51,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncAudioEncoderGsm.h"
+#include "AsyncAudioSampleOps.h"
+#ifdef ASYNC_AUDIO_PROFILING
+#include "AsyncAudioPerfCounters.h"
+#endif
 
 
 
@@ -127,33 +132,36 @@ AudioEncoderGsm::~AudioEncoderGsm(void)
 
 int AudioEncoderGsm::writeSamples(const float *samples, int count)
 {
-  for (int i=0; i<count; ++i)
+  int pos = 0;
+  while (pos < count)
   {
-    float sample = samples[i];
-    if (sample > 1.0)
-    {
-      gsm_buf[gsm_buf_len++] = 32767;
-    }
-    else if (sample < -1.0)
-    {
-      gsm_buf[gsm_buf_len++] = -32767;
-    }
-    else
-    {
-      gsm_buf[gsm_buf_len++] = static_cast<gsm_signal>(sample * 32767.0);
-    }
-    
+    int len = GSM_BUF_SIZE - gsm_buf_len;
+    len = (len < count - pos) ? len : count - pos;
+    memset(gsm_buf + gsm_buf_len, 0, len * sizeof(*gsm_buf));
+    AudioSampleOps::mixFloatToS16(gsm_buf + gsm_buf_len, samples + pos, len);
+    gsm_buf_len += len;
+    pos += len;
+
     if (gsm_buf_len == GSM_BUF_SIZE)
     {
       gsm_buf_len = 0;
 
-      gsm_frame frame[FRAME_COUNT];
-      for (int frameno=0; frameno<FRAME_COUNT; ++frameno)
+      gsm_frame *frame = reinterpret_cast<gsm_frame*>(
+          packetBuffer(FRAME_COUNT * sizeof(gsm_frame)));
       {
-        gsm_encode(gsmh, gsm_buf + frameno * FRAME_SAMPLE_CNT, frame[frameno]);
+#ifdef ASYNC_AUDIO_PROFILING
+        static AudioPerfCounters::Stage *perf_stage =
+            AudioPerfCounters::stage("gsm encode");
+        AudioPerfCounters::Probe probe(perf_stage, GSM_BUF_SIZE);
+#endif
+        for (int frameno=0; frameno<FRAME_COUNT; ++frameno)
+        {
+          gsm_encode(gsmh, gsm_buf + frameno * FRAME_SAMPLE_CNT,
+                     frame[frameno]);
+        }
       }
       
-      writeEncodedSamples(frame, FRAME_COUNT * sizeof(gsm_frame));
+      sendEncodedPacket(FRAME_COUNT * sizeof(gsm_frame));
     }
   }
   
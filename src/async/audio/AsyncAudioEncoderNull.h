@@ -153,10 +153,10 @@ class AudioEncoderNull : public AudioEncoder
       {
         return -1;
       }
-      uint8_t buf[2];
+      uint8_t *buf = reinterpret_cast<uint8_t*>(packetBuffer(2));
       buf[0] = static_cast<uint8_t>(count & 0xff);
       buf[1] = static_cast<uint8_t>(count >> 8);
-      writeEncodedSamples(buf, sizeof(buf));
+      sendEncodedPacket(2);
       return count;
     }
     
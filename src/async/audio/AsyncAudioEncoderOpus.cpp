@@ -35,7 +35,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iostream>
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -44,6 +46,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncTimer.h>
 
 
 /****************************************************************************
@@ -52,7 +55,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include "AsyncAudioSampleRate.h"
 #include "AsyncAudioEncoderOpus.h"
+#ifdef ASYNC_AUDIO_PROFILING
+#include "AsyncAudioPerfCounters.h"
+#endif
 
 
 
@@ -115,7 +122,11 @@ using namespace Async;
  ****************************************************************************/
 
 AudioEncoderOpus::AudioEncoderOpus(void)
-  : enc(0), frame_size(0), sample_buf(0), buf_len(0)
+  : enc(0), frame_size(0), sample_buf(0), buf_len(0), adapt_timer(0),
+    adapt_poll_cnt(0), adapt_up_cnt(0), adapt_min(0), adapt_max(10),
+    adapt_max_load(20), adapt_enc_time(0.0), adapt_enc_frames(0),
+    adapt_load(0.0f), adapt_lag(0), adapt_max_lag(0), rp(0),
+    frames_per_packet(1), frame_cnt(0), pkt_buf_len(0)
 {
   int error;
   enc = opus_encoder_create(INTERNAL_SAMPLE_RATE, 1, OPUS_APPLICATION_AUDIO,
@@ -142,7 +153,12 @@ AudioEncoderOpus::AudioEncoderOpus(void)
 
 AudioEncoderOpus::~AudioEncoderOpus(void)
 {
+  delete adapt_timer;
   delete [] sample_buf;
+  if (rp != 0)
+  {
+    opus_repacketizer_destroy(rp);
+  }
   opus_encoder_destroy(enc);
 } /* AsyncAudioEncoderOpus::~AsyncAudioEncoderOpus */
 
@@ -150,13 +166,11 @@ AudioEncoderOpus::~AudioEncoderOpus(void)
 void AudioEncoderOpus::setOption(const std::string &name,
       	      	    	      	 const std::string &value)
 {
-#if 0
   if (name == "FRAMES_PER_PACKET")
   {
     setFramesPerPacket(atoi(value.c_str()));
   }
-#endif
-  if (name == "FRAME_SIZE")
+  else if (name == "FRAME_SIZE")
   {
     stringstream ss(value);
     float frame_size;
@@ -167,7 +181,34 @@ void AudioEncoderOpus::setOption(const std::string &name,
   }
   else if (name == "COMPLEXITY")
   {
-    setComplexity(atoi(value.c_str()));
+    if (value == "AUTO")
+    {
+      enableAdaptiveComplexity(true);
+    }
+    else
+    {
+      enableAdaptiveComplexity(false);
+      setComplexity(atoi(value.c_str()));
+    }
+  }
+  else if (name == "COMPLEXITY_RANGE")
+  {
+    istringstream ss(value);
+    opus_int32 min_comp, max_comp;
+    char sep;
+    if ((ss >> min_comp >> sep >> max_comp) && (sep == '-'))
+    {
+      setComplexityRange(min_comp, max_comp);
+    }
+    else
+    {
+      cerr << "*** WARNING AudioEncoderOpus: Illegal COMPLEXITY_RANGE \""
+           << value << "\". Ignoring it.\n";
+    }
+  }
+  else if (name == "COMPLEXITY_MAX_LOAD")
+  {
+    setComplexityMaxLoad(atoi(value.c_str()));
   }
   else if (name == "BITRATE")
   {
@@ -181,6 +222,35 @@ void AudioEncoderOpus::setOption(const std::string &name,
   {
     enableConstrainedVbr(atoi(value.c_str()) != 0);
   }
+  else if (name == "FEC")
+  {
+    enableInbandFec(atoi(value.c_str()) != 0);
+  }
+  else if (name == "PACKET_LOSS")
+  {
+    setExpectedPacketLoss(atoi(value.c_str()));
+  }
+  else if (name == "DTX")
+  {
+    enableDtx(atoi(value.c_str()) != 0);
+  }
+  else if ((name == "MAX_BANDWIDTH") || (name == "BANDWIDTH"))
+  {
+    opus_int32 bw = bandwidthFromStr(value);
+    if (bw == -1)
+    {
+      cerr << "*** WARNING AudioEncoderOpus: Unknown bandwidth \""
+           << value << "\". Ignoring it.\n";
+    }
+    else if (name == "MAX_BANDWIDTH")
+    {
+      setMaxBandwidth(bw);
+    }
+    else
+    {
+      setBandwidth(bw);
+    }
+  }
   else
   {
     cerr << "*** WARNING AudioEncoderOpus: Unknown option \""
@@ -193,7 +263,14 @@ void AudioEncoderOpus::printCodecParams(void)
 {
   cout << "------ Opus encoder parameters ------\n";
   cout << "Frame size           = " << frameSize() << endl;
-  cout << "Complexity           = " << complexity() << endl;
+  cout << "Frames per packet    = " << framesPerPacket() << endl;
+  cout << "Complexity           = " << complexity();
+  if (adaptiveComplexityEnabled())
+  {
+    cout << " (AUTO " << adapt_min << "-" << adapt_max << ", max load "
+         << adapt_max_load << "%)";
+  }
+  cout << endl;
   cout << "Bitrate              = " << bitrate() << endl;
   cout << "VBR                  = "
        << (vbrEnabled() ? "YES" : "NO") << endl;
@@ -222,6 +299,8 @@ float AudioEncoderOpus::setFrameSize(float new_frame_size_ms)
     static_cast<int>(new_frame_size_ms * INTERNAL_SAMPLE_RATE / 1000);
   delete [] sample_buf;
   sample_buf = new float[frame_size];
+  buf_len = 0;
+  setFramesPerPacket(frames_per_packet);
   return new_frame_size_ms;
 } /* AudioEncoderOpus::setFrameSize */
 
@@ -238,6 +317,49 @@ opus_int32 AudioEncoderOpus::setComplexity(opus_int32 new_comp)
 } /* AudioEncoderOpus::setBitrate */
 
 
+void AudioEncoderOpus::enableAdaptiveComplexity(bool enable)
+{
+  if (enable == adaptiveComplexityEnabled())
+  {
+    return;
+  }
+
+  if (enable)
+  {
+    adapt_timer = new Timer(ADAPT_POLL_INTERVAL, Timer::TYPE_PERIODIC);
+    adapt_timer->expired.connect(mem_fun(*this, &AudioEncoderOpus::adaptPoll));
+    clock_gettime(CLOCK_MONOTONIC, &adapt_last_poll);
+    adapt_poll_cnt = 0;
+    adapt_up_cnt = 0;
+    adapt_enc_time = 0.0;
+    adapt_enc_frames = 0;
+    adapt_max_lag = 0;
+    setComplexity(adapt_max);
+  }
+  else
+  {
+    delete adapt_timer;
+    adapt_timer = 0;
+  }
+} /* AudioEncoderOpus::enableAdaptiveComplexity */
+
+
+void AudioEncoderOpus::setComplexityRange(opus_int32 min_comp,
+                                          opus_int32 max_comp)
+{
+  adapt_min = max(0, min(min_comp, 10));
+  adapt_max = max(adapt_min, min(max_comp, 10));
+  if (adaptiveComplexityEnabled())
+  {
+    opus_int32 comp = complexity();
+    if ((comp < adapt_min) || (comp > adapt_max))
+    {
+      setComplexity(max(adapt_min, min(comp, adapt_max)));
+    }
+  }
+} /* AudioEncoderOpus::setComplexityRange */
+
+
 opus_int32 AudioEncoderOpus::complexity(void)
 {
   opus_int32 comp;
@@ -558,6 +680,7 @@ opus_int32 AudioEncoderOpus::lsbDepth(void)
 
 void AudioEncoderOpus::reset(void)
 {
+  frame_cnt = 0;
   int err = opus_encoder_ctl(enc, OPUS_RESET_STATE);
   if (err != OPUS_OK)
   {
@@ -567,12 +690,21 @@ void AudioEncoderOpus::reset(void)
 } /* AudioEncoderOpus::reset */
 
 
-#if 0
-void AudioEncoderOpus::setFramesPerPacket(unsigned fpp)
+unsigned AudioEncoderOpus::setFramesPerPacket(unsigned fpp)
 {
-  frames_per_packet = fpp;
+  sendPacket();
+
+    // An Opus packet may hold at most 120ms of audio
+  const unsigned max_fpp =
+    max(1, 120 * static_cast<int>(INTERNAL_SAMPLE_RATE) / 1000 / frame_size);
+  frames_per_packet = min(max(fpp, 1U), max_fpp);
+  if ((frames_per_packet > 1) && (rp == 0))
+  {
+    rp = opus_repacketizer_create();
+  }
+  pkt_buf.resize(frames_per_packet * MAX_PACKET_BYTES);
+  return frames_per_packet;
 } /* AudioEncoderOpus::setFramesPerPacket */
-#endif
 
 
 const char *AudioEncoderOpus::bandwidthStr(opus_int32 bw)
@@ -597,6 +729,25 @@ const char *AudioEncoderOpus::bandwidthStr(opus_int32 bw)
 } /* AudioEncoderOpus::bandwidthStr */
 
 
+opus_int32 AudioEncoderOpus::bandwidthFromStr(const std::string &name)
+{
+  static const opus_int32 bws[] =
+  {
+    OPUS_AUTO, OPUS_BANDWIDTH_NARROWBAND, OPUS_BANDWIDTH_MEDIUMBAND,
+    OPUS_BANDWIDTH_WIDEBAND, OPUS_BANDWIDTH_SUPERWIDEBAND,
+    OPUS_BANDWIDTH_FULLBAND
+  };
+  for (size_t i=0; i<sizeof(bws)/sizeof(*bws); ++i)
+  {
+    if (name == bandwidthStr(bws[i]))
+    {
+      return bws[i];
+    }
+  }
+  return -1;
+} /* AudioEncoderOpus::bandwidthFromStr */
+
+
 const char *AudioEncoderOpus::signalTypeStr(opus_int32 type)
 {
   switch (type)
@@ -638,13 +789,48 @@ int AudioEncoderOpus::writeSamples(const float *samples, int count)
     if (buf_len == frame_size)
     {
       buf_len = 0;
-      unsigned char output_buf[4000];
-      opus_int32 nbytes = opus_encode_float(enc, sample_buf, frame_size,
-                                            output_buf, sizeof(output_buf));
+        // A single frame packet is encoded directly into the packet buffer
+      unsigned char frame_buf[MAX_PACKET_BYTES];
+      unsigned char *output_buf = frame_buf;
+      if (frames_per_packet <= 1)
+      {
+        output_buf = reinterpret_cast<unsigned char*>(
+            packetBuffer(MAX_PACKET_BYTES));
+      }
+      struct timespec start;
+      if (adapt_timer != 0)
+      {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+      }
+      opus_int32 nbytes;
+      {
+#ifdef ASYNC_AUDIO_PROFILING
+        static AudioPerfCounters::Stage *perf_stage =
+            AudioPerfCounters::stage("opus encode");
+        AudioPerfCounters::Probe probe(perf_stage, frame_size);
+#endif
+        nbytes = opus_encode_float(enc, sample_buf, frame_size, output_buf,
+                                   MAX_PACKET_BYTES);
+      }
+      if (adapt_timer != 0)
+      {
+        struct timespec stop;
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+        adapt_enc_time += (stop.tv_sec - start.tv_sec) +
+                          (stop.tv_nsec - start.tv_nsec) / 1.0e9;
+        adapt_enc_frames += 1;
+      }
       //cout << "### frame_size=" << frame_size << " nbytes=" << nbytes << endl;
-      if (nbytes > 0)
+        // With DTX enabled, a packet of two bytes or less does not need to
+        // be transmitted
+      if ((nbytes > 2) || ((nbytes > 0) && !dtxEnabled()))
       {
-        writeEncodedSamples(output_buf, nbytes);
+        addFrame(output_buf, nbytes);
+      }
+      else if (nbytes > 0)
+      {
+          // Do not hold back bundled speech frames during a DTX pause
+        sendPacket();
       }
       else if (nbytes < 0)
       {
@@ -659,6 +845,13 @@ int AudioEncoderOpus::writeSamples(const float *samples, int count)
 } /* AudioEncoderOpus::writeSamples */
 
 
+void AudioEncoderOpus::flushSamples(void)
+{
+  sendPacket();
+  AudioEncoder::flushSamples();
+} /* AudioEncoderOpus::flushSamples */
+
+
 
 
 /****************************************************************************
@@ -675,6 +868,147 @@ int AudioEncoderOpus::writeSamples(const float *samples, int count)
  *
  ****************************************************************************/
 
+void AudioEncoderOpus::addFrame(const unsigned char *frame, int len)
+{
+  if (frames_per_packet <= 1)
+  {
+      // The frame has been encoded into the packet buffer
+    sendEncodedPacket(len);
+    return;
+  }
+
+    // The repacketizer keep pointers to the frames so they are copied to a
+    // buffer that is kept until the packet has been sent
+  for (;;)
+  {
+    if (frame_cnt == 0)
+    {
+      opus_repacketizer_init(rp);
+      pkt_buf_len = 0;
+    }
+    unsigned char *dst = &pkt_buf[pkt_buf_len];
+    memcpy(dst, frame, len);
+    if (opus_repacketizer_cat(rp, dst, len) == OPUS_OK)
+    {
+      pkt_buf_len += len;
+      frame_cnt += 1;
+      break;
+    }
+    if (frame_cnt == 0)
+    {
+      cerr << "*** ERROR: Could not add frame to Opus packet\n";
+      return;
+    }
+      // The frame has another configuration, e.g. audio bandwidth, than the
+      // frames already in the packet. Start a new packet with it.
+    sendPacket();
+  }
+
+  if (frame_cnt >= frames_per_packet)
+  {
+    sendPacket();
+  }
+} /* AudioEncoderOpus::addFrame */
+
+
+void AudioEncoderOpus::sendPacket(void)
+{
+  if (frame_cnt == 0)
+  {
+    return;
+  }
+  frame_cnt = 0;
+    // The packet header may need two length bytes for each of the at most
+    // 48 frames in a packet and two more for the frame count and padding
+  const size_t max_size = pkt_buf_len + 2 * 48 + 3;
+  unsigned char *packet =
+      reinterpret_cast<unsigned char*>(packetBuffer(max_size));
+  opus_int32 nbytes = opus_repacketizer_out(rp, packet, max_size);
+  if (nbytes > 0)
+  {
+    sendEncodedPacket(nbytes);
+  }
+  else
+  {
+    cerr << "*** ERROR: Opus repacketizer error: " << opus_strerror(nbytes)
+         << endl;
+  }
+} /* AudioEncoderOpus::sendPacket */
+
+
+void AudioEncoderOpus::adaptPoll(Timer *t)
+{
+    // The main loop lag is how much later than expected the timer expired
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long elapsed = (now.tv_sec - adapt_last_poll.tv_sec) * 1000 +
+                 (now.tv_nsec - adapt_last_poll.tv_nsec) / 1000000;
+  adapt_last_poll = now;
+  if (elapsed > static_cast<long>(ADAPT_POLL_INTERVAL))
+  {
+    adapt_max_lag = max(adapt_max_lag,
+        static_cast<unsigned>(elapsed - ADAPT_POLL_INTERVAL));
+  }
+
+  if (++adapt_poll_cnt >= ADAPT_POLL_CNT)
+  {
+    adaptComplexity();
+    adapt_poll_cnt = 0;
+    adapt_enc_time = 0.0;
+    adapt_enc_frames = 0;
+    adapt_max_lag = 0;
+  }
+} /* AudioEncoderOpus::adaptPoll */
+
+
+void AudioEncoderOpus::adaptComplexity(void)
+{
+    // Nothing to base a decision on if no audio has been encoded
+  if (adapt_enc_frames == 0)
+  {
+    adapt_up_cnt = 0;
+    return;
+  }
+
+  double audio_time =
+    static_cast<double>(adapt_enc_frames) * frame_size / INTERNAL_SAMPLE_RATE;
+  adapt_load = 100.0 * adapt_enc_time / audio_time;
+  adapt_lag = adapt_max_lag;
+
+  opus_int32 comp = complexity();
+  opus_int32 new_comp = comp;
+  if ((adapt_load > adapt_max_load) || (adapt_lag > ADAPT_LAG_HIGH))
+  {
+    adapt_up_cnt = 0;
+    if (comp > adapt_min)
+    {
+      new_comp = comp - 1;
+    }
+  }
+  else if ((adapt_load < adapt_max_load / 2.0f) &&
+           (adapt_lag < ADAPT_LAG_LOW))
+  {
+    if ((comp < adapt_max) && (++adapt_up_cnt >= ADAPT_UP_CNT))
+    {
+      adapt_up_cnt = 0;
+      new_comp = comp + 1;
+    }
+  }
+  else
+  {
+    adapt_up_cnt = 0;
+  }
+
+  if (new_comp != comp)
+  {
+    new_comp = setComplexity(new_comp);
+    cout << "AudioEncoderOpus: Complexity changed from " << comp << " to "
+         << new_comp << " (encoder load " << adapt_load
+         << "%, main loop lag " << adapt_lag << "ms)" << endl;
+    complexityChanged(new_comp);
+  }
+} /* AudioEncoderOpus::adaptComplexity */
+
 
 
 /*
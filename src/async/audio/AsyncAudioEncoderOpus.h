@@ -35,6 +35,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <opus.h>
+#include <time.h>
+#include <vector>
 
 
 /****************************************************************************
@@ -72,6 +74,15 @@ namespace Async
 {
 
 
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class Timer;
+
+
 /****************************************************************************
  *
  * Forward declarations of classes inside of the declared namespace
@@ -108,6 +119,14 @@ namespace Async
 @date   2013-10-12
 
 This class implements an audio encoder that use the Opus audio codec.
+
+The encoder complexity can be adjusted automatically to the available CPU
+capacity. When adaptive complexity is enabled, the time used to encode each
+frame and the main loop lag are measured. If the encoder use more than the
+configured share of real time, or if the main loop is lagging, the
+complexity is lowered one step. When there is plenty of headroom during a
+couple of measurement periods the complexity is raised one step again. The
+complexity is kept within the configured range.
 */
 class AudioEncoderOpus : public AudioEncoder
 {
@@ -173,6 +192,59 @@ class AudioEncoderOpus : public AudioEncoder
      * @returns Returns the current complexity
      */
     opus_int32 complexity(void);
+
+    /**
+     * @brief   Enable or disable adaptive complexity
+     * @param   enable Set to \em true to enable adaptive complexity
+     *
+     * When enabled, the complexity will be adjusted within the range set by
+     * setComplexityRange depending on the measured encoder load and main
+     * loop lag. The complexity is set to the maximum value when enabling.
+     */
+    void enableAdaptiveComplexity(bool enable);
+
+    /**
+     * @brief   Check if adaptive complexity is enabled
+     * @returns Returns \em true if adaptive complexity is enabled
+     */
+    bool adaptiveComplexityEnabled(void) const { return adapt_timer != 0; }
+
+    /**
+     * @brief   Set the range for adaptive complexity
+     * @param   min_comp The lowest complexity to use (0-10)
+     * @param   max_comp The highest complexity to use (0-10)
+     */
+    void setComplexityRange(opus_int32 min_comp, opus_int32 max_comp);
+
+    /**
+     * @brief   Set the maximum encoder load for adaptive complexity
+     * @param   percent The share of real time the encoder may use (1-100)
+     */
+    void setComplexityMaxLoad(unsigned percent) { adapt_max_load = percent; }
+
+    /**
+     * @brief   Get the measured encoder load
+     * @returns Returns the share of real time, in percent, used for encoding
+     *          during the last measurement period
+     *
+     * This value is only measured when adaptive complexity is enabled.
+     */
+    float encoderLoad(void) const { return adapt_load; }
+
+    /**
+     * @brief   Get the measured main loop lag
+     * @returns Returns the highest main loop lag, in milliseconds, seen
+     *          during the last measurement period
+     *
+     * This value is only measured when adaptive complexity is enabled.
+     */
+    unsigned mainLoopLag(void) const { return adapt_lag; }
+
+    /**
+     * @brief   A signal emitted when adaptive complexity change the setting
+     * @param   comp The new complexity
+     */
+    sigc::signal<void, opus_int32> complexityChanged;
     
     /**
      * @brief   Set the bitrate to use
@@ -367,13 +439,25 @@ class AudioEncoderOpus : public AudioEncoder
      */
     void reset(void);
 
-#if 0
     /**
      * @brief 	Set the number of frames that are sent in each packet
      * @param 	fpp Frames per packet
+     * @returns Returns the new number of frames per packet
+     *
+     * Bundling several frames in each packet reduce the packet rate, and
+     * with it the per packet overhead, at the cost of added latency. The
+     * frames are joined into one Opus packet so any Opus decoder can decode
+     * it. A packet cannot hold more than 120 milliseconds of audio so the
+     * number of frames is limited accordingly. The default is one frame per
+     * packet.
+     */
+    unsigned setFramesPerPacket(unsigned fpp);
+
+    /**
+     * @brief   Get the number of frames that are sent in each packet
+     * @returns Returns the number of frames per packet
      */
-    void setFramesPerPacket(unsigned fpp);
-#endif 
+    unsigned framesPerPacket(void) const { return frames_per_packet; }
     
     /**
      * @brief   Translate a bandwidth id to a string
@@ -382,6 +466,13 @@ class AudioEncoderOpus : public AudioEncoder
      */
     static const char *bandwidthStr(opus_int32 bw);
 
+    /**
+     * @brief   Translate a bandwidth name to a bandwidth id
+     * @param   name The bandwidth name (e.g. NARROWBAND or AUTO)
+     * @returns Returns the bandwidth id or -1 if the name is unknown
+     */
+    static opus_int32 bandwidthFromStr(const std::string &name);
+
     /**
      * @brief   Translate a signal type id to a string
      * @param   bw The signal type id
@@ -410,19 +501,51 @@ class AudioEncoderOpus : public AudioEncoder
      */
     virtual int writeSamples(const float *samples, int count);
     
+    /**
+     * @brief 	Tell the sink to flush the previously written samples
+     *
+     * Frames waiting to be bundled are sent before the flush is passed on.
+     */
+    virtual void flushSamples(void);
     
   protected:
     
   private:
+    static const int      MAX_PACKET_BYTES    = 4000;
+    static const unsigned ADAPT_POLL_INTERVAL = 100;
+    static const unsigned ADAPT_POLL_CNT      = 10;
+    static const unsigned ADAPT_UP_CNT        = 3;
+    static const unsigned ADAPT_LAG_HIGH      = 20;
+    static const unsigned ADAPT_LAG_LOW       = 5;
+
     OpusEncoder *enc;
     int       frame_size;
     float     *sample_buf;
     int       buf_len;
-    //int       frames_per_packet;
-    //int       frame_cnt;
+    Timer *         adapt_timer;
+    struct timespec adapt_last_poll;
+    unsigned        adapt_poll_cnt;
+    unsigned        adapt_up_cnt;
+    opus_int32      adapt_min;
+    opus_int32      adapt_max;
+    unsigned        adapt_max_load;
+    double          adapt_enc_time;
+    unsigned        adapt_enc_frames;
+    float           adapt_load;
+    unsigned        adapt_lag;
+    unsigned        adapt_max_lag;
+    OpusRepacketizer *rp;
+    unsigned        frames_per_packet;
+    unsigned        frame_cnt;
+    std::vector<unsigned char> pkt_buf;
+    size_t          pkt_buf_len;
     
     AudioEncoderOpus(const AudioEncoderOpus&);
     AudioEncoderOpus& operator=(const AudioEncoderOpus&);
+    void adaptPoll(Timer *t);
+    void adaptComplexity(void);
+    void addFrame(const unsigned char *frame, int len);
+    void sendPacket(void);
     
 };  /* class AudioEncoderOpus */
 
@@ -34,6 +34,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <cstring>
 
 
 /****************************************************************************
@@ -141,7 +142,17 @@ class AudioEncoderRaw : public AudioEncoder
      */
     virtual int writeSamples(const float *samples, int count)
     {
-      writeEncodedSamples(samples, sizeof(*samples) * count);
+      const size_t size = sizeof(*samples) * count;
+      if (writeEncodedPacket.empty())
+      {
+          // No copy is needed when there is no packet consumer
+        writeEncodedSamples(samples, size);
+      }
+      else
+      {
+        std::memcpy(packetBuffer(size), samples, size);
+        sendEncodedPacket(size);
+      }
       return count;
     }
     
@@ -33,6 +33,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <stdint.h>
+#include <cstring>
 
 
 /****************************************************************************
@@ -50,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncAudioEncoderS16.h"
+#include "AsyncAudioSampleOps.h"
 
 
 
@@ -127,26 +129,12 @@ AudioEncoderS16::~AudioEncoderS16(void)
 
 int AudioEncoderS16::writeSamples(const float *samples, int count)
 {
-  int16_t s16_samples[count];
+  const size_t size = count * sizeof(int16_t);
+  int16_t *s16_samples = reinterpret_cast<int16_t*>(packetBuffer(size));
+  memset(s16_samples, 0, size);
+  AudioSampleOps::mixFloatToS16(s16_samples, samples, count);
   
-  for (int i=0; i<count; ++i)
-  {
-    float sample = samples[i];
-    if (sample > 1.0)
-    {
-      s16_samples[i] = 32767;
-    }
-    else if (sample < -1.0)
-    {
-      s16_samples[i] = -32767;
-    }
-    else
-    {
-      s16_samples[i] = static_cast<int16_t>(sample * 32767.0);
-    }
-  }
-  
-  writeEncodedSamples(s16_samples, count * sizeof(*s16_samples));
+  sendEncodedPacket(size);
   
   return count;
   
@@ -51,7 +51,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include "AsyncAudioSampleRate.h"
 #include "AsyncAudioEncoderSpeex.h"
+#ifdef ASYNC_AUDIO_PROFILING
+#include "AsyncAudioPerfCounters.h"
+#endif
 
 
 
@@ -117,11 +121,8 @@ AudioEncoderSpeex::AudioEncoderSpeex(void)
   : buf_len(0), frames_per_packet(4), frame_cnt(0)
 {
   speex_bits_init(&bits);
-#if INTERNAL_SAMPLE_RATE == 16000
-  enc_state = speex_encoder_init(&speex_wb_mode);
-#else
-  enc_state = speex_encoder_init(&speex_nb_mode);
-#endif
+  enc_state = speex_encoder_init(
+      (INTERNAL_SAMPLE_RATE == 16000) ? &speex_wb_mode : &speex_nb_mode);
   speex_encoder_ctl(enc_state, SPEEX_GET_FRAME_SIZE, &frame_size);
   sample_buf = new float[frame_size];
   
@@ -330,7 +331,14 @@ int AudioEncoderSpeex::writeSamples(const float *samples, int count)
     
     if (buf_len == frame_size)
     {
-      speex_encode(enc_state, sample_buf, &bits);
+      {
+#ifdef ASYNC_AUDIO_PROFILING
+        static AudioPerfCounters::Stage *perf_stage =
+            AudioPerfCounters::stage("speex encode");
+        AudioPerfCounters::Probe probe(perf_stage, frame_size);
+#endif
+        speex_encode(enc_state, sample_buf, &bits);
+      }
       buf_len = 0;
       
       if (++frame_cnt == frames_per_packet)
@@ -338,11 +346,11 @@ int AudioEncoderSpeex::writeSamples(const float *samples, int count)
         frame_cnt = 0;
       	speex_bits_insert_terminator(&bits);
         int nbytes = speex_bits_nbytes(&bits);
-        char output_buf[nbytes];
+        char *output_buf = packetBuffer(nbytes);
         nbytes = speex_bits_write(&bits, output_buf, nbytes);
         speex_bits_reset(&bits);
         //cout << "writing " << nbytes << " bytes\n";
-        writeEncodedSamples(output_buf, nbytes);
+        sendEncodedPacket(nbytes);
       }
     }
   }
@@ -38,6 +38,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cstring>
 #include <algorithm>
 #include <cassert>
+#include <climits>
 
 
 /****************************************************************************
@@ -55,6 +56,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncAudioFifo.h"
+#include "AsyncAudioLatencyTrace.h"
+#include "AsyncAudioLatencyBudget.h"
+#include "AsyncAudioSampleRate.h"
 
 
 
@@ -109,6 +113,10 @@ using namespace Async;
 
 static const unsigned  MAX_WRITE_SIZE = 800;
 
+  // The adaptive prebuffer is grown quickly on an underrun and shrunk slowly
+static const unsigned  PREBUF_GROW_MS = 20;
+static const unsigned  PREBUF_SHRINK_MS = 5;
+
 
 /****************************************************************************
  *
@@ -121,7 +129,10 @@ AudioFifo::AudioFifo(unsigned fifo_size)
   : fifo_size(fifo_size), head(0), tail(0),
     do_overwrite(false), output_stopped(false), prebuf_samples(0),
     prebuf(false), is_flushing(false), is_full(false), buffering_enabled(true),
-    disable_buffering_when_flushed(false), is_idle(true), input_stopped(false)
+    disable_buffering_when_flushed(false), is_idle(true), input_stopped(false),
+    in_cnt(0), out_cnt(0), sink_buffer_used(false), adapt_min_samples(0),
+    adapt_max_samples(0), in_stream(false), sink_limited(false),
+    stream_underrun(false), stream_low_water(UINT_MAX), stream_high_water(0)
 {
   assert(fifo_size > 0);
   fifo = new float[fifo_size];
@@ -130,6 +141,7 @@ AudioFifo::AudioFifo(unsigned fifo_size)
 
 AudioFifo::~AudioFifo(void)
 {
+  AudioLatencyBudget::remove(this);
   delete [] fifo;
 } /* ~AudioFifo */
 
@@ -171,8 +183,12 @@ void AudioFifo::clear(void)
   
   is_full = false;
   tail = head = 0;
+  out_cnt = in_cnt;
+  latency_marks.clear();
   prebuf = (prebuf_samples > 0);
   output_stopped = false;
+  in_stream = false;
+  sink_limited = false;
   
   if (is_flushing && !was_empty)
   {
@@ -191,6 +207,22 @@ void AudioFifo::setPrebufSamples(unsigned prebuf_samples)
 } /* AudioFifo::setPrebufSamples */
 
 
+void AudioFifo::setAdaptivePrebuf(unsigned min_samples, unsigned max_samples)
+{
+  adapt_max_samples = min(max_samples, fifo_size-1);
+  adapt_min_samples = min(min_samples, adapt_max_samples);
+  if (prebufIsAdaptive())
+  {
+    unsigned samples = max(prebuf_samples, adapt_min_samples);
+    samples = min(samples, adapt_max_samples);
+    if (samples != prebuf_samples)
+    {
+      setPrebufSamples(samples);
+    }
+  }
+} /* AudioFifo::setAdaptivePrebuf */
+
+
 void AudioFifo::enableBuffering(bool enable)
 {
   if (enable)
@@ -231,6 +263,8 @@ int AudioFifo::writeSamples(const float *samples, int count)
   
   assert(count > 0);
   
+  trackInput();
+
   is_idle = false;
   is_flushing = false;
   
@@ -244,6 +278,10 @@ int AudioFifo::writeSamples(const float *samples, int count)
   if (empty() && !prebuf)
   {
     samples_written = sinkWriteSamples(samples, count);
+    if (samples_written < count)
+    {
+      sink_limited = true;
+    }
     /*
     printf("AudioFifo::writeSamples: count=%d "
       	   "samples_written=%d\n", count, samples_written);
@@ -252,8 +290,17 @@ int AudioFifo::writeSamples(const float *samples, int count)
   
   if (buffering_enabled)
   {
+      // A latency trace mark belong to the first sample of the block so it
+      // is only stored if that sample is buffered
+    if ((samples_written == 0) && (AudioLatencyTrace::current() != 0) &&
+        (latency_marks.size() < MAX_LATENCY_MARKS))
+    {
+      latency_marks.push_back(
+          std::make_pair(in_cnt, AudioLatencyTrace::current()));
+    }
     while (!is_full && (samples_written < count))
     {
+      int buffered_start = samples_written;
       while (!is_full && (samples_written < count))
       {
 	fifo[head] = samples[samples_written++];
@@ -263,6 +310,7 @@ int AudioFifo::writeSamples(const float *samples, int count)
 	  if (do_overwrite)
 	  {
       	    tail = (tail < fifo_size-1) ? tail + 1 : 0;
+            out_cnt += 1;
 	  }
 	  else
 	  {
@@ -270,6 +318,7 @@ int AudioFifo::writeSamples(const float *samples, int count)
 	  }
 	}
       }
+      in_cnt += samples_written - buffered_start;
       
       if (prebuf && (samplesInFifo() > 0))
       {
@@ -291,10 +340,103 @@ int AudioFifo::writeSamples(const float *samples, int count)
 } /* writeSamples */
 
 
+float *AudioFifo::writeBuffer(int count)
+{
+  assert(count > 0);
+
+  if (is_full)
+  {
+    return 0;
+  }
+
+  if (empty() && !prebuf)
+  {
+      // Nothing is buffered so the samples may be written directly into a
+      // buffer in the connected sink, if it has one
+    float *buf = sinkWriteBuffer(count);
+    if ((buf != 0) || !buffering_enabled)
+    {
+      sink_buffer_used = (buf != 0);
+      return buf;
+    }
+  }
+  else if (!buffering_enabled)
+  {
+    return 0;
+  }
+
+    // The samples must fit in the contiguous free space after the head
+    // without filling up the FIFO completely
+  unsigned space = (head >= tail) ? fifo_size - head - (tail == 0 ? 1 : 0)
+                                  : tail - head - 1;
+  if (static_cast<unsigned>(count) > space)
+  {
+    return 0;
+  }
+  sink_buffer_used = false;
+  return fifo + head;
+
+} /* AudioFifo::writeBuffer */
+
+
+void AudioFifo::commitSamples(int count)
+{
+  if (count > 0)
+  {
+    trackInput();
+  }
+
+  if (sink_buffer_used)
+  {
+    sink_buffer_used = false;
+    sinkCommitSamples(count);
+    if ((count > 0) && !buffering_enabled)
+    {
+      output_stopped = false;
+    }
+    return;
+  }
+
+  if (count <= 0)
+  {
+    return;
+  }
+
+  is_idle = false;
+  is_flushing = false;
+  input_stopped = false;
+
+  if ((AudioLatencyTrace::current() != 0) &&
+      (latency_marks.size() < MAX_LATENCY_MARKS))
+  {
+    latency_marks.push_back(
+        std::make_pair(in_cnt, AudioLatencyTrace::current()));
+  }
+  head += count;
+  if (head == fifo_size)
+  {
+    head = 0;
+  }
+  in_cnt += count;
+
+  if (prebuf && (samplesInFifo() > 0))
+  {
+    prebuf = false;
+  }
+
+  writeSamplesFromFifo();
+
+} /* AudioFifo::commitSamples */
+
+
 void AudioFifo::flushSamples(void)
 {
   //printf("AudioFifo::flushSamples\n");
   is_flushing = true;
+  if (in_stream)
+  {
+    endStream();
+  }
   prebuf = (prebuf_samples > 0);
   if (empty())
   {
@@ -377,7 +519,30 @@ void AudioFifo::writeSamplesFromFifo(void)
     int samples_to_write = min(MAX_WRITE_SIZE, samplesInFifo(true));
     int to_end_of_fifo = fifo_size - tail;
     samples_to_write = min(samples_to_write, to_end_of_fifo);
-    samples_written = sinkWriteSamples(fifo+tail, samples_to_write);
+    {
+        // Buffered samples only carry the latency trace marks stored with
+        // them, not the mark of a block currently being written
+      uint64_t mark = 0;
+      if (!latency_marks.empty())
+      {
+        uint64_t mark_pos = latency_marks.front().first;
+        if (mark_pos <= out_cnt)
+        {
+          mark = latency_marks.front().second;
+        }
+        else if (mark_pos < out_cnt + samples_to_write)
+        {
+          samples_to_write = mark_pos - out_cnt;
+        }
+      }
+      AudioLatencyTrace::Scope latency_scope(mark);
+      samples_written = sinkWriteSamples(fifo+tail, samples_to_write);
+    }
+    out_cnt += samples_written;
+    while (!latency_marks.empty() && (latency_marks.front().first < out_cnt))
+    {
+      latency_marks.pop_front();
+    }
     //printf("AudioFifo::writeSamplesFromFifo(%s): samples_to_write=%d "
     //  	   "samples_written=%d\n", debug_name.c_str(), samples_to_write,
 	//   samples_written);
@@ -392,6 +557,7 @@ void AudioFifo::writeSamplesFromFifo(void)
   if (samples_written == 0)
   {
     output_stopped = true;
+    sink_limited = true;
   }
   
   if (input_stopped && !full())
@@ -408,6 +574,65 @@ void AudioFifo::writeSamplesFromFifo(void)
 } /* writeSamplesFromFifo */
 
 
+void AudioFifo::trackInput(void)
+{
+  if (!in_stream)
+  {
+    in_stream = true;
+    stream_underrun = false;
+    stream_low_water = UINT_MAX;
+    stream_high_water = 0;
+    prebuf_stats.streams += 1;
+    return;
+  }
+
+    // The fill level only tell something about the underrun risk when the
+    // sink limit the output rate and the FIFO is not prebuffering
+  if (!sink_limited || prebuf)
+  {
+    return;
+  }
+
+  unsigned level = samplesInFifo(true);
+  if ((level == 0) && !output_stopped)
+  {
+      // The sink have been waiting for more samples
+    stream_underrun = true;
+    prebuf_stats.underruns += 1;
+    if (prebufIsAdaptive() && (prebuf_samples < adapt_max_samples))
+    {
+        // Setting a new size on the empty FIFO make it prebuffer again
+      unsigned step = PREBUF_GROW_MS * INTERNAL_SAMPLE_RATE / 1000;
+      setPrebufSamples(min(prebuf_samples + step, adapt_max_samples));
+      prebuf_stats.grows += 1;
+    }
+  }
+  stream_low_water = min(stream_low_water, level);
+  stream_high_water = max(stream_high_water, level);
+} /* AudioFifo::trackInput */
+
+
+void AudioFifo::endStream(void)
+{
+  in_stream = false;
+  bool measured = (stream_low_water != UINT_MAX);
+  prebuf_stats.low_water = measured ? stream_low_water : 0;
+  prebuf_stats.high_water = stream_high_water;
+
+    // Only shrink if more than two steps of margin was left during the
+    // whole stream. The FIFO is not empty here so the new size apply to the
+    // next stream.
+  unsigned step = PREBUF_SHRINK_MS * INTERNAL_SAMPLE_RATE / 1000;
+  if (prebufIsAdaptive() && measured && !stream_underrun &&
+      (stream_low_water > 2 * step) && (prebuf_samples > adapt_min_samples))
+  {
+    prebuf_samples -= min(step, prebuf_samples - adapt_min_samples);
+    prebuf_stats.shrinks += 1;
+  }
+  sink_limited = false;
+} /* AudioFifo::endStream */
+
+
 
 /*
  * This file has not been truncated
@@ -37,6 +37,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <stdint.h>
+#include <deque>
+#include <utility>
 
 
 /****************************************************************************
@@ -225,6 +228,74 @@ class AudioFifo : public AudioSink, public AudioSource
      * @return  Returns \em true if buffering is enabled or else \em false
      */
     bool bufferingEnabled(void) const { return buffering_enabled; }
+
+    /**
+     * @brief   Statistics for the prebuffer of the FIFO
+     *
+     * A stream is the samples written between two flushes. The fill levels
+     * are measured each time new samples are written, that is they tell how
+     * many samples were left in the FIFO when more arrived. They are only
+     * measured when the connected sink limit the output rate, e.g. an audio
+     * device.
+     */
+    struct PrebufStats
+    {
+      uint64_t  streams;      // The number of streams written
+      uint64_t  underruns;    // The number of times the FIFO ran dry
+      uint64_t  grows;        // Adaptive prebuffer increases
+      uint64_t  shrinks;      // Adaptive prebuffer decreases
+      unsigned  low_water;    // The lowest fill level in the last stream
+      unsigned  high_water;   // The highest fill level in the last stream
+
+      PrebufStats(void)
+        : streams(0), underruns(0), grows(0), shrinks(0), low_water(0),
+          high_water(0) {}
+    };
+
+    /**
+     * @brief   Get the number of samples to prebuffer
+     * @return  Returns the current prebuffer size in samples
+     */
+    unsigned prebufSamples(void) const { return prebuf_samples; }
+
+    /**
+     * @brief   Let the FIFO adjust its prebuffer size at runtime
+     * @param   min_samples The smallest prebuffer size to use
+     * @param   max_samples The largest prebuffer size to use, 0 to disable
+     *
+     * When enabled, the prebuffer is grown as soon as the FIFO run dry in
+     * the middle of a stream while the connected sink is waiting for more
+     * samples, which would give a dropout. When a stream end without any
+     * underrun, the prebuffer is shrunk a little if the FIFO never got close
+     * to empty during that stream. That way the prebuffer converge to the
+     * smallest size that do not give any dropouts. The current prebuffer
+     * size is clamped to the given limits.
+     */
+    void setAdaptivePrebuf(unsigned min_samples, unsigned max_samples);
+
+    /**
+     * @brief   Check if the prebuffer size is adjusted at runtime
+     * @return  Returns \em true if adaptive prebuffering is enabled
+     */
+    bool prebufIsAdaptive(void) const { return adapt_max_samples > 0; }
+
+    /**
+     * @brief   Get the lower adaptive prebuffer limit
+     * @return  Returns the smallest prebuffer size in samples
+     */
+    unsigned adaptiveMinSamples(void) const { return adapt_min_samples; }
+
+    /**
+     * @brief   Get the upper adaptive prebuffer limit
+     * @return  Returns the largest prebuffer size in samples
+     */
+    unsigned adaptiveMaxSamples(void) const { return adapt_max_samples; }
+
+    /**
+     * @brief   Get the prebuffer statistics
+     * @return  Returns the prebuffer statistics for this FIFO
+     */
+    const PrebufStats& prebufStats(void) const { return prebuf_stats; }
     
     /**
      * @brief 	Write samples into the FIFO
@@ -238,6 +309,27 @@ class AudioFifo : public AudioSink, public AudioSource
      * This function is normally only called from a connected source object.
      */
     virtual int writeSamples(const float *samples, int count);
+
+    /**
+     * @brief   Get a buffer to write samples directly into
+     * @param   count The number of samples that the source want to write
+     * @return  Returns a buffer with room for count samples or 0
+     *
+     * If the FIFO is empty and the connected sink provide a buffer of its
+     * own, that buffer is returned. Otherwise a pointer into the FIFO is
+     * returned if there is enough contiguous free space in it. The samples
+     * must be committed using commitSamples.
+     * This function is normally only called from a connected source object.
+     */
+    virtual float *writeBuffer(int count);
+
+    /**
+     * @brief   Commit samples written into the buffer from writeBuffer
+     * @param   count The number of samples written
+     *
+     * This function is normally only called from a connected source object.
+     */
+    virtual void commitSamples(int count);
     
     /**
      * @brief 	Tell the FIFO to flush the previously written samples
@@ -270,6 +362,10 @@ class AudioFifo : public AudioSink, public AudioSource
     
     
   private:    
+    typedef std::deque<std::pair<uint64_t, uint64_t> > LatencyMarks;
+
+    static const size_t MAX_LATENCY_MARKS = 4;
+
     float     	*fifo;
     unsigned    fifo_size;
     unsigned    head, tail;
@@ -283,8 +379,22 @@ class AudioFifo : public AudioSink, public AudioSource
     bool      	disable_buffering_when_flushed;
     bool      	is_idle;
     bool      	input_stopped;
+    uint64_t    in_cnt;
+    uint64_t    out_cnt;
+    LatencyMarks latency_marks;   // Input position and AudioLatencyTrace mark
+    bool        sink_buffer_used;
+    unsigned    adapt_min_samples;
+    unsigned    adapt_max_samples;
+    bool        in_stream;
+    bool        sink_limited;
+    bool        stream_underrun;
+    unsigned    stream_low_water;
+    unsigned    stream_high_water;
+    PrebufStats prebuf_stats;
     
     void writeSamplesFromFifo(void);
+    void trackInput(void);
+    void endStream(void);
 
 };  /* class AudioFifo */
 
@@ -38,6 +38,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cstdlib>
 #include <cmath>
 #include <locale>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include <pthread.h>
 
 
 /****************************************************************************
@@ -59,6 +67,7 @@ extern "C" {
 };
 
 #include "AsyncAudioFilter.h"
+#include "AsyncAudioFixedPoint.h"
 
 
 
@@ -89,15 +98,127 @@ using namespace Async;
 
 namespace Async
 {
+  /**
+   * An immutable filter design. Designs are shared between all filters
+   * using the same specification and sampling rate so that the design is
+   * only calculated once. If the design can be expressed as first and second
+   * order sections, the coefficients of the biquad cascade are stored.
+   * Otherwise the fidlib interpreter is compiled and each filter allocate
+   * its own run buffer for it.
+   */
+  class FilterDesign
+  {
+    public:
+      struct Section
+      {
+        double b0, b1, b2, a1, a2;
+      };
+
+        // Fixed point sections run in direct form I using Q28 coefficients,
+        // Q24 samples and a 64 bit accumulator
+      static const int COEFF_FRAC_BITS = 28;
+      static const int SAMPLE_FRAC_BITS = 24;
+      struct FixedSection
+      {
+        int32_t b0, b1, b2, a1, a2;
+      };
+
+      FidFilter                 *ff;
+      FidRun                    *run;
+      FidFunc                   *func;
+      bool                      biquad;
+      std::vector<Section>      sections;
+      double                    gain;
+      bool                      use_fixed;
+      std::vector<FixedSection> fixed_sections;
+      double                    fixed_gain;
+
+      static std::shared_ptr<const FilterDesign> get(const std::string &spec,
+                                                     int sample_rate,
+                                                     std::string &error_str);
+
+      FilterDesign(void)
+        : ff(0), run(0), func(0), biquad(false), gain(1.0),
+          use_fixed(false), fixed_gain(1.0) {}
+      ~FilterDesign(void);
+
+    private:
+      typedef std::map<std::pair<std::string, int>,
+                       std::weak_ptr<const FilterDesign> > Cache;
+
+      static pthread_mutex_t  cache_mutex;
+      static Cache            cache;
+
+      bool create(const std::string &spec, int sample_rate,
+                  std::string &error_str);
+      bool build(const FidFilter *filt);
+      bool buildFixed(void);
+      static bool toFixedCoeff(double coeff, int32_t *q);
+      void addSection(const double *iir, int n_iir,
+                      const double *fir, int n_fir);
+
+      FilterDesign(const FilterDesign&);
+      FilterDesign& operator=(const FilterDesign&);
+  };
+
   class FidVars
   {
     public:
-      FidFilter 	*ff;
-      FidRun    	*run;
-      FidFunc   	*func;
-      void      	*buf;
+      std::shared_ptr<const FilterDesign> design;
+      void                                *buf;
 
-      FidVars(void) : ff(0), run(0), func(0), buf(0) {}
+      FidVars(void) : buf(0) {}
+  };
+
+  /**
+   * The per filter state of a biquad cascade. Each section is run in
+   * transposed direct form II over a whole block of samples before moving
+   * on to the next section, which keeps the coefficients and the state in
+   * registers for the inner loop.
+   */
+  class BiquadCascade
+  {
+    public:
+      static const int BLOCK_SIZE = 256;
+
+      explicit BiquadCascade(const FilterDesign *design);
+      void reset(void);
+      void process(float *dest, const float *src, int count, float out_gain);
+
+    private:
+      static const int LANES = 4;
+
+      typedef FilterDesign::Section Section;
+      typedef FilterDesign::FixedSection FixedSection;
+      struct State
+      {
+        double z1, z2;
+      };
+      struct FixedState
+      {
+        int32_t x1, x2, y1, y2;
+      };
+
+      const FilterDesign*       d;
+      std::vector<State>        state;
+      std::vector<FixedState>   fixed_state;
+      double                    buf[BLOCK_SIZE];
+      int32_t                   qbuf[BLOCK_SIZE];
+
+      static inline void stepSection(const Section &sec, State &st, double &x)
+      {
+        const double y = sec.b0 * x + st.z1;
+        st.z1 = sec.b1 * x - sec.a1 * y + st.z2;
+        st.z2 = sec.b2 * x - sec.a2 * y;
+        x = y;
+      }
+
+      void processSection(const Section &sec, State &st, int len);
+      void processGroup(const Section *sec, State *st, int len);
+      void processFixed(float *dest, const float *src, int count,
+                        float out_gain);
+      static void processFixedSection(const FixedSection &sec,
+                                      FixedState &st, int32_t *buf, int len);
   };
 };
 
@@ -125,6 +246,8 @@ namespace Async
  *
  ****************************************************************************/
 
+pthread_mutex_t FilterDesign::cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+FilterDesign::Cache FilterDesign::cache;
 
 
 /****************************************************************************
@@ -133,15 +256,556 @@ namespace Async
  *
  ****************************************************************************/
 
+std::shared_ptr<const FilterDesign> FilterDesign::get(
+    const std::string &spec, int sample_rate, std::string &error_str)
+{
+  std::shared_ptr<const FilterDesign> design;
+  pthread_mutex_lock(&cache_mutex);
+  const Cache::key_type key(spec, sample_rate);
+  Cache::iterator it = cache.find(key);
+  if (it != cache.end())
+  {
+    design = it->second.lock();
+  }
+  if (!design)
+  {
+      // Drop designs that are no longer used by any filter so that the
+      // cache does not grow when filters are redesigned at runtime
+    for (Cache::iterator cit = cache.begin(); cit != cache.end(); )
+    {
+      if (cit->second.expired())
+      {
+        cache.erase(cit++);
+      }
+      else
+      {
+        ++cit;
+      }
+    }
+
+    std::shared_ptr<FilterDesign> new_design(new FilterDesign);
+    if (new_design->create(spec, sample_rate, error_str))
+    {
+      cache[key] = new_design;
+      design = new_design;
+    }
+  }
+  pthread_mutex_unlock(&cache_mutex);
+  return design;
+} /* FilterDesign::get */
+
+
+FilterDesign::~FilterDesign(void)
+{
+  if (run != 0)
+  {
+    fid_run_free(run);
+  }
+  if (ff != 0)
+  {
+    free(ff);
+  }
+} /* FilterDesign::~FilterDesign */
+
+
+bool FilterDesign::create(const std::string &spec, int sample_rate,
+                          std::string &error_str)
+{
+  char spec_buf[256];
+  strncpy(spec_buf, spec.c_str(), sizeof(spec_buf));
+  spec_buf[sizeof(spec_buf) - 1] = 0;
+  char *spec_ptr = spec_buf;
+  char *old_locale = setlocale(LC_ALL, "C");
+  char *fferr = fid_parse(sample_rate, &spec_ptr, &ff);
+  setlocale(LC_ALL, old_locale);
+  if (fferr != 0)
+  {
+    error_str = fferr;
+    free(fferr);
+    ff = 0;
+    return false;
+  }
+
+    // Use the biquad cascade if the design can be expressed as second order
+    // sections. The fidlib interpreter is kept as a fallback and may be
+    // forced by setting the ASYNC_AUDIO_FILTER environment variable to
+    // "fidlib".
+  const char *engine = getenv("ASYNC_AUDIO_FILTER");
+  if ((engine == 0) || (strcmp(engine, "fidlib") != 0))
+  {
+    biquad = build(ff);
+    if (!biquad)
+    {
+      sections.clear();
+    }
+    else if (AudioFixedPoint::enabled())
+    {
+      buildFixed();
+    }
+  }
+  if (!biquad)
+  {
+    run = fid_run_new(ff, &func);
+  }
+  return true;
+} /* FilterDesign::create */
+
+
+bool FilterDesign::build(const FidFilter *filt)
+{
+  sections.clear();
+  gain = 1.0;
+
+    // Walk the filter list the same way as fid_run_new does, pairing each
+    // IIR element with the FIR element following it. Elements of higher
+    // order than two are left to the fidlib interpreter.
+  while (filt->len != 0)
+  {
+    if ((filt->typ == 'F') && (filt->len == 1))
+    {
+      gain *= filt->val[0];
+      filt = FFNEXT(filt);
+      continue;
+    }
+
+    const double *iir = 0;
+    const double *fir = 0;
+    int n_iir = 0;
+    int n_fir = 0;
+    if (filt->typ == 'F')
+    {
+      fir = filt->val;
+      n_fir = filt->len;
+      filt = FFNEXT(filt);
+    }
+    else if (filt->typ == 'I')
+    {
+      iir = filt->val;
+      n_iir = filt->len;
+      filt = FFNEXT(filt);
+      while ((filt->typ == 'F') && (filt->len == 1))
+      {
+        gain *= filt->val[0];
+        filt = FFNEXT(filt);
+      }
+      if (filt->typ == 'F')
+      {
+        fir = filt->val;
+        n_fir = filt->len;
+        filt = FFNEXT(filt);
+      }
+    }
+    else
+    {
+      return false;
+    }
+
+    if ((n_iir > 3) || (n_fir > 3) || ((n_iir > 0) && (iir[0] == 0.0)))
+    {
+      return false;
+    }
+    addSection(iir, n_iir, fir, n_fir);
+  }
+
+  return true;
+} /* FilterDesign::build */
+
+
+bool FilterDesign::buildFixed(void)
+{
+  fixed_sections.clear();
+  if (sections.empty())
+  {
+    return false;
+  }
+
+    // Calculate the magnitude response of each section and of the whole
+    // cascade on a frequency grid
+  static const int GRID_SIZE = 512;
+  std::vector<std::vector<double> > mag(sections.size(),
+                                        std::vector<double>(GRID_SIZE + 1));
+  std::vector<double> total(GRID_SIZE + 1, 1.0);
+  for (size_t k=0; k<sections.size(); ++k)
+  {
+    const Section &sec = sections[k];
+    for (int i=0; i<=GRID_SIZE; ++i)
+    {
+      const double w = M_PI * i / GRID_SIZE;
+      const double c1 = cos(w), s1 = sin(w);
+      const double c2 = cos(2.0 * w), s2 = sin(2.0 * w);
+      const double num_re = sec.b0 + sec.b1 * c1 + sec.b2 * c2;
+      const double num_im = -sec.b1 * s1 - sec.b2 * s2;
+      const double den_re = 1.0 + sec.a1 * c1 + sec.a2 * c2;
+      const double den_im = -sec.a1 * s1 - sec.a2 * s2;
+      const double den = den_re * den_re + den_im * den_im;
+      mag[k][i] = (den > 0.0)
+        ? sqrt((num_re * num_re + num_im * num_im) / den)
+        : 0.0;
+      total[i] *= mag[k][i];
+    }
+  }
+  const double total_peak = *std::max_element(total.begin(), total.end());
+  if (!(total_peak > 0.0) || !std::isfinite(total_peak))
+  {
+    return false;
+  }
+
+    // The cascade is reordered so that the passband is not attenuated much
+    // between the sections, which would drown the signal in quantization
+    // noise. Each step pick the section that keep the ratio between the
+    // peak gain and the lowest passband gain of the partial cascade as
+    // small as possible. The sections are scaled so that the peak gain of
+    // the partial cascade is one. The peak gain of the whole filter is
+    // applied in floating point at the output.
+  static const double MAX_PASSBAND_LOSS = 256.0;
+  std::vector<double> cum(GRID_SIZE + 1, 1.0);
+  std::vector<bool> used(sections.size(), false);
+  double prev_peak = 1.0;
+  for (size_t n=0; n<sections.size(); ++n)
+  {
+    size_t best = 0;
+    double best_ratio = -1.0;
+    double best_peak = 0.0;
+    for (size_t k=0; k<sections.size(); ++k)
+    {
+      if (used[k])
+      {
+        continue;
+      }
+      double peak = 0.0;
+      double pass_min = std::numeric_limits<double>::max();
+      for (int i=0; i<=GRID_SIZE; ++i)
+      {
+        const double m = cum[i] * mag[k][i];
+        peak = (m > peak) ? m : peak;
+        if ((total[i] >= 0.5 * total_peak) && (m < pass_min))
+        {
+          pass_min = m;
+        }
+      }
+      const double ratio = (pass_min > 0.0)
+        ? peak / pass_min
+        : std::numeric_limits<double>::max();
+      if ((best_ratio < 0.0) || (ratio < best_ratio))
+      {
+        best = k;
+        best_ratio = ratio;
+        best_peak = peak;
+      }
+    }
+    if ((best_ratio > MAX_PASSBAND_LOSS) || !(best_peak > 0.0) ||
+        !std::isfinite(best_peak))
+    {
+      fixed_sections.clear();
+      return false;
+    }
+
+    const Section &sec = sections[best];
+    const double scale = prev_peak / best_peak;
+    FixedSection fsec;
+    if (!toFixedCoeff(sec.b0 * scale, &fsec.b0) ||
+        !toFixedCoeff(sec.b1 * scale, &fsec.b1) ||
+        !toFixedCoeff(sec.b2 * scale, &fsec.b2) ||
+        !toFixedCoeff(sec.a1, &fsec.a1) || !toFixedCoeff(sec.a2, &fsec.a2))
+    {
+      fixed_sections.clear();
+      return false;
+    }
+    fixed_sections.push_back(fsec);
+
+    used[best] = true;
+    for (int i=0; i<=GRID_SIZE; ++i)
+    {
+      cum[i] *= mag[best][i];
+    }
+    prev_peak = best_peak;
+  }
+
+  fixed_gain = gain * prev_peak;
+  use_fixed = true;
+  return true;
+} /* FilterDesign::buildFixed */
+
+
+bool FilterDesign::toFixedCoeff(double coeff, int32_t *q)
+{
+  const double scaled = ldexp(coeff, COEFF_FRAC_BITS);
+  if (!(fabs(scaled) < 2147483647.0))
+  {
+    return false;
+  }
+  *q = static_cast<int32_t>(llround(scaled));
+  return true;
+} /* FilterDesign::toFixedCoeff */
+
+
+void FilterDesign::addSection(const double *iir, int n_iir,
+                              const double *fir, int n_fir)
+{
+  Section sec;
+  double adj = 1.0;
+  if (n_iir > 0)
+  {
+    adj = 1.0 / iir[0];
+  }
+  sec.a1 = (n_iir > 1) ? iir[1] * adj : 0.0;
+  sec.a2 = (n_iir > 2) ? iir[2] * adj : 0.0;
+
+    // The IIR normalization is applied to the numerator so that each
+    // section keeps unit leading denominator coefficient
+  if (n_fir > 0)
+  {
+    sec.b0 = fir[0] * adj;
+    sec.b1 = (n_fir > 1) ? fir[1] * adj : 0.0;
+    sec.b2 = (n_fir > 2) ? fir[2] * adj : 0.0;
+  }
+  else
+  {
+    sec.b0 = adj;
+    sec.b1 = sec.b2 = 0.0;
+  }
+  sections.push_back(sec);
+} /* FilterDesign::addSection */
+
+
+BiquadCascade::BiquadCascade(const FilterDesign *design)
+  : d(design), state(design->sections.size()),
+    fixed_state(design->fixed_sections.size())
+{
+  reset();
+} /* BiquadCascade::BiquadCascade */
+
+
+void BiquadCascade::reset(void)
+{
+  for (std::vector<State>::iterator it = state.begin();
+       it != state.end(); ++it)
+  {
+    it->z1 = it->z2 = 0.0;
+  }
+  for (std::vector<FixedState>::iterator it = fixed_state.begin();
+       it != fixed_state.end(); ++it)
+  {
+    it->x1 = it->x2 = it->y1 = it->y2 = 0;
+  }
+} /* BiquadCascade::reset */
+
+
+void BiquadCascade::process(float *dest, const float *src, int count,
+                            float out_gain)
+{
+  if (d->use_fixed)
+  {
+    processFixed(dest, src, count, out_gain);
+    return;
+  }
+
+  const double g = d->gain * out_gain;
+  while (count > 0)
+  {
+    const int len = (count < BLOCK_SIZE) ? count : BLOCK_SIZE;
+    for (int i=0; i<len; ++i)
+    {
+      buf[i] = src[i];
+    }
+
+    const int nsec = d->sections.size();
+    int sec = 0;
+    for (; sec + LANES <= nsec; sec += LANES)
+    {
+      processGroup(&d->sections[sec], &state[sec], len);
+    }
+    for (; sec < nsec; ++sec)
+    {
+      processSection(d->sections[sec], state[sec], len);
+    }
+
+    for (int i=0; i<len; ++i)
+    {
+      dest[i] = static_cast<float>(g * buf[i]);
+    }
+
+    src += len;
+    dest += len;
+    count -= len;
+  }
+} /* BiquadCascade::process */
+
+
+void BiquadCascade::processSection(const Section &sec, State &st, int len)
+{
+  const double b0 = sec.b0, b1 = sec.b1, b2 = sec.b2;
+  const double a1 = sec.a1, a2 = sec.a2;
+  double z1 = st.z1, z2 = st.z2;
+  for (int i=0; i<len; ++i)
+  {
+    const double x = buf[i];
+    const double y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    buf[i] = y;
+  }
+  st.z1 = z1;
+  st.z2 = z2;
+} /* BiquadCascade::processSection */
+
+
+void BiquadCascade::processGroup(const Section *sec, State *st, int len)
+{
+    // The recursion within one section is bound by the latency of the
+    // multiply-add chain. Running four consecutive sections as a wavefront,
+    // where section j works on sample t-j at step t, gives four independent
+    // chains that the CPU can execute in parallel and that the compiler can
+    // pack into SIMD registers. The arithmetic is the same as for
+    // processSection so the output is unchanged.
+  int t = 0;
+
+    // Ramp up the wavefront
+  for (; (t < LANES - 1) && (t < len); ++t)
+  {
+    for (int j=t; j>=0; --j)
+    {
+      stepSection(sec[j], st[j], buf[t - j]);
+    }
+  }
+
+  if (t == LANES - 1)
+  {
+    const double b0_0 = sec[0].b0, b1_0 = sec[0].b1, b2_0 = sec[0].b2;
+    const double a1_0 = sec[0].a1, a2_0 = sec[0].a2;
+    const double b0_1 = sec[1].b0, b1_1 = sec[1].b1, b2_1 = sec[1].b2;
+    const double a1_1 = sec[1].a1, a2_1 = sec[1].a2;
+    const double b0_2 = sec[2].b0, b1_2 = sec[2].b1, b2_2 = sec[2].b2;
+    const double a1_2 = sec[2].a1, a2_2 = sec[2].a2;
+    const double b0_3 = sec[3].b0, b1_3 = sec[3].b1, b2_3 = sec[3].b2;
+    const double a1_3 = sec[3].a1, a2_3 = sec[3].a2;
+    double z1_0 = st[0].z1, z2_0 = st[0].z2;
+    double z1_1 = st[1].z1, z2_1 = st[1].z2;
+    double z1_2 = st[2].z1, z2_2 = st[2].z2;
+    double z1_3 = st[3].z1, z2_3 = st[3].z2;
+    double x1 = buf[t - 1], x2 = buf[t - 2], x3 = buf[t - 3];
+    for (; t<len; ++t)
+    {
+      const double x0 = buf[t];
+      const double y0 = b0_0 * x0 + z1_0;
+      const double y1 = b0_1 * x1 + z1_1;
+      const double y2 = b0_2 * x2 + z1_2;
+      const double y3 = b0_3 * x3 + z1_3;
+      z1_0 = b1_0 * x0 - a1_0 * y0 + z2_0;
+      z1_1 = b1_1 * x1 - a1_1 * y1 + z2_1;
+      z1_2 = b1_2 * x2 - a1_2 * y2 + z2_2;
+      z1_3 = b1_3 * x3 - a1_3 * y3 + z2_3;
+      z2_0 = b2_0 * x0 - a2_0 * y0;
+      z2_1 = b2_1 * x1 - a2_1 * y1;
+      z2_2 = b2_2 * x2 - a2_2 * y2;
+      z2_3 = b2_3 * x3 - a2_3 * y3;
+      buf[t - 3] = y3;
+      x3 = y2;
+      x2 = y1;
+      x1 = y0;
+    }
+    st[0].z1 = z1_0; st[0].z2 = z2_0;
+    st[1].z1 = z1_1; st[1].z2 = z2_1;
+    st[2].z1 = z1_2; st[2].z2 = z2_2;
+    st[3].z1 = z1_3; st[3].z2 = z2_3;
+    buf[t - 1] = x1;
+    buf[t - 2] = x2;
+    buf[t - 3] = x3;
+  }
+
+    // Ramp down the wavefront. The last samples in the block have only
+    // been through the first len-i sections.
+  const int first = (len > LANES - 1) ? len - LANES + 1 : 0;
+  for (int i=first; i<len; ++i)
+  {
+    for (int j=len-i; j<LANES; ++j)
+    {
+      stepSection(sec[j], st[j], buf[i]);
+    }
+  }
+} /* BiquadCascade::processGroup */
+
+
+void BiquadCascade::processFixed(float *dest, const float *src, int count,
+                                 float out_gain)
+{
+  const int frac_bits = FilterDesign::SAMPLE_FRAC_BITS;
+  const float in_scale = static_cast<float>(1 << frac_bits);
+  const float in_max = static_cast<float>(
+      std::numeric_limits<int32_t>::max() >> frac_bits);
+  const float out_scale = static_cast<float>(
+      d->fixed_gain * out_gain / (1 << frac_bits));
+  const int nsec = d->fixed_sections.size();
+  while (count > 0)
+  {
+    const int len = (count < BLOCK_SIZE) ? count : BLOCK_SIZE;
+    for (int i=0; i<len; ++i)
+    {
+      float x = src[i];
+      x = (x > in_max) ? in_max : ((x < -in_max) ? -in_max : x);
+      qbuf[i] = static_cast<int32_t>(x * in_scale);
+    }
+
+    for (int sec=0; sec<nsec; ++sec)
+    {
+      processFixedSection(d->fixed_sections[sec], fixed_state[sec], qbuf,
+                          len);
+    }
+
+    for (int i=0; i<len; ++i)
+    {
+      dest[i] = out_scale * qbuf[i];
+    }
+
+    src += len;
+    dest += len;
+    count -= len;
+  }
+} /* BiquadCascade::processFixed */
+
+
+void BiquadCascade::processFixedSection(const FixedSection &sec,
+                                        FixedState &st, int32_t *buf, int len)
+{
+  const int64_t b0 = sec.b0, b1 = sec.b1, b2 = sec.b2;
+  const int64_t a1 = sec.a1, a2 = sec.a2;
+  int32_t x1 = st.x1, x2 = st.x2, y1 = st.y1, y2 = st.y2;
+  for (int i=0; i<len; ++i)
+  {
+    const int32_t x = buf[i];
+    int64_t acc = (static_cast<int64_t>(1) << (FilterDesign::COEFF_FRAC_BITS - 1)) +
+                  b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+    acc >>= FilterDesign::COEFF_FRAC_BITS;
+    if (acc > std::numeric_limits<int32_t>::max())
+    {
+      acc = std::numeric_limits<int32_t>::max();
+    }
+    else if (acc < std::numeric_limits<int32_t>::min())
+    {
+      acc = std::numeric_limits<int32_t>::min();
+    }
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = static_cast<int32_t>(acc);
+    buf[i] = y1;
+  }
+  st.x1 = x1;
+  st.x2 = x2;
+  st.y1 = y1;
+  st.y2 = y2;
+} /* BiquadCascade::processFixedSection */
+
+
 AudioFilter::AudioFilter(int sample_rate)
-  : sample_rate(sample_rate), fv(0), output_gain(1.0f)
+  : sample_rate(sample_rate), fv(0), bq(0), output_gain(1.0f)
 {
 
 } /* AudioFilter::AudioFilter */
 
 
 AudioFilter::AudioFilter(const string &filter_spec, int sample_rate)
-  : sample_rate(sample_rate), fv(0), output_gain(1.0f)
+  : sample_rate(sample_rate), fv(0), bq(0), output_gain(1.0f)
 {
   if (!parseFilterSpec(filter_spec))
   {
@@ -161,24 +825,26 @@ bool AudioFilter::parseFilterSpec(const std::string &filter_spec)
 {
   deleteFilter();
 
-  fv = new FidVars;
-  
-  char spec_buf[256];
-  strncpy(spec_buf, filter_spec.c_str(), sizeof(spec_buf));
-  spec_buf[sizeof(spec_buf) - 1] = 0;
-  char *spec = spec_buf;
-  char *old_locale = setlocale(LC_ALL, "C");
-  char *fferr = fid_parse(sample_rate, &spec, &fv->ff);
-  setlocale(LC_ALL, old_locale);
-  if (fferr != 0)
+    // The design is shared with all other filters using the same
+    // specification and sampling rate. Only the filter state is allocated
+    // for this filter.
+  std::shared_ptr<const FilterDesign> design =
+    FilterDesign::get(filter_spec, sample_rate, error_str);
+  if (!design)
   {
-    error_str = fferr;
-    free(fferr);
-    deleteFilter();
     return false;
   }
-  fv->run = fid_run_new(fv->ff, &fv->func);
-  fv->buf = fid_run_newbuf(fv->run);
+
+  fv = new FidVars;
+  fv->design = design;
+  if (design->biquad)
+  {
+    bq = new BiquadCascade(design.get());
+  }
+  else
+  {
+    fv->buf = fid_run_newbuf(design->run);
+  }
   return true;
 } /* AudioFilter::parseFilterSpec */
 
@@ -191,7 +857,14 @@ void AudioFilter::setOutputGain(float gain_db)
 
 void AudioFilter::reset(void)
 {
-  fid_run_zapbuf(fv->buf);
+  if (bq != 0)
+  {
+    bq->reset();
+  }
+  else if ((fv != 0) && (fv->buf != 0))
+  {
+    fid_run_zapbuf(fv->buf);
+  }
 } /* AudioFilter::reset */
 
 
@@ -206,10 +879,17 @@ void AudioFilter::reset(void)
 void AudioFilter::processSamples(float *dest, const float *src, int count)
 {
   //cout << "AudioFilter::processSamples: len=" << len << endl;
-  
+
+  if (bq != 0)
+  {
+    bq->process(dest, src, count, output_gain);
+    return;
+  }
+
+  FidFunc *func = fv->design->func;
   for (int i=0; i<count; ++i)
   {
-    dest[i] = output_gain * fv->func(fv->buf, src[i]);
+    dest[i] = output_gain * func(fv->buf, src[i]);
   }
 } /* AudioFilter::writeSamples */
 
@@ -224,13 +904,14 @@ void AudioFilter::processSamples(float *dest, const float *src, int count)
 
 void AudioFilter::deleteFilter(void)
 {
+  delete bq;
+  bq = 0;
+
   if (fv != 0)
   {
-    if (fv->ff != 0)
+    if (fv->buf != 0)
     {
       fid_run_freebuf(fv->buf);
-      fid_run_free(fv->run);
-      free(fv->ff);
     }
     delete fv;
     fv = 0;
@@ -44,6 +44,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -81,6 +82,7 @@ namespace Async
  ****************************************************************************/
 
 class FidVars;
+class BiquadCascade;
   
 
 /****************************************************************************
@@ -109,6 +111,16 @@ class FidVars;
 @brief	A class for creating a wide range of audio filters
 @author Tobias Blomberg / SM0SVX
 @date   2006-04-23
+
+The filter is designed by fidlib from a filter specification string. If the
+resulting design consists of first and second order sections, which is the
+case for all the common filter types, it is run as a cascade of biquads.
+Otherwise the fidlib filter interpreter is used. Setting the environment
+variable ASYNC_AUDIO_FILTER to "fidlib" force the use of the interpreter.
+
+Filter designs are cached and shared between all filters that use the same
+specification and sampling rate. Only the filter state is allocated per
+instance so creating many identical filters is cheap.
 */
 class AudioFilter : public AudioProcessor
 {
@@ -191,6 +203,7 @@ class AudioFilter : public AudioProcessor
   private:
     int         sample_rate;
     FidVars   	*fv;
+    BiquadCascade *bq;
     float     	output_gain;
     std::string error_str;
     
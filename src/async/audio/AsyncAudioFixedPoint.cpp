@@ -0,0 +1,179 @@
+/**
+@file   AsyncAudioFixedPoint.cpp
+@brief  Fixed point helpers for the audio filters
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains the implementation of the AudioFixedPoint class.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioFixedPoint.h"
+#include "AsyncAudioSampleOps.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+bool AudioFixedPoint::enabled(void)
+{
+  const char *force = getenv("ASYNC_AUDIO_FIXED_POINT");
+  if ((force != 0) && (*force != 0))
+  {
+    return strcmp(force, "0") != 0;
+  }
+#ifdef ASYNC_AUDIO_FIXED_POINT
+  return true;
+#else
+  return false;
+#endif
+} /* AudioFixedPoint::enabled */
+
+
+int AudioFixedPoint::coeffShift(const float *coeff, int len)
+{
+  double max_abs = 0.0;
+  double sum_abs = 0.0;
+  for (int i=0; i<len; ++i)
+  {
+    double c = fabs(coeff[i]);
+    max_abs = (c > max_abs) ? c : max_abs;
+    sum_abs += c;
+  }
+
+    // The sum of the absolute coefficient values times the largest Q15
+    // sample must fit in 31 bits
+  int shift = 15;
+  while ((shift > 0) &&
+         ((max_abs * (1 << shift) >= 32767.0) ||
+          (sum_abs * (1 << shift) * 32768.0 >= 2147483647.0)))
+  {
+    --shift;
+  }
+  return shift;
+} /* AudioFixedPoint::coeffShift */
+
+
+void AudioFixedPoint::floatToQ15(int16_t *dst, const float *src, int len)
+{
+  memset(dst, 0, len * sizeof(*dst));
+  AudioSampleOps::mixFloatToS16(dst, src, len);
+} /* AudioFixedPoint::floatToQ15 */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+
+
+/*
+ * This file has not been truncated
+ */
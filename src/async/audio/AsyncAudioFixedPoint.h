@@ -0,0 +1,203 @@
+/**
+@file   AsyncAudioFixedPoint.h
+@brief  Fixed point helpers for the audio filters
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a small helper class with the fixed point primitives used
+by the audio decimator, interpolator and filter when running in fixed point
+mode. This is useful on CPUs with a slow or no floating point unit.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_FIXED_POINT_INCLUDED
+#define ASYNC_AUDIO_FIXED_POINT_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Fixed point primitives for the audio filters
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+The audio framework pass float samples between the audio processors. On CPUs
+with a weak floating point unit, like the ARMv6 in the Raspberry Pi Zero or
+the MIPS CPUs in many routers, the floating point multiply-add in the filter
+inner loops is the bottleneck. In fixed point mode the FIR filters keep their
+delay lines and coefficients as Q15 values and accumulate in 32 bits. The
+biquad filters use Q28 coefficients and 64 bit accumulators. Samples are only
+converted at the filter input and output.
+
+Fixed point mode is the default if the library was built with the CMake
+option USE_FIXED_POINT_DSP. The mode may be forced on or off by setting the
+environment variable ASYNC_AUDIO_FIXED_POINT to "1" or "0". The mode is read
+when a filter is created.
+*/
+class AudioFixedPoint
+{
+  public:
+    /**
+     * @brief   The Q15 value that a float sample of 1.0 is converted to
+     */
+    static const int Q15_ONE = 32767;
+
+    /**
+     * @brief   Check if the audio filters should run in fixed point mode
+     * @return  Returns \em true if fixed point mode is enabled
+     */
+    static bool enabled(void);
+
+    /**
+     * @brief   Find how much FIR coefficients can be scaled up
+     * @param   coeff The filter coefficients
+     * @param   len   The number of coefficients
+     * @return  Returns the number of fractional bits to use, 0 to 15
+     *
+     * The coefficients are scaled by 2^shift and rounded to 16 bits. The
+     * shift is chosen so that both each coefficient and the sum of their
+     * absolute values fit. The latter guarantee that a dot product of
+     * the coefficients and Q15 samples cannot overflow 32 bits.
+     */
+    static int coeffShift(const float *coeff, int len);
+
+    /**
+     * @brief   Convert float samples to Q15
+     * @param   dst The destination buffer
+     * @param   src The samples to convert
+     * @param   len The number of samples to convert
+     *
+     * Samples outside of -1.0 - 1.0 are clipped.
+     */
+    static void floatToQ15(int16_t *dst, const float *src, int len);
+
+    /**
+     * @brief   Calculate the dot product of two Q15 vectors
+     * @param   a   The first vector
+     * @param   b   The second vector
+     * @param   len The number of elements in each vector
+     * @return  Returns the sum of a[i]*b[i] for all i
+     *
+     * The vectors must be scaled so that the sum fit in 32 bits, see
+     * coeffShift.
+     */
+    static int32_t dotProduct(const int16_t *a, const int16_t *b, int len)
+    {
+      int32_t sum0 = 0;
+      int32_t sum1 = 0;
+      int i = 0;
+      for (; i + 2 <= len; i += 2)
+      {
+        sum0 += static_cast<int32_t>(a[i]) * b[i];
+        sum1 += static_cast<int32_t>(a[i + 1]) * b[i + 1];
+      }
+      if (i < len)
+      {
+        sum0 += static_cast<int32_t>(a[i]) * b[i];
+      }
+      return sum0 + sum1;
+    }
+
+  private:
+    AudioFixedPoint(void);
+};  /* class AudioFixedPoint */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_FIXED_POINT_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -35,6 +35,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cassert>
 #include <iostream>
 
+#if defined(__SSE__)
+#define ASYNC_FSF_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ASYNC_FSF_NEON
+#include <arm_neon.h>
+#endif
+
 
 /****************************************************************************
  *
@@ -70,6 +78,13 @@ using namespace Async;
  *
  ****************************************************************************/
 
+namespace {
+    // The number of resonators processed in parallel
+  const size_t LANES = 4;
+
+    // The number of samples processed in each pass through the resonators
+  const int BLOCK_SIZE = 64;
+}
 
 
 /****************************************************************************
@@ -116,44 +131,6 @@ namespace Async
       CombFilter& operator=(const CombFilter&);
   
   }; /* AudioFsf::CombFilter */
-
-
-  class AudioFsf::Resonator
-  {
-    public:
-      Resonator(const size_t N, const size_t k, const float r, const float H)
-        : gain(H), coeff1(2.0*r*cos(2.0*M_PI*k/N)), coeff2(-r*r),
-          z1(0.0), z2(0.0)
-      {
-        gain /= N;
-        if ((k == 0) || (k == N/2))
-        {
-          gain /= 2.0;
-        }
-        if (k % 2 == 1)
-        {
-          gain = -gain;
-        }
-        //std::cout << "### Resonator: N=" << N << " k=" << k << " r=" << r
-        //          << " H=" << H << " gain=" << gain
-        //          << " coeff1=" << coeff1 << " coeff2=" << coeff2 << std::endl;
-      }
-
-      inline float processSample(const float& src)
-      {
-        float dest = src + z1*coeff1 + z2*coeff2;
-        z2 = z1;
-        z1 = dest;
-        return dest * gain;
-      }
-
-    private:
-      float       gain;
-      const float coeff1;
-      const float coeff2;
-      float       z1;
-      float       z2;
-  };
 };
 
 
@@ -188,6 +165,7 @@ namespace Async
  ****************************************************************************/
 
 AudioFsf::AudioFsf(const size_t N, const float *coeff, const float r)
+  : m_lane_cnt(0)
 {
   assert(N % 2 == 0);
   assert((r >= 0.0) && (r <= 1.0));
@@ -198,22 +176,26 @@ AudioFsf::AudioFsf(const size_t N, const float *coeff, const float r)
     float H = coeff[k];
     if (H > 0.0f)
     {
-      Resonator *res = new Resonator(N, k, r, H);
-      m_resonators.push_back(res);
+      addResonator(N, k, r, H);
     }
   }
+
+    // Pad the bank to a whole number of lane groups. A padding resonator
+    // has zero gain and zero feedback so it does not affect the output.
+  while (m_lane_cnt % LANES != 0)
+  {
+    m_gain.push_back(0.0f);
+    m_coeff1.push_back(0.0f);
+    m_coeff2.push_back(0.0f);
+    ++m_lane_cnt;
+  }
+  m_z1.assign(m_lane_cnt, 0.0f);
+  m_z2.assign(m_lane_cnt, 0.0f);
 } /* AudioFsf::AudioFsf */
 
 
 AudioFsf::~AudioFsf(void)
 {
-  for (std::vector<Resonator*>::iterator it=m_resonators.begin();
-       it!=m_resonators.end();
-       ++it)
-  {
-    delete *it;
-  }
-  m_resonators.clear();
   delete m_comb2;
   m_comb2 = 0;
   delete m_combN;
@@ -229,17 +211,18 @@ AudioFsf::~AudioFsf(void)
 
 void AudioFsf::processSamples(float *dest, const float *src, int count)
 {
-  for (int i=0; i<count; ++i)
+  while (count > 0)
   {
-    float destN = m_combN->processSample(src[i]);
-    float dest2 = m_comb2->processSample(destN);
-    dest[i] = 0.0f;
-    for (std::vector<Resonator*>::iterator it=m_resonators.begin();
-         it!=m_resonators.end();
-         ++it)
+    int len = (count < BLOCK_SIZE) ? count : BLOCK_SIZE;
+    float comb[BLOCK_SIZE];
+    for (int i=0; i<len; ++i)
     {
-      dest[i] += (*it)->processSample(dest2);
+      comb[i] = m_comb2->processSample(m_combN->processSample(src[i]));
     }
+    processResonators(dest, comb, len);
+    src += len;
+    dest += len;
+    count -= len;
   }
 } /* AudioFsf::processSamples */
 
@@ -250,6 +233,97 @@ void AudioFsf::processSamples(float *dest, const float *src, int count)
  *
  ****************************************************************************/
 
+void AudioFsf::addResonator(size_t N, size_t k, float r, float H)
+{
+  float gain = H / N;
+  if ((k == 0) || (k == N/2))
+  {
+    gain /= 2.0;
+  }
+  if (k % 2 == 1)
+  {
+    gain = -gain;
+  }
+  m_gain.push_back(gain);
+  m_coeff1.push_back(2.0*r*cos(2.0*M_PI*k/N));
+  m_coeff2.push_back(-r*r);
+  ++m_lane_cnt;
+} /* AudioFsf::addResonator */
+
+
+void AudioFsf::processResonators(float *dest, const float *src, int count)
+{
+    // Each lane group is run over the whole block with its state kept in
+    // registers. The per lane outputs are accumulated in acc and summed up
+    // at the end. The resonator update must be evaluated in the same order
+    // in all implementations, (x + z1*c1) + z2*c2, since the filter relies
+    // on the poles being cancelled by the comb filter zeros and is quite
+    // sensitive to rounding differences.
+  float acc[BLOCK_SIZE * LANES];
+  std::memset(acc, 0, sizeof(*acc) * LANES * count);
+  for (size_t l=0; l<m_lane_cnt; l+=LANES)
+  {
+#if defined(ASYNC_FSF_SSE)
+    __m128 gain = _mm_loadu_ps(&m_gain[l]);
+    __m128 c1 = _mm_loadu_ps(&m_coeff1[l]);
+    __m128 c2 = _mm_loadu_ps(&m_coeff2[l]);
+    __m128 z1 = _mm_loadu_ps(&m_z1[l]);
+    __m128 z2 = _mm_loadu_ps(&m_z2[l]);
+    for (int i=0; i<count; ++i)
+    {
+      __m128 y = _mm_add_ps(_mm_add_ps(_mm_set1_ps(src[i]),
+                                       _mm_mul_ps(z1, c1)),
+                            _mm_mul_ps(z2, c2));
+      z2 = z1;
+      z1 = y;
+      float *a = acc + i * LANES;
+      _mm_storeu_ps(a, _mm_add_ps(_mm_loadu_ps(a), _mm_mul_ps(y, gain)));
+    }
+    _mm_storeu_ps(&m_z1[l], z1);
+    _mm_storeu_ps(&m_z2[l], z2);
+#elif defined(ASYNC_FSF_NEON)
+    float32x4_t gain = vld1q_f32(&m_gain[l]);
+    float32x4_t c1 = vld1q_f32(&m_coeff1[l]);
+    float32x4_t c2 = vld1q_f32(&m_coeff2[l]);
+    float32x4_t z1 = vld1q_f32(&m_z1[l]);
+    float32x4_t z2 = vld1q_f32(&m_z2[l]);
+    for (int i=0; i<count; ++i)
+    {
+      float32x4_t y = vmlaq_f32(vmlaq_f32(vdupq_n_f32(src[i]), z1, c1), z2, c2);
+      z2 = z1;
+      z1 = y;
+      float *a = acc + i * LANES;
+      vst1q_f32(a, vmlaq_f32(vld1q_f32(a), y, gain));
+    }
+    vst1q_f32(&m_z1[l], z1);
+    vst1q_f32(&m_z2[l], z2);
+#else
+    float z1[LANES], z2[LANES];
+    std::memcpy(z1, &m_z1[l], sizeof(z1));
+    std::memcpy(z2, &m_z2[l], sizeof(z2));
+    for (int i=0; i<count; ++i)
+    {
+      float *a = acc + i * LANES;
+      for (size_t j=0; j<LANES; ++j)
+      {
+        float y = src[i] + z1[j]*m_coeff1[l+j] + z2[j]*m_coeff2[l+j];
+        z2[j] = z1[j];
+        z1[j] = y;
+        a[j] += y * m_gain[l+j];
+      }
+    }
+    std::memcpy(&m_z1[l], z1, sizeof(z1));
+    std::memcpy(&m_z2[l], z2, sizeof(z2));
+#endif
+  }
+
+  for (int i=0; i<count; ++i)
+  {
+    const float *a = acc + i * LANES;
+    dest[i] = (a[0] + a[1]) + (a[2] + a[3]);
+  }
+} /* AudioFsf::processResonators */
+
 
 
 /*
@@ -165,6 +165,10 @@ That value has been looked up in the table mentioned above. All other positions
 must be set to 0 to form the stop band. The dampening factor 'r' should be left
 at its default unless there is a good reason to change it.
 
+All resonators with a non-zero coefficient are run together as a resonator
+bank, four at a time, using SSE or NEON when available. The cost of the filter
+is thus proportional to the number of non-zero coefficients rather than to N.
+
 \image html AsyncAudioFsfExample.png "Example filter frequency response (blue) and phase response (red)"
 
 \include AsyncAudioFsf_demo.cpp
@@ -204,11 +208,18 @@ class AudioFsf : public Async::AudioProcessor
 
   private:
     class CombFilter;
-    class Resonator;
 
-    CombFilter *            m_combN;
-    CombFilter *            m_comb2;
-    std::vector<Resonator*> m_resonators;
+    CombFilter *        m_combN;
+    CombFilter *        m_comb2;
+    size_t              m_lane_cnt;
+    std::vector<float>  m_gain;
+    std::vector<float>  m_coeff1;
+    std::vector<float>  m_coeff2;
+    std::vector<float>  m_z1;
+    std::vector<float>  m_z2;
+
+    void addResonator(size_t N, size_t k, float r, float H);
+    void processResonators(float *dest, const float *src, int count);
 
     AudioFsf(const AudioFsf&);
     AudioFsf& operator=(const AudioFsf&);
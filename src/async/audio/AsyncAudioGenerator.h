@@ -46,6 +46,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncAudioSource.h>
+#include <AsyncAudioOscillator.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -165,6 +167,7 @@ class AudioGenerator : public Async::AudioSource
     {
       m_arginc = 2.0f * M_PI * tone_fq / m_sample_rate;
       assert(m_arginc <= M_PI);
+      m_osc.setFq(tone_fq, m_sample_rate);
     }
 
     /**
@@ -191,6 +194,7 @@ class AudioGenerator : public Async::AudioSource
       if (enable)
       {
         m_arg = 0.0f;
+        m_osc.reset();
         writeSamples();
       }
       else
@@ -231,6 +235,7 @@ class AudioGenerator : public Async::AudioSource
     Waveform  m_waveform;
     float     m_power;
     bool      m_enabled;
+    AudioOscillator m_osc;
 
     AudioGenerator(const AudioGenerator&);
     AudioGenerator& operator=(const AudioGenerator&);
@@ -256,6 +261,51 @@ class AudioGenerator : public Async::AudioSource
           m_peak = 0.0f;
           break;
       }
+      m_osc.setAmplitude(m_peak);
+    }
+
+    /**
+     * @brief   Fill a block with a square or triangular wave
+     * @param   buf The buffer to fill with BLOCK_SIZE samples
+     */
+    void fillWaveform(float *buf)
+    {
+      float arg = m_arg;
+      for (int i=0; i<BLOCK_SIZE; ++i)
+      {
+        switch (m_waveform)
+        {
+          case SQUARE:
+            buf[i] = (arg < M_PI) ? m_peak : -m_peak;
+            break;
+          case TRIANGLE:
+            if (arg < M_PI / 2.0f)
+            {
+              buf[i] = m_peak * arg * 2.0f / M_PI;
+            }
+            else if (arg < M_PI)
+            {
+              buf[i] = m_peak * (2.0f - 2.0 * arg / M_PI);
+            }
+            else if (arg < 3.0f * M_PI / 2.0f)
+            {
+              buf[i] = -m_peak * (2.0f * arg / M_PI - 2.0f);
+            }
+            else
+            {
+              buf[i] = -m_peak * (4.0f - 2.0f * arg / M_PI);
+            }
+            break;
+          default:
+            buf[i] = 0;
+            break;
+        }
+        arg += m_arginc;
+        if (arg >= 2.0f * M_PI)
+        {
+          arg -= 2.0f * M_PI;
+        }
+      }
     }
 
     /**
@@ -267,46 +317,19 @@ class AudioGenerator : public Async::AudioSource
       do
       {
         float buf[BLOCK_SIZE];
-        float arg = m_arg;
-        for (int i=0; i<BLOCK_SIZE; ++i)
+        if (m_waveform == SIN)
         {
-          switch (m_waveform)
-          {
-            case SIN:
-              buf[i] = m_peak * sinf(arg);
-              break;
-            case SQUARE:
-              buf[i] = (arg < M_PI) ? m_peak : -m_peak;
-              break;
-            case TRIANGLE:
-              if (arg < M_PI / 2.0f)
-              {
-                buf[i] = m_peak * arg * 2.0f / M_PI;
-              }
-              else if (arg < M_PI)
-              {
-                buf[i] = m_peak * (2.0f - 2.0 * arg / M_PI);
-              }
-              else if (arg < 3.0f * M_PI / 2.0f)
-              {
-                buf[i] = -m_peak * (2.0f * arg / M_PI - 2.0f);
-              }
-              else
-              {
-                buf[i] = -m_peak * (4.0f - 2.0f * arg / M_PI);
-              }
-              break;
-            default:
-              buf[i] = 0;
-              break;
-          }
-          arg += m_arginc;
-          if (arg >= 2.0f * M_PI)
-          {
-            arg -= 2.0f * M_PI;
-          }
+          m_osc.generate(buf, BLOCK_SIZE);
+        }
+        else
+        {
+          fillWaveform(buf);
         }
         written = sinkWriteSamples(buf, BLOCK_SIZE);
+        if (m_waveform == SIN)
+        {
+          m_osc.advance(written - BLOCK_SIZE);
+        }
         if (written > 0)
         {
           m_arg += written * m_arginc;
@@ -43,6 +43,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cassert>
 #include <cerrno>
 #include <cmath>
+#include <sstream>
 
 
 /****************************************************************************
@@ -66,6 +67,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "AsyncAudioValve.h"
 #include "AsyncAudioIO.h"
 #include "AsyncAudioDebugger.h"
+#include "AsyncAudioLatencyTrace.h"
+#include "AsyncAudioLatencyBudget.h"
 
 
 
@@ -167,6 +170,7 @@ class Async::AudioIO::DelayedFlushAudioReader
     {
       is_idle = false;
       flush_timer.setEnable(false);
+      AudioLatencyTrace::stage("playback");
       return AudioReader::writeSamples(samples, count);
     }
     
@@ -316,6 +320,24 @@ bool AudioIO::isFullDuplexCapable(void)
 } /* AudioIO::isFullDuplexCapable */
 
 
+void AudioIO::setDeviceBlocksize(int size)
+{
+  if (audio_dev != 0)
+  {
+    audio_dev->setDeviceBlocksize(size);
+  }
+} /* AudioIO::setDeviceBlocksize */
+
+
+void AudioIO::setDeviceBlockCount(int count)
+{
+  if (audio_dev != 0)
+  {
+    audio_dev->setDeviceBlockCount(count);
+  }
+} /* AudioIO::setDeviceBlockCount */
+
+
 bool AudioIO::open(Mode mode)
 {
   if (m_channel >= AudioDevice::getChannels())
@@ -350,8 +372,17 @@ bool AudioIO::open(Mode mode)
   if (open_ok)
   {
     io_mode = mode;
-    input_fifo->setSize(audio_dev->writeBlocksize() * 2 + 1);
-    input_fifo->setPrebufSamples(audio_dev->writeBlocksize() * 2 + 1);
+    const unsigned blocksize = audio_dev->writeBlocksize();
+    input_fifo->setSize(blocksize * 2 + 1);
+      // An adaptive prebuffer keep its size between transmissions
+    if (!input_fifo->prebufIsAdaptive())
+    {
+      input_fifo->setPrebufSamples(blocksize * 2 + 1);
+    }
+    std::ostringstream fifo_name;
+    fifo_name << audio_dev->devName() << ":" << m_channel << ":input_fifo";
+    AudioLatencyBudget::add(fifo_name.str(), input_fifo, blocksize,
+                            blocksize * 2);
   }
   
   input_valve->setOpen(true);
@@ -385,6 +416,23 @@ void AudioIO::close(void)
 } /* AudioIO::close */
 
 
+int AudioIO::samplesToWrite(void) const
+{
+  if ((io_mode != MODE_WR) && (io_mode != MODE_RDWR))
+  {
+    return 0;
+  }
+
+  const int dev_samples = audio_dev->samplesToWrite();
+  if (dev_samples < 0)
+  {
+    return -1;
+  }
+
+  return input_fifo->samplesInFifo(true) + dev_samples;
+} /* AudioIO::samplesToWrite */
+
+
 
 /****************************************************************************
  *
@@ -226,6 +226,31 @@ class AudioIO : public Async::AudioSource, public Async::AudioSink
      *	        \em false if it is not
      */
     bool isFullDuplexCapable(void);
+
+    /**
+     * @brief 	Set the block size to use for the associated audio device
+     * @param 	size  The block size in samples per channel or 0 to use the
+     *                global setting
+     *
+     * Use this function to override the global block size, set using
+     * setBlocksize, for the audio device that this object is associated
+     * with. Since the audio device is shared by all AudioIO objects using it,
+     * all of them will be affected. The setting is used the next time the
+     * audio device is opened.
+     */
+    void setDeviceBlocksize(int size);
+
+    /**
+     * @brief 	Set the block count to use for the associated audio device
+     * @param 	count The block count or 0 to use the global setting
+     *
+     * Use this function to override the global block count, set using
+     * setBlockCount, for the audio device that this object is associated
+     * with. Since the audio device is shared by all AudioIO objects using it,
+     * all of them will be affected. The setting is used the next time the
+     * audio device is opened.
+     */
+    void setDeviceBlockCount(int count);
   
     /**
      * @brief 	Open the audio device in the specified mode
@@ -248,9 +273,12 @@ class AudioIO : public Async::AudioSource, public Async::AudioSink
      * This function can be used to find out how many samples there are
      * in the output buffer at the moment. This can for example be used
      * to find out how long it will take before the output buffer has
-     * been flushed.
+     * been flushed. Both the samples buffered in this object and the
+     * samples written to the audio device but not yet played are counted.
+     * Since the audio device is shared between all AudioIO objects using
+     * it, samples written by other AudioIO objects are counted too.
      */
-    //int samplesToWrite(void) const;
+    int samplesToWrite(void) const;
     
     /*
      * @brief 	Call this method to clear all samples in the buffer
@@ -28,6 +28,8 @@ ANY KIND. See http://www.dspguru.com/wol.htm for more information.
  ****************************************************************************/
 
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -45,6 +47,8 @@ ANY KIND. See http://www.dspguru.com/wol.htm for more information.
  ****************************************************************************/
 
 #include "AsyncAudioInterpolator.h"
+#include "AsyncAudioDotProduct.h"
+#include "AsyncAudioFixedPoint.h"
 
 
 
@@ -108,15 +112,58 @@ using namespace Async;
 
 AudioInterpolator::AudioInterpolator(int interpolation_factor,
       	      	      	      	     const float *filter_coeff, int taps)
-  : factor_L(interpolation_factor), L_size(taps), p_H(filter_coeff)
+  : factor_L(interpolation_factor), p_Z(0), L_size(taps), p_H(0), q_Z(0),
+    q_H(0), q_scale(0.0f)
 {
-  //p_H = new float[taps];
-  //memcpy(p_H, filter_coeff, taps * sizeof(*p_H));
-  
   setInputOutputSampleRate(1, factor_L);
 
     // FIXME: What if L_size does not divide evenly with factor_L?
-  size_t p_Z_size = L_size / factor_L;
+  taps_per_phase = L_size / factor_L;
+
+    // Split the filter into one contiguous polyphase filter per phase. The
+    // coefficients of each phase are stored in reverse order so that each
+    // output sample is the dot product of the coefficients and a contiguous
+    // part of the delay line where the oldest sample comes first.
+  p_H = new float[factor_L * taps_per_phase];
+  for (int phase_num = 0; phase_num < factor_L; phase_num++)
+  {
+    float *p_phase = p_H + phase_num * taps_per_phase;
+    for (int tap = 0; tap < taps_per_phase; tap++)
+    {
+      p_phase[taps_per_phase - 1 - tap] =
+        filter_coeff[phase_num + tap * factor_L];
+    }
+  }
+
+    // The delay line hold the last taps_per_phase-1 input samples followed
+    // by room for one chunk of new samples
+  size_t p_Z_size = taps_per_phase - 1 + CHUNK_SIZE;
+
+  if (AudioFixedPoint::enabled())
+  {
+      // All phases use the same scaling. The interpolation gain is applied
+      // to the output together with the Q15 scaling.
+    const int h_size = factor_L * taps_per_phase;
+    int shift = 15;
+    for (int phase_num = 0; phase_num < factor_L; phase_num++)
+    {
+      shift = std::min(shift, AudioFixedPoint::coeffShift(
+            p_H + phase_num * taps_per_phase, taps_per_phase));
+    }
+    q_H = new int16_t[h_size];
+    for (int i=0; i<h_size; ++i)
+    {
+      q_H[i] = static_cast<int16_t>(lrintf(ldexpf(p_H[i], shift)));
+    }
+    q_scale = ldexpf(static_cast<float>(factor_L) / AudioFixedPoint::Q15_ONE,
+                     -shift);
+    q_Z = new int16_t[p_Z_size];
+    memset(q_Z, 0, sizeof(*q_Z) * p_Z_size);
+    delete [] p_H;
+    p_H = 0;
+    return;
+  }
+
   p_Z = new float[p_Z_size];
   memset(p_Z, 0, sizeof(*p_Z) * p_Z_size);
 } /* AudioInterpolator::AudioInterpolator */
@@ -124,7 +171,10 @@ AudioInterpolator::AudioInterpolator(int interpolation_factor,
 
 AudioInterpolator::~AudioInterpolator(void)
 {
+  delete [] q_Z;
+  delete [] q_H;
   delete [] p_Z;
+  delete [] p_H;
 } /* AudioInterpolator::~AudioInterpolator */
 
 
@@ -139,33 +189,55 @@ AudioInterpolator::~AudioInterpolator(void)
 void AudioInterpolator::processSamples(float *dest, const float *src, int count)
 {
   int orig_count = count;
-  int num_taps_per_phase = L_size / factor_L;
-  
+  const int hist_size = taps_per_phase - 1;
+
   int num_out = 0;
-  while (count-- > 0)
+  while (count > 0)
   {
-      // shift Z delay line up to make room for next sample
-    memmove(p_Z + 1, p_Z, (num_taps_per_phase - 1) * sizeof(float));
+      // copy next chunk of samples from input buffer to the end of the
+      // delay line
+    int chunk_cnt = std::min(count, static_cast<int>(CHUNK_SIZE));
+    if (q_H != 0)
+    {
+      AudioFixedPoint::floatToQ15(q_Z + hist_size, src, chunk_cnt);
+      for (int pos = 0; pos < chunk_cnt; pos++)
+      {
+        const int16_t *p_coeff = q_H;
+        for (int phase_num = 0; phase_num < factor_L; phase_num++)
+        {
+          *dest++ = q_scale *
+            AudioFixedPoint::dotProduct(p_coeff, q_Z + pos, taps_per_phase);
+          p_coeff += taps_per_phase;
+          num_out++;
+        }
+      }
+      memmove(q_Z, q_Z + chunk_cnt, hist_size * sizeof(*q_Z));
+      src += chunk_cnt;
+      count -= chunk_cnt;
+      continue;
+    }
 
-      // copy next sample from input buffer to bottom of Z delay line
-    p_Z[0] = *src++;
+    memcpy(p_Z + hist_size, src, chunk_cnt * sizeof(float));
+    src += chunk_cnt;
+    count -= chunk_cnt;
 
-      // calculate outputs
-    for (int phase_num = 0; phase_num < factor_L; phase_num++)
+    for (int pos = 0; pos < chunk_cnt; pos++)
     {
-      	// point to the current polyphase filter
-      const float *p_coeff = p_H + phase_num;
-
-      	// calculate FIR sum
-      float sum = 0.0;
-      for (int tap = 0; tap < num_taps_per_phase; tap++)
+        // calculate outputs
+      for (int phase_num = 0; phase_num < factor_L; phase_num++)
       {
-        sum += *p_coeff * p_Z[tap];
-        p_coeff += factor_L;          /* point to next coefficient */
+          // point to the current polyphase filter
+        const float *p_coeff = p_H + phase_num * taps_per_phase;
+
+          // calculate FIR sum
+        float sum = AudioDotProduct::calc(p_coeff, p_Z + pos, taps_per_phase);
+        *dest++ = sum * factor_L; /* store scaled sum and point to next output */
+        num_out++;
       }
-      *dest++ = sum * factor_L; /* store scaled sum and point to next output */
-      num_out++;
     }
+
+      // move the last hist_size samples to the start of the delay line
+    memmove(p_Z, p_Z + chunk_cnt, hist_size * sizeof(float));
   }
 
   //printf("num_out=%d  orig_count=%d\n", num_out, orig_count);
@@ -29,6 +29,7 @@ ANY KIND. See http://www.dspguru.com/wol.htm for more information.
  *
  ****************************************************************************/
 
+#include <stdint.h>
 
 
 /****************************************************************************
@@ -148,10 +149,16 @@ class AudioInterpolator : public Async::AudioProcessor
 
     
   private:
+    static const int CHUNK_SIZE = 256;
+
     const int 	factor_L;
     float     	*p_Z;
     int       	L_size;
-    const float *p_H;
+    float       *p_H;
+    int         taps_per_phase;
+    int16_t     *q_Z;
+    int16_t     *q_H;
+    float       q_scale;
 
     AudioInterpolator(const AudioInterpolator&);
     AudioInterpolator& operator=(const AudioInterpolator&);
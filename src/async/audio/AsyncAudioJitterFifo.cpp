@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <cstdio>
 #include <cstring>
+#include <cmath>
 #include <algorithm>
 #include <cassert>
 
@@ -54,6 +55,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include "AsyncAudioSampleRate.h"
 #include "AsyncAudioJitterFifo.h"
 
 
@@ -109,6 +111,14 @@ using namespace Async;
 
 static const unsigned  MAX_WRITE_SIZE = 800;
 
+  // Drift compensation controller. The fill level error is expressed in
+  // seconds. The time constant of the loop is in the order of tens of
+  // seconds so that the pitch change is inaudible.
+static const double    FILL_AVG_TAU = 0.5;
+static const double    DRIFT_KP = 0.05;
+static const double    DRIFT_KI = DRIFT_KP * DRIFT_KP / 4.0;
+static const double    MAX_DRIFT_CORRECTION = 0.005;
+
 
 /****************************************************************************
  *
@@ -119,7 +129,9 @@ static const unsigned  MAX_WRITE_SIZE = 800;
 
 AudioJitterFifo::AudioJitterFifo(unsigned fifo_size)
   : fifo_size(fifo_size), head(0), tail(0),
-    output_stopped(false), prebuf(true), is_flushing(false)
+    output_stopped(false), prebuf(true), is_flushing(false),
+    drift_comp(false), rs_ratio(1.0), rs_frac(0.0), rs_prev(0.0f),
+    fill_avg(fifo_size / 2), fill_integral(0.0)
 {
   assert(fifo_size > 0);
   fifo = new float[fifo_size];
@@ -169,6 +181,9 @@ void AudioJitterFifo::clear(void)
   tail = head = 0;
   prebuf = true;
   output_stopped = false;
+  rs_frac = 0.0;
+  rs_prev = 0.0f;
+  fill_avg = fifo_size / 2;
   
   if (is_flushing)
   {
@@ -181,6 +196,16 @@ void AudioJitterFifo::clear(void)
 } /* AudioJitterFifo::clear */
 
 
+void AudioJitterFifo::setDriftCompensation(bool enable)
+{
+  drift_comp = enable;
+  rs_ratio = 1.0;
+  rs_frac = 0.0;
+  fill_avg = fifo_size / 2;
+  fill_integral = 0.0;
+} /* AudioJitterFifo::setDriftCompensation */
+
+
 int AudioJitterFifo::writeSamples(const float *samples, int count)
 {
   assert(count > 0);
@@ -287,6 +312,10 @@ void AudioJitterFifo::writeSamplesFromFifo(void)
       samples_written = sinkWriteSamples(silence, MAX_WRITE_SIZE);
     } while ((samples_written > 0) && (--timeout));
   }
+  else if (drift_comp)
+  {
+    writeResampledFromFifo(samples_written);
+  }
   else
   {
     do
@@ -319,6 +348,96 @@ void AudioJitterFifo::writeSamplesFromFifo(void)
 } /* writeSamplesFromFifo */
 
 
+void AudioJitterFifo::writeResampledFromFifo(int &samples_written)
+{
+  samples_written = 1;
+  while ((samples_written > 0) && !empty())
+  {
+    unsigned avail = samplesInFifo();
+
+      // Four point interpolation need two samples after the read position.
+      // The last few samples of a flushed stream are written as they are.
+    if (avail < 3)
+    {
+      if (!is_flushing)
+      {
+        break;
+      }
+      int samples_to_write = min(avail, fifo_size - tail);
+      samples_written = sinkWriteSamples(fifo+tail, samples_to_write);
+      if (samples_written > 0)
+      {
+        rs_prev = fifoSample(samples_written - 1);
+      }
+      tail = (tail + samples_written) % fifo_size;
+      rs_frac = 0.0;
+      continue;
+    }
+
+    float buf[MAX_WRITE_SIZE];
+    int cnt = 0;
+    while (cnt < static_cast<int>(MAX_WRITE_SIZE))
+    {
+      double pos = rs_frac + cnt * rs_ratio;
+      unsigned idx = static_cast<unsigned>(pos);
+      if (idx + 2 >= avail)
+      {
+        break;
+      }
+      float t = pos - idx;
+      float xm1 = (idx > 0) ? fifoSample(idx - 1) : rs_prev;
+      float x0 = fifoSample(idx);
+      float x1 = fifoSample(idx + 1);
+      float x2 = fifoSample(idx + 2);
+
+        // 4-point, 3rd-order Hermite interpolation
+      float c1 = 0.5f * (x1 - xm1);
+      float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+      float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+      buf[cnt++] = ((c3 * t + c2) * t + c1) * t + x0;
+    }
+
+    samples_written = sinkWriteSamples(buf, cnt);
+    if (samples_written > 0)
+    {
+      updateDriftCorrection(avail, samples_written);
+    }
+
+    double next_pos = rs_frac + samples_written * rs_ratio;
+    unsigned consumed = static_cast<unsigned>(next_pos);
+    if (consumed > 0)
+    {
+      rs_prev = fifoSample(consumed - 1);
+    }
+    tail = (tail + consumed) % fifo_size;
+    rs_frac = next_pos - consumed;
+  }
+} /* AudioJitterFifo::writeResampledFromFifo */
+
+
+void AudioJitterFifo::updateDriftCorrection(unsigned samples_in_fifo,
+                                            int samples_out)
+{
+    // Low pass filter the fill level to even out packet jitter. The time
+    // is measured in output samples.
+  double dt = static_cast<double>(samples_out) / INTERNAL_SAMPLE_RATE;
+  double alpha = min(1.0, dt / FILL_AVG_TAU);
+  fill_avg += alpha * (samples_in_fifo - fill_avg);
+
+  double err = (fill_avg - fifo_size / 2) / INTERNAL_SAMPLE_RATE;
+  fill_integral += err * dt;
+
+    // Limit the integral so that it cannot wind up beyond what is needed
+    // to reach the maximum correction
+  double max_integral = MAX_DRIFT_CORRECTION / DRIFT_KI;
+  fill_integral = max(-max_integral, min(max_integral, fill_integral));
+
+  double corr = DRIFT_KP * err + DRIFT_KI * fill_integral;
+  corr = max(-MAX_DRIFT_CORRECTION, min(MAX_DRIFT_CORRECTION, corr));
+  rs_ratio = 1.0 + corr;
+} /* AudioJitterFifo::updateDriftCorrection */
+
+
 
 /*
  * This file has not been truncated
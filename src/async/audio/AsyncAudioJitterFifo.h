@@ -116,6 +116,13 @@ of sample rate or packet jitter. Under normal operation, the FIFO is kept
 half full. Varying sample rates or packet rates slowly move the amount of
 samples out of center. When the FIFO reaches a full or empty state, it is
 automatically reset to the half-full state.
+
+If the source and the sink run on different clocks, the difference in sample
+rate will slowly move the fill level until the FIFO overflows or runs empty,
+which is heard as a glitch. Enable drift compensation to avoid that. The
+output is then resampled with a ratio, very close to one, that is
+continuously adjusted by a PI controller to keep the FIFO half full. The
+FIFO can then be made smaller since it only has to absorb the jitter.
 */
 class AudioJitterFifo : public AudioSink, public AudioSource
 {
@@ -162,6 +169,28 @@ class AudioJitterFifo : public AudioSink, public AudioSource
      */
     void clear(void);
 
+    /**
+     * @brief   Enable or disable clock drift compensation
+     * @param   enable Set to \em true to enable drift compensation
+     *
+     * When enabled, the output is resampled to follow the rate of the
+     * incoming samples so that the FIFO is kept half full.
+     */
+    void setDriftCompensation(bool enable);
+
+    /**
+     * @brief   Check if clock drift compensation is enabled
+     * @return  Returns \em true if drift compensation is enabled
+     */
+    bool driftCompensation(void) const { return drift_comp; }
+
+    /**
+     * @brief   Get the current drift correction
+     * @return  Returns the relative rate correction, e.g. 1E-4 means that
+     *          the FIFO is read 100ppm faster than the nominal rate
+     */
+    double driftCorrection(void) const { return rs_ratio - 1.0; }
+
     /**
      * @brief 	Write samples into the FIFO
      * @param 	samples The buffer containing the samples
@@ -212,8 +241,20 @@ class AudioJitterFifo : public AudioSink, public AudioSource
     bool      	output_stopped;
     bool      	prebuf;
     bool      	is_flushing;
+    bool        drift_comp;
+    double      rs_ratio;
+    double      rs_frac;
+    float       rs_prev;
+    double      fill_avg;
+    double      fill_integral;
     
     void writeSamplesFromFifo(void);
+    void writeResampledFromFifo(int &samples_written);
+    void updateDriftCorrection(unsigned samples_in_fifo, int samples_out);
+    float fifoSample(unsigned offset) const
+    {
+      return fifo[(tail + offset) % fifo_size];
+    }
 
 };  /* class AudioJitterFifo */
 
@@ -0,0 +1,258 @@
+/**
+@file   AsyncAudioLatencyBudget.cpp
+@brief  Keep track of the prebuffers of the FIFOs in the audio pipes
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <map>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <iomanip>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncMetrics.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioLatencyBudget.h"
+#include "AsyncAudioFifo.h"
+#include "AsyncAudioSampleRate.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+namespace {
+  typedef std::map<AudioFifo*, std::string> FifoMap;
+  typedef std::pair<std::string, const AudioFifo*> NamedFifo;
+
+  double toMs(unsigned samples)
+  {
+    return samples * 1000.0 / INTERNAL_SAMPLE_RATE;
+  }
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static FifoMap& fifos(void);
+static std::vector<NamedFifo> sortedFifos(void);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+bool AudioLatencyBudget::is_enabled = false;
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+void AudioLatencyBudget::add(const std::string& name, AudioFifo *fifo,
+                             unsigned min_samples, unsigned max_samples)
+{
+  static bool metrics_connected = false;
+  if (!metrics_connected)
+  {
+    Metrics::instance().collect.connect(
+        sigc::ptr_fun(&AudioLatencyBudget::writeMetrics));
+    metrics_connected = true;
+  }
+
+  fifos()[fifo] = name;
+  if (is_enabled && (max_samples > 0))
+  {
+    fifo->setAdaptivePrebuf(min_samples, max_samples);
+  }
+} /* AudioLatencyBudget::add */
+
+
+void AudioLatencyBudget::remove(AudioFifo *fifo)
+{
+  fifos().erase(fifo);
+} /* AudioLatencyBudget::remove */
+
+
+void AudioLatencyBudget::report(std::ostream& os)
+{
+  os << "Audio FIFO prebuffers, milliseconds (latency budget mode "
+     << (is_enabled ? "enabled" : "disabled") << "):\n";
+  std::vector<NamedFifo> sorted = sortedFifos();
+  if (sorted.empty())
+  {
+    os << "  No FIFOs registered\n";
+    return;
+  }
+
+  os << "  " << std::left << std::setw(28) << "FIFO" << std::right
+     << std::setw(8) << "Prebuf" << std::setw(8) << "Min"
+     << std::setw(8) << "Max" << std::setw(8) << "Low"
+     << std::setw(8) << "High" << std::setw(9) << "Streams"
+     << std::setw(10) << "Underruns" << std::setw(7) << "Grows"
+     << std::setw(8) << "Shrinks" << "\n";
+  os << std::fixed << std::setprecision(1);
+  double total_ms = 0.0;
+  for (std::vector<NamedFifo>::const_iterator it = sorted.begin();
+       it != sorted.end(); ++it)
+  {
+    const AudioFifo *fifo = it->second;
+    const AudioFifo::PrebufStats& st = fifo->prebufStats();
+    os << "  " << std::left << std::setw(28) << it->first << std::right
+       << std::setw(8) << toMs(fifo->prebufSamples());
+    if (fifo->prebufIsAdaptive())
+    {
+      os << std::setw(8) << toMs(fifo->adaptiveMinSamples())
+         << std::setw(8) << toMs(fifo->adaptiveMaxSamples());
+    }
+    else
+    {
+      os << std::setw(8) << "-" << std::setw(8) << "-";
+    }
+    os << std::setw(8) << toMs(st.low_water)
+       << std::setw(8) << toMs(st.high_water)
+       << std::setw(9) << st.streams
+       << std::setw(10) << st.underruns
+       << std::setw(7) << st.grows
+       << std::setw(8) << st.shrinks << "\n";
+    total_ms += toMs(fifo->prebufSamples());
+  }
+  os << "  Total prebuffer: " << total_ms << "ms\n";
+  os.unsetf(std::ios::floatfield);
+} /* AudioLatencyBudget::report */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void AudioLatencyBudget::writeMetrics(MetricsWriter& writer)
+{
+  const FifoMap& f = fifos();
+  for (FifoMap::const_iterator it = f.begin(); it != f.end(); ++it)
+  {
+    const AudioFifo::PrebufStats& st = it->first->prebufStats();
+    const Metrics::Labels labels(Metrics::labels("fifo", it->second));
+    writer.gauge("async_audio_fifo_prebuf_seconds",
+        "The current prebuffer size of an audio FIFO", labels,
+        it->first->prebufSamples() / static_cast<double>(INTERNAL_SAMPLE_RATE));
+    writer.gauge("async_audio_fifo_low_water_seconds",
+        "The lowest audio FIFO fill level during the last stream", labels,
+        st.low_water / static_cast<double>(INTERNAL_SAMPLE_RATE));
+    writer.counter("async_audio_fifo_underruns",
+        "The number of times an audio FIFO ran dry in a stream", labels,
+        st.underruns);
+  }
+} /* AudioLatencyBudget::writeMetrics */
+
+
+static FifoMap& fifos(void)
+{
+  static FifoMap fifo_map;
+  return fifo_map;
+} /* fifos */
+
+
+static std::vector<NamedFifo> sortedFifos(void)
+{
+  std::vector<NamedFifo> sorted;
+  const FifoMap& f = fifos();
+  for (FifoMap::const_iterator it = f.begin(); it != f.end(); ++it)
+  {
+    sorted.push_back(NamedFifo(it->second, it->first));
+  }
+  std::sort(sorted.begin(), sorted.end());
+  return sorted;
+} /* sortedFifos */
+
+
+/*
+ * This file has not been truncated
+ */
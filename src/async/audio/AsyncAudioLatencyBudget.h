@@ -0,0 +1,191 @@
+/**
+@file   AsyncAudioLatencyBudget.h
+@brief  Keep track of the prebuffers of the FIFOs in the audio pipes
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_LATENCY_BUDGET_INCLUDED
+#define ASYNC_AUDIO_LATENCY_BUDGET_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <string>
+#include <ostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class AudioFifo;
+class MetricsWriter;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Keep track of the prebuffers of the FIFOs in the audio pipes
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+Most of the delay through an audio pipe come from FIFOs that prebuffer audio
+to protect against dropouts. Each of them is normally sized for the worst
+case. The FIFOs that add delay are registered in this class under a
+descriptive name so that their contribution to the end-to-end delay can be
+reported.
+
+When the latency budget mode is enabled using setEnabled, the registered
+FIFOs that have been given prebuffer limits are switched to adaptive
+prebuffering, see Async::AudioFifo::setAdaptivePrebuf. Each FIFO then measure
+its own underrun risk and shrink or grow its prebuffer within the limits.
+FIFOs registered without limits, e.g. because they are adapted by their
+owner, are only reported.
+
+The statistics are printed using report and are exported through
+Async::Metrics as async_audio_fifo_prebuf_seconds,
+async_audio_fifo_low_water_seconds and async_audio_fifo_underruns_total.
+
+This class must only be used from the thread running the main event loop.
+*/
+class AudioLatencyBudget
+{
+  public:
+    /**
+     * @brief   Enable or disable the latency budget mode
+     * @param   enable Set to \em true to enable adaptive prebuffering
+     *
+     * This function should be called before the audio pipes are set up.
+     */
+    static void setEnabled(bool enable) { is_enabled = enable; }
+
+    /**
+     * @brief   Check if the latency budget mode is enabled
+     * @return  Returns \em true if the mode is enabled
+     */
+    static bool isEnabled(void) { return is_enabled; }
+
+    /**
+     * @brief   Register a FIFO
+     * @param   name        A name for the FIFO used in reports
+     * @param   fifo        The FIFO to register
+     * @param   min_samples The smallest prebuffer to use in the budget mode
+     * @param   max_samples The largest prebuffer to use in the budget mode
+     *
+     * If max_samples is zero, the prebuffer of the FIFO is only reported.
+     * Registering an already registered FIFO update the name and the limits.
+     * A FIFO is automatically unregistered when it is destroyed.
+     */
+    static void add(const std::string& name, AudioFifo *fifo,
+                    unsigned min_samples=0, unsigned max_samples=0);
+
+    /**
+     * @brief   Unregister a FIFO
+     * @param   fifo The FIFO to unregister
+     */
+    static void remove(AudioFifo *fifo);
+
+    /**
+     * @brief   Print the prebuffer statistics for all registered FIFOs
+     * @param   os The stream to print to
+     */
+    static void report(std::ostream& os);
+
+  private:
+    static bool is_enabled;
+
+    AudioLatencyBudget(void);
+    static void writeMetrics(MetricsWriter& writer);
+
+};  /* class AudioLatencyBudget */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_LATENCY_BUDGET_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
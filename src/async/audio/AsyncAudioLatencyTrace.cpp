@@ -0,0 +1,318 @@
+/**
+@file   AsyncAudioLatencyTrace.cpp
+@brief  Trace the end-to-end latency of sampled audio blocks
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncMetrics.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioLatencyTrace.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+namespace {
+    // Histogram bucket upper limits in milliseconds
+  const unsigned BUCKET_LIMITS_MS[] = {
+    5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000
+  };
+  const size_t BUCKET_CNT =
+    sizeof(BUCKET_LIMITS_MS) / sizeof(BUCKET_LIMITS_MS[0]);
+
+  struct StageStats
+  {
+    uint64_t  count;
+    uint64_t  sum_ns;
+    uint64_t  min_ns;
+    uint64_t  max_ns;
+    uint64_t  last_ns;
+    uint64_t  buckets[BUCKET_CNT];
+
+    StageStats(void) : count(0), sum_ns(0), min_ns(0), max_ns(0), last_ns(0)
+    {
+      std::fill_n(buckets, BUCKET_CNT, 0);
+    }
+    double avgNs(void) const
+    {
+      return (count > 0) ? static_cast<double>(sum_ns) / count : 0.0;
+    }
+  };
+  typedef std::map<std::string, StageStats> StageMap;
+
+  struct AvgLess
+  {
+    bool operator()(const StageMap::value_type* a,
+                    const StageMap::value_type* b) const
+    {
+      return a->second.avgNs() < b->second.avgNs();
+    }
+  };
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static StageMap& stages(void);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+uint64_t AudioLatencyTrace::current_mark = 0;
+unsigned AudioLatencyTrace::interval_ms = 0;
+uint64_t AudioLatencyTrace::next_mark = 0;
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+void AudioLatencyTrace::setInterval(unsigned interval_ms)
+{
+  AudioLatencyTrace::interval_ms = interval_ms;
+  next_mark = 0;
+} /* AudioLatencyTrace::setInterval */
+
+
+uint64_t AudioLatencyTrace::now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+} /* AudioLatencyTrace::now */
+
+
+uint64_t AudioLatencyTrace::newCaptureMark(unsigned age_us)
+{
+  if (interval_ms == 0)
+  {
+    return 0;
+  }
+  uint64_t t = now();
+  if (t < next_mark)
+  {
+    return 0;
+  }
+  next_mark = t + static_cast<uint64_t>(interval_ms) * 1000000ULL;
+  return t - static_cast<uint64_t>(age_us) * 1000ULL;
+} /* AudioLatencyTrace::newCaptureMark */
+
+
+void AudioLatencyTrace::record(const std::string& name, uint64_t mark)
+{
+  static bool metrics_connected = false;
+  if (!metrics_connected)
+  {
+    Metrics::instance().collect.connect(
+        sigc::ptr_fun(&AudioLatencyTrace::writeMetrics));
+    metrics_connected = true;
+  }
+
+    // A mark from a host with a clock that is ahead of ours is recorded as
+    // zero latency
+  uint64_t t = now();
+  uint64_t latency_ns = (t > mark) ? t - mark : 0;
+
+  StageStats& s = stages()[name];
+  if ((s.count == 0) || (latency_ns < s.min_ns))
+  {
+    s.min_ns = latency_ns;
+  }
+  if (latency_ns > s.max_ns)
+  {
+    s.max_ns = latency_ns;
+  }
+  s.last_ns = latency_ns;
+  s.sum_ns += latency_ns;
+  s.count += 1;
+  for (size_t i=0; i<BUCKET_CNT; ++i)
+  {
+    if (latency_ns <= BUCKET_LIMITS_MS[i] * 1000000ULL)
+    {
+      s.buckets[i] += 1;
+      break;
+    }
+  }
+} /* AudioLatencyTrace::record */
+
+
+void AudioLatencyTrace::report(std::ostream& os)
+{
+  os << "Audio latency trace, milliseconds since capture";
+  if (interval_ms > 0)
+  {
+    os << " (one mark every " << interval_ms << "ms)";
+  }
+  os << ":\n";
+  const StageMap& s = stages();
+  if (s.empty())
+  {
+    os << "  No marks recorded\n";
+    return;
+  }
+  std::vector<const StageMap::value_type*> sorted;
+  for (StageMap::const_iterator it = s.begin(); it != s.end(); ++it)
+  {
+    sorted.push_back(&(*it));
+  }
+  std::stable_sort(sorted.begin(), sorted.end(), AvgLess());
+
+  os << "  " << std::left << std::setw(20) << "Stage" << std::right
+     << std::setw(8) << "Count" << std::setw(10) << "Last"
+     << std::setw(10) << "Min" << std::setw(10) << "Avg"
+     << std::setw(10) << "Max" << "\n";
+  os << std::fixed << std::setprecision(1);
+  for (std::vector<const StageMap::value_type*>::const_iterator it =
+         sorted.begin(); it != sorted.end(); ++it)
+  {
+    const StageStats& st = (*it)->second;
+    os << "  " << std::left << std::setw(20) << (*it)->first << std::right
+       << std::setw(8) << st.count
+       << std::setw(10) << st.last_ns / 1e6
+       << std::setw(10) << st.min_ns / 1e6
+       << std::setw(10) << st.avgNs() / 1e6
+       << std::setw(10) << st.max_ns / 1e6 << "\n";
+  }
+  os.unsetf(std::ios::floatfield);
+} /* AudioLatencyTrace::report */
+
+
+void AudioLatencyTrace::reset(void)
+{
+  stages().clear();
+} /* AudioLatencyTrace::reset */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void AudioLatencyTrace::writeMetrics(MetricsWriter& writer)
+{
+  const StageMap& s = stages();
+  for (StageMap::const_iterator it = s.begin(); it != s.end(); ++it)
+  {
+    const StageStats& st = it->second;
+    std::vector<MetricsWriter::Bucket> buckets;
+    uint64_t cumulative = 0;
+    for (size_t i=0; i<BUCKET_CNT; ++i)
+    {
+      cumulative += st.buckets[i];
+      buckets.push_back(
+          MetricsWriter::Bucket(BUCKET_LIMITS_MS[i] / 1000.0, cumulative));
+    }
+    writer.histogram("async_audio_latency_seconds",
+        "Time since capture for sampled audio blocks reaching a stage",
+        Metrics::labels("stage", it->first), buckets, st.count,
+        st.sum_ns / 1e9);
+  }
+} /* AudioLatencyTrace::writeMetrics */
+
+
+static StageMap& stages(void)
+{
+  static StageMap stage_map;
+  return stage_map;
+} /* stages */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,314 @@
+/**
+@file   AsyncAudioLatencyTrace.h
+@brief  Trace the end-to-end latency of sampled audio blocks
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_LATENCY_TRACE_INCLUDED
+#define ASYNC_AUDIO_LATENCY_TRACE_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <string>
+#include <ostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioPassthrough.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class MetricsWriter;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Trace the latency of sampled audio blocks through the audio pipe
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class is used to find out how long it take for audio to travel from the
+capture device, through the audio pipe and possibly over the network, to the
+point where it is played back. A capture mark, the wall clock time in
+nanoseconds when the first sample of a block was captured, is created at a
+configurable interval by the audio device. The mark is not stored in the
+samples themselves. Instead it is made current, using a Scope object, while
+the block is written into the audio pipe. Any node that is called while the
+mark is current can record the time since capture under a stage name using
+the stage function.
+
+Audio pipe nodes that buffer samples must store the mark together with the
+samples and make it current again when the samples are written out. The
+Async::AudioFifo do this. A mark is lost in nodes that buffer without doing
+so. The network links carry the mark in an optional message field so that
+the latency at the remote end can be recorded as well. Comparing times from
+different hosts require their clocks to be synchronized, e.g. using NTP.
+
+Marks are created only when enabled using setInterval but stages are always
+recorded when a mark is current, so a receiving node record remote marks
+without any configuration. The cost for audio without a mark is the test of
+a static variable.
+
+The statistics are printed using report and exported as a histogram, named
+async_audio_latency_seconds, through Async::Metrics.
+
+This class must only be used from the thread running the main event loop.
+*/
+class AudioLatencyTrace
+{
+  public:
+    /**
+     * @brief   Make a capture mark current while writing audio
+     *
+     * An object of this class is created on the stack around the write of
+     * a block of samples into the audio pipe. The previously current mark is
+     * restored when the object is destroyed. A mark of zero hide any current
+     * mark, which is used when writing samples that does not belong to the
+     * block that is being written.
+     */
+    class Scope
+    {
+      public:
+        explicit Scope(uint64_t mark) : saved_mark(current_mark)
+        {
+          current_mark = mark;
+        }
+        ~Scope(void) { current_mark = saved_mark; }
+
+      private:
+        uint64_t saved_mark;
+
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+    };
+
+    /**
+     * @brief   Set the interval between capture marks
+     * @param   interval_ms The interval in milliseconds. Zero disable marks.
+     */
+    static void setInterval(unsigned interval_ms);
+
+    /**
+     * @brief   Get the interval between capture marks
+     * @return  Returns the interval in milliseconds, zero if disabled
+     */
+    static unsigned interval(void) { return interval_ms; }
+
+    /**
+     * @brief   Check if capture marks are created
+     * @return  Returns \em true if capture marks are enabled
+     */
+    static bool isEnabled(void) { return interval_ms > 0; }
+
+    /**
+     * @brief   Get the current wall clock time
+     * @return  Returns the time in nanoseconds since the epoch
+     */
+    static uint64_t now(void);
+
+    /**
+     * @brief   Create a new capture mark if one is due
+     * @param   age_us  How long ago the first sample was captured, in us
+     * @return  Returns a new mark or zero if no mark is due
+     *
+     * This function is called by the capture device for each block of
+     * captured samples.
+     */
+    static uint64_t newCaptureMark(unsigned age_us);
+
+    /**
+     * @brief   Get the current mark
+     * @return  Returns the mark current in this call chain or zero
+     */
+    static uint64_t current(void) { return current_mark; }
+
+    /**
+     * @brief   Record the latency for a stage if a mark is current
+     * @param   name  The name of the stage
+     */
+    static void stage(const char *name)
+    {
+      if (current_mark != 0)
+      {
+        record(name, current_mark);
+      }
+    }
+
+    /**
+     * @brief   Record the latency for a stage
+     * @param   name  The name of the stage
+     * @param   mark  The capture mark to record the latency for
+     */
+    static void record(const std::string& name, uint64_t mark);
+
+    /**
+     * @brief   Print the collected statistics
+     * @param   os  The stream to print the report to
+     *
+     * The stages are sorted in ascending order of average latency, which
+     * normally is the order in which they are passed.
+     */
+    static void report(std::ostream& os);
+
+    /**
+     * @brief   Clear the collected statistics
+     */
+    static void reset(void);
+
+  private:
+    static uint64_t current_mark;
+    static unsigned interval_ms;
+    static uint64_t next_mark;
+
+    AudioLatencyTrace(void);
+    static void writeMetrics(MetricsWriter& writer);
+
+};  /* class AudioLatencyTrace */
+
+
+/**
+@brief  An audio pipe node that record a latency trace stage
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+Insert an object of this class into the audio pipe to record the time since
+capture of sampled blocks passing that point. The stage is recorded before
+the samples are written on to the next node, so the time used further down
+the pipe is not included.
+*/
+class AudioLatencyStage : public AudioPassthrough
+{
+  public:
+    /**
+     * @brief   Constructor
+     * @param   name  The name of the stage
+     */
+    explicit AudioLatencyStage(const std::string& name) : m_name(name) {}
+
+    /**
+     * @brief   Write samples into this audio sink
+     * @param   samples The buffer containing the samples
+     * @param   count   The number of samples in the buffer
+     * @return  Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *samples, int count)
+    {
+      AudioLatencyTrace::stage(m_name.c_str());
+      return sinkWriteSamples(samples, count);
+    }
+
+    /**
+     * @brief   Get a buffer in the connected sink to write samples into
+     * @param   count The number of samples that the source want to write
+     * @return  Returns a buffer with room for count samples or 0
+     */
+    virtual float *writeBuffer(int count) { return sinkWriteBuffer(count); }
+
+    /**
+     * @brief   Commit samples written into the buffer from writeBuffer
+     * @param   count The number of samples written
+     */
+    virtual void commitSamples(int count)
+    {
+      AudioLatencyTrace::stage(m_name.c_str());
+      sinkCommitSamples(count);
+    }
+
+  private:
+    std::string m_name;
+
+};  /* class AudioLatencyStage */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_LATENCY_TRACE_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
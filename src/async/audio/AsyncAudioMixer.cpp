@@ -54,6 +54,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "AsyncAudioMixer.h"
 #include "AsyncAudioFifo.h"
 #include "AsyncAudioReader.h"
+#include "AsyncAudioSampleOps.h"
 
 
 
@@ -360,11 +361,7 @@ void AudioMixer::outputHandler(Timer *t)
 	{
 	  unsigned samples_read = (*it)->readSamples(tmp, samples_to_read);
 	  assert(samples_read == samples_to_read);
-
-	  for (unsigned i=0; i<samples_to_read; ++i)
-	  {
-      	    outbuf[i] += tmp[i];
-	  }
+	  AudioSampleOps::mix(outbuf, tmp, samples_to_read);
 	}
       }
 
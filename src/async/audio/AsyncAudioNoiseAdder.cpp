@@ -38,7 +38,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cstdlib>
 #include <cmath>
 #include <locale>
-#include <limits>
 
 
 /****************************************************************************
@@ -116,8 +115,7 @@ using namespace Async;
  ****************************************************************************/
 
 AudioNoiseAdder::AudioNoiseAdder(float level_db)
-  : sigma(sqrt(powf(10.0f, level_db / 10.0f) / 2.0f)), z1(0.0f),
-    generate(false), seed(0)
+  : sigma(sqrt(powf(10.0f, level_db / 10.0f) / 2.0f))
 {
 } /* AudioNoiseAdder::AudioNoiseAdder */
 
@@ -137,12 +135,8 @@ AudioNoiseAdder::~AudioNoiseAdder(void)
 void AudioNoiseAdder::processSamples(float *dest, const float *src, int count)
 {
   //cout << "AudioNoiseAdder::processSamples: len=" << len << endl;
-  
-  for (int i=0; i<count; ++i)
-  {
-    float noise = generateGaussianNoise();
-    dest[i] = src[i] + noise;
-  }
+
+  noise.add(dest, src, count, sigma);
 } /* AudioNoiseAdder::writeSamples */
 
 
@@ -153,31 +147,6 @@ void AudioNoiseAdder::processSamples(float *dest, const float *src, int count)
  *
  ****************************************************************************/
 
-float AudioNoiseAdder::generateGaussianNoise(void)
-{
-  static const float epsilon = std::numeric_limits<float>::min();
-  static const float two_pi = 2.0f * M_PI;
-  static const float mu = 0.0f;
-
-  generate = !generate;
-
-  if (!generate)
-  {
-    return z1 * sigma + mu;
-  }
-
-  float u1, u2;
-  do
-  {
-    u1 = rand_r(&seed) * (1.0f / RAND_MAX);
-    u2 = rand_r(&seed) * (1.0f / RAND_MAX);
-  }
-  while (u1 <= epsilon);
-
-  float z0 = sqrt(-2.0f * log(u1)) * cos(two_pi * u2);
-  z1 = sqrt(-2.0f * log(u1)) * sin(two_pi * u2);
-  return z0 * sigma + mu;
-} /* AudioNoiseAdder::generateGaussianNoise */
 
 
 /*
@@ -53,6 +53,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncAudioProcessor.h>
+#include <AsyncAudioNoiseGenerator.h>
 
 
 
@@ -110,10 +111,8 @@ namespace Async
 @date   2015-03-08
 
 This class implement a noise generator that add white gaussian noise to an
-audio stream. The noise is generated using the Box-Muller transform which for
-example is described on Wikipedia:
-
-  http://en.wikipedia.org/wiki/Box%E2%80%93Muller_transform
+audio stream. The noise is generated by an AudioNoiseGenerator, a block at a
+time.
 
 The class is not implemented as a pure audio source but rather as an audio pipe
 component that should be inserted in the audio path.
@@ -154,14 +153,11 @@ class AudioNoiseAdder : public AudioProcessor
     void processSamples(float *dest, const float *src, int count);
 
   private:
-    float sigma;        // Standard deviation of the generated noise
-    float z1;
-    bool generate;
-    unsigned int seed;
+    float               sigma;  // Standard deviation of the generated noise
+    AudioNoiseGenerator noise;
 
     AudioNoiseAdder(const AudioNoiseAdder&);
     AudioNoiseAdder& operator=(const AudioNoiseAdder&);
-    float generateGaussianNoise(void);
 
 };  /* class AudioNoiseAdder */
 
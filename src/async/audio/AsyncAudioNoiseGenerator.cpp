@@ -0,0 +1,495 @@
+/**
+@file   AsyncAudioNoiseGenerator.cpp
+@brief  A fast block based gaussian noise generator
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains the implementation of the AudioNoiseGenerator class and
+its random bit kernels.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ASYNC_NOISE_X86
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ASYNC_NOISE_NEON
+#include <arm_neon.h>
+#endif
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioNoiseGenerator.h"
+#include "AsyncAudioCpuFeatures.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+namespace {
+  const int LANES = 8;
+
+  /*
+   * The tables for the 128 layer Ziggurat, as given by Marsaglia and Tsang in
+   * "The Ziggurat Method for Generating Random Variables", 2000
+   */
+  struct ZigguratTables
+  {
+    static const double R;
+
+    uint32_t  kn[128];
+    float     wn[128];
+    float     fn[128];
+
+    ZigguratTables(void)
+    {
+      const double m1 = 2147483648.0;
+      const double vn = 9.91256303526217e-3;
+      double dn = R;
+      double tn = dn;
+      const double q = vn / exp(-0.5 * dn * dn);
+
+      kn[0] = static_cast<uint32_t>((dn / q) * m1);
+      kn[1] = 0;
+      wn[0] = q / m1;
+      wn[127] = dn / m1;
+      fn[0] = 1.0f;
+      fn[127] = exp(-0.5 * dn * dn);
+      for (int i=126; i>=1; --i)
+      {
+        dn = sqrt(-2.0 * log(vn / dn + exp(-0.5 * dn * dn)));
+        kn[i+1] = static_cast<uint32_t>((dn / tn) * m1);
+        tn = dn;
+        fn[i] = exp(-0.5 * dn * dn);
+        wn[i] = dn / m1;
+      }
+    }
+  };
+  const double ZigguratTables::R = 3.442619855899;
+
+  const ZigguratTables zig;
+
+  uint32_t rotl(uint32_t x, int k)
+  {
+    return (x << k) | (x >> (32 - k));
+  }
+
+  uint64_t splitmix64(uint64_t& x)
+  {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  uint32_t absHz(int32_t hz)
+  {
+    return (hz < 0) ? 0U - static_cast<uint32_t>(hz)
+                    : static_cast<uint32_t>(hz);
+  }
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void xoshiro_scalar(uint32_t state[4][LANES], uint32_t *buf,
+                           int rounds);
+#ifdef ASYNC_NOISE_X86
+static void xoshiro_avx2(uint32_t state[4][LANES], uint32_t *buf, int rounds)
+  __attribute__((target("avx2")));
+#endif
+#ifdef ASYNC_NOISE_NEON
+static void xoshiro_neon(uint32_t state[4][LANES], uint32_t *buf,
+                         int rounds);
+#endif
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+AudioNoiseGenerator::Kernel AudioNoiseGenerator::kernel =
+    AudioNoiseGenerator::selectKernel;
+const char *AudioNoiseGenerator::kernel_name = 0;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+AudioNoiseGenerator::AudioNoiseGenerator(uint64_t seed)
+{
+  setSeed(seed);
+} /* AudioNoiseGenerator::AudioNoiseGenerator */
+
+
+void AudioNoiseGenerator::setSeed(uint64_t seed)
+{
+    // Expand the seed using splitmix64, as recommended by the xoshiro
+    // authors, so that the lanes get unrelated non-zero start states
+  for (int lane=0; lane<LANES; ++lane)
+  {
+    uint64_t a = splitmix64(seed);
+    uint64_t b = splitmix64(seed);
+    state[0][lane] = static_cast<uint32_t>(a);
+    state[1][lane] = static_cast<uint32_t>(a >> 32);
+    state[2][lane] = static_cast<uint32_t>(b);
+    state[3][lane] = static_cast<uint32_t>(b >> 32);
+  }
+  buf_pos = BUF_SIZE;
+} /* AudioNoiseGenerator::setSeed */
+
+
+void AudioNoiseGenerator::generate(float *dest, int count, float sigma)
+{
+  int i = 0;
+  while (i < count)
+  {
+    if (buf_pos == BUF_SIZE)
+    {
+      kernel(state, buf, BUF_SIZE / LANES);
+      buf_pos = 0;
+    }
+
+      // The fast path of the Ziggurat is run directly on the block of
+      // random words. The rare rejected words are handled one at a time.
+    const int end = buf_pos + (((count - i) < (BUF_SIZE - buf_pos))
+                              ? (count - i) : (BUF_SIZE - buf_pos));
+    while ((buf_pos < end) && (i < count))
+    {
+      const int32_t hz = static_cast<int32_t>(buf[buf_pos++]);
+      const uint32_t iz = hz & 127;
+      if (absHz(hz) < zig.kn[iz])
+      {
+        dest[i++] = sigma * (hz * zig.wn[iz]);
+      }
+      else
+      {
+        dest[i++] = sigma * gaussianSlow(hz, iz);
+        break;
+      }
+    }
+  }
+} /* AudioNoiseGenerator::generate */
+
+
+void AudioNoiseGenerator::add(float *dest, const float *src, int count,
+                              float sigma)
+{
+  float noise[BUF_SIZE];
+  while (count > 0)
+  {
+    const int cnt = (count < BUF_SIZE) ? count : BUF_SIZE;
+    generate(noise, cnt, sigma);
+    for (int i=0; i<cnt; ++i)
+    {
+      dest[i] = src[i] + noise[i];
+    }
+    dest += cnt;
+    src += cnt;
+    count -= cnt;
+  }
+} /* AudioNoiseGenerator::add */
+
+
+float AudioNoiseGenerator::gaussian(void)
+{
+  const int32_t hz = static_cast<int32_t>(nextWord());
+  const uint32_t iz = hz & 127;
+  if (absHz(hz) < zig.kn[iz])
+  {
+    return hz * zig.wn[iz];
+  }
+  return gaussianSlow(hz, iz);
+} /* AudioNoiseGenerator::gaussian */
+
+
+const char *AudioNoiseGenerator::kernelName(void)
+{
+  if (kernel_name == 0)
+  {
+    init();
+  }
+  return kernel_name;
+} /* AudioNoiseGenerator::kernelName */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void AudioNoiseGenerator::selectKernel(uint32_t state[4][LANES],
+                                       uint32_t *buf, int rounds)
+{
+  init();
+  kernel(state, buf, rounds);
+} /* AudioNoiseGenerator::selectKernel */
+
+
+void AudioNoiseGenerator::init(void)
+{
+  AudioCpuFeatures::addDispatcher(init);
+
+  const char *force = getenv("ASYNC_AUDIO_NOISE");
+  if (force == 0)
+  {
+    force = "";
+  }
+
+#ifdef ASYNC_NOISE_X86
+  if (AudioCpuFeatures::has(AudioCpuFeatures::AVX2) &&
+      (strcmp(force, "scalar") != 0))
+  {
+    kernel_name = "avx2";
+    kernel = xoshiro_avx2;
+    return;
+  }
+#endif
+
+#ifdef ASYNC_NOISE_NEON
+  if (AudioCpuFeatures::has(AudioCpuFeatures::NEON) &&
+      (strcmp(force, "scalar") != 0))
+  {
+    kernel_name = "neon";
+    kernel = xoshiro_neon;
+    return;
+  }
+#endif
+
+  kernel_name = "scalar";
+  kernel = xoshiro_scalar;
+} /* AudioNoiseGenerator::init */
+
+
+/*
+ * The slow path of the Ziggurat, taken for about 1.2% of the samples
+ */
+float AudioNoiseGenerator::gaussianSlow(int32_t hz, uint32_t iz)
+{
+  for (;;)
+  {
+    float x = hz * zig.wn[iz];
+    if (iz == 0)
+    {
+        // Sample from the tail using the method by Marsaglia
+      float y;
+      do
+      {
+        x = -logf(uniform()) / static_cast<float>(ZigguratTables::R);
+        y = -logf(uniform());
+      } while (y + y < x * x);
+      return (hz > 0) ? ZigguratTables::R + x : -ZigguratTables::R - x;
+    }
+    if (zig.fn[iz] + uniform() * (zig.fn[iz-1] - zig.fn[iz]) <
+        expf(-0.5f * x * x))
+    {
+      return x;
+    }
+    hz = static_cast<int32_t>(nextWord());
+    iz = hz & 127;
+    if (absHz(hz) < zig.kn[iz])
+    {
+      return hz * zig.wn[iz];
+    }
+  }
+} /* AudioNoiseGenerator::gaussianSlow */
+
+
+
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+/*
+ * Step all lanes of the xoshiro128** generators the given number of rounds.
+ * The output of lane l in round r is stored in buf[r * LANES + l]. This is
+ * the reference implementation for the SIMD kernels.
+ */
+static void xoshiro_scalar(uint32_t state[4][LANES], uint32_t *buf,
+                           int rounds)
+{
+  for (int r=0; r<rounds; ++r)
+  {
+    for (int l=0; l<LANES; ++l)
+    {
+      buf[r * LANES + l] = rotl(state[1][l] * 5, 7) * 9;
+      const uint32_t t = state[1][l] << 9;
+      state[2][l] ^= state[0][l];
+      state[3][l] ^= state[1][l];
+      state[1][l] ^= state[2][l];
+      state[0][l] ^= state[3][l];
+      state[2][l] ^= t;
+      state[3][l] = rotl(state[3][l], 11);
+    }
+  }
+} /* xoshiro_scalar */
+
+
+#ifdef ASYNC_NOISE_X86
+static inline __m256i rotl_avx2(__m256i x, int k)
+  __attribute__((target("avx2"), always_inline));
+static inline __m256i rotl_avx2(__m256i x, int k)
+{
+  return _mm256_or_si256(_mm256_slli_epi32(x, k), _mm256_srli_epi32(x, 32-k));
+}
+
+
+static void xoshiro_avx2(uint32_t state[4][LANES], uint32_t *buf, int rounds)
+{
+  __m256i s0 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(state[0]));
+  __m256i s1 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(state[1]));
+  __m256i s2 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(state[2]));
+  __m256i s3 = _mm256_loadu_si256(reinterpret_cast<__m256i*>(state[3]));
+  const __m256i five = _mm256_set1_epi32(5);
+  const __m256i nine = _mm256_set1_epi32(9);
+  for (int r=0; r<rounds; ++r)
+  {
+    __m256i res = _mm256_mullo_epi32(
+        rotl_avx2(_mm256_mullo_epi32(s1, five), 7), nine);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(buf + r * LANES), res);
+    const __m256i t = _mm256_slli_epi32(s1, 9);
+    s2 = _mm256_xor_si256(s2, s0);
+    s3 = _mm256_xor_si256(s3, s1);
+    s1 = _mm256_xor_si256(s1, s2);
+    s0 = _mm256_xor_si256(s0, s3);
+    s2 = _mm256_xor_si256(s2, t);
+    s3 = rotl_avx2(s3, 11);
+  }
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[0]), s0);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[1]), s1);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[2]), s2);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(state[3]), s3);
+} /* xoshiro_avx2 */
+#endif /* ASYNC_NOISE_X86 */
+
+
+#ifdef ASYNC_NOISE_NEON
+#define ROTL_NEON(x, k) vorrq_u32(vshlq_n_u32((x), (k)), \
+                                  vshrq_n_u32((x), 32-(k)))
+
+static void xoshiro_neon(uint32_t state[4][LANES], uint32_t *buf, int rounds)
+{
+    // Eight lanes are handled as two groups of four
+  for (int half=0; half<LANES; half+=4)
+  {
+    uint32x4_t s0 = vld1q_u32(state[0] + half);
+    uint32x4_t s1 = vld1q_u32(state[1] + half);
+    uint32x4_t s2 = vld1q_u32(state[2] + half);
+    uint32x4_t s3 = vld1q_u32(state[3] + half);
+    for (int r=0; r<rounds; ++r)
+    {
+      uint32x4_t res = vmulq_n_u32(ROTL_NEON(vmulq_n_u32(s1, 5), 7), 9);
+      vst1q_u32(buf + r * LANES + half, res);
+      const uint32x4_t t = vshlq_n_u32(s1, 9);
+      s2 = veorq_u32(s2, s0);
+      s3 = veorq_u32(s3, s1);
+      s1 = veorq_u32(s1, s2);
+      s0 = veorq_u32(s0, s3);
+      s2 = veorq_u32(s2, t);
+      s3 = ROTL_NEON(s3, 11);
+    }
+    vst1q_u32(state[0] + half, s0);
+    vst1q_u32(state[1] + half, s1);
+    vst1q_u32(state[2] + half, s2);
+    vst1q_u32(state[3] + half, s3);
+  }
+} /* xoshiro_neon */
+#endif /* ASYNC_NOISE_NEON */
+
+
+/*
+ * This file has not been truncated
+ */
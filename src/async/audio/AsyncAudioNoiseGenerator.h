@@ -0,0 +1,227 @@
+/**
+@file   AsyncAudioNoiseGenerator.h
+@brief  A fast block based gaussian noise generator
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that generate gaussian white noise in blocks. The
+random bits are produced by several xoshiro128** generators in parallel using
+SIMD instructions and are turned into normally distributed samples using the
+Ziggurat method.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_NOISE_GENERATOR_INCLUDED
+#define ASYNC_AUDIO_NOISE_GENERATOR_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A fast block based gaussian noise generator
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class generate gaussian white noise with zero mean. It is used by the
+AudioNoiseAdder, the noise generators in the calibration tools and the
+simulated receivers so that noise generation do not dominate the CPU usage
+when many channels are simulated.
+
+The random bits come from eight interleaved xoshiro128** generators which are
+stepped in parallel, a block at a time, by a SIMD kernel. The kernel is
+selected at runtime like the other kernel families, see AudioCpuFeatures. On
+x86 AVX2 is used and on ARM NEON is used if the code was compiled with NEON
+support. The kernel may be forced by setting the environment variable
+ASYNC_AUDIO_NOISE to one of "scalar", "avx2" or "neon". All kernels produce
+exactly the same bit stream so the generated noise only depend on the seed.
+
+The random bits are turned into normally distributed samples using the
+Ziggurat method by Marsaglia and Tsang. Almost all samples only need one
+random word, one table lookup and one multiplication. Each generator object
+has its own state so different objects may be used in different threads.
+*/
+class AudioNoiseGenerator
+{
+  public:
+    /**
+     * @brief   Constructor
+     * @param   seed The seed for the random number generators
+     */
+    explicit AudioNoiseGenerator(uint64_t seed=0);
+
+    /**
+     * @brief   Restart the noise sequence from a new seed
+     * @param   seed The seed for the random number generators
+     */
+    void setSeed(uint64_t seed);
+
+    /**
+     * @brief   Fill a buffer with gaussian noise
+     * @param   dest  The buffer to fill
+     * @param   count The number of samples to generate
+     * @param   sigma The standard deviation of the noise
+     */
+    void generate(float *dest, int count, float sigma=1.0f);
+
+    /**
+     * @brief   Add gaussian noise to a buffer of samples
+     * @param   dest  The destination buffer, may be the same as src
+     * @param   src   The samples to add noise to
+     * @param   count The number of samples
+     * @param   sigma The standard deviation of the noise
+     */
+    void add(float *dest, const float *src, int count, float sigma);
+
+    /**
+     * @brief   Generate one gaussian sample
+     * @return  Returns a sample with zero mean and unit standard deviation
+     */
+    float gaussian(void);
+
+    /**
+     * @brief   Generate one uniformly distributed random number
+     * @return  Returns a number in the interval (0, 1)
+     */
+    float uniform(void)
+    {
+      return ((nextWord() >> 8) + 0.5f) * (1.0f / 16777216.0f);
+    }
+
+    /**
+     * @brief   Get the name of the selected random bit kernel
+     * @return  Returns the name of the kernel, e.g. "avx2"
+     */
+    static const char *kernelName(void);
+
+  private:
+    static const int LANES     = 8;
+    static const int BUF_SIZE  = 32 * LANES;
+
+    typedef void (*Kernel)(uint32_t state[4][LANES], uint32_t *buf,
+                           int rounds);
+
+    static Kernel      kernel;
+    static const char *kernel_name;
+
+    uint32_t  state[4][LANES];
+    uint32_t  buf[BUF_SIZE];
+    int       buf_pos;
+
+    static void selectKernel(uint32_t state[4][LANES], uint32_t *buf,
+                             int rounds);
+    static void init(void);
+
+    AudioNoiseGenerator(const AudioNoiseGenerator&);
+    AudioNoiseGenerator& operator=(const AudioNoiseGenerator&);
+    uint32_t nextWord(void)
+    {
+      if (buf_pos == BUF_SIZE)
+      {
+        kernel(state, buf, BUF_SIZE / LANES);
+        buf_pos = 0;
+      }
+      return buf[buf_pos++];
+    }
+    float gaussianSlow(int32_t hz, uint32_t iz);
+
+};  /* class AudioNoiseGenerator */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_NOISE_GENERATOR_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
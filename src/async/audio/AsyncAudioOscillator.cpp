@@ -0,0 +1,231 @@
+/**
+@file   AsyncAudioOscillator.cpp
+@brief  A sine wave oscillator for tone generation
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cmath>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioOscillator.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+AudioOscillator::AudioOscillator(void)
+  : m_phase(0.0), m_phase_inc(0.0), m_amp(1.0f)
+{
+} /* AudioOscillator::AudioOscillator */
+
+
+void AudioOscillator::setFq(double fq, unsigned sample_rate)
+{
+  m_phase_inc = 2.0 * M_PI * fq / sample_rate;
+} /* AudioOscillator::setFq */
+
+
+void AudioOscillator::seek(unsigned pos)
+{
+  m_phase = fmod(pos * m_phase_inc, 2.0 * M_PI);
+} /* AudioOscillator::seek */
+
+
+void AudioOscillator::advance(int count)
+{
+  m_phase = fmod(m_phase + count * m_phase_inc, 2.0 * M_PI);
+  if (m_phase < 0.0)
+  {
+    m_phase += 2.0 * M_PI;
+  }
+} /* AudioOscillator::advance */
+
+
+void AudioOscillator::generate(float *buf, int count)
+{
+  fill<false>(buf, count);
+} /* AudioOscillator::generate */
+
+
+void AudioOscillator::addTo(float *buf, int count)
+{
+  fill<true>(buf, count);
+} /* AudioOscillator::addTo */
+
+
+void AudioOscillator::applyEnvelope(float *buf, int count, int pos, int len,
+                                    int ramp_len)
+{
+  if (ramp_len <= 0)
+  {
+    return;
+  }
+
+  int up_end = min(count, ramp_len - pos);
+  for (int i=max(0, -pos); i<up_end; ++i)
+  {
+    buf[i] *= 0.5f - 0.5f * cosf(M_PI * (pos + i + 0.5f) / ramp_len);
+  }
+
+  int down_start = max(0, len - ramp_len - pos);
+  for (int i=down_start; i<count; ++i)
+  {
+    buf[i] *= 0.5f - 0.5f * cosf(M_PI * (len - pos - i - 0.5f) / ramp_len);
+  }
+} /* AudioOscillator::applyEnvelope */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+template <bool ADD>
+void AudioOscillator::fill(float *buf, int count)
+{
+  int pos = 0;
+  while (pos < count)
+  {
+    int cnt = min(count - pos, static_cast<int>(MAX_RECURSION));
+
+      // Seed the phasors from the exact phase. Lane k is k samples ahead.
+    float re[LANES], im[LANES];
+    for (int k=0; k<LANES; ++k)
+    {
+      double phase = m_phase + k * m_phase_inc;
+      re[k] = m_amp * cos(phase);
+      im[k] = m_amp * sin(phase);
+    }
+    const float rot_re = cos(LANES * m_phase_inc);
+    const float rot_im = sin(LANES * m_phase_inc);
+
+    float *out = buf + pos;
+    int i = 0;
+    for (; i+LANES<=cnt; i+=LANES)
+    {
+      for (int k=0; k<LANES; ++k)
+      {
+        out[i+k] = ADD ? out[i+k] + im[k] : im[k];
+        float tmp = re[k] * rot_re - im[k] * rot_im;
+        im[k] = re[k] * rot_im + im[k] * rot_re;
+        re[k] = tmp;
+      }
+    }
+    for (int k=0; i<cnt; ++i, ++k)
+    {
+      out[i] = ADD ? out[i] + im[k] : im[k];
+    }
+
+    advance(cnt);
+    pos += cnt;
+  }
+} /* AudioOscillator::fill */
+
+
+/*
+ * This file has not been truncated
+ */
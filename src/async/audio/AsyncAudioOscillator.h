@@ -0,0 +1,223 @@
+/**
+@file   AsyncAudioOscillator.h
+@brief  A sine wave oscillator for tone generation
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_OSCILLATOR_INCLUDED
+#define ASYNC_AUDIO_OSCILLATOR_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSampleRate.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  A sine wave oscillator for tone generation
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class generates a sine wave by rotating a phasor instead of calling the
+sin function for every sample. Four phasors, each one sample apart, are
+rotated in parallel so that the compiler can use SIMD instructions to fill a
+block of samples. The phasors are recalculated from the exact phase at the
+start of each block, and at regular intervals within long blocks, so the
+amplitude and phase do not drift.
+
+Tones can be mixed by calling addTo for more than one oscillator on the same
+buffer, like when generating DTMF. The applyEnvelope function can be used to
+ramp a tone up and down to avoid clicks, like when sending CW.
+*/
+class AudioOscillator
+{
+  public:
+    /**
+     * @brief   Default constructor
+     */
+    AudioOscillator(void);
+
+    /**
+     * @brief   Set the frequency of the oscillator
+     * @param   fq          The frequency in Hz
+     * @param   sample_rate The sampling rate in Hz
+     *
+     * The phase of the oscillator is kept when the frequency is changed.
+     */
+    void setFq(double fq, unsigned sample_rate=INTERNAL_SAMPLE_RATE);
+
+    /**
+     * @brief   Set the peak amplitude of the generated sine wave
+     * @param   amp The peak amplitude
+     */
+    void setAmplitude(float amp) { m_amp = amp; }
+
+    /**
+     * @brief   Get the peak amplitude
+     * @return  Returns the peak amplitude of the generated sine wave
+     */
+    float amplitude(void) const { return m_amp; }
+
+    /**
+     * @brief   Set the phase to that of the given sample position
+     * @param   pos The sample position, counted from phase zero
+     */
+    void seek(unsigned pos);
+
+    /**
+     * @brief   Reset the phase to zero
+     */
+    void reset(void) { m_phase = 0.0; }
+
+    /**
+     * @brief   Move the phase forward or backward
+     * @param   count The number of samples to move, negative to go back
+     *
+     * This can be used to unread samples that were generated but could not
+     * be written to a sink.
+     */
+    void advance(int count);
+
+    /**
+     * @brief   Generate samples
+     * @param   buf   The buffer to write the samples to
+     * @param   count The number of samples to generate
+     *
+     * The phase will be advanced by the given number of samples.
+     */
+    void generate(float *buf, int count);
+
+    /**
+     * @brief   Generate samples and add them to a buffer
+     * @param   buf   The buffer to add the samples to
+     * @param   count The number of samples to generate
+     *
+     * The phase will be advanced by the given number of samples.
+     */
+    void addTo(float *buf, int count);
+
+    /**
+     * @brief   Apply a raised cosine ramp to the start and end of a tone
+     * @param   buf      The buffer containing a part of the tone
+     * @param   count    The number of samples in the buffer
+     * @param   pos      The position of the first sample in the tone
+     * @param   len      The total length of the tone in samples
+     * @param   ramp_len The length of each ramp in samples
+     *
+     * Only the samples that fall within one of the ramps are touched so this
+     * function is cheap to call for each block of a tone.
+     */
+    static void applyEnvelope(float *buf, int count, int pos, int len,
+                              int ramp_len);
+
+  private:
+    static const int LANES            = 4;
+    static const int MAX_RECURSION    = 512;
+
+    double  m_phase;
+    double  m_phase_inc;
+    float   m_amp;
+
+    template <bool ADD>
+    void fill(float *buf, int count);
+
+};  /* class AudioOscillator */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_OSCILLATOR_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -33,6 +33,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef HAS_TIMERFD
+#include <sys/timerfd.h>
+#endif
 
 #include <algorithm>
 #include <cstring>
@@ -46,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncTimer.h>
+#include <AsyncFdWatch.h>
 
 
 /****************************************************************************
@@ -75,6 +81,10 @@ using namespace Async;
  *
  ****************************************************************************/
 
+  // The maximum number of missed blocks to send at once before the pacing
+  // is restarted from the current time
+#define MAX_CATCHUP_BLOCKS  4
+
 
 
 /****************************************************************************
@@ -91,6 +101,13 @@ using namespace Async;
  *
  ****************************************************************************/
 
+static inline int64_t monotonicNow(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+} /* monotonicNow */
+
 
 
 /****************************************************************************
@@ -119,7 +136,9 @@ using namespace Async;
 
 AudioPacer::AudioPacer(int sample_rate, int block_size, int prebuf_time)
   : sample_rate(sample_rate), buf_size(block_size), prebuf_time(prebuf_time),
-    buf_pos(0), pace_timer(0), do_flush(false), input_stopped(false)
+    buf_pos(0), pace_timer(0), timer_watch(0), timer_fd(-1),
+    is_pacing(false), pace_start(0), block_cnt(0), jitter_sum_us(0),
+    jitter_cnt(0), jitter_max_us(0), do_flush(false), input_stopped(false)
 {
   assert(sample_rate > 0);
   assert(block_size > 0);
@@ -128,13 +147,25 @@ AudioPacer::AudioPacer(int sample_rate, int block_size, int prebuf_time)
   buf = new float[buf_size];
   prebuf_samples = prebuf_time * sample_rate / 1000;
   
-  pace_timer = new Timer(buf_size * 1000 / sample_rate,
-       	      	      	 Timer::TYPE_PERIODIC);
-  pace_timer->expired.connect(mem_fun(*this, &AudioPacer::outputNextBlock));
+#ifdef HAS_TIMERFD
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_fd >= 0)
+  {
+    timer_watch = new FdWatch(timer_fd, FdWatch::FD_WATCH_RD);
+    timer_watch->activity.connect(
+        mem_fun(*this, &AudioPacer::timerFdActivity));
+  }
+#endif
+  if (timer_fd < 0)
+  {
+    pace_timer = new Timer(0, Timer::TYPE_ONESHOT, false);
+    pace_timer->expired.connect(
+        mem_fun(*this, &AudioPacer::paceTimerExpired));
+  }
   
-  if (prebuf_samples > 0)
+  if (prebuf_samples == 0)
   {
-    pace_timer->setEnable(false);
+    startPacing();
   }
   
 } /* AudioPacer::AudioPacer */
@@ -143,6 +174,11 @@ AudioPacer::AudioPacer(int sample_rate, int block_size, int prebuf_time)
 AudioPacer::~AudioPacer(void)
 {
   delete pace_timer;
+  delete timer_watch;
+  if (timer_fd >= 0)
+  {
+    close(timer_fd);
+  }
   delete [] buf;
 } /* AudioPacer::~AudioPacer */
 
@@ -175,7 +211,7 @@ int AudioPacer::writeSamples(const float *samples, int count)
 	samples_written += writeSamples(samples + samples_written,
 	      	      	      	      	samples_left);
       }
-      pace_timer->setEnable(true);
+      startPacing();
     }
     else
     {
@@ -192,9 +228,9 @@ int AudioPacer::writeSamples(const float *samples, int count)
     memcpy(buf + buf_pos, samples, samples_written * sizeof(*buf));
     buf_pos += samples_written;
     
-    if (!pace_timer->isEnabled())
+    if (!is_pacing)
     {
-      pace_timer->setEnable(true);
+      startPacing();
     }
   }
   
@@ -224,10 +260,24 @@ void AudioPacer::resumeOutput(void)
 {
   if (prebuf_samples <= 0)
   {
-    pace_timer->setEnable(true);
+    startPacing();
     outputNextBlock();
   }
 } /* AudioPacer::resumeOutput */
+
+
+unsigned AudioPacer::avgPacingJitter(void) const
+{
+  return (jitter_cnt > 0) ? jitter_sum_us / jitter_cnt : 0;
+} /* AudioPacer::avgPacingJitter */
+
+
+void AudioPacer::resetPacingJitter(void)
+{
+  jitter_sum_us = 0;
+  jitter_cnt = 0;
+  jitter_max_us = 0;
+} /* AudioPacer::resetPacingJitter */
     
 
 
@@ -255,11 +305,130 @@ void AudioPacer::allSamplesFlushed(void)
  ****************************************************************************/
 
 
-void AudioPacer::outputNextBlock(Timer *t)
+void AudioPacer::startPacing(void)
 {
-  if (buf_pos < buf_size)
+  if (is_pacing)
+  {
+    return;
+  }
+  is_pacing = true;
+  pace_start = monotonicNow();
+  block_cnt = 0;
+  armTimer();
+} /* AudioPacer::startPacing */
+
+
+void AudioPacer::stopPacing(void)
+{
+  is_pacing = false;
+#ifdef HAS_TIMERFD
+  if (timer_fd >= 0)
+  {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    timerfd_settime(timer_fd, 0, &its, 0);
+  }
+#endif
+  if (pace_timer != 0)
   {
     pace_timer->setEnable(false);
+  }
+} /* AudioPacer::stopPacing */
+
+
+int64_t AudioPacer::nextDeadline(void) const
+{
+    // Calculated from the start time so that rounding errors do not add up
+  return pace_start +
+         static_cast<int64_t>((block_cnt + 1) * buf_size * 1000000000ULL /
+                              sample_rate);
+} /* AudioPacer::nextDeadline */
+
+
+void AudioPacer::armTimer(void)
+{
+  int64_t deadline = nextDeadline();
+#ifdef HAS_TIMERFD
+  if (timer_fd >= 0)
+  {
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    its.it_value.tv_sec = deadline / 1000000000LL;
+    its.it_value.tv_nsec = deadline % 1000000000LL;
+    timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, 0);
+    return;
+  }
+#endif
+  int64_t wait_ns = max(deadline - monotonicNow(), static_cast<int64_t>(0));
+  pace_timer->setTimeout(static_cast<int>((wait_ns + 999999) / 1000000));
+  pace_timer->setEnable(true);
+} /* AudioPacer::armTimer */
+
+
+void AudioPacer::paceTimerExpired(Timer *t)
+{
+  handleDeadline();
+} /* AudioPacer::paceTimerExpired */
+
+
+void AudioPacer::timerFdActivity(FdWatch *w)
+{
+#ifdef HAS_TIMERFD
+  uint64_t expirations;
+  if (read(timer_fd, &expirations, sizeof(expirations)) < 0)
+  {
+    return;
+  }
+  handleDeadline();
+#endif
+} /* AudioPacer::timerFdActivity */
+
+
+void AudioPacer::handleDeadline(void)
+{
+  if (!is_pacing)
+  {
+    return;
+  }
+
+  int64_t now = monotonicNow();
+  int64_t late_us = (now - nextDeadline()) / 1000;
+  if (late_us >= 0)
+  {
+    jitter_sum_us += late_us;
+    jitter_cnt += 1;
+    jitter_max_us = max(jitter_max_us, static_cast<unsigned>(late_us));
+  }
+
+    // Send one block for each deadline that has passed. Sending a block may
+    // stop or restart the pacing so the state is checked in each iteration.
+  int blocks = 0;
+  while (is_pacing && (now >= nextDeadline()) &&
+         (blocks < MAX_CATCHUP_BLOCKS))
+  {
+    ++block_cnt;
+    ++blocks;
+    outputNextBlock();
+  }
+
+  if (is_pacing)
+  {
+    if (now >= nextDeadline())
+    {
+        // Too far behind to catch up so restart the pacing from now
+      pace_start = now;
+      block_cnt = 0;
+    }
+    armTimer();
+  }
+} /* AudioPacer::handleDeadline */
+
+
+void AudioPacer::outputNextBlock(void)
+{
+  if (buf_pos < buf_size)
+  {
+    stopPacing();
     prebuf_samples = prebuf_time * sample_rate / 1000;
   }
   
@@ -291,7 +460,7 @@ void AudioPacer::outputNextBlock(Timer *t)
   
   if (samples_written == 0)
   {
-    pace_timer->setEnable(false);
+    stopPacing();
   }
   
   if (input_stopped && (buf_pos < buf_size))
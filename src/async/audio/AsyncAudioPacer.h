@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <sigc++/sigc++.h>
+#include <stdint.h>
 
 
 /****************************************************************************
@@ -81,6 +82,7 @@ namespace Async
  ****************************************************************************/
 
 class Timer;
+class FdWatch;
   
 
 /****************************************************************************
@@ -111,6 +113,14 @@ class Timer;
 @date   2007-11-17
 
 This class is used in an audio pipe chain to pace audio output.
+
+The blocks are sent at absolute deadlines on the monotonic clock, calculated
+from the time when the pacing started. Rounding errors therefore do not
+accumulate and the output does not drift. If the main loop has been busy so
+that one or more deadlines have been missed, the missed blocks are sent at
+once to catch up, up to a limit, after which the pacing is restarted. Where
+available, a timerfd is used to wake up at the deadlines with sub-millisecond
+accuracy. Otherwise an ordinary Async::Timer is used.
 */
 class AudioPacer : public AudioSink, public AudioSource, public sigc::trackable
 {
@@ -159,6 +169,26 @@ class AudioPacer : public AudioSink, public AudioSource, public sigc::trackable
      * This function is normally only called from a connected sink object.
      */
     virtual void resumeOutput(void);
+
+    /**
+     * @brief   Get the maximum pacing jitter
+     * @return  Returns the maximum lateness, in microseconds, of a block
+     *
+     * The jitter is measured as the time between when a block should have
+     * been sent and when the pacer actually woke up to send it.
+     */
+    unsigned maxPacingJitter(void) const { return jitter_max_us; }
+
+    /**
+     * @brief   Get the average pacing jitter
+     * @return  Returns the average lateness, in microseconds, of a block
+     */
+    unsigned avgPacingJitter(void) const;
+
+    /**
+     * @brief   Reset the pacing jitter measurements
+     */
+    void resetPacingJitter(void);
     
 
   protected:
@@ -181,10 +211,25 @@ class AudioPacer : public AudioSink, public AudioSource, public sigc::trackable
     int       	  buf_pos;
     int       	  prebuf_samples;
     Async::Timer  *pace_timer;
+    Async::FdWatch *timer_watch;
+    int           timer_fd;
+    bool          is_pacing;
+    int64_t       pace_start;
+    uint64_t      block_cnt;
+    uint64_t      jitter_sum_us;
+    unsigned      jitter_cnt;
+    unsigned      jitter_max_us;
     bool      	  do_flush;
     bool      	  input_stopped;
     
-    void outputNextBlock(Async::Timer *t=0);
+    void startPacing(void);
+    void stopPacing(void);
+    int64_t nextDeadline(void) const;
+    void armTimer(void);
+    void paceTimerExpired(Async::Timer *t);
+    void timerFdActivity(Async::FdWatch *w);
+    void handleDeadline(void);
+    void outputNextBlock(void);
 
 };  /* class AudioPacer */
 
@@ -0,0 +1,505 @@
+/**
+@file   AsyncAudioPerfCounters.cpp
+@brief  Hardware performance counter sampling for DSP stages
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <unistd.h>
+#include <cxxabi.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(ASYNC_AUDIO_PROFILING) && defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#define HAS_PERF_EVENTS
+#endif
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioPerfCounters.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+  // The counters in the order they are stored after the two time values
+enum
+{
+  EV_CYCLES, EV_INSTRUCTIONS, EV_CACHE_MISSES, EV_BRANCH_MISSES, EV_CNT
+};
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+struct AudioPerfCounters::Stage
+{
+  Stage(void) : calls(0), samples(0), unscheduled(0)
+  {
+    fill_n(counts, static_cast<int>(EV_CNT), 0ULL);
+  }
+  string              name;
+  unsigned long long  calls;
+  unsigned long long  samples;
+  unsigned long long  unscheduled;
+  unsigned long long  counts[EV_CNT];
+};
+
+namespace {
+  typedef map<string, AudioPerfCounters::Stage> StageMap;
+  typedef map<const type_info*, AudioPerfCounters::Stage*> TypeMap;
+
+    // The counter group of one thread. The event slot is the position of
+    // the event in the value array read from the group leader, or -1 if the
+    // event could not be opened on this CPU.
+  struct ThreadCounters
+  {
+    ThreadCounters(void) : leader(-1), nr(0), opened(false)
+    {
+      fill_n(slot, static_cast<int>(EV_CNT), -1);
+      fill_n(fds, static_cast<int>(EV_CNT), -1);
+    }
+    ~ThreadCounters(void)
+    {
+      for (int i=0; i<EV_CNT; ++i)
+      {
+        if (fds[i] >= 0)
+        {
+          ::close(fds[i]);
+        }
+      }
+    }
+    int   leader;
+    int   nr;
+    bool  opened;
+    int   slot[EV_CNT];
+    int   fds[EV_CNT];
+  };
+
+  struct ByCycles
+  {
+    bool operator()(const AudioPerfCounters::Stage *a,
+                    const AudioPerfCounters::Stage *b) const
+    {
+      return a->counts[EV_CYCLES] > b->counts[EV_CYCLES];
+    }
+  };
+} /* anonymous namespace */
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static bool envEnabled(void);
+static StageMap& stages(void);
+static string className(const type_info& type);
+#ifdef HAS_PERF_EVENTS
+static ThreadCounters *threadCounters(void);
+static bool readCounters(ThreadCounters *tc, uint64_t *values);
+#endif
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+volatile bool AudioPerfCounters::enabled = envEnabled();
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+static pthread_mutex_t  stage_mutex = PTHREAD_MUTEX_INITIALIZER;
+#ifdef HAS_PERF_EVENTS
+static bool             open_warned = false;
+#endif
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+bool AudioPerfCounters::isAvailable(void)
+{
+#ifdef HAS_PERF_EVENTS
+  return true;
+#else
+  return false;
+#endif
+} /* AudioPerfCounters::isAvailable */
+
+
+void AudioPerfCounters::setEnabled(bool enable)
+{
+  enabled = enable && isAvailable();
+} /* AudioPerfCounters::setEnabled */
+
+
+AudioPerfCounters::Stage *AudioPerfCounters::stage(const string& name)
+{
+  pthread_mutex_lock(&stage_mutex);
+  Stage *s = &stages()[name];
+  if (s->name.empty())
+  {
+    s->name = name;
+  }
+  pthread_mutex_unlock(&stage_mutex);
+  return s;
+} /* AudioPerfCounters::stage */
+
+
+AudioPerfCounters::Stage *AudioPerfCounters::stage(const type_info& type)
+{
+  pthread_mutex_lock(&stage_mutex);
+  static TypeMap type_stages;
+  Stage *&s = type_stages[&type];
+  if (s == 0)
+  {
+    string name(className(type));
+    s = &stages()[name];
+    s->name = name;
+  }
+  Stage *ret = s;
+  pthread_mutex_unlock(&stage_mutex);
+  return ret;
+} /* AudioPerfCounters::stage */
+
+
+void AudioPerfCounters::report(ostream& os)
+{
+  if (!isAvailable())
+  {
+    os << "*** Performance counters not available. Rebuild the Async "
+          "library with USE_AUDIO_PROFILING=ON.\n";
+    return;
+  }
+  if (!enabled)
+  {
+    os << "*** Performance counters not enabled. Set AUDIO_PERF_COUNTERS=1 "
+          "or ASYNC_AUDIO_PERF=1.\n";
+    return;
+  }
+
+  pthread_mutex_lock(&stage_mutex);
+  vector<Stage> sorted_stages;
+  const StageMap& stage_map = stages();
+  for (StageMap::const_iterator it = stage_map.begin();
+       it != stage_map.end(); ++it)
+  {
+    if (it->second.calls > 0)
+    {
+      sorted_stages.push_back(it->second);
+    }
+  }
+  pthread_mutex_unlock(&stage_mutex);
+  vector<const Stage*> sorted;
+  for (size_t i=0; i<sorted_stages.size(); ++i)
+  {
+    sorted.push_back(&sorted_stages[i]);
+  }
+  sort(sorted.begin(), sorted.end(), ByCycles());
+
+  ios_base::fmtflags old_flags = os.flags();
+  streamsize old_prec = os.precision();
+  os << setiosflags(ios::fixed) << setprecision(2);
+  os << left << setw(32) << "Stage" << right
+     << setw(10) << "Calls"
+     << setw(12) << "Samples"
+     << setw(11) << "Mcycles"
+     << setw(10) << "Cyc/smp"
+     << setw(7) << "IPC"
+     << setw(9) << "CM/kI"
+     << setw(9) << "BrM/kI" << "\n";
+  for (vector<const Stage*>::const_iterator it = sorted.begin();
+       it != sorted.end(); ++it)
+  {
+    const Stage *s = *it;
+    const double cycles = s->counts[EV_CYCLES];
+    const double instr = s->counts[EV_INSTRUCTIONS];
+    os << left << setw(32) << s->name.substr(0, 31) << right
+       << setw(10) << s->calls
+       << setw(12) << s->samples
+       << setw(11) << cycles / 1.0e6
+       << setw(10) << ((s->samples > 0) ? cycles / s->samples : 0.0)
+       << setw(7) << ((cycles > 0) ? instr / cycles : 0.0)
+       << setw(9)
+       << ((instr > 0) ? 1000.0 * s->counts[EV_CACHE_MISSES] / instr : 0.0)
+       << setw(9)
+       << ((instr > 0) ? 1000.0 * s->counts[EV_BRANCH_MISSES] / instr : 0.0);
+    if (s->unscheduled > 0)
+    {
+      os << "  (" << s->unscheduled << " unscheduled)";
+    }
+    os << "\n";
+  }
+  os.flags(old_flags);
+  os.precision(old_prec);
+} /* AudioPerfCounters::report */
+
+
+void AudioPerfCounters::reset(void)
+{
+  pthread_mutex_lock(&stage_mutex);
+  StageMap& stage_map = stages();
+  for (StageMap::iterator it = stage_map.begin(); it != stage_map.end(); ++it)
+  {
+    string name(it->second.name);
+    it->second = Stage();
+    it->second.name = name;
+  }
+  pthread_mutex_unlock(&stage_mutex);
+} /* AudioPerfCounters::reset */
+
+
+void AudioPerfCounters::Probe::start(void)
+{
+  m_valid = false;
+#ifdef HAS_PERF_EVENTS
+  ThreadCounters *tc = threadCounters();
+  m_valid = (tc != 0) && readCounters(tc, m_start);
+#endif
+} /* AudioPerfCounters::Probe::start */
+
+
+void AudioPerfCounters::Probe::stop(void)
+{
+#ifdef HAS_PERF_EVENTS
+  uint64_t end[2 + EV_CNT];
+  ThreadCounters *tc = threadCounters();
+  if (!m_valid || (tc == 0) || !readCounters(tc, end))
+  {
+    return;
+  }
+
+    // When more counters are in use than the CPU has, the kernel multiplex
+    // them and the counts are scaled by the time the group actually ran
+  const uint64_t time_enabled = end[0] - m_start[0];
+  const uint64_t time_running = end[1] - m_start[1];
+  pthread_mutex_lock(&stage_mutex);
+  m_stage->calls += 1;
+  m_stage->samples += m_samples;
+  if (time_running == 0)
+  {
+    m_stage->unscheduled += 1;
+  }
+  else
+  {
+    const double scale =
+        static_cast<double>(time_enabled) / static_cast<double>(time_running);
+    for (int i=0; i<EV_CNT; ++i)
+    {
+      const uint64_t delta = end[2 + i] - m_start[2 + i];
+      m_stage->counts[i] += (time_running < time_enabled)
+          ? static_cast<unsigned long long>(delta * scale) : delta;
+    }
+  }
+  pthread_mutex_unlock(&stage_mutex);
+#endif
+} /* AudioPerfCounters::Probe::stop */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+static bool envEnabled(void)
+{
+#ifdef HAS_PERF_EVENTS
+  const char *env = getenv("ASYNC_AUDIO_PERF");
+  return (env != 0) && (atoi(env) != 0);
+#else
+  return false;
+#endif
+} /* envEnabled */
+
+
+  // The stages are created from static initializers in other files so the
+  // map must be constructed on first use
+static StageMap& stages(void)
+{
+  static StageMap stage_map;
+  return stage_map;
+} /* stages */
+
+
+static string className(const type_info& type)
+{
+  const char *mangled = type.name();
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(mangled, 0, 0, &status);
+  string name((status == 0 && demangled != 0) ? demangled : mangled);
+  free(demangled);
+  if (name.compare(0, 7, "Async::") == 0)
+  {
+    name.erase(0, 7);
+  }
+  return name;
+} /* className */
+
+
+#ifdef HAS_PERF_EVENTS
+static ThreadCounters *threadCounters(void)
+{
+  static thread_local ThreadCounters tc;
+  if (tc.opened)
+  {
+    return (tc.leader >= 0) ? &tc : 0;
+  }
+  tc.opened = true;
+
+  static const uint64_t configs[EV_CNT] =
+  {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+  for (int i=0; i<EV_CNT; ++i)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[i];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, tc.leader, 0);
+    if (fd < 0)
+    {
+      if (i == EV_CYCLES)
+      {
+        pthread_mutex_lock(&stage_mutex);
+        if (!open_warned)
+        {
+          cerr << "*** WARNING[AudioPerfCounters]: Could not open the CPU "
+                  "performance counters: " << strerror(errno)
+               << ". The CPU may lack hardware counters or their use may be "
+                  "restricted by /proc/sys/kernel/perf_event_paranoid.\n";
+          open_warned = true;
+        }
+        pthread_mutex_unlock(&stage_mutex);
+        return 0;
+      }
+      continue;
+    }
+    tc.fds[i] = fd;
+    tc.slot[i] = tc.nr++;
+    if (i == EV_CYCLES)
+    {
+      tc.leader = fd;
+    }
+  }
+  return &tc;
+} /* threadCounters */
+
+
+  // Read the time values followed by one value per event in event order.
+  // Events that could not be opened read as zero.
+static bool readCounters(ThreadCounters *tc, uint64_t *values)
+{
+  uint64_t buf[3 + EV_CNT];
+  const ssize_t size = (3 + tc->nr) * sizeof(uint64_t);
+  if (::read(tc->leader, buf, size) != size)
+  {
+    return false;
+  }
+  values[0] = buf[1];
+  values[1] = buf[2];
+  for (int i=0; i<EV_CNT; ++i)
+  {
+    values[2 + i] = (tc->slot[i] >= 0) ? buf[3 + tc->slot[i]] : 0;
+  }
+  return true;
+} /* readCounters */
+#endif
+
+
+/*
+ * This file has not been truncated
+ */
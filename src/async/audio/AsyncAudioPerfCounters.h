@@ -0,0 +1,256 @@
+/**
+@file   AsyncAudioPerfCounters.h
+@brief  Hardware performance counter sampling for DSP stages
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that read the CPU hardware performance counters
+around DSP stages, like audio processors, codecs and the DDR channelizer, and
+aggregate the counts per stage. The instrumentation is only active if the
+Async library is compiled with ASYNC_AUDIO_PROFILING defined.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_PERF_COUNTERS_INCLUDED
+#define ASYNC_AUDIO_PERF_COUNTERS_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+
+#include <string>
+#include <iosfwd>
+#include <typeinfo>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Sample hardware performance counters around DSP stages
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class use the Linux perf_event_open(2) interface to count CPU cycles,
+retired instructions, cache misses and branch misses while a DSP stage is
+running. The counts are aggregated per stage together with the number of
+calls and the number of samples processed. From that the report compute the
+number of cycles per sample, the instructions per cycle (IPC) and the number
+of cache and branch misses per thousand instructions. A stage with a low IPC
+and many cache misses is memory bound while a stage with a high IPC is compute
+bound and is where SIMD kernels pay off.
+
+The instrumentation is compiled in by building the Async library with the
+CMake option USE_AUDIO_PROFILING, which define ASYNC_AUDIO_PROFILING. Since
+reading the counters cost a couple of system calls per measurement, the
+counters must also be enabled at runtime, either by calling setEnabled or by
+setting the environment variable ASYNC_AUDIO_PERF to 1. When disabled, a probe
+only check one flag.
+
+The counters are opened per thread, only counting user space execution of the
+calling thread, so stages running in worker threads are measured too. The
+counts of nested stages are included in the counts of the enclosing stage.
+If the kernel does not allow unprivileged use of the counters, see
+/proc/sys/kernel/perf_event_paranoid, a warning is printed and nothing is
+counted.
+*/
+class AudioPerfCounters
+{
+  public:
+    struct Stage;   ///< Internal per stage statistics
+
+    /**
+     * @brief   Check if the counters are compiled in
+     * @return  Returns \em true if the counters are available
+     */
+    static bool isAvailable(void);
+
+    /**
+     * @brief   Enable or disable the counters
+     * @param   enable Set to \em true to enable the counters
+     */
+    static void setEnabled(bool enable);
+
+    /**
+     * @brief   Check if the counters are enabled
+     * @return  Returns \em true if the counters are enabled
+     */
+    static bool isEnabled(void) { return enabled; }
+
+    /**
+     * @brief   Find or create a stage
+     * @param   name The name of the stage
+     * @return  Returns the stage object to use with a probe
+     *
+     * The returned pointer is valid for the lifetime of the application so
+     * the lookup can be done once at each call site.
+     */
+    static Stage *stage(const std::string& name);
+
+    /**
+     * @brief   Find or create a stage named after a class
+     * @param   type The type of the class
+     * @return  Returns the stage object to use with a probe
+     */
+    static Stage *stage(const std::type_info& type);
+
+    /**
+     * @brief   Print the collected statistics
+     * @param   os  The stream to print the report to
+     *
+     * The stages are sorted in descending order of cycle count.
+     */
+    static void report(std::ostream& os);
+
+    /**
+     * @brief   Clear the collected statistics
+     */
+    static void reset(void);
+
+    /**
+     * @brief   Measure a DSP stage
+     *
+     * An object of this class is created on the stack around the code to
+     * measure.
+     */
+    class Probe
+    {
+      public:
+        Probe(Stage *stage, int samples=0)
+          : m_stage(enabled ? stage : 0), m_samples(samples)
+        {
+          if (m_stage != 0)
+          {
+            start();
+          }
+        }
+        Probe(const std::type_info& type, int samples=0)
+          : m_stage(enabled ? AudioPerfCounters::stage(type) : 0),
+            m_samples(samples)
+        {
+          if (m_stage != 0)
+          {
+            start();
+          }
+        }
+        ~Probe(void)
+        {
+          if (m_stage != 0)
+          {
+            stop();
+          }
+        }
+
+      private:
+        Stage     *m_stage;
+        int       m_samples;
+        uint64_t  m_start[6];
+        bool      m_valid;
+
+        Probe(const Probe&);
+        Probe& operator=(const Probe&);
+        void start(void);
+        void stop(void);
+    };
+
+  private:
+    static volatile bool enabled;
+
+    AudioPerfCounters(void);
+
+};  /* class AudioPerfCounters */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_PERF_COUNTERS_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
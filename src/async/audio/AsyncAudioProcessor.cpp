@@ -54,6 +54,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncAudioProcessor.h"
+#ifdef ASYNC_AUDIO_PROFILING
+#include "AsyncAudioPerfCounters.h"
+#endif
 
 
 
@@ -160,7 +163,7 @@ int AudioProcessor::writeSamples(const float *samples, int len)
     
     if (input_buf_cnt == input_buf_size)
     {
-      processSamples(buf + buf_cnt, input_buf, input_buf_size);
+      runProcessSamples(buf + buf_cnt, input_buf, input_buf_size);
       buf_cnt += 1;
       max_proc -= input_buf_size;
       input_buf_cnt = 0;
@@ -176,7 +179,7 @@ int AudioProcessor::writeSamples(const float *samples, int len)
   int proc_cnt = min(max_proc, len-reminder);
   if (proc_cnt > 0)
   {
-    processSamples(buf + buf_cnt, samples, proc_cnt);
+    runProcessSamples(buf + buf_cnt, samples, proc_cnt);
     buf_cnt += proc_cnt * output_rate / input_rate;
     samples += proc_cnt;
     len -= proc_cnt;
@@ -213,7 +216,7 @@ void AudioProcessor::flushSamples(void)
     {
       memset(input_buf + input_buf_cnt, 0,
       	     (input_buf_size - input_buf_cnt) * sizeof(*input_buf));
-      processSamples(buf, input_buf, input_buf_size);
+      runProcessSamples(buf, input_buf, input_buf_size);
       buf_cnt += 1;
       input_buf_cnt = 0;
       writeFromBuf();
@@ -295,6 +298,16 @@ void AudioProcessor::setInputOutputSampleRate(int input_rate, int output_rate)
  *
  ****************************************************************************/
 
+void AudioProcessor::runProcessSamples(float *dest, const float *src,
+                                       int count)
+{
+#ifdef ASYNC_AUDIO_PROFILING
+  AudioPerfCounters::Probe probe(typeid(*this), count);
+#endif
+  processSamples(dest, src, count);
+} /* AudioProcessor::runProcessSamples */
+
+
 
 /*
  *----------------------------------------------------------------------------
@@ -335,7 +348,7 @@ void AudioProcessor::writeFromBuf(void)
       {
 	memset(input_buf + input_buf_cnt, 0,
       	       (input_buf_size - input_buf_cnt) * sizeof(*input_buf));
-	processSamples(buf, input_buf, input_buf_size);
+	runProcessSamples(buf, input_buf, input_buf_size);
 	buf_cnt += 1;
 	input_buf_cnt = 0;
       }
@@ -175,6 +175,8 @@ class AudioProcessor : public AudioSink, public AudioSource, public sigc::tracka
     
     
   private:
+    friend class AudioProcessorChain;
+
     static const int BUFSIZE = 256;
     
     float     	buf[BUFSIZE];
@@ -191,6 +193,7 @@ class AudioProcessor : public AudioSink, public AudioSource, public sigc::tracka
     AudioProcessor(const AudioProcessor&);
     AudioProcessor& operator=(const AudioProcessor&);
     void writeFromBuf(void);
+    void runProcessSamples(float *dest, const float *src, int count);
 
 };  /* class AudioProcessor */
 
@@ -0,0 +1,238 @@
+/**
+@file   AsyncAudioProcessorChain.cpp
+@brief  Run a number of audio processors as one processing stage
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that fuse a linear run of audio processors into one
+audio pipe component so that a block of samples is passed through all of them
+in one go.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstring>
+#include <cassert>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioProcessorChain.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+namespace {
+  int greatestCommonDivisor(int a, int b)
+  {
+    while (b != 0)
+    {
+      int t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+  }
+};
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+AudioProcessorChain::AudioProcessorChain(void)
+  : num(1), den(1)
+{
+
+} /* AudioProcessorChain::AudioProcessorChain */
+
+
+AudioProcessorChain::~AudioProcessorChain(void)
+{
+  for (vector<Stage>::iterator it = stages.begin(); it != stages.end(); ++it)
+  {
+    if (it->managed)
+    {
+      delete it->proc;
+    }
+  }
+} /* AudioProcessorChain::~AudioProcessorChain */
+
+
+bool AudioProcessorChain::addProcessor(AudioProcessor *proc, bool managed)
+{
+  assert(proc != 0);
+
+    // Keep track of the rate change up to and including this stage as the
+    // fraction num/den of input samples
+  int new_num = num * proc->output_rate;
+  int new_den = den * proc->input_rate;
+  int div = greatestCommonDivisor(new_num, new_den);
+  new_num /= div;
+  new_den /= div;
+  if ((new_num != 1) && (new_den != 1))
+  {
+    return false;
+  }
+
+    // The base class feed us with blocks that are a multiple of the total
+    // decimation factor. Each stage must get an integer number of samples
+    // out of that.
+  for (vector<Stage>::const_iterator it = stages.begin();
+       it != stages.end(); ++it)
+  {
+    if (new_den % it->den != 0)
+    {
+      return false;
+    }
+  }
+
+  Stage stage;
+  stage.proc = proc;
+  stage.managed = managed;
+  stage.num = new_num;
+  stage.den = new_den;
+  stages.push_back(stage);
+
+  num = new_num;
+  den = new_den;
+  setInputOutputSampleRate(den, num);
+
+  return true;
+} /* AudioProcessorChain::addProcessor */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+void AudioProcessorChain::processSamples(float *dest, const float *src,
+                                         int count)
+{
+  if (stages.empty())
+  {
+    memcpy(dest, src, count * sizeof(*dest));
+    return;
+  }
+
+  const float *in = src;
+  int in_cnt = count;
+  const int last = stages.size() - 1;
+  for (int i=0; i<=last; ++i)
+  {
+    const Stage &stage = stages[i];
+    const int out_cnt = count * stage.num / stage.den;
+    float *out = dest;
+    if (i < last)
+    {
+      vector<float> &buf = scratch[i & 1];
+      if (static_cast<int>(buf.size()) < out_cnt)
+      {
+        buf.resize(out_cnt);
+      }
+      out = &buf[0];
+    }
+    stage.proc->runProcessSamples(out, in, in_cnt);
+    in = out;
+    in_cnt = out_cnt;
+  }
+} /* AudioProcessorChain::processSamples */
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+
+
+/*
+ * This file has not been truncated
+ */
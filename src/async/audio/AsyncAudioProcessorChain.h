@@ -0,0 +1,217 @@
+/**
+@file   AsyncAudioProcessorChain.h
+@brief  Run a number of audio processors as one processing stage
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that fuse a linear run of audio processors into one
+audio pipe component so that a block of samples is passed through all of them
+in one go.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_PROCESSOR_CHAIN_INCLUDED
+#define ASYNC_AUDIO_PROCESSOR_CHAIN_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioProcessor.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Run a linear chain of audio processors as one audio pipe component
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+Normally each audio processor is a separate component in the audio pipe.
+A block of samples is then written to each processor in turn, where it is
+buffered and checked for flow control before being written to the next one.
+When a number of processors follow directly after each other, like a
+decimator followed by a number of filters, it is more efficient to fuse them
+using this class. The processSamples function of each added processor is
+then called in sequence, using an internal scratch buffer between the
+stages, so that there is only one buffering and flow control step for the
+whole chain.
+
+Processors added to the chain must not be connected to any other audio
+source or sink. The processors may change the sample rate but the total
+rate change of the chain must be an integer decimation or interpolation
+factor, as required by Async::AudioProcessor.
+
+\code
+AudioProcessorChain *chain = new AudioProcessorChain;
+chain->addProcessor(new AudioDecimator(2, coeff, taps), true);
+chain->addProcessor(new AudioFilter("HpBu3/300"), true);
+prev_src->registerSink(chain, true);
+\endcode
+*/
+class AudioProcessorChain : public AudioProcessor
+{
+  public:
+    /**
+     * @brief 	Default constuctor
+     */
+    AudioProcessorChain(void);
+
+    /**
+     * @brief 	Destructor
+     *
+     * All processors that was added as managed will be deleted.
+     */
+    ~AudioProcessorChain(void);
+
+    /**
+     * @brief 	Add an audio processor to the end of the chain
+     * @param 	proc    The audio processor to add
+     * @param 	managed If \em true, the processor will be deleted when the
+     *                  chain is deleted
+     * @return	Returns \em true on success or else \em false
+     *
+     * The processor is added at the end of the chain. If the processor would
+     * make the total rate change of the chain impossible to handle, the
+     * processor is not added and \em false is returned.
+     */
+    bool addProcessor(AudioProcessor *proc, bool managed=false);
+
+    /**
+     * @brief 	Return the number of processors in the chain
+     * @return	Returns the number of processors in the chain
+     */
+    int size(void) const { return stages.size(); }
+
+    /**
+     * @brief 	Check if the chain is empty
+     * @return	Returns \em true if no processors have been added
+     */
+    bool empty(void) const { return stages.empty(); }
+
+  protected:
+    /**
+     * @brief Process incoming samples and put them into the output buffer
+     * @param dest  Destination buffer
+     * @param src   Source buffer
+     * @param count Number of samples in the source buffer
+     *
+     * This function is called from the base class to do the actual
+     * processing of the incoming samples. The samples are passed through
+     * each processor in the chain in turn.
+     */
+    void processSamples(float *dest, const float *src, int count);
+
+  private:
+    struct Stage
+    {
+      AudioProcessor  *proc;
+      bool            managed;
+      int             num;
+      int             den;
+    };
+
+    std::vector<Stage>  stages;
+    int                 num;
+    int                 den;
+    std::vector<float>  scratch[2];
+
+    AudioProcessorChain(const AudioProcessorChain&);
+    AudioProcessorChain& operator=(const AudioProcessorChain&);
+
+};  /* class AudioProcessorChain */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_PROCESSOR_CHAIN_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,321 @@
+/**
+@file   AsyncAudioProfiler.cpp
+@brief  Profiling instrumentation for the audio pipe
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that collect statistics about how much time is
+spent in each node of the audio pipe and how much audio is passed through it.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+#include <cxxabi.h>
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <string>
+#include <typeinfo>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioSink.h"
+#include "AsyncAudioProfiler.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+struct AudioProfiler::Node
+{
+  Node(void)
+    : calls(0), offered(0), accepted(0), backpressure(0), flushes(0),
+      total_time(0), self_time(0)
+  {
+  }
+  string              name;
+  unsigned long long  calls;
+  unsigned long long  offered;
+  unsigned long long  accepted;
+  unsigned long long  backpressure;
+  unsigned long long  flushes;
+  long long           total_time;
+  long long           self_time;
+};
+
+typedef map<const AudioSink*, AudioProfiler::Node> NodeMap;
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static long long nowNs(void);
+static bool bySelfTime(const AudioProfiler::Node *a,
+                       const AudioProfiler::Node *b);
+static string className(const AudioSink *sink);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+static NodeMap          nodes;
+static map<string, int> name_seq;
+static long long        child_time = 0;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+bool AudioProfiler::isAvailable(void)
+{
+#ifdef ASYNC_AUDIO_PROFILING
+  return true;
+#else
+  return false;
+#endif
+} /* AudioProfiler::isAvailable */
+
+
+void AudioProfiler::setNodeName(const AudioSink *sink, const string& name)
+{
+  nodes[sink].name = name;
+} /* AudioProfiler::setNodeName */
+
+
+void AudioProfiler::report(ostream& os)
+{
+  if (!isAvailable())
+  {
+    os << "*** Audio profiling not available. Rebuild the Async library with "
+          "USE_AUDIO_PROFILING=ON.\n";
+    return;
+  }
+
+  vector<Node*> sorted;
+  long long sum_self_time = 0;
+  for (NodeMap::iterator it = nodes.begin(); it != nodes.end(); ++it)
+  {
+    if (it->second.calls + it->second.flushes > 0)
+    {
+      sorted.push_back(&it->second);
+      sum_self_time += it->second.self_time;
+    }
+  }
+  sort(sorted.begin(), sorted.end(), bySelfTime);
+
+  ios_base::fmtflags old_flags = os.flags();
+  streamsize old_prec = os.precision();
+  os << setiosflags(ios::fixed) << setprecision(2);
+  os << left << setw(32) << "Node" << right
+     << setw(10) << "Calls"
+     << setw(12) << "Samples"
+     << setw(12) << "Accepted"
+     << setw(8) << "Bkpr"
+     << setw(8) << "Flush"
+     << setw(11) << "Total ms"
+     << setw(11) << "Self ms"
+     << setw(7) << "Self%" << "\n";
+  for (vector<Node*>::const_iterator it = sorted.begin();
+       it != sorted.end(); ++it)
+  {
+    const Node *n = *it;
+    double self_pct = (sum_self_time > 0)
+        ? 100.0 * n->self_time / sum_self_time : 0.0;
+    os << left << setw(32) << n->name.substr(0, 31) << right
+       << setw(10) << n->calls
+       << setw(12) << n->offered
+       << setw(12) << n->accepted
+       << setw(8) << n->backpressure
+       << setw(8) << n->flushes
+       << setw(11) << n->total_time / 1.0e6
+       << setw(11) << n->self_time / 1.0e6
+       << setw(7) << self_pct << "\n";
+  }
+  os.flags(old_flags);
+  os.precision(old_prec);
+} /* AudioProfiler::report */
+
+
+void AudioProfiler::reset(void)
+{
+  for (NodeMap::iterator it = nodes.begin(); it != nodes.end(); ++it)
+  {
+    string name(it->second.name);
+    it->second = Node();
+    it->second.name = name;
+  }
+} /* AudioProfiler::reset */
+
+
+void AudioProfiler::removeNode(const AudioSink *sink)
+{
+  nodes.erase(sink);
+} /* AudioProfiler::removeNode */
+
+
+AudioProfiler::WriteProbe::WriteProbe(const AudioSink *sink, int count)
+  : node(0), offered(count), accepted(count), start(nowNs()),
+    saved_child_time(child_time)
+{
+  node = &nodes[sink];
+  if (node->name.empty())
+  {
+    string cls(className(sink));
+    ostringstream ss;
+    ss << cls << "#" << ++name_seq[cls];
+    node->name = ss.str();
+  }
+  child_time = 0;
+} /* AudioProfiler::WriteProbe::WriteProbe */
+
+
+AudioProfiler::WriteProbe::~WriteProbe(void)
+{
+  long long elapsed = nowNs() - start;
+  node->calls += 1;
+  node->offered += offered;
+  node->accepted += accepted;
+  if (accepted < offered)
+  {
+    node->backpressure += 1;
+  }
+  node->total_time += elapsed;
+  node->self_time += elapsed - child_time;
+  child_time = saved_child_time + elapsed;
+} /* AudioProfiler::WriteProbe::~WriteProbe */
+
+
+void AudioProfiler::flushed(const AudioSink *sink)
+{
+  nodes[sink].flushes += 1;
+} /* AudioProfiler::flushed */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+static long long nowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<long long>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+} /* nowNs */
+
+
+static string className(const AudioSink *sink)
+{
+  const char *mangled = typeid(*sink).name();
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(mangled, 0, 0, &status);
+  string name((status == 0 && demangled != 0) ? demangled : mangled);
+  free(demangled);
+  if (name.compare(0, 7, "Async::") == 0)
+  {
+    name.erase(0, 7);
+  }
+  return name;
+} /* className */
+
+
+static bool bySelfTime(const AudioProfiler::Node *a,
+                       const AudioProfiler::Node *b)
+{
+  return a->self_time > b->self_time;
+} /* bySelfTime */
+
+
+/*
+ * This file has not been truncated
+ */
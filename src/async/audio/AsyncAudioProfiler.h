@@ -0,0 +1,212 @@
+/**
+@file   AsyncAudioProfiler.h
+@brief  Profiling instrumentation for the audio pipe
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that collect statistics about how much time is
+spent in each node of the audio pipe and how much audio is passed through it.
+The instrumentation is only active if the Async library is compiled with
+ASYNC_AUDIO_PROFILING defined.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_PROFILER_INCLUDED
+#define ASYNC_AUDIO_PROFILER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <string>
+#include <iosfwd>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class AudioSink;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Collect per node statistics for the audio pipe
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class collect statistics for each audio sink that samples are written to
+through Async::AudioSource::sinkWriteSamples. For each node the number of
+calls, the number of samples offered and accepted, the number of times the
+sink did not accept all samples (backpressure), the number of flushes and the
+time spent are recorded. The time is recorded both in total and excluding the
+time spent in nodes further down the pipe (self time).
+
+The instrumentation is compiled in by building the Async library with the
+CMake option USE_AUDIO_PROFILING, which define ASYNC_AUDIO_PROFILING. When not
+compiled in there is no overhead and the report only tell that profiling is
+not available.
+
+Nodes are named after their class name and a sequence number. A more
+descriptive name can be given using setNodeName.
+
+This class must only be used from the thread running the main event loop.
+*/
+class AudioProfiler
+{
+  public:
+    /**
+     * @brief   Check if the profiling instrumentation is compiled in
+     * @return  Returns \em true if profiling is available
+     */
+    static bool isAvailable(void);
+
+    /**
+     * @brief   Set a descriptive name for an audio pipe node
+     * @param   sink  The audio sink to name
+     * @param   name  The name to use in the report
+     */
+    static void setNodeName(const AudioSink *sink, const std::string& name);
+
+    /**
+     * @brief   Print the collected statistics
+     * @param   os  The stream to print the report to
+     *
+     * The nodes are sorted in descending order of self time.
+     */
+    static void report(std::ostream& os);
+
+    /**
+     * @brief   Clear the collected statistics
+     */
+    static void reset(void);
+
+    /**
+     * @brief   Remove a node from the statistics
+     * @param   sink  The audio sink that is being destroyed
+     *
+     * This function is called by the audio sink destructor.
+     */
+    static void removeNode(const AudioSink *sink);
+
+    /**
+     * @brief   Measure a write to an audio sink
+     *
+     * An object of this class is created on the stack around a call to
+     * AudioSink::writeSamples.
+     */
+    struct Node;   ///< Internal per node statistics
+
+    class WriteProbe
+    {
+      public:
+        WriteProbe(const AudioSink *sink, int count);
+        ~WriteProbe(void);
+        void setAccepted(int count) { accepted = count; }
+
+      private:
+        Node      *node;
+        int       offered;
+        int       accepted;
+        long long start;
+        long long saved_child_time;
+    };
+
+    /**
+     * @brief   Count a flush of an audio sink
+     * @param   sink  The audio sink that is being flushed
+     */
+    static void flushed(const AudioSink *sink);
+
+  private:
+    AudioProfiler(void);
+};  /* class AudioProfiler */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_PROFILER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
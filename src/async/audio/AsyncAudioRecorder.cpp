@@ -38,7 +38,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cerrno>
 #include <algorithm>
 #include <sstream>
+#include <vector>
 #include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
 
 
 /****************************************************************************
@@ -47,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncThreadScheduling.h>
 
 
 /****************************************************************************
@@ -56,6 +61,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncAudioRecorder.h"
+#include "AsyncAudioContainer.h"
 
 
 
@@ -85,6 +91,182 @@ using namespace Async;
  *
  ****************************************************************************/
 
+/**
+ * Write data to a file from a thread of its own. The data is put into a ring
+ * buffer of fixed size by the caller thread and the writer thread is woken up
+ * when a block of data is available or when the maximum delay has passed.
+ */
+class AudioRecorder::Writer
+{
+  public:
+    Writer(FILE *file, size_t size, unsigned max_delay_ms, bool sync_writes)
+      : file(file), ring(size), head(0), tail(0), fill(0),
+        block_size(max(size / 8, static_cast<size_t>(1))),
+        max_delay_ms(max_delay_ms), sync_writes(sync_writes), err(0),
+        done(false), kick(false)
+    {
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&cond, NULL);
+      clock_gettime(CLOCK_MONOTONIC, &last_kick);
+    }
+
+    ~Writer(void)
+    {
+      pthread_mutex_lock(&mutex);
+      done = true;
+      pthread_cond_broadcast(&cond);
+      pthread_mutex_unlock(&mutex);
+      pthread_join(thread, NULL);
+      pthread_cond_destroy(&cond);
+      pthread_mutex_destroy(&mutex);
+    }
+
+    int start(void)
+    {
+      return pthread_create(&thread, NULL, threadFunc, this);
+    }
+
+    size_t space(void)
+    {
+      pthread_mutex_lock(&mutex);
+      size_t ret = ring.size() - fill;
+      pthread_mutex_unlock(&mutex);
+      return ret;
+    }
+
+    int write(const void *data, size_t len)
+    {
+      const char *ptr = static_cast<const char *>(data);
+      pthread_mutex_lock(&mutex);
+      while ((len > 0) && (err == 0))
+      {
+          // Only happen if the caller have not checked for free space.
+          // The writer thread is always kicked when the buffer is full.
+        while ((fill == ring.size()) && (err == 0))
+        {
+          pthread_cond_wait(&cond, &mutex);
+        }
+        size_t cnt = min(len, min(ring.size() - fill, ring.size() - head));
+        memcpy(&ring[head], ptr, cnt);
+        head = (head + cnt) % ring.size();
+        fill += cnt;
+        ptr += cnt;
+        len -= cnt;
+        if (fill >= block_size)
+        {
+          kickWriter();
+        }
+      }
+      if ((max_delay_ms > 0) && (fill > 0) && !kick)
+      {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long elapsed_ms = (now.tv_sec - last_kick.tv_sec) * 1000 +
+                          (now.tv_nsec - last_kick.tv_nsec) / 1000000;
+        if (elapsed_ms >= static_cast<long>(max_delay_ms))
+        {
+          kickWriter();
+        }
+      }
+      int ret = err;
+      pthread_mutex_unlock(&mutex);
+      return ret;
+    }
+
+    int sync(void)
+    {
+      pthread_mutex_lock(&mutex);
+      kickWriter();
+      while ((fill > 0) && (err == 0))
+      {
+        pthread_cond_wait(&cond, &mutex);
+      }
+      int ret = err;
+      pthread_mutex_unlock(&mutex);
+      return ret;
+    }
+
+  private:
+    FILE              *file;
+    std::vector<char> ring;
+    size_t            head;
+    size_t            tail;
+    size_t            fill;
+    size_t            block_size;
+    unsigned          max_delay_ms;
+    bool              sync_writes;
+    pthread_t         thread;
+    pthread_mutex_t   mutex;
+    pthread_cond_t    cond;
+    int               err;
+    bool              done;
+    bool              kick;
+    struct timespec   last_kick;
+
+    void kickWriter(void)
+    {
+      kick = true;
+      clock_gettime(CLOCK_MONOTONIC, &last_kick);
+      pthread_cond_broadcast(&cond);
+    }
+
+    static void *threadFunc(void *arg)
+    {
+      ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_FILE_IO);
+      Writer *self = static_cast<Writer *>(arg);
+      pthread_mutex_lock(&self->mutex);
+      for (;;)
+      {
+        while (!self->kick && !self->done)
+        {
+          pthread_cond_wait(&self->cond, &self->mutex);
+        }
+        if (self->fill == 0)
+        {
+          self->kick = false;
+          if (self->done)
+          {
+            break;
+          }
+          continue;
+        }
+
+          // The caller only write at the head so the part of the ring
+          // buffer from the tail can be written without holding the lock
+        size_t cnt = min(self->fill, self->ring.size() - self->tail);
+        const char *ptr = &self->ring[self->tail];
+        pthread_mutex_unlock(&self->mutex);
+
+        int errnum = 0;
+        if ((fwrite(ptr, 1, cnt, self->file) != cnt) ||
+            (fflush(self->file) != 0) ||
+            (self->sync_writes && (fsync(fileno(self->file)) != 0)))
+        {
+          errnum = errno;
+        }
+
+        pthread_mutex_lock(&self->mutex);
+        if (errnum != 0)
+        {
+          self->err = errnum;
+          self->tail = self->head;
+          self->fill = 0;
+        }
+        else
+        {
+          self->tail = (self->tail + cnt) % self->ring.size();
+          self->fill -= cnt;
+        }
+        pthread_cond_broadcast(&self->cond);
+      }
+      pthread_mutex_unlock(&self->mutex);
+      return NULL;
+    }
+
+    Writer(const Writer&);
+    Writer& operator=(const Writer&);
+};
+
 
 
 /****************************************************************************
@@ -123,7 +305,10 @@ AudioRecorder::AudioRecorder(const string& filename,
 			     int sample_rate)
   : filename(filename), file(NULL), samples_written(0), format(fmt),
     sample_rate(sample_rate), max_samples(0), high_water_mark(0),
-    high_water_mark_reached(false)
+    high_water_mark_reached(false), max_file_size(0), bytes_written(0),
+    write_buffer_size(0), write_max_delay(0), write_sync(false),
+    container(0), writer(0), write_failed(false), overrun_cnt(0),
+    samples_dropped(0)
 {
   timerclear(&begin_timestamp);
   timerclear(&end_timestamp);
@@ -140,6 +325,10 @@ AudioRecorder::AudioRecorder(const string& filename,
       {
         format = FMT_WAV;
       }
+      else if ((ext == "opus") || (ext == "ogg"))
+      {
+        format = FMT_OPUS;
+      }
     }
   }
 } /* AudioRecorder::AudioRecorder */
@@ -162,12 +351,51 @@ bool AudioRecorder::initialize(void)
     return false;
   }
   
+  size_t header_size = 0;
   if (format == FMT_WAV)
   {
-      // Leave room for the wave file header
-    if (fseek(file, WAVE_HEADER_SIZE, SEEK_SET) != 0)
+    header_size = WAVE_HEADER_SIZE;
+  }
+  else if (format == FMT_OPUS)
+  {
+    container = createAudioContainer("opus");
+    if (container == 0)
+    {
+      errmsg = "Opus audio format not supported";
+      fclose(file);
+      file = NULL;
+      return false;
+    }
+    container->writeBlock.connect(
+        sigc::mem_fun(*this, &AudioRecorder::onContainerBlock));
+    header_size = container->headerSize();
+  }
+
+  if (header_size > 0)
+  {
+      // Leave room for the file header
+    if (fseek(file, header_size, SEEK_SET) != 0)
     {
       setErrMsgFromErrno("fseek");
+      delete container;
+      container = 0;
+      fclose(file);
+      file = NULL;
+      return false;
+    }
+  }
+
+  if (write_buffer_size > 0)
+  {
+    writer = new Writer(file, write_buffer_size, write_max_delay, write_sync);
+    int ret = writer->start();
+    if (ret != 0)
+    {
+      setErrMsgFromErrno("pthread_create", ret);
+      delete writer;
+      writer = 0;
+      delete container;
+      container = 0;
       fclose(file);
       file = NULL;
       return false;
@@ -175,6 +403,10 @@ bool AudioRecorder::initialize(void)
   }
   
   samples_written = 0;
+  bytes_written = header_size;
+  write_failed = false;
+  overrun_cnt = 0;
+  samples_dropped = 0;
   high_water_mark_reached = false;
   timerclear(&begin_timestamp);
   timerclear(&end_timestamp);
@@ -197,9 +429,43 @@ bool AudioRecorder::closeFile(void)
   bool success = true;
   if (file != NULL)
   {
-    if (format == FMT_WAV)
+    if (container != 0)
+    {
+      container->endStream();
+    }
+    if (writer != 0)
+    {
+      int ret = writer->sync();
+      delete writer;
+      writer = 0;
+      if (ret != 0)
+      {
+        setErrMsgFromErrno("fwrite", ret);
+        success = false;
+      }
+    }
+    if (write_failed)
+    {
+      success = false;
+    }
+    if (container != 0)
+    {
+      if (container->headerSize() > 0)
+      {
+        rewind(file);
+        if (fwrite(container->header(), 1, container->headerSize(), file)
+            != container->headerSize())
+        {
+          setErrMsgFromErrno("fwrite");
+          success = false;
+        }
+      }
+      delete container;
+      container = 0;
+    }
+    else if (format == FMT_WAV)
     {
-      success = writeWaveHeader();
+      success = writeWaveHeader() && success;
     }
     if (fclose(file) != 0)
     {
@@ -238,28 +504,44 @@ int AudioRecorder::writeSamples(const float *samples, int count)
     timersub(&end_timestamp, &block_time, &begin_timestamp);
   }
   
-  short buf[count];
-  for (int i=0; i<count; ++i)
+    // Throw the samples away if the writer thread cannot keep up. An encoded
+    // block is never larger than the same samples in 16 bit PCM format.
+  if ((writer != 0) && (writer->space() < count * sizeof(short)))
   {
-    float sample = samples[i];
-    if (sample > 1)
-    {
-      buf[i] = 32767;
-    }
-    else if (sample < -1)
-    {
-      buf[i] = -32767;
-    }
-    else
+    ++overrun_cnt;
+    samples_dropped += count;
+    return count;
+  }
+
+  int written = count;
+  if (container != 0)
+  {
+    written = container->writeSamples(samples, count);
+  }
+  else
+  {
+    short buf[count];
+    for (int i=0; i<count; ++i)
     {
-      buf[i] = static_cast<short>(32767.0 * sample);
+      float sample = samples[i];
+      if (sample > 1)
+      {
+        buf[i] = 32767;
+      }
+      else if (sample < -1)
+      {
+        buf[i] = -32767;
+      }
+      else
+      {
+        buf[i] = static_cast<short>(32767.0 * sample);
+      }
     }
+    writeData(buf, count * sizeof(*buf));
   }
-  
-  int written = fwrite(buf, sizeof(*buf), count, file);
-  if ((written != count) && ferror(file))
+
+  if (write_failed)
   {
-    setErrMsgFromErrno("fwrite");
     errorOccurred();
     closeFile();
     return count;
@@ -273,7 +555,8 @@ int AudioRecorder::writeSamples(const float *samples, int count)
     high_water_mark_reached = true;
   }
 
-  if ((max_samples > 0) && (samples_written >= max_samples))
+  if (((max_samples > 0) && (samples_written >= max_samples)) ||
+      ((max_file_size > 0) && (bytes_written >= max_file_size)))
   {
     closeFile();
     maxRecordingTimeReached();
@@ -378,6 +661,40 @@ bool AudioRecorder::writeWaveHeader(void)
 } /* AudioRecorder::writeWaveHeader */
 
 
+bool AudioRecorder::writeData(const void *buf, size_t len)
+{
+  if (write_failed)
+  {
+    return false;
+  }
+
+  if (writer != 0)
+  {
+    int ret = writer->write(buf, len);
+    if (ret != 0)
+    {
+      setErrMsgFromErrno("fwrite", ret);
+      write_failed = true;
+      return false;
+    }
+  }
+  else if (fwrite(buf, 1, len, file) != len)
+  {
+    setErrMsgFromErrno("fwrite");
+    write_failed = true;
+    return false;
+  }
+  bytes_written += len;
+  return true;
+} /* AudioRecorder::writeData */
+
+
+void AudioRecorder::onContainerBlock(const char *buf, size_t len)
+{
+  writeData(buf, len);
+} /* AudioRecorder::onContainerBlock */
+
+
 int AudioRecorder::store32bitValue(char *ptr, uint32_t val)
 {
   *ptr++ = val & 0xff;
@@ -400,10 +717,10 @@ int AudioRecorder::store16bitValue(char *ptr, uint16_t val)
 } /* AudioRecorder::store32bitValue */
 
 
-void AudioRecorder::setErrMsgFromErrno(const std::string &fname)
+void AudioRecorder::setErrMsgFromErrno(const std::string &fname, int errnum)
 {
   ostringstream ss;
-  ss << fname << ": " << strerror(errno);
+  ss << fname << ": " << strerror((errnum != 0) ? errnum : errno);
   errmsg = ss.str();
 } /* AudioRecorder::setErrMsgFromErrno */
 
@@ -40,6 +40,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sys/time.h>
 
 #include <string>
+#include <cstddef>
 
 #include <AsyncAudioSink.h>
 
@@ -50,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -84,7 +86,8 @@ namespace Async
  *
  ****************************************************************************/
 
-  
+class AudioContainer;
+
 
 /****************************************************************************
  *
@@ -114,12 +117,16 @@ namespace Async
 @date   2005-08-29
 
 Use this class to stream audio into a file. The audio is stored in raw format,
-(only samples no header) or WAV format.
+(only samples no header), WAV format or Ogg/Opus format. The Opus format is
+only available if the library was built with Opus and Ogg support.
+
+The actual disk writes can optionally be done by a background thread, see
+setWriteBufferSize, so that a slow disk does not stall the audio handling.
 */
 class AudioRecorder : public Async::AudioSink
 {
   public:
-    typedef enum { FMT_AUTO, FMT_RAW, FMT_WAV } Format;
+    typedef enum { FMT_AUTO, FMT_RAW, FMT_WAV, FMT_OPUS } Format;
     
     /**
      * @brief 	Default constuctor
@@ -162,6 +169,50 @@ class AudioRecorder : public Async::AudioSink
      * the time. Setting the time to 0 will allow the file to grow indefinetly.
      */
     void setMaxRecordingTime(unsigned time_ms, unsigned hw_time_ms=0);
+
+    /**
+     * @brief   Set the maximum size of the file
+     * @param   max_size The maximum file size in bytes (0=unlimited)
+     *
+     * When the file have grown to the given size, the file will be closed
+     * and the maxRecordingTimeReached signal will be emitted, just like when
+     * the maximum recording time is reached. The file may grow slightly
+     * larger than the limit since whole blocks are written.
+     */
+    void setMaxFileSize(size_t max_size) { max_file_size = max_size; }
+
+    /**
+     * @brief   Write to the file from a background thread
+     * @param   size The size of the write buffer in bytes
+     *
+     * Setting the size to non zero will make the recorder put the audio data
+     * in a ring buffer of the given size. The data is then written to disk by
+     * a thread of its own so that a stalled disk will not stall the caller.
+     * If the buffer is full, incoming samples are thrown away and counted as
+     * an overrun. Closing the file will wait for all buffered data to be
+     * written. This function must be called before the initialize function to
+     * have effect. The default is 0, which means that the data is written
+     * directly.
+     */
+    void setWriteBufferSize(size_t size) { write_buffer_size = size; }
+
+    /**
+     * @brief   Set when the background writer thread should write to disk
+     * @param   max_delay_ms The maximum time data may stay in the buffer
+     * @param   sync_writes Set to \em true to sync the file after each write
+     *
+     * The writer thread write the data when an eighth of the write buffer
+     * have been filled. A maximum delay can be set so that data is written at
+     * least that often, which limit how much audio that is lost on a crash.
+     * Setting sync_writes will make sure the data actually reach the disk.
+     * A delay of 0, the default, disable the delay limit. This function must
+     * be called before the initialize function to have effect.
+     */
+    void setWriteFlushPolicy(unsigned max_delay_ms, bool sync_writes=false)
+    {
+      write_max_delay = max_delay_ms;
+      write_sync = sync_writes;
+    }
     
     /**
      * @brief   Close the file
@@ -180,6 +231,24 @@ class AudioRecorder : public Async::AudioSink
      */
     unsigned samplesWritten(void) const { return samples_written; }
 
+    /**
+     * @brief   Find out how many bytes that have been written to the file
+     * @return  Returns the current size of the file, including the header
+     */
+    size_t bytesWritten(void) const { return bytes_written; }
+
+    /**
+     * @brief   Find out how many times the write buffer have overrun
+     * @return  Returns the number of overruns for the current file
+     */
+    unsigned overrunCount(void) const { return overrun_cnt; }
+
+    /**
+     * @brief   Find out how many samples that was lost due to overruns
+     * @return  Returns the number of dropped samples for the current file
+     */
+    unsigned samplesDropped(void) const { return samples_dropped; }
+
     /**
      * @brief   The timestamp of the first stored sample
      * @returns Returns the timestamp
@@ -228,8 +297,8 @@ class AudioRecorder : public Async::AudioSink
     /**
      * @brief   A signal that's emitted when the max recording time is reached
      *
-     * This signal will be emitted when any of the maximum recording time or
-     * the high watermark limits are reached. Before this signal is emitted,
+     * This signal will be emitted when any of the maximum recording time,
+     * the high watermark or the maximum file size limits are reached. Before this signal is emitted,
      * the file is closed. It is safe to delete the audio recorder from the
      * slot that is connected to this signal.
      */
@@ -246,6 +315,8 @@ class AudioRecorder : public Async::AudioSink
     sigc::signal<void> errorOccurred;
 
   private:
+    class Writer;
+
     std::string     filename;
     FILE      	    *file;
     unsigned        samples_written;
@@ -257,13 +328,25 @@ class AudioRecorder : public Async::AudioSink
     struct timeval  begin_timestamp;
     struct timeval  end_timestamp;
     std::string     errmsg;
+    size_t          max_file_size;
+    size_t          bytes_written;
+    size_t          write_buffer_size;
+    unsigned        write_max_delay;
+    bool            write_sync;
+    AudioContainer  *container;
+    Writer          *writer;
+    bool            write_failed;
+    unsigned        overrun_cnt;
+    unsigned        samples_dropped;
     
     AudioRecorder(const AudioRecorder&);
     AudioRecorder& operator=(const AudioRecorder&);
     bool writeWaveHeader(void);
+    bool writeData(const void *buf, size_t len);
+    void onContainerBlock(const char *buf, size_t len);
     int store32bitValue(char *ptr, uint32_t val);
     int store16bitValue(char *ptr, uint16_t val);
-    void setErrMsgFromErrno(const std::string &fname);
+    void setErrMsgFromErrno(const std::string &fname, int errnum=0);
 
 };  /* class AudioRecorder */
 
@@ -0,0 +1,448 @@
+/**
+@file   AsyncAudioResampler.cpp
+@brief  A polyphase resampler for rational and arbitrary rate ratios
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains an audio pipe class that convert the sampling rate of an
+audio stream by any ratio, e.g. between a 44.1kHz sound card and the
+internal sampling rate.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <cmath>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncApplication.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioResampler.h"
+#include "AsyncAudioDotProduct.h"
+
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+namespace {
+
+    // The number of filter taps, per phase, used when interpolating. When
+    // decimating the filter is made longer in proportion to the ratio so
+    // that the transition band stay the same relative to the output rate.
+  const int     BASE_TAPS     = 48;
+
+    // The cutoff frequency relative to half the lower sampling rate
+  const double  PASSBAND      = 0.9;
+
+    // The Kaiser window beta, giving about 80dB stopband attenuation
+  const double  KAISER_BETA   = 8.0;
+
+};
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+namespace {
+
+  int greatestCommonDivisor(int a, int b)
+  {
+    while (b != 0)
+    {
+      int t = a % b;
+      a = b;
+      b = t;
+    }
+    return a;
+  }
+
+
+    // Modified Bessel function of the first kind, order zero
+  double besselI0(double x)
+  {
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k=1; k<50; ++k)
+    {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+      if (term < 1.0e-12 * sum)
+      {
+        break;
+      }
+    }
+    return sum;
+  }
+
+};
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+AudioResampler::AudioResampler(int input_rate, int output_rate)
+  : input_rate(input_rate), output_rate(output_rate), taps(0), phase_L(1),
+    phase_M(1), h_exact(0), h_interp(0), drift_ppm(0.0), step(0.0), z(0),
+    z_size(0), z_cnt(0), next(0), phase(0), frac(0.0), buf_cnt(0),
+    do_flush(false), input_stopped(false), output_stopped(false)
+{
+  assert((input_rate > 0) && (output_rate > 0));
+
+  const int div = greatestCommonDivisor(input_rate, output_rate);
+  phase_L = output_rate / div;
+  phase_M = input_rate / div;
+
+    // Round the number of taps up to a multiple of eight to suit the SIMD
+    // dot product kernels
+  const double ratio = min(1.0, static_cast<double>(output_rate) / input_rate);
+  taps = static_cast<int>(ceil(BASE_TAPS / ratio));
+  taps = (taps + 7) & ~7;
+
+  if (phase_L <= MAX_PHASES)
+  {
+    h_exact = new float[phase_L * taps];
+    designBank(h_exact, phase_L, phase_L, 0.5 * PASSBAND * ratio);
+  }
+  else
+  {
+    h_interp = new float[(PHASES + 1) * taps];
+    designBank(h_interp, PHASES, PHASES + 1, 0.5 * PASSBAND * ratio);
+    step = static_cast<double>(input_rate) / output_rate;
+  }
+
+    // The delay line hold the taps-1 samples of history needed by the next
+    // output sample followed by room for one chunk of new samples
+  z_size = taps - 1 + CHUNK_SIZE;
+  z = new float[z_size];
+  memset(z, 0, z_size * sizeof(*z));
+  z_cnt = taps - 1;
+  next = taps - 1;
+} /* AudioResampler::AudioResampler */
+
+
+AudioResampler::~AudioResampler(void)
+{
+  delete [] z;
+  delete [] h_interp;
+  delete [] h_exact;
+} /* AudioResampler::~AudioResampler */
+
+
+void AudioResampler::setDrift(double ppm)
+{
+  drift_ppm = ppm;
+  if ((ppm == 0.0) && (h_exact != 0))
+  {
+    if (step != 0.0)
+    {
+        // Switch back to the exact bank at the closest phase
+      phase = static_cast<int>(lrint(frac * phase_L));
+      if (phase == phase_L)
+      {
+        phase = 0;
+        next += 1;
+      }
+      step = 0.0;
+    }
+    return;
+  }
+
+  if (h_interp == 0)
+  {
+    h_interp = new float[(PHASES + 1) * taps];
+    const double ratio =
+      min(1.0, static_cast<double>(output_rate) / input_rate);
+    designBank(h_interp, PHASES, PHASES + 1, 0.5 * PASSBAND * ratio);
+  }
+  if (step == 0.0)
+  {
+    frac = static_cast<double>(phase) / phase_L;
+  }
+  step = static_cast<double>(input_rate) / output_rate * (1.0 + 1.0e-6 * ppm);
+} /* AudioResampler::setDrift */
+
+
+int AudioResampler::writeSamples(const float *samples, int len)
+{
+  assert(len > 0);
+
+  do_flush = false;
+  const int orig_len = len;
+  while (len > 0)
+  {
+    writeFromBuf();
+    const int cnt = min(len, z_size - z_cnt);
+    if (cnt == 0)
+    {
+      break;
+    }
+    memcpy(z + z_cnt, samples, cnt * sizeof(*z));
+    z_cnt += cnt;
+    samples += cnt;
+    len -= cnt;
+  }
+  writeFromBuf();
+
+  const int ret_len = orig_len - len;
+  if (ret_len == 0)
+  {
+    input_stopped = true;
+  }
+  return ret_len;
+} /* AudioResampler::writeSamples */
+
+
+void AudioResampler::flushSamples(void)
+{
+  do_flush = true;
+  input_stopped = false;
+  if ((buf_cnt == 0) && (next >= z_cnt))
+  {
+    do_flush = false;
+    sinkFlushSamples();
+    return;
+  }
+  writeFromBuf();
+} /* AudioResampler::flushSamples */
+
+
+void AudioResampler::resumeOutput(void)
+{
+  output_stopped = false;
+  writeFromBuf();
+} /* AudioResampler::resumeOutput */
+
+
+void AudioResampler::allSamplesFlushed(void)
+{
+  do_flush = false;
+  sourceAllSamplesFlushed();
+} /* AudioResampler::allSamplesFlushed */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+/*
+ * Design a bank of sub-filters from a Kaiser windowed sinc lowpass filter.
+ * Sub-filter p is the prototype delayed by p/phase_cnt input samples. The
+ * coefficients of each sub-filter are stored in reverse order so that an
+ * output is the dot product of the sub-filter and a contiguous part of the
+ * delay line where the oldest sample comes first. Each sub-filter is
+ * normalized to unity DC gain so that no ripple is added between phases.
+ */
+void AudioResampler::designBank(float *bank, int phase_cnt,
+                                int bank_phase_cnt, double fc)
+{
+  const double half_len = taps / 2.0;
+  const double i0_beta = besselI0(KAISER_BETA);
+  for (int p=0; p<bank_phase_cnt; ++p)
+  {
+    float *h = bank + p * taps;
+    double sum = 0.0;
+    for (int k=0; k<taps; ++k)
+    {
+      const double t = k + static_cast<double>(p) / phase_cnt - half_len;
+      const double x = t / half_len;
+      double w = 0.0;
+      if (fabs(x) < 1.0)
+      {
+        w = besselI0(KAISER_BETA * sqrt(1.0 - x * x)) / i0_beta;
+      }
+      double sinc = 1.0;
+      if (t != 0.0)
+      {
+        sinc = sin(2.0 * M_PI * fc * t) / (2.0 * M_PI * fc * t);
+      }
+      const double c = 2.0 * fc * sinc * w;
+      h[taps - 1 - k] = c;
+      sum += c;
+    }
+    for (int k=0; k<taps; ++k)
+    {
+      h[k] /= sum;
+    }
+  }
+} /* AudioResampler::designBank */
+
+
+void AudioResampler::process(void)
+{
+  while ((buf_cnt < BUFSIZE) && (next < z_cnt))
+  {
+    const float *x = z + next - (taps - 1);
+    if (step == 0.0)
+    {
+      buf[buf_cnt++] = AudioDotProduct::calc(h_exact + phase * taps, x, taps);
+      phase += phase_M;
+      next += phase / phase_L;
+      phase %= phase_L;
+    }
+    else
+    {
+      const double pos = frac * PHASES;
+      const int p = static_cast<int>(pos);
+      const float a = pos - p;
+      const float *h = h_interp + p * taps;
+      const float y0 = AudioDotProduct::calc(h, x, taps);
+      const float y1 = AudioDotProduct::calc(h + taps, x, taps);
+      buf[buf_cnt++] = y0 + a * (y1 - y0);
+      frac += step;
+      const int adv = static_cast<int>(frac);
+      next += adv;
+      frac -= adv;
+    }
+  }
+
+    // Drop the samples that are not needed by the next output sample. The
+    // next output may need samples that have not arrived yet.
+  const int drop = min(next, z_cnt) - (taps - 1);
+  if (drop > 0)
+  {
+    memmove(z, z + drop, (z_cnt - drop) * sizeof(*z));
+    z_cnt -= drop;
+    next -= drop;
+  }
+} /* AudioResampler::process */
+
+
+void AudioResampler::writeFromBuf(void)
+{
+  for (;;)
+  {
+    process();
+    if ((buf_cnt == 0) || output_stopped)
+    {
+      break;
+    }
+    const int written = sinkWriteSamples(buf, buf_cnt);
+    assert((written >= 0) && (written <= buf_cnt));
+    if (written == 0)
+    {
+      output_stopped = true;
+      break;
+    }
+    buf_cnt -= written;
+    if (buf_cnt > 0)
+    {
+      memmove(buf, buf + written, buf_cnt * sizeof(*buf));
+    }
+  }
+
+  if (do_flush && (buf_cnt == 0) && (next >= z_cnt))
+  {
+    do_flush = false;
+    Application::app().runTask(
+        mem_fun(*this, &AudioResampler::sinkFlushSamples));
+  }
+
+  if (input_stopped && (z_cnt < z_size))
+  {
+    input_stopped = false;
+    Application::app().runTask(
+        mem_fun(*this, &AudioResampler::sourceResumeOutput));
+  }
+} /* AudioResampler::writeFromBuf */
+
+
+
+/*
+ * This file has not been truncated
+ */
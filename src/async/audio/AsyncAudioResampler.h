@@ -0,0 +1,262 @@
+/**
+@file   AsyncAudioResampler.h
+@brief  A polyphase resampler for rational and arbitrary rate ratios
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains an audio pipe class that convert the sampling rate of an
+audio stream by any ratio, e.g. between a 44.1kHz sound card and the
+internal sampling rate.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_RESAMPLER_INCLUDED
+#define ASYNC_AUDIO_RESAMPLER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSource.h>
+#include <AsyncAudioSink.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Convert the sampling rate of an audio stream by any ratio
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This audio pipe class convert an audio stream from one sampling rate to
+another. Unlike the AudioDecimator and AudioInterpolator the ratio does not
+have to be an integer and no filter coefficients have to be supplied. A
+lowpass filter, cutting off just below half of the lower one of the two
+sampling rates, is designed by the constructor.
+
+The filter is stored as a bank of polyphase sub-filters. If the ratio reduce
+to L/M with L not larger than MAX_PHASES, e.g. 16000/44100 = 160/441, one
+sub-filter is stored for each of the L output phases and the conversion is
+exact. Other ratios use a bank of PHASES sub-filters with linear
+interpolation between the two closest ones. The sub-filters are calculated
+using AudioDotProduct so the fastest SIMD kernel available is used.
+
+The two clocks of a sound card and some other audio source never run at
+exactly the same rate. If the drift is known, e.g. from the fill level of a
+FIFO, it can be given to setDrift. The ratio is then adjusted accordingly and
+the interpolating filter bank is used.
+*/
+class AudioResampler : public AudioSink, public AudioSource,
+                       public sigc::trackable
+{
+  public:
+    /**
+     * @brief   The maximum number of phases used for an exact ratio
+     */
+    static const int MAX_PHASES = 512;
+
+    /**
+     * @brief   The number of phases used for an arbitrary ratio
+     */
+    static const int PHASES = 256;
+
+    /**
+     * @brief 	Constructor
+     * @param 	input_rate  The sampling rate of the incoming samples
+     * @param 	output_rate The sampling rate of the outgoing samples
+     */
+    AudioResampler(int input_rate, int output_rate);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~AudioResampler(void);
+
+    /**
+     * @brief   Get the input sampling rate
+     * @return  Returns the sampling rate given to the constructor
+     */
+    int inputRate(void) const { return input_rate; }
+
+    /**
+     * @brief   Get the output sampling rate
+     * @return  Returns the sampling rate given to the constructor
+     */
+    int outputRate(void) const { return output_rate; }
+
+    /**
+     * @brief   Set the drift of the input clock
+     * @param   ppm The input clock error, in parts per million, relative to
+     *              the output clock
+     *
+     * A positive value mean that the input is sampled faster than the
+     * nominal input rate so more input samples are consumed for each output
+     * sample. Setting the drift to zero switch back to the exact filter bank,
+     * if one is used for this ratio. The drift may be changed at any time.
+     */
+    void setDrift(double ppm);
+
+    /**
+     * @brief   Get the drift of the input clock
+     * @return  Returns the drift in parts per million
+     */
+    double drift(void) const { return drift_ppm; }
+
+    /**
+     * @brief   Check if the ratio is exact
+     * @return  Returns \em true if an exact filter bank is used
+     */
+    bool isExact(void) const { return (h_exact != 0) && (step == 0.0); }
+
+    /**
+     * @brief 	Write samples into this audio sink
+     * @param 	samples The buffer containing the samples
+     * @param 	len     The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *samples, int len);
+
+    /**
+     * @brief 	Tell the sink to flush the previously written samples
+     */
+    virtual void flushSamples(void);
+
+    /**
+     * @brief Resume audio output to the sink
+     */
+    virtual void resumeOutput(void);
+
+    /**
+     * @brief The registered sink has flushed all samples
+     */
+    virtual void allSamplesFlushed(void);
+
+
+  private:
+    static const int BUFSIZE    = 256;
+    static const int CHUNK_SIZE = 256;
+
+    const int input_rate;
+    const int output_rate;
+    int       taps;
+    int       phase_L;
+    int       phase_M;
+    float     *h_exact;
+    float     *h_interp;
+    double    drift_ppm;
+    double    step;
+    float     *z;
+    int       z_size;
+    int       z_cnt;
+    int       next;
+    int       phase;
+    double    frac;
+    float     buf[BUFSIZE];
+    int       buf_cnt;
+    bool      do_flush;
+    bool      input_stopped;
+    bool      output_stopped;
+
+    AudioResampler(const AudioResampler&);
+    AudioResampler& operator=(const AudioResampler&);
+    void designBank(float *bank, int phase_cnt, int bank_phase_cnt,
+                    double fc);
+    void process(void);
+    void writeFromBuf(void);
+
+};  /* class AudioResampler */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_RESAMPLER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,182 @@
+/**
+@file   AsyncAudioSampleBlock.cpp
+@brief  A reference counted block of audio samples
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a reference counted block of audio samples with pooled
+storage. It is used to share a block of samples between multiple consumers
+without copying it.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cassert>
+#include <cstring>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncBlockPool.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioSampleBlock.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+AudioSampleBlock *AudioSampleBlock::allocate(int len)
+{
+  assert(len >= 0);
+
+  void *mem = BlockPool::allocate(HEADER_SIZE + len * sizeof(float));
+  int cap = (BlockPool::capacity(mem) - HEADER_SIZE) / sizeof(float);
+  return new (mem) AudioSampleBlock(len, cap);
+} /* AudioSampleBlock::allocate */
+
+
+void AudioSampleBlock::clearPool(void)
+{
+  BlockPool::clear();
+} /* AudioSampleBlock::clearPool */
+
+
+void AudioSampleBlock::unref(void)
+{
+  assert(ref_cnt > 0);
+  if (--ref_cnt > 0)
+  {
+    return;
+  }
+  this->~AudioSampleBlock();
+  BlockPool::release(this);
+} /* AudioSampleBlock::unref */
+
+
+void AudioSampleBlockPtr::makeUnique(void)
+{
+  if ((blk == 0) || (blk->refCount() == 1))
+  {
+    return;
+  }
+  AudioSampleBlock *copy = AudioSampleBlock::allocate(blk->size());
+  memcpy(copy->data(), blk->data(), blk->size() * sizeof(*copy->data()));
+  blk->unref();
+  blk = copy;
+} /* AudioSampleBlockPtr::makeUnique */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+AudioSampleBlock::AudioSampleBlock(int len, int cap)
+  : ref_cnt(1), len(len), cap(cap),
+    samples(reinterpret_cast<float*>(reinterpret_cast<char*>(this) +
+                                     HEADER_SIZE))
+{
+  assert(sizeof(*this) <= HEADER_SIZE);
+} /* AudioSampleBlock::AudioSampleBlock */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,309 @@
+/**
+@file   AsyncAudioSampleBlock.h
+@brief  A reference counted block of audio samples
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a reference counted block of audio samples with pooled
+storage. It is used to share a block of samples between multiple consumers
+without copying it.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_SAMPLE_BLOCK_INCLUDED
+#define ASYNC_AUDIO_SAMPLE_BLOCK_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A reference counted block of audio samples with pooled storage
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class is used to hold a block of audio samples that should be shared
+between multiple consumers, like the branches of an Async::AudioSplitter.
+The block is reference counted and is returned to the Async::BlockPool
+when the last reference is released. This avoid allocating memory for each
+block in the steady state. Use the AudioSampleBlockPtr class to handle the
+references.
+
+The pool is not thread safe so blocks should only be used from the thread
+running the main event loop.
+*/
+class AudioSampleBlock
+{
+  public:
+    /**
+     * @brief   Get a block from the pool
+     * @param   len The number of samples that the block should hold
+     * @return  Returns a new block with a reference count of one
+     *
+     * The block object and the samples are kept in a single block taken
+     * from the Async::BlockPool.
+     */
+    static AudioSampleBlock *allocate(int len);
+
+    /**
+     * @brief   Delete all free blocks in the pool
+     *
+     * Note that the pool is shared with all other users of the
+     * Async::BlockPool.
+     */
+    static void clearPool(void);
+
+    /**
+     * @brief   Add a reference to the block
+     */
+    void ref(void) { ++ref_cnt; }
+
+    /**
+     * @brief   Release a reference to the block
+     *
+     * When the last reference is released the block is returned to the pool.
+     */
+    void unref(void);
+
+    /**
+     * @brief   Get the number of references to this block
+     * @return  Returns the reference count
+     */
+    int refCount(void) const { return ref_cnt; }
+
+    /**
+     * @brief   Get a pointer to the samples
+     * @return  Returns a pointer to the first sample in the block
+     */
+    float *data(void) { return samples; }
+
+    /**
+     * @brief   Get a pointer to the samples
+     * @return  Returns a pointer to the first sample in the block
+     */
+    const float *data(void) const { return samples; }
+
+    /**
+     * @brief   Get the number of samples in the block
+     * @return  Returns the number of samples in the block
+     */
+    int size(void) const { return len; }
+
+    /**
+     * @brief   Get the maximum number of samples the block can hold
+     * @return  Returns the capacity of the block
+     */
+    int capacity(void) const { return cap; }
+
+  private:
+    static const size_t HEADER_SIZE = 32;
+
+    int               ref_cnt;
+    int               len;
+    int               cap;
+    float             *samples;
+
+    AudioSampleBlock(int len, int cap);
+    ~AudioSampleBlock(void) {}
+    AudioSampleBlock(const AudioSampleBlock&);
+    AudioSampleBlock& operator=(const AudioSampleBlock&);
+
+};  /* class AudioSampleBlock */
+
+
+/**
+@brief	A smart pointer handling references to an AudioSampleBlock
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+Copying the pointer adds a reference to the block and destroying it releases
+the reference. If the block need to be modified while it is shared, call
+makeUnique first to get a private copy of it.
+*/
+class AudioSampleBlockPtr
+{
+  public:
+    /**
+     * @brief   Default constructor, creating a null pointer
+     */
+    AudioSampleBlockPtr(void) : blk(0) {}
+
+    /**
+     * @brief   Constructor
+     * @param   blk A newly allocated block
+     *
+     * The pointer takes over the reference returned by
+     * AudioSampleBlock::allocate.
+     */
+    explicit AudioSampleBlockPtr(AudioSampleBlock *blk) : blk(blk) {}
+
+    /**
+     * @brief   Copy constructor
+     * @param   other The pointer to copy
+     */
+    AudioSampleBlockPtr(const AudioSampleBlockPtr &other) : blk(other.blk)
+    {
+      if (blk != 0)
+      {
+        blk->ref();
+      }
+    }
+
+    /**
+     * @brief   Destructor
+     */
+    ~AudioSampleBlockPtr(void) { reset(); }
+
+    /**
+     * @brief   Assignment operator
+     * @param   other The pointer to assign from
+     * @return  Returns a reference to this object
+     */
+    AudioSampleBlockPtr& operator=(const AudioSampleBlockPtr &other)
+    {
+      if (other.blk != 0)
+      {
+        other.blk->ref();
+      }
+      reset();
+      blk = other.blk;
+      return *this;
+    }
+
+    /**
+     * @brief   Release the reference and make this a null pointer
+     */
+    void reset(void)
+    {
+      if (blk != 0)
+      {
+        blk->unref();
+        blk = 0;
+      }
+    }
+
+    /**
+     * @brief   Make sure that this pointer is the only reference to the block
+     *
+     * If the block is shared with other pointers, the samples are copied to
+     * a new block that is only referenced by this pointer.
+     */
+    void makeUnique(void);
+
+    /**
+     * @brief   Check if this is a null pointer
+     * @return  Returns \em true if no block is referenced
+     */
+    bool isNull(void) const { return blk == 0; }
+
+    /**
+     * @brief   Get the referenced block
+     * @return  Returns a pointer to the block or 0 if this is a null pointer
+     */
+    AudioSampleBlock *get(void) const { return blk; }
+
+    AudioSampleBlock *operator->(void) const { return blk; }
+    AudioSampleBlock &operator*(void) const { return *blk; }
+
+  private:
+    AudioSampleBlock *blk;
+
+};  /* class AudioSampleBlockPtr */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_SAMPLE_BLOCK_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,506 @@
+/**
+@file   AsyncAudioSampleOps.cpp
+@brief  Vectorized sample format conversion and mixing kernels
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains the implementation of the AudioSampleOps class which select
+the best sample conversion and mixing kernels for the running CPU.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ASYNC_SAMPLEOPS_X86
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ASYNC_SAMPLEOPS_NEON
+#include <arm_neon.h>
+#endif
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioSampleOps.h"
+#include "AsyncAudioCpuFeatures.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void s16_to_float_scalar(float *dst, const int16_t *src, int len,
+                                int stride);
+static void mix_float_to_s16_scalar(int16_t *dst, const float *src, int len,
+                                    int stride);
+static void mix_scalar(float *dst, const float *src, int len, float gain);
+static double energy_scalar(const float *src, int len);
+#ifdef ASYNC_SAMPLEOPS_X86
+static void s16_to_float_sse2(float *dst, const int16_t *src, int len,
+                              int stride)
+  __attribute__((target("sse2")));
+static void mix_float_to_s16_sse2(int16_t *dst, const float *src, int len,
+                                  int stride)
+  __attribute__((target("sse2")));
+static void mix_sse2(float *dst, const float *src, int len, float gain)
+  __attribute__((target("sse2")));
+static double energy_sse2(const float *src, int len)
+  __attribute__((target("sse2")));
+#endif
+#ifdef ASYNC_SAMPLEOPS_NEON
+static void s16_to_float_neon(float *dst, const int16_t *src, int len,
+                              int stride);
+static void mix_float_to_s16_neon(int16_t *dst, const float *src, int len,
+                                  int stride);
+static void mix_neon(float *dst, const float *src, int len, float gain);
+static double energy_neon(const float *src, int len);
+#endif
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+static const float S16_TO_FLOAT = 1.0f / 32768.0f;
+static const float FLOAT_TO_S16 = 32767.0f;
+static const float S16_MAX = 32767.0f;
+
+/* The max number of squared samples that are summed in single precision */
+static const int ENERGY_CHUNK = 64;
+
+const AudioSampleOps::Kernels *AudioSampleOps::active = 0;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void AudioSampleOps::init(void)
+{
+  static const Kernels scalar_kernels =
+  {
+    "scalar", s16_to_float_scalar, mix_float_to_s16_scalar, mix_scalar,
+    energy_scalar
+  };
+#ifdef ASYNC_SAMPLEOPS_X86
+  static const Kernels sse2_kernels =
+  {
+    "sse2", s16_to_float_sse2, mix_float_to_s16_sse2, mix_sse2,
+    energy_sse2
+  };
+#endif
+#ifdef ASYNC_SAMPLEOPS_NEON
+  static const Kernels neon_kernels =
+  {
+    "neon", s16_to_float_neon, mix_float_to_s16_neon, mix_neon,
+    energy_neon
+  };
+#endif
+
+  AudioCpuFeatures::addDispatcher(init);
+
+  const char *force = getenv("ASYNC_AUDIO_SAMPLEOPS");
+  if (force == 0)
+  {
+    force = "";
+  }
+
+#ifdef ASYNC_SAMPLEOPS_X86
+  if (AudioCpuFeatures::has(AudioCpuFeatures::SSE2) &&
+      (strcmp(force, "scalar") != 0))
+  {
+    active = &sse2_kernels;
+    return;
+  }
+#endif
+
+#ifdef ASYNC_SAMPLEOPS_NEON
+  if (AudioCpuFeatures::has(AudioCpuFeatures::NEON) &&
+      (strcmp(force, "scalar") != 0))
+  {
+    active = &neon_kernels;
+    return;
+  }
+#endif
+
+  active = &scalar_kernels;
+} /* AudioSampleOps::init */
+
+
+
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+static void s16_to_float_scalar(float *dst, const int16_t *src, int len,
+                                int stride)
+{
+  for (int i=0; i<len; ++i)
+  {
+    dst[i] = static_cast<float>(src[i * stride]) * S16_TO_FLOAT;
+  }
+} /* s16_to_float_scalar */
+
+
+static void mix_float_to_s16_scalar(int16_t *dst, const float *src, int len,
+                                    int stride)
+{
+  for (int i=0; i<len; ++i)
+  {
+    int16_t *d = dst + i * stride;
+    float sample = FLOAT_TO_S16 * src[i] + *d;
+    if (sample > S16_MAX)
+    {
+      *d = 32767;
+    }
+    else if (sample < -S16_MAX)
+    {
+      *d = -32767;
+    }
+    else
+    {
+      *d = static_cast<int16_t>(sample);
+    }
+  }
+} /* mix_float_to_s16_scalar */
+
+
+static void mix_scalar(float *dst, const float *src, int len, float gain)
+{
+  for (int i=0; i<len; ++i)
+  {
+    dst[i] += gain * src[i];
+  }
+} /* mix_scalar */
+
+
+static double energy_scalar(const float *src, int len)
+{
+  double energy = 0.0;
+  for (int i=0; i<len; ++i)
+  {
+    energy += src[i] * src[i];
+  }
+  return energy;
+} /* energy_scalar */
+
+
+#ifdef ASYNC_SAMPLEOPS_X86
+static void s16_to_float_sse2(float *dst, const int16_t *src, int len,
+                              int stride)
+{
+  const __m128 scale = _mm_set1_ps(S16_TO_FLOAT);
+  int i = 0;
+  if (stride == 1)
+  {
+    for (; i + 8 <= len; i += 8)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+      _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+  }
+  else if (stride == 2)
+  {
+      // Sign extend the even 16 bit lanes of four stereo frames
+    for (; i + 4 <= len; i += 4)
+    {
+      __m128i v = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(src + 2 * i));
+      __m128i even = _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+      _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(even), scale));
+    }
+  }
+  s16_to_float_scalar(dst + i, src + i * stride, len - i, stride);
+} /* s16_to_float_sse2 */
+
+
+static void mix_float_to_s16_sse2(int16_t *dst, const float *src, int len,
+                                  int stride)
+{
+  const __m128 scale = _mm_set1_ps(FLOAT_TO_S16);
+  const __m128 max = _mm_set1_ps(S16_MAX);
+  const __m128 min = _mm_set1_ps(-S16_MAX);
+  int i = 0;
+  if (stride == 1)
+  {
+    for (; i + 8 <= len; i += 8)
+    {
+      __m128i *d = reinterpret_cast<__m128i*>(dst + i);
+      __m128i v = _mm_loadu_si128(d);
+      __m128 lo = _mm_cvtepi32_ps(
+          _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+      __m128 hi = _mm_cvtepi32_ps(
+          _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+      lo = _mm_add_ps(_mm_mul_ps(scale, _mm_loadu_ps(src + i)), lo);
+      hi = _mm_add_ps(_mm_mul_ps(scale, _mm_loadu_ps(src + i + 4)), hi);
+      lo = _mm_max_ps(_mm_min_ps(lo, max), min);
+      hi = _mm_max_ps(_mm_min_ps(hi, max), min);
+      _mm_storeu_si128(d, _mm_packs_epi32(_mm_cvttps_epi32(lo),
+                                          _mm_cvttps_epi32(hi)));
+    }
+  }
+  else if (stride == 2)
+  {
+      // Replace the even 16 bit lanes of four stereo frames, keeping the
+      // samples of the other channel
+    const __m128i even_mask = _mm_set1_epi32(0x0000ffff);
+    for (; i + 4 <= len; i += 4)
+    {
+      __m128i *d = reinterpret_cast<__m128i*>(dst + 2 * i);
+      __m128i v = _mm_loadu_si128(d);
+      __m128 even = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+      even = _mm_add_ps(_mm_mul_ps(scale, _mm_loadu_ps(src + i)), even);
+      even = _mm_max_ps(_mm_min_ps(even, max), min);
+      __m128i res = _mm_and_si128(_mm_cvttps_epi32(even), even_mask);
+      _mm_storeu_si128(d, _mm_or_si128(res, _mm_andnot_si128(even_mask, v)));
+    }
+  }
+  mix_float_to_s16_scalar(dst + i * stride, src + i, len - i, stride);
+} /* mix_float_to_s16_sse2 */
+
+
+static void mix_sse2(float *dst, const float *src, int len, float gain)
+{
+  const __m128 g = _mm_set1_ps(gain);
+  int i = 0;
+  for (; i + 8 <= len; i += 8)
+  {
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i),
+                                      _mm_mul_ps(g, _mm_loadu_ps(src + i))));
+    _mm_storeu_ps(dst + i + 4,
+                  _mm_add_ps(_mm_loadu_ps(dst + i + 4),
+                             _mm_mul_ps(g, _mm_loadu_ps(src + i + 4))));
+  }
+  mix_scalar(dst + i, src + i, len - i, gain);
+} /* mix_sse2 */
+
+
+static double energy_sse2(const float *src, int len)
+{
+  double energy = 0.0;
+  int i = 0;
+  while (i + 8 <= len)
+  {
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    const int end = (len - i > ENERGY_CHUNK) ? i + ENERGY_CHUNK : len - 7;
+    for (; i < end; i += 8)
+    {
+      const __m128 x0 = _mm_loadu_ps(src + i);
+      const __m128 x1 = _mm_loadu_ps(src + i + 4);
+      acc0 = _mm_add_ps(acc0, _mm_mul_ps(x0, x0));
+      acc1 = _mm_add_ps(acc1, _mm_mul_ps(x1, x1));
+    }
+    float sum[4];
+    _mm_storeu_ps(sum, _mm_add_ps(acc0, acc1));
+    energy += (static_cast<double>(sum[0]) + sum[1]) + (sum[2] + sum[3]);
+  }
+  return energy + energy_scalar(src + i, len - i);
+} /* energy_sse2 */
+#endif /* ASYNC_SAMPLEOPS_X86 */
+
+
+#ifdef ASYNC_SAMPLEOPS_NEON
+static void s16_to_float_neon(float *dst, const int16_t *src, int len,
+                              int stride)
+{
+  int i = 0;
+  if ((stride == 1) || (stride == 2))
+  {
+    for (; i + 8 <= len; i += 8)
+    {
+      int16x8_t v = (stride == 1) ? vld1q_s16(src + i)
+                                  : vld2q_s16(src + 2 * i).val[0];
+      float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+      float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+      vst1q_f32(dst + i, vmulq_n_f32(lo, S16_TO_FLOAT));
+      vst1q_f32(dst + i + 4, vmulq_n_f32(hi, S16_TO_FLOAT));
+    }
+  }
+  s16_to_float_scalar(dst + i, src + i * stride, len - i, stride);
+} /* s16_to_float_neon */
+
+
+static void mix_float_to_s16_neon(int16_t *dst, const float *src, int len,
+                                  int stride)
+{
+  const float32x4_t max = vdupq_n_f32(S16_MAX);
+  const float32x4_t min = vdupq_n_f32(-S16_MAX);
+  int i = 0;
+  if ((stride == 1) || (stride == 2))
+  {
+    for (; i + 8 <= len; i += 8)
+    {
+      int16x8x2_t frames;
+      if (stride == 1)
+      {
+        frames.val[0] = vld1q_s16(dst + i);
+      }
+      else
+      {
+        frames = vld2q_s16(dst + 2 * i);
+      }
+      int16x8_t v = frames.val[0];
+      float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+      float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+      lo = vaddq_f32(vmulq_n_f32(vld1q_f32(src + i), FLOAT_TO_S16), lo);
+      hi = vaddq_f32(vmulq_n_f32(vld1q_f32(src + i + 4), FLOAT_TO_S16), hi);
+      lo = vmaxq_f32(vminq_f32(lo, max), min);
+      hi = vmaxq_f32(vminq_f32(hi, max), min);
+      frames.val[0] = vcombine_s16(vmovn_s32(vcvtq_s32_f32(lo)),
+                                   vmovn_s32(vcvtq_s32_f32(hi)));
+      if (stride == 1)
+      {
+        vst1q_s16(dst + i, frames.val[0]);
+      }
+      else
+      {
+        vst2q_s16(dst + 2 * i, frames);
+      }
+    }
+  }
+  mix_float_to_s16_scalar(dst + i * stride, src + i, len - i, stride);
+} /* mix_float_to_s16_neon */
+
+
+static void mix_neon(float *dst, const float *src, int len, float gain)
+{
+  int i = 0;
+  for (; i + 4 <= len; i += 4)
+  {
+    vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i),
+                                 vmulq_n_f32(vld1q_f32(src + i), gain)));
+  }
+  mix_scalar(dst + i, src + i, len - i, gain);
+} /* mix_neon */
+
+
+static double energy_neon(const float *src, int len)
+{
+  double energy = 0.0;
+  int i = 0;
+  while (i + 8 <= len)
+  {
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    const int end = (len - i > ENERGY_CHUNK) ? i + ENERGY_CHUNK : len - 7;
+    for (; i < end; i += 8)
+    {
+      const float32x4_t x0 = vld1q_f32(src + i);
+      const float32x4_t x1 = vld1q_f32(src + i + 4);
+      acc0 = vmlaq_f32(acc0, x0, x0);
+      acc1 = vmlaq_f32(acc1, x1, x1);
+    }
+    float sum[4];
+    vst1q_f32(sum, vaddq_f32(acc0, acc1));
+    energy += (static_cast<double>(sum[0]) + sum[1]) + (sum[2] + sum[3]);
+  }
+  return energy + energy_scalar(src + i, len - i);
+} /* energy_neon */
+#endif /* ASYNC_SAMPLEOPS_NEON */
+
+
+/*
+ * This file has not been truncated
+ */
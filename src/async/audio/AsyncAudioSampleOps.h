@@ -0,0 +1,233 @@
+/**
+@file   AsyncAudioSampleOps.h
+@brief  Vectorized sample format conversion and mixing kernels
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a small helper class with SIMD kernels for converting audio
+samples between the 16 bit integer format used by the audio devices and the
+float format used in the audio pipes, and for mixing audio streams. The best
+kernel for the running CPU is selected at runtime.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_SAMPLE_OPS_INCLUDED
+#define ASYNC_AUDIO_SAMPLE_OPS_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Sample format conversion and mixing using the best SIMD kernel
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class contain the inner loops used when converting between interleaved
+16 bit device buffers and per channel float buffers, when mixing float
+audio streams and when calculating the energy of a block of samples. The kernels are selected at runtime depending on what the CPU
+support. SSE2 is used on x86 and NEON is used on ARM if the code was compiled
+with NEON support. A plain C++ implementation is used as a fallback. The
+strided kernels are vectorized for mono and stereo buffers. Other channel
+counts use the plain implementation.
+
+The kernel may be forced by setting the environment variable
+ASYNC_AUDIO_SAMPLEOPS to one of "scalar", "sse2" or "neon". If the given
+kernel is not available, the default selection is used. Only the features
+enabled in AudioCpuFeatures are used.
+*/
+class AudioSampleOps
+{
+  public:
+    /**
+     * @brief   Convert 16 bit samples to float
+     * @param   dst     The destination buffer
+     * @param   src     The first 16 bit sample to convert
+     * @param   len     The number of samples to convert
+     * @param   stride  The distance between two samples in the source buffer
+     *
+     * The samples are scaled so that the 16 bit range maps to -1.0 - 1.0. To
+     * convert one channel of an interleaved buffer, point src at the first
+     * sample of that channel and set the stride to the number of channels.
+     */
+    static void s16ToFloat(float *dst, const int16_t *src, int len,
+                           int stride=1)
+    {
+      kernels().s16_to_float(dst, src, len, stride);
+    }
+
+    /**
+     * @brief   Mix float samples into a 16 bit buffer
+     * @param   dst     The first 16 bit sample to mix into
+     * @param   src     The float samples to mix
+     * @param   len     The number of samples to mix
+     * @param   stride  The distance between two samples in the destination
+     *
+     * Each float sample is scaled to the 16 bit range and added to the
+     * destination sample. The result is clipped to +-32767. Mixing into a
+     * zeroed buffer gives a plain conversion.
+     */
+    static void mixFloatToS16(int16_t *dst, const float *src, int len,
+                              int stride=1)
+    {
+      kernels().mix_float_to_s16(dst, src, len, stride);
+    }
+
+    /**
+     * @brief   Mix float samples into a float buffer
+     * @param   dst   The buffer to mix into
+     * @param   src   The samples to mix
+     * @param   len   The number of samples to mix
+     * @param   gain  The gain (linear) to apply to the source samples
+     */
+    static void mix(float *dst, const float *src, int len, float gain=1.0f)
+    {
+      kernels().mix(dst, src, len, gain);
+    }
+
+    /**
+     * @brief   Calculate the energy of a block of samples
+     * @param   src   The samples
+     * @param   len   The number of samples
+     * @return  Returns the sum of the squared samples
+     *
+     * Partial sums are kept in single precision for at most 64 samples at a
+     * time before being added to the double precision result.
+     */
+    static double energy(const float *src, int len)
+    {
+      return kernels().energy(src, len);
+    }
+
+    /**
+     * @brief   Get the name of the selected kernel
+     * @return  Returns the name of the kernel, e.g. "sse2"
+     */
+    static const char *kernelName(void) { return kernels().name; }
+
+  private:
+    struct Kernels
+    {
+      const char *name;
+      void (*s16_to_float)(float *dst, const int16_t *src, int len,
+                           int stride);
+      void (*mix_float_to_s16)(int16_t *dst, const float *src, int len,
+                               int stride);
+      void (*mix)(float *dst, const float *src, int len, float gain);
+      double (*energy)(const float *src, int len);
+    };
+
+    static const Kernels *active;
+
+    static const Kernels& kernels(void)
+    {
+      if (active == 0)
+      {
+        init();
+      }
+      return *active;
+    }
+
+    static void init(void);
+
+    AudioSampleOps(void);
+};  /* class AudioSampleOps */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_SAMPLE_OPS_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,186 @@
+/**
+@file   AsyncAudioSampleRate.h
+@brief  The sample rate used for internal audio processing
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_SAMPLE_RATE_INCLUDED
+#define ASYNC_AUDIO_SAMPLE_RATE_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#ifndef DEFAULT_INTERNAL_SAMPLE_RATE
+#define DEFAULT_INTERNAL_SAMPLE_RATE 16000
+#endif
+
+/**
+ * @brief The sample rate currently used for internal audio processing
+ */
+#define INTERNAL_SAMPLE_RATE (Async::AudioSampleRate::internal())
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  The sample rate used for internal audio processing
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+All audio processing inside an application is done at one sample rate, the
+internal sample rate. It defaults to the rate chosen when building, using the
+INTERNAL_SAMPLE_RATE CMake variable, but an application may select another
+supported rate at startup. A lower rate trade audio bandwidth for less CPU
+usage. The rate must be selected before any audio objects are created since
+they read it when they are set up. Use the INTERNAL_SAMPLE_RATE macro to get
+the rate in use.
+*/
+class AudioSampleRate
+{
+  public:
+    /**
+     * @brief The internal sample rate used if no other rate is selected
+     */
+    static const int DEFAULT = DEFAULT_INTERNAL_SAMPLE_RATE;
+
+    /**
+     * @brief The highest supported internal sample rate
+     *
+     * Use this to size buffers that depend on the sample rate.
+     */
+    static const int MAX = 16000;
+
+    /**
+     * @brief   Check if a sample rate can be used as the internal rate
+     * @param   rate The sample rate to check
+     * @return  Returns \em true if the rate is supported
+     */
+    static bool isSupported(int rate)
+    {
+      return (rate == 8000) || (rate == 16000);
+    }
+
+    /**
+     * @brief   Select the internal sample rate
+     * @param   rate The sample rate to use
+     * @return  Returns \em true on success or \em false if the rate is not
+     *          supported
+     *
+     * This function must be called before any audio objects are created.
+     */
+    static bool setInternal(int rate);
+
+    /**
+     * @brief   Get the internal sample rate
+     * @return  Returns the internal sample rate in Hz
+     */
+    static int internal(void) { return internal_rate; }
+
+    /**
+     * @brief   Check if the internal sample rate is wideband
+     * @return  Returns \em true if the internal rate is 16kHz or more
+     */
+    static bool isWideband(void) { return internal_rate >= 16000; }
+
+  private:
+    static int internal_rate;
+
+    AudioSampleRate(void);
+};  /* class AudioSampleRate */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_SAMPLE_RATE_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -82,24 +82,42 @@ using namespace Async;
 class Async::AudioSelector::Branch : public AudioSink
 {
   public:
-    Branch(AudioSelector *selector)
-      : m_selector(selector), m_auto_select(false), m_prio(0),
-        m_stream_state(STATE_IDLE), m_flush_wait(true)
+    Branch(AudioSelector *selector, AudioSource *source)
+      : m_selector(selector), m_source(source), m_auto_select(false),
+        m_prio(0), m_stream_state(STATE_IDLE), m_flush_wait(true),
+        m_is_active(false), m_active_prio(0)
     {
       assert(selector != 0);
     }
 
+    ~Branch(void)
+    {
+      setInactive();
+    }
+
+    AudioSource *source(void) const { return m_source; }
     StreamState streamState(void) const { return m_stream_state; }
-    void setSelectionPrio(int prio) { m_prio = prio; }
     int selectionPrio(void) const { return m_prio; }
-    void enableAutoSelect(void) { m_auto_select = true; }
     bool autoSelectEnabled(void) const { return m_auto_select; }
     void setFlushWait(bool flush_wait) { m_flush_wait = flush_wait; }
     bool flushWait(void) const { return m_flush_wait; }
 
+    void setSelectionPrio(int prio)
+    {
+      m_prio = prio;
+      updateActive();
+    }
+
+    void enableAutoSelect(void)
+    {
+      m_auto_select = true;
+      updateActive();
+    }
+
     void disableAutoSelect(void)
     {
       m_auto_select = false;
+      updateActive();
       if (isSelected())
       {
         m_selector->selectHighestPrioActiveBranch(true);
@@ -114,7 +132,7 @@ class Async::AudioSelector::Branch : public AudioSink
     virtual int writeSamples(const float *samples, int count)
     {
       assert(count > 0);
-      m_stream_state = STATE_WRITING;
+      setStreamState(STATE_WRITING);
       if (m_auto_select && !isSelected())
       {
 	const Branch *selected_branch = m_selector->selectedBranch();
@@ -130,7 +148,7 @@ class Async::AudioSelector::Branch : public AudioSink
         ret = m_selector->branchWriteSamples(samples, count);
         if (ret == 0)
         {
-          m_stream_state = STATE_STOPPED;
+          setStreamState(STATE_STOPPED);
         }
       }
       return ret;
@@ -148,12 +166,12 @@ class Async::AudioSelector::Branch : public AudioSink
         case STATE_STOPPED:
           if (isSelected())
           {
-            m_stream_state = STATE_FLUSHING;
+            setStreamState(STATE_FLUSHING);
             m_selector->branchFlushSamples();
           }
           else
           {
-            m_stream_state = STATE_IDLE;
+            setStreamState(STATE_IDLE);
             sourceAllSamplesFlushed();
           }
           break;
@@ -167,7 +185,7 @@ class Async::AudioSelector::Branch : public AudioSink
     {
       if (m_stream_state == STATE_STOPPED)
       {
-        m_stream_state = STATE_WRITING;
+        setStreamState(STATE_WRITING);
         sourceResumeOutput();
       }
     }
@@ -176,7 +194,7 @@ class Async::AudioSelector::Branch : public AudioSink
     {
       if (m_stream_state == STATE_FLUSHING)
       {
-        m_stream_state = STATE_IDLE;
+        setStreamState(STATE_IDLE);
         if (m_auto_select)
         {
           m_selector->selectBranch(0);
@@ -194,23 +212,63 @@ class Async::AudioSelector::Branch : public AudioSink
           break;
 
         case STATE_STOPPED:
-          m_stream_state = STATE_WRITING;
+          setStreamState(STATE_WRITING);
           sourceResumeOutput();
           break;
 
         case STATE_FLUSHING:
-          m_stream_state = STATE_IDLE;
+          setStreamState(STATE_IDLE);
           sourceAllSamplesFlushed();
           break;
       }
     }
 
+    void setInactive(void)
+    {
+      if (m_is_active)
+      {
+        m_selector->removeActiveBranch(m_active_it, m_active_prio);
+        m_is_active = false;
+      }
+    }
+
   private:
-    AudioSelector * m_selector;
-    bool            m_auto_select;
-    int             m_prio;
-    StreamState     m_stream_state;
-    bool            m_flush_wait;
+    AudioSelector *         m_selector;
+    AudioSource *           m_source;
+    bool                    m_auto_select;
+    int                     m_prio;
+    StreamState             m_stream_state;
+    bool                    m_flush_wait;
+    bool                    m_is_active;
+    int                     m_active_prio;
+    BranchList::iterator    m_active_it;
+
+    void setStreamState(StreamState state)
+    {
+      if (state != m_stream_state)
+      {
+        m_stream_state = state;
+        updateActive();
+      }
+    }
+
+      // Keep the selector's set of active auto select branches up to date
+    void updateActive(void)
+    {
+      bool active = m_auto_select &&
+                    ((m_stream_state == STATE_WRITING) ||
+                     (m_stream_state == STATE_STOPPED));
+      if (m_is_active && (!active || (m_active_prio != m_prio)))
+      {
+        setInactive();
+      }
+      if (active && !m_is_active)
+      {
+        m_active_prio = m_prio;
+        m_active_it = m_selector->addActiveBranch(this, m_active_prio);
+        m_is_active = true;
+      }
+    }
 
 }; /* class Async::AudioSelector::Branch */
 
@@ -267,7 +325,7 @@ void AudioSelector::addSource(Async::AudioSource *source)
 {
   assert(source != 0);
   assert(m_branch_map.find(source) == m_branch_map.end());
-  Branch *branch = new Branch(this);
+  Branch *branch = new Branch(this, source);
   source->registerSink(branch);
   m_branch_map[source] = branch;
 } /* AudioSelector::addSource */
@@ -280,6 +338,7 @@ void AudioSelector::removeSource(AudioSource *source)
   Branch *branch = (*it).second;
   m_branch_map.erase(it);
   assert(m_branch_map.find(source) == m_branch_map.end());
+  branch->setInactive();
   if (branch == selectedBranch())
   {
     selectHighestPrioActiveBranch(true);
@@ -341,15 +400,7 @@ void AudioSelector::selectSource(AudioSource *source)
 
 AudioSource *AudioSelector::selectedSource(void) const
 {
-  for (BranchMap::const_iterator it = m_branch_map.begin();
-       it != m_branch_map.end(); ++it)
-  {
-    if (it->second == selectedBranch())
-    {
-      return it->first;
-    }
-  }
-  return 0;
+  return (m_selected_branch != 0) ? m_selected_branch->source() : 0;
 } /* AudioSelector::selectedSource */
 
 
@@ -480,21 +531,12 @@ void AudioSelector::selectBranch(Branch *branch)
 
 void AudioSelector::selectHighestPrioActiveBranch(bool clear_if_no_active)
 {
+    // Among branches with the same priority, the one that became active
+    // first is chosen
   Branch *new_branch = 0;
-  for (BranchMap::iterator it = m_branch_map.begin();
-       it != m_branch_map.end(); ++it)
+  if (!m_active_branches.empty())
   {
-    Branch *branch = (*it).second;
-    if (branch->autoSelectEnabled())
-    {
-      if (((branch->streamState() == STATE_WRITING) ||
-           (branch->streamState() == STATE_STOPPED)) &&
-          ((new_branch == 0) ||
-          (branch->selectionPrio() > new_branch->selectionPrio())))
-      {
-        new_branch = branch;
-      }
-    }
+    new_branch = m_active_branches.rbegin()->second.front();
   }
   if ((new_branch != 0) || clear_if_no_active)
   {
@@ -503,6 +545,26 @@ void AudioSelector::selectHighestPrioActiveBranch(bool clear_if_no_active)
 } /* AudioSelector::selectHighestPrioActiveBranch */
 
 
+AudioSelector::BranchList::iterator AudioSelector::addActiveBranch(
+    Branch *branch, int prio)
+{
+  BranchList &branches = m_active_branches[prio];
+  return branches.insert(branches.end(), branch);
+} /* AudioSelector::addActiveBranch */
+
+
+void AudioSelector::removeActiveBranch(BranchList::iterator it, int prio)
+{
+  ActiveMap::iterator ait = m_active_branches.find(prio);
+  assert(ait != m_active_branches.end());
+  ait->second.erase(it);
+  if (ait->second.empty())
+  {
+    m_active_branches.erase(ait);
+  }
+} /* AudioSelector::removeActiveBranch */
+
+
 /*
  * This file has not been truncated
  */
@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <map>
+#include <list>
 
 
 /****************************************************************************
@@ -110,6 +111,11 @@ namespace Async
 
 This class is used to select one of many incoming audio streams. Incoming
 samples on non-selected branches will be thrown away.
+
+Branches with auto select enabled that currently have an active stream are
+kept in per priority lists so finding the highest priority active branch does
+not require scanning all branches. This keeps switching cheap even when there
+are many sources, like one per connected station.
 */
 class AudioSelector : public AudioSource
 {
@@ -211,8 +217,11 @@ class AudioSelector : public AudioSource
 
     class Branch;
     typedef std::map<Async::AudioSource *, Branch *> BranchMap;
-    
+    typedef std::list<Branch *> BranchList;
+    typedef std::map<int, BranchList> ActiveMap;
+
     BranchMap 	m_branch_map;
+    ActiveMap   m_active_branches;
     Branch *    m_selected_branch;
     StreamState m_stream_state;
     
@@ -223,6 +232,8 @@ class AudioSelector : public AudioSource
     void selectHighestPrioActiveBranch(bool clear_if_no_active);
     int branchWriteSamples(const float *samples, int count);
     void branchFlushSamples(void);
+    BranchList::iterator addActiveBranch(Branch *branch, int prio);
+    void removeActiveBranch(BranchList::iterator it, int prio);
     
     friend class Branch;
     
@@ -50,6 +50,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "AsyncAudioSink.h"
 #include "AsyncAudioSource.h"
+#include "AsyncAudioProfiler.h"
 
 
 
@@ -115,6 +116,9 @@ AudioSink::~AudioSink(void)
 {
   unregisterSource();
   clearHandler();
+#ifdef ASYNC_AUDIO_PROFILING
+  AudioProfiler::removeNode(this);
+#endif
 } /* AudioSink::~AudioSink */
 
 
@@ -180,6 +180,30 @@ class AudioSink
       assert(m_handler != 0);
       m_handler->flushSamples();    
     }
+
+    /**
+     * @brief   Get a buffer to write samples directly into
+     * @param   count The number of samples that the source want to write
+     * @return  Returns a buffer with room for count samples or 0
+     *
+     * A sink that store the samples in a buffer of its own may reimplement
+     * this function so that a source, e.g. an audio decoder, can produce the
+     * samples directly into that buffer instead of copying them in a call to
+     * writeSamples. When a buffer is returned the source must call
+     * commitSamples, without any other call to the sink in between, when the
+     * samples have been written. If 0 is returned, the source should use
+     * writeSamples instead. The default implementation always return 0.
+     * This function is normally only called from a connected source object.
+     */
+    virtual float *writeBuffer(int count) { return 0; }
+
+    /**
+     * @brief   Commit samples written into the buffer from writeBuffer
+     * @param   count The number of samples written, may be less than asked for
+     *
+     * This function is normally only called from a connected source object.
+     */
+    virtual void commitSamples(int count) {}
     
     
   protected:
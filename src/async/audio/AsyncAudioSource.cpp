@@ -50,6 +50,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "AsyncAudioSource.h"
 #include "AsyncAudioSink.h"
+#include "AsyncAudioProfiler.h"
 
 
 
@@ -171,7 +172,13 @@ int AudioSource::sinkWriteSamples(const float *samples, int len)
   
   if (m_sink != 0)
   {
+#ifdef ASYNC_AUDIO_PROFILING
+    AudioProfiler::WriteProbe probe(m_sink, len);
     len = m_sink->writeSamples(samples, len);
+    probe.setAccepted(len);
+#else
+    len = m_sink->writeSamples(samples, len);
+#endif
   }
   
   return len;
@@ -179,11 +186,39 @@ int AudioSource::sinkWriteSamples(const float *samples, int len)
 } /* AudioSource::sinkWriteSamples */
 
 
+float *AudioSource::sinkWriteBuffer(int len)
+{
+  assert(len > 0);
+  return (m_sink != 0) ? m_sink->writeBuffer(len) : 0;
+} /* AudioSource::sinkWriteBuffer */
+
+
+void AudioSource::sinkCommitSamples(int len)
+{
+  assert((m_sink != 0) && (len >= 0));
+
+  if (len > 0)
+  {
+    is_flushing = false;
+  }
+#ifdef ASYNC_AUDIO_PROFILING
+  AudioProfiler::WriteProbe probe(m_sink, len);
+  m_sink->commitSamples(len);
+  probe.setAccepted(len);
+#else
+  m_sink->commitSamples(len);
+#endif
+} /* AudioSource::sinkCommitSamples */
+
+
 void AudioSource::sinkFlushSamples(void)
 {
   if (m_sink != 0)
   {
     is_flushing = true;
+#ifdef ASYNC_AUDIO_PROFILING
+    AudioProfiler::flushed(m_sink);
+#endif
     m_sink->flushSamples();
   }
   else
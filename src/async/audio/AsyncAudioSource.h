@@ -222,6 +222,25 @@ class AudioSource
      * normally be written again to the sink.
      */
     int sinkWriteSamples(const float *samples, int len);
+
+    /**
+     * @brief   Get a buffer in the connected sink to write samples into
+     * @param   len The number of samples that are going to be written
+     * @return  Returns a buffer with room for len samples or 0
+     *
+     * This function is used by the inheriting class to write samples
+     * directly into a buffer in the connected sink, see
+     * AudioSink::writeBuffer. If a buffer is returned, sinkCommitSamples
+     * must be called when the samples have been written. If 0 is returned,
+     * sinkWriteSamples should be used instead.
+     */
+    float *sinkWriteBuffer(int len);
+
+    /**
+     * @brief   Commit samples written into the buffer from sinkWriteBuffer
+     * @param   len The number of samples written
+     */
+    void sinkCommitSamples(int len);
     
     /*
      * @brief 	Tell the sink to flush any buffered samples
@@ -53,6 +53,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncAudioSource.h"
+#include "AsyncAudioSampleBlock.h"
 #include "AsyncAudioSplitter.h"
 
 
@@ -84,12 +85,16 @@ using namespace Async;
 class Async::AudioSplitter::Branch : public AudioSource
 {
   public:
-    int   current_buf_pos;
-    bool  is_flushed;
+    int                 current_buf_pos;
+    bool                is_flushed;
+    AudioSampleBlockPtr block;
+    int                 block_start;
+    bool                is_output;
   
     Branch(AudioSplitter *splitter)
-      : current_buf_pos(0), is_flushed(true), is_enabled(true),
-	is_stopped(false), is_flushing(false), splitter(splitter)
+      : current_buf_pos(0), is_flushed(true), block_start(0), is_output(false),
+        is_enabled(true), is_stopped(false), is_flushing(false),
+        splitter(splitter)
     {
     }
     
@@ -227,7 +232,7 @@ class Async::AudioSplitter::Branch : public AudioSource
  ****************************************************************************/
 
 AudioSplitter::AudioSplitter(void)
-  : buf(0), buf_size(0), buf_len(0), do_flush(false), input_stopped(false),
+  : buf_len(0), pending_branches(0), do_flush(false), input_stopped(false),
     flushed_branches(0), main_branch(0)
 {
   main_branch = new Branch(this);
@@ -238,7 +243,6 @@ AudioSplitter::AudioSplitter(void)
 
 AudioSplitter::~AudioSplitter(void)
 {
-  delete [] buf;
   removeAllSinks();
   AudioSource::clearHandler();
   delete main_branch;
@@ -292,6 +296,11 @@ void AudioSplitter::removeAllSinks(void)
   list<Branch *>::iterator it;
   for (it = branches.begin(); it != branches.end(); ++it)
   {
+    if (!(*it)->block.isNull())
+    {
+      (*it)->block.reset();
+      --pending_branches;
+    }
     if (*it != main_branch)
     {
       delete *it;
@@ -302,6 +311,36 @@ void AudioSplitter::removeAllSinks(void)
 } /* AudioSplitter::removeAllSinks */
 
 
+AudioSource *AudioSplitter::addOutput(void)
+{
+  Branch *branch = new Branch(this);
+  branch->is_output = true;
+  branches.push_back(branch);
+  if (do_flush)
+  {
+    branch->sinkFlushSamples();
+  }
+  return branch;
+} /* AudioSplitter::addOutput */
+
+
+void AudioSplitter::removeOutput(AudioSource *output)
+{
+  list<Branch *>::iterator it;
+  for (it = branches.begin(); it != branches.end(); ++it)
+  {
+    if ((*it == output) && (*it)->is_output)
+    {
+      (*it)->is_output = false;
+      (*it)->unregisterSink();
+      Async::Application::app().runTask(
+          mem_fun(*this, &AudioSplitter::cleanupBranches));
+      break;
+    }
+  }
+} /* AudioSplitter::removeOutput */
+
+
 void AudioSplitter::enableSink(AudioSink *sink, bool enable)
 {
   if (sink == main_branch->sink())
@@ -330,34 +369,42 @@ int AudioSplitter::writeSamples(const float *samples, int len)
     return 0;
   }
   
-  if (buf_len > 0)
+  if (pending_branches > 0)
   {
     input_stopped = true;
     return 0;
   }
   
-  bool samples_written = false;
-  
+  int min_pos = len;
   list<Branch *>::iterator it;
   for (it = branches.begin(); it != branches.end(); ++it)
   {
     (*it)->current_buf_pos = 0;
     int written = (*it)->sinkWriteSamples(samples, len);
-    if (written != len)
+    if (written < min_pos)
     {
-      if (buf_len == 0) // Only copy the buffer one time
+      min_pos = written;
+    }
+  }
+
+    // Samples that one or more branches did not accept are copied once into
+    // a shared block from the pool. Each branch that still need samples hold
+    // a reference to it. Samples that all branches accepted are not copied.
+  if (min_pos < len)
+  {
+    AudioSampleBlockPtr block(AudioSampleBlock::allocate(len - min_pos));
+    memcpy(block->data(), samples + min_pos,
+           (len - min_pos) * sizeof(*samples));
+    buf_len = len;
+    for (it = branches.begin(); it != branches.end(); ++it)
+    {
+      if ((*it)->current_buf_pos < len)
       {
-	if (buf_size < len)
-	{
-	  delete [] buf;
-          buf_size = len;
-	  buf = new float[buf_size];
-	}
-	memcpy(buf, samples, len * sizeof(*samples));
-	buf_len = len;
+        (*it)->block = block;
+        (*it)->block_start = min_pos;
+        ++pending_branches;
       }
     }
-    samples_written |= (written > 0);
   }
   
   writeFromBuffer();
@@ -383,7 +430,7 @@ void AudioSplitter::flushSamples(void)
   do_flush = true;
   flushed_branches = 0;
   
-  if (buf_len > 0)
+  if (pending_branches > 0)
   {
     return;
   }
@@ -442,7 +489,7 @@ void AudioSplitter::flushSamples(void)
 void AudioSplitter::writeFromBuffer(void)
 {
   bool samples_written = true;
-  bool all_written = (buf_len == 0);
+  bool all_written = (pending_branches == 0);
   
   //cout << "samples_written=" << samples_written << "  all_written="
     //   << all_written << endl;
@@ -450,21 +497,28 @@ void AudioSplitter::writeFromBuffer(void)
   while (samples_written && !all_written)
   {
     samples_written = false;
-    all_written = true;
     list<Branch *>::iterator it;
     for (it = branches.begin(); it != branches.end(); ++it)
     {
-      //cout << "(*it)->current_buf_pos=" << (*it)->current_buf_pos
+      Branch *branch = *it;
+      //cout << "branch->current_buf_pos=" << branch->current_buf_pos
 	//   << "  buf_len=" << buf_len << endl;
-      if ((*it)->current_buf_pos < buf_len)
+      if (!branch->block.isNull())
       {
-	int written = (*it)->sinkWriteSamples(buf+(*it)->current_buf_pos,
-	      	      	      	      	      buf_len-(*it)->current_buf_pos);
+        const float *samples = branch->block->data() +
+                               (branch->current_buf_pos - branch->block_start);
+	int written = branch->sinkWriteSamples(samples,
+                                               buf_len-branch->current_buf_pos);
 	//cout << "written=" << written << endl;
 	samples_written |= (written > 0);
-	all_written &= ((*it)->current_buf_pos == buf_len);
+        if (branch->current_buf_pos == buf_len)
+        {
+          branch->block.reset();
+          --pending_branches;
+        }
       }
     }
+    all_written = (pending_branches == 0);
     
     if (all_written)
     {
@@ -491,7 +545,7 @@ void AudioSplitter::flushAllBranches(void)
 void AudioSplitter::branchResumeOutput(void)
 {
   writeFromBuffer();
-  if (input_stopped && (buf_len == 0))
+  if (input_stopped && (pending_branches == 0))
   {
     input_stopped = false;
     sourceResumeOutput();
@@ -524,8 +578,13 @@ void AudioSplitter::cleanupBranches(void)
   list<Branch *>::iterator it = branches.begin();
   while (it != branches.end())
   {
-    if ((*it != main_branch) && !(*it)->isRegistered())
+    if ((*it != main_branch) && !(*it)->is_output && !(*it)->isRegistered())
     {
+      if (!(*it)->block.isNull())
+      {
+        (*it)->block.reset();
+        --pending_branches;
+      }
       list<Branch *>::iterator delete_it = it;
       ++it;
       delete *delete_it;
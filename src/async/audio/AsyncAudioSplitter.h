@@ -155,6 +155,25 @@ class AudioSplitter : public Async::AudioSink, public Async::AudioSource,
      */
     void enableSink(AudioSink *sink, bool enable);
 
+    /**
+     * @brief 	Add an output to the splitter
+     * @return	Returns an audio source for the new output
+     *
+     * This function add a new output branch to the splitter and return it as
+     * an audio source. This is used to connect the splitter directly to
+     * something that take an audio source, like an AudioSelector, without
+     * having to put an AudioPassthrough in between. The output is owned by
+     * the splitter and will be deleted when the splitter is deleted or when
+     * removeOutput is called.
+     */
+    AudioSource *addOutput(void);
+
+    /**
+     * @brief 	Remove an output that was added using addOutput
+     * @param 	output The output to remove
+     */
+    void removeOutput(AudioSource *output);
+
     /**
      * @brief 	Write samples into this audio sink
      * @param 	samples The buffer containing the samples
@@ -185,9 +204,8 @@ class AudioSplitter : public Async::AudioSink, public Async::AudioSource,
     class Branch;
     
     std::list<Branch *> branches;
-    float     	      	*buf;
-    int       	      	buf_size;
     int       	      	buf_len;
+    int       	      	pending_branches;
     bool      	      	do_flush;
     bool      	      	input_stopped;
     int       	      	flushed_branches;
@@ -0,0 +1,495 @@
+/**
+@file   AsyncAudioThreadFifo.cpp
+@brief  A lock-free audio FIFO that can be shared between two threads
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a FIFO for audio samples that can be shared between two
+threads, one writing and one reading samples, without using any locks.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncFdWatch.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioThreadFifo.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define MAX_WRITE_SIZE 800
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+AudioThreadFifo::AudioThreadFifo(unsigned fifo_size)
+  : fifo(0), fifo_size(0), mask(0), head(0), tail(0), prebuf(false),
+    flush_pending(false), reader_flushed(false), input_stopped(false),
+    notify_pending(false), overrun_cnt(0), underrun_cnt(0),
+    do_overwrite(false), prebuf_samples(0), output_stopped(false),
+    is_flushing(false), main_thread(pthread_self()), notifier_rd(-1),
+    notifier_wr(-1), notifier_watch(0)
+{
+  assert(fifo_size > 0);
+  allocFifo(fifo_size);
+
+  int fd[2];
+  if (pipe(fd) != 0)
+  {
+    cerr << "*** ERROR: Could not create pipe: " << strerror(errno) << endl;
+    return;
+  }
+  notifier_rd = fd[0];
+  notifier_wr = fd[1];
+  fcntl(notifier_rd, F_SETFL, fcntl(notifier_rd, F_GETFL) | O_NONBLOCK);
+  fcntl(notifier_wr, F_SETFL, fcntl(notifier_wr, F_GETFL) | O_NONBLOCK);
+  notifier_watch = new FdWatch(notifier_rd, FdWatch::FD_WATCH_RD);
+  notifier_watch->activity.connect(
+      mem_fun(*this, &AudioThreadFifo::notificationReceived));
+} /* AudioThreadFifo::AudioThreadFifo */
+
+
+AudioThreadFifo::~AudioThreadFifo(void)
+{
+  delete notifier_watch;
+  if (notifier_rd != -1)
+  {
+    close(notifier_rd);
+  }
+  if (notifier_wr != -1)
+  {
+    close(notifier_wr);
+  }
+  delete [] fifo;
+} /* AudioThreadFifo::~AudioThreadFifo */
+
+
+void AudioThreadFifo::setSize(unsigned new_size)
+{
+  assert(new_size > 0);
+  if (new_size != fifo_size)
+  {
+    allocFifo(new_size);
+  }
+  clear();
+} /* AudioThreadFifo::setSize */
+
+
+unsigned AudioThreadFifo::samplesInFifo(bool ignore_prebuf) const
+{
+  unsigned t = tail.load(memory_order_acquire);
+  unsigned h = head.load(memory_order_acquire);
+  unsigned samples_in_buffer = h - t;
+
+  if (!ignore_prebuf && prebuf.load(memory_order_relaxed) &&
+      !flush_pending.load(memory_order_relaxed))
+  {
+    if (samples_in_buffer < prebuf_samples)
+    {
+      return 0;
+    }
+  }
+
+  return samples_in_buffer;
+} /* AudioThreadFifo::samplesInFifo */
+
+
+void AudioThreadFifo::clear(void)
+{
+  unsigned t = tail.load(memory_order_acquire);
+  while (!tail.compare_exchange_weak(t, head.load(memory_order_acquire)))
+  {
+  }
+  prebuf = (prebuf_samples > 0);
+  output_stopped = false;
+  if (input_stopped.exchange(false))
+  {
+    sourceResumeOutput();
+  }
+  if (flush_pending && AudioSource::isRegistered())
+  {
+    writeSamplesFromFifo();
+  }
+} /* AudioThreadFifo::clear */
+
+
+void AudioThreadFifo::setPrebufSamples(unsigned prebuf_samples)
+{
+  this->prebuf_samples = min(prebuf_samples, fifo_size-1);
+  if (empty())
+  {
+    prebuf = (prebuf_samples > 0);
+  }
+} /* AudioThreadFifo::setPrebufSamples */
+
+
+int AudioThreadFifo::writeSamples(const float *samples, int count)
+{
+  assert(count > 0);
+
+  flush_pending.store(false, memory_order_relaxed);
+
+  unsigned h = head.load(memory_order_relaxed);
+  unsigned t = tail.load(memory_order_acquire);
+  unsigned space = fifo_size - (h - t);
+  unsigned to_write = count;
+  if (do_overwrite)
+  {
+      // Drop the oldest samples to make room for the new ones. The tail is
+      // updated with a compare-and-swap since the reader may move it at the
+      // same time.
+    if (to_write > fifo_size)
+    {
+      overrun_cnt += to_write - fifo_size;
+      samples += to_write - fifo_size;
+      to_write = fifo_size;
+    }
+    while (to_write > space)
+    {
+      unsigned new_tail = t + (to_write - space);
+      if (tail.compare_exchange_weak(t, new_tail, memory_order_acq_rel))
+      {
+        overrun_cnt += new_tail - t;
+        break;
+      }
+      space = fifo_size - (h - t);
+    }
+  }
+  else if (to_write > space)
+  {
+    to_write = space;
+  }
+
+  if (to_write > 0)
+  {
+    unsigned pos = h & mask;
+    unsigned first = min(to_write, mask + 1 - pos);
+    memcpy(fifo + pos, samples, first * sizeof(*fifo));
+    memcpy(fifo, samples + first, (to_write - first) * sizeof(*fifo));
+    head.store(h + to_write, memory_order_release);
+    if (AudioSource::isRegistered())
+    {
+      if (pthread_equal(pthread_self(), main_thread))
+      {
+        writeSamplesFromFifo();
+      }
+      else
+      {
+        notify();
+      }
+    }
+  }
+
+  if (to_write < static_cast<unsigned>(count))
+  {
+    input_stopped = true;
+  }
+
+  return to_write;
+} /* AudioThreadFifo::writeSamples */
+
+
+void AudioThreadFifo::flushSamples(void)
+{
+  flush_pending = true;
+  if (pthread_equal(pthread_self(), main_thread) &&
+      AudioSource::isRegistered())
+  {
+    writeSamplesFromFifo();
+  }
+  else
+  {
+    notify();
+  }
+} /* AudioThreadFifo::flushSamples */
+
+
+int AudioThreadFifo::readSamples(float *samples, int count)
+{
+  assert(count >= 0);
+
+  unsigned avail = samplesInFifo();
+  if (avail == 0)
+  {
+    if (flush_pending && empty())
+    {
+      flush_pending = false;
+      prebuf = (prebuf_samples > 0);
+      reader_flushed = true;
+      notify();
+    }
+    else if (!flush_pending)
+    {
+      ++underrun_cnt;
+    }
+    return 0;
+  }
+
+  prebuf.store(false, memory_order_relaxed);
+  unsigned read_cnt = copyOut(samples, count);
+  if (input_stopped.load(memory_order_relaxed))
+  {
+    notify();
+  }
+  return read_cnt;
+} /* AudioThreadFifo::readSamples */
+
+
+void AudioThreadFifo::resumeOutput(void)
+{
+  if (output_stopped)
+  {
+    output_stopped = false;
+    writeSamplesFromFifo();
+  }
+} /* AudioThreadFifo::resumeOutput */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+void AudioThreadFifo::allSamplesFlushed(void)
+{
+  if (is_flushing && empty())
+  {
+    is_flushing = false;
+    flush_pending = false;
+    prebuf = (prebuf_samples > 0);
+    sourceAllSamplesFlushed();
+  }
+} /* AudioThreadFifo::allSamplesFlushed */
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void AudioThreadFifo::allocFifo(unsigned size)
+{
+    // The ring buffer is a power of two in size so that the free running
+    // head and tail counters can be masked into buffer positions
+  unsigned capacity = 1;
+  while (capacity < size)
+  {
+    capacity <<= 1;
+  }
+  delete [] fifo;
+  fifo = new float[capacity];
+  fifo_size = size;
+  mask = capacity - 1;
+  head = 0;
+  tail = 0;
+} /* AudioThreadFifo::allocFifo */
+
+
+unsigned AudioThreadFifo::copyOut(float *samples, unsigned count)
+{
+  unsigned t = tail.load(memory_order_acquire);
+  for (;;)
+  {
+    unsigned h = head.load(memory_order_acquire);
+    unsigned n = min(count, h - t);
+    unsigned pos = t & mask;
+    unsigned first = min(n, mask + 1 - pos);
+    memcpy(samples, fifo + pos, first * sizeof(*fifo));
+    memcpy(samples + first, fifo, (n - first) * sizeof(*fifo));
+
+      // If the writer dropped samples in overwrite mode while we were
+      // copying, the tail has moved and we have to start over
+    if (tail.compare_exchange_strong(t, t + n, memory_order_acq_rel))
+    {
+      return n;
+    }
+  }
+} /* AudioThreadFifo::copyOut */
+
+
+void AudioThreadFifo::notify(void)
+{
+  if (!notify_pending.exchange(true) && (notifier_wr != -1))
+  {
+    char c = 0;
+    if (write(notifier_wr, &c, 1) != 1)
+    {
+      notify_pending = false;
+    }
+  }
+} /* AudioThreadFifo::notify */
+
+
+void AudioThreadFifo::notificationReceived(FdWatch *w)
+{
+  char buf[64];
+  while (read(w->fd(), buf, sizeof(buf)) > 0)
+  {
+  }
+  notify_pending = false;
+
+  if (AudioSource::isRegistered())
+  {
+    writeSamplesFromFifo();
+  }
+
+  if (input_stopped && !full())
+  {
+    input_stopped = false;
+    sourceResumeOutput();
+  }
+
+  if (reader_flushed.exchange(false))
+  {
+    sourceAllSamplesFlushed();
+  }
+} /* AudioThreadFifo::notificationReceived */
+
+
+void AudioThreadFifo::writeSamplesFromFifo(void)
+{
+  if (output_stopped)
+  {
+    return;
+  }
+
+  while (samplesInFifo() > 0)
+  {
+    prebuf.store(false, memory_order_relaxed);
+    is_flushing = false;
+
+      // Peek at the samples and only remove the ones that the sink accept
+    unsigned t = tail.load(memory_order_acquire);
+    unsigned h = head.load(memory_order_acquire);
+    unsigned n = min(static_cast<unsigned>(MAX_WRITE_SIZE), h - t);
+    unsigned pos = t & mask;
+    n = min(n, mask + 1 - pos);
+    int written = sinkWriteSamples(fifo + pos, n);
+    if (written > 0)
+    {
+      tail.compare_exchange_strong(t, t + written, memory_order_acq_rel);
+    }
+    if (written < static_cast<int>(n))
+    {
+      output_stopped = true;
+      break;
+    }
+  }
+
+  if (input_stopped && !full())
+  {
+    input_stopped = false;
+    sourceResumeOutput();
+  }
+
+  if (flush_pending && !is_flushing && empty())
+  {
+    is_flushing = true;
+    sinkFlushSamples();
+  }
+} /* AudioThreadFifo::writeSamplesFromFifo */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,337 @@
+/**
+@file   AsyncAudioThreadFifo.h
+@brief  A lock-free audio FIFO that can be shared between two threads
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a FIFO for audio samples that can be shared between two
+threads, one writing and one reading samples, without using any locks.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_THREAD_FIFO_INCLUDED
+#define ASYNC_AUDIO_THREAD_FIFO_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <pthread.h>
+
+#include <atomic>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSink.h>
+#include <AsyncAudioSource.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class FdWatch;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A lock-free audio FIFO that can be shared between two threads
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class implements a single producer, single consumer ring buffer for
+audio samples. It is used in the same way as an Async::AudioFifo but one of
+the ends may be used from another thread than the one running the main event
+loop, like a realtime audio device thread.
+
+Samples are put into the FIFO using the writeSamples function. That function
+may be called from the main thread, by a connected audio source, or from one
+other thread. The samples are read out of the FIFO either by the main thread,
+by registering an audio sink that the FIFO will write the samples to, or by
+calling readSamples from one other thread. Only one of the ends may be used
+from another thread than the main thread.
+
+The FIFO must be created in the main thread. All callbacks to connected
+audio sinks and sources are done from the main thread. When the other thread has changed the state of the FIFO, the main
+thread is notified through a pipe that is watched by the main event loop.
+
+Pre-buffering, overwrite mode and flushing work like for Async::AudioFifo.
+In overwrite mode the writer may drop the oldest samples while the reader is
+copying them out. The reader will then retry, so no inconsistent state can
+arise, but a sample block written to a registered sink at the same time may
+contain a mix of old and new samples.
+*/
+class AudioThreadFifo : public AudioSink, public AudioSource,
+                        public sigc::trackable
+{
+  public:
+    /**
+     * @brief 	Constuctor
+     * @param   fifo_size This is the size of the fifo expressed in number
+     *                    of samples.
+     */
+    explicit AudioThreadFifo(unsigned fifo_size);
+
+    /**
+     * @brief 	Destructor
+     *
+     * The other thread must not use the FIFO anymore when it is destroyed.
+     */
+    virtual ~AudioThreadFifo(void);
+
+    /**
+     * @brief   Check if the initialization was successful
+     * @return  Returns \em true if the notification pipe could be created
+     */
+    bool initOk(void) const { return notifier_watch != 0; }
+
+    /**
+     * @brief	Set the size of the FIFO
+     * @param	new_size  This is the size of the fifo expressed in number
+     *                    of samples.
+     *
+     * Use this function to set the size of the FIFO. In doing this, the
+     * FIFO will also be cleared. This function must not be called while
+     * the other thread is using the FIFO.
+     */
+    void setSize(unsigned new_size);
+
+    /**
+     * @brief 	Check if the FIFO is empty
+     * @return	Returns \em true if the FIFO is empty or else \em false
+     */
+    bool empty(void) const { return samplesInFifo(true) == 0; }
+
+    /**
+     * @brief 	Check if the FIFO is full
+     * @return	Returns \em true if the FIFO is full or else \em false
+     */
+    bool full(void) const { return samplesInFifo(true) >= fifo_size; }
+
+    /**
+     * @brief 	Find out how many samples there are in the FIFO
+     * @param	ignore_prebuf Set to \em true to not report pre-buffered
+     *                        samples.
+     * @return	Returns the number of samples in the FIFO
+     *
+     * This function may be called from either thread.
+     */
+    unsigned samplesInFifo(bool ignore_prebuf=false) const;
+
+    /**
+     * @brief 	Set the overwrite mode
+     * @param 	overwrite Set to \em true to overwrite or else \em false
+     *
+     * When overwrite is set, newly written samples will overwrite the oldest
+     * samples in the FIFO so that it never get full.
+     */
+    void setOverwrite(bool overwrite) { do_overwrite = overwrite; }
+
+    /**
+     * @brief 	Check the overwrite mode
+     * @return	Returns \em true if overwrite is enabled or else \em false
+     */
+    bool overwrite(void) const { return do_overwrite; }
+
+    /**
+     * @brief 	Clear all samples from the FIFO
+     *
+     * This will immediately discard all samples in the FIFO. It must be
+     * called from the main thread.
+     */
+    void clear(void);
+
+    /**
+     * @brief	Set the number of samples that must be in the fifo before
+     *		any samples are read out from it.
+     * @param	prebuf_samples The number of samples
+     */
+    void setPrebufSamples(unsigned prebuf_samples);
+
+    /**
+     * @brief   Get the number of samples that have been lost
+     * @return  Returns the number of samples lost due to a full FIFO
+     *
+     * Samples are lost when they are overwritten in overwrite mode.
+     */
+    unsigned long overrunCount(void) const { return overrun_cnt; }
+
+    /**
+     * @brief   Get the number of times the reader found the FIFO empty
+     * @return  Returns the number of readSamples calls that returned no
+     *          samples while not flushing
+     */
+    unsigned long underrunCount(void) const { return underrun_cnt; }
+
+    /**
+     * @brief 	Write samples into the FIFO
+     * @param 	samples The buffer containing the samples
+     * @param 	count The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     *
+     * This function is used to write audio into the FIFO. It may be called
+     * from the main thread or from one other thread. It never blocks. If it
+     * returns less than count, resumeOutput will be called on the connected
+     * source when there is room in the FIFO again.
+     */
+    virtual int writeSamples(const float *samples, int count);
+
+    /**
+     * @brief 	Tell the FIFO to flush the previously written samples
+     *
+     * This function must be called from the same thread that call
+     * writeSamples.
+     */
+    virtual void flushSamples(void);
+
+    /**
+     * @brief   Read samples from the FIFO
+     * @param   samples The buffer to put the samples in
+     * @param   count   The maximum number of samples to read
+     * @return  Returns the number of samples read
+     *
+     * Use this function to read samples when the reading end of the FIFO is
+     * used from another thread than the main thread. It never blocks. No
+     * sink should be registered when this function is used.
+     */
+    int readSamples(float *samples, int count);
+
+    /**
+     * @brief Resume audio output to the connected sink
+     *
+     * This function will be called when the registered audio sink is ready
+     * to accept more samples.
+     * This function is normally only called from a connected sink object.
+     */
+    virtual void resumeOutput(void);
+
+
+  protected:
+    /**
+     * @brief The registered sink has flushed all samples
+     *
+     * This function will be called when all samples have been flushed in the
+     * registered sink.
+     * This function is normally only called from a connected sink object.
+     */
+    virtual void allSamplesFlushed(void);
+
+
+  private:
+    float                   *fifo;
+    unsigned                fifo_size;
+    unsigned                mask;
+    std::atomic<unsigned>   head;
+    std::atomic<unsigned>   tail;
+    std::atomic<bool>       prebuf;
+    std::atomic<bool>       flush_pending;
+    std::atomic<bool>       reader_flushed;
+    std::atomic<bool>       input_stopped;
+    std::atomic<bool>       notify_pending;
+    std::atomic<unsigned long> overrun_cnt;
+    std::atomic<unsigned long> underrun_cnt;
+    bool                    do_overwrite;
+    unsigned                prebuf_samples;
+    bool                    output_stopped;
+    bool                    is_flushing;
+    pthread_t               main_thread;
+    int                     notifier_rd;
+    int                     notifier_wr;
+    FdWatch                 *notifier_watch;
+
+    AudioThreadFifo(const AudioThreadFifo&);
+    AudioThreadFifo& operator=(const AudioThreadFifo&);
+    void allocFifo(unsigned size);
+    unsigned copyOut(float *samples, unsigned count);
+    void notify(void);
+    void notificationReceived(FdWatch *w);
+    void writeSamplesFromFifo(void);
+
+};  /* class AudioThreadFifo */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_THREAD_FIFO_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,361 @@
+/**
+@file   AsyncAudioWorkerPool.cpp
+@brief  Run audio processors on a pool of worker threads
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncThreadScheduling.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncAudioProcessor.h"
+#include "AsyncAudioWorkerPool.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define BLOCK_SIZE 256
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+AudioWorkerPool *AudioWorkerPool::shared_pool = 0;
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+bool AudioWorkerPool::startShared(unsigned thread_cnt)
+{
+  if (shared_pool != 0)
+  {
+    return false;
+  }
+  AudioWorkerPool *pool = new AudioWorkerPool(thread_cnt);
+  if (!pool->initOk())
+  {
+    delete pool;
+    return false;
+  }
+  shared_pool = pool;
+  return true;
+} /* AudioWorkerPool::startShared */
+
+
+AudioWorkerPool::AudioWorkerPool(unsigned thread_cnt)
+  : m_stop(false)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_work_cond, NULL);
+  pthread_cond_init(&m_idle_cond, NULL);
+  for (unsigned i=0; i<thread_cnt; ++i)
+  {
+    pthread_t thread;
+    int ret = pthread_create(&thread, NULL, threadFunc, this);
+    if (ret != 0)
+    {
+      cerr << "*** ERROR: Could not start audio worker thread: "
+           << strerror(ret) << endl;
+      stopThreads();
+      break;
+    }
+    m_threads.push_back(thread);
+  }
+} /* AudioWorkerPool::AudioWorkerPool */
+
+
+AudioWorkerPool::~AudioWorkerPool(void)
+{
+  assert(m_queue.empty());
+  stopThreads();
+  pthread_cond_destroy(&m_idle_cond);
+  pthread_cond_destroy(&m_work_cond);
+  pthread_mutex_destroy(&m_mutex);
+} /* AudioWorkerPool::~AudioWorkerPool */
+
+
+AudioWorkerStage::AudioWorkerStage(AudioWorkerPool *pool, AudioProcessor *proc,
+                                   bool managed, unsigned fifo_size)
+  : m_pool(pool), m_in_fifo(fifo_size), m_out_fifo(fifo_size),
+    m_collector(m_out_fifo), m_flush_pending(false), m_flush_sent(false),
+    m_is_flushing(false), m_queued(false), m_running(false), m_rerun(false)
+{
+  assert(pool != 0);
+  assert(proc != 0);
+
+    // Both FIFOs drop the oldest samples instead of stopping the writer.
+    // Flow control would need calls in both directions between the threads.
+  m_in_fifo.setOverwrite(true);
+  m_out_fifo.setOverwrite(true);
+  m_feeder.registerSink(proc, managed);
+  proc->registerSink(&m_collector);
+  AudioSource::setHandler(&m_out_fifo);
+} /* AudioWorkerStage::AudioWorkerStage */
+
+
+AudioWorkerStage::~AudioWorkerStage(void)
+{
+  m_pool->detach(this);
+  AudioSource::clearHandler();
+} /* AudioWorkerStage::~AudioWorkerStage */
+
+
+int AudioWorkerStage::writeSamples(const float *samples, int count)
+{
+  m_is_flushing = false;
+  m_flush_pending = false;
+  m_flush_sent = false;
+  m_in_fifo.writeSamples(samples, count);
+  m_pool->schedule(this);
+  return count;
+} /* AudioWorkerStage::writeSamples */
+
+
+void AudioWorkerStage::flushSamples(void)
+{
+  m_is_flushing = true;
+  m_flush_pending = true;
+  m_pool->schedule(this);
+} /* AudioWorkerStage::flushSamples */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+void AudioWorkerStage::allSamplesFlushed(void)
+{
+  m_out_fifo.handleAllSamplesFlushed();
+  if (m_is_flushing && m_flush_sent && m_out_fifo.empty())
+  {
+    m_is_flushing = false;
+    m_flush_sent = false;
+    sourceAllSamplesFlushed();
+  }
+} /* AudioWorkerStage::allSamplesFlushed */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void *AudioWorkerPool::threadFunc(void *arg)
+{
+  ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_DSP);
+  reinterpret_cast<AudioWorkerPool*>(arg)->run();
+  return NULL;
+} /* AudioWorkerPool::threadFunc */
+
+
+void AudioWorkerPool::run(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  for (;;)
+  {
+    while (m_queue.empty() && !m_stop)
+    {
+      pthread_cond_wait(&m_work_cond, &m_mutex);
+    }
+    if (m_stop)
+    {
+      break;
+    }
+    AudioWorkerStage *stage = m_queue.front();
+    m_queue.pop_front();
+    stage->m_running = true;
+    pthread_mutex_unlock(&m_mutex);
+
+    stage->process();
+
+    pthread_mutex_lock(&m_mutex);
+    stage->m_running = false;
+    if (stage->m_rerun)
+    {
+        // More samples arrived while the stage was running
+      stage->m_rerun = false;
+      m_queue.push_back(stage);
+      pthread_cond_signal(&m_work_cond);
+    }
+    else
+    {
+      stage->m_queued = false;
+    }
+    pthread_cond_broadcast(&m_idle_cond);
+  }
+  pthread_mutex_unlock(&m_mutex);
+} /* AudioWorkerPool::run */
+
+
+void AudioWorkerPool::stopThreads(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  m_stop = true;
+  pthread_cond_broadcast(&m_work_cond);
+  pthread_mutex_unlock(&m_mutex);
+  for (vector<pthread_t>::iterator it=m_threads.begin();
+       it!=m_threads.end(); ++it)
+  {
+    pthread_join(*it, NULL);
+  }
+  m_threads.clear();
+} /* AudioWorkerPool::stopThreads */
+
+
+void AudioWorkerPool::schedule(AudioWorkerStage *stage)
+{
+  pthread_mutex_lock(&m_mutex);
+  if (!stage->m_queued)
+  {
+    stage->m_queued = true;
+    m_queue.push_back(stage);
+    pthread_cond_signal(&m_work_cond);
+  }
+  else if (stage->m_running)
+  {
+    stage->m_rerun = true;
+  }
+  pthread_mutex_unlock(&m_mutex);
+} /* AudioWorkerPool::schedule */
+
+
+void AudioWorkerPool::detach(AudioWorkerStage *stage)
+{
+  pthread_mutex_lock(&m_mutex);
+  while (stage->m_running)
+  {
+    pthread_cond_wait(&m_idle_cond, &m_mutex);
+  }
+  m_queue.erase(remove(m_queue.begin(), m_queue.end(), stage), m_queue.end());
+  stage->m_queued = false;
+  stage->m_rerun = false;
+  pthread_mutex_unlock(&m_mutex);
+} /* AudioWorkerPool::detach */
+
+
+void AudioWorkerStage::process(void)
+{
+  float buf[BLOCK_SIZE];
+  while (!m_in_fifo.empty())
+  {
+    int cnt = m_in_fifo.readSamples(buf, BLOCK_SIZE);
+    if (cnt > 0)
+    {
+      m_feeder.write(buf, cnt);
+    }
+  }
+
+    // The processor itself is not flushed since AudioProcessor use the
+    // main loop to finish a flush. The output FIFO is flushed directly.
+  if (m_flush_pending.exchange(false))
+  {
+    m_flush_sent = true;
+    m_out_fifo.flushSamples();
+  }
+} /* AudioWorkerStage::process */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,344 @@
+/**
+@file   AsyncAudioWorkerPool.h
+@brief  Run audio processors on a pool of worker threads
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_AUDIO_WORKER_POOL_INCLUDED
+#define ASYNC_AUDIO_WORKER_POOL_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+#include <atomic>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSink.h>
+#include <AsyncAudioSource.h>
+#include <AsyncAudioThreadFifo.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class AudioProcessor;
+class AudioWorkerStage;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  A pool of threads running audio processing stages
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class manage a fixed number of worker threads that run the audio
+processors of AudioWorkerStage objects. When a stage has received samples it
+is put in the run queue of the pool. The first idle worker thread will then
+feed all pending samples of that stage through its processor. A stage is only
+run by one thread at a time so the samples of a stream are always processed
+in order, but different stages may run on different CPU cores at the same
+time.
+
+The worker threads use the DSP role of Async::ThreadScheduling so their
+scheduling policy and CPU affinity may be configured.
+
+Most applications use the process wide pool that is created using
+startShared.
+*/
+class AudioWorkerPool
+{
+  public:
+    /**
+     * @brief   Start the process wide pool
+     * @param   thread_cnt The number of worker threads to start
+     * @return  Returns \em true on success or \em false on failure
+     *
+     * This function must be called from the main thread. The pool is
+     * never destroyed. Calling it again when the pool is already started
+     * will fail.
+     */
+    static bool startShared(unsigned thread_cnt);
+
+    /**
+     * @brief   Get the process wide pool
+     * @return  Returns the pool or 0 if startShared has not been called
+     */
+    static AudioWorkerPool *shared(void) { return shared_pool; }
+
+    /**
+     * @brief 	Constructor
+     * @param   thread_cnt The number of worker threads to start
+     */
+    explicit AudioWorkerPool(unsigned thread_cnt);
+
+    /**
+     * @brief 	Destructor
+     *
+     * All stages using the pool must have been destroyed before the pool is
+     * destroyed.
+     */
+    ~AudioWorkerPool(void);
+
+    /**
+     * @brief   Check if the initialization was successful
+     * @return  Returns \em true if all worker threads were started
+     */
+    bool initOk(void) const { return !m_threads.empty(); }
+
+    /**
+     * @brief   Get the number of worker threads
+     * @return  Returns the number of running worker threads
+     */
+    unsigned threadCount(void) const { return m_threads.size(); }
+
+  private:
+    static AudioWorkerPool *shared_pool;
+
+    std::vector<pthread_t>          m_threads;
+    std::deque<AudioWorkerStage*>   m_queue;
+    pthread_mutex_t                 m_mutex;
+    pthread_cond_t                  m_work_cond;
+    pthread_cond_t                  m_idle_cond;
+    bool                            m_stop;
+
+    AudioWorkerPool(const AudioWorkerPool&);
+    AudioWorkerPool& operator=(const AudioWorkerPool&);
+    static void *threadFunc(void *arg);
+    void run(void);
+    void stopThreads(void);
+    void schedule(AudioWorkerStage *stage);
+    void detach(AudioWorkerStage *stage);
+
+    friend class AudioWorkerStage;
+
+};  /* class AudioWorkerPool */
+
+
+/**
+@brief  An audio pipe component that runs a processor on a worker thread
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class wrap an audio processor, or an AudioProcessorChain, so that the
+processing is done on a thread in an AudioWorkerPool. Samples written to the
+stage are put in a lock-free input FIFO and the stage is queued in the pool.
+The processed samples are put in an AudioThreadFifo that write them to the
+connected sink from the main thread.
+
+The processor must only do pure sample processing. It must not use timers,
+emit signals or in any other way touch the main event loop since it is run
+from another thread. Parameters of the processor, like the gain of an
+AudioAmp, may be changed from the main thread if they are updated atomically.
+
+The stage does not use flow control since it is meant for live audio. If the
+worker threads cannot keep up, the oldest samples are dropped and counted in
+overrunCount. A flush is passed on when all samples written before it have
+been processed. Samples that a decimating processor buffer internally at that
+point, which is always less than the decimation factor, are discarded.
+*/
+class AudioWorkerStage : public AudioSink, public AudioSource
+{
+  public:
+    /**
+     * @brief   The default size of the input and output FIFOs in samples
+     */
+    static const unsigned DEFAULT_FIFO_SIZE = 4096;
+
+    /**
+     * @brief 	Constructor
+     * @param   pool      The pool to run the processor in
+     * @param   proc      The processor to run
+     * @param   managed   Set to \em true to delete the processor with the
+     *                    stage
+     * @param   fifo_size The size in samples of the input and output FIFOs
+     */
+    AudioWorkerStage(AudioWorkerPool *pool, AudioProcessor *proc,
+                     bool managed=false,
+                     unsigned fifo_size=DEFAULT_FIFO_SIZE);
+
+    /**
+     * @brief 	Destructor
+     *
+     * Waits for a worker thread that is currently running the stage.
+     */
+    virtual ~AudioWorkerStage(void);
+
+    /**
+     * @brief   Check if the initialization was successful
+     * @return  Returns \em true if the FIFOs could be set up
+     */
+    bool initOk(void) const { return m_in_fifo.initOk() && m_out_fifo.initOk(); }
+
+    /**
+     * @brief   Get the number of samples that have been dropped
+     * @return  Returns the number of samples lost in the input and output
+     *          FIFOs since the worker threads could not keep up
+     */
+    unsigned long overrunCount(void) const
+    {
+      return m_in_fifo.overrunCount() + m_out_fifo.overrunCount();
+    }
+
+    /**
+     * @brief 	Write samples into the stage
+     * @param 	samples The buffer containing the samples
+     * @param 	count The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *samples, int count);
+
+    /**
+     * @brief 	Tell the stage to flush the previously written samples
+     */
+    virtual void flushSamples(void);
+
+  protected:
+    /**
+     * @brief The registered sink has flushed all samples
+     *
+     * This function will be called when all samples have been flushed in the
+     * registered sink.
+     */
+    virtual void allSamplesFlushed(void);
+
+  private:
+    class Feeder : public AudioSource
+    {
+      public:
+        int write(const float *samples, int count)
+        {
+          return sinkWriteSamples(samples, count);
+        }
+        virtual void resumeOutput(void) {}
+        virtual void allSamplesFlushed(void) {}
+    };
+
+    class Collector : public AudioSink
+    {
+      public:
+        explicit Collector(AudioThreadFifo& fifo) : m_fifo(fifo) {}
+        virtual int writeSamples(const float *samples, int count)
+        {
+          return m_fifo.writeSamples(samples, count);
+        }
+        virtual void flushSamples(void) {}
+      private:
+        AudioThreadFifo& m_fifo;
+    };
+
+    AudioWorkerPool*  m_pool;
+    AudioThreadFifo   m_in_fifo;
+    AudioThreadFifo   m_out_fifo;
+    Collector         m_collector;
+    Feeder            m_feeder;
+    std::atomic<bool> m_flush_pending;
+    std::atomic<bool> m_flush_sent;
+    bool              m_is_flushing;
+
+      // Protected by the pool mutex
+    bool              m_queued;
+    bool              m_running;
+    bool              m_rerun;
+
+    AudioWorkerStage(const AudioWorkerStage&);
+    AudioWorkerStage& operator=(const AudioWorkerStage&);
+    void process(void);
+
+    friend class AudioWorkerPool;
+
+};  /* class AudioWorkerStage */
+
+
+} /* namespace */
+
+#endif /* ASYNC_AUDIO_WORKER_POOL_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,327 @@
+/**
+@file   AsyncOggPageWriter.cpp
+@brief  Assemble Ogg pages from a stream of packets
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that pack packets, e.g. Opus frames, into Ogg pages
+that are ready to be written to a file or sent over a network connection.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstring>
+#include <cassert>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncOggPageWriter.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+namespace {
+  /**
+   * @brief Lookup tables for a slicing-by-8 Ogg CRC32
+   *
+   * Table zero is the usual bytewise table. Table k give the CRC
+   * contribution of a byte followed by k zero bytes so that eight bytes can
+   * be processed in each iteration.
+   */
+  struct CrcTables
+  {
+    uint32_t t[8][256];
+
+    CrcTables(void)
+    {
+      for (uint32_t i=0; i<256; ++i)
+      {
+        uint32_t r = i << 24;
+        for (int j=0; j<8; ++j)
+        {
+          r = (r & 0x80000000) ? ((r << 1) ^ 0x04c11db7) : (r << 1);
+        }
+        t[0][i] = r;
+      }
+      for (uint32_t i=0; i<256; ++i)
+      {
+        for (int k=1; k<8; ++k)
+        {
+          t[k][i] = (t[k-1][i] << 8) ^ t[0][t[k-1][i] >> 24];
+        }
+      }
+    }
+  };
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void putLe32(uint8_t* p, uint32_t val);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+uint32_t OggPageWriter::crc32(const void* buf, size_t len, uint32_t crc)
+{
+  static const CrcTables tables;
+  const uint32_t (&t)[8][256] = tables.t;
+  const uint8_t* p = static_cast<const uint8_t*>(buf);
+  while (len >= 8)
+  {
+    crc ^= (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) |
+           (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    crc = t[7][crc >> 24] ^ t[6][(crc >> 16) & 0xff] ^
+          t[5][(crc >> 8) & 0xff] ^ t[4][crc & 0xff] ^
+          t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    p += 8;
+    len -= 8;
+  }
+  while (len-- > 0)
+  {
+    crc = (crc << 8) ^ t[0][(crc >> 24) ^ *p++];
+  }
+  return crc;
+} /* OggPageWriter::crc32 */
+
+
+OggPageWriter::OggPageWriter(uint32_t serialno, unsigned max_packets)
+  : m_serialno(serialno), m_max_packets(max_packets > 0 ? max_packets : 1)
+{
+  m_lacing.reserve(MAX_SEGMENTS);
+} /* OggPageWriter::OggPageWriter */
+
+
+OggPageWriter::~OggPageWriter(void)
+{
+  releasePages();
+  delete m_page;
+  for (std::vector<Page*>::iterator it = m_free.begin();
+       it != m_free.end(); ++it)
+  {
+    delete *it;
+  }
+} /* OggPageWriter::~OggPageWriter */
+
+
+bool OggPageWriter::addPacket(const void* data, size_t len,
+                              int64_t granulepos)
+{
+  const size_t segments = len / 255 + 1;
+  if (segments > MAX_SEGMENTS)
+  {
+    return false;
+  }
+  if (m_lacing.size() + segments > MAX_SEGMENTS)
+  {
+    finishPage(false);
+  }
+  if (m_page == nullptr)
+  {
+    newPage();
+  }
+
+  m_page->insert(m_page->end(), static_cast<const uint8_t*>(data),
+                 static_cast<const uint8_t*>(data) + len);
+  m_lacing.insert(m_lacing.end(), segments - 1, 255);
+  m_lacing.push_back(len % 255);
+  m_granulepos = granulepos;
+  if (++m_packets >= m_max_packets)
+  {
+    finishPage(false);
+  }
+  return true;
+} /* OggPageWriter::addPacket */
+
+
+bool OggPageWriter::flush(bool eos)
+{
+  if ((m_packets == 0) && !eos)
+  {
+    return false;
+  }
+  if (m_page == nullptr)
+  {
+    newPage();
+  }
+  finishPage(eos);
+  return true;
+} /* OggPageWriter::flush */
+
+
+void OggPageWriter::releasePages(void)
+{
+  m_free.insert(m_free.end(), m_done.begin(), m_done.end());
+  m_done.clear();
+  m_iov.clear();
+} /* OggPageWriter::releasePages */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void OggPageWriter::newPage(void)
+{
+  assert(m_page == nullptr);
+  if (!m_free.empty())
+  {
+    m_page = m_free.back();
+    m_free.pop_back();
+  }
+  else
+  {
+    m_page = new Page;
+    m_page->reserve(HEADER_SPACE + 4096);
+  }
+  m_page->resize(HEADER_SPACE);
+  m_lacing.clear();
+  m_packets = 0;
+  m_granulepos = -1;
+} /* OggPageWriter::newPage */
+
+
+void OggPageWriter::finishPage(bool eos)
+{
+  if (m_page == nullptr)
+  {
+    return;
+  }
+
+    // The header is written right in front of the body so that the page
+    // end up in one contiguous buffer
+  const size_t nsegs = m_lacing.size();
+  const size_t head = HEADER_SPACE - HEADER_SIZE - nsegs;
+  uint8_t* hdr = m_page->data() + head;
+  std::memcpy(hdr, "OggS", 4);
+  hdr[4] = 0;                                   // Stream structure version
+  hdr[5] = (m_bos ? 0x02 : 0x00) | (eos ? 0x04 : 0x00);
+  putLe32(hdr + 6, uint32_t(uint64_t(m_granulepos)));
+  putLe32(hdr + 10, uint32_t(uint64_t(m_granulepos) >> 32));
+  putLe32(hdr + 14, m_serialno);
+  putLe32(hdr + 18, m_pageno++);
+  putLe32(hdr + 22, 0);                         // Checksum placeholder
+  hdr[26] = nsegs;
+  if (nsegs > 0)
+  {
+    std::memcpy(hdr + HEADER_SIZE, m_lacing.data(), nsegs);
+  }
+  const size_t page_len = m_page->size() - head;
+  putLe32(hdr + 22, crc32(hdr, page_len));
+
+  struct iovec iov;
+  iov.iov_base = hdr;
+  iov.iov_len = page_len;
+  m_iov.push_back(iov);
+  m_done.push_back(m_page);
+  m_page = nullptr;
+  m_lacing.clear();
+  m_packets = 0;
+  m_bos = false;
+} /* OggPageWriter::finishPage */
+
+
+static void putLe32(uint8_t* p, uint32_t val)
+{
+  p[0] = val & 0xff;
+  p[1] = (val >> 8) & 0xff;
+  p[2] = (val >> 16) & 0xff;
+  p[3] = (val >> 24) & 0xff;
+} /* putLe32 */
+
+
+/*
+ * This file has not been truncated
+ */
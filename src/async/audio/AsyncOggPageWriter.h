@@ -0,0 +1,263 @@
+/**
+@file   AsyncOggPageWriter.h
+@brief  Assemble Ogg pages from a stream of packets
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that pack packets, e.g. Opus frames, into Ogg pages
+that are ready to be written to a file or sent over a network connection.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_OGG_PAGE_WRITER_INCLUDED
+#define ASYNC_OGG_PAGE_WRITER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/uio.h>
+#include <stdint.h>
+
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Assemble Ogg pages from a stream of packets
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class pack packets into Ogg pages. Packet data is copied directly into a
+page buffer which has space reserved in front of it for the page header so a
+finished page is always stored in one contiguous buffer. The page header is
+filled in, including the CRC, when the page is finished. The CRC is calculated
+using a table driven slicing-by-8 algorithm.
+
+Finished pages are kept by the writer until releasePages is called. The pages
+are available as a vector of iovec structures, one per page, which can be
+given directly to for example TcpConnection::write or writev(2) so that a
+stream can be sent without copying the data. Page buffers are reused so there
+are no memory allocations in steady state.
+
+A page is finished when the configured number of packets have been added to
+it, when the next packet will not fit in the segment table or when the flush
+function is called. Packets larger than what fit in one page are not
+supported. The first page produced by the writer is marked as the beginning of
+the stream.
+
+  OggPageWriter ogg(serialno);
+  ogg.addPacket(opus_frame, len, granulepos);
+  if (ogg.pageCount() > 0)
+  {
+    con->write(ogg.pages().data(), ogg.pageCount());
+    ogg.releasePages();
+  }
+*/
+class OggPageWriter
+{
+  public:
+    /**
+     * @brief   Calculate the Ogg CRC32 for a block of data
+     * @param   buf Pointer to the data
+     * @param   len The length of the data
+     * @param   crc The CRC to continue from
+     * @return  Returns the updated CRC
+     *
+     * This is the CRC32 used by Ogg, with polynom 0x04c11db7, no reflection,
+     * a zero initial value and no final XOR.
+     */
+    static uint32_t crc32(const void* buf, size_t len, uint32_t crc=0);
+
+    /**
+     * @brief   Constructor
+     * @param   serialno    The serial number of the logical Ogg stream
+     * @param   max_packets The maximum number of packets to put in a page
+     */
+    explicit OggPageWriter(uint32_t serialno, unsigned max_packets=5);
+
+    /**
+     * @brief   Destructor
+     */
+    ~OggPageWriter(void);
+
+    /**
+     * @brief   Get the serial number of the logical stream
+     * @return  Returns the serial number
+     */
+    uint32_t serialNo(void) const { return m_serialno; }
+
+    /**
+     * @brief   Get the sequence number to use for the next page
+     * @return  Returns the page sequence number
+     */
+    uint32_t pageNo(void) const { return m_pageno; }
+
+    /**
+     * @brief   Add a packet to the stream
+     * @param   data        Pointer to the packet data
+     * @param   len         The size of the packet
+     * @param   granulepos  The granule position at the end of this packet
+     * @return  Returns \em true on success or \em false if the packet is too
+     *          large to fit in one page
+     *
+     * The packet data is copied into the current page. If the page is full
+     * after adding this packet it is finished and made available through the
+     * pages function.
+     */
+    bool addPacket(const void* data, size_t len, int64_t granulepos);
+
+    /**
+     * @brief   Finish the current page
+     * @param   eos Set to \em true to mark the end of the stream
+     * @return  Returns \em true if a page was finished
+     *
+     * Finish the current page even if it is not full. If eos is \em true,
+     * the page is marked as the last in the stream. If there are no packets
+     * in the current page and eos is \em true, an empty page is produced.
+     */
+    bool flush(bool eos=false);
+
+    /**
+     * @brief   Get the finished pages
+     * @return  Returns a vector with one iovec for each finished page
+     *
+     * The buffers pointed to by the returned iovecs stay valid until
+     * releasePages is called.
+     */
+    const std::vector<struct iovec>& pages(void) const { return m_iov; }
+
+    /**
+     * @brief   Get the number of finished pages
+     * @return  Returns the number of finished pages
+     */
+    size_t pageCount(void) const { return m_iov.size(); }
+
+    /**
+     * @brief   Release all finished pages
+     *
+     * Call this function when the finished pages have been written. The page
+     * buffers will then be reused for new pages.
+     */
+    void releasePages(void);
+
+  private:
+    static const size_t HEADER_SIZE   = 27;
+    static const size_t MAX_SEGMENTS  = 255;
+    static const size_t HEADER_SPACE  = HEADER_SIZE + MAX_SEGMENTS;
+
+    typedef std::vector<uint8_t> Page;
+
+    const uint32_t        m_serialno;
+    const unsigned        m_max_packets;
+    uint32_t              m_pageno        = 0;
+    bool                  m_bos           = true;
+    Page*                 m_page          = nullptr;
+    std::vector<uint8_t>  m_lacing;
+    unsigned              m_packets       = 0;
+    int64_t               m_granulepos    = -1;
+    std::vector<Page*>    m_done;
+    std::vector<Page*>    m_free;
+    std::vector<struct iovec> m_iov;
+
+    OggPageWriter(const OggPageWriter&);
+    OggPageWriter& operator=(const OggPageWriter&);
+    void newPage(void);
+    void finishPage(bool eos);
+
+};  /* class OggPageWriter */
+
+
+} /* namespace */
+
+#endif /* ASYNC_OGG_PAGE_WRITER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
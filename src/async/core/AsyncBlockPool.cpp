@@ -0,0 +1,333 @@
+/**
+@file   AsyncBlockPool.cpp
+@brief  A process wide pool of memory blocks in power of two size classes
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <sigc++/sigc++.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncMetrics.h"
+#include "AsyncBlockPool.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void writeMetrics(MetricsWriter& w);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+BlockPool::Header* BlockPool::m_free_list[OVERSIZE_CLASS] = {0};
+size_t BlockPool::m_free_cnt[OVERSIZE_CLASS] = {0};
+BlockPool::Stats BlockPool::m_stats = {0, 0, 0, 0, 0, 0, 0, 0};
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+void *BlockPool::allocate(size_t size)
+{
+  static bool initialized = false;
+  if (!initialized)
+  {
+    initialized = true;
+    startMetrics();
+  }
+
+  unsigned size_class = MIN_SIZE_CLASS;
+  while ((size_class <= MAX_SIZE_CLASS) && ((size_t(1) << size_class) < size))
+  {
+    ++size_class;
+  }
+
+  m_stats.alloc_cnt += 1;
+  Header *hdr = 0;
+  if ((size_class <= MAX_SIZE_CLASS) && (m_free_list[size_class] != 0))
+  {
+    hdr = m_free_list[size_class];
+    m_free_list[size_class] = hdr->next_free;
+    m_free_cnt[size_class] -= 1;
+    m_stats.free_blocks -= 1;
+    m_stats.free_bytes -= hdr->capacity;
+    m_stats.hit_cnt += 1;
+  }
+  else
+  {
+    checkSteadyState(size);
+    size_t cap = size;
+    if (size_class <= MAX_SIZE_CLASS)
+    {
+      cap = size_t(1) << size_class;
+    }
+    else
+    {
+      size_class = OVERSIZE_CLASS;
+      m_stats.oversize_cnt += 1;
+    }
+    hdr = static_cast<Header*>(malloc(HEADER_SIZE + cap));
+    if (hdr == 0)
+    {
+      throw std::bad_alloc();
+    }
+    hdr->size_class = size_class;
+    hdr->capacity = static_cast<uint32_t>(cap);
+    m_stats.miss_cnt += 1;
+  }
+  hdr->next_free = 0;
+  m_stats.used_blocks += 1;
+  m_stats.used_bytes += hdr->capacity;
+
+  return reinterpret_cast<char*>(hdr) + HEADER_SIZE;
+} /* BlockPool::allocate */
+
+
+void BlockPool::release(void *ptr)
+{
+  if (ptr == 0)
+  {
+    return;
+  }
+
+  Header *hdr = header(ptr);
+  assert(hdr->size_class <= OVERSIZE_CLASS);
+  assert(m_stats.used_blocks > 0);
+  m_stats.used_blocks -= 1;
+  m_stats.used_bytes -= hdr->capacity;
+
+  unsigned size_class = hdr->size_class;
+  if ((size_class <= MAX_SIZE_CLASS) &&
+      (m_free_cnt[size_class] < maxPooled(size_class)))
+  {
+    hdr->next_free = m_free_list[size_class];
+    m_free_list[size_class] = hdr;
+    m_free_cnt[size_class] += 1;
+    m_stats.free_blocks += 1;
+    m_stats.free_bytes += hdr->capacity;
+  }
+  else
+  {
+    free(hdr);
+  }
+} /* BlockPool::release */
+
+
+size_t BlockPool::capacity(const void *ptr)
+{
+  assert(ptr != 0);
+  return header(ptr)->capacity;
+} /* BlockPool::capacity */
+
+
+void BlockPool::clear(void)
+{
+  for (unsigned i=0; i<=MAX_SIZE_CLASS; ++i)
+  {
+    while (m_free_list[i] != 0)
+    {
+      Header *hdr = m_free_list[i];
+      m_free_list[i] = hdr->next_free;
+      free(hdr);
+    }
+    m_free_cnt[i] = 0;
+  }
+  m_stats.free_blocks = 0;
+  m_stats.free_bytes = 0;
+} /* BlockPool::clear */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+size_t BlockPool::maxPooled(unsigned size_class)
+{
+    // Keep at most about MAX_POOLED_CLASS_SIZE bytes in each size class but
+    // never so few blocks that a couple of queued blocks would miss
+  size_t cnt = MAX_POOLED_CLASS_SIZE >> size_class;
+  if (cnt < MIN_POOLED)
+  {
+    return MIN_POOLED;
+  }
+  if (cnt > MAX_POOLED)
+  {
+    return MAX_POOLED;
+  }
+  return cnt;
+} /* BlockPool::maxPooled */
+
+
+void BlockPool::checkSteadyState(size_t size)
+{
+  static bool debug = false;
+  static bool initialized = false;
+  static int warmup_time = 0;
+  static struct timespec start;
+  if (!initialized)
+  {
+    initialized = true;
+    const char *debug_str = getenv("ASYNC_BLOCK_POOL_DEBUG");
+    if (debug_str != 0)
+    {
+      debug = true;
+      istringstream(debug_str) >> warmup_time;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+  }
+  if (!debug)
+  {
+    return;
+  }
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (now.tv_sec - start.tv_sec < warmup_time)
+  {
+    return;
+  }
+
+  cerr << "*** ERROR: Heap allocation of " << size << " bytes in the "
+       << "Async::BlockPool after the warm-up time of " << warmup_time
+       << " seconds (ASYNC_BLOCK_POOL_DEBUG). Aborting.\n";
+  abort();
+} /* BlockPool::checkSteadyState */
+
+
+void BlockPool::startMetrics(void)
+{
+  Metrics::instance().collect.connect(sigc::ptr_fun(&writeMetrics));
+} /* BlockPool::startMetrics */
+
+
+static void writeMetrics(MetricsWriter& w)
+{
+  const BlockPool::Stats& s = BlockPool::stats();
+  MetricsWriter::Labels labels;
+  labels["result"] = "hit";
+  w.counter("async_block_pool_allocations",
+            "Number of block pool allocations", labels, s.hit_cnt);
+  labels["result"] = "miss";
+  w.counter("async_block_pool_allocations",
+            "Number of block pool allocations", labels, s.miss_cnt);
+  labels.clear();
+  w.counter("async_block_pool_oversize_allocations",
+            "Number of allocations larger than the largest size class",
+            labels, s.oversize_cnt);
+  labels["state"] = "used";
+  w.gauge("async_block_pool_bytes", "Capacity of block pool blocks",
+          labels, s.used_bytes);
+  w.gauge("async_block_pool_blocks", "Number of block pool blocks",
+          labels, s.used_blocks);
+  labels["state"] = "free";
+  w.gauge("async_block_pool_bytes", "Capacity of block pool blocks",
+          labels, s.free_bytes);
+  w.gauge("async_block_pool_blocks", "Number of block pool blocks",
+          labels, s.free_blocks);
+} /* writeMetrics */
+
+
+/*
+ * This file has not been truncated
+ */
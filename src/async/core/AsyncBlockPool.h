@@ -0,0 +1,262 @@
+/**
+@file   AsyncBlockPool.h
+@brief  A process wide pool of memory blocks in power of two size classes
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that hand out memory blocks from free lists, one
+per size class, so that buffers that are allocated and released over and over
+again, like audio blocks and network frames, do not hit the heap in the
+steady state.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_BLOCK_POOL_INCLUDED
+#define ASYNC_BLOCK_POOL_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <cstddef>
+#include <new>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A process wide pool of memory blocks
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class keep one free list for each power of two size class, from 64 bytes
+to 1MB. A released block is put on the free list for its size class and is
+handed out again on the next allocation in the same class, so code that
+allocate and release buffers of about the same size over and over again will
+not touch the heap once the pool has warmed up. Blocks larger than the largest
+size class are allocated directly from the heap and are never pooled.
+
+All blocks share the same pool, whatever they are used for. Audio sample
+blocks (Async::AudioSampleBlock), frames queued on a
+Async::FramedTcpConnection and other short lived buffers in the audio path
+use the pool.
+
+Statistics are available through the stats function and are also published
+as metrics through Async::Metrics. If the environment variable
+ASYNC_BLOCK_POOL_DEBUG is set to a number of seconds, the pool will consider
+itself warmed up when that time has passed since the first allocation. After
+that, any allocation that would have to go to the heap is treated as a bug.
+An error is printed and the application is aborted so that the offending
+allocation can be found in a core dump or in a debugger.
+
+The pool is not thread safe so it should only be used from the thread running
+the main event loop.
+*/
+class BlockPool
+{
+  public:
+    /**
+     * @brief Block pool statistics
+     */
+    struct Stats
+    {
+      uint64_t  alloc_cnt;      ///< Total number of allocations
+      uint64_t  hit_cnt;        ///< Allocations served from a free list
+      uint64_t  miss_cnt;       ///< Allocations that had to use the heap
+      uint64_t  oversize_cnt;   ///< Allocations larger than the largest class
+      size_t    used_blocks;    ///< Number of blocks currently handed out
+      size_t    used_bytes;     ///< Capacity of the blocks handed out
+      size_t    free_blocks;    ///< Number of blocks on the free lists
+      size_t    free_bytes;     ///< Capacity of the blocks on the free lists
+    };
+
+    /**
+     * @brief   Allocate a block
+     * @param   size The minimum number of bytes that the block should hold
+     * @return  Returns a pointer to the new block
+     *
+     * The returned block is aligned at least as well as a block returned by
+     * malloc. A std::bad_alloc exception is thrown if the heap is exhausted,
+     * just like for operator new.
+     */
+    static void *allocate(size_t size);
+
+    /**
+     * @brief   Release a block
+     * @param   ptr A pointer previously returned by allocate or 0
+     *
+     * The block is returned to the free list for its size class or, if the
+     * free list is full, to the heap.
+     */
+    static void release(void *ptr);
+
+    /**
+     * @brief   Get the capacity of a block
+     * @param   ptr A pointer previously returned by allocate
+     * @return  Returns the number of bytes that the block can hold
+     *
+     * The capacity is the requested size rounded up to the size class of the
+     * block. All of it may be used by the caller.
+     */
+    static size_t capacity(const void *ptr);
+
+    /**
+     * @brief   Return all blocks on the free lists to the heap
+     */
+    static void clear(void);
+
+    /**
+     * @brief   Get the pool statistics
+     * @return  Returns a reference to the statistics
+     */
+    static const Stats& stats(void) { return m_stats; }
+
+  private:
+    static const unsigned MIN_SIZE_CLASS        = 6;
+    static const unsigned MAX_SIZE_CLASS        = 20;
+    static const unsigned OVERSIZE_CLASS        = MAX_SIZE_CLASS + 1;
+    static const size_t   MAX_POOLED_CLASS_SIZE = 1024 * 1024;
+    static const size_t   MIN_POOLED            = 4;
+    static const size_t   MAX_POOLED            = 64;
+    static const size_t   HEADER_SIZE           = 16;
+
+    struct Header
+    {
+      Header*   next_free;
+      uint32_t  size_class;
+      uint32_t  capacity;
+    };
+
+    static Header*  m_free_list[OVERSIZE_CLASS];
+    static size_t   m_free_cnt[OVERSIZE_CLASS];
+    static Stats    m_stats;
+
+    static Header *header(const void *ptr)
+    {
+      return reinterpret_cast<Header*>(
+          const_cast<char*>(static_cast<const char*>(ptr)) - HEADER_SIZE);
+    }
+    static size_t maxPooled(unsigned size_class);
+    static void checkSteadyState(size_t size);
+    static void startMetrics(void);
+
+    BlockPool(void);
+
+};  /* class BlockPool */
+
+
+/**
+@brief	A base class that make objects of derived classes use the block pool
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+Inherit from this class to make new and delete of objects of the class, and
+of all classes derived from it, use the Async::BlockPool. It is useful for
+small objects that are created and deleted in the steady state, like queue
+items.
+*/
+class BlockPoolAllocated
+{
+  public:
+    static void *operator new(size_t size)
+    {
+      return BlockPool::allocate(size);
+    }
+    static void operator delete(void *ptr) { BlockPool::release(ptr); }
+
+};  /* class BlockPoolAllocated */
+
+
+} /* namespace */
+
+#endif /* ASYNC_BLOCK_POOL_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -143,27 +143,70 @@ bool Config::open(const string& name)
   fclose(file);
   file = NULL;
 
+  if (success)
+  {
+    files.push_back(name);
+  }
+
   return success;
 
 } /* Config::open */
 
 
-bool Config::getValue(const string& section, const string& tag,
-		      string& value) const
+bool Config::reload(void)
 {
-  Sections::const_iterator sec_it = sections.find(section);
-  if (sec_it == sections.end())
+  Config new_cfg;
+  for (std::vector<string>::const_iterator it = files.begin();
+       it != files.end(); ++it)
   {
-    return false;
+    if (!new_cfg.open(*it))
+    {
+      return false;
+    }
   }
 
-  Values::const_iterator val_it = sec_it->second.find(tag);
-  if (val_it == sec_it->second.end())
+    // Update all values first and then notify subscribers
+  typedef std::vector<std::pair<string, string> > Changes;
+  Changes changes;
+  for (Sections::const_iterator sec_it = new_cfg.sections.begin();
+       sec_it != new_cfg.sections.end(); ++sec_it)
+  {
+    const string& section = sec_it->first;
+    sections[section].is_set = true;
+    const Values& values = sec_it->second.values;
+    for (Values::const_iterator val_it = values.begin();
+         val_it != values.end(); ++val_it)
+    {
+      const string& tag = val_it->first;
+      const Value* val = findValue(section, tag);
+      if ((val == 0) || (val->str != val_it->second.str))
+      {
+        setValueP(section, tag).str = val_it->second.str;
+        changes.push_back(make_pair(section, tag));
+      }
+    }
+  }
+
+  for (Changes::const_iterator it = changes.begin(); it != changes.end(); ++it)
+  {
+    notifyValueUpdated(it->first, it->second,
+                       sections[it->first].values[it->second]);
+  }
+
+  return true;
+} /* Config::reload */
+
+
+bool Config::getValue(const string& section, const string& tag,
+		      string& value) const
+{
+  const Value* val = findValue(section, tag);
+  if (val == 0)
   {
     return false;
   }
 
-  value = val_it->second;
+  value = val->str;
   return true;
 } /* Config::getValue */
 
@@ -172,19 +215,13 @@ const string &Config::getValue(const string& section, const string& tag) const
 {
   static const string empty_strng;
   
-  Sections::const_iterator sec_it = sections.find(section);
-  if (sec_it == sections.end())
-  {
-    return empty_strng;
-  }
-
-  Values::const_iterator val_it = sec_it->second.find(tag);
-  if (val_it == sec_it->second.end())
+  const Value* val = findValue(section, tag);
+  if (val == 0)
   {
     return empty_strng;
   }
 
-  return val_it->second;
+  return val->str;
 } /* Config::getValue */
 
 
@@ -193,8 +230,13 @@ list<string> Config::listSections(void)
   list<string> section_list;
   for (Sections::const_iterator it=sections.begin(); it!=sections.end(); ++it)
   {
-    section_list.push_back((*it).first);
+    if ((*it).second.is_set)
+    {
+      section_list.push_back((*it).first);
+    }
   }
+    // The hash table is unordered so sort to keep the old behaviour
+  section_list.sort();
   return section_list;
 } /* Config::listSections */
 
@@ -203,17 +245,22 @@ list<string> Config::listSection(const string& section)
 {
   list<string> tags;
   
-  if (sections.count(section) == 0)
+  Sections::const_iterator sec_it = sections.find(section);
+  if (sec_it == sections.end())
   {
     return tags;
   }
   
-  Values& values = sections[section];  
-  Values::iterator it = values.begin();
+  const Values& values = sec_it->second.values;
+  Values::const_iterator it = values.begin();
   for (it=values.begin(); it!=values.end(); ++it)
   {
-    tags.push_back(it->first);
+    if (it->second.is_set)
+    {
+      tags.push_back(it->first);
+    }
   }
+  tags.sort();
   
   return tags;
   
@@ -223,12 +270,24 @@ list<string> Config::listSection(const string& section)
 void Config::setValue(const std::string& section, const std::string& tag,
       	      	      const std::string& value)
 {
-  Values &values = sections[section];
-  values[tag] = value;
-  valueUpdated(section, tag);
+  Value& val = setValueP(section, tag);
+  val.str = value;
+  notifyValueUpdated(section, tag, val);
 } /* Config::setValue */
 
 
+sigc::connection Config::subscribeValue(const std::string& section,
+    const std::string& tag, const sigc::slot<void, const std::string&>& slot)
+{
+  Value& val = sections[section].values[tag];
+  if (val.subscribers == 0)
+  {
+    val.subscribers.reset(new Subscribers);
+  }
+  return val.subscribers->connect(slot);
+} /* Config::subscribeValue */
+
+
 /****************************************************************************
  *
  * Protected member functions
@@ -261,6 +320,59 @@ void Config::setValue(const std::string& section, const std::string& tag,
  ****************************************************************************/
 
 
+const Config::Value* Config::findValue(const string& section,
+                                       const string& tag) const
+{
+  Sections::const_iterator sec_it = sections.find(section);
+  if (sec_it == sections.end())
+  {
+    return 0;
+  }
+
+  Values::const_iterator val_it = sec_it->second.values.find(tag);
+  if ((val_it == sec_it->second.values.end()) || !val_it->second.is_set)
+  {
+    return 0;
+  }
+
+  return &val_it->second;
+} /* Config::findValue */
+
+
+Config::Value& Config::setValueP(const string& section, const string& tag)
+{
+  Section& sec = sections[section];
+  sec.is_set = true;
+  Value& val = sec.values[tag];
+  val.is_set = true;
+  val.version += 1;
+  val.cache.reset();
+  return val;
+} /* Config::setValueP */
+
+
+void Config::notifyValueUpdated(const string& section, const string& tag,
+                                const Value& val)
+{
+    // Hold a reference since a subscriber may modify the configuration
+  std::shared_ptr<Subscribers> subscribers(val.subscribers);
+  string value(val.str);
+  valueUpdated(section, tag);
+  if (subscribers != 0)
+  {
+    (*subscribers)(value);
+  }
+} /* Config::notifyValueUpdated */
+
+
+void Config::printIllegalValue(const string& section, const string& tag,
+                               const string& value)
+{
+  cerr << "*** ERROR: Illegal value for configuration variable "
+       << section << "/" << tag << ": \"" << value << "\"" << endl;
+} /* Config::printIllegalValue */
+
+
 /*
  *----------------------------------------------------------------------------
  * Method:    
@@ -303,13 +415,7 @@ bool Config::parseCfgFile(FILE *file)
 	//printf("New section=%s\n", sec);
 	current_sec = sec;
 	current_tag = "";
-	if (sections.count(current_sec) == 0)
-	{
-	  sections[current_sec];	// Create a new empty section
-	  //cerr << "*** ERROR: Configuration file parse error: Section "
-	  //    	  "previously defined on line " << line_no << endl;
-	  //return false;
-	}
+	sections[current_sec].is_set = true;	// Create a new empty section
       	break;
       }
       
@@ -333,9 +439,8 @@ bool Config::parseCfgFile(FILE *file)
 	}
 	assert(!current_sec.empty());
 	
-	Values &values = sections[current_sec];
-	string& value = values[current_tag];
-	value += val;
+	Value& value = setValueP(current_sec, current_tag);
+	value.str += val;
 	break;
       }
       
@@ -356,9 +461,8 @@ bool Config::parseCfgFile(FILE *file)
 	      	  "section on line " << line_no << endl;
 	  return false;
 	}
-	Values &values = sections[current_sec];
 	current_tag = tag;
-	values[current_tag] = value;
+	setValueP(current_sec, current_tag).str = value;
       	break;
       }
     }
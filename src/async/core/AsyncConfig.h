@@ -55,6 +55,8 @@ An example of how to use the Config class
 #include <sstream>
 #include <locale>
 #include <vector>
+#include <unordered_map>
+#include <memory>
 
 
 /****************************************************************************
@@ -133,10 +135,105 @@ is shown below.
 \include test.cfg
 
 \include AsyncConfig_demo.cpp
+
+The configuration variables are stored in hash tables and the typed value of
+a variable is cached after the first successful conversion so repeated calls
+to getValue for the same variable only cost two hash lookups. The cache is
+invalidated when the variable is changed using setValue. Code that read a
+configuration variable often, e.g. for each received audio block, should
+use a value handle instead. A handle resolve the variable once and then
+read the cached value directly.
+
+A component that is able to apply a changed configuration variable without
+being restarted can subscribe to changes of that variable using the
+subscribeValue function. The reload function read the configuration files
+again and notify subscribers for all variables that have changed. The
+Async::ConfigWatch class can be used to call reload automatically when a
+configuration file is written.
 */
 class Config
 {
+  private:
+    class Value;
+    template <typename T> struct Identity { typedef T Type; };
+
   public:
+    /**
+     * @brief   A handle to a typed configuration variable
+     *
+     * A handle is created using the Config::valueHandle function. It point
+     * directly to the storage of the configuration variable so reading the
+     * value is very cheap. The value is converted again only if it has been
+     * changed using setValue. A handle must not be used after the Config
+     * object that created it has been destroyed.
+     */
+    template <typename T>
+    class ValueHandle
+    {
+      public:
+        /**
+         * @brief   Default constructor, creating a handle to nothing
+         */
+        ValueHandle(void) : m_val(0), m_version(0), m_valid(false) {}
+
+        /**
+         * @brief   Get the value of the configuration variable
+         * @param   rsp The value is returned in this argument
+         * @return  Returns \em true if the variable is set and could be
+         *          converted to the type of the handle
+         */
+        bool get(T& rsp) const
+        {
+          if (!refresh())
+          {
+            return false;
+          }
+          rsp = m_cached;
+          return true;
+        }
+
+        /**
+         * @brief   Get the value of the configuration variable
+         * @param   def The value to return if the variable is not valid
+         * @return  Returns the value or the given default value
+         */
+        T value(const T& def=T()) const
+        {
+          return refresh() ? m_cached : def;
+        }
+
+        /**
+         * @brief   Check if the variable is set and have a valid value
+         * @return  Returns \em true if the variable have a valid value
+         */
+        bool isValid(void) const { return refresh(); }
+
+      private:
+        const Value*      m_val;
+        mutable unsigned  m_version;
+        mutable bool      m_valid;
+        mutable T         m_cached;
+
+        explicit ValueHandle(const Value* val)
+          : m_val(val), m_version(0), m_valid(false) {}
+
+        bool refresh(void) const
+        {
+          if (m_val == 0)
+          {
+            return false;
+          }
+          if (m_version != m_val->version)
+          {
+            m_version = m_val->version;
+            m_valid = m_val->is_set && convertValue(m_val->str, m_cached);
+          }
+          return m_valid;
+        }
+
+        friend class Config;
+    };
+
     /**
      * @brief 	Default constuctor
      */
@@ -157,6 +254,27 @@ class Config
      * give a hint what the problem was.
      */
     bool open(const std::string& name);
+
+    /**
+     * @brief   Read all configuration files again
+     * @return  Returns \em true on success or \em false on failure
+     *
+     * This function will read all configuration files that have been
+     * successfully opened again, in the same order. All variables that have
+     * been changed or added are updated as if setValue had been called so
+     * that subscribers are notified. Variables that have been removed from
+     * the files are left untouched. If any of the files cannot be read or
+     * parsed, nothing is changed.
+     * All values are updated before any subscriber is notified so a
+     * subscriber always see the complete new configuration.
+     */
+    bool reload(void);
+
+    /**
+     * @brief   Get the names of the configuration files that have been read
+     * @return  Returns the file names in the order they were opened
+     */
+    const std::vector<std::string>& fileNames(void) const { return files; }
     
     /**
      * @brief 	Return the string value of the given configuration variable
@@ -212,23 +330,17 @@ class Config
     bool getValue(const std::string& section, const std::string& tag,
 		  Rsp &rsp, bool missing_ok = false) const
     {
-      std::string str_val;
-      if (!getValue(section, tag, str_val))
+      const Value* val = findValue(section, tag);
+      if (val == 0)
       {
 	return missing_ok;
       }
-      std::stringstream ssval(str_val);
-      Rsp tmp;
-      ssval >> tmp;
-      if(!ssval.eof())
-      {
-        ssval >> std::ws;
-      }
-      if (ssval.fail() || !ssval.eof())
+      const Rsp* tmp = cachedValue<Rsp>(*val);
+      if (tmp == 0)
       {
 	return false;
       }
-      rsp = tmp;
+      rsp = *tmp;
       return true;
     } /* Config::getValue */
 
@@ -253,9 +365,9 @@ class Config
      * still returns \em false if an illegal value is specified.
      */
     template <template <typename, typename> class Container,
-              typename Value>
+              typename Elem>
     bool getValue(const std::string& section, const std::string& tag,
-		  Container<Value, std::allocator<Value> > &c,
+		  Container<Elem, std::allocator<Elem> > &c,
                   bool missing_ok = false) const
     {
       std::string str_val;
@@ -272,7 +384,7 @@ class Config
       ssval.imbue(std::locale(ssval.getloc(), new csv_whitespace));
       while (!ssval.eof())
       {
-        Value tmp;
+        Elem tmp;
         ssval >> tmp;
         if(!ssval.eof())
         {
@@ -368,26 +480,41 @@ class Config
 		  const Rsp& min, const Rsp& max, Rsp &rsp,
 		  bool missing_ok = false) const
     {
-      std::string str_val;
-      if (!getValue(section, tag, str_val))
+      const Value* val = findValue(section, tag);
+      if (val == 0)
       {
 	return missing_ok;
       }
-      std::stringstream ssval(str_val);
-      Rsp tmp;
-      ssval >> tmp;
-      if(!ssval.eof())
-      {
-        ssval >> std::ws;
-      }
-      if (ssval.fail() || !ssval.eof() || (tmp < min) || (tmp > max))
+      const Rsp* tmp = cachedValue<Rsp>(*val);
+      if ((tmp == 0) || (*tmp < min) || (*tmp > max))
       {
 	return false;
       }
-      rsp = tmp;
+      rsp = *tmp;
       return true;
     } /* Config::getValue */
 
+    /**
+     * @brief   Get a handle to a typed configuration variable
+     * @param   section The name of the section where the configuration
+     *                  variable is located
+     * @param   tag     The name of the configuration variable
+     * @return  Returns a handle to the configuration variable
+     *
+     * This function is used to get a handle that can be used to read the
+     * value of a configuration variable cheaply, e.g. in code that is run
+     * very often. The variable is looked up once when the handle is created.
+     * The handle will follow changes made using setValue. It is ok to get a
+     * handle to a variable that is not set. The handle will then return the
+     * value when the variable is set.
+     */
+    template <typename T>
+    ValueHandle<T> valueHandle(const std::string& section,
+                               const std::string& tag)
+    {
+      return ValueHandle<T>(&sections[section].values[tag]);
+    } /* Config::valueHandle */
+
     /**
      * @brief   Return the name of all configuration sections
      * @return  Returns a list of all existing section names
@@ -421,6 +548,46 @@ class Config
     void setValue(const std::string& section, const std::string& tag,
       	      	  const std::string& value);
 
+    /**
+     * @brief   Subscribe to changes of a configuration variable
+     * @param   section The name of the section where the configuration
+     *                  variable is located
+     * @param   tag     The name of the configuration variable
+     * @param   slot    The function to call with the new value
+     * @return  Returns the connection, which can be used to unsubscribe
+     *
+     * The given slot will be called with the new string value each time the
+     * configuration variable is changed by setValue or reload. It is ok to
+     * subscribe to a variable that is not set.
+     */
+    sigc::connection subscribeValue(const std::string& section,
+        const std::string& tag,
+        const sigc::slot<void, const std::string&>& slot);
+
+    /**
+     * @brief   Subscribe to changes of a typed configuration variable
+     * @param   section The name of the section where the configuration
+     *                  variable is located
+     * @param   tag     The name of the configuration variable
+     * @param   slot    The function to call with the new value
+     * @return  Returns the connection, which can be used to unsubscribe
+     *
+     * This is a variant of the subscribeValue function above that convert
+     * the new value to the given type before calling the slot. The type must
+     * be given explicitly, e.g. cfg.subscribeValue<float>(...). If the new
+     * value cannot be converted, an error is printed and the slot is not
+     * called.
+     */
+    template <typename Rsp>
+    sigc::connection subscribeValue(const std::string& section,
+        const std::string& tag,
+        const typename Identity<sigc::slot<void, const Rsp&> >::Type& slot)
+    {
+      return subscribeValue(section, tag,
+          sigc::slot<void, const std::string&>(
+            TypedSubscriber<Rsp>(section, tag, slot)));
+    } /* Config::subscribeValue */
+
     /**
      * @brief   A signal that is emitted when a config value is updated
      * @param   section The config section of the update
@@ -432,8 +599,60 @@ class Config
     sigc::signal<void, const std::string&, const std::string&> valueUpdated;
 
   private:
-    typedef std::map<std::string, std::string>  Values;
-    typedef std::map<std::string, Values>       Sections;
+    class CachedValueBase
+    {
+      public:
+        virtual ~CachedValueBase(void) {}
+    };
+    template <typename T>
+    class CachedValue : public CachedValueBase
+    {
+      public:
+        explicit CachedValue(const T& v) : value(v) {}
+        T value;
+    };
+    typedef sigc::signal<void, const std::string&> Subscribers;
+    class Value
+    {
+      public:
+        Value(void) : is_set(false), version(1) {}
+        std::string                               str;
+        bool                                      is_set;
+        unsigned                                  version;
+        mutable std::shared_ptr<CachedValueBase>  cache;
+        std::shared_ptr<Subscribers>              subscribers;
+    };
+    template <typename Rsp>
+    class TypedSubscriber
+    {
+      public:
+        typedef void result_type;
+        TypedSubscriber(const std::string& section, const std::string& tag,
+                        const sigc::slot<void, const Rsp&>& slot)
+          : m_section(section), m_tag(tag), m_slot(slot) {}
+        void operator()(const std::string& str_val) const
+        {
+          Rsp val;
+          if (!convertValue(str_val, val))
+          {
+            printIllegalValue(m_section, m_tag, str_val);
+            return;
+          }
+          m_slot(val);
+        }
+      private:
+        std::string                   m_section;
+        std::string                   m_tag;
+        sigc::slot<void, const Rsp&>  m_slot;
+    };
+    typedef std::unordered_map<std::string, Value>    Values;
+    struct Section
+    {
+      Section(void) : is_set(false) {}
+      bool    is_set;
+      Values  values;
+    };
+    typedef std::unordered_map<std::string, Section>  Sections;
     struct csv_whitespace : std::ctype<char>
     {
       static const mask* make_table(void)
@@ -448,7 +667,60 @@ class Config
         : std::ctype<char>(make_table(), false, refs) {}
     };
 
-    Sections  sections;
+    Sections                  sections;
+    std::vector<std::string>  files;
+
+    const Value* findValue(const std::string& section,
+                           const std::string& tag) const;
+    Value& setValueP(const std::string& section, const std::string& tag);
+    void notifyValueUpdated(const std::string& section,
+                            const std::string& tag, const Value& val);
+    static void printIllegalValue(const std::string& section,
+                                  const std::string& tag,
+                                  const std::string& value);
+
+    static bool convertValue(const std::string& str_val, std::string& rsp)
+    {
+      rsp = str_val;
+      return true;
+    } /* Config::convertValue */
+
+    template <typename Rsp>
+    static bool convertValue(const std::string& str_val, Rsp& rsp)
+    {
+      std::stringstream ssval(str_val);
+      Rsp tmp;
+      ssval >> tmp;
+      if(!ssval.eof())
+      {
+        ssval >> std::ws;
+      }
+      if (ssval.fail() || !ssval.eof())
+      {
+	return false;
+      }
+      rsp = tmp;
+      return true;
+    } /* Config::convertValue */
+
+    template <typename Rsp>
+    static const Rsp* cachedValue(const Value& val)
+    {
+      const CachedValue<Rsp>* cached =
+        dynamic_cast<const CachedValue<Rsp>*>(val.cache.get());
+      if (cached == 0)
+      {
+        Rsp tmp;
+        if (!convertValue(val.str, tmp))
+        {
+          return 0;
+        }
+        CachedValue<Rsp>* new_cached = new CachedValue<Rsp>(tmp);
+        val.cache.reset(new_cached);
+        cached = new_cached;
+      }
+      return &cached->value;
+    } /* Config::cachedValue */
 
     //Config(const Config&);
     //Config& operator=(const Config&);
@@ -0,0 +1,311 @@
+/**
+@file   AsyncConfigWatch.cpp
+@brief  Reload the configuration when a configuration file change
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that watch the configuration files for changes and
+reload the configuration when a file has been written.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#ifdef HAS_INOTIFY
+#include <sys/inotify.h>
+#endif
+
+#include <cstring>
+#include <sstream>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncConfig.h>
+#include <AsyncFdWatch.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncConfigWatch.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void splitPath(const string& path, string& dir, string& base);
+static string fileState(const string& path);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+ConfigWatch::ConfigWatch(Config& cfg, unsigned delay_ms)
+  : m_cfg(cfg), m_delay_timer(delay_ms, Timer::TYPE_ONESHOT, false),
+    m_poll_timer(POLL_INTERVAL_MS, Timer::TYPE_PERIODIC, false), m_fd(-1),
+    m_fd_watch(0)
+{
+  m_delay_timer.expired.connect(
+      sigc::mem_fun(*this, &ConfigWatch::onDelayTimeout));
+  m_poll_timer.expired.connect(
+      sigc::mem_fun(*this, &ConfigWatch::onPollTimeout));
+} /* ConfigWatch::ConfigWatch */
+
+
+ConfigWatch::~ConfigWatch(void)
+{
+  delete m_fd_watch;
+  m_fd_watch = 0;
+  if (m_fd >= 0)
+  {
+    close(m_fd);
+  }
+} /* ConfigWatch::~ConfigWatch */
+
+
+bool ConfigWatch::start(void)
+{
+  const vector<string>& file_names = m_cfg.fileNames();
+  for (vector<string>::const_iterator it = file_names.begin();
+       it != file_names.end(); ++it)
+  {
+    string dir, base;
+    splitPath(*it, dir, base);
+    m_files[dir + "/" + base] = fileState(*it);
+  }
+
+#ifdef HAS_INOTIFY
+  m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (m_fd < 0)
+  {
+    cerr << "*** ERROR: Could not initialize inotify: "
+         << strerror(errno) << endl;
+    return false;
+  }
+  for (FileStates::const_iterator it = m_files.begin(); it != m_files.end();
+       ++it)
+  {
+    string dir, base;
+    splitPath(it->first, dir, base);
+    int wd = inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0)
+    {
+      cerr << "*** ERROR: Could not watch directory \"" << dir << "\": "
+           << strerror(errno) << endl;
+      return false;
+    }
+    m_dirs[wd] = dir;
+  }
+  m_fd_watch = new FdWatch(m_fd, FdWatch::FD_WATCH_RD);
+  m_fd_watch->activity.connect(
+      sigc::mem_fun(*this, &ConfigWatch::onInotifyActivity));
+#else
+  m_poll_timer.setEnable(true);
+#endif
+
+  return true;
+} /* ConfigWatch::start */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void ConfigWatch::onInotifyActivity(FdWatch *w)
+{
+#ifdef HAS_INOTIFY
+  char buf[4096]
+    __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  for (;;)
+  {
+    ssize_t len = read(m_fd, buf, sizeof(buf));
+    if (len <= 0)
+    {
+      if ((len < 0) && (errno != EAGAIN) && (errno != EINTR))
+      {
+        cerr << "*** ERROR: Failed to read inotify events: "
+             << strerror(errno) << endl;
+        m_fd_watch->setEnabled(false);
+      }
+      return;
+    }
+
+    const struct inotify_event *ev = 0;
+    for (char *ptr = buf; ptr < buf + len;
+         ptr += sizeof(struct inotify_event) + ev->len)
+    {
+      ev = reinterpret_cast<const struct inotify_event*>(ptr);
+      WatchDirs::const_iterator dir_it = m_dirs.find(ev->wd);
+      if ((ev->len > 0) && (dir_it != m_dirs.end()) &&
+          (m_files.count(dir_it->second + "/" + ev->name) > 0))
+      {
+        fileChanged();
+      }
+    }
+  }
+#endif
+} /* ConfigWatch::onInotifyActivity */
+
+
+void ConfigWatch::onPollTimeout(Timer *t)
+{
+  for (FileStates::iterator it = m_files.begin(); it != m_files.end(); ++it)
+  {
+    string state = fileState(it->first);
+    if (state != it->second)
+    {
+      it->second = state;
+      fileChanged();
+    }
+  }
+} /* ConfigWatch::onPollTimeout */
+
+
+void ConfigWatch::onDelayTimeout(Timer *t)
+{
+  bool success = m_cfg.reload();
+  reloaded(success);
+} /* ConfigWatch::onDelayTimeout */
+
+
+void ConfigWatch::fileChanged(void)
+{
+    // Restart the delay so that a burst of writes only cause one reload
+  m_delay_timer.setEnable(false);
+  m_delay_timer.setEnable(true);
+} /* ConfigWatch::fileChanged */
+
+
+
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+static void splitPath(const string& path, string& dir, string& base)
+{
+  string::size_type slash_pos = path.rfind('/');
+  if (slash_pos == string::npos)
+  {
+    dir = ".";
+    base = path;
+  }
+  else
+  {
+    dir = (slash_pos == 0) ? "/" : path.substr(0, slash_pos);
+    base = path.substr(slash_pos + 1);
+  }
+} /* splitPath */
+
+
+static string fileState(const string& path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+  {
+    return "";
+  }
+  ostringstream os;
+  os << st.st_mtime << ":" << st.st_size << ":" << st.st_ino;
+  return os.str();
+} /* fileState */
+
+
+/*
+ * This file has not been truncated
+ */
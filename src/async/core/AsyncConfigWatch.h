@@ -0,0 +1,199 @@
+/**
+@file   AsyncConfigWatch.h
+@brief  Reload the configuration when a configuration file change
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that watch the configuration files for changes and
+reload the configuration when a file has been written.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_CONFIG_WATCH_INCLUDED
+#define ASYNC_CONFIG_WATCH_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+#include <string>
+#include <map>
+#include <set>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncTimer.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class Config;
+class FdWatch;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Reload the configuration when a configuration file change
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class watch all files that have been read by a Config object. When one
+of the files is written, Config::reload is called after a short delay so that
+an editor have time to finish writing. The delay is restarted on each write
+so a burst of writes only cause one reload.
+
+On Linux inotify is used to watch the directories of the files, which means
+that it does not matter if the file is written in place or if a new file is
+renamed into place. On other systems the modification time of the files is
+polled every few seconds.
+
+Only the files that have been opened in the Config object are watched. A new
+file added to a configuration directory is not picked up until restart.
+*/
+class ConfigWatch : public sigc::trackable
+{
+  public:
+    /**
+     * @brief   The default delay from a file change to the reload
+     */
+    static const unsigned DEFAULT_DELAY_MS = 1000;
+
+    /**
+     * @brief   Constructor
+     * @param   cfg       The configuration object to watch and reload
+     * @param   delay_ms  The delay from a file change to the reload
+     */
+    explicit ConfigWatch(Config& cfg, unsigned delay_ms=DEFAULT_DELAY_MS);
+
+    /**
+     * @brief   Destructor
+     */
+    ~ConfigWatch(void);
+
+    /**
+     * @brief   Start watching the configuration files
+     * @return  Returns \em true on success or \em false on failure
+     *
+     * The files that have been read by the Config object when this function
+     * is called are watched.
+     */
+    bool start(void);
+
+    /**
+     * @brief   A signal that is emitted after the configuration is reloaded
+     * @param   success \em true if the reload was successful
+     */
+    sigc::signal<void, bool> reloaded;
+
+  private:
+    static const unsigned POLL_INTERVAL_MS = 2000;
+
+    typedef std::map<int, std::string>          WatchDirs;
+    typedef std::map<std::string, std::string>  FileStates;
+
+    Config&     m_cfg;
+    Timer       m_delay_timer;
+    Timer       m_poll_timer;
+    int         m_fd;
+    FdWatch*    m_fd_watch;
+    WatchDirs   m_dirs;
+    FileStates  m_files;
+
+    ConfigWatch(const ConfigWatch&);
+    ConfigWatch& operator=(const ConfigWatch&);
+    void onInotifyActivity(FdWatch *w);
+    void onPollTimeout(Timer *t);
+    void onDelayTimeout(Timer *t);
+    void fileChanged(void);
+
+};  /* class ConfigWatch */
+
+
+} /* namespace */
+
+#endif /* ASYNC_CONFIG_WATCH_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -115,6 +115,10 @@ Use this class to make DNS lookups. Right now it only supports looking up
 hostnames to find out what IP-addresses it maps to. An example usage can be seen
 below.
 
+In the Cpp variant of the async environment, the answers are cached for as
+long as the DNS allow, bounded to an hour. Lookups of the same name that are
+made at the same time are coalesced into one query.
+
 \include AsyncDnsLookup_demo.cpp
 */
 class DnsLookup : public sigc::trackable
@@ -38,6 +38,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/resource.h>
+#include <spawn.h>
 #include <sys/types.h>
 
 #include <cstring>
@@ -54,6 +55,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncTimer.h>
+#include <AsyncApplication.h>
 
 
 /****************************************************************************
@@ -99,6 +101,10 @@ using namespace Async;
  *
  ****************************************************************************/
 
+extern char **environ;
+
+static bool createPipe(int fds[2]);
+static void closePipe(int fds[2]);
 
 
 /****************************************************************************
@@ -136,8 +142,10 @@ Exec::Exec(const std::string &cmd)
     // Set up SIGCHLD signal handling on first usage of the class
   if (sigchld_watch == 0)
   {
-    int ret = pipe(sigchld_pipe);
-    if (ret == -1)
+      // The write end must not block since it is written from the signal
+      // handler
+    if (!createPipe(sigchld_pipe) ||
+        (fcntl(sigchld_pipe[1], F_SETFL, O_NONBLOCK) == -1))
     {
       cerr << "*** ERROR: Could not set up SIGCHLD pipe for Async::Exec: "
         << strerror(errno) << endl;
@@ -243,8 +251,7 @@ bool Exec::run(void)
 {
     // Create pipe file descriptor pair for handling stdin to subprocess
   int in_filedes[2];
-  int ret = pipe(in_filedes);
-  if (ret == -1)
+  if (!createPipe(in_filedes))
   {
     cerr << "*** ERROR: Could not set up stdin pipe for subprocess "
          << args[0] << ": " << strerror(errno) << endl;
@@ -253,96 +260,108 @@ bool Exec::run(void)
 
     // Create pipe file descriptor pair for handling stdout from subprocess
   int out_filedes[2];
-  ret = pipe(out_filedes);
-  if (ret == -1)
+  if (!createPipe(out_filedes))
   {
     cerr << "*** ERROR: Could not set up stdout pipe for subprocess "
          << args[0] << ": " << strerror(errno) << endl;
+    closePipe(in_filedes);
     return false;
   }
 
     // Create pipe file descriptor pair for handling stderr from subprocess
   int err_filedes[2];
-  ret = pipe(err_filedes);
-  if (ret == -1)
+  if (!createPipe(err_filedes))
   {
     cerr << "*** ERROR: Could not set up stderr pipe for subprocess "
          << args[0] << ": " << strerror(errno) << endl;
+    closePipe(in_filedes);
+    closePipe(out_filedes);
     return false;
   }
 
-  pid = fork();
-  if (pid == -1)
+    // Connect the child end of the pipes to stdin, stdout and stderr in the
+    // subprocess. All pipe file descriptors are closed on exec.
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, in_filedes[0], STDIN_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, out_filedes[1], STDOUT_FILENO);
+  posix_spawn_file_actions_adddup2(&actions, err_filedes[1], STDERR_FILENO);
+
+    // The subprocess should not inherit signals blocked by the application
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  sigset_t sigmask;
+  sigemptyset(&sigmask);
+  posix_spawnattr_setsigmask(&attr, &sigmask);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+
+  std::vector<char*> argv;
+  argv.reserve(args.size()+1);
+  for (size_t i=0; i<args.size(); ++i)
   {
-    cerr << "*** ERROR: The fork system call failed for subprocess "
-         << args[0] << ": " << strerror(errno) << endl;
-    return false;
+    argv.push_back(const_cast<char*>(args[i].c_str()));
   }
+  argv.push_back(0);
 
-    // If pid is non-zero we're in the parent process
-  if (pid != 0)
-  {
-      // Set up priority for child if specified
-    if (nice_value != 0)
-    {
-      nice(0);
-    }
-
-      // Add the new child to the global map
-    execs[pid] = this;
+    // Unlike fork, posix_spawn does not copy the page tables of the
+    // application so the time it takes does not grow with the size of
+    // the process
+  int err = posix_spawn(&pid, argv[0], &actions, &attr, &argv[0], environ);
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
 
-      // Set up handling for subprocess stdin
-    close(in_filedes[0]);
-    stdin_fd = in_filedes[1];
-
-      // Set up handling for subprocess stdout
-    close(out_filedes[1]);
-    stdout_watch = new FdWatch(out_filedes[0], FdWatch::FD_WATCH_RD);
-    stdout_watch->activity.connect(mem_fun(*this, &Exec::stdoutActivity));
-
-      // Set up handling for subprocess stderr
-    close(err_filedes[1]);
-    stderr_watch = new FdWatch(err_filedes[0], FdWatch::FD_WATCH_RD);
-    stderr_watch->activity.connect(mem_fun(*this, &Exec::stderrActivity));
+  close(in_filedes[0]);
+  close(out_filedes[1]);
+  close(err_filedes[1]);
 
-    if (timeout_timer != 0)
+  if (err != 0)
+  {
+    pid = -1;
+    close(in_filedes[1]);
+    close(out_filedes[0]);
+    close(err_filedes[0]);
+    if (err == EAGAIN)
     {
-      timeout_timer->setEnable(true);
+      cerr << "*** ERROR: Could not create subprocess " << args[0] << ": "
+           << strerror(err) << endl;
+      return false;
     }
 
+      // Report a failing exec through the exited signal, just like when
+      // the exec call failed in a forked child
+    cerr << "*** ERROR: Failed to exec " << args[0]
+         << ": " << strerror(err) << endl;
+    status = W_EXITCODE(255, 0);
+    Application::app().runTask(mem_fun(*this, &Exec::execFailed));
     return true;
   }
 
-  /* From this point we are in the child process */
+    // Set up priority for child if specified
+  if (nice_value != 0)
+  {
+    nice(0);
+  }
+
+    // Add the new child to the global map
+  execs[pid] = this;
 
-    // Set up stdin pipe
-  close(in_filedes[1]);
-  dup2(in_filedes[0], STDIN_FILENO);
-  close(in_filedes[0]);
+    // Set up handling for subprocess stdin
+  stdin_fd = in_filedes[1];
 
-    // Set up stdout pipe
-  close(out_filedes[0]);
-  dup2(out_filedes[1], STDOUT_FILENO);
-  close(out_filedes[1]);
+    // Set up handling for subprocess stdout
+  stdout_watch = new FdWatch(out_filedes[0], FdWatch::FD_WATCH_RD);
+  stdout_watch->activity.connect(mem_fun(*this, &Exec::stdoutActivity));
 
-    // Set up stderr pipe
-  close(err_filedes[0]);
-  dup2(err_filedes[1], STDERR_FILENO);
-  close(err_filedes[1]);
+    // Set up handling for subprocess stderr
+  stderr_watch = new FdWatch(err_filedes[0], FdWatch::FD_WATCH_RD);
+  stderr_watch->activity.connect(mem_fun(*this, &Exec::stderrActivity));
 
-  char *cmd[args.size()+1];
-  for (size_t i=0; i<args.size(); ++i)
+  if (timeout_timer != 0)
   {
-    cmd[i] = strdup(args[i].c_str());
+    timeout_timer->setEnable(true);
   }
-  cmd[args.size()] = 0;
-  ret = execv(cmd[0], cmd);
-  assert (ret == -1);
-
-  cerr << "*** ERROR: Failed to exec " << args[0]
-       << ": " << strerror(errno) << endl;
 
-  exit(255);
+  return true;
 } /* Exec::run */
 
 
@@ -493,6 +512,14 @@ void Exec::handleSigChld(int signal_number, siginfo_t *info, void *context)
 } /* Exec::handleSigChld */
 
 
+void Exec::execFailed(void)
+{
+  stdoutClosed();
+  stderrClosed();
+  exited();
+} /* Exec::execFailed */
+
+
 void Exec::subprocessExited(void)
 {
   execs.erase(pid);
@@ -565,6 +592,44 @@ void Exec::sigchldReceived(void)
 
 
 
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+static bool createPipe(int fds[2])
+{
+    // Create the pipe with close on exec set so that the file descriptors
+    // do not leak into other subprocesses
+#if defined(O_CLOEXEC) && defined(__linux__)
+  return pipe2(fds, O_CLOEXEC) == 0;
+#else
+  if (pipe(fds) == -1)
+  {
+    return false;
+  }
+  if ((fcntl(fds[0], F_SETFD, FD_CLOEXEC) == -1) ||
+      (fcntl(fds[1], F_SETFD, FD_CLOEXEC) == -1))
+  {
+    int errno_tmp = errno;
+    closePipe(fds);
+    errno = errno_tmp;
+    return false;
+  }
+  return true;
+#endif
+} /* createPipe */
+
+
+static void closePipe(int fds[2])
+{
+  close(fds[0]);
+  close(fds[1]);
+} /* closePipe */
+
+
+
 /*
  * This file has not been truncated
  */
@@ -192,11 +192,13 @@ class Exec : public sigc::trackable
      * @returns Returns \em true on success or \em false otherwise
      *
      * This method is used to run the command specified using the constructor,
-     * setCommandLine and appendArgument. This function will return success as
-     * long as the fork call succeeds. If the command cannot be run for some
-     * reason, this function will still return success. Errors that occurr
-     * after the fork call will be handled through the "exited" signal. If the
-     * command cannot run for some reason, the exit code will be 255.
+     * setCommandLine and appendArgument. The subprocess is started using
+     * posix_spawn, which does not copy the address space of the application
+     * like fork does, so starting a command does not stall the application
+     * even when it is large. This function will return success as long as
+     * the subprocess could be created. If the command cannot be run for some
+     * reason, this function will still return success. Such errors will be
+     * handled through the "exited" signal and the exit code will be 255.
      */
     bool run(void);
 
@@ -339,6 +341,7 @@ class Exec : public sigc::trackable
     Exec& operator=(const Exec&);
     void stdoutActivity(Async::FdWatch *w);
     void stderrActivity(Async::FdWatch *w);
+    void execFailed(void);
     void subprocessExited(void);
     void handleTimeout(void);
     
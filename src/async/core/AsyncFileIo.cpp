@@ -0,0 +1,423 @@
+/**
+@file   AsyncFileIo.cpp
+@brief  A service for doing file I/O in worker threads
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains the implementation of a class that runs blocking file I/O
+system calls in a small pool of worker threads.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncFdWatch.h"
+#include "AsyncFileIo.h"
+#include "AsyncThreadScheduling.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+unsigned FileIo::worker_cnt = FileIo::DEFAULT_WORKER_CNT;
+FileIo *FileIo::the_instance = 0;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+FileIo& FileIo::instance(void)
+{
+  if (the_instance == 0)
+  {
+    the_instance = new FileIo;
+  }
+  return *the_instance;
+} /* FileIo::instance */
+
+
+unsigned FileIo::read(int fd, void *buf, size_t len, off_t offset,
+                      const CompletionSlot& done)
+{
+  Request *req = new Request;
+  req->is_write = false;
+  req->fd = fd;
+  req->buf = buf;
+  req->len = len;
+  req->offset = offset;
+  req->done = done;
+  return submit(req);
+} /* FileIo::read */
+
+
+unsigned FileIo::write(int fd, const void *buf, size_t len, off_t offset,
+                       const CompletionSlot& done)
+{
+  Request *req = new Request;
+  req->is_write = true;
+  req->fd = fd;
+  req->buf = const_cast<void *>(buf);
+  req->len = len;
+  req->offset = offset;
+  req->done = done;
+  return submit(req);
+} /* FileIo::write */
+
+
+void FileIo::cancel(unsigned id)
+{
+  pthread_mutex_lock(&mutex);
+  if (eraseRequest(pending, id))
+  {
+    pthread_mutex_unlock(&mutex);
+    return;
+  }
+  while (running.find(id) != running.end())
+  {
+    pthread_cond_wait(&done_cond, &mutex);
+  }
+  eraseRequest(completed, id);
+  pthread_mutex_unlock(&mutex);
+
+    // The request may also be waiting to be dispatched in the main thread
+  for (RequestQueue::iterator it=dispatching.begin();
+       it!=dispatching.end(); ++it)
+  {
+    if ((*it)->id == id)
+    {
+      (*it)->done = CompletionSlot();
+      break;
+    }
+  }
+} /* FileIo::cancel */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+FileIo::FileIo(void)
+  : next_id(0), notify_watch(0), quit(false)
+{
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&work_cond, NULL);
+  pthread_cond_init(&done_cond, NULL);
+
+  if (pipe(notify_pipe) == -1)
+  {
+    cerr << "*** ERROR: Could not create the FileIo notification pipe: "
+         << strerror(errno) << endl;
+    abort();
+  }
+  fcntl(notify_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(notify_pipe[1], F_SETFL, O_NONBLOCK);
+  fcntl(notify_pipe[0], F_SETFD, FD_CLOEXEC);
+  fcntl(notify_pipe[1], F_SETFD, FD_CLOEXEC);
+  notify_watch = new FdWatch(notify_pipe[0], FdWatch::FD_WATCH_RD);
+  notify_watch->activity.connect(mem_fun(*this, &FileIo::onCompleted));
+
+  for (unsigned i=0; i<worker_cnt; ++i)
+  {
+    pthread_t thread;
+    int ret = pthread_create(&thread, NULL, workerThread, this);
+    if (ret != 0)
+    {
+      cerr << "*** WARNING: Could not create FileIo worker thread: "
+           << strerror(ret) << endl;
+      break;
+    }
+    workers.push_back(thread);
+  }
+  if (workers.empty())
+  {
+    cerr << "*** WARNING: No FileIo worker threads. File I/O will be "
+            "done in the main thread." << endl;
+  }
+} /* FileIo::FileIo */
+
+
+FileIo::~FileIo(void)
+{
+  pthread_mutex_lock(&mutex);
+  quit = true;
+  pthread_cond_broadcast(&work_cond);
+  pthread_mutex_unlock(&mutex);
+  for (vector<pthread_t>::iterator it=workers.begin();
+       it!=workers.end(); ++it)
+  {
+    pthread_join(*it, NULL);
+  }
+  deleteRequests(pending);
+  deleteRequests(completed);
+  deleteRequests(dispatching);
+  delete notify_watch;
+  ::close(notify_pipe[0]);
+  ::close(notify_pipe[1]);
+  pthread_cond_destroy(&done_cond);
+  pthread_cond_destroy(&work_cond);
+  pthread_mutex_destroy(&mutex);
+} /* FileIo::~FileIo */
+
+
+unsigned FileIo::submit(Request *req)
+{
+  if (++next_id == 0)
+  {
+    ++next_id;
+  }
+  req->id = next_id;
+  req->result = -1;
+  req->errnum = 0;
+
+  if (workers.empty())
+  {
+    execute(req);
+    pthread_mutex_lock(&mutex);
+    completed.push_back(req);
+    pthread_mutex_unlock(&mutex);
+    notifyMainThread();
+    return req->id;
+  }
+
+  pthread_mutex_lock(&mutex);
+  pending.push_back(req);
+  pthread_cond_signal(&work_cond);
+  pthread_mutex_unlock(&mutex);
+
+  return req->id;
+} /* FileIo::submit */
+
+
+void FileIo::onCompleted(FdWatch *watch)
+{
+  char buf[64];
+  while (::read(notify_pipe[0], buf, sizeof(buf)) > 0)
+  {
+  }
+
+  pthread_mutex_lock(&mutex);
+  dispatching.insert(dispatching.end(), completed.begin(), completed.end());
+  completed.clear();
+  pthread_mutex_unlock(&mutex);
+
+    // A completion slot may cancel requests that are still in the dispatch
+    // queue so the queue is consumed one request at a time
+  while (!dispatching.empty())
+  {
+    Request *req = dispatching.front();
+    dispatching.pop_front();
+    CompletionSlot done = req->done;
+    ssize_t result = req->result;
+    int errnum = req->errnum;
+    delete req;
+    if (!done.empty())
+    {
+      done(result, errnum);
+    }
+  }
+} /* FileIo::onCompleted */
+
+
+void FileIo::execute(Request *req)
+{
+  ssize_t ret;
+  do
+  {
+    if (req->is_write)
+    {
+      ret = (req->offset < 0)
+          ? ::write(req->fd, req->buf, req->len)
+          : ::pwrite(req->fd, req->buf, req->len, req->offset);
+    }
+    else
+    {
+      ret = (req->offset < 0)
+          ? ::read(req->fd, req->buf, req->len)
+          : ::pread(req->fd, req->buf, req->len, req->offset);
+    }
+  } while ((ret == -1) && (errno == EINTR));
+  req->result = ret;
+  req->errnum = (ret < 0) ? errno : 0;
+} /* FileIo::execute */
+
+
+void *FileIo::workerThread(void *arg)
+{
+  ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_FILE_IO);
+  FileIo *self = static_cast<FileIo *>(arg);
+  pthread_mutex_lock(&self->mutex);
+  for (;;)
+  {
+    while (self->pending.empty() && !self->quit)
+    {
+      pthread_cond_wait(&self->work_cond, &self->mutex);
+    }
+    if (self->quit)
+    {
+      break;
+    }
+    Request *req = self->pending.front();
+    self->pending.pop_front();
+    self->running.insert(req->id);
+    pthread_mutex_unlock(&self->mutex);
+
+    execute(req);
+
+    pthread_mutex_lock(&self->mutex);
+    self->running.erase(req->id);
+    bool was_empty = self->completed.empty();
+    self->completed.push_back(req);
+    pthread_cond_broadcast(&self->done_cond);
+    if (was_empty)
+    {
+      self->notifyMainThread();
+    }
+  }
+  pthread_mutex_unlock(&self->mutex);
+  return NULL;
+} /* FileIo::workerThread */
+
+
+void FileIo::notifyMainThread(void)
+{
+    // If the pipe is full there already is a pending notification
+  char ch = 0;
+  ssize_t ret = ::write(notify_pipe[1], &ch, 1);
+  (void)ret;
+} /* FileIo::notifyMainThread */
+
+
+
+bool FileIo::eraseRequest(RequestQueue& queue, unsigned id)
+{
+  for (RequestQueue::iterator it=queue.begin(); it!=queue.end(); ++it)
+  {
+    if ((*it)->id == id)
+    {
+      delete *it;
+      queue.erase(it);
+      return true;
+    }
+  }
+  return false;
+} /* FileIo::eraseRequest */
+
+
+void FileIo::deleteRequests(RequestQueue& queue)
+{
+  for (RequestQueue::iterator it=queue.begin(); it!=queue.end(); ++it)
+  {
+    delete *it;
+  }
+  queue.clear();
+} /* FileIo::deleteRequests */
+
+
+/*
+ * This file has not been truncated
+ */
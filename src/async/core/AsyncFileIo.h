@@ -0,0 +1,262 @@
+/**
+@file   AsyncFileIo.h
+@brief  A service for doing file I/O in worker threads
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that runs blocking file I/O system calls in a small
+pool of worker threads and reports the completion of each request on the main
+event loop.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_FILE_IO_INCLUDED
+#define ASYNC_FILE_IO_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <pthread.h>
+#include <sigc++/sigc++.h>
+
+#include <deque>
+#include <set>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class FdWatch;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+ * @brief   A service for doing file I/O without blocking the event loop
+ * @author  Tobias Blomberg / SM0SVX
+ * @date    2026-10-14
+ *
+ * Reading and writing files on slow media, like SD cards, may block for
+ * tens of milliseconds. This class runs the actual read and write system calls
+ * in a small pool of worker threads. When a request has been completed the
+ * given completion slot is called from the main event loop, so the user of
+ * this class never has to care about threads.
+ *
+ * The buffer given to a request is owned by the caller but must not be
+ * touched until the completion slot has been called or the request has been
+ * cancelled.
+ *
+ * \code
+ *   unsigned id = FileIo::instance().read(fd, buf, sizeof(buf), 0,
+ *       mem_fun(*this, &MyClass::onReadDone));
+ * \endcode
+ */
+class FileIo : public sigc::trackable
+{
+  public:
+    /**
+     * @brief   The completion slot type
+     *
+     * The first argument is the return value of the read or write system
+     * call and the second argument is the errno value if the first argument
+     * is negative.
+     */
+    typedef sigc::slot<void, ssize_t, int> CompletionSlot;
+
+    /**
+     * @brief   The default number of worker threads
+     */
+    static const unsigned DEFAULT_WORKER_CNT = 2;
+
+    /**
+     * @brief   Get the file I/O service instance
+     * @return  Returns the one and only file I/O service object
+     *
+     * The instance is created on the first call. The Async::Application
+     * object must have been created before that.
+     */
+    static FileIo& instance(void);
+
+    /**
+     * @brief   Set the number of worker threads to use
+     * @param   cnt The number of worker threads
+     *
+     * This function must be called before the first call to instance() to
+     * have any effect.
+     */
+    static void setWorkerCount(unsigned cnt) { worker_cnt = cnt; }
+
+    /**
+     * @brief   Start reading data from a file
+     * @param   fd      The file descriptor to read from
+     * @param   buf     The buffer to read data into
+     * @param   len     The maximum number of bytes to read
+     * @param   offset  The file offset to read from. A negative value will
+     *                  read from the current file position.
+     * @param   done    The slot to call when the read has completed
+     * @return  Returns an id that can be used to cancel the request
+     */
+    unsigned read(int fd, void *buf, size_t len, off_t offset,
+                  const CompletionSlot& done);
+
+    /**
+     * @brief   Start writing data to a file
+     * @param   fd      The file descriptor to write to
+     * @param   buf     The buffer containing the data to write
+     * @param   len     The number of bytes to write
+     * @param   offset  The file offset to write at. A negative value will
+     *                  write at the current file position.
+     * @param   done    The slot to call when the write has completed
+     * @return  Returns an id that can be used to cancel the request
+     */
+    unsigned write(int fd, const void *buf, size_t len, off_t offset,
+                   const CompletionSlot& done);
+
+    /**
+     * @brief   Cancel a request
+     * @param   id The id of the request to cancel
+     *
+     * The completion slot will not be called after this function has
+     * returned. If the request is being executed by a worker thread, the
+     * call will block until it is done so that the buffer is free for reuse
+     * when this function returns.
+     */
+    void cancel(unsigned id);
+
+  private:
+    struct Request
+    {
+      unsigned        id;
+      bool            is_write;
+      int             fd;
+      void            *buf;
+      size_t          len;
+      off_t           offset;
+      ssize_t         result;
+      int             errnum;
+      CompletionSlot  done;
+    };
+    typedef std::deque<Request*> RequestQueue;
+
+    static unsigned worker_cnt;
+    static FileIo * the_instance;
+
+    std::vector<pthread_t>  workers;
+    pthread_mutex_t         mutex;
+    pthread_cond_t          work_cond;
+    pthread_cond_t          done_cond;
+    RequestQueue            pending;
+    RequestQueue            completed;
+    RequestQueue            dispatching;
+    std::set<unsigned>      running;
+    unsigned                next_id;
+    int                     notify_pipe[2];
+    FdWatch *               notify_watch;
+    bool                    quit;
+
+    FileIo(void);
+    ~FileIo(void);
+    FileIo(const FileIo&);
+    FileIo& operator=(const FileIo&);
+
+    unsigned submit(Request *req);
+    void onCompleted(FdWatch *watch);
+    void notifyMainThread(void);
+    static void execute(Request *req);
+    static void *workerThread(void *arg);
+    static bool eraseRequest(RequestQueue& queue, unsigned id);
+    static void deleteRequests(RequestQueue& queue);
+
+};  /* class FileIo */
+
+
+} /* namespace */
+
+#endif /* ASYNC_FILE_IO_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -5,7 +5,8 @@
 @date	 2011-07-20
 
 This file contains a class that is used for buffered reading
-from binary files in a completely non-blocking way.
+from binary files in a completely non-blocking way. The file is read ahead
+by the Async::FileIo worker threads.
 
 \verbatim
 Async - A library for programming event driven applications
@@ -45,7 +46,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
-#include <AsyncFdWatch.h>
+#include <AsyncFileIo.h>
 
 
 /****************************************************************************
@@ -117,8 +118,8 @@ using namespace Async;
  ****************************************************************************/
 
 FileReader::FileReader(int buf_size)
-  : fd(-1), rd_watch(0), buffer(0), head(0), tail(0), buf_size(buf_size),
-    is_full(false), is_eof(false)
+  : fd(-1), buffer(0), head(0), tail(0), buf_size(buf_size),
+    is_full(false), is_eof(false), is_err(false), file_pos(0), read_id(0)
 {
   buffer = new char [buf_size];
 } /* FileReader::FileReader */
@@ -135,18 +136,17 @@ bool FileReader::open(const string& name)
 {
   close();
   
-  fd = ::open(name.c_str(), O_RDONLY | O_NONBLOCK);
+  fd = ::open(name.c_str(), O_RDONLY);
   if (fd == -1)
   {
     return false;
   }
   
-  rd_watch = new FdWatch(fd, FdWatch::FD_WATCH_RD);
-  rd_watch->activity.connect(mem_fun(*this, &FileReader::onDataAvail));
+  fillBuffer();
 
-  return fillBuffer();
+  return true;
   
-} /* FileReader::openPort */
+} /* FileReader::open */
 
 
 bool FileReader::close(void)
@@ -155,26 +155,29 @@ bool FileReader::close(void)
   {
     return true;
   }
-  
-  if (::close(fd) < 0)
+
+  if (read_id != 0)
   {
-    return false;
+    FileIo::instance().cancel(read_id);
+    read_id = 0;
   }
   
+  int ret = ::close(fd);
   fd = -1;
   head = tail = 0;
   is_full = false;
   is_eof = false;
+  is_err = false;
+  file_pos = 0;
   
-  delete rd_watch;
-  return true;
+  return (ret == 0);
   
 } /* FileReader::close */
 
 
 int FileReader::read(void *buf, int len)
 {
-  if (!fillBuffer())
+  if (!isOpen() || is_err)
   {
     return -1;
   }
@@ -182,10 +185,10 @@ int FileReader::read(void *buf, int len)
   int avail = bytesInBuffer();
   if (!is_eof && (avail < len))
   {
-    cerr << "FileReader: Buffer underrun" << endl;
-    return -1;
+    fillBuffer();
+    return 0;
   }
-  
+
   int bytes_from_buffer = min(avail, len);
   int written = 0;
   while (bytes_from_buffer > 0)
@@ -201,8 +204,10 @@ int FileReader::read(void *buf, int len)
 
   is_full &= (written == 0);
 
+  fillBuffer();
+
   return written;
-}
+} /* FileReader::read */
 
 
 /****************************************************************************
@@ -211,52 +216,48 @@ int FileReader::read(void *buf, int len)
  *
  ****************************************************************************/
 
-void FileReader::onDataAvail(FdWatch *watch)
+void FileReader::fillBuffer(void)
 {
-  fillBuffer();
+  if (!isOpen() || (read_id != 0) || is_full || is_eof || is_err)
+  {
+    return;
+  }
 
-} /* FileReader::onDataAvail */
+    // Only read into the contiguous free space. The rest of the free space
+    // will be filled by the next request.
+  int space = (head >= tail) ? (buf_size - head) : (tail - head);
+  read_id = FileIo::instance().read(fd, buffer + head, space, file_pos,
+      mem_fun(*this, &FileReader::onReadDone));
 
+} /* FileReader::fillBuffer */
 
-bool FileReader::fillBuffer(void)
-{
-  int space = buf_size - bytesInBuffer();
 
-  int bytes_to_buffer = space;
-  int written = 0;
-  while ((bytes_to_buffer > 0) && isOpen())
+void FileReader::onReadDone(ssize_t cnt, int errnum)
+{
+  read_id = 0;
+  if (cnt < 0)
   {
-    int to_end_of_buffer = min(bytes_to_buffer, buf_size - head);
-    int cnt = ::read(fd, buffer + head, to_end_of_buffer);
-
-    if (cnt <= 0)
-    {
-      if (cnt < 0)
-      {
-        if (errno == EAGAIN)
-          rd_watch->setEnabled(true);
-        if ((errno == EIO) || (errno == EBADF) || (errno == EINVAL))
-          close();
-      }
-      is_eof |= (cnt == 0);
-      break;
-    }
-    
-    head += cnt;
-    head %= buf_size;
-    bytes_to_buffer -= cnt;
-    written += cnt;
+    cerr << "*** WARNING: FileReader read failed: " << strerror(errnum)
+         << endl;
+    is_err = true;
   }
-  
-  if (written == space)
+  else if (cnt == 0)
+  {
+    is_eof = true;
+  }
+  else
   {
-    is_full = true;
-    rd_watch->setEnabled(false);
+    head += cnt;
+    head %= buf_size;
+    file_pos += cnt;
+    is_full = (head == tail);
+    fillBuffer();
   }
 
-  return isOpen();
+    // Emit last since the receiver may delete this object
+  dataAvailable();
 
-} /* FileReader::fillBuffer */
+} /* FileReader::onReadDone */
 
 
 int FileReader::bytesInBuffer(void) const
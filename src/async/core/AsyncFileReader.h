@@ -5,7 +5,8 @@
 @date	 2011-07-20
 
 This file contains a class that is used for buffered reading
-from binary files in a completely non-blocking way.
+from binary files in a completely non-blocking way. The file is read ahead
+by the Async::FileIo worker threads.
 
 \verbatim
 Async - A library for programming event driven applications
@@ -84,8 +85,7 @@ namespace Async
  *
  ****************************************************************************/
 
-class FdWatch;
-  
+
 
 /****************************************************************************
  *
@@ -109,13 +109,21 @@ class FdWatch;
  *
  ****************************************************************************/
 
+/**
+ * @brief   A read ahead buffer for binary files
+ *
+ * This class keeps a buffer filled with data read ahead from a file. The
+ * actual reading is done by the Async::FileIo service so the main loop never
+ * blocks on a slow disk. When more data has been read into the buffer the
+ * dataAvailable signal is emitted.
+ */
 class FileReader : public sigc::trackable
 {
   public:
 
     /**
       * @brief   Constuctor
-      * @param   buf_size The device name of the serial port to use
+      * @param   buf_size The size of the read ahead buffer in bytes
       *
       * This is the constructor for the file reader class. The buffer size
       * should be assigned at least twice as large as the maximum block size
@@ -155,21 +163,50 @@ class FileReader : public sigc::trackable
       * @param   len  The number of bytes to be read
       * @return  The number of read bytes is returned on success. If an error
       *          occurs, -1 is returned.
+      *
+      * This function never blocks. If the read ahead has not yet buffered
+      * len bytes, zero is returned and the dataAvailable signal will be
+      * emitted when more data is available. Fewer bytes than requested are
+      * only returned at the end of the file. Use isEof to find out if a zero
+      * return value means that the end of the file has been reached.
       */
     int read(void *buf, int len);
 
+    /**
+     * @brief   Find out how much data that can be read without waiting
+     * @return  Returns the number of bytes in the read ahead buffer
+     */
+    int available(void) const { return bytesInBuffer(); }
+
+    /**
+     * @brief   Check if all data in the file has been read
+     * @return  Returns \em true if the end of the file has been reached and
+     *          all buffered data has been read
+     */
+    bool isEof(void) const { return is_eof && (bytesInBuffer() == 0); }
+
+    /**
+     * @brief   A signal that is emitted when the read ahead has completed
+     *
+     * The signal is emitted when more data has been read into the buffer,
+     * when the end of the file has been reached or when a read error has
+     * occurred.
+     */
+    sigc::signal<void> dataAvailable;
       
   private:
-    int     fd;
-    FdWatch *rd_watch;
-    char    *buffer;
-    int     head, tail;
-    int     buf_size;
-    bool    is_full;
-    bool    is_eof;
+    int       fd;
+    char      *buffer;
+    int       head, tail;
+    int       buf_size;
+    bool      is_full;
+    bool      is_eof;
+    bool      is_err;
+    off_t     file_pos;
+    unsigned  read_id;
     
-    void onDataAvail(FdWatch *watch);
-    bool fillBuffer(void);
+    void fillBuffer(void);
+    void onReadDone(ssize_t cnt, int errnum);
     int bytesInBuffer(void) const;
     
 };  /* class FileReader */
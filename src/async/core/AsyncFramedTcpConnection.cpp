@@ -112,9 +112,51 @@ using namespace Async;
  *
  ****************************************************************************/
 
+FramedTcpConnection::Frame::Frame(int count)
+  : m_buf(reinterpret_cast<char*>(this + 1)), m_size(HEADER_SIZE+count),
+    m_ref_cnt(1)
+{
+  char *ptr = m_buf;
+  *ptr++ = static_cast<uint32_t>(count) >> 24;
+  *ptr++ = (static_cast<uint32_t>(count) >> 16) & 0xff;
+  *ptr++ = (static_cast<uint32_t>(count) >> 8) & 0xff;
+  *ptr++ = (static_cast<uint32_t>(count)) & 0xff;
+} /* FramedTcpConnection::Frame::Frame */
+
+
+FramedTcpConnection::Frame *FramedTcpConnection::Frame::create(
+    const void *buf, int count)
+{
+  struct iovec iov;
+  iov.iov_base = const_cast<void*>(buf);
+  iov.iov_len = count;
+  return create(&iov, 1);
+} /* FramedTcpConnection::Frame::create */
+
+
+FramedTcpConnection::Frame *FramedTcpConnection::Frame::create(
+    const struct iovec *iov, int iovcnt)
+{
+  int count = 0;
+  for (int i=0; i<iovcnt; ++i)
+  {
+    count += iov[i].iov_len;
+  }
+  void *mem = BlockPool::allocate(sizeof(Frame) + HEADER_SIZE + count);
+  Frame *frame = new (mem) Frame(count);
+  char *ptr = frame->m_buf + HEADER_SIZE;
+  for (int i=0; i<iovcnt; ++i)
+  {
+    std::memcpy(ptr, iov[i].iov_base, iov[i].iov_len);
+    ptr += iov[i].iov_len;
+  }
+  return frame;
+} /* FramedTcpConnection::Frame::create */
+
+
 FramedTcpConnection::FramedTcpConnection(size_t recv_buf_len)
   : TcpConnection(recv_buf_len), m_max_frame_size(DEFAULT_MAX_FRAME_SIZE),
-    m_size_received(false)
+    m_size_received(false), m_txq_bytes(0), m_max_txq_size(0)
 {
   TcpConnection::sendBufferFull.connect(
       sigc::mem_fun(*this, &FramedTcpConnection::onSendBufferFull));
@@ -125,13 +167,17 @@ FramedTcpConnection::FramedTcpConnection(
     int sock, const IpAddress& remote_addr, uint16_t remote_port,
     size_t recv_buf_len)
   : TcpConnection(sock, remote_addr, remote_port, recv_buf_len),
-    m_max_frame_size(DEFAULT_MAX_FRAME_SIZE), m_size_received(false)
+    m_max_frame_size(DEFAULT_MAX_FRAME_SIZE), m_size_received(false),
+    m_txq_bytes(0), m_max_txq_size(0)
 {
+  TcpConnection::sendBufferFull.connect(
+      sigc::mem_fun(*this, &FramedTcpConnection::onSendBufferFull));
 } /* FramedTcpConnection::FramedTcpConnection */
 
 
 FramedTcpConnection::~FramedTcpConnection(void)
 {
+  disconnectCleanup();
 } /* FramedTcpConnection::~FramedTcpConnection */
 
 
@@ -150,42 +196,88 @@ int FramedTcpConnection::write(const void *buf, int count)
   {
     return 0;
   }
+  struct iovec iov;
+  iov.iov_base = const_cast<void*>(buf);
+  iov.iov_len = count;
+  return write(&iov, 1);
+} /* FramedTcpConnection::write */
+
+
+int FramedTcpConnection::write(const struct iovec *iov, int iovcnt)
+{
+  int count = 0;
+  for (int i=0; i<iovcnt; ++i)
+  {
+    count += iov[i].iov_len;
+  }
+  if (count < 0)
+  {
+    return 0;
+  }
   else if (static_cast<uint32_t>(count) > m_max_frame_size)
   {
     errno = EMSGSIZE;
     return -1;
   }
 
-  QueueItem *qi = new QueueItem(buf, count);
+  Frame *frame = Frame::create(iov, iovcnt);
+  int ret = write(frame);
+  frame->unref();
+  return ret;
+} /* FramedTcpConnection::write */
+
+
+int FramedTcpConnection::write(Frame *frame, Priority prio)
+{
+  if (static_cast<uint32_t>(frame->payloadSize()) > m_max_frame_size)
+  {
+    errno = EMSGSIZE;
+    return -1;
+  }
+
+    // A frame is never partly sent so the limit is checked before anything
+    // is written. When the queue is empty the frame is written directly.
+  if (!m_txq.empty() && (m_max_txq_size > 0) &&
+      (m_txq_bytes + frame->size() > m_max_txq_size))
+  {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  int pos = 0;
   if (m_txq.empty())
   {
-    int ret = TcpConnection::write(qi->m_buf, qi->m_size);
-    //cout << "###   count=" << (qi->m_size-qi->m_pos) << " ret=" << ret << endl;
-    if (ret < 0)
+    pos = TcpConnection::write(frame->data(), frame->size());
+    //cout << "###   count=" << frame->size() << " ret=" << pos << endl;
+    if (pos < 0)
     {
-      delete qi;
-      qi = 0;
       return -1;
     }
-    if (ret >= qi->m_size)
-    {
-      delete qi;
-      qi = 0;
-    }
-    else
-    {
-      //cout << "### Not all bytes were sent: count=" << count
-      //     << " ret=" << ret << endl;
-      qi->m_pos += ret;
-    }
   }
 
-  if (qi != 0)
+  if (pos < frame->size())
   {
-    m_txq.push_back(qi);
+    frame->ref();
+    TxQueue::iterator it = m_txq.end();
+    if (prio == PRIO_HIGH)
+    {
+        // Put the frame after the frame currently being transmitted and
+        // after other high priority frames
+      it = m_txq.begin();
+      if ((it != m_txq.end()) && (it->m_pos > 0))
+      {
+        ++it;
+      }
+      while ((it != m_txq.end()) && (it->m_prio == PRIO_HIGH))
+      {
+        ++it;
+      }
+    }
+    m_txq.insert(it, QueueItem(frame, pos, prio));
+    m_txq_bytes += frame->size() - pos;
   }
 
-  return count;
+  return frame->payloadSize();
 } /* FramedTcpConnection::write */
 
 
@@ -264,23 +356,46 @@ void FramedTcpConnection::onSendBufferFull(bool is_full)
   //     << is_full << "\n";
   if (!is_full)
   {
+      // Send as many of the queued frames as possible using one system call
     while (!m_txq.empty())
     {
-      QueueItem *qi = m_txq.front();
-      int ret = TcpConnection::write(qi->m_buf+qi->m_pos, qi->m_size-qi->m_pos);
-      //cout << "###   count=" << (qi->m_size-qi->m_pos) << " ret=" << ret << endl;
+      struct iovec iov[MAX_WRITE_IOVCNT];
+      int iovcnt = 0;
+      int count = 0;
+      for (TxQueue::iterator it = m_txq.begin();
+           (it != m_txq.end()) && (iovcnt < MAX_WRITE_IOVCNT); ++it)
+      {
+        iov[iovcnt].iov_base = const_cast<char*>(it->m_frame->data()) +
+                               it->m_pos;
+        iov[iovcnt].iov_len = it->m_frame->size() - it->m_pos;
+        count += iov[iovcnt].iov_len;
+        ++iovcnt;
+      }
+      int ret = TcpConnection::write(iov, iovcnt);
+      //cout << "###   count=" << count << " ret=" << ret << endl;
       if (ret <= 0)
       {
         return;
       }
-      qi->m_pos += ret;
-      if (qi->m_pos < qi->m_size)
+      int written = ret;
+      m_txq_bytes -= ret;
+      while (written > 0)
+      {
+        QueueItem& qi = m_txq.front();
+        int left = qi.m_frame->size() - qi.m_pos;
+        if (written < left)
+        {
+          qi.m_pos += written;
+          break;
+        }
+        written -= left;
+        qi.m_frame->unref();
+        m_txq.pop_front();
+      }
+      if (ret < count)
       {
         break;
       }
-      m_txq.pop_front();
-      delete qi;
-      qi = 0;
     }
   }
 } /* FramedTcpConnection::onSendBufferFull */
@@ -290,9 +405,10 @@ void FramedTcpConnection::disconnectCleanup(void)
 {
   for (TxQueue::iterator it = m_txq.begin(); it != m_txq.end(); ++it)
   {
-    delete *it;
+    it->m_frame->unref();
   }
   m_txq.clear();
+  m_txq_bytes = 0;
 } /* FramedTcpConnection::disconnectCleanup */
 
 
@@ -56,6 +56,7 @@ An example of how to use the FramedTcpConnection class in a server
  ****************************************************************************/
 
 #include <AsyncTcpConnection.h>
+#include <AsyncBlockPool.h>
 
 
 /****************************************************************************
@@ -131,6 +132,99 @@ that only want to see completely transfered messages at the other end.
 class FramedTcpConnection : public TcpConnection
 {
   public:
+    /**
+     * @brief The priority of a frame in the transmit queue
+     *
+     * A high priority frame is queued before all normal priority frames that
+     * have not yet started to be transmitted. The order of frames with the
+     * same priority is always kept.
+     */
+    typedef enum
+    {
+      PRIO_NORMAL,  ///< Queued last, in order
+      PRIO_HIGH     ///< Queued before normal priority frames
+    } Priority;
+
+    /**
+     * @brief A reference counted frame that can be queued on many connections
+     *
+     * A frame hold the data to send together with the frame header. The same
+     * frame can be written to any number of connections without copying,
+     * which is useful when broadcasting a message to many clients. Each
+     * connection that have to queue the frame take a reference to it. The
+     * creator of the frame must call unref when done with it and the frame
+     * is deleted when the last reference has been released. The frame
+     * object and its data are kept in a single Async::BlockPool block.
+     */
+    class Frame
+    {
+      public:
+        /**
+         * @brief   Create a new frame
+         * @param   buf   The buffer containing the frame payload
+         * @param   count The number of bytes in the buffer
+         * @return  Returns a new frame with a reference count of one
+         */
+        static Frame *create(const void *buf, int count);
+
+        /**
+         * @brief   Create a new frame gathered from a number of buffers
+         * @param   iov     An array of buffers that make up the frame payload
+         * @param   iovcnt  The number of elements in the iov array
+         * @return  Returns a new frame with a reference count of one
+         */
+        static Frame *create(const struct iovec *iov, int iovcnt);
+
+        /**
+         * @brief   Take a reference to the frame
+         */
+        void ref(void) { ++m_ref_cnt; }
+
+        /**
+         * @brief   Release a reference to the frame
+         *
+         * The frame is deleted when the last reference is released.
+         */
+        void unref(void)
+        {
+          if (--m_ref_cnt == 0)
+          {
+            this->~Frame();
+            BlockPool::release(this);
+          }
+        }
+
+        /**
+         * @brief   Get the frame data, including the frame header
+         * @return  Returns a pointer to the frame data
+         */
+        const char *data(void) const { return m_buf; }
+
+        /**
+         * @brief   Get the size of the frame data, including the frame header
+         * @return  Returns the number of bytes to send on the connection
+         */
+        int size(void) const { return m_size; }
+
+        /**
+         * @brief   Get the size of the frame payload
+         * @return  Returns the number of payload bytes in the frame
+         */
+        int payloadSize(void) const { return m_size - HEADER_SIZE; }
+
+      private:
+        static const int HEADER_SIZE = 4;
+
+        char*     m_buf;
+        int       m_size;
+        unsigned  m_ref_cnt;
+
+        Frame(int count);
+        ~Frame(void) {}
+        Frame(const Frame&);
+        Frame& operator=(const Frame&);
+    };
+
     /**
      * @brief 	Constructor
      * @param 	recv_buf_len  The length of the receiver buffer to use
@@ -163,6 +257,24 @@ class FramedTcpConnection : public TcpConnection
      */
     void setMaxFrameSize(uint32_t frame_size) { m_max_frame_size = frame_size; }
 
+    /**
+     * @brief   Set the maximum size of the transmit queue
+     * @param   size The maximum number of queued bytes, 0 for no limit
+     *
+     * Frames that cannot be sent directly are queued until the socket is
+     * writable again. Use this function to limit how much data that may be
+     * queued. A write that would make the queue grow larger than this fails
+     * with errno set to ENOBUFS. The frame is then not sent at all. The
+     * default is to not limit the queue size.
+     */
+    void setMaxTxQueueSize(size_t size) { m_max_txq_size = size; }
+
+    /**
+     * @brief   Get the size of the transmit queue
+     * @return  Returns the number of bytes waiting to be sent
+     */
+    size_t txQueueSize(void) const { return m_txq_bytes; }
+
     /**
      * @brief 	Disconnect from the remote host
      *
@@ -185,6 +297,30 @@ class FramedTcpConnection : public TcpConnection
      */
     virtual int write(const void *buf, int count);
 
+    /**
+     * @brief 	Send a frame gathered from a number of buffers
+     * @param 	iov     An array of buffers that together make up the frame
+     * @param 	iovcnt  The number of elements in the iov array
+     * @return	Return bytes written or -1 on failure
+     *
+     * Like the buffer variant of write, the frame will either be completely
+     * transmitted or discarded on error.
+     */
+    virtual int write(const struct iovec *iov, int iovcnt);
+
+    /**
+     * @brief 	Send a shared frame on the TCP connection
+     * @param 	frame The frame to send
+     * @param 	prio  The priority of the frame in the transmit queue
+     * @return	Return the frame payload size or -1 on failure
+     *
+     * This function will send a frame that may also be queued on other
+     * connections. If the frame cannot be sent right away a reference is
+     * taken to it so that the caller can release its own reference as soon
+     * as the frame has been written to all connections.
+     */
+    int write(Frame *frame, Priority prio=PRIO_NORMAL);
+
     /**
      * @brief 	A signal that is emitted when a connection has been terminated
      * @param 	con   	The connection object
@@ -235,32 +371,26 @@ class FramedTcpConnection : public TcpConnection
   private:
     static const uint32_t DEFAULT_MAX_FRAME_SIZE = 1024 * 1024; // 1MB
 
+    static const int      MAX_WRITE_IOVCNT = 64;
+
     struct QueueItem
     {
-      char* m_buf;
-      int   m_size;
-      int   m_pos;
-
-      QueueItem(const void* buf, int count)
-        : m_buf(0), m_size(4+count), m_pos(0)
-      {
-        m_buf = new char[4+count];
-        char *ptr = m_buf;
-        *ptr++ = static_cast<uint32_t>(count) >> 24;
-        *ptr++ = (static_cast<uint32_t>(count) >> 16) & 0xff;
-        *ptr++ = (static_cast<uint32_t>(count) >> 8) & 0xff;
-        *ptr++ = (static_cast<uint32_t>(count)) & 0xff;
-        std::memcpy(ptr, buf, count);
-      }
-      ~QueueItem(void) { delete [] m_buf; }
+      Frame*    m_frame;
+      int       m_pos;
+      Priority  m_prio;
+
+      QueueItem(Frame *frame, int pos, Priority prio)
+        : m_frame(frame), m_pos(pos), m_prio(prio) {}
     };
-    typedef std::deque<QueueItem*> TxQueue;
+    typedef std::deque<QueueItem> TxQueue;
 
     uint32_t              m_max_frame_size;
     bool                  m_size_received;
     uint32_t              m_frame_size;
     std::vector<uint8_t>  m_frame;
     TxQueue               m_txq;
+    size_t                m_txq_bytes;
+    size_t                m_max_txq_size;
 
     FramedTcpConnection(const FramedTcpConnection&);
     FramedTcpConnection& operator=(const FramedTcpConnection&);
@@ -30,9 +30,16 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <sys/uio.h>
+#include <strings.h>
+
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
 #include <cerrno>
 #include <sstream>
+#include <algorithm>
 #include <cassert>
 
 
@@ -50,6 +57,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include "AsyncApplication.h"
 #include "AsyncHttpServerConnection.h"
 
 
@@ -87,6 +95,9 @@ using namespace Async;
  *
  ****************************************************************************/
 
+static const std::string* findHeader(const HttpServerConnection::Headers& hdrs,
+                                     const char* name);
+static bool hasToken(const std::string& value, const char* token);
 
 
 /****************************************************************************
@@ -114,10 +125,12 @@ using namespace Async;
 
 HttpServerConnection::HttpServerConnection(size_t recv_buf_len)
   : TcpConnection(recv_buf_len), m_state(STATE_DISCONNECTED),
-    m_chunked(false)
+    m_chunked(false), m_keep_alive(false), m_hdr_scan_len(0),
+    m_payload_left(0)
 {
   TcpConnection::sendBufferFull.connect(
       sigc::mem_fun(*this, &HttpServerConnection::onSendBufferFull));
+  setMaxRecvBufLen(MAX_HEADER_LEN);
 } /* HttpServerConnection::HttpServerConnection */
 
 
@@ -125,8 +138,12 @@ HttpServerConnection::HttpServerConnection(
     int sock, const IpAddress& remote_addr, uint16_t remote_port,
     size_t recv_buf_len)
   : TcpConnection(sock, remote_addr, remote_port, recv_buf_len),
-    m_state(STATE_EXPECT_START_LINE), m_chunked(false)
+    m_state(STATE_EXPECT_HEADER), m_chunked(false), m_keep_alive(false),
+    m_hdr_scan_len(0), m_payload_left(0)
 {
+    // The whole request header block must fit in the receive buffer since
+    // it is parsed in place
+  setMaxRecvBufLen(MAX_HEADER_LEN);
 } /* HttpServerConnection::HttpServerConnection */
 
 
@@ -186,26 +203,77 @@ void HttpServerConnection::disconnect(void)
 
 bool HttpServerConnection::write(const Response& res)
 {
-  std::ostringstream os;
-  os << "HTTP/1.1 " << res.code() << " " << codeToString(res.code()) << "\r\n";
-  for (std::map<std::string, std::string>::const_iterator it=res.headers().begin();
-       it!=res.headers().end(); ++it)
+  const Headers& hdrs = res.headers();
+  unsigned code = res.code();
+
+    // A response that is not chunked and does not carry a length is ended by
+    // closing the connection so no further requests can be handled after it
+  bool delimited = m_chunked || (findHeader(hdrs, "Content-length") != 0) ||
+                   (code / 100 == 1) || (code == 204) || (code == 304) ||
+                   (m_req.method == "HEAD");
+  const std::string* con_hdr = findHeader(hdrs, "Connection");
+  const char* add_con_hdr = 0;
+  if (m_chunked || !delimited)
+  {
+    m_state = STATE_RESPONSE_STREAM;
+  }
+  else if (!m_keep_alive || ((con_hdr != 0) && hasToken(*con_hdr, "close")))
+  {
+    if (con_hdr == 0)
+    {
+      add_con_hdr = "close";
+    }
+    if (m_state != STATE_CLOSING)
+    {
+      m_state = STATE_CLOSING;
+      Application::app().runTask(
+          sigc::mem_fun(*this, &HttpServerConnection::closeConnection));
+    }
+  }
+  else if ((m_req.ver_major == 1) && (m_req.ver_minor == 0) &&
+           (con_hdr == 0))
+  {
+    add_con_hdr = "keep-alive";
+  }
+
+  m_tx_hdr.clear();
+  char status[32];
+  snprintf(status, sizeof(status), "HTTP/1.1 %u ", code);
+  m_tx_hdr += status;
+  m_tx_hdr += codeToString(code);
+  m_tx_hdr += "\r\n";
+  for (Headers::const_iterator it=hdrs.begin(); it!=hdrs.end(); ++it)
+  {
+    m_tx_hdr += (*it).first;
+    m_tx_hdr += ": ";
+    m_tx_hdr += (*it).second;
+    m_tx_hdr += "\r\n";
+  }
+  if (add_con_hdr != 0)
   {
-    os << (*it).first << ": " << (*it).second << "\r\n";
+    m_tx_hdr += "Connection: ";
+    m_tx_hdr += add_con_hdr;
+    m_tx_hdr += "\r\n";
   }
   if (m_chunked)
   {
-    os << "Transfer-encoding: chunked\r\n";
+    m_tx_hdr += "Transfer-encoding: chunked\r\n";
   }
-  os << "\r\n";
-  if (res.sendContent())
+  m_tx_hdr += "\r\n";
+
+  struct iovec iov[2];
+  iov[0].iov_base = const_cast<char*>(m_tx_hdr.data());
+  iov[0].iov_len = m_tx_hdr.size();
+  int iovcnt = 1;
+  size_t len = m_tx_hdr.size();
+  if (res.sendContent() && !res.content().empty())
   {
-    os << res.content();
+    iov[1].iov_base = const_cast<char*>(res.content().data());
+    iov[1].iov_len = res.content().size();
+    len += res.content().size();
+    iovcnt = 2;
   }
-  //std::cout << "### HttpServerConnection::write:" << std::endl;
-  //std::cout << os.str() << std::endl;
-  int len = os.str().size();
-  return TcpConnection::write(os.str().c_str(), len) == len;
+  return TcpConnection::write(iov, iovcnt) == static_cast<int>(len);
 } /* HttpServerConnection::write */
 
 
@@ -213,23 +281,21 @@ bool HttpServerConnection::write(const char* buf, int len)
 {
   assert(len >= 0);
 
-  int ret = -1;
-  if (m_chunked)
+  if (!m_chunked)
   {
-    std::ostringstream os;
-    //os << hex << len << ";tg=240;talker=SM0SVX\r\n";
-    os << hex << len << "\r\n";
-    ret = TcpConnection::write(os.str().c_str(), os.str().size());
-    ret += TcpConnection::write(buf, len);
-    ret += TcpConnection::write("\r\n", 2);
-    len += os.str().size() + 2;
-  }
-  else
-  {
-    ret = TcpConnection::write(buf, len);
+    return TcpConnection::write(buf, len) == len;
   }
 
-  return ret == len;
+  char chunk_hdr[16];
+  int hdr_len = snprintf(chunk_hdr, sizeof(chunk_hdr), "%x\r\n", len);
+  struct iovec iov[3];
+  iov[0].iov_base = chunk_hdr;
+  iov[0].iov_len = hdr_len;
+  iov[1].iov_base = const_cast<char*>(buf);
+  iov[1].iov_len = len;
+  iov[2].iov_base = const_cast<char*>("\r\n");
+  iov[2].iov_len = 2;
+  return TcpConnection::write(iov, 3) == hdr_len + len + 2;
 } /* HttpServerConnection::write */
 
 
@@ -250,63 +316,62 @@ void HttpServerConnection::onDisconnected(DisconnectReason reason)
 
 int HttpServerConnection::onDataReceived(void *buf, int count)
 {
-  std::string data(reinterpret_cast<char*>(buf), count);
-  size_t data_pos = 0;
-
-  //std::cout << "### HttpServerConnection::onDataReceived: "
-  //         << data << std::endl;
+  const char* begin = reinterpret_cast<const char*>(buf);
+  const char* end = begin + count;
+  const char* pos = begin;
 
-  while (data.size() > data_pos)
+  while (pos < end)
   {
-    if (m_state == STATE_EXPECT_START_LINE)
+    if (m_state == STATE_EXPECT_HEADER)
     {
-      size_t eol = data.find("\r\n", data_pos);
-      size_t len = eol;
-      if (len != std::string::npos)
+        // Be liberal and ignore empty lines preceding a request line
+      while ((end - pos >= 2) && (pos[0] == '\r') && (pos[1] == '\n'))
       {
-        len -= data_pos;
+        pos += 2;
       }
-      m_row.append(data.substr(data_pos, len));
-      data_pos = eol;
-      if (eol != std::string::npos)
+      const char* hdr_end = findHeaderEnd(pos, end);
+      if (hdr_end == 0)
       {
-        data_pos += 2;
-        handleStartLine();
-        m_row.clear();
+        break;
       }
-    }
-    else if (m_state == STATE_EXPECT_HEADER)
-    {
-      size_t eol = data.find("\r\n", data_pos);
-      size_t len = eol;
-      if (len != std::string::npos)
+      unsigned err = parseRequest(pos, hdr_end);
+      if (err != 0)
       {
-        len -= data_pos;
+        std::cerr << "*** WARNING: Malformed HTTP request received from "
+                  << remoteHost() << ":" << remotePort() << std::endl;
+        sendError(err);
+        return count;
       }
-      m_row.append(data.substr(data_pos, len));
-      data_pos = eol;
-      if (eol != std::string::npos)
+      pos = hdr_end;
+      m_state = (m_payload_left > 0) ? STATE_EXPECT_PAYLOAD
+                                     : STATE_REQ_COMPLETE;
+    }
+    else if (m_state == STATE_EXPECT_PAYLOAD)
+    {
+        // Request bodies are not used by anything so they are just skipped
+      size_t len = std::min(m_payload_left, static_cast<size_t>(end - pos));
+      pos += len;
+      m_payload_left -= len;
+      if (m_payload_left == 0)
       {
-        data_pos += 2;
-        handleHeader();
-        m_row.clear();
+        m_state = STATE_REQ_COMPLETE;
       }
     }
     else
     {
-      data_pos = std::string::npos;
-      //m_req.content.append(data);
+        // Data received after a response that is ended by closing the
+        // connection, or when about to close, is discarded
+      return count;
     }
-  }
 
-  if (m_state == STATE_REQ_COMPLETE)
-  {
-    requestReceived(this, m_req);
-    m_req.clear();
-    m_state = STATE_EXPECT_START_LINE;
+    if (m_state == STATE_REQ_COMPLETE)
+    {
+      m_state = STATE_EXPECT_HEADER;
+      requestReceived(this, m_req);
+    }
   }
 
-  return count;
+  return pos - begin;
 } /* HttpServerConnection::onDataReceived */
 
 
@@ -316,80 +381,186 @@ int HttpServerConnection::onDataReceived(void *buf, int count)
  *
  ****************************************************************************/
 
-void HttpServerConnection::handleStartLine(void)
+const char* HttpServerConnection::findHeaderEnd(const char* begin,
+                                                const char* end)
 {
-  std::istringstream is(m_row);
-  std::string protocol;
-  if (!(is >> m_req.method >> m_req.target >> protocol >> std::ws))
+    // Only scan data that was not scanned on the previous calls. The
+    // terminating empty line can at the earliest end at the fourth byte.
+  const char* p = begin + std::max(m_hdr_scan_len, static_cast<size_t>(3));
+  while ((p < end) &&
+         ((p = static_cast<const char*>(std::memchr(p, '\n', end-p))) != 0))
   {
-    std::cerr << "*** ERROR: Could not parse HTTP header" << std::endl;
-    disconnect();
-    return;
+    if ((p[-1] == '\r') && (p[-2] == '\n') && (p[-3] == '\r'))
+    {
+      m_hdr_scan_len = 0;
+      return p + 1;
+    }
+    ++p;
   }
+  m_hdr_scan_len = end - begin;
+  return 0;
+} /* HttpServerConnection::findHeaderEnd */
 
-  if (protocol.substr(0, 5) != "HTTP/")
+
+unsigned HttpServerConnection::parseRequest(const char* begin,
+                                            const char* end)
+{
+  m_req.clear();
+  m_keep_alive = false;
+  m_payload_left = 0;
+
+    // The block is terminated by an empty line so a newline is always found
+  const char* line = begin;
+  const char* eol = static_cast<const char*>(std::memchr(line, '\n', end-line));
+  if ((eol == line) || (eol[-1] != '\r') || !parseStartLine(line, eol-1))
   {
-    std::cerr << "*** ERROR: Illegal protocol specification string \""
-              << protocol << "\"" << std::endl;
-    disconnect();
-    return;
+    return 400;
+  }
+  for (;;)
+  {
+    line = eol + 1;
+    eol = static_cast<const char*>(std::memchr(line, '\n', end-line));
+    if ((eol == 0) || (eol == line) || (eol[-1] != '\r'))
+    {
+      return 400;
+    }
+    if (eol - 1 == line)
+    {
+      break;
+    }
+    if (!parseHeaderLine(line, eol-1))
+    {
+      return 400;
+    }
   }
 
-  is.clear();
-  is.str(protocol.substr(5));
-  char dot;
-  if (!(is >> m_req.ver_major >> dot >> m_req.ver_minor >> std::ws) ||
-      (dot != '.'))
+  if (findHeader(m_req.headers, "Transfer-Encoding") != 0)
   {
-    std::cerr << "*** ERROR: Illegal protocol version specification \""
-              << protocol << "\"" << std::endl;
-    disconnect();
-    return;
+    return 501;
+  }
+
+  const std::string* len_hdr = findHeader(m_req.headers, "Content-Length");
+  if (len_hdr != 0)
+  {
+    const char* lenstr = len_hdr->c_str();
+    char* lenend = 0;
+    m_payload_left = strtoul(lenstr, &lenend, 10);
+    if (!isdigit(static_cast<unsigned char>(*lenstr)) || (*lenend != '\0'))
+    {
+      m_payload_left = 0;
+      return 400;
+    }
   }
 
-  //std::cout << "### HttpServerConnection::handleStartLine: method="
+  const std::string* con_hdr = findHeader(m_req.headers, "Connection");
+  if ((m_req.ver_major > 1) ||
+      ((m_req.ver_major == 1) && (m_req.ver_minor >= 1)))
+  {
+    m_keep_alive = (con_hdr == 0) || !hasToken(*con_hdr, "close");
+  }
+  else
+  {
+    m_keep_alive = (con_hdr != 0) && hasToken(*con_hdr, "keep-alive");
+  }
+
+  return 0;
+} /* HttpServerConnection::parseRequest */
+
+
+bool HttpServerConnection::parseStartLine(const char* begin, const char* end)
+{
+    // method SP request-target SP HTTP-version
+  const char* method_end =
+    static_cast<const char*>(std::memchr(begin, ' ', end-begin));
+  if ((method_end == 0) || (method_end == begin))
+  {
+    return false;
+  }
+  const char* target = method_end + 1;
+  const char* target_end =
+    static_cast<const char*>(std::memchr(target, ' ', end-target));
+  if ((target_end == 0) || (target_end == target))
+  {
+    return false;
+  }
+  const char* ver = target_end + 1;
+  if ((end - ver != 8) || (std::strncmp(ver, "HTTP/", 5) != 0) ||
+      !isdigit(static_cast<unsigned char>(ver[5])) || (ver[6] != '.') ||
+      !isdigit(static_cast<unsigned char>(ver[7])))
+  {
+    return false;
+  }
+
+  m_req.method.assign(begin, method_end);
+  m_req.target.assign(target, target_end);
+  m_req.ver_major = ver[5] - '0';
+  m_req.ver_minor = ver[7] - '0';
+
+  //std::cout << "### HttpServerConnection::parseStartLine: method="
   //          << m_req.method << " target=" << m_req.target
   //          << " version=" << m_req.ver_major << "."
   //          << m_req.ver_minor
   //          << std::endl;
-  m_state = STATE_EXPECT_HEADER;
-} /* HttpServerConnection::handleStartLine */
+  return true;
+} /* HttpServerConnection::parseStartLine */
 
 
-void HttpServerConnection::handleHeader(void)
+bool HttpServerConnection::parseHeaderLine(const char* begin,
+                                           const char* end)
 {
-  //std::cout << "### HttpServerConnection::handleHeader: m_row="
-  //          << m_row << std::endl;
-
-  if (m_row.empty())
+    // Obsolete line folding is not supported
+  if ((*begin == ' ') || (*begin == '\t'))
   {
-    m_state = STATE_REQ_COMPLETE;
-    return;
+    return false;
   }
-
-  size_t colon = m_row.find(":");
-  if (colon == std::string::npos)
+  const char* colon =
+    static_cast<const char*>(std::memchr(begin, ':', end-begin));
+  if ((colon == 0) || (colon == begin))
   {
-    std::cerr << "*** ERROR: Malformed HTTP header received" << std::endl;
-    disconnect();
-    return;
+    return false;
   }
-  std::string key(m_row.substr(0, colon));
-  size_t value_begin = m_row.find_first_not_of(" \t", colon+1);
-  size_t value_end = m_row.find_last_not_of(" \t");
-  if (value_begin == std::string::npos)
+  const char* value_begin = colon + 1;
+  while ((value_begin < end) && ((*value_begin == ' ') ||
+                                 (*value_begin == '\t')))
   {
-    std::cerr << "*** ERROR: Malformed HTTP header value received" << std::endl;
-    disconnect();
-    return;
+    ++value_begin;
+  }
+  const char* value_end = end;
+  while ((value_end > value_begin) && ((value_end[-1] == ' ') ||
+                                       (value_end[-1] == '\t')))
+  {
+    --value_end;
   }
-  std::string value(m_row.substr(value_begin, value_end-value_begin+1));
 
-  //std::cout << "### HttpServerConnection::handleStartLine: key="
-  //          << key << " value=" << value << std::endl;
+  //std::cout << "### HttpServerConnection::parseHeaderLine: key="
+  //          << std::string(begin, colon) << " value="
+  //          << std::string(value_begin, value_end) << std::endl;
+
+  m_req.headers[std::string(begin, colon)].assign(value_begin, value_end);
+  return true;
+} /* HttpServerConnection::parseHeaderLine */
+
+
+void HttpServerConnection::sendError(unsigned code)
+{
+  m_keep_alive = false;
+  m_chunked = false;
+  Response res;
+  res.setCode(code);
+  res.setContent("text/plain", codeToString(code));
+  write(res);
+} /* HttpServerConnection::sendError */
+
 
-  m_req.headers[key] = value;
-} /* HttpServerConnection::handleHeader */
+void HttpServerConnection::closeConnection(void)
+{
+  if ((m_state != STATE_CLOSING) || !isConnected())
+  {
+    return;
+  }
+  disconnect();
+  onDisconnected(DR_ORDERED_DISCONNECT);
+} /* HttpServerConnection::closeConnection */
 
 
 void HttpServerConnection::onSendBufferFull(bool is_full)
@@ -424,6 +595,8 @@ void HttpServerConnection::disconnectCleanup(void)
 {
   //std::cout << "### HttpServerConnection::disconnectCleanup" << std::endl;
   m_state = STATE_DISCONNECTED;
+  m_hdr_scan_len = 0;
+  m_payload_left = 0;
   //for (TxQueue::iterator it = m_txq.begin(); it != m_txq.end(); ++it)
   //{
   //  delete *it;
@@ -438,18 +611,73 @@ const char* HttpServerConnection::codeToString(unsigned code)
   {
     case 200:
       return "OK";
+    case 204:
+      return "No Content";
+    case 304:
+      return "Not Modified";
+    case 400:
+      return "Bad Request";
     case 404:
       return "Not Found";
     case 406:
       return "Not Acceptable";
     case 501:
       return "Not Implemented";
+    case 503:
+      return "Service Unavailable";
     default:
       return "?";
   }
 } /* HttpServerConnection::codeToString */
 
 
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+static const std::string* findHeader(const HttpServerConnection::Headers& hdrs,
+                                     const char* name)
+{
+    // Header field names are case insensitive
+  for (HttpServerConnection::Headers::const_iterator it=hdrs.begin();
+       it!=hdrs.end(); ++it)
+  {
+    if (strcasecmp((*it).first.c_str(), name) == 0)
+    {
+      return &(*it).second;
+    }
+  }
+  return 0;
+} /* findHeader */
+
+
+static bool hasToken(const std::string& value, const char* token)
+{
+  size_t token_len = std::strlen(token);
+  size_t pos = 0;
+  while (pos < value.size())
+  {
+    size_t end = value.find(',', pos);
+    if (end == std::string::npos)
+    {
+      end = value.size();
+    }
+    size_t begin = value.find_first_not_of(" \t", pos);
+    size_t last = value.find_last_not_of(" \t", end-1);
+    if ((begin < end) && (last != std::string::npos) && (last >= begin) &&
+        (last - begin + 1 == token_len) &&
+        (strncasecmp(value.c_str()+begin, token, token_len) == 0))
+    {
+      return true;
+    }
+    pos = end + 1;
+  }
+  return false;
+} /* hasToken */
+
+
 /*
  * This file has not been truncated
  */
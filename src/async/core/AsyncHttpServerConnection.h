@@ -120,6 +120,17 @@ namespace Async
 This class implement a VERY simple HTTP server side connection. It can be used
 together with the Async::TcpServer class to build a HTTP server.
 
+Connections are persistent by default for HTTP/1.1 clients and for HTTP/1.0
+clients sending "Connection: keep-alive". Pipelined requests are handled in
+order, one requestReceived signal per request. The request header is parsed in
+place in the receive buffer so a request is only emitted when its whole header
+block has been received. A request body, if any, is skipped. When the client
+asked for the connection to be closed, a "Connection: close" header is added
+to the response and the connection is closed after the response has been
+written. A response without a Content-length that is not chunked is ended by
+closing the connection, which the user of the connection then is responsible
+for.
+
 WARNING: This implementation is not suitable to be exposed to the public
 Internet. It contains a number of security flaws and probably also
 incompatibilities. Only use this class with known clients.
@@ -156,7 +167,8 @@ class HttpServerConnection : public TcpConnection
     class Response
     {
       public:
-        Response(void) : m_code(0), m_send_content(false) {}
+        Response(void) : m_code(0), m_shared_content(0), m_send_content(false)
+        {}
 
         unsigned code(void) const { return m_code; }
         void setCode(unsigned code) { m_code = code; }
@@ -170,15 +182,39 @@ class HttpServerConnection : public TcpConnection
           m_headers[key] = os.str();
         }
 
-        const std::string& content(void) const { return m_content; }
+        const std::string& content(void) const
+        {
+          return (m_shared_content != 0) ? *m_shared_content : m_content;
+        }
         void setContent(const std::string& content_type,
                         const std::string& content)
         {
           m_content = content;
+          m_shared_content = 0;
           setHeader("Content-type", content_type);
           setHeader("Content-length", m_content.size());
           setSendContent(true);
         }
+
+        /**
+         * @brief   Set a content body that is owned by the caller
+         * @param   content_type  The media type of the content
+         * @param   content       The content body
+         *
+         * Use this function instead of setContent for a body that is built
+         * once and sent many times, like a cached status document. The
+         * content is not copied so the string must remain unchanged until
+         * the response has been written.
+         */
+        void setSharedContent(const std::string& content_type,
+                              const std::string& content)
+        {
+          m_content.clear();
+          m_shared_content = &content;
+          setHeader("Content-type", content_type);
+          setHeader("Content-length", content.size());
+          setSendContent(true);
+        }
         bool sendContent(void) const { return m_send_content; }
         void setSendContent(bool send_content)
         {
@@ -190,13 +226,15 @@ class HttpServerConnection : public TcpConnection
           m_code = 0;
           m_headers.clear();
           m_content.clear();
+          m_shared_content = 0;
         }
 
       private:
-        unsigned    m_code;
-        Headers     m_headers;
-        std::string m_content;
-        bool        m_send_content;
+        unsigned            m_code;
+        Headers             m_headers;
+        std::string         m_content;
+        const std::string*  m_shared_content;
+        bool                m_send_content;
     };
 
     /**
@@ -243,6 +281,9 @@ class HttpServerConnection : public TcpConnection
      * @brief   Send a HTTP response
      * @param   res The response (@see Response)
      * @return  Return \em true on success or else \em false
+     *
+     * The header block and the content are sent using one gathering write
+     * so the content is never copied.
      */
     virtual bool write(const Response& res);
 
@@ -302,9 +343,11 @@ class HttpServerConnection : public TcpConnection
     virtual int onDataReceived(void *buf, int count);
 
   private:
+    static const size_t MAX_HEADER_LEN = 16384;
+
     enum State {
-      STATE_DISCONNECTED, STATE_EXPECT_START_LINE, STATE_EXPECT_HEADER,
-      STATE_EXPECT_PAYLOAD, STATE_REQ_COMPLETE
+      STATE_DISCONNECTED, STATE_EXPECT_HEADER, STATE_EXPECT_PAYLOAD,
+      STATE_REQ_COMPLETE, STATE_RESPONSE_STREAM, STATE_CLOSING
     };
     //struct QueueItem
     //{
@@ -329,14 +372,21 @@ class HttpServerConnection : public TcpConnection
 
     //TxQueue               m_txq;
     State                   m_state;
-    std::string             m_row;
     Request                 m_req;
     bool                    m_chunked;
+    bool                    m_keep_alive;
+    size_t                  m_hdr_scan_len;
+    size_t                  m_payload_left;
+    std::string             m_tx_hdr;
 
     HttpServerConnection(const HttpServerConnection&);
     HttpServerConnection& operator=(const HttpServerConnection&);
-    void handleStartLine(void);
-    void handleHeader(void);
+    const char* findHeaderEnd(const char* begin, const char* end);
+    unsigned parseRequest(const char* begin, const char* end);
+    bool parseStartLine(const char* begin, const char* end);
+    bool parseHeaderLine(const char* begin, const char* end);
+    void sendError(unsigned code);
+    void closeConnection(void);
     void onSendBufferFull(bool is_full);
     void disconnectCleanup(void);
     const char* codeToString(unsigned code);
@@ -41,7 +41,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
-#include <cmath>
+#include <cstring>
+#include <cstdlib>
 #include <algorithm>
 
 
@@ -136,7 +137,7 @@ using namespace Async;
  */
 IpAddress::IpAddress(void)
 {
-  m_addr.s_addr = INADDR_NONE;
+  clear();
 } /* IpAddress::IpAddress */
 
 
@@ -147,18 +148,46 @@ IpAddress::IpAddress(const string& addr)
 
 
 IpAddress::IpAddress(const Ip4Addr& addr)
-  : m_addr(addr)
+  : m_family(AF_INET)
 {
-  
+  m_addr.v4 = addr;
+} /* IpAddress::IpAddress */
+
+
+IpAddress::IpAddress(const Ip6Addr& addr)
+{
+  setIp6(addr);
 } /* IpAddress::IpAddress */
 
 
+IpAddress::Ip6Addr IpAddress::ip6Addr(void) const
+{
+  if (isIp6())
+  {
+    return m_addr.v6;
+  }
+
+  Ip6Addr addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.s6_addr[10] = 0xff;
+  addr.s6_addr[11] = 0xff;
+  memcpy(&addr.s6_addr[12], &m_addr.v4.s_addr, sizeof(m_addr.v4.s_addr));
+  return addr;
+} /* IpAddress::ip6Addr */
+
+
 bool IpAddress::isUnicast(void) const
 {
+  if (isIp6())
+  {
+    return !IN6_IS_ADDR_MULTICAST(&m_addr.v6) &&
+           !IN6_IS_ADDR_UNSPECIFIED(&m_addr.v6);
+  }
+
   bool is_unicast;
-  is_unicast  = (ntohl(m_addr.s_addr) & 0x80000000) == 0x00000000;
-  is_unicast |= (ntohl(m_addr.s_addr) & 0xc0000000) == 0x80000000;
-  is_unicast |= (ntohl(m_addr.s_addr) & 0xe0000000) == 0xc0000000;
+  is_unicast  = (ntohl(m_addr.v4.s_addr) & 0x80000000) == 0x00000000;
+  is_unicast |= (ntohl(m_addr.v4.s_addr) & 0xc0000000) == 0x80000000;
+  is_unicast |= (ntohl(m_addr.v4.s_addr) & 0xe0000000) == 0xc0000000;
   
   return is_unicast;
   
@@ -174,9 +203,9 @@ bool IpAddress::isWithinSubet(const std::string& subnet) const
     return false;
   }
   
-  string ip_str(subnet.begin(), slash);
-  Ip4Addr ip;
-  if (inet_aton(ip_str.c_str(), &ip) == 0)  // Address is invalid
+  IpAddress net;
+  if (!net.setIpFromString(string(subnet.begin(), slash)) ||
+      (net.m_family != m_family))
   {
     return false;
   }
@@ -186,27 +215,68 @@ bool IpAddress::isWithinSubet(const std::string& subnet) const
     return false;
   }
   string mask_str(slash, subnet.end());
-  uint32_t mask = 0xffffffff ^ ((uint32_t)pow(2.0, 32-atoi(mask_str.c_str())) - 1);
+  int bits = atoi(mask_str.c_str());
 
-  return (ntohl(m_addr.s_addr) & mask) == (ntohl(ip.s_addr) & mask);
+  if (isIp4())
+  {
+    bits = max(0, min(bits, 32));
+    uint32_t mask = (bits == 0) ? 0 : (0xffffffff << (32 - bits));
+    return (ntohl(m_addr.v4.s_addr) & mask) ==
+           (ntohl(net.m_addr.v4.s_addr) & mask);
+  }
+
+  bits = max(0, min(bits, 128));
+  const uint8_t *a = m_addr.v6.s6_addr;
+  const uint8_t *b = net.m_addr.v6.s6_addr;
+  int bytes = bits / 8;
+  if (memcmp(a, b, bytes) != 0)
+  {
+    return false;
+  }
+  if ((bits % 8) != 0)
+  {
+    uint8_t mask = 0xff << (8 - (bits % 8));
+    return (a[bytes] & mask) == (b[bytes] & mask);
+  }
+  return true;
  
 } /* IpAddress::isWithinSubet */
 
 
 string IpAddress::toString(void) const
 {
-  return inet_ntoa(m_addr);
+  char buf[INET6_ADDRSTRLEN];
+  if (inet_ntop(m_family, &m_addr, buf, sizeof(buf)) == 0)
+  {
+    return "";
+  }
+  return buf;
 } /* IpAddress::toString */
 
 
 bool IpAddress::setIpFromString(const string &str)
 {
-  if (inet_aton(str.c_str(), &m_addr) == 0)  // Address is invalid
+  m_family = AF_INET;
+  if (inet_aton(str.c_str(), &m_addr.v4) != 0)
   {
-    m_addr.s_addr = INADDR_NONE;
-    return false;
+    return true;
   }
-  return true;
+
+  string ip6_str(str);
+  if ((ip6_str.size() > 2) && (ip6_str[0] == '[') &&
+      (ip6_str[ip6_str.size()-1] == ']'))
+  {
+    ip6_str = ip6_str.substr(1, ip6_str.size()-2);
+  }
+  Ip6Addr addr;
+  if (inet_pton(AF_INET6, ip6_str.c_str(), &addr) == 1)
+  {
+    setIp6(addr);
+    return true;
+  }
+
+  clear();  // Address is invalid
+  return false;
 } /* IpAddress::setIpFromString */
 
 
@@ -271,6 +341,19 @@ std::istream& Async::operator>>(std::istream& is, Async::IpAddress& ip)
  * Bugs:      
  *----------------------------------------------------------------------------
  */
+void IpAddress::setIp6(const Ip6Addr& addr)
+{
+  if (IN6_IS_ADDR_V4MAPPED(&addr))
+  {
+    m_family = AF_INET;
+    memcpy(&m_addr.v4.s_addr, &addr.s6_addr[12], sizeof(m_addr.v4.s_addr));
+  }
+  else
+  {
+    m_family = AF_INET6;
+    m_addr.v6 = addr;
+  }
+} /* IpAddress::setIp6 */
 
 
 
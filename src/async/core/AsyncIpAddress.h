@@ -5,7 +5,7 @@
 @date	 2003-04-12
 
 Contains a class for representing an IP address in an OS independent way.
-Rigt now it can only handle IPv4 addresses.
+Both IPv4 and IPv6 addresses can be represented.
 
 \verbatim
 Async - A library for programming event driven applications
@@ -37,10 +37,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <sys/socket.h>
 #include <netinet/in.h>
 
 #include <string>
 #include <iostream>
+#include <cstring>
+#include <functional>
+#include <stdint.h>
 
 
 /****************************************************************************
@@ -100,6 +104,13 @@ namespace Async
 
 /**
  * @brief A class for representing an IP address in an OS independent way.
+ *
+ * An address is either an IPv4 or an IPv6 address. IPv4-mapped IPv6
+ * addresses (::ffff:a.b.c.d) are stored as IPv4 addresses so that an address
+ * received on a dual stack socket compares equal to the same IPv4 address.
+ *
+ * Comparison and hashing are cheap so IpAddress objects can be used as keys
+ * in both ordered maps and hash tables (std::unordered_map).
  */
 class IpAddress
 {
@@ -108,6 +119,11 @@ class IpAddress
      * @brief The type for the OS specific representation of an IP address
      */
     typedef struct in_addr Ip4Addr;
+
+    /**
+     * @brief The type for the OS specific representation of an IPv6 address
+     */
+    typedef struct in6_addr Ip6Addr;
     
     /**
      * @brief Default constructor for the IpAddress class.
@@ -125,6 +141,14 @@ class IpAddress
      * @param addr The IP address in OS specific representation
      */
     IpAddress(const Ip4Addr& addr);
+
+    /**
+     * @brief Constructor for the IpAddress class.
+     * @param addr The IPv6 address in OS specific representation
+     *
+     * An IPv4-mapped address will be stored as an IPv4 address.
+     */
+    IpAddress(const Ip6Addr& addr);
     
     /**
      * @brief Copy contructor
@@ -140,8 +164,46 @@ class IpAddress
     /**
      * @brief Return the IP address in OS specific representation
      * @return The IP address
+     *
+     * An IPv6 address cannot be represented as an IPv4 address so
+     * INADDR_NONE is returned in that case.
+     */
+    Ip4Addr ip4Addr(void) const
+    {
+      if (isIp6())
+      {
+        Ip4Addr none;
+        none.s_addr = INADDR_NONE;
+        return none;
+      }
+      return m_addr.v4;
+    }
+
+    /**
+     * @brief Return the IPv6 address in OS specific representation
+     * @return The IP address
+     *
+     * An IPv4 address is returned as an IPv4-mapped IPv6 address.
+     */
+    Ip6Addr ip6Addr(void) const;
+
+    /**
+     * @brief   Check if this is an IPv4 address
+     * @return  Return \em true if this is an IPv4 address
+     */
+    bool isIp4(void) const { return m_family == AF_INET; }
+
+    /**
+     * @brief   Check if this is an IPv6 address
+     * @return  Return \em true if this is an IPv6 address
      */
-    Ip4Addr ip4Addr(void) const { return m_addr; }
+    bool isIp6(void) const { return m_family == AF_INET6; }
+
+    /**
+     * @brief   Return the address family
+     * @return  Returns AF_INET or AF_INET6
+     */
+    int family(void) const { return m_family; }
     
     /**
      * @brief 	Check if this is a unicast IP address
@@ -153,7 +215,8 @@ class IpAddress
     /**
      * @brief 	Check if the IP address is within the given netmask
      * @param 	subnet	The subnet to use in the check. The subnet should
-     *	      	      	be given on the form a.b.c.d/m (e.g. 192.168.1.0/24).
+     *	      	      	be given on the form a.b.c.d/m (e.g. 192.168.1.0/24)
+     *	      	      	or, for IPv6, on the form x:x::x/m (e.g. fd00::/8).
      * @return	Return \em true if within the given subnet or \em false
      *	      	if it is not.
      */
@@ -164,12 +227,19 @@ class IpAddress
      * @return	Return \em true if this is an invalid address or \em false
      *		if a valid address has been assigned.
      */
-    bool isEmpty(void) const { return (m_addr.s_addr == INADDR_NONE); }
+    bool isEmpty(void) const
+    {
+      return isIp4() && (m_addr.v4.s_addr == INADDR_NONE);
+    }
 
     /**
      * @brief	Invalidate the IP address value
      */    
-    void clear(void) { m_addr.s_addr = INADDR_NONE; }
+    void clear(void)
+    {
+      m_family = AF_INET;
+      m_addr.v4.s_addr = INADDR_NONE;
+    }
     
     /**
      * @brief 	Return the string representation of the IP address.
@@ -179,11 +249,43 @@ class IpAddress
     
     /**
      * @brief   Set the IP address from a string
-     * @param   str The string to parse (e.g. "192.168.0.1")
+     * @param   str The string to parse (e.g. "192.168.0.1" or "fd00::1")
      * @return  Returns \em true on success or else \em false
+     *
+     * An IPv6 address may be enclosed in brackets (e.g. "[fd00::1]").
      */
     bool setIpFromString(const std::string &str);
 
+    /**
+     * @brief   Calculate a hash value for the address
+     * @return  Returns a hash value suitable for hash tables
+     *
+     * The bits of the address are mixed so that all bits of the hash value
+     * depend on the whole address. It is therefore safe to just mask out the
+     * low bits when using a power of two sized table.
+     */
+    size_t hash(void) const
+    {
+      uint64_t h;
+      if (isIp4())
+      {
+        h = m_addr.v4.s_addr;
+      }
+      else
+      {
+        uint64_t w[2];
+        std::memcpy(w, &m_addr.v6, sizeof(w));
+        h = w[0] ^ (w[1] * 0x9e3779b97f4a7c15ULL) ^ 0x6a09e667f3bcc909ULL;
+      }
+        // The 64 bit finalizer from MurmurHash3
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 33;
+      h *= 0xc4ceb3fe1a85ec53ULL;
+      h ^= h >> 33;
+      return static_cast<size_t>(h);
+    }
+
     /**
      * @brief 	Assignment operator.
      * @param 	rhs The address object to assign to this object
@@ -191,6 +293,7 @@ class IpAddress
      */
     IpAddress& operator=(const IpAddress& rhs)
     {
+      m_family = rhs.m_family;
       m_addr = rhs.m_addr;
       return *this;
     }
@@ -203,7 +306,15 @@ class IpAddress
      */
     bool operator==(const IpAddress& rhs) const
     {
-      return m_addr.s_addr == rhs.m_addr.s_addr;
+      if (m_family != rhs.m_family)
+      {
+        return false;
+      }
+      if (isIp4())
+      {
+        return m_addr.v4.s_addr == rhs.m_addr.v4.s_addr;
+      }
+      return std::memcmp(&m_addr.v6, &rhs.m_addr.v6, sizeof(Ip6Addr)) == 0;
     }
     
     /**
@@ -222,10 +333,20 @@ class IpAddress
      * @param 	rhs Right hand side expression
      * @return  Returns \em true if the right hand side object is
      *          less than this object, or else returns \em false.
+     *
+     * All IPv4 addresses are ordered before all IPv6 addresses.
      */
     bool operator<(const IpAddress& rhs) const
     {
-      return m_addr.s_addr < rhs.m_addr.s_addr;
+      if (m_family != rhs.m_family)
+      {
+        return isIp4();
+      }
+      if (isIp4())
+      {
+        return m_addr.v4.s_addr < rhs.m_addr.v4.s_addr;
+      }
+      return std::memcmp(&m_addr.v6, &rhs.m_addr.v6, sizeof(Ip6Addr)) < 0;
     }
     
     /**
@@ -247,7 +368,16 @@ class IpAddress
   protected:
     
   private:
-    Ip4Addr m_addr;
+    union Addr
+    {
+      Ip4Addr v4;
+      Ip6Addr v6;
+    };
+
+    int   m_family;
+    Addr  m_addr;
+
+    void setIp6(const Ip6Addr& addr);
   
 };  /* class IpAddress */
 
@@ -259,6 +389,22 @@ std::istream& operator>>(std::istream& is, IpAddress& ip);
 } /* namespace */
 
 
+namespace std
+{
+  /**
+   * @brief Hash function object making IpAddress usable in unordered containers
+   */
+  template <>
+  struct hash<Async::IpAddress>
+  {
+    size_t operator()(const Async::IpAddress& addr) const
+    {
+      return addr.hash();
+    }
+  };
+} /* namespace std */
+
+
 #endif /* ASYNC_IP_ADDRESS_INCLUDED */
 
 
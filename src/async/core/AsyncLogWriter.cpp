@@ -0,0 +1,584 @@
+/**
+@file   AsyncLogWriter.cpp
+@brief  Write the stdout log to a file from background threads
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+
+#include <cstring>
+#include <cstdio>
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncThreadScheduling.h"
+#include "AsyncLogWriter.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+LogWriter::LogWriter(size_t buffer_size)
+  : m_logfd(-1), m_pipefd(-1), m_wake_rd(-1), m_wake_wr(-1), m_buf(0),
+    m_mask(0), m_head(0), m_tail(0), m_stop(false), m_reader_done(false),
+    m_reader_busy(false), m_writer_busy(false), m_dropped_total(0),
+    m_dropped(0), m_at_line_start(true), m_dropping(false),
+    m_truncated(false), m_reopen_pending(false), m_running(false)
+{
+    // The ring buffer is a power of two in size so that the free running
+    // head and tail counters can be masked into buffer positions
+  size_t capacity = 1;
+  while (capacity < buffer_size)
+  {
+    capacity <<= 1;
+  }
+  m_buf = new char[capacity];
+  m_mask = capacity - 1;
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_cond, NULL);
+} /* LogWriter::LogWriter */
+
+
+LogWriter::~LogWriter(void)
+{
+  stop();
+  if (m_logfd != -1)
+  {
+    close(m_logfd);
+  }
+  delete [] m_buf;
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutex);
+} /* LogWriter::~LogWriter */
+
+
+bool LogWriter::open(const std::string& path)
+{
+  assert(!m_running);
+  if (m_logfd != -1)
+  {
+    close(m_logfd);
+  }
+  m_path = path;
+  m_logfd = ::open(m_path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 00644);
+  if (m_logfd == -1)
+  {
+    cerr << "open(\"" << m_path << "\"): " << strerror(errno) << endl;
+    return false;
+  }
+  return true;
+} /* LogWriter::open */
+
+
+void LogWriter::setTimestampFormat(const std::string& fmt)
+{
+  pthread_mutex_lock(&m_mutex);
+  m_tstamp_format = fmt;
+  pthread_mutex_unlock(&m_mutex);
+} /* LogWriter::setTimestampFormat */
+
+
+bool LogWriter::start(int fd)
+{
+  assert(!m_running);
+  int wakefd[2];
+  if (pipe(wakefd) != 0)
+  {
+    cerr << "*** ERROR: Could not create pipe: " << strerror(errno) << endl;
+    return false;
+  }
+  m_wake_rd = wakefd[0];
+  m_wake_wr = wakefd[1];
+  m_pipefd = fd;
+  m_stop = false;
+  m_reader_done = false;
+
+  int ret = pthread_create(&m_writer, NULL, writerFunc, this);
+  if (ret != 0)
+  {
+    cerr << "*** ERROR: Could not start the log writer thread: "
+         << strerror(ret) << endl;
+    return false;
+  }
+  ret = pthread_create(&m_reader, NULL, readerFunc, this);
+  if (ret != 0)
+  {
+    cerr << "*** ERROR: Could not start the log reader thread: "
+         << strerror(ret) << endl;
+    m_reader_done = true;
+    wakeWriter();
+    pthread_join(m_writer, NULL);
+    return false;
+  }
+  m_running = true;
+  return true;
+} /* LogWriter::start */
+
+
+void LogWriter::reopen(const std::string& reason)
+{
+  pthread_mutex_lock(&m_mutex);
+  m_reopen_pending = true;
+  m_reopen_reason = reason;
+  pthread_cond_broadcast(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+} /* LogWriter::reopen */
+
+
+void LogWriter::flush(void)
+{
+  if (!m_running)
+  {
+    return;
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  deadline.tv_sec += 1;
+
+  pthread_mutex_lock(&m_mutex);
+  for (;;)
+  {
+    int unread = 0;
+    if (ioctl(m_pipefd, FIONREAD, &unread) != 0)
+    {
+      unread = 0;
+    }
+    if ((unread == 0) && !m_reader_busy && !m_writer_busy &&
+        (m_head.load() == m_tail.load()))
+    {
+      break;
+    }
+      // The reader does not signal the condition so wait in short steps
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 10000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+      ts.tv_sec += 1;
+      ts.tv_nsec -= 1000000000;
+    }
+    if ((ts.tv_sec > deadline.tv_sec) ||
+        ((ts.tv_sec == deadline.tv_sec) && (ts.tv_nsec > deadline.tv_nsec)))
+    {
+      break;
+    }
+    pthread_cond_timedwait(&m_cond, &m_mutex, &ts);
+  }
+  pthread_mutex_unlock(&m_mutex);
+} /* LogWriter::flush */
+
+
+void LogWriter::stop(void)
+{
+  if (!m_running)
+  {
+    return;
+  }
+  m_stop = true;
+  ssize_t ret = write(m_wake_wr, "S", 1);
+  (void)ret;
+  pthread_join(m_reader, NULL);
+  pthread_join(m_writer, NULL);
+  close(m_wake_rd);
+  close(m_wake_wr);
+  m_wake_rd = m_wake_wr = -1;
+  m_running = false;
+} /* LogWriter::stop */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void *LogWriter::readerFunc(void *arg)
+{
+  ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_FILE_IO);
+  reinterpret_cast<LogWriter*>(arg)->readerRun();
+  return NULL;
+} /* LogWriter::readerFunc */
+
+
+void *LogWriter::writerFunc(void *arg)
+{
+  ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_FILE_IO);
+  reinterpret_cast<LogWriter*>(arg)->writerRun();
+  return NULL;
+} /* LogWriter::writerFunc */
+
+
+void LogWriter::readerRun(void)
+{
+  struct pollfd fds[2];
+  fds[0].fd = m_pipefd;
+  fds[0].events = POLLIN;
+  fds[1].fd = m_wake_rd;
+  fds[1].events = POLLIN;
+  for (;;)
+  {
+    fds[0].revents = fds[1].revents = 0;
+    if ((poll(fds, 2, -1) == -1) && (errno != EINTR))
+    {
+      cerr << "*** ERROR: poll failed in log reader: " << strerror(errno)
+           << endl;
+      break;
+    }
+
+      // The pipe is drained also when stopping, so that the last lines
+      // written before stop was called end up in the log
+    bool stopping = m_stop;
+    if ((fds[0].revents != 0) || stopping)
+    {
+      m_reader_busy = true;
+      char buf[4096];
+      ssize_t len;
+      while ((len = read(m_pipefd, buf, sizeof(buf))) > 0)
+      {
+        handleInput(buf, len);
+      }
+      m_reader_busy = false;
+      wakeWriter();
+      if ((len == 0) || ((len == -1) && (errno != EAGAIN) &&
+                         (errno != EINTR)))
+      {
+          // All writers have closed the pipe or it is broken
+        fds[0].fd = -1;
+      }
+    }
+    if (stopping)
+    {
+      break;
+    }
+  }
+  m_reader_done = true;
+  wakeWriter();
+} /* LogWriter::readerRun */
+
+
+void LogWriter::writerRun(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  for (;;)
+  {
+    while ((m_head.load() == m_tail.load()) && !m_reopen_pending &&
+           !m_reader_done)
+    {
+      pthread_cond_wait(&m_cond, &m_mutex);
+    }
+
+    size_t tail = m_tail.load(memory_order_relaxed);
+    size_t head = m_head.load(memory_order_acquire);
+    if (m_reopen_pending)
+    {
+        // Write complete lines to the old file first so that the reopen
+        // messages do not end up in the middle of a line
+      size_t end = head;
+      while ((end != tail) && (m_buf[(end - 1) & m_mask] != '\n'))
+      {
+        --end;
+      }
+      if (end == tail)
+      {
+        m_reopen_pending = false;
+        string reason(m_reopen_reason);
+        pthread_mutex_unlock(&m_mutex);
+        writeLine(reason + ". Reopening logfile\n");
+        close(m_logfd);
+        m_logfd = ::open(m_path.c_str(), O_WRONLY | O_APPEND | O_CREAT,
+                         00644);
+        writeLine(reason + ". Logfile reopened\n");
+        pthread_mutex_lock(&m_mutex);
+        continue;
+      }
+      head = end;
+    }
+
+    if (head == tail)
+    {
+      break;
+    }
+    m_writer_busy = true;
+    pthread_mutex_unlock(&m_mutex);
+
+      // Write everything that is in the buffer, at most two write calls
+      // since the data may wrap around the end of the buffer
+    bool write_error = false;
+    while ((tail != head) && !write_error)
+    {
+      size_t pos = tail & m_mask;
+      size_t len = min(head - tail, m_mask + 1 - pos);
+      ssize_t ret = write(m_logfd, m_buf + pos, len);
+      if ((ret == -1) && (errno == EINTR))
+      {
+        continue;
+      }
+      if (ret <= 0)
+      {
+        write_error = true;
+        break;
+      }
+      tail += ret;
+    }
+      // On a write error the unwritten data is thrown away
+    m_tail.store(head, memory_order_release);
+
+    pthread_mutex_lock(&m_mutex);
+    m_writer_busy = false;
+    if (write_error)
+    {
+      m_reopen_pending = true;
+      m_reopen_reason = "Write error";
+    }
+    pthread_cond_broadcast(&m_cond);
+  }
+  pthread_mutex_unlock(&m_mutex);
+} /* LogWriter::writerRun */
+
+
+void LogWriter::handleInput(const char *data, size_t len)
+{
+  char tstamp[256];
+  while (len > 0)
+  {
+    const char *nl = static_cast<const char*>(memchr(data, '\n', len));
+    size_t seg_len = (nl != 0) ? static_cast<size_t>(nl - data + 1) : len;
+
+    if (m_at_line_start)
+    {
+      size_t tlen = formatTimestamp(tstamp, sizeof(tstamp));
+      if (m_dropped > 0)
+      {
+        ostringstream ss;
+        if (m_truncated)
+        {
+          ss << "\n";
+        }
+        ss.write(tstamp, tlen);
+        ss << "*** WARNING: " << m_dropped << " log line(s) dropped since "
+              "the logfile could not be written fast enough\n";
+        if (put(ss.str().data(), ss.str().size()))
+        {
+          m_dropped = 0;
+          m_truncated = false;
+        }
+      }
+
+      size_t head = m_head.load(memory_order_relaxed);
+      size_t tail = m_tail.load(memory_order_acquire);
+      size_t space = m_mask + 1 - (head - tail);
+      m_dropping = (m_dropped > 0) || (tlen + seg_len > space);
+      if (m_dropping)
+      {
+        ++m_dropped;
+        ++m_dropped_total;
+      }
+      else
+      {
+        put(tstamp, tlen);
+        put(data, seg_len);
+      }
+    }
+    else if (!m_dropping && !put(data, seg_len))
+    {
+        // The start of the line has been written but the rest is dropped
+      m_dropping = true;
+      m_truncated = true;
+      ++m_dropped;
+      ++m_dropped_total;
+    }
+
+    m_at_line_start = (nl != 0);
+    data += seg_len;
+    len -= seg_len;
+  }
+} /* LogWriter::handleInput */
+
+
+bool LogWriter::put(const char *data, size_t len)
+{
+  size_t head = m_head.load(memory_order_relaxed);
+  size_t tail = m_tail.load(memory_order_acquire);
+  if (m_mask + 1 - (head - tail) < len)
+  {
+    return false;
+  }
+  size_t pos = head & m_mask;
+  size_t first = min(len, m_mask + 1 - pos);
+  memcpy(m_buf + pos, data, first);
+  memcpy(m_buf, data + first, len - first);
+  m_head.store(head + len, memory_order_release);
+  return true;
+} /* LogWriter::put */
+
+
+size_t LogWriter::formatTimestamp(char *buf, size_t size)
+{
+  pthread_mutex_lock(&m_mutex);
+  string fmt(m_tstamp_format);
+  pthread_mutex_unlock(&m_mutex);
+  if (fmt.empty())
+  {
+    return 0;
+  }
+
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  const string frac_code("%f");
+  size_t pos = fmt.find(frac_code);
+  if (pos != string::npos)
+  {
+    stringstream ss;
+    ss << setfill('0') << setw(3) << (tv.tv_usec / 1000);
+    fmt.replace(pos, frac_code.length(), ss.str());
+  }
+  struct tm tm;
+  localtime_r(&tv.tv_sec, &tm);
+  size_t tlen = strftime(buf, size - 2, fmt.c_str(), &tm);
+  buf[tlen++] = ':';
+  buf[tlen++] = ' ';
+  return tlen;
+} /* LogWriter::formatTimestamp */
+
+
+void LogWriter::writeLine(const std::string& line)
+{
+  if (m_logfd == -1)
+  {
+    return;
+  }
+  char tstamp[256];
+  size_t tlen = formatTimestamp(tstamp, sizeof(tstamp));
+  string str(tstamp, tlen);
+  str += line;
+  ssize_t ret = write(m_logfd, str.data(), str.size());
+  (void)ret;
+} /* LogWriter::writeLine */
+
+
+void LogWriter::wakeWriter(void)
+{
+    // Broadcast since a thread waiting in flush may also use the condition
+  pthread_mutex_lock(&m_mutex);
+  pthread_cond_broadcast(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+} /* LogWriter::wakeWriter */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,262 @@
+/**
+@file   AsyncLogWriter.h
+@brief  Write the stdout log to a file from background threads
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_LOG_WRITER_INCLUDED
+#define ASYNC_LOG_WRITER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <pthread.h>
+
+#include <string>
+#include <atomic>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+ * @brief   Write stdout and stderr to a logfile without blocking the main loop
+ * @author  Tobias Blomberg / SM0SVX
+ * @date    2026-10-14
+ *
+ * The SvxLink applications redirect stdout and stderr into a pipe when
+ * logging to a file. This class drains that pipe on a reader thread,
+ * timestamps each line and puts it in a lock-free ring buffer. A writer thread
+ * then writes everything that is in the buffer to the logfile in as few
+ * write calls as possible. The main thread is therefore never blocked by
+ * slow storage or by formatting timestamps.
+ *
+ * If the writer cannot keep up and the buffer is full, whole lines are
+ * dropped and counted. A warning with the number of dropped lines is written
+ * to the log when there is room again.
+ *
+ * Both threads use the FILE_IO role of Async::ThreadScheduling.
+ *
+ * \code
+ *   LogWriter *log_writer = new LogWriter;
+ *   if (!log_writer->open(logfile_name)) exit(1);
+ *   // ...create the pipe and redirect stdout/stderr to it...
+ *   log_writer->start(pipefd[0]);
+ * \endcode
+ */
+class LogWriter
+{
+  public:
+    /**
+     * @brief   The default size of the line buffer in bytes
+     */
+    static const size_t DEFAULT_BUFFER_SIZE = 256 * 1024;
+
+    /**
+     * @brief 	Constructor
+     * @param   buffer_size The size of the line buffer in bytes
+     */
+    explicit LogWriter(size_t buffer_size=DEFAULT_BUFFER_SIZE);
+
+    /**
+     * @brief 	Destructor
+     *
+     * The threads are stopped, after writing what has been read so far.
+     */
+    ~LogWriter(void);
+
+    /**
+     * @brief   Open the logfile
+     * @param   path The path to the logfile
+     * @return  Returns \em true on success or \em false on failure
+     *
+     * The file is opened for appending and created if it does not exist.
+     * This function must be called before start.
+     */
+    bool open(const std::string& path);
+
+    /**
+     * @brief   Set the timestamp format
+     * @param   fmt A strftime format. The code %f is replaced by milliseconds.
+     *
+     * The timestamp is written in front of each line. An empty format, which
+     * is the default, turns off timestamps. This function may be called at any
+     * time from the main thread.
+     */
+    void setTimestampFormat(const std::string& fmt);
+
+    /**
+     * @brief   Start reading from the given file descriptor
+     * @param   fd The read end of the pipe that stdout is redirected to
+     * @return  Returns \em true on success or \em false on failure
+     */
+    bool start(int fd);
+
+    /**
+     * @brief   Close and open the logfile again, e.g. after log rotation
+     * @param   reason The reason for reopening, written to the log
+     *
+     * The reopen is done by the writer thread when it has written the lines
+     * that are in the buffer.
+     */
+    void reopen(const std::string& reason);
+
+    /**
+     * @brief   Wait until everything written to the pipe is in the logfile
+     *
+     * This function should be called after flushing stdout and stderr. It
+     * waits at most one second.
+     */
+    void flush(void);
+
+    /**
+     * @brief   Stop the threads
+     *
+     * Lines that are in the pipe or in the buffer are written before the
+     * threads exit.
+     */
+    void stop(void);
+
+    /**
+     * @brief   Get the number of dropped lines
+     * @return  Returns the total number of lines dropped since start
+     */
+    unsigned long droppedLines(void) const { return m_dropped_total; }
+
+  private:
+    std::string                   m_path;
+    int                           m_logfd;
+    int                           m_pipefd;
+    int                           m_wake_rd;
+    int                           m_wake_wr;
+    char*                         m_buf;
+    size_t                        m_mask;
+    std::atomic<size_t>           m_head;
+    std::atomic<size_t>           m_tail;
+    std::atomic<bool>             m_stop;
+    std::atomic<bool>             m_reader_done;
+    std::atomic<bool>             m_reader_busy;
+    std::atomic<bool>             m_writer_busy;
+    std::atomic<unsigned long>    m_dropped_total;
+    unsigned long                 m_dropped;
+    bool                          m_at_line_start;
+    bool                          m_dropping;
+    bool                          m_truncated;
+    bool                          m_reopen_pending;
+    std::string                   m_reopen_reason;
+    std::string                   m_tstamp_format;
+    pthread_mutex_t               m_mutex;
+    pthread_cond_t                m_cond;
+    pthread_t                     m_reader;
+    pthread_t                     m_writer;
+    bool                          m_running;
+
+    LogWriter(const LogWriter&);
+    LogWriter& operator=(const LogWriter&);
+    static void *readerFunc(void *arg);
+    static void *writerFunc(void *arg);
+    void readerRun(void);
+    void writerRun(void);
+    void handleInput(const char *data, size_t len);
+    bool put(const char *data, size_t len);
+    size_t formatTimestamp(char *buf, size_t size);
+    void writeLine(const std::string& line);
+    void wakeWriter(void);
+
+};  /* class LogWriter */
+
+
+} /* namespace */
+
+#endif /* ASYNC_LOG_WRITER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
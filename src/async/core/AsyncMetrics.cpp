@@ -0,0 +1,339 @@
+/**
+@file   AsyncMetrics.cpp
+@brief  Export application metrics in the Prometheus text format
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains classes that collect metrics, like counters and gauges,
+from the different parts of an application and format them in the Prometheus
+text exposition format or the OpenMetrics format so that they can be scraped
+over HTTP.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <strings.h>
+
+#include <sstream>
+#include <cmath>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncMetrics.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+void MetricsWriter::counter(const std::string& name, const std::string& help,
+                            const Labels& labels, double value)
+{
+  family(name, "counter", help).samples.push_back(
+      sample(name + "_total", labels, value));
+} /* MetricsWriter::counter */
+
+
+void MetricsWriter::gauge(const std::string& name, const std::string& help,
+                          const Labels& labels, double value)
+{
+  family(name, "gauge", help).samples.push_back(sample(name, labels, value));
+} /* MetricsWriter::gauge */
+
+
+void MetricsWriter::histogram(const std::string& name, const std::string& help,
+                              const Labels& labels,
+                              const std::vector<Bucket>& buckets,
+                              uint64_t count, double sum)
+{
+  Family& f = family(name, "histogram", help);
+  for (std::vector<Bucket>::const_iterator it=buckets.begin();
+       it!=buckets.end(); ++it)
+  {
+    ostringstream le;
+    le.precision(15);
+    le << it->first;
+    f.samples.push_back(
+        sample(name + "_bucket", labels, it->second, "le", le.str()));
+  }
+  f.samples.push_back(sample(name + "_bucket", labels, count, "le", "+Inf"));
+  f.samples.push_back(sample(name + "_count", labels, count));
+  f.samples.push_back(sample(name + "_sum", labels, sum));
+} /* MetricsWriter::histogram */
+
+
+std::string MetricsWriter::str(bool openmetrics) const
+{
+  ostringstream os;
+  for (Families::const_iterator it=m_families.begin();
+       it!=m_families.end(); ++it)
+  {
+    const Family& f = it->second;
+      // The Prometheus text format name the counter family after the
+      // samples while OpenMetrics use the name without the suffix
+    std::string name(it->first);
+    if (!openmetrics && (f.type == "counter"))
+    {
+      name += "_total";
+    }
+    os << "# HELP " << name << " " << f.help << "\n";
+    os << "# TYPE " << name << " " << f.type << "\n";
+    for (std::list<std::string>::const_iterator sit=f.samples.begin();
+         sit!=f.samples.end(); ++sit)
+    {
+      os << *sit << "\n";
+    }
+  }
+  if (openmetrics)
+  {
+    os << "# EOF\n";
+  }
+  return os.str();
+} /* MetricsWriter::str */
+
+
+Metrics& Metrics::instance(void)
+{
+  static Metrics metrics;
+  return metrics;
+} /* Metrics::instance */
+
+
+MetricCounter& Metrics::counter(const std::string& name,
+                                const std::string& help, const Labels& labels)
+{
+  RegisteredCounter*& c = m_counters[make_pair(name, labels)];
+  if (c == 0)
+  {
+    c = new RegisteredCounter;
+    c->name = name;
+    c->help = help;
+    c->labels = labels;
+  }
+  return c->counter;
+} /* Metrics::counter */
+
+
+std::string Metrics::str(bool openmetrics)
+{
+  MetricsWriter writer;
+  for (CounterMap::const_iterator it=m_counters.begin();
+       it!=m_counters.end(); ++it)
+  {
+    const RegisteredCounter *c = it->second;
+    writer.counter(c->name, c->help, c->labels, c->counter.value());
+  }
+  collect(writer);
+  return writer.str(openmetrics);
+} /* Metrics::str */
+
+
+void Metrics::writeHttpResponse(HttpServerConnection *con,
+                                const HttpServerConnection::Request& req)
+{
+  bool openmetrics = false;
+  for (HttpServerConnection::Headers::const_iterator it=req.headers.begin();
+       it!=req.headers.end(); ++it)
+  {
+    if ((strcasecmp(it->first.c_str(), "Accept") == 0) &&
+        (it->second.find("application/openmetrics-text") != string::npos))
+    {
+      openmetrics = true;
+    }
+  }
+
+  HttpServerConnection::Response res;
+  res.setCode(200);
+  res.setHeader("Cache-Control", "no-cache");
+  res.setContent(openmetrics
+      ? "application/openmetrics-text; version=1.0.0; charset=utf-8"
+      : "text/plain; version=0.0.4; charset=utf-8",
+      str(openmetrics));
+  if (req.method == "HEAD")
+  {
+    res.setSendContent(false);
+  }
+  con->write(res);
+} /* Metrics::writeHttpResponse */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+Metrics::~Metrics(void)
+{
+  for (CounterMap::iterator it=m_counters.begin(); it!=m_counters.end(); ++it)
+  {
+    delete it->second;
+  }
+} /* Metrics::~Metrics */
+
+
+MetricsWriter::Family& MetricsWriter::family(const std::string& name,
+                                             const std::string& type,
+                                             const std::string& help)
+{
+  Family& f = m_families[name];
+  if (f.type.empty())
+  {
+    f.type = type;
+    f.help = help;
+  }
+  return f;
+} /* MetricsWriter::family */
+
+
+std::string MetricsWriter::sample(const std::string& name,
+                                  const Labels& labels, double value,
+                                  const std::string& extra_label,
+                                  const std::string& extra_value)
+{
+  Labels all(labels);
+  if (!extra_label.empty())
+  {
+    all[extra_label] = extra_value;
+  }
+  ostringstream os;
+  os.precision(15);
+  os << name;
+  if (!all.empty())
+  {
+    os << "{";
+    for (Labels::const_iterator it=all.begin(); it!=all.end(); ++it)
+    {
+      if (it != all.begin())
+      {
+        os << ",";
+      }
+      os << it->first << "=\"";
+      for (std::string::const_iterator cit=it->second.begin();
+           cit!=it->second.end(); ++cit)
+      {
+        switch (*cit)
+        {
+          case '\\': os << "\\\\"; break;
+          case '"':  os << "\\\""; break;
+          case '\n': os << "\\n"; break;
+          default:   os << *cit; break;
+        }
+      }
+      os << "\"";
+    }
+    os << "}";
+  }
+  os << " ";
+  if (std::isnan(value))
+  {
+    os << "NaN";
+  }
+  else
+  {
+    os << value;
+  }
+  return os.str();
+} /* MetricsWriter::sample */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,347 @@
+/**
+@file   AsyncMetrics.h
+@brief  Export application metrics in the Prometheus text format
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains classes that collect metrics, like counters and gauges,
+from the different parts of an application and format them in the Prometheus
+text exposition format or the OpenMetrics format so that they can be scraped
+over HTTP.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_METRICS_INCLUDED
+#define ASYNC_METRICS_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+#include <sigc++/sigc++.h>
+
+#include <atomic>
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+#include <utility>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncHttpServerConnection.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  A counter that can be updated cheaply from any thread
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+The counter is a relaxed atomic so incrementing it is a single lock free
+instruction on all common platforms. It is meant to be used on hot paths,
+like audio processing or packet handling, where the value is read out only
+when the metrics are scraped.
+*/
+class MetricCounter
+{
+  public:
+    /**
+     * @brief   Default constructor
+     */
+    MetricCounter(void) : m_value(0) {}
+
+    /**
+     * @brief   Increment the counter
+     * @param   n The number to add to the counter
+     */
+    void inc(uint64_t n=1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+
+    /**
+     * @brief   Read the counter value
+     * @return  Returns the current value of the counter
+     */
+    uint64_t value(void) const { return m_value.load(std::memory_order_relaxed); }
+
+  private:
+    std::atomic<uint64_t> m_value;
+
+    MetricCounter(const MetricCounter&);
+    MetricCounter& operator=(const MetricCounter&);
+
+};  /* class MetricCounter */
+
+
+/**
+@brief  Format metric samples in the Prometheus text format
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+An object of this class is handed to all metric collectors when the metrics
+are scraped. The samples may be added in any order. They are grouped by
+metric name when the text is generated, as required by the exposition format.
+*/
+class MetricsWriter
+{
+  public:
+    /**
+     * @brief   Metric labels, mapping label name to label value
+     */
+    typedef std::map<std::string, std::string> Labels;
+
+    /**
+     * @brief   A histogram bucket, upper bound and cumulative count
+     */
+    typedef std::pair<double, uint64_t> Bucket;
+
+    /**
+     * @brief   Add a counter sample
+     * @param   name    The metric name, excluding the "_total" suffix
+     * @param   help    A description of the metric
+     * @param   labels  The labels for this sample
+     * @param   value   The counter value
+     */
+    void counter(const std::string& name, const std::string& help,
+                 const Labels& labels, double value);
+
+    /**
+     * @brief   Add a gauge sample
+     * @param   name    The metric name
+     * @param   help    A description of the metric
+     * @param   labels  The labels for this sample
+     * @param   value   The gauge value
+     */
+    void gauge(const std::string& name, const std::string& help,
+               const Labels& labels, double value);
+
+    /**
+     * @brief   Add a histogram
+     * @param   name    The metric name
+     * @param   help    A description of the metric
+     * @param   labels  The labels for this histogram
+     * @param   buckets The buckets, with increasing upper bounds, excluding
+     *                  the +Inf bucket
+     * @param   count   The total number of observations
+     * @param   sum     The sum of all observations
+     */
+    void histogram(const std::string& name, const std::string& help,
+                   const Labels& labels, const std::vector<Bucket>& buckets,
+                   uint64_t count, double sum);
+
+    /**
+     * @brief   Generate the text for all added samples
+     * @param   openmetrics Generate OpenMetrics instead of Prometheus text
+     * @return  Returns the formatted metrics
+     */
+    std::string str(bool openmetrics) const;
+
+  private:
+    struct Family
+    {
+      std::string             type;
+      std::string             help;
+      std::list<std::string>  samples;
+    };
+    typedef std::map<std::string, Family> Families;
+
+    Families  m_families;
+
+    Family& family(const std::string& name, const std::string& type,
+                   const std::string& help);
+    static std::string sample(const std::string& name, const Labels& labels,
+                              double value, const std::string& extra_label="",
+                              const std::string& extra_value="");
+
+};  /* class MetricsWriter */
+
+
+/**
+@brief  The registry of all application metrics
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+All parts of an application that want to export metrics do it through the
+one and only instance of this class. There are two ways to do that. The
+first one is to register a counter using the counter function and then
+increment it as things happen. The second one is to connect to the collect
+signal and write the current value of existing statistics when the metrics
+are scraped. The second way cost nothing until someone actually asks for the
+metrics so it is preferred when the values already are tracked somewhere.
+
+The metrics are usually published through a HTTP server, using the
+writeHttpResponse function to answer requests for the /metrics target.
+*/
+class Metrics
+{
+  public:
+    typedef MetricsWriter::Labels Labels;
+
+    /**
+     * @brief   Get the one and only metrics registry
+     * @return  Returns a reference to the registry
+     */
+    static Metrics& instance(void);
+
+    /**
+     * @brief   Convenience function to create a set of labels
+     * @param   name  The name of the label
+     * @param   value The value of the label
+     * @return  Returns a label set containing the given label
+     */
+    static Labels labels(const std::string& name, const std::string& value)
+    {
+      Labels l;
+      l[name] = value;
+      return l;
+    }
+
+    /**
+     * @brief   Get a registered counter, creating it if needed
+     * @param   name    The metric name, excluding the "_total" suffix
+     * @param   help    A description of the metric
+     * @param   labels  The labels for this counter
+     * @return  Returns a reference to the counter
+     *
+     * The counter lives until the application exits so the returned
+     * reference can be stored and used at any time. Asking for the same name
+     * and labels again will return the same counter.
+     */
+    MetricCounter& counter(const std::string& name, const std::string& help,
+                           const Labels& labels=Labels());
+
+    /**
+     * @brief   Generate the text for all metrics
+     * @param   openmetrics Generate OpenMetrics instead of Prometheus text
+     * @return  Returns the formatted metrics
+     */
+    std::string str(bool openmetrics=false);
+
+    /**
+     * @brief   Answer a HTTP request for the metrics
+     * @param   con The connection to write the response to
+     * @param   req The request
+     *
+     * The OpenMetrics format is used if the client ask for it in the Accept
+     * header. Otherwise the Prometheus text format is used.
+     */
+    void writeHttpResponse(HttpServerConnection *con,
+                           const HttpServerConnection::Request& req);
+
+    /**
+     * @brief   A signal that is emitted when the metrics are generated
+     * @param   writer The writer to add samples to
+     */
+    sigc::signal<void, MetricsWriter&> collect;
+
+  private:
+    struct RegisteredCounter
+    {
+      std::string   name;
+      std::string   help;
+      Labels        labels;
+      MetricCounter counter;
+    };
+    typedef std::map<std::pair<std::string, Labels>,
+                     RegisteredCounter*> CounterMap;
+
+    CounterMap m_counters;
+
+    Metrics(void) {}
+    ~Metrics(void);
+    Metrics(const Metrics&);
+    Metrics& operator=(const Metrics&);
+
+};  /* class Metrics */
+
+
+} /* namespace */
+
+#endif /* ASYNC_METRICS_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -86,6 +86,20 @@ MsgDerived d2;
 d2.unpack(ss);
 \endcode
 
+Instead of a stream, a message can also be packed into or unpacked from a
+contiguous buffer using the Async::MsgWriter and Async::MsgReader classes. That
+avoid the overhead of the iostream classes, which may matter when many small
+messages are handled, e.g. network audio packets.
+
+\code{.cpp}
+std::vector<char> buf(d1.packedSize());
+Async::MsgWriter w(&buf[0], buf.size());
+d1.pack(w);
+
+Async::MsgReader r(&buf[0], buf.size());
+d2.unpack(r);
+\endcode
+
 For a working example, have a look at the demo application,
 \ref AsyncMsg_demo.cpp.
 
@@ -130,6 +144,7 @@ An example of how to use the AsyncMsg class
 #include <set>
 #include <map>
 #include <limits>
+#include <cstring>
 #include <endian.h>
 #include <stdint.h>
 
@@ -190,7 +205,8 @@ namespace Async
  * class. Multiple inheritance is not supported.
  */
 #define ASYNC_MSG_DERIVED_FROM(BASE_CLASS) \
-    bool packParent(std::ostream& os) const \
+    template <typename OS> \
+    bool packParent(OS& os) const \
     { \
       return BASE_CLASS::pack(os); \
     } \
@@ -198,7 +214,8 @@ namespace Async
     { \
       return BASE_CLASS::packedSize(); \
     } \
-    bool unpackParent(std::istream& is) \
+    template <typename IS> \
+    bool unpackParent(IS& is) \
     { \
       return BASE_CLASS::unpack(is); \
     }
@@ -215,6 +232,10 @@ namespace Async
     { \
       return packParent(os) && Msg::pack(os, __VA_ARGS__); \
     } \
+    bool pack(Async::MsgWriter& w) const \
+    { \
+      return packParent(w) && Msg::pack(w, __VA_ARGS__); \
+    } \
     size_t packedSize(void) const \
     { \
       return packedSizeParent() + Msg::packedSize(__VA_ARGS__); \
@@ -222,6 +243,10 @@ namespace Async
     bool unpack(std::istream& is) \
     { \
       return unpackParent(is) && Msg::unpack(is, __VA_ARGS__); \
+    } \
+    bool unpack(Async::MsgReader& r) \
+    { \
+      return unpackParent(r) && Msg::unpack(r, __VA_ARGS__); \
     }
 
 /**
@@ -234,10 +259,18 @@ namespace Async
     { \
       return packParent(os); \
     } \
+    bool pack(Async::MsgWriter& w) const \
+    { \
+      return packParent(w); \
+    } \
     size_t packedSize(void) const { return packedSizeParent(); } \
     bool unpack(std::istream& is) \
     { \
       return unpackParent(is); \
+    } \
+    bool unpack(Async::MsgReader& r) \
+    { \
+      return unpackParent(r); \
     }
 
 
@@ -255,26 +288,190 @@ namespace Async
  *
  ****************************************************************************/
 
+/**
+@brief  A writer used to pack messages into a contiguous buffer
+@author Tobias Blomberg / SM0SVX
+@date   2020-05-12
+
+This class can be used instead of a std::ostream when packing messages. It
+write directly into a buffer provided by the caller, which avoid the overhead
+of the iostream machinery. The packedSize function of the message can be used
+to find out how big the buffer need to be.
+
+\code{.cpp}
+std::vector<char> buf(msg.packedSize());
+Async::MsgWriter w(&buf[0], buf.size());
+if (!msg.pack(w)) { ... }
+\endcode
+*/
+class MsgWriter
+{
+  public:
+    /**
+     * @brief   Constructor
+     * @param   buf   The buffer to write into
+     * @param   size  The size of the buffer
+     */
+    MsgWriter(char *buf, size_t size)
+      : m_buf(buf), m_size(size), m_pos(0), m_ok(true) {}
+
+    /**
+     * @brief   Write data into the buffer
+     * @param   data  The data to write
+     * @param   count The number of bytes to write
+     * @return  Returns a reference to this object
+     *
+     * If the data does not fit in the buffer the writer is put in the failed
+     * state and nothing more will be written.
+     */
+    MsgWriter& write(const char *data, size_t count)
+    {
+      if (!m_ok || (count > m_size - m_pos))
+      {
+        m_ok = false;
+        return *this;
+      }
+      std::memcpy(m_buf + m_pos, data, count);
+      m_pos += count;
+      return *this;
+    }
+
+    /**
+     * @brief   Check if all writes have been successful
+     * @return  Returns \em true if no write has failed
+     */
+    bool good(void) const { return m_ok; }
+    explicit operator bool(void) const { return m_ok; }
+
+    /**
+     * @brief   Get the number of bytes written so far
+     * @return  Returns the number of bytes written to the buffer
+     */
+    size_t size(void) const { return m_pos; }
+
+  private:
+    char*   m_buf;
+    size_t  m_size;
+    size_t  m_pos;
+    bool    m_ok;
+};
+
+
+/**
+@brief  A reader used to unpack messages from a contiguous buffer
+@author Tobias Blomberg / SM0SVX
+@date   2020-05-12
+
+This class can be used instead of a std::istream when unpacking messages. It
+read directly from a buffer provided by the caller, for example a received
+network packet, without first copying the data into a stream.
+*/
+class MsgReader
+{
+  public:
+    /**
+     * @brief   Constructor
+     * @param   buf   The buffer to read from
+     * @param   size  The number of bytes in the buffer
+     */
+    MsgReader(const char *buf, size_t size)
+      : m_buf(buf), m_size(size), m_pos(0), m_ok(true) {}
+
+    /**
+     * @brief   Read data from the buffer
+     * @param   data  Where to store the data
+     * @param   count The number of bytes to read
+     * @return  Returns a reference to this object
+     *
+     * If there is not enough data left in the buffer the reader is put in
+     * the failed state.
+     */
+    MsgReader& read(char *data, size_t count)
+    {
+      if (!m_ok || (count > m_size - m_pos))
+      {
+        m_ok = false;
+        return *this;
+      }
+      std::memcpy(data, m_buf + m_pos, count);
+      m_pos += count;
+      return *this;
+    }
+
+    /**
+     * @brief   Check if all reads have been successful
+     * @return  Returns \em true if no read has failed
+     */
+    bool good(void) const { return m_ok; }
+    explicit operator bool(void) const { return m_ok; }
+
+    /**
+     * @brief   Get the number of bytes that have not been read yet
+     * @return  Returns the number of unread bytes
+     */
+    size_t available(void) const { return m_size - m_pos; }
+
+    /**
+     * @brief   Get a pointer to the current read position
+     * @return  Returns a pointer to the next byte to read
+     */
+    const char* data(void) const { return m_buf + m_pos; }
+
+  private:
+    const char* m_buf;
+    size_t      m_size;
+    size_t      m_pos;
+    bool        m_ok;
+};
+
+
+/**
+@brief  Get the packed size of a type if it is known at compile time
+
+The value is zero for types that have a variable packed size.
+*/
+template <typename T>
+struct MsgFixedSize
+{
+  static const size_t value = 0;
+};
+template <> struct MsgFixedSize<char> { static const size_t value = 1; };
+template <> struct MsgFixedSize<uint64_t> { static const size_t value = 8; };
+template <> struct MsgFixedSize<int64_t> { static const size_t value = 8; };
+template <> struct MsgFixedSize<double> { static const size_t value = 8; };
+template <> struct MsgFixedSize<uint32_t> { static const size_t value = 4; };
+template <> struct MsgFixedSize<int32_t> { static const size_t value = 4; };
+template <> struct MsgFixedSize<float> { static const size_t value = 4; };
+template <> struct MsgFixedSize<uint16_t> { static const size_t value = 2; };
+template <> struct MsgFixedSize<int16_t> { static const size_t value = 2; };
+template <> struct MsgFixedSize<uint8_t> { static const size_t value = 1; };
+template <> struct MsgFixedSize<int8_t> { static const size_t value = 1; };
+
+
 template <typename T>
 class MsgPacker
 {
   public:
-    static bool pack(std::ostream& os, const T& val) { return val.pack(os); }
+    template <typename OS>
+    static bool pack(OS& os, const T& val) { return val.pack(os); }
     static size_t packedSize(const T& val) { return val.packedSize(); }
-    static bool unpack(std::istream& is, T& val) { return val.unpack(is); }
+    template <typename IS>
+    static bool unpack(IS& is, T& val) { return val.unpack(is); }
 };
 
 template <>
 class MsgPacker<char>
 {
   public:
-    static bool pack(std::ostream& os, char val)
+    template <typename OS>
+    static bool pack(OS& os, char val)
     {
       //std::cout << "pack<char>("<< int(val) << ")" << std::endl;
       return os.write(&val, 1).good();
     }
     static size_t packedSize(const char& val) { return sizeof(char); }
-    static bool unpack(std::istream& is, char& val)
+    template <typename IS>
+    static bool unpack(IS& is, char& val)
     {
       is.read(&val, 1);
       //std::cout << "unpack<char>(" << int(val) << ")" << std::endl;
@@ -286,7 +483,8 @@ template <typename T>
 class Packer64
 {
   public:
-    static bool pack(std::ostream& os, const T& val)
+    template <typename OS>
+    static bool pack(OS& os, const T& val)
     {
       //std::cout << "pack<64>(" << val << ")" << std::endl;
       Overlay o;
@@ -295,7 +493,8 @@ class Packer64
       return os.write(o.buf, sizeof(T)).good();
     }
     static size_t packedSize(const T& val) { return sizeof(T); }
-    static bool unpack(std::istream& is, T& val)
+    template <typename IS>
+    static bool unpack(IS& is, T& val)
     {
       Overlay o;
       is.read(o.buf, sizeof(T));
@@ -320,7 +519,8 @@ template <typename T>
 class Packer32
 {
   public:
-    static bool pack(std::ostream& os, const T& val)
+    template <typename OS>
+    static bool pack(OS& os, const T& val)
     {
       //std::cout << "pack<32>(" << val << ")" << std::endl;
       Overlay o;
@@ -329,7 +529,8 @@ class Packer32
       return os.write(o.buf, sizeof(T)).good();
     }
     static size_t packedSize(const T& val) { return sizeof(T); }
-    static bool unpack(std::istream& is, T& val)
+    template <typename IS>
+    static bool unpack(IS& is, T& val)
     {
       Overlay o;
       is.read(o.buf, sizeof(T));
@@ -354,7 +555,8 @@ template <typename T>
 class Packer16
 {
   public:
-    static bool pack(std::ostream& os, const T& val)
+    template <typename OS>
+    static bool pack(OS& os, const T& val)
     {
       //std::cout << "pack<16>(" << val << ")" << std::endl;
       Overlay o;
@@ -363,7 +565,8 @@ class Packer16
       return os.write(o.buf, sizeof(T)).good();
     }
     static size_t packedSize(const T& val) { return sizeof(T); }
-    static bool unpack(std::istream& is, T& val)
+    template <typename IS>
+    static bool unpack(IS& is, T& val)
     {
       Overlay o;
       is.read(o.buf, sizeof(T));
@@ -387,13 +590,15 @@ template <typename T>
 class Packer8
 {
   public:
-    static bool pack(std::ostream& os, const T& val)
+    template <typename OS>
+    static bool pack(OS& os, const T& val)
     {
       //std::cout << "pack<8>(" << int(val) << ")" << std::endl;
       return os.write(reinterpret_cast<const char*>(&val), sizeof(T)).good();
     }
     static size_t packedSize(const T& val) { return sizeof(T); }
-    static bool unpack(std::istream& is, T& val)
+    template <typename IS>
+    static bool unpack(IS& is, T& val)
     {
       is.read(reinterpret_cast<char*>(&val), sizeof(T));
       //std::cout << "unpack<8>(" << int(val) << ")" << std::endl;
@@ -407,7 +612,8 @@ template <>
 class MsgPacker<std::string>
 {
   public:
-    static bool pack(std::ostream& os, const std::string& val)
+    template <typename OS>
+    static bool pack(OS& os, const std::string& val)
     {
       //std::cout << "pack<string>(" << val << ")" << std::endl;
       if (val.size() > std::numeric_limits<uint16_t>::max())
@@ -422,7 +628,8 @@ class MsgPacker<std::string>
     {
       return sizeof(uint16_t) + val.size();
     }
-    static bool unpack(std::istream& is, std::string& val)
+    template <typename IS>
+    static bool unpack(IS& is, std::string& val)
     {
       uint16_t str_len;
       if (MsgPacker<uint16_t>::unpack(is, str_len))
@@ -447,24 +654,35 @@ template <typename I>
 class MsgPacker<std::vector<I> >
 {
   public:
-    static bool pack(std::ostream& os, const std::vector<I>& vec)
+    template <typename OS>
+    static bool pack(OS& os, const std::vector<I>& vec)
     {
       //std::cout << "pack<vector>(" << vec.size() << ")" << std::endl;
       if (vec.size() > std::numeric_limits<uint16_t>::max())
       {
         return false;
       }
-      MsgPacker<uint16_t>::pack(os, vec.size());
+      if (!MsgPacker<uint16_t>::pack(os, vec.size()))
+      {
+        return false;
+      }
       for (typename std::vector<I>::const_iterator it = vec.begin();
            it != vec.end();
            ++it)
       {
-        MsgPacker<I>::pack(os, *it);
+        if (!MsgPacker<I>::pack(os, *it))
+        {
+          return false;
+        }
       }
       return true;
     }
     static size_t packedSize(const std::vector<I>& vec)
     {
+      if (MsgFixedSize<I>::value > 0)
+      {
+        return sizeof(uint16_t) + vec.size() * MsgFixedSize<I>::value;
+      }
       size_t size = sizeof(uint16_t);
       for (typename std::vector<I>::const_iterator it = vec.begin();
            it != vec.end(); ++it)
@@ -473,10 +691,14 @@ class MsgPacker<std::vector<I> >
       }
       return size;
     }
-    static bool unpack(std::istream& is, std::vector<I>& vec)
+    template <typename IS>
+    static bool unpack(IS& is, std::vector<I>& vec)
     {
       uint16_t vec_size;
-      MsgPacker<uint16_t>::unpack(is, vec_size);
+      if (!MsgPacker<uint16_t>::unpack(is, vec_size))
+      {
+        return false;
+      }
       if (vec_size > std::numeric_limits<uint16_t>::max())
       {
         return false;
@@ -487,7 +709,10 @@ class MsgPacker<std::vector<I> >
       for (int i=0; i<vec_size; ++i)
       {
         I val;
-        MsgPacker<I>::unpack(is, val);
+        if (!MsgPacker<I>::unpack(is, val))
+        {
+          return false;
+        }
         vec.push_back(val);
       }
       return true;
@@ -498,24 +723,35 @@ template <typename I>
 class MsgPacker<std::set<I> >
 {
   public:
-    static bool pack(std::ostream& os, const std::set<I>& s)
+    template <typename OS>
+    static bool pack(OS& os, const std::set<I>& s)
     {
       //std::cout << "pack<set>(" << s.size() << ")" << std::endl;
       if (s.size() > std::numeric_limits<uint16_t>::max())
       {
         return false;
       }
-      MsgPacker<uint16_t>::pack(os, s.size());
+      if (!MsgPacker<uint16_t>::pack(os, s.size()))
+      {
+        return false;
+      }
       for (typename std::set<I>::const_iterator it = s.begin();
            it != s.end();
            ++it)
       {
-        MsgPacker<I>::pack(os, *it);
+        if (!MsgPacker<I>::pack(os, *it))
+        {
+          return false;
+        }
       }
       return true;
     }
     static size_t packedSize(const std::set<I>& s)
     {
+      if (MsgFixedSize<I>::value > 0)
+      {
+        return sizeof(uint16_t) + s.size() * MsgFixedSize<I>::value;
+      }
       size_t size = sizeof(uint16_t);
       for (typename std::set<I>::const_iterator it = s.begin();
            it != s.end(); ++it)
@@ -524,10 +760,14 @@ class MsgPacker<std::set<I> >
       }
       return size;
     }
-    static bool unpack(std::istream& is, std::set<I>& s)
+    template <typename IS>
+    static bool unpack(IS& is, std::set<I>& s)
     {
       uint16_t set_size;
-      MsgPacker<uint16_t>::unpack(is, set_size);
+      if (!MsgPacker<uint16_t>::unpack(is, set_size))
+      {
+        return false;
+      }
       if (set_size > std::numeric_limits<uint16_t>::max())
       {
         return false;
@@ -537,7 +777,10 @@ class MsgPacker<std::set<I> >
       for (int i=0; i<set_size; ++i)
       {
         I val;
-        MsgPacker<I>::unpack(is, val);
+        if (!MsgPacker<I>::unpack(is, val))
+        {
+          return false;
+        }
         s.insert(val);
       }
       return true;
@@ -548,20 +791,27 @@ template <typename Tag, typename Value>
 class MsgPacker<std::map<Tag,Value> >
 {
   public:
-    static bool pack(std::ostream& os, const std::map<Tag, Value>& m)
+    template <typename OS>
+    static bool pack(OS& os, const std::map<Tag, Value>& m)
     {
       //std::cout << "pack<map>(" << m.size() << ")" << std::endl;
       if (m.size() > std::numeric_limits<uint16_t>::max())
       {
         return false;
       }
-      MsgPacker<uint16_t>::pack(os, m.size());
+      if (!MsgPacker<uint16_t>::pack(os, m.size()))
+      {
+        return false;
+      }
       for (typename std::map<Tag,Value>::const_iterator it = m.begin();
            it != m.end();
            ++it)
       {
-        MsgPacker<Tag>::pack(os, (*it).first);
-        MsgPacker<Value>::pack(os, (*it).second);
+        if (!MsgPacker<Tag>::pack(os, (*it).first) ||
+            !MsgPacker<Value>::pack(os, (*it).second))
+        {
+          return false;
+        }
       }
       return true;
     }
@@ -576,10 +826,14 @@ class MsgPacker<std::map<Tag,Value> >
       }
       return size;
     }
-    static bool unpack(std::istream& is, std::map<Tag,Value>& m)
+    template <typename IS>
+    static bool unpack(IS& is, std::map<Tag,Value>& m)
     {
       uint16_t map_size;
-      MsgPacker<uint16_t>::unpack(is, map_size);
+      if (!MsgPacker<uint16_t>::unpack(is, map_size))
+      {
+        return false;
+      }
       if (map_size > std::numeric_limits<uint16_t>::max())
       {
         return false;
@@ -590,8 +844,11 @@ class MsgPacker<std::map<Tag,Value> >
       {
         Tag tag;
         Value val;
-        MsgPacker<Tag>::unpack(is, tag);
-        MsgPacker<Value>::unpack(is, val);
+        if (!MsgPacker<Tag>::unpack(is, tag) ||
+            !MsgPacker<Value>::unpack(is, val))
+        {
+          return false;
+        }
         m[tag] = val;
       }
       return true;
@@ -609,16 +866,20 @@ class Msg
   public:
     virtual ~Msg(void) {}
 
-    bool packParent(std::ostream&) const { return true; }
+    template <typename OS>
+    bool packParent(OS&) const { return true; }
     size_t packedSizeParent(void) const { return 0; }
-    bool unpackParent(std::istream&) const { return true; }
+    template <typename IS>
+    bool unpackParent(IS&) const { return true; }
 
     virtual bool pack(std::ostream&) const { return true; }
+    virtual bool pack(MsgWriter&) const { return true; }
     virtual size_t packedSize(void) const { return 0; }
     virtual bool unpack(std::istream&) const { return true; }
+    virtual bool unpack(MsgReader&) { return true; }
 
-    template <typename T>
-    bool pack(std::ostream& os, const T& val) const
+    template <typename OS, typename T>
+    bool pack(OS& os, const T& val) const
     {
       return MsgPacker<T>::pack(os, val);
     }
@@ -627,14 +888,14 @@ class Msg
     {
       return MsgPacker<T>::packedSize(val);
     }
-    template <typename T>
-    bool unpack(std::istream& is, T& val) const
+    template <typename IS, typename T>
+    bool unpack(IS& is, T& val) const
     {
       return MsgPacker<T>::unpack(is, val);
     }
 
-    template <typename T1, typename T2>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2) const
+    template <typename OS, typename T1, typename T2>
+    bool pack(OS& os, const T1& v1, const T2& v2) const
     {
       return pack(os, v1) && pack(os, v2);
     }
@@ -643,14 +904,14 @@ class Msg
     {
       return packedSize(v1) + packedSize(v2);
     }
-    template <typename T1, typename T2>
-    bool unpack(std::istream& is, T1& v1, T2& v2)
+    template <typename IS, typename T1, typename T2>
+    bool unpack(IS& is, T1& v1, T2& v2)
     {
       return unpack(is, v1) && unpack(is, v2);
     }
 
-    template <typename T1, typename T2, typename T3>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2, const T3& v3) const
+    template <typename OS, typename T1, typename T2, typename T3>
+    bool pack(OS& os, const T1& v1, const T2& v2, const T3& v3) const
     {
       return pack(os, v1) && pack(os, v2) && pack(os, v3);
     }
@@ -659,14 +920,14 @@ class Msg
     {
       return packedSize(v1) + packedSize(v2) + packedSize(v3);
     }
-    template <typename T1, typename T2, typename T3>
-    bool unpack(std::istream& is, T1& v1, T2& v2, T3& v3)
+    template <typename IS, typename T1, typename T2, typename T3>
+    bool unpack(IS& is, T1& v1, T2& v2, T3& v3)
     {
       return unpack(is, v1) && unpack(is, v2) && unpack(is, v3);
     }
 
-    template <typename T1, typename T2, typename T3, typename T4>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2, const T3& v3,
+    template <typename OS, typename T1, typename T2, typename T3, typename T4>
+    bool pack(OS& os, const T1& v1, const T2& v2, const T3& v3,
               const T4& v4) const
     {
       return pack(os, v1) && pack(os, v2) && pack(os, v3) && pack(os, v4);
@@ -677,15 +938,16 @@ class Msg
     {
       return packedSize(v1) + packedSize(v2) + packedSize(v3) + packedSize(v4);
     }
-    template <typename T1, typename T2, typename T3, typename T4>
-    bool unpack(std::istream& is, T1& v1, T2& v2, T3& v3, T4& v4)
+    template <typename IS, typename T1, typename T2, typename T3, typename T4>
+    bool unpack(IS& is, T1& v1, T2& v2, T3& v3, T4& v4)
     {
       return unpack(is, v1) && unpack(is, v2) && unpack(is, v3) &&
              unpack(is, v4);
     }
 
-    template <typename T1, typename T2, typename T3, typename T4, typename T5>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2, const T3& v3,
+    template <typename OS, typename T1, typename T2, typename T3, typename T4,
+              typename T5>
+    bool pack(OS& os, const T1& v1, const T2& v2, const T3& v3,
               const T4& v4, const T5& v5) const
     {
       return pack(os, v1) && pack(os, v2) && pack(os, v3) && pack(os, v4) &&
@@ -698,16 +960,17 @@ class Msg
       return packedSize(v1) + packedSize(v2) + packedSize(v3) + packedSize(v4) +
              packedSize(v5);
     }
-    template <typename T1, typename T2, typename T3, typename T4, typename T5>
-    bool unpack(std::istream& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5)
+    template <typename IS, typename T1, typename T2, typename T3, typename T4,
+              typename T5>
+    bool unpack(IS& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5)
     {
       return unpack(is, v1) && unpack(is, v2) && unpack(is, v3) &&
              unpack(is, v4) && unpack(is, v5);
     }
 
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2, const T3& v3,
+    template <typename OS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6>
+    bool pack(OS& os, const T1& v1, const T2& v2, const T3& v3,
               const T4& v4, const T5& v5, const T6& v6) const
     {
       return pack(os, v1) && pack(os, v2) && pack(os, v3) && pack(os, v4) &&
@@ -721,18 +984,18 @@ class Msg
       return packedSize(v1) + packedSize(v2) + packedSize(v3) + packedSize(v4) +
              packedSize(v5) + packedSize(v6);
     }
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6>
-    bool unpack(std::istream& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
+    template <typename IS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6>
+    bool unpack(IS& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
                T6& v6)
     {
       return unpack(is, v1) && unpack(is, v2) && unpack(is, v3) &&
              unpack(is, v4) && unpack(is, v5) && unpack(is, v6);
     }
 
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6, typename T7>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2, const T3& v3,
+    template <typename OS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6, typename T7>
+    bool pack(OS& os, const T1& v1, const T2& v2, const T3& v3,
               const T4& v4, const T5& v5, const T6& v6, const T7& v7) const
     {
       return pack(os, v1) && pack(os, v2) && pack(os, v3) && pack(os, v4) &&
@@ -747,9 +1010,9 @@ class Msg
       return packedSize(v1) + packedSize(v2) + packedSize(v3) + packedSize(v4) +
              packedSize(v5) + packedSize(v6) + packedSize(v7);
     }
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6, typename T7>
-    bool unpack(std::istream& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
+    template <typename IS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6, typename T7>
+    bool unpack(IS& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
                T6& v6, T7& v7)
     {
       return unpack(is, v1) && unpack(is, v2) && unpack(is, v3) &&
@@ -757,9 +1020,9 @@ class Msg
              unpack(is, v7);
     }
 
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6, typename T7, typename T8>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2, const T3& v3,
+    template <typename OS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6, typename T7, typename T8>
+    bool pack(OS& os, const T1& v1, const T2& v2, const T3& v3,
               const T4& v4, const T5& v5, const T6& v6, const T7& v7,
               const T8& v8) const
     {
@@ -775,9 +1038,9 @@ class Msg
       return packedSize(v1) + packedSize(v2) + packedSize(v3) + packedSize(v4) +
              packedSize(v5) + packedSize(v6) + packedSize(v7) + packedSize(v8);
     }
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6, typename T7, typename T8>
-    bool unpack(std::istream& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
+    template <typename IS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6, typename T7, typename T8>
+    bool unpack(IS& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
                T6& v6, T7& v7, T8& v8)
     {
       return unpack(is, v1) && unpack(is, v2) && unpack(is, v3) &&
@@ -785,9 +1048,9 @@ class Msg
              unpack(is, v7) && unpack(is, v8);
     }
 
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6, typename T7, typename T8, typename T9>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2, const T3& v3,
+    template <typename OS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6, typename T7, typename T8, typename T9>
+    bool pack(OS& os, const T1& v1, const T2& v2, const T3& v3,
               const T4& v4, const T5& v5, const T6& v6, const T7& v7,
               const T8& v8, const T9& v9) const
     {
@@ -805,9 +1068,9 @@ class Msg
              packedSize(v5) + packedSize(v6) + packedSize(v7) + packedSize(v8) +
              packedSize(v9);
     }
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6, typename T7, typename T8, typename T9>
-    bool unpack(std::istream& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
+    template <typename IS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6, typename T7, typename T8, typename T9>
+    bool unpack(IS& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
                T6& v6, T7& v7, T8& v8, T9& v9)
     {
       return unpack(is, v1) && unpack(is, v2) && unpack(is, v3) &&
@@ -815,9 +1078,10 @@ class Msg
              unpack(is, v7) && unpack(is, v8) && unpack(is, v9);
     }
 
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6, typename T7, typename T8, typename T9, typename T10>
-    bool pack(std::ostream& os, const T1& v1, const T2& v2, const T3& v3,
+    template <typename OS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6, typename T7, typename T8, typename T9,
+              typename T10>
+    bool pack(OS& os, const T1& v1, const T2& v2, const T3& v3,
               const T4& v4, const T5& v5, const T6& v6, const T7& v7,
               const T8& v8, const T9& v9, const T10& v10) const
     {
@@ -836,9 +1100,10 @@ class Msg
              packedSize(v5) + packedSize(v6) + packedSize(v7) + packedSize(v8) +
              packedSize(v9) + packedSize(v10);
     }
-    template <typename T1, typename T2, typename T3, typename T4, typename T5,
-              typename T6, typename T7, typename T8, typename T9, typename T10>
-    bool unpack(std::istream& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
+    template <typename IS, typename T1, typename T2, typename T3, typename T4,
+              typename T5, typename T6, typename T7, typename T8, typename T9,
+              typename T10>
+    bool unpack(IS& is, T1& v1, T2& v2, T3& v3, T4& v4, T5& v5,
                T6& v6, T7& v7, T8& v8, T9& v9, T10& v10)
     {
       return unpack(is, v1) && unpack(is, v2) && unpack(is, v3) &&
@@ -140,7 +140,8 @@ using namespace Async;
  *------------------------------------------------------------------------
  */
 Serial::Serial(const string& serial_port)
-  : serial_port(serial_port), canonical(false), fd(-1), port_settings(), dev(0)
+  : serial_port(serial_port), canonical(false), fd(-1), port_settings(), dev(0),
+    pin_events(false), pin_state(0)
 {
 
 } /* Serial::Serial */
@@ -344,6 +345,7 @@ bool Serial::close(void)
     return true;
   }
   
+  enablePinEvents(false);
   bool success = SerialDevice::close(dev);
   dev = 0;
   fd = -1;
@@ -450,6 +452,12 @@ bool Serial::getPin(Pin pin, bool &is_set)
       return false;
   }
   
+  if (pin_events)
+  {
+    is_set = (pin_state & the_pin);
+    return true;
+  }
+
   int pins = 0;
   if (ioctl(fd, TIOCMGET, &pins) == -1)
   {
@@ -463,6 +471,37 @@ bool Serial::getPin(Pin pin, bool &is_set)
 } /* Serial::getPin */
 
 
+bool Serial::enablePinEvents(bool enable)
+{
+  if (enable == pin_events)
+  {
+    return true;
+  }
+
+  if (!enable)
+  {
+    pin_con.disconnect();
+    dev->removePinWatcher();
+    pin_events = false;
+    return true;
+  }
+
+  if (dev == 0)
+  {
+    errno = EBADF;
+    return false;
+  }
+  if (!dev->addPinWatcher())
+  {
+    return false;
+  }
+  pin_state = dev->pinState();
+  pin_con = dev->pinsChanged.connect(mem_fun(*this, &Serial::onPinsChanged));
+  pin_events = true;
+  return true;
+} /* Serial::enablePinEvents */
+
+
 
 
 /****************************************************************************
@@ -510,6 +549,25 @@ bool Serial::getPin(Pin pin, bool &is_set)
  *----------------------------------------------------------------------------
  */
 
+void Serial::onPinsChanged(int pins)
+{
+  static const struct { Pin pin; int bit; } input_pins[] =
+  {
+    { PIN_CTS, TIOCM_CTS }, { PIN_DSR, TIOCM_DSR },
+    { PIN_DCD, TIOCM_CD }, { PIN_RI, TIOCM_RI }
+  };
+
+  int changed = pins ^ pin_state;
+  pin_state = pins;
+  for (size_t i=0; i<sizeof(input_pins)/sizeof(*input_pins); ++i)
+  {
+    if (changed & input_pins[i].bit)
+    {
+      pinChanged(input_pins[i].pin, (pins & input_pins[i].bit) != 0);
+    }
+  }
+} /* Serial::onPinsChanged */
+
 
 
 
@@ -302,6 +302,21 @@ class Serial : public sigc::trackable
      */
     bool getPin(Pin pin, bool &is_set);
 
+    /**
+     * @brief   Enable or disable events for the input pins
+     * @param   enable Set to \em true to enable or \em false to disable
+     * @return  Return \em true on success or else \em false on failue. On
+     *	      	failure the global variable \em errno will be set to indicate
+     *	      	the cause of the error.
+     *
+     * When enabled, the pinChanged signal is emitted when one of the input
+     * pins change state so that the pins do not have to be polled. The pins
+     * are watched by a helper thread that is shared by all Serial objects
+     * using the same port. While enabled, getPin return the last reported
+     * state without doing any system call. The port must be open.
+     */
+    bool enablePinEvents(bool enable);
+
     /**
      * @brief 	A signal that is emitted when there is data to read
      * @param 	buf   A buffer containing the data that has been read
@@ -313,6 +328,16 @@ class Serial : public sigc::trackable
      * but the null is not included in the count.
      */
     sigc::signal<void, char*, int> charactersReceived;
+
+    /**
+     * @brief   A signal that is emitted when an input pin change state
+     * @param   pin     The pin that changed state. See @ref Serial::Pin.
+     * @param   is_set  The new state of the pin
+     *
+     * This signal is only emitted when pin events have been enabled using
+     * the enablePinEvents function.
+     */
+    sigc::signal<void, Pin, bool> pinChanged;
     
       
   protected:
@@ -324,6 +349,11 @@ class Serial : public sigc::trackable
     int       	      	fd;
     struct termios    	port_settings;
     SerialDevice      	*dev;
+    bool                pin_events;
+    int                 pin_state;
+    sigc::connection    pin_con;
+
+    void onPinsChanged(int pins);
     
 
 };  /* class Serial */
@@ -38,8 +38,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
 #include <errno.h>
 #include <cstdio>
+#include <cstring>
+#include <iostream>
 
 
 /****************************************************************************
@@ -49,6 +53,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncFdWatch.h>
+#include <AsyncTimer.h>
 
 
 /****************************************************************************
@@ -79,6 +84,8 @@ using namespace Async;
  *
  ****************************************************************************/
 
+#define MODEM_INPUT_PINS (TIOCM_CTS | TIOCM_DSR | TIOCM_CD | TIOCM_RI)
+
 
 
 /****************************************************************************
@@ -174,6 +181,72 @@ bool SerialDevice::close(SerialDevice *dev)
 } /* SerialDevice::close */
 
 
+bool SerialDevice::addPinWatcher(void)
+{
+  if (pin_watch_cnt > 0)
+  {
+    ++pin_watch_cnt;
+    return true;
+  }
+
+  if (fd == -1)
+  {
+    errno = EBADF;
+    return false;
+  }
+
+  if (pipe(pin_notify_pipe) == -1)
+  {
+    return false;
+  }
+  fcntl(pin_notify_pipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(pin_notify_pipe[1], F_SETFL, O_NONBLOCK);
+
+  int pins = 0;
+  if (ioctl(fd, TIOCMGET, &pins) == -1)
+  {
+    int errno_tmp = errno;
+    ::close(pin_notify_pipe[0]);
+    ::close(pin_notify_pipe[1]);
+    errno = errno_tmp;
+    return false;
+  }
+  pin_state = pin_state_reported = pins & MODEM_INPUT_PINS;
+
+  int ret = pthread_create(&pin_thread, NULL, pinWatchThread, this);
+  if (ret != 0)
+  {
+    ::close(pin_notify_pipe[0]);
+    ::close(pin_notify_pipe[1]);
+    errno = ret;
+    return false;
+  }
+
+  pin_notify_watch = new FdWatch(pin_notify_pipe[0], FdWatch::FD_WATCH_RD);
+  pin_notify_watch->activity.connect(
+      mem_fun(*this, &SerialDevice::onPinNotify));
+
+    // A change happening just before the helper thread start to wait for
+    // the next change can not be detected. The state is therefore also
+    // checked at a low rate from the main loop.
+  pin_resync_timer = new Timer(PIN_RESYNC_INTERVAL, Timer::TYPE_PERIODIC);
+  pin_resync_timer->expired.connect(
+      mem_fun(*this, &SerialDevice::resyncPins));
+
+  pin_watch_cnt = 1;
+  return true;
+} /* SerialDevice::addPinWatcher */
+
+
+void SerialDevice::removePinWatcher(void)
+{
+  if ((pin_watch_cnt > 0) && (--pin_watch_cnt == 0))
+  {
+    stopPinWatch();
+  }
+} /* SerialDevice::removePinWatcher */
+
+
 
 /****************************************************************************
  *
@@ -221,14 +294,18 @@ bool SerialDevice::close(SerialDevice *dev)
  */
 SerialDevice::SerialDevice(const string& port)
   : port_name(port), use_count(0), fd(-1), old_port_settings(),
-    rd_watch(0), restore_on_close(false)
+    rd_watch(0), restore_on_close(false), pin_watch_cnt(0), pin_thread(),
+    pin_notify_watch(0), pin_resync_timer(0), pin_state(0),
+    pin_state_reported(0)
 {
+  pin_notify_pipe[0] = pin_notify_pipe[1] = -1;
   
 } /* SerialDevice::SerialDevice */
 
 
 SerialDevice::~SerialDevice(void)
 {
+  stopPinWatch();
   delete rd_watch;
 } /* SerialDevice::~SerialDevice */
 
@@ -272,6 +349,10 @@ bool SerialDevice::openPort(bool flush)
 
 bool SerialDevice::closePort(void)
 {
+    // The helper thread must not use the file descriptor after it is closed
+  stopPinWatch();
+  pin_watch_cnt = 0;
+
   if (restore_on_close)
   {
     if (tcsetattr(fd, TCSANOW, &old_port_settings) == -1)
@@ -315,6 +396,103 @@ void SerialDevice::onIncomingData(FdWatch *watch)
 } /* SerialDevice::onIncomingData */
 
 
+void SerialDevice::stopPinWatch(void)
+{
+  if (pin_notify_watch == 0)
+  {
+    return;
+  }
+
+  pthread_cancel(pin_thread);
+  pthread_join(pin_thread, NULL);
+
+  delete pin_resync_timer;
+  pin_resync_timer = 0;
+  delete pin_notify_watch;
+  pin_notify_watch = 0;
+  ::close(pin_notify_pipe[0]);
+  ::close(pin_notify_pipe[1]);
+  pin_notify_pipe[0] = pin_notify_pipe[1] = -1;
+} /* SerialDevice::stopPinWatch */
+
+
+void *SerialDevice::pinWatchThread(void *data)
+{
+  SerialDevice *dev = reinterpret_cast<SerialDevice*>(data);
+  const int mask = MODEM_INPUT_PINS;
+  int last_pins = dev->pin_state & mask;
+#ifdef TIOCMIWAIT
+  bool use_miwait = true;
+#endif
+  for (;;)
+  {
+    int pins = 0;
+    if (ioctl(dev->fd, TIOCMGET, &pins) == 0)
+    {
+      pins &= mask;
+      if (pins != last_pins)
+      {
+        last_pins = pins;
+        dev->pin_state = pins;
+          // If the pipe is full there already is an unread notification
+        if (::write(dev->pin_notify_pipe[1], "P", 1) == -1) {}
+      }
+    }
+
+#ifdef TIOCMIWAIT
+    if (use_miwait)
+    {
+        // The ioctl is not a cancellation point so asynchronous
+        // cancellation is enabled while blocking in it
+      int oldtype;
+      pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
+      int ret = ioctl(dev->fd, TIOCMIWAIT, mask);
+      int errno_tmp = errno;
+      pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, &oldtype);
+      if ((ret == 0) || (errno_tmp == EINTR))
+      {
+        continue;
+      }
+        // Not supported by the driver so fall back to polling
+      use_miwait = false;
+    }
+#endif
+
+    usleep(PIN_POLL_INTERVAL_US);
+  }
+
+  return NULL;
+} /* SerialDevice::pinWatchThread */
+
+
+void SerialDevice::onPinNotify(FdWatch *watch)
+{
+  char buf[32];
+  while (::read(watch->fd(), buf, sizeof(buf)) > 0) {}
+  reportPins(pin_state);
+} /* SerialDevice::onPinNotify */
+
+
+void SerialDevice::resyncPins(Timer *t)
+{
+  int pins = 0;
+  if (ioctl(fd, TIOCMGET, &pins) == 0)
+  {
+    reportPins(pins & MODEM_INPUT_PINS);
+  }
+} /* SerialDevice::resyncPins */
+
+
+void SerialDevice::reportPins(int pins)
+{
+  if (pins != pin_state_reported)
+  {
+    pin_state_reported = pins;
+    pinsChanged(pins);
+  }
+} /* SerialDevice::reportPins */
+
+
 
 
 
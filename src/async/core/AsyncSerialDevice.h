@@ -41,9 +41,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <sigc++/sigc++.h>
 #include <termios.h>
+#include <pthread.h>
 
 #include <string>
 #include <map>
+#include <atomic>
 
 
 /****************************************************************************
@@ -87,6 +89,7 @@ namespace Async
  ****************************************************************************/
 
 class FdWatch;
+class Timer;
   
 
 /****************************************************************************
@@ -167,11 +170,46 @@ class SerialDevice : public sigc::trackable
      * but the null is not included in the count.
      */
     sigc::signal<void, char*, int> charactersReceived;
+
+    /**
+     * @brief   Start watching the modem status input pins
+     * @return  Returns \em true on success or \em false on failure
+     *
+     * The first call to this function start a helper thread that wait for
+     * changes on the CTS, DSR, DCD and RI pins using the TIOCMIWAIT ioctl,
+     * or poll them if the driver does not support that ioctl. Changes are
+     * forwarded to the main loop and emitted through the pinsChanged
+     * signal. All users of the port share the same helper thread.
+     */
+    bool addPinWatcher(void);
+
+    /**
+     * @brief   Stop watching the modem status input pins
+     *
+     * Each call to addPinWatcher must be matched by a call to this
+     * function. The helper thread is stopped when the last user is gone.
+     */
+    void removePinWatcher(void);
+
+    /**
+     * @brief   Get the last reported state of the modem status input pins
+     * @return  Returns the pin state as a bit mask of TIOCM_* flags
+     */
+    int pinState(void) const { return pin_state_reported; }
+
+    /**
+     * @brief   A signal that is emitted when a modem status pin change
+     * @param   pins The new pin state as a bit mask of TIOCM_* flags
+     */
+    sigc::signal<void, int> pinsChanged;
     
     
   protected:
     
   private:
+    static const int        PIN_RESYNC_INTERVAL   = 1000;
+    static const unsigned   PIN_POLL_INTERVAL_US  = 10000;
+
     static std::map<std::string, SerialDevice *>  dev_map;
     
     std::string     port_name;
@@ -180,12 +218,24 @@ class SerialDevice : public sigc::trackable
     struct termios  old_port_settings;
     FdWatch   	    *rd_watch;
     bool            restore_on_close;
+    int             pin_watch_cnt;
+    pthread_t       pin_thread;
+    int             pin_notify_pipe[2];
+    FdWatch         *pin_notify_watch;
+    Timer           *pin_resync_timer;
+    std::atomic<int> pin_state;
+    int             pin_state_reported;
     
     SerialDevice(const std::string& port);
     ~SerialDevice(void);
     bool openPort(bool flush);
     bool closePort(void);
     void onIncomingData(FdWatch *watch);
+    void stopPinWatch(void);
+    static void *pinWatchThread(void *data);
+    void onPinNotify(FdWatch *watch);
+    void resyncPins(Timer *t);
+    void reportPins(int pins);
   
     
 };  /* class SerialDevice */
@@ -42,6 +42,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -163,8 +164,8 @@ const char *TcpConnection::disconnectReasonStr(DisconnectReason reason)
  *------------------------------------------------------------------------
  */
 TcpConnection::TcpConnection(size_t recv_buf_len)
-  : remote_port(0), recv_buf_len(recv_buf_len), sock(-1), rd_watch(0),
-    wr_watch(0), recv_buf(0), recv_buf_cnt(0)
+  : remote_port(0), recv_buf_len(recv_buf_len), recv_buf_max_len(0),
+    sock(-1), rd_watch(0), wr_watch(0), recv_buf(0), recv_buf_cnt(0)
 {
   recv_buf = new char[recv_buf_len];
   rd_watch = new FdWatch;
@@ -177,8 +178,8 @@ TcpConnection::TcpConnection(size_t recv_buf_len)
 TcpConnection::TcpConnection(int sock, const IpAddress& remote_addr,
       	      	      	     uint16_t remote_port, size_t recv_buf_len)
   : remote_addr(remote_addr), remote_port(remote_port),
-    recv_buf_len(recv_buf_len), sock(sock), rd_watch(0), wr_watch(0),
-    recv_buf(0), recv_buf_cnt(0)
+    recv_buf_len(recv_buf_len), recv_buf_max_len(0), sock(sock), rd_watch(0),
+    wr_watch(0), recv_buf(0), recv_buf_cnt(0)
 {
   recv_buf = new char[recv_buf_len];
   rd_watch = new FdWatch;
@@ -213,6 +214,12 @@ void TcpConnection::setRecvBufLen(size_t recv_buf_len)
 } /* TcpConnection::setRecvBufLen */
 
 
+void TcpConnection::setMaxRecvBufLen(size_t max_len)
+{
+  recv_buf_max_len = max_len;
+} /* TcpConnection::setMaxRecvBufLen */
+
+
 void TcpConnection::disconnect(void)
 {
   recv_buf_cnt = 0;
@@ -252,6 +259,40 @@ int TcpConnection::write(const void *buf, int count)
 } /* TcpConnection::write */
 
 
+int TcpConnection::write(const struct iovec *iov, int iovcnt)
+{
+  assert(sock != -1);
+  int count = 0;
+  for (int i=0; i<iovcnt; ++i)
+  {
+    count += iov[i].iov_len;
+  }
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = const_cast<struct iovec*>(iov);
+  msg.msg_iovlen = iovcnt;
+  int cnt = ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+  if (cnt < 0)
+  {
+    if (errno != EAGAIN)
+    {
+      return -1;
+    }
+    cnt = 0;
+  }
+
+  if (cnt < count)
+  {
+    sendBufferFull(true);
+    wr_watch->setEnabled(true);
+  }
+
+  return cnt;
+
+} /* TcpConnection::write */
+
+
 
 /****************************************************************************
  *
@@ -345,14 +386,33 @@ void TcpConnection::recvHandler(FdWatch *watch)
   //cout << "recv_buf_cnt=" << recv_buf_cnt << endl;
   //cout << "recv_buf_len=" << recv_buf_len << endl;
   
+  size_t max_len = max(recv_buf_len, recv_buf_max_len);
   if (recv_buf_cnt == recv_buf_len)
   {
-    disconnect();
-    onDisconnected(DR_RECV_BUFFER_OVERFLOW);
-    return;
+    if (recv_buf_len >= max_len)
+    {
+      disconnect();
+      onDisconnected(DR_RECV_BUFFER_OVERFLOW);
+      return;
+    }
+    growRecvBuf(recv_buf_len + 1);
   }
-  
-  int cnt = read(sock, recv_buf+recv_buf_cnt, recv_buf_len-recv_buf_cnt);
+
+    // If the receive buffer is allowed to grow, data that does not fit in
+    // the buffer is read into a temporary buffer in the same system call.
+    // The receive buffer is then grown to make room for it.
+  char extra_buf[RECV_EXTRA_BUF_LEN];
+  struct iovec iov[2];
+  iov[0].iov_base = recv_buf + recv_buf_cnt;
+  iov[0].iov_len = recv_buf_len - recv_buf_cnt;
+  int iovcnt = 1;
+  if (max_len > recv_buf_len)
+  {
+    iov[1].iov_base = extra_buf;
+    iov[1].iov_len = min(max_len - recv_buf_len, sizeof(extra_buf));
+    iovcnt = 2;
+  }
+  int cnt = readv(sock, iov, iovcnt);
   if (cnt == -1)
   {
     int errno_tmp = errno;
@@ -368,8 +428,21 @@ void TcpConnection::recvHandler(FdWatch *watch)
     onDisconnected(DR_REMOTE_DISCONNECTED);
     return;
   }
-  
+
+  size_t extra_cnt = 0;
+  if (static_cast<size_t>(cnt) > iov[0].iov_len)
+  {
+    extra_cnt = cnt - iov[0].iov_len;
+    cnt = iov[0].iov_len;
+  }
   recv_buf_cnt += cnt;
+  if (extra_cnt > 0)
+  {
+    growRecvBuf(recv_buf_cnt + extra_cnt);
+    memcpy(recv_buf + recv_buf_cnt, extra_buf, extra_cnt);
+    recv_buf_cnt += extra_cnt;
+  }
+
   size_t processed = onDataReceived(recv_buf, recv_buf_cnt);
   //cout << "processed=" << processed << endl;
   if (processed >= recv_buf_cnt)
@@ -392,6 +465,19 @@ void TcpConnection::writeHandler(FdWatch *watch)
 } /* TcpConnection::writeHandler */
 
 
+void TcpConnection::growRecvBuf(size_t min_len)
+{
+    // Double the buffer size to not have to grow it too often
+  size_t max_len = max(recv_buf_len, recv_buf_max_len);
+  size_t new_len = max(min_len, min(2 * recv_buf_len, max_len));
+  char *new_recv_buf = new char[new_len];
+  memcpy(new_recv_buf, recv_buf, recv_buf_cnt);
+  delete [] recv_buf;
+  recv_buf = new_recv_buf;
+  recv_buf_len = new_len;
+} /* TcpConnection::growRecvBuf */
+
+
 
 /*
  * This file has not been truncated
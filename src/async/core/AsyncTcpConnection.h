@@ -39,6 +39,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <sys/uio.h>
 #include <sigc++/sigc++.h>
 #include <stdint.h>
 
@@ -179,6 +180,20 @@ class TcpConnection : public sigc::trackable
      */
     void setRecvBufLen(size_t recv_buf_len);
 
+    /**
+     * @brief   Allow the receive buffer to grow
+     * @param   max_len The maximum receive buffer size in bytes
+     *
+     * By default the receive buffer have a fixed size and a receive buffer
+     * overflow disconnection is issued if it get full. Use this function on
+     * connections that stream a lot of data to let the buffer grow, up to
+     * max_len bytes, when more data is available than fit in the buffer. All
+     * data that is available, up to the maximum buffer size, is then read
+     * using one system call so that the number of reads does not grow with
+     * the data rate.
+     */
+    void setMaxRecvBufLen(size_t max_len);
+
     /**
      * @brief 	Disconnect from the remote host
      *
@@ -195,6 +210,19 @@ class TcpConnection : public sigc::trackable
      * @return	Returns the number of bytes written or -1 on failure
      */
     virtual int write(const void *buf, int count);
+
+    /**
+     * @brief 	Write scattered data to the TCP connection
+     * @param 	iov     An array of buffers to send, in order
+     * @param 	iovcnt  The number of elements in the iov array
+     * @return	Returns the number of bytes written or -1 on failure
+     *
+     * This function works like the buffer variant of write but gathers the
+     * data from a number of buffers using a single system call. That way a
+     * message header and a separately stored payload can be sent without
+     * first copying them into one contiguous buffer.
+     */
+    virtual int write(const struct iovec *iov, int iovcnt);
     
     /**
      * @brief 	Return the IP-address of the remote host
@@ -325,9 +353,12 @@ class TcpConnection : public sigc::trackable
   private:
     friend class TcpClientBase;
 
+    static const size_t RECV_EXTRA_BUF_LEN = 65536;
+
     IpAddress remote_addr;
     uint16_t  remote_port;
     size_t    recv_buf_len;
+    size_t    recv_buf_max_len;
     int       sock;
     FdWatch * rd_watch;
     FdWatch * wr_watch;
@@ -336,6 +367,7 @@ class TcpConnection : public sigc::trackable
     
     void recvHandler(FdWatch *watch);
     void writeHandler(FdWatch *watch);
+    void growRecvBuf(size_t min_len);
 
 };  /* class TcpConnection */
 
@@ -37,6 +37,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <netdb.h>
 #include <netinet/tcp.h>
 #include <iostream>
+#include <cerrno>
 #include <stdio.h>
 #include <algorithm>
 #include <cassert>
@@ -125,7 +126,7 @@ void delete_connection(TcpConnection *con);
 
 TcpServerBase::TcpServerBase(const string& port_str,
                              const Async::IpAddress &bind_ip)
-  : sock(-1), rd_watch(0)
+  : sock(-1), rd_watch(0), max_pending(0)
 {
   if ((sock = socket(AF_INET, SOCK_STREAM, 0)) == -1)
   {
@@ -194,13 +195,24 @@ TcpServerBase::TcpServerBase(const string& port_str,
     return;
   }
 
-  if (listen(sock, 5) != 0)
+    // Use a long backlog so that connection attempts can queue up while
+    // the server is busy or admission is closed
+  if (listen(sock, SOMAXCONN) != 0)
   {
     perror("listen");
     cleanup();
     return;
   }
 
+    // Accept must not block since all waiting connections are accepted in
+    // a loop
+  if (fcntl(sock, F_SETFL, O_NONBLOCK) == -1)
+  {
+    perror("fcntl(sock, F_SETFL)");
+    cleanup();
+    return;
+  }
+
   rd_watch = new FdWatch(sock, FdWatch::FD_WATCH_RD);
   rd_watch->activity.connect(mem_fun(*this, &TcpServerBase::onConnection));
     
@@ -287,6 +299,29 @@ int TcpServerBase::writeExcept(TcpConnection *con, const void *buf, int count)
 } /* TcpServerBase::writeExcept */
 
 
+void TcpServerBase::setMaxPendingConnections(unsigned max_pending)
+{
+  this->max_pending = max_pending;
+  if (max_pending == 0)
+  {
+    pendingConList.clear();
+  }
+  updateAdmission();
+} /* TcpServerBase::setMaxPendingConnections */
+
+
+void TcpServerBase::connectionAdmitted(TcpConnection *con)
+{
+  TcpConnectionList::iterator it;
+  it = find(pendingConList.begin(), pendingConList.end(), con);
+  if (it != pendingConList.end())
+  {
+    pendingConList.erase(it);
+    updateAdmission();
+  }
+} /* TcpServerBase::connectionAdmitted */
+
+
 /****************************************************************************
  *
  * Protected member functions
@@ -296,6 +331,11 @@ int TcpServerBase::writeExcept(TcpConnection *con, const void *buf, int count)
 void TcpServerBase::addConnection(TcpConnection *con)
 {
   tcpConnectionList.push_back(con);
+  if (max_pending > 0)
+  {
+    pendingConList.push_back(con);
+    updateAdmission();
+  }
 } /* TcpServerBase::addConnection */
 
 
@@ -305,6 +345,12 @@ void TcpServerBase::removeConnection(TcpConnection *con)
   it = find(tcpConnectionList.begin(), tcpConnectionList.end(), con);
   assert(it != tcpConnectionList.end());
   tcpConnectionList.erase(it);
+  it = find(pendingConList.begin(), pendingConList.end(), con);
+  if (it != pendingConList.end())
+  {
+    pendingConList.erase(it);
+    updateAdmission();
+  }
   Application::app().runTask(sigc::bind(sigc::ptr_fun(&delete_connection), con));
 } /* TcpServerBase::onDisconnected */
 
@@ -333,28 +379,59 @@ void TcpServerBase::cleanup(void)
     delete *it;
   }
   tcpConnectionList.clear();
+  pendingConList.clear();
   
 } /* TcpServerBase::cleanup */
 
 
 void TcpServerBase::onConnection(FdWatch *watch)
+{
+    // Accept all waiting connections on one wakeup. The number is limited
+    // so that other file descriptors are not starved during a connection
+    // storm.
+  for (int i=0; (i<MAX_ACCEPT_PER_EVENT) && admissionOpen(); ++i)
+  {
+    if (!acceptConnection())
+    {
+      break;
+    }
+  }
+} /* TcpServerBase::onConnection */
+
+
+bool TcpServerBase::acceptConnection(void)
 {
   int client_sock;
   struct sockaddr_in client;
   socklen_t addrlen = sizeof(client);
+#if defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+    // Set close on exec and non-blocking mode in the same system call
+  client_sock = accept4(sock, (struct sockaddr *)&client, &addrlen,
+                        SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
   client_sock = accept(sock, (struct sockaddr *)&client, &addrlen);
+#endif
   if (client_sock == -1)
   {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+    {
+      return false;
+    }
+    if ((errno == ECONNABORTED) || (errno == EINTR))
+    {
+      return true;
+    }
     perror("accept");
-    return;
+    return false;
   }
-  
+
+#if !defined(SOCK_NONBLOCK) || !defined(SOCK_CLOEXEC)
     // Force close on exec
   if (fcntl(client_sock, F_SETFD, 1) == -1)
   {
     perror("fcntl(F_SETFD)");
     close(client_sock);
-    return;
+    return true;
   }
   
     // Write must not block!
@@ -362,8 +439,9 @@ void TcpServerBase::onConnection(FdWatch *watch)
   {
     perror("fcntl(client_sock, F_SETFL)");
     close(client_sock);
-    return;
+    return true;
   }
+#endif
   
     // Send small packets at once
   const int on = 1;
@@ -372,13 +450,29 @@ void TcpServerBase::onConnection(FdWatch *watch)
   {
     perror("setsockopt(client_sock, TCP_NODELAY)");
     close(client_sock);
-    return;
+    return true;
   }
   
     // Create client object, add signal handling, add to client list
   createConnection(client_sock, IpAddress(client.sin_addr),
                    ntohs(client.sin_port));
-} /* TcpServerBase::onConnection */
+  return true;
+} /* TcpServerBase::acceptConnection */
+
+
+bool TcpServerBase::admissionOpen(void) const
+{
+  return (max_pending == 0) || (pendingConList.size() < max_pending);
+} /* TcpServerBase::admissionOpen */
+
+
+void TcpServerBase::updateAdmission(void)
+{
+  if (rd_watch != 0)
+  {
+    rd_watch->setEnabled(admissionOpen());
+  }
+} /* TcpServerBase::updateAdmission */
 
 
 namespace {
@@ -164,6 +164,36 @@ class TcpServerBase : public sigc::trackable
      */
     int writeExcept(TcpConnection *con, const void *buf, int count);
 
+    /**
+     * @brief   Limit the number of connections waiting to be admitted
+     * @param   max_pending The maximum number of pending connections (0=off)
+     *
+     * Newly accepted connections are considered pending until the
+     * application call connectionAdmitted for them, typically when a
+     * login handshake has been completed. When the limit is reached, no more
+     * connections are accepted until a pending connection is admitted or
+     * disconnected. Connection attempts arriving meanwhile are queued in the
+     * listen backlog of the operating system. This way a large number of
+     * clients reconnecting at the same time are let in a few at a time
+     * instead of all being handled in one go.
+     */
+    void setMaxPendingConnections(unsigned max_pending);
+
+    /**
+     * @brief   Tell the server that a pending connection has been admitted
+     * @param   con The connection that is no longer pending
+     *
+     * Calling this function for a connection that is not pending is allowed
+     * and has no effect.
+     */
+    void connectionAdmitted(TcpConnection *con);
+
+    /**
+     * @brief   Get the number of connections waiting to be admitted
+     * @return  Returns the number of pending connections
+     */
+    unsigned pendingConnections(void) const { return pendingConList.size(); }
+
   protected:
     virtual void createConnection(int sock, const IpAddress& remote_addr,
                                   uint16_t remote_port) = 0;
@@ -173,12 +203,19 @@ class TcpServerBase : public sigc::trackable
   private:
     typedef std::vector<TcpConnection*> TcpConnectionList;
 
+    static const int MAX_ACCEPT_PER_EVENT = 64;
+
     int       	      sock;
     FdWatch   	      *rd_watch;
     TcpConnectionList tcpConnectionList;
+    TcpConnectionList pendingConList;
+    unsigned          max_pending;
 
     void cleanup(void);
     void onConnection(FdWatch *watch);
+    bool acceptConnection(void);
+    bool admissionOpen(void) const;
+    void updateAdmission(void);
 
 };  /* class TcpServerBase */
 
@@ -0,0 +1,327 @@
+/**
+@file   AsyncThreadScheduling.cpp
+@brief  Configure CPU affinity and scheduling policy for thread roles
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncConfig.h"
+#include "AsyncThreadScheduling.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+ThreadScheduling::RoleParams ThreadScheduling::m_params[ROLE_COUNT];
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+bool ThreadScheduling::configure(Config& cfg, const std::string& section)
+{
+  bool success = true;
+  for (int i=0; i<ROLE_COUNT; ++i)
+  {
+    RoleParams& params = m_params[i];
+    params = RoleParams();
+    params.has_sched = false;
+    params.policy = SCHED_OTHER;
+    params.priority = 0;
+    params.warned = false;
+
+    string var = string("SCHED_") + roleName(Role(i));
+    string value;
+    if (cfg.getValue(section, var, value) && !parseSched(value, params))
+    {
+      cerr << "*** ERROR: Illegal value for configuration variable "
+           << section << "/" << var << "=" << value << ". Valid values are "
+           << "OTHER, FIFO:<prio> or RR:<prio>.\n";
+      success = false;
+    }
+
+    var = string("CPU_AFFINITY_") + roleName(Role(i));
+    if (cfg.getValue(section, var, value) && !parseCpus(value, params.cpus))
+    {
+      cerr << "*** ERROR: Illegal value for configuration variable "
+           << section << "/" << var << "=" << value << ". The value should "
+           << "be a comma separated list of CPU numbers or ranges, like "
+           << "0,2-3.\n";
+      success = false;
+    }
+  }
+  if (!success)
+  {
+    return false;
+  }
+
+  bool lock_memory = false;
+  cfg.getValue(section, "MLOCKALL", lock_memory);
+  if (lock_memory && (mlockall(MCL_CURRENT | MCL_FUTURE) != 0))
+  {
+    cerr << "*** WARNING: Could not lock memory (" << section
+         << "/MLOCKALL): " << strerror(errno) << endl;
+  }
+
+  applyToCurrentThread(ROLE_MAIN);
+
+  return true;
+} /* ThreadScheduling::configure */
+
+
+bool ThreadScheduling::isConfigured(Role role)
+{
+  const RoleParams& params = m_params[role];
+  return params.has_sched || !params.cpus.empty();
+} /* ThreadScheduling::isConfigured */
+
+
+void ThreadScheduling::applyToCurrentThread(Role role)
+{
+  RoleParams& params = m_params[role];
+
+  if (!params.cpus.empty())
+  {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (size_t i=0; i<params.cpus.size(); ++i)
+    {
+      CPU_SET(params.cpus[i], &cpu_set);
+    }
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
+                                     &cpu_set);
+    if ((err != 0) && !params.warned)
+    {
+      cerr << "*** WARNING: Could not set the CPU affinity for the "
+           << roleName(role) << " thread(s): " << strerror(err) << endl;
+      params.warned = true;
+    }
+  }
+
+  if (params.has_sched)
+  {
+    sched_param param;
+    param.sched_priority = params.priority;
+    int err = pthread_setschedparam(pthread_self(), params.policy, &param);
+    if ((err != 0) && !params.warned)
+    {
+      cerr << "*** WARNING: Could not set the scheduling policy for the "
+           << roleName(role) << " thread(s): " << strerror(err) << endl;
+      params.warned = true;
+    }
+  }
+} /* ThreadScheduling::applyToCurrentThread */
+
+
+const char *ThreadScheduling::roleName(Role role)
+{
+  switch (role)
+  {
+    case ROLE_MAIN:       return "MAIN";
+    case ROLE_AUDIO_IO:   return "AUDIO_IO";
+    case ROLE_SDR:        return "SDR";
+    case ROLE_NET_IO:     return "NET_IO";
+    case ROLE_DNS:        return "DNS";
+    case ROLE_FILE_IO:    return "FILE_IO";
+    case ROLE_DSP:        return "DSP";
+    default:              return "?";
+  }
+} /* ThreadScheduling::roleName */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+bool ThreadScheduling::parseSched(const std::string& str, RoleParams& params)
+{
+  string policy_str(str);
+  string prio_str;
+  string::size_type colon = str.find(':');
+  if (colon != string::npos)
+  {
+    policy_str = str.substr(0, colon);
+    prio_str = str.substr(colon + 1);
+  }
+
+  if (policy_str == "OTHER")
+  {
+    params.policy = SCHED_OTHER;
+  }
+  else if (policy_str == "FIFO")
+  {
+    params.policy = SCHED_FIFO;
+  }
+  else if (policy_str == "RR")
+  {
+    params.policy = SCHED_RR;
+  }
+  else
+  {
+    return false;
+  }
+
+  params.priority = sched_get_priority_min(params.policy);
+  if (!prio_str.empty())
+  {
+    istringstream is(prio_str);
+    if (!(is >> params.priority) || !is.eof() ||
+        (params.priority < sched_get_priority_min(params.policy)) ||
+        (params.priority > sched_get_priority_max(params.policy)))
+    {
+      return false;
+    }
+  }
+  params.has_sched = true;
+
+  return true;
+} /* ThreadScheduling::parseSched */
+
+
+bool ThreadScheduling::parseCpus(const std::string& str,
+                                 std::vector<int>& cpus)
+{
+  cpus.clear();
+  istringstream is(str);
+  string range;
+  while (getline(is, range, ','))
+  {
+    int first = -1;
+    int last = -1;
+    char dash = '-';
+    istringstream rs(range);
+    if (!(rs >> first))
+    {
+      return false;
+    }
+    last = first;
+    if (!rs.eof() && (!(rs >> dash >> last) || (dash != '-')))
+    {
+      return false;
+    }
+    if ((first < 0) || (last < first) || (last >= CPU_SETSIZE))
+    {
+      return false;
+    }
+    for (int cpu=first; cpu<=last; ++cpu)
+    {
+      cpus.push_back(cpu);
+    }
+  }
+
+  return !cpus.empty();
+} /* ThreadScheduling::parseCpus */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,216 @@
+/**
+@file   AsyncThreadScheduling.h
+@brief  Configure CPU affinity and scheduling policy for thread roles
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that read CPU affinity and scheduling settings for
+the different kinds of threads in an application from the configuration and
+apply them to the threads when they start.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_THREAD_SCHEDULING_INCLUDED
+#define ASYNC_THREAD_SCHEDULING_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <string>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class Config;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	CPU affinity and scheduling policy for thread roles
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+The threads in an application are grouped into roles, like the main event
+loop thread or the audio I/O threads. For each role, the configuration may
+specify which CPUs the threads may run on and what scheduling policy and
+priority to use. The configuration is read by calling the configure function
+when the application starts, before any other threads are started. Each
+thread then call applyToCurrentThread with its role as the first thing it
+does.
+
+The configuration variables, read from the given section, are:
+
+  CPU_AFFINITY_<ROLE>=0,2-3
+  SCHED_<ROLE>=FIFO:50
+  MLOCKALL=1
+
+The scheduling policy is one of OTHER, FIFO or RR, optionally followed by a
+colon and the priority. The role names are MAIN, AUDIO_IO, SDR, NET_IO, DNS,
+FILE_IO and DSP.
+*/
+class ThreadScheduling
+{
+  public:
+    /**
+     * @brief The thread roles
+     */
+    typedef enum
+    {
+      ROLE_MAIN,      ///< The thread running the main event loop
+      ROLE_AUDIO_IO,  ///< Audio device I/O threads
+      ROLE_SDR,       ///< SDR dongle reader threads
+      ROLE_NET_IO,    ///< Network I/O worker threads
+      ROLE_DNS,       ///< DNS resolver worker threads
+      ROLE_FILE_IO,   ///< File I/O worker threads
+      ROLE_DSP,       ///< Audio processing worker threads
+      ROLE_COUNT
+    } Role;
+
+    /**
+     * @brief   Read the configuration and apply it to the calling thread
+     * @param   cfg     The configuration to read from
+     * @param   section The name of the configuration section to read
+     * @return  Returns \em true on success or \em false on a config error
+     *
+     * This function should be called from the main thread before any other
+     * threads are started. The settings for the MAIN role are applied to the
+     * calling thread and all memory is locked if MLOCKALL is set.
+     */
+    static bool configure(Config& cfg, const std::string& section);
+
+    /**
+     * @brief   Check if anything have been configured for a role
+     * @param   role The role to check
+     * @return  Returns \em true if affinity or scheduling is set for the role
+     */
+    static bool isConfigured(Role role);
+
+    /**
+     * @brief   Apply the settings for a role to the calling thread
+     * @param   role The role of the calling thread
+     *
+     * A warning is printed, once for each role, if the settings could not be
+     * applied. That is usually because the process is not permitted to use
+     * realtime scheduling. The thread then continue with the scheduling it
+     * already had.
+     */
+    static void applyToCurrentThread(Role role);
+
+    /**
+     * @brief   Get the name of a role
+     * @param   role The role
+     * @return  Returns the name used in the configuration variables
+     */
+    static const char *roleName(Role role);
+
+  private:
+    struct RoleParams
+    {
+      bool              has_sched;
+      int               policy;
+      int               priority;
+      std::vector<int>  cpus;
+      bool              warned;
+    };
+
+    static RoleParams m_params[ROLE_COUNT];
+
+    static bool parseSched(const std::string& str, RoleParams& params);
+    static bool parseCpus(const std::string& str, std::vector<int>& cpus);
+
+    ThreadScheduling(void);
+
+};  /* class ThreadScheduling */
+
+
+} /* namespace */
+
+#endif /* ASYNC_THREAD_SCHEDULING_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -81,6 +81,15 @@ An example of how to use the Async::Timer class
 namespace Async
 {
 
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class TimerWheel;
+
+
 /****************************************************************************
  *
  * Defines & typedefs
@@ -213,9 +222,19 @@ class Timer : public sigc::trackable
   protected:
     
   private:
-    Type  m_type;
-    int   m_timeout_ms;
-    bool  m_is_enabled;
+    friend class TimerWheel;
+
+    Type                m_type;
+    int                 m_timeout_ms;
+    bool                m_is_enabled;
+
+      // Bookkeeping used by the timer wheel in the application main loop.
+      // A timer is its own list node so that no allocation is needed when
+      // a timer is started, restarted or stopped.
+    Timer*              m_wheel_next;
+    Timer**             m_wheel_pprev;
+    unsigned long long  m_wheel_expire;
+    int                 m_wheel_slot;
   
 };  /* class Timer */
 
@@ -37,6 +37,8 @@
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -45,6 +47,8 @@
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
+#include <algorithm>
+#include <iostream>
 
 
 /****************************************************************************
@@ -95,15 +99,26 @@ using namespace Async;
 class UdpPacket
 {
   public:
-    const IpAddress ip;
-    int       	    port;
-    char    	    buf[65535];
-    int       	    len;
+    const IpAddress   ip;
+    int       	      port;
+    std::vector<char> buf;
     
     UdpPacket(const IpAddress& ip, int port, const void *buf, int len)
-      : ip(ip), port(port), len(len)
+      : ip(ip), port(port),
+        buf(reinterpret_cast<const char*>(buf),
+            reinterpret_cast<const char*>(buf) + len)
     {
-      memcpy(this->buf, buf, len);
+    }
+    UdpPacket(const IpAddress& ip, int port, const struct iovec *iov,
+              int iovcnt)
+      : ip(ip), port(port)
+    {
+      for (int i=0; i<iovcnt; ++i)
+      {
+        const char *ptr = reinterpret_cast<const char*>(iov[i].iov_base);
+        buf.insert(buf.end(), ptr, ptr + iov[i].iov_len);
+      }
+      assert(buf.size() <= 65535);
     }
   
 };
@@ -132,6 +147,7 @@ class UdpPacket
  *
  ****************************************************************************/
 
+static const unsigned MAX_RECV_BATCH_SIZE = 64;
 
 
 /****************************************************************************
@@ -154,7 +170,8 @@ class UdpPacket
  *------------------------------------------------------------------------
  */
 UdpSocket::UdpSocket(uint16_t local_port, const IpAddress &bind_ip)
-  : sock(-1), rd_watch(0), wr_watch(0), send_buf(0)
+  : sock(-1), rd_watch(0), wr_watch(0), max_send_queue_len(1),
+    recv_batch_size(1), recv_max_size(0), recv_gro(false), deleted(0)
 {
   struct sockaddr_in addr;
   
@@ -214,6 +231,10 @@ UdpSocket::UdpSocket(uint16_t local_port, const IpAddress &bind_ip)
 
 UdpSocket::~UdpSocket(void)
 {
+  if (deleted != 0)
+  {
+    *deleted = true;
+  }
   cleanup();
 } /* UdpSocket::~UdpSocket */
 
@@ -221,9 +242,12 @@ UdpSocket::~UdpSocket(void)
 bool UdpSocket::write(const IpAddress& remote_ip, int remote_port,
     const void *buf, int count)
 {
-  if (send_buf != 0)
+  struct iovec iov;
+  iov.iov_base = const_cast<void*>(buf);
+  iov.iov_len = count;
+  if (!send_queue.empty())
   {
-    return false;
+    return queuePacket(remote_ip, remote_port, &iov, 1);
   }
   
   struct sockaddr_in addr;
@@ -236,13 +260,11 @@ bool UdpSocket::write(const IpAddress& remote_ip, int remote_port,
   {
     if (errno == EAGAIN)
     {
-      send_buf = new UdpPacket(remote_ip, remote_port, buf, count);
-      wr_watch->setEnabled(true);
-      sendBufferFull(true);
-      return true;
+      return queuePacket(remote_ip, remote_port, &iov, 1);
     }
     else
     {
+      send_stats.errors += 1;
       perror("sendto in UdpSocket::write");
       return false;
     }
@@ -254,6 +276,177 @@ bool UdpSocket::write(const IpAddress& remote_ip, int remote_port,
 } /* UdpSocket::write */
 
 
+bool UdpSocket::write(const IpAddress& remote_ip, int remote_port,
+                      const struct iovec *iov, int iovcnt)
+{
+  if (!send_queue.empty())
+  {
+    return queuePacket(remote_ip, remote_port, iov, iovcnt);
+  }
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(remote_port);
+  addr.sin_addr = remote_ip.ip4Addr();
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = &addr;
+  msg.msg_namelen = sizeof(addr);
+  msg.msg_iov = const_cast<struct iovec *>(iov);
+  msg.msg_iovlen = iovcnt;
+  int ret = sendmsg(sock, &msg, 0);
+  if (ret == -1)
+  {
+    if (errno == EAGAIN)
+    {
+      return queuePacket(remote_ip, remote_port, iov, iovcnt);
+    }
+    send_stats.errors += 1;
+    perror("sendmsg in UdpSocket::write");
+    return false;
+  }
+
+  return true;
+} /* UdpSocket::write */
+
+
+int UdpSocket::writeBatch(const Datagram *dgrams, int cnt)
+{
+  int sent_cnt = 0;
+  if (send_queue.empty())
+  {
+    sent_cnt = sendDatagrams(sock, dgrams, cnt);
+    if ((sent_cnt < cnt) && (errno != EAGAIN))
+    {
+      send_stats.errors += cnt - sent_cnt;
+      perror("sendmmsg in UdpSocket::writeBatch");
+      return (sent_cnt > 0) ? sent_cnt : -1;
+    }
+  }
+
+    // Queue what could not be sent, in order, as long as there is room
+  while ((sent_cnt < cnt) && (send_queue.size() < max_send_queue_len))
+  {
+    const Datagram& dgram = dgrams[sent_cnt];
+    queuePacket(dgram.ip, dgram.port, dgram.iov, dgram.iovcnt);
+    ++sent_cnt;
+  }
+  send_stats.dropped += cnt - sent_cnt;
+  return sent_cnt;
+} /* UdpSocket::writeBatch */
+
+
+int UdpSocket::sendDatagrams(int sock, const Datagram *dgrams, int cnt)
+{
+#ifdef HAS_SENDMMSG
+  static const int CHUNK_SIZE = 64;
+  struct mmsghdr msgs[CHUNK_SIZE];
+  struct sockaddr_in addrs[CHUNK_SIZE];
+  int sent_cnt = 0;
+  while (sent_cnt < cnt)
+  {
+    int chunk_cnt = std::min(cnt - sent_cnt, CHUNK_SIZE);
+    for (int i=0; i<chunk_cnt; ++i)
+    {
+      const Datagram& dgram = dgrams[sent_cnt + i];
+      memset(&addrs[i], 0, sizeof(addrs[i]));
+      addrs[i].sin_family = AF_INET;
+      addrs[i].sin_port = htons(dgram.port);
+      addrs[i].sin_addr = dgram.ip.ip4Addr();
+      memset(&msgs[i], 0, sizeof(msgs[i]));
+      msgs[i].msg_hdr.msg_name = &addrs[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+      msgs[i].msg_hdr.msg_iov = const_cast<struct iovec *>(dgram.iov);
+      msgs[i].msg_hdr.msg_iovlen = dgram.iovcnt;
+    }
+    int ret = sendmmsg(sock, msgs, chunk_cnt, 0);
+    if (ret == -1)
+    {
+      return sent_cnt;
+    }
+    sent_cnt += ret;
+  }
+  return sent_cnt;
+#else
+  for (int i=0; i<cnt; ++i)
+  {
+    const Datagram& dgram = dgrams[i];
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(dgram.port);
+    addr.sin_addr = dgram.ip.ip4Addr();
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof(addr);
+    msg.msg_iov = const_cast<struct iovec *>(dgram.iov);
+    msg.msg_iovlen = dgram.iovcnt;
+    if (sendmsg(sock, &msg, 0) == -1)
+    {
+      return i;
+    }
+  }
+  return cnt;
+#endif
+} /* UdpSocket::sendDatagrams */
+
+
+void UdpSocket::setRecvBatchSize(unsigned batch_size, size_t max_size)
+{
+  recv_batch_size = std::min(std::max(batch_size, 1U), MAX_RECV_BATCH_SIZE);
+  recv_max_size = max_size;
+  recv_buf.clear();
+#ifdef HAS_RECVMMSG
+  if (recv_batch_size > 1)
+  {
+    recv_buf.resize(recv_batch_size * recvBufSize());
+  }
+#endif
+} /* UdpSocket::setRecvBatchSize */
+
+
+bool UdpSocket::setRecvGro(bool enable)
+{
+#if defined(HAS_RECVMMSG) && defined(UDP_GRO)
+  int val = enable ? 1 : 0;
+  if (setsockopt(sock, IPPROTO_UDP, UDP_GRO, &val, sizeof(val)) == -1)
+  {
+    return !enable;
+  }
+  recv_gro = enable;
+  setRecvBatchSize(recv_batch_size, recv_max_size);
+  return true;
+#else
+  return !enable;
+#endif
+} /* UdpSocket::setRecvGro */
+
+
+bool UdpSocket::setSendBufferSize(int size)
+{
+  if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) == -1)
+  {
+    perror("setsockopt(SO_SNDBUF)");
+    return false;
+  }
+  return true;
+} /* UdpSocket::setSendBufferSize */
+
+
+int UdpSocket::sendBufferSize(void) const
+{
+  int size = 0;
+  socklen_t len = sizeof(size);
+  if (getsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, &len) == -1)
+  {
+    return -1;
+  }
+  return size;
+} /* UdpSocket::sendBufferSize */
+
+
 
 /****************************************************************************
  *
@@ -307,8 +500,12 @@ void UdpSocket::cleanup(void)
   delete wr_watch;
   wr_watch = 0;
   
-  delete send_buf;
-  send_buf = 0;
+  for (std::deque<UdpPacket*>::iterator it = send_queue.begin();
+       it != send_queue.end(); ++it)
+  {
+    delete *it;
+  }
+  send_queue.clear();
   
   if (sock != -1)
   {
@@ -321,8 +518,33 @@ void UdpSocket::cleanup(void)
 } /* UdpSocket::cleanup */
 
 
+bool UdpSocket::queuePacket(const IpAddress& remote_ip, int remote_port,
+                            const struct iovec *iov, int iovcnt)
+{
+  if (send_queue.size() >= max_send_queue_len)
+  {
+    send_stats.dropped += 1;
+    return false;
+  }
+  send_queue.push_back(new UdpPacket(remote_ip, remote_port, iov, iovcnt));
+  send_stats.queued += 1;
+  if (send_queue.size() == 1)
+  {
+    wr_watch->setEnabled(true);
+    sendBufferFull(true);
+  }
+  return true;
+} /* UdpSocket::queuePacket */
+
+
 void UdpSocket::handleInput(FdWatch *watch)
 {
+  if (!recv_buf.empty())
+  {
+    handleInputBatch();
+    return;
+  }
+
   char buf[65536];
   struct sockaddr_in addr;
   socklen_t addr_len = sizeof(addr);
@@ -335,44 +557,171 @@ void UdpSocket::handleInput(FdWatch *watch)
     return;
   }
   
+  if (!batchReceived.empty())
+  {
+    RecvDatagram dgram;
+    dgram.ip = IpAddress(addr.sin_addr);
+    dgram.port = ntohs(addr.sin_port);
+    dgram.buf = buf;
+    dgram.len = len;
+    recv_dgrams.assign(1, dgram);
+    batchReceived(recv_dgrams);
+    return;
+  }
+
   dataReceived(IpAddress(addr.sin_addr), ntohs(addr.sin_port), buf, len);
   
 } /* UdpSocket::handleInput */
 
 
-void UdpSocket::sendRest(FdWatch *watch)
+void UdpSocket::handleInputBatch(void)
 {
-  struct sockaddr_in addr;
-  addr.sin_family = AF_INET;
-  addr.sin_port = htons(send_buf->port);
-  addr.sin_addr = send_buf->ip.ip4Addr();
-  /*
-  cout << "sock=" << sock << "  port=" << send_buf->port
-      << "  ip=" << send_buf->ip.toString() << "  len=" << send_buf->len
-      << endl;
-  */
-  int ret = sendto(sock, send_buf->buf, send_buf->len, 0,
-      reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+#ifdef HAS_RECVMMSG
+  struct mmsghdr msgs[MAX_RECV_BATCH_SIZE];
+  struct iovec iovs[MAX_RECV_BATCH_SIZE];
+  struct sockaddr_in addrs[MAX_RECV_BATCH_SIZE];
+#ifdef UDP_GRO
+  char ctrls[MAX_RECV_BATCH_SIZE][CMSG_SPACE(sizeof(int))];
+#endif
+  const size_t buf_size = recvBufSize();
+  for (unsigned i=0; i<recv_batch_size; ++i)
+  {
+    iovs[i].iov_base = &recv_buf[i * buf_size];
+    iovs[i].iov_len = buf_size;
+    memset(&msgs[i], 0, sizeof(msgs[i]));
+    msgs[i].msg_hdr.msg_name = &addrs[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+#ifdef UDP_GRO
+    if (recv_gro)
+    {
+      msgs[i].msg_hdr.msg_control = ctrls[i];
+      msgs[i].msg_hdr.msg_controllen = sizeof(ctrls[i]);
+    }
+#endif
+  }
+
+  int ret = recvmmsg(sock, msgs, recv_batch_size, MSG_DONTWAIT, NULL);
   if (ret == -1)
   {
-    if (errno == EAGAIN)
+    if (errno != EAGAIN)
     {
-      return;
+      perror("recvmmsg in UdpSocket::handleInputBatch");
     }
-    else
+    return;
+  }
+
+  recv_dgrams.clear();
+  for (int i=0; i<ret; ++i)
+  {
+    if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0)
     {
-      perror("sendto in UdpSocket::sendRest");
+      std::cerr << "*** WARNING: Dropping UDP datagram larger than "
+                << buf_size << " bytes" << std::endl;
+      continue;
+    }
+
+      // A buffer coalesced by GRO is split up into the original datagrams
+    int seg_size = msgs[i].msg_len;
+#ifdef UDP_GRO
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg != 0;
+         cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+    {
+      if ((cmsg->cmsg_level == IPPROTO_UDP) && (cmsg->cmsg_type == UDP_GRO))
+      {
+        int gso_size = 0;
+        memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+        if (gso_size > 0)
+        {
+          seg_size = gso_size;
+        }
+      }
+    }
+#endif
+    RecvDatagram dgram;
+    dgram.ip = IpAddress(addrs[i].sin_addr);
+    dgram.port = ntohs(addrs[i].sin_port);
+    char *ptr = static_cast<char*>(iovs[i].iov_base);
+    int left = msgs[i].msg_len;
+    do
+    {
+      dgram.buf = ptr;
+      dgram.len = std::min(left, seg_size);
+      if (static_cast<size_t>(dgram.len) > recv_max_size)
+      {
+        std::cerr << "*** WARNING: Dropping UDP datagram larger than "
+                  << recv_max_size << " bytes" << std::endl;
+      }
+      else
+      {
+        recv_dgrams.push_back(dgram);
+      }
+      ptr += dgram.len;
+      left -= dgram.len;
+    } while (left > 0);
+  }
+
+  emitReceived();
+#endif
+} /* UdpSocket::handleInputBatch */
+
+
+void UdpSocket::emitReceived(void)
+{
+  if (!batchReceived.empty())
+  {
+    batchReceived(recv_dgrams);
+    return;
+  }
+
+    // Guard against the socket being deleted by a dataReceived handler
+  bool is_deleted = false;
+  deleted = &is_deleted;
+  for (std::vector<RecvDatagram>::const_iterator it = recv_dgrams.begin();
+       it != recv_dgrams.end(); ++it)
+  {
+    dataReceived(it->ip, it->port, it->buf, it->len);
+    if (is_deleted)
+    {
+      return;
     }
   }
-  else
+  deleted = 0;
+} /* UdpSocket::emitReceived */
+
+
+void UdpSocket::sendRest(FdWatch *watch)
+{
+  while (!send_queue.empty())
   {
-    assert(ret == send_buf->len);
-    sendBufferFull(false);
+    UdpPacket *pkt = send_queue.front();
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(pkt->port);
+    addr.sin_addr = pkt->ip.ip4Addr();
+    int ret = sendto(sock, &pkt->buf[0], pkt->buf.size(), 0,
+        reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr));
+    if (ret == -1)
+    {
+      if (errno == EAGAIN)
+      {
+        return;
+      }
+      send_stats.errors += 1;
+      perror("sendto in UdpSocket::sendRest");
+    }
+    else
+    {
+      assert(ret == static_cast<int>(pkt->buf.size()));
+    }
+    send_queue.pop_front();
+    delete pkt;
   }
   
-  delete send_buf;
-  send_buf = 0;
   wr_watch->setEnabled(false);
+  sendBufferFull(false);
   
 } /* UdpSocket::sendRest */
 
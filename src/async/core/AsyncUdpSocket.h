@@ -41,8 +41,12 @@ An example of how to use the Async::UdpSocket class
  *
  ****************************************************************************/
 
+#include <sys/uio.h>
 #include <sigc++/sigc++.h>
 #include <stdint.h>
+#include <vector>
+#include <deque>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -124,6 +128,18 @@ This class is used to work with UDP sockets. An example usage is shown below.
 class UdpSocket : public sigc::trackable
 {
   public:
+    /**
+     * @brief   Counters for the send path
+     */
+    struct SendStats
+    {
+      unsigned long queued;   ///< Datagrams queued since the buffer was full
+      unsigned long dropped;  ///< Datagrams dropped since the queue was full
+      unsigned long errors;   ///< Datagrams that failed with an error
+
+      SendStats(void) : queued(0), dropped(0), errors(0) {}
+    };
+
     /**
      * @brief 	Constructor
      * @param 	local_port  The local port to use. If not specified, a random
@@ -159,12 +175,149 @@ class UdpSocket : public sigc::trackable
     bool write(const IpAddress& remote_ip, int remote_port, const void *buf,
 	int count);
 
+    /**
+     * @brief 	Write data gathered from multiple buffers to the remote host
+     * @param 	remote_ip   The IP-address of the remote host
+     * @param 	remote_port The remote port to use
+     * @param 	iov   	    The buffers containing the data to send
+     * @param 	iovcnt      The number of buffers
+     * @return	Return \em true on success or \em false on failure
+     *
+     * This function works just like the write function above but the
+     * datagram payload is gathered from multiple buffers, just like the
+     * writev(2) system call. This can for example be used to send a common
+     * payload with a different header to multiple hosts without copying.
+     */
+    bool write(const IpAddress& remote_ip, int remote_port,
+               const struct iovec *iov, int iovcnt);
+
+    /**
+     * @brief   A datagram to send using the writeBatch function
+     */
+    struct Datagram
+    {
+      IpAddress           ip;       ///< The IP-address of the remote host
+      int                 port;     ///< The remote port to use
+      const struct iovec* iov;      ///< The buffers to gather data from
+      int                 iovcnt;   ///< The number of buffers
+    };
+
+    /**
+     * @brief   Write multiple datagrams using as few system calls as possible
+     * @param   dgrams  The datagrams to send
+     * @param   cnt     The number of datagrams
+     * @return  Returns the number of datagrams sent or -1 on failure
+     *
+     * Use this function to send many datagrams in one go. On Linux the
+     * sendmmsg(2) system call is used so that a whole batch is sent using
+     * one system call. If the send buffer become full, the first datagram
+     * that could not be sent is buffered, just like for the write function,
+     * and the rest of the datagrams are dropped, unless a longer send queue
+     * has been set up using setSendQueueLength. The return value will be less
+     * than cnt if any datagram was dropped.
+     */
+    int writeBatch(const Datagram *dgrams, int cnt);
+
+    /**
+     * @brief   Send multiple datagrams on a raw socket
+     * @param   sock    The socket file descriptor to send on
+     * @param   dgrams  The datagrams to send
+     * @param   cnt     The number of datagrams
+     * @return  Returns the number of datagrams that was sent
+     *
+     * This is the low level function used by writeBatch. No buffering is
+     * done so if the return value is less than cnt, errno tells why the
+     * rest of the datagrams could not be sent. The function does not touch
+     * any object state so it may be called from another thread, e.g. using
+     * the file descriptor returned by the fd function.
+     */
+    static int sendDatagrams(int sock, const Datagram *dgrams, int cnt);
+
     /**
      * @brief   Get the file descriptor for the UDP socket
      * @return  Returns the file descriptor associated with the socket or
      *          -1 on error
      */
     int fd(void) const { return sock; }
+
+    /**
+     * @brief   Enable receiving multiple datagrams per read event
+     * @param   batch_size The maximum number of datagrams to read in one go
+     * @param   max_size   The maximum expected size of a datagram
+     *
+     * When batch_size is larger than one, the recvmmsg(2) system call is
+     * used, if available, to read up to batch_size datagrams each time the
+     * socket become readable. The dataReceived signal is emitted once for
+     * each datagram. The receive buffers are allocated once when this
+     * function is called so no allocation is done in the receive path.
+     * Datagrams larger than max_size are dropped. Set batch_size to one to
+     * go back to reading one datagram at a time, which is the default.
+     */
+    void setRecvBatchSize(unsigned batch_size, size_t max_size=65536);
+
+    /**
+     * @brief   Enable UDP generic receive offload
+     * @param   enable Set to \em true to enable or \em false to disable
+     * @return  Returns \em true on success or \em false if not supported
+     *
+     * With generic receive offload (GRO) enabled, the kernel may coalesce
+     * consecutive datagrams from the same remote host into one buffer. This
+     * class split such a buffer up again so that the dataReceived and
+     * batchReceived signals still see one datagram at a time. GRO is only
+     * used in batch mode, so setRecvBatchSize must be called with a batch
+     * size larger than one to make it take effect. Each receive buffer is
+     * enlarged to 64KB since that is the largest coalesced buffer the kernel
+     * may deliver. This is only supported on Linux 5.0 or later.
+     */
+    bool setRecvGro(bool enable);
+
+    /**
+     * @brief   Set the size of the socket send buffer
+     * @param   size The requested buffer size in bytes
+     * @return  Returns \em true on success or \em false on failure
+     *
+     * This function sets the SO_SNDBUF socket option. The kernel may limit the
+     * size, see net.core.wmem_max, so use sendBufferSize to find out the size
+     * that was actually set.
+     */
+    bool setSendBufferSize(int size);
+
+    /**
+     * @brief   Get the size of the socket send buffer
+     * @return  Returns the buffer size in bytes or -1 on failure
+     */
+    int sendBufferSize(void) const;
+
+    /**
+     * @brief   Set the maximum number of datagrams to queue
+     * @param   len The maximum number of queued datagrams
+     *
+     * When the socket send buffer is full, datagrams are queued and sent when
+     * the socket become writable again. The order of the datagrams is kept.
+     * Datagrams that do not fit in the queue are dropped. The default is to
+     * only queue one datagram. The queue length must be at least one.
+     */
+    void setSendQueueLength(size_t len)
+    {
+      max_send_queue_len = std::max(len, static_cast<size_t>(1));
+    }
+
+    /**
+     * @brief   Get the send path counters
+     * @return  Returns the counters for queued, dropped and failed datagrams
+     */
+    const SendStats& sendStats(void) const { return send_stats; }
+
+    /**
+     * @brief   A received datagram, as given to the batchReceived signal
+     */
+    struct RecvDatagram
+    {
+      IpAddress ip;     ///< The IP-address the datagram was received from
+      uint16_t  port;   ///< The remote port number
+      void*     buf;    ///< The datagram data, valid during the signal only
+      int       len;    ///< The number of bytes in the datagram
+    };
     
     /**
      * @brief 	A signal that is emitted when data has been received
@@ -174,6 +327,18 @@ class UdpSocket : public sigc::trackable
      * @param 	count The number of bytes read
      */
     sigc::signal<void, const IpAddress&, uint16_t, void*, int> dataReceived;
+
+    /**
+     * @brief   A signal that is emitted when a batch of data has been received
+     * @param   dgrams The received datagrams
+     *
+     * If a slot is connected to this signal, it is emitted once for every
+     * batch of datagrams read from the socket instead of emitting the
+     * dataReceived signal once for each datagram. The datagrams point into
+     * the receive buffers of the socket so no data is copied. The buffers
+     * are only valid until the slot returns.
+     */
+    sigc::signal<void, const std::vector<RecvDatagram>&> batchReceived;
     
     /**
      * @brief 	A signal that is emitted when the send buffer is full
@@ -185,13 +350,31 @@ class UdpSocket : public sigc::trackable
   protected:
     
   private:
+    static const size_t GRO_BUF_SIZE = 65536;
+
     int       	sock;
     FdWatch * 	rd_watch;
     FdWatch * 	wr_watch;
-    UdpPacket * send_buf;
+    std::deque<UdpPacket*> send_queue;
+    size_t      max_send_queue_len;
+    SendStats   send_stats;
+    unsigned    recv_batch_size;
+    size_t      recv_max_size;
+    std::vector<char> recv_buf;
+    std::vector<RecvDatagram> recv_dgrams;
+    bool        recv_gro;
+    bool *      deleted;
     
     void cleanup(void);
+    bool queuePacket(const IpAddress& remote_ip, int remote_port,
+                     const struct iovec *iov, int iovcnt);
     void handleInput(FdWatch *watch);
+    void handleInputBatch(void);
+    void emitReceived(void);
+    size_t recvBufSize(void) const
+    {
+      return recv_gro ? std::max(recv_max_size, GRO_BUF_SIZE) : recv_max_size;
+    }
     void sendRest(FdWatch *watch);
 
 };  /* class UdpSocket */
@@ -37,14 +37,25 @@
  ****************************************************************************/
 
 #include <sys/select.h>
+#include <sys/types.h>
 #include <signal.h>
 #include <unistd.h>
+#ifdef HAS_EPOLL
+#include <sys/epoll.h>
+#endif
+#ifdef HAS_KQUEUE
+#include <sys/event.h>
+#endif
 
 #include <cstdlib>
 #include <cstdio>
 #include <cerrno>
 #include <cassert>
 #include <algorithm>
+#include <cstring>
+#include <set>
+#include <iostream>
+#include <string>
 
 
 /****************************************************************************
@@ -64,6 +75,7 @@
 #include "AsyncCppDnsLookupWorker.h"
 #include "AsyncFdWatch.h"
 #include "AsyncTimer.h"
+#include "AsyncMetrics.h"
 #include "AsyncCppApplication.h"
 
 
@@ -85,28 +97,6 @@ using namespace Async;
  *
  ****************************************************************************/
 
-# define clock_timeradd(a, b, result)                                         \
-  do {                                                                        \
-    (result)->tv_sec = (a)->tv_sec + (b)->tv_sec;                             \
-    (result)->tv_nsec = (a)->tv_nsec + (b)->tv_nsec;                          \
-    if ((result)->tv_nsec >= 1000000000)                                      \
-      {                                                                       \
-        ++(result)->tv_sec;                                                   \
-        (result)->tv_nsec -= 1000000000;                                      \
-      }                                                                       \
-  } while (0)
-
-# define clock_timersub(a, b, result)                                         \
-  do {                                                                        \
-    (result)->tv_sec = (a)->tv_sec - (b)->tv_sec;                             \
-    (result)->tv_nsec = (a)->tv_nsec - (b)->tv_nsec;                          \
-    if ((result)->tv_nsec < 0) {                                              \
-      --(result)->tv_sec;                                                     \
-      (result)->tv_nsec += 1000000000;                                        \
-    }                                                                         \
-  } while (0)
-
-
 
 
 /****************************************************************************
@@ -115,6 +105,371 @@ using namespace Async;
  *
  ****************************************************************************/
 
+/**
+ * @brief The interface for the main loop event backends
+ *
+ * An event backend keep track of which file descriptors to wait for. When the
+ * wait function is called it will block until at least one of the file
+ * descriptors become active or the timeout expire. All active file
+ * descriptors are then appended to the given ready list.
+ */
+class CppApplication::EventBackend
+{
+  public:
+    virtual ~EventBackend(void) {}
+    virtual const char *name(void) const = 0;
+    virtual void addFd(int fd, FdWatch::FdWatchType type) = 0;
+    virtual void delFd(int fd, FdWatch::FdWatchType type) = 0;
+
+      /* Return value as for pselect, -1 on error with errno set */
+    virtual int wait(const struct timespec *timeout, ReadyFdList& ready) = 0;
+}; /* CppApplication::EventBackend */
+
+
+/**
+ * @brief An event backend using the pselect(2) system call
+ */
+class CppApplication::SelectBackend : public CppApplication::EventBackend
+{
+  public:
+    SelectBackend(void) : max_desc(0)
+    {
+      FD_ZERO(&rd_set);
+      FD_ZERO(&wr_set);
+    }
+
+    virtual const char *name(void) const { return "select"; }
+
+    virtual void addFd(int fd, FdWatch::FdWatchType type)
+    {
+      assert(fd < FD_SETSIZE);
+      switch (type)
+      {
+        case FdWatch::FD_WATCH_RD:
+          FD_SET(fd, &rd_set);
+          break;
+        case FdWatch::FD_WATCH_WR:
+          FD_SET(fd, &wr_set);
+          break;
+      }
+      if (fd+1 > max_desc)
+      {
+        max_desc = fd+1;
+      }
+    }
+
+    virtual void delFd(int fd, FdWatch::FdWatchType type)
+    {
+      switch (type)
+      {
+        case FdWatch::FD_WATCH_RD:
+          FD_CLR(fd, &rd_set);
+          break;
+        case FdWatch::FD_WATCH_WR:
+          FD_CLR(fd, &wr_set);
+          break;
+      }
+      while ((max_desc > 0) && !FD_ISSET(max_desc-1, &rd_set) &&
+             !FD_ISSET(max_desc-1, &wr_set))
+      {
+        --max_desc;
+      }
+    }
+
+    virtual int wait(const struct timespec *timeout, ReadyFdList& ready)
+    {
+      fd_set local_rd_set = rd_set;
+      fd_set local_wr_set = wr_set;
+      int dcnt = pselect(max_desc, &local_rd_set, &local_wr_set, NULL,
+                         timeout, NULL);
+      if (dcnt <= 0)
+      {
+        return dcnt;
+      }
+      int left = dcnt;
+      for (int fd=0; (left > 0) && (fd < max_desc); ++fd)
+      {
+        if (FD_ISSET(fd, &local_rd_set))
+        {
+          ready.push_back(ReadyFd(fd, FdWatch::FD_WATCH_RD));
+          --left;
+        }
+      }
+      for (int fd=0; (left > 0) && (fd < max_desc); ++fd)
+      {
+        if (FD_ISSET(fd, &local_wr_set))
+        {
+          ready.push_back(ReadyFd(fd, FdWatch::FD_WATCH_WR));
+          --left;
+        }
+      }
+      assert(left == 0);
+      return dcnt;
+    }
+
+  private:
+    int     max_desc;
+    fd_set  rd_set;
+    fd_set  wr_set;
+}; /* CppApplication::SelectBackend */
+
+
+#ifdef HAS_EPOLL
+/**
+ * @brief An event backend using the Linux epoll(7) interface
+ *
+ * Regular files cannot be handled by epoll. Just like pselect would do, such
+ * file descriptors are always reported as being ready.
+ */
+class CppApplication::EpollBackend : public CppApplication::EventBackend
+{
+  public:
+    EpollBackend(void) : epfd(-1), events(16)
+    {
+      epfd = epoll_create1(EPOLL_CLOEXEC);
+    }
+
+    virtual ~EpollBackend(void)
+    {
+      if (epfd >= 0)
+      {
+        close(epfd);
+      }
+    }
+
+    bool initOk(void) const { return epfd >= 0; }
+
+    virtual const char *name(void) const { return "epoll"; }
+
+    virtual void addFd(int fd, FdWatch::FdWatchType type)
+    {
+      uint32_t& ev = fd_events[fd];
+      uint32_t old_ev = ev;
+      ev |= eventMask(type);
+      update(fd, old_ev, ev);
+    }
+
+    virtual void delFd(int fd, FdWatch::FdWatchType type)
+    {
+      std::map<int, uint32_t>::iterator it = fd_events.find(fd);
+      if (it == fd_events.end())
+      {
+        return;
+      }
+      uint32_t old_ev = it->second;
+      it->second &= ~eventMask(type);
+      update(fd, old_ev, it->second);
+      if (it->second == 0)
+      {
+        fd_events.erase(it);
+      }
+    }
+
+    virtual int wait(const struct timespec *timeout, ReadyFdList& ready)
+    {
+      int timeout_ms = -1;
+      if (!nonpollable.empty())
+      {
+        timeout_ms = 0;
+      }
+      else if (timeout != 0)
+      {
+          // Round up to not wake up before the timer has expired
+        timeout_ms = timeout->tv_sec * 1000 +
+                     (timeout->tv_nsec + 999999) / 1000000;
+      }
+      int dcnt = epoll_wait(epfd, &events[0], events.size(), timeout_ms);
+      if (dcnt < 0)
+      {
+        return dcnt;
+      }
+      for (int i=0; i<dcnt; ++i)
+      {
+        const struct epoll_event& e = events[i];
+        uint32_t watched = fd_events[e.data.fd];
+        if ((e.events & (EPOLLIN | EPOLLHUP | EPOLLERR)) &&
+            (watched & EPOLLIN))
+        {
+          ready.push_back(ReadyFd(e.data.fd, FdWatch::FD_WATCH_RD));
+        }
+        if ((e.events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) &&
+            (watched & EPOLLOUT))
+        {
+          ready.push_back(ReadyFd(e.data.fd, FdWatch::FD_WATCH_WR));
+        }
+      }
+      if (static_cast<size_t>(dcnt) == events.size())
+      {
+        events.resize(2 * events.size());
+      }
+      for (std::set<int>::const_iterator it = nonpollable.begin();
+           it != nonpollable.end(); ++it)
+      {
+        uint32_t watched = fd_events[*it];
+        if (watched & EPOLLIN)
+        {
+          ready.push_back(ReadyFd(*it, FdWatch::FD_WATCH_RD));
+          ++dcnt;
+        }
+        if (watched & EPOLLOUT)
+        {
+          ready.push_back(ReadyFd(*it, FdWatch::FD_WATCH_WR));
+          ++dcnt;
+        }
+      }
+      return dcnt;
+    }
+
+  private:
+    int                             epfd;
+    std::vector<struct epoll_event> events;
+    std::map<int, uint32_t>         fd_events;
+    std::set<int>                   nonpollable;
+
+    static uint32_t eventMask(FdWatch::FdWatchType type)
+    {
+      return (type == FdWatch::FD_WATCH_RD) ? EPOLLIN : EPOLLOUT;
+    }
+
+    void update(int fd, uint32_t old_ev, uint32_t new_ev)
+    {
+      if (nonpollable.find(fd) != nonpollable.end())
+      {
+        if (new_ev == 0)
+        {
+          nonpollable.erase(fd);
+        }
+        return;
+      }
+
+      struct epoll_event e;
+      memset(&e, 0, sizeof(e));
+      e.events = new_ev;
+      e.data.fd = fd;
+      int op = EPOLL_CTL_MOD;
+      if (old_ev == 0)
+      {
+        op = EPOLL_CTL_ADD;
+      }
+      else if (new_ev == 0)
+      {
+        op = EPOLL_CTL_DEL;
+      }
+      if (epoll_ctl(epfd, op, fd, &e) == 0)
+      {
+        return;
+      }
+
+        // The file descriptor may have been closed before the watch was
+        // removed, which make the kernel forget about it. A closed file
+        // descriptor may also still be registered if it had been duplicated.
+      if ((op == EPOLL_CTL_DEL) && ((errno == EBADF) || (errno == ENOENT)))
+      {
+        return;
+      }
+      if (errno == EPERM)
+      {
+        nonpollable.insert(fd);
+        return;
+      }
+      if ((op == EPOLL_CTL_ADD) && (errno == EEXIST))
+      {
+        op = EPOLL_CTL_MOD;
+      }
+      else if ((op == EPOLL_CTL_MOD) && (errno == ENOENT))
+      {
+        op = EPOLL_CTL_ADD;
+      }
+      if (epoll_ctl(epfd, op, fd, &e) == -1)
+      {
+        perror("epoll_ctl");
+        exit(1);
+      }
+    }
+}; /* CppApplication::EpollBackend */
+#endif /* HAS_EPOLL */
+
+
+#ifdef HAS_KQUEUE
+/**
+ * @brief An event backend using the BSD kqueue(2) interface
+ */
+class CppApplication::KqueueBackend : public CppApplication::EventBackend
+{
+  public:
+    KqueueBackend(void) : kq(-1), events(16), watch_cnt(0)
+    {
+      kq = kqueue();
+    }
+
+    virtual ~KqueueBackend(void)
+    {
+      if (kq >= 0)
+      {
+        close(kq);
+      }
+    }
+
+    bool initOk(void) const { return kq >= 0; }
+
+    virtual const char *name(void) const { return "kqueue"; }
+
+    virtual void addFd(int fd, FdWatch::FdWatchType type)
+    {
+      struct kevent kev;
+      EV_SET(&kev, fd, filter(type), EV_ADD | EV_ENABLE, 0, 0, 0);
+      if (kevent(kq, &kev, 1, NULL, 0, NULL) == -1)
+      {
+        perror("kevent");
+        exit(1);
+      }
+      ++watch_cnt;
+    }
+
+    virtual void delFd(int fd, FdWatch::FdWatchType type)
+    {
+      struct kevent kev;
+      EV_SET(&kev, fd, filter(type), EV_DELETE, 0, 0, 0);
+        // Errors are ignored since the kernel automatically remove closed
+        // file descriptors
+      kevent(kq, &kev, 1, NULL, 0, NULL);
+      --watch_cnt;
+    }
+
+    virtual int wait(const struct timespec *timeout, ReadyFdList& ready)
+    {
+      if (events.size() < watch_cnt)
+      {
+        events.resize(watch_cnt);
+      }
+      int dcnt = kevent(kq, NULL, 0, &events[0], events.size(), timeout);
+      for (int i=0; i<dcnt; ++i)
+      {
+        int fd = static_cast<int>(events[i].ident);
+        if (events[i].filter == EVFILT_READ)
+        {
+          ready.push_back(ReadyFd(fd, FdWatch::FD_WATCH_RD));
+        }
+        else if (events[i].filter == EVFILT_WRITE)
+        {
+          ready.push_back(ReadyFd(fd, FdWatch::FD_WATCH_WR));
+        }
+      }
+      return dcnt;
+    }
+
+  private:
+    int                         kq;
+    std::vector<struct kevent>  events;
+    size_t                      watch_cnt;
+
+    static short filter(FdWatch::FdWatchType type)
+    {
+      return (type == FdWatch::FD_WATCH_RD) ? EVFILT_READ : EVFILT_WRITE;
+    }
+}; /* CppApplication::KqueueBackend */
+#endif /* HAS_KQUEUE */
+
 
 
 /****************************************************************************
@@ -162,17 +517,81 @@ int CppApplication::sighandler_pipe[2];
  *------------------------------------------------------------------------
  */
 CppApplication::CppApplication(void)
-  : do_quit(false), max_desc(0), unix_signal_recv(-1), unix_signal_recv_cnt(0)
+  : do_quit(false), backend(0), unix_signal_recv(-1), unix_signal_recv_cnt(0),
+    profiler(0), profiler_sig_installed(false)
 {
-  FD_ZERO(&rd_set);
-  FD_ZERO(&wr_set);
   sighandler_pipe[0] = sighandler_pipe[1] = -1;
+
+  const char *profile_str = getenv("ASYNC_LOOP_PROFILE");
+  if (profile_str != 0)
+  {
+    unsigned warn_thresh_ms = LoopProfiler::DEFAULT_WARN_THRESH_MS;
+    if (*profile_str != '\0')
+    {
+      warn_thresh_ms = atoi(profile_str);
+    }
+    setLoopProfiling(true, warn_thresh_ms);
+  }
+
+  Metrics::instance().collect.connect(
+      mem_fun(*this, &CppApplication::writeMetrics));
+
+  string backend_name;
+  const char *backend_str = getenv("ASYNC_EVENT_BACKEND");
+  if (backend_str != 0)
+  {
+    backend_name = backend_str;
+  }
+
+#ifdef HAS_EPOLL
+  if (backend_name.empty() || (backend_name == "epoll"))
+  {
+    EpollBackend *epoll_backend = new EpollBackend;
+    if (epoll_backend->initOk())
+    {
+      backend = epoll_backend;
+    }
+    else
+    {
+      perror("epoll_create1");
+      delete epoll_backend;
+    }
+  }
+#endif
+#ifdef HAS_KQUEUE
+  if ((backend == 0) && (backend_name.empty() || (backend_name == "kqueue")))
+  {
+    KqueueBackend *kqueue_backend = new KqueueBackend;
+    if (kqueue_backend->initOk())
+    {
+      backend = kqueue_backend;
+    }
+    else
+    {
+      perror("kqueue");
+      delete kqueue_backend;
+    }
+  }
+#endif
+  if (backend == 0)
+  {
+    backend = new SelectBackend;
+  }
+  if (!backend_name.empty() && (backend_name != backend->name()))
+  {
+    cerr << "*** WARNING: Async event backend \"" << backend_name
+         << "\" is not available. Using \"" << backend->name()
+         << "\" instead." << endl;
+  }
 } /* CppApplication::CppApplication */
 
 
 CppApplication::~CppApplication(void)
 {
   clearTasks();
+  setLoopProfiling(false);
+  delete backend;
+  backend = 0;
 } /* CppApplication::~CppApplication */
 
 
@@ -202,38 +621,21 @@ void CppApplication::exec(void)
       exit(1);
     }
   }
+  installProfilerSignal();
   
   while (!do_quit)
   {
     struct timespec *timeout_ptr = 0;
     struct timespec timeout;
-    TimerMap::iterator titer = timer_map.begin();
-    while (titer != timer_map.end())
-    {
-      if (titer->second != 0)
-      {
-	struct timespec ts;
-	clock_gettime(CLOCK_MONOTONIC, &ts);
-	clock_timersub(&titer->first, &ts, &timeout);
-	if (timeout.tv_sec < 0)
-	{
-	  timeout.tv_sec = 0;
-	  timeout.tv_nsec = 0;
-	}
-	timeout_ptr = &timeout;
-	break;
-      }
-      else
-      {
-	timer_map.erase(titer);
-      }
-      titer = timer_map.begin();
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (timer_wheel.nextTimeout(now, timeout))
+    {
+      timeout_ptr = &timeout;
     }
     
-    fd_set local_rd_set = rd_set;
-    fd_set local_wr_set = wr_set;
-    int dcnt = pselect(max_desc, &local_rd_set, &local_wr_set, NULL,
-	timeout_ptr, NULL);
+    ready_fds.clear();
+    int dcnt = backend->wait(timeout_ptr, ready_fds);
     if (dcnt == -1)
     {
       if ((errno == EINTR) || (errno == EAGAIN))
@@ -242,73 +644,27 @@ void CppApplication::exec(void)
       }
       else
       {
-        perror("pselect");
+        perror(backend->name());
         exit(1);
       }
     }
     
-    if ((timeout_ptr != 0)
-        && ((dcnt == 0)
-            || ((timeout_ptr->tv_sec == 0) && (timeout_ptr->tv_nsec == 0))
-           )
-       )
+      /* Expire all timers that are due */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    timer_wheel.expire(now);
+
+    dispatchReadyFds();
+
+    if (profiler != 0)
     {
-      titer->second->expired(titer->second);
-      if ((titer->second != 0) &&
-	  (titer->second->type() == Timer::TYPE_PERIODIC))
-      {
-	addTimerP(titer->second, titer->first);
-      }
-      timer_map.erase(titer);
-    }
-    
-    WatchMap::iterator witer, next_witer;
-    
-      /* Check for activity on the read watch file descriptors */
-    witer=rd_watch_map.begin();
-    while ((dcnt > 0) && (witer != rd_watch_map.end()))
-    {
-      next_witer = witer;
-      ++next_witer;
-      if (FD_ISSET(witer->first, &local_rd_set))
-      {
-	if (witer->second != 0)
-	{
-	  witer->second->activity(witer->second);
-	}
-	else
-	{
-	  rd_watch_map.erase(witer);
-	}
-	--dcnt;
-      }
-      witer = next_witer;
-    }
-    
-      /* Check for activity on the write watch file descriptors */
-    witer=wr_watch_map.begin();
-    while ((dcnt > 0) && (witer != wr_watch_map.end()))
-    {
-      next_witer = witer;
-      ++next_witer;
-      if (FD_ISSET(witer->first, &local_wr_set))
-      {
-	if (witer->second != 0)
-	{
-	  witer->second->activity(witer->second);
-	}
-	else
-	{
-	  wr_watch_map.erase(witer);
-	}
-	--dcnt;
-      }
-      witer = next_witer;
+      struct timespec end;
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      profiler->iterationDone(now, end);
     }
-    
-    assert(dcnt == 0);
   }
 
+  restoreProfilerSignal();
+
   for (UnixSignalMap::const_iterator it = unix_signals.begin();
        it != unix_signals.end();
        ++it)
@@ -363,6 +719,37 @@ void CppApplication::catchUnixSignal(int signum)
 } /* CppApplication::catchUnixSignal */
 
 
+void CppApplication::setLoopProfiling(bool enable, unsigned warn_thresh_ms)
+{
+  if (enable)
+  {
+    if (profiler == 0)
+    {
+      profiler = new LoopProfiler;
+      timer_wheel.setProfiler(profiler);
+      if (sighandler_pipe[0] != -1)
+      {
+        installProfilerSignal();
+      }
+    }
+    profiler->setWarnThreshold(warn_thresh_ms);
+  }
+  else if (profiler != 0)
+  {
+    restoreProfilerSignal();
+    timer_wheel.setProfiler(0);
+    delete profiler;
+    profiler = 0;
+  }
+} /* CppApplication::setLoopProfiling */
+
+
+const char *CppApplication::eventBackendName(void) const
+{
+  return backend->name();
+} /* CppApplication::eventBackendName */
+
+
 void CppApplication::uncatchUnixSignal(int signum)
 {
   UnixSignalMap::iterator it = unix_signals.find(signum);
@@ -420,33 +807,26 @@ void CppApplication::unixSignalHandler(int signum)
 void CppApplication::addFdWatch(FdWatch *fd_watch)
 {
   int fd = fd_watch->fd();
-  //printf("Adding watch for fd=%d (max_desc=%d)\n", fd, max_desc);
+  //printf("Adding watch for fd=%d\n", fd);
   
   WatchMap *watch_map = 0;
   switch (fd_watch->type())
   {
     case FdWatch::FD_WATCH_RD:
-      FD_SET(fd, &rd_set);
       watch_map = &rd_watch_map;
       break;
 
     case FdWatch::FD_WATCH_WR:
-      FD_SET(fd, &wr_set);
       watch_map = &wr_watch_map;
       break;
   }
   assert(watch_map != 0);
 
   WatchMap::iterator iter = watch_map->find(fd);
-  assert((iter == watch_map->end()) || (iter->second == 0));
+  assert(iter == watch_map->end());
   
-  if (fd+1 > max_desc)
-  {
-    max_desc = fd+1;
-  }
-
   (*watch_map)[fd] = fd_watch;
-  
+  backend->addFd(fd, fd_watch->type());
 } /* CppApplication::addFdWatch */
 
 
@@ -457,46 +837,19 @@ void CppApplication::delFdWatch(FdWatch *fd_watch)
   switch (fd_watch->type())
   {
     case FdWatch::FD_WATCH_RD:
-      FD_CLR(fd, &rd_set);
       watch_map = &rd_watch_map;
       break;
       
     case FdWatch::FD_WATCH_WR:
-      FD_CLR(fd, &wr_set);
       watch_map = &wr_watch_map;
       break;
   }
   assert(watch_map != 0);
   
   WatchMap::iterator iter = watch_map->find(fd);
-  assert((iter != watch_map->end()) && (iter->second != 0));
-  iter->second = 0;
-  
-  if (fd+1 == max_desc)
-  {
-    max_desc = -1;
-
-    WatchMap::reverse_iterator riter;
-    for (riter = rd_watch_map.rbegin(); riter != rd_watch_map.rend(); ++riter)
-    {
-      if ((riter->second != 0) && (riter->first > max_desc))
-      {
-        max_desc = riter->first;
-        break;
-      }
-    }
-    
-    for (riter = wr_watch_map.rbegin(); riter != wr_watch_map.rend(); ++riter)
-    {
-      if ((riter->second != 0) && (riter->first > max_desc))
-      {
-        max_desc = riter->first;
-        break;
-      }
-    }
-    
-    ++max_desc;
-  }
+  assert((iter != watch_map->end()) && (iter->second == fd_watch));
+  watch_map->erase(iter);
+  backend->delFd(fd, fd_watch->type());
 } /* CppApplication::delFdWatch */
 
 
@@ -504,36 +857,13 @@ void CppApplication::addTimer(Timer *timer)
 {
   struct timespec current;
   clock_gettime(CLOCK_MONOTONIC, &current);
-  addTimerP(timer, current);
+  timer_wheel.add(timer, current);
 } /* CppApplication::addTimer */
 
 
-void CppApplication::addTimerP(Timer *timer, const struct timespec& current)
-{
-  struct timespec add;
-  struct timespec expiration;
-  int timeout = timer->timeout();
-  add.tv_sec = timeout / 1000;
-  timeout -= add.tv_sec * 1000;
-  add.tv_nsec = timeout * 1000000;
-  clock_timeradd(&current, &add, &expiration);
-  
-  timer_map.insert(pair<struct timespec, Timer *>(expiration, timer));
-} /* CppApplication::addTimerP */
-
-
 void CppApplication::delTimer(Timer *timer)
 {
-  TimerMap::iterator iter;
-  for (iter=timer_map.begin(); iter!=timer_map.end(); ++iter)
-  {
-    if (iter->second == timer)
-    {
-      //timer_map.erase(iter);
-      iter->second = 0;
-      break;
-    }
-  }
+  timer_wheel.del(timer);
 } /* CppApplication::delTimer */
 
 
@@ -553,13 +883,109 @@ void CppApplication::handleUnixSignal(void)
   assert(unix_signal_recv_cnt <= sizeof(unix_signal_recv));
   if (unix_signal_recv_cnt == sizeof(unix_signal_recv))
   {
-    unixSignalCaught(unix_signal_recv);
+    if ((unix_signal_recv == SIGUSR1) && (profiler != 0) &&
+        (unix_signals.find(SIGUSR1) == unix_signals.end()))
+    {
+      profiler->print(cerr);
+    }
+    else
+    {
+      unixSignalCaught(unix_signal_recv);
+    }
     unix_signal_recv_cnt = 0;
     unix_signal_recv = -1;
   }
 } /* CppApplication::handleUnixSignal */
 
 
+void CppApplication::dispatchReadyFds(void)
+{
+    /* The watch is looked up again for each ready file descriptor since a
+     * callback may remove watches that are later in the list */
+  for (ReadyFdList::const_iterator it = ready_fds.begin();
+       it != ready_fds.end(); ++it)
+  {
+    WatchMap& watch_map =
+      (it->type == FdWatch::FD_WATCH_RD) ? rd_watch_map : wr_watch_map;
+    WatchMap::iterator witer = watch_map.find(it->fd);
+    if (witer == watch_map.end())
+    {
+      continue;
+    }
+    if (profiler != 0)
+    {
+      LoopProfiler::SiteId site(
+          (it->type == FdWatch::FD_WATCH_RD) ?
+            LoopProfiler::SITE_FD_RD : LoopProfiler::SITE_FD_WR,
+          it->fd);
+      struct timespec start;
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      witer->second->activity(witer->second);
+      struct timespec end;
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      profiler->callbackDone(site, start, end);
+    }
+    else
+    {
+      witer->second->activity(witer->second);
+    }
+  }
+  ready_fds.clear();
+} /* CppApplication::dispatchReadyFds */
+
+
+void CppApplication::installProfilerSignal(void)
+{
+    // The profiling report is printed on SIGUSR1, unless the application
+    // use that signal for its own purposes
+  if ((profiler == 0) || profiler_sig_installed ||
+      (unix_signals.find(SIGUSR1) != unix_signals.end()))
+  {
+    return;
+  }
+  struct sigaction act;
+  act.sa_handler = unixSignalHandler;
+  sigemptyset(&act.sa_mask);
+  act.sa_flags = 0;
+  if (sigaction(SIGUSR1, &act, &profiler_old_sigact) == -1)
+  {
+    perror("sigaction");
+    exit(1);
+  }
+  profiler_sig_installed = true;
+} /* CppApplication::installProfilerSignal */
+
+
+void CppApplication::restoreProfilerSignal(void)
+{
+  if (!profiler_sig_installed)
+  {
+    return;
+  }
+  if (sigaction(SIGUSR1, &profiler_old_sigact, NULL) == -1)
+  {
+    perror("sigaction");
+    exit(1);
+  }
+  profiler_sig_installed = false;
+} /* CppApplication::restoreProfilerSignal */
+
+
+void CppApplication::writeMetrics(MetricsWriter& writer)
+{
+  const TimerWheel::Stats& stats = timer_wheel.stats();
+  const MetricsWriter::Labels no_labels;
+  writer.gauge("async_timers_active", "Number of active timers", no_labels,
+               stats.active);
+  writer.counter("async_timer_expirations", "Number of timer expirations",
+                 no_labels, stats.expired);
+  if (profiler != 0)
+  {
+    profiler->writeMetrics(writer);
+  }
+} /* CppApplication::writeMetrics */
+
+
 
 /*
  * This file has not been truncated
@@ -45,6 +45,7 @@
 #include <sigc++/sigc++.h>
 
 #include <map>
+#include <vector>
 #include <utility>
 
 
@@ -55,6 +56,9 @@
  ****************************************************************************/
 
 #include <AsyncApplication.h>
+#include <AsyncFdWatch.h>
+#include <AsyncTimerWheel.h>
+#include <AsyncLoopProfiler.h>
 
 
 /****************************************************************************
@@ -132,6 +136,30 @@ namespace Async
 
 /**
 * @brief An application class for writing non GUI applications.
+*
+* The main loop can use different operating system mechanisms for waiting on
+* file descriptor activity. The classic one is pselect(2), which is available
+* everywhere but scale with the number of watched file descriptors and is
+* limited to FD_SETSIZE descriptors. On Linux epoll(7) is used by default and
+* on BSD systems kqueue(2) is used, if support for them was detected at build
+* time. Both of these only report the file descriptors that actually are
+* active and have no upper limit on the file descriptor number.
+*
+* The backend can be selected at runtime by setting the environment variable
+* ASYNC_EVENT_BACKEND to "select", "epoll" or "kqueue". If the requested
+* backend is not available, the default one will be used.
+*
+* To find callbacks that block the main loop for too long, the main loop can
+* be profiled by setting the environment variable ASYNC_LOOP_PROFILE. The
+* value is the number of milliseconds a callback may run before a warning is
+* printed, or empty to use the default threshold. The collected statistics are
+* printed on stderr when the application receive a SIGUSR1 signal, unless the
+* application itself catch that signal. Profiling can also be controlled
+* using the setLoopProfiling function. See the LoopProfiler class for more
+* information.
+*
+* The timer statistics and, if enabled, the profiling statistics are also
+* available through the Async::Metrics registry.
 */
 class CppApplication : public Application
 {
@@ -183,45 +211,90 @@ class CppApplication : public Application
      * signal will be emitted.
      */
     sigc::signal<void, int> unixSignalCaught;
+
+    /**
+     * @brief   Get the name of the event backend in use
+     * @return  Returns "select", "epoll" or "kqueue"
+     */
+    const char *eventBackendName(void) const;
+
+    /**
+     * @brief   Get statistics for the timer handling
+     * @return  Returns a reference to the timer statistics
+     *
+     * The statistics can be used to see how many timers that are active,
+     * how many timers that have expired and how much time that have been
+     * spent maintaining the timers in the main loop.
+     */
+    const TimerWheel::Stats& timerStats(void) const
+    {
+      return timer_wheel.stats();
+    }
+
+    /**
+     * @brief   Enable or disable main loop profiling
+     * @param   enable Set to \em true to enable profiling
+     * @param   warn_thresh_ms Warn for callbacks running longer than this
+     *
+     * When profiling is enabled, the time each file descriptor watch and
+     * timer callback take to run is measured. The collected statistics are
+     * thrown away when profiling is disabled.
+     */
+    void setLoopProfiling(bool enable,
+        unsigned warn_thresh_ms=LoopProfiler::DEFAULT_WARN_THRESH_MS);
+
+    /**
+     * @brief   Get the main loop profiler
+     * @return  Returns the profiler or 0 if profiling is not enabled
+     */
+    LoopProfiler *loopProfiler(void) { return profiler; }
     
   protected:
     
   private:
-    struct lttimespec
+    class EventBackend;
+    class SelectBackend;
+    class EpollBackend;
+    class KqueueBackend;
+
+    struct ReadyFd
     {
-      bool operator()(const struct timespec& t1, const struct timespec& t2) const
-      {
-        return ((t1.tv_sec == t2.tv_sec)
-                ? (t1.tv_nsec < t2.tv_nsec)
-                : (t1.tv_sec < t2.tv_sec));
-      }
+      int                   fd;
+      FdWatch::FdWatchType  type;
+      ReadyFd(int fd, FdWatch::FdWatchType type) : fd(fd), type(type) {}
     };
+    typedef std::vector<ReadyFd> ReadyFdList;
+
     typedef std::map<int, FdWatch*>   	      	      	        WatchMap;
-    typedef std::multimap<struct timespec, Timer *, lttimespec> TimerMap;
     typedef std::map<int, struct sigaction>                     UnixSignalMap;
     
     static int          sighandler_pipe[2];
 
     bool      	      	do_quit;
-    int       	      	max_desc;
-    fd_set    	      	rd_set;
-    fd_set    	      	wr_set;
+    EventBackend        *backend;
+    ReadyFdList         ready_fds;
     WatchMap  	      	rd_watch_map;
     WatchMap  	      	wr_watch_map;
-    TimerMap  	      	timer_map;
+    TimerWheel          timer_wheel;
     UnixSignalMap       unix_signals;
     int                 unix_signal_recv;
     size_t              unix_signal_recv_cnt;
+    LoopProfiler        *profiler;
+    bool                profiler_sig_installed;
+    struct sigaction    profiler_old_sigact;
     
     static void unixSignalHandler(int signum);
 
     void addFdWatch(FdWatch *fd_watch);
     void delFdWatch(FdWatch *fd_watch);
     void addTimer(Timer *timer);
-    void addTimerP(Timer *timer, const struct timespec& current);
     void delTimer(Timer *timer);    
     DnsLookupWorker *newDnsLookupWorker(const std::string& label);
     void handleUnixSignal(void);
+    void dispatchReadyFds(void);
+    void installProfilerSignal(void);
+    void restoreProfilerSignal(void);
+    void writeMetrics(MetricsWriter& writer);
     
 };  /* class CppApplication */
 
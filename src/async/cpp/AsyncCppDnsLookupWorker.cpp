@@ -38,17 +38,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
-#include <unistd.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <sys/time.h>
-#include <errno.h>
-#include <cstdlib>
-#include <cstdio>
-#include <cassert>
-#include <cstring>
-#include <algorithm>
 
 
 /****************************************************************************
@@ -57,8 +46,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
-#include <AsyncTimer.h>
-#include <AsyncFdWatch.h>
 
 
 /****************************************************************************
@@ -68,6 +55,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "AsyncCppDnsLookupWorker.h"
+#include "AsyncCppDnsResolver.h"
 
 
 
@@ -131,74 +119,31 @@ using namespace Async;
 
 
 CppDnsLookupWorker::CppDnsLookupWorker(const string &label)
-  : label(label), worker_thread(0), notifier_rd(-1), notifier_wr(-1),
-    notifier_watch(0), done(false), result(0)
+  : label(label)
 {
 } /* CppDnsLookupWorker::CppDnsLookupWorker */
 
 
 CppDnsLookupWorker::~CppDnsLookupWorker(void)
 {
-  if (worker_thread != 0)
-  {
-    if (!done)
-    {
-      int ret = pthread_cancel(worker_thread);
-      if (ret != 0)
-      {
-        cerr << "*** WARNING: pthread_cancel: " << strerror(ret) << endl;
-      }
-    }
- 
-    int ret = pthread_join(worker_thread, NULL);
-    if (ret != 0)
-    {
-      cerr << "*** WARNING: pthread_join: " << strerror(ret) << endl;
-    }
-  }
-  
-  if (result != 0)
-  {
-    freeaddrinfo(result);
-  }
-  
-  delete notifier_watch;
-  if (notifier_rd != -1)
-  {
-    close(notifier_rd);
-  }
-  if (notifier_wr != -1)
-  {
-    close(notifier_wr);
-  }
+  CppDnsResolver::instance().cancel(this);
 } /* CppDnsLookupWorker::~CppDnsLookupWorker */
 
 
 bool CppDnsLookupWorker::doLookup(void)
 {
-  int fd[2];
-  if (pipe(fd) != 0)
-  {
-    cerr << "*** ERROR: Could not create pipe: " << strerror(errno) << endl;
-    return false;
-  }
-  notifier_rd = fd[0];
-  notifier_wr = fd[1];
-  notifier_watch = new FdWatch(notifier_rd, FdWatch::FD_WATCH_RD);
-  notifier_watch->activity.connect(
-      	  mem_fun(*this, &CppDnsLookupWorker::notificationReceived));
-  int ret = pthread_create(&worker_thread, NULL, workerFunc, this);
-  if (ret != 0)
-  {
-    cerr << "*** ERROR: pthread_create: " << strerror(ret) << endl;
-    return false;
-  }
-
+  CppDnsResolver::instance().lookup(this, label);
   return true;
-  
 } /* CppDnsLookupWorker::doLookup */
 
 
+void CppDnsLookupWorker::setResult(const std::vector<IpAddress>& addresses)
+{
+  the_addresses = addresses;
+  resultsReady();
+} /* CppDnsLookupWorker::setResult */
+
+
 
 
 /****************************************************************************
@@ -217,91 +162,7 @@ bool CppDnsLookupWorker::doLookup(void)
  ****************************************************************************/
 
 
-/*
- *----------------------------------------------------------------------------
- * Method:    CppDnsLookupWorker::workerFunc
- * Purpose:   This is the function that do the actual DNS lookup. It is
- *    	      started as a separate thread since gethostbyname is a
- *    	      blocking function.
- * Input:     w - Thread user data. This is the actual CppDnsLookupWorker
- *    	      	  object
- * Output:    the_addresses will be filled in with all IP addresses
- *    	      associated with the name.
- * Author:    Tobias Blomberg
- * Created:   2005-04-12
- * Remarks:   
- * Bugs:      
- *----------------------------------------------------------------------------
- */
-void *CppDnsLookupWorker::workerFunc(void *w)
-{
-  CppDnsLookupWorker *worker = reinterpret_cast<CppDnsLookupWorker *>(w);
-
-  struct addrinfo hints;
-  memset(&hints, 0, sizeof(hints));
-  hints.ai_family = AF_INET;
-  int ret = getaddrinfo(worker->label.c_str(), NULL, &hints, &worker->result);
-  if (ret != 0)
-  {
-    cerr << "*** WARNING: Could not look up host \"" << worker->label
-         << "\": " << gai_strerror(ret) << endl;
-  }
-  
-  ret = write(worker->notifier_wr, "D", 1);
-  assert(ret == 1);
-  
-  worker->done = true;
-  return NULL;
-  
-} /* CppDnsLookupWorker::workerFunc */
-
-
-/*
- *----------------------------------------------------------------------------
- * Method:    CppDnsLookupWorker::notificationReceived
- * Purpose:   When the DNS lookup thread is done, this function will be
- *    	      called to notify the user of the result.
- * Input:     w - The file watch object (notification pipe)
- * Output:    None
- * Author:    Tobias Blomberg
- * Created:   2005-04-12
- * Remarks:   
- * Bugs:      
- *----------------------------------------------------------------------------
- */
-void CppDnsLookupWorker::notificationReceived(FdWatch *w)
-{
-  w->setEnabled(false);
-
-  int ret = pthread_join(worker_thread, NULL);
-  if (ret != 0)
-  {
-    cerr << "*** WARNING: pthread_join: " << strerror(ret) << endl;
-  }
-  worker_thread = 0;
-
-  if (result != 0)
-  {
-    struct addrinfo *entry;
-    for (entry = result; entry != 0; entry = entry->ai_next)
-    {
-      //printf("ai_family=%d ai_socktype=%d ai_protocol=%d\n",
-      //       entry->ai_family, entry->ai_socktype, entry->ai_protocol);
-      IpAddress ip_addr(
-          reinterpret_cast<struct sockaddr_in*>(entry->ai_addr)->sin_addr);
-      if (find(the_addresses.begin(), the_addresses.end(), ip_addr) ==
-          the_addresses.end())
-      {
-        the_addresses.push_back(ip_addr);
-      }
-    }
-  }
-  resultsReady();
-} /* CppDnsLookupWorker::notificationReceived */
-
-
 
 /*
  * This file has not been truncated
  */
-
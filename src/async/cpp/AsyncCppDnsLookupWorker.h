@@ -41,8 +41,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <sigc++/sigc++.h>
-#include <pthread.h>
-#include <netdb.h>
 
 #include <string>
 #include <vector>
@@ -83,9 +81,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 namespace Async
 {
 
-class Timer;
-class FdWatch;
-  
   
 /****************************************************************************
  *
@@ -147,6 +142,12 @@ class CppDnsLookupWorker : public DnsLookupWorker, public sigc::trackable
      * the hostname in the query.
      */
     virtual std::vector<IpAddress> addresses(void) { return the_addresses; }
+
+    /**
+     * @brief   Called by the resolver when the lookup is done
+     * @param   addresses The addresses found for the label
+     */
+    void setResult(const std::vector<IpAddress>& addresses);
     
     
   protected:
@@ -154,17 +155,6 @@ class CppDnsLookupWorker : public DnsLookupWorker, public sigc::trackable
   private:
     std::string	      	    label;
     std::vector<IpAddress>  the_addresses;
-    pthread_t 	      	    worker_thread;
-    int       	      	    notifier_rd;
-    int       	      	    notifier_wr;
-    Async::FdWatch    	    *notifier_watch;
-    bool      	      	    done;
-    struct addrinfo    	    *result;
-  
-    static void *workerFunc(void *);
-
-    void onTimeout(Timer *t);
-    void notificationReceived(FdWatch *w);
 
 };  /* class CppDnsLookupWorker */
 
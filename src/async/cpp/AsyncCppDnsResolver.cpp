@@ -0,0 +1,463 @@
+/**
+@file   AsyncCppDnsResolver.cpp
+@brief  A shared resolver with a cache for the Cpp DNS lookup workers
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains the resolver used by the Cpp variant of the async
+environment to execute DNS queries. This class should never be used directly.
+It is used by Async::CppDnsLookupWorker.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <arpa/nameser.h>
+#include <resolv.h>
+#include <netdb.h>
+#include <errno.h>
+#include <cstring>
+#include <cassert>
+#include <iostream>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncFdWatch.h>
+#include <AsyncApplication.h>
+#include <AsyncThreadScheduling.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncCppDnsResolver.h"
+#include "AsyncCppDnsLookupWorker.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static unsigned queryTtl(struct __res_state *res, const string& label);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+CppDnsResolver& CppDnsResolver::instance(void)
+{
+    // The resolver is never deleted since detached worker threads may still
+    // be blocked in a lookup when the application exits
+  static CppDnsResolver *resolver = new CppDnsResolver;
+  return *resolver;
+} /* CppDnsResolver::instance */
+
+
+void CppDnsResolver::lookup(CppDnsLookupWorker *worker,
+                            const std::string& label)
+{
+  Cache::iterator cit = m_cache.find(label);
+  if (cit != m_cache.end())
+  {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec < (*cit).second.expires.tv_sec)
+    {
+      Application::app().runTask(
+          sigc::bind(mem_fun(*worker, &CppDnsLookupWorker::setResult),
+                     (*cit).second.addresses));
+      return;
+    }
+    m_cache.erase(cit);
+  }
+
+  PendingMap::iterator pit = m_pending.find(label);
+  if (pit != m_pending.end())
+  {
+    (*pit).second.push_back(worker);
+    return;
+  }
+  m_pending[label].push_back(worker);
+
+  if (m_notifier_watch == 0)
+  {
+    m_notifier_watch = new FdWatch(m_notifier_rd, FdWatch::FD_WATCH_RD);
+    m_notifier_watch->activity.connect(
+        mem_fun(*this, &CppDnsResolver::notificationReceived));
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  m_jobs.push_back(label);
+  if ((m_jobs.size() > m_idle_thread_cnt) && (m_thread_cnt < MAX_THREADS))
+  {
+    pthread_t thread;
+    int ret = pthread_create(&thread, NULL, threadFunc, this);
+    if (ret == 0)
+    {
+      pthread_detach(thread);
+      ++m_thread_cnt;
+    }
+    else
+    {
+      cerr << "*** WARNING: pthread_create: " << strerror(ret) << endl;
+    }
+  }
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+} /* CppDnsResolver::lookup */
+
+
+void CppDnsResolver::cancel(CppDnsLookupWorker *worker)
+{
+  for (PendingMap::iterator it=m_pending.begin(); it!=m_pending.end(); ++it)
+  {
+    Waiters& waiters = (*it).second;
+    waiters.erase(remove(waiters.begin(), waiters.end(), worker),
+                  waiters.end());
+  }
+  m_notify.erase(remove(m_notify.begin(), m_notify.end(), worker),
+                 m_notify.end());
+} /* CppDnsResolver::cancel */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+CppDnsResolver::CppDnsResolver(void)
+  : m_thread_cnt(0), m_idle_thread_cnt(0), m_notifier_rd(-1),
+    m_notifier_wr(-1), m_notifier_watch(0)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_cond, NULL);
+  int fd[2];
+  if (pipe(fd) != 0)
+  {
+    cerr << "*** ERROR: Could not create pipe: " << strerror(errno) << endl;
+    abort();
+  }
+  m_notifier_rd = fd[0];
+  m_notifier_wr = fd[1];
+  fcntl(m_notifier_rd, F_SETFL, fcntl(m_notifier_rd, F_GETFL) | O_NONBLOCK);
+  fcntl(m_notifier_wr, F_SETFL, fcntl(m_notifier_wr, F_GETFL) | O_NONBLOCK);
+} /* CppDnsResolver::CppDnsResolver */
+
+
+CppDnsResolver::~CppDnsResolver(void)
+{
+  delete m_notifier_watch;
+  close(m_notifier_rd);
+  close(m_notifier_wr);
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutex);
+} /* CppDnsResolver::~CppDnsResolver */
+
+
+void *CppDnsResolver::threadFunc(void *arg)
+{
+  ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_DNS);
+  reinterpret_cast<CppDnsResolver*>(arg)->run();
+  return NULL;
+} /* CppDnsResolver::threadFunc */
+
+
+void CppDnsResolver::run(void)
+{
+  struct __res_state res;
+  memset(&res, 0, sizeof(res));
+  bool res_ok = (res_ninit(&res) == 0);
+
+  for (;;)
+  {
+    pthread_mutex_lock(&m_mutex);
+    ++m_idle_thread_cnt;
+    while (m_jobs.empty())
+    {
+      pthread_cond_wait(&m_cond, &m_mutex);
+    }
+    --m_idle_thread_cnt;
+    Result result;
+    result.label = m_jobs.front();
+    m_jobs.pop_front();
+    pthread_mutex_unlock(&m_mutex);
+
+    result.is_ttl_update = false;
+    result.ttl = 0;
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    struct addrinfo *ai = 0;
+    result.status = getaddrinfo(result.label.c_str(), NULL, &hints, &ai);
+    if (result.status != 0)
+    {
+      cerr << "*** WARNING: Could not look up host \"" << result.label
+           << "\": " << gai_strerror(result.status) << endl;
+    }
+    for (struct addrinfo *entry = ai; entry != 0; entry = entry->ai_next)
+    {
+      IpAddress ip_addr(
+          reinterpret_cast<struct sockaddr_in*>(entry->ai_addr)->sin_addr);
+      if (find(result.addresses.begin(), result.addresses.end(), ip_addr) ==
+          result.addresses.end())
+      {
+        result.addresses.push_back(ip_addr);
+      }
+    }
+    if (ai != 0)
+    {
+      freeaddrinfo(ai);
+    }
+    postResult(result);
+
+      // Find out how long the answer may be cached. This is done after
+      // posting the result so that a slow DNS does not delay names that
+      // are resolved some other way, like through /etc/hosts.
+    struct in_addr numeric;
+    if (res_ok && (result.status == 0) &&
+        (inet_aton(result.label.c_str(), &numeric) == 0))
+    {
+      result.is_ttl_update = true;
+      result.ttl = queryTtl(&res, result.label);
+      if (result.ttl > 0)
+      {
+        postResult(result);
+      }
+    }
+  }
+} /* CppDnsResolver::run */
+
+
+void CppDnsResolver::postResult(const Result& result)
+{
+  pthread_mutex_lock(&m_mutex);
+  m_results.push_back(result);
+  pthread_mutex_unlock(&m_mutex);
+    // If the pipe is full there already are unread notifications
+  ssize_t ret = write(m_notifier_wr, "D", 1);
+  (void)ret;
+} /* CppDnsResolver::postResult */
+
+
+void CppDnsResolver::notificationReceived(FdWatch *w)
+{
+  char buf[64];
+  while (read(m_notifier_rd, buf, sizeof(buf)) > 0);
+
+  std::deque<Result> results;
+  pthread_mutex_lock(&m_mutex);
+  results.swap(m_results);
+  pthread_mutex_unlock(&m_mutex);
+
+  for (std::deque<Result>::const_iterator it=results.begin();
+       it!=results.end(); ++it)
+  {
+    handleResult(*it);
+  }
+} /* CppDnsResolver::notificationReceived */
+
+
+void CppDnsResolver::handleResult(const Result& result)
+{
+  if (result.is_ttl_update)
+  {
+    Cache::iterator cit = m_cache.find(result.label);
+    if ((cit != m_cache.end()) &&
+        ((*cit).second.addresses == result.addresses))
+    {
+      setExpiry((*cit).second, result.ttl);
+    }
+    return;
+  }
+
+  if (result.status == 0)
+  {
+    CacheEntry& entry = m_cache[result.label];
+    entry.addresses = result.addresses;
+    setExpiry(entry, DEFAULT_TTL);
+  }
+#ifdef EAI_NODATA
+  else if ((result.status == EAI_NONAME) || (result.status == EAI_NODATA))
+#else
+  else if (result.status == EAI_NONAME)
+#endif
+  {
+    CacheEntry& entry = m_cache[result.label];
+    entry.addresses.clear();
+    setExpiry(entry, NEGATIVE_TTL);
+  }
+
+  PendingMap::iterator pit = m_pending.find(result.label);
+  if (pit == m_pending.end())
+  {
+    return;
+  }
+  m_notify = (*pit).second;
+  m_pending.erase(pit);
+
+    // A worker may be deleted by the user when another worker reports its
+    // result so the list is updated by the cancel function
+  while (!m_notify.empty())
+  {
+    CppDnsLookupWorker *worker = m_notify.front();
+    m_notify.erase(m_notify.begin());
+    worker->setResult(result.addresses);
+  }
+} /* CppDnsResolver::handleResult */
+
+
+void CppDnsResolver::setExpiry(CacheEntry& entry, unsigned ttl)
+{
+  if (ttl < MIN_TTL)
+  {
+    ttl = MIN_TTL;
+  }
+  else if (ttl > MAX_TTL)
+  {
+    ttl = MAX_TTL;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &entry.expires);
+  entry.expires.tv_sec += ttl;
+} /* CppDnsResolver::setExpiry */
+
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  queryTtl
+ * Purpose:   Query the DNS for the A records of a name to find the TTL of
+ *            the answer.
+ * Input:     res   - The resolver state for this thread
+ *            label - The name to look up
+ * Output:    Returns the lowest TTL of the A records or 0 if no answer
+ * Author:    Tobias Blomberg
+ * Created:   2020-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+static unsigned queryTtl(struct __res_state *res, const string& label)
+{
+  unsigned char answer[NS_PACKETSZ];
+  int len = res_nsearch(res, label.c_str(), ns_c_in, ns_t_a, answer,
+                        sizeof(answer));
+  if (len < 0)
+  {
+    return 0;
+  }
+  ns_msg msg;
+  if (ns_initparse(answer, min(len, static_cast<int>(sizeof(answer))),
+                   &msg) < 0)
+  {
+    return 0;
+  }
+  unsigned ttl = 0;
+  for (int i=0; i<ns_msg_count(msg, ns_s_an); ++i)
+  {
+    ns_rr rr;
+    if ((ns_parserr(&msg, ns_s_an, i, &rr) == 0) &&
+        (ns_rr_type(rr) == ns_t_a) &&
+        ((ttl == 0) || (ns_rr_ttl(rr) < ttl)))
+    {
+      ttl = ns_rr_ttl(rr);
+    }
+  }
+  return ttl;
+} /* queryTtl */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,221 @@
+/**
+@file   AsyncCppDnsResolver.h
+@brief  A shared resolver with a cache for the Cpp DNS lookup workers
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains the resolver used by the Cpp variant of the async
+environment to execute DNS queries. This class should never be used directly.
+It is used by Async::CppDnsLookupWorker.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_CPP_DNS_RESOLVER_INCLUDED
+#define ASYNC_CPP_DNS_RESOLVER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncIpAddress.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class FdWatch;
+class CppDnsLookupWorker;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A shared resolver with a cache for the Cpp DNS lookup workers
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+All DNS lookups in the Cpp variant of the async environment go through this
+resolver. The lookups are executed by a small pool of threads since the system
+resolver functions are blocking. Simultaneous lookups of the same name are
+coalesced into one query and the answers are cached.
+
+The addresses are looked up using getaddrinfo so that the system
+configuration, like /etc/hosts, is honoured. Since getaddrinfo does not give
+the TTL of the answer, a second query is made to the DNS to find it. Until that
+query returns, a short default TTL is used. Names that do not exist are cached
+for a short while too. Temporary failures are not cached.
+
+This is an internal class that should only be used from within the async
+library.
+*/
+class CppDnsResolver : public sigc::trackable
+{
+  public:
+    /**
+     * @brief   Get the resolver instance
+     * @return  Returns the resolver
+     */
+    static CppDnsResolver& instance(void);
+
+    /**
+     * @brief   Start a lookup
+     * @param   worker  The worker that should receive the result
+     * @param   label   The label (hostname) to lookup
+     *
+     * The result is always delivered asynchronously to the worker, even when
+     * it is found in the cache.
+     */
+    void lookup(CppDnsLookupWorker *worker, const std::string& label);
+
+    /**
+     * @brief   Cancel all lookups for a worker
+     * @param   worker  The worker that is going away
+     */
+    void cancel(CppDnsLookupWorker *worker);
+
+  private:
+    static const unsigned MAX_THREADS   = 4;
+    static const unsigned DEFAULT_TTL   = 60;
+    static const unsigned MIN_TTL       = 10;
+    static const unsigned MAX_TTL       = 3600;
+    static const unsigned NEGATIVE_TTL  = 30;
+
+    struct Result
+    {
+      std::string             label;
+      bool                    is_ttl_update;
+      int                     status;
+      unsigned                ttl;
+      std::vector<IpAddress>  addresses;
+    };
+    struct CacheEntry
+    {
+      std::vector<IpAddress>  addresses;
+      struct timespec         expires;
+    };
+    typedef std::vector<CppDnsLookupWorker*>      Waiters;
+    typedef std::map<std::string, Waiters>        PendingMap;
+    typedef std::map<std::string, CacheEntry>     Cache;
+
+    pthread_mutex_t           m_mutex;
+    pthread_cond_t            m_cond;
+    std::deque<std::string>   m_jobs;
+    std::deque<Result>        m_results;
+    unsigned                  m_thread_cnt;
+    unsigned                  m_idle_thread_cnt;
+    int                       m_notifier_rd;
+    int                       m_notifier_wr;
+    FdWatch*                  m_notifier_watch;
+    PendingMap                m_pending;
+    Cache                     m_cache;
+    Waiters                   m_notify;
+
+    CppDnsResolver(void);
+    ~CppDnsResolver(void);
+    CppDnsResolver(const CppDnsResolver&);
+    CppDnsResolver& operator=(const CppDnsResolver&);
+    static void *threadFunc(void *arg);
+    void run(void);
+    void postResult(const Result& result);
+    void notificationReceived(FdWatch *w);
+    void handleResult(const Result& result);
+    void setExpiry(CacheEntry& entry, unsigned ttl);
+
+};  /* class CppDnsResolver */
+
+
+} /* namespace */
+
+#endif /* ASYNC_CPP_DNS_RESOLVER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
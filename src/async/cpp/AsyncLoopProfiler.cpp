@@ -0,0 +1,328 @@
+/**
+@file   AsyncLoopProfiler.cpp
+@brief  Measure how long the main loop callbacks take
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that collect statistics about how long each
+callback site in the Async main loop take to run and how late timers expire.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncMetrics.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncLoopProfiler.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+LoopProfiler::Histogram::Histogram(void)
+  : count(0), total_ns(0), max_ns(0)
+{
+  std::fill(buckets, buckets + BUCKET_CNT, 0);
+} /* LoopProfiler::Histogram::Histogram */
+
+
+void LoopProfiler::Histogram::add(unsigned long long ns)
+{
+  ++count;
+  total_ns += ns;
+  max_ns = std::max(max_ns, ns);
+  unsigned long long us = ns / 1000;
+  int bucket = 0;
+  while ((bucket < BUCKET_CNT-1) && (us >= (1ULL << bucket)))
+  {
+    ++bucket;
+  }
+  ++buckets[bucket];
+} /* LoopProfiler::Histogram::add */
+
+
+unsigned long long LoopProfiler::Histogram::percentileNs(double percent) const
+{
+  unsigned long long limit =
+    static_cast<unsigned long long>(percent * count / 100.0 + 0.5);
+  unsigned long long sum = 0;
+  for (int bucket=0; bucket<BUCKET_CNT-1; ++bucket)
+  {
+    sum += buckets[bucket];
+    if ((sum >= limit) && (sum > 0))
+    {
+      return std::min(max_ns, (1ULL << bucket) * 1000ULL);
+    }
+  }
+  return max_ns;
+} /* LoopProfiler::Histogram::percentileNs */
+
+
+std::string LoopProfiler::SiteId::name(void) const
+{
+  ostringstream ss;
+  switch (type)
+  {
+    case SITE_FD_RD:
+      ss << "fd " << id << " rd";
+      break;
+    case SITE_FD_WR:
+      ss << "fd " << id << " wr";
+      break;
+    case SITE_TIMER_ONESHOT:
+      ss << "timer " << id << "ms oneshot";
+      break;
+    case SITE_TIMER_PERIODIC:
+      ss << "timer " << id << "ms periodic";
+      break;
+  }
+  return ss.str();
+} /* LoopProfiler::SiteId::name */
+
+
+LoopProfiler::LoopProfiler(void)
+  : warn_thresh_ms(DEFAULT_WARN_THRESH_MS)
+{
+} /* LoopProfiler::LoopProfiler */
+
+
+void LoopProfiler::callbackDone(const SiteId& site,
+                                const struct timespec& start,
+                                const struct timespec& end)
+{
+  unsigned long long ns = elapsedNs(start, end);
+  m_sites[site].add(ns);
+  if ((warn_thresh_ms > 0) && (ns >= warn_thresh_ms * 1000000ULL))
+  {
+    cerr << "*** WARNING: Async main loop callback \"" << site.name()
+         << "\" took " << (ns / 1000000) << "ms" << endl;
+    slowCallback(site, ns);
+  }
+} /* LoopProfiler::callbackDone */
+
+
+void LoopProfiler::timerLag(long long lag_ns)
+{
+  m_timer_lags.add((lag_ns > 0) ? lag_ns : 0);
+} /* LoopProfiler::timerLag */
+
+
+void LoopProfiler::iterationDone(const struct timespec& start,
+                                 const struct timespec& end)
+{
+  m_iterations.add(elapsedNs(start, end));
+} /* LoopProfiler::iterationDone */
+
+
+void LoopProfiler::reset(void)
+{
+  m_sites.clear();
+  m_iterations = Histogram();
+  m_timer_lags = Histogram();
+} /* LoopProfiler::reset */
+
+
+void LoopProfiler::print(std::ostream& os) const
+{
+  os << "--- Async main loop profile (times in microseconds)\n";
+  os << left << setw(24) << "Site" << right << setw(12) << "Count"
+     << setw(12) << "Total" << setw(10) << "Avg" << setw(10) << "P99"
+     << setw(10) << "Max" << "\n";
+  printHistogram(os, "Loop iterations", m_iterations);
+  printHistogram(os, "Timer lag", m_timer_lags);
+
+  std::vector<std::pair<unsigned long long, SiteMap::const_iterator> > order;
+  for (SiteMap::const_iterator it=m_sites.begin(); it!=m_sites.end(); ++it)
+  {
+    order.push_back(std::make_pair(it->second.total_ns, it));
+  }
+  std::sort(order.begin(), order.end(), compareTotal);
+  for (size_t i=0; i<order.size(); ++i)
+  {
+    printHistogram(os, order[i].second->first.name(), order[i].second->second);
+  }
+  os << flush;
+} /* LoopProfiler::print */
+
+
+void LoopProfiler::writeMetrics(MetricsWriter& writer) const
+{
+  writeHistogram(writer, "async_loop_iteration_seconds",
+      "Time the main loop was busy handling events per iteration",
+      m_iterations);
+  writeHistogram(writer, "async_loop_timer_lag_seconds",
+      "How late timers expired compared to when they were due",
+      m_timer_lags);
+  for (SiteMap::const_iterator it=m_sites.begin(); it!=m_sites.end(); ++it)
+  {
+    MetricsWriter::Labels labels(Metrics::labels("site", it->first.name()));
+    writer.counter("async_loop_callbacks",
+        "Number of main loop callbacks run", labels, it->second.count);
+    writer.counter("async_loop_callback_seconds",
+        "Time spent in main loop callbacks", labels,
+        it->second.total_ns / 1.0e9);
+    writer.gauge("async_loop_callback_max_seconds",
+        "The longest time a main loop callback has run", labels,
+        it->second.max_ns / 1.0e9);
+  }
+} /* LoopProfiler::writeMetrics */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+unsigned long long LoopProfiler::elapsedNs(const struct timespec& start,
+                                           const struct timespec& end)
+{
+  long long ns = (static_cast<long long>(end.tv_sec) - start.tv_sec) *
+                 1000000000LL + (end.tv_nsec - start.tv_nsec);
+  return (ns > 0) ? ns : 0;
+} /* LoopProfiler::elapsedNs */
+
+
+bool LoopProfiler::compareTotal(
+    const std::pair<unsigned long long, SiteMap::const_iterator>& a,
+    const std::pair<unsigned long long, SiteMap::const_iterator>& b)
+{
+  return a.first > b.first;
+} /* LoopProfiler::compareTotal */
+
+
+void LoopProfiler::printHistogram(std::ostream& os, const std::string& name,
+                                  const Histogram& hist)
+{
+  os << left << setw(24) << name << right << setw(12) << hist.count
+     << setw(12) << (hist.total_ns / 1000)
+     << setw(10) << ((hist.count > 0) ? hist.total_ns / hist.count / 1000 : 0)
+     << setw(10) << (hist.percentileNs(99.0) / 1000)
+     << setw(10) << (hist.max_ns / 1000) << "\n";
+} /* LoopProfiler::printHistogram */
+
+
+void LoopProfiler::writeHistogram(MetricsWriter& writer,
+                                  const std::string& name,
+                                  const std::string& help,
+                                  const Histogram& hist)
+{
+  std::vector<MetricsWriter::Bucket> buckets;
+  unsigned long long sum = 0;
+  for (int bucket=0; bucket<BUCKET_CNT-1; ++bucket)
+  {
+    sum += hist.buckets[bucket];
+    buckets.push_back(MetricsWriter::Bucket((1ULL << bucket) / 1.0e6, sum));
+  }
+  writer.histogram(name, help, MetricsWriter::Labels(), buckets, hist.count,
+                   hist.total_ns / 1.0e9);
+} /* LoopProfiler::writeHistogram */
+
+
+/*
+ * This file has not been truncated
+ */
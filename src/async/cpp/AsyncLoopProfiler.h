@@ -0,0 +1,335 @@
+/**
+@file   AsyncLoopProfiler.h
+@brief  Measure how long the main loop callbacks take
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that collect statistics about how long each
+callback site in the Async main loop take to run and how late timers expire.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_LOOP_PROFILER_INCLUDED
+#define ASYNC_LOOP_PROFILER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+#include <sigc++/sigc++.h>
+
+#include <map>
+#include <string>
+#include <utility>
+#include <ostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class MetricsWriter;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Collect timing statistics for the Async main loop callbacks
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+Everything in an Async application run from the same main loop so a single
+callback that take too long to execute will delay everything else, which for
+example is heard as audio glitches. This class keep a duration histogram for
+each callback site in the main loop. A callback site is identified by the file
+descriptor and direction for file descriptor watches and by the timeout and
+type for timers, since those normally are unique enough to find the code that
+set them up.
+
+Apart from the callback durations, a histogram is kept for how long each main
+loop iteration is busy and for how late timers expire compared to when they
+were due, the loop lag.
+
+Profiling is normally enabled by setting the environment variable
+ASYNC_LOOP_PROFILE before starting the application. See the CppApplication
+class for the details.
+*/
+class LoopProfiler
+{
+  public:
+    /**
+     * @brief   The number of buckets in each histogram
+     *
+     * Bucket n, except the last one, count durations shorter than 2^n
+     * microseconds. The last bucket count all longer durations.
+     */
+    static const int BUCKET_CNT = 20;
+
+    /**
+     * @brief   The default callback duration warning threshold
+     */
+    static const unsigned DEFAULT_WARN_THRESH_MS = 50;
+
+    /**
+     * @brief   A duration histogram
+     */
+    struct Histogram
+    {
+      unsigned long long  count;                ///< Number of samples
+      unsigned long long  total_ns;             ///< Sum of all samples
+      unsigned long long  max_ns;               ///< The longest sample
+      unsigned long long  buckets[BUCKET_CNT];  ///< Log2 histogram buckets
+
+      Histogram(void);
+
+      /**
+       * @brief   Add a sample to the histogram
+       * @param   ns The duration in nanoseconds
+       */
+      void add(unsigned long long ns);
+
+      /**
+       * @brief   Get an upper bound for a percentile
+       * @param   percent The percentile to look up (0-100)
+       * @return  Returns the upper limit, in nanoseconds, of the bucket where
+       *          the given percentile is found
+       */
+      unsigned long long percentileNs(double percent) const;
+    };
+
+    /**
+     * @brief   The different types of callback sites
+     */
+    typedef enum
+    {
+      SITE_FD_RD,           ///< A file descriptor read watch
+      SITE_FD_WR,           ///< A file descriptor write watch
+      SITE_TIMER_ONESHOT,   ///< A one shot timer
+      SITE_TIMER_PERIODIC   ///< A periodic timer
+    } SiteType;
+
+    /**
+     * @brief   Identification of a callback site
+     */
+    struct SiteId
+    {
+      SiteType  type; ///< The type of callback site
+      int       id;   ///< The file descriptor or the timeout in milliseconds
+
+      SiteId(SiteType type, int id) : type(type), id(id) {}
+      bool operator<(const SiteId& other) const
+      {
+        return (type < other.type) || ((type == other.type) && (id < other.id));
+      }
+
+      /**
+       * @brief   Get a printable name for the callback site
+       * @return  Returns a string like "fd 7 rd" or "timer 20ms periodic"
+       */
+      std::string name(void) const;
+    };
+
+    typedef std::map<SiteId, Histogram> SiteMap;
+
+    /**
+     * @brief   Default constructor
+     */
+    LoopProfiler(void);
+
+    /**
+     * @brief   Set the callback duration warning threshold
+     * @param   thresh_ms The threshold in milliseconds, 0 to disable warnings
+     */
+    void setWarnThreshold(unsigned thresh_ms) { warn_thresh_ms = thresh_ms; }
+
+    /**
+     * @brief   Get the callback duration warning threshold
+     * @return  Returns the threshold in milliseconds
+     */
+    unsigned warnThreshold(void) const { return warn_thresh_ms; }
+
+    /**
+     * @brief   Record the duration of a callback
+     * @param   site  The callback site
+     * @param   start When the callback was called (CLOCK_MONOTONIC)
+     * @param   end   When the callback returned (CLOCK_MONOTONIC)
+     */
+    void callbackDone(const SiteId& site, const struct timespec& start,
+                      const struct timespec& end);
+
+    /**
+     * @brief   Record how late a timer expired
+     * @param   lag_ns The time in nanoseconds since the timer was due
+     */
+    void timerLag(long long lag_ns);
+
+    /**
+     * @brief   Record how long a main loop iteration was busy
+     * @param   start When the wait for events returned (CLOCK_MONOTONIC)
+     * @param   end   When all events had been handled (CLOCK_MONOTONIC)
+     */
+    void iterationDone(const struct timespec& start,
+                       const struct timespec& end);
+
+    /**
+     * @brief   Get the statistics for all callback sites
+     * @return  Returns a map from callback site to duration histogram
+     */
+    const SiteMap& sites(void) const { return m_sites; }
+
+    /**
+     * @brief   Get the main loop iteration busy time histogram
+     * @return  Returns a reference to the histogram
+     */
+    const Histogram& iterations(void) const { return m_iterations; }
+
+    /**
+     * @brief   Get the timer lag histogram
+     * @return  Returns a reference to the histogram
+     */
+    const Histogram& timerLags(void) const { return m_timer_lags; }
+
+    /**
+     * @brief   Clear all collected statistics
+     */
+    void reset(void);
+
+    /**
+     * @brief   Print a report of the collected statistics
+     * @param   os The stream to print to
+     *
+     * The callback sites are sorted with the one that have used the most
+     * time in total first.
+     */
+    void print(std::ostream& os) const;
+
+    /**
+     * @brief   Write the collected statistics as metrics
+     * @param   writer The metrics writer to add the samples to
+     *
+     * The loop iteration busy time and the timer lag are written as
+     * histograms. The callback sites are written as counters for the number
+     * of calls and the total time spent in them.
+     */
+    void writeMetrics(MetricsWriter& writer) const;
+
+    /**
+     * @brief   A signal that is emitted when a callback took too long
+     * @param   site The callback site
+     * @param   duration_ns The callback duration in nanoseconds
+     *
+     * This signal is emitted after a callback has taken longer than the
+     * warning threshold to run. A warning is also printed on stderr.
+     */
+    sigc::signal<void, const SiteId&, unsigned long long> slowCallback;
+
+  private:
+    unsigned    warn_thresh_ms;
+    SiteMap     m_sites;
+    Histogram   m_iterations;
+    Histogram   m_timer_lags;
+
+    LoopProfiler(const LoopProfiler&);
+    LoopProfiler& operator=(const LoopProfiler&);
+
+    static unsigned long long elapsedNs(const struct timespec& start,
+                                        const struct timespec& end);
+    static bool compareTotal(
+        const std::pair<unsigned long long, SiteMap::const_iterator>& a,
+        const std::pair<unsigned long long, SiteMap::const_iterator>& b);
+    static void printHistogram(std::ostream& os, const std::string& name,
+                               const Histogram& hist);
+    static void writeHistogram(MetricsWriter& writer, const std::string& name,
+                               const std::string& help,
+                               const Histogram& hist);
+
+};  /* class LoopProfiler */
+
+
+} /* namespace */
+
+#endif /* ASYNC_LOOP_PROFILER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,551 @@
+/**
+@file   AsyncTimerWheel.cpp
+@brief  A hierarchical timer wheel used by the Async main loop
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a hierarchical timer wheel that is used by the
+CppApplication class to keep track of all active timers.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstring>
+#include <cassert>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "AsyncTimer.h"
+#include "AsyncTimerWheel.h"
+#include "AsyncLoopProfiler.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+TimerWheel::TimerWheel(void)
+  : m_wheel_cnt(0), m_next_tick(0), m_firing(0), m_firing_removed(false),
+    m_profiler(0)
+{
+  memset(m_used, 0, sizeof(m_used));
+  memset(&m_stats, 0, sizeof(m_stats));
+  for (int i=0; i<SLOT_CNT_TOT; ++i)
+  {
+    m_slots[i] = 0;
+    m_tails[i] = &m_slots[i];
+  }
+  clock_gettime(CLOCK_MONOTONIC, &m_base);
+} /* TimerWheel::TimerWheel */
+
+
+TimerWheel::~TimerWheel(void)
+{
+  for (int slot=0; slot<SLOT_CNT_TOT; ++slot)
+  {
+    while (m_slots[slot] != 0)
+    {
+      unlink(m_slots[slot]);
+    }
+  }
+} /* TimerWheel::~TimerWheel */
+
+
+void TimerWheel::add(Timer *timer, const struct timespec& now)
+{
+  assert(timer->m_wheel_pprev == 0);
+  assert(timer->timeout() >= 0);
+  if (timer->timeout() == 0)
+  {
+      // Make sure that zero timeout timers expire on the next main loop
+      // iteration and not on the next millisecond tick
+    timer->m_wheel_expire = 0;
+  }
+  else
+  {
+    timer->m_wheel_expire = ticks(now, true) + timer->timeout();
+  }
+  insert(timer);
+  ++m_stats.added;
+  ++m_stats.active;
+} /* TimerWheel::add */
+
+
+void TimerWheel::del(Timer *timer)
+{
+  if (timer == m_firing)
+  {
+    m_firing_removed = true;
+  }
+  if (timer->m_wheel_pprev != 0)
+  {
+    unlink(timer);
+    --m_stats.active;
+  }
+} /* TimerWheel::del */
+
+
+bool TimerWheel::nextTimeout(const struct timespec& now,
+                             struct timespec& timeout)
+{
+  if (m_slots[SLOT_DUE] != 0)
+  {
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = 0;
+    return true;
+  }
+  if (m_wheel_cnt == 0)
+  {
+    return false;
+  }
+
+  const int start = m_next_tick & (L0_SIZE - 1);
+  unsigned long long next_tick = 0;
+  bool found = false;
+  int dist = firstUsed(0, L0_SIZE, start);
+  if (dist >= 0)
+  {
+    next_tick = m_next_tick + dist;
+    found = true;
+  }
+
+    // Timers in the higher levels may expire before the ones found in the
+    // first level so we need to wake up for the next cascade, if any
+  if (firstUsed(L0_SIZE, LN_CNT * LN_SIZE, 0) >= 0)
+  {
+    unsigned long long cascade_tick =
+      (start == 0) ? m_next_tick : (m_next_tick | (L0_SIZE - 1)) + 1;
+    if (!found || (cascade_tick < next_tick))
+    {
+      next_tick = cascade_tick;
+      found = true;
+    }
+  }
+  assert(found);
+
+  long long now_ms = static_cast<long long>(ticks(now, false));
+  if (static_cast<long long>(next_tick) <= now_ms)
+  {
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = 0;
+    return true;
+  }
+  struct timespec expire;
+  expire.tv_sec = m_base.tv_sec + next_tick / 1000;
+  expire.tv_nsec = m_base.tv_nsec + (next_tick % 1000) * 1000000;
+  if (expire.tv_nsec >= 1000000000)
+  {
+    ++expire.tv_sec;
+    expire.tv_nsec -= 1000000000;
+  }
+  timeout.tv_sec = expire.tv_sec - now.tv_sec;
+  timeout.tv_nsec = expire.tv_nsec - now.tv_nsec;
+  if (timeout.tv_nsec < 0)
+  {
+    --timeout.tv_sec;
+    timeout.tv_nsec += 1000000000;
+  }
+  if (timeout.tv_sec < 0)
+  {
+    timeout.tv_sec = 0;
+    timeout.tv_nsec = 0;
+  }
+  return true;
+} /* TimerWheel::nextTimeout */
+
+
+unsigned TimerWheel::expire(const struct timespec& now)
+{
+  advance(ticks(now, false));
+  if (m_slots[SLOT_DUE] == 0)
+  {
+    addOverhead(now);
+    return 0;
+  }
+
+    // Move all due timers to the batch list. Timers that are added by the
+    // expiration handlers will end up on the due list and will thus not
+    // expire until the next call to this function.
+  assert(m_slots[SLOT_BATCH] == 0);
+  for (Timer *t = m_slots[SLOT_DUE]; t != 0; t = t->m_wheel_next)
+  {
+    t->m_wheel_slot = SLOT_BATCH;
+  }
+  m_slots[SLOT_BATCH] = m_slots[SLOT_DUE];
+  m_slots[SLOT_BATCH]->m_wheel_pprev = &m_slots[SLOT_BATCH];
+  m_tails[SLOT_BATCH] = m_tails[SLOT_DUE];
+  m_slots[SLOT_DUE] = 0;
+  m_tails[SLOT_DUE] = &m_slots[SLOT_DUE];
+  setUsed(SLOT_DUE, false);
+  setUsed(SLOT_BATCH, true);
+  ++m_stats.batches;
+  addOverhead(now);
+
+  unsigned cnt = 0;
+  while (m_slots[SLOT_BATCH] != 0)
+  {
+    Timer *timer = m_slots[SLOT_BATCH];
+    unlink(timer);
+    --m_stats.active;
+    ++m_stats.expired;
+    ++cnt;
+
+    m_firing = timer;
+    m_firing_removed = false;
+    if (m_profiler != 0)
+    {
+      profiledExpire(timer);
+    }
+    else
+    {
+      timer->expired(timer);
+    }
+    m_firing = 0;
+
+      // The timer may have been deleted or restarted by the handler
+    if (!m_firing_removed && (timer->type() == Timer::TYPE_PERIODIC))
+    {
+      timer->m_wheel_expire += timer->timeout();
+      insert(timer);
+      ++m_stats.active;
+    }
+  }
+
+  return cnt;
+} /* TimerWheel::expire */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+unsigned long long TimerWheel::ticks(const struct timespec& ts,
+                                     bool round_up) const
+{
+  long long ns = (static_cast<long long>(ts.tv_sec) - m_base.tv_sec) *
+                 1000000000LL + (ts.tv_nsec - m_base.tv_nsec);
+  if (ns < 0)
+  {
+    return 0;
+  }
+  if (round_up)
+  {
+    ns += 999999;
+  }
+  return static_cast<unsigned long long>(ns / 1000000);
+} /* TimerWheel::ticks */
+
+
+void TimerWheel::insert(Timer *timer)
+{
+  const unsigned long long expire = timer->m_wheel_expire;
+  if (expire < m_next_tick)
+  {
+    link(timer, SLOT_DUE);
+    return;
+  }
+
+  const unsigned long long delta = expire - m_next_tick;
+  if (delta < static_cast<unsigned long long>(L0_SIZE))
+  {
+    link(timer, expire & (L0_SIZE - 1));
+    return;
+  }
+  for (int level=1; level<=LN_CNT; ++level)
+  {
+    const int shift = L0_BITS + level * LN_BITS;
+    if ((delta < (1ULL << shift)) || (level == LN_CNT))
+    {
+      assert(delta < (1ULL << shift));
+      int idx = (expire >> (shift - LN_BITS)) & (LN_SIZE - 1);
+      link(timer, L0_SIZE + (level - 1) * LN_SIZE + idx);
+      return;
+    }
+  }
+} /* TimerWheel::insert */
+
+
+void TimerWheel::link(Timer *timer, int slot)
+{
+  timer->m_wheel_next = 0;
+  timer->m_wheel_pprev = m_tails[slot];
+  timer->m_wheel_slot = slot;
+  *m_tails[slot] = timer;
+  m_tails[slot] = &timer->m_wheel_next;
+  setUsed(slot, true);
+  if (slot < SLOT_CNT)
+  {
+    ++m_wheel_cnt;
+  }
+} /* TimerWheel::link */
+
+
+void TimerWheel::unlink(Timer *timer)
+{
+  const int slot = timer->m_wheel_slot;
+  assert((slot >= 0) && (timer->m_wheel_pprev != 0));
+  *timer->m_wheel_pprev = timer->m_wheel_next;
+  if (timer->m_wheel_next != 0)
+  {
+    timer->m_wheel_next->m_wheel_pprev = timer->m_wheel_pprev;
+  }
+  else
+  {
+    m_tails[slot] = timer->m_wheel_pprev;
+  }
+  if (m_slots[slot] == 0)
+  {
+    setUsed(slot, false);
+  }
+  if (slot < SLOT_CNT)
+  {
+    --m_wheel_cnt;
+  }
+  timer->m_wheel_next = 0;
+  timer->m_wheel_pprev = 0;
+  timer->m_wheel_slot = -1;
+} /* TimerWheel::unlink */
+
+
+void TimerWheel::advance(unsigned long long now_tick)
+{
+  while (m_next_tick <= now_tick)
+  {
+    if (m_wheel_cnt == 0)
+    {
+      m_next_tick = now_tick + 1;
+      break;
+    }
+
+    const int idx = m_next_tick & (L0_SIZE - 1);
+    if (idx == 0)
+    {
+      for (int level=1; level<=LN_CNT; ++level)
+      {
+        const int shift = L0_BITS + (level - 1) * LN_BITS;
+        const int lidx = (m_next_tick >> shift) & (LN_SIZE - 1);
+        cascade(L0_SIZE + (level - 1) * LN_SIZE + lidx);
+        if (lidx != 0)
+        {
+          break;
+        }
+      }
+    }
+    else if (firstUsed(0, L0_SIZE, 0) < 0)
+    {
+        // Nothing to do in the first level so skip ahead to the next cascade
+      unsigned long long skip_to = (m_next_tick | (L0_SIZE - 1)) + 1;
+      m_next_tick = (skip_to > now_tick) ? now_tick + 1 : skip_to;
+      continue;
+    }
+
+    while (m_slots[idx] != 0)
+    {
+      Timer *timer = m_slots[idx];
+      unlink(timer);
+      link(timer, SLOT_DUE);
+    }
+    ++m_next_tick;
+  }
+} /* TimerWheel::advance */
+
+
+void TimerWheel::cascade(int slot)
+{
+  Timer *timer = m_slots[slot];
+  while (timer != 0)
+  {
+    Timer *next = timer->m_wheel_next;
+    unlink(timer);
+    insert(timer);
+    ++m_stats.cascaded;
+    timer = next;
+  }
+} /* TimerWheel::cascade */
+
+
+int TimerWheel::firstUsed(int first, int cnt, int start) const
+{
+  int offset = 0;
+  while (offset < cnt)
+  {
+    const int slot = first + ((start + offset) % cnt);
+    const unsigned long long word = m_used[slot / 64] >> (slot % 64);
+    if (word == 0)
+    {
+        // Skip to the start of the next bitmap word
+      offset += 64 - (slot % 64);
+      continue;
+    }
+    int dist = __builtin_ctzll(word);
+    if (offset + dist < cnt)
+    {
+      return offset + dist;
+    }
+    return -1;
+  }
+  return -1;
+} /* TimerWheel::firstUsed */
+
+
+void TimerWheel::setUsed(int slot, bool used)
+{
+  if (used)
+  {
+    m_used[slot / 64] |= 1ULL << (slot % 64);
+  }
+  else
+  {
+    m_used[slot / 64] &= ~(1ULL << (slot % 64));
+  }
+} /* TimerWheel::setUsed */
+
+
+void TimerWheel::profiledExpire(Timer *timer)
+{
+    // The timer may be deleted by the handler so everything needed for the
+    // profiling must be read out before calling it
+  LoopProfiler::SiteId site(
+      (timer->type() == Timer::TYPE_PERIODIC) ?
+        LoopProfiler::SITE_TIMER_PERIODIC : LoopProfiler::SITE_TIMER_ONESHOT,
+      timer->timeout());
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (timer->m_wheel_expire > 0)
+  {
+    long long due_ns =
+      static_cast<long long>(m_base.tv_sec) * 1000000000LL + m_base.tv_nsec +
+      static_cast<long long>(timer->m_wheel_expire) * 1000000LL;
+    m_profiler->timerLag(static_cast<long long>(start.tv_sec) * 1000000000LL +
+                         start.tv_nsec - due_ns);
+  }
+  timer->expired(timer);
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  m_profiler->callbackDone(site, start, end);
+} /* TimerWheel::profiledExpire */
+
+
+void TimerWheel::addOverhead(const struct timespec& start)
+{
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  long long ns = (static_cast<long long>(end.tv_sec) - start.tv_sec) *
+                 1000000000LL + (end.tv_nsec - start.tv_nsec);
+  if (ns > 0)
+  {
+    m_stats.overhead_ns += ns;
+  }
+} /* TimerWheel::addOverhead */
+
+
+/*
+ * This file has not been truncated
+ */
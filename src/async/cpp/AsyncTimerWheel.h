@@ -0,0 +1,255 @@
+/**
+@file   AsyncTimerWheel.h
+@brief  A hierarchical timer wheel used by the Async main loop
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a hierarchical timer wheel that is used by the
+CppApplication class to keep track of all active timers.
+
+\verbatim
+Async - A library for programming event driven applications
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ASYNC_TIMER_WHEEL_INCLUDED
+#define ASYNC_TIMER_WHEEL_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class Timer;
+class LoopProfiler;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  A hierarchical timer wheel
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class keep track of active timers using a hierarchical timer wheel with a
+resolution of one millisecond. Adding, removing and expiring a timer are all
+constant time operations. The wheel consist of five levels where the first
+level have 256 slots, each one representing one millisecond, and the rest of
+the levels have 64 slots each. Timers far into the future are placed in the
+higher levels and are cascaded down to lower levels as time passes. This
+covers the full range of timeout values that a timer can have.
+
+The timer objects themselves are used as list nodes so no memory allocation
+is done when timers are started, restarted or stopped.
+
+This class is an internal helper for the CppApplication class and is not
+meant to be used directly by applications.
+*/
+class TimerWheel
+{
+  public:
+    /**
+     * @brief   Statistics for the timer handling
+     */
+    struct Stats
+    {
+      unsigned long long  active;       ///< Currently active timers
+      unsigned long long  added;        ///< Timers started since creation
+      unsigned long long  expired;      ///< Timer expirations since creation
+      unsigned long long  cascaded;     ///< Timers moved to a lower level
+      unsigned long long  batches;      ///< Loop iterations expiring timers
+      unsigned long long  overhead_ns;  ///< Time spent maintaining the wheel
+    };
+
+    /**
+     * @brief   Default constructor
+     */
+    TimerWheel(void);
+
+    /**
+     * @brief   Destructor
+     */
+    ~TimerWheel(void);
+
+    /**
+     * @brief   Add a timer to the wheel
+     * @param   timer The timer to add
+     * @param   now   The current time (CLOCK_MONOTONIC)
+     *
+     * The timer will expire when its timeout time has elapsed, counted from
+     * the given time.
+     */
+    void add(Timer *timer, const struct timespec& now);
+
+    /**
+     * @brief   Remove a timer from the wheel
+     * @param   timer The timer to remove
+     *
+     * It is safe to call this function for a timer that is not in the wheel.
+     */
+    void del(Timer *timer);
+
+    /**
+     * @brief   Calculate the time until the next timer expires
+     * @param   now     The current time (CLOCK_MONOTONIC)
+     * @param   timeout Will be set to the time left to the next expiration
+     * @return  Returns \em false if there are no active timers
+     *
+     * The returned timeout may be shorter than the time left for the first
+     * timer. That happens when timers need to be cascaded from a higher level
+     * of the wheel.
+     */
+    bool nextTimeout(const struct timespec& now, struct timespec& timeout);
+
+    /**
+     * @brief   Expire all timers that are due
+     * @param   now The current time (CLOCK_MONOTONIC)
+     * @return  Returns the number of timers that expired
+     *
+     * All timers that are due will expire in one go. Timers that are started
+     * by the expiration handlers will not expire until the next call to this
+     * function, even if they have a timeout of zero.
+     */
+    unsigned expire(const struct timespec& now);
+
+    /**
+     * @brief   Get statistics for the timer handling
+     * @return  Returns a reference to the statistics
+     */
+    const Stats& stats(void) const { return m_stats; }
+
+    /**
+     * @brief   Set the profiler to report timer expirations to
+     * @param   profiler The profiler to use or 0 to not profile timers
+     */
+    void setProfiler(LoopProfiler *profiler) { m_profiler = profiler; }
+
+  private:
+      // Level 0 have 256 slots with a resolution of one millisecond. Level 1
+      // to 4 have 64 slots each, covering 2^32 milliseconds in total.
+    static const int      L0_BITS   = 8;
+    static const int      LN_BITS   = 6;
+    static const int      L0_SIZE   = 1 << L0_BITS;
+    static const int      LN_SIZE   = 1 << LN_BITS;
+    static const int      LN_CNT    = 4;
+    static const int      SLOT_CNT  = L0_SIZE + LN_CNT * LN_SIZE;
+    static const int      SLOT_DUE  = SLOT_CNT;
+    static const int      SLOT_BATCH = SLOT_CNT + 1;
+    static const int      SLOT_CNT_TOT = SLOT_CNT + 2;
+
+    Timer*                m_slots[SLOT_CNT_TOT];
+    Timer**               m_tails[SLOT_CNT_TOT];
+    unsigned long long    m_used[(SLOT_CNT_TOT + 63) / 64];
+    unsigned long long    m_wheel_cnt;
+    unsigned long long    m_next_tick;
+    struct timespec       m_base;
+    Timer*                m_firing;
+    bool                  m_firing_removed;
+    Stats                 m_stats;
+    LoopProfiler*         m_profiler;
+
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+    unsigned long long ticks(const struct timespec& ts, bool round_up) const;
+    void insert(Timer *timer);
+    void link(Timer *timer, int slot);
+    void unlink(Timer *timer);
+    void cascade(int slot);
+    void advance(unsigned long long now_tick);
+    int firstUsed(int first, int cnt, int start) const;
+    void setUsed(int slot, bool used);
+    void profiledExpire(Timer *timer);
+    void addOverhead(const struct timespec& start);
+
+};  /* class TimerWheel */
+
+
+} /* namespace */
+
+#endif /* ASYNC_TIMER_WHEEL_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -149,6 +149,25 @@ QtApplication::QtApplication(int &argc, char **argv)
 QtApplication::~QtApplication(void)
 {
   clearTasks();
+
+  for (TimerPool::iterator it=timer_pool.begin(); it!=timer_pool.end(); ++it)
+  {
+    delete *it;
+  }
+  timer_pool.clear();
+
+    // Only disabled notifiers, kept for reuse, belong to this class
+  FdWatchMap *maps[] = { &rd_watch_map, &wr_watch_map };
+  for (size_t i=0; i<sizeof(maps)/sizeof(*maps); ++i)
+  {
+    for (FdWatchMap::iterator it=maps[i]->begin(); it!=maps[i]->end(); ++it)
+    {
+      if (it->second.first == 0)
+      {
+        delete it->second.second;
+      }
+    }
+  }
 } /* QtApplication::~QtApplication */
 
 
@@ -211,49 +230,70 @@ void QtApplication::quit(void)
  */
 void QtApplication::addFdWatch(FdWatch *fd_watch)
 {
-  QSocketNotifier *notifier = 0;
-  
+  FdWatchMap *watch_map = 0;
+  QSocketNotifier::Type type = QSocketNotifier::Read;
   switch (fd_watch->type())
   {
     case FdWatch::FD_WATCH_RD:
-      notifier = new QSocketNotifier(fd_watch->fd(), QSocketNotifier::Read);
-      rd_watch_map[fd_watch->fd()] = FdWatchMapItem(fd_watch, notifier);
-      QObject::connect(notifier, SIGNAL(activated(int)),
-                       this, SLOT(rdFdActivity(int)));
+      watch_map = &rd_watch_map;
+      type = QSocketNotifier::Read;
       break;
       
     case FdWatch::FD_WATCH_WR:
-      notifier = new QSocketNotifier(fd_watch->fd(), QSocketNotifier::Write);
-      wr_watch_map[fd_watch->fd()] = FdWatchMapItem(fd_watch, notifier);
-      QObject::connect(notifier, SIGNAL(activated(int)),
-                       this, SLOT(wrFdActivity(int)));
+      watch_map = &wr_watch_map;
+      type = QSocketNotifier::Write;
       break;
-  }  
+
+    default:
+      return;
+  }
+
+    // A watch that is just toggled reuses the notifier that was disabled
+    // when the watch was disabled
+  FdWatchMap::iterator iter = watch_map->find(fd_watch->fd());
+  if (iter != watch_map->end())
+  {
+    iter->second.first = fd_watch;
+    iter->second.second->setEnabled(true);
+    return;
+  }
+
+  QSocketNotifier *notifier = new QSocketNotifier(fd_watch->fd(), type);
+  (*watch_map)[fd_watch->fd()] = FdWatchMapItem(fd_watch, notifier);
+  if (type == QSocketNotifier::Read)
+  {
+    QObject::connect(notifier, SIGNAL(activated(int)),
+                     this, SLOT(rdFdActivity(int)));
+  }
+  else
+  {
+    QObject::connect(notifier, SIGNAL(activated(int)),
+                     this, SLOT(wrFdActivity(int)));
+  }
 } /* QtApplication::addFdWatch */
 
 
 void QtApplication::delFdWatch(FdWatch *fd_watch)
 {
-  FdWatchMap::iterator iter;
-  
+  FdWatchMap *watch_map = 0;
   switch (fd_watch->type())
   {
     case FdWatch::FD_WATCH_RD:
-      iter = rd_watch_map.find(fd_watch->fd());
-      assert(iter != rd_watch_map.end());
-      delete iter->second.second;
-      rd_watch_map.erase(fd_watch->fd());
+      watch_map = &rd_watch_map;
       break;
       
     case FdWatch::FD_WATCH_WR:
-      iter = wr_watch_map.find(fd_watch->fd());
-      assert(iter != wr_watch_map.end());
-      delete iter->second.second;
-      wr_watch_map.erase(fd_watch->fd());
+      watch_map = &wr_watch_map;
       break;
+
+    default:
+      return;
   }
-  
 
+  FdWatchMap::iterator iter = watch_map->find(fd_watch->fd());
+  assert((iter != watch_map->end()) && (iter->second.first == fd_watch));
+  iter->second.second->setEnabled(false);
+  iter->second.first = 0;
 } /* QtApplication::delFdWatch */
 
 
@@ -262,7 +302,10 @@ void QtApplication::rdFdActivity(int socket)
   FdWatchMap::iterator iter;
   iter = rd_watch_map.find(socket);
   assert(iter != rd_watch_map.end());
-  iter->second.first->activity(iter->second.first);
+  if (iter->second.first != 0)
+  {
+    iter->second.first->activity(iter->second.first);
+  }
 } /* QtApplication::rdFdActivity */
 
 
@@ -271,13 +314,26 @@ void QtApplication::wrFdActivity(int socket)
   FdWatchMap::iterator iter;
   iter = wr_watch_map.find(socket);
   assert(iter != wr_watch_map.end());
-  iter->second.first->activity(iter->second.first);
+  if (iter->second.first != 0)
+  {
+    iter->second.first->activity(iter->second.first);
+  }
 } /* QtApplication::wrFdActivity */
 
 
 void QtApplication::addTimer(Timer *timer)
 {
-  AsyncQtTimer *t = new AsyncQtTimer(timer);
+  AsyncQtTimer *t = 0;
+  if (!timer_pool.empty())
+  {
+    t = timer_pool.back();
+    timer_pool.pop_back();
+    t->start(timer);
+  }
+  else
+  {
+    t = new AsyncQtTimer(timer);
+  }
   timer_map[timer] = t;  
 } /* QtApplication::addTimer */
 
@@ -287,7 +343,8 @@ void QtApplication::delTimer(Timer *timer)
   TimerMap::iterator iter;
   iter = timer_map.find(timer);
   assert(iter != timer_map.end());
-  delete iter->second;
+  iter->second->stop();
+  timer_pool.push_back(iter->second);
   timer_map.erase(iter);
 } /* QtApplication::delTimer */
 
@@ -51,6 +51,7 @@ An example of how to use the Async::QtApplication class
 #include <utility>
 #include <map>
 #include <set>
+#include <vector>
 
 
 /****************************************************************************
@@ -150,6 +151,11 @@ In the application you do not have to use the Async classes for timers and file
 descriptor watches. It is perfecly legal to use the Qt variants (QTimer and
 QSocketNotifier). You can mix them as much as you like.
 
+Async timers are mapped to precise Qt timers. The Qt objects used for timers and
+file descriptor watches are reused when a timer is restarted or a watch is
+disabled and enabled again, so that high rate network and audio handling do not
+allocate and connect new Qt objects all the time.
+
 \include AsyncQtApplication_demo.cpp
 */
 class QtApplication : public QApplication, public Application
@@ -195,10 +201,12 @@ class QtApplication : public QApplication, public Application
     typedef std::pair<Async::FdWatch*, QSocketNotifier*>  FdWatchMapItem;
     typedef std::map<int, FdWatchMapItem> 	      	  FdWatchMap;
     typedef std::map<Timer *, AsyncQtTimer *>         	  TimerMap;
+    typedef std::vector<AsyncQtTimer *>                   TimerPool;
     
     FdWatchMap  rd_watch_map;
     FdWatchMap  wr_watch_map;
     TimerMap  	timer_map;
+    TimerPool   timer_pool;
     
     void addFdWatch(FdWatch *fd_watch);
     void delFdWatch(FdWatch *fd_watch);
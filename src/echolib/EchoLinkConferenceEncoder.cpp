@@ -0,0 +1,294 @@
+/**
+@file   EchoLinkConferenceEncoder.cpp
+@brief  Encode audio once for many EchoLink connections
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that encode the audio that is sent to all stations
+in a conference once per frame and codec, instead of once per connection. For
+more information, see the documentation for class EchoLink::ConferenceEncoder.
+
+\verbatim
+EchoLib - A library for EchoLink communication
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <arpa/inet.h>
+#include <algorithm>
+#include <cstring>
+
+#ifdef SPEEX_MAJOR
+#include <speex/speex.h>
+#endif
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "EchoLinkConferenceEncoder.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+using namespace EchoLink;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+struct ConferenceEncoder::Private
+{
+  gsm             gsmh;
+  Qso::VoicePacket gsm_packet;
+  Qso::RawPacket  gsm_raw;
+  bool            gsm_encoded;
+#ifdef SPEEX_MAJOR
+  SpeexBits       enc_bits;
+  void *          enc_state;
+  Qso::VoicePacket speex_packet;
+  Qso::RawPacket  speex_raw;
+  bool            speex_encoded;
+#endif
+
+  Private(void)
+    : gsmh(0), gsm_encoded(false)
+#ifdef SPEEX_MAJOR
+      , enc_bits(), enc_state(0), speex_encoded(false)
+#endif
+  {}
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+ConferenceEncoder::ConferenceEncoder(void)
+  : buffer_cnt(0), p(new Private)
+{
+  p->gsmh = gsm_create();
+  p->gsm_raw.voice_packet = &p->gsm_packet;
+  p->gsm_raw.length = 0;
+  p->gsm_raw.samples = buffer;
+
+#ifdef SPEEX_MAJOR
+  speex_bits_init(&p->enc_bits);
+  p->enc_state = speex_encoder_init(&speex_nb_mode);
+  int val = 25000;
+  speex_encoder_ctl(p->enc_state, SPEEX_SET_BITRATE, &val);
+  val = 8;
+  speex_encoder_ctl(p->enc_state, SPEEX_SET_QUALITY, &val);
+  val = 4;
+  speex_encoder_ctl(p->enc_state, SPEEX_SET_COMPLEXITY, &val);
+  p->speex_raw.voice_packet = &p->speex_packet;
+  p->speex_raw.length = 0;
+  p->speex_raw.samples = buffer;
+#endif
+} /* ConferenceEncoder::ConferenceEncoder */
+
+
+ConferenceEncoder::~ConferenceEncoder(void)
+{
+  gsm_destroy(p->gsmh);
+#ifdef SPEEX_MAJOR
+  speex_bits_destroy(&p->enc_bits);
+  speex_encoder_destroy(p->enc_state);
+#endif
+  delete p;
+} /* ConferenceEncoder::~ConferenceEncoder */
+
+
+Qso::RawPacket *ConferenceEncoder::packet(bool speex)
+{
+#ifdef SPEEX_MAJOR
+  if (speex)
+  {
+    if (!p->speex_encoded)
+    {
+      Qso::VoicePacket& voice_packet = p->speex_packet;
+      for (int i = 0; i < BUFFER_SIZE; i += 160)
+      {
+        speex_encode_int(p->enc_state, buffer + i, &p->enc_bits);
+      }
+      speex_bits_insert_terminator(&p->enc_bits);
+      size_t nbytes = 0;
+      size_t nsize = speex_bits_nbytes(&p->enc_bits);
+      if (nsize < sizeof(voice_packet.data))
+      {
+        nbytes = speex_bits_write(&p->enc_bits, (char*)voice_packet.data,
+                                  nsize);
+      }
+      speex_bits_reset(&p->enc_bits);
+      voice_packet.header.version = 0xc0;
+      voice_packet.header.pt = 0x96;
+      voice_packet.header.time = htonl(0);
+      voice_packet.header.ssrc = htonl(0);
+      p->speex_raw.length = nbytes + sizeof(voice_packet.header);
+      p->speex_encoded = true;
+    }
+    return &p->speex_raw;
+  }
+#endif
+
+  if (!p->gsm_encoded)
+  {
+    Qso::VoicePacket& voice_packet = p->gsm_packet;
+    for (int i=0; i<FRAME_COUNT; i++)
+    {
+      gsm_encode(p->gsmh, buffer + i*160, voice_packet.data + i*33);
+    }
+    voice_packet.header.version = 0xc0;
+    voice_packet.header.pt = 0x03;
+    voice_packet.header.time = htonl(0);
+    voice_packet.header.ssrc = htonl(0);
+    p->gsm_raw.length = FRAME_COUNT * 33 + sizeof(voice_packet.header);
+    p->gsm_encoded = true;
+  }
+  return &p->gsm_raw;
+} /* ConferenceEncoder::packet */
+
+
+int ConferenceEncoder::writeSamples(const float *samples, int count)
+{
+  for (int i=0; i<count; ++i)
+  {
+    float sample = samples[i];
+    if (sample > 1)
+    {
+      buffer[buffer_cnt++] = 32767;
+    }
+    else if (sample < -1)
+    {
+      buffer[buffer_cnt++] = -32767;
+    }
+    else
+    {
+      buffer[buffer_cnt++] = static_cast<int16_t>(32767.0 * sample);
+    }
+
+    if (buffer_cnt == BUFFER_SIZE)
+    {
+      emitPacket();
+    }
+  }
+
+  return count;
+} /* ConferenceEncoder::writeSamples */
+
+
+void ConferenceEncoder::flushSamples(void)
+{
+  if (buffer_cnt > 0)
+  {
+    memset(buffer + buffer_cnt, 0,
+           sizeof(buffer) - sizeof(*buffer) * buffer_cnt);
+    emitPacket();
+  }
+  sourceAllSamplesFlushed();
+} /* ConferenceEncoder::flushSamples */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void ConferenceEncoder::emitPacket(void)
+{
+  p->gsm_encoded = false;
+#ifdef SPEEX_MAJOR
+  p->speex_encoded = false;
+#endif
+  packetReady();
+  buffer_cnt = 0;
+} /* ConferenceEncoder::emitPacket */
+
+
+/*
+ * This file has not been truncated
+ */
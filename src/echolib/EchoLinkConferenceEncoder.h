@@ -0,0 +1,193 @@
+/**
+@file   EchoLinkConferenceEncoder.h
+@brief  Encode audio once for many EchoLink connections
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that encode the audio that is sent to all stations
+in a conference once per frame and codec, instead of once per connection. For
+more information, see the documentation for class EchoLink::ConferenceEncoder.
+
+\verbatim
+EchoLib - A library for EchoLink communication
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ECHO_LINK_CONFERENCE_ENCODER_INCLUDED
+#define ECHO_LINK_CONFERENCE_ENCODER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSink.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "EchoLinkQso.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace EchoLink
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Encode audio once for many EchoLink connections
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+When the same audio is sent to many stations, like in a conference, it is a
+waste of CPU to encode it in each Qso object. This class buffer the audio,
+which must be sampled at 8kHz, into packets of the same size as a Qso object
+use. When a packet is full the \em packetReady signal is emitted. The handler
+then call the \em packet function for each connection to get a packet encoded
+with the codec that the remote station use and send it using
+Qso::sendAudioRaw. Each packet is only encoded once per codec. The Qso object
+only add its own sequence number before sending the packet.
+*/
+class ConferenceEncoder : public Async::AudioSink, public sigc::trackable
+{
+  public:
+    /**
+     * @brief 	Default constructor
+     */
+    ConferenceEncoder(void);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~ConferenceEncoder(void);
+
+    /**
+     * @brief   Get the current packet
+     * @param   speex Set to \em true to get a SPEEX packet or else GSM
+     * @return  Returns the current packet encoded with the given codec
+     *
+     * This function may only be called from a handler connected to the
+     * packetReady signal. If SPEEX support is not compiled in, a GSM
+     * packet is always returned.
+     */
+    Qso::RawPacket *packet(bool speex);
+
+    /**
+     * @brief 	Write samples into this audio sink
+     * @param 	samples The buffer containing the samples
+     * @param 	count The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *samples, int count);
+
+    /**
+     * @brief 	Tell the sink to flush the previously written samples
+     *
+     * The last, partially filled, packet is padded with silence and sent.
+     */
+    virtual void flushSamples(void);
+
+    /**
+     * @brief   A signal that is emitted when a packet is ready to be sent
+     */
+    sigc::signal<void> packetReady;
+
+  private:
+    struct Private;
+
+    static const int    FRAME_COUNT = 4;
+    static const int    BUFFER_SIZE = FRAME_COUNT*160;
+
+    short               buffer[BUFFER_SIZE];
+    int                 buffer_cnt;
+    Private             *p;
+
+    ConferenceEncoder(const ConferenceEncoder&);
+    ConferenceEncoder& operator=(const ConferenceEncoder&);
+    void emitPacket(void);
+
+};  /* class ConferenceEncoder */
+
+
+} /* namespace */
+
+#endif /* ECHO_LINK_CONFERENCE_ENCODER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,904 @@
+/**
+@file	 EchoLinkConference_bench.cpp
+@brief   A load test and benchmark application for EchoLink conferences
+@author  Tobias Blomberg / SM0SVX
+@date	 2020-10-14
+
+This application sets up an EchoLink conference in-process, built the same
+way as the one in the SvxLink EchoLink module, and connects a number of
+simulated EchoLink stations to it over the loopback interface. The stations
+take turns talking, sending GSM audio packets that the conference decode,
+feed through an audio selector and relay to all other stations. Every audio
+packet carry a send timestamp in the RTP header so that the receiving stations
+can measure the end-to-end latency. The number of stations can be stepped up
+to see how CPU usage, latency and packet loss scale.
+
+\verbatim
+EchoLib - A library for EchoLink communication
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+#include <time.h>
+#include <popt.h>
+#include <sigc++/sigc++.h>
+
+extern "C" {
+#include <gsm.h>
+}
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncCppApplication.h>
+#include <AsyncTimer.h>
+#include <AsyncUdpSocket.h>
+#include <AsyncAudioSelector.h>
+#include <AsyncAudioSink.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "EchoLinkDispatcher.h"
+#include "EchoLinkQso.h"
+#include "rtpacket.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+using namespace EchoLink;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define PROGRAM_NAME "EchoLinkConferenceBench"
+
+  // The conference listen on this address. The simulated stations use the
+  // addresses following it in the 127.0.0.0/8 loopback network.
+#define CONF_IP         "127.0.0.1"
+
+  // The EchoLink UDP ports. Each simulated station bind these ports on its
+  // own loopback address.
+#define CTRL_PORT       5198
+#define AUDIO_PORT      5199
+
+  // An audio packet contain four 20ms GSM frames, the same as what
+  // EchoLink::Qso send
+#define GSM_FRAME_SIZE  33
+#define FRAME_COUNT     4
+#define PACKET_INTERVAL 80
+
+  // The simulated stations must send SDES packets regularly or the
+  // conference will time the connections out
+#define SDES_INTERVAL   10000
+
+  // The pause between two talkers must be longer than the maximum receive
+  // indicator timeout in EchoLink::Qso so that the conference have released
+  // the previous talker before the next one start
+#define TALKER_PAUSE    1500
+
+  // The number of stations to connect every 10 milliseconds
+#define CONNECT_BATCH   10
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+class Bench;
+
+/**
+@brief  A simulated remote EchoLink station
+
+A minimal EchoLink station that connect to the conference by sending SDES
+packets and then send and receive GSM audio packets. Received audio is never
+decoded. Only the send timestamp, written into the RTP header time field by
+the sending station, is inspected.
+*/
+class SimStation : public sigc::trackable
+{
+  public:
+    SimStation(Bench *bench, unsigned idx, const IpAddress& ip)
+      : m_bench(bench), m_idx(idx), m_ctrl_sock(CTRL_PORT, ip),
+        m_audio_sock(AUDIO_PORT, ip), m_sdes_len(0), m_next_seq(0),
+        m_connected(false)
+    {
+      m_ctrl_sock.dataReceived.connect(
+          mem_fun(*this, &SimStation::ctrlDataReceived));
+      m_audio_sock.dataReceived.connect(
+          mem_fun(*this, &SimStation::audioDataReceived));
+
+      char callsign[16];
+      snprintf(callsign, sizeof(callsign), "BN%04u", idx);
+      char name[32];
+      snprintf(name, sizeof(name), "Bench Station %u", idx);
+      m_sdes_len = rtp_make_sdes(m_sdes, callsign, name, 0);
+    }
+
+    bool initOk(void) const
+    {
+      return m_ctrl_sock.initOk() && m_audio_sock.initOk() &&
+             (m_sdes_len > 0);
+    }
+
+      // A station is connected when the conference has answered with an
+      // SDES packet of its own
+    bool isConnected(void) const { return m_connected; }
+
+    void sendSdes(void)
+    {
+      m_ctrl_sock.write(IpAddress(CONF_IP), CTRL_PORT, m_sdes, m_sdes_len);
+    }
+
+    void sendAudio(uint32_t timestamp, const uint8_t *gsm_data);
+
+  private:
+    Bench*          m_bench;
+    unsigned        m_idx;
+    UdpSocket       m_ctrl_sock;
+    UdpSocket       m_audio_sock;
+    unsigned char   m_sdes[1500];
+    int             m_sdes_len;
+    uint16_t        m_next_seq;
+    bool            m_connected;
+
+    void ctrlDataReceived(const IpAddress& addr, uint16_t port,
+                          void *buf, int count)
+    {
+      if (isRTCPSdespacket(static_cast<unsigned char*>(buf), count))
+      {
+        m_connected = true;
+      }
+    }
+
+    void audioDataReceived(const IpAddress& addr, uint16_t port,
+                           void *buf, int count);
+}; /* class SimStation */
+
+
+/**
+@brief  The conference under test
+
+Mirror the way the SvxLink EchoLink module handle a conference. Each incoming
+connection get a Qso object. The received audio is decoded by the Qso objects
+and fed into an audio selector while the raw packets from the current talker
+is relayed to all other connected stations.
+*/
+class Conference : public sigc::trackable
+{
+  public:
+    Conference(void) : m_talker(0)
+    {
+      m_selector.registerSink(&m_sink);
+      Dispatcher::instance()->incomingConnection.connect(
+          mem_fun(*this, &Conference::onIncomingConnection));
+    }
+
+    ~Conference(void)
+    {
+      for (vector<Qso*>::iterator it = m_qsos.begin(); it != m_qsos.end();
+           ++it)
+      {
+        m_selector.removeSource(*it);
+        delete *it;
+      }
+    }
+
+    unsigned long rxDropped(void) const
+    {
+      unsigned long cnt = 0;
+      for (vector<Qso*>::const_iterator it = m_qsos.begin();
+           it != m_qsos.end(); ++it)
+      {
+        cnt += (*it)->audioStats().rx_dropped;
+      }
+      return cnt;
+    }
+
+    unsigned long selectedSamples(void) const { return m_sink.samples(); }
+
+  private:
+    class NullSink : public AudioSink
+    {
+      public:
+        NullSink(void) : m_samples(0) {}
+        virtual int writeSamples(const float *samples, int count)
+        {
+          m_samples += count;
+          return count;
+        }
+        virtual void flushSamples(void) { sourceAllSamplesFlushed(); }
+        unsigned long samples(void) const { return m_samples; }
+
+      private:
+        unsigned long m_samples;
+    };
+
+    vector<Qso*>    m_qsos;
+    AudioSelector   m_selector;
+    NullSink        m_sink;
+    Qso*            m_talker;
+
+    void onIncomingConnection(const IpAddress& ip, const string& callsign,
+                              const string& name, const string& priv);
+    void audioFromRemoteRaw(Qso::RawPacket *packet, Qso *qso);
+    void onIsReceiving(bool is_receiving, Qso *qso);
+}; /* class Conference */
+
+
+/**
+@brief  The benchmark driver
+
+Own the simulated stations, schedule the talkers and collect the statistics
+for each step in the number of connected stations.
+*/
+class Bench : public sigc::trackable
+{
+  public:
+    struct Params
+    {
+      unsigned  stations;
+      unsigned  step;
+      unsigned  talk_time;
+      unsigned  duration;
+    };
+
+    Bench(const Params& params, Conference& conf)
+      : m_params(params), m_conf(conf),
+        m_packet_timer(PACKET_INTERVAL, Timer::TYPE_PERIODIC, false),
+        m_sdes_timer(SDES_INTERVAL, Timer::TYPE_PERIODIC, false),
+        m_connect_timer(10, Timer::TYPE_PERIODIC, false),
+        m_start_timer(100, Timer::TYPE_PERIODIC, false),
+        m_stop_timer(1000 * params.duration, Timer::TYPE_ONESHOT, false),
+        m_drain_timer(500, Timer::TYPE_ONESHOT, false),
+        m_level(0), m_start_wait(0), m_running(false), m_talker(0),
+        m_next_talker(0), m_packets_left(0), m_pause_left(0),
+        m_sent_cnt(0), m_expected_cnt(0), m_received_cnt(0), m_late_cnt(0),
+        m_start_time(0), m_stop_time(0), m_start_dropped(0),
+        m_start_samples(0)
+    {
+      m_packet_timer.expired.connect(mem_fun(*this, &Bench::sendPackets));
+      m_sdes_timer.expired.connect(mem_fun(*this, &Bench::sendSdes));
+      m_connect_timer.expired.connect(
+          mem_fun(*this, &Bench::connectStations));
+      m_start_timer.expired.connect(mem_fun(*this, &Bench::checkStart));
+      m_stop_timer.expired.connect(mem_fun(*this, &Bench::stop));
+      m_drain_timer.expired.connect(mem_fun(*this, &Bench::report));
+    }
+
+    ~Bench(void)
+    {
+      for (vector<SimStation*>::iterator it = m_stations.begin();
+           it != m_stations.end(); ++it)
+      {
+        delete *it;
+      }
+    }
+
+    bool setup(void);
+    void start(void);
+
+    static uint64_t now(void)
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    void packetReceived(uint32_t timestamp);
+
+  private:
+    Params                m_params;
+    Conference&           m_conf;
+    vector<SimStation*>   m_stations;
+    uint8_t               m_gsm_data[FRAME_COUNT * GSM_FRAME_SIZE];
+    Timer                 m_packet_timer;
+    Timer                 m_sdes_timer;
+    Timer                 m_connect_timer;
+    Timer                 m_start_timer;
+    Timer                 m_stop_timer;
+    Timer                 m_drain_timer;
+    unsigned              m_level;
+    unsigned              m_start_wait;
+    bool                  m_running;
+    SimStation*           m_talker;
+    unsigned              m_next_talker;
+    unsigned              m_packets_left;
+    unsigned              m_pause_left;
+    unsigned long         m_sent_cnt;
+    unsigned long         m_expected_cnt;
+    unsigned long         m_received_cnt;
+    unsigned long         m_late_cnt;
+    vector<uint32_t>      m_latencies;
+    uint64_t              m_start_time;
+    uint64_t              m_stop_time;
+    struct rusage         m_start_usage;
+    unsigned long         m_start_dropped;
+    unsigned long         m_start_samples;
+
+    void nextLevel(void);
+    void connectStations(Timer *t);
+    void checkStart(Timer *t);
+    void sendPackets(Timer *t);
+    void sendSdes(Timer *t);
+    void stop(Timer *t);
+    void report(Timer *t);
+    unsigned connectedListeners(void) const;
+}; /* class Bench */
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void parse_arguments(int argc, const char **argv);
+static double percentile(const vector<uint32_t>& sorted, double p);
+static double tv_to_us(const struct timeval& tv);
+static IpAddress station_ip(unsigned idx);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+static int stations = 20;
+static int step = 0;
+static int talk_time = 5000;
+static int duration = 30;
+
+
+/****************************************************************************
+ *
+ * MAIN
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  main
+ * Purpose:   Start everything...
+ * Input:     argc  - The number of arguments passed to this program
+ *    	      	      including the program name.
+ *    	      argv  - The arguments passed to this program. argv[0] is the
+ *    	      	      program name.
+ * Output:    Return 0 on success, else non-zero.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2020-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+int main(int argc, const char *argv[])
+{
+  CppApplication app;
+
+  parse_arguments(argc, const_cast<const char **>(argv));
+
+  if (step == 0)
+  {
+    step = stations;
+  }
+  if ((stations < 2) || (stations > 60000) || (step < 1) ||
+      (talk_time < PACKET_INTERVAL) || (duration < 1))
+  {
+    cerr << "*** ERROR: Illegal argument value(s)" << endl;
+    exit(1);
+  }
+
+  Bench::Params params;
+  params.stations = stations;
+  params.step = step;
+  params.talk_time = talk_time;
+  params.duration = duration;
+
+  Dispatcher::setBindAddr(IpAddress(CONF_IP));
+  if (Dispatcher::instance() == 0)
+  {
+    cerr << "*** ERROR: Could not create the EchoLink dispatcher" << endl;
+    exit(1);
+  }
+
+  {
+    Conference conf;
+    Bench bench(params, conf);
+    if (!bench.setup())
+    {
+      exit(1);
+    }
+
+    bench.start();
+    app.exec();
+  }
+
+  Dispatcher::deleteInstance();
+
+  return 0;
+
+} /* main */
+
+
+/****************************************************************************
+ *
+ * Functions
+ *
+ ****************************************************************************/
+
+void SimStation::sendAudio(uint32_t timestamp, const uint8_t *gsm_data)
+{
+  Qso::VoicePacket packet;
+  packet.header.version = 0xc0;
+  packet.header.pt = 0x03;
+  packet.header.seqNum = htons(m_next_seq++);
+  packet.header.time = timestamp;
+  packet.header.ssrc = htonl(m_idx);
+  memcpy(packet.data, gsm_data, FRAME_COUNT * GSM_FRAME_SIZE);
+  m_audio_sock.write(IpAddress(CONF_IP), AUDIO_PORT, &packet,
+                     sizeof(packet.header) + FRAME_COUNT * GSM_FRAME_SIZE);
+} /* SimStation::sendAudio */
+
+
+void SimStation::audioDataReceived(const IpAddress& addr, uint16_t port,
+                                   void *buf, int count)
+{
+  const Qso::VoicePacket *packet = static_cast<Qso::VoicePacket*>(buf);
+  if (static_cast<size_t>(count) < sizeof(packet->header))
+  {
+    cerr << "*** WARNING[" << m_idx << "]: Short audio packet received"
+         << endl;
+    return;
+  }
+  m_bench->packetReceived(packet->header.time);
+} /* SimStation::audioDataReceived */
+
+
+void Conference::onIncomingConnection(const IpAddress& ip,
+                                      const string& callsign,
+                                      const string& name, const string& priv)
+{
+  Qso *qso = new Qso(ip, "SM0BCH-C", "Bench Conference", "");
+  if (!qso->initOk())
+  {
+    cerr << "*** ERROR: Could not create a Qso object for " << callsign
+         << endl;
+    delete qso;
+    return;
+  }
+  qso->setRemoteParams(priv);
+  qso->audioReceivedRaw.connect(
+      sigc::bind(mem_fun(*this, &Conference::audioFromRemoteRaw), qso));
+  qso->isReceiving.connect(
+      sigc::bind(mem_fun(*this, &Conference::onIsReceiving), qso));
+  m_selector.addSource(qso);
+  m_selector.enableAutoSelect(qso, 0);
+  m_qsos.push_back(qso);
+  qso->accept();
+} /* Conference::onIncomingConnection */
+
+
+void Conference::audioFromRemoteRaw(Qso::RawPacket *packet, Qso *qso)
+{
+  if (m_talker == 0)
+  {
+    m_talker = qso;
+  }
+
+  if (qso == m_talker)
+  {
+    for (vector<Qso*>::iterator it = m_qsos.begin(); it != m_qsos.end(); ++it)
+    {
+      if (*it != qso)
+      {
+        (*it)->sendAudioRaw(packet);
+      }
+    }
+  }
+} /* Conference::audioFromRemoteRaw */
+
+
+void Conference::onIsReceiving(bool is_receiving, Qso *qso)
+{
+  if (!is_receiving && (qso == m_talker))
+  {
+    m_talker = 0;
+  }
+} /* Conference::onIsReceiving */
+
+
+bool Bench::setup(void)
+{
+    // Encode one packet of a 1kHz tone. The same packet is then sent by all
+    // talkers since the conference does not care about the audio content.
+  gsm gsmh = gsm_create();
+  gsm_signal samples[160];
+  for (int frameno = 0; frameno < FRAME_COUNT; ++frameno)
+  {
+    for (int i = 0; i < 160; ++i)
+    {
+      samples[i] = static_cast<gsm_signal>(
+          8000.0 * sin(2.0 * M_PI * 1000.0 * (frameno * 160 + i) / 8000.0));
+    }
+    gsm_encode(gsmh, samples, m_gsm_data + frameno * GSM_FRAME_SIZE);
+  }
+  gsm_destroy(gsmh);
+
+  for (unsigned idx = 0; idx < m_params.stations; ++idx)
+  {
+    SimStation *stn = new SimStation(this, idx, station_ip(idx));
+    if (!stn->initOk())
+    {
+      cerr << "*** ERROR: Could not set up simulated station on "
+           << station_ip(idx) << endl;
+      delete stn;
+      return false;
+    }
+    m_stations.push_back(stn);
+  }
+
+  return true;
+} /* Bench::setup */
+
+
+void Bench::start(void)
+{
+  printf("%8s %8s %8s %8s %8s %8s %8s %8s %8s\n",
+         "Stations", "Sent", "Expected", "Received", "Loss%", "p50(us)",
+         "p99(us)", "Max(us)", "CPU%");
+  m_sdes_timer.setEnable(true);
+  nextLevel();
+} /* Bench::start */
+
+
+void Bench::packetReceived(uint32_t timestamp)
+{
+  if (!m_running)
+  {
+    ++m_late_cnt;
+    return;
+  }
+  ++m_received_cnt;
+  m_latencies.push_back(static_cast<uint32_t>(now()) - timestamp);
+} /* Bench::packetReceived */
+
+
+void Bench::nextLevel(void)
+{
+  m_level = min(m_level + m_params.step, m_params.stations);
+  m_start_wait = 0;
+  m_connect_timer.setEnable(true);
+} /* Bench::nextLevel */
+
+
+void Bench::connectStations(Timer *t)
+{
+  unsigned connected = 0;
+  for (unsigned idx = 0; idx < m_level; ++idx)
+  {
+    if (m_stations[idx]->isConnected())
+    {
+      ++connected;
+    }
+  }
+
+  unsigned cnt = 0;
+  for (unsigned idx = connected; (idx < m_level) && (cnt < CONNECT_BATCH);
+       ++idx)
+  {
+    if (!m_stations[idx]->isConnected())
+    {
+      m_stations[idx]->sendSdes();
+      ++cnt;
+    }
+  }
+
+  if (cnt == 0)
+  {
+    m_connect_timer.setEnable(false);
+    m_start_timer.setEnable(true);
+  }
+} /* Bench::connectStations */
+
+
+void Bench::checkStart(Timer *t)
+{
+  unsigned connected = 0;
+  for (unsigned idx = 0; idx < m_level; ++idx)
+  {
+    if (m_stations[idx]->isConnected())
+    {
+      ++connected;
+    }
+  }
+
+  if (connected < m_level)
+  {
+    if (++m_start_wait > 100)
+    {
+      cerr << "*** ERROR: Only " << connected << " of " << m_level
+           << " stations connected to the conference" << endl;
+      Application::app().quit();
+    }
+    return;
+  }
+
+  m_start_timer.setEnable(false);
+  m_sent_cnt = m_expected_cnt = m_received_cnt = m_late_cnt = 0;
+  m_latencies.clear();
+  m_latencies.reserve(
+      static_cast<size_t>(m_level) * 1000 * m_params.duration /
+      PACKET_INTERVAL);
+  m_talker = 0;
+  m_pause_left = 0;
+  m_start_dropped = m_conf.rxDropped();
+  m_start_samples = m_conf.selectedSamples();
+  getrusage(RUSAGE_SELF, &m_start_usage);
+  m_start_time = now();
+  m_running = true;
+  m_packet_timer.setEnable(true);
+  m_stop_timer.setEnable(true);
+} /* Bench::checkStart */
+
+
+void Bench::sendPackets(Timer *t)
+{
+  if (m_talker == 0)
+  {
+    if (m_pause_left > 0)
+    {
+      m_pause_left -= min(m_pause_left, static_cast<unsigned>(PACKET_INTERVAL));
+      return;
+    }
+    m_talker = m_stations[m_next_talker % m_level];
+    m_next_talker = (m_next_talker + 1) % m_level;
+    m_packets_left = m_params.talk_time / PACKET_INTERVAL;
+  }
+
+  m_talker->sendAudio(static_cast<uint32_t>(now()), m_gsm_data);
+  ++m_sent_cnt;
+  m_expected_cnt += connectedListeners();
+
+  if (--m_packets_left == 0)
+  {
+    m_talker = 0;
+    m_pause_left = TALKER_PAUSE;
+  }
+} /* Bench::sendPackets */
+
+
+void Bench::sendSdes(Timer *t)
+{
+  for (unsigned idx = 0; idx < m_level; ++idx)
+  {
+    if (m_stations[idx]->isConnected())
+    {
+      m_stations[idx]->sendSdes();
+    }
+  }
+} /* Bench::sendSdes */
+
+
+void Bench::stop(Timer *t)
+{
+  m_packet_timer.setEnable(false);
+  m_stop_timer.setEnable(false);
+  m_stop_time = now();
+  m_running = false;
+  m_drain_timer.setEnable(true);
+} /* Bench::stop */
+
+
+void Bench::report(Timer *t)
+{
+  m_drain_timer.setEnable(false);
+
+  uint64_t elapsed = m_stop_time - m_start_time;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double cpu_us = tv_to_us(usage.ru_utime) - tv_to_us(m_start_usage.ru_utime) +
+                  tv_to_us(usage.ru_stime) - tv_to_us(m_start_usage.ru_stime);
+
+  sort(m_latencies.begin(), m_latencies.end());
+  double loss = 0.0;
+  if (m_expected_cnt > 0)
+  {
+    loss = 100.0 * (static_cast<double>(m_expected_cnt) - m_received_cnt) /
+           m_expected_cnt;
+  }
+
+  printf("%8u %8lu %8lu %8lu %8.3f %8.0f %8.0f %8u %8.1f\n",
+         m_level, m_sent_cnt, m_expected_cnt, m_received_cnt, loss,
+         m_latencies.empty() ? 0.0 : percentile(m_latencies, 0.5),
+         m_latencies.empty() ? 0.0 : percentile(m_latencies, 0.99),
+         m_latencies.empty() ? 0 : m_latencies.back(),
+         100.0 * cpu_us / elapsed);
+  if (m_late_cnt > 0)
+  {
+    printf("         %lu packets received after the stop\n", m_late_cnt);
+  }
+  unsigned long dropped = m_conf.rxDropped() - m_start_dropped;
+  if (dropped > 0)
+  {
+    printf("         %lu packets dropped by the conference\n", dropped);
+  }
+  if (m_conf.selectedSamples() == m_start_samples)
+  {
+    printf("         No audio passed through the audio selector\n");
+  }
+  fflush(stdout);
+
+  if (m_level < m_params.stations)
+  {
+    nextLevel();
+  }
+  else
+  {
+    printf("CPU usage include the simulated stations\n");
+    Application::app().quit();
+  }
+} /* Bench::report */
+
+
+unsigned Bench::connectedListeners(void) const
+{
+  unsigned cnt = 0;
+  for (unsigned idx = 0; idx < m_level; ++idx)
+  {
+    if ((m_stations[idx] != m_talker) && m_stations[idx]->isConnected())
+    {
+      ++cnt;
+    }
+  }
+  return cnt;
+} /* Bench::connectedListeners */
+
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  parse_arguments
+ * Purpose:   Parse the command line arguments.
+ * Input:     argc  - Number of arguments in the command line
+ *    	      argv  - Array of strings with the arguments
+ * Output:    Returns 0 if all is ok, otherwise -1.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2020-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+static void parse_arguments(int argc, const char **argv)
+{
+  poptContext optCon;
+  const struct poptOption optionsTable[] =
+  {
+    POPT_AUTOHELP
+    {"stations", 's', POPT_ARG_INT, &stations, 0,
+            "The maximum number of simulated stations (default 20)",
+            "<count>"},
+    {"step", 0, POPT_ARG_INT, &step, 0,
+            "Add this many stations for each measurement (default all)",
+            "<count>"},
+    {"talk-time", 0, POPT_ARG_INT, &talk_time, 0,
+            "The length of each talk spurt in milliseconds (default 5000)",
+            "<ms>"},
+    {"duration", 'd', POPT_ARG_INT, &duration, 0,
+            "The length of each measurement in seconds (default 30)",
+            "<seconds>"},
+    {NULL, 0, 0, NULL, 0}
+  };
+  int err;
+
+  optCon = poptGetContext(PROGRAM_NAME, argc, argv, optionsTable, 0);
+  poptReadDefaultConfig(optCon, 0);
+
+  err = poptGetNextOpt(optCon);
+  if (err != -1)
+  {
+    fprintf(stderr, "\t%s: %s\n",
+	    poptBadOption(optCon, POPT_BADOPTION_NOALIAS),
+	    poptStrerror(err));
+    exit(1);
+  }
+
+  poptFreeContext(optCon);
+
+} /* parse_arguments */
+
+
+static double percentile(const vector<uint32_t>& sorted, double p)
+{
+  size_t idx = static_cast<size_t>(p * sorted.size());
+  if (idx >= sorted.size())
+  {
+    idx = sorted.size() - 1;
+  }
+  return sorted[idx];
+} /* percentile */
+
+
+static double tv_to_us(const struct timeval& tv)
+{
+  return 1000000.0 * tv.tv_sec + tv.tv_usec;
+} /* tv_to_us */
+
+
+static IpAddress station_ip(unsigned idx)
+{
+    // Skip the conference address 127.0.0.1 and avoid the network and
+    // broadcast addresses in each /24
+  unsigned addr = idx + 1;
+  ostringstream ss;
+  ss << "127." << (addr / (254 * 254)) << "." << (addr / 254 % 254) << "."
+     << (addr % 254 + 1);
+  return IpAddress(ss.str());
+} /* station_ip */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -47,6 +47,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cctype>
 #include <cassert>
 #include <cstring>
+#include <cstdlib>
+#include <sstream>
 
 
 /****************************************************************************
@@ -85,6 +87,9 @@ using namespace EchoLink;
  *
  ****************************************************************************/
 
+  // The offset basis of the 64 bit FNV-1a hash used by hashData
+#define HASH_INIT 14695981039346656037ULL
+
 
 
 /****************************************************************************
@@ -110,6 +115,9 @@ struct Cmd
  *
  ****************************************************************************/
 
+static bool stationDataEq(const StationData& a, const StationData& b);
+static uint64_t hashData(uint64_t hash, const char *buf, size_t len);
+
 
 
 /****************************************************************************
@@ -141,6 +149,10 @@ Directory::Directory(const vector<string>& servers, const string& callsign,
   : com_state(CS_IDLE),       	      	      the_servers(servers),
     the_password(password),   	      	      the_description(""),
     error_str(""),    	      	      	      get_call_cnt(0),
+    get_call_hash(0), 	      	      	      last_call_hash(0),
+    delta_updates(false),                     delta_gen(0),
+    get_call_gen(0),                          get_call_delta_reply(false),
+    get_call_base(0),                         get_call_remove_cnt(0),
     ctrl_con(0),
     the_status(StationData::STAT_OFFLINE),    reg_refresh_timer(0),
     current_status(StationData::STAT_OFFLINE),server_changed(false),
@@ -207,10 +219,10 @@ void Directory::getCalls(void)
   }
   else
   {
-    the_links.clear();
-    the_repeaters.clear();
-    the_conferences.clear();
-    the_stations.clear();
+    last_call_hash = 0;
+    delta_gen = 0;
+    clearCallLists();
+    replaceStationLists();
     error("Trying to update the directory list while not registered with the "
       	  "directory server");
     //stationListUpdated();
@@ -222,9 +234,17 @@ void Directory::setServers(const vector<string>& servers)
 {
   server_changed = true;
   the_servers = servers;
+  delta_gen = 0;
 } /* Directory::setServer */
 
 
+void Directory::setDeltaUpdates(bool enable)
+{
+  delta_updates = enable;
+  delta_gen = 0;
+} /* Directory::setDeltaUpdates */
+
+
 void Directory::setCallsign(const string& callsign)
 {
   the_callsign.resize(callsign.size());
@@ -249,142 +269,75 @@ void Directory::setDescription(const string& description)
 } /* Directory::setDescription */
 
 
-const StationData *Directory::findCall(const string& call)
+Directory::ListType Directory::listType(const string& callsign)
 {
-  list<StationData> calls;
-  list<StationData>::const_iterator iter;
-  
-  for (iter=the_links.begin(); iter!=the_links.end(); ++iter)
+  if (callsign.rfind("-L") == callsign.size()-2)
   {
-    if (iter->callsign() == call)
-    {
-      return &(*iter);
-    }
+    return LIST_LINKS;
   }
-  
-  for (iter=the_repeaters.begin(); iter!=the_repeaters.end(); ++iter)
+  else if (callsign.rfind("-R") == callsign.size()-2)
   {
-    if (iter->callsign() == call)
-    {
-      return &(*iter);
-    }
+    return LIST_REPEATERS;
   }
-  
-  for (iter=the_conferences.begin(); iter!=the_conferences.end(); ++iter)
+  else if (callsign.find("*") == 0)
   {
-    if (iter->callsign() == call)
-    {
-      return &(*iter);
-    }
+    return LIST_CONFERENCES;
   }
-  
-  for (iter=the_stations.begin(); iter!=the_stations.end(); ++iter)
+  return LIST_STATIONS;
+} /* Directory::listType */
+
+
+const StationData *Directory::findCall(const string& call)
+{
+  CallIndex::const_iterator it = call_index.find(call);
+  if (it != call_index.end())
   {
-    if (iter->callsign() == call)
-    {
-      return &(*iter);
-    }
+    return it->second;
   }
-  
   return 0;
-  
 } /* Directory::findCall */
 
 
 const StationData *Directory::findStation(int id)
 {
-  list<StationData> calls;
-  list<StationData>::const_iterator iter;
-  
-  for (iter=the_links.begin(); iter!=the_links.end(); ++iter)
+  IdIndex::const_iterator it = id_index.find(id);
+  if (it != id_index.end())
   {
-    if (iter->id() == id)
-    {
-      return &(*iter);
-    }
+    return it->second;
   }
-  
-  for (iter=the_repeaters.begin(); iter!=the_repeaters.end(); ++iter)
-  {
-    if (iter->id() == id)
-    {
-      return &(*iter);
-    }
-  }
-  
-  for (iter=the_conferences.begin(); iter!=the_conferences.end(); ++iter)
-  {
-    if (iter->id() == id)
-    {
-      return &(*iter);
-    }
-  }
-  
-  for (iter=the_stations.begin(); iter!=the_stations.end(); ++iter)
-  {
-    if (iter->id() == id)
-    {
-      return &(*iter);
-    }
-  }
-  
   return 0;
-  
 } /* Directory::findStation */
 
 
-bool Directory::stationCodeEq(const StationData& stn, string code, bool exact)
-{
-  if (exact)
-  {
-    return (stn.code() == code);
-  }
-  else
-  {
-    return (stn.code().find(code) == 0);
-  }
-} /* Directory::stationCodeEq  */
-
-
 void Directory::findStationsByCode(vector<StationData> &stns,
 		const string& code, bool exact)
 {
-  list<StationData>::const_iterator iter;
-  
   stns.clear();
 
-  for (iter=the_links.begin(); iter!=the_links.end(); ++iter)
+    // The code index is sorted on code so all stations with a code starting
+    // with the given digits are found in one consecutive range. The matches
+    // are returned in the same order as the station lists are in.
+  vector<size_t> matches;
+  CodeIndex::const_iterator it = lower_bound(code_index.begin(),
+                                             code_index.end(),
+                                             make_pair(code, size_t(0)));
+  for (; it != code_index.end(); ++it)
   {
-    if (stationCodeEq(*iter, code, exact))
+    if (exact ? (it->first != code)
+              : (it->first.compare(0, code.size(), code) != 0))
     {
-      stns.push_back(*iter);
-    }
-  }
-  
-  for (iter=the_repeaters.begin(); iter!=the_repeaters.end(); ++iter)
-  {
-    if (stationCodeEq(*iter, code, exact))
-    {
-      stns.push_back(*iter);
-    }
-  }
-  
-  for (iter=the_conferences.begin(); iter!=the_conferences.end(); ++iter)
-  {
-    if (stationCodeEq(*iter, code, exact))
-    {
-      stns.push_back(*iter);
+      break;
     }
+    matches.push_back(it->second);
   }
-  
-  for (iter=the_stations.begin(); iter!=the_stations.end(); ++iter)
+  sort(matches.begin(), matches.end());
+
+  stns.reserve(matches.size());
+  vector<size_t>::const_iterator mit;
+  for (mit = matches.begin(); mit != matches.end(); ++mit)
   {
-    if (stationCodeEq(*iter, code, exact))
-    {
-      stns.push_back(*iter);
-    }
+    stns.push_back(*stn_index[*mit]);
   }
-
 } /* Directory::findStationsByCode  */
 
 
@@ -474,9 +427,30 @@ int Directory::handleCallList(char *buf, int len)
       {
 	if (memcmp(buf, "@@@\n", 4) == 0)
 	{
+	  get_call_hash = HASH_INIT;
+	  get_call_delta_reply = false;
+	  get_call_base = 0;
+	  clearCallLists();
 	  com_state = CS_WAITING_FOR_COUNT;
 	  read_len = 4;
 	}
+	else if (memcmp(buf, "###", 3) == 0)
+	{
+	    // A reply to a delta request: "###<generation> <base>\n"
+	  char *nl = (char *)memchr(buf, '\n', len);
+	  if (nl != 0)
+	  {
+	    read_len = nl-buf+1;
+	    buf[read_len-1] = 0;
+	    char *end = 0;
+	    get_call_gen = strtoul(buf+3, &end, 10);
+	    get_call_base = strtoul(end, 0, 10);
+	    get_call_hash = HASH_INIT;
+	    get_call_delta_reply = true;
+	    clearCallLists();
+	    com_state = CS_WAITING_FOR_COUNT;
+	  }
+	}
 	else
 	{
 	  fprintf(stderr, "Error in call list format (@@@ expected).\n");
@@ -497,13 +471,13 @@ int Directory::handleCallList(char *buf, int len)
 	//printf("Number of calls to get: %d\n", get_call_cnt);
 	if (get_call_cnt > 0)
 	{
-	  get_call_list.clear();
 	  the_message = "";
 	  com_state = CS_WAITING_FOR_CALL;
 	}
 	else
 	{
-	  com_state = CS_WAITING_FOR_END;
+	  com_state = get_call_delta_reply ? CS_WAITING_FOR_REMOVE_COUNT
+	                                   : CS_WAITING_FOR_END;
 	}
       }
       break;
@@ -583,14 +557,22 @@ int Directory::handleCallList(char *buf, int len)
 	{
 	  the_message += get_call_entry.description() + "\n";
 	}
+	else if (get_call_base != 0)
+	{
+	    // The delta is merged into the current lists when it is complete
+	  get_call_update_index[get_call_entry.callsign()] =
+	      get_call_updates.size();
+	  get_call_updates.push_back(get_call_entry);
+	}
 	else
 	{
-      	  get_call_list.push_back(get_call_entry);
+      	  addCallEntry(get_call_entry);
 	}
 
 	if (--get_call_cnt <= 0)
 	{
-	  com_state = CS_WAITING_FOR_END;
+	  com_state = get_call_delta_reply ? CS_WAITING_FOR_REMOVE_COUNT
+	                                   : CS_WAITING_FOR_END;
 	}
 	else
 	{
@@ -600,6 +582,36 @@ int Directory::handleCallList(char *buf, int len)
       break;
     }
 
+    case CS_WAITING_FOR_REMOVE_COUNT:
+    {
+      char *nl = (char *)memchr(buf, '\n', len);
+      if (nl != 0)
+      {
+	read_len = nl-buf+1;
+	buf[read_len-1] = 0;
+	get_call_remove_cnt = atoi(buf);
+	com_state = (get_call_remove_cnt > 0) ? CS_WAITING_FOR_REMOVE
+	                                      : CS_WAITING_FOR_END;
+      }
+      break;
+    }
+
+    case CS_WAITING_FOR_REMOVE:
+    {
+      char *nl = (char *)memchr(buf, '\n', len);
+      if (nl != 0)
+      {
+	read_len = nl-buf+1;
+	buf[read_len-1] = 0;
+	get_call_removed.insert(buf);
+	if (--get_call_remove_cnt <= 0)
+	{
+	  com_state = CS_WAITING_FOR_END;
+	}
+      }
+      break;
+    }
+
     case CS_WAITING_FOR_END:
     {
       if (len >= 3)
@@ -607,32 +619,32 @@ int Directory::handleCallList(char *buf, int len)
 	if (memcmp(buf, "+++", 3) == 0)
 	{
 	  //printf("End received!\n");
-	  the_links.clear();
-	  the_repeaters.clear();
-	  the_conferences.clear();
-	  the_stations.clear();
-	  list<StationData>::const_iterator it;
-	  for (it = get_call_list.begin(); it != get_call_list.end(); ++it)
+	    // Only update the station lists if the server sent something
+	    // different from last time
+	  if (get_call_delta_reply)
 	  {
-	    const string &callsign = it->callsign();
-	    if (callsign.rfind("-L") == callsign.size()-2)
-	    {
-	      the_links.push_back(*it);
-	    }
-	    else if (callsign.rfind("-R") == callsign.size()-2)
-	    {
-	      the_repeaters.push_back(*it);
-	    }
-	    else if (callsign.find("*") == 0)
+	    if ((get_call_base != 0) && (get_call_base != delta_gen))
 	    {
-	      the_conferences.push_back(*it);
+		// Not a delta from our list. Ask for the full list next time.
+	      delta_gen = 0;
 	    }
-	    else
+	    else if (get_call_gen != delta_gen)
 	    {
-	      the_stations.push_back(*it);
+	      if (get_call_base != 0)
+	      {
+		mergeDeltaUpdates();
+	      }
+	      delta_gen = get_call_gen;
+	      last_call_hash = 0;
+	      replaceStationLists();
 	    }
 	  }
-	  get_call_list.clear();
+	  else if (get_call_hash != last_call_hash)
+	  {
+	    last_call_hash = get_call_hash;
+	    replaceStationLists();
+	  }
+	  clearCallLists();
 	  com_state = CS_IDLE;
 	  read_len = 3;
 	}
@@ -710,7 +722,16 @@ void Directory::ctrlSockConnected(void)
       
     case Cmd::GET_CALLS:
     {
-      cmdstr = "s";
+      if (delta_updates)
+      {
+	ostringstream ss;
+	ss << "d" << delta_gen << "\015";
+	cmdstr = ss.str();
+      }
+      else
+      {
+	cmdstr = "s";
+      }
       break;
     }
       
@@ -779,6 +800,7 @@ int Directory::ctrlSockDataReceived(void *ptr, unsigned len)
     else if (com_state != CS_IDLE) 	// Waiting for station list
     {
       read_len = handleCallList(buf, len);
+      get_call_hash = hashData(get_call_hash, buf, read_len);
       if (com_state == CS_IDLE)
       {
       	//if (read_len < len)
@@ -1006,6 +1028,176 @@ void Directory::onCmdTimeout(Timer *timer)
 } /* Directory::onCmdTimeout */
 
 
+void Directory::updateIndexes(void)
+{
+    // The containers are cleared rather than recreated so that the buckets
+    // and storage already allocated are reused on every list refresh
+  call_index.clear();
+  id_index.clear();
+  code_index.clear();
+  stn_index.clear();
+
+  size_t cnt = the_links.size() + the_repeaters.size() +
+               the_conferences.size() + the_stations.size();
+  call_index.reserve(cnt);
+  id_index.reserve(cnt);
+  code_index.reserve(cnt);
+  stn_index.reserve(cnt);
+
+    // Add the lists in the same order as the linear search used to look
+    // through them so that the first entry wins if there are duplicates
+  const list<StationData> *lists[] =
+  {
+    &the_links, &the_repeaters, &the_conferences, &the_stations
+  };
+  for (size_t i=0; i<sizeof(lists)/sizeof(*lists); ++i)
+  {
+    list<StationData>::const_iterator it;
+    for (it=lists[i]->begin(); it!=lists[i]->end(); ++it)
+    {
+      const StationData *stn = &(*it);
+      call_index.insert(make_pair(stn->callsign(), stn));
+      id_index.insert(make_pair(stn->id(), stn));
+      code_index.push_back(make_pair(stn->code(), stn_index.size()));
+      stn_index.push_back(stn);
+    }
+  }
+  sort(code_index.begin(), code_index.end());
+} /* Directory::updateIndexes */
+
+
+void Directory::addCallEntry(const StationData& stn)
+{
+  get_call_lists[listType(stn.callsign())].push_back(stn);
+
+    // The current lists are still indexed while the new list is being
+    // received so each entry can be checked as soon as it has been parsed
+  const StationData *old_stn = findCall(stn.callsign());
+  if (old_stn == 0)
+  {
+    get_call_delta.added.push_back(stn);
+  }
+  else if (!stationDataEq(*old_stn, stn))
+  {
+    get_call_delta.changed.push_back(stn);
+  }
+} /* Directory::addCallEntry */
+
+
+/*
+ * Build the new lists from the current lists and a received delta. The
+ * stations are kept in the same order as they were received from the server
+ * the first time, with new stations added at the end.
+ */
+void Directory::mergeDeltaUpdates(void)
+{
+  const list<StationData> *lists[] =
+  {
+    &the_links, &the_repeaters, &the_conferences, &the_stations
+  };
+  vector<bool> used(get_call_updates.size(), false);
+  for (size_t i=0; i<sizeof(lists)/sizeof(*lists); ++i)
+  {
+    list<StationData>::const_iterator it;
+    for (it=lists[i]->begin(); it!=lists[i]->end(); ++it)
+    {
+      if (get_call_removed.count(it->callsign()) > 0)
+      {
+        continue;
+      }
+      unordered_map<string, size_t>::const_iterator uit =
+        get_call_update_index.find(it->callsign());
+      if (uit != get_call_update_index.end())
+      {
+        used[uit->second] = true;
+        addCallEntry(get_call_updates[uit->second]);
+      }
+      else
+      {
+        addCallEntry(*it);
+      }
+    }
+  }
+  for (size_t i=0; i<get_call_updates.size(); ++i)
+  {
+    if (!used[i])
+    {
+      addCallEntry(get_call_updates[i]);
+    }
+  }
+} /* Directory::mergeDeltaUpdates */
+
+
+void Directory::replaceStationLists(void)
+{
+  the_links.swap(get_call_lists[LIST_LINKS]);
+  the_repeaters.swap(get_call_lists[LIST_REPEATERS]);
+  the_conferences.swap(get_call_lists[LIST_CONFERENCES]);
+  the_stations.swap(get_call_lists[LIST_STATIONS]);
+  updateIndexes();
+
+    // The old lists now live in get_call_lists so the stations that are
+    // missing from the new index are the ones that have gone away
+  for (int i=LIST_LINKS; i<=LIST_STATIONS; ++i)
+  {
+    list<StationData>::const_iterator it;
+    for (it=get_call_lists[i].begin(); it!=get_call_lists[i].end(); ++it)
+    {
+      if (findCall(it->callsign()) == 0)
+      {
+        get_call_delta.removed.push_back(*it);
+      }
+    }
+  }
+
+  if (!get_call_delta.added.empty() || !get_call_delta.removed.empty() ||
+      !get_call_delta.changed.empty())
+  {
+    stationListChanged(get_call_delta);
+  }
+  clearCallLists();
+} /* Directory::replaceStationLists */
+
+
+void Directory::clearCallLists(void)
+{
+  for (int i=LIST_LINKS; i<=LIST_STATIONS; ++i)
+  {
+    get_call_lists[i].clear();
+  }
+  get_call_delta.added.clear();
+  get_call_delta.removed.clear();
+  get_call_delta.changed.clear();
+  get_call_updates.clear();
+  get_call_update_index.clear();
+  get_call_removed.clear();
+} /* Directory::clearCallLists */
+
+
+static bool stationDataEq(const StationData& a, const StationData& b)
+{
+  return (a.callsign() == b.callsign()) &&
+         (a.status() == b.status()) &&
+         (a.time() == b.time()) &&
+         (a.description() == b.description()) &&
+         (a.id() == b.id()) &&
+         (a.ip() == b.ip());
+} /* stationDataEq */
+
+
+  // A 64 bit FNV-1a hash is used to find out if a station list is the same
+  // as the last one without having to keep a copy of the raw data around
+static uint64_t hashData(uint64_t hash, const char *buf, size_t len)
+{
+  for (size_t i=0; i<len; ++i)
+  {
+    hash ^= static_cast<unsigned char>(buf[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+} /* hashData */
+
+
 
 /*
  * This file has not been truncated
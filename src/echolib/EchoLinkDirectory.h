@@ -44,10 +44,14 @@ An example of how to use the EchoLink::Directory class
  ****************************************************************************/
 
 #include <sigc++/sigc++.h>
+#include <stdint.h>
 
 #include <string>
 #include <list>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <iostream>
 
 
@@ -131,6 +135,31 @@ class Directory : public sigc::trackable
 {
   public:
     static const unsigned MAX_DESCRIPTION_SIZE = 27;
+
+    /**
+     * @brief The station list a callsign belongs to
+     */
+    typedef enum
+    {
+      LIST_LINKS, LIST_REPEATERS, LIST_CONFERENCES, LIST_STATIONS
+    } ListType;
+
+    /**
+     * @brief The difference between two consecutive station lists
+     */
+    struct StationListDelta
+    {
+      std::vector<StationData> added;   ///< Stations new to the list
+      std::vector<StationData> removed; ///< Stations no longer in the list
+      std::vector<StationData> changed; ///< Stations with updated data
+    };
+
+    /**
+     * @brief 	Find out which station list a callsign belongs to
+     * @param 	callsign The callsign to check
+     * @return	Returns the type of list the callsign is sorted into
+     */
+    static ListType listType(const std::string& callsign);
     
     /**
      * @brief 	Constructor
@@ -219,6 +248,25 @@ class Directory : public sigc::trackable
      * @return	Returns the name of the remote host
      */
     const std::vector<std::string>& servers(void) const { return the_servers; }
+
+    /**
+     * @brief Use delta requests when getting the station list
+     * @param enable Set to \em true to enable delta requests
+     *
+     * The public directory servers do not understand delta requests so this
+     * must only be enabled when the servers are EchoLink::DirectoryCache
+     * servers, e.g. an echolinkdircache daemon running on the local network.
+     * Only the stations that have changed since the last request are then
+     * transfered. The station list and the signals look exactly the same as
+     * when the full list is transfered.
+     */
+    void setDeltaUpdates(bool enable);
+
+    /**
+     * @brief Check if delta requests are used
+     * @return Returns \em true if delta requests are enabled
+     */
+    bool deltaUpdates(void) const { return delta_updates; }
     
     /**
      * @brief Set the callsign to use when logging in to the server
@@ -352,6 +400,17 @@ class Directory : public sigc::trackable
      * @brief A signal that is emitted when the station list has been updated
      */
     sigc::signal<void> stationListUpdated;
+
+    /**
+     * @brief A signal that is emitted when the station list has changed
+     * @param delta The stations that were added, removed or changed
+     *
+     * This signal is emitted right before the stationListUpdated signal but
+     * only if the new station list differ from the previous one. If the
+     * directory server return exactly the same list as last time, the
+     * station lists are left untouched and this signal is not emitted.
+     */
+    sigc::signal<void, const StationListDelta&> stationListChanged;
     
     /**
      * @brief A signal that is emitted when an error occurs
@@ -366,12 +425,17 @@ class Directory : public sigc::trackable
     {
       CS_WAITING_FOR_START, CS_WAITING_FOR_COUNT, CS_WAITING_FOR_CALL,
       CS_WAITING_FOR_DATA,  CS_WAITING_FOR_ID,    CS_WAITING_FOR_IP,
-      CS_WAITING_FOR_END,   CS_IDLE,  	      	  CS_WAITING_FOR_OK
+      CS_WAITING_FOR_END,   CS_IDLE,  	      	  CS_WAITING_FOR_OK,
+      CS_WAITING_FOR_REMOVE_COUNT,                CS_WAITING_FOR_REMOVE
     } ComState;
     
     static const int DIRECTORY_SERVER_PORT    	= 5200;
     static const int REGISTRATION_REFRESH_TIME  = 5 * 60 * 1000; // 5 minutes
     static const int CMD_TIMEOUT                = 120 * 1000; // 2 minutes
+
+    typedef std::unordered_map<std::string, const StationData*> CallIndex;
+    typedef std::unordered_map<int, const StationData*> IdIndex;
+    typedef std::vector<std::pair<std::string, size_t> > CodeIndex;
     
     ComState      	      com_state;
     std::vector<std::string>  the_servers;
@@ -382,12 +446,28 @@ class Directory : public sigc::trackable
     std::list<StationData>    the_repeaters;
     std::list<StationData>    the_stations;
     std::list<StationData>    the_conferences;
+    CallIndex                 call_index;
+    IdIndex                   id_index;
+    CodeIndex                 code_index;
+    std::vector<const StationData*> stn_index;
     std::string       	      the_message;
     std::string       	      error_str;
     
     int       	      	      get_call_cnt;
     StationData       	      get_call_entry;
-    std::list<StationData>    get_call_list;
+    std::list<StationData>    get_call_lists[LIST_STATIONS+1];
+    StationListDelta          get_call_delta;
+    uint64_t                  get_call_hash;
+    uint64_t                  last_call_hash;
+    bool                      delta_updates;
+    unsigned                  delta_gen;
+    unsigned                  get_call_gen;
+    bool                      get_call_delta_reply;
+    unsigned                  get_call_base;
+    int                       get_call_remove_cnt;
+    std::vector<StationData>  get_call_updates;
+    std::unordered_map<std::string, size_t> get_call_update_index;
+    std::unordered_set<std::string> get_call_removed;
     
     DirectoryCon *            ctrl_con;
     std::list<Cmd>    	      cmd_queue;
@@ -414,7 +494,11 @@ class Directory : public sigc::trackable
     void createClientObject(void);
     void onRefreshRegistration(Async::Timer *timer);
     void onCmdTimeout(Async::Timer *timer);
-    bool stationCodeEq(const StationData& stn, std::string code, bool exact);
+    void updateIndexes(void);
+    void addCallEntry(const StationData& stn);
+    void mergeDeltaUpdates(void);
+    void replaceStationLists(void);
+    void clearCallLists(void);
 
 };  /* class Directory */
 
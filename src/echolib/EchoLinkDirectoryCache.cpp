@@ -0,0 +1,739 @@
+/**
+@file	 EchoLinkDirectoryCache.cpp
+@brief   A caching EchoLink directory server for local clients
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+This file contains a class that act as an EchoLink directory server for a
+number of local clients. The station list is fetched once from the real
+directory servers and then served to all clients. For usage instructions,
+see the class documentation for EchoLink::DirectoryCache.
+
+\verbatim
+EchoLib - A library for EchoLink communication
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <sstream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncApplication.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "EchoLinkDirectoryCache.h"
+#include "EchoLinkDirectoryCon.h"
+
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+using namespace EchoLink;
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+  // The longest delta request accepted, "d" followed by a generation number
+#define MAX_REQUEST_LEN 32
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+struct DirectoryCache::Client
+{
+  TcpConnection*  con;
+  DirectoryCon*   upstream;
+  bool            upstream_connected;
+  string          pending;
+  string          out;
+  size_t          out_pos;
+  bool            close_when_sent;
+  bool            waiting;
+  bool            delta;
+  unsigned        base_gen;
+  Timer           timer;
+
+  explicit Client(TcpConnection *con)
+    : con(con), upstream(0), upstream_connected(false), out_pos(0),
+      close_when_sent(false), waiting(false), delta(false), base_gen(0),
+      timer(CLIENT_TIMEOUT)
+  {
+  }
+};
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void deleteDirectoryCon(DirectoryCon *con);
+static bool readLine(const string& buf, size_t& pos, string& line);
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+DirectoryCache::DirectoryCache(const vector<string>& servers,
+                               const string& listen_port,
+                               const IpAddress &bind_ip)
+  : servers(servers), bind_ip(bind_ip), server(listen_port, bind_ip),
+    max_age(DEFAULT_MAX_AGE), current_gen(0), fetch_con(0), fetch_timer(0)
+{
+  last_fetch.tv_sec = 0;
+  last_fetch.tv_nsec = 0;
+  server.clientConnected.connect(
+      mem_fun(*this, &DirectoryCache::onClientConnected));
+  server.clientDisconnected.connect(
+      mem_fun(*this, &DirectoryCache::onClientDisconnected));
+} /* DirectoryCache::DirectoryCache */
+
+
+DirectoryCache::~DirectoryCache(void)
+{
+  for (ClientMap::iterator it=clients.begin(); it!=clients.end(); ++it)
+  {
+    Client *client = it->second;
+    if (client->upstream != 0)
+    {
+      client->upstream->disconnected.clear();
+      delete client->upstream;
+    }
+    delete client;
+  }
+  clients.clear();
+
+  if (fetch_con != 0)
+  {
+    fetch_con->disconnected.clear();
+    delete fetch_con;
+  }
+  delete fetch_timer;
+} /* DirectoryCache::~DirectoryCache */
+
+
+size_t DirectoryCache::stationCount(void) const
+{
+  return history.empty() ? 0 : history.back().second.size();
+} /* DirectoryCache::stationCount */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void DirectoryCache::onClientConnected(TcpConnection *con)
+{
+  Client *client = new Client(con);
+  clients[con] = client;
+  con->dataReceived.connect(mem_fun(*this, &DirectoryCache::onClientData));
+  con->sendBufferFull.connect(sigc::bind(
+        mem_fun(*this, &DirectoryCache::onClientSendBufferFull), con));
+  client->timer.expired.connect(sigc::bind(
+        mem_fun(*this, &DirectoryCache::onClientTimeout), con));
+} /* DirectoryCache::onClientConnected */
+
+
+void DirectoryCache::onClientDisconnected(TcpConnection *con,
+                                          TcpConnection::DisconnectReason)
+{
+  ClientMap::iterator it = clients.find(con);
+  if (it == clients.end())
+  {
+    return;
+  }
+  Client *client = it->second;
+  clients.erase(it);
+
+    // The upstream connection may be the one emitting a signal right now so
+    // it is deleted later, when the call stack has unwound
+  if (client->upstream != 0)
+  {
+    client->upstream->connected.clear();
+    client->upstream->dataReceived.clear();
+    client->upstream->disconnected.clear();
+    Application::app().runTask(
+        sigc::bind(sigc::ptr_fun(&deleteDirectoryCon), client->upstream));
+  }
+  delete client;
+} /* DirectoryCache::onClientDisconnected */
+
+
+int DirectoryCache::onClientData(TcpConnection *con, void *buf, int count)
+{
+  ClientMap::iterator it = clients.find(con);
+  assert(it != clients.end());
+  Client *client = it->second;
+  const char *data = static_cast<const char *>(buf);
+
+  if (client->upstream != 0)
+  {
+    if (client->upstream_connected)
+    {
+      client->upstream->write(data, count);
+    }
+    else
+    {
+      client->pending.append(data, count);
+    }
+    return count;
+  }
+
+    // Only one request is accepted on each connection
+  if (client->waiting || client->close_when_sent)
+  {
+    return count;
+  }
+
+  switch (data[0])
+  {
+    case 's':
+      client->delta = false;
+      requestList(client);
+      return count;
+
+    case 'd':
+    {
+      const char *end = static_cast<const char *>(memchr(data, '\r', count));
+      if (end == 0)
+      {
+        end = static_cast<const char *>(memchr(data, '\n', count));
+      }
+      if (end == 0)
+      {
+        if (count > MAX_REQUEST_LEN)
+        {
+          closeClient(client);
+          return count;
+        }
+        return 0;
+      }
+      client->delta = true;
+      client->base_gen = strtoul(string(data + 1, end).c_str(), 0, 10);
+      requestList(client);
+      return count;
+    }
+
+    case 'l':
+      startRelay(client, data, count);
+      return count;
+
+    default:
+      closeClient(client);
+      return count;
+  }
+} /* DirectoryCache::onClientData */
+
+
+void DirectoryCache::onClientSendBufferFull(bool is_full, TcpConnection *con)
+{
+  ClientMap::iterator it = clients.find(con);
+  if ((it == clients.end()) || is_full)
+  {
+    return;
+  }
+  Client *client = it->second;
+
+  if (client->out_pos < client->out.size())
+  {
+    int ret = con->write(client->out.data() + client->out_pos,
+                         client->out.size() - client->out_pos);
+    if (ret < 0)
+    {
+      closeClient(client);
+      return;
+    }
+    client->out_pos += ret;
+  }
+
+  if (client->out_pos >= client->out.size())
+  {
+    client->out.clear();
+    client->out_pos = 0;
+    if (client->close_when_sent)
+    {
+      closeClient(client);
+    }
+  }
+} /* DirectoryCache::onClientSendBufferFull */
+
+
+void DirectoryCache::onClientTimeout(Timer *t, TcpConnection *con)
+{
+  ClientMap::iterator it = clients.find(con);
+  if (it != clients.end())
+  {
+    closeClient(it->second);
+  }
+} /* DirectoryCache::onClientTimeout */
+
+
+void DirectoryCache::sendToClient(Client *client, const char *data,
+                                  size_t len)
+{
+  if (!client->out.empty())
+  {
+    client->out.append(data, len);
+    return;
+  }
+
+  int ret = client->con->write(data, len);
+  if (ret < 0)
+  {
+    closeClient(client);
+    return;
+  }
+  if (static_cast<size_t>(ret) < len)
+  {
+    client->out.assign(data + ret, len - ret);
+    client->out_pos = 0;
+  }
+} /* DirectoryCache::sendToClient */
+
+
+void DirectoryCache::closeClient(Client *client)
+{
+    // Emitting the disconnected signal make the TCP server forget about the
+    // connection, which in turn end up in onClientDisconnected
+  TcpConnection *con = client->con;
+  con->disconnect();
+  con->disconnected(con, TcpConnection::DR_ORDERED_DISCONNECT);
+} /* DirectoryCache::closeClient */
+
+
+void DirectoryCache::startRelay(Client *client, const char *data, size_t len)
+{
+  ++the_stats.logins;
+  client->pending.assign(data, len);
+  client->upstream = new DirectoryCon(servers, bind_ip);
+  client->upstream->connected.connect(sigc::bind(
+        mem_fun(*this, &DirectoryCache::onRelayConnected), client->con));
+  client->upstream->dataReceived.connect(sigc::bind(
+        mem_fun(*this, &DirectoryCache::onRelayData), client->con));
+  client->upstream->disconnected.connect(sigc::bind(
+        mem_fun(*this, &DirectoryCache::onRelayDisconnected), client->con));
+  client->upstream->connect();
+} /* DirectoryCache::startRelay */
+
+
+void DirectoryCache::onRelayConnected(TcpConnection *con)
+{
+  ClientMap::iterator it = clients.find(con);
+  assert(it != clients.end());
+  Client *client = it->second;
+  client->upstream_connected = true;
+  client->upstream->write(client->pending.data(), client->pending.size());
+  client->pending.clear();
+} /* DirectoryCache::onRelayConnected */
+
+
+int DirectoryCache::onRelayData(void *buf, unsigned count, TcpConnection *con)
+{
+  ClientMap::iterator it = clients.find(con);
+  assert(it != clients.end());
+  sendToClient(it->second, static_cast<const char *>(buf), count);
+  return count;
+} /* DirectoryCache::onRelayData */
+
+
+void DirectoryCache::onRelayDisconnected(TcpConnection *con)
+{
+  ClientMap::iterator it = clients.find(con);
+  assert(it != clients.end());
+  Client *client = it->second;
+  client->close_when_sent = true;
+  if (client->out.empty())
+  {
+    closeClient(client);
+  }
+} /* DirectoryCache::onRelayDisconnected */
+
+
+void DirectoryCache::requestList(Client *client)
+{
+  if (!history.empty() && isFresh())
+  {
+    serveList(client);
+    return;
+  }
+
+  client->waiting = true;
+  if (fetch_con == 0)
+  {
+    startFetch();
+  }
+} /* DirectoryCache::requestList */
+
+
+void DirectoryCache::serveList(Client *client)
+{
+  TcpConnection *con = client->con;
+  client->waiting = false;
+  client->close_when_sent = true;
+  if (client->delta)
+  {
+    ++the_stats.deltas;
+    const string delta = buildDelta(client->base_gen);
+    sendToClient(client, delta.data(), delta.size());
+  }
+  else
+  {
+    ++the_stats.full_lists;
+    sendToClient(client, full_list.data(), full_list.size());
+  }
+
+    // The client may have been closed by a write error in sendToClient
+  ClientMap::iterator it = clients.find(con);
+  if ((it != clients.end()) && client->out.empty())
+  {
+    closeClient(client);
+  }
+} /* DirectoryCache::serveList */
+
+
+string DirectoryCache::buildDelta(unsigned base_gen) const
+{
+  const Snapshot& current = history.back().second;
+  const Snapshot *base = 0;
+  if (base_gen != 0)
+  {
+    for (History::const_iterator it=history.begin(); it!=history.end(); ++it)
+    {
+      if (it->first == base_gen)
+      {
+        base = &it->second;
+        break;
+      }
+    }
+  }
+
+  string updates;
+  size_t update_cnt = messages.size();
+  for (size_t i=0; i<messages.size(); ++i)
+  {
+    updates += messages[i];
+  }
+  Snapshot::const_iterator it;
+  for (it=current.begin(); it!=current.end(); ++it)
+  {
+    if (base != 0)
+    {
+      Snapshot::const_iterator bit = base->find(it->first);
+      if ((bit != base->end()) && (bit->second == it->second))
+      {
+        continue;
+      }
+    }
+    updates += it->second;
+    ++update_cnt;
+  }
+
+  string removes;
+  size_t remove_cnt = 0;
+  if (base != 0)
+  {
+    for (it=base->begin(); it!=base->end(); ++it)
+    {
+      if (current.find(it->first) == current.end())
+      {
+        removes += it->first + "\n";
+        ++remove_cnt;
+      }
+    }
+  }
+
+  ostringstream os;
+  os << "###" << current_gen << " " << ((base != 0) ? base_gen : 0) << "\n"
+     << update_cnt << "\n" << updates
+     << remove_cnt << "\n" << removes
+     << "+++";
+  return os.str();
+} /* DirectoryCache::buildDelta */
+
+
+bool DirectoryCache::isFresh(void) const
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - last_fetch.tv_sec) < static_cast<time_t>(max_age);
+} /* DirectoryCache::isFresh */
+
+
+void DirectoryCache::startFetch(void)
+{
+  ++the_stats.fetches;
+  fetch_buf.clear();
+  fetch_con = new DirectoryCon(servers, bind_ip);
+  fetch_con->connected.connect(
+      mem_fun(*this, &DirectoryCache::onFetchConnected));
+  fetch_con->dataReceived.connect(
+      mem_fun(*this, &DirectoryCache::onFetchData));
+  fetch_con->disconnected.connect(
+      mem_fun(*this, &DirectoryCache::onFetchDisconnected));
+  fetch_timer = new Timer(FETCH_TIMEOUT);
+  fetch_timer->expired.connect(
+      mem_fun(*this, &DirectoryCache::onFetchTimeout));
+  fetch_con->connect();
+} /* DirectoryCache::startFetch */
+
+
+void DirectoryCache::onFetchConnected(void)
+{
+  fetch_con->write("s", 1);
+} /* DirectoryCache::onFetchConnected */
+
+
+int DirectoryCache::onFetchData(void *buf, unsigned count)
+{
+  fetch_buf.append(static_cast<const char *>(buf), count);
+
+    // Only try to parse the list when it look like it is complete
+  if ((fetch_buf.size() >= 3) &&
+      (fetch_buf.compare(fetch_buf.size() - 3, 3, "+++") == 0))
+  {
+    Snapshot stns;
+    vector<string> msgs;
+    string list(fetch_buf);
+    if (parseList(list, stns, msgs))
+    {
+      fetch_buf.clear();
+      if (list != full_list)
+      {
+        full_list.swap(list);
+        messages.swap(msgs);
+          // The first generation number is taken from the clock so that
+          // clients will not mix up generations from before a restart
+        current_gen = (current_gen == 0) ? time(0) : current_gen + 1;
+        history.push_back(make_pair(current_gen, Snapshot()));
+        history.back().second.swap(stns);
+        while (history.size() > HISTORY_SIZE)
+        {
+          history.pop_front();
+        }
+        listUpdated(current_gen);
+      }
+      clock_gettime(CLOCK_MONOTONIC, &last_fetch);
+      fetchDone(true);
+    }
+  }
+  return count;
+} /* DirectoryCache::onFetchData */
+
+
+void DirectoryCache::onFetchDisconnected(void)
+{
+  error("The directory server closed the connection before the station "
+        "list had been received");
+  fetchDone(false);
+} /* DirectoryCache::onFetchDisconnected */
+
+
+void DirectoryCache::onFetchTimeout(Timer *t)
+{
+  error("Timeout while fetching the station list from the directory server");
+  fetchDone(false);
+} /* DirectoryCache::onFetchTimeout */
+
+
+void DirectoryCache::fetchDone(bool success)
+{
+  if (!success)
+  {
+    ++the_stats.fetch_errors;
+  }
+
+  fetch_con->connected.clear();
+  fetch_con->dataReceived.clear();
+  fetch_con->disconnected.clear();
+  Application::app().runTask(
+      sigc::bind(sigc::ptr_fun(&deleteDirectoryCon), fetch_con));
+  fetch_con = 0;
+  delete fetch_timer;
+  fetch_timer = 0;
+
+    // If the fetch failed the old list, if any, is served rather than
+    // leaving the clients without a list
+  vector<Client*> waiting;
+  for (ClientMap::iterator it=clients.begin(); it!=clients.end(); ++it)
+  {
+    if (it->second->waiting)
+    {
+      waiting.push_back(it->second);
+    }
+  }
+  for (vector<Client*>::iterator it=waiting.begin(); it!=waiting.end(); ++it)
+  {
+    if (history.empty())
+    {
+      closeClient(*it);
+    }
+    else
+    {
+      serveList(*it);
+    }
+  }
+} /* DirectoryCache::fetchDone */
+
+
+/*
+ * Parse a station list in the format sent by the directory servers. Each
+ * station is stored in the snapshot, keyed on callsign, in exactly the same
+ * format as it was received so that it can be sent to the clients as is.
+ * The list is truncated to end right after the end marker.
+ */
+bool DirectoryCache::parseList(string& list, Snapshot& stns,
+                               vector<string>& msgs) const
+{
+  if (list.compare(0, 4, "@@@\n") != 0)
+  {
+    return false;
+  }
+  size_t pos = 4;
+  string line;
+  if (!readLine(list, pos, line))
+  {
+    return false;
+  }
+  int cnt = atoi(line.c_str());
+  while (cnt > 0)
+  {
+    const size_t start = pos;
+    string call;
+    if (!readLine(list, pos, call) || !readLine(list, pos, line) ||
+        !readLine(list, pos, line) || !readLine(list, pos, line))
+    {
+      return false;
+    }
+    if (call == ".")
+    {
+      continue;
+    }
+    if (call == " ")
+    {
+      msgs.push_back(list.substr(start, pos - start));
+    }
+    else
+    {
+      stns[call] = list.substr(start, pos - start);
+    }
+    --cnt;
+  }
+  if (list.compare(pos, 3, "+++") != 0)
+  {
+    return false;
+  }
+  list.erase(pos + 3);
+  return true;
+} /* DirectoryCache::parseList */
+
+
+static void deleteDirectoryCon(DirectoryCon *con)
+{
+  delete con;
+} /* deleteDirectoryCon */
+
+
+static bool readLine(const string& buf, size_t& pos, string& line)
+{
+  size_t nl = buf.find('\n', pos);
+  if (nl == string::npos)
+  {
+    return false;
+  }
+  line.assign(buf, pos, nl - pos);
+  pos = nl + 1;
+  return true;
+} /* readLine */
+
+
+
+/*
+ * This file has not been truncated
+ */
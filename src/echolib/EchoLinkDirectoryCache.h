@@ -0,0 +1,312 @@
+/**
+@file	 EchoLinkDirectoryCache.h
+@brief   A caching EchoLink directory server for local clients
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+This file contains a class that act as an EchoLink directory server for a
+number of local clients. The station list is fetched once from the real
+directory servers and then served to all clients. For usage instructions,
+see the class documentation for EchoLink::DirectoryCache.
+
+\verbatim
+EchoLib - A library for EchoLink communication
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+#ifndef ECHOLINK_DIRECTORY_CACHE_INCLUDED
+#define ECHOLINK_DIRECTORY_CACHE_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <utility>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncTcpServer.h>
+#include <AsyncTimer.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace EchoLink
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+class DirectoryCon;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A caching EchoLink directory server for local clients
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class listen for connections from EchoLink directory clients, like
+EchoLink::Directory, and act as a directory server for them. A station list
+request is answered from a cached list. The list is only fetched from the
+real directory servers when it is older than the maximum age, no matter how
+many clients that ask for it. Clients that ask while a fetch is in progress
+are answered when it is done.
+
+Registration (login) requests are relayed unmodified to the real directory
+servers. All clients will therefore be seen as coming from the IP address of
+the host running the cache, just as if they were behind the same NAT router.
+That is also what make the directory servers accept the station list
+requests from the cache.
+
+Apart from the plain station list request, the cache understand a delta
+request, "d<generation>\r". The station list is given a new generation number
+each time it change. A client sending the last generation number it got will
+only receive the stations that have been added, changed or removed since
+then. A client sending zero, or a generation that is too old to be
+remembered, get the full list. The first generation number is taken from
+the system clock so numbers are not reused when the cache is restarted. The reply look like this:
+
+\verbatim
+###<generation> <base generation>\n
+<number of added or changed stations>\n
+<callsign>\n<data>\n<id>\n<ip>\n       (repeated for each station)
+<number of removed stations>\n
+<callsign>\n                           (repeated for each station)
++++
+\endverbatim
+
+A base generation of zero mean that the reply hold the full list. Server
+messages are included among the added stations in every reply, just like in
+the plain station list. Use EchoLink::Directory::setDeltaUpdates to make a
+Directory object use delta requests.
+*/
+class DirectoryCache : public sigc::trackable
+{
+  public:
+    /**
+     * @brief The default maximum age of the cached list in seconds
+     */
+    static const unsigned DEFAULT_MAX_AGE = 60;
+
+    /**
+     * @brief The number of old generations that are remembered for deltas
+     */
+    static const unsigned HISTORY_SIZE = 16;
+
+    /**
+     * @brief Counters that can be used for monitoring the cache
+     */
+    struct Stats
+    {
+      unsigned long fetches;        ///< Station lists fetched from upstream
+      unsigned long fetch_errors;   ///< Failed upstream fetches
+      unsigned long full_lists;     ///< Full station lists served
+      unsigned long deltas;         ///< Delta station lists served
+      unsigned long logins;         ///< Relayed registration requests
+      Stats(void)
+        : fetches(0), fetch_errors(0), full_lists(0), deltas(0), logins(0) {}
+    };
+
+    /**
+     * @brief 	Constructor
+     * @param 	servers     The EchoLink directory servers to fetch from
+     * @param 	listen_port The TCP port to listen for clients on
+     * @param   bind_ip     The IP address to listen on and to use as the
+     *                      source address for upstream connections
+     */
+    DirectoryCache(const std::vector<std::string>& servers,
+                   const std::string& listen_port="5200",
+                   const Async::IpAddress &bind_ip=Async::IpAddress());
+
+    /**
+     * @brief 	Destructor
+     */
+    ~DirectoryCache(void);
+
+    /**
+     * @brief   Set the maximum age of the cached station list
+     * @param   seconds The maximum age in seconds
+     *
+     * A request for the station list that arrive when the cached list is
+     * older than this will trigger a new fetch from the directory servers.
+     */
+    void setMaxAge(unsigned seconds) { max_age = seconds; }
+
+    /**
+     * @brief   Get the maximum age of the cached station list
+     * @return  Returns the maximum age in seconds
+     */
+    unsigned maxAge(void) const { return max_age; }
+
+    /**
+     * @brief   Get the current generation of the station list
+     * @return  Returns the generation number, zero if no list has been
+     *          fetched yet
+     */
+    unsigned generation(void) const { return current_gen; }
+
+    /**
+     * @brief   Get the number of stations in the cached list
+     * @return  Returns the number of stations
+     */
+    size_t stationCount(void) const;
+
+    /**
+     * @brief   Get the statistics counters
+     * @return  Returns a reference to the counters
+     */
+    const Stats& stats(void) const { return the_stats; }
+
+    /**
+     * @brief A signal that is emitted when a new station list generation
+     *        has been created
+     * @param generation The new generation number
+     */
+    sigc::signal<void, unsigned> listUpdated;
+
+    /**
+     * @brief A signal that is emitted when an error occurs
+     * @param msg The error message
+     */
+    sigc::signal<void, const std::string&> error;
+
+  private:
+    static const int FETCH_TIMEOUT  = 120 * 1000;  // 2 minutes
+    static const int CLIENT_TIMEOUT = 120 * 1000;  // 2 minutes
+
+    struct Client;
+    typedef std::map<Async::TcpConnection*, Client*> ClientMap;
+    typedef std::unordered_map<std::string, std::string> Snapshot;
+    typedef std::deque<std::pair<unsigned, Snapshot> > History;
+
+    std::vector<std::string>          servers;
+    Async::IpAddress                  bind_ip;
+    Async::TcpServer<>                server;
+    ClientMap                         clients;
+    unsigned                          max_age;
+    unsigned                          current_gen;
+    struct timespec                   last_fetch;
+    std::string                       full_list;
+    std::vector<std::string>          messages;
+    History                           history;
+    DirectoryCon*                     fetch_con;
+    std::string                       fetch_buf;
+    Async::Timer*                     fetch_timer;
+    Stats                             the_stats;
+
+    DirectoryCache(const DirectoryCache&);
+    DirectoryCache& operator=(const DirectoryCache&);
+    void onClientConnected(Async::TcpConnection *con);
+    void onClientDisconnected(Async::TcpConnection *con,
+                              Async::TcpConnection::DisconnectReason reason);
+    int onClientData(Async::TcpConnection *con, void *buf, int count);
+    void onClientSendBufferFull(bool is_full, Async::TcpConnection *con);
+    void onClientTimeout(Async::Timer *t, Async::TcpConnection *con);
+    void sendToClient(Client *client, const char *data, size_t len);
+    void closeClient(Client *client);
+    void startRelay(Client *client, const char *data, size_t len);
+    void onRelayConnected(Async::TcpConnection *con);
+    int onRelayData(void *buf, unsigned count, Async::TcpConnection *con);
+    void onRelayDisconnected(Async::TcpConnection *con);
+    void requestList(Client *client);
+    void serveList(Client *client);
+    std::string buildDelta(unsigned base_gen) const;
+    bool isFresh(void) const;
+    void startFetch(void);
+    void onFetchConnected(void);
+    int onFetchData(void *buf, unsigned count);
+    void onFetchDisconnected(void);
+    void onFetchTimeout(Async::Timer *t);
+    void fetchDone(bool success);
+    bool parseList(std::string& list, Snapshot& stns,
+                   std::vector<std::string>& msgs) const;
+
+};  /* class DirectoryCache */
+
+
+} /* namespace */
+
+#endif /* ECHOLINK_DIRECTORY_CACHE_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
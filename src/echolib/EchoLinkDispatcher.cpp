@@ -185,19 +185,41 @@ Dispatcher::~Dispatcher(void)
 } /* Dispatcher::~Dispatcher */
 
 
+bool Dispatcher::connectionStats(const IpAddress& ip, ConStats& stats) const
+{
+  const ConData *con_data = const_cast<Dispatcher *>(this)->findCon(ip);
+  if (con_data == 0)
+  {
+    return false;
+  }
+  stats = con_data->stats;
+  return true;
+} /* Dispatcher::connectionStats */
+
+
 bool Dispatcher::registerConnection(Qso *con, CtrlInputHandler cih,
 	AudioInputHandler aih)
 {
-  if (con_map.find(con->remoteIp()) != con_map.end())
+  if (findCon(con->remoteIp()) != 0)
   {
     return false;
   }
   
+    // Keep the load factor at or below 50% so that probe sequences stay short
+  if (2 * (con_cnt + 1) > con_table.size())
+  {
+    growConTable();
+  }
+
   ConData con_data;
+  con_data.addr = con->remoteIp().ip4Addr().s_addr;
   con_data.con = con;
   con_data.cih = cih;
   con_data.aih = aih;
-  con_map[con->remoteIp()] = con_data;
+  con_data.stats.ctrl_pkts = 0;
+  con_data.stats.audio_pkts = 0;
+  insertCon(con_data);
+  ++con_cnt;
   
   return true;
   
@@ -206,10 +228,31 @@ bool Dispatcher::registerConnection(Qso *con, CtrlInputHandler cih,
 
 void Dispatcher::unregisterConnection(Qso *con)
 {
-  ConMap::iterator iter;
-  iter = con_map.find(con->remoteIp());
-  assert(iter != con_map.end());
-  con_map.erase(iter);
+  ConData *con_data = findCon(con->remoteIp());
+  assert(con_data != 0);
+
+    // Backward shift deletion: move following entries of the probe sequence
+    // into the hole so that no tombstones are needed
+  unsigned mask = con_table.size() - 1;
+  unsigned hole = con_data - &con_table[0];
+  unsigned slot = hole;
+  for (;;)
+  {
+    slot = (slot + 1) & mask;
+    ConData &next = con_table[slot];
+    if (next.con == 0)
+    {
+      break;
+    }
+    unsigned home = conSlot(next.addr);
+    if (((slot - home) & mask) >= ((slot - hole) & mask))
+    {
+      con_table[hole] = next;
+      hole = slot;
+    }
+  }
+  con_table[hole].con = 0;
+  --con_cnt;
 } /* Dispatcher::unregisterConnection */
 
 
@@ -275,8 +318,11 @@ bool Dispatcher::sendAudioMsg(const IpAddress& to, const void *buf, int len)
 
 
 Dispatcher::Dispatcher(void)
-  : ctrl_sock(0), audio_sock(0)
+  : con_table_bits(0), con_cnt(0), ctrl_drop_cnt(0), audio_drop_cnt(0),
+    ctrl_sock(0), audio_sock(0)
 {
+  growConTable();
+
   Proxy *proxy = Proxy::instance();
   if (proxy == 0)
   {
@@ -291,6 +337,11 @@ Dispatcher::Dispatcher(void)
       return;
     }
     
+      // Read many datagrams per read event since a busy conference node
+      // receive audio from many stations at the same time
+    ctrl_sock->setRecvBatchSize(RECV_BATCH_SIZE, RECV_MAX_SIZE);
+    audio_sock->setRecvBatchSize(RECV_BATCH_SIZE, RECV_MAX_SIZE);
+
     ctrl_sock->dataReceived.connect(
         mem_fun(*this, &Dispatcher::ctrlDataReceived));
     audio_sock->dataReceived.connect(
@@ -323,11 +374,11 @@ void Dispatcher::ctrlDataReceived(const IpAddress& ip, uint16_t port,
 {
   unsigned char *recv_buf = static_cast<unsigned char *>(buf);
   
-  ConMap::iterator iter;
-  iter = con_map.find(ip);
-  if (iter != con_map.end())
+  ConData *con_data = findCon(ip);
+  if (con_data != 0)
   {
-    ((iter->second.con)->*(iter->second.cih))(recv_buf, len);
+    con_data->stats.ctrl_pkts += 1;
+    ((con_data->con)->*(con_data->cih))(recv_buf, len);
   }
   else
   {
@@ -355,6 +406,7 @@ void Dispatcher::ctrlDataReceived(const IpAddress& ip, uint16_t port,
     }
     else
     {
+      ctrl_drop_cnt += 1;
       cerr << "Spurious ctrl packet received from " << ip << endl;
     }
   }
@@ -367,19 +419,78 @@ void Dispatcher::audioDataReceived(const IpAddress& ip, uint16_t port,
 {
   unsigned char *recv_buf = static_cast<unsigned char *>(buf);
   
-  ConMap::iterator iter;
-  iter = con_map.find(ip);
-  if (iter != con_map.end())
+  ConData *con_data = findCon(ip);
+  if (con_data != 0)
   {
-    ((iter->second.con)->*(iter->second.aih))(recv_buf, len);
+    con_data->stats.audio_pkts += 1;
+    ((con_data->con)->*(con_data->aih))(recv_buf, len);
   }
   else
   {
+    audio_drop_cnt += 1;
     cerr << "Spurious audio packet received from " << ip << endl;
   }
 } /* Dispatcher::audioDataReceived */
 
 
+unsigned Dispatcher::conSlot(in_addr_t addr) const
+{
+    // Fibonacci hashing spreads the IPv4 addresses, which often only differ
+    // in the low bits, evenly over the table
+  return (static_cast<uint32_t>(addr) * 2654435769U) >> (32 - con_table_bits);
+} /* Dispatcher::conSlot */
+
+
+Dispatcher::ConData *Dispatcher::findCon(const IpAddress& ip)
+{
+  in_addr_t addr = ip.ip4Addr().s_addr;
+  unsigned mask = con_table.size() - 1;
+  for (unsigned slot = conSlot(addr); ; slot = (slot + 1) & mask)
+  {
+    ConData &con_data = con_table[slot];
+    if (con_data.con == 0)
+    {
+      return 0;
+    }
+    if (con_data.addr == addr)
+    {
+      return &con_data;
+    }
+  }
+} /* Dispatcher::findCon */
+
+
+void Dispatcher::insertCon(const ConData& con_data)
+{
+  unsigned mask = con_table.size() - 1;
+  unsigned slot = conSlot(con_data.addr);
+  while (con_table[slot].con != 0)
+  {
+    slot = (slot + 1) & mask;
+  }
+  con_table[slot] = con_data;
+} /* Dispatcher::insertCon */
+
+
+void Dispatcher::growConTable(void)
+{
+  ConTable old_table;
+  old_table.swap(con_table);
+  con_table_bits = (con_table_bits == 0) ? CON_TABLE_MIN_BITS
+                                         : con_table_bits + 1;
+  ConData empty = ConData();
+  con_table.assign(1U << con_table_bits, empty);
+  ConTable::const_iterator it;
+  for (it = old_table.begin(); it != old_table.end(); ++it)
+  {
+    if (it->con != 0)
+    {
+      insertCon(*it);
+    }
+  }
+} /* Dispatcher::growConTable */
+
+
 /*
  *----------------------------------------------------------------------------
  * Method:    Dispatcher::printData
@@ -46,7 +46,7 @@ An example of how to use the EchoLink::Dispatcher class
 
 #include <sigc++/sigc++.h>
 
-#include <map>
+#include <vector>
 
 
 /****************************************************************************
@@ -196,6 +196,37 @@ class Dispatcher : public sigc::trackable
      * @brief 	Destructor
      */
     ~Dispatcher(void);
+
+    /**
+     * @brief Packet counters for one connection
+     */
+    typedef struct
+    {
+      unsigned long ctrl_pkts;  ///< Number of received control packets
+      unsigned long audio_pkts; ///< Number of received audio packets
+    } ConStats;
+
+    /**
+     * @brief 	Get the packet counters for a connection
+     * @param 	ip    The IP address of the remote station
+     * @param 	stats Filled in with the counters for the connection
+     * @return	Returns \em true if a connection to the given IP exists
+     */
+    bool connectionStats(const Async::IpAddress& ip, ConStats& stats) const;
+
+    /**
+     * @brief 	Get the number of dropped control packets
+     * @return	Returns the number of control packets received from an
+     *          address with no connection that were not connect requests
+     */
+    unsigned long droppedCtrlPackets(void) const { return ctrl_drop_cnt; }
+
+    /**
+     * @brief 	Get the number of dropped audio packets
+     * @return	Returns the number of audio packets received from an address
+     *          with no connection
+     */
+    unsigned long droppedAudioPackets(void) const { return audio_drop_cnt; }
     
     /**
      * @brief 	A signal that is emitted when someone is trying to connect
@@ -218,25 +249,38 @@ class Dispatcher : public sigc::trackable
     typedef void (Qso::*AudioInputHandler)(unsigned char *buf, int len);
     typedef struct
     {
+      in_addr_t         addr;
       Qso *      	con;
       CtrlInputHandler	cih;
       AudioInputHandler aih;
+      ConStats          stats;
     } ConData;
-    typedef std::map<Async::IpAddress, ConData> ConMap;
+    typedef std::vector<ConData> ConTable;
     
     static const int  	DEFAULT_PORT_BASE = 5198;
+    static const unsigned RECV_BATCH_SIZE   = 16;
+    static const size_t RECV_MAX_SIZE       = 4096;
+    static const unsigned CON_TABLE_MIN_BITS = 4;
     
     static int	      	    port_base;
     static Async::IpAddress bind_ip;
     static Dispatcher *     the_instance;
     
-    ConMap    	      	    con_map;
+    ConTable                con_table;
+    unsigned                con_table_bits;
+    unsigned                con_cnt;
+    unsigned long           ctrl_drop_cnt;
+    unsigned long           audio_drop_cnt;
     Async::UdpSocket * 	    ctrl_sock;
     Async::UdpSocket * 	    audio_sock;
     
     bool registerConnection(Qso *con, CtrlInputHandler cih,
 	AudioInputHandler aih);
     void unregisterConnection(Qso *con);
+    unsigned conSlot(in_addr_t addr) const;
+    ConData *findCon(const Async::IpAddress& ip);
+    void insertCon(const ConData& con_data);
+    void growConTable(void);
     
     Dispatcher(void);
     void ctrlDataReceived(const Async::IpAddress& ip, uint16_t port,
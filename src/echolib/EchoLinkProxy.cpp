@@ -37,6 +37,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cstring>
 #include <iostream>
 #include <algorithm>
+#include <ctime>
 
 
 /****************************************************************************
@@ -46,6 +47,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncIpAddress.h>
+#include <AsyncApplication.h>
 
 
 /****************************************************************************
@@ -128,8 +130,10 @@ Proxy::Proxy(const string &host, uint16_t port, const string &callsign,
   : con(host, port, recv_buf_size), callsign(callsign), password(password),
     state(STATE_DISCONNECTED), tcp_state(TCP_STATE_DISCONNECTED),
     recv_buf_cnt(0), reconnect_timer(RECONNECT_INTERVAL, Timer::TYPE_PERIODIC),
-    cmd_timer(CMD_TIMEOUT)
+    cmd_timer(CMD_TIMEOUT), tx_flush_pending(false)
 {
+  resetQueueStats();
+
   delete the_instance;
   the_instance = this;
 
@@ -148,6 +152,7 @@ Proxy::Proxy(const string &host, uint16_t port, const string &callsign,
   con.connected.connect(mem_fun(*this, &Proxy::onConnected));
   con.dataReceived.connect(mem_fun(*this, &Proxy::onDataReceived));
   con.disconnected.connect(mem_fun(*this, &Proxy::onDisconnected));
+  con.sendBufferFull.connect(mem_fun(*this, &Proxy::onSendBufferFull));
 
   reconnect_timer.setEnable(false);
   reconnect_timer.expired.connect(hide(mem_fun(con, &TcpClient<>::connect)));
@@ -236,6 +241,15 @@ bool Proxy::udpCtrl(const IpAddress &addr, const void *data, unsigned len)
 } /* Proxy::udpCtrl */
 
 
+void Proxy::resetQueueStats(void)
+{
+  queue_stats.frames = 0;
+  queue_stats.writes = 0;
+  queue_stats.total_delay_ms = 0;
+  queue_stats.max_delay_ms = 0;
+} /* Proxy::resetQueueStats */
+
+
 
 /****************************************************************************
  *
@@ -262,9 +276,19 @@ bool Proxy::sendMsgBlock(MsgBlockType type, const IpAddress &remote_ip,
     return false;
   }
 
-  int msg_len = MSG_HEADER_SIZE + len;
-  uint8_t msg_buf[msg_len];
-  uint8_t *msg_ptr = msg_buf;
+  if (tx_buf.size() + MSG_HEADER_SIZE + len > MAX_TX_BUF_SIZE)
+  {
+    cerr << "*** ERROR: The send queue to the EchoLink proxy is full\n";
+    reset();
+    return false;
+  }
+
+    // Append the message to the send queue. All messages queued during one
+    // main loop iteration are written to the proxy in one go.
+  size_t msg_len = MSG_HEADER_SIZE + len;
+  size_t msg_pos = tx_buf.size();
+  tx_buf.resize(msg_pos + msg_len);
+  uint8_t *msg_ptr = &tx_buf[msg_pos];
 
     // Store the message type
   *msg_ptr++ = static_cast<uint8_t>(type);
@@ -287,23 +311,22 @@ bool Proxy::sendMsgBlock(MsgBlockType type, const IpAddress &remote_ip,
   *msg_ptr++ = (len >> 24) & 0xff;
 
     // Store the message data
-  memcpy(msg_ptr, data, len);
-
-    // Send the message
-  int ret = con.write(msg_buf, msg_len);
-  if (ret == -1)
+  if (len > 0)
   {
-    char errstr[256];
-    errstr[0] = 0;
-    cerr << "*** ERROR: Error while writing message to EchoLink proxy: "
-         << strerror_r(errno, errstr, sizeof(errstr)) << endl;
-    reset();
+    memcpy(msg_ptr, data, len);
   }
-  else if (ret != msg_len)
+
+  TxFrame frame;
+  frame.len = msg_len;
+  frame.queued_us = nowUs();
+  tx_frames.push_back(frame);
+
+  if (!tx_flush_pending)
   {
-    cerr << "*** ERROR: Could not write all data to EchoLink proxy\n";
-    reset();
+    tx_flush_pending = true;
+    Application::app().runTask(mem_fun(*this, &Proxy::flushTxBuf));
   }
+
   return true;
 } /* Proxy::sendMsgBlock */
 
@@ -369,6 +392,9 @@ void Proxy::disconnectHandler(void)
     recv_buf_cnt = 0;
     tcpDisconnected();
   }
+
+  tx_buf.clear();
+  tx_frames.clear();
 } /* Proxy::disconnectHandler */
 
 
@@ -683,6 +709,68 @@ void Proxy::cmdTimeout(void)
 } /* Proxy::cmdTimeout */
 
 
+void Proxy::flushTxBuf(void)
+{
+  tx_flush_pending = false;
+  if (tx_buf.empty() || !con.isConnected())
+  {
+    return;
+  }
+
+  int ret = con.write(&tx_buf[0], tx_buf.size());
+  if (ret == -1)
+  {
+    char errstr[256];
+    errstr[0] = 0;
+    cerr << "*** ERROR: Error while writing message to EchoLink proxy: "
+         << strerror_r(errno, errstr, sizeof(errstr)) << endl;
+    reset();
+    return;
+  }
+  queue_stats.writes += 1;
+  tx_buf.erase(tx_buf.begin(), tx_buf.begin() + ret);
+
+    // Account the queueing delay for all frames that have now been
+    // completely written. If not all data could be written, the rest is
+    // sent when the TCP connection signal that the send buffer has room.
+  size_t written = ret;
+  int64_t now = nowUs();
+  while (!tx_frames.empty() && (tx_frames.front().len <= written))
+  {
+    unsigned delay_ms = (now - tx_frames.front().queued_us) / 1000;
+    queue_stats.frames += 1;
+    queue_stats.total_delay_ms += delay_ms;
+    if (delay_ms > queue_stats.max_delay_ms)
+    {
+      queue_stats.max_delay_ms = delay_ms;
+    }
+    written -= tx_frames.front().len;
+    tx_frames.pop_front();
+  }
+  if (!tx_frames.empty())
+  {
+    tx_frames.front().len -= written;
+  }
+} /* Proxy::flushTxBuf */
+
+
+void Proxy::onSendBufferFull(bool is_full)
+{
+  if (!is_full)
+  {
+    flushTxBuf();
+  }
+} /* Proxy::onSendBufferFull */
+
+
+int64_t Proxy::nowUs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+} /* Proxy::nowUs */
+
+
 
 /*
  * This file has not been truncated
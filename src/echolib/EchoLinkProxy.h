@@ -35,6 +35,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <stdint.h>
 #include <sigc++/sigc++.h>
 
 
@@ -231,6 +234,39 @@ class Proxy : public sigc::trackable
      */
     bool udpCtrl(const Async::IpAddress &addr, const void *data, unsigned len);
 
+    /**
+     * @brief   Statistics for the queue of frames going to the proxy server
+     */
+    typedef struct
+    {
+      unsigned long frames;         ///< Frames written to the proxy server
+      unsigned long writes;         ///< Write calls used to send the frames
+      unsigned long total_delay_ms; ///< Sum of the queueing delays
+      unsigned      max_delay_ms;   ///< The largest queueing delay seen
+    } QueueStats;
+
+    /**
+     * @brief   Get the send queue statistics
+     * @return  Returns the statistics collected since the last reset
+     *
+     * Frames sent to the proxy server are queued and written together once
+     * per main loop iteration. The queueing delay is the time from when a
+     * frame was queued until it was completely written to the TCP socket.
+     * If the delay keep growing the link to the proxy server is saturated.
+     */
+    const QueueStats& queueStats(void) const { return queue_stats; }
+
+    /**
+     * @brief   Reset the send queue statistics
+     */
+    void resetQueueStats(void);
+
+    /**
+     * @brief   Get the number of bytes waiting to be sent to the proxy
+     * @return  Returns the number of queued bytes
+     */
+    size_t queuedBytes(void) const { return tx_buf.size(); }
+
     /**
      * @brief   A signal that is emitted when the proxy is ready for operation
      * @param   is_ready Set to true if the proxy is ready or false if it's not
@@ -338,6 +374,13 @@ class Proxy : public sigc::trackable
     static const int RECONNECT_INTERVAL = 10000;
     static const int CMD_TIMEOUT        = 10000;
     static const int recv_buf_size      = 16384;
+    static const size_t MAX_TX_BUF_SIZE = 65536;
+
+    typedef struct
+    {
+      size_t    len;
+      int64_t   queued_us;
+    } TxFrame;
 
     static Proxy *the_instance;
 
@@ -350,6 +393,10 @@ class Proxy : public sigc::trackable
     int                 recv_buf_cnt;
     Async::Timer        reconnect_timer;
     Async::Timer        cmd_timer;
+    std::vector<uint8_t> tx_buf;
+    std::deque<TxFrame> tx_frames;
+    bool                tx_flush_pending;
+    QueueStats          queue_stats;
 
     Proxy(const Proxy&);
     Proxy& operator=(const Proxy&);
@@ -375,6 +422,9 @@ class Proxy : public sigc::trackable
                           int len);
     void handleSystemMsg(const unsigned char *buf, int len);
     void cmdTimeout(void);
+    void flushTxBuf(void);
+    void onSendBufferFull(bool is_full);
+    static int64_t nowUs(void);
     
 };  /* class Proxy */
 
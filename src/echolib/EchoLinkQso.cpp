@@ -168,6 +168,15 @@ Qso::Qso(const IpAddress& addr, const string& callsign, const string& name,
   }
   
   setLocalCallsign(callsign);
+
+    // The constant parts of the RTP header of outgoing audio packets are
+    // only set up once. The payload and sequence number are then written
+    // in place for each packet.
+  memset(&tx_packet.header, 0, sizeof(tx_packet.header));
+  tx_packet.header.version = 0xc0;
+  tx_packet.header.time = htonl(0);
+  tx_packet.header.ssrc = htonl(0);
+  memset(&audio_stats, 0, sizeof(audio_stats));
       
   gsmh = gsm_create();
 
@@ -403,22 +412,18 @@ bool Qso::sendAudioRaw(RawPacket *raw_packet)
       (p->remote_codec == Private::CODEC_GSM))
   {
     // transcode SPEEX -> GSM
-    VoicePacket voice_packet;
     size_t nbytes = 0;
     
     for(int i=0; i<FRAME_COUNT; i++)
     {
-      gsm_encode(gsmh, raw_packet->samples + i*160, voice_packet.data + i*33);
+      gsm_encode(gsmh, raw_packet->samples + i*160, tx_packet.data + i*33);
       nbytes += 33;
     }
-    voice_packet.header.version = 0xc0;
-    voice_packet.header.pt = 0x03;
-    voice_packet.header.time = htonl(0);
-    voice_packet.header.ssrc = htonl(0);
-    voice_packet.header.seqNum = htons(next_audio_seq++);
+    tx_packet.header.pt = 0x03;
+    tx_packet.header.seqNum = htons(next_audio_seq++);
     
-    bool success = Dispatcher::instance()->sendAudioMsg(remote_ip, &voice_packet,
-        nbytes + sizeof(voice_packet.header));
+    bool success = Dispatcher::instance()->sendAudioMsg(remote_ip, &tx_packet,
+        nbytes + sizeof(tx_packet.header));
     if (!success)
     {
       perror("sendAudioMsg in Qso::sendAudioRaw");
@@ -439,6 +444,7 @@ bool Qso::sendAudioRaw(RawPacket *raw_packet)
     }
   }
   
+  audio_stats.tx_packets += 1;
   return true;
 
 } /* Qso::sendAudioRaw */
@@ -458,6 +464,16 @@ void Qso::setRemoteParams(const string& priv)
 } /* Qso::setRemoteParams */
 
 
+bool Qso::remoteUsesSpeex(void) const
+{
+#ifdef SPEEX_MAJOR
+  return p->remote_codec == Private::CODEC_SPEEX;
+#else
+  return false;
+#endif
+} /* Qso::remoteUsesSpeex */
+
+
 int Qso::writeSamples(const float *samples, int count)
 {
   int samples_read = 0;
@@ -772,10 +788,13 @@ inline void Qso::handleAudioPacket(unsigned char *buf, int len)
   RawPacket raw_packet = { voice_packet, len, receive_buffer };
   short *sbuff = receive_buffer;
 
+  audio_stats.rx_packets += 1;
+
   /* Check that we have received a valid header. */
   if ((unsigned)len < sizeof(voice_packet->header))
   {
     cerr << "*** WARNING: Invalid audio packet size." << endl;
+    audio_stats.rx_dropped += 1;
     return;
   }
 
@@ -794,25 +813,18 @@ inline void Qso::handleAudioPacket(unsigned char *buf, int len)
              << FRAME_COUNT << " frames in each audio packet, but only "
              << frameno << " frames have been received."
              << endl;
+        audio_stats.rx_dropped += 1;
         return;
       }
       if (err == -2)
       {
         cerr << "*** WARNING: Corrupt Speex stream in received audio packet."
              << endl;
+        audio_stats.rx_dropped += 1;
         return;
       }
 
-      if (rx_indicator_timer == 0)
-      {
-        receiving_audio = true;
-        isReceiving(true);
-        rx_indicator_timer = new Timer(RX_INDICATOR_POLL_TIME,
-                                       Timer::TYPE_PERIODIC);
-        rx_indicator_timer->expired.connect(
-            mem_fun(*this, &Qso::checkRxActivity));
-        rx_timeout_left = RX_INDICATOR_SLACK;
-      }
+      startRxIndicator();
       
       float samples[160];
       for (int i = 0; i < 160; i++)
@@ -829,21 +841,13 @@ inline void Qso::handleAudioPacket(unsigned char *buf, int len)
     if ((unsigned)len < sizeof(voice_packet->header)+FRAME_COUNT*33)
     {
       cerr << "*** WARNING: Invalid GSM audio packet size." << endl;
+      audio_stats.rx_dropped += 1;
       return;
     }
     for (int frameno=0; frameno<FRAME_COUNT; ++frameno)
     {
       gsm_decode(gsmh, voice_packet->data + frameno*33, sbuff);
-      if (rx_indicator_timer == 0)
-      {
-        receiving_audio = true;
-        isReceiving(true); 
-        rx_indicator_timer = new Timer(RX_INDICATOR_POLL_TIME,
-                                       Timer::TYPE_PERIODIC);
-        rx_indicator_timer->expired.connect(
-            mem_fun(*this, &Qso::checkRxActivity));
-        rx_timeout_left = RX_INDICATOR_SLACK;
-      }
+      startRxIndicator();
       
       float samples[160];
       for (int i=0; i<160; ++i)
@@ -939,14 +943,14 @@ bool Qso::setupConnection(void)
 
 void Qso::cleanupConnection(void)
 {
-  if (rx_indicator_timer != 0)
+  if (receiving_audio)
   {
     receiving_audio = false;
     isReceiving(false);
     sinkFlushSamples();
-    delete rx_indicator_timer;
-    rx_indicator_timer = 0;
   }
+  delete rx_indicator_timer;
+  rx_indicator_timer = 0;
   delete keep_alive_timer;
   keep_alive_timer = 0;
   delete con_timeout_timer;
@@ -960,11 +964,7 @@ bool Qso::sendVoicePacket(void)
   assert(send_buffer_cnt == BUFFER_SIZE);
 
   size_t nbytes = 0;
-  VoicePacket voice_packet;
-  voice_packet.header.version = 0xc0;
-  voice_packet.header.time = htonl(0);
-  voice_packet.header.ssrc = htonl(0);
-  voice_packet.header.seqNum = htons(next_audio_seq++);
+  tx_packet.header.seqNum = htons(next_audio_seq++);
 
 #ifdef SPEEX_MAJOR
   if (p->remote_codec == Private::CODEC_SPEEX)
@@ -975,22 +975,22 @@ bool Qso::sendVoicePacket(void)
     }
     speex_bits_insert_terminator(&p->enc_bits);
     size_t nsize = speex_bits_nbytes(&p->enc_bits);
-    if (nsize < sizeof(voice_packet.data))
+    if (nsize < sizeof(tx_packet.data))
     {
-      nbytes = speex_bits_write(&p->enc_bits, (char*)voice_packet.data, nsize);
+      nbytes = speex_bits_write(&p->enc_bits, (char*)tx_packet.data, nsize);
     }
     speex_bits_reset(&p->enc_bits);
-    voice_packet.header.pt = 0x96;
+    tx_packet.header.pt = 0x96;
   }
   else
 #endif
   {
     for(int i=0; i<FRAME_COUNT; i++)
     {
-      gsm_encode(gsmh, send_buffer + i*160, voice_packet.data + i*33);
+      gsm_encode(gsmh, send_buffer + i*160, tx_packet.data + i*33);
       nbytes += 33;
     }
-    voice_packet.header.pt = 0x03;
+    tx_packet.header.pt = 0x03;
   }
   if (!nbytes)
   {
@@ -998,14 +998,15 @@ bool Qso::sendVoicePacket(void)
     return false;
   }
 
-  bool success = Dispatcher::instance()->sendAudioMsg(remote_ip, &voice_packet,
-      nbytes + sizeof(voice_packet.header));
+  bool success = Dispatcher::instance()->sendAudioMsg(remote_ip, &tx_packet,
+      nbytes + sizeof(tx_packet.header));
   if (!success)
   {
     perror("sendAudioMsg in Qso::sendVoicePacket");
     return false;
   }
   
+  audio_stats.tx_packets += 1;
   return true;
   
 } /* Qso::sendVoicePacket */
@@ -1018,15 +1019,38 @@ void Qso::checkRxActivity(Timer *timer)
   rx_timeout_left -= 100;
   if (rx_timeout_left <= 0)
   {
+    rx_indicator_timer->setEnable(false);
     receiving_audio = false;
     isReceiving(false);
     sinkFlushSamples();
-    delete rx_indicator_timer;
-    rx_indicator_timer = 0;
   }
 } /* Qso::checkRxActivity */
 
 
+void Qso::startRxIndicator(void)
+{
+  if (receiving_audio)
+  {
+    return;
+  }
+  receiving_audio = true;
+  isReceiving(true);
+
+    // The timer is kept between talk spurts so that it is only allocated
+    // once per connection
+  if (rx_indicator_timer == 0)
+  {
+    rx_indicator_timer = new Timer(RX_INDICATOR_POLL_TIME,
+                                   Timer::TYPE_PERIODIC);
+    rx_indicator_timer->expired.connect(
+        mem_fun(*this, &Qso::checkRxActivity));
+    audio_stats.allocations += 1;
+  }
+  rx_indicator_timer->setEnable(true);
+  rx_timeout_left = RX_INDICATOR_SLACK;
+} /* Qso::startRxIndicator */
+
+
 bool Qso::sendByePacket(void)
 {
   unsigned char bye[64];
@@ -158,6 +158,21 @@ class Qso
       uint8_t data[1024];
     } __attribute__ ((packed));
     
+    /**
+     * @brief Counters for the audio path of a connection
+     *
+     * Audio packets are encoded and decoded in place in buffers owned by the
+     * Qso object so the allocation counter should stay constant while the
+     * packet counters grow.
+     */
+    struct AudioStats
+    {
+      unsigned long rx_packets;  ///< Received audio packets
+      unsigned long rx_dropped;  ///< Received audio packets that were dropped
+      unsigned long tx_packets;  ///< Sent audio packets
+      unsigned long allocations; ///< Heap allocations made by the audio path
+    };
+
     struct RawPacket
     {
       VoicePacket *voice_packet;
@@ -320,6 +335,18 @@ class Qso
       * @param priv A private string for passing connection parameters
       */
     void setRemoteParams(const std::string& priv);
+
+    /**
+     * @brief Find out if the SPEEX codec is used for audio sent to the remote
+     * @return Returns \em true if SPEEX is used or \em false if GSM is used
+     */
+    bool remoteUsesSpeex(void) const;
+
+    /**
+     * @brief Get the audio packet counters for this connection
+     * @return Returns the counters collected since the object was created
+     */
+    const AudioStats& audioStats(void) const { return audio_stats; }
     
     /**
      * @brief Set the name of the remote station
@@ -502,6 +529,8 @@ class Qso
     bool                use_gsm_only;
     Private             *p;
     int                 rx_timeout_left;
+    VoicePacket         tx_packet;
+    AudioStats          audio_stats;
 
     Qso(const Qso&);
     Qso& operator=(const Qso&);
@@ -521,6 +550,7 @@ class Qso
     void cleanupConnection(void);
     bool sendVoicePacket(void);
     void checkRxActivity(Async::Timer *timer);
+    void startRxIndicator(void);
     bool sendByePacket(void);
     
 };  /* class Qso */
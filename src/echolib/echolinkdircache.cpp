@@ -0,0 +1,308 @@
+/**
+@file	 echolinkdircache.cpp
+@brief   A caching EchoLink directory server daemon
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+This application run an EchoLink::DirectoryCache so that a number of EchoLink
+nodes at the same site can share one copy of the EchoLink station list.
+Configure the nodes to use the host running this daemon as their directory
+server and enable DIRECTORY_CACHE in the EchoLink module configuration.
+
+\verbatim
+EchoLib - A library for EchoLink communication
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <signal.h>
+#include <popt.h>
+#include <sigc++/sigc++.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncCppApplication.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "EchoLinkDirectoryCache.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+using namespace EchoLink;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define PROGRAM_NAME "echolinkdircache"
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void parse_arguments(int argc, const char **argv);
+static void handle_unix_signal(int signum);
+static void print_stats(void);
+static void on_list_updated(unsigned generation);
+static void on_error(const string& msg);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+static char *servers_str = 0;
+static char *port_str = 0;
+static char *bind_str = 0;
+static int max_age = DirectoryCache::DEFAULT_MAX_AGE;
+static int quiet = 0;
+static DirectoryCache *cache = 0;
+
+
+/****************************************************************************
+ *
+ * MAIN
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  main
+ * Purpose:   Start everything...
+ * Input:     argc  - The number of arguments passed to this program
+ *    	      	      including the program name.
+ *    	      argv  - The arguments passed to this program. argv[0] is the
+ *    	      	      program name.
+ * Output:    Return 0 on success, else non-zero.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2026-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+int main(int argc, const char *argv[])
+{
+  CppApplication app;
+  app.catchUnixSignal(SIGINT);
+  app.catchUnixSignal(SIGTERM);
+  app.catchUnixSignal(SIGUSR1);
+  app.unixSignalCaught.connect(sigc::ptr_fun(&handle_unix_signal));
+
+  parse_arguments(argc, const_cast<const char **>(argv));
+
+  if (max_age < 1)
+  {
+    cerr << "*** ERROR: The maximum age must be at least one second" << endl;
+    exit(1);
+  }
+
+  vector<string> servers;
+  string servers_list((servers_str != 0) ? servers_str
+                                         : "servers.echolink.org");
+  stringstream ss(servers_list);
+  string server;
+  while (getline(ss, server, ','))
+  {
+    if (!server.empty())
+    {
+      servers.push_back(server);
+    }
+  }
+  if (servers.empty())
+  {
+    cerr << "*** ERROR: No directory servers given" << endl;
+    exit(1);
+  }
+
+  IpAddress bind_ip;
+  if (bind_str != 0)
+  {
+    bind_ip = IpAddress(bind_str);
+  }
+
+  cache = new DirectoryCache(servers, (port_str != 0) ? port_str : "5200",
+                             bind_ip);
+  cache->setMaxAge(max_age);
+  cache->listUpdated.connect(sigc::ptr_fun(&on_list_updated));
+  cache->error.connect(sigc::ptr_fun(&on_error));
+
+  app.exec();
+
+  print_stats();
+  delete cache;
+
+  return 0;
+
+} /* main */
+
+
+
+/****************************************************************************
+ *
+ * Functions
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  parse_arguments
+ * Purpose:   Parse the command line arguments.
+ * Input:     argc  - Number of arguments in the command line
+ *    	      argv  - Array of strings with the arguments
+ * Output:    Returns 0 if all is ok, otherwise -1.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2026-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+static void parse_arguments(int argc, const char **argv)
+{
+  poptContext optCon;
+  const struct poptOption optionsTable[] =
+  {
+    POPT_AUTOHELP
+    {"servers", 's', POPT_ARG_STRING, &servers_str, 0,
+            "Comma separated list of EchoLink directory servers "
+            "(default servers.echolink.org)", "<hosts>"},
+    {"port", 'p', POPT_ARG_STRING, &port_str, 0,
+            "The TCP port to listen on (default 5200)", "<port>"},
+    {"bind", 'b', POPT_ARG_STRING, &bind_str, 0,
+            "The IP address to listen on and connect from", "<ip>"},
+    {"max-age", 'a', POPT_ARG_INT, &max_age, 0,
+            "The maximum age of the cached station list in seconds "
+            "(default 60)", "<seconds>"},
+    {"quiet", 'q', POPT_ARG_NONE, &quiet, 0,
+            "Do not print a line for each new station list", NULL},
+    {NULL, 0, 0, NULL, 0}
+  };
+  int err;
+
+  optCon = poptGetContext(PROGRAM_NAME, argc, argv, optionsTable, 0);
+  poptReadDefaultConfig(optCon, 0);
+
+  err = poptGetNextOpt(optCon);
+  if (err != -1)
+  {
+    fprintf(stderr, "\t%s: %s\n",
+	    poptBadOption(optCon, POPT_BADOPTION_NOALIAS),
+	    poptStrerror(err));
+    exit(1);
+  }
+
+  poptFreeContext(optCon);
+
+} /* parse_arguments */
+
+
+static void handle_unix_signal(int signum)
+{
+  switch (signum)
+  {
+    case SIGUSR1:
+      print_stats();
+      break;
+    case SIGINT:
+    case SIGTERM:
+      Application::app().quit();
+      break;
+  }
+} /* handle_unix_signal */
+
+
+static void print_stats(void)
+{
+  const DirectoryCache::Stats& stats = cache->stats();
+  cout << "Generation " << cache->generation() << ", "
+       << cache->stationCount() << " stations. "
+       << stats.fetches << " fetches (" << stats.fetch_errors
+       << " failed), " << stats.full_lists << " full lists and "
+       << stats.deltas << " deltas served, " << stats.logins
+       << " logins relayed" << endl;
+} /* print_stats */
+
+
+static void on_list_updated(unsigned generation)
+{
+  if (!quiet)
+  {
+    cout << "New station list generation " << generation << " with "
+         << cache->stationCount() << " stations" << endl;
+  }
+} /* on_list_updated */
+
+
+static void on_error(const string& msg)
+{
+  cerr << "*** WARNING: " << msg << endl;
+} /* on_error */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -36,6 +36,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cmath>
 #include <cstring>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <cstdio>
 
 
 /****************************************************************************
@@ -120,7 +122,8 @@ using namespace SvxLink;
 AprsTcpClient::AprsTcpClient(LocationInfo::Cfg &loc_cfg,
                             const std::string &server, int port)
   : loc_cfg(loc_cfg), server(server), port(port), con(0), beacon_timer(0),
-    reconnect_timer(0), offset_timer(0), num_connected(0)
+    reconnect_timer(0), offset_timer(0), drain_timer(0), send_buf_full(false),
+    num_connected(0)
 {
    StrList str_list;
 
@@ -133,8 +136,11 @@ AprsTcpClient::AprsTcpClient(LocationInfo::Cfg &loc_cfg,
    con->connected.connect(mem_fun(*this, &AprsTcpClient::tcpConnected));
    con->disconnected.connect(mem_fun(*this, &AprsTcpClient::tcpDisconnected));
    con->dataReceived.connect(mem_fun(*this, &AprsTcpClient::tcpDataReceived));
+   con->sendBufferFull.connect(mem_fun(*this, &AprsTcpClient::onSendBufferFull));
    con->connect();
 
+   buildStaticStrings();
+
    beacon_timer = new Timer(loc_cfg.interval, Timer::TYPE_PERIODIC);
    beacon_timer->setEnable(false);
    beacon_timer->expired.connect(mem_fun(*this, &AprsTcpClient::sendAprsBeacon));
@@ -148,6 +154,10 @@ AprsTcpClient::AprsTcpClient(LocationInfo::Cfg &loc_cfg,
    reconnect_timer->setEnable(false);
    reconnect_timer->expired.connect(mem_fun(*this,
                  &AprsTcpClient::reconnectAprsServer));
+
+   drain_timer = new Timer(0);
+   drain_timer->setEnable(false);
+   drain_timer->expired.connect(mem_fun(*this, &AprsTcpClient::drainQueue));
 } /* AprsTcpClient::AprsTcpClient */
 
 
@@ -157,6 +167,7 @@ AprsTcpClient::~AprsTcpClient(void)
    delete reconnect_timer;
    delete offset_timer;
    delete beacon_timer;
+   delete drain_timer;
 } /* AprsTcpClient::~AprsTcpClient */
 
 
@@ -182,16 +193,8 @@ void AprsTcpClient::updateQsoStatus(int action, const string& call,
   // Format for "object from..."
   // DL1HRC>;EL-242660*111111z4900.05NE00823.29E0434.687MHz T123 R10k   DA0AAA
 
-    // Geographic position
-  char pos[128];
-  posStr(pos);
-
     // APRS message
-  char aprsmsg[256];
-  sprintf(aprsmsg, "%s>%s,%s:;%s%-6.6s*111111z%s%s\r\n",
-          el_call.c_str(), destination.c_str(), loc_cfg.path.c_str(),
-          el_prefix.c_str(), el_call.c_str(), pos, msg);
-  sendMsg(aprsmsg);
+  sendMsg(obj_head + posStr() + msg + "\r\n");
 
   // APRS status message, connected calls
   string status = el_prefix + el_call+">"+destination+","+loc_cfg.path+":>";
@@ -202,7 +205,7 @@ void AprsTcpClient::updateQsoStatus(int action, const string& call,
     status += *it + " ";
   }
   status += "\r\n";
-  sendMsg(status.c_str());
+  sendMsg(status);
 
 } /* AprsTcpClient::updateQsoStatus */
 
@@ -210,15 +213,13 @@ void AprsTcpClient::updateQsoStatus(int action, const string& call,
 // updates state of a 3rd party
 void AprsTcpClient::update3rdState(const string& call, const string& info)
 {
-   char aprsmsg[20 + info.length()];
-   sprintf(aprsmsg, "%s>%s\n\r", call.c_str(), info.c_str());
-   sendMsg(aprsmsg);
+   sendMsg(call + ">" + info + "\n\r");
 } /* AprsTcpClient::update3rdState */
 
 
 void AprsTcpClient::igateMessage(const string& info)
 {
-  sendMsg(info.c_str());
+  sendMsg(info);
 } /* AprsTcpClient::igateMessage */
 
 
@@ -237,7 +238,36 @@ void AprsTcpClient::igateMessage(const string& info)
  *
  ****************************************************************************/
 
-void AprsTcpClient::posStr(char *pos)
+void AprsTcpClient::buildStaticStrings(void)
+{
+    // Everything except the number of connected stations overlay is static
+    // so it is formatted once instead of for each message
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%-6.6s", el_call.c_str());
+  obj_head = el_call + ">" + destination + "," + loc_cfg.path + ":;" +
+             el_prefix + buf + "*111111z";
+
+  snprintf(buf, sizeof(buf), "%02d%02d.%02d%c",
+           loc_cfg.lat_pos.deg, loc_cfg.lat_pos.min,
+           (loc_cfg.lat_pos.sec * 100) / 60, loc_cfg.lat_pos.dir);
+  lat_str = buf;
+  snprintf(buf, sizeof(buf), "%03d%02d.%02d%c0",
+           loc_cfg.lon_pos.deg, loc_cfg.lon_pos.min,
+           (loc_cfg.lon_pos.sec * 100) / 60, loc_cfg.lon_pos.dir);
+  lon_str = buf;
+
+    // CTCSS/1750Hz tone
+  char tone[16];
+  snprintf(tone, sizeof(tone), (loc_cfg.tone < 1000) ? "T%03d" : "%04d",
+           loc_cfg.tone);
+  snprintf(buf, sizeof(buf), "%03d.%03dMHz %s R%02d%c ",
+           loc_cfg.frequency / 1000, loc_cfg.frequency % 1000, tone,
+           loc_cfg.range, loc_cfg.range_unit);
+  beacon_tail = string(buf) + loc_cfg.comment + "\r\n";
+} /* AprsTcpClient::buildStaticStrings */
+
+
+string AprsTcpClient::posStr(void) const
 {
   char num_connected_overlay;
   if (num_connected > 0)
@@ -248,40 +278,17 @@ void AprsTcpClient::posStr(char *pos)
   {
     num_connected_overlay = 'E';
   }
-  sprintf(pos, "%02d%02d.%02d%c%c%03d%02d.%02d%c0",
-               loc_cfg.lat_pos.deg, loc_cfg.lat_pos.min,
-               (loc_cfg.lat_pos.sec * 100) / 60, loc_cfg.lat_pos.dir,
-               num_connected_overlay,
-               loc_cfg.lon_pos.deg, loc_cfg.lon_pos.min,
-               (loc_cfg.lon_pos.sec * 100) / 60, loc_cfg.lon_pos.dir);
-}
+  return lat_str + num_connected_overlay + lon_str;
+} /* AprsTcpClient::posStr */
 
 
 void AprsTcpClient::sendAprsBeacon(Timer *t)
 {
-    // Geographic position
-  char pos[128];
-  posStr(pos);
-
-    // CTCSS/1750Hz tone
-  char tone[5];
-  sprintf(tone, (loc_cfg.tone < 1000) ? "T%03d" : "%04d", loc_cfg.tone);
-
-    // APRS message
-  char aprsmsg[150 + loc_cfg.comment.length()];
-  sprintf(aprsmsg, "%s>%s,%s:;%s%-6.6s*111111z%s%03d.%03dMHz %s R%02d%c %s\r\n",
-            el_call.c_str(), destination.c_str(), loc_cfg.path.c_str(),
-            el_prefix.c_str(), el_call.c_str(), pos, loc_cfg.frequency / 1000,
-            loc_cfg.frequency % 1000, tone, loc_cfg.range,
-            loc_cfg.range_unit, loc_cfg.comment.c_str());
-  //cout << aprsmsg;
-
-  sendMsg(aprsmsg);
-
+  sendMsg(obj_head + posStr() + beacon_tail);
 } /* AprsTcpClient::sendAprsBeacon*/
 
 
-void AprsTcpClient::sendMsg(const char *aprsmsg)
+void AprsTcpClient::sendMsg(const string& aprsmsg)
 {
    //cout << aprsmsg << endl;
 
@@ -290,17 +297,82 @@ void AprsTcpClient::sendMsg(const char *aprsmsg)
     return;
   }
 
-  int written = con->write(aprsmsg, strlen(aprsmsg));
+  if (tx_queue.size() >= MAX_QUEUE_SIZE)
+  {
+    cerr << "*** WARNING: APRS transmit queue full. Message dropped." << endl;
+    return;
+  }
+  tx_queue.push_back(aprsmsg);
+
+    // Drain from the main loop so that messages created at the same time
+    // are written together
+  if (!drain_timer->isEnabled() && !send_buf_full)
+  {
+    drain_timer->setTimeout(0);
+    drain_timer->setEnable(true);
+  }
+} /* AprsTcpClient::sendMsg */
+
+
+void AprsTcpClient::drainQueue(Async::Timer *t)
+{
+  drain_timer->setEnable(false);
+  if (!con->isConnected() || send_buf_full || tx_queue.empty())
+  {
+    return;
+  }
+
+  struct iovec iov[16];
+  int iovcnt = 0;
+  size_t count = 0;
+  for (MsgQueue::const_iterator it = tx_queue.begin();
+       (it != tx_queue.end()) && (iovcnt < 16) &&
+         ((iovcnt == 0) || (count + it->size() <= MAX_DRAIN_BYTES));
+       ++it)
+  {
+    iov[iovcnt].iov_base = const_cast<char*>(it->data());
+    iov[iovcnt].iov_len = it->size();
+    count += it->size();
+    ++iovcnt;
+  }
+
+  int written = con->write(iov, iovcnt);
   if (written < 0)
   {
     cerr << "*** ERROR: TCP write error" << endl;
+    tx_queue.clear();
+    return;
   }
-  else if ((size_t)written != strlen(aprsmsg))
+
+    // Remove what was written. A partially written message is kept so that
+    // the rest is sent when the socket becomes writable again.
+  size_t left = written;
+  while (!tx_queue.empty() && (left >= tx_queue.front().size()))
   {
-    cerr << "*** ERROR: TCP transmit buffer overflow, reconnecting." << endl;
-    con->disconnect();
+    left -= tx_queue.front().size();
+    tx_queue.pop_front();
+  }
+  if (left > 0)
+  {
+    tx_queue.front().erase(0, left);
   }
-} /* AprsTcpClient::sendMsg */
+
+  if (!tx_queue.empty() && !send_buf_full)
+  {
+    drain_timer->setTimeout(DRAIN_INTERVAL_MS);
+    drain_timer->setEnable(true);
+  }
+} /* AprsTcpClient::drainQueue */
+
+
+void AprsTcpClient::onSendBufferFull(bool is_full)
+{
+  send_buf_full = is_full;
+  if (!is_full)
+  {
+    drainQueue();
+  }
+} /* AprsTcpClient::onSendBufferFull */
 
 
 
@@ -309,8 +381,8 @@ void AprsTcpClient::aprsLogin(void)
    char loginmsg[150];
    const char *format = "user %s pass %d vers SvxLink %s filter m/10\n";
 
-   sprintf(loginmsg, format, el_call.c_str(), getPasswd(el_call),
-           SVXLINK_VERSION);
+   snprintf(loginmsg, sizeof(loginmsg), format, el_call.c_str(),
+            getPasswd(el_call), SVXLINK_VERSION);
    //cout << loginmsg;
    sendMsg(loginmsg);
 
@@ -374,6 +446,10 @@ void AprsTcpClient::tcpDisconnected(TcpClient<>::TcpConnection *con,
 {
   cout << "*** WARNING: Disconnected from APRS server" << endl;
 
+  tx_queue.clear();
+  send_buf_full = false;
+  drain_timer->setEnable(false);
+
   beacon_timer->setEnable(false);		// no beacon while disconnected
   reconnect_timer->setEnable(true);		// start the reconnect-timer
   offset_timer->setEnable(false);
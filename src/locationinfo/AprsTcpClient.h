@@ -37,6 +37,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <string>
 #include <vector>
+#include <deque>
 
 
 /****************************************************************************
@@ -112,6 +113,12 @@ namespace Async
 @brief	Aprs-logics
 @author Adi Bier / DL1HRC
 @date   2008-11-01
+
+Messages are not written directly to the APRS server. They are put in a queue
+that is drained from the main loop, so that all messages generated at the
+same time, e.g. the statistics for all logics, are written using one system
+call. Each drain is limited in size and the rest of the queue is sent after
+a short delay so that a burst of messages is spread out over time.
 */
 class AprsTcpClient : public AprsClient, public sigc::trackable
 {
@@ -129,6 +136,11 @@ class AprsTcpClient : public AprsClient, public sigc::trackable
 
   private:
     typedef std::vector<std::string> StrList;
+    typedef std::deque<std::string>  MsgQueue;
+
+    static const size_t   MAX_QUEUE_SIZE    = 100;
+    static const size_t   MAX_DRAIN_BYTES   = 2048;
+    static const int      DRAIN_INTERVAL_MS = 1000;
 
     LocationInfo::Cfg   &loc_cfg;
     std::string		server;
@@ -137,15 +149,25 @@ class AprsTcpClient : public AprsClient, public sigc::trackable
     Async::Timer        *beacon_timer;
     Async::Timer        *reconnect_timer;
     Async::Timer        *offset_timer;
+    Async::Timer        *drain_timer;
+    MsgQueue            tx_queue;
+    bool                send_buf_full;
 
     int			num_connected;
 
     std::string		el_call;
     std::string		el_prefix;
     std::string		destination;
-
-    void  sendMsg(const char *aprsmsg);
-    void  posStr(char *pos);
+    std::string         obj_head;
+    std::string         lat_str;
+    std::string         lon_str;
+    std::string         beacon_tail;
+
+    void  sendMsg(const std::string& aprsmsg);
+    void  drainQueue(Async::Timer *t=0);
+    void  onSendBufferFull(bool is_full);
+    void  buildStaticStrings(void);
+    std::string posStr(void) const;
     void  sendAprsBeacon(Async::Timer *t);
 
     void  tcpConnected(void);
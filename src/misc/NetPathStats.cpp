@@ -0,0 +1,262 @@
+/**
+@file   NetPathStats.cpp
+@brief  Network path statistics for a stream of datagrams
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that keep track of round trip time, jitter, packet
+loss and jitter buffer fill for a network stream.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+#include <cstdlib>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "NetPathStats.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace SvxLink;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+uint32_t NetPathStats::timestampMs(void)
+{
+  return static_cast<uint32_t>(nowUs() / 1000);
+} /* NetPathStats::timestampMs */
+
+
+NetPathStats::NetPathStats(void)
+{
+  reset();
+} /* NetPathStats::NetPathStats */
+
+
+void NetPathStats::reset(void)
+{
+  m_rx_packets = 0;
+  m_lost_packets = 0;
+  m_late_packets = 0;
+  m_last_arrival = 0;
+  m_interval = 0.0;
+  m_jitter = 0.0;
+  m_rtt_cnt = 0;
+  m_rtt_last = 0;
+  m_rtt_min = 0;
+  m_rtt_max = 0;
+  m_rtt_avg = 0.0;
+  m_jb_underruns = 0;
+  resetJitterBufferFill();
+} /* NetPathStats::reset */
+
+
+void NetPathStats::packetReceived(int16_t seq_diff)
+{
+  if (seq_diff < 0)
+  {
+    m_late_packets += 1;
+  }
+  else
+  {
+    m_lost_packets += seq_diff;
+  }
+  m_rx_packets += 1;
+} /* NetPathStats::packetReceived */
+
+
+void NetPathStats::packetArrived(void)
+{
+  int64_t now = nowUs();
+  int64_t diff = now - m_last_arrival;
+  if ((m_last_arrival != 0) && (diff < 1000 * RESYNC_GAP))
+  {
+    if (m_interval == 0.0)
+    {
+      m_interval = diff;
+    }
+    else
+    {
+      m_interval += (diff - m_interval) / 16.0;
+    }
+    double d = diff - m_interval;
+    m_jitter += ((d < 0.0 ? -d : d) - m_jitter) / 16.0;
+  }
+  m_last_arrival = now;
+} /* NetPathStats::packetArrived */
+
+
+void NetPathStats::pongReceived(uint32_t timestamp)
+{
+  uint32_t rtt = timestampMs() - timestamp;
+  if (rtt > 1000 * 60)
+  {
+    return;
+  }
+  m_rtt_last = rtt;
+  if ((m_rtt_cnt == 0) || (rtt < m_rtt_min))
+  {
+    m_rtt_min = rtt;
+  }
+  if (rtt > m_rtt_max)
+  {
+    m_rtt_max = rtt;
+  }
+  if (m_rtt_cnt == 0)
+  {
+    m_rtt_avg = rtt;
+  }
+  else
+  {
+    m_rtt_avg += (rtt - m_rtt_avg) / 8.0;
+  }
+  m_rtt_cnt += 1;
+} /* NetPathStats::pongReceived */
+
+
+void NetPathStats::jitterBufferFill(unsigned fill_ms)
+{
+  if ((m_jb_fill_cnt == 0) || (fill_ms < m_jb_fill_min))
+  {
+    m_jb_fill_min = fill_ms;
+  }
+  if (fill_ms > m_jb_fill_max)
+  {
+    m_jb_fill_max = fill_ms;
+  }
+  if (m_jb_fill_cnt == 0)
+  {
+    m_jb_fill_avg = fill_ms;
+  }
+  else
+  {
+    m_jb_fill_avg += (fill_ms - m_jb_fill_avg) / 16.0;
+  }
+  m_jb_fill_cnt += 1;
+} /* NetPathStats::jitterBufferFill */
+
+
+void NetPathStats::resetJitterBufferFill(void)
+{
+  m_jb_fill_cnt = 0;
+  m_jb_fill_min = 0;
+  m_jb_fill_max = 0;
+  m_jb_fill_avg = 0.0;
+} /* NetPathStats::resetJitterBufferFill */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+int64_t NetPathStats::nowUs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+} /* NetPathStats::nowUs */
+
+
+/*
+ * This file has not been truncated
+ */
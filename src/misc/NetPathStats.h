@@ -0,0 +1,243 @@
+/**
+@file   NetPathStats.h
+@brief  Network path statistics for a stream of datagrams
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that keep track of round trip time, jitter, packet
+loss and jitter buffer fill for a network stream.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef NET_PATH_STATS_INCLUDED
+#define NET_PATH_STATS_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+namespace SvxLink
+{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Network path statistics for a stream of datagrams
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class collect statistics for a network path over which sequence
+numbered datagrams are received. The owner feed it with the events it see and
+read the statistics back when it want to report them.
+
+The inter-arrival jitter is calculated in the same way as in RFC 3550, using
+a smoothing factor of 1/16. The network protocols do not carry sender
+timestamps so the smoothed packet interval is used as the nominal interval
+instead. A pause longer than RESYNC_GAP starts a new measurement since packets
+are not sent continuously.
+
+Round trip time is measured using ping datagrams carrying a timestamp from
+the timestampMs function that the other side echo back.
+*/
+class NetPathStats
+{
+  public:
+    /**
+     * @brief   A pause longer than this (ms) restart the jitter calculation
+     */
+    static const unsigned RESYNC_GAP = 500;
+
+    /**
+     * @brief   Get a timestamp to put into a ping datagram
+     * @return  Returns a monotonic timestamp in milliseconds
+     */
+    static uint32_t timestampMs(void);
+
+    /**
+     * @brief 	Default constructor
+     */
+    NetPathStats(void);
+
+    /**
+     * @brief   Reset all statistics
+     */
+    void reset(void);
+
+    /**
+     * @brief   Register a received datagram
+     * @param   seq_diff The received minus the expected sequence number
+     *
+     * A positive difference mean that datagrams were lost while a negative
+     * difference mean that a late or duplicated datagram was received.
+     */
+    void packetReceived(int16_t seq_diff);
+
+    /**
+     * @brief   Register the arrival of a packet used for jitter calculation
+     *
+     * Call this function for each received audio packet.
+     */
+    void packetArrived(void);
+
+    /**
+     * @brief   Restart the jitter calculation
+     *
+     * Call this function at the end of an audio stream.
+     */
+    void resetJitterReference(void) { m_last_arrival = 0; }
+
+    /**
+     * @brief   Register the echo of a ping
+     * @param   timestamp The timestamp from the ping, set by timestampMs
+     */
+    void pongReceived(uint32_t timestamp);
+
+    /**
+     * @brief   Register the fill level of the jitter buffer
+     * @param   fill_ms The number of milliseconds of audio in the buffer
+     */
+    void jitterBufferFill(unsigned fill_ms);
+
+    /**
+     * @brief   Register that the jitter buffer ran empty
+     */
+    void jitterBufferUnderrun(void) { m_jb_underruns += 1; }
+
+    /**
+     * @brief   Reset the jitter buffer minimum and maximum fill level
+     *
+     * Call this function after reporting the statistics to get the levels
+     * for each reporting interval.
+     */
+    void resetJitterBufferFill(void);
+
+    uint64_t rxPackets(void) const { return m_rx_packets; }
+    uint64_t lostPackets(void) const { return m_lost_packets; }
+    uint64_t latePackets(void) const { return m_late_packets; }
+    double jitterMs(void) const { return m_jitter / 1000.0; }
+    bool hasRtt(void) const { return m_rtt_cnt > 0; }
+    unsigned rttMs(void) const { return m_rtt_last; }
+    unsigned rttMinMs(void) const { return m_rtt_min; }
+    unsigned rttMaxMs(void) const { return m_rtt_max; }
+    double rttAvgMs(void) const { return m_rtt_avg; }
+    bool hasJitterBufferFill(void) const { return m_jb_fill_cnt > 0; }
+    unsigned jitterBufferMinMs(void) const { return m_jb_fill_min; }
+    unsigned jitterBufferMaxMs(void) const { return m_jb_fill_max; }
+    double jitterBufferAvgMs(void) const { return m_jb_fill_avg; }
+    uint64_t jitterBufferUnderruns(void) const { return m_jb_underruns; }
+
+  private:
+    uint64_t  m_rx_packets;
+    uint64_t  m_lost_packets;
+    uint64_t  m_late_packets;
+    int64_t   m_last_arrival;
+    double    m_interval;
+    double    m_jitter;
+    uint64_t  m_rtt_cnt;
+    unsigned  m_rtt_last;
+    unsigned  m_rtt_min;
+    unsigned  m_rtt_max;
+    double    m_rtt_avg;
+    uint64_t  m_jb_fill_cnt;
+    unsigned  m_jb_fill_min;
+    unsigned  m_jb_fill_max;
+    double    m_jb_fill_avg;
+    uint64_t  m_jb_underruns;
+
+    static int64_t nowUs(void);
+
+};  /* class NetPathStats */
+
+
+} /* namespace */
+
+#endif /* NET_PATH_STATS_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
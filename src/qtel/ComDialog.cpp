@@ -68,6 +68,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioSplitter.h>
 #include <AsyncAudioInterpolator.h>
 #include <AsyncAudioDecimator.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -315,9 +316,7 @@ void ComDialog::init(const QString& remote_name)
   prev_src->registerSink(rem_audio_valve);
   prev_src = rem_audio_valve;
 
-#if (INTERNAL_SAMPLE_RATE == 8000)  
-  if (spkr_audio_io->sampleRate() > 8000)
-#endif
+  if ((INTERNAL_SAMPLE_RATE != 8000) || (spkr_audio_io->sampleRate() > 8000))
   {
       // Interpolate sample rate to 16kHz
     AudioInterpolator *i1 = new AudioInterpolator(2, coeff_16_8,
@@ -329,13 +328,15 @@ void ComDialog::init(const QString& remote_name)
   if (spkr_audio_io->sampleRate() > 16000)
   {
       // Interpolate sample rate to 48kHz
-#if (INTERNAL_SAMPLE_RATE == 8000)
-    AudioInterpolator *i2 = new AudioInterpolator(3, coeff_48_16_int,
-                                                  coeff_48_16_int_taps);
-#else
-    AudioInterpolator *i2 = new AudioInterpolator(3, coeff_48_16,
-                                                  coeff_48_16_taps);
-#endif
+    AudioInterpolator *i2 = 0;
+    if (INTERNAL_SAMPLE_RATE == 8000)
+    {
+      i2 = new AudioInterpolator(3, coeff_48_16_int, coeff_48_16_int_taps);
+    }
+    else
+    {
+      i2 = new AudioInterpolator(3, coeff_48_16, coeff_48_16_taps);
+    }
     prev_src->registerSink(i2, true);
     prev_src = i2;
   }
@@ -361,16 +362,14 @@ void ComDialog::init(const QString& remote_name)
     prev_src = d1;
   }
 
-#if (INTERNAL_SAMPLE_RATE < 16000)
     // If the sound card sample rate is higher than 8kHz (16 or 48kHz assumed)
     // decimate it down to 8kHz.
-  if (mic_audio_io->sampleRate() > 8000)
+  if ((INTERNAL_SAMPLE_RATE < 16000) && (mic_audio_io->sampleRate() > 8000))
   {
     AudioDecimator *d2 = new AudioDecimator(2, coeff_16_8, coeff_16_8_taps);
     prev_src->registerSink(d2, true);
     prev_src = d2;
   }
-#endif
 
   tx_audio_splitter = new AudioSplitter;
   prev_src->registerSink(tx_audio_splitter);
@@ -398,16 +397,18 @@ void ComDialog::init(const QString& remote_name)
   vox_threshold->setValue(vox->threshold());
   vox_delay->setValue(vox->delay());
   
-#if INTERNAL_SAMPLE_RATE == 16000
-  AudioDecimator *down_sampler = new AudioDecimator(
-          2, coeff_16_8, coeff_16_8_taps);
-  tx_audio_splitter->addSink(down_sampler, true);
-  ptt_valve = new AudioValve;
-  down_sampler->registerSink(ptt_valve);
-#else
   ptt_valve = new AudioValve;
-  tx_audio_splitter->addSink(ptt_valve);
-#endif
+  if (INTERNAL_SAMPLE_RATE == 16000)
+  {
+    AudioDecimator *down_sampler = new AudioDecimator(
+            2, coeff_16_8, coeff_16_8_taps);
+    tx_audio_splitter->addSink(down_sampler, true);
+    down_sampler->registerSink(ptt_valve);
+  }
+  else
+  {
+    tx_audio_splitter->addSink(ptt_valve);
+  }
   
   if (settings->useFullDuplex())
   {
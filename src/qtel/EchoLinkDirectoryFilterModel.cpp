@@ -0,0 +1,178 @@
+/**
+@file   EchoLinkDirectoryFilterModel.cpp
+@brief  A sort and filter proxy for the EchoLink directory model
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Qtel - The Qt EchoLink client
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "EchoLinkDirectoryModel.h"
+#include "EchoLinkDirectoryFilterModel.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+EchoLinkDirectoryFilterModel::EchoLinkDirectoryFilterModel(QObject *parent)
+  : QSortFilterProxyModel(parent), dir_model(0)
+{
+  setDynamicSortFilter(true);
+} /* EchoLinkDirectoryFilterModel::EchoLinkDirectoryFilterModel */
+
+
+EchoLinkDirectoryFilterModel::~EchoLinkDirectoryFilterModel(void)
+{
+  
+} /* EchoLinkDirectoryFilterModel::~EchoLinkDirectoryFilterModel */
+
+
+void EchoLinkDirectoryFilterModel::setDirectoryModel(
+                                              EchoLinkDirectoryModel *model)
+{
+  dir_model = model;
+  setSourceModel(model);
+} /* EchoLinkDirectoryFilterModel::setDirectoryModel */
+
+
+void EchoLinkDirectoryFilterModel::setFilterText(const QString &text)
+{
+  QString new_filter = text.trimmed().toLower();
+  if (new_filter != filter)
+  {
+    filter = new_filter;
+    invalidateFilter();
+  }
+} /* EchoLinkDirectoryFilterModel::setFilterText */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+bool EchoLinkDirectoryFilterModel::lessThan(const QModelIndex &left,
+                                            const QModelIndex &right) const
+{
+  if (dir_model == 0)
+  {
+    return QSortFilterProxyModel::lessThan(left, right);
+  }
+  return dir_model->lessThan(left.row(), right.row(), left.column());
+} /* EchoLinkDirectoryFilterModel::lessThan */
+
+
+bool EchoLinkDirectoryFilterModel::filterAcceptsRow(int source_row,
+                                    const QModelIndex &source_parent) const
+{
+  if (filter.isEmpty() || (dir_model == 0))
+  {
+    return true;
+  }
+  return dir_model->matches(source_row, filter);
+} /* EchoLinkDirectoryFilterModel::filterAcceptsRow */
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,152 @@
+/**
+@file   EchoLinkDirectoryFilterModel.h
+@brief  A sort and filter proxy for the EchoLink directory model
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+Qtel - The Qt EchoLink client
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ECHO_LINK_DIRECTORY_FILTER_MODEL_INCLUDED
+#define ECHO_LINK_DIRECTORY_FILTER_MODEL_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <QSortFilterProxyModel>
+#include <QString>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+class EchoLinkDirectoryModel;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A sort and filter proxy for the EchoLink directory model
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This proxy model sorts and filters the rows of an EchoLinkDirectoryModel. The
+comparisons use sort keys that are precomputed by the directory model when a
+station is added or updated, so no strings have to be created while sorting.
+Since the directory model is updated incrementally, the view selection is kept
+when the station list is refreshed.
+*/
+class EchoLinkDirectoryFilterModel : public QSortFilterProxyModel
+{
+  Q_OBJECT
+    
+  public:
+    /**
+     * @brief 	Default constuctor
+     */
+    EchoLinkDirectoryFilterModel(QObject *parent = 0);
+  
+    /**
+     * @brief 	Destructor
+     */
+    ~EchoLinkDirectoryFilterModel(void);
+  
+    /**
+     * @brief 	Set the directory model to sort and filter
+     * @param 	model The source model
+     */
+    void setDirectoryModel(EchoLinkDirectoryModel *model);
+    
+  public slots:
+    /**
+     * @brief 	Set the filter text
+     * @param 	text Only show stations with a callsign or description
+     *		that contains this text
+     *
+     * The filter is case insensitive. An empty string shows all stations.
+     */
+    void setFilterText(const QString &text);
+    
+  protected:
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const;
+    bool filterAcceptsRow(int source_row,
+                          const QModelIndex &source_parent) const;
+    
+  private:
+    EchoLinkDirectoryModel  *dir_model;
+    QString                 filter;
+    
+    EchoLinkDirectoryFilterModel(const EchoLinkDirectoryFilterModel&);
+    EchoLinkDirectoryFilterModel& operator=(
+                                        const EchoLinkDirectoryFilterModel&);
+    
+};  /* class EchoLinkDirectoryFilterModel */
+
+
+#endif /* ECHO_LINK_DIRECTORY_FILTER_MODEL_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <algorithm>
 #include <iostream>
+#include <arpa/inet.h>
 
 #include <QtAlgorithms>
 
@@ -142,48 +143,17 @@ void EchoLinkDirectoryModel::updateStationList(
   while (!updated_stations.isEmpty() && (row < stations.count()))
   {
     const StationData &updated_stn = updated_stations.first();
-    StationData &stn = stations[row];
+    const StationData &stn = stations.at(row);
     if (updated_stn.callsign() == stn.callsign())
     {
-      if (updated_stn.description() != stn.description())
-      {
-	QModelIndex stn_index = index(row, 1);
-	stn.setDescription(updated_stn.description());
-	dataChanged(stn_index, stn_index);
-      }
-      if (updated_stn.status() != stn.status())
-      {
-	QModelIndex stn_index = index(row, 2);
-	stn.setStatus(updated_stn.status());
-	dataChanged(stn_index, stn_index);
-      }
-      if (updated_stn.time() != stn.time())
-      {
-	QModelIndex stn_index = index(row, 3);
-	stn.setTime(updated_stn.time());
-	dataChanged(stn_index, stn_index);
-      }
-      if (updated_stn.id() != stn.id())
-      {
-	QModelIndex stn_index = index(row, 4);
-	stn.setId(updated_stn.id());
-	dataChanged(stn_index, stn_index);
-      }
-      if (updated_stn.ip() != stn.ip())
-      {
-	QModelIndex stn_index = index(row, 5);
-	stn.setIp(updated_stn.ip());
-	dataChanged(stn_index, stn_index);
-      }
+      updateRow(row, updated_stn);
       row += 1;
       updated_stations.removeFirst();
     }
     else if (updated_stn.callsign() < stn.callsign())
     {
       //cout << "### Inserting 1 row starting at row " << row << endl;
-      beginInsertRows(QModelIndex(), row, row);
-      stations.insert(row, updated_stn);
-      endInsertRows();
+      insertStation(row, updated_stn);
       row += 1;
       updated_stations.removeFirst();
     }
@@ -202,6 +172,11 @@ void EchoLinkDirectoryModel::updateStationList(
     //stations.append(updated_stations);
     copy(updated_stations.begin(), updated_stations.end(),
          back_inserter(stations));
+    QList<StationData>::const_iterator it;
+    for (it=updated_stations.begin(); it!=updated_stations.end(); ++it)
+    {
+      sort_keys.append(sortKey(*it));
+    }
     endInsertRows();
   }
   else if (row < stations.count())
@@ -214,6 +189,37 @@ void EchoLinkDirectoryModel::updateStationList(
 } /* EchoLinkDirectoryModel::updateStationList */
 
 
+void EchoLinkDirectoryModel::updateStations(
+                                    const vector<StationData> &updated,
+                                    const vector<StationData> &removed)
+{
+  vector<StationData>::const_iterator it;
+  for (it = removed.begin(); it != removed.end(); ++it)
+  {
+    int row = findRow(*it);
+    if ((row < stations.count()) &&
+        (stations.at(row).callsign() == it->callsign()))
+    {
+      removeRows(row, 1);
+    }
+  }
+
+  for (it = updated.begin(); it != updated.end(); ++it)
+  {
+    int row = findRow(*it);
+    if ((row < stations.count()) &&
+        (stations.at(row).callsign() == it->callsign()))
+    {
+      updateRow(row, *it);
+    }
+    else
+    {
+      insertStation(row, *it);
+    }
+  }
+} /* EchoLinkDirectoryModel::updateStations */
+
+
 QModelIndex EchoLinkDirectoryModel::index(int row, int column,
 					  const QModelIndex &parent) const
 {
@@ -336,12 +342,45 @@ bool EchoLinkDirectoryModel::removeRows(int row, int count,
   beginRemoveRows(QModelIndex(), row, row+count-1);
   QList<StationData>::iterator begin(stations.begin()+row);
   stations.erase(begin, begin+count);
+  QList<SortKey>::iterator key_begin(sort_keys.begin()+row);
+  sort_keys.erase(key_begin, key_begin+count);
   endRemoveRows();
   
   return true;
 } /* EchoLinkDirectoryModel::removeRows */
 
 
+bool EchoLinkDirectoryModel::lessThan(int left_row, int right_row,
+                                      int column) const
+{
+  const SortKey &left = sort_keys.at(left_row);
+  const SortKey &right = sort_keys.at(right_row);
+  switch (column)
+  {
+    case 1:
+      return left.description < right.description;
+    case 2:
+      return left.status < right.status;
+    case 3:
+      return left.time < right.time;
+    case 4:
+      return left.id < right.id;
+    case 5:
+      return left.ip < right.ip;
+    default:
+        // The station list is kept sorted on callsign
+      return left_row < right_row;
+  }
+} /* EchoLinkDirectoryModel::lessThan */
+
+
+bool EchoLinkDirectoryModel::matches(int row, const QString &filter) const
+{
+  const SortKey &key = sort_keys.at(row);
+  return key.callsign.contains(filter) || key.description.contains(filter);
+} /* EchoLinkDirectoryModel::matches */
+
+
 /****************************************************************************
  *
  * Protected member functions
@@ -356,6 +395,72 @@ bool EchoLinkDirectoryModel::removeRows(int row, int count,
  *
  ****************************************************************************/
 
+int EchoLinkDirectoryModel::findRow(const StationData &stn) const
+{
+  return qLowerBound(stations.begin(), stations.end(), stn) -
+         stations.begin();
+} /* EchoLinkDirectoryModel::findRow */
+
+
+void EchoLinkDirectoryModel::updateRow(int row, const StationData &updated_stn)
+{
+  StationData &stn = stations[row];
+  if (updated_stn.description() != stn.description())
+  {
+    QModelIndex stn_index = index(row, 1);
+    stn.setDescription(updated_stn.description());
+    dataChanged(stn_index, stn_index);
+  }
+  if (updated_stn.status() != stn.status())
+  {
+    QModelIndex stn_index = index(row, 2);
+    stn.setStatus(updated_stn.status());
+    dataChanged(stn_index, stn_index);
+  }
+  if (updated_stn.time() != stn.time())
+  {
+    QModelIndex stn_index = index(row, 3);
+    stn.setTime(updated_stn.time());
+    dataChanged(stn_index, stn_index);
+  }
+  if (updated_stn.id() != stn.id())
+  {
+    QModelIndex stn_index = index(row, 4);
+    stn.setId(updated_stn.id());
+    dataChanged(stn_index, stn_index);
+  }
+  if (updated_stn.ip() != stn.ip())
+  {
+    QModelIndex stn_index = index(row, 5);
+    stn.setIp(updated_stn.ip());
+    dataChanged(stn_index, stn_index);
+  }
+  sort_keys[row] = sortKey(stn);
+} /* EchoLinkDirectoryModel::updateRow */
+
+
+void EchoLinkDirectoryModel::insertStation(int row, const StationData &stn)
+{
+  beginInsertRows(QModelIndex(), row, row);
+  stations.insert(row, stn);
+  sort_keys.insert(row, sortKey(stn));
+  endInsertRows();
+} /* EchoLinkDirectoryModel::insertStation */
+
+
+EchoLinkDirectoryModel::SortKey EchoLinkDirectoryModel::sortKey(
+                                                      const StationData &stn)
+{
+  SortKey key;
+  key.callsign = QString::fromStdString(stn.callsign()).toLower();
+  key.description = QString::fromStdString(stn.description()).toLower();
+  key.time = QString::fromStdString(stn.time());
+  key.status = stn.status();
+  key.id = stn.id();
+  key.ip = ntohl(stn.ip().ip4Addr().s_addr);
+  return key;
+} /* EchoLinkDirectoryModel::sortKey */
+
 
 
 /*
@@ -42,8 +42,12 @@ An example of how to use the EchoLinkDirectoryModel class
  ****************************************************************************/
 
 #include <QList>
+#include <QString>
 #include <QAbstractItemModel>
 
+#include <vector>
+#include <list>
+
 
 /****************************************************************************
  *
@@ -140,6 +144,17 @@ class EchoLinkDirectoryModel : public QAbstractItemModel
      * @return	Return_value_of_this_member_function
      */
     void updateStationList(const std::list<EchoLink::StationData> &stn_list);
+
+    /**
+     * @brief 	Apply a partial update to the station list
+     * @param 	updated Stations to add or to update if already present
+     * @param 	removed Stations to remove
+     *
+     * Unlike updateStationList, only the given stations are touched so this
+     * is cheap when just a few entries have changed.
+     */
+    void updateStations(const std::vector<EchoLink::StationData> &updated,
+                        const std::vector<EchoLink::StationData> &removed);
     
     QModelIndex index(int row, int column,
 			      const QModelIndex &parent = QModelIndex()) const;
@@ -155,13 +170,47 @@ class EchoLinkDirectoryModel : public QAbstractItemModel
     bool removeRows(int row, int count,
 		    const QModelIndex &parent = QModelIndex());
 
+    /**
+     * @brief 	Compare two rows using the precomputed sort keys
+     * @param 	left_row The row to compare
+     * @param 	right_row The row to compare with
+     * @param 	column The column to sort on
+     * @return	Returns \em true if left_row should be sorted before right_row
+     */
+    bool lessThan(int left_row, int right_row, int column) const;
+
+    /**
+     * @brief 	Check if a row matches a filter string
+     * @param 	row The row to check
+     * @param 	filter A lower case filter string
+     * @return	Returns \em true if the callsign or the description of the
+     *		station contains the filter string
+     */
+    bool matches(int row, const QString &filter) const;
+
   protected:
     
   private:
+    struct SortKey
+    {
+      QString callsign;
+      QString description;
+      QString time;
+      int     status;
+      int     id;
+      quint32 ip;
+    };
+    
     QList<EchoLink::StationData> stations;
+    QList<SortKey>               sort_keys;
     
     EchoLinkDirectoryModel(const EchoLinkDirectoryModel&);
     EchoLinkDirectoryModel& operator=(const EchoLinkDirectoryModel&);
+
+    int findRow(const EchoLink::StationData &stn) const;
+    void updateRow(int row, const EchoLink::StationData &updated_stn);
+    void insertStation(int row, const EchoLink::StationData &stn);
+    static SortKey sortKey(const EchoLink::StationData &stn);
     
 };  /* class EchoLinkDirectoryModel */
 
@@ -60,6 +60,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncIpAddress.h>
 #include <AsyncAudioInterpolator.h>
+#include <AsyncAudioSampleRate.h>
 #include <EchoLinkDirectory.h>
 #include <EchoLinkProxy.h>
 #include <common.h>
@@ -78,6 +79,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "MainWindow.h"
 #include "MsgHandler.h"
 #include "EchoLinkDirectoryModel.h"
+#include "EchoLinkDirectoryFilterModel.h"
 #include "multirate_filter_coeff.h"
 
 
@@ -234,6 +236,16 @@ MainWindow::MainWindow(void)
   link_model = new EchoLinkDirectoryModel(this);
   repeater_model = new EchoLinkDirectoryModel(this);
   station_model = new EchoLinkDirectoryModel(this);
+  filter_model = new EchoLinkDirectoryFilterModel(this);
+  station_view->setModel(filter_model);
+  station_view->sortByColumn(0, Qt::AscendingOrder);
+  connect(station_view->selectionModel(),
+          SIGNAL(selectionChanged(const QItemSelection&,
+                                  const QItemSelection&)),
+          this, SLOT(stationViewSelectionChanged(const QItemSelection&,
+                                                 const QItemSelection&)));
+  connect(station_filter, SIGNAL(textChanged(const QString&)),
+          filter_model, SLOT(setFilterText(const QString&)));
   updateBookmarkModel();
   station_view_selector->setCurrentRow(0);
 
@@ -440,8 +452,7 @@ void MainWindow::initMsgAudioIo(void)
     mem_fun(*this, &MainWindow::allMsgsWritten));
   AudioSource *prev_src = msg_handler;
 
-#if (INTERNAL_SAMPLE_RATE == 8000)  
-  if (msg_audio_io->sampleRate() > 8000)
+  if ((INTERNAL_SAMPLE_RATE == 8000) && (msg_audio_io->sampleRate() > 8000))
   {
       // Interpolate sample rate to 16kHz
     AudioInterpolator *i1 = new AudioInterpolator(2, coeff_16_8,
@@ -449,18 +460,19 @@ void MainWindow::initMsgAudioIo(void)
     prev_src->registerSink(i1, true);
     prev_src = i1;
   }
-#endif
 
   if (msg_audio_io->sampleRate() > 16000)
   {
       // Interpolate sample rate to 48kHz
-#if (INTERNAL_SAMPLE_RATE == 8000)
-    AudioInterpolator *i2 = new AudioInterpolator(3, coeff_48_16_int,
-                                                  coeff_48_16_int_taps);
-#else
-    AudioInterpolator *i2 = new AudioInterpolator(3, coeff_48_16,
-                                                  coeff_48_16_taps);
-#endif
+    AudioInterpolator *i2 = 0;
+    if (INTERNAL_SAMPLE_RATE == 8000)
+    {
+      i2 = new AudioInterpolator(3, coeff_48_16_int, coeff_48_16_int_taps);
+    }
+    else
+    {
+      i2 = new AudioInterpolator(3, coeff_48_16, coeff_48_16_taps);
+    }
     prev_src->registerSink(i2, true);
     prev_src = i2;
   }
@@ -483,13 +495,11 @@ void MainWindow::setupAudioParams(void)
     AudioIO::setBlocksize(512);
     AudioIO::setBlockCount(2);
   }
-#if INTERNAL_SAMPLE_RATE <= 8000
-  else if (rate == 8000)
+  else if ((rate == 8000) && (INTERNAL_SAMPLE_RATE <= 8000))
   {
     AudioIO::setBlocksize(256);
     AudioIO::setBlockCount(2);
   }
-#endif
   AudioIO::setSampleRate(rate);
   AudioIO::setChannels(1);
 } /* MainWindow::setupAudioParams */
@@ -534,6 +544,8 @@ void MainWindow::initEchoLink(void)
   dir->statusChanged.connect(mem_fun(*this, &MainWindow::statusChanged));
   dir->stationListUpdated.connect(
       mem_fun(*this, &MainWindow::callsignListUpdated));
+  dir->stationListChanged.connect(
+      mem_fun(*this, &MainWindow::callsignListChanged));
 
   Dispatcher::setBindAddr(bind_ip);
   Dispatcher *disp = Dispatcher::instance();
@@ -586,8 +598,7 @@ void MainWindow::stationViewSelectorCurrentItemChanged(QListWidgetItem *current,
     return;
   }
   
-  QAbstractItemModel *model = 0;
-  QItemSelectionModel *m = station_view->selectionModel();
+  EchoLinkDirectoryModel *model = 0;
   if (current->text() == trUtf8("Bookmarks"))
   {
     model = bookmark_model;
@@ -609,21 +620,8 @@ void MainWindow::stationViewSelectorCurrentItemChanged(QListWidgetItem *current,
     model = station_model;
   }
   
-  station_view->setModel(model);
-  if (m != 0)
-  {
-    m->clear();
-    delete m;
-  }
-  
-  QItemSelectionModel *sm = station_view->selectionModel();
-  if (sm != 0)
-  {
-    connect(sm, SIGNAL(selectionChanged(const QItemSelection&,
-					const QItemSelection&)),
-	    this, SLOT(stationViewSelectionChanged(const QItemSelection&,
-						   const QItemSelection&)));
-  }
+  station_view->selectionModel()->clear();
+  filter_model->setDirectoryModel(model);
 
 } /* MainWindow::stationViewSelectorCurrentItemChanged */
 
@@ -654,11 +652,6 @@ void MainWindow::callsignListUpdated(void)
 {
   updateBookmarkModel();
   
-  conf_model->updateStationList(dir->conferences());
-  link_model->updateStationList(dir->links());
-  repeater_model->updateStationList(dir->repeaters());
-  station_model->updateStationList(dir->stations());
-  
   statusBar()->showMessage(trUtf8("Station list has been refreshed"), 5000);
   
   const string &msg = dir->message();
@@ -671,6 +664,39 @@ void MainWindow::callsignListUpdated(void)
 } /* MainWindow::callsignListUpdated */
 
 
+void MainWindow::callsignListChanged(const Directory::StationListDelta &delta)
+{
+  EchoLinkDirectoryModel *models[] =
+  {
+    link_model, repeater_model, conf_model, station_model
+  };
+  vector<StationData> updated[4];
+  vector<StationData> removed[4];
+
+  vector<StationData>::const_iterator it;
+  for (it = delta.added.begin(); it != delta.added.end(); ++it)
+  {
+    updated[Directory::listType(it->callsign())].push_back(*it);
+  }
+  for (it = delta.changed.begin(); it != delta.changed.end(); ++it)
+  {
+    updated[Directory::listType(it->callsign())].push_back(*it);
+  }
+  for (it = delta.removed.begin(); it != delta.removed.end(); ++it)
+  {
+    removed[Directory::listType(it->callsign())].push_back(*it);
+  }
+
+  for (int i=0; i<4; ++i)
+  {
+    if (!updated[i].empty() || !removed[i].empty())
+    {
+      models[i]->updateStations(updated[i], removed[i]);
+    }
+  }
+} /* MainWindow::callsignListChanged */
+
+
 void MainWindow::refreshCallList(void)
 {
   if (dir->status() >= StationData::STAT_ONLINE)
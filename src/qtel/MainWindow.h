@@ -76,6 +76,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 class IncomingConnection;
 class MsgHandler;
 class EchoLinkDirectoryModel;
+class EchoLinkDirectoryFilterModel;
 
 namespace EchoLink
 {
@@ -178,6 +179,7 @@ class MainWindow : public QMainWindow, private Ui::MainWindowBase,
     EchoLinkDirectoryModel	  *link_model;
     EchoLinkDirectoryModel	  *repeater_model;
     EchoLinkDirectoryModel	  *station_model;
+    EchoLinkDirectoryFilterModel  *filter_model;
     EchoLink::Proxy               *proxy;
     
     QMap<QString, QString> incoming_con_param;
@@ -196,6 +198,8 @@ class MainWindow : public QMainWindow, private Ui::MainWindowBase,
     void setupAudioParams(void);
     void initEchoLink(void);
     void updateBookmarkModel(void);
+    void callsignListChanged(
+        const EchoLink::Directory::StationListDelta &delta);
     
   private slots:
     void stationViewSelectorCurrentItemChanged(QListWidgetItem *current,
@@ -59,6 +59,7 @@ extern "C" {
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -757,7 +758,7 @@ bool WavFileQueueItem::initialize(void)
   }
   
   ptr += read32bitValue(ptr, &sample_rate);
-  if (sample_rate != INTERNAL_SAMPLE_RATE)
+  if (sample_rate != static_cast<uint32_t>(INTERNAL_SAMPLE_RATE))
   {
     cerr << "*** WARNING: SvxLink can only handle WAV files with sample rate "
       	 << INTERNAL_SAMPLE_RATE << ": "
@@ -43,6 +43,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
 #include <EchoLinkStationData.h>
 
 
@@ -118,9 +119,10 @@ class SettingsDialog : public QDialog, public Ui::SettingsDialog
       setupUi(this);
       my_callsign->setMaxLength(EchoLink::StationData::MAXCALL);
       my_location->setMaxLength(EchoLink::StationData::MAXDESC);
-#if INTERNAL_SAMPLE_RATE == 8000
-      card_sample_rate->addItem("8000");
-#endif
+      if (INTERNAL_SAMPLE_RATE == 8000)
+      {
+        card_sample_rate->addItem("8000");
+      }
       card_sample_rate->addItem("16000");
       card_sample_rate->addItem("48000");
     }
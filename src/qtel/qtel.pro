@@ -4,12 +4,14 @@ LANGUAGE	= C++
 CONFIG	+= qt warn_on release
 
 HEADERS += ComDialog.h MainWindow.h MyMessageBox.h Settings.h \
-	EchoLinkDirectoryModel.h MsgHandler.h SettingsDialog.h Vox.h
+	EchoLinkDirectoryModel.h EchoLinkDirectoryFilterModel.h MsgHandler.h \
+	SettingsDialog.h Vox.h
 
 SOURCES	+= MainWindow.cpp \
 	ComDialog.cpp \
 	Settings.cpp \
-	EchoLinkDirectoryModel.cpp
+	EchoLinkDirectoryModel.cpp \
+	EchoLinkDirectoryFilterModel.cpp
 
 FORMS	= MainWindowBase.ui \
 	ComDialogBase.ui \
@@ -41,7 +41,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sys/time.h>
 #include <cstring>
 #include <cstdlib>
-#include <map>
+#include <sstream>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -55,6 +56,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncTimer.h>
 #include <AsyncTcpServer.h>
 #include <AsyncTcpConnection.h>
+#include <AsyncHttpServerConnection.h>
+#include <AsyncMetrics.h>
 #include <common.h>
 
 
@@ -88,6 +91,8 @@ using namespace NetTrxMsg;
 
 
 SvxServer::SvxServer(Async::Config &cfg)
+  : http_server(0), batch_depth(0), audio_msgs_rx(0), fanout_msgs(0),
+    tcp_writes(0)
 {
   string port = "5210";
   if (!cfg.getValue("GLOBAL", "LISTEN_PORT", port))
@@ -162,14 +167,27 @@ SvxServer::SvxServer(Async::Config &cfg)
   audio_timer->setEnable(false);
 
   master = 0;
+
+  string http_srv_port;
+  if (cfg.getValue("GLOBAL", "HTTP_SRV_PORT", http_srv_port))
+  {
+    cout << "--- starting HTTP status server on port " << http_srv_port
+         << endl;
+    http_server = new Async::TcpServer<HttpServerConnection>(http_srv_port);
+    http_server->clientConnected.connect(
+        mem_fun(*this, &SvxServer::httpClientConnected));
+    Async::Metrics::instance().collect.connect(
+        mem_fun(*this, &SvxServer::writeMetrics));
+  }
 } /* SvxServer::SvxServer */
 
 
 SvxServer::~SvxServer(void)
 {
   clients.clear();
+  delete http_server;
   delete server;
-  delete master;
+  master = 0;  // Owned by the server
   delete heartbeat_timer;
 }
 
@@ -181,36 +199,41 @@ void SvxServer::clientConnected(Async::TcpConnection *con)
 
   con->dataReceived.connect(mem_fun(*this, &SvxServer::tcpDataReceived));
 
-  pair<const string, uint16_t> key(con->remoteHost().toString(),
-                                   con->remotePort());
   Cons clpair;
   clpair.con = con;
+  clpair.tx_mode = Tx::TX_OFF;
   clpair.state = STATE_VER_WAIT;
   clpair.sql_open = false;  // set SQL close as default
   clpair.blocked = false;   // node is not blocked as default
   clpair.recv_exp = sizeof(Msg);
   clpair.recv_cnt = 0;
+  clpair.rx_msgs = 0;
+  clpair.tx_msgs = 0;
   gettimeofday(&clpair.last_msg, NULL);
   gettimeofday(&clpair.sent_msg, NULL);
 
-  clients[key] = clpair;
+  clients[con] = clpair;
 
-  MsgProtoVer *ver_msg = new MsgProtoVer;
-  sendMsg(con, ver_msg);
+  MsgProtoVer ver_msg;
+  sendMsg(con, &ver_msg);
 
+  Clients::iterator it = clients.find(con);
+  if (it == clients.end())
+  {
+    return;
+  }
   if (auth_key.empty())
   {
-    MsgAuthOk *auth_ok = new MsgAuthOk;
-    sendMsg(con, auth_ok);
-    clpair.state = STATE_VER_WAIT;
+    MsgAuthOk auth_ok;
+    sendMsg(con, &auth_ok);
+    (*it).second.state = STATE_VER_WAIT;
   }
   else
   {
     sendMsg(con, auth_msg);
-    clpair.state = STATE_AUTH_WAIT;
+    (*it).second.state = STATE_AUTH_WAIT;
   }
 
-  clients[key] = clpair;
   heartbeat_timer->setEnable(true);
 
 } /* SvxServer::clientConnected */
@@ -229,24 +252,21 @@ void SvxServer::clientDisconnected(Async::TcpConnection *con,
   }
   resetMaster(con);
 
-  Clients::iterator it;
-  for (it=clients.begin(); it!=clients.end(); it++)
+  Clients::iterator it = clients.find(con);
+  if (it != clients.end())
   {
-    if ((*it).second.con == con)
-    {
-      (*it).second.state = STATE_DISC;
-      (*it).second.sql_open = false;
+    (*it).second.state = STATE_DISC;
+    (*it).second.sql_open = false;
 
-        // If a station lost network connection it can't be
-        // master anymore, send a SQL close command to all
-        // connected stations
-      if (isMaster(con))
-      {
-        MsgSquelch *ms = new MsgSquelch(false, 0.0, 1);
-        sendMsg(con, ms);
-      }
-      break;
+      // If a station lost network connection it can't be
+      // master anymore, send a SQL close command to all
+      // connected stations
+    if (isMaster(con))
+    {
+      MsgSquelch ms(false, 0.0, 1);
+      sendMsg(con, &ms);
     }
+    it = clients.find(con);
   }
 
   if (it != clients.end())
@@ -264,15 +284,7 @@ int SvxServer::tcpDataReceived(Async::TcpConnection *con, void *data, int size)
 //  cout << "tcpDataReceived: " << con->remoteHost() << ":"
 //       << con->remotePort() << endl;
 
-  Clients::iterator it;
-  for (it=clients.begin(); it!=clients.end(); it++)
-  {
-    if (((*it).second).con == con)
-    {
-      break;
-    }
-  }
-
+  Clients::iterator it = clients.find(con);
   if (it == clients.end())
   {
     cout << "--- tcp data received from station out of my list "
@@ -282,6 +294,10 @@ int SvxServer::tcpDataReceived(Async::TcpConnection *con, void *data, int size)
 
   int orig_size = size;
   char *buf = static_cast<char*>(data);
+
+    // Collect all messages generated while handling this chunk of data
+    // and send them with one write per client when done
+  ++batch_depth;
   while (size > 0)
   {
     unsigned read_cnt = min(static_cast<unsigned>(size), (*it).second.recv_exp
@@ -292,7 +308,7 @@ int SvxServer::tcpDataReceived(Async::TcpConnection *con, void *data, int size)
               "in svxserver. Disconnecting...\n";
       con->disconnect();
       clientDisconnected(con, TcpConnection::DR_ORDERED_DISCONNECT);
-      return orig_size;
+      break;
     }
     memcpy((*it).second.recv_buf+(*it).second.recv_cnt, buf, read_cnt);
     size -= read_cnt;
@@ -307,6 +323,10 @@ int SvxServer::tcpDataReceived(Async::TcpConnection *con, void *data, int size)
         if (msg->size() == sizeof(Msg))
         {
           handleMsg(con, msg);
+          if ((it = clients.find(con)) == clients.end())
+          {
+            break;
+          }
           (*it).second.recv_cnt = 0;
           (*it).second.recv_exp = sizeof(Msg);
         }
@@ -320,19 +340,28 @@ int SvxServer::tcpDataReceived(Async::TcpConnection *con, void *data, int size)
                << "Header length too small (" << msg->size() << ")\n";
           con->disconnect();
           clientDisconnected(con, TcpConnection::DR_ORDERED_DISCONNECT);
-          return orig_size;
+          break;
         }
       }
       else
       {
         Msg *msg = reinterpret_cast<Msg*>((*it).second.recv_buf);
         handleMsg(con, msg);
+        if ((it = clients.find(con)) == clients.end())
+        {
+          break;
+        }
         (*it).second.recv_cnt = 0;
         (*it).second.recv_exp = sizeof(Msg);
       }
     }
   }
 
+  if (--batch_depth == 0)
+  {
+    flushBatch();
+  }
+
   return orig_size;
 
 } /* SvxServer::tcpDataReceived */
@@ -344,26 +373,16 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
 //  cout << "message <---------- " << con->remoteHost() << ":" 
 //       << con->remotePort() << ", type=" << msg->type() << " received\n";
 
-  int state = STATE_READY;
-  Clients::iterator it;
-  Clients t_clients;
-
-  for (it=clients.begin(); it!=clients.end(); it++)
-  {
-    if ( ((*it).second).con == con)
-    {
-      state = (*it).second.state;
-      gettimeofday(&((*it).second).last_msg, NULL);
-      break;
-    }
-  }
-
+  Clients::iterator it = clients.find(con);
   if (it == clients.end())
   {
     cout << "-- message received from ip out of my list "
          << con->remoteHost() << ":" << con->remotePort() << endl;
     return;
   }
+  int state = (*it).second.state;
+  gettimeofday(&((*it).second).last_msg, NULL);
+  (*it).second.rx_msgs += 1;
 
   switch (state)
   {
@@ -388,14 +407,14 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
         }
         else
         {
-          MsgAuthOk *ok_msg = new MsgAuthOk;
-          sendMsg(con, ok_msg);
           ((*it).second).state = STATE_READY;
+          MsgAuthOk ok_msg;
+          sendMsg(con, &ok_msg);
 
           // sending SQL close to connected node just to be sure that it 
           // isn't still open from former connects
-          MsgTransmitterStateChange *txcl = new MsgTransmitterStateChange(false);
-          sendMsg(con, txcl);
+          MsgTransmitterStateChange txcl(false);
+          sendMsg(con, &txcl);
         }
       }
       else
@@ -419,8 +438,8 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
       // is heartbeat, send a heartbeat back to client
     case MsgHeartbeat::TYPE:
     {
-      MsgHeartbeat *m = new MsgHeartbeat;
-      sendMsg(con, m);
+      MsgHeartbeat m;
+      sendMsg(con, &m);
       return;
     }
 
@@ -468,6 +487,7 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
 
     case MsgAudio::TYPE:
     {
+      audio_msgs_rx += 1;
       // if SvxServer is receiving an audiostream and the SQL is still not
       // open, it will send a SQL=open command to all connected stations
       // may occur in case of a network error when the connection has been
@@ -476,8 +496,8 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
       {
         audio_timer->setEnable(true);
         setMaster(con);
-        MsgSquelch *ms = new MsgSquelch(true, 1.0, 1);
-        sendExcept(con, ms);
+        MsgSquelch ms(true, 1.0, 1);
+        sendExcept(con, &ms);
         (*it).second.sql_open = true;
 
         // sends the audiostream to all connected clients without the
@@ -485,9 +505,9 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
         if ((*it).second.tx_mode != Tx::TX_AUTO)
         {
           (*it).second.tx_mode = Tx::TX_AUTO;
-          MsgSetTxCtrlMode *n = new MsgSetTxCtrlMode(Tx::TX_AUTO);
-          sendExcept(con, n);
-          sendMsg(con, n);
+          MsgSetTxCtrlMode n(Tx::TX_AUTO);
+          sendExcept(con, &n);
+          sendMsg(con, &n);
         }
       }
 
@@ -508,16 +528,16 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
       if (isMaster(con))
       {
         resetMaster(con);
-        MsgSquelch  *ms = new MsgSquelch(false, 0.0, 1);
-        sendExcept(con, ms);
-        sendMsg(con, ms);
+        MsgSquelch ms(false, 0.0, 1);
+        sendExcept(con, &ms);
+        sendMsg(con, &ms);
 
         (*it).second.sql_open = false;
 
-        MsgAllSamplesFlushed *o = new MsgAllSamplesFlushed;
-        sendMsg(con, o);
-        cmsg = o;
-        break;
+        MsgAllSamplesFlushed o;
+        sendMsg(con, &o);
+        sendExcept(con, &o);
+        return;
       }
       else
       {
@@ -548,12 +568,12 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
         // the station with 1st SQL opening becomes a master
         setMaster(con);
 
-        MsgTransmitterStateChange *n = new MsgTransmitterStateChange(true);
-        sendMsg(con, n);
-        sendExcept(con, n);
+        MsgTransmitterStateChange n(true);
+        sendMsg(con, &n);
+        sendExcept(con, &n);
 
-        MsgSquelch  *ms = new MsgSquelch(true, 1.0, 1);
-        sendExcept(con, ms);
+        MsgSquelch ms(true, 1.0, 1);
+        sendExcept(con, &ms);
         (*it).second.sql_open = true;
         audio_timer->reset();
         audio_timer->setEnable(true);
@@ -566,12 +586,12 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
         (*it).second.sql_open = false;
 
         (*it).second.tx_mode = Tx::TX_AUTO;
-        MsgSetTxCtrlMode *n = new MsgSetTxCtrlMode(Tx::TX_AUTO);
-        sendExcept(con, n);
+        MsgSetTxCtrlMode n(Tx::TX_AUTO);
+        sendExcept(con, &n);
 
-        MsgTransmitterStateChange *m = new MsgTransmitterStateChange(false);
-        sendExcept(con, m);
-        sendMsg(con, m);
+        MsgTransmitterStateChange m(false);
+        sendExcept(con, &m);
+        sendMsg(con, &m);
       }
 
       cmsg = s;
@@ -584,7 +604,10 @@ void SvxServer::handleMsg(Async::TcpConnection *con, Msg *msg)
       return;
   }
 
-  sendExcept(con, cmsg);
+  if (cmsg != 0)
+  {
+    sendExcept(con, cmsg);
+  }
 
 } /* SvxServer::handleMsg */
 
@@ -602,22 +625,16 @@ void SvxServer::audiotimeout(Timer *t)
 
 void SvxServer::sqltimeout(Timer *t)
 {
-  Clients::iterator it;
-  Clients t_clients;
-
   // find the connection handler that has a problem with
   // the SQL -> revoke the AUTH grant
-  for (it=clients.begin(); it!=clients.end(); it++)
+  Clients::iterator it = clients.find(master);
+  if (it != clients.end())
   {
-    if ( (*it).second.con == master)
-    {
-      (*it).second.state = STATE_DISC;
-      (*it).second.blocked = true;
-      cout << "*** WARNING: SQL on " << master->remoteHost() 
-           << " has been open too long, blocking station." << endl;
-      gettimeofday(&((*it).second).last_msg, NULL);
-      break;
-    }
+    (*it).second.state = STATE_DISC;
+    (*it).second.blocked = true;
+    cout << "*** WARNING: SQL on " << master->remoteHost() 
+         << " has been open too long, blocking station." << endl;
+    gettimeofday(&((*it).second).last_msg, NULL);
   }
 
   resetAll();
@@ -632,27 +649,29 @@ void SvxServer::sqlresettimeout(Timer *t)
 
 void SvxServer::resetAll(void)
 {
-  MsgSquelch *ms = new MsgSquelch(false, 0.0, 1);
-  sendExcept(master, ms);
-  sendMsg(master, ms);
+  ++batch_depth;
+  MsgSquelch ms(false, 0.0, 1);
+  sendExcept(master, &ms);
+  sendMsg(master, &ms);
 
-  Clients::iterator it;
-  Clients t_clients;
-
-  for (it=clients.begin(); it!=clients.end(); it++)
+  Clients::iterator it = clients.find(master);
+  if (it != clients.end())
   {
-    if ( (*it).second.con == master)
-    {
-      (*it).second.sql_open = false;
-      gettimeofday(&(*it).second.last_msg, NULL);
-      break;
-    }
+    (*it).second.sql_open = false;
+    gettimeofday(&(*it).second.last_msg, NULL);
   }
 
-  MsgAllSamplesFlushed *o = new MsgAllSamplesFlushed;
-  sendMsg(master, o);
-  sendExcept(master, o);
-  resetMaster(master);
+  MsgAllSamplesFlushed o;
+  sendMsg(master, &o);
+  sendExcept(master, &o);
+  if (--batch_depth == 0)
+  {
+    flushBatch();
+  }
+  if (master != 0)
+  {
+    resetMaster(master);
+  }
 } /* SvxServer::resetAll */
 
 
@@ -663,9 +682,10 @@ void SvxServer::hbtimeout(Timer *t)
   int diff_ms;
 
   Clients::iterator it;
-  Clients t_clients;
-  MsgHeartbeat *m = new MsgHeartbeat;
+  ConList t_clients;
+  MsgHeartbeat m;
 
+  ++batch_depth;
   for (it=clients.begin(); it!=clients.end(); it++)
   {
     gettimeofday(&t_time, NULL);
@@ -679,22 +699,31 @@ void SvxServer::hbtimeout(Timer *t)
       cerr << "**** ERROR: Heartbeat timeout, lost connection to "
            << (*it).second.con->remoteHost() << ":"
            << (*it).second.con->remotePort() << endl;
-      t_clients.insert(*it); // storing clients to be removed later
+      t_clients.push_back(it->first); // storing clients to be removed later
       (*it).second.state = STATE_DISC;
     }
     else 
     {
-      sendMsg((*it).second.con, m);
+      sendMsg((*it).second.con, &m);
     }
   }
+  if (--batch_depth == 0)
+  {
+    flushBatch();
+  }
 
   // removing client connection from connection pool
-  for (it = t_clients.begin(); it != t_clients.end(); it++)
+  ConList::iterator cit;
+  for (cit = t_clients.begin(); cit != t_clients.end(); ++cit)
   {
-    cout << "-X- disconnect client " << (*it).second.con->remoteHost() << ":"
-         << (*it).second.con->remotePort() << endl;
-    (*it).second.con->disconnect();
-    clientDisconnected((*it).second.con, TcpConnection::DR_ORDERED_DISCONNECT);
+    if (clients.find(*cit) == clients.end())
+    {
+      continue;
+    }
+    cout << "-X- disconnect client " << (*cit)->remoteHost() << ":"
+         << (*cit)->remotePort() << endl;
+    (*cit)->disconnect();
+    clientDisconnected(*cit, TcpConnection::DR_ORDERED_DISCONNECT);
   }
 
   t->reset();
@@ -704,18 +733,26 @@ void SvxServer::hbtimeout(Timer *t)
 
 void SvxServer::sendExcept(Async::TcpConnection *con, Msg *msg)
 {
-
-    // copy map to prevent a segfault by erasing a connection
-    // that exists anymore
-  Clients t_clients = clients;
-  Clients::iterator it;
+    // A failed write will remove the client so copy the connections first.
+    // The message is already in wire format so the same bytes are sent, or
+    // queued, for every client.
+  ConList cons;
+  cons.reserve(clients.size());
+  for (Clients::iterator it = clients.begin(); it != clients.end(); ++it)
+  {
+    if (it->first != con)
+    {
+      cons.push_back(it->first);
+    }
+  }
+  fanout_msgs += 1;
 
     // sending data to connected clients without the source client
-  for (it = t_clients.begin(); it != t_clients.end(); it++)
+  for (ConList::iterator it = cons.begin(); it != cons.end(); ++it)
   {
-    if ((*it).second.con != con)
+    if (clients.find(*it) != clients.end())
     {
-      sendMsg((*it).second.con, msg);
+      sendMsg(*it, msg);
     }
   }
 } /* SvxServer::sendExcept */
@@ -723,23 +760,26 @@ void SvxServer::sendExcept(Async::TcpConnection *con, Msg *msg)
 
 void SvxServer::sendMsg(Async::TcpConnection *con, Msg *msg)
 {
-
-  assert(con->isConnected());
-  if (clients.size() < 1)
+  Clients::iterator it = clients.find(con);
+  if (it == clients.end())
   {
     return;
   }
+  (*it).second.tx_msgs += 1;
 
-  int written = con->write(msg, msg->size());
-  if (written != static_cast<int>(msg->size()))
+  if (batch_depth > 0)
   {
-    cout << "*** ERROR: (" << con->remoteHost() << ":"
-         << con->remotePort() << ") TCP transmit "
-         << (written == -1 ? "error." : "buffer overflow.")
-         << endl;
-    con->disconnect();
-    clientDisconnected(con, TcpConnection::DR_ORDERED_DISCONNECT);
+    std::vector<char>& buf = (*it).second.send_buf;
+    if (buf.empty())
+    {
+      batch_cons.push_back(con);
+    }
+    const char *data = reinterpret_cast<const char *>(msg);
+    buf.insert(buf.end(), data, data + msg->size());
+    return;
   }
+
+  writeBuf(con, msg, msg->size());
 } /* SvxServer::sendMsg */
 
 
@@ -777,6 +817,134 @@ void SvxServer::resetMaster(Async::TcpConnection *con)
 } /* SvxServer::resetMaster */
 
 
+void SvxServer::flushBatch(void)
+{
+  ConList cons;
+  cons.swap(batch_cons);
+  for (ConList::iterator cit = cons.begin(); cit != cons.end(); ++cit)
+  {
+    Clients::iterator it = clients.find(*cit);
+    if ((it == clients.end()) || (*it).second.send_buf.empty())
+    {
+      continue;
+    }
+    std::vector<char> buf;
+    buf.swap((*it).second.send_buf);
+    writeBuf(*cit, &buf[0], buf.size());
+  }
+} /* SvxServer::flushBatch */
+
+
+void SvxServer::writeBuf(Async::TcpConnection *con, const void *buf, int len)
+{
+  assert(con->isConnected());
+  tcp_writes += 1;
+  int written = con->write(buf, len);
+  if (written != len)
+  {
+    cout << "*** ERROR: (" << con->remoteHost() << ":"
+         << con->remotePort() << ") TCP transmit "
+         << (written == -1 ? "error." : "buffer overflow.")
+         << endl;
+    con->disconnect();
+    clientDisconnected(con, TcpConnection::DR_ORDERED_DISCONNECT);
+  }
+} /* SvxServer::writeBuf */
+
+
+void SvxServer::httpClientConnected(Async::HttpServerConnection *con)
+{
+  con->requestReceived.connect(
+      mem_fun(*this, &SvxServer::httpRequestReceived));
+} /* SvxServer::httpClientConnected */
+
+
+void SvxServer::httpRequestReceived(Async::HttpServerConnection *con,
+                                    Async::HttpServerConnection::Request& req)
+{
+  Async::HttpServerConnection::Response res;
+  if ((req.method != "GET") && (req.method != "HEAD"))
+  {
+    res.setCode(501);
+    res.setContent("application/json",
+        "{\"msg\":\"" + req.method + ": Method not implemented\"}");
+    con->write(res);
+    return;
+  }
+
+  if (req.target == "/metrics")
+  {
+    Async::Metrics::instance().writeHttpResponse(con, req);
+    return;
+  }
+
+  if (req.target != "/status")
+  {
+    res.setCode(404);
+    res.setContent("application/json", "{\"msg\":\"Not found!\"}");
+    con->write(res);
+    return;
+  }
+
+  res.setHeader("Cache-Control", "no-cache");
+  res.setContent("application/json", statusJson());
+  if (req.method == "HEAD")
+  {
+    res.setSendContent(false);
+  }
+  res.setCode(200);
+  con->write(res);
+} /* SvxServer::httpRequestReceived */
+
+
+void SvxServer::writeMetrics(Async::MetricsWriter& writer)
+{
+  const Async::MetricsWriter::Labels no_labels;
+  writer.gauge("svxserver_clients", "Number of connected clients",
+               no_labels, clients.size());
+  writer.gauge("svxserver_has_master", "Set to 1 if a client is talking",
+               no_labels, hasMaster() ? 1 : 0);
+  writer.counter("svxserver_audio_rx_msgs",
+                 "Number of audio messages received", no_labels,
+                 audio_msgs_rx);
+  writer.counter("svxserver_fanout_msgs",
+                 "Number of messages forwarded to all other clients",
+                 no_labels, fanout_msgs);
+  writer.counter("svxserver_tcp_writes",
+                 "Number of TCP writes done to clients", no_labels,
+                 tcp_writes);
+} /* SvxServer::writeMetrics */
+
+
+std::string SvxServer::statusJson(void) const
+{
+  ostringstream os;
+  os << "{\"clients\":[";
+  for (Clients::const_iterator it = clients.begin(); it != clients.end(); ++it)
+  {
+    const Cons& c = it->second;
+    if (it != clients.begin())
+    {
+      os << ",";
+    }
+    os << "{\"host\":\"" << c.con->remoteHost() << "\""
+       << ",\"port\":" << c.con->remotePort()
+       << ",\"ready\":" << (c.state == STATE_READY ? "true" : "false")
+       << ",\"master\":" << (c.con == master ? "true" : "false")
+       << ",\"sql_open\":" << (c.sql_open ? "true" : "false")
+       << ",\"blocked\":" << (c.blocked ? "true" : "false")
+       << ",\"rx_msgs\":" << c.rx_msgs
+       << ",\"tx_msgs\":" << c.tx_msgs
+       << "}";
+  }
+  os << "],\"audio_rx_msgs\":" << audio_msgs_rx
+     << ",\"fanout_msgs\":" << fanout_msgs
+     << ",\"tcp_writes\":" << tcp_writes
+     << "}";
+  return os.str();
+} /* SvxServer::statusJson */
+
+
 /*
  * This file has not been truncated
  */
@@ -34,6 +34,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
 
 
 /****************************************************************************
@@ -44,6 +48,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncConfig.h>
 #include <AsyncTcpServer.h>
+#include <AsyncHttpServerConnection.h>
+#include <AsyncMetrics.h>
 #include <Tx.h>
 
 
@@ -131,6 +137,7 @@ class SvxServer : public sigc::trackable
   private:
 
     Async::TcpServer<> *server;
+    Async::TcpServer<Async::HttpServerConnection> *http_server;
     Async::Timer * heartbeat_timer;
     Async::Timer * sql_timer;
     Async::Timer * sql_resettimer;
@@ -159,11 +166,24 @@ class SvxServer : public sigc::trackable
       unsigned  recv_cnt;
       unsigned  recv_exp;
       bool  blocked;
+      std::vector<char> send_buf;
+      uint64_t  rx_msgs;
+      uint64_t  tx_msgs;
     };
 
-    typedef std::map<std::pair<const std::string, uint16_t>, Cons> Clients;
+    typedef std::unordered_map<Async::TcpConnection*, Cons> Clients;
+    typedef std::vector<Async::TcpConnection*> ConList;
     Clients clients;
 
+      // While handling received data, outgoing messages are collected per
+      // client and written with one write call when all data is handled
+    unsigned  batch_depth;
+    ConList   batch_cons;
+
+    uint64_t  audio_msgs_rx;
+    uint64_t  fanout_msgs;
+    uint64_t  tcp_writes;
+
     std::string     auth_key;
     NetTrxMsg::MsgAuthChallenge *auth_msg;
     struct timeval l_time;
@@ -189,6 +209,13 @@ class SvxServer : public sigc::trackable
     void setMaster(Async::TcpConnection *con);
     void resetMaster(Async::TcpConnection *con);
     bool hasMaster(void);
+    void flushBatch(void);
+    void writeBuf(Async::TcpConnection *con, const void *buf, int len);
+    void httpClientConnected(Async::HttpServerConnection *con);
+    void httpRequestReceived(Async::HttpServerConnection *con,
+                             Async::HttpServerConnection::Request& req);
+    void writeMetrics(Async::MetricsWriter& writer);
+    std::string statusJson(void) const;
 
     SvxServer(const SvxServer&);
     SvxServer& operator=(const SvxServer&);
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <unistd.h>
 #include <signal.h>
+#include <time.h>
 #include <popt.h>
 #include <termios.h>
 
@@ -55,6 +56,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioSplitter.h>
 #include <AsyncConfig.h>
 #include <AsyncFdWatch.h>
+#include <AsyncAudioSampleRate.h>
 #include <Tx.h>
 #include <Rx.h>
 #include <common.h>
@@ -74,6 +76,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "../trx/Emphasis.h"
 #include "../trx/RtlSdr.h"
 #include "../trx/Ddr.h"
+#include "../trx/WbRxRtlSdr.h"
+#include "../trx/RtlReplay.h"
+#include "../trx/LocalRxReplay.h"
+#include "../trx/CaptureFile.h"
 
 
 /****************************************************************************
@@ -280,7 +286,8 @@ class DevPrinter : public AudioSink
         g(mod_fqs.size()), samp_cnt(0), max_dev(max_dev),
         headroom(pow(10.0, headroom_db/20.0)), adj_level(1.0f), dev_est(0.0),
         block_cnt(0), pwr_sum(0.0), tot_dev_est(0.0f), amp_sum(0.0),
-        fqerr_est(0.0), carrier_fq(0.0)
+        fqerr_est(0.0), carrier_fq(0.0), meas_cnt(0), dev_sum(0.0),
+        tot_dev_sum(0.0), fqerr_sum(0.0)
     {
       for (size_t i=0; i<mod_fqs.size(); ++i)
       {
@@ -308,7 +315,27 @@ class DevPrinter : public AudioSink
     }
 
     double carrierFq(void) const { return carrier_fq; }
-    
+
+    void print(ostream &os) const
+    {
+      os << "Tone dev=" << dev_est
+         << "  Full bw dev=" << tot_dev_est
+         << "  Carrier freq err=" << fqerr_est;
+      if (carrier_fq > 0.0)
+      {
+        int ppm_err =
+          static_cast<int>(round(1000000.0 * fqerr_est / carrier_fq));
+        os << "(" << ppm_err << "ppm)";
+      }
+    }
+
+      // Mean values over all measurement blocks, used when a whole capture
+      // file have been processed
+    size_t measurementCount(void) const { return meas_cnt; }
+    double meanDev(void) const { return dev_sum / meas_cnt; }
+    double meanTotDev(void) const { return tot_dev_sum / meas_cnt; }
+    double meanFqErr(void) const { return fqerr_sum / meas_cnt; }
+
     virtual int writeSamples(const float *samples, int count)
     {
       for (int i=0; i<count; ++i)
@@ -346,18 +373,14 @@ class DevPrinter : public AudioSink
           amp_sum = 0.0;
           fqerr_est = (1.0-ALPHA) * fqerr + ALPHA * fqerr_est;
 
+          ++meas_cnt;
+          dev_sum += dev;
+          tot_dev_sum += tot_dev;
+          fqerr_sum += fqerr;
+
           if (++block_cnt >= PRINT_INTERVAL)
           {
-            cout << "\r\033[K" "Tone dev=" << dev_est
-                 << "  Full bw dev=" << tot_dev_est 
-                 << "  Carrier freq err=" << fqerr_est;
-            if (carrier_fq > 0.0)
-            {
-              int ppm_err =
-                static_cast<int>(round(1000000.0 * fqerr_est / carrier_fq));
-              cout << "(" << ppm_err << "ppm)";
-            }
-            cout.flush();
+            measurementUpdated();
             block_cnt = 0;
           }
           for (size_t i=0; i<g.size(); ++i)
@@ -375,6 +398,8 @@ class DevPrinter : public AudioSink
       sourceAllSamplesFlushed();
     }
 
+    sigc::signal<void> measurementUpdated;
+
   private:
     static CONSTEXPR double ALPHA = 0.9;        //!< IIR filter coeff
     static CONSTEXPR size_t PRINT_INTERVAL = 5; //!< Block count
@@ -393,6 +418,10 @@ class DevPrinter : public AudioSink
     double        amp_sum;
     double        fqerr_est;
     double        carrier_fq;
+    size_t        meas_cnt;
+    double        dev_sum;
+    double        tot_dev_sum;
+    double        fqerr_sum;
 };
 
 
@@ -426,6 +455,8 @@ class DevMeasure : public sigc::trackable
       dev_print.writeSamples(&audio[0], audio.size());
     }
 
+    DevPrinter &printer(void) { return dev_print; }
+
   private:
     float         iold;
     float         qold;
@@ -434,6 +465,21 @@ class DevMeasure : public sigc::trackable
 };
 
 
+/**
+ * A receiver being calibrated or measured. More than one receiver can be
+ * calibrated at the same time, e.g. one for each channel of a multi channel
+ * sound card.
+ */
+struct RxCal
+{
+  string          name;
+  Rx              *rx;
+  LocalRxReplay   *replay;
+  DevPrinter      *dp;
+  float           preamp;
+};
+
+
 
 /****************************************************************************
  *
@@ -444,6 +490,10 @@ class DevMeasure : public sigc::trackable
 static void parse_arguments(int argc, const char **argv);
 static void stdin_handler(FdWatch *w);
 static void sigterm_handler(int signal);
+static void print_status(void);
+static void print_preamp(void);
+static bool run_capture(Config &cfg);
+static void print_results(void);
 
 
 /****************************************************************************
@@ -465,10 +515,10 @@ static string cfgfile;
 static string cfgsect;
 static FdWatch *stdin_watch = 0;
 static SineGenerator *gen = 0;
-static DevPrinter *dp = 0;
 static Tx *tx = 0;
-static Rx *rx = 0;
+static vector<RxCal> rx_cals;
 static float level_adjust_offset = 0.0f;
+static const char *capture_file = 0;
 static vector<float> mod_fqs;
 static const char *audio_dev = "alsa:default";
 static const unsigned audio_ch = 0;
@@ -560,55 +610,82 @@ int main(int argc, const char *argv[])
   }
   else if (cal_rx)
   {
-    cfg.getValue(cfgsect, "PREAMP", level_adjust_offset);
-    cout << "--- Initial PREAMP=" << level_adjust_offset << endl;
-
-    cout << "--- Setting SQL_DET=OPEN\n";
-    cfg.setValue(cfgsect, "SQL_DET", "OPEN");
-    cout << "--- Setting DTMF_MUTING=0\n";
-    cfg.setValue(cfgsect, "DTMF_MUTING", "0");
-
-    cout << "--- Use +, - and 0 to adjust PREAMP\n";
-
-    rx = RxFactory::createNamedRx(cfg, cfgsect);
-    if ((rx == 0) || !rx->initialize())
+    vector<string> rx_names;
+    SvxLink::splitStr(rx_names, cfgsect, ",");
+    for (size_t i=0; i<rx_names.size(); ++i)
     {
-      cerr << "*** ERROR: Could not initialize receiver object\n";
-      exit(1);
-    }
-    rx->setVerbose(false);
-    AudioSource *prev_src = rx;
-
-    AudioSplitter *splitter = new AudioSplitter;
-    prev_src->registerSink(splitter);
-    prev_src = splitter;
+      RxCal rc;
+      rc.name = rx_names[i];
+      rc.preamp = 0.0f;
+      cfg.getValue(rc.name, "PREAMP", rc.preamp);
+      cout << "--- Initial " << rc.name << "/PREAMP=" << rc.preamp << endl;
+
+      cout << "--- Setting " << rc.name << "/SQL_DET=OPEN\n";
+      cfg.setValue(rc.name, "SQL_DET", "OPEN");
+      cout << "--- Setting " << rc.name << "/DTMF_MUTING=0\n";
+      cfg.setValue(rc.name, "DTMF_MUTING", "0");
+
+        // When reading from a capture file the audio is written directly
+        // into a receiver chain, configured from the same section
+      rc.replay = 0;
+      if (capture_file != 0)
+      {
+        rc.replay = new LocalRxReplay(cfg, rc.name);
+        rc.rx = rc.replay;
+      }
+      else
+      {
+        rc.rx = RxFactory::createNamedRx(cfg, rc.name);
+      }
+      if ((rc.rx == 0) || !rc.rx->initialize())
+      {
+        cerr << "*** ERROR: Could not initialize receiver object "
+             << rc.name << "\n";
+        exit(1);
+      }
+      rc.rx->setVerbose(false);
+      AudioSource *prev_src = rc.rx;
 
-    if (!flat_fq_response)
-    {
-      PreemphasisFilter *preemph = new PreemphasisFilter;
-      prev_src->registerSink(preemph, true);
-      prev_src = preemph;
-    }
-    
-    dp = new DevPrinter(INTERNAL_SAMPLE_RATE, mod_fqs, maxdev, headroom_db);
-    prev_src->registerSink(dp, true);
-    prev_src = 0;
+      AudioSplitter *splitter = new AudioSplitter;
+      prev_src->registerSink(splitter);
+      prev_src = splitter;
 
-    if (audio_dev[0] != '\0')
-    {
-      audio_io = new AudioIO(audio_dev, audio_ch);
-      if (!audio_io->open(AudioIO::MODE_WR))
+      if (!flat_fq_response)
       {
-        cerr << "*** WARNING: Could not open audio output device \""
-             << audio_dev << "\"\n";
+        PreemphasisFilter *preemph = new PreemphasisFilter;
+        prev_src->registerSink(preemph, true);
+        prev_src = preemph;
       }
-      else
+
+      rc.dp = new DevPrinter(INTERNAL_SAMPLE_RATE, mod_fqs, maxdev,
+                             headroom_db);
+      prev_src->registerSink(rc.dp, true);
+      prev_src = 0;
+
+        // Only the audio from the first receiver is played back
+      if ((capture_file == 0) && rx_cals.empty() && (audio_dev[0] != '\0'))
       {
-        splitter->addSink(audio_io, true);
+        audio_io = new AudioIO(audio_dev, audio_ch);
+        if (!audio_io->open(AudioIO::MODE_WR))
+        {
+          cerr << "*** WARNING: Could not open audio output device \""
+               << audio_dev << "\"\n";
+        }
+        else
+        {
+          splitter->addSink(audio_io, true);
+        }
       }
-    }
 
-    rx->setMuteState(Rx::MUTE_NONE);
+      rc.rx->setMuteState(Rx::MUTE_NONE);
+      rx_cals.push_back(rc);
+    }
+    if (capture_file == 0)
+    {
+      cout << "--- Use +, - and 0 to adjust PREAMP\n";
+      rx_cals.front().dp->measurementUpdated.connect(
+          sigc::ptr_fun(&print_status));
+    }
   }
   else if (measure)
   {
@@ -621,9 +698,16 @@ int main(int argc, const char *argv[])
     {
       cout << "--- Setting " << wbrx_sect << "/SAMPLE_RATE to default value\n";
       cfg.setValue(wbrx_sect, "SAMPLE_RATE", "");
+      if (capture_file != 0)
+      {
+        cout << "--- Setting " << wbrx_sect << "/TYPE=RtlReplay and "
+             << wbrx_sect << "/FILE=" << capture_file << "\n";
+        cfg.setValue(wbrx_sect, "TYPE", "RtlReplay");
+        cfg.setValue(wbrx_sect, "FILE", capture_file);
+      }
     }
 
-    rx = RxFactory::createNamedRx(cfg, cfgsect);
+    Rx *rx = RxFactory::createNamedRx(cfg, cfgsect);
     if ((rx == 0) || !rx->initialize())
     {
       cerr << "*** ERROR: Could not initialize receiver object\n";
@@ -646,7 +730,20 @@ int main(int argc, const char *argv[])
                                              mod_fqs, ddr->nbFq());
     ddr->preDemod.connect(mem_fun(dev_measure, &DevMeasure::processPreDemod));
 
-    if (audio_dev[0] != '\0')
+    RxCal rc;
+    rc.name = cfgsect;
+    rc.rx = rx;
+    rc.replay = 0;
+    rc.dp = &dev_measure->printer();
+    rc.preamp = 0.0f;
+    rx_cals.push_back(rc);
+
+    if (capture_file == 0)
+    {
+      rc.dp->measurementUpdated.connect(sigc::ptr_fun(&print_status));
+    }
+
+    if ((capture_file == 0) && (audio_dev[0] != '\0'))
     {
       audio_io = new AudioIO(audio_dev, audio_ch);
       if (!audio_io->open(AudioIO::MODE_WR))
@@ -662,6 +759,17 @@ int main(int argc, const char *argv[])
     }
   }
 
+  if (capture_file != 0)
+  {
+    bool success = run_capture(cfg);
+    for (size_t i=0; i<rx_cals.size(); ++i)
+    {
+      delete rx_cals[i].rx;
+    }
+    cout.flags(old_cout_flags);
+    return success ? 0 : 1;
+  }
+
   cout << "--- Use Q or Ctrl+C to quit\n\n";
 
   struct termios org_termios;
@@ -682,7 +790,10 @@ int main(int argc, const char *argv[])
   }
   delete gen;
   delete tx;
-  delete rx;
+  for (size_t i=0; i<rx_cals.size(); ++i)
+  {
+    delete rx_cals[i].rx;
+  }
 
   delete stdin_watch;
   tcsetattr(STDIN_FILENO, TCSANOW, &org_termios);
@@ -744,12 +855,17 @@ static void parse_arguments(int argc, const char **argv)
             &audio_dev, 0,
 	    "The audio device to use for audio output",
             "<type:dev>"},
+    {"file", 'i', POPT_ARG_STRING, &capture_file, 0,
+	    "Measure on a capture file, as fast as possible, instead of on "
+            "live audio. An audio capture for -r, an I/Q capture for -M",
+            "<filename>"},
     {NULL, 0, 0, NULL, 0}
   };
   int err;
   
   optCon = poptGetContext(PROGRAM_NAME, argc, argv, optionsTable, 0);
-  poptSetOtherOptionHelp(optCon, "<config file> <config section>");
+  poptSetOtherOptionHelp(optCon,
+      "<config file> <config section>[,<config section>...]");
   poptReadDefaultConfig(optCon, 0);
   
   err = poptGetNextOpt(optCon);
@@ -789,6 +905,20 @@ static void parse_arguments(int argc, const char **argv)
     exit(1);
   }
 
+  if ((capture_file != 0) && cal_tx)
+  {
+    cerr << "*** ERROR: A capture file can only be used with the -r and -M "
+            "command line switches\n";
+    exit(1);
+  }
+
+  if ((cfgsect.find(',') != string::npos) && !cal_rx)
+  {
+    cerr << "*** ERROR: More than one configuration section can only be given "
+            "for receiver calibration\n";
+    exit(1);
+  }
+
   if (wb_mode)
   {
     if (!measure)
@@ -867,11 +997,12 @@ static void stdin_handler(FdWatch *w)
       }
       else if (cal_rx)
       {
-        double gain = dp->levelAdjust() + 0.01;
-        dp->adjustLevel(gain);
-        cout << "\r\033[K" "PREAMP="
-             << (dp->levelAdjust() + level_adjust_offset)
-             << endl;
+        for (size_t i=0; i<rx_cals.size(); ++i)
+        {
+          DevPrinter *dp = rx_cals[i].dp;
+          dp->adjustLevel(dp->levelAdjust() + 0.01);
+        }
+        print_preamp();
       }
       break;
     }
@@ -888,11 +1019,12 @@ static void stdin_handler(FdWatch *w)
       }
       else if (cal_rx)
       {
-        double gain = dp->levelAdjust() - 0.01;
-        dp->adjustLevel(gain);
-        cout << "\r\033[K" "PREAMP="
-             << (dp->levelAdjust() + level_adjust_offset)
-             << endl;
+        for (size_t i=0; i<rx_cals.size(); ++i)
+        {
+          DevPrinter *dp = rx_cals[i].dp;
+          dp->adjustLevel(dp->levelAdjust() - 0.01);
+        }
+        print_preamp();
       }
       break;
     }
@@ -908,10 +1040,11 @@ static void stdin_handler(FdWatch *w)
       }
       else if (cal_rx)
       {
-        dp->adjustLevel(-level_adjust_offset);
-        cout << "\r\033[K" "PREAMP="
-             << (dp->levelAdjust() + level_adjust_offset)
-             << endl;
+        for (size_t i=0; i<rx_cals.size(); ++i)
+        {
+          rx_cals[i].dp->adjustLevel(-rx_cals[i].preamp);
+        }
+        print_preamp();
       }
       break;
     }
@@ -952,6 +1085,155 @@ static void sigterm_handler(int signal)
 } /* sigterm_handler */
 
 
+static void print_status(void)
+{
+  cout << "\r\033[K";
+  for (size_t i=0; i<rx_cals.size(); ++i)
+  {
+    if (rx_cals.size() > 1)
+    {
+      cout << ((i > 0) ? "  |  " : "") << rx_cals[i].name << ": ";
+    }
+    rx_cals[i].dp->print(cout);
+  }
+  cout.flush();
+} /* print_status */
+
+
+static void print_preamp(void)
+{
+  cout << "\r\033[K";
+  for (size_t i=0; i<rx_cals.size(); ++i)
+  {
+    if (rx_cals.size() > 1)
+    {
+      cout << ((i > 0) ? "  " : "") << rx_cals[i].name << "/";
+    }
+    cout << "PREAMP=" << (rx_cals[i].dp->levelAdjust() + rx_cals[i].preamp);
+  }
+  cout << endl;
+} /* print_preamp */
+
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  run_capture
+ * Purpose:   Run the measurement on a capture file, as fast as possible,
+ *            instead of on live audio.
+ * Input:     cfg - The configuration object
+ * Output:    Returns true on success or else false
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2026-10-14
+ * Remarks:   For receiver calibration, channel N of the file is fed to
+ *            receiver N given on the command line. For deviation
+ *            measurement the I/Q file is replayed through the RtlReplay
+ *            device that the WbRx section was set up to use.
+ * Bugs:      
+ *----------------------------------------------------------------------------
+ */
+static bool run_capture(Config &cfg)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  unsigned long long frame_cnt = 0;
+  unsigned rate = INTERNAL_SAMPLE_RATE;
+  if (cal_rx)
+  {
+    CaptureFile file;
+    if (!file.open(capture_file, rx_cals.size()))
+    {
+      return false;
+    }
+    if (static_cast<size_t>(file.channels()) != rx_cals.size())
+    {
+      cerr << "*** ERROR: The capture file have " << file.channels()
+           << " channel(s) but " << rx_cals.size()
+           << " receiver(s) were given\n";
+      return false;
+    }
+    const int block_size = INTERNAL_SAMPLE_RATE / 100;
+    const int channels = file.channels();
+    vector<float> frames(block_size * channels);
+    vector<float> samples(block_size);
+    int cnt;
+    while ((cnt = file.read(&frames[0], block_size)) > 0)
+    {
+      for (int ch=0; ch<channels; ++ch)
+      {
+        for (int i=0; i<cnt; ++i)
+        {
+          samples[i] = frames[i * channels + ch];
+        }
+        rx_cals[ch].replay->write(&samples[0], cnt);
+      }
+      frame_cnt += cnt;
+    }
+  }
+  else
+  {
+    string wbrx_sect;
+    cfg.getValue(cfgsect, "WBRX", wbrx_sect);
+    WbRxRtlSdr *wbrx = WbRxRtlSdr::instance(cfg, wbrx_sect);
+    RtlReplay *replay = (wbrx != 0) ?
+        dynamic_cast<RtlReplay*>(wbrx->device()) : 0;
+    if (replay == 0)
+    {
+      cerr << "*** ERROR: Could not replay the I/Q capture file through "
+           << "receiver " << cfgsect << "\n";
+      return false;
+    }
+    rate = replay->sampleRate();
+    size_t cnt;
+    while ((cnt = replay->replayBlock()) > 0)
+    {
+      frame_cnt += cnt;
+    }
+  }
+
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double elapsed = (end.tv_sec - start.tv_sec) +
+                   (end.tv_nsec - start.tv_nsec) / 1.0e9;
+  double audio_time = static_cast<double>(frame_cnt) / rate;
+  cout << "--- Processed " << audio_time << "s of audio in " << elapsed
+       << "s";
+  if (elapsed > 0.0)
+  {
+    cout << " (" << (audio_time / elapsed) << "x realtime)";
+  }
+  cout << "\n\n";
+
+  print_results();
+
+  return true;
+} /* run_capture */
+
+
+static void print_results(void)
+{
+  for (size_t i=0; i<rx_cals.size(); ++i)
+  {
+    const RxCal &rc = rx_cals[i];
+    const DevPrinter *dp = rc.dp;
+    cout << "--- " << rc.name << ": ";
+    if (dp->measurementCount() == 0)
+    {
+      cout << "Capture too short for a measurement\n";
+      continue;
+    }
+    cout << "Mean tone dev=" << dp->meanDev()
+         << "  Full bw dev=" << dp->meanTotDev()
+         << "  Carrier freq err=" << dp->meanFqErr() << endl;
+    if (cal_rx && (dp->meanDev() > 0.0))
+    {
+      cout << "--- " << rc.name << ": Suggested PREAMP="
+           << (rc.preamp + 20.0 * log10(caldev / dp->meanDev())) << endl;
+    }
+  }
+} /* print_results */
+
+
 /*
  * This file has not been truncated
  */
@@ -6,6 +6,7 @@
 
 #include <AsyncCppApplication.h>
 #include <AsyncAudioIO.h>
+#include <AsyncAudioNoiseGenerator.h>
 #include <AsyncConfig.h>
 
 #include "../trx/Ptt.h"
@@ -71,20 +72,18 @@ class NoiseGenerator : public Async::AudioSource
   private:
     static const int BLOCK_SIZE = 128;
     
-    AudioIO   audio_io;
-    double    level;
-    int       sample_rate;
+    AudioIO             audio_io;
+    double              level;
+    int                 sample_rate;
+    AudioNoiseGenerator noise;
     
     void writeSamples(void)
     {
       int written;
       do {
 	float buf[BLOCK_SIZE];
-	for (int i=0; i<BLOCK_SIZE; ++i)
-	{
-            // coverity[dont_call]
-      	  buf[i] = level * static_cast<float>(rand()) / RAND_MAX;
-	}
+          // Gaussian noise with the peaks, at three sigma, at the level
+	noise.generate(buf, BLOCK_SIZE, level / 3.0);
 	written = sinkWriteSamples(buf, BLOCK_SIZE);
       } while (written != 0);
     }
@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iomanip>
 #include <sstream>
 #include <deque>
+#include <vector>
 
 
 /****************************************************************************
@@ -47,6 +48,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioProcessor.h>
 //#include <AsyncAudioClipper.h>
 #include <AsyncAudioFilter.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -83,52 +85,104 @@ using namespace Async;
  ****************************************************************************/
 
 namespace {
-  class Correlator : public AudioProcessor
+  /**
+   * Correlate the input signal with the mark and space tones over one
+   * symbol. The correlation is done with FIR filters, one for each of the
+   * sine and cosine components of the two tones. The filtering is done one
+   * whole block at a time with the sample loop innermost so that the
+   * compiler can vectorize it. The output is the normalized energy
+   * difference between the upper and lower tone, in the range [-1, 1].
+   */
+  class ToneCorrelator : public AudioProcessor
   {
     public:
-      Correlator(float f0, float f1, unsigned baudrate,
+      ToneCorrelator(float f0, float f1, unsigned baudrate,
           unsigned sample_rate=INTERNAL_SAMPLE_RATE)
-        : delay(0), head(0)
+        : N((sample_rate + baudrate / 2) / baudrate)
       {
-          // Calculate the optimum value for the delay
-        unsigned samples_per_symbol = sample_rate / baudrate;
-        double max_k_val = 0.0;
-        for (unsigned k=0; k<samples_per_symbol; ++k)
+        c0.resize(N);
+        s0.resize(N);
+        c1.resize(N);
+        s1.resize(N);
+        for (size_t k=0; k<N; ++k)
         {
-          double k_val = abs(cos(2.0 * M_PI * f0 * k / sample_rate)
-              - cos(2.0 * M_PI * f1 * k / sample_rate));
-          if (k_val > max_k_val)
-          {
-            max_k_val = k_val;
-            delay = k;
-          }
+          c0[k] = cos(2.0 * M_PI * f0 * (N - 1 - k) / sample_rate);
+          s0[k] = sin(2.0 * M_PI * f0 * (N - 1 - k) / sample_rate);
+          c1[k] = cos(2.0 * M_PI * f1 * (N - 1 - k) / sample_rate);
+          s1[k] = sin(2.0 * M_PI * f1 * (N - 1 - k) / sample_rate);
         }
-        cout << "### Delay: " << delay << endl;
-
-        buf = new float[delay];
-        memset(buf, 0, sizeof(float) * delay);
+        hist.assign(N - 1, 0.0f);
       }
 
-      ~Correlator(void)
-      {
-        delete [] buf;
-      }
+      ~ToneCorrelator(void) {}
 
     protected:
       void processSamples(float *out, const float *in, int len)
       {
-        for (int i=0; i<len; ++i)
+          // The history buffer holds the last N-1 samples from the previous
+          // block followed by the current block
+        hist.insert(hist.end(), in, in + len);
+        for (int i=0; i<len; i+=TILE)
+        {
+          const int n = (len - i < TILE) ? (len - i) : TILE;
+          float ac0[TILE] = {0.0f}, as0[TILE] = {0.0f};
+          float ac1[TILE] = {0.0f}, as1[TILE] = {0.0f};
+          if (n == TILE)
+          {
+            correlate<TILE>(&hist[i], ac0, as0, ac1, as1);
+          }
+          else
+          {
+            for (int j=0; j<n; ++j)
+            {
+              correlate<1>(&hist[i + j], ac0 + j, as0 + j, ac1 + j, as1 + j);
+            }
+          }
+          for (int j=0; j<n; ++j)
+          {
+            float e0 = ac0[j] * ac0[j] + as0[j] * as0[j];
+            float e1 = ac1[j] * ac1[j] + as1[j] * as1[j];
+            float sum = e0 + e1;
+            out[i + j] = (sum > 0.0f) ? (e1 - e0) / sum : 0.0f;
+          }
+        }
+        hist.erase(hist.begin(), hist.end() - (N - 1));
+      }
+
+    private:
+      static const int TILE = 16;
+
+        // Correlate W consecutive output samples. The taps are stored in
+        // reverse time order so x[k] is multiplied by tap N-1-k. With the
+        // output loop innermost and of fixed length the accumulators are
+        // kept in vector registers.
+      template <int W>
+      void correlate(const float *x, float *ac0, float *as0,
+                     float *ac1, float *as1) const
+      {
+        for (size_t k=0; k<N; ++k)
         {
-          out[i] = in[i] * buf[head];
-          buf[head] = in[i];
-          head = (head+1) % delay;
+          const float tc0 = c0[k];
+          const float ts0 = s0[k];
+          const float tc1 = c1[k];
+          const float ts1 = s1[k];
+          for (int j=0; j<W; ++j)
+          {
+            ac0[j] += x[k + j] * tc0;
+            as0[j] += x[k + j] * ts0;
+            ac1[j] += x[k + j] * tc1;
+            as1[j] += x[k + j] * ts1;
+          }
         }
       }
 
     private:
-      unsigned  delay;
-      float *   buf;
-      unsigned  head;
+      const size_t        N;
+      std::vector<float>  c0;
+      std::vector<float>  s0;
+      std::vector<float>  c1;
+      std::vector<float>  s1;
+      std::vector<float>  hist;
   };
 
 #if 0
@@ -165,7 +219,7 @@ namespace {
   {
     public:
       DcBlocker(size_t order)
-        : order(order), delay(order, 0.0f), prev(0.0f)
+        : order(order), delay(order, 0.0f), head(0), prev(0.0f)
       {
       }
 
@@ -186,19 +240,22 @@ namespace {
         for (int i=0; i<count; ++i)
         {
           float in = src[i];
-          float out = (in - delay.back()) / order + prev;
-          //dest[i] = delay[order/2]-out;
+          float out = (in - delay[head]) / order + prev;
           dest[i] = in-out;
           prev = out;
-          delay.pop_back();
-          delay.push_front(in);
+          delay[head] = in;
+          if (++head == order)
+          {
+            head = 0;
+          }
         }
       }
 
     private:
-      const size_t  order;
-      deque<float>  delay;
-      float         prev;
+      const size_t        order;
+      std::vector<float>  delay;
+      size_t              head;
+      float               prev;
 
   }; /* class DcBlocker */
 }; /* Anonymous namespace */
@@ -371,20 +428,11 @@ AfskDemodulator::AfskDemodulator(unsigned f0, unsigned f1, unsigned baudrate,
   }
 #endif
 
-    // Run the sample stream through the correlator
-  Correlator *corr = new Correlator(f0, f1, baudrate, sample_rate);
+    // Correlate the sample stream with the two tones
+  ToneCorrelator *corr = new ToneCorrelator(f0, f1, baudrate, sample_rate);
   prev_src->registerSink(corr, true);
   prev_src = corr;
 
-    // Low pass out the constant component from the correlator
-  stringstream ss("");
-  ss << "LpBu5/" << baudrate;
-  cout << "### Correlator filter: " << ss.str() << endl;
-  AudioFilter *corr_filter = new AudioFilter(ss.str(), sample_rate);
-  corr_filter->setOutputGain(10);
-  prev_src->registerSink(corr_filter, true);
-  prev_src = corr_filter;
-
   AudioSource::setHandler(prev_src);
 } /* AfskDemodulator::AfskDemodulator */
 
@@ -44,6 +44,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncAudioSink.h>
 #include <AsyncAudioSource.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -112,17 +113,13 @@ stream. The output is a sample stream of high and low DC values corresponding
 to the high and low AFSK frequencies. The demodulated sample stream will have
 to be bit synchronized and downsampled in the next stage.
 
-The method used to demodulate the signal is to correlate a sample with a
-previous sample of the same signal, an autocorrelation. This will produce the
-output signal consisting of the two DC levels. The delay used in the correlator
-is optimized to maximize the difference between the high and low frequencies.
-
-  cos(x) * cos(x-phi) =
-  cos(x) * (cos(x)*cos(phi) + sin(x)*sin(phi)) =
-  cos(x)*cos(x)*cos(phi) + cos(x)*sin(x)*sin(phi) =
-  0.5*cos(2x)*cos(phi) + 0.5*(1 - sin(2x))*sin(phi) =
-  [low pass filter to remote the 2x frequency component] =
-  0.5 * sin(phi)
+The signal is demodulated by correlating it with the two tones over one
+symbol period, using FIR filters for the sine and cosine component of each
+tone. The output is the normalized energy difference between the upper and
+lower tone, which will be in the range [-1, 1] independent of the input
+level. Samples are processed one block at a time and the filter loops are
+written so that the compiler can vectorize them, which makes it cheap to run
+several demodulators on the same receiver.
 
 */
 class AfskDemodulator : public Async::AudioSink, public Async::AudioSource
@@ -64,8 +64,6 @@ using namespace std;
  *
  ****************************************************************************/
 
-#define PPPINITFCS      0xffff	/* Initial FCS value */
-#define PPPGOODFCS      0xf0b8	/* Good final FCS value */
 
 
 /****************************************************************************
@@ -151,7 +149,7 @@ namespace {
  *
  ****************************************************************************/
 
-uint16_t fcsCalc(const std::vector<uint8_t> buf)
+uint16_t fcsCalc(const std::vector<uint8_t>& buf)
 {
   uint16_t fcs = PPPINITFCS;
   fcs = pppfcs(fcs, buf.data(), buf.size());
@@ -160,7 +158,7 @@ uint16_t fcsCalc(const std::vector<uint8_t> buf)
 } /* fcsCalc */
 
 
-bool fcsOk(const std::vector<uint8_t> buf)
+bool fcsOk(const std::vector<uint8_t>& buf)
 {
   uint16_t fcs = PPPINITFCS;
   fcs = pppfcs(fcs, buf.data(), buf.size());
@@ -168,6 +166,12 @@ bool fcsOk(const std::vector<uint8_t> buf)
 } /* fcsOk */
 
 
+uint16_t fcsUpdate(uint16_t fcs, uint8_t data)
+{
+  return (fcs >> 8) ^ fcstab[(fcs ^ data) & 0xff];
+} /* fcsUpdate */
+
+
 /****************************************************************************
  *
  * Private functions
@@ -86,6 +86,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#define PPPINITFCS      0xffff	/* Initial FCS value */
+#define PPPGOODFCS      0xf0b8	/* Good final FCS value */
+
 
 
 /****************************************************************************
@@ -107,14 +110,25 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  * @param   buf The buffer containing the data bytes
  * @return  Return the 16 bit frame check sequence
  */
-uint16_t fcsCalc(const std::vector<uint8_t> buf);
+uint16_t fcsCalc(const std::vector<uint8_t>& buf);
 
 /**
  * @brief   Check if the buffer contain a valid data stream
  * @param   buf The buffer containing the data bytes and the transmitted FCS
  * @return  Returns \em true on success or \em false on failure
  * */
-bool fcsOk(const std::vector<uint8_t> buf);
+bool fcsOk(const std::vector<uint8_t>& buf);
+
+/**
+ * @brief   Update a running frame check sequence with one more data byte
+ * @param   fcs The current FCS value, PPPINITFCS for the first byte
+ * @param   data The data byte
+ * @return  Returns the updated FCS value
+ *
+ * When all data bytes and the two transmitted FCS bytes have been fed
+ * through this function the result is PPPGOODFCS if the frame is valid.
+ */
+uint16_t fcsUpdate(uint16_t fcs, uint8_t data);
 
 
 //} /* namespace */
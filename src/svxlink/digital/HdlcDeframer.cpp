@@ -75,6 +75,87 @@ using namespace std;
  *
  ****************************************************************************/
 
+namespace {
+  /*
+   * What to do when receiving a nibble in a given bit stuffing state. The
+   * state is the number of consecutive ones received so far. There can be
+   * at most one flag per nibble since a flag closing zero must be preceded
+   * by six ones. Tables for one to three bits are used for the last bits of
+   * a bit vector that is not a multiple of four bits long.
+   */
+  struct NibbleAction
+  {
+    uint8_t ones;       // Consecutive ones after the nibble, max 7
+    uint8_t bits;       // Unstuffed data bits, LSB first
+    uint8_t bit_cnt;    // Number of unstuffed data bits
+    int8_t  flag_pos;   // Data bits before the flag closing zero, or -1
+  };
+
+  class NibbleTable
+  {
+    public:
+      NibbleTable(void)
+      {
+        for (unsigned len=1; len<=4; ++len)
+        {
+          for (unsigned state=0; state<STATES; ++state)
+          {
+            for (unsigned nibble=0; nibble<16; ++nibble)
+            {
+              build(tab[len-1][state][nibble], len, state, nibble);
+            }
+          }
+        }
+      }
+
+      const NibbleAction& operator()(unsigned len, uint8_t ones,
+                                     uint8_t nibble) const
+      {
+        return tab[len-1][ones][nibble];
+      }
+
+    private:
+      static const unsigned STATES = 8;
+      NibbleAction tab[4][STATES][16];
+
+      static void build(NibbleAction &a, unsigned len, unsigned state,
+                        unsigned nibble)
+      {
+        unsigned ones = state;
+        a.bits = 0;
+        a.bit_cnt = 0;
+        a.flag_pos = -1;
+        for (unsigned i=0; i<len; ++i)
+        {
+          bool bit = (nibble >> i) & 1;
+          if (bit)
+          {
+            ones = (ones < STATES-1) ? ones+1 : ones;
+          }
+          else if (ones == 5)
+          {
+              // Stuffed zero, throw it away
+            ones = 0;
+            continue;
+          }
+          else if (ones == 6)
+          {
+              // The closing zero of a flag is not stored as data
+            a.flag_pos = a.bit_cnt;
+            ones = 0;
+            continue;
+          }
+          else
+          {
+            ones = 0;
+          }
+          a.bits |= bit << a.bit_cnt;
+          a.bit_cnt += 1;
+        }
+        a.ones = ones;
+      }
+  };
+}; /* Anonymous namespace */
 
 
 /****************************************************************************
@@ -99,6 +180,9 @@ using namespace std;
  *
  ****************************************************************************/
 
+namespace {
+  const NibbleTable nibble_table;
+};
 
 
 /****************************************************************************
@@ -108,7 +192,8 @@ using namespace std;
  ****************************************************************************/
 
 HdlcDeframer::HdlcDeframer(void)
-  : state(STATE_SYNCHRONIZING), next_byte(0), bit_cnt(0), ones(0)
+  : state(STATE_SYNCHRONIZING), next_bits(0), bit_cnt(0), ones(0),
+    fcs(PPPINITFCS)
 {
 } /* HdlcDeframer::HdlcDeframer */
 
@@ -120,111 +205,29 @@ HdlcDeframer::~HdlcDeframer(void)
 
 void HdlcDeframer::bitsReceived(vector<bool> &bits)
 {
-  for (size_t i=0; i<bits.size(); ++i)
+  size_t i = 0;
+  while (i < bits.size())
   {
-    bool flag_detected = false;
-
-      // Undo bitstuffing. If we receive a zero and the previous five bits
-      // have been ones, the zero should be thrown away.
-    if (bits[i])
+      // Pack up to four bits into a nibble, LSB first
+    uint8_t nibble = 0;
+    size_t cnt = min(bits.size() - i, static_cast<size_t>(4));
+    for (size_t j=0; j<cnt; ++j)
     {
-      ones += 1;
+      nibble |= static_cast<uint8_t>(bits[i+j]) << j;
     }
-    else
+    i += cnt;
+
+    const NibbleAction &a = nibble_table(cnt, ones, nibble);
+    ones = a.ones;
+    if (a.flag_pos < 0)
     {
-      if (ones == 5)
-      {
-        ones = 0;
-        continue;
-      }
-      else if (ones == 6)
-      {
-        flag_detected = true;
-      }
-      ones = 0;
+      shiftIn(a.bits, a.bit_cnt);
     }
-
-    next_byte >>= 1;
-    next_byte |= (bits[i] << 7);
-    switch (state)
+    else
     {
-      case STATE_SYNCHRONIZING:
-        if (next_byte == 0x7e)
-        {
-          state = STATE_FRAME_START_WAIT;
-          bit_cnt = 0;
-        }
-        break;
-
-      case STATE_FRAME_START_WAIT:
-        if (++bit_cnt >= 8)
-        {
-          if (next_byte != 0x7e)
-          {
-            state = STATE_RECEIVING;
-            frame.clear();
-            frame.push_back(next_byte);
-          }
-          //frame.push_back(next_byte);
-          bit_cnt = 0;
-        }
-        else if (next_byte == 0x7e)
-        {
-          bit_cnt = 0;
-          //frame.clear();
-          //frame.push_back(next_byte);
-        }
-        break;
-
-      case STATE_RECEIVING:
-        if (++bit_cnt >= 8)
-        {
-          if (flag_detected)
-          {
-            state = STATE_FRAME_START_WAIT;
-            /*
-            for (size_t i=0; i<frame.size(); ++i)
-            {
-              if (isprint(frame[i]))
-              {
-                cout << setw(2) << setfill(' ') << (char)frame[i];
-              }
-              else
-              {
-                cout << hex << setw(2) << setfill('0')
-                     << (int)frame[i] << " ";
-              }
-            }
-            cout << endl << endl;
-            */
-            if ((frame.size() > 2) && fcsOk(frame))
-            {
-                // Remove CRC from frame
-              frame.pop_back();
-              frame.pop_back();
-              frameReceived(frame);
-            }
-          }
-          else
-          {
-            if(frame.size() < 330)
-            {
-              frame.push_back(next_byte);
-              next_byte = 0;
-            }
-            else
-            {
-              state = STATE_SYNCHRONIZING;
-            }
-          }
-          bit_cnt = 0;
-        }
-        else if (flag_detected)
-        {
-          state = STATE_FRAME_START_WAIT;
-          bit_cnt = 0;
-        }
-        break;
+      shiftIn(a.bits, a.flag_pos);
+      flagReceived();
+      shiftIn(a.bits >> a.flag_pos, a.bit_cnt - a.flag_pos);
     }
   }
 } /* HdlcDeframer::bitsReceived */
@@ -244,6 +247,82 @@ void HdlcDeframer::bitsReceived(vector<bool> &bits)
  *
  ****************************************************************************/
 
+void HdlcDeframer::shiftIn(uint8_t bits, uint8_t cnt)
+{
+  next_bits |= static_cast<uint16_t>(bits) << bit_cnt;
+  bit_cnt += cnt;
+  if (bit_cnt >= 8)
+  {
+    uint8_t data = next_bits & 0xff;
+    next_bits >>= 8;
+    bit_cnt -= 8;
+    byteReceived(data);
+  }
+} /* HdlcDeframer::shiftIn */
+
+
+void HdlcDeframer::flagReceived(void)
+{
+    // A frame is complete if the flag is byte aligned. The seven first bits
+    // of the flag have already been shifted in as data.
+  if ((state == STATE_RECEIVING) && (bit_cnt == 7) && (frame.size() > 2) &&
+      (fcs == PPPGOODFCS))
+  {
+    /*
+    for (size_t i=0; i<frame.size(); ++i)
+    {
+      if (isprint(frame[i]))
+      {
+        cout << setw(2) << setfill(' ') << (char)frame[i];
+      }
+      else
+      {
+        cout << hex << setw(2) << setfill('0')
+             << (int)frame[i] << " ";
+      }
+    }
+    cout << endl << endl;
+    */
+      // Remove CRC from frame
+    frame.pop_back();
+    frame.pop_back();
+    frameReceived(frame);
+  }
+  state = STATE_FRAME_START_WAIT;
+  next_bits = 0;
+  bit_cnt = 0;
+} /* HdlcDeframer::flagReceived */
+
+
+void HdlcDeframer::byteReceived(uint8_t data)
+{
+  switch (state)
+  {
+    case STATE_SYNCHRONIZING:
+      break;
+
+    case STATE_FRAME_START_WAIT:
+      state = STATE_RECEIVING;
+      frame.clear();
+      frame.push_back(data);
+      fcs = fcsUpdate(PPPINITFCS, data);
+      break;
+
+    case STATE_RECEIVING:
+      if (frame.size() < 330)
+      {
+        frame.push_back(data);
+        fcs = fcsUpdate(fcs, data);
+      }
+      else
+      {
+        state = STATE_SYNCHRONIZING;
+      }
+      break;
+  }
+} /* HdlcDeframer::byteReceived */
+
+
 
 
 /*
@@ -112,6 +112,11 @@ bitstream. An HDLC frame will start and end with one or more flag bytes,
 01111110. The content must be one or more data bytes followed by two CRC bytes
 (Frame Check Sequence). The deframed data bytes will be emitted without the CRC
 bytes.
+
+The bitstream is processed four bits at a time using a precomputed table
+that remove stuffed zeros and locate flags, so there is no per bit branching
+on the bit stuffing state. The frame check sequence is updated as each byte
+is received.
 */
 class HdlcDeframer : public sigc::trackable
 {
@@ -144,13 +149,17 @@ class HdlcDeframer : public sigc::trackable
     } State;
 
     State                 state;
-    uint8_t               next_byte;
+    uint16_t              next_bits;
     uint8_t               bit_cnt;
     std::vector<uint8_t>  frame;
-    unsigned              ones;
+    uint8_t               ones;
+    uint16_t              fcs;
 
     HdlcDeframer(const HdlcDeframer&);
     HdlcDeframer& operator=(const HdlcDeframer&);
+    void shiftIn(uint8_t bits, uint8_t cnt);
+    void flagReceived(void);
+    void byteReceived(uint8_t data);
 
 };  /* class HdlcDeframer */
 
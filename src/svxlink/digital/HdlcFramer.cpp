@@ -73,6 +73,62 @@ using namespace std;
  *
  ****************************************************************************/
 
+namespace {
+  /*
+   * The bit stuffed and NRZI encoded bits for a data byte, given the number
+   * of consecutive ones sent before it. A byte can get at most two stuffed
+   * zeros. The NRZI bits are for a line that was at space before the byte
+   * and have to be inverted if it was at mark.
+   */
+  struct ByteCode
+  {
+    uint16_t  nrzi;     // NRZI encoded bits, first bit in LSB
+    uint8_t   bit_cnt;  // Number of bits, 8-10
+    uint8_t   ones;     // Consecutive ones after the byte
+  };
+
+  class ByteCodeTable
+  {
+    public:
+      ByteCodeTable(void)
+      {
+        for (unsigned state=0; state<5; ++state)
+        {
+          for (unsigned data=0; data<256; ++data)
+          {
+            ByteCode &c = tab[state][data];
+            unsigned ones = state;
+            bool is_mark = false;
+            c.nrzi = 0;
+            c.bit_cnt = 0;
+            for (unsigned bit=0; bit<8; ++bit)
+            {
+              bool is_one = (data >> bit) & 1;
+              is_mark = is_one ? is_mark : !is_mark;
+              c.nrzi |= is_mark << c.bit_cnt++;
+              ones = is_one ? ones + 1 : 0;
+              if (ones == 5)
+              {
+                is_mark = !is_mark;
+                c.nrzi |= is_mark << c.bit_cnt++;
+                ones = 0;
+              }
+            }
+            c.ones = ones;
+          }
+        }
+      }
+
+      const ByteCode& operator()(unsigned ones, uint8_t data) const
+      {
+        return tab[ones][data];
+      }
+
+    private:
+      ByteCode tab[5][256];
+  };
+}; /* Anonymous namespace */
+
 
 
 /****************************************************************************
@@ -97,6 +153,10 @@ using namespace std;
  *
  ****************************************************************************/
 
+namespace {
+  const ByteCodeTable byte_code_table;
+};
+
 
 
 /****************************************************************************
@@ -120,17 +180,12 @@ void HdlcFramer::sendBytes(const vector<uint8_t> &frame)
 {
   vector<bool> bitbuf;
 
+  bitbuf.reserve(8 * (start_flag_cnt + 1) + 10 * (frame.size() + 2));
+
     // Store frame start flags
   for (size_t i=0; i<start_flag_cnt; ++i)
   {
-    bitbuf.push_back(!prev_was_mark);
-    bitbuf.push_back(!prev_was_mark);
-    bitbuf.push_back(!prev_was_mark);
-    bitbuf.push_back(!prev_was_mark);
-    bitbuf.push_back(!prev_was_mark);
-    bitbuf.push_back(!prev_was_mark);
-    bitbuf.push_back(!prev_was_mark);
-    bitbuf.push_back(prev_was_mark);
+    encodeFlag(bitbuf);
   }
 
     // Store frame data
@@ -145,14 +200,7 @@ void HdlcFramer::sendBytes(const vector<uint8_t> &frame)
   encodeByte(bitbuf, crc >> 8);
 
     // Store frame end flag
-  bitbuf.push_back(!prev_was_mark);
-  bitbuf.push_back(!prev_was_mark);
-  bitbuf.push_back(!prev_was_mark);
-  bitbuf.push_back(!prev_was_mark);
-  bitbuf.push_back(!prev_was_mark);
-  bitbuf.push_back(!prev_was_mark);
-  bitbuf.push_back(!prev_was_mark);
-  bitbuf.push_back(prev_was_mark);
+  encodeFlag(bitbuf);
 
   sendBits(bitbuf);
 } /* HdlcFramer::sendBytes */
@@ -174,33 +222,27 @@ void HdlcFramer::sendBytes(const vector<uint8_t> &frame)
 
 void HdlcFramer::encodeByte(vector<bool> &bitbuf, uint8_t data)
 {
-  for (size_t bit=0; bit<8; ++bit)
+  const ByteCode &c = byte_code_table(ones, data);
+  uint16_t nrzi = prev_was_mark ? ~c.nrzi : c.nrzi;
+  for (uint8_t bit=0; bit<c.bit_cnt; ++bit)
   {
-    bool is_one = (data & 0x01);
-    data >>= 1;
-
-    bool is_mark = is_one ? prev_was_mark : !prev_was_mark;
-    bitbuf.push_back(is_mark);
-
-    if (is_one)
-    {
-      if (++ones == 5)
-      {
-        bitbuf.push_back(!prev_was_mark);
-        is_mark = !prev_was_mark;
-        ones = 0;
-      }
-    }
-    else
-    {
-      ones = 0;
-    }
-
-    prev_was_mark = is_mark;
+    bitbuf.push_back((nrzi >> bit) & 1);
   }
+  prev_was_mark = (nrzi >> (c.bit_cnt - 1)) & 1;
+  ones = c.ones;
 } /* HdlcFramer::encodeByte */
 
 
+void HdlcFramer::encodeFlag(vector<bool> &bitbuf)
+{
+    // The flag, 01111110, toggles the line on the first and last bit so
+    // the line state is unchanged afterwards
+  bitbuf.insert(bitbuf.end(), 7, !prev_was_mark);
+  bitbuf.push_back(prev_was_mark);
+  ones = 0;
+} /* HdlcFramer::encodeFlag */
+
+
 /*
  * This file has not been truncated
  */
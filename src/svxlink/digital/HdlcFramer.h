@@ -163,6 +163,7 @@ class HdlcFramer : public sigc::trackable
     HdlcFramer(const HdlcFramer&);
     HdlcFramer& operator=(const HdlcFramer&);
     void encodeByte(std::vector<bool> &bitbuf, uint8_t data);
+    void encodeFlag(std::vector<bool> &bitbuf);
 
 };  /* class HdlcFramer */
 
@@ -110,7 +110,7 @@ Synchronizer::Synchronizer(unsigned baudrate, unsigned sample_rate)
     shift_pos(sample_rate / 2), pos(0), was_mark(false),
     last_stored_was_mark(false)
 {
-  bitbuf.reserve(8);
+  bitbuf.reserve(64);
 } /* Synchronizer::Synchronizer */
 
 
@@ -147,23 +147,17 @@ int Synchronizer::writeSamples(const float *samples, int len)
     {
       bitbuf.push_back(is_mark == last_stored_was_mark);
       last_stored_was_mark = is_mark;
-      if (bitbuf.size() >= 8)
-      {
-        /*
-        for (size_t i=0; i<bitbuf.size(); ++i)
-        {
-          cout << (bitbuf[i] ? '1' : '0');
-        }
-        float err_percent = 100.0 * static_cast<float>(err) / sample_rate;
-        cout << "  " << err << " " << err_percent << "%" << endl;
-        */
-        bitsReceived(bitbuf);
-        bitbuf.clear();
-      }
       pos -= sample_rate;
     }
   }
 
+    // All bits extracted from the block are delivered at once
+  if (!bitbuf.empty())
+  {
+    bitsReceived(bitbuf);
+    bitbuf.clear();
+  }
+
   return len;
 } /* Synchronizer::writeSamples */
 
@@ -45,6 +45,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncAudioSink.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -110,7 +111,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 Find the optimal sampling point in the incoming stream of samples to extract
 the embedded bitstream. The method used is to track zero crossings and adjust
-the sampling point if the zero crossing is too eary or late.
+the sampling point if the zero crossing is too eary or late. All bits
+extracted from a block of samples are emitted using one bitsReceived signal.
 */
 class Synchronizer : public Async::AudioSink, public sigc::trackable
 {
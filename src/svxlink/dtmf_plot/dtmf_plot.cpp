@@ -12,6 +12,7 @@
 
 #include <AsyncQtApplication.h>
 #include <AsyncAudioIO.h>
+#include <AsyncAudioSampleRate.h>
 #include <AsyncTimer.h>
 #include <AsyncAudioSplitter.h>
 #include <SigCAudioSink.h>
@@ -104,8 +104,9 @@ proc spellEchoLinkCallsign {call} {
     playMsg "conference"
     playSilence 50
     set lc_name [string tolower $name]
-    if [file exists "$langdir/EchoLink/conf-$lc_name.wav"] {
-      playFile "$langdir/EchoLink/conf-$lc_name.wav"
+    set clip [findSoundClip "$langdir/EchoLink/conf-$lc_name"]
+    if {$clip != ""} {
+      playFile $clip
     } else {
       spellEchoLinkCallsign $name
     }
@@ -49,18 +49,21 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncTimer.h>
 #include <AsyncConfig.h>
-#include <AsyncAudioSplitter.h>
 #include <AsyncAudioValve.h>
 #include <AsyncAudioSelector.h>
+#include <AsyncAudioDecimator.h>
+#include <AsyncAudioInterpolator.h>
 #include <EchoLinkDirectory.h>
 #include <EchoLinkDispatcher.h>
 #include <EchoLinkProxy.h>
+#include <EchoLinkConferenceEncoder.h>
 #include <LocationInfo.h>
 #include <common.h>
 
 
 #include <AsyncPty.h>
 #include <AsyncPtyStreamBuf.h>
+#include <AsyncAudioSampleRate.h>
 
 /****************************************************************************
  *
@@ -71,6 +74,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "version/MODULE_ECHO_LINK.h"
 #include "ModuleEchoLink.h"
 #include "QsoImpl.h"
+#include "multirate_filter_coeff.h"
 
 
 /****************************************************************************
@@ -158,7 +162,7 @@ ModuleEchoLink::ModuleEchoLink(void *dl_handle, Logic *logic,
     max_connections(1), max_qsos(1), talker(0), squelch_is_open(false),
     state(STATE_NORMAL), cbc_timer(0), dbc_timer(0), drop_incoming_regex(0),
     reject_incoming_regex(0), accept_incoming_regex(0),
-    reject_outgoing_regex(0), accept_outgoing_regex(0), splitter(0),
+    reject_outgoing_regex(0), accept_outgoing_regex(0), conf_encoder(0),
     listen_only_valve(0), selector(0), num_con_max(0), num_con_ttl(5*60),
     num_con_block_time(120*60), num_con_update_timer(0), reject_conf(false),
     autocon_echolink_id(0), autocon_time(DEFAULT_AUTOCON_TIME),
@@ -422,6 +426,9 @@ bool ModuleEchoLink::initialize(void)
   dir->stationListUpdated.connect(
       	  mem_fun(*this, &ModuleEchoLink::onStationListUpdated));
   dir->error.connect(mem_fun(*this, &ModuleEchoLink::onError));
+  bool directory_cache = false;
+  cfg().getValue(cfgName(), "DIRECTORY_CACHE", directory_cache);
+  dir->setDeltaUpdates(directory_cache);
   dir->makeOnline();
   
     // Start listening to the EchoLink UDP ports
@@ -442,17 +449,43 @@ bool ModuleEchoLink::initialize(void)
   }
 
     // Create audio pipe chain for audio transmitted to the remote EchoLink
-    // stations: <from core> -> Valve -> Splitter (-> QsoImpl ...)
+    // stations: <from core> -> Valve -> ConferenceEncoder (-> QsoImpl ...)
+    // The audio is encoded once for all connected stations.
   listen_only_valve = new AudioValve;
   AudioSink::setHandler(listen_only_valve);
-  
-  splitter = new AudioSplitter;
-  listen_only_valve->registerSink(splitter);
+  AudioSource *prev_src = listen_only_valve;
+
+  if (INTERNAL_SAMPLE_RATE == 16000)
+  {
+    AudioDecimator *down_sampler = new AudioDecimator(
+            2, coeff_16_8, coeff_16_8_taps);
+    prev_src->registerSink(down_sampler, true);
+    prev_src = down_sampler;
+  }
+
+  conf_encoder = new ConferenceEncoder;
+  conf_encoder->packetReady.connect(
+      mem_fun(*this, &ModuleEchoLink::sendEncodedAudio));
+  prev_src->registerSink(conf_encoder, true);
+  prev_src = 0;
 
     // Create audio pipe chain for audio received from the remove EchoLink
-    // stations: (QsoImpl -> ) Selector -> Fifo -> <to core>
+    // stations: (QsoImpl -> ) Selector (-> Interpolator) -> <to core>
+    // The QsoImpl objects deliver 8kHz audio so only the one selected stream
+    // is upsampled to the internal sample rate.
   selector = new AudioSelector;
-  AudioSource::setHandler(selector);
+  prev_src = selector;
+
+  if (INTERNAL_SAMPLE_RATE == 16000)
+  {
+    AudioInterpolator *up_sampler = new AudioInterpolator(
+            2, coeff_16_8, coeff_16_8_taps);
+    prev_src->registerSink(up_sampler, true);
+    prev_src = up_sampler;
+  }
+
+  AudioSource::setHandler(prev_src);
+  prev_src = 0;
   
     // Periodic updates of the "watch num connects" list
   if (num_con_max > 0)
@@ -611,6 +644,8 @@ void ModuleEchoLink::moduleCleanup(void)
   
   delete num_con_update_timer;
   num_con_update_timer = 0;
+  num_con_map.clear();
+  call_policy_cache.clear();
 
   if (accept_incoming_regex != 0)
   {
@@ -659,10 +694,9 @@ void ModuleEchoLink::moduleCleanup(void)
   autocon_timer = 0;
   
   AudioSink::clearHandler();
-  delete splitter;
-  splitter = 0;
   delete listen_only_valve;
   listen_only_valve = 0;
+  conf_encoder = 0;
   
   AudioSource::clearHandler();
   delete selector;
@@ -1053,11 +1087,22 @@ void ModuleEchoLink::onIncomingConnection(const IpAddress& ip,
   cout << "Incoming EchoLink connection from " << callsign
        << " (" << name << ") at " << ip << "\n";
   
-  if (regexec(drop_incoming_regex, callsign.c_str(), 0, 0, 0) == 0)
+    // The regex evaluation result is cached per callsign. Stations that
+    // were recently rejected are ignored for a while without creating a
+    // new Qso object or running the reject event handler again.
+  CallPolicy &policy = callPolicy(callsign);
+  if (policy.drop_incoming)
   {
     cerr << "*** WARNING: Dropping incoming connection due to configuration.\n";
     return;
   }
+
+  if (policy.ignore_until > time(0))
+  {
+    cerr << "*** WARNING: Ignoring incoming connection from " << callsign
+         << " since it was recently rejected\n";
+    return;
+  }
   
   if (qsos.size() >= max_connections)
   {
@@ -1119,7 +1164,6 @@ void ModuleEchoLink::onIncomingConnection(const IpAddress& ip,
       	  mem_fun(*this, &ModuleEchoLink::audioFromRemoteRaw));
   qso->destroyMe.connect(mem_fun(*this, &ModuleEchoLink::destroyQsoObject));
 
-  splitter->addSink(qso);
   selector->addSource(qso);
   selector->enableAutoSelect(qso, 0);
 
@@ -1132,15 +1176,16 @@ void ModuleEchoLink::onIncomingConnection(const IpAddress& ip,
     // Check if it is a station that connects very often senselessly
   if ((num_con_max > 0) && !numConCheck(callsign))
   {
+    policy.ignore_until = time(0) + num_con_block_time;
     qso->reject(false);
     return;
   }
 
-  if ((regexec(reject_incoming_regex, callsign.c_str(), 0, 0, 0) == 0) ||
-      (regexec(accept_incoming_regex, callsign.c_str(), 0, 0, 0) != 0) ||
+  if (policy.reject_incoming ||
       (reject_conf && (name.size() > 3) &&
        (name.rfind("CONF") == (name.size()-4))))
   {
+    policy.ignore_until = time(0) + REJECT_IGNORE_TIME;
     qso->reject(true);
     return;
   }
@@ -1372,7 +1417,6 @@ void ModuleEchoLink::destroyQsoObject(QsoImpl *qso)
   //cout << qso->remoteCallsign() << ": Destroying QSO object" << endl;
   string callsign = qso->remoteCallsign();
 
-  splitter->removeSink(qso);
   selector->removeSource(qso);
       
   vector<QsoImpl*>::iterator it = find(qsos.begin(), qsos.end(), qso);
@@ -1452,10 +1496,7 @@ void ModuleEchoLink::createOutgoingConnection(const StationData &station)
     return;
   }
 
-  if ((regexec(reject_outgoing_regex, station.callsign().c_str(),
-	       0, 0, 0) == 0) ||
-      (regexec(accept_outgoing_regex, station.callsign().c_str(),
-	       0, 0, 0) != 0))
+  if (callPolicy(station.callsign()).reject_outgoing)
   {
     cerr << "Rejecting outgoing connection to " << station.callsign() << " ("
 	 << station.id() << ")\n";
@@ -1524,7 +1565,6 @@ void ModuleEchoLink::createOutgoingConnection(const StationData &station)
       	    mem_fun(*this, &ModuleEchoLink::audioFromRemoteRaw));
     qso->destroyMe.connect(mem_fun(*this, &ModuleEchoLink::destroyQsoObject));
 
-    splitter->addSink(qso);
     selector->addSource(qso);
     selector->enableAutoSelect(qso, 0);
   }
@@ -1573,6 +1613,16 @@ void ModuleEchoLink::audioFromRemoteRaw(Qso::RawPacket *packet,
 } /* ModuleEchoLink::audioFromRemoteRaw */
 
 
+void ModuleEchoLink::sendEncodedAudio(void)
+{
+  vector<QsoImpl*>::iterator it;
+  for (it=qsos.begin(); it!=qsos.end(); ++it)
+  {
+    (*it)->sendEncodedAudio(conf_encoder);
+  }
+} /* ModuleEchoLink::sendEncodedAudio */
+
+
 QsoImpl *ModuleEchoLink::findFirstTalker(void) const
 {
   vector<QsoImpl*>::const_iterator it;
@@ -2138,10 +2188,16 @@ bool ModuleEchoLink::numConCheck(const std::string &callsign)
   struct timeval con_time;
   gettimeofday(&con_time, NULL);
 
-    // Refresh connect watch list
-  numConUpdate();
-
+    // Expired entries are handled on lookup so that the whole watch list
+    // does not have to be traversed on every connect. The periodic update
+    // timer takes care of removing entries that are not looked up again.
   NumConMap::iterator cit = num_con_map.find(callsign);
+  if ((cit != num_con_map.end()) && numConExpired(cit->second, con_time))
+  {
+    cout << "### Delete " << callsign << " from watchlist" << endl;
+    num_con_map.erase(cit);
+    cit = num_con_map.end();
+  }
   if (cit != num_con_map.end())
   {
       // Get an alias (reference) to the callsign and NumConStn objects
@@ -2201,18 +2257,8 @@ void ModuleEchoLink::numConUpdate(void)
     const string &t_callsign = (*cit).first;
     const NumConStn &stn = (*cit).second;
 
-    struct timeval remove_at = stn.last_con;
-    if (stn.num_con > num_con_max)
-    {
-      remove_at.tv_sec += num_con_block_time;
-    }
-    else
-    {
-      remove_at.tv_sec += num_con_ttl;
-    }
-
       // If the entry have timed out, delete it
-    if (timercmp(&remove_at, &now, <))
+    if (numConExpired(stn, now))
     {
       cout << "### Delete " << t_callsign << " from watchlist" << endl;
       num_con_map.erase(cit++);
@@ -2232,6 +2278,69 @@ void ModuleEchoLink::numConUpdate(void)
 } /* ModuleEchoLink::numConUpdate */
 
 
+bool ModuleEchoLink::numConExpired(const NumConStn &stn,
+                                   const struct timeval &now) const
+{
+  struct timeval remove_at = stn.last_con;
+  if (stn.num_con > num_con_max)
+  {
+    remove_at.tv_sec += num_con_block_time;
+  }
+  else
+  {
+    remove_at.tv_sec += num_con_ttl;
+  }
+  return timercmp(&remove_at, &now, <);
+} /* ModuleEchoLink::numConExpired */
+
+
+ModuleEchoLink::CallPolicy &ModuleEchoLink::callPolicy(
+                                                  const std::string &callsign)
+{
+  time_t now = time(0);
+  CallPolicyCache::iterator it = call_policy_cache.find(callsign);
+  if (it == call_policy_cache.end())
+  {
+    if (call_policy_cache.size() >= CALL_POLICY_CACHE_MAX)
+    {
+        // Remove entries that have not been used for a while. If that is
+        // not enough we are probably being flooded so just start over.
+      it = call_policy_cache.begin();
+      while (it != call_policy_cache.end())
+      {
+        if ((it->second.last_used + CALL_POLICY_TTL < now) &&
+            (it->second.ignore_until < now))
+        {
+          it = call_policy_cache.erase(it);
+        }
+        else
+        {
+          ++it;
+        }
+      }
+      if (call_policy_cache.size() >= CALL_POLICY_CACHE_MAX)
+      {
+        call_policy_cache.clear();
+      }
+    }
+
+    CallPolicy policy;
+    policy.drop_incoming =
+      (regexec(drop_incoming_regex, callsign.c_str(), 0, 0, 0) == 0);
+    policy.reject_incoming =
+      (regexec(reject_incoming_regex, callsign.c_str(), 0, 0, 0) == 0) ||
+      (regexec(accept_incoming_regex, callsign.c_str(), 0, 0, 0) != 0);
+    policy.reject_outgoing =
+      (regexec(reject_outgoing_regex, callsign.c_str(), 0, 0, 0) == 0) ||
+      (regexec(accept_outgoing_regex, callsign.c_str(), 0, 0, 0) != 0);
+    policy.ignore_until = 0;
+    it = call_policy_cache.insert(make_pair(callsign, policy)).first;
+  }
+  it->second.last_used = now;
+  return it->second;
+} /* ModuleEchoLink::callPolicy */
+
+
 void ModuleEchoLink::replaceAll(std::string &str, const std::string &from,
                                 const std::string &to) const
 {
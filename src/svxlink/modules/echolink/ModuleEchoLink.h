@@ -37,6 +37,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <string>
 #include <vector>
+#include <unordered_map>
 
 #include <sys/types.h>
 #include <regex.h>
@@ -72,7 +73,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 namespace Async
 {
   class Timer;
-  class AudioSplitter;
   class AudioValve;
   class AudioSelector;
   class Pty;
@@ -82,6 +82,7 @@ namespace EchoLink
   class Directory;
   class StationData;
   class Proxy;
+  class ConferenceEncoder;
 };
 
 
@@ -168,9 +169,21 @@ class ModuleEchoLink : public Module
 
       NumConStn(unsigned num, struct timeval &t) : num_con(num), last_con(t) {}
     };
-    typedef std::map<const std::string, NumConStn> NumConMap;
+    typedef std::unordered_map<std::string, NumConStn> NumConMap;
+    struct CallPolicy
+    {
+      bool    drop_incoming;
+      bool    reject_incoming;
+      bool    reject_outgoing;
+      time_t  ignore_until;
+      time_t  last_used;
+    };
+    typedef std::unordered_map<std::string, CallPolicy> CallPolicyCache;
 
     static const int	  DEFAULT_AUTOCON_TIME = 3*60*1000; // Three minutes
+    static const time_t   CALL_POLICY_TTL = 10*60;
+    static const size_t   CALL_POLICY_CACHE_MAX = 4096;
+    static const time_t   REJECT_IGNORE_TIME = 60;
 
     EchoLink::Directory   *dir;
     Async::Timer      	  *dir_refresh_timer;
@@ -198,7 +211,7 @@ class ModuleEchoLink : public Module
     regex_t   	      	  *reject_outgoing_regex;
     regex_t   	      	  *accept_outgoing_regex;
     EchoLink::StationData last_disc_stn;
-    Async::AudioSplitter  *splitter;
+    EchoLink::ConferenceEncoder *conf_encoder;
     Async::AudioValve 	  *listen_only_valve;
     Async::AudioSelector  *selector;
     unsigned              num_con_max;
@@ -206,6 +219,7 @@ class ModuleEchoLink : public Module
     time_t                num_con_block_time;
     NumConMap             num_con_map;
     Async::Timer          *num_con_update_timer;
+    CallPolicyCache       call_policy_cache;
     bool		  reject_conf;
     int   	      	  autocon_echolink_id;
     int   	      	  autocon_time;
@@ -245,6 +259,7 @@ class ModuleEchoLink : public Module
     int audioFromRemote(float *samples, int count, QsoImpl *qso);
     void audioFromRemoteRaw(EchoLink::Qso::RawPacket *packet,
       	      	      	    QsoImpl *qso);
+    void sendEncodedAudio(void);
     QsoImpl *findFirstTalker(void) const;
     void broadcastTalkerStatus(void);
     void updateDescription(void);
@@ -264,6 +279,8 @@ class ModuleEchoLink : public Module
     void checkAutoCon(Async::Timer *timer=0);
     bool numConCheck(const std::string &callsign);
     void numConUpdate(void);
+    bool numConExpired(const NumConStn &stn, const struct timeval &now) const;
+    CallPolicy &callPolicy(const std::string &callsign);
     void replaceAll(std::string &str, const std::string &from,
                     const std::string &to) const;
 
@@ -53,8 +53,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioPassthrough.h>
 #include <AsyncAudioFifo.h>
 #include <AsyncAudioDecimator.h>
-#include <AsyncAudioInterpolator.h>
 #include <AsyncAudioDebugger.h>
+#include <AsyncAudioSampleRate.h>
+#include <EchoLinkConferenceEncoder.h>
 
 #include <MsgHandler.h>
 #include <EventHandler.h>
@@ -211,12 +212,13 @@ QsoImpl::QsoImpl(const StationData &station, ModuleEchoLink *module)
   output_sel->enableAutoSelect(msg_pacer, 10);
   AudioSource *prev_src = output_sel;
 
-#if INTERNAL_SAMPLE_RATE == 16000
-  AudioDecimator *down_sampler = new AudioDecimator(
-          2, coeff_16_8, coeff_16_8_taps);
-  prev_src->registerSink(down_sampler, true);
-  prev_src = down_sampler;
-#endif
+  if (INTERNAL_SAMPLE_RATE == 16000)
+  {
+    AudioDecimator *down_sampler = new AudioDecimator(
+            2, coeff_16_8, coeff_16_8_taps);
+    prev_src->registerSink(down_sampler, true);
+    prev_src = down_sampler;
+  }
 
   prev_src->registerSink(&m_qso);
   prev_src = 0;
@@ -263,14 +265,10 @@ QsoImpl::QsoImpl(const StationData &station, ModuleEchoLink *module)
   input_fifo->setPrebufSamples(1024);
   prev_src->registerSink(input_fifo, true);
   prev_src = input_fifo;
-  
-#if INTERNAL_SAMPLE_RATE == 16000
-  AudioInterpolator *up_sampler = new AudioInterpolator(
-          2, coeff_16_8, coeff_16_8_taps);
-  prev_src->registerSink(up_sampler, true);
-  prev_src = up_sampler;
-#endif
 
+    // The audio is delivered at 8kHz. Upsampling to the internal sample rate
+    // is done once in the module, after the selector, so that only the audio
+    // stream that is actually used is resampled.
   AudioSource::setHandler(prev_src);
   
   init_ok = true;
@@ -322,6 +320,17 @@ bool QsoImpl::sendAudioRaw(Qso::RawPacket *packet)
 } /* QsoImpl::sendAudioRaw */
 
 
+bool QsoImpl::sendEncodedAudio(EchoLink::ConferenceEncoder *enc)
+{
+  if (msg_handler->isWritingMessage() ||
+      (m_qso.currentState() != Qso::STATE_CONNECTED))
+  {
+    return true;
+  }
+  return m_qso.sendAudioRaw(enc->packet(m_qso.remoteUsesSpeex()));
+} /* QsoImpl::sendEncodedAudio */
+
+
 bool QsoImpl::connect(void)
 {
   if (destroy_timer != 0)
@@ -74,6 +74,11 @@ namespace Async
   class AudioPassthrough;
 };
 
+namespace EchoLink
+{
+  class ConferenceEncoder;
+};
+
 
 /****************************************************************************
  *
@@ -167,6 +172,17 @@ class QsoImpl
      * audioReceivedRaw signal.
      */
     bool sendAudioRaw(EchoLink::Qso::RawPacket *packet);
+
+    /**
+     * @brief 	Send the current packet from a conference encoder
+     * @param 	enc The encoder holding the packet to send
+     * @return	Returns \em true on success or else \em false
+     *
+     * This function is used to send local audio that is encoded once for
+     * all connected stations. Nothing is sent while a message is being
+     * played to the remote station.
+     */
+    bool sendEncodedAudio(EchoLink::ConferenceEncoder *enc);
     
     /**
      * @brief 	Initiate a connection to the remote station
@@ -48,6 +48,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioJitterFifo.h>
 #include <AsyncAudioDecimator.h>
 #include <AsyncAudioInterpolator.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -200,29 +201,35 @@ bool ModuleFrn::initialize(void)
 
   AudioSink::setHandler(audio_valve);
   audio_valve->registerSink(audio_splitter);
-#if INTERNAL_SAMPLE_RATE == 16000
-  AudioDecimator *down_sampler = new AudioDecimator(
-      2, coeff_16_8, coeff_16_8_taps);
-  audio_splitter->addSink(down_sampler, true);
-  down_sampler->registerSink(qso);
-#else
-  audio_splitter->addSink(qso);
-#endif
+  if (INTERNAL_SAMPLE_RATE == 16000)
+  {
+    AudioDecimator *down_sampler = new AudioDecimator(
+        2, coeff_16_8, coeff_16_8_taps);
+    audio_splitter->addSink(down_sampler, true);
+    down_sampler->registerSink(qso);
+  }
+  else
+  {
+    audio_splitter->addSink(qso);
+  }
 
   // frn -> rig/speaker
   audio_selector = new AudioSelector;
   audio_fifo = new Async::AudioFifo(100 * 320 * 5);
 
-#if INTERNAL_SAMPLE_RATE == 16000
-  AudioInterpolator *up_sampler = new AudioInterpolator(
-      2, coeff_16_8, coeff_16_8_taps);
-  qso->registerSink(up_sampler, true);
-  audio_selector->addSource(up_sampler);
-  audio_selector->enableAutoSelect(up_sampler, 0);
-#else
-  audio_selector->addSource(qso);
-  audio_selector->enableAutoSelect(qso, 0);
-#endif
+  if (INTERNAL_SAMPLE_RATE == 16000)
+  {
+    AudioInterpolator *up_sampler = new AudioInterpolator(
+        2, coeff_16_8, coeff_16_8_taps);
+    qso->registerSink(up_sampler, true);
+    audio_selector->addSource(up_sampler);
+    audio_selector->enableAutoSelect(up_sampler, 0);
+  }
+  else
+  {
+    audio_selector->addSource(qso);
+    audio_selector->enableAutoSelect(qso, 0);
+  }
   audio_fifo->registerSource(audio_selector);
   AudioSource::setHandler(audio_fifo);
 
@@ -40,6 +40,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sigc++/bind.h>
 #include <sstream>
 #include <regex.h>
+#include <sys/uio.h>
 
 
 /****************************************************************************
@@ -56,6 +57,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioInterpolator.h>
 #include <AsyncAudioDebugger.h>
 #include <AsyncTcpClient.h>
+#include <AsyncAudioSampleOps.h>
 #include <AsyncTimer.h>
 
 
@@ -137,6 +139,7 @@ QsoFrn::QsoFrn(ModuleFrn *module)
   , state(STATE_DISCONNECTED)
   , connect_retry_cnt(0)
   , send_buffer_cnt(0)
+  , tx_batch_cnt(0)
   , gsmh(gsm_create())
   , lines_to_read(-1)
   , is_receiving_voice(false)
@@ -386,16 +389,12 @@ int QsoFrn::writeSamples(const float *samples, int count)
   while (samples_read < count)
   {
     int read_cnt = min(BUFFER_SIZE - send_buffer_cnt, count-samples_read);
-    for (int i = 0; i < read_cnt; i++)
-    {
-      float sample = samples[samples_read++];
-      if (sample > 1)
-        send_buffer[send_buffer_cnt++] = 32767;
-      else if (sample < -1)
-        send_buffer[send_buffer_cnt++] = -32767;
-      else
-        send_buffer[send_buffer_cnt++] = static_cast<int16_t>(32767.0 * sample);
-    }
+      // Mixing into a zeroed buffer gives a clipped conversion
+    memset(send_buffer + send_buffer_cnt, 0, read_cnt * sizeof(*send_buffer));
+    AudioSampleOps::mixFloatToS16(send_buffer + send_buffer_cnt,
+        samples + samples_read, read_cnt);
+    send_buffer_cnt += read_cnt;
+    samples_read += read_cnt;
     if (send_buffer_cnt == BUFFER_SIZE)
     {
       if (state == STATE_TX_AUDIO)
@@ -410,6 +409,7 @@ int QsoFrn::writeSamples(const float *samples, int count)
       }
     }
   }
+  flushVoiceData();
   return samples_read;
 }
 
@@ -428,6 +428,7 @@ void QsoFrn::flushSamples(void)
 
       sendVoiceData(send_buffer, send_buffer_cnt);
       send_buffer_cnt = 0;
+      flushVoiceData();
     }
     sendRequest(RQ_RX0);
   }
@@ -509,9 +510,12 @@ void QsoFrn::sendVoiceData(short *data, int len)
 {
   assert(len == BUFFER_SIZE);
 
-  size_t nbytes = 0;
-  unsigned char gsm_data[FRN_AUDIO_PACKET_SIZE];
+  if (tx_batch_cnt == TX_BATCH_SIZE)
+  {
+    flushVoiceData();
+  }
 
+  unsigned char *gsm_data = tx_batch[tx_batch_cnt++];
   for (int nframe = 0; nframe < FRAME_COUNT; nframe++)
   {
     short * src = data + nframe * PCM_FRAME_SIZE;
@@ -520,12 +524,41 @@ void QsoFrn::sendVoiceData(short *data, int len)
     // GSM_OPT_WAV49, produce alternating frames 32, 33, 32, 33, ..
     gsm_encode(gsmh, src, dst);
     gsm_encode(gsmh, src + PCM_FRAME_SIZE / 2, dst + 32);
+  }
+}
+
 
-    nbytes += GSM_FRAME_SIZE;
+void QsoFrn::flushVoiceData(void)
+{
+  if (tx_batch_cnt == 0)
+  {
+    return;
+  }
+
+  // Each packet is sent as a TX1 request directly followed by the five GSM
+  // frames, as expected by the server. All packets go out in one write.
+  static char tx1_req[] = "TX1\r\n";
+  struct iovec iov[2 * TX_BATCH_SIZE];
+  size_t nbytes = 0;
+  for (int i = 0; i < tx_batch_cnt; i++)
+  {
+    iov[2 * i].iov_base = tx1_req;
+    iov[2 * i].iov_len = sizeof(tx1_req) - 1;
+    iov[2 * i + 1].iov_base = tx_batch[i];
+    iov[2 * i + 1].iov_len = FRN_AUDIO_PACKET_SIZE;
+    nbytes += sizeof(tx1_req) - 1 + FRN_AUDIO_PACKET_SIZE;
+    if (opt_frn_debug)
+      cout << "req:   TX1" << endl;
+  }
+  int iovcnt = 2 * tx_batch_cnt;
+  tx_batch_cnt = 0;
+
+  if (!tcp_client->isConnected())
+  {
+    return;
   }
-  sendRequest(RQ_TX1);
-  size_t written = tcp_client->write(gsm_data, nbytes);
-  if (written != nbytes)
+  int written = tcp_client->write(iov, iovcnt);
+  if (written != static_cast<int>(nbytes))
   {
     cerr << "not all voice data was written to FRN: "
          << written << "\\" << nbytes << endl;
@@ -634,8 +667,7 @@ int QsoFrn::handleAudioData(unsigned char *data, int len)
       if (!is_gsm_decode_success)
         cerr << "gsm decoder failed to decode frame " << frameno << endl;
 
-      for (int i = 0; i < PCM_FRAME_SIZE; i++)
-         pcm_samples[i] = static_cast<float>(pcm_buffer[i]) / 32768.0;
+      AudioSampleOps::s16ToFloat(pcm_samples, pcm_buffer, PCM_FRAME_SIZE);
 
       int all_written = 0;
       while (all_written < PCM_FRAME_SIZE)
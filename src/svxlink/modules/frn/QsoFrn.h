@@ -375,13 +375,21 @@ class QsoFrn
     void login(void);
 
     /**
-     * @brief Sends pcm raw frames to FRN server
+     * @brief Encodes pcm raw frames and queues them for the FRN server
+     *
+     * The encoded packet is sent by flushVoiceData, together with the other
+     * packets encoded since the last flush, using a single TCP write.
      *
      * @param Pcm buffer with samples
      * @param Size of buffer
      */
     void sendVoiceData(short *data, int len);
 
+    /**
+     * @brief Sends all queued voice packets to the FRN server
+     */
+    void flushVoiceData(void);
+
     /**
      * @brief Sends FRN client request to the server
      *
@@ -528,6 +536,7 @@ class QsoFrn
     static const int        GSM_FRAME_SIZE          = 65;     // WAV49 has 65
     static const int        BUFFER_SIZE             = FRAME_COUNT*PCM_FRAME_SIZE;
     static const int        FRN_AUDIO_PACKET_SIZE   = FRAME_COUNT*GSM_FRAME_SIZE;
+    static const int        TX_BATCH_SIZE           = 4;
 
     static const int        CON_TIMEOUT_TIME        = 30000;
     static const int        RX_TIMEOUT_TIME         = 1000;
@@ -550,6 +559,8 @@ class QsoFrn
     short               receive_buffer[BUFFER_SIZE];
     short               send_buffer[BUFFER_SIZE];
     int                 send_buffer_cnt;
+    unsigned char       tx_batch[TX_BATCH_SIZE][FRN_AUDIO_PACKET_SIZE];
+    int                 tx_batch_cnt;
     gsm                 gsmh;
     int                 lines_to_read;
     FrnList             cur_item_list;
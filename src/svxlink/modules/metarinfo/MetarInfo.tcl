@@ -741,7 +741,7 @@ proc icao_available {} {
 # announce airport at the beginning of the MEATAR
 proc announce_airport {icao} {
   global langdir;
-  if [file exists "$langdir/MetarInfo/$icao.wav"] {
+  if {[findSoundClip "$langdir/MetarInfo/$icao"] != ""} {
     playMsg $icao;
   } else {
     spellWord $icao;
@@ -764,8 +764,9 @@ proc airports args {
      if {[regexp {(\d+)} $item tval]} {
        sayNumber $tval;
      } else {
-       if [file exists "$langdir/MetarInfo/$item.wav"] {
-         playFile "$langdir/MetarInfo/$item.wav";
+       set clip [findSoundClip "$langdir/MetarInfo/$item"];
+       if {$clip != ""} {
+         playFile $clip;
        } else {
          spellWord $item;
        }
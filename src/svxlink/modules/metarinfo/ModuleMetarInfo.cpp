@@ -40,7 +40,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sstream>
 #include <time.h>
 #include <algorithm>
-#include <queue>
+#include <stdio.h>
 #include <regex.h>
 
 
@@ -165,15 +165,24 @@ class ModuleMetarInfo::Http : public sigc::trackable
      Async::FdWatch wr;
    };
    typedef std::map<int, WatchSet> WatchMap;
-   CURLM* multi_handle; 
+   struct Request
+   {
+     std::string         url;
+     struct curl_slist*  headers;
+     std::string         body;
+     std::string         etag;
+     std::string         last_modified;
+   };
+   typedef std::map<CURL*, Request> RequestMap;
+   static const long REQUEST_TIMEOUT = 30;
+   CURLM* multi_handle;
    Async::Timer update_timer;
    WatchMap watch_map;
-   std::queue<CURL*> url_queue;
-   CURL* pending_curl;
+   RequestMap requests;
 
   public:
 
-   Http() : multi_handle(0), pending_curl(0)
+   Http() : multi_handle(0)
    {
      multi_handle = curl_multi_init();
      long curl_timeout = -1;
@@ -185,73 +194,31 @@ class ModuleMetarInfo::Http : public sigc::trackable
 
    ~Http()
    {
-     if (pending_curl)
-       curl_easy_cleanup(pending_curl);
-     while (!url_queue.empty())
+     for (RequestMap::iterator it = requests.begin(); it != requests.end();
+          ++it)
      {
-       curl_easy_cleanup(url_queue.front());
-       url_queue.pop();
+       curl_multi_remove_handle(multi_handle, it->first);
+       curl_slist_free_all(it->second.headers);
+       curl_easy_cleanup(it->first);
      }
      disableAllWatches();
      curl_multi_cleanup(multi_handle);
    } /* ~Http */
 
-   // a signal when a metar has been available
-   sigc::signal<void, std::string, size_t> metarInfo;
-
-   // a signal when a metar has a timeout
-   sigc::signal<void> metarTimeout;
-
+   // a signal when a request has finished. The response code is zero if
+   // the transfer failed.
+   sigc::signal<void, const std::string&, long, const std::string&,
+                const std::string&, const std::string&> requestDone;
 
    // update the html handler periodically
    void onTimeout(Async::Timer *timer)
    {
-     int handle_count;
-     curl_multi_perform(multi_handle, &handle_count);
-     if (handle_count == 0) 
-     {
-       disableAllWatches();
-       curl_easy_cleanup(pending_curl);
-       if (url_queue.empty())
-       {
-         pending_curl = 0;
-         update_timer.setEnable(false);
-       }
-       else
-       {
-         pending_curl = url_queue.front();
-         url_queue.pop();
-         curl_multi_add_handle(multi_handle, pending_curl);
-         update_timer.setEnable(true);
-       }
-     }
-     updateWatchMap();
-     update_timer.reset();
+     perform();
    } /* Update */
 
    void onActivity(Async::FdWatch *watch)
    {
-     int handle_count;
-     curl_multi_perform(multi_handle, &handle_count);
-     if (handle_count == 0)
-     {
-       disableAllWatches();
-       curl_easy_cleanup(pending_curl);
-       if (url_queue.empty())
-       {
-         pending_curl = 0;
-         update_timer.setEnable(false);
-       }
-       else
-       {
-         pending_curl = url_queue.front();
-         url_queue.pop();
-         curl_multi_add_handle(multi_handle, pending_curl);
-         updateWatchMap();
-         update_timer.setEnable(true);
-       }
-     }
-     update_timer.reset();
+     perform();
    } /* onActivity */
 
    static size_t callback(char *contents, size_t size, size_t nmemb,
@@ -259,34 +226,114 @@ class ModuleMetarInfo::Http : public sigc::trackable
    {
      if (userp == NULL) return 0;
      size_t written = size * nmemb;
-     std::string html((const char *)contents, written);
-     static_cast<Http*>(userp)->metarInfo(html, html.size());
+     static_cast<Request*>(userp)->body.append(contents, written);
      return written;
    } /* callback */
 
-   void AddRequest(const char* uri)
+   static size_t headerCallback(char *contents, size_t size, size_t nmemb,
+                                void *userp)
    {
-     CURL* curl = curl_easy_init();
-     curl_easy_setopt(curl, CURLOPT_URL, uri);
-     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &Http::callback);
-     curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+     if (userp == NULL) return 0;
+     size_t written = size * nmemb;
+     std::string line(contents, written);
+     size_t colon = line.find(':');
+     if (colon != std::string::npos)
+     {
+       std::string name(line, 0, colon);
+       transform(name.begin(), name.end(), name.begin(),
+                 (int(*)(int))tolower);
+       size_t begin = line.find_first_not_of(" \t", colon + 1);
+       size_t end = line.find_last_not_of(" \t\r\n");
+       std::string value;
+       if ((begin != std::string::npos) && (end >= begin))
+       {
+         value = line.substr(begin, end - begin + 1);
+       }
+       Request *req = static_cast<Request*>(userp);
+       if (name == "etag")
+       {
+         req->etag = value;
+       }
+       else if (name == "last-modified")
+       {
+         req->last_modified = value;
+       }
+     }
+     return written;
+   } /* headerCallback */
 
-     if (!pending_curl)
+   void AddRequest(const std::string& uri, const std::string& etag="",
+                   const std::string& last_modified="")
+   {
+     CURL* curl = curl_easy_init();
+     Request& req = requests[curl];
+     req.url = uri;
+     req.headers = 0;
+     if (!etag.empty())
      {
-       pending_curl = curl;
-       curl_multi_add_handle(multi_handle, pending_curl);
-       updateWatchMap();
-       update_timer.reset();
-       update_timer.setEnable(true);
+       req.headers = curl_slist_append(req.headers,
+                                       ("If-None-Match: " + etag).c_str());
      }
-     else
+     if (!last_modified.empty())
      {
-       url_queue.push(curl);
+       req.headers = curl_slist_append(req.headers,
+           ("If-Modified-Since: " + last_modified).c_str());
      }
+     curl_easy_setopt(curl, CURLOPT_URL, req.url.c_str());
+     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &Http::callback);
+     curl_easy_setopt(curl, CURLOPT_WRITEDATA, &req);
+     curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &Http::headerCallback);
+     curl_easy_setopt(curl, CURLOPT_HEADERDATA, &req);
+     curl_easy_setopt(curl, CURLOPT_TIMEOUT, REQUEST_TIMEOUT);
+     curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+     if (req.headers != 0)
+     {
+       curl_easy_setopt(curl, CURLOPT_HTTPHEADER, req.headers);
+     }
+     curl_multi_add_handle(multi_handle, curl);
+     perform();
    } /* AddRequest */
 
   private:
 
+   void perform(void)
+   {
+     int handle_count;
+     curl_multi_perform(multi_handle, &handle_count);
+
+     CURLMsg *msg;
+     int msgs_left;
+     while ((msg = curl_multi_info_read(multi_handle, &msgs_left)) != 0)
+     {
+       if (msg->msg != CURLMSG_DONE)
+       {
+         continue;
+       }
+       CURL *curl = msg->easy_handle;
+       long code = 0;
+       if (msg->data.result == CURLE_OK)
+       {
+         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+       }
+       else
+       {
+         std::cerr << "*** WARNING: METAR request failed: "
+                   << curl_easy_strerror(msg->data.result) << std::endl;
+       }
+       curl_multi_remove_handle(multi_handle, curl);
+       RequestMap::iterator it = requests.find(curl);
+       Request req = it->second;
+       requests.erase(it);
+       curl_slist_free_all(req.headers);
+       curl_easy_cleanup(curl);
+       requestDone(req.url, code, req.body, req.etag, req.last_modified);
+     }
+
+     updateWatchMap();
+     update_timer.setEnable(!requests.empty());
+     update_timer.reset();
+   } /* perform */
+
    void updateWatchMap()
    {
      fd_set fdread;
@@ -299,34 +346,46 @@ class ModuleMetarInfo::Http : public sigc::trackable
      FD_ZERO(&fdexcep);
      curl_multi_fdset(multi_handle, &fdread, &fdwrite, &fdexcep, &maxfd);
 
+       // Disable watches for file descriptors no longer in use by curl
+     for (WatchMap::iterator it = watch_map.begin(); it != watch_map.end();
+          ++it)
+     {
+       int fd = it->first;
+       if ((fd > maxfd) || !FD_ISSET(fd, &fdread))
+       {
+         it->second.rd.setEnabled(false);
+       }
+       if ((fd > maxfd) || !FD_ISSET(fd, &fdwrite))
+       {
+         it->second.wr.setEnabled(false);
+       }
+     }
+
      for (int fd = 0; fd <= maxfd; fd++) 
      {
        bool read_isset = FD_ISSET(fd, &fdread);
        bool write_isset = FD_ISSET(fd, &fdwrite);
-       WatchSet *ws = 0;
-       WatchMap::iterator it = watch_map.find(fd);
-       if (it != watch_map.end())
+       if (!(read_isset || write_isset))
        {
-         ws = &(it->second);
+         continue;
        }
-       else
+       WatchMap::iterator it = watch_map.find(fd);
+       if (it == watch_map.end())
        {
-         if (!(read_isset || write_isset))
-         {
-           continue;
-         }
-         ws = &(watch_map[fd]);
+         WatchSet& ws = watch_map[fd];
+         ws.rd.activity.connect(mem_fun(*this, &Http::onActivity));
+         ws.wr.activity.connect(mem_fun(*this, &Http::onActivity));
+         it = watch_map.find(fd);
        }
+       WatchSet *ws = &(it->second);
        if (read_isset && !ws->rd.isEnabled())
        {
          ws->rd.setFd(fd, Async::FdWatch::FD_WATCH_RD);
-         ws->rd.activity.connect(mem_fun(*this, &Http::onActivity));
          ws->rd.setEnabled(true);
        }
        if (write_isset && !ws->wr.isEnabled())
        {
          ws->wr.setFd(fd, Async::FdWatch::FD_WATCH_WR);
-         ws->wr.activity.connect(mem_fun(*this, &Http::onActivity));
          ws->wr.setEnabled(true);
        }
      }
@@ -344,6 +403,168 @@ class ModuleMetarInfo::Http : public sigc::trackable
 };
 
 
+/*
+ * A process wide cache of METAR reports, shared by all instances of this
+ * module. Reports are cached per URL (server, link and ICAO code) until a
+ * new observation can be expected. Simultaneous requests for the same URL
+ * are merged into one transfer and an expired report is revalidated using
+ * a conditional request.
+ */
+class ModuleMetarInfo::MetarCache : public sigc::trackable
+{
+  public:
+   typedef sigc::signal<void, bool, const std::string&> DoneSignal;
+
+   static MetarCache* acquire(void)
+   {
+     if (instance == 0)
+     {
+       instance = new MetarCache;
+     }
+     ++ref_cnt;
+     return instance;
+   } /* acquire */
+
+   static void release(void)
+   {
+     if (--ref_cnt == 0)
+     {
+       delete instance;
+       instance = 0;
+     }
+   } /* release */
+
+     // Return true and set body if a valid report is cached for url
+   bool lookup(const std::string& url, std::string& body)
+   {
+     EntryMap::iterator it = entries.find(url);
+     if ((it == entries.end()) || it->second.body.empty() ||
+         (time(NULL) >= it->second.expires))
+     {
+       return false;
+     }
+     body = it->second.body;
+     return true;
+   } /* lookup */
+
+     // Start fetching url, unless a transfer is already in progress. The
+     // returned signal is emitted when the transfer is done.
+   DoneSignal& fetch(const std::string& url)
+   {
+     Entry& e = entries[url];
+     if (!e.pending)
+     {
+       e.pending = true;
+       if (e.body.empty())
+       {
+         http.AddRequest(url);
+       }
+       else
+       {
+         http.AddRequest(url, e.etag, e.last_modified);
+       }
+     }
+     return e.done;
+   } /* fetch */
+
+  private:
+   struct Entry
+   {
+     Entry(void) : expires(0), pending(false) {}
+     std::string body;
+     std::string etag;
+     std::string last_modified;
+     time_t      expires;
+     bool        pending;
+     DoneSignal  done;
+   };
+   typedef std::map<std::string, Entry> EntryMap;
+
+     // Most stations report once or twice an hour
+   static const time_t METAR_INTERVAL = 1800;
+   static const time_t MIN_TTL = 60;
+   static const time_t MAX_TTL = 900;
+
+   static MetarCache* instance;
+   static unsigned    ref_cnt;
+
+   Http     http;
+   EntryMap entries;
+
+   MetarCache(void)
+   {
+     http.requestDone.connect(mem_fun(*this, &MetarCache::onRequestDone));
+   } /* MetarCache */
+
+   void onRequestDone(const std::string& url, long code,
+                      const std::string& body, const std::string& etag,
+                      const std::string& last_modified)
+   {
+     Entry& e = entries[url];
+     e.pending = false;
+     time_t now = time(NULL);
+     std::string result(body);
+     if ((code == 304) && !e.body.empty())
+     {
+       result = e.body;
+       e.expires = expiryTime(e.body, now);
+     }
+     else if (code == 200)
+     {
+       e.body = body;
+       e.etag = etag;
+       e.last_modified = last_modified;
+       e.expires = expiryTime(body, now);
+     }
+     else
+     {
+         // Error responses are passed on but not cached
+       e.body.clear();
+       e.etag.clear();
+       e.last_modified.clear();
+       e.expires = 0;
+     }
+     DoneSignal done(e.done);
+     e.done = DoneSignal();
+     done.emit((code != 0) && !result.empty(), result);
+   } /* onRequestDone */
+
+     // A new report is expected one METAR_INTERVAL after the observation
+   static time_t expiryTime(const std::string& body, time_t now)
+   {
+     struct tm tm;
+     memset(&tm, 0, sizeof(tm));
+     int cnt = 0;
+     size_t pos = body.find("<observation_time>");
+     if (pos != std::string::npos)
+     {
+         // e.g.: 2016-08-10T08:20:00Z
+       cnt = sscanf(body.c_str() + pos + 18, "%4d-%2d-%2dT%2d:%2d",
+                    &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                    &tm.tm_hour, &tm.tm_min);
+     }
+     else
+     {
+         // e.g.: 2009/04/07 13:20
+       cnt = sscanf(body.c_str(), "%4d/%2d/%2d %2d:%2d",
+                    &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                    &tm.tm_hour, &tm.tm_min);
+     }
+     time_t expires = now + MIN_TTL;
+     if (cnt == 5)
+     {
+       tm.tm_year -= 1900;
+       tm.tm_mon -= 1;
+       expires = timegm(&tm) + METAR_INTERVAL;
+     }
+     return std::min(std::max(expires, now + MIN_TTL), now + MAX_TTL);
+   } /* expiryTime */
+};
+
+ModuleMetarInfo::MetarCache* ModuleMetarInfo::MetarCache::instance = 0;
+unsigned ModuleMetarInfo::MetarCache::ref_cnt = 0;
+
+
 /****************************************************************************
  *
  * Prototypes
@@ -410,15 +631,19 @@ extern "C" {
 
 ModuleMetarInfo::ModuleMetarInfo(void *dl_handle, Logic *logic,
                                  const string& cfg_name)
-  : Module(dl_handle, logic, cfg_name), remarks(false), debug(false), http(0)
+  : Module(dl_handle, logic, cfg_name), remarks(false), debug(false), cache(0)
 {
   cout << "\tModule MetarInfo v" MODULE_METAR_INFO_VERSION " starting...\n";
 
+  cache = MetarCache::acquire();
+
 } /* ModuleMetarInfo */
 
 
 ModuleMetarInfo::~ModuleMetarInfo(void)
 {
+  closeConnection();
+  MetarCache::release();
 
 } /* ~ModuleMetarInfo */
 
@@ -851,34 +1076,56 @@ void ModuleMetarInfo::allMsgsWritten(void)
 
 /*
 * establish a https-connection to the METAR-Server
-* using curl library
+* using curl library. The report is taken from the cache shared by all
+* module instances if it is still valid.
 */
 void ModuleMetarInfo::openConnection(void)
 {
   closeConnection();
 
-  http = new Http();
-
   html = "";
   std::string path = server;
               path += link;
               path += icao;
 
-  http->AddRequest(path.c_str());
+  std::string body;
+  if (cache->lookup(path, body))
+  {
+    if (debug)
+    {
+      cout << "Using cached METAR for " << icao << endl;
+    }
+    onData(body, body.size());
+    return;
+  }
+
   cout << path << endl;
-  http->metarInfo.connect(mem_fun(*this, &ModuleMetarInfo::onData));
-  http->metarTimeout.connect(mem_fun(*this, &ModuleMetarInfo::onTimeout));
+  fetch_con = cache->fetch(path).connect(
+      mem_fun(*this, &ModuleMetarInfo::onFetchDone));
 
 } /* openConnection */
 
 
 void ModuleMetarInfo::closeConnection(void)
 {
-  delete http;
-  http = 0;
+  fetch_con.disconnect();
 } /* ModuleMetarInfo::closeConnection */
 
 
+void ModuleMetarInfo::onFetchDone(bool success, const std::string& body)
+{
+  fetch_con.disconnect();
+  if (success)
+  {
+    onData(body, body.size());
+  }
+  else
+  {
+    onTimeout();
+  }
+} /* ModuleMetarInfo::onFetchDone */
+
+
 void ModuleMetarInfo::onTimeout(void)
 {
   stringstream temp;
@@ -137,6 +137,7 @@ class ModuleMetarInfo : public Module
 
   private:
     class Http;
+    class MetarCache;
 
     std::string icao;
     std::string icao_default;
@@ -158,7 +159,8 @@ class ModuleMetarInfo : public Module
     std::string type;
     std::string server;
     std::string link;
-    Http* http;
+    MetarCache* cache;
+    sigc::connection fetch_con;
 
     bool initialize(void);
     void activateInit(void);
@@ -171,6 +173,7 @@ class ModuleMetarInfo : public Module
     void openConnection(void);
     void closeConnection(void);
     void onTimeout(void);
+    void onFetchDone(bool success, const std::string& body);
     std::string getSlp(std::string token);
     std::string getTempTime(std::string token);
     std::string getTempinRmk(std::string token);
@@ -0,0 +1,337 @@
+/**
+@file   EncodedFifo.cpp
+@brief  A FIFO that stores audio in encoded form
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains an audio FIFO that encodes the samples written to it and
+stores them in a compact ring of packets. The packets are decoded again when
+the audio is read out of the FIFO.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <algorithm>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioEncoder.h>
+#include <AsyncAudioDecoder.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "EncodedFifo.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+class EncodedFifo::DecoderSink : public AudioSink
+{
+  public:
+    DecoderSink(std::vector<float> &out) : out(out) {}
+
+    virtual int writeSamples(const float *samples, int count)
+    {
+      out.insert(out.end(), samples, samples + count);
+      return count;
+    }
+
+    virtual void flushSamples(void)
+    {
+      sourceAllSamplesFlushed();
+    }
+
+  private:
+    std::vector<float> &out;
+
+}; /* class EncodedFifo::DecoderSink */
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+EncodedFifo::EncodedFifo(const string &codec, unsigned max_samples)
+  : m_codec(codec), m_max_samples(max_samples), m_enc(0), m_dec(0),
+    m_dec_sink(0), m_sample_cnt(0), m_enc_pending(0), m_out_pos(0),
+    m_is_flushing(false), m_flush_sent(false)
+{
+} /* EncodedFifo::EncodedFifo */
+
+
+EncodedFifo::~EncodedFifo(void)
+{
+  deleteCodec();
+} /* EncodedFifo::~EncodedFifo */
+
+
+void EncodedFifo::setEncoderOption(const string &name, const string &value)
+{
+  m_enc_options[name] = value;
+} /* EncodedFifo::setEncoderOption */
+
+
+bool EncodedFifo::initialize(void)
+{
+  if (!createCodec())
+  {
+    return false;
+  }
+  m_enc->printCodecParams();
+  return true;
+} /* EncodedFifo::initialize */
+
+
+void EncodedFifo::clear(void)
+{
+  deque<char>().swap(m_data);
+  m_packets.clear();
+  m_sample_cnt = 0;
+  m_enc_pending = 0;
+  vector<float>().swap(m_out);
+  m_out_pos = 0;
+  m_is_flushing = false;
+  m_flush_sent = false;
+
+    // Recreate the codec so that no partial frame from the old audio is
+    // left in the encoder or decoder
+  deleteCodec();
+  createCodec();
+} /* EncodedFifo::clear */
+
+
+int EncodedFifo::writeSamples(const float *samples, int count)
+{
+  m_is_flushing = false;
+  m_flush_sent = false;
+  m_enc_pending += count;
+  m_enc->writeSamples(samples, count);
+  writeFromBuffer();
+  return count;
+} /* EncodedFifo::writeSamples */
+
+
+void EncodedFifo::flushSamples(void)
+{
+    // Pad the last partial frame in the encoder with silence so that the
+    // tail of the recording is not lost
+  static const float zeros[PAD_BLOCK_SIZE] = { 0.0f };
+  unsigned pad_left = m_max_samples;
+  while ((m_enc_pending > 0) && (pad_left > 0))
+  {
+    m_enc->writeSamples(zeros, PAD_BLOCK_SIZE);
+    pad_left -= min(pad_left, static_cast<unsigned>(PAD_BLOCK_SIZE));
+  }
+  m_enc_pending = 0;
+
+  m_is_flushing = true;
+  writeFromBuffer();
+} /* EncodedFifo::flushSamples */
+
+
+void EncodedFifo::resumeOutput(void)
+{
+  writeFromBuffer();
+} /* EncodedFifo::resumeOutput */
+
+
+void EncodedFifo::allSamplesFlushed(void)
+{
+  m_is_flushing = false;
+  m_flush_sent = false;
+  sourceAllSamplesFlushed();
+} /* EncodedFifo::allSamplesFlushed */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+bool EncodedFifo::createCodec(void)
+{
+  m_enc = AudioEncoder::create(m_codec);
+  m_dec = AudioDecoder::create(m_codec);
+  if ((m_enc == 0) || (m_dec == 0))
+  {
+    cerr << "*** ERROR: Illegal audio codec (" << m_codec
+         << ") specified for the parrot FIFO\n";
+    deleteCodec();
+    return false;
+  }
+  for (Options::const_iterator it=m_enc_options.begin();
+       it!=m_enc_options.end(); ++it)
+  {
+    m_enc->setOption(it->first, it->second);
+  }
+  m_enc->writeEncodedSamples.connect(
+      mem_fun(*this, &EncodedFifo::storePacket));
+  m_dec_sink = new DecoderSink(m_out);
+  m_dec->registerSink(m_dec_sink);
+  return true;
+} /* EncodedFifo::createCodec */
+
+
+void EncodedFifo::deleteCodec(void)
+{
+  delete m_enc;
+  m_enc = 0;
+  delete m_dec;
+  m_dec = 0;
+  delete m_dec_sink;
+  m_dec_sink = 0;
+} /* EncodedFifo::deleteCodec */
+
+
+void EncodedFifo::storePacket(const void *buf, int size)
+{
+  const char *data = reinterpret_cast<const char *>(buf);
+  m_data.insert(m_data.end(), data, data + size);
+  m_packets.push_back(Packet(size, m_enc_pending));
+  m_sample_cnt += m_enc_pending;
+  m_enc_pending = 0;
+
+    // Throw away the oldest audio if the FIFO is full
+  while ((m_sample_cnt > m_max_samples) && (m_packets.size() > 1))
+  {
+    const Packet &oldest = m_packets.front();
+    m_data.erase(m_data.begin(), m_data.begin() + oldest.size);
+    m_sample_cnt -= oldest.samples;
+    m_packets.pop_front();
+  }
+} /* EncodedFifo::storePacket */
+
+
+void EncodedFifo::writeFromBuffer(void)
+{
+  for (;;)
+  {
+    if (m_out_pos < m_out.size())
+    {
+      int cnt = m_out.size() - m_out_pos;
+      int written = sinkWriteSamples(&m_out[m_out_pos], cnt);
+      m_out_pos += written;
+      if (written < cnt)
+      {
+        return;
+      }
+    }
+    m_out.clear();
+    m_out_pos = 0;
+
+    if (m_packets.empty())
+    {
+      if (m_is_flushing && !m_flush_sent)
+      {
+        m_flush_sent = true;
+        sinkFlushSamples();
+      }
+      return;
+    }
+
+      // Decode the next packet. The decoded samples end up in m_out.
+    const Packet pkt = m_packets.front();
+    m_packets.pop_front();
+    m_sample_cnt -= pkt.samples;
+    vector<char> buf(m_data.begin(), m_data.begin() + pkt.size);
+    m_data.erase(m_data.begin(), m_data.begin() + pkt.size);
+    m_dec->writeEncodedSamples(&buf[0], buf.size());
+  }
+} /* EncodedFifo::writeFromBuffer */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,241 @@
+/**
+@file   EncodedFifo.h
+@brief  A FIFO that stores audio in encoded form
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains an audio FIFO that encodes the samples written to it and
+stores them in a compact ring of packets. The packets are decoded again when
+the audio is read out of the FIFO.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef ENCODED_FIFO_INCLUDED
+#define ENCODED_FIFO_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <stdint.h>
+#include <sigc++/sigc++.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSink.h>
+#include <AsyncAudioSource.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class AudioEncoder;
+  class AudioDecoder;
+};
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  An audio FIFO storing its content encoded
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class works like an Async::AudioFifo with overwrite enabled but instead
+of storing float samples, the audio is run through an audio encoder and the
+encoded packets are stored in a ring. When the FIFO is full, the oldest
+packets are thrown away. On playback the packets are decoded one at a time so
+only one decoded packet is held in memory at any time.
+*/
+class EncodedFifo : public Async::AudioSink, public Async::AudioSource,
+                    public sigc::trackable
+{
+  public:
+    /**
+     * @brief   Constructor
+     * @param   codec The name of the audio codec to use (e.g. GSM, OPUS)
+     * @param   max_samples The maximum number of samples to store
+     */
+    EncodedFifo(const std::string &codec, unsigned max_samples);
+
+    /**
+     * @brief   Destructor
+     */
+    ~EncodedFifo(void);
+
+    /**
+     * @brief   Set an option for the audio encoder
+     * @param   name The name of the option
+     * @param   value The value of the option
+     *
+     * The options are stored and applied each time the encoder is created so
+     * they must be set before calling the initialize function.
+     */
+    void setEncoderOption(const std::string &name, const std::string &value);
+
+    /**
+     * @brief   Initialize the FIFO
+     * @returns Returns \em true on success or \em false on failure
+     */
+    bool initialize(void);
+
+    /**
+     * @brief   Check if the FIFO is empty
+     * @returns Returns \em true if the FIFO is empty or else \em false
+     */
+    bool empty(void) const
+    {
+      return m_packets.empty() && (m_out_pos >= m_out.size());
+    }
+
+    /**
+     * @brief   Clear all samples from the FIFO
+     *
+     * This will throw away all stored audio and also reset the encoder and
+     * decoder so that no partial frames are left behind.
+     */
+    void clear(void);
+
+    /**
+     * @brief   Return the number of bytes used for storing encoded audio
+     * @returns Returns the number of bytes of encoded audio in the FIFO
+     */
+    size_t encodedSize(void) const { return m_data.size(); }
+
+    /**
+     * @brief   Write samples into the FIFO
+     * @param   samples The buffer containing the samples
+     * @param   count The number of samples in the buffer
+     * @return  Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *samples, int count);
+
+    /**
+     * @brief   Tell the FIFO to flush the previously written samples
+     *
+     * The flush is passed on to the connected sink when all stored audio
+     * have been written to it.
+     */
+    virtual void flushSamples(void);
+
+    /**
+     * @brief   Resume audio output to the sink
+     *
+     * This function will be called when the registered audio sink is ready
+     * to accept more samples.
+     */
+    virtual void resumeOutput(void);
+
+    /**
+     * @brief   The registered sink has flushed all samples
+     */
+    virtual void allSamplesFlushed(void);
+
+  private:
+    class DecoderSink;
+    struct Packet
+    {
+      uint32_t size;
+      uint32_t samples;
+      Packet(uint32_t size, uint32_t samples)
+        : size(size), samples(samples) {}
+    };
+    typedef std::map<std::string, std::string> Options;
+
+    static const int PAD_BLOCK_SIZE = 64;
+
+    const std::string     m_codec;
+    const unsigned        m_max_samples;
+    Options               m_enc_options;
+    Async::AudioEncoder*  m_enc;
+    Async::AudioDecoder*  m_dec;
+    DecoderSink*          m_dec_sink;
+    std::deque<char>      m_data;
+    std::deque<Packet>    m_packets;
+    unsigned              m_sample_cnt;
+    unsigned              m_enc_pending;
+    std::vector<float>    m_out;
+    size_t                m_out_pos;
+    bool                  m_is_flushing;
+    bool                  m_flush_sent;
+
+    EncodedFifo(const EncodedFifo&);
+    EncodedFifo& operator=(const EncodedFifo&);
+    bool createCodec(void);
+    void deleteCodec(void);
+    void storePacket(const void *buf, int size);
+    void writeFromBuffer(void);
+
+};  /* class EncodedFifo */
+
+
+#endif /* ENCODED_FIFO_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -53,6 +53,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioFifo.h>
 #include <AsyncAudioPassthrough.h>
 #include <AsyncAudioValve.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -63,6 +64,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "version/MODULE_PARROT.h"
 #include "ModuleParrot.h"
+#include "EncodedFifo.h"
 
 
 
@@ -163,7 +165,8 @@ extern "C" {
 
 ModuleParrot::ModuleParrot(void *dl_handle, Logic *logic,
       	      	      	   const string& cfg_name)
-  : Module(dl_handle, logic, cfg_name), adapter(0), fifo(0), valve(0),
+  : Module(dl_handle, logic, cfg_name), adapter(0), fifo(0), enc_fifo(0),
+    valve(0),
     squelch_is_open(false), repeat_delay_timer(-1)
 {
   cout << "\tModule Parrot v" MODULE_PARROT_VERSION " starting...\n";
@@ -200,17 +203,62 @@ bool ModuleParrot::initialize(void)
     repeat_delay_timer.setTimeout(repeat_delay);
   }
   
+  string fifo_codec;
+  cfg().getValue(cfgName(), "FIFO_CODEC", fifo_codec);
+  if ((fifo_codec == "NULL") || (fifo_codec == "DUMMY"))
+  {
+    cerr << "*** ERROR: Codec " << fifo_codec << " cannot be used for "
+         << cfgName() << "/FIFO_CODEC\n";
+    return false;
+  }
+  if ((fifo_codec == "GSM") && (INTERNAL_SAMPLE_RATE != 8000))
+  {
+    cerr << "*** ERROR: The GSM codec specified in " << cfgName()
+         << "/FIFO_CODEC can only be used with an internal sample rate "
+            "of 8000Hz\n";
+    return false;
+  }
+  
   adapter = new FifoAdapter(this);
   AudioSink::setHandler(adapter);
   
-  fifo = new AudioFifo(atoi(fifo_len.c_str())*INTERNAL_SAMPLE_RATE);
-  fifo->setOverwrite(true);
-  adapter->registerSink(fifo, true);
-  
   valve = new AudioValve;
   valve->setBlockWhenClosed(true);
   valve->setOpen(false);
-  fifo->registerSink(valve, true);
+
+  unsigned fifo_size = atoi(fifo_len.c_str())*INTERNAL_SAMPLE_RATE;
+  if (fifo_codec.empty() || (fifo_codec == "FLOAT"))
+  {
+    fifo = new AudioFifo(fifo_size);
+    fifo->setOverwrite(true);
+    adapter->registerSink(fifo, true);
+    fifo->registerSink(valve, true);
+  }
+  else
+  {
+    enc_fifo = new EncodedFifo(fifo_codec, fifo_size);
+    string opt_prefix(fifo_codec + "_ENC_");
+    list<string> names = cfg().listSection(cfgName());
+    for (list<string>::const_iterator nit=names.begin();
+         nit!=names.end(); ++nit)
+    {
+      if ((*nit).find(opt_prefix) == 0)
+      {
+        string opt_value;
+        cfg().getValue(cfgName(), *nit, opt_value);
+        enc_fifo->setEncoderOption((*nit).substr(opt_prefix.size()),
+                                   opt_value);
+      }
+    }
+    adapter->registerSink(enc_fifo, true);
+    enc_fifo->registerSink(valve, true);
+    if (!enc_fifo->initialize())
+    {
+      return false;
+    }
+    cout << "\tStoring parrot audio using the " << fifo_codec
+         << " codec\n";
+  }
   
   AudioSource::setHandler(valve);
   
@@ -235,13 +283,13 @@ void ModuleParrot::logicIdleStateChanged(bool is_idle)
   /*
   printf("ModuleParrot::logicIdleStateChanged: is_idle=%s fifo->empty()=%s\n",
       is_idle ? "TRUE" : "FALSE",
-      fifo->empty() ? "TRUE" : "FALSE");
+      fifoIsEmpty() ? "TRUE" : "FALSE");
   */
   Module::logicIdleStateChanged(is_idle);
   
   if (is_idle)
   {
-    if (!fifo->empty())
+    if (!fifoIsEmpty())
     {
       if (repeat_delay_timer.timeout() > 0)
       {
@@ -287,7 +335,7 @@ void ModuleParrot::logicIdleStateChanged(bool is_idle)
  */
 void ModuleParrot::activateInit(void)
 {
-  fifo->clear();
+  clearFifo();
   cmd_queue.clear();
   valve->setOpen(false);  
 } /* activateInit */
@@ -309,7 +357,7 @@ void ModuleParrot::activateInit(void)
 void ModuleParrot::deactivateCleanup(void)
 {
   valve->setOpen(true);
-  fifo->clear();
+  clearFifo();
   repeat_delay_timer.setEnable(false);
 } /* deactivateCleanup */
 
@@ -357,7 +405,7 @@ void ModuleParrot::dtmfCmdReceived(const string& cmd)
   cout << "DTMF command received in module " << name() << ": " << cmd << endl;
   
   cmd_queue.push_back(cmd);
-  if (fifo->empty() && !squelch_is_open)
+  if (fifoIsEmpty() && !squelch_is_open)
   {
     execCmdQueue();
   }
@@ -378,6 +426,25 @@ void ModuleParrot::squelchOpen(bool is_open)
 } /* ModuleParrot::squelchOpen */
 
 
+bool ModuleParrot::fifoIsEmpty(void) const
+{
+  return (enc_fifo != 0) ? enc_fifo->empty() : fifo->empty();
+} /* ModuleParrot::fifoIsEmpty */
+
+
+void ModuleParrot::clearFifo(void)
+{
+  if (enc_fifo != 0)
+  {
+    enc_fifo->clear();
+  }
+  else
+  {
+    fifo->clear();
+  }
+} /* ModuleParrot::clearFifo */
+
+
 void ModuleParrot::allSamplesWritten(void)
 {
   //cout << "ModuleParrot::allSamplesWritten\n";
@@ -75,6 +75,8 @@ namespace Async
   class AudioValve;
 };
 
+class EncodedFifo;
+
 
 
 /****************************************************************************
@@ -146,6 +148,7 @@ class ModuleParrot : public Module
     
     FifoAdapter       	    *adapter;
     Async::AudioFifo	    *fifo;
+    EncodedFifo      	    *enc_fifo;
     Async::AudioValve 	    *valve;
     bool      	      	    squelch_is_open;
     Async::Timer      	    repeat_delay_timer;
@@ -157,6 +160,8 @@ class ModuleParrot : public Module
     void dtmfCmdReceived(const std::string& cmd);
     void dtmfCmdReceivedWhenIdle(const std::string &cmd);
     void squelchOpen(bool is_open);
+    bool fifoIsEmpty(void) const;
+    void clearFifo(void);
 
     void allSamplesWritten(void);
     void onRepeatDelayExpired(void);
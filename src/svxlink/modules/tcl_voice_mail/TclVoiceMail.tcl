@@ -110,7 +110,7 @@ proc status_report {} {
   set user_list {}
   foreach userid [lsort [array names users]] {
     set call [id2var $userid call]
-    if {[llength [glob -nocomplain -directory "$recdir/$call" *_subj.wav]] > 0} {
+    if {[voiceMailIndex count "$recdir/$call"] > 0} {
       lappend user_list $call
     }
   }
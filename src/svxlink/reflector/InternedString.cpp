@@ -0,0 +1,164 @@
+/**
+@file   InternedString.cpp
+@brief  A string stored once no matter how many that use it
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a string class that share a single copy of each distinct
+string value between all instances.
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "InternedString.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+InternedString::Pool& InternedString::pool(void)
+{
+    // Function local to avoid static initialization order problems
+  static Pool the_pool;
+  return the_pool;
+} /* InternedString::pool */
+
+
+const std::string& InternedString::emptyString(void)
+{
+  static const std::string empty;
+  return empty;
+} /* InternedString::emptyString */
+
+
+InternedString::Entry* InternedString::acquire(const std::string& str)
+{
+  if (str.empty())
+  {
+    return 0;
+  }
+  Entry& entry = *pool().insert(Pool::value_type(str, 0)).first;
+  entry.second += 1;
+  return &entry;
+} /* InternedString::acquire */
+
+
+void InternedString::release(Entry* entry)
+{
+  if ((entry != 0) && (--entry->second == 0))
+  {
+    pool().erase(entry->first);
+  }
+} /* InternedString::release */
+
+
+/*
+ * This file has not been truncated
+ */
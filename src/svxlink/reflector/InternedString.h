@@ -0,0 +1,238 @@
+/**
+@file   InternedString.h
+@brief  A string stored once no matter how many that use it
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a string class that share a single copy of each distinct
+string value between all instances.
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef INTERNED_STRING_INCLUDED
+#define INTERNED_STRING_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <string>
+#include <map>
+#include <ostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  A string stored once no matter how many that use it
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+Strings like callsigns and codec names are repeated in a lot of places in the
+reflector. An interned string keep a single reference counted copy of each
+distinct value in a pool so each instance only cost one pointer. Since equal
+values always share the same pool entry, two interned strings can be compared
+by just comparing the pointers.
+
+The pool is not thread safe so interned strings must only be used from the
+main thread.
+*/
+class InternedString
+{
+  public:
+    /**
+     * @brief   Default constructor, creating an empty string
+     */
+    InternedString(void) : m_entry(0) {}
+
+    /**
+     * @brief   Constructor
+     * @param   str The string value
+     */
+    explicit InternedString(const std::string& str) : m_entry(acquire(str)) {}
+
+    /**
+     * @brief   Copy constructor
+     * @param   other The object to copy
+     */
+    InternedString(const InternedString& other) : m_entry(other.m_entry)
+    {
+      if (m_entry != 0)
+      {
+        m_entry->second += 1;
+      }
+    }
+
+    /**
+     * @brief   Destructor
+     */
+    ~InternedString(void) { release(m_entry); }
+
+    /**
+     * @brief   Assignment operator
+     * @param   other The object to copy
+     * @return  Returns a reference to this object
+     */
+    InternedString& operator=(const InternedString& other)
+    {
+      if (other.m_entry != 0)
+      {
+        other.m_entry->second += 1;
+      }
+      release(m_entry);
+      m_entry = other.m_entry;
+      return *this;
+    }
+
+    /**
+     * @brief   Assign a new string value
+     * @param   str The new string value
+     * @return  Returns a reference to this object
+     */
+    InternedString& operator=(const std::string& str)
+    {
+      Entry *entry = acquire(str);
+      release(m_entry);
+      m_entry = entry;
+      return *this;
+    }
+
+    /**
+     * @brief   Get the string value
+     * @return  Returns a reference to the shared string value
+     */
+    const std::string& str(void) const
+    {
+      return (m_entry != 0) ? m_entry->first : emptyString();
+    }
+
+    /**
+     * @brief   Check if the string is empty
+     * @return  Returns \em true if the string is empty
+     */
+    bool empty(void) const { return m_entry == 0; }
+
+    /**
+     * @brief   Compare two interned strings
+     * @param   other The string to compare with
+     * @return  Returns \em true if the strings are equal
+     */
+    bool operator==(const InternedString& other) const
+    {
+      return m_entry == other.m_entry;
+    }
+
+    /**
+     * @brief   Compare two interned strings
+     * @param   other The string to compare with
+     * @return  Returns \em true if the strings differ
+     */
+    bool operator!=(const InternedString& other) const
+    {
+      return m_entry != other.m_entry;
+    }
+
+    /**
+     * @brief   Get the number of distinct strings in the pool
+     * @return  Returns the number of pool entries
+     */
+    static size_t poolSize(void) { return pool().size(); }
+
+  private:
+    typedef std::map<std::string, unsigned> Pool;
+    typedef Pool::value_type                Entry;
+
+    Entry* m_entry;
+
+    static Pool& pool(void);
+    static const std::string& emptyString(void);
+    static Entry* acquire(const std::string& str);
+    static void release(Entry* entry);
+
+};  /* class InternedString */
+
+
+/**
+ * @brief   Write an interned string to an output stream
+ * @param   os  The output stream to write to
+ * @param   str The string to write
+ * @return  Returns the output stream
+ */
+inline std::ostream& operator<<(std::ostream& os, const InternedString& str)
+{
+  return os << str.str();
+}
+
+
+#endif /* INTERNED_STRING_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
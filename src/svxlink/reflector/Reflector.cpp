@@ -31,6 +31,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <strings.h>
+#include <cctype>
+#include <ctime>
+#include <sstream>
+#include <fstream>
+#include <cstdio>
 #include <json/json.h>
 
 
@@ -44,6 +52,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncTcpServer.h>
 #include <AsyncUdpSocket.h>
 #include <AsyncApplication.h>
+#include <AsyncAudioDecoder.h>
+#include <AsyncAudioEncoder.h>
+#include <AsyncMetrics.h>
+#include <AsyncAudioLatencyTrace.h>
 #include <common.h>
 
 
@@ -91,6 +103,7 @@ using namespace Async;
  *
  ****************************************************************************/
 
+static unsigned long elapsedUs(const struct timespec& since);
 
 
 /****************************************************************************
@@ -108,10 +121,105 @@ using namespace Async;
  ****************************************************************************/
 
 namespace {
+  HttpServerConnection::Headers::const_iterator findHttpHeader(
+      const HttpServerConnection::Headers& headers, const std::string& name)
+  {
+    HttpServerConnection::Headers::const_iterator it;
+    for (it = headers.begin(); it != headers.end(); ++it)
+    {
+      if (strcasecmp(it->first.c_str(), name.c_str()) == 0)
+      {
+        break;
+      }
+    }
+    return it;
+  }
+
+  int hexDigit(char ch)
+  {
+    if ((ch >= '0') && (ch <= '9')) return ch - '0';
+    if ((ch >= 'a') && (ch <= 'f')) return ch - 'a' + 10;
+    if ((ch >= 'A') && (ch <= 'F')) return ch - 'A' + 10;
+    return -1;
+  }
+
+  std::string urlDecode(const std::string& str)
+  {
+    std::string decoded;
+    for (size_t i=0; i<str.size(); ++i)
+    {
+      if (str[i] == '+')
+      {
+        decoded += ' ';
+      }
+      else if ((str[i] == '%') && (i + 2 < str.size()) &&
+               (hexDigit(str[i+1]) >= 0) && (hexDigit(str[i+2]) >= 0))
+      {
+        decoded += static_cast<char>(16 * hexDigit(str[i+1]) +
+                                     hexDigit(str[i+2]));
+        i += 2;
+      }
+      else
+      {
+        decoded += str[i];
+      }
+    }
+    return decoded;
+  }
+
+  typedef std::map<std::string, std::string> QueryParams;
+
+  QueryParams parseQuery(const std::string& query)
+  {
+    QueryParams params;
+    std::istringstream is(query);
+    std::string param;
+    while (std::getline(is, param, '&'))
+    {
+      if (param.empty())
+      {
+        continue;
+      }
+      std::string::size_type eq = param.find('=');
+      std::string name(urlDecode(param.substr(0, eq)));
+      params[name] = (eq == std::string::npos)
+                     ? "" : urlDecode(param.substr(eq + 1));
+    }
+    return params;
+  }
+
+  bool parseUnsigned(const std::string& str, unsigned long& value)
+  {
+    std::istringstream is(str);
+    return !str.empty() && (str[0] != '-') && (is >> value) && is.eof();
+  }
+
   ReflectorClient::ProtoVerRangeFilter v1_client_filter(
       ProtoVer(1, 0), ProtoVer(1, 999));
   ReflectorClient::ProtoVerRangeFilter v2_client_filter(
       ProtoVer(2, 0), ProtoVer(2, 999));
+  ReflectorClient::ProtoVerRangeFilter event_batch_client_filter(
+      ProtoVer(2, 1), ProtoVer::max());
+
+  Json::Value sessionToJson(const std::string& callsign,
+                            const ReflectorClient::Session& session)
+  {
+    Json::Value entry(Json::objectValue);
+    entry["callsign"] = callsign;
+    entry["token"] = session.token;
+    entry["clientId"] = Json::UInt(session.client_id);
+    entry["tg"] = Json::UInt(session.tg);
+    entry["monitoredTgs"] = Json::Value(Json::arrayValue);
+    for (ReflectorClient::TGList::const_iterator it =
+           session.monitored_tgs.begin();
+         it != session.monitored_tgs.end(); ++it)
+    {
+      entry["monitoredTgs"].append(Json::UInt(*it));
+    }
+    entry["blocktime"] = Json::UInt(session.blocktime);
+    entry["expires"] = Json::Int64(session.expires);
+    return entry;
+  }
 };
 
 
@@ -123,32 +231,91 @@ namespace {
 
 Reflector::Reflector(void)
   : m_srv(0), m_udp_sock(0), m_tg_for_v1_clients(1), m_random_qsy_lo(0),
-    m_random_qsy_hi(0), m_random_qsy_tg(0), m_http_server(0)
+    m_random_qsy_hi(0), m_random_qsy_tg(0), m_http_server(0),
+    m_transcoding(false), m_skip_dtx_frames(false), m_dtx_skipped_frames(0), m_dtx_saved_pkts(0),
+    m_dtx_saved_bytes(0), m_shared_node_cnt(0), m_shared_saved_pkts(0),
+    m_status_dirty(true), m_status_epoch(time(NULL)), m_status_version(0),
+    m_status_pushed_version(0),
+    m_status_push_timer(STATUS_PUSH_INTERVAL, Async::Timer::TYPE_PERIODIC,
+                        false),
+    m_trunk_session(0), m_trunk_tx_seq(0), m_trunk_srv(0),
+    m_trunk_dup_frames(0), m_http_audio_streams(false), m_udp_prio(false),
+    m_udp_ctrl_timer(0, Async::Timer::TYPE_ONESHOT, false),
+    m_event_batch_timer(DEFAULT_EVENT_BATCH_INTERVAL,
+                        Async::Timer::TYPE_ONESHOT, false),
+    m_session_resume_timeout(DEFAULT_SESSION_RESUME_TIMEOUT),
+    m_state_save_timer(1000 * DEFAULT_STATE_SAVE_INTERVAL,
+                       Async::Timer::TYPE_PERIODIC, false)
 {
+  m_udp_ctrl_timer.expired.connect(
+      mem_fun(*this, &Reflector::processUdpCtrlQueue));
+  m_event_batch_timer.expired.connect(
+      mem_fun(*this, &Reflector::flushEventBatch));
+  m_state_save_timer.expired.connect(
+      mem_fun(*this, &Reflector::onStateSaveTimer));
+  m_status_push_timer.expired.connect(
+      mem_fun(*this, &Reflector::pushStatusDelta));
   TGHandler::instance()->talkerUpdated.connect(
       mem_fun(*this, &Reflector::onTalkerUpdated));
   TGHandler::instance()->requestAutoQsy.connect(
       mem_fun(*this, &Reflector::onRequestAutoQsy));
+  Async::Metrics::instance().collect.connect(
+      mem_fun(*this, &Reflector::writeMetrics));
 } /* Reflector::Reflector */
 
 
 Reflector::~Reflector(void)
 {
+  for (TGAudioStreamMap::iterator it = m_audio_streams.begin();
+       it != m_audio_streams.end(); ++it)
+  {
+    delete it->second;
+  }
+  m_audio_streams.clear();
+  m_audio_listeners.clear();
   delete m_http_server;
   m_http_server = 0;
-  delete m_udp_sock;
-  m_udp_sock = 0;
-  delete m_srv;
-  m_srv = 0;
 
-  for (ReflectorClientMap::iterator it = m_client_map.begin();
-       it != m_client_map.end(); ++it)
+    // Delete the clients while the sockets are still around since removing
+    // a talker will cause messages to be sent to the remaining clients. Each
+    // client is removed from the slot table before it is deleted so that it
+    // will not be used by any broadcast.
+  for (ClientSlots::iterator it = m_client_slots.begin();
+       it != m_client_slots.end(); ++it)
+  {
+    ReflectorClient *client = it->client;
+    if (client != 0)
+    {
+      it->client = 0;
+      delete client;
+    }
+  }
+
+  while (!m_transcoders.empty())
   {
-    delete (*it).second;
+    deleteTranscoder(m_transcoders.begin()->first);
   }
-  m_client_map.clear();
+
+  for (Trunks::iterator it = m_trunks.begin(); it != m_trunks.end(); ++it)
+  {
+    delete *it;
+  }
+  m_trunks.clear();
+  delete m_trunk_srv;
+  m_trunk_srv = 0;
 
   delete TGHandler::instance();
+
+  for (FanoutWorkers::iterator it = m_fanout_workers.begin();
+       it != m_fanout_workers.end(); ++it)
+  {
+    delete *it;
+  }
+  m_fanout_workers.clear();
+  delete m_udp_sock;
+  m_udp_sock = 0;
+  delete m_srv;
+  m_srv = 0;
 } /* Reflector::~Reflector */
 
 
@@ -179,6 +346,11 @@ bool Reflector::initialize(Async::Config &cfg)
     }
   }
 
+  if (!initCodecs(cfg))
+  {
+    return false;
+  }
+
   std::string listen_port("5300");
   cfg.getValue("GLOBAL", "LISTEN_PORT", listen_port);
   m_srv = new TcpServer<FramedTcpConnection>(listen_port);
@@ -186,6 +358,9 @@ bool Reflector::initialize(Async::Config &cfg)
       mem_fun(*this, &Reflector::clientConnected));
   m_srv->clientDisconnected.connect(
       mem_fun(*this, &Reflector::clientDisconnected));
+  unsigned max_concurrent_logins = DEFAULT_MAX_CONCURRENT_LOGINS;
+  cfg.getValue("GLOBAL", "MAX_CONCURRENT_LOGINS", max_concurrent_logins);
+  m_srv->setMaxPendingConnections(max_concurrent_logins);
 
   uint16_t udp_listen_port = 5300;
   cfg.getValue("GLOBAL", "LISTEN_PORT", udp_listen_port);
@@ -195,8 +370,88 @@ bool Reflector::initialize(Async::Config &cfg)
     cerr << "*** ERROR: Could not initialize UDP socket" << endl;
     return false;
   }
-  m_udp_sock->dataReceived.connect(
-      mem_fun(*this, &Reflector::udpDatagramReceived));
+  m_udp_sock->setRecvBatchSize(UDP_RECV_BATCH_SIZE, UDP_RECV_MAX_SIZE);
+  (void)m_udp_sock->setRecvGro(true);
+
+    // A large talk group fan-out may fill the default socket send buffer on
+    // small machines. Datagrams that do not fit are queued for a while.
+  int udp_sndbuf = 0;
+  cfg.getValue("GLOBAL", "UDP_SNDBUF", udp_sndbuf);
+  if ((udp_sndbuf > 0) && m_udp_sock->setSendBufferSize(udp_sndbuf))
+  {
+    cout << "UDP socket send buffer size set to "
+         << m_udp_sock->sendBufferSize() << " bytes" << endl;
+  }
+  size_t udp_send_queue = DEFAULT_UDP_SEND_QUEUE;
+  cfg.getValue("GLOBAL", "UDP_SEND_QUEUE", udp_send_queue);
+  m_udp_sock->setSendQueueLength(udp_send_queue);
+  bool udp_audio_priority = false;
+  cfg.getValue("GLOBAL", "UDP_AUDIO_PRIORITY", udp_audio_priority);
+  if (udp_audio_priority)
+  {
+    m_udp_sock->batchReceived.connect(
+        mem_fun(*this, &Reflector::udpBatchReceived));
+    m_udp_prio = true;
+    cout << "Prioritized processing of UDP audio enabled" << endl;
+  }
+  else
+  {
+    m_udp_sock->dataReceived.connect(
+        mem_fun(*this, &Reflector::udpDatagramReceived));
+  }
+
+    // When the clients are told to use Opus DTX, the comfort noise frames
+    // sent during silence are not forwarded to the other clients
+  cfg.getValue("GLOBAL", "OPUS_ENC_DTX", m_skip_dtx_frames);
+
+  unsigned udp_fanout_threads = 0;
+  cfg.getValue("GLOBAL", "UDP_FANOUT_THREADS", udp_fanout_threads);
+  unsigned udp_pacing_interval = 0;
+  cfg.getValue("GLOBAL", "UDP_PACING_INTERVAL", udp_pacing_interval);
+  size_t udp_pacing_chunk = DEFAULT_UDP_PACING_CHUNK;
+  cfg.getValue("GLOBAL", "UDP_PACING_CHUNK", udp_pacing_chunk);
+  if ((udp_pacing_interval > 0) && (udp_fanout_threads == 0))
+  {
+    cerr << "*** WARNING: GLOBAL/UDP_PACING_INTERVAL require "
+            "GLOBAL/UDP_FANOUT_THREADS to be set. Pacing disabled." << endl;
+  }
+  std::string udp_fanout_backend("sendmmsg");
+  cfg.getValue("GLOBAL", "UDP_FANOUT_BACKEND", udp_fanout_backend);
+  if ((udp_fanout_backend != "sendmmsg") && (udp_fanout_backend != "io_uring"))
+  {
+    cerr << "*** ERROR: Unknown GLOBAL/UDP_FANOUT_BACKEND \""
+         << udp_fanout_backend << "\". Valid values are \"sendmmsg\" and "
+            "\"io_uring\"." << endl;
+    return false;
+  }
+  if ((udp_fanout_backend == "io_uring") && (udp_fanout_threads == 0))
+  {
+    cerr << "*** WARNING: GLOBAL/UDP_FANOUT_BACKEND=io_uring require "
+            "GLOBAL/UDP_FANOUT_THREADS to be set. Using sendmmsg." << endl;
+  }
+  bool use_send_ring = (udp_fanout_backend == "io_uring");
+  for (unsigned i=0; i<udp_fanout_threads; ++i)
+  {
+    UdpFanoutWorker *worker = new UdpFanoutWorker(m_udp_sock->fd());
+    worker->setPacing(1000 * udp_pacing_interval, udp_pacing_chunk);
+    std::string errmsg;
+    if (use_send_ring && !worker->enableSendRing(errmsg))
+    {
+      cerr << "*** WARNING: Could not set up io_uring for the UDP fan-out ("
+           << errmsg << "). Using sendmmsg." << endl;
+      use_send_ring = false;
+    }
+    if (!worker->start())
+    {
+      delete worker;
+      return false;
+    }
+    m_fanout_workers.push_back(worker);
+  }
+  if (use_send_ring)
+  {
+    cout << "Using io_uring for the UDP fan-out" << endl;
+  }
 
   unsigned sql_timeout = 0;
   cfg.getValue("GLOBAL", "SQL_TIMEOUT", sql_timeout);
@@ -208,18 +463,45 @@ bool Reflector::initialize(Async::Config &cfg)
 
   m_cfg->getValue("GLOBAL", "TG_FOR_V1_CLIENTS", m_tg_for_v1_clients);
 
-  SvxLink::SepPair<uint32_t, uint32_t> random_qsy_range;
-  if (m_cfg->getValue("GLOBAL", "RANDOM_QSY_RANGE", random_qsy_range))
+    // Node and talker events are collected during this time before being
+    // sent in one message to the clients that support it. Zero disable it.
+  int event_batch_interval = DEFAULT_EVENT_BATCH_INTERVAL;
+  cfg.getValue("GLOBAL", "EVENT_BATCH_INTERVAL", event_batch_interval);
+  m_event_batch_timer.setTimeout(event_batch_interval);
+
+    // The state snapshot makes it possible for clients to resume their
+    // sessions after a restart of the reflector
+  if (cfg.getValue("GLOBAL", "STATE_FILE", m_state_file) &&
+      !m_state_file.empty())
   {
-    m_random_qsy_lo = random_qsy_range.first;
-    m_random_qsy_hi = m_random_qsy_lo + random_qsy_range.second-1;
-    if ((m_random_qsy_lo < 1) || (m_random_qsy_hi < m_random_qsy_lo))
+    cfg.getValue("GLOBAL", "SESSION_RESUME_TIMEOUT",
+                 m_session_resume_timeout);
+    unsigned state_save_interval = DEFAULT_STATE_SAVE_INTERVAL;
+    cfg.getValue("GLOBAL", "STATE_SAVE_INTERVAL", state_save_interval);
+    loadState();
+    if (state_save_interval > 0)
     {
-      cout << "*** WARNING: Illegal RANDOM_QSY_RANGE specified. Ignored."
-           << endl;
-      m_random_qsy_hi = m_random_qsy_lo = 0;
+      m_state_save_timer.setTimeout(1000 * state_save_interval);
+      m_state_save_timer.setEnable(true);
     }
-    m_random_qsy_tg = m_random_qsy_hi;
+  }
+
+  setRandomQsyRange(m_cfg->getValue("GLOBAL", "RANDOM_QSY_RANGE"));
+
+    // These variables can be changed without restarting the reflector. The
+    // user keys are looked up on each login so they need no subscription.
+  cfg.subscribeValue<unsigned>("GLOBAL", "SQL_TIMEOUT",
+      mem_fun(*this, &Reflector::setSqlTimeout));
+  cfg.subscribeValue<unsigned>("GLOBAL", "SQL_TIMEOUT_BLOCKTIME",
+      mem_fun(*this, &Reflector::setSqlTimeoutBlocktime));
+  cfg.subscribeValue<uint32_t>("GLOBAL", "TG_FOR_V1_CLIENTS",
+      mem_fun(*this, &Reflector::setTgForV1Clients));
+  cfg.subscribeValue("GLOBAL", "RANDOM_QSY_RANGE",
+      mem_fun(*this, &Reflector::setRandomQsyRange));
+
+  if (!initTrunks(cfg))
+  {
+    return false;
   }
 
   std::string http_srv_port;
@@ -230,19 +512,37 @@ bool Reflector::initialize(Async::Config &cfg)
         sigc::mem_fun(*this, &Reflector::httpClientConnected));
     m_http_server->clientDisconnected.connect(
         sigc::mem_fun(*this, &Reflector::httpClientDisconnected));
+    m_cfg->getValue("GLOBAL", "HTTP_AUDIO_STREAMS", m_http_audio_streams);
   }
 
   return true;
 } /* Reflector::initialize */
 
 
+const MsgCodecOptions::Options& Reflector::codecEncOptions(
+    const std::string& codec) const
+{
+  static const MsgCodecOptions::Options no_options;
+  CodecOptionsMap::const_iterator it = m_codec_enc_options.find(codec);
+  if (it == m_codec_enc_options.end())
+  {
+    return no_options;
+  }
+  return (*it).second;
+} /* Reflector::codecEncOptions */
+
+
 void Reflector::nodeList(std::vector<std::string>& nodes) const
 {
   nodes.clear();
-  for (ReflectorClientMap::const_iterator it = m_client_map.begin();
-       it != m_client_map.end(); ++it)
+  for (ClientSlots::const_iterator it = m_client_slots.begin();
+       it != m_client_slots.end(); ++it)
   {
-    const std::string& callsign = (*it).second->callsign();
+    if (it->client == 0)
+    {
+      continue;
+    }
+    const std::string& callsign = it->client->callsign();
     if (!callsign.empty())
     {
       nodes.push_back(callsign);
@@ -254,22 +554,122 @@ void Reflector::nodeList(std::vector<std::string>& nodes) const
 void Reflector::broadcastMsg(const ReflectorMsg& msg,
                              const ReflectorClient::Filter& filter)
 {
-  ReflectorClientMap::const_iterator it = m_client_map.begin();
-  for (; it != m_client_map.end(); ++it)
+    // The message is packed once and the same frame is queued on all
+    // client connections
+  FramedTcpConnection::Frame *frame = 0;
+  for (size_t i=0; i<m_client_slots.size(); ++i)
   {
-    ReflectorClient *client = (*it).second;
-    if (filter(client) &&
+    ReflectorClient *client = m_client_slots[i].client;
+    if ((client != 0) && filter(client) &&
         (client->conState() == ReflectorClient::STATE_CONNECTED))
     {
-      (*it).second->sendMsg(msg);
+      if ((frame == 0) && ((frame = ReflectorClient::packMsg(msg)) == 0))
+      {
+        return;
+      }
+      client->sendFrame(frame, msg.type());
     }
   }
+  if (frame != 0)
+  {
+    frame->unref();
+  }
 } /* Reflector::broadcastMsg */
 
 
+void Reflector::broadcastMsgToTG(const ReflectorMsg& msg, uint32_t tg,
+                                 bool include_monitors,
+                                 const ReflectorClient::Filter& filter)
+{
+  std::vector<ReflectorClient*> clients;
+  tgClients(tg, include_monitors, clients);
+  FramedTcpConnection::Frame *frame = 0;
+  for (std::vector<ReflectorClient*>::iterator it = clients.begin();
+       it != clients.end(); ++it)
+  {
+    ReflectorClient *client = *it;
+    if (filter(client) &&
+        (client->conState() == ReflectorClient::STATE_CONNECTED))
+    {
+      if ((frame == 0) && ((frame = ReflectorClient::packMsg(msg)) == 0))
+      {
+        return;
+      }
+      client->sendFrame(frame, msg.type());
+    }
+  }
+  if (frame != 0)
+  {
+    frame->unref();
+  }
+} /* Reflector::broadcastMsgToTG */
+
+
+void Reflector::broadcastEvent(const MsgEventBatch::Event& event,
+                               const ReflectorClient::Filter& filter)
+{
+  FramedTcpConnection::Frame *frame = 0;
+  for (size_t i=0; i<m_client_slots.size(); ++i)
+  {
+    ReflectorClient *client = m_client_slots[i].client;
+    if ((client != 0) && filter(client) &&
+        (client->conState() == ReflectorClient::STATE_CONNECTED))
+    {
+      sendEvent(client, event, frame);
+    }
+  }
+  if (frame != 0)
+  {
+    frame->unref();
+  }
+} /* Reflector::broadcastEvent */
+
+
+void Reflector::broadcastEventToTG(const MsgEventBatch::Event& event,
+                                   uint32_t tg, bool include_monitors,
+                                   const ReflectorClient::Filter& filter)
+{
+  std::vector<ReflectorClient*> clients;
+  tgClients(tg, include_monitors, clients);
+  FramedTcpConnection::Frame *frame = 0;
+  for (std::vector<ReflectorClient*>::iterator it = clients.begin();
+       it != clients.end(); ++it)
+  {
+    ReflectorClient *client = *it;
+    if (filter(client) &&
+        (client->conState() == ReflectorClient::STATE_CONNECTED))
+    {
+      sendEvent(client, event, frame);
+    }
+  }
+  if (frame != 0)
+  {
+    frame->unref();
+  }
+} /* Reflector::broadcastEventToTG */
+
+
 bool Reflector::sendUdpDatagram(ReflectorClient *client, const void *buf,
                                 size_t count)
 {
+  if (!m_fanout_workers.empty())
+  {
+      // All traffic to a client must go through the same worker to not be
+      // reordered
+    const char *data = reinterpret_cast<const char *>(buf);
+    ReflectorUdpMsg header;
+    if (!header.unpackHeader(data, count))
+    {
+      return false;
+    }
+    UdpFanoutWorker::Dest dest;
+    dest.ip = client->remoteHost();
+    dest.port = client->remoteUdpPort();
+    dest.client_id = header.clientId();
+    dest.seq = header.sequenceNum();
+    fanoutWorkerForClient(client)->send(data, count, &dest, 1);
+    return true;
+  }
   return m_udp_sock->write(client->remoteHost(), client->remoteUdpPort(), buf,
                            count);
 } /* Reflector::sendUdpDatagram */
@@ -278,19 +678,30 @@ bool Reflector::sendUdpDatagram(ReflectorClient *client, const void *buf,
 void Reflector::broadcastUdpMsg(const ReflectorUdpMsg& msg,
                                 const ReflectorClient::Filter& filter)
 {
-  for (ReflectorClientMap::iterator it = m_client_map.begin();
-       it != m_client_map.end(); ++it)
+  m_udp_bcast_clients.clear();
+  for (ClientSlots::const_iterator it = m_client_slots.begin();
+       it != m_client_slots.end(); ++it)
   {
-    ReflectorClient *client = (*it).second;
-    if (filter(client) &&
-        (client->conState() == ReflectorClient::STATE_CONNECTED))
+    ReflectorClient *client = it->client;
+    if ((client != 0) && filter(client) &&
+        (client->conState() == ReflectorClient::STATE_CONNECTED) &&
+        (client->remoteUdpPort() != 0))
     {
-      client->sendUdpMsg(msg);
+      m_udp_bcast_clients.push_back(client);
     }
   }
+  sendUdpBatch(msg);
 } /* Reflector::broadcastUdpMsg */
 
 
+void Reflector::broadcastUdpMsgToTG(const ReflectorUdpMsg& msg, uint32_t tg,
+                                    const ReflectorClient::Filter& filter)
+{
+  collectUdpClientsForTG(tg, filter);
+  sendUdpBatch(msg);
+} /* Reflector::broadcastUdpMsgToTG */
+
+
 void Reflector::requestQsy(ReflectorClient *client, uint32_t tg)
 {
   if (tg == 0)
@@ -303,13 +714,168 @@ void Reflector::requestQsy(ReflectorClient *client, uint32_t tg)
   cout << client->callsign() << ": Requesting QSY from TG #"
        << current_tg << " to TG #" << tg << endl;
 
-  broadcastMsg(MsgRequestQsy(tg),
-      ReflectorClient::mkAndFilter(
-        v2_client_filter,
-        ReflectorClient::TgFilter(current_tg)));
+  broadcastMsgToTG(MsgRequestQsy(tg), current_tg, false, v2_client_filter);
 } /* Reflector::requestQsy */
 
 
+void Reflector::loginHandshakeDone(Async::FramedTcpConnection *con)
+{
+  m_srv->connectionAdmitted(con);
+} /* Reflector::loginHandshakeDone */
+
+
+ReflectorClient* Reflector::addSharedNode(ReflectorClient *parent,
+                                          Async::FramedTcpConnection *con,
+                                          uint16_t channel)
+{
+  uint32_t client_id;
+  if (!allocClientId(client_id))
+  {
+    cerr << "*** WARNING: Rejecting shared node on channel " << channel
+         << " from " << parent->callsign() << " since the maximum number "
+         << "of clients, " << (CLIENT_SLOT_MASK + 1) << ", are connected"
+         << endl;
+    return 0;
+  }
+  cout << parent->callsign() << ": Shared channel " << channel
+       << " opened" << endl;
+  ReflectorClient *rc = new ReflectorClient(this, con, m_cfg, client_id,
+                                            parent, channel);
+  ClientSlot& slot = m_client_slots[client_id & CLIENT_SLOT_MASK];
+  slot.client = rc;
+  slot.udp_port = 0;
+  slot.addr = con->remoteHost();
+  m_shared_node_cnt += 1;
+  return rc;
+} /* Reflector::addSharedNode */
+
+
+void Reflector::sharedNodeDisconnected(ReflectorClient *client)
+{
+  if (!client->callsign().empty())
+  {
+    cout << client->callsign() << ": ";
+  }
+  else
+  {
+    cout << "Shared node " << client->remoteHost() << " ";
+  }
+  cout << "disconnected: Shared channel closed" << endl;
+  assert(m_shared_node_cnt > 0);
+  m_shared_node_cnt -= 1;
+  removeClient(client);
+} /* Reflector::sharedNodeDisconnected */
+
+
+bool Reflector::takeSession(const std::string& callsign,
+                            ReflectorClient::Session& session)
+{
+  SessionMap::iterator it = m_resume_sessions.find(callsign);
+  if (it == m_resume_sessions.end())
+  {
+    return false;
+  }
+  bool valid = (it->second.expires > time(NULL));
+  if (valid)
+  {
+    session = it->second;
+  }
+  m_resume_sessions.erase(it);
+  return valid;
+} /* Reflector::takeSession */
+
+
+bool Reflector::changeClientId(ReflectorClient *client, uint32_t client_id)
+{
+  if (client->clientId() == client_id)
+  {
+    return true;
+  }
+  uint32_t slot = client_id & CLIENT_SLOT_MASK;
+  if ((client_id & ~CLIENT_ID_MASK) != 0)
+  {
+    return false;
+  }
+  growClientSlots(slot + 1);
+  if (m_client_slots[slot].client != 0)
+  {
+    return false;
+  }
+
+    // Take the wanted slot out of the free list and move the client over
+  std::deque<uint32_t>::iterator free_it = std::find(
+      m_free_client_slots.begin(), m_free_client_slots.end(), slot);
+  assert(free_it != m_free_client_slots.end());
+  m_free_client_slots.erase(free_it);
+  ClientSlot *old_slot = findClientSlot(client->clientId());
+  assert(old_slot != 0);
+  m_client_slots[slot] = *old_slot;
+  m_client_slots[slot].id = client_id;
+  releaseClientId(client->clientId());
+  client->setClientId(client_id);
+  return true;
+} /* Reflector::changeClientId */
+
+
+void Reflector::saveState(void)
+{
+  if (m_state_file.empty())
+  {
+    return;
+  }
+
+  time_t now = time(NULL);
+  Json::Value sessions(Json::arrayValue);
+  std::set<std::string> callsigns;
+  for (ClientSlots::const_iterator it = m_client_slots.begin();
+       it != m_client_slots.end(); ++it)
+  {
+    ReflectorClient *client = it->client;
+    if ((client == 0) ||
+        (client->conState() != ReflectorClient::STATE_CONNECTED) ||
+        client->sessionToken().empty())
+    {
+      continue;
+    }
+    ReflectorClient::Session session(client->session());
+    session.expires = now + m_session_resume_timeout;
+    sessions.append(sessionToJson(client->callsign(), session));
+    callsigns.insert(client->callsign());
+  }
+  SessionMap::iterator it = m_resume_sessions.begin();
+  while (it != m_resume_sessions.end())
+  {
+    const ReflectorClient::Session& session = it->second;
+    if (session.expires <= now)
+    {
+      m_resume_sessions.erase(it++);
+      continue;
+    }
+    if (callsigns.count(it->first) == 0)
+    {
+      sessions.append(sessionToJson(it->first, session));
+    }
+    ++it;
+  }
+  Json::Value state(Json::objectValue);
+  state["version"] = 1;
+  state["sessions"] = sessions;
+
+    // Write to a temporary file first so that a crash while writing does
+    // not destroy the previous snapshot
+  std::string tmp_file(m_state_file + ".tmp");
+  std::ofstream os(tmp_file.c_str());
+  os << jsonToString(state) << std::endl;
+  os.close();
+  if (!os || (rename(tmp_file.c_str(), m_state_file.c_str()) != 0))
+  {
+    cerr << "*** WARNING: Could not write the state file \""
+         << m_state_file << "\"" << endl;
+    remove(tmp_file.c_str());
+  }
+} /* Reflector::saveState */
+
+
 /****************************************************************************
  *
  * Protected member functions
@@ -324,12 +890,71 @@ void Reflector::requestQsy(ReflectorClient *client, uint32_t tg)
  *
  ****************************************************************************/
 
+bool Reflector::allocClientId(uint32_t& client_id)
+{
+  if (m_free_client_slots.empty())
+  {
+    if (m_client_slots.size() > CLIENT_SLOT_MASK)
+    {
+      return false;
+    }
+    growClientSlots(m_client_slots.size() + 1);
+  }
+
+    // The slot that has been free for the longest time is used first so that
+    // a client that disconnected recently is likely to get its id back if it
+    // resume its session
+  uint32_t slot = m_free_client_slots.front();
+  m_free_client_slots.pop_front();
+  client_id = m_client_slots[slot].id;
+  return true;
+} /* Reflector::allocClientId */
+
+
+void Reflector::releaseClientId(uint32_t client_id)
+{
+  uint32_t slot = client_id & CLIENT_SLOT_MASK;
+  assert((slot < m_client_slots.size()) &&
+         (m_client_slots[slot].id == client_id));
+  ClientSlot& cs = m_client_slots[slot];
+  cs.client = 0;
+  cs.udp_port = 0;
+  cs.id = (client_id + CLIENT_SLOT_MASK + 1) & CLIENT_ID_MASK;
+  m_free_client_slots.push_back(slot);
+} /* Reflector::releaseClientId */
+
+
+void Reflector::growClientSlots(size_t size)
+{
+  while (m_client_slots.size() < size)
+  {
+    uint32_t slot = m_client_slots.size();
+    m_client_slots.push_back(ClientSlot());
+    m_client_slots.back().id = slot;
+    m_free_client_slots.push_back(slot);
+  }
+} /* Reflector::growClientSlots */
+
+
 void Reflector::clientConnected(Async::FramedTcpConnection *con)
 {
+  uint32_t client_id;
+  if (!allocClientId(client_id))
+  {
+    cerr << "*** WARNING: Rejecting client " << con->remoteHost() << ":"
+         << con->remotePort() << " since the maximum number of clients, "
+         << (CLIENT_SLOT_MASK + 1) << ", are connected" << endl;
+    con->disconnect();
+    con->disconnected(con, FramedTcpConnection::DR_ORDERED_DISCONNECT);
+    return;
+  }
   cout << "Client " << con->remoteHost() << ":" << con->remotePort()
        << " connected" << endl;
-  ReflectorClient *rc = new ReflectorClient(this, con, m_cfg);
-  m_client_map[rc->clientId()] = rc;
+  ReflectorClient *rc = new ReflectorClient(this, con, m_cfg, client_id);
+  ClientSlot& slot = m_client_slots[client_id & CLIENT_SLOT_MASK];
+  slot.client = rc;
+  slot.udp_port = 0;
+  slot.addr = con->remoteHost();
   m_client_con_map[con] = rc;
 } /* Reflector::clientConnected */
 
@@ -338,10 +963,16 @@ void Reflector::clientDisconnected(Async::FramedTcpConnection *con,
                            Async::FramedTcpConnection::DisconnectReason reason)
 {
   ReflectorClientConMap::iterator it = m_client_con_map.find(con);
-  assert(it != m_client_con_map.end());
+  if (it == m_client_con_map.end())
+  {
+      // A connection rejected in clientConnected
+    return;
+  }
   ReflectorClient *client = (*it).second;
+  m_client_con_map.erase(it);
 
-  TGHandler::instance()->removeClient(client);
+    // The shared nodes go away together with the connection
+  client->closeSharedNodes();
 
   if (!client->callsign().empty())
   {
@@ -354,70 +985,213 @@ void Reflector::clientDisconnected(Async::FramedTcpConnection *con,
   cout << "disconnected: " << TcpConnection::disconnectReasonStr(reason)
        << endl;
 
-  m_client_map.erase(client->clientId());
-  m_client_con_map.erase(it);
+  removeClient(client);
+} /* Reflector::clientDisconnected */
+
+
+void Reflector::removeClient(ReflectorClient *client)
+{
+  TGHandler::instance()->removeClient(client);
+  invalidateStatus();
+
+  releaseClientId(client->clientId());
+
+    // Keep the session so that the client can resume it if it come back
+  if (!client->sessionToken().empty())
+  {
+    ReflectorClient::Session& session = m_resume_sessions[client->callsign()];
+    session = client->session();
+    session.expires = time(NULL) + m_session_resume_timeout;
+  }
 
   if (!client->callsign().empty())
   {
-    broadcastMsg(MsgNodeLeft(client->callsign()),
-        ReflectorClient::ExceptFilter(client));
+    broadcastEvent(MsgEventBatch::Event(MsgNodeLeft::TYPE, 0,
+                                        client->callsign()),
+                   ReflectorClient::ExceptFilter(client));
   }
   Application::app().runTask([=]{ delete client; });
-} /* Reflector::clientDisconnected */
+} /* Reflector::removeClient */
 
 
 void Reflector::udpDatagramReceived(const IpAddress& addr, uint16_t port,
                                     void *buf, int count)
 {
-  stringstream ss;
-  ss.write(reinterpret_cast<const char *>(buf), count);
-
+  const char *data = reinterpret_cast<const char *>(buf);
   ReflectorUdpMsg header;
-  if (!header.unpack(ss))
+  uint16_t udp_rx_seq_diff = 0;
+  ReflectorClient *client = udpAcceptDatagram(addr, port, data, count,
+                                              header, udp_rx_seq_diff);
+  if (client != 0)
   {
-    cout << "*** WARNING: Unpacking message header failed for UDP datagram "
-            "from " << addr << ":" << port << endl;
-    return;
+    udpDispatchDatagram(client, header, data, count, udp_rx_seq_diff);
   }
+} /* Reflector::udpDatagramReceived */
+
 
-  ReflectorClientMap::iterator it = m_client_map.find(header.clientId());
-  if (it == m_client_map.end())
+void Reflector::udpBatchReceived(
+    const std::vector<Async::UdpSocket::RecvDatagram>& dgrams)
+{
+  struct timespec batch_start;
+  clock_gettime(CLOCK_MONOTONIC, &batch_start);
+
+    // All datagrams are checked in arrival order so that the sequence number
+    // bookkeeping for each client is not affected by the reordering. Audio is
+    // set aside for direct forwarding while everything else is queued. Audio
+    // from a client that already have queued messages is queued as well so
+    // that the messages from one client are always handled in order.
+  m_udp_audio_batch.clear();
+  for (std::vector<Async::UdpSocket::RecvDatagram>::const_iterator it =
+         dgrams.begin(); it != dgrams.end(); ++it)
   {
-    cerr << "*** WARNING: Incoming UDP datagram from " << addr << ":" << port
-         << " has invalid client id " << header.clientId() << endl;
-    return;
-  }
-  ReflectorClient *client = (*it).second;
-  if (addr != client->remoteHost())
+    const char *data = reinterpret_cast<const char *>(it->buf);
+    UdpAudioDatagram dgram;
+    dgram.client = udpAcceptDatagram(it->ip, it->port, data, it->len,
+                                     dgram.header, dgram.seq_diff);
+    if (dgram.client == 0)
+    {
+      continue;
+    }
+    if ((dgram.header.type() == MsgUdpAudio::TYPE) &&
+        (m_udp_ctrl_pending.find(dgram.client->clientId()) ==
+         m_udp_ctrl_pending.end()))
+    {
+      dgram.data = data;
+      dgram.len = it->len;
+      m_udp_audio_batch.push_back(dgram);
+    }
+    else
+    {
+      m_udp_ctrl_queue.push_back(UdpCtrlDatagram());
+      UdpCtrlDatagram& ctrl = m_udp_ctrl_queue.back();
+      ctrl.client_id = dgram.client->clientId();
+      ctrl.header = dgram.header;
+      ctrl.seq_diff = dgram.seq_diff;
+      ctrl.data.assign(data, data + it->len);
+      m_udp_ctrl_pending[ctrl.client_id] += 1;
+    }
+  }
+
+  m_udp_prio_stats.audio_frames += m_udp_audio_batch.size();
+  if (m_udp_audio_batch.size() > m_udp_prio_stats.audio_max_depth)
+  {
+    m_udp_prio_stats.audio_max_depth = m_udp_audio_batch.size();
+  }
+  if (m_udp_ctrl_queue.size() > m_udp_prio_stats.ctrl_max_depth)
+  {
+    m_udp_prio_stats.ctrl_max_depth = m_udp_ctrl_queue.size();
+  }
+
+  for (std::vector<UdpAudioDatagram>::const_iterator it =
+         m_udp_audio_batch.begin(); it != m_udp_audio_batch.end(); ++it)
+  {
+    udpDispatchDatagram(it->client, it->header, it->data, it->len,
+                        it->seq_diff);
+  }
+  if (!m_udp_audio_batch.empty())
+  {
+    unsigned long delay = elapsedUs(batch_start);
+    if (delay > m_udp_prio_stats.audio_max_delay_us)
+    {
+      m_udp_prio_stats.audio_max_delay_us = delay;
+    }
+  }
+
+  processUdpCtrlQueue();
+} /* Reflector::udpBatchReceived */
+
+
+void Reflector::processUdpCtrlQueue(Async::Timer *t)
+{
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (!m_udp_ctrl_queue.empty())
+  {
+    UdpCtrlDatagram& ctrl = m_udp_ctrl_queue.front();
+    UdpCtrlPendingMap::iterator pending_it =
+      m_udp_ctrl_pending.find(ctrl.client_id);
+    assert(pending_it != m_udp_ctrl_pending.end());
+    if (--pending_it->second == 0)
+    {
+      m_udp_ctrl_pending.erase(pending_it);
+    }
+    ReflectorClient *client = findClient(ctrl.client_id);
+    if (client != 0)
+    {
+      udpDispatchDatagram(client, ctrl.header, &ctrl.data[0],
+                          ctrl.data.size(), ctrl.seq_diff);
+      m_udp_prio_stats.ctrl_msgs += 1;
+    }
+    m_udp_ctrl_queue.pop_front();
+
+      // Leave the rest for the next main loop iteration if the time budget
+      // is used up so that new audio is not held back
+    if (!m_udp_ctrl_queue.empty() &&
+        (elapsedUs(start) >= UDP_CTRL_TIME_BUDGET_US))
+    {
+      m_udp_prio_stats.ctrl_budget_exceeded += 1;
+      m_udp_ctrl_timer.setEnable(false);
+      m_udp_ctrl_timer.setEnable(true);
+      return;
+    }
+  }
+  m_udp_ctrl_timer.setEnable(false);
+} /* Reflector::processUdpCtrlQueue */
+
+
+ReflectorClient* Reflector::udpAcceptDatagram(const IpAddress& addr,
+    uint16_t port, const char *data, int count, ReflectorUdpMsg& header,
+    uint16_t& udp_rx_seq_diff)
+{
+  if (!header.unpackHeader(data, count))
+  {
+    cout << "*** WARNING: Unpacking message header failed for UDP datagram "
+            "from " << addr << ":" << port << endl;
+    return 0;
+  }
+
+    // The address and port are checked against the copies in the slot so
+    // that the client object is not touched for a datagram that is dropped
+  ClientSlot *slot = findClientSlot(header.clientId());
+  if (slot == 0)
+  {
+    cerr << "*** WARNING: Incoming UDP datagram from " << addr << ":" << port
+         << " has invalid client id " << header.clientId() << endl;
+    return 0;
+  }
+  ReflectorClient *client = slot->client;
+  if (addr != slot->addr)
   {
     cerr << "*** WARNING[" << client->callsign()
          << "]: Incoming UDP packet has the wrong source ip, "
-         << addr << " instead of " << client->remoteHost() << endl;
-    return;
+         << addr << " instead of " << slot->addr << endl;
+    return 0;
   }
-  if (client->remoteUdpPort() == 0)
+  if (slot->udp_port == 0)
   {
+    slot->udp_port = port;
     client->setRemoteUdpPort(port);
     client->sendUdpMsg(MsgUdpHeartbeat());
   }
-  else if (port != client->remoteUdpPort())
+  else if (port != slot->udp_port)
   {
     cerr << "*** WARNING[" << client->callsign()
          << "]: Incoming UDP packet has the wrong source UDP "
             "port number, " << port << " instead of "
-         << client->remoteUdpPort() << endl;
-    return;
+         << slot->udp_port << endl;
+    return 0;
   }
 
     // Check sequence number
-  uint16_t udp_rx_seq_diff = header.sequenceNum() - client->nextUdpRxSeq();
+  udp_rx_seq_diff = header.sequenceNum() - client->nextUdpRxSeq();
+  client->netStats().packetReceived(static_cast<int16_t>(udp_rx_seq_diff));
   if (udp_rx_seq_diff > 0x7fff) // Frame out of sequence (ignore)
   {
     cout << client->callsign()
          << ": Dropping out of sequence frame with seq="
          << header.sequenceNum() << ". Expected seq="
          << client->nextUdpRxSeq() << endl;
-    return;
+    return 0;
   }
   else if (udp_rx_seq_diff > 0) // Frame(s) lost
   {
@@ -427,7 +1201,15 @@ void Reflector::udpDatagramReceived(const IpAddress& addr, uint16_t port,
   }
 
   client->udpMsgReceived(header);
+  return client;
+} /* Reflector::udpAcceptDatagram */
 
+
+void Reflector::udpDispatchDatagram(ReflectorClient *client,
+                                    const ReflectorUdpMsg& header,
+                                    const char *data, int count,
+                                    uint16_t udp_rx_seq_diff)
+{
   switch (header.type())
   {
     case MsgUdpHeartbeat::TYPE:
@@ -437,29 +1219,74 @@ void Reflector::udpDatagramReceived(const IpAddress& addr, uint16_t port,
     {
       if (!client->isBlocked())
       {
-        MsgUdpAudio msg;
-        if (!msg.unpack(ss))
+          // Unpack the audio in place. The received datagram is forwarded
+          // as is, with only the header patched for each receiver.
+        MsgUdpAudioView msg;
+        if (!msg.unpack(data + ReflectorUdpMsg::HEADER_SIZE,
+                        count - ReflectorUdpMsg::HEADER_SIZE))
         {
           cerr << "*** WARNING[" << client->callsign()
                << "]: Could not unpack incoming MsgUdpAudioV1 message" << endl;
           return;
         }
-        uint32_t tg = TGHandler::instance()->TGForClient(client);
-        if (!msg.audioData().empty() && (tg > 0))
+        if (msg.audioSize() > 0)
         {
-          ReflectorClient* talker = TGHandler::instance()->talkerForTG(tg);
-          if (talker == 0)
-          {
-            TGHandler::instance()->setTalkerForTG(tg, client);
-            talker = TGHandler::instance()->talkerForTG(tg);
-          }
-          if (talker == client)
+          client->netStats().packetArrived();
+        }
+        if (msg.latencyMark() != 0)
+        {
+          AudioLatencyTrace::record("reflector", msg.latencyMark());
+        }
+        TGHandler* tg_handler = TGHandler::instance();
+        uint32_t tg = tg_handler->TGForClient(client);
+        if ((msg.audioSize() > 0) && (tg > 0) &&
+            (m_trunk_talkers.empty() || (m_trunk_talkers.count(tg) == 0)))
+        {
+          if (tg_handler->talkerAudio(client))
           {
-            TGHandler::instance()->setTalkerForTG(tg, client);
-            broadcastUdpMsg(msg,
-                ReflectorClient::mkAndFilter(
-                  ReflectorClient::ExceptFilter(client),
-                  ReflectorClient::TgFilter(tg)));
+            if (!m_trunks.empty())
+            {
+              ++m_trunk_tx_seq;
+              for (Trunks::iterator it = m_trunks.begin();
+                   it != m_trunks.end(); ++it)
+              {
+                (*it)->sendAudio(tg, m_trunk_session, m_trunk_tx_seq,
+                                 msg.audioData(), msg.audioSize());
+              }
+            }
+            streamAudio(tg, client->codec(), msg.audioData(), msg.audioSize());
+            const TGHandler::ClientSet& members =
+              tg_handler->clientsForTG(client);
+            if (m_transcoding)
+            {
+                // The transcoded frames are sent directly so the clients
+                // using the talker's codec must be collected afterwards
+              AudioLatencyTrace::Scope latency_scope(msg.latencyMark());
+              transcodeAudio(client, tg, msg, udp_rx_seq_diff > 0);
+              collectUdpClients(members, ReflectorClient::mkAndFilter(
+                    ReflectorClient::ExceptFilter(client),
+                    ReflectorClient::CodecFilter(client->codec())));
+            }
+            else
+            {
+              collectUdpClients(members, ReflectorClient::ExceptFilter(client));
+            }
+            const size_t size = ReflectorUdpMsg::HEADER_SIZE + msg.packedSize();
+            TGStats& tg_stats = m_tg_stats[tg];
+            tg_stats.frames += 1;
+            if (m_skip_dtx_frames && (msg.audioSize() <= 2))
+            {
+                // An Opus DTX frame is at most two bytes long. The receiving
+                // decoders fill the gap with comfort noise themselves.
+              m_dtx_skipped_frames += 1;
+              m_dtx_saved_pkts += m_udp_bcast_clients.size();
+              m_dtx_saved_bytes += m_udp_bcast_clients.size() * size;
+            }
+            else
+            {
+              tg_stats.fanout_pkts += m_udp_bcast_clients.size();
+              sendUdpBatch(data, size);
+            }
             //broadcastUdpMsgExcept(tg, client, msg,
             //    ProtoVerRange(ProtoVer(0, 6),
             //                  ProtoVer(1, ProtoVer::max().minor())));
@@ -508,11 +1335,11 @@ void Reflector::udpDatagramReceived(const IpAddress& addr, uint16_t port,
 
     case MsgUdpFlushSamples::TYPE:
     {
-      uint32_t tg = TGHandler::instance()->TGForClient(client);
-      ReflectorClient* talker = TGHandler::instance()->talkerForTG(tg);
-      if ((tg > 0) && (client == talker))
+      client->netStats().resetJitterReference();
+      if (TGHandler::instance()->isTalker(client))
       {
-        TGHandler::instance()->setTalkerForTG(tg, 0);
+        TGHandler::instance()->setTalkerForTG(
+            TGHandler::instance()->TGForClient(client), 0);
       }
         // To be 100% correct the reflector should wait for all connected
         // clients to send a MsgUdpAllSamplesFlushed message but that will
@@ -527,10 +1354,40 @@ void Reflector::udpDatagramReceived(const IpAddress& addr, uint16_t port,
       // Ignore
       break;
 
+    case MsgUdpPing::TYPE:
+    {
+      stringstream ss;
+      ss.write(data + ReflectorUdpMsg::HEADER_SIZE,
+               count - ReflectorUdpMsg::HEADER_SIZE);
+      MsgUdpPing msg;
+      if (msg.unpack(ss))
+      {
+        client->sendUdpMsg(MsgUdpPong(msg.timestamp()));
+      }
+      break;
+    }
+
+    case MsgUdpPong::TYPE:
+    {
+      stringstream ss;
+      ss.write(data + ReflectorUdpMsg::HEADER_SIZE,
+               count - ReflectorUdpMsg::HEADER_SIZE);
+      MsgUdpPong msg;
+      if (msg.unpack(ss))
+      {
+        client->netStats().pongReceived(msg.timestamp());
+        invalidateStatus();
+      }
+      break;
+    }
+
     case MsgUdpSignalStrengthValues::TYPE:
     {
       if (!client->isBlocked())
       {
+        stringstream ss;
+        ss.write(data + ReflectorUdpMsg::HEADER_SIZE,
+                 count - ReflectorUdpMsg::HEADER_SIZE);
         MsgUdpSignalStrengthValues msg;
         if (!msg.unpack(ss))
         {
@@ -550,11 +1407,10 @@ void Reflector::udpDatagramReceived(const IpAddress& addr, uint16_t port,
           //  << " sql_open=" << rx.sqlOpen()
           //  << " active=" << rx.active()
           //  << std::endl;
-          client->setRxSiglev(rx.id(), rx.siglev());
-          client->setRxEnabled(rx.id(), rx.enabled());
-          client->setRxSqlOpen(rx.id(), rx.sqlOpen());
-          client->setRxActive(rx.id(), rx.active());
+          client->setRxState(rx.id(), rx.siglev(), rx.enabled(), rx.sqlOpen(),
+                             rx.active());
         }
+        invalidateStatus();
       }
       break;
     }
@@ -568,39 +1424,44 @@ void Reflector::udpDatagramReceived(const IpAddress& addr, uint16_t port,
       //     << header.type() << endl;
       break;
   }
-} /* Reflector::udpDatagramReceived */
+} /* Reflector::udpDispatchDatagram */
 
 
 void Reflector::onTalkerUpdated(uint32_t tg, ReflectorClient* old_talker,
                                 ReflectorClient *new_talker)
 {
+  invalidateStatus();
   if (old_talker != 0)
   {
     cout << old_talker->callsign() << ": Talker stop on TG #" << tg << endl;
-    broadcastMsg(MsgTalkerStop(tg, old_talker->callsign()),
-        ReflectorClient::mkAndFilter(
-          v2_client_filter,
-          ReflectorClient::mkOrFilter(
-            ReflectorClient::TgFilter(tg),
-            ReflectorClient::TgMonitorFilter(tg))));
+    for (Trunks::iterator it = m_trunks.begin(); it != m_trunks.end(); ++it)
+    {
+      (*it)->talkerStop(tg, old_talker->callsign());
+    }
+    broadcastEventToTG(
+        MsgEventBatch::Event(MsgTalkerStop::TYPE, tg, old_talker->callsign()),
+        tg, true, v2_client_filter);
     if (tg == tgForV1Clients())
     {
       broadcastMsg(MsgTalkerStopV1(old_talker->callsign()), v1_client_filter);
     }
-    broadcastUdpMsg(MsgUdpFlushSamples(),
-          ReflectorClient::mkAndFilter(
-            ReflectorClient::TgFilter(tg),
-            ReflectorClient::ExceptFilter(old_talker)));
+      // Any audio still buffered in a transcoder must be sent before the
+      // flush message
+    deleteTranscoder(tg);
+    flushAudioStream(tg);
+    broadcastUdpMsgToTG(MsgUdpFlushSamples(), tg,
+        ReflectorClient::ExceptFilter(old_talker));
   }
   if (new_talker != 0)
   {
     cout << new_talker->callsign() << ": Talker start on TG #" << tg << endl;
-    broadcastMsg(MsgTalkerStart(tg, new_talker->callsign()),
-        ReflectorClient::mkAndFilter(
-          v2_client_filter,
-          ReflectorClient::mkOrFilter(
-            ReflectorClient::TgFilter(tg),
-            ReflectorClient::TgMonitorFilter(tg))));
+    for (Trunks::iterator it = m_trunks.begin(); it != m_trunks.end(); ++it)
+    {
+      (*it)->talkerStart(tg, new_talker->callsign());
+    }
+    broadcastEventToTG(
+        MsgEventBatch::Event(MsgTalkerStart::TYPE, tg, new_talker->callsign()),
+        tg, true, v2_client_filter);
     if (tg == tgForV1Clients())
     {
       broadcastMsg(MsgTalkerStartV1(new_talker->callsign()), v1_client_filter);
@@ -609,6 +1470,181 @@ void Reflector::onTalkerUpdated(uint32_t tg, ReflectorClient* old_talker,
 } /* Reflector::setTalker */
 
 
+void Reflector::tgClients(uint32_t tg, bool include_monitors,
+                          std::vector<ReflectorClient*>& clients)
+{
+  const TGHandler::ClientSet& members = TGHandler::instance()->clientsForTG(tg);
+  clients.assign(members.begin(), members.end());
+  if (include_monitors)
+  {
+    const TGHandler::ClientSet& monitors =
+      TGHandler::instance()->monitorsForTG(tg);
+    for (TGHandler::ClientSet::const_iterator it = monitors.begin();
+         it != monitors.end(); ++it)
+    {
+      if (members.count(*it) == 0)
+      {
+        clients.push_back(*it);
+      }
+    }
+  }
+} /* Reflector::tgClients */
+
+
+void Reflector::sendEvent(ReflectorClient *client,
+                          const MsgEventBatch::Event& event,
+                          FramedTcpConnection::Frame*& frame)
+{
+  if ((m_event_batch_timer.timeout() > 0) && event_batch_client_filter(client))
+  {
+    client->queueEvent(event);
+    if (!m_event_batch_timer.isEnabled())
+    {
+      m_event_batch_timer.setEnable(true);
+    }
+    return;
+  }
+
+    // The single event message for older clients is packed once, on first use
+  if (frame == 0)
+  {
+    switch (event.type())
+    {
+      case MsgNodeJoined::TYPE:
+        frame = ReflectorClient::packMsg(MsgNodeJoined(event.callsign()));
+        break;
+      case MsgNodeLeft::TYPE:
+        frame = ReflectorClient::packMsg(MsgNodeLeft(event.callsign()));
+        break;
+      case MsgTalkerStart::TYPE:
+        frame = ReflectorClient::packMsg(
+            MsgTalkerStart(event.tg(), event.callsign()));
+        break;
+      case MsgTalkerStop::TYPE:
+        frame = ReflectorClient::packMsg(
+            MsgTalkerStop(event.tg(), event.callsign()));
+        break;
+      default:
+        break;
+    }
+    if (frame == 0)
+    {
+      return;
+    }
+  }
+  client->sendFrame(frame, event.type());
+} /* Reflector::sendEvent */
+
+
+void Reflector::flushEventBatch(Async::Timer *t)
+{
+  for (size_t i=0; i<m_client_slots.size(); ++i)
+  {
+    if (m_client_slots[i].client != 0)
+    {
+      m_client_slots[i].client->flushEvents();
+    }
+  }
+} /* Reflector::flushEventBatch */
+
+
+void Reflector::loadState(void)
+{
+  std::ifstream is(m_state_file.c_str());
+  if (!is)
+  {
+    return;
+  }
+  Json::Value state;
+  try
+  {
+    is >> state;
+  }
+  catch (const Json::Exception& e)
+  {
+    cerr << "*** WARNING: Could not parse the state file \""
+         << m_state_file << "\": " << e.what() << endl;
+    return;
+  }
+  if (!state.isObject() || (state.get("version", 0).asInt() != 1) ||
+      !state["sessions"].isArray())
+  {
+    cerr << "*** WARNING: Ignoring unknown state file format in \""
+         << m_state_file << "\"" << endl;
+    return;
+  }
+
+  time_t now = time(NULL);
+  std::vector<uint32_t> resume_ids;
+  const Json::Value& sessions = state["sessions"];
+  for (Json::Value::ArrayIndex i=0; i<sessions.size(); ++i)
+  {
+    const Json::Value& entry = sessions[i];
+    if (!entry.isObject() || !entry["callsign"].isString() ||
+        !entry["token"].isString())
+    {
+      continue;
+    }
+    ReflectorClient::Session session;
+    session.token = entry["token"].asString();
+    session.client_id = entry.get("clientId", 0).asUInt();
+    session.tg = entry.get("tg", 0).asUInt();
+    const Json::Value& tgs = entry["monitoredTgs"];
+    if (tgs.isArray())
+    {
+      for (Json::Value::ArrayIndex j=0; j<tgs.size(); ++j)
+      {
+        session.monitored_tgs.push_back(tgs[j].asUInt());
+      }
+      std::sort(session.monitored_tgs.begin(), session.monitored_tgs.end());
+    }
+    session.blocktime = entry.get("blocktime", 0).asUInt();
+    session.expires = static_cast<time_t>(entry.get("expires", 0).asInt64());
+    if (session.token.empty() || (session.expires <= now))
+    {
+      continue;
+    }
+    m_resume_sessions[entry["callsign"].asString()] = session;
+    if ((session.client_id & ~CLIENT_ID_MASK) == 0)
+    {
+      resume_ids.push_back(session.client_id);
+    }
+  }
+
+    // New clients should not get an id that a resuming client want back so
+    // the slots used by the sessions are put last in the free list. Their
+    // generation is stepped so that another client using one of them does
+    // not get the exact id of the session.
+  for (std::vector<uint32_t>::const_iterator it = resume_ids.begin();
+       it != resume_ids.end(); ++it)
+  {
+    growClientSlots((*it & CLIENT_SLOT_MASK) + 1);
+  }
+  for (std::vector<uint32_t>::const_iterator it = resume_ids.begin();
+       it != resume_ids.end(); ++it)
+  {
+    uint32_t slot = *it & CLIENT_SLOT_MASK;
+    std::deque<uint32_t>::iterator free_it = std::find(
+        m_free_client_slots.begin(), m_free_client_slots.end(), slot);
+    if (free_it != m_free_client_slots.end())
+    {
+      m_free_client_slots.erase(free_it);
+      m_free_client_slots.push_back(slot);
+    }
+    m_client_slots[slot].id =
+      (*it + CLIENT_SLOT_MASK + 1) & CLIENT_ID_MASK;
+  }
+  cout << "Loaded " << m_resume_sessions.size()
+       << " resumable client sessions from " << m_state_file << endl;
+} /* Reflector::loadState */
+
+
+void Reflector::onStateSaveTimer(Async::Timer *t)
+{
+  saveState();
+} /* Reflector::onStateSaveTimer */
+
+
 void Reflector::httpRequestReceived(Async::HttpServerConnection *con,
                                     Async::HttpServerConnection::Request& req)
 {
@@ -624,7 +1660,32 @@ void Reflector::httpRequestReceived(Async::HttpServerConnection *con,
     return;
   }
 
-  if (req.target != "/status")
+  if (m_http_audio_streams && (req.target.compare(0, 7, "/audio/") == 0))
+  {
+    std::istringstream is(req.target.substr(7));
+    uint32_t tg = 0;
+    if ((is >> tg) && is.eof() && (tg > 0))
+    {
+      addAudioListener(con, req, tg);
+      return;
+    }
+  }
+
+  if (req.target == "/metrics")
+  {
+    Async::Metrics::instance().writeHttpResponse(con, req);
+    return;
+  }
+
+  std::string::size_type qpos = req.target.find('?');
+  if ((qpos != std::string::npos) &&
+      (req.target.compare(0, qpos, "/status") == 0))
+  {
+    statusQuery(con, req, req.target.substr(qpos + 1));
+    return;
+  }
+
+  if ((req.target != "/status") && (req.target != "/status/stream"))
   {
     res.setCode(404);
     res.setContent("application/json",
@@ -633,89 +1694,46 @@ void Reflector::httpRequestReceived(Async::HttpServerConnection *con,
     return;
   }
 
-  Json::Value status;
-  status["nodes"] = Json::Value(Json::objectValue);
-  ReflectorClientMap::const_iterator client_it;
-  for (client_it = m_client_map.begin(); client_it != m_client_map.end(); ++client_it)
+  if (req.target == "/status/stream")
   {
-    ReflectorClient* client = client_it->second;
-    Json::Value node(client->nodeInfo());
-    //node["addr"] = client->remoteHost().toString();
-    node["protoVer"]["majorVer"] = client->protoVer().majorVer();
-    node["protoVer"]["minorVer"] = client->protoVer().minorVer();
-    node["tg"] = client->currentTG();
-    Json::Value tgs = Json::Value(Json::arrayValue);
-    const std::set<uint32_t>& monitored_tgs = client->monitoredTGs();
-    for (std::set<uint32_t>::const_iterator mtg_it=monitored_tgs.begin();
-         mtg_it!=monitored_tgs.end(); ++mtg_it)
+    if (req.method == "HEAD")
     {
-      tgs.append(*mtg_it);
+      res.setCode(200);
+      res.setHeader("Content-Type", "text/event-stream");
+      con->write(res);
+      return;
     }
-    node["monitoredTGs"] = tgs;
-    bool is_talker =
-      TGHandler::instance()->talkerForTG(client->currentTG()) == client;
-    node["isTalker"] = is_talker;
-
-    if (node.isMember("qth") && node["qth"].isArray())
+    updateStatus();
+    res.setCode(200);
+    res.setHeader("Content-Type", "text/event-stream");
+    res.setHeader("Cache-Control", "no-cache");
+    con->setChunked();
+    con->write(res);
+    std::string event("event: status\ndata: " + m_status_str + "\n\n");
+    con->write(event.data(), event.size());
+    if (m_status_streams.empty())
     {
-      //std::cout << "### Found qth" << std::endl;
-      Json::Value& qths(node["qth"]);
-      for (Json::Value::ArrayIndex i=0; i<qths.size(); ++i)
-      {
-        Json::Value& qth(qths[i]);
-        if (qth.isMember("rx") && qth["rx"].isObject())
-        {
-          //std::cout << "### Found rx" << std::endl;
-          Json::Value::Members rxs(qth["rx"].getMemberNames());
-          for (Json::Value::Members::const_iterator it=rxs.begin(); it!=rxs.end(); ++it)
-          {
-            //std::cout << "### member=" << *it << std::endl;
-            const std::string& rx_id_str(*it);
-            if (rx_id_str.size() == 1)
-            {
-              char rx_id(rx_id_str[0]);
-              Json::Value& rx(qth["rx"][rx_id_str]);
-              if (client->rxExist(rx_id))
-              {
-                rx["siglev"] = client->rxSiglev(rx_id);
-                rx["enabled"] = client->rxEnabled(rx_id);
-                rx["sql_open"] = client->rxSqlOpen(rx_id);
-                rx["active"] = client->rxActive(rx_id);
-              }
-            }
-          }
-        }
-        if (qth.isMember("tx") && qth["tx"].isObject())
-        {
-          //std::cout << "### Found tx" << std::endl;
-          Json::Value::Members txs(qth["tx"].getMemberNames());
-          for (Json::Value::Members::const_iterator it=txs.begin(); it!=txs.end(); ++it)
-          {
-            //std::cout << "### member=" << *it << std::endl;
-            const std::string& tx_id_str(*it);
-            if (tx_id_str.size() == 1)
-            {
-              char tx_id(tx_id_str[0]);
-              Json::Value& tx(qth["tx"][tx_id_str]);
-              if (client->txExist(tx_id))
-              {
-                tx["transmit"] = client->txTransmit(tx_id);
-              }
-            }
-          }
-        }
-      }
+      m_status_pushed_nodes = m_status_nodes;
+      m_status_pushed_version = m_status_version;
     }
-    status["nodes"][client->callsign()] = node;
+    m_status_streams.insert(con);
+    m_status_push_timer.setEnable(true);
+    return;
   }
-  std::ostringstream os;
-  Json::StreamWriterBuilder builder;
-  builder["commentStyle"] = "None";
-  builder["indentation"] = ""; //The JSON document is written on a single line
-  Json::StreamWriter* writer = builder.newStreamWriter();
-  writer->write(status, &os);
-  delete writer;
-  res.setContent("application/json", os.str());
+
+  updateStatus();
+  res.setHeader("ETag", m_status_etag);
+  res.setHeader("Cache-Control", "no-cache");
+  HttpServerConnection::Headers::const_iterator inm_it =
+    findHttpHeader(req.headers, "If-None-Match");
+  if ((inm_it != req.headers.end()) &&
+      (inm_it->second.find(m_status_etag) != std::string::npos))
+  {
+    res.setCode(304);
+    con->write(res);
+    return;
+  }
+  res.setSharedContent("application/json", m_status_str);
   if (req.method == "HEAD")
   {
     res.setSendContent(false);
@@ -736,6 +1754,8 @@ void Reflector::httpClientConnected(Async::HttpServerConnection *con)
 void Reflector::httpClientDisconnected(Async::HttpServerConnection *con,
     Async::HttpServerConnection::DisconnectReason reason)
 {
+  m_status_streams.erase(con);
+  removeAudioListener(con);
   //std::cout << "### HTTP Client disconnected: "
   //          << con->remoteHost() << ":" << con->remotePort()
   //          << ": " << Async::HttpServerConnection::disconnectReasonStr(reason)
@@ -743,48 +1763,1486 @@ void Reflector::httpClientDisconnected(Async::HttpServerConnection *con,
 } /* Reflector::httpClientDisconnected */
 
 
-void Reflector::onRequestAutoQsy(uint32_t from_tg)
+void Reflector::updateStatus(void)
 {
-  uint32_t tg = nextRandomQsyTg();
-  if (tg == 0) { return; }
-
-  std::cout << "Requesting auto-QSY from TG #" << from_tg
-            << " to TG #" << tg << std::endl;
-
-  broadcastMsg(MsgRequestQsy(tg),
-      ReflectorClient::mkAndFilter(
-        v2_client_filter,
-        ReflectorClient::TgFilter(from_tg)));
-} /* Reflector::onRequestAutoQsy */
+  if (!m_status_dirty)
+  {
+    return;
+  }
 
+  NodeStatusMap nodes;
+  NodeTGMap node_tgs;
+  for (ClientSlots::const_iterator it = m_client_slots.begin();
+       it != m_client_slots.end(); ++it)
+  {
+    ReflectorClient* client = it->client;
+    if (client == 0)
+    {
+      continue;
+    }
+    nodes[client->callsign()] = nodeStatus(client);
+    node_tgs[client->callsign()] = client->currentTG();
+  }
 
-uint32_t Reflector::nextRandomQsyTg(void)
-{
-  if (m_random_qsy_tg == 0)
+  Json::Value status(Json::objectValue);
+  size_t client_mem = 0;
+  for (ReflectorClientConMap::const_iterator it = m_client_con_map.begin();
+       it != m_client_con_map.end(); ++it)
   {
-    std::cout << "*** WARNING: QSY request for random TG "
-              << "requested but RANDOM_QSY_RANGE is empty" << std::endl;
-    return 0;
+    client_mem += it->second->memoryUsage();
+  }
+  status["memory"]["clients"] = Json::UInt64(m_client_con_map.size());
+  status["memory"]["totalBytes"] = Json::UInt64(client_mem);
+  status["memory"]["bytesPerClient"] = Json::UInt64(
+      m_client_con_map.empty() ? 0 : client_mem / m_client_con_map.size());
+  status["memory"]["internedStrings"] =
+    Json::UInt64(InternedString::poolSize());
+  if (m_skip_dtx_frames)
+  {
+    status["dtx"]["skippedFrames"] = Json::UInt64(m_dtx_skipped_frames);
+    status["dtx"]["savedPackets"] = Json::UInt64(m_dtx_saved_pkts);
+    status["dtx"]["savedBytes"] = Json::UInt64(m_dtx_saved_bytes);
+  }
+  if (m_shared_node_cnt > 0)
+  {
+    status["sharedSessions"]["nodes"] = Json::UInt64(m_shared_node_cnt);
+    status["sharedSessions"]["savedPackets"] =
+      Json::UInt64(m_shared_saved_pkts);
+  }
+  if (!m_trunks.empty())
+  {
+    status["trunks"] = Json::Value(Json::objectValue);
+    for (Trunks::const_iterator it = m_trunks.begin(); it != m_trunks.end();
+         ++it)
+    {
+      const ReflectorTrunk *trunk = *it;
+      Json::Value& trunk_status = status["trunks"][trunk->name()];
+      trunk_status["peerId"] = trunk->peerId();
+      trunk_status["isUp"] = trunk->isUp();
+      Json::Value tgs = Json::Value(Json::arrayValue);
+      for (std::set<uint32_t>::const_iterator tg_it = trunk->peerTGs().begin();
+           tg_it != trunk->peerTGs().end(); ++tg_it)
+      {
+        tgs.append(*tg_it);
+      }
+      trunk_status["peerTGs"] = tgs;
+    }
+    status["trunkDuplicateFrames"] = Json::UInt64(m_trunk_dup_frames);
+  }
+  if (m_udp_prio)
+  {
+    Json::Value& prio = status["udpPriority"];
+    prio["audio"]["frames"] = Json::UInt64(m_udp_prio_stats.audio_frames);
+    prio["audio"]["maxDepth"] = Json::UInt64(m_udp_prio_stats.audio_max_depth);
+    prio["audio"]["maxDelayUs"] =
+      Json::UInt64(m_udp_prio_stats.audio_max_delay_us);
+    prio["control"]["msgs"] = Json::UInt64(m_udp_prio_stats.ctrl_msgs);
+    prio["control"]["depth"] = Json::UInt64(m_udp_ctrl_queue.size());
+    prio["control"]["maxDepth"] = Json::UInt64(m_udp_prio_stats.ctrl_max_depth);
+    prio["control"]["budgetExceeded"] =
+      Json::UInt64(m_udp_prio_stats.ctrl_budget_exceeded);
+  }
+  if (!m_audio_streams.empty())
+  {
+    status["audioStreams"] = Json::Value(Json::objectValue);
+    for (TGAudioStreamMap::const_iterator it = m_audio_streams.begin();
+         it != m_audio_streams.end(); ++it)
+    {
+      std::ostringstream tg_str;
+      tg_str << it->first;
+      Json::Value& stream_status = status["audioStreams"][tg_str.str()];
+      stream_status["listeners"] = Json::UInt64(it->second->listenerCount());
+      stream_status["skippedPages"] = Json::UInt64(it->second->skipCount());
+    }
   }
 
-  assert (m_random_qsy_tg != 0);
-  uint32_t range_size = m_random_qsy_hi-m_random_qsy_lo+1;
-  uint32_t i;
-  for (i=0; i<range_size; ++i)
+    // The node status objects are spliced into the document as text
+  std::string status_str("{\"nodes\":{");
+  for (NodeStatusMap::const_iterator it = nodes.begin(); it != nodes.end();
+       ++it)
   {
-    m_random_qsy_tg = (m_random_qsy_tg < m_random_qsy_hi) ?
-      m_random_qsy_tg+1 : m_random_qsy_lo;
-    if (TGHandler::instance()->clientsForTG(m_random_qsy_tg).empty())
+    if (it != nodes.begin())
     {
-      return m_random_qsy_tg;
+      status_str += ",";
     }
+    status_str += jsonToString(Json::Value(it->first));
+    status_str += ":";
+    status_str += it->second;
   }
+  status_str += "}";
+  std::string rest(jsonToString(status));
+  if (rest.size() > 2)
+  {
+    status_str += ",";
+    status_str.append(rest, 1, std::string::npos);
+  }
+  else
+  {
+    status_str += "}";
+  }
+  m_status_nodes.swap(nodes);
+  m_status_node_tgs.swap(node_tgs);
+  m_status_str.swap(status_str);
+  m_status_version += 1;
+  std::ostringstream ss;
+  ss << "\"" << std::hex << m_status_epoch << "-" << m_status_version << "\"";
+  m_status_etag = ss.str();
+  m_status_dirty = false;
+} /* Reflector::updateStatus */
+
+
+void Reflector::writeMetrics(Async::MetricsWriter& writer)
+{
+  typedef Async::MetricsWriter::Labels Labels;
+  const Labels no_labels;
 
-  std::cout << "*** WARNING: No random TG available for QSY" << std::endl;
-  return 0;
+  writer.gauge("svxreflector_clients", "Number of connected clients",
+               no_labels, m_client_con_map.size());
+  for (ClientSlots::const_iterator it = m_client_slots.begin();
+       it != m_client_slots.end(); ++it)
+  {
+    ReflectorClient* client = it->client;
+    if ((client == 0) || client->callsign().empty())
+    {
+      continue;
+    }
+    Labels labels(Async::Metrics::labels("callsign", client->callsign()));
+    const SvxLink::NetPathStats& net_stats = client->netStats();
+    writer.counter("svxreflector_node_udp_rx_packets",
+        "Number of audio packets received from the node", labels,
+        net_stats.rxPackets());
+    writer.counter("svxreflector_node_udp_lost_packets",
+        "Number of packets from the node that were lost in transit", labels,
+        net_stats.lostPackets());
+    writer.counter("svxreflector_node_udp_late_packets",
+        "Number of packets from the node that arrived out of order", labels,
+        net_stats.latePackets());
+    writer.gauge("svxreflector_node_udp_jitter_seconds",
+        "Interarrival jitter for audio packets from the node", labels,
+        net_stats.jitterMs() / 1000.0);
+    if (net_stats.hasRtt())
+    {
+      writer.gauge("svxreflector_node_rtt_seconds",
+          "The last measured round trip time to the node", labels,
+          net_stats.rttMs() / 1000.0);
+    }
+    writer.gauge("svxreflector_node_tcp_tx_queue_bytes",
+        "Number of bytes queued for sending to the node", labels,
+        client->txQueueSize());
+    writer.gauge("svxreflector_node_tcp_tx_queue_peak_bytes",
+        "Largest number of bytes queued for sending to the node", labels,
+        client->txQueuePeak());
+    writer.gauge("svxreflector_node_held_events",
+        "Number of events held back since the node is slow", labels,
+        client->pendingEvents());
+    writer.counter("svxreflector_node_coalesced_events",
+        "Number of events that cancelled out before being sent", labels,
+        client->coalescedEvents());
+  }
+  writer.counter("svxreflector_slow_client_disconnects",
+      "Number of clients disconnected for not reading fast enough", no_labels,
+      ReflectorClient::slowClientDisconnects());
+
+  for (TGStatsMap::const_iterator it = m_tg_stats.begin();
+       it != m_tg_stats.end(); ++it)
+  {
+    std::ostringstream tg_str;
+    tg_str << it->first;
+    Labels labels(Async::Metrics::labels("tg", tg_str.str()));
+    writer.counter("svxreflector_tg_audio_frames",
+        "Number of audio frames received from talkers on the talk group",
+        labels, it->second.frames);
+    writer.counter("svxreflector_tg_fanout_packets",
+        "Number of audio packets sent to listeners on the talk group",
+        labels, it->second.fanout_pkts);
+  }
+
+  TranscodeCpuMap transcode_cpu_ns(m_transcode_cpu_ns);
+  for (TranscoderMap::const_iterator it = m_transcoders.begin();
+       it != m_transcoders.end(); ++it)
+  {
+    transcode_cpu_ns[it->second->srcCodec()] += it->second->cpuTimeNs();
+  }
+  for (TranscodeCpuMap::const_iterator it = transcode_cpu_ns.begin();
+       it != transcode_cpu_ns.end(); ++it)
+  {
+    writer.counter("svxreflector_transcode_cpu_seconds",
+        "CPU time spent decoding and encoding audio for transcoding",
+        Async::Metrics::labels("codec", it->first), it->second / 1.0e9);
+  }
+
+  if (m_skip_dtx_frames)
+  {
+    writer.counter("svxreflector_dtx_skipped_frames",
+        "Number of DTX frames that were not forwarded", no_labels,
+        m_dtx_skipped_frames);
+    writer.counter("svxreflector_dtx_saved_packets",
+        "Number of packets saved by not forwarding DTX frames", no_labels,
+        m_dtx_saved_pkts);
+  }
+  writer.gauge("svxreflector_shared_nodes",
+               "Number of nodes logged in on a shared connection", no_labels,
+               m_shared_node_cnt);
+  writer.counter("svxreflector_shared_saved_packets",
+      "Number of UDP packets saved by delivering once per shared connection",
+      no_labels, m_shared_saved_pkts);
+  if (!m_trunks.empty())
+  {
+    writer.counter("svxreflector_trunk_duplicate_frames",
+        "Number of duplicate audio frames received over trunks", no_labels,
+        m_trunk_dup_frames);
+  }
+  if (m_udp_prio)
+  {
+    writer.counter("svxreflector_udp_prio_audio_frames",
+        "Number of audio frames handled before control messages", no_labels,
+        m_udp_prio_stats.audio_frames);
+    writer.counter("svxreflector_udp_prio_ctrl_msgs",
+        "Number of deferred UDP control messages", no_labels,
+        m_udp_prio_stats.ctrl_msgs);
+    writer.gauge("svxreflector_udp_prio_ctrl_queue_depth",
+        "Number of UDP control messages waiting to be handled", no_labels,
+        m_udp_ctrl_queue.size());
+  }
+  const Async::UdpSocket::SendStats& udp_stats = m_udp_sock->sendStats();
+  unsigned long udp_dropped = udp_stats.dropped;
+  unsigned long udp_retried = 0;
+  for (FanoutWorkers::const_iterator it = m_fanout_workers.begin();
+       it != m_fanout_workers.end(); ++it)
+  {
+    udp_dropped += (*it)->droppedCnt();
+    udp_retried += (*it)->retriedCnt();
+  }
+  writer.counter("svxreflector_udp_send_queued",
+      "Number of UDP datagrams queued since the send buffer was full",
+      no_labels, udp_stats.queued);
+  writer.counter("svxreflector_udp_send_retries",
+      "Number of UDP send retries in the fan-out threads", no_labels,
+      udp_retried);
+  writer.counter("svxreflector_udp_send_dropped",
+      "Number of UDP datagrams dropped since the send buffer was full",
+      no_labels, udp_dropped);
+  writer.counter("svxreflector_udp_send_errors",
+      "Number of UDP datagrams that could not be sent due to an error",
+      no_labels, udp_stats.errors);
+  for (TGAudioStreamMap::const_iterator it = m_audio_streams.begin();
+       it != m_audio_streams.end(); ++it)
+  {
+    std::ostringstream tg_str;
+    tg_str << it->first;
+    writer.gauge("svxreflector_audio_stream_listeners",
+        "Number of HTTP audio stream listeners on the talk group",
+        Async::Metrics::labels("tg", tg_str.str()),
+        it->second->listenerCount());
+  }
+} /* Reflector::writeMetrics */
+
+
+std::string Reflector::nodeStatus(ReflectorClient* client)
+{
+  Json::Value node(Json::objectValue);
+  //node["addr"] = client->remoteHost().toString();
+  node["protoVer"]["majorVer"] = client->protoVer().majorVer();
+  node["protoVer"]["minorVer"] = client->protoVer().minorVer();
+  node["tg"] = client->currentTG();
+  node["codec"] = client->codec();
+  if (client->isSharedNode())
+  {
+    node["sharedSession"] = client->sharedSessionOwner()->callsign();
+  }
+  const SvxLink::NetPathStats& net_stats = client->netStats();
+  Json::Value net(Json::objectValue);
+  net["rxPackets"] = Json::UInt64(net_stats.rxPackets());
+  net["rxLost"] = Json::UInt64(net_stats.lostPackets());
+  net["rxLate"] = Json::UInt64(net_stats.latePackets());
+  net["rxJitterMs"] = net_stats.jitterMs();
+  if (net_stats.hasRtt())
+  {
+    net["rttMs"] = net_stats.rttMs();
+    net["rttMinMs"] = net_stats.rttMinMs();
+    net["rttMaxMs"] = net_stats.rttMaxMs();
+    net["rttAvgMs"] = net_stats.rttAvgMs();
+  }
+  node["net"] = net;
+  Json::Value tgs = Json::Value(Json::arrayValue);
+  const ReflectorClient::TGList& monitored_tgs = client->monitoredTGs();
+  for (ReflectorClient::TGList::const_iterator mtg_it=monitored_tgs.begin();
+       mtg_it!=monitored_tgs.end(); ++mtg_it)
+  {
+    tgs.append(*mtg_it);
+  }
+  node["monitoredTGs"] = tgs;
+  bool is_talker = TGHandler::instance()->isTalker(client);
+  node["isTalker"] = is_talker;
+
+    // Splice the cached node information text in with the live members
+  std::string status(jsonToString(node));
+  status.erase(status.size() - 1);
+  const std::string& info = client->nodeInfoJson();
+  if (info.size() > 2)
+  {
+    status += ",";
+    status.append(info, 1, info.size() - 2);
+  }
+  if (!client->nodeQthJson().empty())
+  {
+    status += ",\"qth\":";
+    status += qthStatus(client);
+  }
+  status += "}";
+  return status;
+} /* Reflector::nodeStatus */
+
+
+/*
+ * Answer a /status request with query parameters. Only the nodes selected by
+ * the tg and callsign filters, and the offset and limit pagination
+ * parameters, are returned. The cached node status fragments are copied as
+ * is unless a fields list is given, in which case only the selected
+ * fragments are parsed to pick out the requested members.
+ */
+void Reflector::statusQuery(Async::HttpServerConnection *con,
+                            Async::HttpServerConnection::Request& req,
+                            const std::string& query)
+{
+  Async::HttpServerConnection::Response res;
+  QueryParams params(parseQuery(query));
+  bool filter_tg = false;
+  unsigned long tg = 0;
+  std::string callsign_prefix;
+  std::vector<std::string> fields;
+  unsigned long offset = 0;
+  unsigned long limit = 0;
+  bool has_limit = false;
+  std::string error;
+  for (QueryParams::const_iterator it = params.begin(); it != params.end();
+       ++it)
+  {
+    if (it->first == "tg")
+    {
+      filter_tg = true;
+      if (!parseUnsigned(it->second, tg))
+      {
+        error = "Illegal tg value";
+      }
+    }
+    else if (it->first == "callsign")
+    {
+        // Callsigns are always in upper case
+      callsign_prefix = it->second;
+      std::transform(callsign_prefix.begin(), callsign_prefix.end(),
+                     callsign_prefix.begin(), ::toupper);
+    }
+    else if (it->first == "fields")
+    {
+      std::istringstream is(it->second);
+      std::string field;
+      while (std::getline(is, field, ','))
+      {
+        if (!field.empty())
+        {
+          fields.push_back(field);
+        }
+      }
+    }
+    else if (it->first == "offset")
+    {
+      if (!parseUnsigned(it->second, offset))
+      {
+        error = "Illegal offset value";
+      }
+    }
+    else if (it->first == "limit")
+    {
+      has_limit = true;
+      if (!parseUnsigned(it->second, limit))
+      {
+        error = "Illegal limit value";
+      }
+    }
+    else
+    {
+      error = "Unknown query parameter: " + it->first;
+    }
+  }
+  if (!error.empty())
+  {
+    res.setCode(400);
+    res.setContent("application/json",
+        "{\"msg\":" + jsonToString(Json::Value(error)) + "}");
+    con->write(res);
+    return;
+  }
+
+  updateStatus();
+  res.setHeader("ETag", m_status_etag);
+  res.setHeader("Cache-Control", "no-cache");
+  HttpServerConnection::Headers::const_iterator inm_it =
+    findHttpHeader(req.headers, "If-None-Match");
+  if ((inm_it != req.headers.end()) &&
+      (inm_it->second.find(m_status_etag) != std::string::npos))
+  {
+    res.setCode(304);
+    con->write(res);
+    return;
+  }
+
+    // The node map is sorted on callsign so a prefix match is a range
+  NodeStatusMap::const_iterator it = m_status_nodes.begin();
+  if (!callsign_prefix.empty())
+  {
+    it = m_status_nodes.lower_bound(callsign_prefix);
+  }
+  std::string nodes_str;
+  unsigned long total = 0;
+  unsigned long count = 0;
+  for (; it != m_status_nodes.end(); ++it)
+  {
+    const std::string& callsign = it->first;
+    if (callsign.compare(0, callsign_prefix.size(), callsign_prefix) != 0)
+    {
+      break;
+    }
+    if (filter_tg)
+    {
+      NodeTGMap::const_iterator tg_it = m_status_node_tgs.find(callsign);
+      if ((tg_it == m_status_node_tgs.end()) || (tg_it->second != tg))
+      {
+        continue;
+      }
+    }
+    total += 1;
+    if ((total <= offset) || (has_limit && (count >= limit)))
+    {
+      continue;
+    }
+    count += 1;
+
+    if (!nodes_str.empty())
+    {
+      nodes_str += ",";
+    }
+    nodes_str += jsonToString(Json::Value(callsign));
+    nodes_str += ":";
+    if (fields.empty())
+    {
+      nodes_str += it->second;
+      continue;
+    }
+    Json::Value node;
+    Json::Value selected(Json::objectValue);
+    std::istringstream is(it->second);
+    if (is >> node)
+    {
+      for (std::vector<std::string>::const_iterator field_it = fields.begin();
+           field_it != fields.end(); ++field_it)
+      {
+        if (node.isMember(*field_it))
+        {
+          selected[*field_it] = node[*field_it];
+        }
+      }
+    }
+    nodes_str += jsonToString(selected);
+  }
+
+  std::ostringstream ss;
+  ss << "{\"nodes\":{" << nodes_str << "},\"total\":" << total
+     << ",\"offset\":" << offset << ",\"count\":" << count << "}";
+  res.setContent("application/json", ss.str());
+  if (req.method == "HEAD")
+  {
+    res.setSendContent(false);
+  }
+  res.setCode(200);
+  con->write(res);
+} /* Reflector::statusQuery */
+
+
+std::string Reflector::qthStatus(ReflectorClient* client)
+{
+  Json::Value qths;
+  std::istringstream is(client->nodeQthJson());
+  is >> qths;
+  if (qths.isArray())
+  {
+    //std::cout << "### Found qth" << std::endl;
+    for (Json::Value::ArrayIndex i=0; i<qths.size(); ++i)
+    {
+      Json::Value& qth(qths[i]);
+      if (qth.isMember("rx") && qth["rx"].isObject())
+      {
+        //std::cout << "### Found rx" << std::endl;
+        Json::Value::Members rxs(qth["rx"].getMemberNames());
+        for (Json::Value::Members::const_iterator it=rxs.begin(); it!=rxs.end(); ++it)
+        {
+          //std::cout << "### member=" << *it << std::endl;
+          const std::string& rx_id_str(*it);
+          if (rx_id_str.size() == 1)
+          {
+            char rx_id(rx_id_str[0]);
+            Json::Value& rx(qth["rx"][rx_id_str]);
+            if (client->rxExist(rx_id))
+            {
+              rx["siglev"] = client->rxSiglev(rx_id);
+              rx["enabled"] = client->rxEnabled(rx_id);
+              rx["sql_open"] = client->rxSqlOpen(rx_id);
+              rx["active"] = client->rxActive(rx_id);
+            }
+          }
+        }
+      }
+      if (qth.isMember("tx") && qth["tx"].isObject())
+      {
+        //std::cout << "### Found tx" << std::endl;
+        Json::Value::Members txs(qth["tx"].getMemberNames());
+        for (Json::Value::Members::const_iterator it=txs.begin(); it!=txs.end(); ++it)
+        {
+          //std::cout << "### member=" << *it << std::endl;
+          const std::string& tx_id_str(*it);
+          if (tx_id_str.size() == 1)
+          {
+            char tx_id(tx_id_str[0]);
+            Json::Value& tx(qth["tx"][tx_id_str]);
+            if (client->txExist(tx_id))
+            {
+              tx["transmit"] = client->txTransmit(tx_id);
+            }
+          }
+        }
+      }
+    }
+  }
+  return jsonToString(qths);
+} /* Reflector::qthStatus */
+
+
+std::string Reflector::jsonToString(const Json::Value& value)
+{
+  std::ostringstream os;
+  Json::StreamWriterBuilder builder;
+  builder["commentStyle"] = "None";
+  builder["indentation"] = ""; //The JSON document is written on a single line
+  Json::StreamWriter* writer = builder.newStreamWriter();
+  writer->write(value, &os);
+  delete writer;
+  return os.str();
+} /* Reflector::jsonToString */
+
+
+void Reflector::pushStatusDelta(Async::Timer *t)
+{
+  if (m_status_streams.empty())
+  {
+    m_status_push_timer.setEnable(false);
+    m_status_pushed_nodes.clear();
+    return;
+  }
+
+  updateStatus();
+  if (m_status_version == m_status_pushed_version)
+  {
+    return;
+  }
+
+    // Only send the nodes that have been added or changed and the callsigns
+    // of the nodes that have been removed since the last push. The node
+    // status text is generated deterministically so it can be compared as is.
+  std::string changed;
+  for (NodeStatusMap::const_iterator it = m_status_nodes.begin();
+       it != m_status_nodes.end(); ++it)
+  {
+    NodeStatusMap::const_iterator old_it = m_status_pushed_nodes.find(it->first);
+    if ((old_it == m_status_pushed_nodes.end()) ||
+        (old_it->second != it->second))
+    {
+      if (!changed.empty())
+      {
+        changed += ",";
+      }
+      changed += jsonToString(Json::Value(it->first));
+      changed += ":";
+      changed += it->second;
+    }
+  }
+  Json::Value removed(Json::arrayValue);
+  for (NodeStatusMap::const_iterator it = m_status_pushed_nodes.begin();
+       it != m_status_pushed_nodes.end(); ++it)
+  {
+    if (m_status_nodes.find(it->first) == m_status_nodes.end())
+    {
+      removed.append(it->first);
+    }
+  }
+  m_status_pushed_nodes = m_status_nodes;
+  m_status_pushed_version = m_status_version;
+  if (changed.empty() && removed.empty())
+  {
+    return;
+  }
+
+  std::string event("event: delta\ndata: {\"nodes\":{" + changed +
+                    "},\"removed\":" + jsonToString(removed) + "}\n\n");
+  for (HttpConSet::const_iterator it = m_status_streams.begin();
+       it != m_status_streams.end(); ++it)
+  {
+    (*it)->write(event.data(), event.size());
+  }
+} /* Reflector::pushStatusDelta */
+
+
+void Reflector::onRequestAutoQsy(uint32_t from_tg)
+{
+  uint32_t tg = nextRandomQsyTg();
+  if (tg == 0) { return; }
+
+  std::cout << "Requesting auto-QSY from TG #" << from_tg
+            << " to TG #" << tg << std::endl;
+
+  broadcastMsgToTG(MsgRequestQsy(tg), from_tg, false, v2_client_filter);
+} /* Reflector::onRequestAutoQsy */
+
+
+uint32_t Reflector::nextRandomQsyTg(void)
+{
+  if (m_random_qsy_tg == 0)
+  {
+    std::cout << "*** WARNING: QSY request for random TG "
+              << "requested but RANDOM_QSY_RANGE is empty" << std::endl;
+    return 0;
+  }
+
+  assert (m_random_qsy_tg != 0);
+  uint32_t range_size = m_random_qsy_hi-m_random_qsy_lo+1;
+  uint32_t i;
+  for (i=0; i<range_size; ++i)
+  {
+    m_random_qsy_tg = (m_random_qsy_tg < m_random_qsy_hi) ?
+      m_random_qsy_tg+1 : m_random_qsy_lo;
+    if (TGHandler::instance()->clientsForTG(m_random_qsy_tg).empty())
+    {
+      return m_random_qsy_tg;
+    }
+  }
+
+  std::cout << "*** WARNING: No random TG available for QSY" << std::endl;
+  return 0;
 } /* Reflector::nextRandomQsyTg */
 
 
+void Reflector::setSqlTimeout(const unsigned& sql_timeout)
+{
+  TGHandler::instance()->setSqlTimeout(sql_timeout);
+  cout << "Setting SQL_TIMEOUT to " << sql_timeout << endl;
+} /* Reflector::setSqlTimeout */
+
+
+void Reflector::setSqlTimeoutBlocktime(const unsigned& blocktime)
+{
+  TGHandler::instance()->setSqlTimeoutBlocktime(blocktime);
+  cout << "Setting SQL_TIMEOUT_BLOCKTIME to " << blocktime << endl;
+} /* Reflector::setSqlTimeoutBlocktime */
+
+
+void Reflector::setTgForV1Clients(const uint32_t& tg)
+{
+  m_tg_for_v1_clients = tg;
+  cout << "Setting TG_FOR_V1_CLIENTS to " << tg << endl;
+} /* Reflector::setTgForV1Clients */
+
+
+void Reflector::setRandomQsyRange(const std::string& range)
+{
+  m_random_qsy_lo = m_random_qsy_hi = 0;
+  if (range.empty())
+  {
+    return;
+  }
+
+  SvxLink::SepPair<uint32_t, uint32_t> random_qsy_range;
+  std::istringstream is(range);
+  if (!(is >> random_qsy_range))
+  {
+    cout << "*** WARNING: Illegal RANDOM_QSY_RANGE specified. Ignored."
+         << endl;
+    return;
+  }
+  m_random_qsy_lo = random_qsy_range.first;
+  m_random_qsy_hi = m_random_qsy_lo + random_qsy_range.second-1;
+  if ((m_random_qsy_lo < 1) || (m_random_qsy_hi < m_random_qsy_lo))
+  {
+    cout << "*** WARNING: Illegal RANDOM_QSY_RANGE specified. Ignored."
+         << endl;
+    m_random_qsy_hi = m_random_qsy_lo = 0;
+  }
+  m_random_qsy_tg = m_random_qsy_hi;
+} /* Reflector::setRandomQsyRange */
+
+
+void Reflector::sendUdpBatch(const ReflectorUdpMsg& msg,
+                             const Async::Msg *ext)
+{
+  if (m_udp_bcast_clients.empty())
+  {
+    return;
+  }
+
+    // Pack the message only once. The header is patched per client below.
+  ReflectorUdpMsg header(msg.type());
+  m_udp_pack_buf.resize(header.packedSize() + msg.packedSize() +
+                        ((ext != 0) ? ext->packedSize() : 0));
+  Async::MsgWriter w(&m_udp_pack_buf[0], m_udp_pack_buf.size());
+  if (!header.pack(w) || !msg.pack(w) || ((ext != 0) && !ext->pack(w)))
+  {
+    cerr << "*** ERROR: Failed to pack reflector UDP message of type "
+         << msg.type() << endl;
+    return;
+  }
+  sendUdpBatch(&m_udp_pack_buf[0], w.size());
+} /* Reflector::sendUdpBatch */
+
+
+void Reflector::sendUdpBatch(const char *packed, size_t len)
+{
+  assert(len >= ReflectorUdpMsg::HEADER_SIZE);
+  if (m_shared_node_cnt > 0)
+  {
+    sendUdpMuxDeliveries(packed, len);
+  }
+  if (m_udp_bcast_clients.empty())
+  {
+    return;
+  }
+
+  if (!m_fanout_workers.empty())
+  {
+    sendUdpBatchThreaded(packed, len);
+    return;
+  }
+
+  const size_t cnt = m_udp_bcast_clients.size();
+  m_udp_bcast_hdrs.resize(cnt * ReflectorUdpMsg::HEADER_SIZE);
+  m_udp_bcast_iov.resize(2 * cnt);
+  m_udp_bcast_dgrams.resize(cnt);
+  size_t dgram_cnt = 0;
+  for (size_t i=0; i<cnt; ++i)
+  {
+    ReflectorClient *client = m_udp_bcast_clients[i];
+    uint16_t seq;
+    if (!client->prepareUdpTx(seq))
+    {
+      continue;
+    }
+    char *hdr = &m_udp_bcast_hdrs[dgram_cnt * ReflectorUdpMsg::HEADER_SIZE];
+    memcpy(hdr, packed, ReflectorUdpMsg::HEADER_SIZE);
+    ReflectorUdpMsg::setPackedHeader(hdr, client->clientId(), seq);
+
+    struct iovec *iov = &m_udp_bcast_iov[2 * dgram_cnt];
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = ReflectorUdpMsg::HEADER_SIZE;
+    iov[1].iov_base = const_cast<char*>(packed) + ReflectorUdpMsg::HEADER_SIZE;
+    iov[1].iov_len = len - ReflectorUdpMsg::HEADER_SIZE;
+
+    Async::UdpSocket::Datagram& dgram = m_udp_bcast_dgrams[dgram_cnt];
+    dgram.ip = client->remoteHost();
+    dgram.port = client->remoteUdpPort();
+    dgram.iov = iov;
+    dgram.iovcnt = 2;
+    ++dgram_cnt;
+  }
+  if (dgram_cnt > 0)
+  {
+    (void)m_udp_sock->writeBatch(&m_udp_bcast_dgrams[0], dgram_cnt);
+  }
+} /* Reflector::sendUdpBatch */
+
+
+void Reflector::sendUdpBatchThreaded(const char *packed, size_t len)
+{
+  m_fanout_dests.resize(m_fanout_workers.size());
+  for (size_t i=0; i<m_fanout_dests.size(); ++i)
+  {
+    m_fanout_dests[i].clear();
+  }
+  for (size_t i=0; i<m_udp_bcast_clients.size(); ++i)
+  {
+    ReflectorClient *client = m_udp_bcast_clients[i];
+    UdpFanoutWorker::Dest dest;
+    if (!client->prepareUdpTx(dest.seq))
+    {
+      continue;
+    }
+    dest.ip = client->remoteHost();
+    dest.port = client->remoteUdpPort();
+    dest.client_id = client->clientId();
+    m_fanout_dests[client->clientId() % m_fanout_workers.size()].push_back(
+        dest);
+  }
+  for (size_t i=0; i<m_fanout_workers.size(); ++i)
+  {
+    if (!m_fanout_dests[i].empty())
+    {
+      m_fanout_workers[i]->send(packed, len, &m_fanout_dests[i][0],
+                                m_fanout_dests[i].size());
+    }
+  }
+} /* Reflector::sendUdpBatchThreaded */
+
+
+void Reflector::sendUdpMuxDeliveries(const char *packed, size_t len)
+{
+    // Move all clients on shared connections out of the broadcast list and
+    // sort them so that the nodes on the same connection are next to each
+    // other
+  m_udp_mux_clients.clear();
+  size_t keep = 0;
+  for (size_t i=0; i<m_udp_bcast_clients.size(); ++i)
+  {
+    ReflectorClient *client = m_udp_bcast_clients[i];
+    if (client->sharedSessionOwner() != 0)
+    {
+      m_udp_mux_clients.push_back(client);
+    }
+    else
+    {
+      m_udp_bcast_clients[keep++] = client;
+    }
+  }
+  m_udp_bcast_clients.resize(keep);
+  if (m_udp_mux_clients.empty())
+  {
+    return;
+  }
+  std::stable_sort(m_udp_mux_clients.begin(), m_udp_mux_clients.end(),
+      [](ReflectorClient *a, ReflectorClient *b)
+      {
+        return a->sharedSessionOwner() < b->sharedSessionOwner();
+      });
+
+  ReflectorUdpMsg header;
+  if (!header.unpackHeader(packed, len))
+  {
+    return;
+  }
+  const size_t body_len = len - ReflectorUdpMsg::HEADER_SIZE;
+  size_t begin = 0;
+  while (begin < m_udp_mux_clients.size())
+  {
+    ReflectorClient *owner = m_udp_mux_clients[begin]->sharedSessionOwner();
+    size_t end = begin + 1;
+    while ((end < m_udp_mux_clients.size()) &&
+           (m_udp_mux_clients[end]->sharedSessionOwner() == owner))
+    {
+      ++end;
+    }
+
+      // A node alone on its connection get the message as usual
+    if (end - begin == 1)
+    {
+      m_udp_bcast_clients.push_back(m_udp_mux_clients[begin]);
+      begin = end;
+      continue;
+    }
+
+    MsgUdpMuxDelivery msg(header.type());
+    ReflectorClient *first = 0;
+    for (size_t i=begin; i<end; ++i)
+    {
+      ReflectorClient *client = m_udp_mux_clients[i];
+      if (client->remoteUdpPort() == 0)
+      {
+        continue;
+      }
+      if (first == 0)
+      {
+        first = client;
+      }
+      else
+      {
+        msg.clientIds().push_back(client->clientId());
+      }
+    }
+    begin = end;
+    uint16_t seq;
+    if ((first == 0) || !first->prepareUdpTx(seq))
+    {
+      continue;
+    }
+
+    ReflectorUdpMsg mux_header(MsgUdpMuxDelivery::TYPE, first->clientId(),
+                               seq);
+    m_udp_mux_buf.resize(mux_header.packedSize() + msg.packedSize() +
+                         body_len);
+    Async::MsgWriter w(&m_udp_mux_buf[0], m_udp_mux_buf.size());
+    if (!mux_header.pack(w) || !msg.pack(w) ||
+        !w.write(packed + ReflectorUdpMsg::HEADER_SIZE, body_len))
+    {
+      cerr << "*** ERROR: Failed to pack reflector UDP message of type "
+           << MsgUdpMuxDelivery::TYPE << endl;
+      continue;
+    }
+    (void)sendUdpDatagram(first, &m_udp_mux_buf[0], w.size());
+    m_shared_saved_pkts += msg.clientIds().size();
+  }
+} /* Reflector::sendUdpMuxDeliveries */
+
+
+UdpFanoutWorker* Reflector::fanoutWorkerForClient(ReflectorClient *client)
+{
+  assert(!m_fanout_workers.empty());
+  return m_fanout_workers[client->clientId() % m_fanout_workers.size()];
+} /* Reflector::fanoutWorkerForClient */
+
+
+void Reflector::collectUdpClientsForTG(uint32_t tg,
+                                       const ReflectorClient::Filter& filter)
+{
+  collectUdpClients(TGHandler::instance()->clientsForTG(tg), filter);
+} /* Reflector::collectUdpClientsForTG */
+
+
+void Reflector::collectUdpClients(const TGHandler::ClientSet& members,
+                                  const ReflectorClient::Filter& filter)
+{
+  m_udp_bcast_clients.clear();
+  for (TGHandler::ClientSet::const_iterator it = members.begin();
+       it != members.end(); ++it)
+  {
+    ReflectorClient *client = *it;
+    if (filter(client) &&
+        (client->conState() == ReflectorClient::STATE_CONNECTED) &&
+        (client->remoteUdpPort() != 0))
+    {
+      m_udp_bcast_clients.push_back(client);
+    }
+  }
+} /* Reflector::collectUdpClients */
+
+
+bool Reflector::initCodecs(Async::Config &cfg)
+{
+  cfg.getValue("GLOBAL", "TRANSCODING", m_transcoding);
+
+  string codecs;
+  if (cfg.getValue("GLOBAL", "CODECS", codecs))
+  {
+    SvxLink::splitStr(m_codecs, codecs, ",");
+  }
+  if ((m_codecs.size() > 1) && !m_transcoding)
+  {
+    m_codecs.erase(m_codecs.begin()+1, m_codecs.end());
+    cout << "*** WARNING: The GLOBAL/CODECS configuration "
+            "variable can only take one codec unless GLOBAL/TRANSCODING is "
+            "enabled. Using the first one: \"" << m_codecs.front() << "\""
+         << endl;
+  }
+  else if (m_codecs.empty())
+  {
+    string codec = "GSM";
+    if (AudioDecoder::isAvailable("OPUS") &&
+        AudioEncoder::isAvailable("OPUS"))
+    {
+      codec = "OPUS";
+    }
+    else if (AudioDecoder::isAvailable("SPEEX") &&
+             AudioEncoder::isAvailable("SPEEX"))
+    {
+      codec = "SPEEX";
+    }
+    m_codecs.push_back(codec);
+  }
+
+  list<string> names = cfg.listSection("GLOBAL");
+  for (vector<string>::const_iterator cit=m_codecs.begin();
+       cit!=m_codecs.end(); ++cit)
+  {
+    if (m_transcoding &&
+        (!AudioDecoder::isAvailable(*cit) || !AudioEncoder::isAvailable(*cit)))
+    {
+      cerr << "*** ERROR: Codec \"" << *cit << "\" in GLOBAL/CODECS is not "
+              "available for transcoding" << endl;
+      return false;
+    }
+
+      // Encoder options for the codec, e.g. OPUS_ENC_DTX, are forwarded to
+      // the clients and are also used by the transcoders
+    string opt_prefix = *cit + "_ENC_";
+    for (list<string>::const_iterator it=names.begin(); it!=names.end(); ++it)
+    {
+      if ((*it).find(opt_prefix) == 0)
+      {
+        cfg.getValue("GLOBAL", *it,
+            m_codec_enc_options[*cit][(*it).substr(opt_prefix.size())]);
+      }
+    }
+  }
+
+  if (m_transcoding && (m_codecs.size() > 1))
+  {
+    cout << "Transcoding between codecs enabled" << endl;
+  }
+
+  return true;
+} /* Reflector::initCodecs */
+
+
+void Reflector::transcodeAudio(ReflectorClient *talker, uint32_t tg,
+                               const MsgUdpAudioView& msg, bool frame_lost)
+{
+  TranscoderMap::iterator it = m_transcoders.find(tg);
+  if ((it != m_transcoders.end()) &&
+      ((*it).second->srcCodec() != talker->codec()))
+  {
+    deleteTranscoder(tg);
+    it = m_transcoders.end();
+  }
+
+    // Find out which other codecs the listeners on the TG use
+  std::set<std::string> target_codecs;
+  const TGHandler::ClientSet& members =
+    TGHandler::instance()->clientsForTG(talker);
+  for (TGHandler::ClientSet::const_iterator mit = members.begin();
+       mit != members.end(); ++mit)
+  {
+    ReflectorClient *client = *mit;
+    if ((client->codec() != talker->codec()) &&
+        (client->conState() == ReflectorClient::STATE_CONNECTED) &&
+        (client->remoteUdpPort() != 0))
+    {
+      target_codecs.insert(client->codec());
+    }
+  }
+  if ((it == m_transcoders.end()) && target_codecs.empty())
+  {
+    return;
+  }
+
+  if (it == m_transcoders.end())
+  {
+    Transcoder *transcoder = new Transcoder(tg, talker->codec());
+    if (!transcoder->initOk())
+    {
+      delete transcoder;
+      return;
+    }
+    transcoder->encodedAudio.connect(
+        mem_fun(*this, &Reflector::onTranscodedAudio));
+    it = m_transcoders.insert(make_pair(tg, transcoder)).first;
+  }
+  Transcoder *transcoder = (*it).second;
+  for (std::set<std::string>::const_iterator cit = target_codecs.begin();
+       cit != target_codecs.end(); ++cit)
+  {
+    transcoder->addTarget(*cit, codecEncOptions(*cit));
+  }
+  transcoder->writeEncodedSamples(const_cast<uint8_t*>(msg.audioData()),
+                                  msg.audioSize(), frame_lost);
+} /* Reflector::transcodeAudio */
+
+
+void Reflector::onTranscodedAudio(Transcoder *transcoder,
+                                  const std::string& codec,
+                                  const void *buf, int size)
+{
+  uint32_t tg = transcoder->tg();
+  ReflectorClient *talker = TGHandler::instance()->talkerForTG(tg);
+  collectUdpClientsForTG(tg, ReflectorClient::mkAndFilter(
+        ReflectorClient::ExceptFilter(talker),
+        ReflectorClient::CodecFilter(codec)));
+  m_tg_stats[tg].fanout_pkts += m_udp_bcast_clients.size();
+    // The latency trace mark is forwarded if the frame was encoded while
+    // decoding the marked frame
+  if (AudioLatencyTrace::current() != 0)
+  {
+    MsgUdpAudioLatencyMark latency_mark(AudioLatencyTrace::current());
+    sendUdpBatch(MsgUdpAudio(buf, size), &latency_mark);
+  }
+  else
+  {
+    sendUdpBatch(MsgUdpAudio(buf, size));
+  }
+} /* Reflector::onTranscodedAudio */
+
+
+void Reflector::deleteTranscoder(uint32_t tg)
+{
+  TranscoderMap::iterator it = m_transcoders.find(tg);
+  if (it == m_transcoders.end())
+  {
+    return;
+  }
+  Transcoder *transcoder = (*it).second;
+  m_transcoders.erase(it);
+  transcoder->flush();
+  m_transcode_cpu_ns[transcoder->srcCodec()] += transcoder->cpuTimeNs();
+  delete transcoder;
+} /* Reflector::deleteTranscoder */
+
+
+bool Reflector::initTrunks(Async::Config &cfg)
+{
+  std::vector<std::string> trunk_names;
+  cfg.getValue("GLOBAL", "TRUNKS", trunk_names);
+  if (trunk_names.empty())
+  {
+    return true;
+  }
+
+  if (!cfg.getValue("GLOBAL", "TRUNK_ID", m_trunk_id) || m_trunk_id.empty())
+  {
+    cerr << "*** ERROR: Config variable GLOBAL/TRUNK_ID must be set when "
+            "using trunks" << endl;
+    return false;
+  }
+
+    // The session number make it possible for the other reflectors to tell
+    // the frames sent after a restart from old duplicated frames
+  gcry_create_nonce(&m_trunk_session, sizeof(m_trunk_session));
+
+  bool has_passive_trunks = false;
+  for (std::vector<std::string>::const_iterator it = trunk_names.begin();
+       it != trunk_names.end(); ++it)
+  {
+    ReflectorTrunk *trunk = new ReflectorTrunk(*it, m_trunk_id);
+    if (!trunk->initialize(cfg))
+    {
+      delete trunk;
+      return false;
+    }
+    trunk->talkerStarted.connect(
+        mem_fun(*this, &Reflector::onTrunkTalkerStarted));
+    trunk->talkerStopped.connect(
+        mem_fun(*this, &Reflector::onTrunkTalkerStopped));
+    trunk->audioReceived.connect(
+        mem_fun(*this, &Reflector::onTrunkAudio));
+    trunk->linkStateChanged.connect(
+        sigc::hide(sigc::hide(mem_fun(*this, &Reflector::invalidateStatus))));
+    m_trunks.push_back(trunk);
+    has_passive_trunks |= !trunk->isActive();
+  }
+
+  if (has_passive_trunks)
+  {
+    std::string trunk_listen_port("5302");
+    cfg.getValue("GLOBAL", "TRUNK_LISTEN_PORT", trunk_listen_port);
+    m_trunk_srv = new FramedTcpServer(trunk_listen_port);
+    m_trunk_srv->clientConnected.connect(
+        mem_fun(*this, &Reflector::trunkClientConnected));
+    m_trunk_srv->clientDisconnected.connect(
+        mem_fun(*this, &Reflector::trunkClientDisconnected));
+  }
+
+  return true;
+} /* Reflector::initTrunks */
+
+
+void Reflector::trunkClientConnected(Async::FramedTcpConnection *con)
+{
+  cout << "Trunk connection from " << con->remoteHost() << ":"
+       << con->remotePort() << endl;
+  con->setMaxFrameSize(ReflectorMsg::MAX_PREAUTH_FRAME_SIZE);
+  con->frameReceived.connect(mem_fun(*this, &Reflector::trunkFrameReceived));
+
+  MsgAuthChallenge msg;
+  m_trunk_pending[con].assign(msg.challenge(),
+                              msg.challenge() + MsgAuthChallenge::CHALLENGE_LEN);
+  ostringstream ss;
+  ReflectorMsg header(msg.type());
+  if (!header.pack(ss) || !msg.pack(ss))
+  {
+    cerr << "*** ERROR: Failed to pack trunk TCP message\n";
+    return;
+  }
+  con->write(ss.str().data(), ss.str().size());
+} /* Reflector::trunkClientConnected */
+
+
+void Reflector::trunkClientDisconnected(Async::FramedTcpConnection *con,
+                            Async::FramedTcpConnection::DisconnectReason reason)
+{
+  if (m_trunk_pending.erase(con) > 0)
+  {
+    cout << "Unauthenticated trunk connection from " << con->remoteHost()
+         << ":" << con->remotePort() << " disconnected: "
+         << TcpConnection::disconnectReasonStr(reason) << endl;
+    return;
+  }
+  for (Trunks::iterator it = m_trunks.begin(); it != m_trunks.end(); ++it)
+  {
+    ReflectorTrunk *trunk = *it;
+    if (trunk->isConnection(con))
+    {
+      cout << trunk->name() << ": Trunk peer " << trunk->peerId()
+           << " disconnected: " << TcpConnection::disconnectReasonStr(reason)
+           << endl;
+      trunk->connectionClosed(con);
+    }
+  }
+} /* Reflector::trunkClientDisconnected */
+
+
+void Reflector::trunkFrameReceived(Async::FramedTcpConnection *con,
+                                   std::vector<uint8_t>& data)
+{
+  TrunkPendingMap::iterator pending_it = m_trunk_pending.find(con);
+  if (pending_it == m_trunk_pending.end())
+  {
+    for (Trunks::iterator it = m_trunks.begin(); it != m_trunks.end(); ++it)
+    {
+      if ((*it)->isConnection(con))
+      {
+        (*it)->handleFrame(data);
+        return;
+      }
+    }
+    return;
+  }
+
+  stringstream ss;
+  ss.write(reinterpret_cast<const char*>(&data.front()), data.size());
+  ReflectorMsg header;
+  MsgAuthResponse msg;
+  if (!header.unpack(ss) || (header.type() != MsgAuthResponse::TYPE) ||
+      !msg.unpack(ss))
+  {
+    if (header.type() == MsgHeartbeat::TYPE)
+    {
+      return;
+    }
+    cout << "*** WARNING: Unexpected message on trunk connection from "
+         << con->remoteHost() << ":" << con->remotePort() << endl;
+    m_trunk_pending.erase(pending_it);
+    con->disconnect();
+    con->disconnected(con, FramedTcpConnection::DR_ORDERED_DISCONNECT);
+    return;
+  }
+
+  std::vector<uint8_t> challenge;
+  challenge.swap(pending_it->second);
+  m_trunk_pending.erase(pending_it);
+  for (Trunks::iterator it = m_trunks.begin(); it != m_trunks.end(); ++it)
+  {
+    ReflectorTrunk *trunk = *it;
+    if (trunk->authenticate(msg, &challenge.front()))
+    {
+      cout << trunk->name() << ": Trunk peer " << trunk->peerId()
+           << " authenticated from " << con->remoteHost() << ":"
+           << con->remotePort() << endl;
+      trunk->accept(con);
+      return;
+    }
+  }
+
+  cout << "*** WARNING: Trunk authentication failed for \"" << msg.callsign()
+       << "\" from " << con->remoteHost() << ":" << con->remotePort() << endl;
+  con->disconnect();
+  con->disconnected(con, FramedTcpConnection::DR_ORDERED_DISCONNECT);
+} /* Reflector::trunkFrameReceived */
+
+
+void Reflector::onTrunkTalkerStarted(ReflectorTrunk *trunk, uint32_t tg,
+                                     const std::string& callsign)
+{
+  ReflectorClient *local_talker = TGHandler::instance()->talkerForTG(tg);
+  TrunkTalkerMap::iterator it = m_trunk_talkers.find(tg);
+  if ((local_talker != 0) ||
+      ((it != m_trunk_talkers.end()) && (it->second.trunk != trunk)))
+  {
+    cout << callsign << ": Ignoring talker on TG #" << tg << " from trunk "
+         << trunk->peerId() << " since the talk group is busy" << endl;
+    return;
+  }
+  if (it != m_trunk_talkers.end())
+  {
+    onTrunkTalkerStopped(trunk, tg, it->second.callsign);
+  }
+
+  TrunkTalker& talker = m_trunk_talkers[tg];
+  talker.trunk = trunk;
+  talker.callsign = callsign;
+  invalidateStatus();
+  cout << callsign << ": Talker start on TG #" << tg << " via trunk "
+       << trunk->peerId() << endl;
+  broadcastEventToTG(MsgEventBatch::Event(MsgTalkerStart::TYPE, tg, callsign),
+                     tg, true, v2_client_filter);
+  if (tg == tgForV1Clients())
+  {
+    broadcastMsg(MsgTalkerStartV1(callsign), v1_client_filter);
+  }
+} /* Reflector::onTrunkTalkerStarted */
+
+
+void Reflector::onTrunkTalkerStopped(ReflectorTrunk *trunk, uint32_t tg,
+                                     const std::string& callsign)
+{
+  TrunkTalkerMap::iterator it = m_trunk_talkers.find(tg);
+  if ((it == m_trunk_talkers.end()) || (it->second.trunk != trunk))
+  {
+    return;
+  }
+  std::string talker_callsign(it->second.callsign);
+  m_trunk_talkers.erase(it);
+  invalidateStatus();
+  cout << talker_callsign << ": Talker stop on TG #" << tg << " via trunk "
+       << trunk->peerId() << endl;
+  broadcastEventToTG(
+      MsgEventBatch::Event(MsgTalkerStop::TYPE, tg, talker_callsign),
+      tg, true, v2_client_filter);
+  if (tg == tgForV1Clients())
+  {
+    broadcastMsg(MsgTalkerStopV1(talker_callsign), v1_client_filter);
+  }
+  flushAudioStream(tg);
+  broadcastUdpMsgToTG(MsgUdpFlushSamples(), tg);
+} /* Reflector::onTrunkTalkerStopped */
+
+
+void Reflector::onTrunkAudio(ReflectorTrunk *trunk, const MsgTrunkAudio& msg)
+{
+    // Throw away frames that have already been seen. That happen if a frame
+    // find its way back to the originating reflector or if it arrive over
+    // more than one trunk link.
+  if (msg.origin() == m_trunk_id)
+  {
+    m_trunk_dup_frames += 1;
+    return;
+  }
+  TrunkSeenMap::iterator seen_it = m_trunk_seen.find(msg.origin());
+  if (seen_it == m_trunk_seen.end())
+  {
+    seen_it = m_trunk_seen.insert(
+        make_pair(msg.origin(), TrunkSeen())).first;
+  }
+  else if ((seen_it->second.session == msg.session()) &&
+           (static_cast<int32_t>(msg.seq() - seen_it->second.seq) <= 0))
+  {
+    m_trunk_dup_frames += 1;
+    return;
+  }
+  seen_it->second.session = msg.session();
+  seen_it->second.seq = msg.seq();
+
+  TrunkTalkerMap::const_iterator it = m_trunk_talkers.find(msg.tg());
+  if ((it == m_trunk_talkers.end()) || (it->second.trunk != trunk))
+  {
+    return;
+  }
+
+    // Audio from other reflectors is not transcoded so it is only sent to
+    // the clients using the primary codec
+  broadcastUdpMsgToTG(
+      MsgUdpAudio(&msg.audioData().front(), msg.audioData().size()),
+      msg.tg(), ReflectorClient::CodecFilter(m_codecs.front()));
+  streamAudio(msg.tg(), m_codecs.front(), &msg.audioData().front(),
+              msg.audioData().size());
+} /* Reflector::onTrunkAudio */
+
+
+void Reflector::addAudioListener(Async::HttpServerConnection *con,
+                                 Async::HttpServerConnection::Request& req,
+                                 uint32_t tg)
+{
+  removeAudioListener(con);
+
+  Async::HttpServerConnection::Response res;
+  TGAudioStreamMap::iterator it = m_audio_streams.find(tg);
+  if (it == m_audio_streams.end())
+  {
+    TGAudioStream *stream = new TGAudioStream(tg);
+    if (!stream->initOk())
+    {
+      delete stream;
+      res.setCode(503);
+      res.setContent("application/json",
+          "{\"msg\":\"Audio streaming not available\"}");
+      con->write(res);
+      return;
+    }
+    it = m_audio_streams.insert(make_pair(tg, stream)).first;
+  }
+  TGAudioStream *stream = it->second;
+
+  res.setCode(200);
+  res.setHeader("Content-Type", stream->mediaType());
+  res.setHeader("Cache-Control", "no-cache");
+  if (req.method == "HEAD")
+  {
+    con->write(res);
+    if (stream->listenerCount() == 0)
+    {
+      delete stream;
+      m_audio_streams.erase(it);
+    }
+    return;
+  }
+
+    // The stream has no length so it is ended by closing the connection
+  res.setHeader("Connection", "close");
+  con->write(res);
+  stream->addListener(con);
+  m_audio_listeners[con] = tg;
+  cout << "HTTP: Audio stream listener " << con->remoteHost() << ":"
+       << con->remotePort() << " added to TG #" << tg << endl;
+  invalidateStatus();
+} /* Reflector::addAudioListener */
+
+
+void Reflector::removeAudioListener(Async::HttpServerConnection *con)
+{
+  AudioListenerMap::iterator it = m_audio_listeners.find(con);
+  if (it == m_audio_listeners.end())
+  {
+    return;
+  }
+  uint32_t tg = it->second;
+  m_audio_listeners.erase(it);
+  TGAudioStreamMap::iterator stream_it = m_audio_streams.find(tg);
+  assert(stream_it != m_audio_streams.end());
+  TGAudioStream *stream = stream_it->second;
+  stream->removeListener(con);
+  if (stream->listenerCount() == 0)
+  {
+    delete stream;
+    m_audio_streams.erase(stream_it);
+  }
+  invalidateStatus();
+} /* Reflector::removeAudioListener */
+
+
+void Reflector::streamAudio(uint32_t tg, const std::string& codec,
+                            const void *buf, int size)
+{
+  if (m_audio_streams.empty())
+  {
+    return;
+  }
+  TGAudioStreamMap::iterator it = m_audio_streams.find(tg);
+  if (it != m_audio_streams.end())
+  {
+    it->second->writeEncodedSamples(codec, buf, size);
+  }
+} /* Reflector::streamAudio */
+
+
+void Reflector::flushAudioStream(uint32_t tg)
+{
+  TGAudioStreamMap::iterator it = m_audio_streams.find(tg);
+  if (it != m_audio_streams.end())
+  {
+    it->second->flush();
+  }
+} /* Reflector::flushAudioStream */
+
+
+static unsigned long elapsedUs(const struct timespec& since)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - since.tv_sec) * 1000000UL +
+         (now.tv_nsec - since.tv_nsec) / 1000;
+} /* elapsedUs */
+
+
 /*
  * This file has not been truncated
  */
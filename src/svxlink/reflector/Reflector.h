@@ -38,6 +38,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sys/time.h>
 #include <vector>
 #include <string>
+#include <set>
+#include <map>
+#include <deque>
+#include <json/json.h>
 
 
 /****************************************************************************
@@ -47,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncTcpServer.h>
+#include <AsyncUdpSocket.h>
 #include <AsyncFramedTcpConnection.h>
 #include <AsyncTimer.h>
 #include <AsyncHttpServerConnection.h>
@@ -60,6 +65,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "ProtoVer.h"
 #include "ReflectorClient.h"
+#include "UdpFanoutWorker.h"
+#include "Transcoder.h"
+#include "ReflectorTrunk.h"
+#include "TGAudioStream.h"
 
 
 /****************************************************************************
@@ -72,6 +81,7 @@ namespace Async
 {
   class UdpSocket;
   class Config;
+  class MetricsWriter;
 };
 
 class ReflectorMsg;
@@ -157,6 +167,48 @@ class Reflector : public sigc::trackable
     void broadcastMsg(const ReflectorMsg& msg,
         const ReflectorClient::Filter& filter=ReflectorClient::NoFilter());
 
+    /**
+     * @brief   Broadcast a TCP message to the clients on a talk group
+     * @param   msg The message to broadcast
+     * @param   tg The talk group to broadcast to
+     * @param   include_monitors Also send to clients monitoring the TG
+     * @param   filter The client filter to apply
+     *
+     * This function works like broadcastMsg but only the subscribers of the
+     * given talk group are visited so the cost scale with the size of the
+     * talk group rather than with the number of connected clients.
+     */
+    void broadcastMsgToTG(const ReflectorMsg& msg, uint32_t tg,
+        bool include_monitors,
+        const ReflectorClient::Filter& filter=ReflectorClient::NoFilter());
+
+    /**
+     * @brief   Broadcast a node or talker event to connected clients
+     * @param   event The event to broadcast
+     * @param   filter The client filter to apply
+     *
+     * Clients that support it get the event queued for the next
+     * MsgEventBatch message, which is sent at the end of a short batching
+     * window. Older clients get the corresponding single event message
+     * directly, e.g. MsgNodeJoined.
+     */
+    void broadcastEvent(const MsgEventBatch::Event& event,
+        const ReflectorClient::Filter& filter=ReflectorClient::NoFilter());
+
+    /**
+     * @brief   Broadcast a node or talker event to the clients on a TG
+     * @param   event The event to broadcast
+     * @param   tg The talk group to broadcast to
+     * @param   include_monitors Also send to clients monitoring the TG
+     * @param   filter The client filter to apply
+     *
+     * This function works like broadcastEvent but only the subscribers of
+     * the given talk group are visited.
+     */
+    void broadcastEventToTG(const MsgEventBatch::Event& event, uint32_t tg,
+        bool include_monitors,
+        const ReflectorClient::Filter& filter=ReflectorClient::NoFilter());
+
     /**
      * @brief   Send a UDP datagram to the specificed ReflectorClient
      * @param   client The client to the send datagram to
@@ -166,30 +218,242 @@ class Reflector : public sigc::trackable
      */
     bool sendUdpDatagram(ReflectorClient *client, const void *buf, size_t count);
 
+    /**
+     * @brief   Broadcast an UDP message to clients
+     * @param   msg The message to broadcast
+     * @param   filter The client filter to apply
+     *
+     * The message is only packed once. The header is then patched with the
+     * client ID and sequence number for each client and all datagrams are
+     * sent in one batch.
+     */
     void broadcastUdpMsg(const ReflectorUdpMsg& msg,
         const ReflectorClient::Filter& filter=ReflectorClient::NoFilter());
 
+    /**
+     * @brief   Broadcast an UDP message to the clients on a talk group
+     * @param   msg The message to broadcast
+     * @param   tg The talk group to broadcast to
+     * @param   filter The client filter to apply
+     *
+     * This function works like broadcastUdpMsg but only the clients that
+     * are members of the given talk group are visited.
+     */
+    void broadcastUdpMsgToTG(const ReflectorUdpMsg& msg, uint32_t tg,
+        const ReflectorClient::Filter& filter=ReflectorClient::NoFilter());
+
     /**
      * @brief   Get the TG for protocol V1 clients
      * @return  Returns the TG used for protocol V1 clients
      */
     uint32_t tgForV1Clients(void) { return m_tg_for_v1_clients; }
 
+    /**
+     * @brief   Get the codecs offered to clients
+     * @return  Returns the codecs in order of preference
+     *
+     * The first codec in the list is the primary codec. Clients that do not
+     * tell which codec they use are assumed to use that one.
+     */
+    const std::vector<std::string>& codecs(void) const { return m_codecs; }
+
+    /**
+     * @brief   Get the encoder options for a codec
+     * @param   codec The name of the codec
+     * @return  Returns the <CODEC>_ENC_* options from the GLOBAL section
+     */
+    const MsgCodecOptions::Options& codecEncOptions(
+        const std::string& codec) const;
+
     /**
      * @brief   Request QSY to another talk group
      * @param   tg The talk group to QSY to
      */
     void requestQsy(ReflectorClient *client, uint32_t tg);
 
+    /**
+     * @brief   Mark the status document as outdated
+     *
+     * The status document served by the HTTP server is cached. This
+     * function must be called when something that is part of the status
+     * changes so that it is rebuilt on the next request.
+     */
+    void invalidateStatus(void) { m_status_dirty = true; }
+
+    /**
+     * @brief   Tell the reflector that a client login handshake has ended
+     * @param   con The client connection
+     *
+     * This function must be called when a client has logged in or when the
+     * login has failed. It release the handshake slot that the connection
+     * held so that another waiting client connection can be accepted.
+     */
+    void loginHandshakeDone(Async::FramedTcpConnection *con);
+
+    /**
+     * @brief   Add a node that log in on the connection of another client
+     * @param   parent  The client owning the connection
+     * @param   con     The shared connection
+     * @param   channel The channel used by the node
+     * @return  Returns the new client object or 0 if no client id was free
+     *
+     * This function is called by a client when a MsgMuxFrame open a new
+     * channel on its connection.
+     */
+    ReflectorClient* addSharedNode(ReflectorClient *parent,
+                                   Async::FramedTcpConnection *con,
+                                   uint16_t channel);
+
+    /**
+     * @brief   Tell the reflector that a shared node has disconnected
+     * @param   client  The shared node client object
+     *
+     * The client object is deleted after the function has returned.
+     */
+    void sharedNodeDisconnected(ReflectorClient *client);
+
+    /**
+     * @brief   Check if clients may resume their sessions
+     * @return  Returns \em true if a state file has been configured
+     */
+    bool sessionResumeEnabled(void) const { return !m_state_file.empty(); }
+
+    /**
+     * @brief   Take the resumable session for a callsign
+     * @param   callsign The callsign to look up the session for
+     * @param   session Return the session state here
+     * @return  Returns \em true if a session that has not expired was found
+     *
+     * The session is removed when taken so each session can only be
+     * resumed once.
+     */
+    bool takeSession(const std::string& callsign,
+                     ReflectorClient::Session& session);
+
+    /**
+     * @brief   Give a client another client id
+     * @param   client The client to change the id for
+     * @param   client_id The new client id
+     * @return  Returns \em true on success or \em false if the id is in use
+     *          or is not a valid client id
+     */
+    bool changeClientId(ReflectorClient *client, uint32_t client_id);
+
+    /**
+     * @brief   Write the state snapshot to the state file
+     *
+     * The snapshot contain the session state for all logged in clients and
+     * for the sessions that have not yet been resumed or expired. It is
+     * written periodically and should also be written on shutdown so that
+     * the clients can resume their sessions when the reflector is started
+     * again. Nothing is done if no state file has been configured.
+     */
+    void saveState(void);
+
   private:
-    typedef std::map<uint32_t, ReflectorClient*> ReflectorClientMap;
+    static const unsigned UDP_RECV_BATCH_SIZE = 32;
+    static const size_t   UDP_RECV_MAX_SIZE   = 4096;
+
+    static const unsigned CLIENT_SLOT_BITS = 13;
+    static const uint32_t CLIENT_SLOT_MASK = (1 << CLIENT_SLOT_BITS) - 1;
+    static const uint32_t CLIENT_ID_MASK   = 0xffff;
+
+      // A client id is the slot index in the low bits and a generation
+      // counter in the high bits. The generation is stepped each time a slot
+      // is released so that datagrams for an old client are never taken to
+      // be for the new one using the same slot. The ids must fit in the
+      // sixteen bit client id field of the UDP header.
+    struct ClientSlot
+    {
+      ReflectorClient*  client;
+      uint32_t          id;
+      uint16_t          udp_port;
+      Async::IpAddress  addr;
+
+      ClientSlot(void) : client(0), id(0), udp_port(0) {}
+    };
+    typedef std::vector<ClientSlot> ClientSlots;
     typedef std::map<Async::FramedTcpConnection*,
                      ReflectorClient*> ReflectorClientConMap;
     typedef Async::TcpServer<Async::FramedTcpConnection> FramedTcpServer;
+    typedef std::vector<UdpFanoutWorker*> FanoutWorkers;
+    typedef std::vector<std::vector<UdpFanoutWorker::Dest> > FanoutDests;
+    typedef std::set<Async::HttpServerConnection*> HttpConSet;
+    typedef std::map<std::string, std::string> NodeStatusMap;
+    typedef std::map<std::string, uint32_t> NodeTGMap;
+    typedef std::map<std::string, ReflectorClient::Session> SessionMap;
+    typedef std::map<std::string, MsgCodecOptions::Options> CodecOptionsMap;
+    typedef std::map<uint32_t, Transcoder*> TranscoderMap;
+    typedef std::vector<ReflectorTrunk*> Trunks;
+    typedef std::map<Async::FramedTcpConnection*,
+                     std::vector<uint8_t> > TrunkPendingMap;
+    struct TrunkTalker
+    {
+      ReflectorTrunk* trunk;
+      std::string     callsign;
+    };
+    typedef std::map<uint32_t, TrunkTalker> TrunkTalkerMap;
+    struct TrunkSeen
+    {
+      uint32_t session;
+      uint32_t seq;
+    };
+    typedef std::map<std::string, TrunkSeen> TrunkSeenMap;
+    typedef std::map<uint32_t, TGAudioStream*> TGAudioStreamMap;
+    typedef std::map<Async::HttpServerConnection*, uint32_t> AudioListenerMap;
+    struct UdpAudioDatagram
+    {
+      ReflectorClient*  client;
+      ReflectorUdpMsg   header;
+      const char*       data;
+      int               len;
+      uint16_t          seq_diff;
+    };
+    struct UdpCtrlDatagram
+    {
+      uint32_t          client_id;
+      ReflectorUdpMsg   header;
+      std::vector<char> data;
+      uint16_t          seq_diff;
+    };
+    typedef std::map<uint32_t, unsigned> UdpCtrlPendingMap;
+    struct UdpPrioStats
+    {
+      unsigned long audio_frames;
+      size_t        audio_max_depth;
+      unsigned long audio_max_delay_us;
+      unsigned long ctrl_msgs;
+      size_t        ctrl_max_depth;
+      unsigned long ctrl_budget_exceeded;
+
+      UdpPrioStats(void)
+        : audio_frames(0), audio_max_depth(0), audio_max_delay_us(0),
+          ctrl_msgs(0), ctrl_max_depth(0), ctrl_budget_exceeded(0) {}
+    };
+
+    struct TGStats
+    {
+      uint64_t frames;
+      uint64_t fanout_pkts;
+
+      TGStats(void) : frames(0), fanout_pkts(0) {}
+    };
+    typedef std::map<uint32_t, TGStats> TGStatsMap;
+    typedef std::map<std::string, uint64_t> TranscodeCpuMap;
+
+    static const unsigned STATUS_PUSH_INTERVAL = 1000;
+    static const unsigned DEFAULT_EVENT_BATCH_INTERVAL = 50;
+    static const unsigned DEFAULT_STATE_SAVE_INTERVAL = 60;
+    static const unsigned DEFAULT_SESSION_RESUME_TIMEOUT = 300;
+    static const unsigned DEFAULT_MAX_CONCURRENT_LOGINS = 32;
+    static const size_t DEFAULT_UDP_SEND_QUEUE = 256;
+    static const size_t DEFAULT_UDP_PACING_CHUNK = 32;
+    static const unsigned long UDP_CTRL_TIME_BUDGET_US = 2000;
 
     FramedTcpServer*                                m_srv;
     Async::UdpSocket*                               m_udp_sock;
-    ReflectorClientMap                              m_client_map;
+    ClientSlots                                     m_client_slots;
+    std::deque<uint32_t>                            m_free_client_slots;
     ReflectorClientConMap                           m_client_con_map;
     Async::Config*                                  m_cfg;
     uint32_t                                        m_tg_for_v1_clients;
@@ -197,16 +461,108 @@ class Reflector : public sigc::trackable
     uint32_t                                        m_random_qsy_hi;
     uint32_t                                        m_random_qsy_tg;
     Async::TcpServer<Async::HttpServerConnection>*  m_http_server;
+    std::vector<char>                               m_udp_pack_buf;
+    std::vector<ReflectorClient*>                   m_udp_bcast_clients;
+    std::vector<char>                               m_udp_bcast_hdrs;
+    std::vector<struct iovec>                       m_udp_bcast_iov;
+    std::vector<Async::UdpSocket::Datagram>         m_udp_bcast_dgrams;
+    FanoutWorkers                                   m_fanout_workers;
+    FanoutDests                                     m_fanout_dests;
+    std::vector<std::string>                        m_codecs;
+    CodecOptionsMap                                 m_codec_enc_options;
+    bool                                            m_transcoding;
+    TranscoderMap                                   m_transcoders;
+    bool                                            m_skip_dtx_frames;
+    unsigned long                                   m_dtx_skipped_frames;
+    unsigned long                                   m_dtx_saved_pkts;
+    unsigned long                                   m_dtx_saved_bytes;
+    size_t                                          m_shared_node_cnt;
+    unsigned long                                   m_shared_saved_pkts;
+    std::vector<ReflectorClient*>                   m_udp_mux_clients;
+    std::vector<char>                               m_udp_mux_buf;
+    bool                                            m_status_dirty;
+    NodeStatusMap                                   m_status_nodes;
+    NodeTGMap                                       m_status_node_tgs;
+    std::string                                     m_status_str;
+    std::string                                     m_status_etag;
+    time_t                                          m_status_epoch;
+    unsigned long                                   m_status_version;
+    NodeStatusMap                                   m_status_pushed_nodes;
+    unsigned long                                   m_status_pushed_version;
+    HttpConSet                                      m_status_streams;
+    Async::Timer                                    m_status_push_timer;
+    std::string                                     m_trunk_id;
+    uint32_t                                        m_trunk_session;
+    uint32_t                                        m_trunk_tx_seq;
+    Trunks                                          m_trunks;
+    FramedTcpServer*                                m_trunk_srv;
+    TrunkPendingMap                                 m_trunk_pending;
+    TrunkTalkerMap                                  m_trunk_talkers;
+    TrunkSeenMap                                    m_trunk_seen;
+    unsigned long                                   m_trunk_dup_frames;
+    bool                                            m_http_audio_streams;
+    TGAudioStreamMap                                m_audio_streams;
+    AudioListenerMap                                m_audio_listeners;
+    bool                                            m_udp_prio;
+    std::vector<UdpAudioDatagram>                   m_udp_audio_batch;
+    std::deque<UdpCtrlDatagram>                     m_udp_ctrl_queue;
+    UdpCtrlPendingMap                               m_udp_ctrl_pending;
+    Async::Timer                                    m_udp_ctrl_timer;
+    Async::Timer                                    m_event_batch_timer;
+    std::string                                     m_state_file;
+    unsigned                                        m_session_resume_timeout;
+    SessionMap                                      m_resume_sessions;
+    Async::Timer                                    m_state_save_timer;
+    UdpPrioStats                                    m_udp_prio_stats;
+    TGStatsMap                                      m_tg_stats;
+    TranscodeCpuMap                                 m_transcode_cpu_ns;
 
     Reflector(const Reflector&);
     Reflector& operator=(const Reflector&);
+    ClientSlot* findClientSlot(uint32_t client_id)
+    {
+      uint32_t slot = client_id & CLIENT_SLOT_MASK;
+      if ((slot < m_client_slots.size()) &&
+          (m_client_slots[slot].client != 0) &&
+          (m_client_slots[slot].id == client_id))
+      {
+        return &m_client_slots[slot];
+      }
+      return 0;
+    }
+    ReflectorClient* findClient(uint32_t client_id)
+    {
+      ClientSlot *slot = findClientSlot(client_id);
+      return (slot != 0) ? slot->client : 0;
+    }
+    bool allocClientId(uint32_t& client_id);
+    void releaseClientId(uint32_t client_id);
+    void growClientSlots(size_t size);
     void clientConnected(Async::FramedTcpConnection *con);
     void clientDisconnected(Async::FramedTcpConnection *con,
                             Async::FramedTcpConnection::DisconnectReason reason);
+    void removeClient(ReflectorClient *client);
     void udpDatagramReceived(const Async::IpAddress& addr, uint16_t port,
                              void *buf, int count);
+    void udpBatchReceived(
+        const std::vector<Async::UdpSocket::RecvDatagram>& dgrams);
+    void processUdpCtrlQueue(Async::Timer *t=0);
+    ReflectorClient* udpAcceptDatagram(const Async::IpAddress& addr,
+        uint16_t port, const char *data, int count, ReflectorUdpMsg& header,
+        uint16_t& udp_rx_seq_diff);
+    void udpDispatchDatagram(ReflectorClient *client,
+                             const ReflectorUdpMsg& header,
+                             const char *data, int count,
+                             uint16_t udp_rx_seq_diff);
     void onTalkerUpdated(uint32_t tg, ReflectorClient* old_talker,
                          ReflectorClient *new_talker);
+    void tgClients(uint32_t tg, bool include_monitors,
+                   std::vector<ReflectorClient*>& clients);
+    void sendEvent(ReflectorClient *client, const MsgEventBatch::Event& event,
+                   Async::FramedTcpConnection::Frame*& frame);
+    void flushEventBatch(Async::Timer *t);
+    void loadState(void);
+    void onStateSaveTimer(Async::Timer *t);
     void httpRequestReceived(Async::HttpServerConnection *con,
                              Async::HttpServerConnection::Request& req);
     void httpClientConnected(Async::HttpServerConnection *con);
@@ -214,6 +570,53 @@ class Reflector : public sigc::trackable
         Async::HttpServerConnection::DisconnectReason reason);
     void onRequestAutoQsy(uint32_t from_tg);
     uint32_t nextRandomQsyTg(void);
+    void setSqlTimeout(const unsigned& sql_timeout);
+    void setSqlTimeoutBlocktime(const unsigned& blocktime);
+    void setTgForV1Clients(const uint32_t& tg);
+    void setRandomQsyRange(const std::string& range);
+    void sendUdpBatch(const ReflectorUdpMsg& msg,
+                      const Async::Msg *ext=0);
+    void sendUdpBatch(const char *packed, size_t len);
+    void sendUdpMuxDeliveries(const char *packed, size_t len);
+    void sendUdpBatchThreaded(const char *packed, size_t len);
+    UdpFanoutWorker* fanoutWorkerForClient(ReflectorClient *client);
+    void updateStatus(void);
+    std::string nodeStatus(ReflectorClient* client);
+    void statusQuery(Async::HttpServerConnection *con,
+                     Async::HttpServerConnection::Request& req,
+                     const std::string& query);
+    std::string qthStatus(ReflectorClient* client);
+    void writeMetrics(Async::MetricsWriter& writer);
+    std::string jsonToString(const Json::Value& value);
+    void pushStatusDelta(Async::Timer *t);
+    void collectUdpClientsForTG(uint32_t tg,
+                                const ReflectorClient::Filter& filter);
+    void collectUdpClients(const std::set<ReflectorClient*>& members,
+                           const ReflectorClient::Filter& filter);
+    bool initCodecs(Async::Config &cfg);
+    void transcodeAudio(ReflectorClient *talker, uint32_t tg,
+                        const MsgUdpAudioView& msg, bool frame_lost);
+    void onTranscodedAudio(Transcoder *transcoder, const std::string& codec,
+                           const void *buf, int size);
+    void deleteTranscoder(uint32_t tg);
+    bool initTrunks(Async::Config &cfg);
+    void trunkClientConnected(Async::FramedTcpConnection *con);
+    void trunkClientDisconnected(Async::FramedTcpConnection *con,
+                            Async::FramedTcpConnection::DisconnectReason reason);
+    void trunkFrameReceived(Async::FramedTcpConnection *con,
+                            std::vector<uint8_t>& data);
+    void onTrunkTalkerStarted(ReflectorTrunk *trunk, uint32_t tg,
+                              const std::string& callsign);
+    void onTrunkTalkerStopped(ReflectorTrunk *trunk, uint32_t tg,
+                              const std::string& callsign);
+    void onTrunkAudio(ReflectorTrunk *trunk, const MsgTrunkAudio& msg);
+    void addAudioListener(Async::HttpServerConnection *con,
+                          Async::HttpServerConnection::Request& req,
+                          uint32_t tg);
+    void removeAudioListener(Async::HttpServerConnection *con);
+    void streamAudio(uint32_t tg, const std::string& codec,
+                     const void *buf, int size);
+    void flushAudioStream(uint32_t tg);
 
 };  /* class Reflector */
 
@@ -45,8 +45,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncTimer.h>
-#include <AsyncAudioEncoder.h>
-#include <AsyncAudioDecoder.h>
 #include <common.h>
 
 
@@ -111,7 +109,14 @@ using namespace Async;
  *
  ****************************************************************************/
 
-uint32_t ReflectorClient::next_client_id = 0;
+ReflectorClient::HbSlot ReflectorClient::hb_wheel[HB_WHEEL_SLOTS];
+Async::Timer* ReflectorClient::hb_timer = 0;
+unsigned ReflectorClient::hb_pos = 0;
+unsigned ReflectorClient::hb_ticking_slot = ReflectorClient::HB_NO_SLOT;
+bool ReflectorClient::hb_dirty = false;
+size_t ReflectorClient::hb_clients = 0;
+std::vector<char> ReflectorClient::udp_tx_buf;
+unsigned long ReflectorClient::slow_disconnects = 0;
 
 
 /****************************************************************************
@@ -129,85 +134,211 @@ bool ReflectorClient::TgFilter::operator()(ReflectorClient* client) const
 
 
 ReflectorClient::ReflectorClient(Reflector *ref, Async::FramedTcpConnection *con,
-                                 Async::Config *cfg)
-  : m_con(con), m_con_state(STATE_EXPECT_PROTO_VER),
-    m_disc_timer(10000, Timer::TYPE_ONESHOT, false),
-    m_client_id(next_client_id++), m_remote_udp_port(0), m_cfg(cfg),
+                                 Async::Config *cfg, uint32_t client_id,
+                                 ReflectorClient *mux_parent,
+                                 uint16_t mux_channel)
+  : m_con(con), m_cfg(cfg), m_reflector(ref),
+    m_client_id(client_id), m_current_tg(0),
+    m_con_state(STATE_EXPECT_PROTO_VER), m_blocktime(0),
+    m_remaining_blocktime(0), m_tgh_slot(TGHandler::NO_SLOT), m_tgh_tg(0),
+    m_hb_slot(HB_NO_SLOT), m_hb_idx(0), m_remote_udp_port(0),
     m_next_udp_tx_seq(0), m_next_udp_rx_seq(0),
-    m_heartbeat_timer(1000, Timer::TYPE_PERIODIC),
     m_heartbeat_tx_cnt(HEARTBEAT_TX_CNT_RESET),
     m_heartbeat_rx_cnt(HEARTBEAT_RX_CNT_RESET),
     m_udp_heartbeat_tx_cnt(UDP_HEARTBEAT_TX_CNT_RESET),
     m_udp_heartbeat_rx_cnt(UDP_HEARTBEAT_RX_CNT_RESET),
-    m_reflector(ref), m_blocktime(0), m_remaining_blocktime(0),
-    m_current_tg(0)
+    m_udp_ping_cnt(UDP_PING_CNT_RESET), m_disc_cnt(0),
+    m_heartbeat_enabled(true), m_tx_queue_peak(0),
+    m_slow_timeout(DEFAULT_SLOW_CLIENT_TIMEOUT), m_slow_cnt(0),
+    m_coalesced_events(0), m_slow_disconnect(false),
+    m_mux_parent(mux_parent), m_mux_channel(mux_channel)
 {
-  m_con->setMaxFrameSize(ReflectorMsg::MAX_PREAUTH_FRAME_SIZE);
-  m_con->frameReceived.connect(
-      mem_fun(*this, &ReflectorClient::onFrameReceived));
-  m_disc_timer.expired.connect(
-      mem_fun(*this, &ReflectorClient::onDiscTimeout));
-  m_heartbeat_timer.expired.connect(
-      mem_fun(*this, &ReflectorClient::handleHeartbeat));
-
-  string codecs;
-  if (m_cfg->getValue("GLOBAL", "CODECS", codecs))
-  {
-    SvxLink::splitStr(m_supported_codecs, codecs, ",");
-  }
-  if (m_supported_codecs.size() > 1)
+    // Bound the memory that a client that does not read its connection can
+    // make us use
+  unsigned tx_queue_max = DEFAULT_TCP_TX_QUEUE_MAX;
+  m_cfg->getValue("GLOBAL", "TCP_TX_QUEUE_MAX", tx_queue_max);
+  m_tx_queue_max = 1024 * static_cast<size_t>(tx_queue_max);
+  m_cfg->getValue("GLOBAL", "TCP_SLOW_CLIENT_TIMEOUT", m_slow_timeout);
+
+    // A shared node get its frames from the parent client and the
+    // connection is set up by the parent
+  if (m_mux_parent == 0)
   {
-    m_supported_codecs.erase(m_supported_codecs.begin()+1,
-                             m_supported_codecs.end());
-    cout << "*** WARNING: The GLOBAL/CODECS configuration "
-            "variable can only take one codec at the moment. Using the first "
-            "one: \"" << m_supported_codecs.front() << "\"" << endl;
-  }
-  else if (m_supported_codecs.empty())
-  {
-    string codec = "GSM";
-    if (AudioDecoder::isAvailable("OPUS") &&
-        AudioEncoder::isAvailable("OPUS"))
-    {
-      codec = "OPUS";
-    }
-    else if (AudioDecoder::isAvailable("SPEEX") &&
-             AudioEncoder::isAvailable("SPEEX"))
-    {
-      codec = "SPEEX";
-    }
-    m_supported_codecs.push_back(codec);
+    m_con->setMaxFrameSize(ReflectorMsg::MAX_PREAUTH_FRAME_SIZE);
+    m_con->setMaxTxQueueSize(m_tx_queue_max);
+    m_con->frameReceived.connect(
+        mem_fun(*this, &ReflectorClient::onFrameReceived));
   }
+
+  m_codec = m_reflector->codecs().front();
+
+  hbWheelAdd();
 } /* ReflectorClient::ReflectorClient */
 
 
 ReflectorClient::~ReflectorClient(void)
 {
+  hbWheelRemove();
   TGHandler::instance()->removeClient(this);
 } /* ReflectorClient::~ReflectorClient */
 
 
 int ReflectorClient::sendMsg(const ReflectorMsg& msg)
 {
-  if (((m_con_state != STATE_CONNECTED) && (msg.type() >= 100)) ||
-      !m_con->isConnected())
+  FramedTcpConnection::Frame *frame = packMsg(msg);
+  if (frame == 0)
   {
-    errno = ENOTCONN;
+    errno = EBADMSG;
     return -1;
   }
+  int ret = sendFrame(frame, msg.type());
+  frame->unref();
+  return ret;
+} /* ReflectorClient::sendMsg */
 
-  m_heartbeat_tx_cnt = HEARTBEAT_TX_CNT_RESET;
 
+FramedTcpConnection::Frame *ReflectorClient::packMsg(const ReflectorMsg& msg)
+{
   ReflectorMsg header(msg.type());
   ostringstream ss;
   if (!header.pack(ss) || !msg.pack(ss))
   {
     cerr << "*** ERROR: Failed to pack TCP message\n";
-    errno = EBADMSG;
+    return 0;
+  }
+  return FramedTcpConnection::Frame::create(ss.str().data(), ss.str().size());
+} /* ReflectorClient::packMsg */
+
+
+int ReflectorClient::sendFrame(FramedTcpConnection::Frame *frame,
+                               unsigned msg_type)
+{
+  if (((m_con_state != STATE_CONNECTED) && (msg_type >= 100)) ||
+      (m_con_state == STATE_DISCONNECTED) || !m_con->isConnected())
+  {
+    errno = ENOTCONN;
     return -1;
   }
-  return m_con->write(ss.str().data(), ss.str().size());
-} /* ReflectorClient::sendMsg */
+  if (m_slow_disconnect)
+  {
+    errno = ENOBUFS;
+    return -1;
+  }
+
+  if (!m_pending_events.empty() && (msg_type != MsgEventBatch::TYPE))
+  {
+    flushEvents();
+  }
+
+  m_heartbeat_tx_cnt = HEARTBEAT_TX_CNT_RESET;
+
+    // Control messages are sent before queued node and talker status
+    // messages so that a slow client does not time out or get a QSY late
+  FramedTcpConnection::Priority prio = FramedTcpConnection::PRIO_HIGH;
+  switch (msg_type)
+  {
+    case MsgNodeJoined::TYPE:
+    case MsgNodeLeft::TYPE:
+    case MsgTalkerStart::TYPE:
+    case MsgTalkerStop::TYPE:
+    case MsgEventBatch::TYPE:
+      prio = FramedTcpConnection::PRIO_NORMAL;
+      break;
+    default:
+      break;
+  }
+
+  int ret = 0;
+  if (m_mux_parent != 0)
+  {
+      // Wrap the frame in a MsgMuxFrame without copying the payload
+    char prefix[MsgMuxFrame::PREFIX_SIZE];
+    MsgMuxFrame::packPrefix(prefix, m_mux_channel, frame->payloadSize());
+    struct iovec iov[2];
+    iov[0].iov_base = prefix;
+    iov[0].iov_len = sizeof(prefix);
+    iov[1].iov_base = const_cast<char*>(
+        frame->data() + frame->size() - frame->payloadSize());
+    iov[1].iov_len = frame->payloadSize();
+    FramedTcpConnection::Frame *mux_frame =
+      FramedTcpConnection::Frame::create(iov, 2);
+    ret = m_con->write(mux_frame, prio);
+    mux_frame->unref();
+  }
+  else
+  {
+    ret = m_con->write(frame, prio);
+  }
+  if ((ret < 0) && (errno == ENOBUFS))
+  {
+      // The transmit queue of a shared connection belong to the parent
+    ReflectorClient *owner = (m_mux_parent != 0) ? m_mux_parent : this;
+    owner->slowConsumer("TCP transmit queue full");
+    errno = ENOBUFS;
+  }
+  else if (m_con->txQueueSize() > m_tx_queue_peak)
+  {
+    m_tx_queue_peak = m_con->txQueueSize();
+  }
+  return ret;
+} /* ReflectorClient::sendFrame */
+
+
+void ReflectorClient::queueEvent(const MsgEventBatch::Event& event)
+{
+  if (coalesceEvent(event))
+  {
+    m_coalesced_events += 2;
+    return;
+  }
+  m_pending_events.push_back(event);
+  if (m_pending_events.size() >= MAX_BATCH_EVENTS)
+  {
+    flushEvents();
+  }
+  if (m_pending_events.size() > MAX_PENDING_EVENTS)
+  {
+    slowConsumer("Too many events held back");
+  }
+} /* ReflectorClient::queueEvent */
+
+
+void ReflectorClient::flushEvents(void)
+{
+  MsgEventBatch msg;
+  while (!m_pending_events.empty() && !isSlow())
+  {
+    if (m_pending_events.size() > MAX_BATCH_EVENTS)
+    {
+      MsgEventBatch::Events::iterator end =
+        m_pending_events.begin() + MAX_BATCH_EVENTS;
+      msg.events().assign(m_pending_events.begin(), end);
+      m_pending_events.erase(m_pending_events.begin(), end);
+    }
+    else
+    {
+      msg.events().swap(m_pending_events);
+    }
+    sendMsg(msg);
+    msg.events().clear();
+  }
+  if (m_pending_events.empty())
+  {
+      // Keep the allocated event buffer for the next batch
+    msg.events().swap(m_pending_events);
+  }
+} /* ReflectorClient::flushEvents */
+
+
+bool ReflectorClient::isSlow(void) const
+{
+  if ((m_mux_parent != 0) && m_mux_parent->isSlow())
+  {
+    return true;
+  }
+  return m_slow_disconnect ||
+         ((m_tx_queue_max > 0) && (m_con->txQueueSize() > m_tx_queue_max / 4));
+} /* ReflectorClient::isSlow */
 
 
 void ReflectorClient::udpMsgReceived(const ReflectorUdpMsg &header)
@@ -225,18 +356,59 @@ void ReflectorClient::udpMsgReceived(const ReflectorUdpMsg &header)
 
 void ReflectorClient::sendUdpMsg(const ReflectorUdpMsg &msg)
 {
-  if (remoteUdpPort() == 0)
+  uint16_t seq;
+  if (!prepareUdpTx(seq))
+  {
+    return;
+  }
+
+  ReflectorUdpMsg header(msg.type(), clientId(), seq);
+    // The buffer is shared by all clients since the datagram is copied or
+    // sent before sendUdpDatagram returns
+  udp_tx_buf.resize(header.packedSize() + msg.packedSize());
+  Async::MsgWriter w(&udp_tx_buf[0], udp_tx_buf.size());
+  if (!header.pack(w) || !msg.pack(w))
   {
+    cerr << "*** ERROR[" << callsign()
+         << "]: Failed to pack UDP message of type " << msg.type() << endl;
     return;
   }
+  (void)m_reflector->sendUdpDatagram(this, &udp_tx_buf[0], w.size());
+} /* ReflectorClient::sendUdpMsg */
+
+
+bool ReflectorClient::prepareUdpTx(uint16_t& seq)
+{
+  if (remoteUdpPort() == 0)
+  {
+    return false;
+  }
 
   m_udp_heartbeat_tx_cnt = UDP_HEARTBEAT_TX_CNT_RESET;
+  seq = nextUdpTxSeq();
+  return true;
+} /* ReflectorClient::prepareUdpTx */
 
-  ReflectorUdpMsg header(msg.type(), clientId(), nextUdpTxSeq());
-  ostringstream ss;
-  assert(header.pack(ss) && msg.pack(ss));
-  (void)m_reflector->sendUdpDatagram(this, ss.str().data(), ss.str().size());
-} /* ReflectorClient::sendUdpMsg */
+
+void ReflectorClient::setClientId(uint32_t client_id)
+{
+    // The heartbeat wheel slot depend on the client id
+  hbWheelRemove();
+  m_client_id = client_id;
+  hbWheelAdd();
+} /* ReflectorClient::setClientId */
+
+
+ReflectorClient::Session ReflectorClient::session(void) const
+{
+  Session session;
+  session.token = m_session_token;
+  session.client_id = m_client_id;
+  session.tg = m_current_tg;
+  session.monitored_tgs = m_monitored_tgs;
+  session.blocktime = isBlocked() ? m_remaining_blocktime : 0;
+  return session;
+} /* ReflectorClient::session */
 
 
 void ReflectorClient::setBlock(unsigned blocktime)
@@ -246,6 +418,44 @@ void ReflectorClient::setBlock(unsigned blocktime)
 } /* ReflectorClient::setBlock */
 
 
+size_t ReflectorClient::memoryUsage(void) const
+{
+    // Approximate size of a node in a red-black tree, excluding the value
+  static const size_t MAP_NODE_OVERHEAD = 4 * sizeof(void*);
+
+  size_t size = sizeof(*this);
+  size += m_monitored_tgs.capacity() * sizeof(TGList::value_type);
+  size += m_node_info_json.capacity();
+  size += m_node_qth_json.capacity();
+  size += m_pending_events.capacity() * sizeof(MsgEventBatch::Event);
+  size += m_rx_map.size() * (MAP_NODE_OVERHEAD + sizeof(RxMap::value_type));
+  for (RxMap::const_iterator it = m_rx_map.begin(); it != m_rx_map.end(); ++it)
+  {
+    size += it->second.name.capacity();
+  }
+  size += m_tx_map.size() * (MAP_NODE_OVERHEAD + sizeof(TxMap::value_type));
+  for (TxMap::const_iterator it = m_tx_map.begin(); it != m_tx_map.end(); ++it)
+  {
+    size += it->second.name.capacity();
+  }
+  size += m_shared_nodes.size() *
+          (MAP_NODE_OVERHEAD + sizeof(SharedNodeMap::value_type));
+  return size;
+} /* ReflectorClient::memoryUsage */
+
+
+void ReflectorClient::closeSharedNodes(void)
+{
+    // Disconnecting a node remove it from the map
+  SharedNodeMap nodes;
+  nodes.swap(m_shared_nodes);
+  for (SharedNodeMap::iterator it = nodes.begin(); it != nodes.end(); ++it)
+  {
+    it->second->disconnect();
+  }
+} /* ReflectorClient::closeSharedNodes */
+
+
 /****************************************************************************
  *
  * Protected member functions
@@ -306,6 +516,9 @@ void ReflectorClient::onFrameReceived(FramedTcpConnection *con,
     case MsgAuthResponse::TYPE:
       handleMsgAuthResponse(ss);
       break;
+    case MsgSessionResume::TYPE:
+      handleMsgSessionResume(ss);
+      break;
     case MsgSelectTG::TYPE:
       handleSelectTG(ss);
       break;
@@ -335,6 +548,12 @@ void ReflectorClient::onFrameReceived(FramedTcpConnection *con,
     case MsgError::TYPE:
       handleMsgError(ss);
       break;
+    case MsgSelectCodec::TYPE:
+      handleMsgSelectCodec(ss);
+      break;
+    case MsgMuxFrame::TYPE:
+      handleMsgMuxFrame(ss);
+      break;
     default:
       // Better just ignoring unknown protocol messages for making it easier to
       // add messages to the protocol and still be backwards compatible.
@@ -390,11 +609,7 @@ void ReflectorClient::handleMsgProtoVer(std::istream& is)
     return;
   }
 
-  MsgAuthChallenge challenge_msg;
-  memcpy(m_auth_challenge, challenge_msg.challenge(),
-         MsgAuthChallenge::CHALLENGE_LEN);
-  sendMsg(challenge_msg);
-  m_con_state = STATE_EXPECT_AUTH_RESPONSE;
+  sendAuthChallenge();
 } /* ReflectorClient::handleMsgProtoVer */
 
 
@@ -420,40 +635,7 @@ void ReflectorClient::handleMsgAuthResponse(std::istream& is)
   string auth_key = lookupUserKey(msg.callsign());
   if (msg.verify(auth_key, m_auth_challenge))
   {
-    vector<string> connected_nodes;
-    m_reflector->nodeList(connected_nodes);
-    if (find(connected_nodes.begin(), connected_nodes.end(),
-             msg.callsign()) == connected_nodes.end())
-    {
-      m_con->setMaxFrameSize(ReflectorMsg::MAX_POSTAUTH_FRAME_SIZE);
-      m_callsign = msg.callsign();
-      sendMsg(MsgAuthOk());
-      cout << m_callsign << ": Login OK from "
-           << m_con->remoteHost() << ":" << m_con->remotePort()
-           << " with protocol version " << m_client_proto_ver.majorVer()
-           << "." << m_client_proto_ver.minorVer()
-           << endl;
-      m_con_state = STATE_CONNECTED;
-      MsgServerInfo msg_srv_info(m_client_id, m_supported_codecs);
-      m_reflector->nodeList(msg_srv_info.nodes());
-      sendMsg(msg_srv_info);
-      if (m_client_proto_ver < ProtoVer(0, 7))
-      {
-        MsgNodeList msg_node_list(msg_srv_info.nodes());
-        sendMsg(msg_node_list);
-      }
-      if (m_client_proto_ver < ProtoVer(2, 0))
-      {
-        TGHandler::instance()->switchTo(this, m_reflector->tgForV1Clients());
-        m_current_tg = m_reflector->tgForV1Clients();
-      }
-      m_reflector->broadcastMsg(MsgNodeJoined(m_callsign), ExceptFilter(this));
-    }
-    else
-    {
-      cout << msg.callsign() << ": Already connected" << endl;
-      sendError("Access denied");
-    }
+    loginOk(msg.callsign(), 0);
   }
   else
   {
@@ -465,6 +647,183 @@ void ReflectorClient::handleMsgAuthResponse(std::istream& is)
 } /* ReflectorClient::handleMsgAuthResponse */
 
 
+void ReflectorClient::handleMsgSessionResume(std::istream& is)
+{
+  if (m_con_state != STATE_EXPECT_AUTH_RESPONSE)
+  {
+    cout << "Client " << m_con->remoteHost() << ":" << m_con->remotePort()
+         << " Session resume unexpected" << endl;
+    sendError("Session resume unexpected");
+    return;
+  }
+
+  MsgSessionResume msg;
+  if (!msg.unpack(is))
+  {
+    cout << "Client " << m_con->remoteHost() << ":" << m_con->remotePort()
+         << " ERROR: Could not unpack MsgSessionResume" << endl;
+    sendError("Illegal MsgSessionResume protocol message received");
+    return;
+  }
+
+  Session session;
+  if (m_reflector->takeSession(msg.callsign(), session) &&
+      msg.verify(session.token, m_auth_challenge))
+  {
+    loginOk(msg.callsign(), &session);
+    return;
+  }
+
+    // Let the client fall back to a normal authentication
+  cout << "Client " << m_con->remoteHost() << ":" << m_con->remotePort()
+       << " Could not resume session for user \"" << msg.callsign()
+       << "\"" << endl;
+  sendAuthChallenge();
+} /* ReflectorClient::handleMsgSessionResume */
+
+
+void ReflectorClient::loginOk(const std::string& callsign,
+                              const Session* session)
+{
+  vector<string> connected_nodes;
+  m_reflector->nodeList(connected_nodes);
+  if (find(connected_nodes.begin(), connected_nodes.end(),
+           callsign) != connected_nodes.end())
+  {
+    cout << callsign << ": Already connected" << endl;
+    sendError("Access denied");
+    return;
+  }
+
+  if (m_mux_parent == 0)
+  {
+    m_con->setMaxFrameSize(ReflectorMsg::MAX_POSTAUTH_FRAME_SIZE);
+  }
+  m_callsign = callsign;
+  sendMsg(MsgAuthOk());
+  cout << m_callsign << ": Login OK from "
+       << m_con->remoteHost() << ":" << m_con->remotePort()
+       << " with protocol version " << m_client_proto_ver.majorVer()
+       << "." << m_client_proto_ver.minorVer()
+       << (session != 0 ? " (session resumed)" : "");
+  if (m_mux_parent != 0)
+  {
+    cout << " (shared with " << m_mux_parent->callsign() << ")";
+  }
+  cout << endl;
+  m_con_state = STATE_CONNECTED;
+  if (m_mux_parent == 0)
+  {
+    m_reflector->loginHandshakeDone(m_con);
+  }
+  m_reflector->invalidateStatus();
+  if (session != 0)
+  {
+    m_reflector->changeClientId(this, session->client_id);
+  }
+  MsgServerInfo msg_srv_info(m_client_id, m_reflector->codecs());
+  m_reflector->nodeList(msg_srv_info.nodes());
+  sendMsg(msg_srv_info);
+  const vector<string>& codecs = m_reflector->codecs();
+  for (vector<string>::const_iterator it=codecs.begin();
+       it!=codecs.end(); ++it)
+  {
+    const MsgCodecOptions::Options& opts =
+      m_reflector->codecEncOptions(*it);
+    if (!opts.empty())
+    {
+      sendMsg(MsgCodecOptions(*it, opts));
+    }
+  }
+  if (m_client_proto_ver < ProtoVer(0, 7))
+  {
+    MsgNodeList msg_node_list(msg_srv_info.nodes());
+    sendMsg(msg_node_list);
+  }
+  if (m_client_proto_ver < ProtoVer(2, 0))
+  {
+    TGHandler::instance()->switchTo(this, m_reflector->tgForV1Clients());
+    m_current_tg = m_reflector->tgForV1Clients();
+  }
+  else if (session != 0)
+  {
+      // Restore the talk group state directly instead of waiting for the
+      // client to select its talk group again
+    if (session->tg != 0)
+    {
+      m_current_tg = session->tg;
+      TGHandler::instance()->switchTo(this, m_current_tg);
+    }
+    if (!session->monitored_tgs.empty())
+    {
+      std::set<uint32_t> tgs(session->monitored_tgs.begin(),
+                             session->monitored_tgs.end());
+      TGHandler::instance()->setMonitoredTGs(this, tgs);
+      m_monitored_tgs = session->monitored_tgs;
+    }
+    if (session->blocktime > 0)
+    {
+      setBlock(session->blocktime);
+    }
+  }
+  if (m_reflector->sessionResumeEnabled() &&
+      (m_client_proto_ver >= ProtoVer(2, 1)))
+  {
+    uint8_t nonce[MsgAuthChallenge::CHALLENGE_LEN];
+    gcry_create_nonce(nonce, sizeof(nonce));
+    std::ostringstream ss;
+    ss << std::hex << std::setfill('0');
+    for (size_t i=0; i<sizeof(nonce); ++i)
+    {
+      ss << std::setw(2) << static_cast<unsigned>(nonce[i]);
+    }
+    m_session_token = ss.str();
+    sendMsg(MsgSessionToken(m_session_token));
+  }
+  m_reflector->broadcastEvent(
+      MsgEventBatch::Event(MsgNodeJoined::TYPE, 0, m_callsign.str()),
+      ExceptFilter(this));
+} /* ReflectorClient::loginOk */
+
+
+void ReflectorClient::sendAuthChallenge(void)
+{
+  MsgAuthChallenge challenge_msg;
+  memcpy(m_auth_challenge, challenge_msg.challenge(),
+         MsgAuthChallenge::CHALLENGE_LEN);
+  sendMsg(challenge_msg);
+  m_con_state = STATE_EXPECT_AUTH_RESPONSE;
+} /* ReflectorClient::sendAuthChallenge */
+
+
+void ReflectorClient::handleMsgSelectCodec(std::istream& is)
+{
+  MsgSelectCodec msg;
+  if (!msg.unpack(is))
+  {
+    cout << "Client " << m_con->remoteHost() << ":" << m_con->remotePort()
+         << " ERROR: Could not unpack MsgSelectCodec" << endl;
+    sendError("Illegal MsgSelectCodec protocol message received");
+    return;
+  }
+  const vector<string>& codecs = m_reflector->codecs();
+  if (find(codecs.begin(), codecs.end(), msg.codec()) == codecs.end())
+  {
+    cout << m_callsign << ": ERROR: Selected codec \"" << msg.codec()
+         << "\" is not supported" << endl;
+    sendError("Unsupported codec selected");
+    return;
+  }
+  if (msg.codec() != m_codec.str())
+  {
+    cout << m_callsign << ": Using audio codec \"" << msg.codec() << "\""
+         << endl;
+    m_codec = msg.codec();
+    m_reflector->invalidateStatus();
+  }
+} /* ReflectorClient::handleMsgSelectCodec */
+
+
 void ReflectorClient::handleSelectTG(std::istream& is)
 {
   MsgSelectTG msg;
@@ -481,10 +840,8 @@ void ReflectorClient::handleSelectTG(std::istream& is)
     ReflectorClient *talker = TGHandler::instance()->talkerForTG(m_current_tg);
     if (talker == this)
     {
-      m_reflector->broadcastUdpMsg(MsgUdpFlushSamples(),
-          mkAndFilter(
-            TgFilter(m_current_tg),
-            ExceptFilter(this)));
+      m_reflector->broadcastUdpMsgToTG(MsgUdpFlushSamples(), m_current_tg,
+                                       ExceptFilter(this));
     }
     else if (talker != 0)
     {
@@ -492,6 +849,7 @@ void ReflectorClient::handleSelectTG(std::istream& is)
     }
     m_current_tg = msg.tg();
     TGHandler::instance()->switchTo(this, msg.tg());
+    m_reflector->invalidateStatus();
   }
 } /* ReflectorClient::handleSelectTG */
 
@@ -511,7 +869,9 @@ void ReflectorClient::handleTgMonitor(std::istream& is)
   std::copy(tgs.begin(), tgs.end(), std::ostream_iterator<uint32_t>(cout, " "));
   cout << "]" << endl;
 
-  m_monitored_tgs = tgs;
+  TGHandler::instance()->setMonitoredTGs(this, tgs);
+  m_monitored_tgs.assign(tgs.begin(), tgs.end());
+  m_reflector->invalidateStatus();
 } /* ReflectorClient::handleTgMonitor */
 
 
@@ -528,8 +888,38 @@ void ReflectorClient::handleNodeInfo(std::istream& is)
   //std::cout << "### handleNodeInfo: " << msg.json() << std::endl;
   try
   {
+      // Only keep the compact serialized form. The qth member is stored
+      // separately since it is the only part that needs to be parsed again
+      // when the status document is rebuilt.
     std::istringstream is(msg.json());
-    is >> m_node_info;
+    Json::Value node_info;
+    is >> node_info;
+    if (!node_info.isObject())
+    {
+      std::cerr << "*** WARNING[" << m_callsign
+                << "]: The MsgNodeInfo JSON data is not an object"
+                << std::endl;
+      return;
+    }
+    Json::StreamWriterBuilder builder;
+    builder["commentStyle"] = "None";
+    builder["indentation"] = "";
+    m_node_qth_json.clear();
+    Json::Value qth;
+    if (node_info.removeMember("qth", &qth))
+    {
+      m_node_qth_json = Json::writeString(builder, qth);
+    }
+      // These members are set by the reflector in the status document
+    static const char *live_members[] = {
+      "protoVer", "tg", "codec", "net", "monitoredTGs", "isTalker"
+    };
+    for (size_t i=0; i<sizeof(live_members)/sizeof(*live_members); ++i)
+    {
+      node_info.removeMember(live_members[i]);
+    }
+    m_node_info_json = Json::writeString(builder, node_info);
+    m_reflector->invalidateStatus();
   }
   catch (const Json::Exception& e)
   {
@@ -561,11 +951,10 @@ void ReflectorClient::handleMsgSignalStrengthValues(std::istream& is)
     //  << " sql_open=" << rx.sqlOpen()
     //  << " active=" << rx.active()
     //  << std::endl;
-    setRxSiglev(rx.id(), rx.siglev());
-    setRxEnabled(rx.id(), rx.enabled());
-    setRxSqlOpen(rx.id(), rx.sqlOpen());
-    setRxActive(rx.id(), rx.active());
+    setRxState(rx.id(), rx.siglev(), rx.enabled(), rx.sqlOpen(),
+               rx.active());
   }
+  m_reflector->invalidateStatus();
 } /* ReflectorClient::handleMsgSignalStrengthValues */
 
 
@@ -588,6 +977,7 @@ void ReflectorClient::handleMsgTxStatus(std::istream& is)
     //  << std::endl;
     setTxTransmit(tx.id(), tx.transmit());
   }
+  m_reflector->invalidateStatus();
 } /* ReflectorClient::handleMsgTxStatus */
 
 
@@ -726,35 +1116,150 @@ void ReflectorClient::handleMsgError(std::istream& is)
 } /* ReflectorClient::handleMsgError */
 
 
+void ReflectorClient::handleMsgMuxFrame(std::istream& is)
+{
+  MsgMuxFrame msg;
+  if (!msg.unpack(is) || (msg.channel() == 0))
+  {
+    cout << m_callsign << ": ERROR: Could not unpack MsgMuxFrame" << endl;
+    sendError("Illegal MsgMuxFrame protocol message received");
+    return;
+  }
+  if ((m_mux_parent != 0) || (m_con_state != STATE_CONNECTED) ||
+      (m_client_proto_ver < ProtoVer(2, 2)))
+  {
+    cout << m_callsign << ": ERROR: Unexpected MsgMuxFrame received" << endl;
+    sendError("Unexpected MsgMuxFrame protocol message received");
+    return;
+  }
+
+  SharedNodeMap::iterator it = m_shared_nodes.find(msg.channel());
+  if (msg.frame().empty())
+  {
+      // The client closed the channel so there is no need to confirm it
+    if (it != m_shared_nodes.end())
+    {
+      ReflectorClient *node = it->second;
+      m_shared_nodes.erase(it);
+      node->disconnect();
+    }
+    return;
+  }
+
+  ReflectorClient *node = 0;
+  if (it != m_shared_nodes.end())
+  {
+    node = it->second;
+  }
+  else
+  {
+    if (m_shared_nodes.size() >= MAX_SHARED_NODES)
+    {
+      cout << m_callsign << ": Refusing to open shared channel "
+           << msg.channel() << " since the maximum number of shared nodes, "
+           << MAX_SHARED_NODES << ", are connected" << endl;
+      sendMsg(MsgMuxFrame(msg.channel()));
+      return;
+    }
+    node = m_reflector->addSharedNode(this, m_con, msg.channel());
+    if (node == 0)
+    {
+      sendMsg(MsgMuxFrame(msg.channel()));
+      return;
+    }
+    m_shared_nodes[msg.channel()] = node;
+    m_con->setMaxFrameSize(MsgMuxFrame::MAX_FRAME_SIZE);
+  }
+
+    // The frame size limit before login is enforced by the connection for
+    // a client of its own
+  if ((node->m_con_state != STATE_CONNECTED) &&
+      (msg.frame().size() > ReflectorMsg::MAX_PREAUTH_FRAME_SIZE))
+  {
+    cout << m_callsign << ": Too large frame received on shared channel "
+         << msg.channel() << " before login" << endl;
+    node->disconnect();
+    return;
+  }
+
+  node->onFrameReceived(m_con, msg.frame());
+} /* ReflectorClient::handleMsgMuxFrame */
+
+
+void ReflectorClient::sharedNodeClosed(uint16_t channel)
+{
+  SharedNodeMap::iterator it = m_shared_nodes.find(channel);
+  if (it == m_shared_nodes.end())
+  {
+    return;
+  }
+  m_shared_nodes.erase(it);
+  sendMsg(MsgMuxFrame(channel));
+} /* ReflectorClient::sharedNodeClosed */
+
+
 void ReflectorClient::sendError(const std::string& msg)
 {
   sendMsg(MsgError(msg));
-  m_heartbeat_timer.setEnable(false);
+  if (m_mux_parent == 0)
+  {
+    m_reflector->loginHandshakeDone(m_con);
+  }
+  m_heartbeat_enabled = false;
   m_remote_udp_port = 0;
-  m_disc_timer.setEnable(true);
+  m_disc_cnt = DISC_CNT_RESET;
   m_con_state = STATE_EXPECT_DISCONNECT;
 } /* ReflectorClient::sendError */
 
 
-void ReflectorClient::onDiscTimeout(Timer *t)
-{
-  assert(m_con_state == STATE_EXPECT_DISCONNECT);
-  disconnect();
-} /* ReflectorClient::onDiscTimeout */
-
-
 void ReflectorClient::disconnect(void)
 {
-  m_heartbeat_timer.setEnable(false);
+  m_heartbeat_enabled = false;
+  m_disc_cnt = 0;
   m_remote_udp_port = 0;
+  if (m_mux_parent != 0)
+  {
+      // Only the channel is closed for a shared node
+    if (m_con_state == STATE_DISCONNECTED)
+    {
+      return;
+    }
+    m_con_state = STATE_DISCONNECTED;
+    m_mux_parent->sharedNodeClosed(m_mux_channel);
+    m_reflector->sharedNodeDisconnected(this);
+    return;
+  }
   m_con->disconnect();
   m_con_state = STATE_DISCONNECTED;
   m_con->disconnected(m_con, FramedTcpConnection::DR_ORDERED_DISCONNECT);
 } /* ReflectorClient::disconnect */
 
 
-void ReflectorClient::handleHeartbeat(Async::Timer *t)
+void ReflectorClient::handleHeartbeat(void)
 {
+  if (m_blocktime > 0)
+  {
+    if (m_remaining_blocktime == 0)
+    {
+      m_blocktime = 0;
+    }
+    else
+    {
+      m_remaining_blocktime -= 1;
+    }
+  }
+
+    // The heartbeats and the slow client detection of a shared node is
+    // handled by the client owning the connection
+  if (m_mux_parent != 0)
+  {
+    if (!isSlow())
+    {
+      flushEvents();
+    }
+    return;
+  }
+
   if (--m_heartbeat_tx_cnt == 0)
   {
     sendMsg(MsgHeartbeat());
@@ -765,6 +1270,12 @@ void ReflectorClient::handleHeartbeat(Async::Timer *t)
     sendUdpMsg(MsgUdpHeartbeat());
   }
 
+  if (--m_udp_ping_cnt == 0)
+  {
+    m_udp_ping_cnt = UDP_PING_CNT_RESET;
+    sendUdpMsg(MsgUdpPing(SvxLink::NetPathStats::timestampMs()));
+  }
+
   if (--m_heartbeat_rx_cnt == 0)
   {
     if (!callsign().empty())
@@ -795,18 +1306,126 @@ void ReflectorClient::handleHeartbeat(Async::Timer *t)
     sendError("UDP heartbeat timeout");
   }
 
-  if (m_blocktime > 0)
+  if (isSlow())
   {
-    if (m_remaining_blocktime == 0)
+    if ((m_slow_timeout > 0) && (++m_slow_cnt >= m_slow_timeout))
     {
-      m_blocktime = 0;
+      slowConsumer("TCP transmit queue not drained");
     }
-    else
+  }
+  else
+  {
+    m_slow_cnt = 0;
+    flushEvents();
+  }
+} /* ReflectorClient::handleHeartbeat */
+
+
+void ReflectorClient::heartbeatTick(void)
+{
+  if (m_slow_disconnect)
+  {
+    disconnect();
+    return;
+  }
+
+  if (m_disc_cnt > 0)
+  {
+    if (--m_disc_cnt == 0)
     {
-      m_remaining_blocktime -= 1;
+      assert(m_con_state == STATE_EXPECT_DISCONNECT);
+      disconnect();
     }
+    return;
   }
-} /* ReflectorClient::handleHeartbeat */
+
+  if (m_heartbeat_enabled)
+  {
+    handleHeartbeat();
+  }
+} /* ReflectorClient::heartbeatTick */
+
+
+void ReflectorClient::hbWheelAdd(void)
+{
+  if (hb_timer == 0)
+  {
+    hb_timer = new Timer(1000 / HB_WHEEL_SLOTS, Timer::TYPE_PERIODIC, false);
+    hb_timer->expired.connect(sigc::ptr_fun(&ReflectorClient::onHbWheelTick));
+  }
+  if (hb_clients++ == 0)
+  {
+    hb_timer->setEnable(true);
+  }
+
+  m_hb_slot = m_client_id % HB_WHEEL_SLOTS;
+  m_hb_idx = hb_wheel[m_hb_slot].size();
+  hb_wheel[m_hb_slot].push_back(this);
+} /* ReflectorClient::hbWheelAdd */
+
+
+void ReflectorClient::hbWheelRemove(void)
+{
+  if (m_hb_slot == HB_NO_SLOT)
+  {
+    return;
+  }
+
+  HbSlot& slot = hb_wheel[m_hb_slot];
+  assert(slot[m_hb_idx] == this);
+  if (m_hb_slot == hb_ticking_slot)
+  {
+      // The slot is being iterated so just leave a hole that is removed
+      // when the tick is done
+    slot[m_hb_idx] = 0;
+    hb_dirty = true;
+  }
+  else
+  {
+    slot[m_hb_idx] = slot.back();
+    slot[m_hb_idx]->m_hb_idx = m_hb_idx;
+    slot.pop_back();
+  }
+  m_hb_slot = HB_NO_SLOT;
+
+  if (--hb_clients == 0)
+  {
+    hb_timer->setEnable(false);
+  }
+} /* ReflectorClient::hbWheelRemove */
+
+
+void ReflectorClient::onHbWheelTick(Async::Timer *t)
+{
+  unsigned slot_idx = hb_pos;
+  hb_pos = (hb_pos + 1) % HB_WHEEL_SLOTS;
+
+    // A client may be deleted, e.g. on disconnect, while the slot is
+    // iterated so the size is checked in each turn
+  hb_ticking_slot = slot_idx;
+  for (size_t i = 0; i < hb_wheel[slot_idx].size(); ++i)
+  {
+    ReflectorClient *client = hb_wheel[slot_idx][i];
+    if (client != 0)
+    {
+      client->heartbeatTick();
+    }
+  }
+  hb_ticking_slot = HB_NO_SLOT;
+
+  if (hb_dirty)
+  {
+    HbSlot& slot = hb_wheel[slot_idx];
+    slot.erase(std::remove(slot.begin(), slot.end(),
+                           static_cast<ReflectorClient*>(0)),
+               slot.end());
+    for (size_t i = 0; i < slot.size(); ++i)
+    {
+      slot[i]->m_hb_idx = i;
+    }
+    hb_dirty = false;
+  }
+} /* ReflectorClient::onHbWheelTick */
 
 
 std::string ReflectorClient::lookupUserKey(const std::string& callsign)
@@ -830,6 +1449,78 @@ std::string ReflectorClient::lookupUserKey(const std::string& callsign)
 } /* ReflectorClient::lookupUserKey */
 
 
+bool ReflectorClient::coalesceEvent(const MsgEventBatch::Event& event)
+{
+  uint16_t inverse_type = 0;
+  switch (event.type())
+  {
+    case MsgNodeJoined::TYPE:
+      inverse_type = MsgNodeLeft::TYPE;
+      break;
+    case MsgNodeLeft::TYPE:
+      inverse_type = MsgNodeJoined::TYPE;
+      break;
+    case MsgTalkerStart::TYPE:
+      inverse_type = MsgTalkerStop::TYPE;
+      break;
+    case MsgTalkerStop::TYPE:
+      inverse_type = MsgTalkerStart::TYPE;
+      break;
+    default:
+      return false;
+  }
+  bool is_talker_event = (event.type() == MsgTalkerStart::TYPE) ||
+                         (event.type() == MsgTalkerStop::TYPE);
+
+    // Find the last queued event about the same node, or the same talker on
+    // the same talk group. If it is the inverse of the new event the client
+    // would end up in the same state anyway so both can be dropped.
+  for (MsgEventBatch::Events::iterator it = m_pending_events.end();
+       it != m_pending_events.begin(); )
+  {
+    --it;
+    bool it_is_talker_event = (it->type() == MsgTalkerStart::TYPE) ||
+                              (it->type() == MsgTalkerStop::TYPE);
+    if ((it_is_talker_event != is_talker_event) ||
+        (is_talker_event && (it->tg() != event.tg())) ||
+        (it->callsign() != event.callsign()))
+    {
+      continue;
+    }
+    if (it->type() == inverse_type)
+    {
+      m_pending_events.erase(it);
+      return true;
+    }
+    return false;
+  }
+  return false;
+} /* ReflectorClient::coalesceEvent */
+
+
+void ReflectorClient::slowConsumer(const std::string& reason)
+{
+  if (m_slow_disconnect)
+  {
+    return;
+  }
+  m_slow_disconnect = true;
+  ++slow_disconnects;
+  m_pending_events.clear();
+  if (!m_callsign.empty())
+  {
+    cout << m_callsign << ": ";
+  }
+  else
+  {
+    cout << "Client " << m_con->remoteHost() << ":"
+         << m_con->remotePort() << " ";
+  }
+  cout << "Slow client: " << reason << " ("
+       << m_con->txQueueSize() << " bytes queued). Disconnecting." << endl;
+} /* ReflectorClient::slowConsumer */
+
+
 /*
  * This file has not been truncated
  */
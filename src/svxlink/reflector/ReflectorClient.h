@@ -35,6 +35,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <ctime>
 #include <json/json.h>
 
 
@@ -47,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncFramedTcpConnection.h>
 #include <AsyncTimer.h>
 #include <AsyncConfig.h>
+#include <NetPathStats.h>
 
 
 /****************************************************************************
@@ -57,6 +62,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "ReflectorMsg.h"
 #include "ProtoVer.h"
+#include "InternedString.h"
 
 
 /****************************************************************************
@@ -74,6 +80,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 class Reflector;
+class TGHandler;
 
 
 /****************************************************************************
@@ -134,6 +141,24 @@ class ReflectorClient
     };
     typedef std::map<char, Tx> TxMap;
 
+      // A sorted list of talk groups. Much smaller than a std::set for the
+      // few talk groups that a client usually monitor.
+    typedef std::vector<uint32_t> TGList;
+
+      // The client state that is kept in the reflector state snapshot so
+      // that it can be restored when the client resume its session
+    struct Session
+    {
+      std::string token;
+      uint32_t    client_id;
+      uint32_t    tg;
+      TGList      monitored_tgs;
+      unsigned    blocktime;
+      time_t      expires;
+
+      Session(void) : client_id(0), tg(0), blocktime(0), expires(0) {}
+    };
+
     class Filter
     {
       public:
@@ -189,12 +214,25 @@ class ReflectorClient
         TgMonitorFilter(uint32_t tg) : m_tg(tg) {}
         virtual bool operator ()(ReflectorClient *client) const
         {
-          return client->m_monitored_tgs.count(m_tg) > 0;
+          return std::binary_search(client->m_monitored_tgs.begin(),
+                                    client->m_monitored_tgs.end(), m_tg);
         }
       private:
         uint32_t m_tg;
     };
 
+    class CodecFilter : public Filter
+    {
+      public:
+        CodecFilter(const std::string& codec) : m_codec(codec) {}
+        virtual bool operator ()(ReflectorClient *client) const
+        {
+          return client->m_codec == m_codec;
+        }
+      private:
+        InternedString m_codec;
+    };
+
     template <class F1, class F2>
     class AndFilter : public Filter
     {
@@ -240,9 +278,17 @@ class ReflectorClient
      * @param   ref The associated Reflector object
      * @param   con The associated FramedTcpConnection object
      * @param   cfg The associated configuration file object
+     * @param   client_id The client id allocated by the Reflector
+     * @param   mux_parent The client owning the connection for a shared node
+     * @param   mux_channel The channel used by a shared node
+     *
+     * A shared node is a node that log in through a channel on the
+     * connection of another client, see MsgMuxFrame. For a shared node the
+     * con argument is the connection of the parent client.
      */
     ReflectorClient(Reflector *ref, Async::FramedTcpConnection *con,
-                    Async::Config* cfg);
+                    Async::Config* cfg, uint32_t client_id,
+                    ReflectorClient *mux_parent=0, uint16_t mux_channel=0);
 
     /**
      * @brief 	Destructor
@@ -288,7 +334,13 @@ class ReflectorClient
      * @brief   Get the callsign for this connection
      * @return  Returns the callsign associated with this coinnection
      */
-    const std::string& callsign(void) const { return m_callsign; }
+    const std::string& callsign(void) const { return m_callsign.str(); }
+
+    /**
+     * @brief   Get the audio codec used by the client
+     * @return  Returns the name of the codec that the client use
+     */
+    const std::string& codec(void) const { return m_codec.str(); }
 
     /**
      * @brief   Return the next UDP packet transmit sequence number
@@ -318,6 +370,87 @@ class ReflectorClient
      */
     int sendMsg(const ReflectorMsg& msg);
 
+    /**
+     * @brief   Pack a TCP message into a frame that can be sent to clients
+     * @param   msg The message to pack
+     * @return  Returns a new frame or 0 if the message could not be packed
+     *
+     * This function is used by the Reflector when broadcasting a message so
+     * that the message only have to be packed once. The caller must release
+     * the returned frame when it has been sent to all clients.
+     */
+    static Async::FramedTcpConnection::Frame *packMsg(const ReflectorMsg& msg);
+
+    /**
+     * @brief   Send a packed TCP message to the remote end
+     * @param   frame     The packed message, as returned by packMsg
+     * @param   msg_type  The type of the packed message
+     * @return  On success 0 is returned or else -1
+     */
+    int sendFrame(Async::FramedTcpConnection::Frame *frame, unsigned msg_type);
+
+    /**
+     * @brief   Queue an event to be sent in the next MsgEventBatch
+     * @param   event The event to queue
+     *
+     * The Reflector use this function for clients that support event
+     * batching. The queued events are sent by flushEvents. They are also
+     * flushed before any other TCP message is sent to the client so that the
+     * order of the messages is kept. A batch is sent directly if it grows
+     * too large. An event that cancel out the last queued event for the same
+     * node or talker, like a talker stop directly following the talker start,
+     * remove that event instead of being queued.
+     */
+    void queueEvent(const MsgEventBatch::Event& event);
+
+    /**
+     * @brief   Send all queued events in MsgEventBatch messages
+     *
+     * The events are held back while the client is slow, that is while its
+     * TCP transmit queue is filled above a quarter of the maximum size. They
+     * are then sent on a later heartbeat tick when the queue has drained.
+     */
+    void flushEvents(void);
+
+    /**
+     * @brief   Check if the client does not read its TCP connection fast enough
+     * @return  Returns \em true if the TCP transmit queue is filling up
+     */
+    bool isSlow(void) const;
+
+    /**
+     * @brief   Get the largest seen size of the TCP transmit queue
+     * @return  Returns the peak number of queued bytes
+     */
+    size_t txQueuePeak(void) const { return m_tx_queue_peak; }
+
+    /**
+     * @brief   Get the number of events that has been coalesced
+     * @return  Returns the number of events that never had to be sent
+     */
+    unsigned long coalescedEvents(void) const { return m_coalesced_events; }
+
+    /**
+     * @brief   Get the number of events being held back
+     * @return  Returns the number of queued events not yet sent
+     */
+    size_t pendingEvents(void) const { return m_pending_events.size(); }
+
+    /**
+     * @brief   Get the size of the TCP transmit queue
+     * @return  Returns the number of bytes waiting to be sent to the client
+     */
+    size_t txQueueSize(void) const { return m_con->txQueueSize(); }
+
+    /**
+     * @brief   Get the number of clients disconnected for being too slow
+     * @return  Returns the total number of slow consumer disconnects
+     */
+    static unsigned long slowClientDisconnects(void)
+    {
+      return slow_disconnects;
+    }
+
     /**
      * @brief   Handle a received UDP message
      * @param   The received UDP message
@@ -333,6 +466,17 @@ class ReflectorClient
      */
     void sendUdpMsg(const ReflectorUdpMsg &msg);
 
+    /**
+     * @brief   Prepare for sending a UDP message to the client
+     * @param   seq Return the sequence number to use for the message
+     * @return  Returns \em false if the UDP port of the client is not known
+     *
+     * This function is used by the Reflector when it send the same UDP
+     * message to many clients without calling sendUdpMsg.  It takes care of
+     * the same bookkeeping that the sendUdpMsg function does.
+     */
+    bool prepareUdpTx(uint16_t& seq);
+
     /**
      * @brief   Block client audio for the specified time
      * @param   The number of seconds to block
@@ -349,6 +493,28 @@ class ReflectorClient
      */
     bool isBlocked(void) const { return (m_remaining_blocktime > 0); }
 
+    /**
+     * @brief   Change the client id
+     * @param   client_id The new client id
+     *
+     * This function is used by the Reflector to give a resuming client its
+     * old id back. It must only be called during the login, before the
+     * MsgServerInfo message has been sent.
+     */
+    void setClientId(uint32_t client_id);
+
+    /**
+     * @brief   Get the session token
+     * @return  Returns the token or an empty string if there is no session
+     */
+    const std::string& sessionToken(void) const { return m_session_token; }
+
+    /**
+     * @brief   Get the state of the session
+     * @return  Returns the resumable state of this client
+     */
+    Session session(void) const;
+
     /**
      * @brief   Get the state of the connection
      * @return  Returns the state of the connection
@@ -371,7 +537,7 @@ class ReflectorClient
      * @brief   Get the monitored talk groups
      * @return  Returns the monitored talk groups
      */
-    const std::set<uint32_t>& monitoredTGs(void) const
+    const TGList& monitoredTGs(void) const
     {
       return m_monitored_tgs;
     }
@@ -399,6 +565,14 @@ class ReflectorClient
     bool rxSqlOpen(char id) { return m_rx_map[id].sql_open; }
     void setRxActive(char id, bool active) { m_rx_map[id].active = active; }
     bool rxActive(char id) { return m_rx_map[id].active; }
+    void setRxState(char id, uint8_t siglev, bool enab, bool open, bool active)
+    {
+      Rx& rx = m_rx_map[id];
+      rx.siglev = siglev;
+      rx.enabled = enab;
+      rx.sql_open = open;
+      rx.active = active;
+    }
     //RxMap& rxMap(void) { return m_rx_map; }
     //const RxMap& rxMap(void) const { return m_rx_map; }
 
@@ -409,43 +583,160 @@ class ReflectorClient
     void setTxTransmit(char id, bool transmit) { m_tx_map[id].transmit = transmit; }
     bool txTransmit(char id) { return m_tx_map[id].transmit; }
 
-    const Json::Value& nodeInfo(void) const { return m_node_info; }
+    /**
+     * @brief   Get the node information sent by the client
+     * @return  Returns the node information as serialized JSON text
+     *
+     * The node information is validated and stored as a compact JSON object
+     * so that it can be spliced into the status document without parsing.
+     * The "qth" member and the members that the reflector sets itself in the
+     * status document are not included. An empty string is returned if the
+     * client has not sent any node information.
+     */
+    const std::string& nodeInfoJson(void) const { return m_node_info_json; }
+
+    /**
+     * @brief   Get the qth member of the node information
+     * @return  Returns the qth member as serialized JSON text
+     *
+     * The qth member is kept separately since it is the only part of the
+     * node information that has to be parsed when the status document is
+     * rebuilt, to merge the live receiver and transmitter state into it.
+     * An empty string is returned if there is no qth member.
+     */
+    const std::string& nodeQthJson(void) const { return m_node_qth_json; }
+
+    /**
+     * @brief   Estimate the memory used by this client
+     * @return  Returns the approximate number of bytes used
+     *
+     * The estimate include the object itself and the heap memory that it
+     * own. Interned strings are shared between clients and are not counted.
+     * Neither is memory held by the TCP connection.
+     */
+    size_t memoryUsage(void) const;
+
+    /**
+     * @brief   Get the statistics for the network path from the client
+     * @return  Returns the network path statistics
+     */
+    SvxLink::NetPathStats& netStats(void) { return m_net_stats; }
+
+    /**
+     * @brief   Find out if this client is a shared node
+     * @return  Returns \em true if the client use a channel on another
+     *          client's connection
+     */
+    bool isSharedNode(void) const { return m_mux_parent != 0; }
+
+    /**
+     * @brief   Get the client that own a shared connection
+     * @return  Returns the owner of the connection or 0 if not shared
+     *
+     * For a shared node the parent client is returned. For a client that
+     * carry shared nodes the client itself is returned.
+     */
+    ReflectorClient* sharedSessionOwner(void)
+    {
+      if (m_mux_parent != 0)
+      {
+        return m_mux_parent;
+      }
+      return m_shared_nodes.empty() ? 0 : this;
+    }
+
+    /**
+     * @brief   Get the number of shared nodes using this client's connection
+     * @return  Returns the number of open channels
+     */
+    size_t sharedNodeCount(void) const { return m_shared_nodes.size(); }
+
+    /**
+     * @brief   Disconnect all shared nodes using this client's connection
+     *
+     * This function is called by the Reflector when the connection is about
+     * to be closed.
+     */
+    void closeSharedNodes(void);
 
   private:
     static const uint16_t MIN_MAJOR_VER = 0;
     static const uint16_t MIN_MINOR_VER = 6;
-    static uint32_t next_client_id;
 
-    static const unsigned HEARTBEAT_TX_CNT_RESET      = 10;
-    static const unsigned HEARTBEAT_RX_CNT_RESET      = 15;
-    static const unsigned UDP_HEARTBEAT_TX_CNT_RESET  = 15;
-    static const unsigned UDP_HEARTBEAT_RX_CNT_RESET  = 120;
+    static const uint8_t HEARTBEAT_TX_CNT_RESET       = 10;
+    static const uint8_t HEARTBEAT_RX_CNT_RESET       = 15;
+    static const uint8_t UDP_HEARTBEAT_TX_CNT_RESET   = 15;
+    static const uint8_t UDP_HEARTBEAT_RX_CNT_RESET   = 120;
+    static const uint8_t UDP_PING_CNT_RESET           = 10;
+    static const uint8_t DISC_CNT_RESET               = 10;
+    static const size_t MAX_BATCH_EVENTS              = 1024;
+    static const size_t MAX_PENDING_EVENTS            = 4 * MAX_BATCH_EVENTS;
+    static const size_t MAX_SHARED_NODES              = 32;
+    static const unsigned DEFAULT_TCP_TX_QUEUE_MAX    = 256;  // kB
+    static const unsigned DEFAULT_SLOW_CLIENT_TIMEOUT = 30;   // Seconds
+
+      // The heartbeat of all clients is driven by a single timer. The
+      // clients are spread out over the slots of a wheel and one slot is
+      // handled on each tick so that each client is visited once a second.
+    static const unsigned HB_WHEEL_SLOTS              = 10;
+    static const unsigned HB_NO_SLOT                  = ~0U;
+    typedef std::vector<ReflectorClient*> HbSlot;
+    static HbSlot         hb_wheel[HB_WHEEL_SLOTS];
+    static Async::Timer*  hb_timer;
+    static unsigned       hb_pos;
+    static unsigned       hb_ticking_slot;
+    static bool           hb_dirty;
+    static size_t         hb_clients;
+    static std::vector<char> udp_tx_buf;
+    static unsigned long  slow_disconnects;
+
+    typedef std::map<uint16_t, ReflectorClient*> SharedNodeMap;
 
     Async::FramedTcpConnection* m_con;
-    unsigned char               m_auth_challenge[MsgAuthChallenge::CHALLENGE_LEN];
-    ConState                    m_con_state;
-    Async::Timer                m_disc_timer;
-    std::string                 m_callsign;
-    uint32_t                    m_client_id;
-    uint16_t                    m_remote_udp_port;
     Async::Config*              m_cfg;
-    uint16_t                    m_next_udp_tx_seq;
-    uint16_t                    m_next_udp_rx_seq;
-    Async::Timer                m_heartbeat_timer;
-    unsigned                    m_heartbeat_tx_cnt;
-    unsigned                    m_heartbeat_rx_cnt;
-    unsigned                    m_udp_heartbeat_tx_cnt;
-    unsigned                    m_udp_heartbeat_rx_cnt;
     Reflector*                  m_reflector;
+    InternedString              m_callsign;
+    InternedString              m_codec;
+    uint32_t                    m_client_id;
+    uint32_t                    m_current_tg;
+    ConState                    m_con_state;
     unsigned                    m_blocktime;
     unsigned                    m_remaining_blocktime;
+    unsigned                    m_tgh_slot;
+    uint32_t                    m_tgh_tg;
+    unsigned                    m_hb_slot;
+    unsigned                    m_hb_idx;
+    uint16_t                    m_remote_udp_port;
+    uint16_t                    m_next_udp_tx_seq;
+    uint16_t                    m_next_udp_rx_seq;
+    uint8_t                     m_heartbeat_tx_cnt;
+    uint8_t                     m_heartbeat_rx_cnt;
+    uint8_t                     m_udp_heartbeat_tx_cnt;
+    uint8_t                     m_udp_heartbeat_rx_cnt;
+    uint8_t                     m_udp_ping_cnt;
+    uint8_t                     m_disc_cnt;
+    bool                        m_heartbeat_enabled;
+    unsigned char               m_auth_challenge[MsgAuthChallenge::CHALLENGE_LEN];
     ProtoVer                    m_client_proto_ver;
-    std::vector<std::string>    m_supported_codecs;
-    uint32_t                    m_current_tg;
-    std::set<uint32_t>          m_monitored_tgs;
+    TGList                      m_monitored_tgs;
     RxMap                       m_rx_map;
     TxMap                       m_tx_map;
-    Json::Value                 m_node_info;
+    std::string                 m_node_info_json;
+    std::string                 m_node_qth_json;
+    MsgEventBatch::Events       m_pending_events;
+    std::string                 m_session_token;
+    SvxLink::NetPathStats       m_net_stats;
+    size_t                      m_tx_queue_max;
+    size_t                      m_tx_queue_peak;
+    unsigned                    m_slow_timeout;
+    unsigned                    m_slow_cnt;
+    unsigned long               m_coalesced_events;
+    bool                        m_slow_disconnect;
+    ReflectorClient*            m_mux_parent;
+    uint16_t                    m_mux_channel;
+    SharedNodeMap               m_shared_nodes;
+
+    friend class TGHandler;
 
     ReflectorClient(const ReflectorClient&);
     ReflectorClient& operator=(const ReflectorClient&);
@@ -453,6 +744,7 @@ class ReflectorClient
                          std::vector<uint8_t>& data);
     void handleMsgProtoVer(std::istream& is);
     void handleMsgAuthResponse(std::istream& is);
+    void handleMsgSelectCodec(std::istream& is);
     void handleSelectTG(std::istream& is);
     void handleTgMonitor(std::istream& is);
     void handleNodeInfo(std::istream& is);
@@ -461,11 +753,21 @@ class ReflectorClient
     void handleRequestQsy(std::istream& is);
     void handleStateEvent(std::istream& is);
     void handleMsgError(std::istream& is);
+    void handleMsgMuxFrame(std::istream& is);
+    void sharedNodeClosed(uint16_t channel);
     void sendError(const std::string& msg);
-    void onDiscTimeout(Async::Timer *t);
     void disconnect(void);
-    void handleHeartbeat(Async::Timer *t);
+    void handleHeartbeat(void);
+    void heartbeatTick(void);
+    void hbWheelAdd(void);
+    void hbWheelRemove(void);
+    static void onHbWheelTick(Async::Timer *t);
     std::string lookupUserKey(const std::string& callsign);
+    void handleMsgSessionResume(std::istream& is);
+    void loginOk(const std::string& callsign, const Session* session);
+    void sendAuthChallenge(void);
+    bool coalesceEvent(const MsgEventBatch::Event& event);
+    void slowConsumer(const std::string& reason);
 
 };  /* class ReflectorClient */
 
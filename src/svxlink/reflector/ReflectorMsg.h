@@ -36,6 +36,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncMsg.h>
 #include <gcrypt.h>
+#include <map>
+#include <string>
 
 
 /****************************************************************************
@@ -170,6 +172,47 @@ class ReflectorUdpMsg : public Async::Msg
     ReflectorUdpMsg(uint16_t type=0, uint16_t client_id=0, uint16_t seq=0)
       : m_type(type), m_client_id(client_id), m_seq(seq) {}
 
+    /**
+     * @brief   The size of a packed UDP message header
+     */
+    static const size_t HEADER_SIZE = 6;
+
+    /**
+     * @brief   Set client ID and sequence number in a packed header
+     * @param   buf       Pointer to a packed header, HEADER_SIZE bytes long
+     * @param   client_id The client ID to set
+     * @param   seq       The sequence number to set
+     *
+     * This function can be used to patch an already packed header so that
+     * the same packed message can be sent to multiple clients without
+     * packing it again for each one of them.
+     */
+    static void setPackedHeader(char *buf, uint16_t client_id, uint16_t seq)
+    {
+      buf[2] = static_cast<char>(client_id >> 8);
+      buf[3] = static_cast<char>(client_id & 0xff);
+      buf[4] = static_cast<char>(seq >> 8);
+      buf[5] = static_cast<char>(seq & 0xff);
+    }
+
+    /**
+     * @brief   Write a complete packed header
+     * @param   buf       Pointer to a buffer, HEADER_SIZE bytes long
+     * @param   type      The message type
+     * @param   client_id The client ID
+     * @param   seq       The sequence number
+     *
+     * This function can be used to write the header directly in front of an
+     * already packed message body.
+     */
+    static void packHeader(char *buf, uint16_t type, uint16_t client_id,
+                           uint16_t seq)
+    {
+      buf[0] = static_cast<char>(type >> 8);
+      buf[1] = static_cast<char>(type & 0xff);
+      setPackedHeader(buf, client_id, seq);
+    }
+
     /**
      * @brief 	Destructor
      */
@@ -193,6 +236,28 @@ class ReflectorUdpMsg : public Async::Msg
      */
     uint16_t sequenceNum(void) const { return m_seq; }
 
+    /**
+     * @brief   Unpack the header directly from a buffer
+     * @param   buf A buffer holding a packed message
+     * @param   len The number of bytes in the buffer
+     * @return  Returns \em true on success or \em false if too short
+     *
+     * This is an alternative to the stream based unpack function that is
+     * used in the receive path to avoid copying the datagram.
+     */
+    bool unpackHeader(const char *buf, size_t len)
+    {
+      if (len < HEADER_SIZE)
+      {
+        return false;
+      }
+      const uint8_t *ubuf = reinterpret_cast<const uint8_t*>(buf);
+      m_type = (static_cast<uint16_t>(ubuf[0]) << 8) | ubuf[1];
+      m_client_id = (static_cast<uint16_t>(ubuf[2]) << 8) | ubuf[3];
+      m_seq = (static_cast<uint16_t>(ubuf[4]) << 8) | ubuf[5];
+      return true;
+    }
+
     ASYNC_MSG_MEMBERS(m_type, m_client_id, m_seq)
 
   private:
@@ -256,7 +321,7 @@ class MsgProtoVer : public ReflectorMsgBase<5>
 {
   public:
     static const uint16_t MAJOR = 2;
-    static const uint16_t MINOR = 0;
+    static const uint16_t MINOR = 2;
     MsgProtoVer(void) : m_major(MAJOR), m_minor(MINOR) {}
     MsgProtoVer(uint16_t major, uint16_t minor)
       : m_major(major), m_minor(minor) {}
@@ -427,6 +492,56 @@ class MsgAuthResponse : public ReflectorMsgBase<11>
 }; /* MsgAuthResponse */
 
 
+/**
+@brief	 Session resume TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2026-10-14
+
+This message may be sent by a client, instead of a MsgAuthResponse, as an
+answer to the MsgAuthChallenge message. It is used to resume a previous
+session, e.g. after a restart of the reflector server. The digest is
+calculated in the same way as for the MsgAuthResponse message but the session
+token, received in a MsgSessionToken message, is used as the key. If the
+session cannot be resumed, the server sends a new MsgAuthChallenge and the
+client should do a normal authentication.
+*/
+class MsgSessionResume : public ReflectorMsgBase<14>
+{
+  public:
+    MsgSessionResume(void) {}
+
+    /**
+     * @brief   Constructor
+     * @param   callsign The callsign (username) of the client
+     * @param   token The session token received from the server
+     * @param   challenge The authentication challenge received from the server
+     */
+    MsgSessionResume(const std::string& callsign, const std::string &token,
+                     const unsigned char *challenge)
+      : m_auth(callsign, token, challenge) {}
+
+    /**
+     * @brief   Get the callsign
+     */
+    const std::string& callsign(void) const { return m_auth.callsign(); }
+
+    /**
+     * @brief   Verify that the given token and challenge match the digest
+     * @param   token The session token
+     * @param   challenge The previously transmitted authentication challenge
+     */
+    bool verify(const std::string &token, const unsigned char *challenge) const
+    {
+      return m_auth.verify(token, challenge);
+    }
+
+    ASYNC_MSG_MEMBERS(m_auth);
+
+  private:
+    MsgAuthResponse m_auth;
+}; /* MsgSessionResume */
+
+
 /**
 @brief	 Authentication success TCP network message
 @author  Tobias Blomberg / SM0SVX
@@ -1106,6 +1221,315 @@ class MsgTxStatus : public ReflectorMsgBase<113>
 }; /* class MsgTxStatus */
 
 
+/**
+@brief	 Codec options TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This message is sent by the server to the client directly after the
+MsgServerInfo message, once for each offered codec that have options set. It
+contains encoder options that the client should use if it select that codec,
+like enabling DTX and inband FEC for the Opus codec. Clients that do not know
+about this message will just ignore it.
+*/
+class MsgCodecOptions : public ReflectorMsgBase<114>
+{
+  public:
+    typedef std::map<std::string, std::string> Options;
+
+    MsgCodecOptions(const std::string& codec="",
+                    const Options& options=Options())
+      : m_codec(codec), m_options(options) {}
+    const std::string& codec(void) const { return m_codec; }
+    Options& options(void) { return m_options; }
+
+    ASYNC_MSG_MEMBERS(m_codec, m_options)
+
+  private:
+    std::string m_codec;
+    Options     m_options;
+}; /* class MsgCodecOptions */
+
+
+/**
+@brief	 Select codec TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This message is sent by the client to the server to tell which of the codecs
+in the MsgServerInfo message that it will use. It is only sent if the server
+offered more than one codec. Clients that do not send this message are
+assumed to use the first codec in the list.
+*/
+class MsgSelectCodec : public ReflectorMsgBase<115>
+{
+  public:
+    MsgSelectCodec(const std::string& codec="") : m_codec(codec) {}
+    const std::string& codec(void) const { return m_codec; }
+
+    ASYNC_MSG_MEMBERS(m_codec)
+
+  private:
+    std::string m_codec;
+}; /* class MsgSelectCodec */
+
+
+/**
+@brief	 Event batch TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2026-10-14
+
+This message is sent by the server to clients using protocol version 2.1 or
+later. It carries a number of node joined, node left, talker start and talker
+stop events that have been collected during a short batching window. Each
+event should be handled exactly as if the corresponding MsgNodeJoined,
+MsgNodeLeft, MsgTalkerStart or MsgTalkerStop message had been received, in
+the order they appear in the batch. The talk group is zero for the node
+events.
+*/
+class MsgEventBatch : public ReflectorMsgBase<116>
+{
+  public:
+    class Event : public Async::Msg
+    {
+      public:
+        Event(uint16_t type=0, uint32_t tg=0, const std::string& callsign="")
+          : m_type(type), m_tg(tg), m_callsign(callsign) {}
+        uint16_t type(void) const { return m_type; }
+        uint32_t tg(void) const { return m_tg; }
+        const std::string& callsign(void) const { return m_callsign; }
+
+        ASYNC_MSG_MEMBERS(m_type, m_tg, m_callsign)
+
+      private:
+        uint16_t    m_type;
+        uint32_t    m_tg;
+        std::string m_callsign;
+    };
+    typedef std::vector<Event> Events;
+
+    MsgEventBatch(void) {}
+    MsgEventBatch(const Events& events) : m_events(events) {}
+    Events& events(void) { return m_events; }
+
+    ASYNC_MSG_MEMBERS(m_events)
+
+  private:
+    Events m_events;
+}; /* class MsgEventBatch */
+
+
+/**
+@brief	 Session token TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2026-10-14
+
+This message is sent by the server to clients using protocol version 2.1 or
+later, directly after a successful login, if the server support session
+resumption. The token can be used in a MsgSessionResume message on the next
+login to get the talk group state back without doing a normal authentication.
+A new token is sent on each login so only the last received one is valid.
+*/
+class MsgSessionToken : public ReflectorMsgBase<117>
+{
+  public:
+    MsgSessionToken(const std::string& token="") : m_token(token) {}
+    const std::string& token(void) const { return m_token; }
+
+    ASYNC_MSG_MEMBERS(m_token)
+
+  private:
+    std::string m_token;
+}; /* class MsgSessionToken */
+
+
+/**
+@brief	 Multiplexed frame TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2026-10-14
+
+This message is used by clients using protocol version 2.2 or later to carry
+more than one node on one connection. The nodes on a shared connection are
+called shared nodes. The message wraps a complete TCP message frame to or from
+the shared node using the given channel. The client chooses the channel
+numbers, which must not be zero. It opens a channel by sending the first login
+message of the node, a MsgProtoVer, on a channel that is not in use. The node
+then logs in just like on a connection of its own. An empty frame closes the
+channel. The client sends it when the node disconnects. The server sends it
+when it disconnects the node, e.g. after sending a MsgError, or when the
+channel could not be opened.
+
+A shared node sends its UDP messages from the same socket as the node that
+owns the connection, using its own client id and sequence numbers. It must
+send a MsgUdpHeartbeat after login so that the server learn the port number
+but after that the heartbeats of the owning node cover all shared nodes.
+Shared nodes are disconnected when the connection is.
+*/
+class MsgMuxFrame : public ReflectorMsgBase<118>
+{
+  public:
+    /**
+     * @brief   The size of the packed message in front of the frame data
+     */
+    static const size_t PREFIX_SIZE = 3 * sizeof(uint16_t);
+
+    /**
+     * @brief   The largest frame that may carry a wrapped post-auth frame
+     */
+    static const uint32_t MAX_FRAME_SIZE =
+      MAX_POSTAUTH_FRAME_SIZE + PREFIX_SIZE;
+
+    MsgMuxFrame(uint16_t channel=0) : m_channel(channel) {}
+    MsgMuxFrame(uint16_t channel, const std::string& frame)
+      : m_channel(channel), m_frame(frame.begin(), frame.end()) {}
+    uint16_t channel(void) const { return m_channel; }
+    std::vector<uint8_t>& frame(void) { return m_frame; }
+
+    /**
+     * @brief   Write the packed message in front of a wrapped frame
+     * @param   buf     Pointer to a buffer, PREFIX_SIZE bytes long
+     * @param   channel The channel of the shared node
+     * @param   size    The size of the wrapped frame that follow
+     *
+     * This function is used to wrap an already packed frame without copying
+     * it into the message first.
+     */
+    static void packPrefix(char *buf, uint16_t channel, uint16_t size)
+    {
+      buf[0] = static_cast<char>(TYPE >> 8);
+      buf[1] = static_cast<char>(TYPE & 0xff);
+      buf[2] = static_cast<char>(channel >> 8);
+      buf[3] = static_cast<char>(channel & 0xff);
+      buf[4] = static_cast<char>(size >> 8);
+      buf[5] = static_cast<char>(size & 0xff);
+    }
+
+    ASYNC_MSG_MEMBERS(m_channel, m_frame)
+
+  private:
+    uint16_t              m_channel;
+    std::vector<uint8_t>  m_frame;
+}; /* class MsgMuxFrame */
+
+
+/**
+@brief	 Trunk subscription TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This message is sent between two reflectors connected by a trunk link. It
+contain the talk groups that have members or monitors on the sending
+reflector. Only traffic for these talk groups will be sent over the trunk. The
+message is sent again each time the set of talk groups change.
+*/
+class MsgTrunkSubscribe : public ReflectorMsgBase<200>
+{
+  public:
+    MsgTrunkSubscribe(void) {}
+    MsgTrunkSubscribe(const std::set<uint32_t>& tgs) : m_tgs(tgs) {}
+
+    const std::set<uint32_t>& tgs(void) const { return m_tgs; }
+
+    ASYNC_MSG_MEMBERS(m_tgs);
+
+  private:
+    std::set<uint32_t> m_tgs;
+}; /* MsgTrunkSubscribe */
+
+
+/**
+@brief	 Trunk talker start TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This message is sent over a trunk link when a node connected to the sending
+reflector become the talker on a talk group that the other side subscribe to.
+*/
+class MsgTrunkTalkerStart : public ReflectorMsgBase<201>
+{
+  public:
+    MsgTrunkTalkerStart(uint32_t tg=0, const std::string& callsign="")
+      : m_tg(tg), m_callsign(callsign) {}
+
+    uint32_t tg(void) const { return m_tg; }
+    const std::string& callsign(void) const { return m_callsign; }
+
+    ASYNC_MSG_MEMBERS(m_tg, m_callsign);
+
+  private:
+    uint32_t    m_tg;
+    std::string m_callsign;
+}; /* MsgTrunkTalkerStart */
+
+
+/**
+@brief	 Trunk talker stop TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This message is sent over a trunk link when the talker on a talk group stop
+talking.
+*/
+class MsgTrunkTalkerStop : public ReflectorMsgBase<202>
+{
+  public:
+    MsgTrunkTalkerStop(uint32_t tg=0, const std::string& callsign="")
+      : m_tg(tg), m_callsign(callsign) {}
+
+    uint32_t tg(void) const { return m_tg; }
+    const std::string& callsign(void) const { return m_callsign; }
+
+    ASYNC_MSG_MEMBERS(m_tg, m_callsign);
+
+  private:
+    uint32_t    m_tg;
+    std::string m_callsign;
+}; /* MsgTrunkTalkerStop */
+
+
+/**
+@brief	 Trunk audio TCP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This message carry one encoded audio frame from the talker on a talk group over
+a trunk link. The origin is the trunk id of the reflector where the talker is
+connected. Together with the session number, which is chosen at random when a
+reflector start, and the sequence number it is used by the receiver to detect
+and throw away frames that have already been seen.
+*/
+class MsgTrunkAudio : public ReflectorMsgBase<203>
+{
+  public:
+    MsgTrunkAudio(void) : m_tg(0), m_session(0), m_seq(0) {}
+    MsgTrunkAudio(uint32_t tg, const std::string& origin, uint32_t session,
+                  uint32_t seq, const void *buf, int count)
+      : m_tg(tg), m_origin(origin), m_session(session), m_seq(seq)
+    {
+      if (count > 0)
+      {
+        const uint8_t *bbuf = reinterpret_cast<const uint8_t*>(buf);
+        m_audio_data.assign(bbuf, bbuf+count);
+      }
+    }
+
+    uint32_t tg(void) const { return m_tg; }
+    const std::string& origin(void) const { return m_origin; }
+    uint32_t session(void) const { return m_session; }
+    uint32_t seq(void) const { return m_seq; }
+    const std::vector<uint8_t>& audioData(void) const { return m_audio_data; }
+
+    ASYNC_MSG_MEMBERS(m_tg, m_origin, m_session, m_seq, m_audio_data);
+
+  private:
+    uint32_t              m_tg;
+    std::string           m_origin;
+    uint32_t              m_session;
+    uint32_t              m_seq;
+    std::vector<uint8_t>  m_audio_data;
+}; /* MsgTrunkAudio */
+
+
 /***************************** UDP Messages *****************************/
 
 /**
@@ -1148,6 +1572,25 @@ class MsgUdpAudio : public ReflectorUdpMsgBase<101>
     std::vector<uint8_t>& audioData(void) { return m_audio_data; }
     const std::vector<uint8_t>& audioData(void) const { return m_audio_data; }
 
+    /**
+     * @brief   The size of the packed audio data length field
+     */
+    static const size_t DATA_SIZE_LEN = 2;
+
+    /**
+     * @brief   Write the packed audio data length field
+     * @param   buf   Pointer to a buffer, DATA_SIZE_LEN bytes long
+     * @param   size  The size of the audio data that follow the field
+     *
+     * The packed message body is the length field followed by the audio
+     * data so a message can be packed in place in front of the audio data.
+     */
+    static void packDataSize(char *buf, uint16_t size)
+    {
+      buf[0] = static_cast<char>(size >> 8);
+      buf[1] = static_cast<char>(size & 0xff);
+    }
+
     ASYNC_MSG_MEMBERS(m_audio_data)
 
   private:
@@ -1155,6 +1598,112 @@ class MsgUdpAudio : public ReflectorUdpMsgBase<101>
 }; /* MsgUdpAudio */
 
 
+/**
+@brief	 Latency trace extension for an audio UDP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This optional field may be appended after the body of a MsgUdpAudio message.
+It carry the capture time, in nanoseconds since the epoch, of a sampled audio
+block so that the end-to-end latency can be traced. It is only sent on a small
+fraction of the audio frames. Receivers that do not know about the field
+ignore the trailing bytes. The reflector forward the field together with the
+audio.
+*/
+class MsgUdpAudioLatencyMark : public Async::Msg
+{
+  public:
+    static const uint16_t MAGIC = 0x4c4d; // "LM"
+    static const size_t PACKED_SIZE = sizeof(uint16_t) + sizeof(uint64_t);
+
+    MsgUdpAudioLatencyMark(uint64_t mark=0) : m_magic(MAGIC), m_mark(mark) {}
+    bool isValid(void) const { return (m_magic == MAGIC) && (m_mark != 0); }
+    uint64_t mark(void) const { return m_mark; }
+
+    ASYNC_MSG_MEMBERS(m_magic, m_mark)
+
+  private:
+    uint16_t m_magic;
+    uint64_t m_mark;
+}; /* MsgUdpAudioLatencyMark */
+
+
+/**
+@brief	 A non-owning view of an audio UDP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-05-10
+
+This class is used to unpack a MsgUdpAudio message directly from a receive
+buffer without copying the audio data. The buffer must outlive the view. An
+appended MsgUdpAudioLatencyMark field is unpacked as well and is included in
+the packed size.
+*/
+class MsgUdpAudioView
+{
+  public:
+    MsgUdpAudioView(void)
+      : m_audio_data(0), m_audio_size(0), m_latency_mark(0) {}
+
+    /**
+     * @brief   Unpack the message body
+     * @param   buf Pointer to the message body, just after the header
+     * @param   len The number of bytes available in the buffer
+     * @return  Returns \em true on success or \em false on failure
+     */
+    bool unpack(const char *buf, size_t len)
+    {
+      if (len < sizeof(uint16_t))
+      {
+        return false;
+      }
+      const uint8_t *ubuf = reinterpret_cast<const uint8_t*>(buf);
+      m_audio_size = (static_cast<size_t>(ubuf[0]) << 8) | ubuf[1];
+      if (len - sizeof(uint16_t) < m_audio_size)
+      {
+        return false;
+      }
+      m_audio_data = ubuf + sizeof(uint16_t);
+      m_latency_mark = 0;
+      const uint8_t *ext = m_audio_data + m_audio_size;
+      if ((len - sizeof(uint16_t) - m_audio_size >=
+           MsgUdpAudioLatencyMark::PACKED_SIZE) &&
+          (((static_cast<uint16_t>(ext[0]) << 8) | ext[1]) ==
+           MsgUdpAudioLatencyMark::MAGIC))
+      {
+        for (size_t i=0; i<sizeof(uint64_t); ++i)
+        {
+          m_latency_mark = (m_latency_mark << 8) | ext[sizeof(uint16_t) + i];
+        }
+      }
+      return true;
+    }
+
+    const uint8_t* audioData(void) const { return m_audio_data; }
+    size_t audioSize(void) const { return m_audio_size; }
+
+    /**
+     * @brief   Get the latency trace mark
+     * @return  Returns the capture time of the audio or zero if not present
+     */
+    uint64_t latencyMark(void) const { return m_latency_mark; }
+
+    /**
+     * @brief   Get the packed size of the message body
+     * @return  Returns the number of bytes the body occupy in the buffer
+     */
+    size_t packedSize(void) const
+    {
+      return sizeof(uint16_t) + m_audio_size +
+             ((m_latency_mark != 0) ? MsgUdpAudioLatencyMark::PACKED_SIZE : 0);
+    }
+
+  private:
+    const uint8_t*  m_audio_data;
+    size_t          m_audio_size;
+    uint64_t        m_latency_mark;
+}; /* MsgUdpAudioView */
+
+
 /**
 @brief	 Audio flush UDP network message
 @author  Tobias Blomberg / SM0SVX
@@ -1199,6 +1748,78 @@ struct MsgUdpSignalStrengthValues
 }; /* MsgUdpSignalStrengthValues */
 
 
+/**
+@brief   Ping UDP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This message can be sent by both the client and the reflector to measure the
+round trip time. The other side answer with a MsgUdpPong carrying the same
+timestamp. The timestamp is only interpreted by the sender of the ping.
+Unknown UDP messages are ignored so older versions will not answer.
+*/
+class MsgUdpPing : public ReflectorUdpMsgBase<105>
+{
+  public:
+    MsgUdpPing(uint32_t timestamp=0) : m_timestamp(timestamp) {}
+    uint32_t timestamp(void) const { return m_timestamp; }
+
+    ASYNC_MSG_MEMBERS(m_timestamp)
+
+  private:
+    uint32_t m_timestamp;
+}; /* MsgUdpPing */
+
+
+/**
+@brief   Pong UDP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2020-10-14
+
+This message is the answer to a MsgUdpPing.
+*/
+class MsgUdpPong : public ReflectorUdpMsgBase<106>
+{
+  public:
+    MsgUdpPong(uint32_t timestamp=0) : m_timestamp(timestamp) {}
+    uint32_t timestamp(void) const { return m_timestamp; }
+
+    ASYNC_MSG_MEMBERS(m_timestamp)
+
+  private:
+    uint32_t m_timestamp;
+}; /* MsgUdpPong */
+
+
+/**
+@brief   Shared delivery UDP network message
+@author  Tobias Blomberg / SM0SVX
+@date    2026-10-14
+
+The server sends this message on a shared connection, see MsgMuxFrame, when
+more than one node on it should receive the same UDP message. The message is
+then sent only once. The header has the client id and sequence number of the
+first receiving node. The body has the client ids of the other receiving
+nodes and the type of the wrapped message, followed by the body of the
+wrapped message. The wrapped message should be handled as if each node had
+received it. Only the first receiving node should check the sequence number.
+*/
+class MsgUdpMuxDelivery : public ReflectorUdpMsgBase<107>
+{
+  public:
+    MsgUdpMuxDelivery(uint16_t msg_type=0) : m_msg_type(msg_type) {}
+    uint16_t msgType(void) const { return m_msg_type; }
+    std::vector<uint16_t>& clientIds(void) { return m_client_ids; }
+    const std::vector<uint16_t>& clientIds(void) const { return m_client_ids; }
+
+    ASYNC_MSG_MEMBERS(m_client_ids, m_msg_type)
+
+  private:
+    std::vector<uint16_t> m_client_ids;
+    uint16_t              m_msg_type;
+}; /* MsgUdpMuxDelivery */
+
+
 #if 0
 /**
 @brief	 Audio UDP network message V2
@@ -0,0 +1,637 @@
+/**
+@file   ReflectorTrunk.cpp
+@brief  A trunk link between two reflectors
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <cassert>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "ReflectorTrunk.h"
+#include "TGHandler.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+ReflectorTrunk::ReflectorTrunk(const std::string& name,
+                               const std::string& local_id)
+  : m_name(name), m_local_id(local_id), m_port(5302), m_client(0), m_con(0),
+    m_con_state(STATE_DISCONNECTED),
+    m_heartbeat_timer(1000, Timer::TYPE_PERIODIC, false),
+    m_reconnect_timer(RECONNECT_INTERVAL, Timer::TYPE_ONESHOT, false),
+    m_heartbeat_tx_cnt(0), m_heartbeat_rx_cnt(0), m_local_tgs_sent(false)
+{
+  m_heartbeat_timer.expired.connect(
+      mem_fun(*this, &ReflectorTrunk::handleTimerTick));
+  m_reconnect_timer.expired.connect(
+      sigc::hide(mem_fun(*this, &ReflectorTrunk::connect)));
+} /* ReflectorTrunk::ReflectorTrunk */
+
+
+ReflectorTrunk::~ReflectorTrunk(void)
+{
+  delete m_client;
+  m_client = 0;
+  m_con = 0;
+} /* ReflectorTrunk::~ReflectorTrunk */
+
+
+bool ReflectorTrunk::initialize(Async::Config& cfg)
+{
+  if (!cfg.getValue(m_name, "PEER_ID", m_peer_id) || m_peer_id.empty())
+  {
+    cerr << "*** ERROR: Config variable " << m_name
+         << "/PEER_ID not set or empty" << endl;
+    return false;
+  }
+  if (!cfg.getValue(m_name, "SECRET", m_secret) || m_secret.empty())
+  {
+    cerr << "*** ERROR: Config variable " << m_name
+         << "/SECRET not set or empty" << endl;
+    return false;
+  }
+  cfg.getValue(m_name, "HOST", m_host);
+  cfg.getValue(m_name, "PORT", m_port);
+
+  if (isActive())
+  {
+    m_client = new FramedTcpClient(m_host, m_port);
+    m_client->connected.connect(
+        mem_fun(*this, &ReflectorTrunk::onConnected));
+    m_client->disconnected.connect(
+        mem_fun(*this, &ReflectorTrunk::onDisconnected));
+    m_client->frameReceived.connect(
+        mem_fun(*this, &ReflectorTrunk::onFrameReceived));
+    connect();
+  }
+
+  return true;
+} /* ReflectorTrunk::initialize */
+
+
+bool ReflectorTrunk::authenticate(const MsgAuthResponse& msg,
+                                  const uint8_t *challenge) const
+{
+  return !isActive() && (msg.callsign() == m_peer_id) &&
+         msg.verify(m_secret, challenge);
+} /* ReflectorTrunk::authenticate */
+
+
+void ReflectorTrunk::accept(Async::FramedTcpConnection *con)
+{
+  if (m_con != 0)
+  {
+    cout << m_name << ": Replacing old trunk connection from " << m_peer_id
+         << endl;
+    disconnect();
+  }
+  m_con = con;
+  m_con->setMaxFrameSize(ReflectorMsg::MAX_POSTAUTH_FRAME_SIZE);
+  m_con_state = STATE_CONNECTED;
+  sendMsg(MsgAuthOk());
+  linkUp();
+} /* ReflectorTrunk::accept */
+
+
+void ReflectorTrunk::connectionClosed(Async::FramedTcpConnection *con)
+{
+  if (isConnection(con))
+  {
+    m_con = 0;
+    linkDown();
+  }
+} /* ReflectorTrunk::connectionClosed */
+
+
+void ReflectorTrunk::talkerStart(uint32_t tg, const std::string& callsign)
+{
+  if (peerSubscribes(tg))
+  {
+    sendMsg(MsgTrunkTalkerStart(tg, callsign));
+  }
+} /* ReflectorTrunk::talkerStart */
+
+
+void ReflectorTrunk::talkerStop(uint32_t tg, const std::string& callsign)
+{
+  if (peerSubscribes(tg))
+  {
+    sendMsg(MsgTrunkTalkerStop(tg, callsign));
+  }
+} /* ReflectorTrunk::talkerStop */
+
+
+void ReflectorTrunk::sendAudio(uint32_t tg, uint32_t session, uint32_t seq,
+                               const void *buf, int size)
+{
+  if (peerSubscribes(tg))
+  {
+    sendMsg(MsgTrunkAudio(tg, m_local_id, session, seq, buf, size));
+  }
+} /* ReflectorTrunk::sendAudio */
+
+
+void ReflectorTrunk::handleFrame(std::vector<uint8_t>& data)
+{
+  if (m_con_state == STATE_DISCONNECTED)
+  {
+    return;
+  }
+
+  stringstream ss;
+  ss.write(reinterpret_cast<const char*>(&data.front()), data.size());
+
+  ReflectorMsg header;
+  if (!header.unpack(ss))
+  {
+    cout << "*** ERROR[" << m_name
+         << "]: Unpacking failed for trunk TCP message header" << endl;
+    disconnect();
+    return;
+  }
+
+  m_heartbeat_rx_cnt = HEARTBEAT_RX_CNT_RESET;
+
+  if ((m_con_state != STATE_CONNECTED) && (header.type() >= 100))
+  {
+    cout << "*** ERROR[" << m_name << "]: Unexpected protocol message "
+            "received before the trunk was authenticated" << endl;
+    disconnect();
+    return;
+  }
+
+  switch (header.type())
+  {
+    case MsgHeartbeat::TYPE:
+      break;
+    case MsgAuthChallenge::TYPE:
+      handleMsgAuthChallenge(ss);
+      break;
+    case MsgAuthOk::TYPE:
+      handleMsgAuthOk();
+      break;
+    case MsgError::TYPE:
+      handleMsgError(ss);
+      break;
+    case MsgTrunkSubscribe::TYPE:
+      handleMsgTrunkSubscribe(ss);
+      break;
+    case MsgTrunkTalkerStart::TYPE:
+      handleMsgTrunkTalkerStart(ss);
+      break;
+    case MsgTrunkTalkerStop::TYPE:
+      handleMsgTrunkTalkerStop(ss);
+      break;
+    case MsgTrunkAudio::TYPE:
+      handleMsgTrunkAudio(ss);
+      break;
+    default:
+      // Ignore unknown messages to make it possible to add new ones while
+      // still being compatible with older reflectors
+      break;
+  }
+} /* ReflectorTrunk::handleFrame */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void ReflectorTrunk::connect(void)
+{
+  cout << m_name << ": Connecting to trunk peer " << m_peer_id << " at "
+       << m_host << ":" << m_port << endl;
+  m_reconnect_timer.setEnable(false);
+  m_client->setMaxFrameSize(ReflectorMsg::MAX_PREAUTH_FRAME_SIZE);
+  m_client->connect();
+} /* ReflectorTrunk::connect */
+
+
+void ReflectorTrunk::onConnected(void)
+{
+  cout << m_name << ": Connection established to trunk peer " << m_peer_id
+       << endl;
+  m_con = m_client;
+  m_con_state = STATE_EXPECT_AUTH_CHALLENGE;
+  m_heartbeat_tx_cnt = HEARTBEAT_TX_CNT_RESET;
+  m_heartbeat_rx_cnt = HEARTBEAT_RX_CNT_RESET;
+  m_heartbeat_timer.setEnable(true);
+} /* ReflectorTrunk::onConnected */
+
+
+void ReflectorTrunk::onDisconnected(Async::TcpConnection *con,
+                                    Async::TcpConnection::DisconnectReason reason)
+{
+  cout << m_name << ": Disconnected from trunk peer " << m_peer_id << ": "
+       << TcpConnection::disconnectReasonStr(reason) << endl;
+  m_con = 0;
+  linkDown();
+  m_reconnect_timer.setEnable(true);
+} /* ReflectorTrunk::onDisconnected */
+
+
+void ReflectorTrunk::onFrameReceived(Async::FramedTcpConnection *con,
+                                     std::vector<uint8_t>& data)
+{
+  handleFrame(data);
+} /* ReflectorTrunk::onFrameReceived */
+
+
+void ReflectorTrunk::handleMsgAuthChallenge(std::istream& is)
+{
+  if (m_con_state != STATE_EXPECT_AUTH_CHALLENGE)
+  {
+    cerr << "*** ERROR[" << m_name << "]: Unexpected MsgAuthChallenge" << endl;
+    disconnect();
+    return;
+  }
+  MsgAuthChallenge msg;
+  if (!msg.unpack(is) || (msg.challenge() == 0))
+  {
+    cerr << "*** ERROR[" << m_name << "]: Could not unpack MsgAuthChallenge"
+         << endl;
+    disconnect();
+    return;
+  }
+  sendMsg(MsgAuthResponse(m_local_id, m_secret, msg.challenge()));
+  m_con_state = STATE_EXPECT_AUTH_OK;
+} /* ReflectorTrunk::handleMsgAuthChallenge */
+
+
+void ReflectorTrunk::handleMsgAuthOk(void)
+{
+  if (m_con_state != STATE_EXPECT_AUTH_OK)
+  {
+    cerr << "*** ERROR[" << m_name << "]: Unexpected MsgAuthOk" << endl;
+    disconnect();
+    return;
+  }
+  m_client->setMaxFrameSize(ReflectorMsg::MAX_POSTAUTH_FRAME_SIZE);
+  m_con_state = STATE_CONNECTED;
+  linkUp();
+} /* ReflectorTrunk::handleMsgAuthOk */
+
+
+void ReflectorTrunk::handleMsgError(std::istream& is)
+{
+  MsgError msg;
+  std::string message;
+  if (msg.unpack(is))
+  {
+    message = msg.message();
+  }
+  cout << m_name << ": Error message received from trunk peer " << m_peer_id
+       << ": " << message << endl;
+  disconnect();
+} /* ReflectorTrunk::handleMsgError */
+
+
+void ReflectorTrunk::handleMsgTrunkSubscribe(std::istream& is)
+{
+  MsgTrunkSubscribe msg;
+  if (!msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << m_name << "]: Could not unpack MsgTrunkSubscribe"
+         << endl;
+    disconnect();
+    return;
+  }
+  std::set<uint32_t> old_tgs;
+  old_tgs.swap(m_peer_tgs);
+  m_peer_tgs = msg.tgs();
+
+    // Tell the other side about talkers that are already active on the
+    // newly subscribed talk groups
+  for (std::set<uint32_t>::const_iterator it = m_peer_tgs.begin();
+       it != m_peer_tgs.end(); ++it)
+  {
+    if (old_tgs.count(*it) == 0)
+    {
+      ReflectorClient *talker = TGHandler::instance()->talkerForTG(*it);
+      if (talker != 0)
+      {
+        talkerStart(*it, talker->callsign());
+      }
+    }
+  }
+} /* ReflectorTrunk::handleMsgTrunkSubscribe */
+
+
+void ReflectorTrunk::handleMsgTrunkTalkerStart(std::istream& is)
+{
+  MsgTrunkTalkerStart msg;
+  if (!msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << m_name
+         << "]: Could not unpack MsgTrunkTalkerStart" << endl;
+    disconnect();
+    return;
+  }
+  RemoteTalkerMap::iterator it = m_remote_talkers.find(msg.tg());
+  if (it != m_remote_talkers.end())
+  {
+    if (it->second.callsign == msg.callsign())
+    {
+      return;
+    }
+    std::string old_callsign(it->second.callsign);
+    m_remote_talkers.erase(it);
+    talkerStopped(this, msg.tg(), old_callsign);
+  }
+  RemoteTalker& talker = m_remote_talkers[msg.tg()];
+  talker.callsign = msg.callsign();
+  gettimeofday(&talker.last_audio, NULL);
+  talkerStarted(this, msg.tg(), msg.callsign());
+} /* ReflectorTrunk::handleMsgTrunkTalkerStart */
+
+
+void ReflectorTrunk::handleMsgTrunkTalkerStop(std::istream& is)
+{
+  MsgTrunkTalkerStop msg;
+  if (!msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << m_name
+         << "]: Could not unpack MsgTrunkTalkerStop" << endl;
+    disconnect();
+    return;
+  }
+  RemoteTalkerMap::iterator it = m_remote_talkers.find(msg.tg());
+  if (it != m_remote_talkers.end())
+  {
+    m_remote_talkers.erase(it);
+    talkerStopped(this, msg.tg(), msg.callsign());
+  }
+} /* ReflectorTrunk::handleMsgTrunkTalkerStop */
+
+
+void ReflectorTrunk::handleMsgTrunkAudio(std::istream& is)
+{
+  MsgTrunkAudio msg;
+  if (!msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << m_name << "]: Could not unpack MsgTrunkAudio"
+         << endl;
+    disconnect();
+    return;
+  }
+  RemoteTalkerMap::iterator it = m_remote_talkers.find(msg.tg());
+  if ((it == m_remote_talkers.end()) || msg.audioData().empty())
+  {
+    return;
+  }
+  gettimeofday(&it->second.last_audio, NULL);
+  audioReceived(this, msg);
+} /* ReflectorTrunk::handleMsgTrunkAudio */
+
+
+void ReflectorTrunk::linkUp(void)
+{
+  cout << m_name << ": Trunk link to " << m_peer_id << " is up" << endl;
+  m_heartbeat_tx_cnt = HEARTBEAT_TX_CNT_RESET;
+  m_heartbeat_rx_cnt = HEARTBEAT_RX_CNT_RESET;
+  m_heartbeat_timer.setEnable(true);
+  m_local_tgs_sent = false;
+  updateLocalTGs();
+  linkStateChanged(this, true);
+} /* ReflectorTrunk::linkUp */
+
+
+void ReflectorTrunk::linkDown(void)
+{
+  bool was_up = isUp();
+  m_con_state = STATE_DISCONNECTED;
+  m_heartbeat_timer.setEnable(false);
+  m_peer_tgs.clear();
+  m_local_tgs.clear();
+  m_local_tgs_sent = false;
+  while (!m_remote_talkers.empty())
+  {
+    uint32_t tg = m_remote_talkers.begin()->first;
+    std::string callsign(m_remote_talkers.begin()->second.callsign);
+    m_remote_talkers.erase(m_remote_talkers.begin());
+    talkerStopped(this, tg, callsign);
+  }
+  if (was_up)
+  {
+    cout << m_name << ": Trunk link to " << m_peer_id << " is down" << endl;
+    linkStateChanged(this, false);
+  }
+} /* ReflectorTrunk::linkDown */
+
+
+void ReflectorTrunk::disconnect(void)
+{
+  if (m_con == 0)
+  {
+    return;
+  }
+  if (isActive())
+  {
+    m_client->disconnect();
+    m_con = 0;
+    linkDown();
+    m_reconnect_timer.setEnable(true);
+  }
+  else
+  {
+      // The connection is owned by the trunk server in the reflector. The
+      // disconnected signal will make the server remove the connection and
+      // call the connectionClosed function.
+    Async::FramedTcpConnection *con = m_con;
+    con->disconnect();
+    con->disconnected(con, FramedTcpConnection::DR_ORDERED_DISCONNECT);
+  }
+} /* ReflectorTrunk::disconnect */
+
+
+void ReflectorTrunk::sendMsg(const ReflectorMsg& msg)
+{
+  if (m_con == 0)
+  {
+    return;
+  }
+
+  m_heartbeat_tx_cnt = HEARTBEAT_TX_CNT_RESET;
+
+  ostringstream ss;
+  ReflectorMsg header(msg.type());
+  if (!header.pack(ss) || !msg.pack(ss))
+  {
+    cerr << "*** ERROR[" << m_name << "]: Failed to pack trunk TCP message"
+         << endl;
+    return;
+  }
+  if (m_con->write(ss.str().data(), ss.str().size()) == -1)
+  {
+    disconnect();
+  }
+} /* ReflectorTrunk::sendMsg */
+
+
+void ReflectorTrunk::handleTimerTick(Async::Timer *t)
+{
+  if (--m_heartbeat_tx_cnt == 0)
+  {
+    sendMsg(MsgHeartbeat());
+  }
+
+  if (--m_heartbeat_rx_cnt == 0)
+  {
+    cout << m_name << ": Heartbeat timeout on trunk to " << m_peer_id << endl;
+    disconnect();
+    return;
+  }
+
+  if (!isUp())
+  {
+    return;
+  }
+
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  RemoteTalkerMap::iterator it = m_remote_talkers.begin();
+  while (it != m_remote_talkers.end())
+  {
+    struct timeval diff;
+    timersub(&now, &it->second.last_audio, &diff);
+    if (diff.tv_sec > TALKER_AUDIO_TIMEOUT)
+    {
+      uint32_t tg = it->first;
+      std::string callsign(it->second.callsign);
+      cout << callsign << ": Trunk talker audio timeout on TG #" << tg << endl;
+      m_remote_talkers.erase(it++);
+      talkerStopped(this, tg, callsign);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+
+  updateLocalTGs();
+} /* ReflectorTrunk::handleTimerTick */
+
+
+void ReflectorTrunk::updateLocalTGs(void)
+{
+  std::set<uint32_t> tgs;
+  TGHandler::instance()->activeTGs(tgs);
+  if (!m_local_tgs_sent || (tgs != m_local_tgs))
+  {
+    m_local_tgs.swap(tgs);
+    m_local_tgs_sent = true;
+    sendMsg(MsgTrunkSubscribe(m_local_tgs));
+  }
+} /* ReflectorTrunk::updateLocalTGs */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,344 @@
+/**
+@file   ReflectorTrunk.h
+@brief  A trunk link between two reflectors
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef REFLECTOR_TRUNK_INCLUDED
+#define REFLECTOR_TRUNK_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <sys/time.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncTcpClient.h>
+#include <AsyncFramedTcpConnection.h>
+#include <AsyncTimer.h>
+#include <AsyncConfig.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "ReflectorMsg.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  A trunk link between two reflectors
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+A trunk link connect two reflectors so that talk groups can span more than one
+reflector. Each side tell the other which talk groups that have members or
+monitors locally and only the talker state and the audio for those talk groups
+are sent over the link.
+
+The link is a TCP connection. The side that has the HOST configuration
+variable set connect to the other side, which accept the connection on its
+trunk listen port. The connecting side is authenticated using the same
+challenge/response mechanism that is used for the nodes, with the trunk id of
+the connecting reflector as the username and the shared secret as the key.
+*/
+class ReflectorTrunk : public sigc::trackable
+{
+  public:
+    /**
+     * @brief   Constructor
+     * @param   name      The name of the configuration section
+     * @param   local_id  The trunk id of this reflector
+     */
+    ReflectorTrunk(const std::string& name, const std::string& local_id);
+
+    /**
+     * @brief   Destructor
+     */
+    ~ReflectorTrunk(void);
+
+    /**
+     * @brief   Initialize the trunk from the configuration
+     * @param   cfg The configuration to read from
+     * @return  Returns \em true on success or else \em false
+     */
+    bool initialize(Async::Config& cfg);
+
+    /**
+     * @brief   Get the name of the trunk
+     * @return  Returns the name of the configuration section
+     */
+    const std::string& name(void) const { return m_name; }
+
+    /**
+     * @brief   Get the trunk id of the reflector on the other side
+     * @return  Returns the configured PEER_ID
+     */
+    const std::string& peerId(void) const { return m_peer_id; }
+
+    /**
+     * @brief   Check if this side is connecting to the other side
+     * @return  Returns \em true if the HOST configuration variable is set
+     */
+    bool isActive(void) const { return !m_host.empty(); }
+
+    /**
+     * @brief   Check if the trunk link is up
+     * @return  Returns \em true if the link is connected and authenticated
+     */
+    bool isUp(void) const { return m_con_state == STATE_CONNECTED; }
+
+    /**
+     * @brief   Check if a connection is the one used by this trunk
+     * @param   con The connection to check
+     * @return  Returns \em true if the given connection belong to this trunk
+     */
+    bool isConnection(const Async::FramedTcpConnection *con) const
+    {
+      return (con != 0) && (con == m_con);
+    }
+
+    /**
+     * @brief   Check if an incoming connection may be used for this trunk
+     * @param   msg       The authentication response from the other side
+     * @param   challenge The challenge previously sent to the other side
+     * @return  Returns \em true if the peer id and the digest match
+     */
+    bool authenticate(const MsgAuthResponse& msg,
+                      const uint8_t *challenge) const;
+
+    /**
+     * @brief   Use an authenticated incoming connection for this trunk
+     * @param   con The connection
+     *
+     * The connection is owned by the trunk server in the reflector. Received
+     * frames must be handed over using the handleFrame function.
+     */
+    void accept(Async::FramedTcpConnection *con);
+
+    /**
+     * @brief   Tell the trunk that an incoming connection has been closed
+     * @param   con The connection that was closed
+     */
+    void connectionClosed(Async::FramedTcpConnection *con);
+
+    /**
+     * @brief   Handle a frame received on an incoming connection
+     * @param   data The frame
+     */
+    void handleFrame(std::vector<uint8_t>& data);
+
+    /**
+     * @brief   Check if the other side want traffic for a talk group
+     * @param   tg The talk group
+     * @return  Returns \em true if the link is up and the talk group is
+     *          subscribed by the other side
+     */
+    bool peerSubscribes(uint32_t tg) const
+    {
+      return isUp() && (m_peer_tgs.count(tg) > 0);
+    }
+
+    /**
+     * @brief   Get the talk groups that the other side subscribe to
+     * @return  Returns the set of subscribed talk groups
+     */
+    const std::set<uint32_t>& peerTGs(void) const { return m_peer_tgs; }
+
+    /**
+     * @brief   Tell the other side that a local node started talking
+     * @param   tg        The talk group
+     * @param   callsign  The callsign of the talker
+     */
+    void talkerStart(uint32_t tg, const std::string& callsign);
+
+    /**
+     * @brief   Tell the other side that a local node stopped talking
+     * @param   tg        The talk group
+     * @param   callsign  The callsign of the talker
+     */
+    void talkerStop(uint32_t tg, const std::string& callsign);
+
+    /**
+     * @brief   Send an audio frame from a local talker to the other side
+     * @param   tg      The talk group
+     * @param   session The session number of this reflector
+     * @param   seq     The sequence number of the frame
+     * @param   buf     The encoded audio frame
+     * @param   size    The size of the frame
+     */
+    void sendAudio(uint32_t tg, uint32_t session, uint32_t seq,
+                   const void *buf, int size);
+
+    /**
+     * @brief   A signal emitted when a talker start on the other side
+     * @param   trunk     This object
+     * @param   tg        The talk group
+     * @param   callsign  The callsign of the talker
+     */
+    sigc::signal<void, ReflectorTrunk*, uint32_t,
+                 const std::string&> talkerStarted;
+
+    /**
+     * @brief   A signal emitted when a talker on the other side stop
+     * @param   trunk     This object
+     * @param   tg        The talk group
+     * @param   callsign  The callsign of the talker
+     *
+     * This signal is also emitted when the talker audio time out and for all
+     * talkers when the link go down.
+     */
+    sigc::signal<void, ReflectorTrunk*, uint32_t,
+                 const std::string&> talkerStopped;
+
+    /**
+     * @brief   A signal emitted when an audio frame is received
+     * @param   trunk This object
+     * @param   msg   The received audio message
+     */
+    sigc::signal<void, ReflectorTrunk*, const MsgTrunkAudio&> audioReceived;
+
+    /**
+     * @brief   A signal emitted when the link go up or down
+     * @param   trunk This object
+     * @param   is_up \em true if the link is up or else \em false
+     */
+    sigc::signal<void, ReflectorTrunk*, bool> linkStateChanged;
+
+  private:
+    typedef enum
+    {
+      STATE_DISCONNECTED, STATE_EXPECT_AUTH_CHALLENGE, STATE_EXPECT_AUTH_OK,
+      STATE_CONNECTED
+    } ConState;
+    struct RemoteTalker
+    {
+      std::string     callsign;
+      struct timeval  last_audio;
+    };
+    typedef std::map<uint32_t, RemoteTalker> RemoteTalkerMap;
+    typedef Async::TcpClient<Async::FramedTcpConnection> FramedTcpClient;
+
+    static const unsigned HEARTBEAT_TX_CNT_RESET  = 10;
+    static const unsigned HEARTBEAT_RX_CNT_RESET  = 15;
+    static const unsigned RECONNECT_INTERVAL      = 10000;
+    static const time_t   TALKER_AUDIO_TIMEOUT    = 3;
+
+    std::string                 m_name;
+    std::string                 m_local_id;
+    std::string                 m_peer_id;
+    std::string                 m_secret;
+    std::string                 m_host;
+    uint16_t                    m_port;
+    FramedTcpClient*            m_client;
+    Async::FramedTcpConnection* m_con;
+    ConState                    m_con_state;
+    Async::Timer                m_heartbeat_timer;
+    Async::Timer                m_reconnect_timer;
+    unsigned                    m_heartbeat_tx_cnt;
+    unsigned                    m_heartbeat_rx_cnt;
+    std::set<uint32_t>          m_peer_tgs;
+    std::set<uint32_t>          m_local_tgs;
+    bool                        m_local_tgs_sent;
+    RemoteTalkerMap             m_remote_talkers;
+
+    ReflectorTrunk(const ReflectorTrunk&);
+    ReflectorTrunk& operator=(const ReflectorTrunk&);
+    void connect(void);
+    void onConnected(void);
+    void onDisconnected(Async::TcpConnection *con,
+                        Async::TcpConnection::DisconnectReason reason);
+    void onFrameReceived(Async::FramedTcpConnection *con,
+                         std::vector<uint8_t>& data);
+    void handleMsgAuthChallenge(std::istream& is);
+    void handleMsgAuthOk(void);
+    void handleMsgError(std::istream& is);
+    void handleMsgTrunkSubscribe(std::istream& is);
+    void handleMsgTrunkTalkerStart(std::istream& is);
+    void handleMsgTrunkTalkerStop(std::istream& is);
+    void handleMsgTrunkAudio(std::istream& is);
+    void linkUp(void);
+    void linkDown(void);
+    void disconnect(void);
+    void sendMsg(const ReflectorMsg& msg);
+    void handleTimerTick(Async::Timer *t);
+    void updateLocalTGs(void);
+
+};  /* class ReflectorTrunk */
+
+
+#endif /* REFLECTOR_TRUNK_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,378 @@
+/**
+@file   TGAudioStream.cpp
+@brief  Stream the audio of a talk group to HTTP listeners
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that stream the audio of a talk group as Ogg/Opus
+to HTTP listeners.
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/uio.h>
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioDecoder.h>
+#include <AsyncAudioContainer.h>
+#include <AsyncHttpServerConnection.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "TGAudioStream.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+TGAudioStream::TGAudioStream(uint32_t tg)
+  : m_tg(tg), m_dec(0), m_container(0), m_first_page(0), m_backlog_size(0),
+    m_skip_cnt(0)
+{
+  m_container = createAudioContainer("opus");
+  if (m_container == 0)
+  {
+    cerr << "*** ERROR: Failed to create Ogg/Opus audio container for "
+            "streaming TG #" << tg << endl;
+    return;
+  }
+  m_container->setRealtime();
+  m_container->writeBlock.connect(
+      mem_fun(*this, &TGAudioStream::onWriteBlock));
+} /* TGAudioStream::TGAudioStream */
+
+
+TGAudioStream::~TGAudioStream(void)
+{
+  for (Listeners::iterator it=m_listeners.begin(); it!=m_listeners.end(); ++it)
+  {
+    (*it).second.send_buf_con.disconnect();
+  }
+  m_listeners.clear();
+  delete m_dec;
+  m_dec = 0;
+  delete m_container;
+  m_container = 0;
+} /* TGAudioStream::~TGAudioStream */
+
+
+const char* TGAudioStream::mediaType(void) const
+{
+  assert(initOk());
+  return m_container->mediaType();
+} /* TGAudioStream::mediaType */
+
+
+void TGAudioStream::addListener(Async::HttpServerConnection *con)
+{
+  assert(initOk());
+  Listener& l = m_listeners[con];
+  l.partial.assign(m_container->header(), m_container->headerSize());
+  l.partial_pos = 0;
+  l.next_page = m_first_page + m_pages.size();
+  l.page_pos = 0;
+  l.write_failed = false;
+    // The signal in TcpConnection is used since HttpServerConnection hide it
+  l.send_buf_con = con->TcpConnection::sendBufferFull.connect(
+      sigc::bind(mem_fun(*this, &TGAudioStream::onSendBufferFull), con));
+  sendPending(con, l);
+} /* TGAudioStream::addListener */
+
+
+bool TGAudioStream::removeListener(Async::HttpServerConnection *con)
+{
+  Listeners::iterator it = m_listeners.find(con);
+  if (it == m_listeners.end())
+  {
+    return false;
+  }
+  (*it).second.send_buf_con.disconnect();
+  m_listeners.erase(it);
+  trimBacklog();
+  return true;
+} /* TGAudioStream::removeListener */
+
+
+void TGAudioStream::writeEncodedSamples(const std::string& codec,
+                                        const void *buf, int size)
+{
+  if (!initOk())
+  {
+    return;
+  }
+  if ((m_dec == 0) || (codec != m_codec))
+  {
+    delete m_dec;
+    m_codec = codec;
+    m_dec = AudioDecoder::create(codec);
+    if (m_dec == 0)
+    {
+      cerr << "*** ERROR: Failed to create " << codec
+           << " audio decoder for streaming TG #" << m_tg << endl;
+      return;
+    }
+    m_dec->registerSink(m_container);
+  }
+  m_dec->writeEncodedSamples(const_cast<void*>(buf), size);
+} /* TGAudioStream::writeEncodedSamples */
+
+
+void TGAudioStream::flush(void)
+{
+  if (m_dec != 0)
+  {
+    m_dec->flushEncodedSamples();
+  }
+} /* TGAudioStream::flush */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void TGAudioStream::onWriteBlock(const char *buf, size_t len)
+{
+  m_pages.push_back(std::string(buf, len));
+  m_backlog_size += len;
+  for (Listeners::iterator it=m_listeners.begin(); it!=m_listeners.end(); ++it)
+  {
+    sendPending((*it).first, (*it).second);
+  }
+  trimBacklog();
+} /* TGAudioStream::onWriteBlock */
+
+
+void TGAudioStream::onSendBufferFull(bool is_full,
+                                     Async::HttpServerConnection *con)
+{
+  if (is_full)
+  {
+    return;
+  }
+  Listeners::iterator it = m_listeners.find(con);
+  if (it != m_listeners.end())
+  {
+    sendPending(con, (*it).second);
+    trimBacklog();
+  }
+} /* TGAudioStream::onSendBufferFull */
+
+
+void TGAudioStream::sendPending(Async::HttpServerConnection *con, Listener& l)
+{
+  if (l.write_failed)
+  {
+    return;
+  }
+
+    // Gather everything that is pending for this listener into one write
+  struct iovec iov[16];
+  int iovcnt = 0;
+  if (l.partial_pos < l.partial.size())
+  {
+    iov[iovcnt].iov_base = const_cast<char*>(l.partial.data()) + l.partial_pos;
+    iov[iovcnt].iov_len = l.partial.size() - l.partial_pos;
+    ++iovcnt;
+  }
+  size_t page_pos = l.page_pos;
+  for (unsigned long page = l.next_page;
+       (page < m_first_page + m_pages.size()) && (iovcnt < 16); ++page)
+  {
+    const std::string& data = m_pages[page - m_first_page];
+    iov[iovcnt].iov_base = const_cast<char*>(data.data()) + page_pos;
+    iov[iovcnt].iov_len = data.size() - page_pos;
+    ++iovcnt;
+    page_pos = 0;
+  }
+  if (iovcnt == 0)
+  {
+    return;
+  }
+
+  int cnt = con->TcpConnection::write(iov, iovcnt);
+  if (cnt < 0)
+  {
+      // The listener will be removed when the connection is closed
+    l.write_failed = true;
+    return;
+  }
+
+  size_t left = cnt;
+  if (l.partial_pos < l.partial.size())
+  {
+    size_t len = std::min(left, l.partial.size() - l.partial_pos);
+    l.partial_pos += len;
+    left -= len;
+    if (l.partial_pos < l.partial.size())
+    {
+      return;
+    }
+    l.partial.clear();
+    l.partial_pos = 0;
+  }
+  while ((left > 0) && (l.next_page < m_first_page + m_pages.size()))
+  {
+    const std::string& data = m_pages[l.next_page - m_first_page];
+    size_t len = std::min(left, data.size() - l.page_pos);
+    l.page_pos += len;
+    left -= len;
+    if (l.page_pos < data.size())
+    {
+      break;
+    }
+    l.page_pos = 0;
+    ++l.next_page;
+  }
+} /* TGAudioStream::sendPending */
+
+
+void TGAudioStream::trimBacklog(void)
+{
+  unsigned long min_next = m_first_page + m_pages.size();
+  for (Listeners::iterator it=m_listeners.begin(); it!=m_listeners.end(); ++it)
+  {
+    const Listener& l = (*it).second;
+    if (!l.write_failed && (l.next_page < min_next))
+    {
+      min_next = l.next_page;
+    }
+  }
+
+  while (!m_pages.empty() &&
+         ((m_first_page < min_next) || (m_backlog_size > MAX_BACKLOG_SIZE)))
+  {
+      // A listener that have not received the oldest page yet lose it. A
+      // page that has been partially sent must be completed to not break
+      // the stream so the rest of it is copied to the listener.
+    const std::string& data = m_pages.front();
+    for (Listeners::iterator it=m_listeners.begin();
+         it!=m_listeners.end(); ++it)
+    {
+      Listener& l = (*it).second;
+      if (l.next_page != m_first_page)
+      {
+        continue;
+      }
+      if (l.page_pos > 0)
+      {
+        l.partial.append(data, l.page_pos, std::string::npos);
+        l.page_pos = 0;
+      }
+      else
+      {
+        ++m_skip_cnt;
+      }
+      ++l.next_page;
+    }
+    m_backlog_size -= data.size();
+    m_pages.pop_front();
+    ++m_first_page;
+  }
+} /* TGAudioStream::trimBacklog */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,232 @@
+/**
+@file   TGAudioStream.h
+@brief  Stream the audio of a talk group to HTTP listeners
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that stream the audio of a talk group as Ogg/Opus
+to HTTP listeners.
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef TGAUDIO_STREAM_INCLUDED
+#define TGAUDIO_STREAM_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <stdint.h>
+
+#include <string>
+#include <deque>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class AudioDecoder;
+  class AudioContainer;
+  class HttpServerConnection;
+};
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Stream the audio of a talk group to HTTP listeners
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+The reflector use one audio stream for each talk group that have HTTP
+listeners. The incoming audio is decoded once and then encoded into an
+Ogg/Opus stream using an audio container, no matter how many listeners there
+are.
+
+Each finished Ogg page is stored once in a backlog shared by all listeners and
+each listener keep track of how far into the backlog it has come. Listeners
+are written to without blocking. If the socket of a listener is full, the rest
+is sent when the socket become writable again. The backlog is limited in size
+so a listener that cannot keep up will lose whole pages of audio. A slow
+listener will never hold back the audio path or the other listeners.
+*/
+class TGAudioStream : public sigc::trackable
+{
+  public:
+    /**
+     * @brief   Constructor
+     * @param   tg The talk group that this stream serve
+     */
+    explicit TGAudioStream(uint32_t tg);
+
+    /**
+     * @brief   Destructor
+     */
+    ~TGAudioStream(void);
+
+    /**
+     * @brief   Check if the stream was successfully initialized
+     * @return  Returns \em true if the audio container could be created
+     */
+    bool initOk(void) const { return m_container != 0; }
+
+    /**
+     * @brief   Get the talk group this stream serve
+     * @return  Returns the talk group number
+     */
+    uint32_t tg(void) const { return m_tg; }
+
+    /**
+     * @brief   Get the media type of the stream
+     * @return  Returns the media type to use in the Content-Type header
+     */
+    const char* mediaType(void) const;
+
+    /**
+     * @brief   Add a listener to the stream
+     * @param   con The HTTP connection to stream to
+     *
+     * The HTTP response header must have been sent before calling this
+     * function. The stream header is sent first and then the listener
+     * receive the live audio from the next page on.
+     */
+    void addListener(Async::HttpServerConnection *con);
+
+    /**
+     * @brief   Remove a listener from the stream
+     * @param   con The HTTP connection to remove
+     * @return  Returns \em true if the connection was a listener
+     */
+    bool removeListener(Async::HttpServerConnection *con);
+
+    /**
+     * @brief   Get the number of listeners
+     * @return  Returns the number of listeners
+     */
+    size_t listenerCount(void) const { return m_listeners.size(); }
+
+    /**
+     * @brief   Get the number of times a listener have lost audio
+     * @return  Returns the number of times that pages have been skipped
+     */
+    unsigned long skipCount(void) const { return m_skip_cnt; }
+
+    /**
+     * @brief   Write an encoded audio frame from the talker
+     * @param   codec The codec that the frame is encoded with
+     * @param   buf   The encoded audio frame
+     * @param   size  The size of the frame
+     */
+    void writeEncodedSamples(const std::string& codec, const void *buf,
+                             int size);
+
+    /**
+     * @brief   Flush all buffered audio at the end of a talker stream
+     */
+    void flush(void);
+
+  private:
+    static const size_t MAX_BACKLOG_SIZE = 32768;
+
+    struct Listener
+    {
+      std::string       partial;
+      size_t            partial_pos;
+      unsigned long     next_page;
+      size_t            page_pos;
+      bool              write_failed;
+      sigc::connection  send_buf_con;
+    };
+    typedef std::map<Async::HttpServerConnection*, Listener> Listeners;
+
+    uint32_t                  m_tg;
+    std::string               m_codec;
+    Async::AudioDecoder*      m_dec;
+    Async::AudioContainer*    m_container;
+    std::deque<std::string>   m_pages;
+    unsigned long             m_first_page;
+    size_t                    m_backlog_size;
+    Listeners                 m_listeners;
+    unsigned long             m_skip_cnt;
+
+    TGAudioStream(const TGAudioStream&);
+    TGAudioStream& operator=(const TGAudioStream&);
+    void onWriteBlock(const char *buf, size_t len);
+    void onSendBufferFull(bool is_full, Async::HttpServerConnection *con);
+    void sendPending(Async::HttpServerConnection *con, Listener& l);
+    void trimBacklog(void);
+
+};  /* class TGAudioStream */
+
+
+#endif /* TGAUDIO_STREAM_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -84,6 +84,7 @@ using namespace std;
  *
  ****************************************************************************/
 
+static void startTimer(Async::Timer& timer, int timeout_ms);
 
 
 /****************************************************************************
@@ -109,20 +110,16 @@ using namespace std;
  ****************************************************************************/
 
 TGHandler::TGHandler(void)
-  : m_cfg(0), m_timeout_timer(1000, Async::Timer::TYPE_PERIODIC),
-    m_sql_timeout(0), m_sql_timeout_blocktime(60)
+  : m_cfg(0), m_sql_timeout(0), m_sql_timeout_blocktime(60)
 {
-  m_timeout_timer.expired.connect(
-      mem_fun(*this, &TGHandler::checkTimers));
 } /* TGHandler::TGHandler */
 
 
 TGHandler::~TGHandler(void)
 {
-  for (IdMap::iterator it = m_id_map.begin(); it != m_id_map.end(); ++it)
+  for (TGTable::iterator it = m_tgs.begin(); it != m_tgs.end(); ++it)
   {
-    TGInfo* tg_info = it->second;
-    delete tg_info;
+    delete *it;
   }
 } /* TGHandler::~TGHandler */
 
@@ -135,11 +132,9 @@ void TGHandler::setSqlTimeoutBlocktime(unsigned sql_timeout_blocktime)
 
 void TGHandler::switchTo(ReflectorClient *client, uint32_t tg)
 {
-  TGInfo *tg_info = 0;
-  ClientMap::iterator client_map_it = m_client_map.find(client);
-  if (client_map_it != m_client_map.end())
+  if (client->m_tgh_slot != NO_SLOT)
   {
-    tg_info = client_map_it->second;
+    TGInfo *tg_info = m_tgs[client->m_tgh_slot];
     assert(tg_info != 0);
     if (tg_info->id == tg)
     {
@@ -150,14 +145,20 @@ void TGHandler::switchTo(ReflectorClient *client, uint32_t tg)
 
   if (tg > 0)
   {
-    IdMap::iterator id_map_it = m_id_map.find(tg);
-    if (id_map_it != m_id_map.end())
-    {
-      tg_info = id_map_it->second;
-    }
-    else
+    TGInfo *tg_info = findTG(tg);
+    if (tg_info == 0)
     {
-      tg_info = new TGInfo(tg);
+      unsigned slot = m_tgs.size();
+      if (!m_free_slots.empty())
+      {
+        slot = m_free_slots.back();
+        m_free_slots.pop_back();
+      }
+      tg_info = new TGInfo(tg, slot);
+      tg_info->talker_timer.expired.connect(sigc::hide(sigc::bind(
+          mem_fun(*this, &TGHandler::talkerTimerExpired), tg_info)));
+      tg_info->sql_timer.expired.connect(sigc::hide(sigc::bind(
+          mem_fun(*this, &TGHandler::sqlTimerExpired), tg_info)));
       std::ostringstream ss;
       ss << "TG#" << tg;
       tg_info->auto_qsy_after_s = 0;
@@ -166,10 +167,19 @@ void TGHandler::switchTo(ReflectorClient *client, uint32_t tg)
       {
         tg_info->auto_qsy_time = time(NULL) + tg_info->auto_qsy_after_s;
       }
-      m_id_map[tg] = tg_info;
+      if (slot == m_tgs.size())
+      {
+        m_tgs.push_back(tg_info);
+      }
+      else
+      {
+        m_tgs[slot] = tg_info;
+      }
+      m_id_map[tg] = slot;
     }
     tg_info->clients.insert(client);
-    m_client_map[client] = tg_info;
+    client->m_tgh_slot = tg_info->slot;
+    client->m_tgh_tg = tg;
   }
 
   //printTGStatus();
@@ -178,13 +188,19 @@ void TGHandler::switchTo(ReflectorClient *client, uint32_t tg)
 
 void TGHandler::removeClient(ReflectorClient* client)
 {
-  ClientMap::iterator client_map_it = m_client_map.find(client);
-  if (client_map_it != m_client_map.end())
+  const ReflectorClient::TGList& monitored_tgs = client->monitoredTGs();
+  for (ReflectorClient::TGList::const_iterator it = monitored_tgs.begin();
+       it != monitored_tgs.end(); ++it)
   {
-    TGInfo* tg_info = client_map_it->second;
+    removeMonitorP(client, *it);
+  }
+
+  if (client->m_tgh_slot != NO_SLOT)
+  {
+    TGInfo* tg_info = m_tgs[client->m_tgh_slot];
     if (tg_info->talker == client)
     {
-      setTalkerForTG(tg_info->id, 0);
+      setTalkerP(tg_info, 0);
     }
     removeClientP(tg_info, client);
     //printTGStatus();
@@ -195,64 +211,119 @@ void TGHandler::removeClient(ReflectorClient* client)
 const TGHandler::ClientSet& TGHandler::clientsForTG(uint32_t tg) const
 {
   static const TGHandler::ClientSet empty_set;
-  IdMap::const_iterator id_map_it = m_id_map.find(tg);
-  if (id_map_it == m_id_map.end())
+  const TGInfo *tg_info = findTG(tg);
+  if (tg_info == 0)
   {
     return empty_set;
   }
-  return id_map_it->second->clients;
+  return tg_info->clients;
 } /* TGHandler::clientsForTG */
 
 
-void TGHandler::setTalkerForTG(uint32_t tg, ReflectorClient* new_talker)
+const TGHandler::ClientSet& TGHandler::clientsForTG(
+    const ReflectorClient* client) const
 {
-  IdMap::const_iterator id_map_it = m_id_map.find(tg);
-  if (id_map_it == m_id_map.end())
+  static const TGHandler::ClientSet empty_set;
+  if (client->m_tgh_slot == NO_SLOT)
   {
-    return;
+    return empty_set;
   }
-  TGInfo* tg_info = id_map_it->second;
-  ReflectorClient* old_talker = tg_info->talker;
-  if (new_talker == old_talker)
+  return m_tgs[client->m_tgh_slot]->clients;
+} /* TGHandler::clientsForTG */
+
+
+void TGHandler::setMonitoredTGs(ReflectorClient* client,
+                                const std::set<uint32_t>& tgs)
+{
+  const ReflectorClient::TGList& old_tgs = client->monitoredTGs();
+  for (ReflectorClient::TGList::const_iterator it = old_tgs.begin();
+       it != old_tgs.end(); ++it)
   {
-    gettimeofday(&tg_info->last_talker_timestamp, NULL);
-    return;
+    if (tgs.count(*it) == 0)
+    {
+      removeMonitorP(client, *it);
+    }
+  }
+  for (std::set<uint32_t>::const_iterator it = tgs.begin();
+       it != tgs.end(); ++it)
+  {
+    m_monitor_map[*it].insert(client);
   }
-  tg_info->sql_timeout_cnt = (new_talker != 0) ? m_sql_timeout : 0;
-  id_map_it->second->talker = new_talker;
-  talkerUpdated(tg, old_talker, new_talker);
+} /* TGHandler::setMonitoredTGs */
 
-  time_t now = time(NULL);
-  if ((new_talker == 0) && (tg_info->auto_qsy_time > 0) &&
-      (now > tg_info->auto_qsy_time))
+
+const TGHandler::ClientSet& TGHandler::monitorsForTG(uint32_t tg) const
+{
+  static const TGHandler::ClientSet empty_set;
+  MonitorMap::const_iterator it = m_monitor_map.find(tg);
+  if (it == m_monitor_map.end())
   {
-    requestAutoQsy(tg_info->id);
-    tg_info->auto_qsy_time = now + tg_info->auto_qsy_after_s;
+    return empty_set;
   }
-  //printTGStatus();
+  return it->second;
+} /* TGHandler::monitorsForTG */
+
+
+void TGHandler::activeTGs(std::set<uint32_t>& tgs) const
+{
+  tgs.clear();
+  for (IdMap::const_iterator it = m_id_map.begin(); it != m_id_map.end(); ++it)
+  {
+    tgs.insert(tgs.end(), it->first);
+  }
+  for (MonitorMap::const_iterator it = m_monitor_map.begin();
+       it != m_monitor_map.end(); ++it)
+  {
+    tgs.insert(it->first);
+  }
+} /* TGHandler::activeTGs */
+
+
+void TGHandler::setTalkerForTG(uint32_t tg, ReflectorClient* new_talker)
+{
+  TGInfo* tg_info = findTG(tg);
+  if (tg_info == 0)
+  {
+    return;
+  }
+  setTalkerP(tg_info, new_talker);
 } /* TGHandler::setTalkerForTG */
 
 
 ReflectorClient* TGHandler::talkerForTG(uint32_t tg) const
 {
-  IdMap::const_iterator id_map_it = m_id_map.find(tg);
-  if (id_map_it == m_id_map.end())
+  const TGInfo* tg_info = findTG(tg);
+  if (tg_info == 0)
   {
     return 0;
   }
-  return id_map_it->second->talker;
+  return tg_info->talker;
 } /* TGHandler::talkerForTG */
 
 
-uint32_t TGHandler::TGForClient(ReflectorClient* client)
+bool TGHandler::talkerAudio(ReflectorClient* client)
 {
-  ClientMap::iterator client_map_it = m_client_map.find(client);
-  if (client_map_it == m_client_map.end())
+  if (client->m_tgh_slot == NO_SLOT)
   {
-    return 0;
+    return false;
+  }
+  TGInfo* tg_info = m_tgs[client->m_tgh_slot];
+  if (tg_info->talker == 0)
+  {
+    setTalkerP(tg_info, client);
+      // The talkerUpdated signal may have changed the talker
+    if (tg_info->talker != client)
+    {
+      return false;
+    }
   }
-  return client_map_it->second->id;
-} /* TGHandler::TGForClient */
+  else if (tg_info->talker != client)
+  {
+    return false;
+  }
+  gettimeofday(&tg_info->last_talker_timestamp, NULL);
+  return true;
+} /* TGHandler::talkerAudio */
 
 
 /****************************************************************************
@@ -269,43 +340,84 @@ uint32_t TGHandler::TGForClient(ReflectorClient* client)
  *
  ****************************************************************************/
 
-void TGHandler::checkTimers(Async::Timer *t)
+TGHandler::TGInfo* TGHandler::findTG(uint32_t tg) const
 {
-  for (IdMap::iterator it = m_id_map.begin(); it != m_id_map.end(); ++it)
+  IdMap::const_iterator it = m_id_map.find(tg);
+  if (it == m_id_map.end())
   {
-    struct timeval now;
-    gettimeofday(&now, NULL);
+    return 0;
+  }
+  return m_tgs[it->second];
+} /* TGHandler::findTG */
 
-    TGInfo *tg_info = it->second;
-    assert(tg_info != 0);
-    if (tg_info->talker != 0)
-    {
-      struct timeval diff;
-      timersub(&now, &tg_info->last_talker_timestamp, &diff);
-      if (diff.tv_sec > TALKER_AUDIO_TIMEOUT)
-      {
-        cout << tg_info->talker->callsign() << ": Talker audio timeout on TG #"
-             << tg_info->id << endl;
-        setTalkerForTG(tg_info->id, 0);
-      }
 
-      if ((tg_info->sql_timeout_cnt > 0) && (--tg_info->sql_timeout_cnt == 0))
-      {
-        cout << tg_info->talker->callsign() << ": Talker audio timeout on TG #"
-             << tg_info->id << endl;
-        tg_info->talker->setBlock(m_sql_timeout_blocktime);
-        setTalkerForTG(tg_info->id, 0);
-      }
+void TGHandler::setTalkerP(TGInfo *tg_info, ReflectorClient* new_talker)
+{
+  ReflectorClient* old_talker = tg_info->talker;
+  if (new_talker == old_talker)
+  {
+    gettimeofday(&tg_info->last_talker_timestamp, NULL);
+    return;
+  }
+  tg_info->talker = new_talker;
+  if (new_talker != 0)
+  {
+    gettimeofday(&tg_info->last_talker_timestamp, NULL);
+    startTimer(tg_info->talker_timer, TALKER_AUDIO_TIMEOUT_MS);
+    if (m_sql_timeout > 0)
+    {
+      startTimer(tg_info->sql_timer, 1000 * m_sql_timeout);
     }
+  }
+  else
+  {
+    tg_info->talker_timer.setEnable(false);
+    tg_info->sql_timer.setEnable(false);
+  }
+  talkerUpdated(tg_info->id, old_talker, new_talker);
+
+  time_t now = time(NULL);
+  if ((new_talker == 0) && (tg_info->auto_qsy_time > 0) &&
+      (now > tg_info->auto_qsy_time))
+  {
+    requestAutoQsy(tg_info->id);
+    tg_info->auto_qsy_time = now + tg_info->auto_qsy_after_s;
+  }
+  //printTGStatus();
+} /* TGHandler::setTalkerP */
+
 
-    //if ((tg_info->auto_qsy_time > 0) &&
-    //    (now.tv_sec > tg_info->auto_qsy_time))
-    //{
-    //  requestAutoQsy(tg_info->id);
-    //  tg_info->auto_qsy_time = time(NULL) + tg_info->auto_qsy_after_s;
-    //}
+void TGHandler::talkerTimerExpired(TGInfo *tg_info)
+{
+  assert(tg_info->talker != 0);
+
+    // The timer is not restarted for each audio packet. Check how long it
+    // was since the last one and wait for the remaining time if needed.
+  struct timeval now, diff;
+  gettimeofday(&now, NULL);
+  timersub(&now, &tg_info->last_talker_timestamp, &diff);
+  int remaining = TALKER_AUDIO_TIMEOUT_MS -
+                  (diff.tv_sec * 1000 + diff.tv_usec / 1000);
+  if (remaining > 0)
+  {
+    startTimer(tg_info->talker_timer, remaining);
+    return;
   }
-} /* TGHandler::checkTimers */
+
+  cout << tg_info->talker->callsign() << ": Talker audio timeout on TG #"
+       << tg_info->id << endl;
+  setTalkerP(tg_info, 0);
+} /* TGHandler::talkerTimerExpired */
+
+
+void TGHandler::sqlTimerExpired(TGInfo *tg_info)
+{
+  assert(tg_info->talker != 0);
+  cout << tg_info->talker->callsign() << ": Talker audio timeout on TG #"
+       << tg_info->id << endl;
+  tg_info->talker->setBlock(m_sql_timeout_blocktime);
+  setTalkerP(tg_info, 0);
+} /* TGHandler::sqlTimerExpired */
 
 
 void TGHandler::removeClientP(TGInfo *tg_info, ReflectorClient* client)
@@ -315,24 +427,44 @@ void TGHandler::removeClientP(TGInfo *tg_info, ReflectorClient* client)
   if (client == tg_info->talker)
   {
     tg_info->talker = 0;
+    tg_info->talker_timer.setEnable(false);
+    tg_info->sql_timer.setEnable(false);
   }
   tg_info->clients.erase(client);
-  m_client_map.erase(client);
+  client->m_tgh_slot = NO_SLOT;
+  client->m_tgh_tg = 0;
   if (tg_info->clients.empty())
   {
     m_id_map.erase(tg_info->id);
+    m_tgs[tg_info->slot] = 0;
+    m_free_slots.push_back(tg_info->slot);
     delete tg_info;
   }
 } /* TGHandler::removeClientP */
 
 
+void TGHandler::removeMonitorP(ReflectorClient* client, uint32_t tg)
+{
+  MonitorMap::iterator it = m_monitor_map.find(tg);
+  if (it == m_monitor_map.end())
+  {
+    return;
+  }
+  it->second.erase(client);
+  if (it->second.empty())
+  {
+    m_monitor_map.erase(it);
+  }
+} /* TGHandler::removeMonitorP */
+
+
 void TGHandler::printTGStatus(void)
 {
   std::cout << "### ----------- BEGIN ----------------" << std::endl;
   for (IdMap::const_iterator it = m_id_map.begin();
        it != m_id_map.end(); ++it)
   {
-    TGInfo *tg_info = it->second;
+    TGInfo *tg_info = m_tgs[it->second];
     std::cout << "### " << tg_info->id << ": ";
     for (ClientSet::const_iterator it = tg_info->clients.begin();
          it != tg_info->clients.end(); ++it)
@@ -350,6 +482,16 @@ void TGHandler::printTGStatus(void)
 } /* TGHandler::printTGStatus */
 
 
+static void startTimer(Async::Timer& timer, int timeout_ms)
+{
+    // A one shot timer is still enabled after it has expired so it must be
+    // disabled before it can be started again
+  timer.setEnable(false);
+  timer.setTimeout(timeout_ms);
+  timer.setEnable(true);
+} /* startTimer */
+
+
 /*
  * This file has not been truncated
  */
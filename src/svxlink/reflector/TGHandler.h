@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <map>
 #include <set>
+#include <vector>
 #include <sigc++/sigc++.h>
 #include <sys/time.h>
 
@@ -47,6 +48,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncConfig.h>
+#include <AsyncTimer.h>
 
 
 /****************************************************************************
@@ -113,6 +115,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 This class is responsible for keeping track of all talk groups that are used in
 the system.
+
+The active talk groups are kept in a dense table. Each client store the table
+slot and the id of its talk group so that the functions used when routing
+audio packets do not have to do any map lookups. The talker timeouts are
+handled by timers that are only running while a talk group has a talker.
 */
 class TGHandler : public sigc::trackable
 {
@@ -152,51 +159,124 @@ class TGHandler : public sigc::trackable
 
     const ClientSet& clientsForTG(uint32_t tg) const;
 
+    /**
+     * @brief   Get the members of the talk group that a client is on
+     * @param   client The client
+     * @return  Returns the set of clients on the same talk group
+     */
+    const ClientSet& clientsForTG(const ReflectorClient* client) const;
+
+    /**
+     * @brief   Set which talk groups that a client is monitoring
+     * @param   client The client
+     * @param   tgs The new set of monitored talk groups
+     *
+     * This function must be called before the monitored talk groups are
+     * updated in the client object so that the old ones can be removed from
+     * the subscriber index.
+     */
+    void setMonitoredTGs(ReflectorClient* client,
+                         const std::set<uint32_t>& tgs);
+
+    /**
+     * @brief   Get the clients that are monitoring a talk group
+     * @param   tg The talk group
+     * @return  Returns the set of clients that monitor the given talk group
+     */
+    const ClientSet& monitorsForTG(uint32_t tg) const;
+
+    /**
+     * @brief   Get all talk groups that have members or monitors
+     * @param   tgs The set to return the talk groups in
+     */
+    void activeTGs(std::set<uint32_t>& tgs) const;
+
     void setTalkerForTG(uint32_t tg, ReflectorClient* client);
 
     ReflectorClient* talkerForTG(uint32_t tg) const;
 
-    uint32_t TGForClient(ReflectorClient* client);
+    uint32_t TGForClient(const ReflectorClient* client) const
+    {
+      return client->m_tgh_tg;
+    }
+
+    /**
+     * @brief   Check if a client is the talker on its talk group
+     * @param   client The client
+     * @return  Returns \em true if the client is the current talker
+     */
+    bool isTalker(const ReflectorClient* client) const
+    {
+      return (client->m_tgh_slot != NO_SLOT) &&
+             (m_tgs[client->m_tgh_slot]->talker == client);
+    }
+
+    /**
+     * @brief   Register audio received from a client
+     * @param   client The client that sent the audio
+     * @return  Returns \em true if the client is the talker
+     *
+     * This function is called for each received audio packet. If the talk
+     * group that the client is on have no talker, the client become the
+     * talker. If the client is the talker, the audio timeout is restarted.
+     */
+    bool talkerAudio(ReflectorClient* client);
 
     sigc::signal<void, uint32_t,
       ReflectorClient*, ReflectorClient*> talkerUpdated;
 
     sigc::signal<void, uint32_t> requestAutoQsy;
 
+    /**
+     * @brief   The slot number used for clients not on any talk group
+     */
+    static const unsigned NO_SLOT = ~0U;
+
   private:
-    static const time_t TALKER_AUDIO_TIMEOUT = 3; // Max three seconds gap
+    static const int TALKER_AUDIO_TIMEOUT_MS = 4000; // Max three seconds gap
 
     struct TGInfo
     {
       uint32_t          id;
+      unsigned          slot;
       ClientSet         clients;
       ReflectorClient*  talker;
       struct timeval    last_talker_timestamp;
-      unsigned          sql_timeout_cnt;
+      Async::Timer      talker_timer;
+      Async::Timer      sql_timer;
       time_t            auto_qsy_after_s;
       time_t            auto_qsy_time;
 
-      TGInfo(uint32_t tg)
-        : id(tg), talker(0), sql_timeout_cnt(0), auto_qsy_after_s(0),
-          auto_qsy_time(-1)
+      TGInfo(uint32_t tg, unsigned slot)
+        : id(tg), slot(slot), talker(0),
+          talker_timer(TALKER_AUDIO_TIMEOUT_MS, Async::Timer::TYPE_ONESHOT,
+                       false),
+          sql_timer(0, Async::Timer::TYPE_ONESHOT, false),
+          auto_qsy_after_s(0), auto_qsy_time(-1)
       {
         timerclear(&last_talker_timestamp);
       }
     };
-    typedef std::map<uint32_t, TGInfo*>               IdMap;
-    typedef std::map<const ReflectorClient*, TGInfo*> ClientMap;
+    typedef std::map<uint32_t, unsigned>              IdMap;
+    typedef std::vector<TGInfo*>                      TGTable;
+    typedef std::map<uint32_t, ClientSet>             MonitorMap;
 
     const Async::Config*  m_cfg;
+    TGTable               m_tgs;
+    std::vector<unsigned> m_free_slots;
     IdMap                 m_id_map;
-    ClientMap             m_client_map;
-    Async::Timer          m_timeout_timer;
+    MonitorMap            m_monitor_map;
     unsigned              m_sql_timeout;
     unsigned              m_sql_timeout_blocktime;
 
     TGHandler(const TGHandler&);
     TGHandler& operator=(const TGHandler&);
-    void checkTimers(Async::Timer *t);
+    TGInfo* findTG(uint32_t tg) const;
+    void setTalkerP(TGInfo *tg_info, ReflectorClient* new_talker);
+    void talkerTimerExpired(TGInfo *tg_info);
+    void sqlTimerExpired(TGInfo *tg_info);
     void removeClientP(TGInfo *tg_info, ReflectorClient* client);
+    void removeMonitorP(ReflectorClient* client, uint32_t tg);
     void printTGStatus(void);
 };  /* class TGHandler */
 
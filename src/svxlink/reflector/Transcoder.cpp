@@ -0,0 +1,242 @@
+/**
+@file   Transcoder.cpp
+@brief  Transcode the audio stream of a talker to other codecs
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+#include <iostream>
+#include <cassert>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioDecoder.h>
+#include <AsyncAudioEncoder.h>
+#include <AsyncAudioSplitter.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "Transcoder.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+Transcoder::Transcoder(uint32_t tg, const std::string& src_codec)
+  : m_tg(tg), m_src_codec(src_codec), m_dec(0), m_splitter(0), m_cpu_ns(0),
+    m_emit_ns(0)
+{
+  m_dec = AudioDecoder::create(src_codec);
+  if (m_dec == 0)
+  {
+    cerr << "*** ERROR: Failed to create " << src_codec
+         << " audio decoder for transcoding on TG #" << tg << endl;
+    return;
+  }
+  m_splitter = new AudioSplitter;
+  m_dec->registerSink(m_splitter, true);
+} /* Transcoder::Transcoder */
+
+
+Transcoder::~Transcoder(void)
+{
+  delete m_dec;
+  m_dec = 0;
+  m_splitter = 0;
+  for (Encoders::iterator it=m_encoders.begin(); it!=m_encoders.end(); ++it)
+  {
+    delete (*it).second;
+  }
+  m_encoders.clear();
+} /* Transcoder::~Transcoder */
+
+
+bool Transcoder::addTarget(const std::string& codec, const Options& opts)
+{
+  if (!initOk())
+  {
+    return false;
+  }
+  if (hasTarget(codec))
+  {
+    return true;
+  }
+
+  AudioEncoder *enc = AudioEncoder::create(codec);
+  if (enc == 0)
+  {
+    cerr << "*** ERROR: Failed to create " << codec
+         << " audio encoder for transcoding on TG #" << m_tg << endl;
+    return false;
+  }
+  for (Options::const_iterator it=opts.begin(); it!=opts.end(); ++it)
+  {
+    enc->setOption((*it).first, (*it).second);
+  }
+  enc->writeEncodedSamples.connect(
+      sigc::bind(mem_fun(*this, &Transcoder::onEncodedAudio), codec));
+    // There is nothing to wait for when flushing so the flush is
+    // acknowledged directly
+  enc->flushEncodedSamples.connect(
+      mem_fun(*enc, &AudioEncoder::allEncodedSamplesFlushed));
+  m_splitter->addSink(enc);
+  m_encoders[codec] = enc;
+  cout << "TG #" << m_tg << ": Transcoding " << m_src_codec << " to "
+       << codec << endl;
+  return true;
+} /* Transcoder::addTarget */
+
+
+void Transcoder::writeEncodedSamples(void *buf, int size, bool frame_lost)
+{
+  assert(initOk());
+  uint64_t start = cpuTimeNow();
+  m_emit_ns = 0;
+  if (frame_lost)
+  {
+    m_dec->writeEncodedSamplesAfterLoss(buf, size);
+  }
+  else
+  {
+    m_dec->writeEncodedSamples(buf, size);
+  }
+    // The time spent sending the transcoded frames is not counted
+  m_cpu_ns += cpuTimeNow() - start - m_emit_ns;
+} /* Transcoder::writeEncodedSamples */
+
+
+void Transcoder::flush(void)
+{
+  if (initOk())
+  {
+    m_dec->flushEncodedSamples();
+  }
+} /* Transcoder::flush */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+uint64_t Transcoder::cpuTimeNow(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+} /* Transcoder::cpuTimeNow */
+
+
+void Transcoder::onEncodedAudio(const void *buf, int size, std::string codec)
+{
+  uint64_t start = cpuTimeNow();
+  encodedAudio(this, codec, buf, size);
+  m_emit_ns += cpuTimeNow() - start;
+} /* Transcoder::onEncodedAudio */
+
+
+
+/*
+ * This file has not been truncated
+ */
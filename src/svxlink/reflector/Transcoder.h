@@ -0,0 +1,214 @@
+/**
+@file   Transcoder.h
+@brief  Transcode the audio stream of a talker to other codecs
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef TRANSCODER_INCLUDED
+#define TRANSCODER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <stdint.h>
+#include <string>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class AudioDecoder;
+  class AudioEncoder;
+  class AudioSplitter;
+};
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Transcode the audio stream of a talker to other codecs
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+The reflector use one transcoder for each talk group where the talker use
+another codec than some of the listeners. The incoming audio is decoded once
+and then encoded once for each target codec, no matter how many listeners
+there are. The encoded frames are emitted through the encodedAudio signal so
+that the reflector can fan them out to all clients using that codec.
+*/
+class Transcoder : public sigc::trackable
+{
+  public:
+    typedef std::map<std::string, std::string> Options;
+
+    /**
+     * @brief   Constructor
+     * @param   tg        The talk group that this transcoder serve
+     * @param   src_codec The codec used by the talker
+     */
+    Transcoder(uint32_t tg, const std::string& src_codec);
+
+    /**
+     * @brief   Destructor
+     */
+    ~Transcoder(void);
+
+    /**
+     * @brief   Check if the transcoder was successfully initialized
+     * @return  Returns \em true if the source codec decoder could be created
+     */
+    bool initOk(void) const { return m_dec != 0; }
+
+    /**
+     * @brief   Get the talk group this transcoder serve
+     * @return  Returns the talk group number
+     */
+    uint32_t tg(void) const { return m_tg; }
+
+    /**
+     * @brief   Get the codec used by the talker
+     * @return  Returns the name of the source codec
+     */
+    const std::string& srcCodec(void) const { return m_src_codec; }
+
+    /**
+     * @brief   Make sure that there is an encoder for the given codec
+     * @param   codec The name of the target codec
+     * @param   opts  Encoder options to use if a new encoder is created
+     * @return  Returns \em true on success or else \em false
+     */
+    bool addTarget(const std::string& codec, const Options& opts);
+
+    /**
+     * @brief   Check if there is an encoder for the given codec
+     * @param   codec The name of the target codec
+     * @return  Returns \em true if the codec is a target of this transcoder
+     */
+    bool hasTarget(const std::string& codec) const
+    {
+      return m_encoders.find(codec) != m_encoders.end();
+    }
+
+    /**
+     * @brief   Write an encoded audio frame from the talker
+     * @param   buf         The encoded audio frame
+     * @param   size        The size of the frame
+     * @param   frame_lost  Set to \em true if the previous frame was lost
+     */
+    void writeEncodedSamples(void *buf, int size, bool frame_lost=false);
+
+    /**
+     * @brief   Flush all buffered audio at the end of a talker stream
+     */
+    void flush(void);
+
+    /**
+     * @brief   Get the CPU time used for transcoding
+     * @return  Returns the CPU time, in nanoseconds, spent decoding and
+     *          encoding audio, not counting the sending of the frames
+     */
+    uint64_t cpuTimeNs(void) const { return m_cpu_ns; }
+
+    /**
+     * @brief   A signal emitted when an encoded frame is available
+     * @param   transcoder  This object
+     * @param   codec       The name of the codec that the frame is encoded with
+     * @param   buf         The encoded frame
+     * @param   size        The size of the frame
+     */
+    sigc::signal<void, Transcoder*, const std::string&,
+                 const void*, int> encodedAudio;
+
+  private:
+    typedef std::map<std::string, Async::AudioEncoder*> Encoders;
+
+    uint32_t              m_tg;
+    std::string           m_src_codec;
+    Async::AudioDecoder*  m_dec;
+    Async::AudioSplitter* m_splitter;
+    Encoders              m_encoders;
+    uint64_t              m_cpu_ns;
+    uint64_t              m_emit_ns;
+
+    Transcoder(const Transcoder&);
+    Transcoder& operator=(const Transcoder&);
+    static uint64_t cpuTimeNow(void);
+    void onEncodedAudio(const void *buf, int size, std::string codec);
+
+};  /* class Transcoder */
+
+
+#endif /* TRANSCODER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,421 @@
+/**
+@file   UdpFanoutWorker.cpp
+@brief  A worker thread used to send UDP audio to clients
+@author Tobias Blomberg / SM0SVX
+@date   2020-05-15
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <poll.h>
+#include <time.h>
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncThreadScheduling.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "UdpFanoutWorker.h"
+#include "ReflectorMsg.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+UdpFanoutWorker::UdpFanoutWorker(int sock)
+  : m_sock(sock), m_thread_started(false), m_quit(false), m_dropped_cnt(0),
+    m_retried_cnt(0), m_pace_interval_us(0), m_pace_chunk_size(0),
+    m_ring(0)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+  pthread_cond_init(&m_cond, NULL);
+} /* UdpFanoutWorker::UdpFanoutWorker */
+
+
+UdpFanoutWorker::~UdpFanoutWorker(void)
+{
+  if (m_thread_started)
+  {
+    pthread_mutex_lock(&m_mutex);
+    m_quit = true;
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+    int ret = pthread_join(m_thread, NULL);
+    if (ret != 0)
+    {
+      cerr << "*** WARNING: pthread_join: " << strerror(ret) << endl;
+    }
+  }
+
+  for (JobQueue::iterator it = m_queue.begin(); it != m_queue.end(); ++it)
+  {
+    delete *it;
+  }
+  for (std::vector<Job*>::iterator it = m_free_jobs.begin();
+       it != m_free_jobs.end(); ++it)
+  {
+    delete *it;
+  }
+  delete m_ring;
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutex);
+} /* UdpFanoutWorker::~UdpFanoutWorker */
+
+
+bool UdpFanoutWorker::start(void)
+{
+  assert(!m_thread_started);
+  int ret = pthread_create(&m_thread, NULL, threadFunc, this);
+  if (ret != 0)
+  {
+    cerr << "*** ERROR: pthread_create: " << strerror(ret) << endl;
+    return false;
+  }
+  m_thread_started = true;
+  return true;
+} /* UdpFanoutWorker::start */
+
+
+void UdpFanoutWorker::setPacing(unsigned interval_us, size_t chunk_size)
+{
+  assert(!m_thread_started);
+  m_pace_interval_us = interval_us;
+  m_pace_chunk_size = std::max(chunk_size, static_cast<size_t>(1));
+} /* UdpFanoutWorker::setPacing */
+
+
+bool UdpFanoutWorker::enableSendRing(std::string& errmsg)
+{
+  assert(!m_thread_started);
+  if (m_ring != 0)
+  {
+    return true;
+  }
+  UdpSendRing *ring = new UdpSendRing;
+  if (!ring->init(m_sock, SEND_RING_ENTRIES, errmsg))
+  {
+    delete ring;
+    return false;
+  }
+  m_ring = ring;
+  return true;
+} /* UdpFanoutWorker::enableSendRing */
+
+
+void UdpFanoutWorker::send(const char *packed, size_t len, const Dest *dests,
+                           size_t cnt)
+{
+  if (cnt == 0)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&m_mutex);
+  if (m_queue.size() >= MAX_QUEUED_JOBS)
+  {
+    m_dropped_cnt += cnt;
+    pthread_mutex_unlock(&m_mutex);
+    return;
+  }
+  Job *job = 0;
+  if (!m_free_jobs.empty())
+  {
+    job = m_free_jobs.back();
+    m_free_jobs.pop_back();
+  }
+  else
+  {
+    job = new Job;
+  }
+  job->packed.assign(packed, packed + len);
+  job->dests.assign(dests, dests + cnt);
+  m_queue.push_back(job);
+  pthread_cond_signal(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+} /* UdpFanoutWorker::send */
+
+
+unsigned long UdpFanoutWorker::droppedCnt(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  unsigned long dropped_cnt = m_dropped_cnt;
+  pthread_mutex_unlock(&m_mutex);
+  return dropped_cnt;
+} /* UdpFanoutWorker::droppedCnt */
+
+
+unsigned long UdpFanoutWorker::retriedCnt(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  unsigned long retried_cnt = m_retried_cnt;
+  pthread_mutex_unlock(&m_mutex);
+  return retried_cnt;
+} /* UdpFanoutWorker::retriedCnt */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void *UdpFanoutWorker::threadFunc(void *arg)
+{
+  Async::ThreadScheduling::applyToCurrentThread(
+      Async::ThreadScheduling::ROLE_NET_IO);
+  UdpFanoutWorker *worker = reinterpret_cast<UdpFanoutWorker *>(arg);
+  worker->run();
+  return NULL;
+} /* UdpFanoutWorker::threadFunc */
+
+
+void UdpFanoutWorker::run(void)
+{
+  pthread_mutex_lock(&m_mutex);
+  for (;;)
+  {
+    while (m_queue.empty() && !m_quit)
+    {
+      pthread_cond_wait(&m_cond, &m_mutex);
+    }
+    if (m_quit)
+    {
+      break;
+    }
+    Job *job = m_queue.front();
+    m_queue.pop_front();
+    pthread_mutex_unlock(&m_mutex);
+
+    size_t dropped_cnt = job->dests.size() - sendJob(job);
+
+    pthread_mutex_lock(&m_mutex);
+    m_dropped_cnt += dropped_cnt;
+    m_free_jobs.push_back(job);
+  }
+  pthread_mutex_unlock(&m_mutex);
+} /* UdpFanoutWorker::run */
+
+
+size_t UdpFanoutWorker::sendJob(const Job *job)
+{
+  assert(job->packed.size() >= ReflectorUdpMsg::HEADER_SIZE);
+  const size_t cnt = job->dests.size();
+  m_hdrs.resize(cnt * ReflectorUdpMsg::HEADER_SIZE);
+  m_iov.resize(2 * cnt);
+  m_dgrams.resize(cnt);
+  for (size_t i=0; i<cnt; ++i)
+  {
+    const Dest& dest = job->dests[i];
+    char *hdr = &m_hdrs[i * ReflectorUdpMsg::HEADER_SIZE];
+    memcpy(hdr, &job->packed[0], ReflectorUdpMsg::HEADER_SIZE);
+    ReflectorUdpMsg::setPackedHeader(hdr, dest.client_id, dest.seq);
+
+    struct iovec *iov = &m_iov[2 * i];
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = ReflectorUdpMsg::HEADER_SIZE;
+    iov[1].iov_base = const_cast<char*>(&job->packed[0]) +
+                      ReflectorUdpMsg::HEADER_SIZE;
+    iov[1].iov_len = job->packed.size() - ReflectorUdpMsg::HEADER_SIZE;
+
+    Async::UdpSocket::Datagram& dgram = m_dgrams[i];
+    dgram.ip = dest.ip;
+    dgram.port = dest.port;
+    dgram.iov = iov;
+    dgram.iovcnt = 2;
+  }
+
+  if ((m_pace_interval_us == 0) || (cnt <= m_pace_chunk_size))
+  {
+    return sendDatagrams(&m_dgrams[0], cnt);
+  }
+
+    // Send the chunks evenly spread over the pacing interval
+  const size_t chunk_cnt = (cnt + m_pace_chunk_size - 1) / m_pace_chunk_size;
+  const unsigned delay_us = m_pace_interval_us / chunk_cnt;
+  size_t sent_cnt = 0;
+  size_t pos = 0;
+  while (pos < cnt)
+  {
+    size_t len = std::min(m_pace_chunk_size, cnt - pos);
+    sent_cnt += sendDatagrams(&m_dgrams[pos], len);
+    pos += len;
+    if ((pos < cnt) && !paceWait(delay_us))
+    {
+      sent_cnt += sendDatagrams(&m_dgrams[pos], cnt - pos);
+      break;
+    }
+  }
+  return sent_cnt;
+} /* UdpFanoutWorker::sendJob */
+
+
+size_t UdpFanoutWorker::sendDatagrams(const Async::UdpSocket::Datagram *dgrams,
+                                      size_t cnt)
+{
+  size_t pos = 0;
+  size_t sent_cnt = 0;
+  unsigned long retried_cnt = 0;
+  unsigned retries = 0;
+  while (pos < cnt)
+  {
+    int ret = (m_ring != 0)
+      ? m_ring->send(&dgrams[pos], cnt - pos)
+      : Async::UdpSocket::sendDatagrams(m_sock, &dgrams[pos], cnt - pos);
+    pos += ret;
+    sent_cnt += ret;
+    if (ret > 0)
+    {
+      retries = 0;
+    }
+    if (pos < cnt)
+    {
+      if ((errno == EAGAIN) && (retries++ < MAX_SEND_RETRIES))
+      {
+          // Wait a while for the send buffer to drain and try again
+        struct pollfd pfd;
+        pfd.fd = m_sock;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, SEND_RETRY_TIMEOUT_MS) > 0)
+        {
+          ++retried_cnt;
+          continue;
+        }
+      }
+        // Skip the datagram that failed and continue with the rest
+      ++pos;
+    }
+  }
+  if (retried_cnt > 0)
+  {
+    pthread_mutex_lock(&m_mutex);
+    m_retried_cnt += retried_cnt;
+    pthread_mutex_unlock(&m_mutex);
+  }
+  return sent_cnt;
+} /* UdpFanoutWorker::sendDatagrams */
+
+
+bool UdpFanoutWorker::paceWait(unsigned delay_us)
+{
+  pthread_mutex_lock(&m_mutex);
+  bool next_job_waiting = !m_queue.empty() || m_quit;
+  pthread_mutex_unlock(&m_mutex);
+  if (next_job_waiting)
+  {
+    return false;
+  }
+  struct timespec ts;
+  ts.tv_sec = delay_us / 1000000;
+  ts.tv_nsec = 1000L * (delay_us % 1000000);
+  while ((nanosleep(&ts, &ts) == -1) && (errno == EINTR))
+  {
+  }
+  return true;
+} /* UdpFanoutWorker::paceWait */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,248 @@
+/**
+@file   UdpFanoutWorker.h
+@brief  A worker thread used to send UDP audio to clients
+@author Tobias Blomberg / SM0SVX
+@date   2020-05-15
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef UDP_FANOUT_WORKER_INCLUDED
+#define UDP_FANOUT_WORKER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include <string>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncIpAddress.h>
+#include <AsyncUdpSocket.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "UdpSendRing.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  A worker thread used to send UDP audio to clients
+@author Tobias Blomberg / SM0SVX
+@date   2020-05-15
+
+The reflector may be configured to use a number of these worker threads to
+offload the UDP fan-out from the main thread. The main thread still handle all
+protocol logic, like assigning sequence numbers, and just hand a packed message
+and a list of destinations to a worker. The worker patch the message header
+for each destination and send the datagrams on the shared UDP socket.
+
+All traffic to a specific client must always be sent through the same worker
+or else packets may be reordered. The reflector use the client ID to choose
+the worker.
+
+If the socket send buffer is full, the worker wait a short while for it to
+drain before giving up on a datagram. The fan-out of a message to many clients
+can also be paced, that is spread out over some time, so that the send buffer
+is not filled up by one burst.
+
+The datagrams are normally sent using sendmmsg(2). On Linux the worker can
+instead hand them to the kernel through an io_uring submission queue, see
+UdpSendRing, so that no system calls are needed in the worker thread.
+*/
+class UdpFanoutWorker
+{
+  public:
+    /**
+     * @brief   A destination for a message
+     */
+    struct Dest
+    {
+      Async::IpAddress  ip;         ///< The IP address of the client
+      uint16_t          port;       ///< The UDP port of the client
+      uint16_t          client_id;  ///< The client ID to put in the header
+      uint16_t          seq;        ///< The sequence number to put in header
+    };
+
+    /**
+     * @brief   Constructor
+     * @param   sock The UDP socket file descriptor to send on
+     */
+    explicit UdpFanoutWorker(int sock);
+
+    /**
+     * @brief   Destructor
+     *
+     * The worker thread is stopped. Messages not yet sent are discarded.
+     */
+    ~UdpFanoutWorker(void);
+
+    /**
+     * @brief   Start the worker thread
+     * @return  Returns \em true on success or else \em false
+     */
+    bool start(void);
+
+    /**
+     * @brief   Spread the fan-out of each message over some time
+     * @param   interval_us The time in microseconds to spread the sends over
+     * @param   chunk_size  The number of datagrams to send in one go
+     *
+     * When pacing is enabled, a message with more destinations than
+     * chunk_size is sent in chunks evenly spread over the given interval.
+     * Pacing stops as soon as the next message is queued so a message is
+     * never held back by the previous one. Set interval_us to zero to send
+     * all datagrams directly, which is the default. This function must be
+     * called before start.
+     */
+    void setPacing(unsigned interval_us, size_t chunk_size);
+
+    /**
+     * @brief   Send the datagrams through an io_uring submission queue
+     * @param   errmsg Set to a description of the error on failure
+     * @return  Returns \em true on success or \em false if not available
+     *
+     * If this function fail, the worker keep using sendmmsg. This function
+     * must be called before start.
+     */
+    bool enableSendRing(std::string& errmsg);
+
+    /**
+     * @brief   Queue a message for sending to a number of clients
+     * @param   packed  The packed message, including the header
+     * @param   len     The length of the packed message
+     * @param   dests   The destinations
+     * @param   cnt     The number of destinations
+     *
+     * The data is copied so the buffers can be reused as soon as this
+     * function returns. If the queue is full the message is dropped.
+     */
+    void send(const char *packed, size_t len, const Dest *dests, size_t cnt);
+
+    /**
+     * @brief   Get the number of datagrams that have been dropped
+     * @return  Returns the number of datagrams dropped by this worker
+     */
+    unsigned long droppedCnt(void);
+
+    /**
+     * @brief   Get the number of send retries
+     * @return  Returns the number of times the send buffer was full
+     *
+     * Each time the send buffer is full, the worker wait for the socket to
+     * become writable and then try again.
+     */
+    unsigned long retriedCnt(void);
+
+  private:
+    static const size_t   MAX_QUEUED_JOBS       = 256;
+    static const int      SEND_RETRY_TIMEOUT_MS = 5;
+    static const unsigned MAX_SEND_RETRIES      = 3;
+    static const unsigned SEND_RING_ENTRIES     = 256;
+
+    struct Job
+    {
+      std::vector<char> packed;
+      std::vector<Dest> dests;
+    };
+    typedef std::deque<Job*> JobQueue;
+
+    int                                     m_sock;
+    pthread_t                               m_thread;
+    bool                                    m_thread_started;
+    pthread_mutex_t                         m_mutex;
+    pthread_cond_t                          m_cond;
+    JobQueue                                m_queue;
+    std::vector<Job*>                       m_free_jobs;
+    bool                                    m_quit;
+    unsigned long                           m_dropped_cnt;
+    unsigned long                           m_retried_cnt;
+    unsigned                                m_pace_interval_us;
+    size_t                                  m_pace_chunk_size;
+    std::vector<char>                       m_hdrs;
+    std::vector<struct iovec>               m_iov;
+    std::vector<Async::UdpSocket::Datagram> m_dgrams;
+    UdpSendRing*                            m_ring;
+
+    UdpFanoutWorker(const UdpFanoutWorker&);
+    UdpFanoutWorker& operator=(const UdpFanoutWorker&);
+    static void *threadFunc(void *arg);
+    void run(void);
+    size_t sendJob(const Job *job);
+    size_t sendDatagrams(const Async::UdpSocket::Datagram *dgrams, size_t cnt);
+    bool paceWait(unsigned delay_us);
+
+};  /* class UdpFanoutWorker */
+
+
+#endif /* UDP_FANOUT_WORKER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
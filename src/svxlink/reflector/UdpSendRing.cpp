@@ -0,0 +1,408 @@
+/**
+@file   UdpSendRing.cpp
+@brief  Send UDP datagrams through an io_uring submission queue
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef HAS_IO_URING
+#include <linux/io_uring.h>
+#endif
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "UdpSendRing.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+#ifdef HAS_IO_URING
+namespace {
+  int io_uring_setup(unsigned entries, struct io_uring_params *p)
+  {
+    return syscall(__NR_io_uring_setup, entries, p);
+  }
+
+  int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                     unsigned flags)
+  {
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                   NULL, 0);
+  }
+
+  int io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+  {
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+  }
+
+  void *mapRing(int fd, size_t size, off_t offset)
+  {
+    void *addr = mmap(0, size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, offset);
+    return (addr == MAP_FAILED) ? 0 : addr;
+  }
+
+  unsigned *ringField(void *ring, unsigned offset)
+  {
+    return reinterpret_cast<unsigned*>(
+        reinterpret_cast<char*>(ring) + offset);
+  }
+};
+#endif
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+UdpSendRing::UdpSendRing(void)
+  : m_ring_fd(-1), m_sq_ring(0), m_sq_ring_size(0), m_cq_ring(0),
+    m_cq_ring_size(0), m_sqes(0), m_sqes_size(0), m_sq_tail(0),
+    m_sq_flags(0), m_sq_mask(0), m_sq_entries(0), m_cq_head(0), m_cq_tail(0),
+    m_cq_mask(0), m_cqes(0)
+{
+} /* UdpSendRing::UdpSendRing */
+
+
+UdpSendRing::~UdpSendRing(void)
+{
+  cleanup();
+} /* UdpSendRing::~UdpSendRing */
+
+
+bool UdpSendRing::init(int sock, unsigned entries, std::string& errmsg)
+{
+  cleanup();
+
+#ifdef HAS_IO_URING
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_SQPOLL;
+  p.sq_thread_idle = SQ_THREAD_IDLE_MS;
+  m_ring_fd = io_uring_setup(entries, &p);
+  if (m_ring_fd < 0)
+  {
+    errmsg = string("io_uring_setup: ") + strerror(errno);
+    m_ring_fd = -1;
+    return false;
+  }
+
+    // Sending messages was added in Linux 5.3 but there is no way to check
+    // for it before the probe was added in 5.6
+  const unsigned probe_size = sizeof(struct io_uring_probe) +
+                              256 * sizeof(struct io_uring_probe_op);
+  struct io_uring_probe *probe =
+    reinterpret_cast<struct io_uring_probe*>(calloc(1, probe_size));
+  bool sendmsg_ok =
+    (io_uring_register(m_ring_fd, IORING_REGISTER_PROBE, probe, 256) == 0) &&
+    (probe->last_op >= IORING_OP_SENDMSG) &&
+    ((probe->ops[IORING_OP_SENDMSG].flags & IO_URING_OP_SUPPORTED) != 0);
+  free(probe);
+  if (!sendmsg_ok)
+  {
+    errmsg = "The kernel does not support sending messages using io_uring";
+    cleanup();
+    return false;
+  }
+
+    // Before Linux 5.11 the polling thread could only use registered files
+  if (io_uring_register(m_ring_fd, IORING_REGISTER_FILES, &sock, 1) < 0)
+  {
+    errmsg = string("io_uring_register: ") + strerror(errno);
+    cleanup();
+    return false;
+  }
+
+  m_sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  m_cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  m_sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  m_sq_ring = mapRing(m_ring_fd, m_sq_ring_size, IORING_OFF_SQ_RING);
+  m_cq_ring = mapRing(m_ring_fd, m_cq_ring_size, IORING_OFF_CQ_RING);
+  m_sqes = mapRing(m_ring_fd, m_sqes_size, IORING_OFF_SQES);
+  if ((m_sq_ring == 0) || (m_cq_ring == 0) || (m_sqes == 0))
+  {
+    errmsg = string("mmap: ") + strerror(errno);
+    cleanup();
+    return false;
+  }
+
+  m_sq_tail = ringField(m_sq_ring, p.sq_off.tail);
+  m_sq_flags = ringField(m_sq_ring, p.sq_off.flags);
+  m_sq_mask = *ringField(m_sq_ring, p.sq_off.ring_mask);
+  m_sq_entries = p.sq_entries;
+  m_cq_head = ringField(m_cq_ring, p.cq_off.head);
+  m_cq_tail = ringField(m_cq_ring, p.cq_off.tail);
+  m_cq_mask = *ringField(m_cq_ring, p.cq_off.ring_mask);
+  m_cqes = reinterpret_cast<char*>(m_cq_ring) + p.cq_off.cqes;
+
+    // The submission queue entries are always used in ring order so the
+    // index array never has to be changed after this
+  unsigned *sq_array = ringField(m_sq_ring, p.sq_off.array);
+  for (unsigned i=0; i<m_sq_entries; ++i)
+  {
+    sq_array[i] = i;
+  }
+
+  m_msgs.resize(m_sq_entries);
+  m_addrs.resize(m_sq_entries);
+  m_results.resize(m_sq_entries);
+  return true;
+#else
+  errmsg = "Not compiled with io_uring support";
+  return false;
+#endif
+} /* UdpSendRing::init */
+
+
+int UdpSendRing::send(const Async::UdpSocket::Datagram *dgrams, int cnt)
+{
+#ifdef HAS_IO_URING
+  struct io_uring_sqe *sqes = reinterpret_cast<struct io_uring_sqe*>(m_sqes);
+  int sent_cnt = 0;
+  while (sent_cnt < cnt)
+  {
+    unsigned chunk_cnt = std::min(static_cast<unsigned>(cnt - sent_cnt),
+                                  m_sq_entries);
+    unsigned tail = *m_sq_tail;
+    for (unsigned i=0; i<chunk_cnt; ++i)
+    {
+      const Async::UdpSocket::Datagram& dgram = dgrams[sent_cnt + i];
+      sockaddr_in& addr = m_addrs[i];
+      memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(dgram.port);
+      addr.sin_addr = dgram.ip.ip4Addr();
+      struct msghdr& msg = m_msgs[i];
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_name = &addr;
+      msg.msg_namelen = sizeof(addr);
+      msg.msg_iov = const_cast<struct iovec *>(dgram.iov);
+      msg.msg_iovlen = dgram.iovcnt;
+
+      struct io_uring_sqe& sqe = sqes[(tail + i) & m_sq_mask];
+      memset(&sqe, 0, sizeof(sqe));
+      sqe.opcode = IORING_OP_SENDMSG;
+      sqe.flags = IOSQE_FIXED_FILE;
+      sqe.fd = 0;
+      sqe.addr = reinterpret_cast<uintptr_t>(&msg);
+      sqe.len = 1;
+      sqe.msg_flags = MSG_DONTWAIT;
+      sqe.user_data = i;
+      if (i + 1 < chunk_cnt)
+      {
+        sqe.flags |= IOSQE_IO_LINK;
+      }
+    }
+    __atomic_store_n(m_sq_tail, tail + chunk_cnt, __ATOMIC_RELEASE);
+
+      // The kernel thread go to sleep after being idle for a while. The
+      // barrier make sure that the flags are read after the tail is written.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ((__atomic_load_n(m_sq_flags, __ATOMIC_RELAXED) &
+         IORING_SQ_NEED_WAKEUP) != 0)
+    {
+      io_uring_enter(m_ring_fd, 0, 0, IORING_ENTER_SQ_WAKEUP);
+    }
+
+    if (!waitCompletions(chunk_cnt))
+    {
+      return sent_cnt;
+    }
+    for (unsigned i=0; i<chunk_cnt; ++i)
+    {
+      if (m_results[i] < 0)
+      {
+        errno = -m_results[i];
+        return sent_cnt;
+      }
+      ++sent_cnt;
+    }
+  }
+  return sent_cnt;
+#else
+  errno = ENOSYS;
+  return 0;
+#endif
+} /* UdpSendRing::send */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void UdpSendRing::cleanup(void)
+{
+  if (m_sqes != 0)
+  {
+    munmap(m_sqes, m_sqes_size);
+    m_sqes = 0;
+  }
+  if (m_cq_ring != 0)
+  {
+    munmap(m_cq_ring, m_cq_ring_size);
+    m_cq_ring = 0;
+  }
+  if (m_sq_ring != 0)
+  {
+    munmap(m_sq_ring, m_sq_ring_size);
+    m_sq_ring = 0;
+  }
+  if (m_ring_fd >= 0)
+  {
+    close(m_ring_fd);
+    m_ring_fd = -1;
+  }
+} /* UdpSendRing::cleanup */
+
+
+bool UdpSendRing::waitCompletions(unsigned cnt)
+{
+#ifdef HAS_IO_URING
+  const struct io_uring_cqe *cqes =
+    reinterpret_cast<const struct io_uring_cqe*>(m_cqes);
+  unsigned spins = 0;
+  while (cnt > 0)
+  {
+    unsigned head = *m_cq_head;
+    unsigned tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail)
+    {
+        // Spin for a short while before going to sleep since the kernel
+        // thread usually send a batch in a few microseconds
+      if (++spins < COMPLETION_SPINS)
+      {
+        continue;
+      }
+      if ((io_uring_enter(m_ring_fd, 0, cnt, IORING_ENTER_GETEVENTS) < 0) &&
+          (errno != EINTR))
+      {
+        return false;
+      }
+      continue;
+    }
+    for (; (head != tail) && (cnt > 0); ++head, --cnt)
+    {
+      const struct io_uring_cqe& cqe = cqes[head & m_cq_mask];
+      if (cqe.user_data < m_results.size())
+      {
+        m_results[cqe.user_data] = cqe.res;
+      }
+    }
+    __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+  }
+#endif
+  return true;
+} /* UdpSendRing::waitCompletions */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,183 @@
+/**
+@file   UdpSendRing.h
+@brief  Send UDP datagrams through an io_uring submission queue
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef UDP_SEND_RING_INCLUDED
+#define UDP_SEND_RING_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncUdpSocket.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Send UDP datagrams through an io_uring submission queue
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class is used by the UDP fan-out workers as an alternative to the
+sendmmsg(2) system call. The datagrams are written to a Linux io_uring
+submission queue that is polled by a kernel thread, so sending a batch
+normally does not need any system call at all. The kernel still does all the
+UDP and IP processing, but that work is moved off the worker thread and
+the per-call overhead is gone.
+
+The datagrams of a batch are linked so that they are sent in order and so
+that the rest of the batch is cancelled when one of them fail. That give the
+send function the same semantics as Async::UdpSocket::sendDatagrams.
+
+One object must only be used by one thread. If io_uring is not available,
+because of an old kernel, a kernel built without it or because it has been
+disabled by a security policy, the init function fail and the caller should
+fall back to sendmmsg.
+*/
+class UdpSendRing
+{
+  public:
+    /**
+     * @brief   Default constructor
+     */
+    UdpSendRing(void);
+
+    /**
+     * @brief   Destructor
+     */
+    ~UdpSendRing(void);
+
+    /**
+     * @brief   Set up the ring
+     * @param   sock    The UDP socket to send on
+     * @param   entries The maximum number of datagrams sent in one go
+     * @param   errmsg  Set to a description of the error on failure
+     * @return  Returns \em true on success or \em false on failure
+     */
+    bool init(int sock, unsigned entries, std::string& errmsg);
+
+    /**
+     * @brief   Send a number of datagrams
+     * @param   dgrams  The datagrams to send
+     * @param   cnt     The number of datagrams
+     * @return  Returns the number of datagrams sent before the first failure
+     *
+     * The function return when all datagrams have been handled by the
+     * kernel. If not all datagrams could be sent, errno is set to the error
+     * of the first one that failed.
+     */
+    int send(const Async::UdpSocket::Datagram *dgrams, int cnt);
+
+  private:
+    static const unsigned SQ_THREAD_IDLE_MS = 1000;
+    static const unsigned COMPLETION_SPINS  = 20000;
+
+    int                         m_ring_fd;
+    void*                       m_sq_ring;
+    size_t                      m_sq_ring_size;
+    void*                       m_cq_ring;
+    size_t                      m_cq_ring_size;
+    void*                       m_sqes;
+    size_t                      m_sqes_size;
+    unsigned*                   m_sq_tail;
+    unsigned*                   m_sq_flags;
+    unsigned                    m_sq_mask;
+    unsigned                    m_sq_entries;
+    unsigned*                   m_cq_head;
+    unsigned*                   m_cq_tail;
+    unsigned                    m_cq_mask;
+    void*                       m_cqes;
+    std::vector<struct msghdr>  m_msgs;
+    std::vector<sockaddr_in>    m_addrs;
+    std::vector<int>            m_results;
+
+    UdpSendRing(const UdpSendRing&);
+    UdpSendRing& operator=(const UdpSendRing&);
+    void cleanup(void);
+    bool waitCompletions(unsigned cnt);
+
+};  /* class UdpSendRing */
+
+
+#endif /* UDP_SEND_RING_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
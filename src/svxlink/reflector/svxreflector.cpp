@@ -64,7 +64,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncCppApplication.h>
 #include <AsyncFdWatch.h>
+#include <AsyncLogWriter.h>
 #include <AsyncConfig.h>
+#include <AsyncConfigWatch.h>
+#include <AsyncThreadScheduling.h>
 #include <config.h>
 
 
@@ -113,14 +116,10 @@ using namespace Async;
 
 static void parse_arguments(int argc, const char **argv);
 static void stdinHandler(FdWatch *w);
-static void stdout_handler(FdWatch *w);
 static void sighup_handler(int signal);
+static void cfg_reloaded(bool success);
 static void sigterm_handler(int signal);
 static void handle_unix_signal(int signum);
-static bool logfile_open(void);
-static void logfile_reopen(const char *reason);
-static bool logfile_write_timestamp(void);
-static void logfile_write(const char *buf);
 static void logfile_flush(void);
 
 
@@ -143,9 +142,8 @@ static char             *logfile_name = NULL;
 static char             *runasuser = NULL;
 static char   	      	*config = NULL;
 static int    	      	daemonize = 0;
-static int    	      	logfd = -1;
 static FdWatch	      	*stdin_watch = 0;
-static FdWatch	      	*stdout_watch = 0;
+static LogWriter        *log_writer = 0;
 static string         	tstamp_format;
 
 
@@ -187,7 +185,8 @@ int main(int argc, const char *argv[])
   if (logfile_name != 0)
   {
       /* Open the logfile */
-    if (!logfile_open())
+    log_writer = new LogWriter;
+    if (!log_writer->open(logfile_name))
     {
       exit(1);
     }
@@ -210,8 +209,10 @@ int main(int argc, const char *argv[])
       perror("fcntl(..., F_SETFL)");
       exit(1);
     }
-    stdout_watch = new FdWatch(pipefd[0], FdWatch::FD_WATCH_RD);
-    stdout_watch->activity.connect(sigc::ptr_fun(&stdout_handler));
+    if (!log_writer->start(pipefd[0]))
+    {
+      exit(1);
+    }
 
       /* Redirect stdout to the logpipe */
     if (dup2(pipefd[1], STDOUT_FILENO) == -1)
@@ -320,6 +321,10 @@ int main(int argc, const char *argv[])
   }
 
   tstamp_format = "%c";
+  if (log_writer != 0)
+  {
+    log_writer->setTimestampFormat(tstamp_format);
+  }
 
   Config cfg;
   string cfg_filename;
@@ -410,6 +415,10 @@ int main(int argc, const char *argv[])
   }
 
   cfg.getValue("GLOBAL", "TIMESTAMP_FORMAT", tstamp_format);
+  if (log_writer != 0)
+  {
+    log_writer->setTimestampFormat(tstamp_format);
+  }
 
   cout << PROGRAM_NAME " v" SVXREFLECTOR_VERSION
           " Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX\n\n";
@@ -421,6 +430,11 @@ int main(int argc, const char *argv[])
 
   cout << "\nUsing configuration file: " << main_cfg_filename << endl;
 
+  if (!ThreadScheduling::configure(cfg, "GLOBAL"))
+  {
+    exit(1);
+  }
+
   struct termios org_termios = {0};
   if (logfile_name == 0)
   {
@@ -434,10 +448,35 @@ int main(int argc, const char *argv[])
     stdin_watch->activity.connect(sigc::ptr_fun(&stdinHandler));
   }
 
+  ConfigWatch cfg_watch(cfg);
+  bool cfg_auto_reload = false;
+  cfg.getValue("GLOBAL", "CFG_AUTO_RELOAD", cfg_auto_reload);
+  if (cfg_auto_reload)
+  {
+    cfg_watch.reloaded.connect(sigc::ptr_fun(&cfg_reloaded));
+    if (!cfg_watch.start())
+    {
+      cerr << "*** WARNING: Could not watch the configuration files for "
+              "changes\n";
+    }
+  }
+
+    // The main loop statistics are published on the /metrics HTTP target.
+    // Warnings are only printed if explicitly enabled.
+  std::string http_srv_port;
+  if (cfg.getValue("GLOBAL", "HTTP_SRV_PORT", http_srv_port) &&
+      (app.loopProfiler() == 0))
+  {
+    app.setLoopProfiling(true, 0);
+  }
+
   Reflector ref;
   if (ref.initialize(cfg))
   {
     app.exec();
+
+      // Save the client sessions so that they can be resumed after restart
+    ref.saveState();
   }
   else
   {
@@ -452,18 +491,15 @@ int main(int argc, const char *argv[])
     tcsetattr(STDIN_FILENO, TCSANOW, &org_termios);
   }
 
-  if (stdout_watch != 0)
+  if (log_writer != 0)
   {
-    delete stdout_watch;
+    log_writer->stop();
+    delete log_writer;
+    log_writer = 0;
     close(pipefd[0]);
     close(pipefd[1]);
   }
 
-  if (logfd != -1)
-  {
-    close(logfd);
-  }
-
   return 0;
 } /* main */
 
@@ -580,22 +616,6 @@ static void stdinHandler(FdWatch *w)
 } /* stdinHandler */
 
 
-static void stdout_handler(FdWatch *w)
-{
-  ssize_t len =  0;
-  do
-  {
-    char buf[256];
-    len = read(w->fd(), buf, sizeof(buf)-1);
-    if (len > 0)
-    {
-      buf[len] = 0;
-      logfile_write(buf);
-    }
-  } while (len > 0);
-} /* stdout_handler  */
-
-
 static void sighup_handler(int signal)
 {
   if (logfile_name == 0)
@@ -603,10 +623,24 @@ static void sighup_handler(int signal)
     cout << "Ignoring SIGHUP\n";
     return;
   }
-  logfile_reopen("SIGHUP received");
+  log_writer->reopen("SIGHUP received");
 } /* sighup_handler */
 
 
+static void cfg_reloaded(bool success)
+{
+  if (success)
+  {
+    cout << "Configuration reloaded\n";
+  }
+  else
+  {
+    cerr << "*** WARNING: Failed to reload the configuration. "
+            "Keeping the old configuration.\n";
+  }
+} /* cfg_reloaded */
+
+
 static void sigterm_handler(int signal)
 {
   const char *signame = 0;
@@ -625,7 +659,7 @@ static void sigterm_handler(int signal)
   string msg("\n");
   msg += signame;
   msg += " received. Shutting down application...\n";
-  logfile_write(msg.c_str());
+  cout << msg << flush;
   Application::app().quit();
 } /* sigterm_handler */
 
@@ -645,129 +679,13 @@ static void handle_unix_signal(int signum)
 } /* handle_unix_signal */
 
 
-static bool logfile_open(void)
-{
-  if (logfd != -1)
-  {
-    close(logfd);
-  }
-
-  logfd = open(logfile_name, O_WRONLY | O_APPEND | O_CREAT, 00644);
-  if (logfd == -1)
-  {
-    ostringstream ss;
-    ss << "open(\"" << logfile_name << "\")";
-    perror(ss.str().c_str());
-    return false;
-  }
-
-  return true;
-
-} /* logfile_open */
-
-
-static void logfile_reopen(const char *reason)
-{
-  logfile_write_timestamp();
-  string msg(reason);
-  msg += ". Reopening logfile\n";
-  if (write(logfd, msg.c_str(), msg.size()) == -1) {}
-
-  logfile_open();
-
-  logfile_write_timestamp();
-  msg = reason;
-  msg += ". Logfile reopened\n";
-  if (write(logfd, msg.c_str(), msg.size()) == -1) {}
-} /* logfile_reopen */
-
-
-static bool logfile_write_timestamp(void)
-{
-  if (!tstamp_format.empty())
-  {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    string fmt(tstamp_format);
-    const string frac_code("%f");
-    size_t pos = fmt.find(frac_code);
-    if (pos != string::npos)
-    {
-      stringstream ss;
-      ss << setfill('0') << setw(3) << (tv.tv_usec / 1000);
-      fmt.replace(pos, frac_code.length(), ss.str());
-    }
-    struct tm *tm = localtime(&tv.tv_sec);
-    char tstr[256];
-    size_t tlen = strftime(tstr, sizeof(tstr), fmt.c_str(), tm);
-    ssize_t ret = write(logfd, tstr, tlen);
-    if (ret != static_cast<ssize_t>(tlen))
-    {
-      return false;
-    }
-    ret = write(logfd, ": ", 2);
-    if (ret != 2)
-    {
-      return false;
-    }
-  }
-  return true;
-} /* logfile_write_timestamp */
-
-
-static void logfile_write(const char *buf)
-{
-  if (logfd == -1)
-  {
-    cout << buf;
-    return;
-  }
-
-  const char *ptr = buf;
-  while (*ptr != 0)
-  {
-    static bool print_timestamp = true;
-    ssize_t ret;
-
-    if (print_timestamp)
-    {
-      if (!logfile_write_timestamp())
-      {
-        logfile_reopen("Write error");
-        return;
-      }
-      print_timestamp = false;
-    }
-
-    size_t write_len = 0;
-    const char *nl = strchr(ptr, '\n');
-    if (nl != 0)
-    {
-      write_len = nl-ptr+1;
-      print_timestamp = true;
-    }
-    else
-    {
-      write_len = strlen(ptr);
-    }
-    ret = write(logfd, ptr, write_len);
-    if (ret != static_cast<ssize_t>(write_len))
-    {
-      logfile_reopen("Write error");
-      return;
-    }
-    ptr += write_len;
-  }
-} /* logfile_write */
-
-
 static void logfile_flush(void)
 {
   cout.flush();
   cerr.flush();
-  if (stdout_watch != 0)
+  if (log_writer != 0)
   {
-    stdout_handler(stdout_watch);
+    log_writer->flush();
   }
 } /*  logfile_flush */
 
@@ -0,0 +1,900 @@
+/**
+@file	 svxreflector_bench.cpp
+@brief   A load test and benchmark application for the SvxReflector
+@author  Tobias Blomberg / SM0SVX
+@date	 2020-05-16
+
+This application starts a reflector in-process and connects a number of
+simulated clients to it over the loopback interface. The clients log in using
+the same protocol as the ReflectorLogic in SvxLink, select talk groups and
+take turns talking. Every audio frame carry a sequence number and a send
+timestamp so that the receiving clients can measure the fan-out latency and
+packet loss.
+
+\verbatim
+SvxReflector - An audio reflector for connecting SvxLink Servers
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <popt.h>
+#include <sigc++/sigc++.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncCppApplication.h>
+#include <AsyncConfig.h>
+#include <AsyncTimer.h>
+#include <AsyncTcpClient.h>
+#include <AsyncFramedTcpConnection.h>
+#include <AsyncUdpSocket.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "Reflector.h"
+#include "ReflectorMsg.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define PROGRAM_NAME "SvxReflectorBench"
+
+  // Each audio frame start with a 32 bit frame number and a 64 bit
+  // timestamp in microseconds
+#define FRAME_HDR_SIZE  12
+
+  // The number of clients to connect every 10 milliseconds. The reflector
+  // use a short listen backlog so connecting all clients at once would make
+  // some of the connections fail.
+#define CONNECT_BATCH   4
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+class Bench;
+
+/**
+@brief  A simulated reflector client
+
+A minimal implementation of the client side of the reflector protocol. It
+logs in, selects a talk group and then send and receive audio frames. Audio
+payloads are never decoded, only inspected for the frame number and timestamp
+written by the sending client.
+*/
+class BenchClient : public sigc::trackable
+{
+  public:
+    BenchClient(Bench *bench, const string& callsign, const string& auth_key,
+                uint32_t tg)
+      : m_bench(bench), m_callsign(callsign), m_auth_key(auth_key), m_tg(tg),
+        m_udp_sock(0), m_client_id(0), m_next_udp_tx_seq(0),
+        m_next_udp_rx_seq(0), m_logged_in(false), m_ready(false)
+    {
+      m_con.connected.connect(mem_fun(*this, &BenchClient::onConnected));
+      m_con.disconnected.connect(
+          mem_fun(*this, &BenchClient::onDisconnected));
+      m_con.frameReceived.connect(
+          mem_fun(*this, &BenchClient::onFrameReceived));
+    }
+
+    ~BenchClient(void)
+    {
+      delete m_udp_sock;
+    }
+
+    void connect(const IpAddress& ip, uint16_t port)
+    {
+      m_con.connect(ip, port);
+    }
+
+    const string& callsign(void) const { return m_callsign; }
+    uint32_t tg(void) const { return m_tg; }
+
+      // A client is ready when the UDP path has been verified by the
+      // reflector sending a heartbeat back
+    bool isReady(void) const { return m_ready; }
+
+    void sendHeartbeats(void)
+    {
+      sendMsg(MsgHeartbeat());
+      sendUdpMsg(MsgUdpHeartbeat());
+    }
+
+    void sendAudioFrame(uint32_t frame_no, uint64_t timestamp,
+                        vector<uint8_t>& frame);
+
+    void sendFlush(void)
+    {
+      sendUdpMsg(MsgUdpFlushSamples());
+    }
+
+  private:
+    Bench*                            m_bench;
+    string                            m_callsign;
+    string                            m_auth_key;
+    uint32_t                          m_tg;
+    TcpClient<FramedTcpConnection>    m_con;
+    UdpSocket*                        m_udp_sock;
+    uint16_t                          m_client_id;
+    uint16_t                          m_next_udp_tx_seq;
+    uint16_t                          m_next_udp_rx_seq;
+    bool                              m_logged_in;
+    bool                              m_ready;
+
+    void onConnected(void)
+    {
+      sendMsg(MsgProtoVer());
+    }
+
+    void onDisconnected(TcpConnection *con,
+                        TcpConnection::DisconnectReason reason)
+    {
+      cerr << "*** ERROR[" << m_callsign << "]: Disconnected from reflector: "
+           << TcpConnection::disconnectReasonStr(reason) << endl;
+      delete m_udp_sock;
+      m_udp_sock = 0;
+      m_logged_in = false;
+      m_ready = false;
+    }
+
+    void onFrameReceived(FramedTcpConnection *con, vector<uint8_t>& data);
+    void udpDatagramReceived(const IpAddress& addr, uint16_t port,
+                             void *buf, int count);
+    void sendMsg(const ReflectorMsg& msg);
+    void sendUdpMsg(const ReflectorUdpMsg& msg);
+}; /* class BenchClient */
+
+
+/**
+@brief  The benchmark driver
+
+Owns the simulated clients, schedules talkers for each talk group and
+collect the statistics.
+*/
+class Bench : public sigc::trackable
+{
+  public:
+    struct Params
+    {
+      unsigned  clients;
+      unsigned  tgs;
+      bool      skewed;
+      unsigned  talk_time;
+      unsigned  frame_interval;
+      unsigned  frame_size;
+      unsigned  duration;
+      uint16_t  port;
+    };
+
+    Bench(const Params& params)
+      : m_params(params), m_frame(params.frame_size),
+        m_frame_timer(params.frame_interval, Timer::TYPE_PERIODIC, false),
+        m_heartbeat_timer(5000, Timer::TYPE_PERIODIC, false),
+        m_connect_timer(10, Timer::TYPE_PERIODIC, false),
+        m_start_timer(100, Timer::TYPE_PERIODIC, false),
+        m_stop_timer(1000 * params.duration, Timer::TYPE_ONESHOT, false),
+        m_drain_timer(500, Timer::TYPE_ONESHOT, false),
+        m_running(false), m_connect_cnt(0), m_start_wait(0),
+        m_next_frame_no(0),
+        m_sent_cnt(0), m_expected_cnt(0), m_received_cnt(0), m_late_cnt(0),
+        m_start_time(0), m_stop_time(0)
+    {
+      m_frame_timer.expired.connect(mem_fun(*this, &Bench::sendFrames));
+      m_heartbeat_timer.expired.connect(
+          mem_fun(*this, &Bench::sendHeartbeats));
+      m_connect_timer.expired.connect(
+          mem_fun(*this, &Bench::connectClients));
+      m_start_timer.expired.connect(mem_fun(*this, &Bench::checkStart));
+      m_stop_timer.expired.connect(mem_fun(*this, &Bench::stop));
+      m_drain_timer.expired.connect(mem_fun(*this, &Bench::report));
+    }
+
+    ~Bench(void)
+    {
+      for (vector<BenchClient*>::iterator it = m_clients.begin();
+           it != m_clients.end(); ++it)
+      {
+        delete *it;
+      }
+    }
+
+    void setup(Config& cfg);
+    void start(void);
+
+    static uint64_t now(void)
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
+    void frameReceived(const uint8_t *buf, size_t len);
+
+  private:
+    struct TgState
+    {
+      TgState(void) : talker(0), frames_left(0) {}
+      vector<BenchClient*>  members;
+      BenchClient*          talker;
+      unsigned              frames_left;
+    };
+    typedef vector<TgState> TgStates;
+
+    Params                m_params;
+    vector<BenchClient*>  m_clients;
+    TgStates              m_tg_states;
+    vector<uint8_t>       m_frame;
+    Timer                 m_frame_timer;
+    Timer                 m_heartbeat_timer;
+    Timer                 m_connect_timer;
+    Timer                 m_start_timer;
+    Timer                 m_stop_timer;
+    Timer                 m_drain_timer;
+    bool                  m_running;
+    unsigned              m_connect_cnt;
+    unsigned              m_start_wait;
+    uint32_t              m_next_frame_no;
+    unsigned long         m_sent_cnt;
+    unsigned long         m_expected_cnt;
+    unsigned long         m_received_cnt;
+    unsigned long         m_late_cnt;
+    vector<uint32_t>      m_latencies;
+    uint64_t              m_start_time;
+    uint64_t              m_stop_time;
+    struct rusage         m_start_usage;
+
+    void connectClients(Timer *t);
+    void checkStart(Timer *t);
+    void sendFrames(Timer *t);
+    void sendHeartbeats(Timer *t);
+    void stop(Timer *t);
+    void report(Timer *t);
+    unsigned readyListeners(const TgState& state) const;
+}; /* class Bench */
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void parse_arguments(int argc, const char **argv);
+static double percentile(const vector<uint32_t>& sorted, double p);
+static double tv_to_us(const struct timeval& tv);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+static int clients = 50;
+static int tgs = 1;
+static char *tg_dist = NULL;
+static int talk_time = 5000;
+static int frame_interval = 20;
+static int frame_size = 64;
+static int duration = 30;
+static int port = 15300;
+static int fanout_threads = 0;
+static int audio_priority = 0;
+static int verbose = 0;
+
+
+/****************************************************************************
+ *
+ * MAIN
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  main
+ * Purpose:   Start everything...
+ * Input:     argc  - The number of arguments passed to this program
+ *    	      	      including the program name.
+ *    	      argv  - The arguments passed to this program. argv[0] is the
+ *    	      	      program name.
+ * Output:    Return 0 on success, else non-zero.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2020-05-16
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+int main(int argc, const char *argv[])
+{
+  CppApplication app;
+
+  parse_arguments(argc, const_cast<const char **>(argv));
+
+  if ((clients < 2) || (tgs < 1) || (talk_time < frame_interval) ||
+      (frame_interval < 1) || (frame_size < FRAME_HDR_SIZE) ||
+      (frame_size > 1024) || (duration < 1) || (port < 1) ||
+      (port > 65535) || (fanout_threads < 0))
+  {
+    cerr << "*** ERROR: Illegal argument value(s)" << endl;
+    exit(1);
+  }
+
+  Bench::Params params;
+  params.clients = clients;
+  params.tgs = tgs;
+  params.skewed = false;
+  if (tg_dist != NULL)
+  {
+    if (strcmp(tg_dist, "skewed") == 0)
+    {
+      params.skewed = true;
+    }
+    else if (strcmp(tg_dist, "uniform") != 0)
+    {
+      cerr << "*** ERROR: Unknown TG distribution \"" << tg_dist
+           << "\". Use \"uniform\" or \"skewed\"." << endl;
+      exit(1);
+    }
+  }
+  params.talk_time = talk_time;
+  params.frame_interval = frame_interval;
+  params.frame_size = frame_size;
+  params.duration = duration;
+  params.port = port;
+
+  Config cfg;
+  ostringstream ss;
+  ss << port;
+  cfg.setValue("GLOBAL", "LISTEN_PORT", ss.str());
+  ss.str("");
+  ss << fanout_threads;
+  cfg.setValue("GLOBAL", "UDP_FANOUT_THREADS", ss.str());
+  cfg.setValue("GLOBAL", "UDP_AUDIO_PRIORITY", audio_priority ? "1" : "0");
+
+  Bench bench(params);
+  bench.setup(cfg);
+
+    // The reflector is quite chatty so its output is discarded unless
+    // verbose mode has been selected
+  streambuf *cout_buf = cout.rdbuf();
+  if (!verbose)
+  {
+    cout.rdbuf(0);
+  }
+
+  Reflector ref;
+  if (!ref.initialize(cfg))
+  {
+    cout.rdbuf(cout_buf);
+    cerr << "*** ERROR: Could not initialize the reflector" << endl;
+    exit(1);
+  }
+
+  bench.start();
+  app.exec();
+
+  return 0;
+
+} /* main */
+
+
+/****************************************************************************
+ *
+ * Functions
+ *
+ ****************************************************************************/
+
+void BenchClient::sendAudioFrame(uint32_t frame_no, uint64_t timestamp,
+                                 vector<uint8_t>& frame)
+{
+  memcpy(&frame[0], &frame_no, sizeof(frame_no));
+  memcpy(&frame[sizeof(frame_no)], &timestamp, sizeof(timestamp));
+  sendUdpMsg(MsgUdpAudio(frame));
+} /* BenchClient::sendAudioFrame */
+
+
+void BenchClient::onFrameReceived(FramedTcpConnection *con,
+                                  vector<uint8_t>& data)
+{
+  stringstream ss;
+  ss.write(reinterpret_cast<const char*>(&data.front()), data.size());
+
+  ReflectorMsg header;
+  if (!header.unpack(ss))
+  {
+    cerr << "*** ERROR[" << m_callsign << "]: Could not unpack TCP header"
+         << endl;
+    return;
+  }
+
+  switch (header.type())
+  {
+    case MsgAuthChallenge::TYPE:
+    {
+      MsgAuthChallenge msg;
+      if (!msg.unpack(ss) || (msg.challenge() == 0))
+      {
+        cerr << "*** ERROR[" << m_callsign
+             << "]: Could not unpack MsgAuthChallenge" << endl;
+        return;
+      }
+      sendMsg(MsgAuthResponse(m_callsign, m_auth_key, msg.challenge()));
+      break;
+    }
+
+    case MsgAuthOk::TYPE:
+      m_logged_in = true;
+      break;
+
+    case MsgServerInfo::TYPE:
+    {
+      MsgServerInfo msg;
+      if (!msg.unpack(ss))
+      {
+        cerr << "*** ERROR[" << m_callsign
+             << "]: Could not unpack MsgServerInfo" << endl;
+        return;
+      }
+      m_client_id = msg.clientId();
+      delete m_udp_sock;
+      m_udp_sock = new UdpSocket;
+      m_udp_sock->dataReceived.connect(
+          mem_fun(*this, &BenchClient::udpDatagramReceived));
+      sendMsg(MsgSelectTG(m_tg));
+      sendUdpMsg(MsgUdpHeartbeat());
+      break;
+    }
+
+    case MsgError::TYPE:
+    {
+      MsgError msg;
+      msg.unpack(ss);
+      cerr << "*** ERROR[" << m_callsign << "]: Error from reflector: "
+           << msg.message() << endl;
+      break;
+    }
+
+    default:
+      break;
+  }
+} /* BenchClient::onFrameReceived */
+
+
+void BenchClient::udpDatagramReceived(const IpAddress& addr, uint16_t port,
+                                      void *buf, int count)
+{
+  const char *data = reinterpret_cast<const char*>(buf);
+  ReflectorUdpMsg header;
+  if (!header.unpackHeader(data, count))
+  {
+    return;
+  }
+  m_next_udp_rx_seq = header.sequenceNum() + 1;
+  m_ready = true;
+
+  if (header.type() == MsgUdpAudio::TYPE)
+  {
+    MsgUdpAudioView msg;
+    if (msg.unpack(data + ReflectorUdpMsg::HEADER_SIZE,
+                   count - ReflectorUdpMsg::HEADER_SIZE))
+    {
+      m_bench->frameReceived(msg.audioData(), msg.audioSize());
+    }
+  }
+} /* BenchClient::udpDatagramReceived */
+
+
+void BenchClient::sendMsg(const ReflectorMsg& msg)
+{
+  if (!m_con.isConnected())
+  {
+    return;
+  }
+  ostringstream ss;
+  ReflectorMsg header(msg.type());
+  if (!header.pack(ss) || !msg.pack(ss))
+  {
+    cerr << "*** ERROR[" << m_callsign << "]: Failed to pack TCP message"
+         << endl;
+    return;
+  }
+  m_con.write(ss.str().data(), ss.str().size());
+} /* BenchClient::sendMsg */
+
+
+void BenchClient::sendUdpMsg(const ReflectorUdpMsg& msg)
+{
+  if (m_udp_sock == 0)
+  {
+    return;
+  }
+  ReflectorUdpMsg header(msg.type(), m_client_id, m_next_udp_tx_seq++);
+  ostringstream ss;
+  if (!header.pack(ss) || !msg.pack(ss))
+  {
+    cerr << "*** ERROR[" << m_callsign << "]: Failed to pack UDP message"
+         << endl;
+    return;
+  }
+  m_udp_sock->write(m_con.remoteHost(), m_con.remotePort(),
+                    ss.str().data(), ss.str().size());
+} /* BenchClient::sendUdpMsg */
+
+
+void Bench::setup(Config& cfg)
+{
+  cfg.setValue("PASSWORDS", "BenchUsers", "BenchPasswd");
+
+    // Distribute the clients over the talk groups. With the skewed
+    // distribution, TG n get a share proportional to 1/n.
+  vector<double> weights(m_params.tgs);
+  double weight_sum = 0.0;
+  for (unsigned i=0; i<m_params.tgs; ++i)
+  {
+    weights[i] = m_params.skewed ? 1.0 / (i + 1) : 1.0;
+    weight_sum += weights[i];
+  }
+  m_tg_states.resize(m_params.tgs);
+  unsigned tg_idx = 0;
+  double tg_limit = m_params.clients * weights[0] / weight_sum;
+  for (unsigned i=0; i<m_params.clients; ++i)
+  {
+    while ((i >= tg_limit) && (tg_idx + 1 < m_params.tgs))
+    {
+      ++tg_idx;
+      tg_limit += m_params.clients * weights[tg_idx] / weight_sum;
+    }
+    ostringstream ss;
+    ss << "BENCH" << i;
+    cfg.setValue("USERS", ss.str(), "BenchUsers");
+    BenchClient *client = new BenchClient(this, ss.str(), "BenchPasswd",
+                                          tg_idx + 1);
+    m_clients.push_back(client);
+    m_tg_states[tg_idx].members.push_back(client);
+  }
+} /* Bench::setup */
+
+
+void Bench::start(void)
+{
+  m_connect_timer.setEnable(true);
+  m_heartbeat_timer.setEnable(true);
+} /* Bench::start */
+
+
+void Bench::frameReceived(const uint8_t *buf, size_t len)
+{
+  if (len < FRAME_HDR_SIZE)
+  {
+    return;
+  }
+  uint64_t timestamp;
+  memcpy(&timestamp, buf + sizeof(uint32_t), sizeof(timestamp));
+  if (timestamp < m_start_time)
+  {
+    return;
+  }
+  ++m_received_cnt;
+  if (!m_running)
+  {
+    ++m_late_cnt;
+  }
+  m_latencies.push_back(static_cast<uint32_t>(now() - timestamp));
+} /* Bench::frameReceived */
+
+
+void Bench::connectClients(Timer *t)
+{
+  for (unsigned i=0; (i<CONNECT_BATCH) && (m_connect_cnt<m_clients.size()); ++i)
+  {
+    m_clients[m_connect_cnt++]->connect(IpAddress("127.0.0.1"), m_params.port);
+  }
+  if (m_connect_cnt == m_clients.size())
+  {
+    m_connect_timer.setEnable(false);
+    m_start_timer.setEnable(true);
+  }
+} /* Bench::connectClients */
+
+
+void Bench::checkStart(Timer *t)
+{
+  unsigned ready_cnt = 0;
+  for (vector<BenchClient*>::const_iterator it = m_clients.begin();
+       it != m_clients.end(); ++it)
+  {
+    ready_cnt += (*it)->isReady() ? 1 : 0;
+  }
+  if ((ready_cnt < m_clients.size()) && (++m_start_wait < 100))
+  {
+    return;
+  }
+  m_start_timer.setEnable(false);
+  if (ready_cnt < 2)
+  {
+    cerr << "*** ERROR: Only " << ready_cnt << " client(s) got ready" << endl;
+    Application::app().quit();
+    return;
+  }
+  if (ready_cnt < m_clients.size())
+  {
+    cerr << "*** WARNING: Only " << ready_cnt << " of " << m_clients.size()
+         << " clients got ready. Starting anyway." << endl;
+  }
+
+  m_latencies.reserve(m_params.clients * 1000 / m_params.frame_interval *
+                      m_params.duration);
+  m_start_time = now();
+  getrusage(RUSAGE_SELF, &m_start_usage);
+  m_running = true;
+  m_frame_timer.setEnable(true);
+  m_stop_timer.setEnable(true);
+} /* Bench::checkStart */
+
+
+void Bench::sendFrames(Timer *t)
+{
+  uint64_t timestamp = now();
+  for (TgStates::iterator it = m_tg_states.begin();
+       it != m_tg_states.end(); ++it)
+  {
+    TgState& state = *it;
+    if (state.members.size() < 2)
+    {
+      continue;
+    }
+    if (state.talker == 0)
+    {
+      state.talker = state.members[rand() % state.members.size()];
+      state.frames_left = m_params.talk_time / m_params.frame_interval;
+    }
+    state.talker->sendAudioFrame(m_next_frame_no++, timestamp, m_frame);
+    ++m_sent_cnt;
+    m_expected_cnt += readyListeners(state);
+    if (--state.frames_left == 0)
+    {
+        // End this talk spurt. A new talker is selected on the next tick.
+      state.talker->sendFlush();
+      state.talker = 0;
+    }
+  }
+} /* Bench::sendFrames */
+
+
+void Bench::sendHeartbeats(Timer *t)
+{
+  for (vector<BenchClient*>::iterator it = m_clients.begin();
+       it != m_clients.end(); ++it)
+  {
+    (*it)->sendHeartbeats();
+  }
+} /* Bench::sendHeartbeats */
+
+
+void Bench::stop(Timer *t)
+{
+  m_running = false;
+  m_stop_time = now();
+  m_frame_timer.setEnable(false);
+  m_drain_timer.setEnable(true);
+} /* Bench::stop */
+
+
+void Bench::report(Timer *t)
+{
+  uint64_t elapsed = m_stop_time - m_start_time;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  double user_us = tv_to_us(usage.ru_utime) -
+                   tv_to_us(m_start_usage.ru_utime);
+  double sys_us = tv_to_us(usage.ru_stime) - tv_to_us(m_start_usage.ru_stime);
+
+  sort(m_latencies.begin(), m_latencies.end());
+  double loss = 0.0;
+  if (m_expected_cnt > 0)
+  {
+    loss = 100.0 * (static_cast<double>(m_expected_cnt) - m_received_cnt) /
+           m_expected_cnt;
+  }
+  double fwd_cnt = max(m_received_cnt, 1UL);
+
+  printf("Clients:               %u in %u TG(s), %s distribution\n",
+         m_params.clients, m_params.tgs,
+         m_params.skewed ? "skewed" : "uniform");
+  printf("Audio:                 %u bytes every %u ms, %u ms talk spurts\n",
+         m_params.frame_size, m_params.frame_interval, m_params.talk_time);
+  printf("Frames sent:           %lu\n", m_sent_cnt);
+  printf("Frames expected:       %lu\n", m_expected_cnt);
+  printf("Frames received:       %lu (%lu after stop)\n",
+         m_received_cnt, m_late_cnt);
+  printf("Packet loss:           %.3f%%\n", loss);
+  printf("Forwarded packets/s:   %.0f\n", 1000000.0 * m_received_cnt / elapsed);
+  if (!m_latencies.empty())
+  {
+    printf("Fan-out latency (us):  p50=%.0f p90=%.0f p99=%.0f p99.9=%.0f "
+           "max=%u\n",
+           percentile(m_latencies, 0.5), percentile(m_latencies, 0.9),
+           percentile(m_latencies, 0.99), percentile(m_latencies, 0.999),
+           m_latencies.back());
+  }
+  printf("CPU/forwarded packet:  %.2f us user, %.2f us sys\n",
+         user_us / fwd_cnt, sys_us / fwd_cnt);
+  printf("                       (including the simulated clients)\n");
+
+  Application::app().quit();
+} /* Bench::report */
+
+
+unsigned Bench::readyListeners(const TgState& state) const
+{
+  unsigned cnt = 0;
+  for (vector<BenchClient*>::const_iterator it = state.members.begin();
+       it != state.members.end(); ++it)
+  {
+    if ((*it != state.talker) && (*it)->isReady())
+    {
+      ++cnt;
+    }
+  }
+  return cnt;
+} /* Bench::readyListeners */
+
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  parse_arguments
+ * Purpose:   Parse the command line arguments.
+ * Input:     argc  - Number of arguments in the command line
+ *    	      argv  - Array of strings with the arguments
+ * Output:    Returns 0 if all is ok, otherwise -1.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2020-05-16
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+static void parse_arguments(int argc, const char **argv)
+{
+  poptContext optCon;
+  const struct poptOption optionsTable[] =
+  {
+    POPT_AUTOHELP
+    {"clients", 'c', POPT_ARG_INT, &clients, 0,
+            "The number of simulated clients (default 50)", "<count>"},
+    {"tgs", 't', POPT_ARG_INT, &tgs, 0,
+            "The number of talk groups to spread the clients over (default 1)",
+            "<count>"},
+    {"tg-dist", 0, POPT_ARG_STRING, &tg_dist, 0,
+            "How to distribute clients over talk groups (default uniform)",
+            "uniform|skewed"},
+    {"talk-time", 0, POPT_ARG_INT, &talk_time, 0,
+            "The length of each talk spurt in milliseconds (default 5000)",
+            "<ms>"},
+    {"frame-interval", 0, POPT_ARG_INT, &frame_interval, 0,
+            "The time between audio frames in milliseconds (default 20)",
+            "<ms>"},
+    {"frame-size", 0, POPT_ARG_INT, &frame_size, 0,
+            "The size of each audio frame in bytes (default 64)", "<bytes>"},
+    {"duration", 'd', POPT_ARG_INT, &duration, 0,
+            "The length of the test in seconds (default 30)", "<seconds>"},
+    {"port", 'p', POPT_ARG_INT, &port, 0,
+            "The port for the reflector to listen on (default 15300)",
+            "<port>"},
+    {"fanout-threads", 0, POPT_ARG_INT, &fanout_threads, 0,
+            "Set the UDP_FANOUT_THREADS reflector option (default 0)",
+            "<count>"},
+    {"audio-priority", 0, POPT_ARG_NONE, &audio_priority, 0,
+            "Set the UDP_AUDIO_PRIORITY reflector option", NULL},
+    {"verbose", 'v', POPT_ARG_NONE, &verbose, 0,
+            "Show the log output from the reflector", NULL},
+    {NULL, 0, 0, NULL, 0}
+  };
+  int err;
+
+  optCon = poptGetContext(PROGRAM_NAME, argc, argv, optionsTable, 0);
+  poptReadDefaultConfig(optCon, 0);
+
+  err = poptGetNextOpt(optCon);
+  if (err != -1)
+  {
+    fprintf(stderr, "\t%s: %s\n",
+	    poptBadOption(optCon, POPT_BADOPTION_NOALIAS),
+	    poptStrerror(err));
+    exit(1);
+  }
+
+  poptFreeContext(optCon);
+
+} /* parse_arguments */
+
+
+static double percentile(const vector<uint32_t>& sorted, double p)
+{
+  size_t idx = static_cast<size_t>(p * sorted.size());
+  if (idx >= sorted.size())
+  {
+    idx = sorted.size() - 1;
+  }
+  return sorted[idx];
+} /* percentile */
+
+
+static double tv_to_us(const struct timeval& tv)
+{
+  return 1000000.0 * tv.tv_sec + tv.tv_usec;
+} /* tv_to_us */
+
+
+
+/*
+ * This file has not been truncated
+ */
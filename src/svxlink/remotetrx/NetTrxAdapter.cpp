@@ -44,6 +44,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <Tx.h>
 #include <AsyncAudioValve.h>
 #include <AsyncAudioFifo.h>
+#include <AsyncAudioLatencyBudget.h>
 #include <AsyncAudioDebugger.h>
 #include <AsyncTimer.h>
 
@@ -473,6 +474,7 @@ bool NetTrxAdapter::initialize(void)
   prev_src = txa1;
   
   AudioFifo *fifo1 = new AudioFifo(8000);
+  AudioLatencyBudget::add(net_uplink_name + ":net_tx_fifo", fifo1);
   prev_src->registerSink(fifo1, true);
   prev_src = fifo1;
   
@@ -502,6 +504,7 @@ bool NetTrxAdapter::initialize(void)
   prev_src = txa2;
   
   AudioFifo *fifo2 = new AudioFifo(8000);
+  AudioLatencyBudget::add(net_uplink_name + ":net_rx_fifo", fifo2);
   prev_src->registerSink(fifo2, true);
   prev_src = fifo2;
   
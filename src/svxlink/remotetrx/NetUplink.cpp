@@ -52,6 +52,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioSplitter.h>
 #include <AsyncAudioSelector.h>
 #include <AsyncAudioPassthrough.h>
+#include <AsyncUdpSocket.h>
+#include <AsyncAudioLatencyTrace.h>
 
 
 /****************************************************************************
@@ -62,6 +64,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "NetUplink.h"
 #include "Rx.h"
+#include "PlayoutBuffer.h"
 
 
 /****************************************************************************
@@ -82,6 +85,9 @@ using namespace NetTrxMsg;
  *
  ****************************************************************************/
 
+// Playout deadlines further into the future than this, in milliseconds,
+// are assumed to be caused by unsynchronized clocks
+#define MAX_PLAYOUT_DELAY 2000
 
 
 /****************************************************************************
@@ -126,15 +132,32 @@ using namespace NetTrxMsg;
 NetUplink::NetUplink(Config &cfg, const string &name, Rx *rx, Tx *tx,
       	      	     const string& port_str)
   : server(0), con(0), recv_cnt(0), recv_exp(0), rx(rx), tx(tx), fifo(0),
+    playout(0),
     cfg(cfg), name(name), last_msg_timestamp(), heartbeat_timer(0),
-    audio_enc(0), audio_dec(0), loopback_con(0), rx_splitter(0),
+    audio_enc(0), shared_enc(0), share_rx_encoder(false),
+    rx_mute_state(Rx::MUTE_ALL), audio_dec(0), loopback_con(0), rx_splitter(0),
     tx_selector(0), state(STATE_DISC), mute_tx_timer(0), tx_muted(false),
-    fallback_enabled(false), tx_ctrl_mode(Tx::TX_OFF)
+    fallback_enabled(false), tx_ctrl_mode(Tx::TX_OFF), udp_sock(0),
+    udp_heartbeat_timer(0), flush_guard_timer(0), udp_setup(false),
+    udp_token(0), udp_peer_port(0), udp_tx_seq(0), udp_rx_seq(0),
+    udp_active(false), last_udp_timestamp(), udp_latency_mark(0),
+    siglev_stream(false)
 {
   heartbeat_timer = new Timer(10000);
   heartbeat_timer->setEnable(false);
   heartbeat_timer->expired.connect(mem_fun(*this, &NetUplink::heartbeat));
 
+  udp_heartbeat_timer = new Timer(NET_TRX_UDP_HEARTBEAT_INTERVAL,
+                                  Timer::TYPE_PERIODIC);
+  udp_heartbeat_timer->setEnable(false);
+  udp_heartbeat_timer->expired.connect(
+      mem_fun(*this, &NetUplink::udpHeartbeat));
+
+  flush_guard_timer = new Timer(NET_TRX_UDP_FLUSH_GUARD);
+  flush_guard_timer->setEnable(false);
+  flush_guard_timer->expired.connect(
+      mem_fun(*this, &NetUplink::flushGuardExpired));
+
     // FIXME: Shouldn't we use the updates directly from the receiver instead?
     // Why is this even here?!
   //siglev_check_timer = new Timer(1000, Timer::TYPE_PERIODIC);
@@ -146,15 +169,19 @@ NetUplink::NetUplink(Config &cfg, const string &name, Rx *rx, Tx *tx,
 
 NetUplink::~NetUplink(void)
 {
-  delete audio_enc;
+  releaseAudioEncoder();
   delete audio_dec;
   delete fifo;
+  delete playout;
   delete tx_selector;
   delete rx_splitter;
   delete loopback_con;
   delete server;
   delete heartbeat_timer;
   delete mute_tx_timer;
+  delete udp_sock;
+  delete udp_heartbeat_timer;
+  delete flush_guard_timer;
   //delete siglev_check_timer;
 } /* NetUplink::~NetUplink */
 
@@ -193,6 +220,7 @@ bool NetUplink::initialize(void)
   
   cfg.getValue(name, "FALLBACK_REPEATER", fallback_enabled, true);
   cfg.getValue(name, "AUTH_KEY", auth_key, true);
+  cfg.getValue(name, "SHARE_RX_ENCODER", share_rx_encoder, true);
   
   int mute_tx_on_rx = -1;
   cfg.getValue(name, "MUTE_TX_ON_RX", mute_tx_on_rx, true);
@@ -203,6 +231,26 @@ bool NetUplink::initialize(void)
     mute_tx_timer->expired.connect(mem_fun(*this, &NetUplink::unmuteTx));
   }
   
+  bool udp_audio = true;
+  cfg.getValue(name, "UDP_AUDIO", udp_audio, true);
+  if (udp_audio)
+  {
+    udp_sock = new UdpSocket(atoi(listen_port.c_str()));
+    if (!udp_sock->initOk())
+    {
+      cerr << "*** WARNING: Could not open UDP port " << listen_port
+           << " in NetUplink " << name << ". Audio will only be sent over "
+           << "TCP.\n";
+      delete udp_sock;
+      udp_sock = 0;
+    }
+    else
+    {
+      udp_sock->dataReceived.connect(
+          mem_fun(*this, &NetUplink::udpDataReceived));
+    }
+  }
+
   server = new TcpServer<>(listen_port);
   server->clientConnected.connect(mem_fun(*this, &NetUplink::clientConnected));
   server->clientDisconnected.connect(
@@ -231,8 +279,16 @@ bool NetUplink::initialize(void)
   tx_selector->addSource(loopback_con);
 
   fifo = new AudioFifo(16000);
-  tx_selector->addSource(fifo);
-  tx_selector->selectSource(fifo);
+
+    // The playout buffer hold the audio of each talk spurt until the
+    // deadline set by a remote NetTx with SIMULCAST_DELAY configured
+  playout = new PlayoutBuffer(name, MAX_PLAYOUT_DELAY);
+  int simulcast_tx_offset = 0;
+  cfg.getValue(name, "SIMULCAST_TX_OFFSET", simulcast_tx_offset, true);
+  playout->setOffset(simulcast_tx_offset);
+  fifo->registerSink(playout);
+  tx_selector->addSource(playout);
+  tx_selector->selectSource(playout);
 
   tx_selector->registerSink(tx);
   
@@ -242,7 +298,7 @@ bool NetUplink::initialize(void)
   }
   else
   {
-    rx->setMuteState(Rx::MUTE_CONTENT);
+    setRxMuteState(Rx::MUTE_CONTENT);
   }
 
   return true;
@@ -275,12 +331,7 @@ void NetUplink::handleIncomingConnection(TcpConnection *incoming_con)
     setFallbackActive(false);
   }
   
-  if (audio_enc != 0)
-  {
-    rx_splitter->removeSink(audio_enc);
-    delete audio_enc;
-    audio_enc = 0;
-  }
+  releaseAudioEncoder();
   
   delete audio_dec;
   audio_dec = 0;
@@ -343,6 +394,7 @@ void NetUplink::disconnectCleanup(void)
   rx->reset();
   tx->enableCtcss(false);
   fifo->clear();
+  playout->reset();
   if (audio_dec != 0)
   {
     audio_dec->flushEncodedSamples();
@@ -357,6 +409,8 @@ void NetUplink::disconnectCleanup(void)
 
   tx_muted = false;
   tx_ctrl_mode = Tx::TX_OFF;
+  closeUdp();
+  siglev_stream = false;
     
   if (fallback_enabled)
   {
@@ -364,7 +418,7 @@ void NetUplink::disconnectCleanup(void)
   }
   else
   {
-    rx->setMuteState(Rx::MUTE_CONTENT);
+    setRxMuteState(Rx::MUTE_CONTENT);
   }
 } /* NetUplink::disconnectCleanup */
 
@@ -510,6 +564,27 @@ void NetUplink::handleMsg(Msg *msg)
       rx->reset();
       break;
     }
+
+    case MsgUdpSetupRequest::TYPE:
+    {
+      if (udp_sock != 0)
+      {
+        closeUdp();
+        MsgUdpSetup *setup_msg = new MsgUdpSetup;
+        udp_token = setup_msg->token();
+        udp_tx_seq = 0;
+        udp_setup = true;
+        sendMsg(setup_msg);
+        udp_heartbeat_timer->setEnable(true);
+      }
+      break;
+    }
+
+    case MsgSiglevStreamRequest::TYPE:
+    {
+      siglev_stream = true;
+      break;
+    }
     
     case MsgSetRxFq::TYPE:
     {
@@ -534,7 +609,7 @@ void NetUplink::handleMsg(Msg *msg)
       cout << rx->name() << ": SetMuteState("
            << Rx::muteStateToString(mute_msg->muteState())
       	   << ")\n";
-      rx->setMuteState(mute_msg->muteState());
+      setRxMuteState(mute_msg->muteState());
       break;
     }
     
@@ -578,10 +653,25 @@ void NetUplink::handleMsg(Msg *msg)
     {
       MsgRxAudioCodecSelect *codec_msg = 
           reinterpret_cast<MsgRxAudioCodecSelect *>(msg);
-      if (audio_enc != 0)
+      releaseAudioEncoder();
+      if (share_rx_encoder)
       {
-	rx_splitter->removeSink(audio_enc);
-	delete audio_enc;
+        MsgRxAudioCodecSelect::Opts opts;
+        codec_msg->options(opts);
+        shared_enc = SharedAudioEncoder::subscribe(this, rx->name(),
+                                                   codec_msg->name(), opts);
+        if (shared_enc != 0)
+        {
+          cout << name << ": Using shared CODEC \""
+               << shared_enc->encoder()->name()
+               << "\" to encode RX audio\n";
+        }
+        else
+        {
+          cerr << "*** ERROR: Received request for unknown RX audio codec ("
+               << codec_msg->name() << ") in NetUplink " << name << "\n";
+        }
+        break;
       }
       audio_enc = AudioEncoder::create(codec_msg->name());
       if (audio_enc != 0)
@@ -646,6 +736,10 @@ void NetUplink::handleMsg(Msg *msg)
     case MsgAudio::TYPE:
     {
       //cout << "NetUplink [MsgAudio]\n";
+      if (flush_guard_timer->isEnabled())
+      {
+        flush_guard_timer->reset();
+      }
       if (!tx_muted && (audio_dec != 0))
       {
         MsgAudio *audio_msg = reinterpret_cast<MsgAudio*>(msg);
@@ -656,13 +750,25 @@ void NetUplink::handleMsg(Msg *msg)
     
     case MsgFlush::TYPE:
     {
-      if (audio_dec != 0)
+      if (udp_active)
+      {
+        flush_guard_timer->setEnable(true);
+      }
+      else if (audio_dec != 0)
       {
         audio_dec->flushEncodedSamples();
       }
       break;
     } 
 
+    case MsgPlayoutDeadline::TYPE:
+    {
+      MsgPlayoutDeadline *deadline_msg =
+        reinterpret_cast<MsgPlayoutDeadline *>(msg);
+      playout->setDeadline(deadline_msg->deadline());
+      break;
+    }
+
     case MsgTransmittedSignalStrength::TYPE:
     {
       MsgTransmittedSignalStrength *siglev_msg =
@@ -701,21 +807,17 @@ void NetUplink::handleMsg(Msg *msg)
 
 void NetUplink::sendMsg(Msg *msg)
 {
-  if ((state == STATE_CON_SETUP) || (state == STATE_READY))
+  if (msg->type() == MsgAudio::TYPE)
   {
-    int written = con->write(msg, msg->size());
-    if (written == -1)
-    {
-      cerr << "*** ERROR: TCP transmit error in NetUplink \"" << name
-           << "\": " << strerror(errno) << ".\n";
-      forceDisconnect();
-    }
-    else if (written != static_cast<int>(msg->size()))
-    {
-      cerr << "*** ERROR: TCP transmit buffer overflow in NetUplink "
-           << name << ".\n";
-      forceDisconnect();
-    }
+    MsgAudio *audio_msg = reinterpret_cast<MsgAudio*>(msg);
+    sendAudio(audio_msg->buf(), audio_msg->size());
+  }
+  else if ((state == STATE_CON_SETUP) || (state == STATE_READY))
+  {
+    struct iovec iov;
+    iov.iov_base = msg;
+    iov.iov_len = msg->size();
+    writeMsg(&iov, 1, msg->size());
   }
   
   delete msg;
@@ -723,6 +825,62 @@ void NetUplink::sendMsg(Msg *msg)
 } /* NetUplink::sendMsg */
 
 
+void NetUplink::sendAudio(const void *buf, int size)
+{
+  MsgAudioHeader hdr(size);
+  struct iovec iov[3];
+  iov[0].iov_base = &hdr;
+  iov[0].iov_len = sizeof(hdr);
+  iov[1].iov_base = const_cast<void*>(buf);
+  iov[1].iov_len = size;
+  if ((state == STATE_READY) && udp_active)
+  {
+      // A sampled latency trace mark is sent just before the audio
+    if (AudioLatencyTrace::current() != 0)
+    {
+      uint64_t mark = AudioLatencyTrace::current();
+      struct iovec mark_iov;
+      mark_iov.iov_base = &mark;
+      mark_iov.iov_len = sizeof(mark);
+      sendUdpMsg(UdpMsg::TYPE_LATENCY_MARK, &mark_iov, 1);
+    }
+    if (!udp_siglev.empty())
+    {
+      iov[2].iov_base = const_cast<void*>(udp_siglev.data());
+      iov[2].iov_len = udp_siglev.size();
+      sendUdpMsg(UdpMsg::TYPE_AUDIO_SIGLEV, iov, 3);
+      udp_siglev.clear();
+    }
+    else
+    {
+      sendUdpMsg(UdpMsg::TYPE_AUDIO, iov, 2);
+    }
+  }
+  else if ((state == STATE_CON_SETUP) || (state == STATE_READY))
+  {
+    writeMsg(iov, 2, hdr.size());
+  }
+} /* NetUplink::sendAudio */
+
+
+void NetUplink::writeMsg(const struct iovec *iov, int iovcnt, unsigned size)
+{
+  int written = con->write(iov, iovcnt);
+  if (written == -1)
+  {
+    cerr << "*** ERROR: TCP transmit error in NetUplink \"" << name
+         << "\": " << strerror(errno) << ".\n";
+    forceDisconnect();
+  }
+  else if (written != static_cast<int>(size))
+  {
+    cerr << "*** ERROR: TCP transmit buffer overflow in NetUplink "
+         << name << ".\n";
+    forceDisconnect();
+  }
+} /* NetUplink::writeMsg */
+
+
 void NetUplink::squelchOpen(bool is_open)
 {
   if (mute_tx_timer != 0)
@@ -738,6 +896,9 @@ void NetUplink::squelchOpen(bool is_open)
     }
   }
   
+    // The squelch message carry the current signal level so levels that
+    // are waiting for the next audio datagram are not needed anymore
+  udp_siglev.clear();
   MsgSquelch *msg = new MsgSquelch(is_open, rx->signalStrength(),
       	      	      	      	   rx->sqlRxId());
   sendMsg(msg);
@@ -777,14 +938,46 @@ void NetUplink::writeEncodedSamples(const void *buf, int size)
   {
     const int bufsize = MsgAudio::BUFSIZE;
     int len = min(size, bufsize);
-    MsgAudio *msg = new MsgAudio(ptr, len);
-    sendMsg(msg);
+    sendAudio(ptr, len);
     size -= len;
     ptr += len;
   }
 } /* NetUplink::writeEncodedSamples */
 
 
+bool NetUplink::wantEncodedAudio(void) const
+{
+  return rx_mute_state == Rx::MUTE_NONE;
+} /* NetUplink::wantEncodedAudio */
+
+
+void NetUplink::setRxMuteState(Rx::MuteState new_mute_state)
+{
+  rx->setMuteState(new_mute_state);
+  rx_mute_state = new_mute_state;
+  if (shared_enc != 0)
+  {
+    shared_enc->updateFeed();
+  }
+} /* NetUplink::setRxMuteState */
+
+
+void NetUplink::releaseAudioEncoder(void)
+{
+  if (audio_enc != 0)
+  {
+    rx_splitter->removeSink(audio_enc);
+    delete audio_enc;
+    audio_enc = 0;
+  }
+  if (shared_enc != 0)
+  {
+    shared_enc->unsubscribe(this);
+    shared_enc = 0;
+  }
+} /* NetUplink::releaseAudioEncoder */
+
+
 void NetUplink::txTimeout(void)
 {
   MsgTxTimeout *msg = new MsgTxTimeout;
@@ -853,19 +1046,30 @@ void NetUplink::setFallbackActive(bool activate)
     cout << name << ": Activating fallback repeater mode\n";
     tx->setTxCtrlMode(Tx::TX_AUTO);
     tx_selector->selectSource(loopback_con);
-    rx->setMuteState(Rx::MUTE_NONE);
+    setRxMuteState(Rx::MUTE_NONE);
   }
   else
   {
     cout << name << ": Deactivating fallback repeater mode\n";
     tx->setTxCtrlMode(Tx::TX_OFF);
-    tx_selector->selectSource(fifo);
+    tx_selector->selectSource(playout);
   }
 } /* NetUplink::setFallbackActive */
 
 
 void NetUplink::signalLevelUpdated(float siglev)
 {
+    // While the squelch is open the audio is flowing so the signal level is
+    // sent in the next audio datagram instead of in its own TCP message. If
+    // the audio stops anyway, the TCP message is used when the stream is
+    // full.
+  if (siglev_stream && udp_active && (state == STATE_READY) &&
+      rx->squelchIsOpen() &&
+      udp_siglev.add(rx->signalStrength(), rx->sqlRxId()))
+  {
+    return;
+  }
+  udp_siglev.clear();
   MsgSiglevUpdate *msg = new MsgSiglevUpdate(rx->signalStrength(),
 					     rx->sqlRxId());
   sendMsg(msg);  
@@ -879,6 +1083,152 @@ void NetUplink::forceDisconnect(void)
 } /* NetUplink::forceDisconnect */
 
 
+void NetUplink::closeUdp(void)
+{
+  if (udp_active)
+  {
+    cout << name << ": Using TCP for audio\n";
+  }
+  udp_setup = false;
+  udp_active = false;
+  udp_peer_port = 0;
+  udp_siglev.clear();
+  udp_heartbeat_timer->setEnable(false);
+  if (flush_guard_timer->isEnabled())
+  {
+    flushGuardExpired(flush_guard_timer);
+  }
+} /* NetUplink::closeUdp */
+
+
+void NetUplink::sendUdpMsg(uint16_t type, const struct iovec *iov, int iovcnt)
+{
+  if (udp_peer_port == 0)
+  {
+    return;
+  }
+  assert(iovcnt <= 3);
+  UdpMsg hdr(type, udp_tx_seq++, udp_token);
+  struct iovec dgram_iov[4];
+  dgram_iov[0].iov_base = &hdr;
+  dgram_iov[0].iov_len = sizeof(hdr);
+  for (int i=0; i<iovcnt; ++i)
+  {
+    dgram_iov[i+1] = iov[i];
+  }
+  udp_sock->write(udp_peer_addr, udp_peer_port, dgram_iov, iovcnt + 1);
+} /* NetUplink::sendUdpMsg */
+
+
+void NetUplink::udpDataReceived(const IpAddress& addr, uint16_t port,
+                                void *buf, int count)
+{
+  if ((state != STATE_READY) || !udp_setup || (con == 0) ||
+      (addr != con->remoteHost()) ||
+      (count < static_cast<int>(sizeof(UdpMsg))))
+  {
+    return;
+  }
+  UdpMsg hdr(0, 0, 0);
+  memcpy(&hdr, buf, sizeof(hdr));
+  if (hdr.token() != udp_token)
+  {
+    return;
+  }
+
+    // The first valid datagram tell us where to send datagrams. A new
+    // source port is accepted at any time since NAT mappings may change.
+  if ((udp_peer_port != port) || (udp_peer_addr != addr))
+  {
+    udp_peer_addr = addr;
+    udp_peer_port = port;
+    udp_rx_seq = hdr.seq();
+  }
+  else if (static_cast<int16_t>(hdr.seq() - udp_rx_seq) < 0)
+  {
+    return;   // Late or duplicated datagram
+  }
+  udp_rx_seq = hdr.seq() + 1;
+  gettimeofday(&last_udp_timestamp, NULL);
+  if (!udp_active)
+  {
+    cout << name << ": Using UDP for audio\n";
+    udp_active = true;
+    sendUdpMsg(UdpMsg::TYPE_HEARTBEAT);
+  }
+
+    // The audio message is handled directly in the datagram buffer
+  unsigned len = count - sizeof(hdr);
+  char *payload = static_cast<char*>(buf) + sizeof(hdr);
+  Msg *msg = reinterpret_cast<Msg*>(payload);
+  if ((hdr.type() == UdpMsg::TYPE_AUDIO) &&
+      (len >= sizeof(MsgAudioHeader)) && (len <= sizeof(MsgAudio)) &&
+      (msg->type() == MsgAudio::TYPE) && (msg->size() == len) &&
+      (sizeof(MsgAudioHeader) +
+       reinterpret_cast<MsgAudio*>(msg)->size() == len))
+  {
+    AudioLatencyTrace::Scope latency_scope(udp_latency_mark);
+    if (udp_latency_mark != 0)
+    {
+      AudioLatencyTrace::record("nettrx", udp_latency_mark);
+      udp_latency_mark = 0;
+    }
+    handleMsg(msg);
+  }
+  else if ((hdr.type() == UdpMsg::TYPE_LATENCY_MARK) &&
+           (len == sizeof(udp_latency_mark)))
+  {
+    memcpy(&udp_latency_mark, payload, sizeof(udp_latency_mark));
+  }
+  else if ((hdr.type() == UdpMsg::TYPE_PLAYOUT_DEADLINE) &&
+           (len == sizeof(uint64_t)))
+  {
+    uint64_t deadline;
+    memcpy(&deadline, payload, sizeof(deadline));
+    playout->setDeadline(deadline);
+  }
+  else if ((hdr.type() == UdpMsg::TYPE_PING) && (len == sizeof(uint32_t)))
+  {
+      // Echo the timestamp so that the client can measure the round trip time
+    struct iovec iov;
+    iov.iov_base = payload;
+    iov.iov_len = len;
+    sendUdpMsg(UdpMsg::TYPE_PONG, &iov, 1);
+  }
+} /* NetUplink::udpDataReceived */
+
+
+void NetUplink::udpHeartbeat(Timer *t)
+{
+  sendUdpMsg(UdpMsg::TYPE_HEARTBEAT);
+
+  if (udp_active)
+  {
+    struct timeval diff_tv;
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    timersub(&now, &last_udp_timestamp, &diff_tv);
+    int diff_ms = diff_tv.tv_sec * 1000 + diff_tv.tv_usec / 1000;
+    if (diff_ms > NET_TRX_UDP_TIMEOUT)
+    {
+      cerr << "*** WARNING: UDP audio timeout in NetUplink " << name
+           << ". Falling back to TCP.\n";
+      udp_active = false;
+    }
+  }
+} /* NetUplink::udpHeartbeat */
+
+
+void NetUplink::flushGuardExpired(Timer *t)
+{
+  flush_guard_timer->setEnable(false);
+  if (audio_dec != 0)
+  {
+    audio_dec->flushEncodedSamples();
+  }
+} /* NetUplink::flushGuardExpired */
+
+
 /*
  * This file has not been truncated
  */
@@ -47,6 +47,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncTcpConnection.h>
+#include <AsyncIpAddress.h>
 #include <NetTrxMsg.h>
 
 
@@ -57,6 +58,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "Uplink.h"
+#include "SharedAudioEncoder.h"
 
 
 
@@ -77,6 +79,7 @@ namespace Async
   class AudioSplitter;
   class AudioSelector;
   class AudioPassthrough;
+  class UdpSocket;
 };
 
 namespace NetTrxMsg
@@ -100,6 +103,7 @@ namespace NetTrxMsg
  *
  ****************************************************************************/
 
+class PlayoutBuffer;
 
 
 /****************************************************************************
@@ -131,7 +135,7 @@ namespace NetTrxMsg
 
 This class implements a remote transceiver uplink via an IP network.
 */
-class NetUplink : public Uplink
+class NetUplink : public Uplink, private SharedAudioEncoder::Subscriber
 {
   public:
     /**
@@ -173,11 +177,15 @@ class NetUplink : public Uplink
     Rx	      	      	    *rx;
     Tx	      	      	    *tx;
     Async::AudioFifo  	    *fifo;
+    PlayoutBuffer           *playout;
     Async::Config     	    &cfg;
     std::string       	    name;
     struct timeval    	    last_msg_timestamp;
     Async::Timer      	    *heartbeat_timer;
     Async::AudioEncoder     *audio_enc;
+    SharedAudioEncoder      *shared_enc;
+    bool                    share_rx_encoder;
+    Rx::MuteState           rx_mute_state;
     Async::AudioDecoder     *audio_dec;
     Async::AudioPassthrough *loopback_con;
     Async::AudioSplitter    *rx_splitter;
@@ -190,6 +198,20 @@ class NetUplink : public Uplink
     bool		    tx_muted;
     bool                    fallback_enabled;
     Tx::TxCtrlMode	    tx_ctrl_mode;
+    Async::UdpSocket        *udp_sock;
+    Async::Timer            *udp_heartbeat_timer;
+    Async::Timer            *flush_guard_timer;
+    bool                    udp_setup;
+    uint32_t                udp_token;
+    Async::IpAddress        udp_peer_addr;
+    uint16_t                udp_peer_port;
+    uint16_t                udp_tx_seq;
+    uint16_t                udp_rx_seq;
+    bool                    udp_active;
+    struct timeval          last_udp_timestamp;
+    uint64_t                udp_latency_mark;
+    bool                    siglev_stream;
+    NetTrxMsg::UdpSiglevStream  udp_siglev;
     
     NetUplink(const NetUplink&);
     NetUplink& operator=(const NetUplink&);
@@ -201,6 +223,8 @@ class NetUplink : public Uplink
     int tcpDataReceived(Async::TcpConnection *con, void *data, int size);
     void handleMsg(NetTrxMsg::Msg *msg);
     void sendMsg(NetTrxMsg::Msg *msg);
+    void sendAudio(const void *buf, int size);
+    void writeMsg(const struct iovec *iov, int iovcnt, unsigned size);
 
     /**
      * @brief 	Set squelch state to open/closed
@@ -227,7 +251,11 @@ class NetUplink : public Uplink
     void selcallSequenceDetected(std::string sequence);
 
 
-    void writeEncodedSamples(const void *buf, int size);
+    virtual Async::AudioSplitter *encoderFeed(void) { return rx_splitter; }
+    virtual bool wantEncodedAudio(void) const;
+    virtual void writeEncodedSamples(const void *buf, int size);
+    void setRxMuteState(Rx::MuteState new_mute_state);
+    void releaseAudioEncoder(void);
     void txTimeout(void);
     void transmitterStateChange(bool is_transmitting);
     void allEncodedSamplesFlushed(void);
@@ -238,6 +266,12 @@ class NetUplink : public Uplink
     void signalLevelUpdated(float siglev);
     void forceDisconnect(void);
     void setState(State new_state) { state = new_state; }
+    void closeUdp(void);
+    void sendUdpMsg(uint16_t type, const struct iovec *iov=0, int iovcnt=0);
+    void udpDataReceived(const Async::IpAddress& addr, uint16_t port,
+                         void *buf, int count);
+    void udpHeartbeat(Async::Timer *t);
+    void flushGuardExpired(Async::Timer *t);
 
 };  /* class NetUplink */
 
@@ -0,0 +1,258 @@
+/**
+@file   SharedAudioEncoder.cpp
+@brief  An audio encoder shared between a number of uplinks
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+RemoteTrx - A remote receiver for the SvxLink server
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioEncoder.h>
+#include <AsyncAudioSplitter.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "SharedAudioEncoder.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+SharedAudioEncoder::EncoderMap SharedAudioEncoder::encoders;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+SharedAudioEncoder *SharedAudioEncoder::subscribe(Subscriber *sub,
+                                                  const std::string& rx_name,
+                                                  const std::string& codec,
+                                                  const Opts& opts)
+{
+  string key(rx_name + "/" + codec);
+  for (Opts::const_iterator it=opts.begin(); it!=opts.end(); ++it)
+  {
+    key += "/" + (*it).first + "=" + (*it).second;
+  }
+
+  SharedAudioEncoder *shared_enc = 0;
+  EncoderMap::iterator it = encoders.find(key);
+  if (it != encoders.end())
+  {
+    shared_enc = (*it).second;
+  }
+  else
+  {
+    AudioEncoder *enc = AudioEncoder::create(codec);
+    if (enc == 0)
+    {
+      return 0;
+    }
+    for (Opts::const_iterator oit=opts.begin(); oit!=opts.end(); ++oit)
+    {
+      enc->setOption((*oit).first, (*oit).second);
+    }
+    enc->printCodecParams();
+    shared_enc = new SharedAudioEncoder(key, enc);
+    encoders[key] = shared_enc;
+  }
+
+  shared_enc->m_subs.push_back(sub);
+  shared_enc->updateFeed();
+  return shared_enc;
+} /* SharedAudioEncoder::subscribe */
+
+
+void SharedAudioEncoder::unsubscribe(Subscriber *sub)
+{
+  Subscribers::iterator it = find(m_subs.begin(), m_subs.end(), sub);
+  assert(it != m_subs.end());
+  m_subs.erase(it);
+  if (m_subs.empty())
+  {
+    delete this;
+    return;
+  }
+  if (sub == m_feed)
+  {
+    setFeed(0);
+  }
+  updateFeed();
+} /* SharedAudioEncoder::unsubscribe */
+
+
+void SharedAudioEncoder::updateFeed(void)
+{
+  if ((m_feed != 0) && m_feed->wantEncodedAudio())
+  {
+    return;
+  }
+  for (Subscribers::iterator it=m_subs.begin(); it!=m_subs.end(); ++it)
+  {
+    if ((*it)->wantEncodedAudio())
+    {
+      setFeed(*it);
+      return;
+    }
+  }
+  if (m_feed == 0)
+  {
+    setFeed(m_subs.front());
+  }
+} /* SharedAudioEncoder::updateFeed */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+SharedAudioEncoder::SharedAudioEncoder(const std::string& key,
+                                       AudioEncoder *enc)
+  : m_key(key), m_enc(enc), m_feed(0)
+{
+  m_enc->writeEncodedSamples.connect(
+      mem_fun(*this, &SharedAudioEncoder::onEncodedSamples));
+  m_enc->flushEncodedSamples.connect(
+      mem_fun(*m_enc, &AudioEncoder::allEncodedSamplesFlushed));
+} /* SharedAudioEncoder::SharedAudioEncoder */
+
+
+SharedAudioEncoder::~SharedAudioEncoder(void)
+{
+  setFeed(0);
+  encoders.erase(m_key);
+  delete m_enc;
+} /* SharedAudioEncoder::~SharedAudioEncoder */
+
+
+void SharedAudioEncoder::setFeed(Subscriber *sub)
+{
+  if (sub == m_feed)
+  {
+    return;
+  }
+  if (m_feed != 0)
+  {
+    m_feed->encoderFeed()->removeSink(m_enc);
+  }
+  m_feed = sub;
+  if (m_feed != 0)
+  {
+    m_feed->encoderFeed()->addSink(m_enc);
+  }
+} /* SharedAudioEncoder::setFeed */
+
+
+void SharedAudioEncoder::onEncodedSamples(const void *buf, int size)
+{
+  for (Subscribers::iterator it=m_subs.begin(); it!=m_subs.end(); ++it)
+  {
+    if ((*it)->wantEncodedAudio())
+    {
+      (*it)->writeEncodedSamples(buf, size);
+    }
+  }
+} /* SharedAudioEncoder::onEncodedSamples */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,210 @@
+/**
+@file   SharedAudioEncoder.h
+@brief  An audio encoder shared between a number of uplinks
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+RemoteTrx - A remote receiver for the SvxLink server
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef SHARED_AUDIO_ENCODER_INCLUDED
+#define SHARED_AUDIO_ENCODER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class AudioEncoder;
+  class AudioSplitter;
+};
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	An audio encoder shared between a number of uplinks
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+When a number of net uplinks use the same receiver configuration and their
+clients ask for the same codec with the same options, they will all send
+exactly the same encoded audio. This class make it possible for them to share
+a single encoder so that the audio is only encoded once.
+
+The encoder is fed from the receiver of one of the subscribers. If that
+receiver is muted, another subscriber with an unmuted receiver is chosen. The
+encoded audio is only passed on to subscribers that currently want audio.
+*/
+class SharedAudioEncoder : public sigc::trackable
+{
+  public:
+    typedef std::vector<std::pair<std::string, std::string> > Opts;
+
+    /**
+     * @brief   The interface that a user of a shared encoder must implement
+     */
+    class Subscriber
+    {
+      public:
+        virtual ~Subscriber(void) {}
+
+        /**
+         * @brief   Get the audio source that can feed the encoder
+         * @return  Returns the splitter for the receiver audio
+         */
+        virtual Async::AudioSplitter *encoderFeed(void) = 0;
+
+        /**
+         * @brief   Check if the subscriber currently want audio
+         * @return  Returns \em true if the receiver of the subscriber is
+         *          not muted
+         */
+        virtual bool wantEncodedAudio(void) const = 0;
+
+        /**
+         * @brief   Handle encoded audio
+         * @param   buf   The buffer containing the encoded audio
+         * @param   size  The size of the buffer
+         */
+        virtual void writeEncodedSamples(const void *buf, int size) = 0;
+    };
+
+    /**
+     * @brief   Subscribe to a shared encoder
+     * @param   sub     The subscriber
+     * @param   rx_name The name of the receiver configuration
+     * @param   codec   The name of the codec
+     * @param   opts    Encoder options
+     * @return  Returns the shared encoder or 0 if the codec is unknown
+     *
+     * If there is no encoder for the given receiver, codec and options yet,
+     * a new one is created.
+     */
+    static SharedAudioEncoder *subscribe(Subscriber *sub,
+                                         const std::string& rx_name,
+                                         const std::string& codec,
+                                         const Opts& opts);
+
+    /**
+     * @brief   Unsubscribe from the encoder
+     * @param   sub The subscriber to remove
+     *
+     * The encoder is deleted when the last subscriber is removed so the
+     * object must not be used after calling this function.
+     */
+    void unsubscribe(Subscriber *sub);
+
+    /**
+     * @brief   Choose which subscriber that should feed the encoder
+     *
+     * This function must be called by a subscriber when the value returned
+     * by its wantEncodedAudio function changes.
+     */
+    void updateFeed(void);
+
+    /**
+     * @brief   Get the encoder
+     * @return  Returns the audio encoder
+     */
+    Async::AudioEncoder *encoder(void) { return m_enc; }
+
+  private:
+    typedef std::map<std::string, SharedAudioEncoder*> EncoderMap;
+    typedef std::vector<Subscriber*> Subscribers;
+
+    static EncoderMap encoders;
+
+    std::string           m_key;
+    Async::AudioEncoder*  m_enc;
+    Subscribers           m_subs;
+    Subscriber*           m_feed;
+
+    SharedAudioEncoder(const std::string& key, Async::AudioEncoder *enc);
+    ~SharedAudioEncoder(void);
+    SharedAudioEncoder(const SharedAudioEncoder&);
+    SharedAudioEncoder& operator=(const SharedAudioEncoder&);
+    void setFeed(Subscriber *sub);
+    void onEncodedSamples(const void *buf, int size);
+
+};  /* class SharedAudioEncoder */
+
+
+#endif /* SHARED_AUDIO_ENCODER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
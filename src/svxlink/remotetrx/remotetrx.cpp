@@ -65,7 +65,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncCppApplication.h>
 #include <AsyncConfig.h>
 #include <AsyncFdWatch.h>
+#include <AsyncLogWriter.h>
 #include <AsyncAudioIO.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncAudioLatencyTrace.h>
+#include <AsyncAudioLatencyBudget.h>
+#include <AsyncAudioWorkerPool.h>
+#include <AsyncThreadScheduling.h>
+#include <AsyncAudioCpuFeatures.h>
 #include <Rx.h>
 #include <Tx.h>
 #include <common.h>
@@ -157,14 +164,9 @@ class NetTxAdapterFactory : public TxFactory
 
 static void parse_arguments(int argc, const char **argv);
 static void stdinHandler(FdWatch *w);
-static void stdout_handler(FdWatch *w);
 static void sighup_handler(int signal);
 static void sigterm_handler(int signal);
 static void handle_unix_signal(int signum);
-static bool logfile_open(void);
-static void logfile_reopen(const char *reason);
-static bool logfile_write_timestamp(void);
-static void logfile_write(const char *buf);
 static void logfile_flush(void);
 
 
@@ -188,9 +190,8 @@ static char             *logfile_name = NULL;
 static char             *runasuser = NULL;
 static char   	      	*config = NULL;
 static int    	      	daemonize = 0;
-static int    	      	logfd = -1;
 static FdWatch	      	*stdin_watch = 0;
-static FdWatch	      	*stdout_watch = 0;
+static LogWriter        *log_writer = 0;
 static string         	tstamp_format;
 
 
@@ -244,7 +245,8 @@ int main(int argc, char **argv)
   if (logfile_name != 0)
   {
       /* Open the logfile */
-    if (!logfile_open())
+    log_writer = new LogWriter;
+    if (!log_writer->open(logfile_name))
     {
       exit(1);
     }
@@ -267,8 +269,10 @@ int main(int argc, char **argv)
       perror("fcntl(..., F_SETFL)");
       exit(1);
     }
-    stdout_watch = new FdWatch(pipefd[0], FdWatch::FD_WATCH_RD);
-    stdout_watch->activity.connect(sigc::ptr_fun(&stdout_handler));
+    if (!log_writer->start(pipefd[0]))
+    {
+      exit(1);
+    }
 
       /* Redirect stdout to the logpipe */
     if (dup2(pipefd[1], STDOUT_FILENO) == -1)
@@ -377,6 +381,10 @@ int main(int argc, char **argv)
   }
   
   tstamp_format = "%c";
+  if (log_writer != 0)
+  {
+    log_writer->setTimestampFormat(tstamp_format);
+  }
 
   Config cfg;
   string cfg_filename;
@@ -472,6 +480,10 @@ int main(int argc, char **argv)
   }
   
   cfg.getValue("GLOBAL", "TIMESTAMP_FORMAT", tstamp_format);
+  if (log_writer != 0)
+  {
+    log_writer->setTimestampFormat(tstamp_format);
+  }
   
   cout << PROGRAM_NAME " v" REMOTE_TRX_VERSION
           " Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX\n\n";
@@ -482,8 +494,41 @@ int main(int argc, char **argv)
   cout << "GNU GPL (General Public License) version 2 or later.\n";
 
   cout << "\nUsing configuration file: " << main_cfg_filename << endl;
+
+  if (!ThreadScheduling::configure(cfg, "GLOBAL"))
+  {
+    exit(1);
+  }
   
   string value;
+  if (cfg.getValue("GLOBAL", "INTERNAL_SAMPLE_RATE", value))
+  {
+    int rate = atoi(value.c_str());
+    if (!AudioSampleRate::setInternal(rate))
+    {
+      cerr << "*** ERROR: Illegal internal sample rate specified for "
+              "config variable GLOBAL/INTERNAL_SAMPLE_RATE. Valid rates are "
+              "8000 and 16000\n";
+      exit(1);
+    }
+      // The sound card use the internal sample rate unless CARD_SAMPLE_RATE
+      // is set
+    AudioIO::setSampleRate(rate);
+    cout << "--- Using internal sample rate " << rate << "Hz\n";
+  }
+
+  if (cfg.getValue("GLOBAL", "DSP_SIMD", value))
+  {
+    if (!AudioCpuFeatures::setLimit(value))
+    {
+      cerr << "*** ERROR: Illegal value \"" << value << "\" for config "
+              "variable GLOBAL/DSP_SIMD. Valid values are native, scalar, "
+              "sse, sse2, avx, avx2, avx512 and neon\n";
+      exit(1);
+    }
+    cout << "--- Using SIMD features for DSP: "
+         << AudioCpuFeatures::toString(AudioCpuFeatures::enabled()) << endl;
+  }
   if (cfg.getValue("GLOBAL", "CARD_SAMPLE_RATE", value))
   {
     int rate = atoi(value.c_str());
@@ -497,21 +542,24 @@ int main(int argc, char **argv)
       AudioIO::setBlocksize(512);
       AudioIO::setBlockCount(2);
     }
-    #if INTERNAL_SAMPLE_RATE <= 8000
-    else if (rate == 8000)
+    else if ((rate == 8000) && (INTERNAL_SAMPLE_RATE <= 8000))
     {
       AudioIO::setBlocksize(256);
       AudioIO::setBlockCount(2);
     }
-    #endif
+    else if ((rate >= 11025) && (rate <= 192000))
+    {
+        // Other rates, like 44100, are converted using a resampler
+      AudioIO::setBlocksize((rate > 16000) ? 1024 : 512);
+      AudioIO::setBlockCount((rate > 16000) ? 4 : 2);
+    }
     else
     {
       cerr << "*** ERROR: Illegal sound card sample rate specified for "
       	      "config variable GLOBAL/CARD_SAMPLE_RATE. Valid rates are "
-	      #if INTERNAL_SAMPLE_RATE <= 8000
-	      "8000, "
-	      #endif
-	      "16000 and 48000\n";
+           << ((INTERNAL_SAMPLE_RATE <= 8000) ? "8000, " : "")
+           << "16000 and 48000 or, using a resampler, any rate between "
+              "11025 and 192000\n";
       exit(1);
     }
     AudioIO::setSampleRate(rate);
@@ -522,6 +570,28 @@ int main(int argc, char **argv)
   cfg.getValue("GLOBAL", "CARD_CHANNELS", card_channels);
   AudioIO::setChannels(card_channels);
 
+  unsigned latency_trace_interval = 0;
+  cfg.getValue("GLOBAL", "AUDIO_LATENCY_TRACE", latency_trace_interval);
+  AudioLatencyTrace::setInterval(latency_trace_interval);
+
+  bool latency_budget = false;
+  cfg.getValue("GLOBAL", "LATENCY_BUDGET", latency_budget);
+  AudioLatencyBudget::setEnabled(latency_budget);
+
+  unsigned dsp_threads = 0;
+  cfg.getValue("GLOBAL", "DSP_THREADS", dsp_threads);
+  if (dsp_threads > 0)
+  {
+    if (!AudioWorkerPool::startShared(dsp_threads))
+    {
+      cerr << "*** ERROR: Could not start the audio worker threads given by "
+              "config variable GLOBAL/DSP_THREADS\n";
+      exit(1);
+    }
+    cout << "--- Running receiver audio processing on " << dsp_threads
+         << " worker thread(s)\n";
+  }
+
   struct termios org_termios = {0};
   if (logfile_name == 0)
   {
@@ -582,18 +652,15 @@ int main(int argc, char **argv)
     tcsetattr(STDIN_FILENO, TCSANOW, &org_termios);
   }
 
-  if (stdout_watch != 0)
+  if (log_writer != 0)
   {
-    delete stdout_watch;
+    log_writer->stop();
+    delete log_writer;
+    log_writer = 0;
     close(pipefd[0]);
     close(pipefd[1]);
   }
 
-  if (logfd != -1)
-  {
-    close(logfd);
-  }
-  
   return 0;
   
 } /* main */
@@ -706,6 +773,11 @@ static void stdinHandler(FdWatch *w)
     case '\n':
       putchar('\n');
       break;
+
+    case 'L':
+      AudioLatencyTrace::report(cout);
+      AudioLatencyBudget::report(cout);
+      break;
     /*
     case '0': case '1': case '2': case '3':
     case '4': case '5': case '6': case '7':
@@ -720,22 +792,6 @@ static void stdinHandler(FdWatch *w)
 }
 
 
-static void stdout_handler(FdWatch *w)
-{
-  ssize_t len =  0;
-  do
-  {
-    char buf[256];
-    len = read(w->fd(), buf, sizeof(buf)-1);
-    if (len > 0)
-    {
-      buf[len] = 0;
-      logfile_write(buf);
-    }
-  } while (len > 0);
-} /* stdout_handler  */
-
-
 static void sighup_handler(int signal)
 {
   if (logfile_name == 0)
@@ -743,7 +799,7 @@ static void sighup_handler(int signal)
     cout << "Ignoring SIGHUP\n";
     return;
   }
-  logfile_reopen("SIGHUP received");
+  log_writer->reopen("SIGHUP received");
 } /* sighup_handler */
 
 
@@ -765,7 +821,7 @@ void sigterm_handler(int signal)
   string msg("\n");
   msg += signame;
   msg += " received. Shutting down application...\n";
-  logfile_write(msg.c_str());
+  cout << msg << flush;
   Application::app().quit();
 } /* sigterm_handler */
 
@@ -785,129 +841,13 @@ static void handle_unix_signal(int signum)
 } /* handle_unix_signal */
 
 
-static bool logfile_open(void)
-{
-  if (logfd != -1)
-  {
-    close(logfd);
-  }
-  
-  logfd = open(logfile_name, O_WRONLY | O_APPEND | O_CREAT, 00644);
-  if (logfd == -1)
-  {
-    ostringstream ss;
-    ss << "open(\"" << logfile_name << "\")";
-    perror(ss.str().c_str());
-    return false;
-  }
-
-  return true;
-  
-} /* logfile_open */
-
-
-static void logfile_reopen(const char *reason)
-{
-  logfile_write_timestamp();
-  string msg(reason);
-  msg += ". Reopening logfile\n";
-  if (write(logfd, msg.c_str(), msg.size()) == -1) {}
-
-  logfile_open();
-
-  logfile_write_timestamp();
-  msg = reason;
-  msg += ". Logfile reopened\n";
-  if (write(logfd, msg.c_str(), msg.size()) == -1) {}
-} /* logfile_reopen */
-
-
-static bool logfile_write_timestamp(void)
-{
-  if (!tstamp_format.empty())
-  {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    string fmt(tstamp_format);
-    const string frac_code("%f");
-    size_t pos = fmt.find(frac_code);
-    if (pos != string::npos)
-    {
-      stringstream ss;
-      ss << setfill('0') << setw(3) << (tv.tv_usec / 1000);
-      fmt.replace(pos, frac_code.length(), ss.str());
-    }
-    struct tm *tm = localtime(&tv.tv_sec);
-    char tstr[256];
-    size_t tlen = strftime(tstr, sizeof(tstr), fmt.c_str(), tm);
-    ssize_t ret = write(logfd, tstr, tlen);
-    if (ret != static_cast<ssize_t>(tlen))
-    {
-      return false;
-    }
-    ret = write(logfd, ": ", 2);
-    if (ret != 2)
-    {
-      return false;
-    }
-  }
-  return true;
-} /* logfile_write_timestamp */
-
-
-static void logfile_write(const char *buf)
-{
-  if (logfd == -1)
-  {
-    cout << buf;
-    return;
-  }
-  
-  const char *ptr = buf;
-  while (*ptr != 0)
-  {
-    static bool print_timestamp = true;
-    ssize_t ret;
-    
-    if (print_timestamp)
-    {
-      if (!logfile_write_timestamp())
-      {
-        logfile_reopen("Write error");
-        return;
-      }
-      print_timestamp = false;
-    }
-
-    size_t write_len = 0;
-    const char *nl = strchr(ptr, '\n');
-    if (nl != 0)
-    {
-      write_len = nl-ptr+1;
-      print_timestamp = true;
-    }
-    else
-    {
-      write_len = strlen(ptr);
-    }
-    ret = write(logfd, ptr, write_len);
-    if (ret != static_cast<ssize_t>(write_len))
-    {
-      logfile_reopen("Write error");
-      return;
-    }
-    ptr += write_len;
-  }
-} /* logfile_write */
-
-
 static void logfile_flush(void)
 {
   cout.flush();
   cerr.flush();
-  if (stdout_watch != 0)
+  if (log_writer != 0)
   {
-    stdout_handler(stdout_watch);
+    log_writer->flush();
   }
 } /*  logfile_flush */
 
@@ -0,0 +1,408 @@
+#!/usr/bin/env python3
+#
+# Whole node capacity benchmark for SvxLink
+#
+# Start one svxlink process with N logic cores, each fed by a simulated
+# receiver (RX type LocalSim) and transmitting to a dummy transmitter, and
+# measure how much CPU and memory that the process use and how the main loop
+# latency behave. A sweep over several values of N give the number of logics
+# that one core can handle.
+#
+# The simulated receivers key up periodically with voice like noise and may
+# also send a CTCSS tone and a DTMF sequence. Optionally each RF logic can be
+# linked to its own ReflectorLogic so that the network path is included.
+#
+# The main loop latency is read from the Prometheus endpoint, which is
+# enabled using GLOBAL/METRICS_HTTP_PORT. The histograms are sampled before
+# and after the measurement window so that the startup is not included.
+#
+# Example:
+#   svxlink_capacity_bench.py --svxlink ./bin/svxlink --sweep 1,2,4,8,16
+#
+
+import argparse
+import glob
+import json
+import os
+import re
+import shutil
+import signal
+import subprocess
+import sys
+import tempfile
+import time
+import urllib.request
+
+
+LAT_METRICS = ("async_loop_timer_lag_seconds", "async_loop_iteration_seconds")
+QUANTILES = (0.5, 0.9, 0.99, 0.999)
+
+
+def find_source_dir():
+    """Return the src/svxlink directory that this script is located in"""
+    return os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def make_share_dir(dest):
+    """Assemble a share directory from the source tree
+
+    The layout is the same as the installed one. Sound clips are not
+    included so announcements will only produce warnings.
+    """
+    src = find_source_dir()
+    events_d = os.path.join(dest, "events.d")
+    modules_d = os.path.join(dest, "modules.d")
+    os.makedirs(events_d)
+    os.makedirs(modules_d)
+    shutil.copy(os.path.join(src, "svxlink", "events.tcl"), dest)
+    for name in ("RepeaterLogic.tcl", "SimplexLogic.tcl", "ReflectorLogic.tcl",
+                 "Module.tcl", "Logic.tcl", "CW.tcl", "SelCall.tcl",
+                 "locale.tcl"):
+        shutil.copy(os.path.join(src, "svxlink", name), events_d)
+    for path in glob.glob(os.path.join(src, "modules", "*", "*.tcl")):
+        name = os.path.basename(path)
+        if name.startswith("Module"):
+            shutil.copy(path, modules_d)
+        else:
+            shutil.copy(path, events_d)
+
+        # The events.tcl script require at least one file in modules.d
+    with open(os.path.join(modules_d, "CapacityBench.tcl"), "w") as f:
+        f.write("# Placeholder created by svxlink_capacity_bench.py\n")
+
+
+def write_config(path, args, logics, metrics_port):
+    """Write a svxlink configuration file for the given number of logics"""
+    event_handler = os.path.join(args.share_dir, "events.tcl")
+    rf_logics = ["Logic%d" % i for i in range(logics)]
+    ref_logics = []
+    links = []
+    out = []
+
+    if args.reflector:
+        ref_logics = ["Ref%d" % i for i in range(logics)]
+        links = ["Link%d" % i for i in range(logics)]
+
+    out.append("[GLOBAL]")
+    out.append("LOGICS=%s" % ",".join(rf_logics + ref_logics))
+    if links:
+        out.append("LINKS=%s" % ",".join(links))
+    out.append("TIMESTAMP_FORMAT=\"%c\"")
+    out.append("CARD_SAMPLE_RATE=48000")
+    out.append("METRICS_HTTP_PORT=%d" % metrics_port)
+    out.append("")
+
+    for i, logic in enumerate(rf_logics):
+        out.append("[%s]" % logic)
+        out.append("TYPE=%s" % ("Repeater" if args.repeater else "Simplex"))
+        out.append("RX=Rx%d" % i)
+        out.append("TX=Tx%d" % i)
+        out.append("CALLSIGN=BENCH%d" % i)
+        out.append("EVENT_HANDLER=%s" % event_handler)
+        out.append("DEFAULT_LANG=en_US")
+        out.append("SHORT_IDENT_INTERVAL=0")
+        out.append("LONG_IDENT_INTERVAL=0")
+        out.append("RGR_SOUND_DELAY=0")
+        if args.repeater:
+            out.append("OPEN_ON_SQL=%d" % min(500, args.key_duration))
+            out.append("IDLE_TIMEOUT=30")
+        out.append("")
+
+        out.append("[Rx%d]" % i)
+        out.append("TYPE=LocalSim")
+        out.append("SIM_WAVEFORM=%s" % ("VOICE" if args.voice else "SIN"))
+        out.append("SIM_TONE_FQ=1000")
+        out.append("SIM_TONE_PWR=-20")
+        out.append("SIM_KEY_INTERVAL=%d" % args.key_interval)
+        out.append("SIM_KEY_DURATION=%d" % args.key_duration)
+        if args.ctcss:
+            out.append("SIM_CTCSS_FQ=%g" % args.ctcss)
+            out.append("SQL_DET=CTCSS")
+            out.append("CTCSS_FQ=%g" % args.ctcss)
+        else:
+            out.append("SQL_DET=VOX")
+            out.append("VOX_FILTER_DEPTH=20")
+            out.append("VOX_THRESH=1000")
+        if args.dtmf:
+            out.append("SIM_DTMF=%s" % args.dtmf)
+        out.append("SQL_START_DELAY=0")
+        out.append("SQL_DELAY=0")
+        out.append("SQL_HANGTIME=200")
+        out.append("DTMF_DEC_TYPE=INTERNAL")
+        out.append("")
+
+        out.append("[Tx%d]" % i)
+        out.append("TYPE=Dummy")
+        out.append("")
+
+    host, _, port = args.reflector.partition(":") if args.reflector else ("",
+                                                                         "", "")
+    for i, logic in enumerate(ref_logics):
+        out.append("[%s]" % logic)
+        out.append("TYPE=Reflector")
+        out.append("HOST=%s" % host)
+        if port:
+            out.append("PORT=%s" % port)
+        out.append("CALLSIGN=\"BENCH%d\"" % i)
+        out.append("AUTH_KEY=\"%s\"" % args.auth_key)
+        out.append("DEFAULT_TG=%d" % (args.tg_base + i))
+        out.append("EVENT_HANDLER=%s" % event_handler)
+        out.append("")
+
+    for i, link in enumerate(links):
+        out.append("[%s]" % link)
+        out.append("CONNECT_LOGICS=%s:9%d:BENCH,%s" %
+                   (rf_logics[i], i, ref_logics[i]))
+        out.append("DEFAULT_ACTIVE=1")
+        out.append("TIMEOUT=0")
+        out.append("")
+
+    with open(path, "w") as f:
+        f.write("\n".join(out))
+
+
+def clock_ticks():
+    return os.sysconf(os.sysconf_names["SC_CLK_TCK"])
+
+
+def read_cpu_ticks(stat_path):
+    """Return utime + stime from a /proc stat file"""
+    with open(stat_path) as f:
+        data = f.read()
+        # The command name may contain spaces so split after it
+    fields = data[data.rindex(")") + 2:].split()
+    return int(fields[11]) + int(fields[12])
+
+
+def read_cpu(pid):
+    """Return the CPU ticks used by the main thread and by all threads"""
+    main = read_cpu_ticks("/proc/%d/task/%d/stat" % (pid, pid))
+    total = read_cpu_ticks("/proc/%d/stat" % pid)
+    return main, total
+
+
+def read_mem(pid):
+    """Return the resident set size and its high water mark in kB"""
+    mem = {}
+    with open("/proc/%d/status" % pid) as f:
+        for line in f:
+            key, _, value = line.partition(":")
+            if key in ("VmRSS", "VmHWM"):
+                mem[key] = int(value.split()[0])
+    return mem.get("VmRSS", 0), mem.get("VmHWM", 0)
+
+
+def fetch_metrics(port):
+    """Fetch the histogram buckets of the latency metrics"""
+    url = "http://127.0.0.1:%d/metrics" % port
+    with urllib.request.urlopen(url, timeout=5) as resp:
+        text = resp.read().decode("utf-8", "replace")
+    hists = dict((name, {}) for name in LAT_METRICS)
+    bucket_re = re.compile(r'^(\w+)_bucket\{.*le="([^"]+)".*\}\s+(\S+)')
+    for line in text.splitlines():
+        m = bucket_re.match(line)
+        if m and m.group(1) in hists:
+            le = float("inf") if m.group(2) == "+Inf" else float(m.group(2))
+            hists[m.group(1)][le] = float(m.group(3))
+    return hists
+
+
+def quantiles(before, after):
+    """Calculate quantiles from the difference of two cumulative histograms
+
+    The upper bucket bound is reported, which is what can be resolved from a
+    histogram.
+    """
+    bounds = sorted(after.keys())
+    counts = [after[le] - before.get(le, 0.0) for le in bounds]
+    result = {"count": int(counts[-1]) if counts else 0}
+    for q in QUANTILES:
+        value = None
+        if counts and counts[-1] > 0:
+            for le, cnt in zip(bounds, counts):
+                if cnt >= q * counts[-1]:
+                    value = le
+                    break
+        result["p%g" % (q * 100)] = value
+    return result
+
+
+def wait_for_metrics(proc, port, timeout):
+    end = time.time() + timeout
+    while time.time() < end:
+        if proc.poll() is not None:
+            return False
+        try:
+            fetch_metrics(port)
+            return True
+        except OSError:
+            time.sleep(0.2)
+    return False
+
+
+def run_one(args, logics, workdir):
+    """Run svxlink with the given number of logics and measure it"""
+    port = args.metrics_port
+    cfg_path = os.path.join(workdir, "svxlink-%d.conf" % logics)
+    log_path = os.path.join(workdir, "svxlink-%d.log" % logics)
+    write_config(cfg_path, args, logics, port)
+
+    proc = subprocess.Popen([args.svxlink, "--config=" + cfg_path,
+                             "--logfile=" + log_path],
+                            stdin=subprocess.DEVNULL,
+                            stdout=subprocess.DEVNULL,
+                            stderr=subprocess.DEVNULL)
+    try:
+        if not wait_for_metrics(proc, port, 30):
+            raise RuntimeError("svxlink did not start, see %s" % log_path)
+        time.sleep(args.warmup)
+        if proc.poll() is not None:
+            raise RuntimeError("svxlink exited, see %s" % log_path)
+
+        hist_before = fetch_metrics(port)
+        cpu_before = read_cpu(proc.pid)
+        t_before = time.monotonic()
+        rss_max = 0
+        end = t_before + args.duration
+        while time.monotonic() < end:
+            time.sleep(min(1.0, max(0.0, end - time.monotonic())))
+            rss_max = max(rss_max, read_mem(proc.pid)[0])
+        cpu_after = read_cpu(proc.pid)
+        t_after = time.monotonic()
+        hist_after = fetch_metrics(port)
+        rss, hwm = read_mem(proc.pid)
+    finally:
+        if proc.poll() is None:
+            proc.send_signal(signal.SIGTERM)
+            try:
+                proc.wait(timeout=10)
+            except subprocess.TimeoutExpired:
+                proc.kill()
+                proc.wait()
+
+    elapsed = (t_after - t_before) * clock_ticks()
+    main_cpu = 100.0 * (cpu_after[0] - cpu_before[0]) / elapsed
+    total_cpu = 100.0 * (cpu_after[1] - cpu_before[1]) / elapsed
+    result = {
+        "logics": logics,
+        "duration": t_after - t_before,
+        "cpu_main_pct": main_cpu,
+        "cpu_total_pct": total_cpu,
+        "cpu_total_pct_per_logic": total_cpu / logics,
+        "rss_kb": max(rss, rss_max),
+        "hwm_kb": hwm,
+    }
+    for name in LAT_METRICS:
+        result[name] = quantiles(hist_before[name], hist_after[name])
+    return result
+
+
+def fmt_ms(value):
+    if value is None:
+        return "-"
+    if value == float("inf"):
+        return ">max"
+    return "%.2f" % (value * 1000.0)
+
+
+def print_table(results):
+    print("%7s %9s %9s %10s %9s %9s %9s %9s %9s" %
+          ("Logics", "Main%", "Total%", "%/logic", "RSS[MB]", "Lag p50",
+           "Lag p99", "Lag p99.9", "Iter p99"))
+    for r in results:
+        lag = r["async_loop_timer_lag_seconds"]
+        itr = r["async_loop_iteration_seconds"]
+        print("%7d %9.1f %9.1f %10.2f %9.1f %9s %9s %9s %9s" %
+              (r["logics"], r["cpu_main_pct"], r["cpu_total_pct"],
+               r["cpu_total_pct_per_logic"], r["rss_kb"] / 1024.0,
+               fmt_ms(lag["p50"]), fmt_ms(lag["p99"]), fmt_ms(lag["p99.9"]),
+               fmt_ms(itr["p99"])))
+    print("Latencies in milliseconds, upper histogram bucket bound")
+    if results:
+        last = results[-1]
+        per_logic = last["cpu_main_pct"] / last["logics"]
+        if per_logic > 0.0:
+            print("Estimated logics per core (main thread): %.0f" %
+                  (100.0 / per_logic))
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(
+        description="Measure how many logic cores one svxlink process can "
+                    "handle using simulated receivers")
+    parser.add_argument("--svxlink", default="svxlink",
+                        help="the svxlink binary to run")
+    parser.add_argument("--share-dir",
+                        help="directory containing events.tcl, default is to "
+                             "assemble one from the source tree")
+    parser.add_argument("-n", "--logics", type=int, default=1,
+                        help="number of RF logics to run")
+    parser.add_argument("--sweep",
+                        help="comma separated list of logic counts to run, "
+                             "overrides --logics")
+    parser.add_argument("--repeater", action="store_true",
+                        help="use repeater logics instead of simplex logics")
+    parser.add_argument("--duration", type=float, default=30.0,
+                        help="measurement window in seconds")
+    parser.add_argument("--warmup", type=float, default=5.0,
+                        help="seconds to run before measuring")
+    parser.add_argument("--voice", action="store_true",
+                        help="send voice like noise instead of a tone")
+    parser.add_argument("--ctcss", type=float, default=0.0,
+                        help="send this CTCSS tone and use a CTCSS squelch")
+    parser.add_argument("--dtmf", default="",
+                        help="DTMF digits to send at each key up")
+    parser.add_argument("--key-interval", type=int, default=10000,
+                        help="milliseconds between key ups")
+    parser.add_argument("--key-duration", type=int, default=5000,
+                        help="milliseconds to stay keyed up")
+    parser.add_argument("--reflector",
+                        help="link each RF logic to a ReflectorLogic "
+                             "connected to HOST[:PORT]")
+    parser.add_argument("--auth-key", default="bench",
+                        help="reflector authentication key")
+    parser.add_argument("--tg-base", type=int, default=9000,
+                        help="first talk group to use for the reflector logics")
+    parser.add_argument("--metrics-port", type=int, default=18093,
+                        help="TCP port for the metrics endpoint")
+    parser.add_argument("--json", action="store_true",
+                        help="print the results as JSON")
+    args = parser.parse_args()
+    if args.key_duration <= 0 or args.key_duration > args.key_interval:
+        parser.error("--key-duration must be between 1 and --key-interval")
+    return args
+
+
+def main():
+    args = parse_args()
+    if args.sweep:
+        counts = [int(n) for n in args.sweep.split(",") if n.strip()]
+    else:
+        counts = [args.logics]
+
+    workdir = tempfile.mkdtemp(prefix="svxlink-bench-")
+    try:
+        if not args.share_dir:
+            args.share_dir = os.path.join(workdir, "share")
+            make_share_dir(args.share_dir)
+        results = []
+        for n in counts:
+            if not args.json:
+                print("Running %d logics..." % n, file=sys.stderr)
+            results.append(run_one(args, n, workdir))
+    except (RuntimeError, OSError) as e:
+        print("*** ERROR: %s" % e, file=sys.stderr)
+        print("The work directory %s is kept" % workdir, file=sys.stderr)
+        return 1
+
+    shutil.rmtree(workdir, ignore_errors=True)
+    if args.json:
+        json.dump(results, sys.stdout, indent=2)
+        print()
+    else:
+        print_table(results)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -6,8 +6,11 @@
 #include <AsyncFdWatch.h>
 #include <AsyncTimer.h>
 #include <AsyncAudioIO.h>
+#include <AsyncAudioSampleRate.h>
 
 #include <LocalRxBase.h>
+#include <LocalRxReplay.h>
+#include <CaptureFile.h>
 
 #include "version/SIGLEV_DET_CAL.h"
 
@@ -22,8 +25,11 @@ static const int ITERATIONS = 150;
 
 static Config cfg;
 static LocalRxBase *rx;
+static LocalRxReplay *replay_rx = 0;
 static double open_sum = 0.0f;
 static double close_sum = 0.0f;
+static int open_cnt = ITERATIONS;
+static int close_cnt = ITERATIONS;
 static float siglev_slope = 10.0;
 static float siglev_offset = 0.0;
 static double ctcss_snr_sum = 0.0;
@@ -72,6 +78,89 @@ void squelchOpen(bool is_open)
 #endif
 
 
+static void print_results(void)
+{
+  float open_close_mean = open_sum / open_cnt - close_sum / close_cnt;
+  float close_mean = close_sum / close_cnt;
+
+  float new_siglev_slope = 100.0 / open_close_mean;
+  float new_siglev_offset = -close_mean * new_siglev_slope;
+  if (ctcss_snr_cnt > 0)
+  {
+    ctcss_close_snr = ctcss_snr_sum / ctcss_snr_cnt;
+  }
+
+  cout << endl;
+  cout << "--- Results\n";
+  printf("Mean SNR for the CTCSS tone              : ");
+  if (ctcss_snr_cnt > 0)
+  {
+    printf("%.1fdB\n",
+           ctcss_open_snr - ctcss_close_snr);
+  }
+  else
+  {
+    printf("N/A (CTCSS not enabled)\n");
+  }
+  printf("Dynamic range for the siglev measurement : %.1fdB\n",
+         10.0 * open_close_mean);
+
+  cout << endl;
+  cout << "--- Put the config variables below in the configuration file\n";
+  cout << "--- section for " << rx->name() << ".\n";
+  printf("SIGLEV_SLOPE=%.2f\n", new_siglev_slope);
+  printf("SIGLEV_OFFSET=%.2f\n", new_siglev_offset);
+  if (ctcss_snr_cnt > 0)
+  {
+    printf("CTCSS_SNR_OFFSET=%.2f\n", ctcss_close_snr);
+  }
+  cout << endl;
+} /* print_results */
+
+
+/*
+ * Feed a capture file through the receiver as fast as possible, sampling the
+ * signal strength every INTERVAL milliseconds of audio just like when
+ * measuring on live audio.
+ */
+static int measure_capture(const string &path, double &sum)
+{
+  CaptureFile file;
+  if (!file.open(path))
+  {
+    exit(1);
+  }
+  if (file.channels() != 1)
+  {
+    cerr << "*** ERROR: The capture file \"" << path << "\" must be mono\n";
+    exit(1);
+  }
+
+  ctcss_snr_sum = 0.0;
+  ctcss_snr_cnt = 0;
+  sum = 0.0;
+  int count = 0;
+  const int block_size = INTERNAL_SAMPLE_RATE * INTERVAL / 1000;
+  float samples[block_size];
+  while ((count < ITERATIONS) &&
+         (file.read(samples, block_size) == block_size))
+  {
+    replay_rx->write(samples, block_size);
+    printf("Signal strength=%.3f\n",
+           siglev_offset + siglev_slope * rx->signalStrength());
+    sum += rx->signalStrength();
+    ++count;
+  }
+  if (count == 0)
+  {
+    cerr << "*** ERROR: The capture file \"" << path << "\" is shorter than "
+         << INTERVAL << "ms\n";
+    exit(1);
+  }
+  return count;
+} /* measure_capture */
+
+
 void sample_squelch_close(Timer *t)
 {
   static int count = 0;
@@ -83,45 +172,7 @@ void sample_squelch_close(Timer *t)
   if (++count == ITERATIONS)
   {
     delete t;
-
-    float open_close_mean = (open_sum - close_sum) / ITERATIONS;
-    float close_mean = close_sum / ITERATIONS;
-
-    float new_siglev_slope = 100.0 / open_close_mean;
-    float new_siglev_offset = -close_mean * new_siglev_slope;
-    if (ctcss_snr_cnt > 0)
-    {
-      ctcss_close_snr = ctcss_snr_sum / ctcss_snr_cnt;
-    }
-
-    cout << endl;
-    cout << "--- Results\n";
-    printf("Mean SNR for the CTCSS tone              : ");
-    if (ctcss_snr_cnt > 0)
-    {
-      printf("%.1fdB\n",
-             ctcss_open_snr - ctcss_close_snr);
-    }
-    else
-    {
-      printf("N/A (CTCSS not enabled)\n");
-    }
-    printf("Dynamic range for the siglev measurement : %.1fdB\n",
-           10.0 * open_close_mean);
-
-    cout << endl;
-    cout << "--- Put the config variables below in the configuration file\n";
-    cout << "--- section for " << rx->name() << ".\n";
-    printf("SIGLEV_SLOPE=%.2f\n", new_siglev_slope);
-    printf("SIGLEV_OFFSET=%.2f\n", new_siglev_offset);
-    if (ctcss_snr_cnt > 0)
-    {
-      printf("CTCSS_SNR_OFFSET=%.2f\n", ctcss_close_snr);
-    }
-    cout << endl;
-    
-    //rx->setVerbose(true);
-    
+    print_results();
     Application::app().quit();
   }
   else
@@ -225,9 +276,10 @@ int main(int argc, char **argv)
           "terms and conditions in\n";
   cout << "the GNU GPL (General Public License) version 2 or later.\n\n";
 
-  if (argc < 3)
+  if ((argc != 3) && (argc != 5))
   {
-    cerr << "Usage: siglevdetcal <config file> <receiver section>\n";
+    cerr << "Usage: siglevdetcal <config file> <receiver section> "
+            "[<strong signal capture> <no signal capture>]\n";
     exit(1);
   }
   string cfg_file(argv[1]);
@@ -240,6 +292,21 @@ int main(int argc, char **argv)
   }
   
   string value;
+  if (cfg.getValue("GLOBAL", "INTERNAL_SAMPLE_RATE", value))
+  {
+    int rate = atoi(value.c_str());
+    if (!AudioSampleRate::setInternal(rate))
+    {
+      cerr << "*** ERROR: Illegal internal sample rate specified for "
+              "config variable GLOBAL/INTERNAL_SAMPLE_RATE. Valid rates are "
+              "8000 and 16000\n";
+      exit(1);
+    }
+      // The sound card use the internal sample rate unless CARD_SAMPLE_RATE
+      // is set
+    AudioIO::setSampleRate(rate);
+    cout << "--- Using internal sample rate " << rate << "Hz\n";
+  }
   if (cfg.getValue("GLOBAL", "CARD_SAMPLE_RATE", value))
   {
     int rate = atoi(value.c_str());
@@ -253,21 +320,24 @@ int main(int argc, char **argv)
       AudioIO::setBlocksize(512);
       AudioIO::setBlockCount(2);
     }
-    #if INTERNAL_SAMPLE_RATE <= 8000
-    else if (rate == 8000)
+    else if ((rate == 8000) && (INTERNAL_SAMPLE_RATE <= 8000))
     {
       AudioIO::setBlocksize(256);
       AudioIO::setBlockCount(2);
     }
-    #endif
+    else if ((rate >= 11025) && (rate <= 192000))
+    {
+        // Other rates, like 44100, are converted using a resampler
+      AudioIO::setBlocksize((rate > 16000) ? 1024 : 512);
+      AudioIO::setBlockCount((rate > 16000) ? 4 : 2);
+    }
     else
     {
       cerr << "*** ERROR: Illegal sound card sample rate specified for "
       	      "config variable GLOBAL/CARD_SAMPLE_RATE. Valid rates are "
-	      #if INTERNAL_SAMPLE_RATE <= 8000
-	      "8000, "
-	      #endif
-	      "16000 and 48000\n";
+           << ((INTERNAL_SAMPLE_RATE <= 8000) ? "8000, " : "")
+           << "16000 and 48000 or, using a resampler, any rate between "
+              "11025 and 192000\n";
       exit(1);
     }
     AudioIO::setSampleRate(rate);
@@ -300,7 +370,23 @@ int main(int argc, char **argv)
   cfg.getValue(rx_name, "SIGLEV_OFFSET", siglev_offset);
   cfg.setValue(rx_name, "SIGLEV_OFFSET", "0.0");
   
-  rx = dynamic_cast<LocalRxBase*>(RxFactory::createNamedRx(cfg, rx_name));
+  if (argc == 5)
+  {
+      // Measure on capture files, recorded from the receiver audio input,
+      // instead of on live audio
+    if (rx_type != "Local")
+    {
+      cerr << "*** ERROR: Capture files can only be used with receivers of "
+           << "type Local\n";
+      exit(1);
+    }
+    replay_rx = new LocalRxReplay(cfg, rx_name);
+    rx = replay_rx;
+  }
+  else
+  {
+    rx = dynamic_cast<LocalRxBase*>(RxFactory::createNamedRx(cfg, rx_name));
+  }
   if (rx == 0)
   {
     cerr << "*** ERROR: The given receiver config section is not for a "
@@ -318,6 +404,21 @@ int main(int argc, char **argv)
   rx->ctcssSnrUpdated.connect(sigc::ptr_fun(&ctcss_snr_updated));
   rx->setMuteState(Rx::MUTE_NONE);
   rx->setVerbose(false);
+
+  if (replay_rx != 0)
+  {
+    cout << "--- Measuring the strong signal capture " << argv[3] << endl;
+    open_cnt = measure_capture(argv[3], open_sum);
+    if (ctcss_snr_cnt > 0)
+    {
+      ctcss_open_snr = ctcss_snr_sum / ctcss_snr_cnt;
+    }
+    cout << "--- Measuring the no signal capture " << argv[4] << endl;
+    close_cnt = measure_capture(argv[4], close_sum);
+    print_results();
+    delete rx;
+    return 0;
+  }
   
   FdWatch *w = new FdWatch(0, FdWatch::FD_WATCH_RD);
   // must explicitly specify name space for ptr_fun() to avoid conflict
@@ -112,55 +112,114 @@ using namespace std;
 
 CmdParser::~CmdParser(void)
 {
-  CmdMap cmds_copy = cmds;
-  CmdMap::iterator it;
-  for (it = cmds_copy.begin(); it != cmds_copy.end(); ++it)
+    // Deleting a command will remove it from the parser so the commands
+    // are collected before deleting them
+  vector<Command *> cmds;
+  collectCmds(&root, cmds);
+  vector<Command *>::iterator it;
+  for (it = cmds.begin(); it != cmds.end(); ++it)
   {
-    delete (*it).second;
+    delete *it;
   }
+  deleteChildren(&root);
 } /* CmdParser::~CmdParser */
 
 
 bool CmdParser::addCmd(Command *cmd)
 {
-  bool cmd_undefined = (cmds.count(cmd->cmdStr()) == 0);
-  if (cmd_undefined)
+  const string& cmd_str = cmd->cmdStr();
+  if (findCmd(cmd_str) != 0)
   {
-    cmds[cmd->cmdStr()] = cmd;
+    return false;
   }
-  return cmd_undefined;
+  Node *node = &root;
+  for (string::const_iterator it = cmd_str.begin(); it != cmd_str.end(); ++it)
+  {
+    Node *&child = node->children[*it];
+    if (child == 0)
+    {
+      child = new Node;
+    }
+    node = child;
+  }
+  node->cmd = cmd;
+  return true;
 } /* CmdParser::addCmd */
 
 
 bool CmdParser::removeCmd(Command *cmd)
 {
-  CmdMap::iterator cmd_it = cmds.find(cmd->cmdStr());
-  bool cmd_exist = (cmd_it != cmds.end());
-  if (cmd_exist)
+  const string& cmd_str = cmd->cmdStr();
+  vector<Node *> path;
+  path.reserve(cmd_str.size() + 1);
+  Node *node = &root;
+  path.push_back(node);
+  for (string::const_iterator it = cmd_str.begin(); it != cmd_str.end(); ++it)
+  {
+    Node::Children::iterator child_it = node->children.find(*it);
+    if (child_it == node->children.end())
+    {
+      return false;
+    }
+    node = child_it->second;
+    path.push_back(node);
+  }
+  if (node->cmd != cmd)
+  {
+    return false;
+  }
+  node->cmd = 0;
+
+    // Prune the nodes that no longer lead to any command
+  for (size_t i = cmd_str.size(); i > 0; --i)
   {
-    cmds.erase(cmd_it);
+    Node *child = path[i];
+    if ((child->cmd != 0) || !child->children.empty())
+    {
+      break;
+    }
+    path[i-1]->children.erase(cmd_str[i-1]);
+    delete child;
   }
-  return cmd_exist;
+  return true;
 } /* CmdParser::removeCmd */
 
 
 bool CmdParser::processCmd(const string& cmd_str)
 {
-  int len = cmd_str.size();
-  while (len > 0)
+  Command *cmd = 0;
+  string::size_type len = 0;
+  const Node *node = &root;
+  for (string::size_type i = 0; i < cmd_str.size(); ++i)
   {
-    if (cmds.count(cmd_str.substr(0, len)) > 0)
+    Node::Children::const_iterator child_it = node->children.find(cmd_str[i]);
+    if (child_it == node->children.end())
+    {
+      break;
+    }
+    node = child_it->second;
+    if (node->cmd != 0)
     {
-      Command *cmd = cmds[cmd_str.substr(0, len)];
-      (*cmd)(cmd_str.substr(len, cmd_str.size()-len));
-      return true;
+      cmd = node->cmd;
+      len = i + 1;
     }
-    --len;
   }
 
-  return false;
+  if (cmd == 0)
+  {
+    return false;
+  }
+  (*cmd)(cmd_str.substr(len));
+  return true;
   
 } /* CmdParser::processCmd */
+
+
+Command *CmdParser::findCmd(const string& cmd_str) const
+{
+  const Node *node = findNode(cmd_str);
+  return (node != 0) ? node->cmd : 0;
+} /* CmdParser::findCmd */
     
 
 
@@ -196,23 +255,46 @@ bool CmdParser::processCmd(const string& cmd_str)
  *
  ****************************************************************************/
 
-
-/*
- *----------------------------------------------------------------------------
- * Method:    
- * Purpose:   
- * Input:     
- * Output:    
- * Author:    
- * Created:   
- * Remarks:   
- * Bugs:      
- *----------------------------------------------------------------------------
- */
+const CmdParser::Node *CmdParser::findNode(const string& cmd_str) const
+{
+  const Node *node = &root;
+  for (string::const_iterator it = cmd_str.begin(); it != cmd_str.end(); ++it)
+  {
+    Node::Children::const_iterator child_it = node->children.find(*it);
+    if (child_it == node->children.end())
+    {
+      return 0;
+    }
+    node = child_it->second;
+  }
+  return node;
+} /* CmdParser::findNode */
 
 
+void CmdParser::collectCmds(const Node *node, vector<Command *>& cmds)
+{
+  if (node->cmd != 0)
+  {
+    cmds.push_back(node->cmd);
+  }
+  Node::Children::const_iterator it;
+  for (it = node->children.begin(); it != node->children.end(); ++it)
+  {
+    collectCmds(it->second, cmds);
+  }
+} /* CmdParser::collectCmds */
 
 
+void CmdParser::deleteChildren(Node *node)
+{
+  Node::Children::iterator it;
+  for (it = node->children.begin(); it != node->children.end(); ++it)
+  {
+    deleteChildren(it->second);
+    delete it->second;
+  }
+  node->children.clear();
+} /* CmdParser::deleteChildren */
 
 
 
@@ -38,6 +38,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <map>
 #include <string>
+#include <vector>
 #include <cassert>
 
 
@@ -113,6 +114,11 @@ class Command;
 
 This is the DTMF command parser engine implementation. Add commands based on
 the Command class.
+
+The commands are stored in a trie with one node per command character. A
+command string is looked up in one pass through the trie and the longest
+command that is a prefix of the command string wins. The rest of the command
+string is given to the command as the sub command.
 */
 class CmdParser
 {
@@ -148,12 +154,30 @@ class CmdParser
      */
     bool processCmd(const std::string& cmd_str);
     
+    /**
+     * @brief   Find a command that exactly matches the given string
+     * @param   cmd_str The command string to look for
+     * @return  Returns the command or 0 if not found
+     */
+    Command *findCmd(const std::string& cmd_str) const;
     
   protected:
     
   private:
-    typedef std::map<std::string, Command *> CmdMap;
-    CmdMap cmds;
+    struct Node
+    {
+      typedef std::map<char, Node *> Children;
+      Command   *cmd;
+      Children  children;
+      Node(void) : cmd(0) {}
+    };
+    Node root;
+
+    CmdParser(const CmdParser&);
+    CmdParser& operator=(const CmdParser&);
+    const Node *findNode(const std::string& cmd_str) const;
+    static void collectCmds(const Node *node, std::vector<Command *>& cmds);
+    static void deleteChildren(Node *node);
     
 };  /* class CmdParser */
 
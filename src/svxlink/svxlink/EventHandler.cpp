@@ -32,10 +32,18 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
 #include <iostream>
 #include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <sstream>
 
 
 /****************************************************************************
@@ -45,6 +53,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncApplication.h>
+#include <AsyncFdWatch.h>
 
 
 
@@ -56,6 +65,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "EventHandler.h"
 #include "Module.h"
+#include "VoiceMailIndex.h"
+#include "SoundPack.h"
 
 
 
@@ -84,6 +95,16 @@ using namespace Async;
  *
  ****************************************************************************/
 
+namespace {
+  struct CachedScript
+  {
+    time_t  mtime;
+    off_t   size;
+    string  content;
+  };
+  typedef map<string, CachedScript> ScriptCache;
+}
+
 
 
 /****************************************************************************
@@ -92,6 +113,11 @@ using namespace Async;
  *
  ****************************************************************************/
 
+static bool read_cached_script(const string& filename, string& content);
+static void set_info_script(Tcl_Interp *irp, Tcl_Obj *filename);
+static Tcl_Obj *voice_mail_message_obj(const VoiceMailIndex::Message& msg);
+static bool get_int_arg(Tcl_Obj *obj, int *value);
+
 
 
 /****************************************************************************
@@ -109,6 +135,13 @@ using namespace Async;
  *
  ****************************************************************************/
 
+bool EventHandler::script_cache_enabled = false;
+
+  // The script cache is shared by all event handler threads
+static ScriptCache      script_cache;
+static pthread_mutex_t  script_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
 
 
 /****************************************************************************
@@ -118,15 +151,268 @@ using namespace Async;
  ****************************************************************************/
 
 
-EventHandler::EventHandler(const string& event_script, const string& logic_name)
-  : event_script(event_script), logic_name(logic_name), interp(0)
+void EventHandler::setScriptCacheEnabled(bool enable)
+{
+  script_cache_enabled = enable;
+  if (!enable)
+  {
+    pthread_mutex_lock(&script_cache_mutex);
+    script_cache.clear();
+    pthread_mutex_unlock(&script_cache_mutex);
+  }
+} /* EventHandler::setScriptCacheEnabled */
+
+
+EventHandler::EventHandler(const string& event_script, const string& logic_name,
+                           bool use_thread)
+  : event_script(event_script), logic_name(logic_name), interp(0),
+    warn_time(0), use_thread(use_thread), thread_started(false),
+    queued_jobs(0), done_jobs(0), last_event_job(0), last_job_ok(true),
+    init_job(0), init_ok(false),
+    quit(false), in_event(false), event_has_output(false), notifier_rd(-1),
+    notifier_wr(-1), notifier_watch(0)
+{
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&job_cond, NULL);
+  pthread_cond_init(&done_cond, NULL);
+
+  if (this->use_thread)
+  {
+    int fd[2];
+    if (pipe(fd) == 0)
+    {
+      notifier_rd = fd[0];
+      notifier_wr = fd[1];
+      fcntl(notifier_rd, F_SETFL, O_NONBLOCK);
+      notifier_watch = new FdWatch(notifier_rd, FdWatch::FD_WATCH_RD);
+      notifier_watch->activity.connect(
+          mem_fun(*this, &EventHandler::notificationReceived));
+
+      int ret = pthread_create(&thread, NULL, threadFunc, this);
+      if (ret == 0)
+      {
+        thread_started = true;
+      }
+      else
+      {
+        cerr << "*** ERROR: Could not create the TCL event handler thread "
+                "for logic " << logic_name << ": " << strerror(ret) << endl;
+      }
+    }
+    else
+    {
+      cerr << "*** ERROR: Could not create pipe for the TCL event handler "
+              "thread for logic " << logic_name << ": " << strerror(errno)
+           << endl;
+    }
+
+    if (!thread_started)
+    {
+      cerr << "*** WARNING: Running the TCL event handler for logic "
+           << logic_name << " in the main thread" << endl;
+      this->use_thread = false;
+    }
+  }
+
+  if (!this->use_thread && !createInterp())
+  {
+    return;
+  }
+
+  setVariable("script_path", event_script);
+
+} /* EventHandler::EventHandler */
+
+
+EventHandler::~EventHandler(void)
+{
+  if (thread_started)
+  {
+      // Let the thread handle the jobs that are already queued before it
+      // exit. Output from those jobs is discarded.
+    pthread_mutex_lock(&mutex);
+    quit = true;
+    pthread_cond_signal(&job_cond);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+  }
+  else
+  {
+    deleteInterp();
+  }
+
+  delete notifier_watch;
+  if (notifier_rd >= 0)
+  {
+    close(notifier_rd);
+    close(notifier_wr);
+  }
+  pthread_cond_destroy(&done_cond);
+  pthread_cond_destroy(&job_cond);
+  pthread_mutex_destroy(&mutex);
+} /* EventHandler::~EventHandler */
+
+
+bool EventHandler::initialize(void)
+{
+  startInitialize();
+  return waitInitialized();
+} /* EventHandler::initialize */
+
+
+void EventHandler::startInitialize(void)
+{
+  if (use_thread)
+  {
+    init_job = queueJob(Job(Job::EVAL_FILE));
+    return;
+  }
+  init_ok = evalFile();
+} /* EventHandler::startInitialize */
+
+
+bool EventHandler::waitInitialized(void)
+{
+  if (use_thread)
+  {
+    waitForJob(init_job);
+    pthread_mutex_lock(&mutex);
+    bool success = init_ok;
+    pthread_mutex_unlock(&mutex);
+    return success;
+  }
+  return init_ok;
+} /* EventHandler::waitInitialized */
+
+
+void EventHandler::setVariable(const string& name, const string& value)
+{
+  if (use_thread)
+  {
+    queueJob(Job(Job::SET_VARIABLE, name, value));
+    return;
+  }
+  setVariableP(name, value);
+} /* EventHandler::setVariable */
+
+
+bool EventHandler::processEvent(const string& event)
+{
+  if (use_thread)
+  {
+    last_event_job = queueJob(Job(Job::PROCESS_EVENT, event));
+    return true;
+  }
+  return handleEvent(event);
+} /* EventHandler::processEvent */
+
+
+const string EventHandler::eventResult(void)
+{
+  if (use_thread)
+  {
+    waitForJob(last_event_job);
+    pthread_mutex_lock(&mutex);
+    string result(last_result);
+    pthread_mutex_unlock(&mutex);
+    return result;
+  }
+
+  if (interp == 0)
+  {
+    return "";
+  }
+  
+  return Tcl_GetStringResult(interp);
+  
+} /* EventHandler::eventResult */
+
+
+void EventHandler::addDefaultProc(const string& proc, const string& body)
+{
+  default_proc_bodies[proc] = normalizeProcBody(body);
+} /* EventHandler::addDefaultProc */
+
+
+bool EventHandler::isDefaultProc(const string& proc) const
+{
+  pthread_mutex_lock(&mutex);
+  bool is_default = (default_procs.find(proc) != default_procs.end());
+  pthread_mutex_unlock(&mutex);
+  return is_default;
+} /* EventHandler::isDefaultProc */
+
+
+void EventHandler::addWatchedList(const string& var)
+{
+  WatchedList& wl = watched_lists[var];
+  wl.handler = this;
+  wl.var = var;
+} /* EventHandler::addWatchedList */
+
+
+bool EventHandler::watchedListIsEmpty(const string& var) const
+{
+  pthread_mutex_lock(&mutex);
+  WatchedListMap::const_iterator it = watched_lists.find(var);
+  bool is_empty = (it != watched_lists.end()) && it->second.is_empty;
+  pthread_mutex_unlock(&mutex);
+  return is_empty;
+} /* EventHandler::watchedListIsEmpty */
+
+
+bool EventHandler::isIdle(void) const
+{
+  if (!use_thread)
+  {
+    return true;
+  }
+  pthread_mutex_lock(&mutex);
+  bool is_idle = (done_jobs == queued_jobs) && outputs.empty();
+  pthread_mutex_unlock(&mutex);
+  return is_idle;
+} /* EventHandler::isIdle */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+/*
+ *------------------------------------------------------------------------
+ * Method:    
+ * Purpose:   
+ * Input:     
+ * Output:    
+ * Author:    
+ * Created:   
+ * Remarks:   
+ * Bugs:      
+ *------------------------------------------------------------------------
+ */
+
+
+
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+bool EventHandler::createInterp(void)
 {
   interp = Tcl_CreateInterp();
   if (interp == 0)
   {
     cerr << "*** ERROR: Could not create TCL interpreter for logic "
          << logic_name << "\n";
-    return;
+    return false;
   }
   
   if (Tcl_Init(interp) != TCL_OK)
@@ -135,28 +421,59 @@ EventHandler::EventHandler(const string& event_script, const string& logic_name)
          << Tcl_GetStringResult(interp) << endl;
     Tcl_DeleteInterp(interp);
     interp = 0;
-    return;
+    return false;
   }
   
-  Tcl_CreateCommand(interp, "playFile", playFileHandler, this, NULL);
-  Tcl_CreateCommand(interp, "playSilence", playSilenceHandler, this, NULL);
-  Tcl_CreateCommand(interp, "playTone", playToneHandler, this, NULL);
-  Tcl_CreateCommand(interp, "recordStart", recordHandler, this, NULL);
-  Tcl_CreateCommand(interp, "recordStop", recordHandler, this, NULL);
-  Tcl_CreateCommand(interp, "deactivateModule", deactivateModuleHandler,
-                    this, NULL);
-  Tcl_CreateCommand(interp, "publishStateEvent", publishStateEventHandler,
-                    this, NULL);
-  Tcl_CreateCommand(interp, "playDtmf", playDtmfHandler, this, NULL);
-  Tcl_CreateCommand(interp, "injectDtmf", injectDtmfHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "playFile", playFileHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "playSilence", playSilenceHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "playTone", playToneHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "recordStart", recordHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "recordStop", recordHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "deactivateModule", deactivateModuleHandler,
+                       this, NULL);
+  Tcl_CreateObjCommand(interp, "publishStateEvent", publishStateEventHandler,
+                       this, NULL);
+  Tcl_CreateObjCommand(interp, "playDtmf", playDtmfHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "injectDtmf", injectDtmfHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "composeBegin", composeHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "composeEnd", composeHandler, this, NULL);
+  Tcl_CreateObjCommand(interp, "voiceMailIndex", voiceMailIndexHandler,
+                       this, NULL);
+  Tcl_CreateObjCommand(interp, "findSoundClip", findSoundClipHandler,
+                       this, NULL);
+
+  if (script_cache_enabled)
+  {
+      // Keep the original source command for the forms not handled by
+      // the cache, like "source -encoding"
+    if (Tcl_Eval(interp, "rename ::source ::_uncached_source") == TCL_OK)
+    {
+      Tcl_CreateObjCommand(interp, "source", sourceHandler, this, NULL);
+    }
+    else
+    {
+      cerr << "*** WARNING: Could not enable the TCL script cache for logic "
+           << logic_name << ": " << Tcl_GetStringResult(interp) << endl;
+    }
+  }
 
-  setVariable("script_path", event_script);
+  return true;
 
-} /* EventHandler::EventHandler */
+} /* EventHandler::createInterp */
 
 
-EventHandler::~EventHandler(void)
+void EventHandler::deleteInterp(void)
 {
+  for (EventProcMap::iterator it = event_procs.begin();
+       it != event_procs.end(); ++it)
+  {
+    if (it->second.cmd != 0)
+    {
+      Tcl_DecrRefCount(it->second.cmd);
+    }
+  }
+  event_procs.clear();
+
   if (interp != 0)
   {
     Tcl_Preserve(interp);
@@ -165,30 +482,144 @@ EventHandler::~EventHandler(void)
       Tcl_DeleteInterp(interp);
     }
     Tcl_Release(interp);
+    interp = 0;
   }
-} /* EventHandler::~EventHandler */
+} /* EventHandler::deleteInterp */
 
 
-bool EventHandler::initialize(void)
+bool EventHandler::evalFile(void)
 {
   if (interp == 0)
   {
     return false;
   }
   
-  if (Tcl_EvalFile(interp, event_script.c_str()) != TCL_OK)
+  int ret = script_cache_enabled ? evalCachedFile(interp, event_script)
+                                 : Tcl_EvalFile(interp, event_script.c_str());
+  if (ret != TCL_OK)
   {
     cerr << event_script << " in logic " << logic_name << ": "
          << Tcl_GetStringResult(interp) << endl;
     return false;
   }
+
+  checkDefaultProcs();
+  setupWatchedLists();
   
   return true;
   
-} /* EventHandler::initialize */
+} /* EventHandler::evalFile */
 
 
-void EventHandler::setVariable(const string& name, const string& value)
+string EventHandler::normalizeProcBody(const string& body)
+{
+  string normalized;
+  istringstream is(body);
+  string line;
+  while (getline(is, line))
+  {
+    string::size_type first = line.find_first_not_of(" \t\r");
+    if ((first == string::npos) || (line[first] == '#'))
+    {
+      continue;
+    }
+    string::size_type last = line.find_last_not_of(" \t\r");
+    if (!normalized.empty())
+    {
+      normalized += '\n';
+    }
+    normalized.append(line, first, last - first + 1);
+  }
+  return normalized;
+} /* EventHandler::normalizeProcBody */
+
+
+void EventHandler::checkDefaultProcs(void)
+{
+  set<string> procs;
+  for (map<string, string>::const_iterator it = default_proc_bodies.begin();
+       it != default_proc_bodies.end(); ++it)
+  {
+    Tcl_Obj *cmd[3];
+    cmd[0] = Tcl_NewStringObj("info", -1);
+    cmd[1] = Tcl_NewStringObj("body", -1);
+    cmd[2] = Tcl_NewStringObj(("::" + it->first).c_str(), -1);
+    for (int i=0; i<3; ++i)
+    {
+      Tcl_IncrRefCount(cmd[i]);
+    }
+    if ((Tcl_EvalObjv(interp, 3, cmd, TCL_EVAL_GLOBAL) == TCL_OK) &&
+        (normalizeProcBody(Tcl_GetStringResult(interp)) == it->second))
+    {
+      procs.insert(it->first);
+    }
+    for (int i=0; i<3; ++i)
+    {
+      Tcl_DecrRefCount(cmd[i]);
+    }
+  }
+  Tcl_ResetResult(interp);
+
+  pthread_mutex_lock(&mutex);
+  default_procs.swap(procs);
+  pthread_mutex_unlock(&mutex);
+} /* EventHandler::checkDefaultProcs */
+
+
+void EventHandler::setupWatchedLists(void)
+{
+  for (WatchedListMap::iterator it = watched_lists.begin();
+       it != watched_lists.end(); ++it)
+  {
+    WatchedList& wl = it->second;
+    string var("::" + wl.var);
+    if (Tcl_TraceVar(interp, var.c_str(),
+                     TCL_GLOBAL_ONLY | TCL_TRACE_WRITES | TCL_TRACE_UNSETS,
+                     watchedListTraceHandler, &wl) != TCL_OK)
+    {
+      Tcl_ResetResult(interp);
+    }
+    updateWatchedList(wl);
+  }
+} /* EventHandler::setupWatchedLists */
+
+
+char *EventHandler::watchedListTraceHandler(ClientData cdata,
+                                            Tcl_Interp *irp,
+                                            const char *name1,
+                                            const char *name2, int flags)
+{
+  WatchedList *wl = reinterpret_cast<WatchedList *>(cdata);
+  if ((flags & TCL_TRACE_UNSETS) != 0)
+  {
+      // The trace is removed when the variable is unset so the state is
+      // not known anymore
+    pthread_mutex_lock(&wl->handler->mutex);
+    wl->is_empty = false;
+    pthread_mutex_unlock(&wl->handler->mutex);
+    return NULL;
+  }
+  wl->handler->updateWatchedList(*wl);
+  return NULL;
+} /* EventHandler::watchedListTraceHandler */
+
+
+void EventHandler::updateWatchedList(WatchedList& wl)
+{
+  string var("::" + wl.var);
+  Tcl_Obj *value = Tcl_GetVar2Ex(interp, var.c_str(), NULL, TCL_GLOBAL_ONLY);
+  int len = -1;
+  if ((value != 0) && (Tcl_ListObjLength(0, value, &len) != TCL_OK))
+  {
+    len = -1;
+  }
+  pthread_mutex_lock(&mutex);
+  wl.is_empty = (len == 0);
+  pthread_mutex_unlock(&mutex);
+} /* EventHandler::updateWatchedList */
+
+
+void EventHandler::setVariableP(const string& name, const string& value)
 {
   if (interp == 0)
   {
@@ -203,173 +634,160 @@ void EventHandler::setVariable(const string& name, const string& value)
          << Tcl_GetStringResult(interp) << endl;
   }
   Tcl_Release(interp);
-} /* EventHandler::setVariable */
+} /* EventHandler::setVariableP */
 
 
-bool EventHandler::processEvent(const string& event)
+bool EventHandler::handleEvent(const string& event)
 {
   if (interp == 0)
   {
     return false;
   }
   
+    // Event statistics are kept per procedure name, which is the first
+    // word of the event
+  string name;
+  string::size_type name_begin = event.find_first_not_of(" \t");
+  if (name_begin != string::npos)
+  {
+    name = event.substr(name_begin,
+                        event.find_first_of(" \t", name_begin) - name_begin);
+  }
+  EventProc& proc = event_procs[name];
+
   bool success = true;
   Tcl_Preserve(interp);
-  if (Tcl_Eval(interp, (event + ";").c_str()) != TCL_OK)
+  in_event = use_thread;
+  event_has_output = false;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (evalEvent(event, proc) != TCL_OK)
   {
     cerr << "*** ERROR: Unable to handle event: " << event
          << " in logic " << logic_name << " ("
          << Tcl_GetStringResult(interp) << ")" << endl;
     success = false;
   }
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  uint64_t elapsed_us =
+    static_cast<int64_t>(end.tv_sec - start.tv_sec) * 1000000 +
+    (end.tv_nsec - start.tv_nsec) / 1000;
+  proc.calls += 1;
+  proc.total_us += elapsed_us;
+  if ((warn_time > 0) && (elapsed_us >= 1000ULL * warn_time))
+  {
+    cerr << "*** WARNING: Event " << name << " in logic " << logic_name
+         << " took " << (elapsed_us / 1000) << "ms (average "
+         << (proc.total_us / proc.calls / 1000) << "ms over " << proc.calls
+         << " calls)" << endl;
+  }
   Tcl_Release(interp);
-  
-  return success;
-  
-} /* EventHandler::processEvent */
-
-
-const string EventHandler::eventResult(void) const
-{
-  if (interp == 0)
+  if (event_has_output)
   {
-    return 0;
+    in_event = false;
+    output(Output(Output::EVENT_END));
   }
   
-  return Tcl_GetStringResult(interp);
+  return success;
   
-} /* EventHandler::eventResult */
+} /* EventHandler::handleEvent */
 
 
-/****************************************************************************
- *
- * Protected member functions
- *
- ****************************************************************************/
-
-
-/*
- *------------------------------------------------------------------------
- * Method:    
- * Purpose:   
- * Input:     
- * Output:    
- * Author:    
- * Created:   
- * Remarks:   
- * Bugs:      
- *------------------------------------------------------------------------
- */
-
-
-
-
-
-
-/****************************************************************************
- *
- * Private member functions
- *
- ****************************************************************************/
-
-int EventHandler::playFileHandler(ClientData cdata, Tcl_Interp *irp, int argc,
-      	      	      	   const char *argv[])
+int EventHandler::playFileHandler(ClientData cdata, Tcl_Interp *irp,
+                                  int objc, Tcl_Obj *const objv[])
 {
-  if(argc != 2)
+  if (objc != 2)
   {
     static char msg[] = "Usage: playFile: <filename>";
     Tcl_SetResult(irp, msg, TCL_STATIC);
     return TCL_ERROR;
   }
-  //cout << "EventHandler::playFile: " << argv[1] << endl;
+  //cout << "EventHandler::playFile: " << Tcl_GetString(objv[1]) << endl;
 
   EventHandler *self = static_cast<EventHandler *>(cdata);
-  string filename(argv[1]);
-  self->playFile(filename);
+  self->output(Output(Output::PLAY_FILE, Tcl_GetString(objv[1])));
 
   return TCL_OK;
-}
+} /* EventHandler::playFileHandler */
 
 
 int EventHandler::playSilenceHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	      	      int argc, const char *argv[])
+                                     int objc, Tcl_Obj *const objv[])
 {
-  if(argc != 2)
+  int length;
+  if ((objc != 2) || !get_int_arg(objv[1], &length))
   {
     static char msg[] = "Usage: playSilence <milliseconds>";
     Tcl_SetResult(irp, msg, TCL_STATIC);
     return TCL_ERROR;
   }
-  //cout << "EventHandler::playSilence: " << argv[1] << endl;
+  //cout << "EventHandler::playSilence: " << length << endl;
 
   EventHandler *self = static_cast<EventHandler *>(cdata);
-  self->playSilence(atoi(argv[1]));
+  self->output(Output(Output::PLAY_SILENCE, "", "", length));
 
   return TCL_OK;
-}
+} /* EventHandler::playSilenceHandler */
 
 
 int EventHandler::playToneHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	      	      int argc, const char *argv[])
+                                  int objc, Tcl_Obj *const objv[])
 {
-  if(argc != 4)
+  int fq, amp, length;
+  if ((objc != 4) || !get_int_arg(objv[1], &fq) ||
+      !get_int_arg(objv[2], &amp) || !get_int_arg(objv[3], &length))
   {
     static char msg[] = "Usage: playTone <fq> <amp> <milliseconds>";
     Tcl_SetResult(irp, msg, TCL_STATIC);
     return TCL_ERROR;
   }
-  //cout << "EventHandler::playTone: " << argv[1] << endl;
+  //cout << "EventHandler::playTone: " << fq << endl;
 
   EventHandler *self = static_cast<EventHandler *>(cdata);
-  self->playTone(atoi(argv[1]), atoi(argv[2]), atoi(argv[3]));
+  self->output(Output(Output::PLAY_TONE, "", "", fq, amp, length));
 
   return TCL_OK;
-}
+} /* EventHandler::playToneHandler */
 
 
 int EventHandler::recordHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	      	      int argc, const char *argv[])
+                                int objc, Tcl_Obj *const objv[])
 {
-  //cout << "recordHandler: " << argv[0] << endl;
-  if (strcmp(argv[0], "recordStart") == 0)
+  //cout << "recordHandler: " << Tcl_GetString(objv[0]) << endl;
+  EventHandler *self = static_cast<EventHandler *>(cdata);
+  if (strcmp(Tcl_GetString(objv[0]), "recordStart") == 0)
   {
-    if((argc < 2) || (argc > 3))
+    int max_time = 0;
+    if ((objc < 2) || (objc > 3) ||
+        ((objc == 3) && !get_int_arg(objv[2], &max_time)))
     {
       static char msg[] = "Usage: recordStart <filename> [max_time]";
       Tcl_SetResult(irp, msg, TCL_STATIC);
       return TCL_ERROR;
     }
-
-    EventHandler *self = static_cast<EventHandler *>(cdata);
-    unsigned max_time = 0;
-    if (argc == 3)
-    {
-      max_time = atoi(argv[2]);
-    }
-    self->recordStart(argv[1], max_time);
+    self->output(Output(Output::RECORD_START, Tcl_GetString(objv[1]), "",
+                        max_time));
   }
   else
   {
-    if(argc != 1)
+    if (objc != 1)
     {
       static char msg[] = "Usage: recordStop";
       Tcl_SetResult(irp, msg, TCL_STATIC);
       return TCL_ERROR;
     }
-
-    EventHandler *self = static_cast<EventHandler *>(cdata);
-    self->recordStop();
+    self->output(Output(Output::RECORD_STOP));
   }
-  
 
   return TCL_OK;
-}
+} /* EventHandler::recordHandler */
 
 
 int EventHandler::deactivateModuleHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	      	      int argc, const char *argv[])
+                                          int objc, Tcl_Obj *const objv[])
 {
-  if(argc != 1)
+  if (objc != 1)
   {
     static char msg[] = "Usage: deactivateModule";
     Tcl_SetResult(irp, msg, TCL_STATIC);
@@ -377,16 +795,16 @@ int EventHandler::deactivateModuleHandler(ClientData cdata, Tcl_Interp *irp,
   }
 
   EventHandler *self = static_cast<EventHandler *>(cdata);
-  Application::app().runTask(self->deactivateModule.make_slot());
+  self->output(Output(Output::DEACTIVATE_MODULE));
 
   return TCL_OK;
-}
+} /* EventHandler::deactivateModuleHandler */
 
 
 int EventHandler::publishStateEventHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	      	      int argc, const char *argv[])
+                                           int objc, Tcl_Obj *const objv[])
 {
-  if (argc != 3)
+  if (objc != 3)
   {
     static char msg[] = "Usage: publishStateEvent <event name> <event msg>";
     Tcl_SetResult(irp, msg, TCL_STATIC);
@@ -394,54 +812,600 @@ int EventHandler::publishStateEventHandler(ClientData cdata, Tcl_Interp *irp,
   }
 
   EventHandler *self = static_cast<EventHandler *>(cdata);
-  self->publishStateEvent(argv[1], argv[2]);
+  self->output(Output(Output::PUBLISH_STATE_EVENT, Tcl_GetString(objv[1]),
+                      Tcl_GetString(objv[2])));
 
   return TCL_OK;
-}
+} /* EventHandler::publishStateEventHandler */
 
 
 int EventHandler::playDtmfHandler(ClientData cdata, Tcl_Interp *irp,
-                                  int argc, const char *argv[])
+                                  int objc, Tcl_Obj *const objv[])
 {
-  if(argc != 4)
+  int amp, length;
+  if ((objc != 4) || !get_int_arg(objv[2], &amp) ||
+      !get_int_arg(objv[3], &length))
   {
     static char msg[] = "Usage: playDtmf <digits> <amp> <milliseconds>";
     Tcl_SetResult(irp, msg, TCL_STATIC);
     return TCL_ERROR;
   }
-  //cout << "EventHandler::playDtmf: " << argv[1] << ", "
-  //    << argv[2] << ", " << argv[3]<< endl;
+  //cout << "EventHandler::playDtmf: " << Tcl_GetString(objv[1]) << ", "
+  //    << amp << ", " << length << endl;
   EventHandler *self = static_cast<EventHandler *>(cdata);
-  self->playDtmf(argv[1], atoi(argv[2]), atoi(argv[3]));
+  self->output(Output(Output::PLAY_DTMF, Tcl_GetString(objv[1]), "", amp,
+                      length));
 
   return TCL_OK;
 } /* EventHandler::playDtmfHandler */
 
 
 int EventHandler::injectDtmfHandler(ClientData cdata, Tcl_Interp *irp,
-                                    int argc, const char *argv[])
+                                    int objc, Tcl_Obj *const objv[])
 {
-  if((argc < 2) or (argc > 3))
+  int duration = 100;
+  if ((objc < 2) || (objc > 3) ||
+      ((objc == 3) && !get_int_arg(objv[2], &duration)))
   {
     static char msg[] = "Usage: injectDtmf <digits> [milliseconds]";
     Tcl_SetResult(irp, msg, TCL_STATIC);
     return TCL_ERROR;
   }
-  string digits(argv[1]);
-  int duration = 100;
-  if (argc == 3)
-  {
-    duration = atoi(argv[2]);
-  }
-  //cout << "EventHandler::injectDtmf: " << digits << ", " << duration << endl;
+  //cout << "EventHandler::injectDtmf: " << Tcl_GetString(objv[1]) << ", "
+  //     << duration << endl;
   EventHandler *self = static_cast<EventHandler *>(cdata);
-  self->injectDtmf(digits, duration);
+  self->output(Output(Output::INJECT_DTMF, Tcl_GetString(objv[1]), "",
+                      duration));
 
   return TCL_OK;
 } /* EventHandler::injectDtmfHandler */
 
 
+int EventHandler::composeHandler(ClientData cdata, Tcl_Interp *irp,
+                                 int objc, Tcl_Obj *const objv[])
+{
+  EventHandler *self = static_cast<EventHandler *>(cdata);
+  if (strcmp(Tcl_GetString(objv[0]), "composeBegin") == 0)
+  {
+    if (objc != 2)
+    {
+      static char msg[] = "Usage: composeBegin <key>";
+      Tcl_SetResult(irp, msg, TCL_STATIC);
+      return TCL_ERROR;
+    }
+    self->output(Output(Output::COMPOSITION_BEGIN, Tcl_GetString(objv[1])));
+  }
+  else
+  {
+    if (objc != 1)
+    {
+      static char msg[] = "Usage: composeEnd";
+      Tcl_SetResult(irp, msg, TCL_STATIC);
+      return TCL_ERROR;
+    }
+    self->output(Output(Output::COMPOSITION_END));
+  }
+
+  return TCL_OK;
+} /* EventHandler::composeHandler */
+
+
+int EventHandler::sourceHandler(ClientData cdata, Tcl_Interp *irp,
+                                int objc, Tcl_Obj *const objv[])
+{
+  if (objc != 2)
+  {
+    vector<Tcl_Obj*> args(objv, objv + objc);
+    args[0] = Tcl_NewStringObj("::_uncached_source", -1);
+    Tcl_IncrRefCount(args[0]);
+    int ret = Tcl_EvalObjv(irp, objc, &args[0], 0);
+    Tcl_DecrRefCount(args[0]);
+    return ret;
+  }
+  return evalCachedFile(irp, Tcl_GetString(objv[1]));
+} /* EventHandler::sourceHandler */
+
+
+
+int EventHandler::voiceMailIndexHandler(ClientData cdata, Tcl_Interp *irp,
+                                        int objc, Tcl_Obj *const objv[])
+{
+  if (objc != 3)
+  {
+    static char msg[] =
+      "Usage: voiceMailIndex <count|first|list> <dir> | "
+      "voiceMailIndex <add|remove> <basename>";
+    Tcl_SetResult(irp, msg, TCL_STATIC);
+    return TCL_ERROR;
+  }
+
+  VoiceMailIndex& index = VoiceMailIndex::instance();
+  string subcmd(Tcl_GetString(objv[1]));
+  const char *arg = Tcl_GetString(objv[2]);
+  if (subcmd == "count")
+  {
+    Tcl_SetObjResult(irp,
+        Tcl_NewWideIntObj(static_cast<Tcl_WideInt>(index.count(arg))));
+  }
+  else if (subcmd == "first")
+  {
+    VoiceMailIndex::Message msg;
+    if (index.first(arg, msg))
+    {
+      Tcl_SetObjResult(irp, voice_mail_message_obj(msg));
+    }
+  }
+  else if (subcmd == "list")
+  {
+    VoiceMailIndex::Messages msgs(index.list(arg));
+    Tcl_Obj *list = Tcl_NewListObj(0, NULL);
+    for (VoiceMailIndex::Messages::const_iterator it = msgs.begin();
+         it != msgs.end(); ++it)
+    {
+      Tcl_ListObjAppendElement(NULL, list, voice_mail_message_obj(*it));
+    }
+    Tcl_SetObjResult(irp, list);
+  }
+  else if (subcmd == "add")
+  {
+    index.add(arg);
+  }
+  else if (subcmd == "remove")
+  {
+    index.remove(arg);
+  }
+  else
+  {
+    static char msg[] = "voiceMailIndex: Unknown subcommand";
+    Tcl_SetResult(irp, msg, TCL_STATIC);
+    return TCL_ERROR;
+  }
+
+  return TCL_OK;
+} /* EventHandler::voiceMailIndexHandler */
+
+
 /*
- * This file has not been truncated
+ * Return the path to the first of the given clips, given without file
+ * extension, that exist in a sound pack or in the file system
  */
+int EventHandler::findSoundClipHandler(ClientData cdata, Tcl_Interp *irp,
+                                       int objc, Tcl_Obj *const objv[])
+{
+  if (objc < 2)
+  {
+    static char msg[] = "Usage: findSoundClip <basename> ?<basename> ...?";
+    Tcl_SetResult(irp, msg, TCL_STATIC);
+    return TCL_ERROR;
+  }
+
+  for (int i=1; i<objc; ++i)
+  {
+    string path = SoundPack::instance().findClip(Tcl_GetString(objv[i]));
+    if (!path.empty())
+    {
+      Tcl_SetObjResult(irp, Tcl_NewStringObj(path.c_str(), path.size()));
+      break;
+    }
+  }
+
+  return TCL_OK;
+} /* EventHandler::findSoundClipHandler */
+
+
+int EventHandler::evalCachedFile(Tcl_Interp *irp, const string& filename)
+{
+  string content;
+  if (!read_cached_script(filename, content))
+  {
+    Tcl_SetObjResult(irp, Tcl_ObjPrintf("couldn't read file \"%s\": %s",
+                                        filename.c_str(), Tcl_PosixError(irp)));
+    return TCL_ERROR;
+  }
 
+    // Convert from the system encoding, like Tcl_EvalFile do
+  Tcl_DString script;
+  Tcl_ExternalToUtfDString(NULL, content.data(), content.size(), &script);
+
+    // Make "info script" return the sourced file while it is evaluated
+  Tcl_Eval(irp, "info script");
+  Tcl_Obj *prev_script = Tcl_GetObjResult(irp);
+  Tcl_IncrRefCount(prev_script);
+  Tcl_Obj *script_name = Tcl_NewStringObj(filename.c_str(), -1);
+  Tcl_IncrRefCount(script_name);
+  set_info_script(irp, script_name);
+  Tcl_DecrRefCount(script_name);
+
+  int ret = Tcl_EvalEx(irp, Tcl_DStringValue(&script),
+                       Tcl_DStringLength(&script), 0);
+  Tcl_DStringFree(&script);
+  if (ret == TCL_RETURN)
+  {
+    ret = TCL_OK;
+  }
+  else if (ret == TCL_ERROR)
+  {
+    ostringstream os;
+    os << "\n    (file \"" << filename << "\" line "
+       << Tcl_GetErrorLine(irp) << ")";
+    Tcl_AddErrorInfo(irp, os.str().c_str());
+  }
+
+    // Restoring "info script" reset the result so save the result and the
+    // error information from the script
+  Tcl_Obj *result = Tcl_GetObjResult(irp);
+  Tcl_IncrRefCount(result);
+  Tcl_Obj *options = Tcl_GetReturnOptions(irp, ret);
+  Tcl_IncrRefCount(options);
+  set_info_script(irp, prev_script);
+  Tcl_SetObjResult(irp, result);
+  ret = Tcl_SetReturnOptions(irp, options);
+  Tcl_DecrRefCount(options);
+  Tcl_DecrRefCount(result);
+  Tcl_DecrRefCount(prev_script);
+
+  return ret;
+} /* EventHandler::evalCachedFile */
+
+
+int EventHandler::evalEvent(const string& event, EventProc& proc)
+{
+    // A plain event is split into words which are passed to the procedure
+    // as arguments without being parsed by TCL. The command object for the
+    // procedure is kept between calls so that TCL can cache the command
+    // lookup in it. Events that use quoting or substitutions are evaluated
+    // as a script.
+  Tcl_Obj *objv[MAX_EVENT_WORDS];
+  int objc = 0;
+  string::size_type begin = event.find_first_not_of(" \t");
+  bool is_plain = (begin != string::npos) && (event[begin] != '#') &&
+                  (event.find_first_of("[]{}$\\\";\r\n\v\f") ==
+                   string::npos);
+  while (is_plain && (begin != string::npos))
+  {
+    if (objc == MAX_EVENT_WORDS)
+    {
+      is_plain = false;
+      break;
+    }
+    string::size_type end = event.find_first_of(" \t", begin);
+    int len = static_cast<int>(
+        (end == string::npos ? event.size() : end) - begin);
+    if (objc == 0)
+    {
+      if (proc.cmd == 0)
+      {
+        proc.cmd = Tcl_NewStringObj(event.data() + begin, len);
+        Tcl_IncrRefCount(proc.cmd);
+      }
+      objv[objc] = proc.cmd;
+    }
+    else
+    {
+      objv[objc] = Tcl_NewStringObj(event.data() + begin, len);
+    }
+    Tcl_IncrRefCount(objv[objc]);
+    ++objc;
+    begin = event.find_first_not_of(" \t", end);
+  }
+
+  int ret;
+  if (is_plain)
+  {
+    ret = Tcl_EvalObjv(interp, objc, objv, 0);
+  }
+  else
+  {
+    ret = Tcl_Eval(interp, (event + ";").c_str());
+  }
+
+  for (int i=0; i<objc; ++i)
+  {
+    Tcl_DecrRefCount(objv[i]);
+  }
+
+  return ret;
+
+} /* EventHandler::evalEvent */
+
+
+void EventHandler::output(const Output& out)
+{
+  if (!use_thread)
+  {
+    emitOutput(out);
+    return;
+  }
+
+    // The main thread is only notified when the queue goes from empty to
+    // non-empty. It will empty the whole queue when notified.
+  pthread_mutex_lock(&mutex);
+  bool notify = outputs.empty();
+  if (in_event && !event_has_output)
+  {
+    outputs.push_back(Output(Output::EVENT_BEGIN));
+    event_has_output = true;
+  }
+  outputs.push_back(out);
+  pthread_mutex_unlock(&mutex);
+
+  if (notify)
+  {
+    char ch = 0;
+    if (write(notifier_wr, &ch, 1) != 1)
+    {
+      cerr << "*** WARNING: Could not notify the main thread about TCL "
+              "event handler output in logic " << logic_name << endl;
+    }
+  }
+} /* EventHandler::output */
+
+
+void EventHandler::emitOutput(const Output& out)
+{
+  switch (out.type)
+  {
+    case Output::EVENT_BEGIN:
+      eventOutputBegin();
+      break;
+    case Output::EVENT_END:
+      eventOutputEnd();
+      break;
+    case Output::PLAY_FILE:
+      playFile(out.str1);
+      break;
+    case Output::PLAY_SILENCE:
+      playSilence(out.arg1);
+      break;
+    case Output::PLAY_TONE:
+      playTone(out.arg1, out.arg2, out.arg3);
+      break;
+    case Output::PLAY_DTMF:
+      playDtmf(out.str1, out.arg1, out.arg2);
+      break;
+    case Output::RECORD_START:
+      recordStart(out.str1, static_cast<unsigned>(out.arg1));
+      break;
+    case Output::RECORD_STOP:
+      recordStop();
+      break;
+    case Output::DEACTIVATE_MODULE:
+      Application::app().runTask(deactivateModule.make_slot());
+      break;
+    case Output::PUBLISH_STATE_EVENT:
+      publishStateEvent(out.str1, out.str2);
+      break;
+    case Output::INJECT_DTMF:
+      injectDtmf(out.str1, out.arg1);
+      break;
+    case Output::COMPOSITION_BEGIN:
+      compositionBegin(out.str1);
+      break;
+    case Output::COMPOSITION_END:
+      compositionEnd();
+      break;
+  }
+} /* EventHandler::emitOutput */
+
+
+void EventHandler::emitQueuedOutputs(void)
+{
+  vector<Output> outs;
+  pthread_mutex_lock(&mutex);
+  outs.swap(outputs);
+  pthread_mutex_unlock(&mutex);
+
+  for (vector<Output>::const_iterator it = outs.begin(); it != outs.end();
+       ++it)
+  {
+    emitOutput(*it);
+  }
+} /* EventHandler::emitQueuedOutputs */
+
+
+unsigned long EventHandler::queueJob(const Job& job)
+{
+  pthread_mutex_lock(&mutex);
+  jobs.push_back(job);
+  unsigned long job_no = ++queued_jobs;
+  pthread_cond_signal(&job_cond);
+  pthread_mutex_unlock(&mutex);
+  return job_no;
+} /* EventHandler::queueJob */
+
+
+bool EventHandler::waitForJob(unsigned long job_no)
+{
+  pthread_mutex_lock(&mutex);
+  while (done_jobs < job_no)
+  {
+    pthread_cond_wait(&done_cond, &mutex);
+  }
+  bool success = last_job_ok;
+  pthread_mutex_unlock(&mutex);
+
+    // Emit the output from the job before returning so that it is handled
+    // in the same order as if the job had been run in the main thread
+  emitQueuedOutputs();
+
+  return success;
+} /* EventHandler::waitForJob */
+
+
+void *EventHandler::threadFunc(void *arg)
+{
+  EventHandler *self = reinterpret_cast<EventHandler *>(arg);
+  self->run();
+  return NULL;
+} /* EventHandler::threadFunc */
+
+
+void EventHandler::run(void)
+{
+    // A TCL interpreter may only be used by the thread that created it
+  createInterp();
+
+  pthread_mutex_lock(&mutex);
+  for (;;)
+  {
+    while (jobs.empty() && !quit)
+    {
+      pthread_cond_wait(&job_cond, &mutex);
+    }
+    if (jobs.empty())
+    {
+      break;
+    }
+    Job job(jobs.front());
+    jobs.pop_front();
+    pthread_mutex_unlock(&mutex);
+
+    bool success = true;
+    string result;
+    switch (job.type)
+    {
+      case Job::SET_VARIABLE:
+        setVariableP(job.str1, job.str2);
+        break;
+      case Job::EVAL_FILE:
+        success = evalFile();
+        break;
+      case Job::PROCESS_EVENT:
+        success = handleEvent(job.str1);
+        if (interp != 0)
+        {
+          result = Tcl_GetStringResult(interp);
+        }
+        break;
+    }
+
+    pthread_mutex_lock(&mutex);
+    if (job.type == Job::PROCESS_EVENT)
+    {
+      last_result.swap(result);
+    }
+    else if (job.type == Job::EVAL_FILE)
+    {
+      init_ok = success;
+    }
+    last_job_ok = success;
+    ++done_jobs;
+    pthread_cond_broadcast(&done_cond);
+  }
+  pthread_mutex_unlock(&mutex);
+
+  deleteInterp();
+} /* EventHandler::run */
+
+
+void EventHandler::notificationReceived(FdWatch *w)
+{
+  char buf[64];
+  while (read(w->fd(), buf, sizeof(buf)) > 0)
+  {
+  }
+  emitQueuedOutputs();
+} /* EventHandler::notificationReceived */
+
+
+static bool read_cached_script(const string& filename, string& content)
+{
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0)
+  {
+    return false;
+  }
+
+  pthread_mutex_lock(&script_cache_mutex);
+  ScriptCache::const_iterator it = script_cache.find(filename);
+  if ((it != script_cache.end()) && (it->second.mtime == st.st_mtime) &&
+      (it->second.size == st.st_size))
+  {
+    content = it->second.content;
+    pthread_mutex_unlock(&script_cache_mutex);
+    return true;
+  }
+  pthread_mutex_unlock(&script_cache_mutex);
+
+  ifstream is(filename.c_str(), ios::binary);
+  if (!is)
+  {
+    return false;
+  }
+  ostringstream os;
+  os << is.rdbuf();
+  if (is.bad())
+  {
+    return false;
+  }
+  content = os.str();
+
+  pthread_mutex_lock(&script_cache_mutex);
+  CachedScript& cached = script_cache[filename];
+  cached.mtime = st.st_mtime;
+  cached.size = st.st_size;
+  cached.content = content;
+  pthread_mutex_unlock(&script_cache_mutex);
+
+  return true;
+} /* read_cached_script */
+
+
+static void set_info_script(Tcl_Interp *irp, Tcl_Obj *filename)
+{
+  Tcl_Obj *objv[3];
+  objv[0] = Tcl_NewStringObj("info", -1);
+  objv[1] = Tcl_NewStringObj("script", -1);
+  objv[2] = filename;
+  for (int i=0; i<3; ++i)
+  {
+    Tcl_IncrRefCount(objv[i]);
+  }
+  Tcl_EvalObjv(irp, 3, objv, 0);
+  for (int i=0; i<3; ++i)
+  {
+    Tcl_DecrRefCount(objv[i]);
+  }
+} /* set_info_script */
+
+
+static Tcl_Obj *voice_mail_message_obj(const VoiceMailIndex::Message& msg)
+{
+  Tcl_Obj *obj = Tcl_NewListObj(0, NULL);
+  Tcl_ListObjAppendElement(NULL, obj, Tcl_NewStringObj("basename", -1));
+  Tcl_ListObjAppendElement(NULL, obj,
+                           Tcl_NewStringObj(msg.basename.c_str(), -1));
+  Tcl_ListObjAppendElement(NULL, obj, Tcl_NewStringObj("timestamp", -1));
+  Tcl_ListObjAppendElement(NULL, obj,
+                           Tcl_NewStringObj(msg.timestamp.c_str(), -1));
+  Tcl_ListObjAppendElement(NULL, obj, Tcl_NewStringObj("sender", -1));
+  Tcl_ListObjAppendElement(NULL, obj,
+                           Tcl_NewStringObj(msg.sender.c_str(), -1));
+  return obj;
+} /* voice_mail_message_obj */
+
+
+static bool get_int_arg(Tcl_Obj *obj, int *value)
+{
+    // Tcl keep the parsed integer in the object so repeated calls with the
+    // same argument are cheap. Some scripts calculate lengths using
+    // floating point arithmetic so such values are truncated, like atoi
+    // would have done.
+  if (Tcl_GetIntFromObj(NULL, obj, value) == TCL_OK)
+  {
+    return true;
+  }
+  double dval;
+  if (Tcl_GetDoubleFromObj(NULL, obj, &dval) == TCL_OK)
+  {
+    *value = static_cast<int>(dval);
+    return true;
+  }
+  return false;
+} /* get_int_arg */
+
+
+
+/*
+ * This file has not been truncated
+ */
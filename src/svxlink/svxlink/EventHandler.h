@@ -37,8 +37,15 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <tcl.h>
 #include <sigc++/sigc++.h>
 
+#include <stdint.h>
+#include <pthread.h>
+
 #include <string>
 #include <sstream>
+#include <map>
+#include <deque>
+#include <vector>
+#include <set>
 
 
 /****************************************************************************
@@ -63,6 +70,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+namespace Async
+{
+  class FdWatch;
+};
 
 
 /****************************************************************************
@@ -109,14 +120,41 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 @brief	Manage the TCL interpreter and call TCL functions for different events.
 @author Tobias Blomberg
 @date   2005-04-09
+
+The TCL interpreter may optionally be run in a thread of its own so that slow
+event handlers do not block the main thread, which handle all audio. All
+calls to the interpreter are then queued to the event handler thread in the
+order they are made. The audio and other requests from the TCL scripts are
+queued back to the main thread where the signals are emitted, enclosed in an
+eventOutputBegin/eventOutputEnd pair for each event. The processEvent
+function then return before the event has been handled. A call to
+eventResult wait for the last event to be handled.
 */
 class EventHandler : public sigc::trackable
 {
   public:
+    /**
+     * @brief 	Enable or disable the shared TCL script cache
+     * @param 	enable Set to \em true to enable the cache
+     *
+     * The event handling scripts are the same for all logics but each logic
+     * has its own TCL interpreter, so each script is read once per logic.
+     * When the cache is enabled, the content of each script file is read
+     * only once and is kept in memory to be shared by all interpreters
+     * created after this call. A file is read again if its modification time
+     * or size has changed. The TCL "source" command is replaced so that the
+     * cache is also used for files that are sourced by other scripts.
+     */
+    static void setScriptCacheEnabled(bool enable);
+
     /**
      * @brief 	Constuctor
+     * @param 	event_script The path to the TCL event handler script
+     * @param 	logic_name The name of the logic that own the event handler
+     * @param 	use_thread Set to \em true to run TCL in a separate thread
      */
-    EventHandler(const std::string& event_script, const std::string& logic_name);
+    EventHandler(const std::string& event_script, const std::string& logic_name,
+                 bool use_thread=false);
 
     /**
      * @brief 	Destructor
@@ -128,6 +166,26 @@ class EventHandler : public sigc::trackable
      * @return	Returns \em true on success or else \em false
      */
     bool initialize(void);
+
+    /**
+     * @brief 	Start loading the event handling script
+     *
+     * When running the event handler in a separate thread, the script is
+     * loaded in the background while the caller continue to execute. Use
+     * waitInitialized to get the result. Events and variables set after
+     * calling this function are handled after the script has been loaded.
+     * When not using a thread the script is loaded before this function
+     * return.
+     */
+    void startInitialize(void);
+
+    /**
+     * @brief 	Wait for the event handling script to be loaded
+     * @return	Returns \em true if the script was loaded or else \em false
+     *
+     * Must be called after startInitialize.
+     */
+    bool waitInitialized(void);
   
     /**
      * @brief 	Set a TCL variable
@@ -148,14 +206,85 @@ class EventHandler : public sigc::trackable
      * @brief 	Process the given event
      * @param 	event The event must be a valid TCL function call
      * @return	Returns \em true on success or else \em false
+     *
+     * Events that consist of a procedure name followed by plain words,
+     * without any TCL quoting or substitution characters, are dispatched
+     * using a cached command object so that the event string does not
+     * have to be parsed as a script. Other events are evaluated as a
+     * script.
      */
     bool processEvent(const std::string& event);
+
+    /**
+     * @brief 	Set the time above which a slow event is reported
+     * @param 	warn_time The time in milliseconds. 0 disables the reports.
+     *
+     * When set, a warning is printed each time the handling of an event
+     * take longer than the given time. The warning include the average
+     * handling time for the event procedure to make it easier to find
+     * event handlers that are slow.
+     */
+    void setWarnTime(unsigned warn_time) { this->warn_time = warn_time; }
   
     /**
      * @brief 	Return the event result from the last call
      * @return	This is the return value from the called TCL function
+     *
+     * If the event handler run in a separate thread, this function wait
+     * until the last event has been handled and all output from it has
+     * been emitted.
+     */
+    const std::string eventResult(void);
+
+    /**
+     * @brief 	Register the default definition of a TCL procedure
+     * @param 	proc The fully qualified name of the procedure
+     * @param 	body The body of the default procedure definition
+     *
+     * Must be called before startInitialize. When the event handling
+     * script has been loaded, the body of each registered procedure is
+     * compared to its default body. Indentation, empty lines and comment
+     * lines are ignored. Use isDefaultProc to find out if a procedure still
+     * has its default definition, e.g. to replace it with a native
+     * implementation.
+     */
+    void addDefaultProc(const std::string& proc, const std::string& body);
+
+    /**
+     * @brief 	Check if a procedure still has its default definition
+     * @param 	proc The fully qualified name of the procedure
+     * @return	Returns \em true if the loaded procedure match the default
+     *
+     * Only valid after the event handling script have been loaded.
+     */
+    bool isDefaultProc(const std::string& proc) const;
+
+    /**
+     * @brief 	Keep track of whether a TCL list variable is empty
+     * @param 	var The fully qualified name of the list variable
+     *
+     * Must be called before startInitialize. A variable trace is set up
+     * when the event handling script has been loaded so that the state is
+     * known without calling into the TCL interpreter.
+     */
+    void addWatchedList(const std::string& var);
+
+    /**
+     * @brief 	Check if a watched TCL list variable is empty
+     * @param 	var The fully qualified name of the list variable
+     * @return	Returns \em true if the list is known to be empty
+     */
+    bool watchedListIsEmpty(const std::string& var) const;
+
+    /**
+     * @brief 	Check if all queued jobs have been handled
+     * @return	Returns \em true if there is no pending TCL work or output
+     *
+     * Always true when not running the event handler in a separate thread.
+     * Output produced natively must only be sent when the event handler is
+     * idle, or else it would be mixed up with queued TCL output.
      */
-    const std::string eventResult(void) const;
+    bool isIdle(void) const;
     
     /**
      * @brief 	A signal that is emitted when the TCL script want to play
@@ -225,30 +354,172 @@ class EventHandler : public sigc::trackable
      * @param 	duration  The duration of each digit in milliseconds
      */
     sigc::signal<void, const std::string&, int> injectDtmf;
+
+    /**
+     * @brief 	A signal that is emitted when the TCL script start a
+     *	      	composition of announcements
+     * @param 	key The name of the composition
+     *
+     * See MsgHandler::beginComposition for more information.
+     */
+    sigc::signal<void, const std::string&>  compositionBegin;
+
+    /**
+     * @brief 	A signal that is emitted when the TCL script end a
+     *	      	composition of announcements
+     */
+    sigc::signal<void>                      compositionEnd;
+
+    /**
+     * @brief 	A signal that is emitted before the output from an event
+     *
+     * This signal is only emitted when the event handler run in a separate
+     * thread. It is emitted before the signals requested by the TCL script
+     * while handling one event, like playFile, so that they can be grouped
+     * together in the same way as if the event had been handled directly.
+     */
+    sigc::signal<void>                      eventOutputBegin;
+
+    /**
+     * @brief 	A signal that is emitted after the output from an event
+     *
+     * This signal is only emitted when the event handler run in a separate
+     * thread. Each eventOutputBegin is followed by one eventOutputEnd.
+     */
+    sigc::signal<void>                      eventOutputEnd;
     
   protected:
 
   private:
-    std::string   event_script;
-    std::string   logic_name;
-    Tcl_Interp *  interp;
+    struct EventProc
+    {
+      EventProc(void) : cmd(0), calls(0), total_us(0) {}
+      Tcl_Obj *     cmd;
+      unsigned long calls;
+      uint64_t      total_us;
+    };
+    typedef std::map<std::string, EventProc> EventProcMap;
+
+    struct WatchedList
+    {
+      WatchedList(void) : handler(0), is_empty(false) {}
+      EventHandler *  handler;
+      std::string     var;
+      bool            is_empty;
+    };
+    typedef std::map<std::string, WatchedList> WatchedListMap;
+
+    struct Job
+    {
+      typedef enum { SET_VARIABLE, EVAL_FILE, PROCESS_EVENT } Type;
+      Job(Type type, const std::string& str1="", const std::string& str2="")
+        : type(type), str1(str1), str2(str2) {}
+      Type        type;
+      std::string str1;
+      std::string str2;
+    };
+
+    struct Output
+    {
+      typedef enum
+      {
+        EVENT_BEGIN, EVENT_END, PLAY_FILE, PLAY_SILENCE, PLAY_TONE,
+        PLAY_DTMF, RECORD_START, RECORD_STOP, DEACTIVATE_MODULE,
+        PUBLISH_STATE_EVENT, INJECT_DTMF, COMPOSITION_BEGIN, COMPOSITION_END
+      } Type;
+      Output(Type type, const std::string& str1="",
+             const std::string& str2="", int arg1=0, int arg2=0, int arg3=0)
+        : type(type), str1(str1), str2(str2), arg1(arg1), arg2(arg2),
+          arg3(arg3) {}
+      Type        type;
+      std::string str1;
+      std::string str2;
+      int         arg1;
+      int         arg2;
+      int         arg3;
+    };
+
+    static const int MAX_EVENT_WORDS = 16;
+
+    static bool script_cache_enabled;
+
+    std::string         event_script;
+    std::string         logic_name;
+    Tcl_Interp *        interp;
+    EventProcMap        event_procs;
+    std::map<std::string, std::string> default_proc_bodies;
+    std::set<std::string> default_procs;
+    WatchedListMap      watched_lists;
+    unsigned            warn_time;
+    bool                use_thread;
+    pthread_t           thread;
+    bool                thread_started;
+    mutable pthread_mutex_t mutex;
+    pthread_cond_t      job_cond;
+    pthread_cond_t      done_cond;
+    std::deque<Job>     jobs;
+    unsigned long       queued_jobs;
+    unsigned long       done_jobs;
+    unsigned long       last_event_job;
+    bool                last_job_ok;
+    unsigned long       init_job;
+    bool                init_ok;
+    std::string         last_result;
+    bool                quit;
+    std::vector<Output> outputs;
+    bool                in_event;
+    bool                event_has_output;
+    int                 notifier_rd;
+    int                 notifier_wr;
+    Async::FdWatch *    notifier_watch;
+
+    bool createInterp(void);
+    void deleteInterp(void);
+    bool evalFile(void);
+    static std::string normalizeProcBody(const std::string& body);
+    void checkDefaultProcs(void);
+    void setupWatchedLists(void);
+    static char *watchedListTraceHandler(ClientData cdata, Tcl_Interp *irp,
+                                         const char *name1, const char *name2,
+                                         int flags);
+    void updateWatchedList(WatchedList& wl);
+    static int evalCachedFile(Tcl_Interp *irp, const std::string& filename);
+    void setVariableP(const std::string& name, const std::string& value);
+    bool handleEvent(const std::string& event);
+    int evalEvent(const std::string& event, EventProc& proc);
+    void output(const Output& out);
+    void emitOutput(const Output& out);
+    void emitQueuedOutputs(void);
+    unsigned long queueJob(const Job& job);
+    bool waitForJob(unsigned long job_no);
+    static void *threadFunc(void *arg);
+    void run(void);
+    void notificationReceived(Async::FdWatch *w);
 
     static int playFileHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	    int argc, const char *argv[]);
+                    int objc, Tcl_Obj *const objv[]);
     static int playSilenceHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	    int argc, const char *argv[]);
+                    int objc, Tcl_Obj *const objv[]);
     static int playToneHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	    int argc, const char *argv[]);
+                    int objc, Tcl_Obj *const objv[]);
     static int recordHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	    int argc, const char *argv[]);
+                    int objc, Tcl_Obj *const objv[]);
     static int deactivateModuleHandler(ClientData cdata, Tcl_Interp *irp,
-      	      	    int argc, const char *argv[]);
+                    int objc, Tcl_Obj *const objv[]);
     static int publishStateEventHandler(ClientData cdata, Tcl_Interp *irp,
-      	            int argc, const char *argv[]);
+                    int objc, Tcl_Obj *const objv[]);
     static int playDtmfHandler(ClientData cdata, Tcl_Interp *irp,
-                    int argc, const char *argv[]);
+                    int objc, Tcl_Obj *const objv[]);
     static int injectDtmfHandler(ClientData cdata, Tcl_Interp *irp,
-                    int argc, const char *argv[]);
+                    int objc, Tcl_Obj *const objv[]);
+    static int composeHandler(ClientData cdata, Tcl_Interp *irp,
+                    int objc, Tcl_Obj *const objv[]);
+    static int sourceHandler(ClientData cdata, Tcl_Interp *irp,
+                    int objc, Tcl_Obj *const objv[]);
+    static int voiceMailIndexHandler(ClientData cdata, Tcl_Interp *irp,
+                    int objc, Tcl_Obj *const objv[]);
+    static int findSoundClipHandler(ClientData cdata, Tcl_Interp *irp,
+                    int objc, Tcl_Obj *const objv[]);
 
 };  /* class EventHandler */
 
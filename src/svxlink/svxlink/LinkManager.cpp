@@ -280,11 +280,14 @@ void LinkManager::addLogic(LogicBase *logic)
   sinks[logic->name()].sink = logic->logicConIn();
   sinks[logic->name()].selector = selector;
 
-    // Now create a connection from the new logic source to each sink.
+    // Now create a connection from the new logic source to each sink. The
+    // splitter branches are disabled until the connection is established so
+    // that audio is only copied along the currently active routes.
   for (SinkMap::iterator it=sinks.begin(); it != sinks.end(); ++it)
   {
     AudioPassthrough *connector = new AudioPassthrough;
     splitter->addSink(connector, true);
+    splitter->enableSink(connector, false);
     AudioSelector *other_selector = (*it).second.selector;
     other_selector->addSource(connector);
     (*it).second.connectors[logic->name()] = connector;
@@ -295,6 +298,7 @@ void LinkManager::addLogic(LogicBase *logic)
   {
     AudioPassthrough *connector = new AudioPassthrough;
     (*it).second.splitter->addSink(connector, true);
+    (*it).second.splitter->enableSink(connector, false);
     selector->addSource(connector);
     sinks[logic->name()].connectors[(*it).first] = connector;
   }
@@ -720,8 +724,7 @@ void LinkManager::activateLink(Link &link)
     const string &src_name = it->first;
     const string &sink_name = it->second;
     //cout << "### " << src_name << " ===> " << sink_name << endl;
-    SinkInfo &sink = sinks[sink_name];
-    sink.selector->enableAutoSelect(sink.connectors[src_name], 0);
+    setRouteEnabled(src_name, sink_name, true);
 
       // Store all connections in "current_cons" (current connections)
     current_cons.insert(*it);
@@ -764,12 +767,8 @@ void LinkManager::deactivateLink(Link &link)
     const string &sink_name = it->second;
     //cout << "### " << src_name << " =X=> " << sink_name << endl;
 
-    SinkMap::iterator sink_it = sinks.find(sink_name);
-    assert(sink_it != sinks.end());
-    SinkInfo &sink = (*sink_it).second;
-
       // Disconnect the audio path from source logic to sink logic
-    sink.selector->disableAutoSelect(sink.connectors[src_name]);
+    setRouteEnabled(src_name, sink_name, false);
 
       // Delete the link connect information
     current_cons.erase(*it);
@@ -781,6 +780,33 @@ void LinkManager::deactivateLink(Link &link)
 } /* LinkManager::deactivateLink */
 
 
+void LinkManager::setRouteEnabled(const std::string& src_name,
+                                  const std::string& sink_name, bool enable)
+{
+  SourceMap::iterator src_it = sources.find(src_name);
+  assert(src_it != sources.end());
+  SinkMap::iterator sink_it = sinks.find(sink_name);
+  assert(sink_it != sinks.end());
+  SinkInfo &sink = (*sink_it).second;
+  ConMap::iterator con_it = sink.connectors.find(src_name);
+  assert(con_it != sink.connectors.end());
+  AudioPassthrough *connector = (*con_it).second;
+
+    // A disabled splitter branch is skipped altogether so audio is only
+    // copied to the sinks that currently are connected to the source
+  if (enable)
+  {
+    (*src_it).second.splitter->enableSink(connector, true);
+    sink.selector->enableAutoSelect(connector, 0);
+  }
+  else
+  {
+    sink.selector->disableAutoSelect(connector);
+    (*src_it).second.splitter->enableSink(connector, false);
+  }
+} /* LinkManager::setRouteEnabled */
+
+
 void LinkManager::sendCmdToLogics(Link& link, LogicBase* src_logic,
                                   const std::string& cmd)
 {
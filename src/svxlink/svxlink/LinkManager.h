@@ -335,6 +335,8 @@ class LinkManager : public sigc::trackable
     void wantedConnections(LogicConSet &want);
     void activateLink(Link &link);
     void deactivateLink(Link &link);
+    void setRouteEnabled(const std::string& src_name,
+                         const std::string& sink_name, bool enable);
     void sendCmdToLogics(Link &link, LogicBase *src_logic,
                          const std::string& cmd);
     /*
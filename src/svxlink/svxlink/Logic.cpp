@@ -62,7 +62,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncTimer.h>
 #include <Rx.h>
 #include <Tx.h>
-#include <AsyncAudioPassthrough.h>
 #include <AsyncAudioMixer.h>
 #include <AsyncAudioAmp.h>
 #include <AsyncAudioSelector.h>
@@ -71,8 +70,14 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioFifo.h>
 #include <AsyncAudioStreamStateDetector.h>
 #include <AsyncAudioPacer.h>
+#include <AsyncAudioClockedFifo.h>
 #include <AsyncAudioDebugger.h>
 #include <AsyncAudioRecorder.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncAudioPassthrough.h>
+#include <AsyncMetrics.h>
+#include <AsyncAudioLatencyTrace.h>
+#include <AsyncAudioLatencyBudget.h>
 #include <common.h>
 #include <config.h>
 
@@ -89,6 +94,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "LogicCmds.h"
 #include "Logic.h"
 #include "QsoRecorder.h"
+#include "SoundPack.h"
 #include "LinkManager.h"
 #include "DtmfDigitHandler.h"
 
@@ -120,6 +126,51 @@ using namespace SvxLink;
  *
  ****************************************************************************/
 
+namespace {
+  /**
+   * @brief An audio passthrough counting the samples in a metrics counter
+   *
+   * The latency of sampled blocks passing is recorded as well, in a stage
+   * named after the direction.
+   */
+  class AudioSampleCounter : public Async::AudioPassthrough
+  {
+    public:
+      AudioSampleCounter(const std::string& logic_name,
+                         const std::string& direction)
+        : m_counter(Async::Metrics::instance().counter(
+              "svxlink_logic_audio_samples",
+              "Number of audio samples passed through the logic core",
+              labels(logic_name, direction))),
+          m_latency_stage("logic_" + direction)
+      {
+      }
+
+      virtual int writeSamples(const float *samples, int count)
+      {
+        AudioLatencyTrace::stage(m_latency_stage.c_str());
+        int ret = sinkWriteSamples(samples, count);
+        if (ret > 0)
+        {
+          m_counter.inc(ret);
+        }
+        return ret;
+      }
+
+    private:
+      Async::MetricCounter& m_counter;
+      std::string           m_latency_stage;
+
+      static Async::Metrics::Labels labels(const std::string& logic_name,
+                                           const std::string& direction)
+      {
+        Async::Metrics::Labels l(Async::Metrics::labels("logic", logic_name));
+        l["direction"] = direction;
+        return l;
+      }
+  };
+};
+
 
 
 /****************************************************************************
@@ -144,6 +195,60 @@ using namespace SvxLink;
  *
  ****************************************************************************/
 
+namespace {
+  /**
+   * The default definitions of the event handlers that have a native
+   * implementation. The logic namespace handler forward the call to the
+   * handler in the Logic namespace. The native implementation is only used
+   * if both are unchanged.
+   */
+  struct DefaultEventProc
+  {
+    const char *event;
+    const char *logic_body;
+    const char *base_body;
+  };
+  const DefaultEventProc default_event_procs[] =
+  {
+    { "squelch_open",
+      "Logic::squelch_open $rx_id $is_open;",
+      "variable sql_rx_id;\n"
+      "set sql_rx_id $rx_id;" },
+    { "transmit",
+      "Logic::transmit $is_on;",
+      "variable prev_ident;\n"
+      "variable need_ident;\n"
+      "if {$is_on && ([clock seconds] - $prev_ident > 5)} {\n"
+      "set need_ident 1;\n"
+      "}" },
+    { "dtmf_digit_received",
+      "return [Logic::dtmf_digit_received $digit $duration];",
+      "return 0;" },
+    { "every_minute",
+      "Logic::every_minute;",
+      "variable minute_tick_subscribers;\n"
+      "foreach subscriber $minute_tick_subscribers {\n"
+      "$subscriber;\n"
+      "}" },
+    { "every_second",
+      "Logic::every_second;",
+      "variable second_tick_subscribers;\n"
+      "foreach subscriber $second_tick_subscribers {\n"
+      "$subscriber;\n"
+      "}" },
+    { "send_rgr_sound",
+      "Logic::send_rgr_sound;",
+      "variable sql_rx_id\n"
+      "if {$sql_rx_id != \"?\"} {\n"
+      "CW::play $sql_rx_id 150 1000 -4\n"
+      "set sql_rx_id \"?\"\n"
+      "} else {\n"
+      "playTone 440 500 100\n"
+      "}\n"
+      "playSilence 100" },
+  };
+};
+
 
 
 /****************************************************************************
@@ -170,7 +275,8 @@ Logic::Logic(Config &cfg, const string& name)
     tx_ctcss_mask(0),
     currently_set_tx_ctrl_mode(Tx::TX_OFF), is_online(true),
     dtmf_digit_handler(0),                  state_pty(0),
-    dtmf_ctrl_pty(0)
+    dtmf_ctrl_pty(0),                       native_events_enabled(true),
+    native_sql_rx_id("?"),                  native_event_handled(false)
 {
   rgr_sound_timer.expired.connect(sigc::hide(
         mem_fun(*this, &Logic::sendRgrSound)));
@@ -319,7 +425,20 @@ bool Logic::initialize(void)
     for (mlit=macro_list.begin(); mlit!=macro_list.end(); ++mlit)
     {
       cfg().getValue(macro_section, *mlit, value);
-      macros[atoi(mlit->c_str())] = value;
+      stringstream ss;
+      ss << atoi(mlit->c_str());
+      Command *old_macro = macro_parser.findCmd(ss.str());
+      if (old_macro != 0)
+      {
+        delete old_macro;
+      }
+      MacroCmd *macro = new MacroCmd(&macro_parser, ss.str(), value);
+      macro->addToParser();
+      if (!macro->isValid())
+      {
+        cerr << "*** WARNING: No colon found in macro " << *mlit << " ("
+             << value << ") in section " << macro_section << "\n";
+      }
     }
   }
 
@@ -381,6 +500,9 @@ bool Logic::initialize(void)
   cfg().getValue(name(), "FX_GAIN_NORMAL", fx_gain_normal);
   cfg().getValue(name(), "FX_GAIN_LOW", fx_gain_low);
 
+  unsigned audio_block_time = 0;
+  cfg().getValue("GLOBAL", "AUDIO_BLOCK_TIME", audio_block_time);
+
   AudioSource *prev_rx_src = 0;
 
     // Create the RX object
@@ -408,6 +530,19 @@ bool Logic::initialize(void)
   prev_rx_src->registerSink(rx_valve, true);
   prev_rx_src = rx_valve;
 
+  AudioSampleCounter *rx_counter = new AudioSampleCounter(name(), "rx");
+  prev_rx_src->registerSink(rx_counter, true);
+  prev_rx_src = rx_counter;
+
+    // Optionally move RX audio in fixed size blocks on a shared clock tick
+  if (audio_block_time > 0)
+  {
+    AudioClockedFifo *rx_clock = new AudioClockedFifo(INTERNAL_SAMPLE_RATE,
+                                                      audio_block_time);
+    prev_rx_src->registerSink(rx_clock, true);
+    prev_rx_src = rx_clock;
+  }
+
     // Split the RX audio stream to multiple sinks
   rx_splitter = new AudioSplitter;
   prev_rx_src->registerSink(rx_splitter, true);
@@ -416,27 +551,25 @@ bool Logic::initialize(void)
     // Create a selector for audio to the module
   audio_to_module_selector = new AudioSelector;
 
-    // Connect RX audio to the modules
-  AudioPassthrough *passthrough = new AudioPassthrough;
-  rx_splitter->addSink(passthrough, true);
-  audio_to_module_selector->addSource(passthrough);
-  audio_to_module_selector->enableAutoSelect(passthrough, 10);
+    // Connect RX audio to the modules. The splitter outputs are connected
+    // directly to the selectors to not add any extra hops in the audio path.
+  AudioSource *splitter_out = rx_splitter->addOutput();
+  audio_to_module_selector->addSource(splitter_out);
+  audio_to_module_selector->enableAutoSelect(splitter_out, 10);
 
     // Connect inter logic audio input to the modules
-  passthrough = new AudioPassthrough;
-  logic_con_in->addSink(passthrough, true);
-  audio_to_module_selector->addSource(passthrough);
-  audio_to_module_selector->enableAutoSelect(passthrough, 0);
+  splitter_out = logic_con_in->addOutput();
+  audio_to_module_selector->addSource(splitter_out);
+  audio_to_module_selector->enableAutoSelect(splitter_out, 0);
 
     // Split audio to all modules
   audio_to_module_splitter = new AudioSplitter;
   audio_to_module_selector->registerSink(audio_to_module_splitter, true);
 
     // Connect RX audio to inter logic audio output
-  passthrough = new AudioPassthrough;
-  rx_splitter->addSink(passthrough, true);
-  logic_con_out->addSource(passthrough);
-  logic_con_out->enableAutoSelect(passthrough, 10);
+  splitter_out = rx_splitter->addOutput();
+  logic_con_out->addSource(splitter_out);
+  logic_con_out->enableAutoSelect(splitter_out, 10);
 
     // A valve that is used to turn direct RX to TX audio on or off.
     // Used by the repeater logic.
@@ -465,7 +598,17 @@ bool Logic::initialize(void)
     // Create a selector and a splitter to handle audio from modules
   audio_from_module_selector = new AudioSelector;
   AudioSplitter *audio_from_module_splitter = new AudioSplitter;
-  audio_from_module_selector->registerSink(audio_from_module_splitter, true);
+  if (audio_block_time > 0)
+  {
+    AudioClockedFifo *module_clock = new AudioClockedFifo(
+        INTERNAL_SAMPLE_RATE, audio_block_time);
+    audio_from_module_selector->registerSink(module_clock, true);
+    module_clock->registerSink(audio_from_module_splitter, true);
+  }
+  else
+  {
+    audio_from_module_selector->registerSink(audio_from_module_splitter, true);
+  }
 
     // Connect audio from modules to the TX audio selector
     // via an audio stream state detector
@@ -478,10 +621,9 @@ bool Logic::initialize(void)
   tx_audio_selector->enableAutoSelect(audio_from_module_idle_det, 0);
 
     // Connect audio from modules to the inter logic audio output
-  passthrough = new AudioPassthrough;
-  audio_from_module_splitter->addSink(passthrough, true);
-  logic_con_out->addSource(passthrough);
-  logic_con_out->enableAutoSelect(passthrough, 0);
+  splitter_out = audio_from_module_splitter->addOutput();
+  logic_con_out->addSource(splitter_out);
+  logic_con_out->enableAutoSelect(splitter_out, 0);
 
     // Create the qso recorder if QSO_RECORDER is properly set
   SepPair<string, string> qso_rec_cfg;
@@ -516,14 +658,10 @@ bool Logic::initialize(void)
     }
 
       // Connect RX audio and link audio to the qso recorder
-    passthrough = new AudioPassthrough;
-    audio_to_module_splitter->addSink(passthrough, true);
-    qso_recorder->addSource(passthrough, 10);
+    qso_recorder->addSource(audio_to_module_splitter->addOutput(), 10);
 
       // Connect audio from modules to the qso recorder
-    passthrough = new AudioPassthrough;
-    audio_from_module_splitter->addSink(passthrough, true);
-    qso_recorder->addSource(passthrough, 0);
+    qso_recorder->addSource(audio_from_module_splitter->addOutput(), 0);
   }
 
     // Create the state detector
@@ -536,6 +674,9 @@ bool Logic::initialize(void)
     // Add a pre-buffered FIFO to avoid underrun
   AudioFifo *tx_fifo = new AudioFifo(1024 * INTERNAL_SAMPLE_RATE / 8000);
   tx_fifo->setPrebufSamples(512 * INTERNAL_SAMPLE_RATE / 8000);
+  AudioLatencyBudget::add(name() + ":tx_fifo", tx_fifo,
+                          128 * INTERNAL_SAMPLE_RATE / 8000,
+                          512 * INTERNAL_SAMPLE_RATE / 8000);
   prev_tx_src->registerSink(tx_fifo, true);
   prev_tx_src = tx_fifo;
 
@@ -558,12 +699,44 @@ bool Logic::initialize(void)
   tx().transmitterStateChange.connect(
       mem_fun(*this, &Logic::transmitterStateChange));
   tx().publishStateEvent.connect(mem_fun(*this, &Logic::onPublishStateEvent));
+  AudioSampleCounter *tx_counter = new AudioSampleCounter(name(), "tx");
+  prev_tx_src->registerSink(tx_counter, true);
+  prev_tx_src = tx_counter;
   prev_tx_src->registerSink(m_tx);
   prev_tx_src = 0;
 
     // Create the message handler
   msg_handler = new MsgHandler(INTERNAL_SAMPLE_RATE);
   msg_handler->allMsgsWritten.connect(mem_fun(*this, &Logic::allMsgsWritten));
+  vector<string> msg_sound_packs;
+  cfg().getValue(name(), "MSG_SOUND_PACK", msg_sound_packs);
+  for (vector<string>::const_iterator it = msg_sound_packs.begin();
+       it != msg_sound_packs.end(); ++it)
+  {
+    if (!SoundPack::instance().load(*it, INTERNAL_SAMPLE_RATE))
+    {
+      cerr << "*** WARNING: " << name() << ": Sound pack \"" << *it
+           << "\" not loaded. Playing sound clips from files instead.\n";
+    }
+  }
+  unsigned msg_cache_size = 0;
+  cfg().getValue(name(), "MSG_CACHE_SIZE", msg_cache_size);
+  msg_handler->setClipCacheSize(1024 * msg_cache_size);
+  bool msg_cache_mmap = false;
+  cfg().getValue(name(), "MSG_CACHE_MMAP", msg_cache_mmap);
+  msg_handler->setClipCacheMmap(msg_cache_mmap);
+  string msg_cache_prefetch;
+  if ((msg_cache_size > 0) &&
+      cfg().getValue(name(), "MSG_CACHE_PREFETCH", msg_cache_prefetch))
+  {
+    unsigned cnt = msg_handler->prefetchClips(msg_cache_prefetch);
+    cout << name() << ": Prefetched " << cnt << " sound clips from \""
+         << msg_cache_prefetch << "\"\n";
+  }
+  unsigned msg_composition_cache_size = 1024;
+  cfg().getValue(name(), "MSG_COMPOSITION_CACHE_SIZE",
+                 msg_composition_cache_size);
+  msg_handler->setCompositionCacheSize(1024 * msg_composition_cache_size);
   prev_tx_src = msg_handler;
 
     // This gain control is used to reduce the audio volume of effects
@@ -580,7 +753,17 @@ bool Logic::initialize(void)
   tx_audio_mixer->addSource(msg_pacer);
   prev_tx_src = 0;
 
-  event_handler = new EventHandler(event_handler_str, name());
+  bool event_handler_thread = false;
+  cfg().getValue(name(), "EVENT_HANDLER_THREAD", event_handler_thread);
+  event_handler = new EventHandler(event_handler_str, name(),
+                                   event_handler_thread);
+  unsigned event_handler_warn_time = 0;
+  cfg().getValue(name(), "EVENT_HANDLER_WARN_TIME", event_handler_warn_time);
+  event_handler->setWarnTime(event_handler_warn_time);
+  event_handler->eventOutputBegin.connect(
+          mem_fun(*msg_handler, &MsgHandler::begin));
+  event_handler->eventOutputEnd.connect(
+          mem_fun(*msg_handler, &MsgHandler::end));
   event_handler->playFile.connect(mem_fun(*this, &Logic::playFile));
   event_handler->playSilence.connect(mem_fun(*this, &Logic::playSilence));
   event_handler->playTone.connect(mem_fun(*this, &Logic::playTone));
@@ -592,6 +775,10 @@ bool Logic::initialize(void)
           mem_fun(*this, &Logic::onPublishStateEvent));
   event_handler->playDtmf.connect(mem_fun(*this, &Logic::playDtmf));
   event_handler->injectDtmf.connect(mem_fun(*this, &Logic::injectDtmf));
+  event_handler->compositionBegin.connect(
+      mem_fun(*msg_handler, &MsgHandler::beginComposition));
+  event_handler->compositionEnd.connect(
+      mem_fun(*this, &Logic::compositionEnd));
   event_handler->setVariable("mycall", m_callsign);
   char str[256];
   sprintf(str, "%.1f", report_ctcss);
@@ -603,18 +790,7 @@ bool Logic::initialize(void)
   updateTxCtcss(true, TX_CTCSS_ALWAYS);
 
   loadModules();
-
-  string loaded_modules;
-  list<Module*>::const_iterator mit;
-  for (mit=modules.begin(); mit!=modules.end(); ++mit)
-  {
-    if (!loaded_modules.empty())
-    {
-      loaded_modules += " ";
-    }
-    loaded_modules += (*mit)->name();
-  }
-  event_handler->setVariable("loaded_modules", loaded_modules);
+  updateLoadedModulesVar();
 
   event_handler->processEvent("namespace eval Logic {}");
   list<string> cfgvars = cfg().listSection(name());
@@ -627,12 +803,17 @@ bool Logic::initialize(void)
     event_handler->setVariable(var, value);
   }
 
-  if (!event_handler->initialize())
+  cfg().getValue(name(), "NATIVE_EVENT_HANDLERS", native_events_enabled);
+  if (native_events_enabled)
   {
-    cleanup();
-    return false;
+    addDefaultEventProcs();
   }
 
+    // Loading the event handler script may continue in the background if
+    // the event handler run in its own thread. The result is checked in
+    // finishInitialize.
+  event_handler->startInitialize();
+
   if (LocationInfo::has_instance())
   {
      LocationInfo::AprsStatistics lis;
@@ -693,12 +874,27 @@ bool Logic::initialize(void)
 } /* Logic::initialize */
 
 
+bool Logic::finishInitialize(void)
+{
+  if ((event_handler == 0) || !event_handler->waitInitialized())
+  {
+    return false;
+  }
+  setupNativeEvents();
+  return true;
+} /* Logic::finishInitialize */
+
+
 void Logic::processEvent(const string& event, const Module *module)
 {
   msg_handler->begin();
+  native_event_handled = false;
   if (module == 0)
   {
-    event_handler->processEvent(name() + "::" + event);
+    if (!processNativeEvent(event))
+    {
+      event_handler->processEvent(name() + "::" + event);
+    }
   }
   else
   {
@@ -770,6 +966,19 @@ void Logic::playDtmf(const std::string& digits, int amp, int len)
 } /* Logic::playDtmf */
 
 
+void Logic::compositionEnd(void)
+{
+  msg_handler->endComposition();
+
+  if (!msg_handler->isIdle())
+  {
+    updateTxCtcss(true, TX_CTCSS_ANNOUNCEMENT);
+  }
+
+  checkIdle();
+} /* Logic::compositionEnd */
+
+
 void Logic::recordStart(const string& filename, unsigned max_time)
 {
   recordStop();
@@ -856,6 +1065,15 @@ Module *Logic::findModule(int id)
     }
   }
 
+  LazyModuleList::iterator lit;
+  for (lit=lazy_modules.begin(); lit!=lazy_modules.end(); ++lit)
+  {
+    if (lit->id == id)
+    {
+      return loadLazyModule(lit);
+    }
+  }
+
   return 0;
 
 } /* Logic::findModule */
@@ -872,11 +1090,32 @@ Module *Logic::findModule(const string& name)
     }
   }
 
+  LazyModuleList::iterator lit;
+  for (lit=lazy_modules.begin(); lit!=lazy_modules.end(); ++lit)
+  {
+    if (lit->name == name)
+    {
+      return loadLazyModule(lit);
+    }
+  }
+
   return 0;
 
 } /* Logic::findModule */
 
 
+list<Module*> Logic::moduleList(void)
+{
+    // Anyone asking for the full module list will want all modules so load
+    // the ones that have not been used yet
+  while (!lazy_modules.empty())
+  {
+    loadLazyModule(lazy_modules.begin());
+  }
+  return modules;
+} /* Logic::moduleList */
+
+
 void Logic::dtmfDigitDetected(char digit, int duration)
 {
   if (active_module != 0)
@@ -1165,27 +1404,36 @@ void Logic::loadModules(void)
     return;
   }
 
+  bool lazy_load = false;
+  cfg().getValue(name(), "LAZY_MODULE_LOAD", lazy_load);
+
   string::iterator comma;
   string::iterator begin = modules.begin();
   do
   {
     comma = find(begin, modules.end(), ',');
-    if (comma == modules.end())
+    string module_name(begin, comma);
+    if (comma != modules.end())
     {
-      string module_name(begin, modules.end());
-      loadModule(module_name);
+      begin = comma + 1;
+    }
+
+    bool module_lazy_load = lazy_load;
+    cfg().getValue(module_name, "LAZY_LOAD", module_lazy_load);
+    if (module_lazy_load)
+    {
+      registerLazyModule(module_name);
     }
     else
     {
-      string module_name(begin, comma);
       loadModule(module_name);
-      begin = comma + 1;
     }
   } while (comma != modules.end());
 } /* Logic::loadModules */
 
 
-void Logic::loadModule(const string& module_cfg_name)
+Module *Logic::loadModule(const string& module_cfg_name,
+                          bool add_activate_cmd)
 {
   cout << "Loading module \"" << module_cfg_name << "\" into logic \""
        << name() << "\"\n";
@@ -1212,7 +1460,7 @@ void Logic::loadModule(const string& module_cfg_name)
       cerr << "*** ERROR: Failed to load module "
         << module_cfg_name.c_str() << " into logic " << name() << ": "
         << dlerror() << endl;
-      return;
+      return 0;
     }
   }
   else
@@ -1228,7 +1476,7 @@ void Logic::loadModule(const string& module_cfg_name)
         cerr << "*** ERROR: Failed to load module "
           << module_cfg_name.c_str() << " into logic " << name() << ": "
           << dlerror() << endl;
-        return;
+        return 0;
       }
     }
   }
@@ -1240,7 +1488,7 @@ void Logic::loadModule(const string& module_cfg_name)
       	 << module_cfg_name.c_str() << " in logic " << name() << ": "
          << dlerror() << endl;
     dlclose(handle);
-    return;
+    return 0;
   }
   cout << "\tFound " << link_map->l_name << endl;
 
@@ -1251,7 +1499,7 @@ void Logic::loadModule(const string& module_cfg_name)
       	 << module_cfg_name.c_str() << " in logic " << name() << ": "
          << dlerror() << endl;
     dlclose(handle);
-    return;
+    return 0;
   }
 
   Module *module = init(handle, this, module_cfg_name.c_str());
@@ -1260,7 +1508,7 @@ void Logic::loadModule(const string& module_cfg_name)
     cerr << "*** ERROR: Creation failed for module "
       	 << module_cfg_name.c_str() << " in logic " << name() << endl;
     dlclose(handle);
-    return;
+    return 0;
   }
 
   if (!module->initialize())
@@ -1269,26 +1517,15 @@ void Logic::loadModule(const string& module_cfg_name)
       	 << module_cfg_name.c_str() << " in logic " << name() << endl;
     delete module;
     dlclose(handle);
-    return;
+    return 0;
   }
 
-  if (module->id() >= 0)
+  if (add_activate_cmd && (module->id() >= 0) &&
+      !addModuleActivateCmd(module->id(), module_cfg_name))
   {
-    stringstream ss;
-    ss << module->id();
-    ModuleActivateCmd *cmd = new ModuleActivateCmd(&cmd_parser, ss.str(), this);
-    if (!cmd->addToParser())
-    {
-      cerr << "\n*** ERROR: Failed to add module activation command for "
-           << "module \"" << module_cfg_name << "\" in logic \"" << name()
-           << "\". This is probably due to having set up two modules with the "
-           << "same module id or choosing a module id that is the same as "
-           << "another command.\n\n";
-      delete cmd;
-      delete module;
-      dlclose(handle);
-      return;
-    }
+    delete module;
+    dlclose(handle);
+    return 0;
   }
 
     // Connect module audio output to the module audio selector
@@ -1301,9 +1538,78 @@ void Logic::loadModule(const string& module_cfg_name)
 
   modules.push_back(module);
 
+  return module;
+
 } /* Logic::loadModule */
 
 
+void Logic::registerLazyModule(const string& module_cfg_name)
+{
+  LazyModule lazy;
+  lazy.cfg_name = module_cfg_name;
+  lazy.name = module_cfg_name;
+  lazy.id = -1;
+  cfg().getValue(module_cfg_name, "NAME", lazy.name);
+  cfg().getValue(module_cfg_name, "ID", lazy.id);
+
+  cout << "Registering module \"" << module_cfg_name << "\" in logic \""
+       << name() << "\" for loading on first use\n";
+
+  if ((lazy.id >= 0) && !addModuleActivateCmd(lazy.id, module_cfg_name))
+  {
+    return;
+  }
+  lazy_modules.push_back(lazy);
+} /* Logic::registerLazyModule */
+
+
+Module *Logic::loadLazyModule(LazyModuleList::iterator it)
+{
+    // Only one load attempt is made. If it fails the module activation
+    // command will report the module as missing.
+  string module_cfg_name(it->cfg_name);
+  lazy_modules.erase(it);
+  Module *module = loadModule(module_cfg_name, false);
+  updateLoadedModulesVar();
+  return module;
+} /* Logic::loadLazyModule */
+
+
+bool Logic::addModuleActivateCmd(int id, const string& module_cfg_name)
+{
+  stringstream ss;
+  ss << id;
+  ModuleActivateCmd *cmd = new ModuleActivateCmd(&cmd_parser, ss.str(), this);
+  if (!cmd->addToParser())
+  {
+    cerr << "\n*** ERROR: Failed to add module activation command for "
+         << "module \"" << module_cfg_name << "\" in logic \"" << name()
+         << "\". This is probably due to having set up two modules with the "
+         << "same module id or choosing a module id that is the same as "
+         << "another command.\n\n";
+    delete cmd;
+    return false;
+  }
+  return true;
+} /* Logic::addModuleActivateCmd */
+
+
+void Logic::updateLoadedModulesVar(void)
+{
+  string loaded_modules;
+  list<Module*>::const_iterator mit;
+  for (mit=modules.begin(); mit!=modules.end(); ++mit)
+  {
+    if (!loaded_modules.empty())
+    {
+      loaded_modules += " ";
+    }
+    loaded_modules += (*mit)->name();
+  }
+  event_handler->setVariable("loaded_modules", loaded_modules);
+} /* Logic::updateLoadedModulesVar */
+
+
 void Logic::unloadModules(void)
 {
   deactivateModule(0);
@@ -1334,7 +1640,7 @@ void Logic::processCommandQueue(void)
     stringstream ss;
     ss << "dtmf_cmd_received \"" << cmd << "\"";
     processEvent(ss.str());
-    if (atoi(event_handler->eventResult().c_str()) != 0)
+    if (atoi(eventResult().c_str()) != 0)
     {
       continue;
     }
@@ -1413,28 +1719,29 @@ void Logic::processMacroCmd(const string& macro_cmd)
     return;
   }
 
-  map<int, string>::iterator it = macros.find(atoi(cmd.c_str()));
-  if (it == macros.end())
+  stringstream ss;
+  ss << atoi(cmd.c_str());
+  MacroCmd *macro = static_cast<MacroCmd *>(macro_parser.findCmd(ss.str()));
+  if (macro == 0)
   {
     cerr << "*** Macro error in logic " << name() << ": Macro "
          << cmd << " not found.\n";
     processEvent("macro_not_found");
     return;
   }
-  string macro(it->second);
-  cout << name() << ": Macro command found: \"" << macro << "\"\n";
+  cout << name() << ": Macro command found: \"" << macro->macroStr()
+       << "\"\n";
 
-  string::iterator colon = find(macro.begin(), macro.end(), ':');
-  if (colon == macro.end())
+  if (!macro->isValid())
   {
     cerr << "*** Macro error in logic " << name()
-         << ": No colon found in macro (" << macro << ").\n";
+         << ": No colon found in macro (" << macro->macroStr() << ").\n";
     processEvent("macro_syntax_error");
     return;
   }
 
-  string module_name(macro.begin(), colon);
-  string module_cmd(colon+1, macro.end());
+  const string& module_name = macro->moduleName();
+  const string module_cmd(macro->moduleCmd());
 
   if (!module_name.empty())
   {
@@ -1563,7 +1870,7 @@ void Logic::dtmfDigitDetectedP(char digit, int duration)
   stringstream ss;
   ss << "dtmf_digit_received " << digit << " " << duration;
   processEvent(ss.str());
-  if (atoi(event_handler->eventResult().c_str()) != 0)
+  if (atoi(eventResult().c_str()) != 0)
   {
     return;
   }
@@ -1689,6 +1996,158 @@ void Logic::detectedTone(float fq)
 } /* Logic::detectedTone */
 
 
+void Logic::addDefaultEventProcs(void)
+{
+  const size_t cnt = sizeof(default_event_procs) / sizeof(*default_event_procs);
+  for (size_t i=0; i<cnt; ++i)
+  {
+    const DefaultEventProc& dp = default_event_procs[i];
+    event_handler->addDefaultProc(name() + "::" + dp.event, dp.logic_body);
+    event_handler->addDefaultProc(string("Logic::") + dp.event, dp.base_body);
+  }
+  event_handler->addWatchedList("Logic::minute_tick_subscribers");
+  event_handler->addWatchedList("Logic::second_tick_subscribers");
+} /* Logic::addDefaultEventProcs */
+
+
+void Logic::setupNativeEvents(void)
+{
+  native_events.clear();
+  if (!native_events_enabled)
+  {
+    return;
+  }
+
+  NativeEventMap handlers;
+  handlers["squelch_open"] = &Logic::nativeSquelchOpen;
+  handlers["transmit"] = &Logic::nativeTransmit;
+  handlers["dtmf_digit_received"] = &Logic::nativeDtmfDigitReceived;
+  handlers["every_minute"] = &Logic::nativeEveryMinute;
+  handlers["every_second"] = &Logic::nativeEverySecond;
+  handlers["send_rgr_sound"] = &Logic::nativeSendRgrSound;
+
+  for (NativeEventMap::const_iterator it=handlers.begin();
+       it!=handlers.end(); ++it)
+  {
+    if (event_handler->isDefaultProc(name() + "::" + it->first) &&
+        event_handler->isDefaultProc("Logic::" + it->first))
+    {
+      native_events[it->first] = it->second;
+    }
+  }
+
+    // The roger sound depend on the receiver id stored by squelch_open
+  if (native_events.find("squelch_open") == native_events.end())
+  {
+    native_events.erase("send_rgr_sound");
+  }
+
+  if (!native_events.empty())
+  {
+    cout << name() << ": Handling unmodified events natively:";
+    for (NativeEventMap::const_iterator it=native_events.begin();
+         it!=native_events.end(); ++it)
+    {
+      cout << " " << it->first;
+    }
+    cout << endl;
+  }
+} /* Logic::setupNativeEvents */
+
+
+bool Logic::processNativeEvent(const std::string& event)
+{
+  istringstream is(event);
+  string event_name;
+  is >> event_name;
+  NativeEventMap::const_iterator it = native_events.find(event_name);
+  if (it == native_events.end())
+  {
+    return false;
+  }
+  native_event_result.clear();
+  native_event_handled = (this->*(it->second))(is);
+  return native_event_handled;
+} /* Logic::processNativeEvent */
+
+
+string Logic::eventResult(void)
+{
+  if (native_event_handled)
+  {
+    return native_event_result;
+  }
+  return event_handler->eventResult();
+} /* Logic::eventResult */
+
+
+bool Logic::nativeSquelchOpen(std::istream& args)
+{
+  string rx_id;
+  int is_open = 0;
+  if (!(args >> rx_id >> is_open))
+  {
+    return false;
+  }
+  native_sql_rx_id = rx_id;
+  if (native_events.find("send_rgr_sound") == native_events.end())
+  {
+    event_handler->setVariable("Logic::sql_rx_id", rx_id);
+  }
+  return true;
+} /* Logic::nativeSquelchOpen */
+
+
+bool Logic::nativeTransmit(std::istream& args)
+{
+  int is_on = 1;
+  if (!(args >> is_on))
+  {
+    return false;
+  }
+
+    // Decide if an identification is needed is left to the Tcl code
+  return (is_on == 0);
+} /* Logic::nativeTransmit */
+
+
+bool Logic::nativeDtmfDigitReceived(std::istream& args)
+{
+  native_event_result = "0";
+  return true;
+} /* Logic::nativeDtmfDigitReceived */
+
+
+bool Logic::nativeEveryMinute(std::istream& args)
+{
+  return event_handler->isIdle() &&
+         event_handler->watchedListIsEmpty("Logic::minute_tick_subscribers");
+} /* Logic::nativeEveryMinute */
+
+
+bool Logic::nativeEverySecond(std::istream& args)
+{
+  return event_handler->isIdle() &&
+         event_handler->watchedListIsEmpty("Logic::second_tick_subscribers");
+} /* Logic::nativeEverySecond */
+
+
+bool Logic::nativeSendRgrSound(std::istream& args)
+{
+    // Playing the receiver id using CW is left to the Tcl code. The same
+    // is true if there are Tcl events queued that may depend on the order.
+  if ((native_sql_rx_id != "?") || !event_handler->isIdle())
+  {
+    event_handler->setVariable("Logic::sql_rx_id", native_sql_rx_id);
+    native_sql_rx_id = "?";
+    return false;
+  }
+  playTone(440, 500, 100);
+  playSilence(100);
+  return true;
+} /* Logic::nativeSendRgrSound */
+
+
 /*
  * This file has not been truncated
  */
@@ -39,6 +39,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <iosfwd>
 #include <string>
 #include <list>
 #include <map>
@@ -167,6 +168,12 @@ class Logic : public LogicBase
 
     virtual bool initialize(void);
 
+    /**
+     * @brief 	Wait for the event handler script to be loaded
+     * @return	Returns \em true on success or \em false on failure
+     */
+    virtual bool finishInitialize(void);
+
     virtual void processEvent(const std::string& event, const Module *module=0);
     void setEventVariable(const std::string& name, const std::string& value);
     virtual void playFile(const std::string& path);
@@ -182,7 +189,7 @@ class Logic : public LogicBase
     Module *activeModule(void) const { return active_module; }
     Module *findModule(int id);
     Module *findModule(const std::string& name);
-    std::list<Module*> moduleList(void) const { return modules; }
+    std::list<Module*> moduleList(void);
 
     const std::string& callsign(void) const { return m_callsign; }
 
@@ -231,6 +238,17 @@ class Logic : public LogicBase
       TX_CTCSS_MODULE=8, TX_CTCSS_ANNOUNCEMENT=16
     } TxCtcssType;
 
+    struct LazyModule
+    {
+      std::string cfg_name;
+      std::string name;
+      int         id;
+    };
+    typedef std::list<LazyModule> LazyModuleList;
+
+    typedef bool (Logic::*NativeEventHandler)(std::istream& args);
+    typedef std::map<std::string, NativeEventHandler> NativeEventMap;
+
     struct AprsStatistics : public LocationInfo::AprsStatistics
     {
       time_t last_rx_sec;
@@ -242,12 +260,13 @@ class Logic : public LogicBase
     MsgHandler	      	      	    *msg_handler;
     Module    	      	      	    *active_module;
     std::list<Module*>	      	    modules;
+    LazyModuleList                  lazy_modules;
     std::string       	      	    m_callsign;
     std::list<std::string>    	    cmd_queue;
     Async::Timer      	      	    exec_cmd_on_sql_close_timer;
     Async::Timer      	      	    rgr_sound_timer;
     float       	      	    report_ctcss;
-    std::map<int, std::string>	    macros;
+    CmdParser 	      	      	    macro_parser;
     EventHandler      	      	    *event_handler;
     Async::AudioSelector      	    *logic_con_out;
     Async::AudioSplitter	    *logic_con_in;
@@ -283,9 +302,19 @@ class Logic : public LogicBase
     Async::Pty                      *state_pty;
     Async::Pty                      *dtmf_ctrl_pty;
     std::map<uint16_t, uint32_t>    m_ctcss_to_tg;
+    bool                            native_events_enabled;
+    NativeEventMap                  native_events;
+    std::string                     native_sql_rx_id;
+    bool                            native_event_handled;
+    std::string                     native_event_result;
 
     void loadModules(void);
-    void loadModule(const std::string& module_name);
+    Module *loadModule(const std::string& module_name,
+                       bool add_activate_cmd=true);
+    void registerLazyModule(const std::string& module_cfg_name);
+    Module *loadLazyModule(LazyModuleList::iterator it);
+    bool addModuleActivateCmd(int id, const std::string& module_cfg_name);
+    void updateLoadedModulesVar(void);
     void unloadModules(void);
     void processCommandQueue(void);
     void processCommand(const std::string &cmd, bool force_core_cmd=false);
@@ -305,6 +334,17 @@ class Logic : public LogicBase
     void onPublishStateEvent(const std::string &event_name,
                              const std::string &msg);
     void detectedTone(float fq);
+    void compositionEnd(void);
+    void addDefaultEventProcs(void);
+    void setupNativeEvents(void);
+    bool processNativeEvent(const std::string& event);
+    std::string eventResult(void);
+    bool nativeSquelchOpen(std::istream& args);
+    bool nativeTransmit(std::istream& args);
+    bool nativeDtmfDigitReceived(std::istream& args);
+    bool nativeEveryMinute(std::istream& args);
+    bool nativeEverySecond(std::istream& args);
+    bool nativeSendRgrSound(std::istream& args);
 
 };  /* class Logic */
 
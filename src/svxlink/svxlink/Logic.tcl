@@ -148,9 +148,11 @@ proc send_short_ident {{hour -1} {minute -1}} {
   # Play voice id if enabled
   if {$short_voice_id_enable} {
     puts "Playing short voice ID"
-    spellWord $mycall;
-    if {$CFG_TYPE == "Repeater"} {
-      playMsg "Core" "repeater";
+    playComposed voice_id {
+      spellWord $mycall;
+      if {$CFG_TYPE == "Repeater"} {
+        playMsg "Core" "repeater";
+      }
     }
     playSilence 500;
   }
@@ -167,11 +169,13 @@ proc send_short_ident {{hour -1} {minute -1}} {
   # Play CW id if enabled
   if {$short_cw_id_enable} {
     puts "Playing short CW ID"
-    if {$CFG_TYPE == "Repeater"} {
-      set call "$mycall/R"
-      CW::play $call
-    } else {
-      CW::play $mycall
+    playComposed cw_id {
+      if {$CFG_TYPE == "Repeater"} {
+        set call "$mycall/R"
+        CW::play $call
+      } else {
+        CW::play $mycall
+      }
     }
     playSilence 500;
   }
@@ -196,9 +200,11 @@ proc send_long_ident {hour minute} {
   # Play the voice ID if enabled
   if {$long_voice_id_enable} {
     puts "Playing Long voice ID"
-    spellWord $mycall;
-    if {$CFG_TYPE == "Repeater"} {
-      playMsg "Core" "repeater";
+    playComposed voice_id {
+      spellWord $mycall;
+      if {$CFG_TYPE == "Repeater"} {
+        playMsg "Core" "repeater";
+      }
     }
     playSilence 500;
     playMsg "Core" "the_time_is";
@@ -232,11 +238,13 @@ proc send_long_ident {hour minute} {
   # Play CW id if enabled
   if {$long_cw_id_enable} {
     puts "Playing long CW ID"
-    if {$CFG_TYPE == "Repeater"} {
-      set call "$mycall/R"
-      CW::play $call
-    } else {
-      CW::play $mycall
+    playComposed cw_id {
+      if {$CFG_TYPE == "Repeater"} {
+        set call "$mycall/R"
+        CW::play $call
+      } else {
+        CW::play $mycall
+      }
     }
     playSilence 100
   }
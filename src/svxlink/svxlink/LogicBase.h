@@ -158,6 +158,18 @@ class LogicBase : public sigc::trackable
       return true;
     }
 
+    /**
+     * @brief 	Wait for initialization running in the background to finish
+     * @return	Returns \em true on success or \em false on failure
+     *
+     * Some initialization, like loading the TCL event handler script, may be
+     * allowed to continue after the initialize function has returned so that
+     * multiple logics can be started in parallel. This function is called for
+     * each logic after all logics have been initialized. The logic object
+     * should be deleted if this function return \em false.
+     */
+    virtual bool finishInitialize(void) { return true; }
+
     const std::string& name(void) const { return m_name; }
 
     /**
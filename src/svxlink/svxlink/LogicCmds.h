@@ -141,8 +141,14 @@ class ModuleActivateCmd : public Command
       //std::cout << "cmd=" << cmdStr() << " subcmd=" << subcmd << std::endl;
       int module_id = atoi(cmdStr().c_str());
       Module *module = logic->findModule(module_id);
-      assert(module != 0);
-      if (!subcmd.empty())
+      if (module == 0)
+      {
+          // A module registered for lazy loading failed to load
+        std::stringstream ss;
+        ss << "command_failed " << cmdStr() << subcmd;
+        logic->processEvent(ss.str());
+      }
+      else if (!subcmd.empty())
       {
 	module->dtmfCmdReceivedWhenIdle(subcmd);
       }
@@ -405,6 +411,67 @@ class OnlineCmd : public Command
 };
 
 
+/**
+@brief	A macro definition
+@author Tobias Blomberg
+@date   2026-10-14
+
+This class holds one macro from the section pointed out by the MACROS
+configuration variable. The command string is the macro number. The macro is
+split into its module name and module command parts when the configuration is
+read so that the split does not have to be done each time the macro is
+executed. The macro is not executed by the parser itself but is looked up
+by the logic core using CmdParser::findCmd.
+*/
+class MacroCmd : public Command
+{
+  public:
+    MacroCmd(CmdParser *parser, const std::string& cmd,
+             const std::string& macro)
+      : Command(parser, cmd), macro(macro), is_valid(false)
+    {
+      std::string::size_type colon = macro.find(':');
+      if (colon != std::string::npos)
+      {
+        module_name = macro.substr(0, colon);
+        module_cmd = macro.substr(colon + 1);
+        is_valid = true;
+      }
+    }
+
+    /**
+     * @brief   Get the macro definition
+     * @return  Returns the macro string as given in the configuration
+     */
+    const std::string& macroStr(void) const { return macro; }
+
+    /**
+     * @brief   Check if the macro was correctly formatted
+     * @return  Returns \em true if a colon was found in the macro
+     */
+    bool isValid(void) const { return is_valid; }
+
+    /**
+     * @brief   The name of the module to activate
+     * @return  Returns the module name, which may be empty
+     */
+    const std::string& moduleName(void) const { return module_name; }
+
+    /**
+     * @brief   The command to send to the module
+     * @return  Returns the module command
+     */
+    const std::string& moduleCmd(void) const { return module_cmd; }
+
+  private:
+    std::string macro;
+    std::string module_name;
+    std::string module_cmd;
+    bool        is_valid;
+
+};
+
+
 //} /* namespace */
 
 #endif /* LOGIC_CMDS_INCLUDED */
@@ -36,8 +36,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <math.h>
@@ -52,6 +54,8 @@ extern "C" {
 #include <cstring>
 #include <fstream>
 #include <cerrno>
+#include <vector>
+#include <sstream>
 
 
 
@@ -61,6 +65,12 @@ extern "C" {
  *
  ****************************************************************************/
 
+#include <AsyncApplication.h>
+#include <AsyncAudioOscillator.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncBlockPool.h>
+#include <AsyncFileReader.h>
+
 
 
 /****************************************************************************
@@ -70,6 +80,7 @@ extern "C" {
  ****************************************************************************/
 
 #include "MsgHandler.h"
+#include "SoundPack.h"
 
 
 
@@ -80,6 +91,7 @@ extern "C" {
  ****************************************************************************/
 
 using namespace std;
+using namespace Async;
 
 
 
@@ -92,6 +104,9 @@ using namespace std;
 //#define WRITE_BLOCK_SIZE    4*160
 #define WRITE_BLOCK_SIZE    256
 
+  // The length, in milliseconds, of the ramp at the start and end of a tone
+#define TONE_RAMP_LEN       5
+
 
 
 /****************************************************************************
@@ -100,16 +115,24 @@ using namespace std;
  *
  ****************************************************************************/
 
-class QueueItem
+  // Queue items are created and deleted for every announcement so they are
+  // allocated from the block pool
+class QueueItem : public Async::BlockPoolAllocated
 {
   public:
     QueueItem(bool idle_marked) : idle_marked(idle_marked) {}
     virtual ~QueueItem(void) {}
     virtual bool initialize(void) { return true; }
+
+      // Return the number of samples read, 0 at the end of the item or -1
+      // if no samples are available right now. In the last case the
+      // samplesAvailable signal is emitted when reading may be retried.
     virtual int readSamples(float *samples, int len) = 0;
     virtual void unreadSamples(int len) = 0;
     
     bool idleMarked(void) const { return idle_marked; }
+
+    sigc::signal<void> samplesAvailable;
   
   private:
     bool  idle_marked;
@@ -134,17 +157,20 @@ class ToneQueueItem : public QueueItem
 {
   public:
     ToneQueueItem(int fq, int amp, int len, int sample_rate, bool idle_marked)
-      : QueueItem(idle_marked), fq(fq), amp(amp),
-      	tone_len(sample_rate * len / 1000), pos(0), sample_rate(sample_rate) {}
+      : QueueItem(idle_marked), tone_len(sample_rate * len / 1000), pos(0),
+        ramp_len(min(TONE_RAMP_LEN * sample_rate / 1000, tone_len / 2))
+    {
+      osc.setFq(fq, sample_rate);
+      osc.setAmplitude(amp / 1000.0);
+    }
     int readSamples(float *samples, int len);
     void unreadSamples(int len);
 
   private:
-    int fq;
-    int amp;
-    int tone_len;
-    int pos;
-    int sample_rate;
+    int             tone_len;
+    int             pos;
+    int             ramp_len;
+    AudioOscillator osc;
     
 };
 
@@ -153,42 +179,78 @@ class DtmfQueueItem : public QueueItem
   public:
     DtmfQueueItem(int fqh, int fql, int amp, int len, int sample_rate,
                   bool idle_marked)
-      : QueueItem(idle_marked), fqh(fqh), fql(fql), amp(amp),
-        tone_len(sample_rate * len / 1000), pos(0), sample_rate(sample_rate) {}
+      : QueueItem(idle_marked), tone_len(sample_rate * len / 1000), pos(0)
+    {
+      osc_h.setFq(fqh, sample_rate);
+      osc_h.setAmplitude(amp / 1000.0);
+      osc_l.setFq(fql, sample_rate);
+      osc_l.setAmplitude(amp / 1000.0);
+    }
     int readSamples(float *samples, int len);
     void unreadSamples(int len);
 
   private:
-    int fqh;
-    int fql;
-    int amp;
-    int tone_len;
-    int pos;
-    int sample_rate;
+    int             tone_len;
+    int             pos;
+    AudioOscillator osc_h;
+    AudioOscillator osc_l;
 
 };
 
-class RawFileQueueItem : public QueueItem
+/**
+ * Base class for queue items reading from a file. When read ahead is enabled
+ * the file is read by an Async::FileReader so that a slow disk does not block
+ * the main loop.
+ */
+class FileQueueItem : public QueueItem
 {
   public:
-    RawFileQueueItem(const std::string& filename, bool idle_marked)
-      : QueueItem(idle_marked), filename(filename), file(-1) {}
-    ~RawFileQueueItem(void);
+    FileQueueItem(const std::string& filename, bool idle_marked,
+                  bool read_ahead)
+      : QueueItem(idle_marked), filename(filename), read_ahead(read_ahead),
+        file(-1), reader(0) {}
+    ~FileQueueItem(void);
     bool initialize(void);
+
+  protected:
+    string  filename;
+
+    int readFile(void *buf, int len);
+
+  private:
+    static const int READ_AHEAD_SIZE = 16384;
+
+    bool        read_ahead;
+    int         file;
+    FileReader  *reader;
+
+};
+
+class RawFileQueueItem : public FileQueueItem
+{
+  public:
+    RawFileQueueItem(const std::string& filename, bool idle_marked,
+                     bool read_ahead)
+      : FileQueueItem(filename, idle_marked, read_ahead), buf_len(0),
+        buf_pos(0) {}
     int readSamples(float *samples, int len);
     void unreadSamples(int len);
 
   private:
-    string  filename;
-    int     file;
+    static const int BUFSIZE = 256;
+
+    int   buf_len;
+    int   buf_pos;
+    short buf[BUFSIZE];
     
 };
 
-class GsmFileQueueItem : public QueueItem
+class GsmFileQueueItem : public FileQueueItem
 {
   public:
-    GsmFileQueueItem(const std::string& filename, bool idle_marked)
-      : QueueItem(idle_marked), filename(filename), file(-1), decoder(0),
+    GsmFileQueueItem(const std::string& filename, bool idle_marked,
+                     bool read_ahead)
+      : FileQueueItem(filename, idle_marked, read_ahead), decoder(0),
         buf_pos(0) {}
     ~GsmFileQueueItem(void);
     bool initialize(void);
@@ -198,8 +260,6 @@ class GsmFileQueueItem : public QueueItem
   private:
     static const int BUFSIZE = 160;
     
-    string    	filename;
-    int       	file;
     gsm       	decoder;
     int       	buf_pos;
     gsm_signal  buf[BUFSIZE];
@@ -242,6 +302,57 @@ class WavFileQueueItem : public QueueItem
     int read16bitValue(uint8_t *ptr, uint16_t *val);
 };
 
+/**
+ * A decoded sound clip held in memory. The clip is reference counted since
+ * it may be thrown out of the cache while a queue item is still playing it.
+ */
+class SoundClip
+{
+  public:
+    SoundClip(void) : samples(0), count(0), map_addr(0), map_len(0),
+                      refcnt(1) {}
+    ~SoundClip(void)
+    {
+      if (map_addr != 0)
+      {
+        munmap(map_addr, map_len);
+      }
+    }
+    void ref(void) { ++refcnt; }
+    void unref(void) { if (--refcnt == 0) delete this; }
+    size_t size(void) const { return count * sizeof(*samples); }
+
+    const short         *samples;
+    size_t              count;
+    std::vector<short>  data;
+    void                *map_addr;
+    size_t              map_len;
+
+  private:
+    int refcnt;
+
+    SoundClip(const SoundClip&);
+    SoundClip& operator=(const SoundClip&);
+};
+
+class ClipQueueItem : public QueueItem
+{
+  public:
+    ClipQueueItem(SoundClip *clip, bool idle_marked)
+      : QueueItem(idle_marked), clip(clip), pos(0)
+    {
+      clip->ref();
+    }
+    ~ClipQueueItem(void) { clip->unref(); }
+    int readSamples(float *samples, int len);
+    void unreadSamples(int len);
+
+  private:
+    SoundClip *clip;
+    size_t    pos;
+
+};
+
 
 
 /****************************************************************************
@@ -250,6 +361,10 @@ class WavFileQueueItem : public QueueItem
  *
  ****************************************************************************/
 
+static size_t decodedClipSize(const string& path, off_t file_size);
+static bool dtmfTones(char digit, int *fql, int *fqh);
+static short floatToSample(float sample);
+
 
 
 /****************************************************************************
@@ -277,7 +392,10 @@ class WavFileQueueItem : public QueueItem
 
 MsgHandler::MsgHandler(int sample_rate)
   : sample_rate(sample_rate), nesting_level(0), pending_play_next(false),
-    current(0), is_writing_message(false), non_idle_cnt(0)
+    current(0), is_writing_message(false), non_idle_cnt(0),
+    clip_cache_size(0), clip_cache_limit(0), clip_cache_mmap(false),
+    comp_cache_size(0), comp_cache_limit(0), comp_nesting_level(0),
+    comp_non_idle_cnt(0)
 {
   
 }
@@ -286,76 +404,181 @@ MsgHandler::MsgHandler(int sample_rate)
 MsgHandler::~MsgHandler(void)
 {
   clearP();
+  setCompositionCacheSize(0);
+  setClipCacheSize(0);
 } /* MsgHandler::~MsgHandler */
 
 
 void MsgHandler::playFile(const string& path, bool idle_marked)
 {
-  QueueItem *item = 0;
-  const char *ext = strrchr(path.c_str(), '.');
-  if (strcmp(ext, ".gsm") == 0)
-  {
-    item = new GsmFileQueueItem(path, idle_marked);
-  }
-  else if (strcmp(ext, ".wav") == 0)
-  {
-    item = new WavFileQueueItem(path, idle_marked);
-  }
-  else
-  {
-    item = new RawFileQueueItem(path, idle_marked);
-  }
-  addItemToQueue(item);
+  CompositionPart part = { CompositionPart::FILE, path, 0, 0, 0, idle_marked };
+  playPart(part);
 } /* MsgHandler::playFile */
 
 
 void MsgHandler::playSilence(int length, bool idle_marked)
 {
-  QueueItem *item = new SilenceQueueItem(length, sample_rate, idle_marked);
-  addItemToQueue(item);
+  CompositionPart part = {
+    CompositionPart::SILENCE, "", length, 0, 0, idle_marked
+  };
+  playPart(part);
 } /* MsgHandler::playSilence */
 
 
 void MsgHandler::playTone(int fq, int amp, int length, bool idle_marked)
 {
-  QueueItem *item = new ToneQueueItem(fq, amp, length, sample_rate,
-      	      	      	      	      idle_marked);
-  addItemToQueue(item);
+  CompositionPart part = {
+    CompositionPart::TONE, "", fq, amp, length, idle_marked
+  };
+  playPart(part);
 } /* MsgHandler::playTone */
 
 
 void MsgHandler::playDtmf(char digit, int amp, int length, bool idle_marked)
 {
-  static map<char, pair<int, int> > tone_map;
-  tone_map['1'] = pair<int, int>(697, 1209);
-  tone_map['2'] = pair<int, int>(697, 1336);
-  tone_map['3'] = pair<int, int>(697, 1477);
-  tone_map['A'] = pair<int, int>(697, 1633);
-  tone_map['4'] = pair<int, int>(770, 1209);
-  tone_map['5'] = pair<int, int>(770, 1336);
-  tone_map['6'] = pair<int, int>(770, 1477);
-  tone_map['B'] = pair<int, int>(770, 1633);
-  tone_map['7'] = pair<int, int>(852, 1209);
-  tone_map['8'] = pair<int, int>(852, 1336);
-  tone_map['9'] = pair<int, int>(852, 1477);
-  tone_map['C'] = pair<int, int>(852, 1633);
-  tone_map['*'] = pair<int, int>(941, 1209);
-  tone_map['0'] = pair<int, int>(941, 1336);
-  tone_map['#'] = pair<int, int>(941, 1477);
-  tone_map['D'] = pair<int, int>(941, 1633);
-
-  int fql = tone_map[digit].first;
-  int fqh = tone_map[digit].second;
-
-  if (fql > 0)
-  {
-    QueueItem *item = new DtmfQueueItem(fqh, fql, amp, length, sample_rate,
-                                        idle_marked);
-    addItemToQueue(item);
+  int fql = 0;
+  int fqh = 0;
+  if (dtmfTones(digit, &fql, &fqh))
+  {
+    CompositionPart part = {
+      CompositionPart::DTMF, string(1, digit), amp, length, 0, idle_marked
+    };
+    playPart(part);
   }
 } /* MsgHandler::playDtmf */
 
 
+void MsgHandler::setClipCacheSize(size_t size)
+{
+  clip_cache_limit = size;
+  while (clip_cache_size > clip_cache_limit)
+  {
+    evictClip();
+  }
+} /* MsgHandler::setClipCacheSize */
+
+
+unsigned MsgHandler::prefetchClips(const string& dir)
+{
+  if (clip_cache_limit == 0)
+  {
+    return 0;
+  }
+  return prefetchDir(dir);
+} /* MsgHandler::prefetchClips */
+
+
+void MsgHandler::setCompositionCacheSize(size_t size)
+{
+  comp_cache_limit = size;
+  while (comp_cache_size > comp_cache_limit)
+  {
+    eraseComposition(comp_cache.find(comp_lru.back()));
+  }
+} /* MsgHandler::setCompositionCacheSize */
+
+
+void MsgHandler::beginComposition(const string& key)
+{
+  if (comp_nesting_level++ == 0)
+  {
+    comp_key = key;
+  }
+} /* MsgHandler::beginComposition */
+
+
+void MsgHandler::endComposition(void)
+{
+  assert(comp_nesting_level > 0);
+  if (--comp_nesting_level > 0)
+  {
+    return;
+  }
+
+  CompositionPartList parts;
+  parts.swap(comp_parts);
+  string key;
+  key.swap(comp_key);
+  non_idle_cnt -= comp_non_idle_cnt;
+  comp_non_idle_cnt = 0;
+  assert(non_idle_cnt >= 0);
+  if (parts.empty())
+  {
+    return;
+  }
+
+    // The sequence of play calls is the signature of the composition. It
+    // will differ if any variable used to build it has changed.
+  ostringstream ss;
+  bool idle_marked = true;
+  vector<FileStamp> files;
+  bool cacheable = true;
+  for (CompositionPartList::const_iterator it=parts.begin();
+       it!=parts.end(); ++it)
+  {
+    ss << (*it).type << ' ' << (*it).path << ' ' << (*it).arg1 << ' '
+       << (*it).arg2 << ' ' << (*it).arg3 << ' ' << (*it).idle_marked << '\n';
+    idle_marked = idle_marked && (*it).idle_marked;
+    if ((*it).type == CompositionPart::FILE)
+    {
+        // A clip in a sound pack cannot change while the pack is loaded
+      const short *samples;
+      size_t count;
+      if (SoundPack::instance().find((*it).path, samples, count))
+      {
+        continue;
+      }
+      struct stat st;
+      if (stat((*it).path.c_str(), &st) == -1)
+      {
+        cacheable = false;
+        continue;
+      }
+      FileStamp stamp = { (*it).path, st.st_mtime, st.st_size };
+      files.push_back(stamp);
+    }
+  }
+  string signature = ss.str();
+
+  CompositionCache::iterator it = comp_cache.find(key);
+  if (it != comp_cache.end())
+  {
+    CachedComposition &cached = (*it).second;
+    if ((cached.signature == signature) && compositionFilesUnchanged(cached))
+    {
+      comp_lru.splice(comp_lru.begin(), comp_lru, cached.lru_pos);
+      addItemToQueue(new ClipQueueItem(cached.clip, cached.idle_marked));
+      return;
+    }
+    eraseComposition(it);
+  }
+
+  SoundClip *clip = renderComposition(parts);
+  if (clip->count > 0)
+  {
+    addItemToQueue(new ClipQueueItem(clip, idle_marked));
+  }
+
+  if (!cacheable || (clip->size() > comp_cache_limit))
+  {
+    clip->unref();
+    return;
+  }
+  while (comp_cache_size + clip->size() > comp_cache_limit)
+  {
+    eraseComposition(comp_cache.find(comp_lru.back()));
+  }
+  comp_lru.push_front(key);
+  CachedComposition &cached = comp_cache[key];
+  cached.signature = signature;
+  cached.files.swap(files);
+  cached.clip = clip;
+  cached.idle_marked = idle_marked;
+  cached.lru_pos = comp_lru.begin();
+  comp_cache_size += clip->size();
+} /* MsgHandler::endComposition */
+
+
 void MsgHandler::clear(void)
 {
   clearP();
@@ -405,6 +628,30 @@ void MsgHandler::resumeOutput(void)
 } /* MsgHandler::resumeOutput */
 
 
+bool MsgHandler::decodeClip(const string& path, vector<short>& samples)
+{
+    // Decode the file using the ordinary file queue items. The whole file
+    // is read at once so read ahead would not help.
+  QueueItem *item = createFileQueueItem(path, true, false);
+  if (!item->initialize())
+  {
+    delete item;
+    return false;
+  }
+  float buf[WRITE_BLOCK_SIZE];
+  int cnt;
+  while ((cnt = item->readSamples(buf, sizeof(buf) / sizeof(*buf))) > 0)
+  {
+    for (int i=0; i<cnt; ++i)
+    {
+      samples.push_back(static_cast<short>(lrintf(buf[i] * 32768.0f)));
+    }
+  }
+  delete item;
+  return true;
+} /* MsgHandler::decodeClip */
+
+
 
 /****************************************************************************
  *
@@ -465,6 +712,8 @@ void MsgHandler::playMsg(void)
     
   current = msg_queue.front();
   msg_queue.pop_front();
+  current->samplesAvailable.connect(
+      mem_fun(*this, &MsgHandler::onSamplesAvailable));
   if (!current->initialize())
   {
     deleteQueueItem(current);
@@ -493,6 +742,11 @@ void MsgHandler::writeSamples(void)
     {
       goto done;
     }
+    if (read_cnt < 0)
+    {
+        // Wait for the samplesAvailable signal
+      return;
+    }
     
     written = sinkWriteSamples(buf, read_cnt);
     if (written == -1)
@@ -547,9 +801,361 @@ void MsgHandler::clearP(void)
   non_idle_cnt = 0;
 
   msg_queue.clear();
+
+    // An ongoing composition is kept open but what it contain is thrown away
+  comp_parts.clear();
+  comp_non_idle_cnt = 0;
 } /* MsgHandler::clearP */
 
 
+QueueItem *MsgHandler::createFileQueueItem(const string& path,
+                                           bool idle_marked, bool read_ahead)
+{
+  const char *ext = strrchr(path.c_str(), '.');
+  if ((ext != 0) && (strcmp(ext, ".gsm") == 0))
+  {
+    return new GsmFileQueueItem(path, idle_marked, read_ahead);
+  }
+  else if ((ext != 0) && (strcmp(ext, ".wav") == 0))
+  {
+    return new WavFileQueueItem(path, idle_marked);
+  }
+  return new RawFileQueueItem(path, idle_marked, read_ahead);
+} /* MsgHandler::createFileQueueItem */
+
+
+void MsgHandler::onSamplesAvailable(void)
+{
+    // Deferred since the queue item, that is emitting the signal, may be
+    // deleted when writing samples
+  Application::app().runTask(mem_fun(*this, &MsgHandler::resumeOutput));
+} /* MsgHandler::onSamplesAvailable */
+
+
+SoundClip *MsgHandler::cachedClip(const string& path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) == -1)
+  {
+    return 0;
+  }
+
+  ClipCache::iterator it = clip_cache.find(path);
+  if (it != clip_cache.end())
+  {
+    CachedClip &cached = (*it).second;
+    if ((cached.mtime == st.st_mtime) && (cached.file_size == st.st_size))
+    {
+      clip_lru.splice(clip_lru.begin(), clip_lru, cached.lru_pos);
+      return cached.clip;
+    }
+
+      // The file have changed on disk so throw away the old clip
+    cached.clip->unref();
+    clip_cache_size -= cached.clip->size();
+    clip_lru.erase(cached.lru_pos);
+    clip_cache.erase(it);
+  }
+
+    // Clips that would not fit in the cache are played directly from file
+  if (decodedClipSize(path, st.st_size) > clip_cache_limit)
+  {
+    return 0;
+  }
+
+  SoundClip *clip = loadClip(path, st.st_size);
+  if (clip == 0)
+  {
+    return 0;
+  }
+
+  while ((clip_cache_size + clip->size() > clip_cache_limit) &&
+         !clip_lru.empty())
+  {
+    evictClip();
+  }
+
+  clip_lru.push_front(path);
+  CachedClip &cached = clip_cache[path];
+  cached.clip = clip;
+  cached.mtime = st.st_mtime;
+  cached.file_size = st.st_size;
+  cached.lru_pos = clip_lru.begin();
+  clip_cache_size += clip->size();
+
+  return clip;
+} /* MsgHandler::cachedClip */
+
+
+SoundClip *MsgHandler::loadClip(const string& path, off_t file_size)
+{
+  const char *ext = strrchr(path.c_str(), '.');
+  bool is_raw = (ext == 0) ||
+                ((strcmp(ext, ".gsm") != 0) && (strcmp(ext, ".wav") != 0));
+  if (is_raw && clip_cache_mmap && (file_size >= (off_t)sizeof(short)))
+  {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd != -1)
+    {
+      void *addr = mmap(0, file_size, PROT_READ, MAP_SHARED, fd, 0);
+      ::close(fd);
+      if (addr != MAP_FAILED)
+      {
+        madvise(addr, file_size, MADV_WILLNEED);
+        SoundClip *clip = new SoundClip;
+        clip->map_addr = addr;
+        clip->map_len = file_size;
+        clip->samples = static_cast<const short *>(addr);
+        clip->count = file_size / sizeof(short);
+        return clip;
+      }
+      perror("mmap in MsgHandler::loadClip");
+    }
+  }
+
+  SoundClip *clip = new SoundClip;
+  if (!decodeClip(path, clip->data))
+  {
+    clip->unref();
+    return 0;
+  }
+  clip->samples = clip->data.empty() ? 0 : &clip->data[0];
+  clip->count = clip->data.size();
+
+  return clip;
+} /* MsgHandler::loadClip */
+
+
+void MsgHandler::evictClip(void)
+{
+  assert(!clip_lru.empty());
+  ClipCache::iterator it = clip_cache.find(clip_lru.back());
+  assert(it != clip_cache.end());
+  clip_cache_size -= (*it).second.clip->size();
+  (*it).second.clip->unref();
+  clip_cache.erase(it);
+  clip_lru.pop_back();
+} /* MsgHandler::evictClip */
+
+
+unsigned MsgHandler::prefetchDir(const string& dir)
+{
+  DIR *dp = opendir(dir.c_str());
+  if (dp == 0)
+  {
+    cerr << "*** WARNING: Could not open sound clip directory \""
+         << dir << "\": " << strerror(errno) << endl;
+    return 0;
+  }
+
+  unsigned cnt = 0;
+  struct dirent *ent;
+  while ((ent = readdir(dp)) != 0)
+  {
+    if (ent->d_name[0] == '.')
+    {
+      continue;
+    }
+    string path = dir + "/" + ent->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1)
+    {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+      cnt += prefetchDir(path);
+      continue;
+    }
+    const char *ext = strrchr(ent->d_name, '.');
+    if (!S_ISREG(st.st_mode) || (ext == 0) ||
+        ((strcmp(ext, ".wav") != 0) && (strcmp(ext, ".gsm") != 0) &&
+         (strcmp(ext, ".raw") != 0)))
+    {
+      continue;
+    }
+
+      // Skip clips that do not fit. Loading them would only throw out the
+      // clips that was just loaded.
+    if (clip_cache_size + decodedClipSize(path, st.st_size) >
+        clip_cache_limit)
+    {
+      continue;
+    }
+    if (cachedClip(path) != 0)
+    {
+      ++cnt;
+    }
+  }
+  closedir(dp);
+
+  return cnt;
+} /* MsgHandler::prefetchDir */
+
+
+void MsgHandler::playPart(const CompositionPart& part)
+{
+  if ((comp_nesting_level > 0) && (comp_cache_limit > 0))
+  {
+      // Count the part as queued so that isIdle report the correct state
+      // while the composition is recorded
+    comp_parts.push_back(part);
+    if (!part.idle_marked)
+    {
+      non_idle_cnt += 1;
+      comp_non_idle_cnt += 1;
+    }
+    return;
+  }
+
+  QueueItem *item = createPartQueueItem(part, true);
+  if (item != 0)
+  {
+    addItemToQueue(item);
+  }
+} /* MsgHandler::playPart */
+
+
+QueueItem *MsgHandler::createPartQueueItem(const CompositionPart& part,
+                                           bool read_ahead)
+{
+  switch (part.type)
+  {
+    case CompositionPart::FILE:
+    {
+      const short *samples;
+      size_t count;
+      if ((sample_rate == INTERNAL_SAMPLE_RATE) &&
+          SoundPack::instance().find(part.path, samples, count))
+      {
+          // The clip is played directly from the mapped sound pack
+        SoundClip *clip = new SoundClip;
+        clip->samples = samples;
+        clip->count = count;
+        QueueItem *item = new ClipQueueItem(clip, part.idle_marked);
+        clip->unref();
+        return item;
+      }
+      if (clip_cache_limit > 0)
+      {
+        SoundClip *clip = cachedClip(part.path);
+        if (clip != 0)
+        {
+          return new ClipQueueItem(clip, part.idle_marked);
+        }
+      }
+      return createFileQueueItem(part.path, part.idle_marked, read_ahead);
+    }
+
+    case CompositionPart::SILENCE:
+      return new SilenceQueueItem(part.arg1, sample_rate, part.idle_marked);
+
+    case CompositionPart::TONE:
+      return new ToneQueueItem(part.arg1, part.arg2, part.arg3, sample_rate,
+                               part.idle_marked);
+
+    case CompositionPart::DTMF:
+    {
+      int fql = 0;
+      int fqh = 0;
+      if (part.path.empty() || !dtmfTones(part.path[0], &fql, &fqh))
+      {
+        return 0;
+      }
+      return new DtmfQueueItem(fqh, fql, part.arg1, part.arg2, sample_rate,
+                               part.idle_marked);
+    }
+  }
+  return 0;
+} /* MsgHandler::createPartQueueItem */
+
+
+SoundClip *MsgHandler::renderComposition(const CompositionPartList& parts)
+{
+    // Parts that cannot be played, like missing files, are skipped just
+    // like they would have been during normal playback
+  SoundClip *clip = new SoundClip;
+  float buf[WRITE_BLOCK_SIZE];
+  for (CompositionPartList::const_iterator it=parts.begin();
+       it!=parts.end(); ++it)
+  {
+    QueueItem *item = createPartQueueItem(*it, false);
+    if (item == 0)
+    {
+      continue;
+    }
+    if (item->initialize())
+    {
+      int cnt;
+      while ((cnt = item->readSamples(buf, sizeof(buf) / sizeof(*buf))) > 0)
+      {
+        for (int i=0; i<cnt; ++i)
+        {
+          clip->data.push_back(floatToSample(buf[i]));
+        }
+      }
+    }
+    delete item;
+  }
+
+  clip->samples = clip->data.empty() ? 0 : &clip->data[0];
+  clip->count = clip->data.size();
+
+  return clip;
+} /* MsgHandler::renderComposition */
+
+
+bool MsgHandler::compositionFilesUnchanged(const CachedComposition& comp)
+{
+  for (vector<FileStamp>::const_iterator it=comp.files.begin();
+       it!=comp.files.end(); ++it)
+  {
+    struct stat st;
+    if ((stat((*it).path.c_str(), &st) == -1) ||
+        (st.st_mtime != (*it).mtime) || (st.st_size != (*it).file_size))
+    {
+      return false;
+    }
+  }
+  return true;
+} /* MsgHandler::compositionFilesUnchanged */
+
+
+void MsgHandler::eraseComposition(CompositionCache::iterator it)
+{
+  assert(it != comp_cache.end());
+  comp_cache_size -= (*it).second.clip->size();
+  (*it).second.clip->unref();
+  comp_lru.erase((*it).second.lru_pos);
+  comp_cache.erase(it);
+} /* MsgHandler::eraseComposition */
+
+
+
+/****************************************************************************
+ *
+ * Private member functions for class ClipQueueItem
+ *
+ ****************************************************************************/
+
+int ClipQueueItem::readSamples(float *samples, int len)
+{
+  int read_cnt = 0;
+  while ((read_cnt < len) && (pos < clip->count))
+  {
+    samples[read_cnt++] = static_cast<float>(clip->samples[pos++]) / 32768.0;
+  }
+  return read_cnt;
+} /* ClipQueueItem::readSamples */
+
+
+void ClipQueueItem::unreadSamples(int len)
+{
+  assert(len >= 0);
+  pos -= min(static_cast<size_t>(len), pos);
+} /* ClipQueueItem::unreadSamples */
+
+
 
 /****************************************************************************
  *
@@ -557,18 +1163,31 @@ void MsgHandler::clearP(void)
  *
  ****************************************************************************/
 
-RawFileQueueItem::~RawFileQueueItem(void)
+FileQueueItem::~FileQueueItem(void)
 {
+  delete reader;
   if (file != -1)
   {
     ::close(file);
   }
-} /* RawFileQueueItem::~FileQueueItem */
+} /* FileQueueItem::~FileQueueItem */
 
 
-bool RawFileQueueItem::initialize(void)
+bool FileQueueItem::initialize(void)
 {
-  assert(file == -1);
+  assert((file == -1) && (reader == 0));
+
+  if (read_ahead)
+  {
+    reader = new FileReader(READ_AHEAD_SIZE);
+    if (!reader->open(filename))
+    {
+      cerr << "*** WARNING: Could not find audio file \"" << filename << "\"\n";
+      return false;
+    }
+    reader->dataAvailable.connect(samplesAvailable.make_slot());
+    return true;
+  }
 
   file = ::open(filename.c_str(), O_RDONLY);
   if (file == -1)
@@ -579,26 +1198,62 @@ bool RawFileQueueItem::initialize(void)
     
   return true;
   
-} /* RawFileQueueItem::initialize */
+} /* FileQueueItem::initialize */
 
 
-int RawFileQueueItem::readSamples(float *samples, int len)
+int FileQueueItem::readFile(void *buf, int len)
 {
-  short buf[len];
+  if (reader != 0)
+  {
+    int cnt = reader->read(buf, len);
+    if (cnt < 0)
+    {
+      cerr << "*** WARNING: Failed to read audio file \"" << filename
+           << "\"\n";
+      return 0;
+    }
+    if ((cnt == 0) && !reader->isEof())
+    {
+      return -1;
+    }
+    return cnt;
+  }
+
   assert(file != -1);
-  int read_cnt = read(file, buf, len * sizeof(*buf));
-  if (read_cnt == -1)
+  int cnt = ::read(file, buf, len);
+  if (cnt == -1)
   {
-    perror("read in FileQueueItem::readSamples");
-    read_cnt = 0;
+    perror("read in FileQueueItem::readFile");
+    return 0;
   }
-  else
+  return cnt;
+} /* FileQueueItem::readFile */
+
+
+
+/****************************************************************************
+ *
+ * Private member functions for class RawFileQueueItem
+ *
+ ****************************************************************************/
+
+int RawFileQueueItem::readSamples(float *samples, int len)
+{
+  if (buf_pos == buf_len)
   {
-    read_cnt /= sizeof(*buf);
-    for (int i=0; i<read_cnt; ++i)
+    int cnt = readFile(buf, sizeof(buf));
+    if (cnt < 0)
     {
-      samples[i] = static_cast<float>(buf[i]) / 32768.0;
+      return -1;
     }
+    buf_len = cnt / sizeof(*buf);
+    buf_pos = 0;
+  }
+
+  int read_cnt = 0;
+  while ((read_cnt < len) && (buf_pos < buf_len))
+  {
+    samples[read_cnt++] = static_cast<float>(buf[buf_pos++]) / 32768.0;
   }
   
   return read_cnt;
@@ -608,10 +1263,13 @@ int RawFileQueueItem::readSamples(float *samples, int len)
 
 void RawFileQueueItem::unreadSamples(int len)
 {
-  if (lseek(file, -len * sizeof(short), SEEK_CUR) == -1)
+  if (len > buf_pos)
   {
-    perror("lseek in RawFileQueueItem::unreadSamples");
+    cerr << "*** WARNING: Trying to unread more raw samples then was "
+            "previously read." << endl;
+    return;
   }
+  buf_pos -= len;
 } /* RawFileQueueItem::unreadSamples */
 
 
@@ -628,24 +1286,15 @@ GsmFileQueueItem::~GsmFileQueueItem(void)
   {
     gsm_destroy(decoder);
   }
-  
-  if (file != -1)
-  {
-    ::close(file);
-  }
-} /* GsmFileQueueItem::~FileQueueItem */
+} /* GsmFileQueueItem::~GsmFileQueueItem */
 
 
 bool GsmFileQueueItem::initialize(void)
 {
   //cout << "GsmFileQueueItem::initialize\n";
   
-  assert(file == -1);
-
-  file = ::open(filename.c_str(), O_RDONLY);
-  if (file == -1)
+  if (!FileQueueItem::initialize())
   {
-    cerr << "*** WARNING: Could not find audio file \"" << filename << "\"\n";
     return false;
   }
   
@@ -665,14 +1314,11 @@ int GsmFileQueueItem::readSamples(float *samples, int len)
   //cout << "buf_pos=" << buf_pos << endl;
   if (buf_pos == BUFSIZE)
   {
-    assert(file != -1);
-
     gsm_frame gsm_data;
-    int cnt = read(file, gsm_data, sizeof(gsm_data));
+    int cnt = readFile(gsm_data, sizeof(gsm_data));
     if (cnt == -1)
     {
-      perror("read in GsmFileQueueItem::readSamples");
-      return 0;
+      return -1;
     }
     else if (cnt != sizeof(gsm_data))
     {
@@ -863,7 +1509,7 @@ bool WavFileQueueItem::initialize(void)
         }
 
         ptr += read32bitValue(ptr, &sample_rate);
-        if (sample_rate != INTERNAL_SAMPLE_RATE)
+        if (sample_rate != static_cast<uint32_t>(INTERNAL_SAMPLE_RATE))
         {
           cerr << "*** WARNING: SvxLink can only handle WAV files which have "
                   "a sample rate of "
@@ -1039,11 +1685,11 @@ void SilenceQueueItem::unreadSamples(int len)
 int ToneQueueItem::readSamples(float *samples, int len)
 {
   int read_cnt = min(len, tone_len-pos);
-  for (int i=0; i<read_cnt; ++i)
-  {
-    samples[i] = amp / 1000.0 * sin(2 * M_PI * fq * pos / sample_rate);
-    ++pos;
-  }
+  osc.generate(samples, read_cnt);
+  
+    // Ramp the tone up and down to avoid clicks, e.g. when sending CW
+  AudioOscillator::applyEnvelope(samples, read_cnt, pos, tone_len, ramp_len);
+  pos += read_cnt;
   
   return read_cnt;
   
@@ -1053,6 +1699,7 @@ int ToneQueueItem::readSamples(float *samples, int len)
 void ToneQueueItem::unreadSamples(int len)
 {
   pos -= len;
+  osc.advance(-len);
 } /* ToneQueueItem::unreadSamples */
 
 
@@ -1066,13 +1713,9 @@ void ToneQueueItem::unreadSamples(int len)
 int DtmfQueueItem::readSamples(float *samples, int len)
 {
   int read_cnt = min(len, tone_len-pos);
-  for (int i=0; i<read_cnt; ++i)
-  {
-    samples[i] = amp / 1000.0 * (
-                sin(2 * M_PI * fqh * pos / sample_rate) +
-                sin(2 * M_PI * fql * pos / sample_rate));
-    ++pos;
-  }
+  osc_h.generate(samples, read_cnt);
+  osc_l.addTo(samples, read_cnt);
+  pos += read_cnt;
 
   return read_cnt;
 } /* DtmfQueueItem::readSamples */
@@ -1081,10 +1724,57 @@ int DtmfQueueItem::readSamples(float *samples, int len)
 void DtmfQueueItem::unreadSamples(int len)
 {
   pos -= len;
+  osc_h.advance(-len);
+  osc_l.advance(-len);
 } /* DtmfQueueItem::unreadSamples */
 
 
 
+static size_t decodedClipSize(const string& path, off_t file_size)
+{
+    // A 33 byte GSM frame decode to 160 samples
+  const char *ext = strrchr(path.c_str(), '.');
+  if ((ext != 0) && (strcmp(ext, ".gsm") == 0))
+  {
+    return file_size / sizeof(gsm_frame) * 160 * sizeof(short);
+  }
+  return file_size;
+} /* decodedClipSize */
+
+
+static bool dtmfTones(char digit, int *fql, int *fqh)
+{
+  static const char digits[] = "123A456B789C*0#D";
+  static const int low[] = { 697, 770, 852, 941 };
+  static const int high[] = { 1209, 1336, 1477, 1633 };
+
+  const char *pos = (digit != 0) ? strchr(digits, digit) : 0;
+  if (pos == 0)
+  {
+    return false;
+  }
+  int idx = pos - digits;
+  *fql = low[idx / 4];
+  *fqh = high[idx % 4];
+  return true;
+} /* dtmfTones */
+
+
+static short floatToSample(float sample)
+{
+  if (sample >= 32767.0f / 32768.0f)
+  {
+    return 32767;
+  }
+  if (sample <= -1.0f)
+  {
+    return -32768;
+  }
+  return static_cast<short>(lrintf(sample * 32768.0f));
+} /* floatToSample */
+
+
+
 /*
  * This file has not been truncated
  */
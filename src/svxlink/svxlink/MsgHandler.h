@@ -38,9 +38,13 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <sys/types.h>
+
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
+#include <ctime>
 
 #include <sigc++/sigc++.h>
 
@@ -70,6 +74,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 class QueueItem;
+class SoundClip;
 
 
 
@@ -179,6 +184,64 @@ class MsgHandler : public sigc::trackable, public Async::AudioSource
      *
      */
     void playDtmf(char digit, int amp, int length, bool idle_marked=false);
+
+    /**
+     * @brief 	Set the maximum size of the sound clip cache
+     * @param 	size The maximum size in bytes of the cache (0=disabled)
+     *
+     * When the cache is enabled, played files are decoded into memory and
+     * kept there so that playing them again do not cause any file I/O. The
+     * least recently used clips are thrown out when the cache get full.
+     */
+    void setClipCacheSize(size_t size);
+
+    /**
+     * @brief 	Choose if raw sound clips should be memory mapped
+     * @param 	use_mmap Set to \em true to memory map raw files
+     *
+     * Raw files need no decoding so instead of reading them into the cache
+     * they can be memory mapped.
+     */
+    void setClipCacheMmap(bool use_mmap) { clip_cache_mmap = use_mmap; }
+
+    /**
+     * @brief 	Load all sound clips in a directory tree into the cache
+     * @param 	dir The directory to search for sound clips
+     * @return	Returns the number of clips that was loaded into the cache
+     *
+     * Loading stops when the cache is full. The cache must have been enabled
+     * using setClipCacheSize before calling this function.
+     */
+    unsigned prefetchClips(const std::string& dir);
+
+    /**
+     * @brief 	Set the maximum size of the composition cache
+     * @param 	size The maximum size in bytes of the cache (0=disabled)
+     *
+     * See beginComposition for a description of compositions.
+     */
+    void setCompositionCacheSize(size_t size);
+
+    /**
+     * @brief 	Mark the beginning of a composition
+     * @param 	key A name for the composition, e.g. "voice_id"
+     *
+     * All the playXxx calls up to the matching endComposition call are
+     * rendered into one sound clip that is played as a single queue item.
+     * The clip is cached under the given key and is played directly the
+     * next time the same sequence of playXxx calls is made, if no sound
+     * file used in it has changed on disk. When the sequence differ, for
+     * example because the callsign have been changed, the clip is rendered
+     * again. Compositions can be nested but only the outermost one is
+     * rendered. If the composition cache is disabled, the playXxx calls are
+     * queued as usual.
+     */
+    void beginComposition(const std::string& key);
+
+    /**
+     * @brief 	Mark the end of a composition
+     */
+    void endComposition(void);
     
     /**
      * @brief 	Check if a message is beeing written
@@ -226,6 +289,15 @@ class MsgHandler : public sigc::trackable, public Async::AudioSource
      * This function is normally only called from a connected sink object.
      */
     virtual void resumeOutput(void);
+
+    /**
+     * @brief   Decode a sound clip file
+     * @param   path    The path to the .wav, .gsm or raw file to decode
+     * @param   samples The decoded samples are appended to this vector
+     * @return  Returns \em true on success or \em false on failure
+     */
+    static bool decodeClip(const std::string& path,
+                           std::vector<short>& samples);
     
   protected:
     /**
@@ -238,6 +310,43 @@ class MsgHandler : public sigc::trackable, public Async::AudioSource
     virtual void allSamplesFlushed(void);
     
   private:
+    typedef std::list<std::string> ClipLru;
+    struct CachedClip
+    {
+      SoundClip         *clip;
+      time_t            mtime;
+      off_t             file_size;
+      ClipLru::iterator lru_pos;
+    };
+    typedef std::map<std::string, CachedClip> ClipCache;
+    struct CompositionPart
+    {
+      typedef enum { FILE, SILENCE, TONE, DTMF } Type;
+      Type        type;
+      std::string path;
+      int         arg1;
+      int         arg2;
+      int         arg3;
+      bool        idle_marked;
+    };
+    typedef std::vector<CompositionPart> CompositionPartList;
+    struct FileStamp
+    {
+      std::string path;
+      time_t      mtime;
+      off_t       file_size;
+    };
+    typedef std::list<std::string> CompositionLru;
+    struct CachedComposition
+    {
+      std::string               signature;
+      std::vector<FileStamp>    files;
+      SoundClip                 *clip;
+      bool                      idle_marked;
+      CompositionLru::iterator  lru_pos;
+    };
+    typedef std::map<std::string, CachedComposition> CompositionCache;
+
     std::list<QueueItem*>   msg_queue;
     int			    sample_rate;
     int      	      	    nesting_level;
@@ -245,6 +354,19 @@ class MsgHandler : public sigc::trackable, public Async::AudioSource
     QueueItem 	      	    *current;
     bool      	      	    is_writing_message;
     int       	      	    non_idle_cnt;
+    ClipCache               clip_cache;
+    ClipLru                 clip_lru;
+    size_t                  clip_cache_size;
+    size_t                  clip_cache_limit;
+    bool                    clip_cache_mmap;
+    CompositionCache        comp_cache;
+    CompositionLru          comp_lru;
+    size_t                  comp_cache_size;
+    size_t                  comp_cache_limit;
+    int                     comp_nesting_level;
+    std::string             comp_key;
+    CompositionPartList     comp_parts;
+    int                     comp_non_idle_cnt;
     
     MsgHandler(const MsgHandler&);
     MsgHandler& operator=(const MsgHandler&);
@@ -253,6 +375,19 @@ class MsgHandler : public sigc::trackable, public Async::AudioSource
     void writeSamples(void);
     void deleteQueueItem(QueueItem *item);
     void clearP(void);
+    static QueueItem *createFileQueueItem(const std::string& path,
+                                          bool idle_marked, bool read_ahead);
+    void onSamplesAvailable(void);
+    SoundClip *cachedClip(const std::string& path);
+    SoundClip *loadClip(const std::string& path, off_t file_size);
+    void evictClip(void);
+    unsigned prefetchDir(const std::string& dir);
+    void playPart(const CompositionPart& part);
+    QueueItem *createPartQueueItem(const CompositionPart& part,
+                                   bool read_ahead);
+    SoundClip *renderComposition(const CompositionPartList& parts);
+    bool compositionFilesUnchanged(const CachedComposition& comp);
+    void eraseComposition(CompositionCache::iterator it);
 
 }; /* class MsgHandler */
 
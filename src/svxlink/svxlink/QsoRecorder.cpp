@@ -55,6 +55,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncConfig.h>
 #include <AsyncTimer.h>
 #include <AsyncExec.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -97,9 +98,9 @@ using namespace Async;
 class QsoRecorder::FileEncoder : public Exec
 {
   public:
-    string basename;
-    FileEncoder(const char *shell, string basename)
-      : Exec(shell), basename(basename)
+    string filename;
+    FileEncoder(const char *shell, string filename)
+      : Exec(shell), filename(filename)
     {}
 };
 
@@ -142,7 +143,8 @@ namespace {
 QsoRecorder::QsoRecorder(Logic *logic)
   : recorder(0), hard_chunk_limit(0), soft_chunk_limit(0), max_dirsize(0),
     default_active(false), tmo_timer(0), logic(logic), qso_tmo_timer(0),
-    min_samples(0)
+    min_samples(0), file_ext("wav"), max_filesize(0), write_buffer_size(0),
+    write_flush_interval(0), write_sync(false)
 {
   selector = new AudioSelector;
 } /* QsoRecorder::QsoRecorder */
@@ -165,6 +167,23 @@ bool QsoRecorder::initialize(const Config &cfg, const string &name)
     return false;
   }
 
+  string format;
+  if (cfg.getValue(name, "FORMAT", format))
+  {
+    if ((format != "wav") && (format != "opus"))
+    {
+      cerr << "*** ERROR: Unknown audio format \"" << format << "\" "
+           << "specified in " << name << "/FORMAT. Use wav or opus.\n";
+      return false;
+    }
+    file_ext = format;
+  }
+
+  cfg.getValue(name, "MAX_FILESIZE", max_filesize);
+  cfg.getValue(name, "WRITE_BUFFER_SIZE", write_buffer_size);
+  cfg.getValue(name, "WRITE_FLUSH_INTERVAL", write_flush_interval);
+  cfg.getValue(name, "WRITE_SYNC", write_sync);
+
   unsigned max_time = 0;
   cfg.getValue(name, "MAX_TIME", max_time);
   unsigned soft_time = 0;
@@ -280,9 +299,12 @@ void QsoRecorder::openFile(void)
     string filename(rec_dir);
     filename += "/.qsorec_";
     filename += logic->name();
-    filename += ".wav";
+    filename += "." + file_ext;
     recorder = new AudioRecorder(filename);
     recorder->setMaxRecordingTime(hard_chunk_limit, soft_chunk_limit);
+    recorder->setMaxFileSize(1024 * max_filesize);
+    recorder->setWriteBufferSize(1024 * write_buffer_size);
+    recorder->setWriteFlushPolicy(write_flush_interval, write_sync);
     recorder->maxRecordingTimeReached.connect(
         mem_fun(*this, &QsoRecorder::openNewFile));
     recorder->errorOccurred.connect(mem_fun(*this, &QsoRecorder::onError));
@@ -301,7 +323,7 @@ void QsoRecorder::closeFile(void)
 {
   if (recorder != 0)
   {
-    string oldpath(rec_dir + "/.qsorec_" + logic->name() + ".wav");
+    string oldpath(rec_dir + "/.qsorec_" + logic->name() + "." + file_ext);
 
     if (!recorder->closeFile())
     {
@@ -310,6 +332,14 @@ void QsoRecorder::closeFile(void)
            << endl;
     }
 
+    if (recorder->overrunCount() > 0)
+    {
+      cerr << "*** WARNING: The QsoRecorder in logic " << logic->name()
+           << " dropped " << recorder->samplesDropped() << " samples in "
+           << recorder->overrunCount() << " overruns since the disk could "
+              "not keep up. Consider increasing WRITE_BUFFER_SIZE.\n";
+    }
+
     if (recorder->samplesWritten() > min_samples)
     {
       string basename("qsorec_" + logic->name() + "_");
@@ -327,32 +357,33 @@ void QsoRecorder::closeFile(void)
       localtime_r(&end_time.tv_sec, &tm);
       strftime(timestamp, sizeof(timestamp), "%Y-%m-%d_%H%M%S", &tm);
       basename += timestamp;
-      string newpath = rec_dir + "/" + basename + ".wav";
+      string filename = basename + "." + file_ext;
+      string newpath = rec_dir + "/" + filename;
       if (rename(oldpath.c_str(), newpath.c_str()) != 0)
       {
         perror("QsoRecorder rename");
       }
 
       cout << logic->name() << ": Wrote QSO recorder file "
-           << basename << ".wav\n";
+           << filename << "\n";
 
         // Execute external audio file handler (e.g. encoder) if configured
       if (!encoder_cmd.empty())
       {
         cout << logic->name() << ": Starting encoding for file "
-             << basename << ".wav\n";
+             << filename << "\n";
         const char *shell = getenv("SHELL");
         if (shell == NULL)
         {
           shell = "/bin/sh";
         }
-        FileEncoder *enc = new FileEncoder(shell, basename);
+        FileEncoder *enc = new FileEncoder(shell, filename);
         enc->appendArgument("-c");
         string cmdline(encoder_cmd);
         replace_all(cmdline, "%f", newpath);
         replace_all(cmdline, "%d", rec_dir);
         replace_all(cmdline, "%b", basename);
-        replace_all(cmdline, "%n", basename + ".wav");
+        replace_all(cmdline, "%n", filename);
         enc->appendArgument(cmdline);
         enc->stdoutData.connect(
             mem_fun(*this, &QsoRecorder::handleEncoderPrintouts));
@@ -465,7 +496,7 @@ void QsoRecorder::handleEncoderPrintouts(const char *buf, int cnt)
 void QsoRecorder::encoderExited(QsoRecorder::FileEncoder *enc)
 {
   cout << logic->name() << ": Encoding done for file "
-             << enc->basename << ".wav\n";
+             << enc->filename << "\n";
   if (enc->ifExited() && (enc->exitStatus() != 0))
   {
     cerr << "*** ERROR: QSO recorder external audio file handler in logic "
@@ -191,6 +191,11 @@ class QsoRecorder
     Async::Timer          *qso_tmo_timer;
     unsigned              min_samples;
     std::string           encoder_cmd;
+    std::string           file_ext;
+    unsigned              max_filesize;
+    unsigned              write_buffer_size;
+    unsigned              write_flush_interval;
+    bool                  write_sync;
 
     QsoRecorder(const QsoRecorder&);
     QsoRecorder& operator=(const QsoRecorder&);
@@ -36,6 +36,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iomanip>
 #include <algorithm>
 #include <iterator>
+#include <ctime>
+#include <limits>
 
 
 /****************************************************************************
@@ -48,6 +50,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncUdpSocket.h>
 #include <AsyncAudioPassthrough.h>
 #include <AsyncAudioValve.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncMetrics.h>
+#include <AsyncAudioLatencyTrace.h>
+#include <AsyncAudioLatencyBudget.h>
 #include <version/SVXLINK.h>
 
 
@@ -87,6 +93,76 @@ using namespace Async;
  *
  ****************************************************************************/
 
+namespace {
+  /**
+   * @brief An audio passthrough that accumulate the CPU time used downstream
+   *
+   * Used to separate the CPU time used by a codec from the time used by the
+   * audio pipe it feed.
+   */
+  class CpuTimedPassthrough : public Async::AudioPassthrough
+  {
+    public:
+      static uint64_t now(void)
+      {
+        struct timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+      }
+
+      explicit CpuTimedPassthrough(uint64_t& cpu_ns) : m_cpu_ns(cpu_ns) {}
+
+      virtual int writeSamples(const float *samples, int count)
+      {
+        uint64_t start = now();
+        int ret = sinkWriteSamples(samples, count);
+        m_cpu_ns += now() - start;
+        return ret;
+      }
+
+      virtual float *writeBuffer(int count)
+      {
+        return sinkWriteBuffer(count);
+      }
+
+      virtual void commitSamples(int count)
+      {
+        uint64_t start = now();
+        sinkCommitSamples(count);
+        m_cpu_ns += now() - start;
+      }
+
+    private:
+      uint64_t& m_cpu_ns;
+  };
+
+  /**
+   * @brief An audio passthrough that save the latency trace mark of the
+   *        audio going into the encoder
+   *
+   * The encoder collect samples into frames so the mark is saved until the
+   * next encoded frame is sent.
+   */
+  class LatencyMarkLatch : public Async::AudioPassthrough
+  {
+    public:
+      explicit LatencyMarkLatch(uint64_t& mark) : m_mark(mark) {}
+
+      virtual int writeSamples(const float *samples, int count)
+      {
+        if (Async::AudioLatencyTrace::current() != 0)
+        {
+          m_mark = Async::AudioLatencyTrace::current();
+          Async::AudioLatencyTrace::record("reflector_logic", m_mark);
+        }
+        return sinkWriteSamples(samples, count);
+      }
+
+    private:
+      uint64_t& m_mark;
+  };
+};
+
 
 
 /****************************************************************************
@@ -111,6 +187,8 @@ using namespace Async;
  *
  ****************************************************************************/
 
+ReflectorLogic::SharedSessionMap ReflectorLogic::shared_sessions;
+
 
 
 /****************************************************************************
@@ -123,6 +201,8 @@ ReflectorLogic::ReflectorLogic(Async::Config& cfg, const std::string& name)
   : LogicBase(cfg, name), m_con(0), m_msg_type(0), m_udp_sock(0),
     m_logic_con_in(0), m_logic_con_out(0),
     m_reconnect_timer(20000, Timer::TYPE_ONESHOT, false),
+    m_reconnect_backoff(RECONNECT_BACKOFF_START),
+    m_reconnect_rng(std::random_device()()),
     m_next_udp_tx_seq(0), m_next_udp_rx_seq(0),
     m_heartbeat_timer(1000, Timer::TYPE_PERIODIC, false), m_dec(0),
     m_flush_timeout_timer(3000, Timer::TYPE_ONESHOT, false),
@@ -137,7 +217,23 @@ ReflectorLogic::ReflectorLogic(Async::Config& cfg, const std::string& name)
     m_tg_local_activity(false), m_last_qsy(0), m_logic_con_in_valve(0),
     m_mute_first_tx_loc(true), m_mute_first_tx_rem(false),
     m_tmp_monitor_timer(1000, Async::Timer::TYPE_PERIODIC),
-    m_tmp_monitor_timeout(DEFAULT_TMP_MONITOR_TIMEOUT)
+    m_tmp_monitor_timeout(DEFAULT_TMP_MONITOR_TIMEOUT), m_jitter_fifo(0),
+    m_fast_tg_switch(false),
+    m_udp_ping_cnt(0), m_udp_ping_interval(UDP_PING_CNT_RESET),
+    m_net_stats_interval(DEFAULT_NET_STATS_INTERVAL),
+    m_net_stats_cnt(0), m_jb_min_delay(0), m_jb_max_delay(0),
+    m_jb_target_delay(0), m_jb_grow_cnt(0), m_udp_audio_tx_frames(0),
+    m_enc_cpu_ns(0), m_enc_send_cpu_ns(0), m_dec_cpu_ns(0),
+    m_dec_downstream_cpu_ns(0), m_tx_latency_mark(0),
+    m_siglev_report_timer(DEFAULT_SIGLEV_REPORT_INTERVAL,
+                          Async::Timer::TYPE_ONESHOT, false),
+    m_rx_state_changed(false), m_session_resume_sent(false),
+    m_standby_timer(1000, Async::Timer::TYPE_PERIODIC, false),
+    m_standby_switch_margin(DEFAULT_STANDBY_SWITCH_MARGIN),
+    m_standby_switch_hold(DEFAULT_STANDBY_SWITCH_HOLD),
+    m_standby_better_cnt(0), m_standby_switches(0),
+    m_proto_minor_ver(MsgProtoVer::MINOR), m_mux_owner(0), m_mux_channel(0),
+    m_next_mux_channel(0)
 {
   m_reconnect_timer.expired.connect(
       sigc::hide(mem_fun(*this, &ReflectorLogic::reconnect)));
@@ -153,11 +249,51 @@ ReflectorLogic::ReflectorLogic(Async::Config& cfg, const std::string& name)
         sigc::mem_fun(*this, &ReflectorLogic::processTgSelectionEvent)));
   m_tmp_monitor_timer.expired.connect(sigc::hide(
         sigc::mem_fun(*this, &ReflectorLogic::checkTmpMonitorTimeout)));
+  m_siglev_report_timer.expired.connect(sigc::hide(
+        sigc::mem_fun(*this, &ReflectorLogic::sendRxStateReport)));
+  m_standby_timer.expired.connect(sigc::hide(
+        sigc::mem_fun(*this, &ReflectorLogic::checkStandbyLinks)));
+  Async::Metrics::instance().collect.connect(
+      sigc::mem_fun(*this, &ReflectorLogic::writeMetrics));
 } /* ReflectorLogic::ReflectorLogic */
 
 
 ReflectorLogic::~ReflectorLogic(void)
 {
+  if (m_mux_owner != 0)
+  {
+    if (m_mux_channel != 0)
+    {
+      m_mux_owner->closeMuxChannel(m_mux_channel);
+      m_mux_channel = 0;
+    }
+    std::vector<ReflectorLogic*>& members = m_mux_owner->m_mux_members;
+    members.erase(std::remove(members.begin(), members.end(), this),
+                  members.end());
+  }
+  for (std::vector<ReflectorLogic*>::iterator it=m_mux_members.begin();
+       it!=m_mux_members.end(); ++it)
+  {
+    (*it)->m_mux_owner = 0;
+    (*it)->m_mux_channel = 0;
+    (*it)->m_con_state = STATE_DISCONNECTED;
+  }
+  m_mux_members.clear();
+  for (SharedSessionMap::iterator it=shared_sessions.begin();
+       it!=shared_sessions.end(); ++it)
+  {
+    if (it->second == this)
+    {
+      shared_sessions.erase(it);
+      break;
+    }
+  }
+  for (std::vector<ReflectorStandbyLink*>::iterator it=m_standby_links.begin();
+       it!=m_standby_links.end(); ++it)
+  {
+    delete *it;
+  }
+  m_standby_links.clear();
   delete m_event_handler;
   m_event_handler = 0;
   delete m_udp_sock;
@@ -184,6 +320,9 @@ bool ReflectorLogic::initialize(void)
   m_reflector_port = 5300;
   cfg().getValue(name(), "PORT", m_reflector_port);
 
+  bool share_session = false;
+  cfg().getValue(name(), "SHARE_SESSION", share_session);
+
   if (!cfg().getValue(name(), "CALLSIGN", m_callsign))
   {
     cerr << "*** ERROR: " << name() << "/CALLSIGN missing in configuration"
@@ -204,6 +343,37 @@ bool ReflectorLogic::initialize(void)
     return false;
   }
 
+  if (share_session)
+  {
+      // The first logic connecting to a reflector own the connection and
+      // the others log in through it
+    std::ostringstream ss;
+    ss << m_reflector_host << ":" << m_reflector_port;
+    SharedSessionMap::iterator it = shared_sessions.find(ss.str());
+    if (it == shared_sessions.end())
+    {
+      shared_sessions[ss.str()] = this;
+    }
+    else
+    {
+      m_mux_owner = it->second;
+      m_mux_owner->m_mux_members.push_back(this);
+      cout << name() << ": Sharing the reflector connection of "
+           << m_mux_owner->name() << endl;
+    }
+    std::string standby_hosts;
+    if (cfg().getValue(name(), "STANDBY_HOSTS", standby_hosts) &&
+        !standby_hosts.empty())
+    {
+      cerr << "*** WARNING[" << name() << "]: STANDBY_HOSTS cannot be used "
+              "together with SHARE_SESSION. Ignoring it." << endl;
+    }
+  }
+  else if (!parseStandbyHosts())
+  {
+    return false;
+  }
+
   string event_handler_str;
   if (!cfg().getValue(name(), "EVENT_HANDLER", event_handler_str))
   {
@@ -212,30 +382,12 @@ bool ReflectorLogic::initialize(void)
     return false;
   }
 
-  std::vector<std::string> monitor_tgs;
-  cfg().getValue(name(), "MONITOR_TGS", monitor_tgs);
-  for (std::vector<std::string>::iterator it=monitor_tgs.begin();
-       it!=monitor_tgs.end(); ++it)
+  if (!parseMonitorTgs(m_monitor_tgs))
   {
-    std::istringstream is(*it);
-    MonitorTgEntry mte;
-    is >> mte.tg;
-    char modifier;
-    while (is >> modifier)
-    {
-      if (modifier == '+')
-      {
-        mte.prio += 1;
-      }
-      else
-      {
-        cerr << "*** ERROR: Illegal format for config variable MONITOR_TGS "
-             << "entry \"" << *it << "\"" << endl;
-        return false;
-      }
-    }
-    m_monitor_tgs.insert(mte);
+    return false;
   }
+  cfg().subscribeValue(name(), "MONITOR_TGS",
+      mem_fun(*this, &ReflectorLogic::monitorTgsCfgUpdated));
 
 #if 0
   string audio_codec("GSM");
@@ -267,23 +419,77 @@ bool ReflectorLogic::initialize(void)
     prev_src = m_logic_con_in_valve;
   }
 
-  m_enc_endpoint = prev_src;
+  LatencyMarkLatch *latency_latch = new LatencyMarkLatch(m_tx_latency_mark);
+  prev_src->registerSink(latency_latch, true);
+  prev_src = latency_latch;
+
+    // Measure the CPU time used by the encoder and whatever it feed
+  CpuTimedPassthrough *enc_timer = new CpuTimedPassthrough(m_enc_cpu_ns);
+  prev_src->registerSink(enc_timer, true);
+  m_enc_endpoint = enc_timer;
   prev_src = 0;
 
     // Create dummy audio codec used before setting the real encoder
   if (!setAudioCodec("DUMMY")) { return false; }
   prev_src = m_dec;
 
+    // Keep the CPU time used downstream of the decoder apart
+  CpuTimedPassthrough *dec_timer =
+    new CpuTimedPassthrough(m_dec_downstream_cpu_ns);
+  prev_src->registerSink(dec_timer, true);
+  prev_src = dec_timer;
+
+  AudioLatencyStage *dec_latency = new AudioLatencyStage("decode");
+  prev_src->registerSink(dec_latency, true);
+  prev_src = dec_latency;
+
     // Create jitter buffer
   AudioFifo *fifo = new Async::AudioFifo(2*INTERNAL_SAMPLE_RATE);
   prev_src->registerSink(fifo, true);
   prev_src = fifo;
+
+  AudioLatencyStage *jb_latency = new AudioLatencyStage("jitter_buffer");
+  prev_src->registerSink(jb_latency, true);
+  prev_src = jb_latency;
   unsigned jitter_buffer_delay = 0;
   cfg().getValue(name(), "JITTER_BUFFER_DELAY", jitter_buffer_delay);
+  cfg().getValue(name(), "JITTER_BUFFER_MIN_DELAY", m_jb_min_delay);
+  cfg().getValue(name(), "JITTER_BUFFER_MAX_DELAY", m_jb_max_delay);
+  cfg().getValue(name(), "FAST_TG_SWITCH", m_fast_tg_switch);
+  if (jitterBufferIsAdaptive())
+  {
+    m_jb_max_delay = min(m_jb_max_delay, 1000U);
+    m_jb_min_delay = min(m_jb_min_delay, m_jb_max_delay);
+    jitter_buffer_delay = max(jitter_buffer_delay, m_jb_min_delay);
+    jitter_buffer_delay = min(jitter_buffer_delay, m_jb_max_delay);
+    if (jitter_buffer_delay == 0)
+    {
+      jitter_buffer_delay = (m_jb_max_delay < JITTER_BUFFER_GROW_STEP)
+                            ? m_jb_max_delay : JITTER_BUFFER_GROW_STEP;
+    }
+  }
   if (jitter_buffer_delay > 0)
   {
+    m_jb_target_delay = jitter_buffer_delay;
     fifo->setPrebufSamples(jitter_buffer_delay * INTERNAL_SAMPLE_RATE / 1000);
+      // Only a prebuffering FIFO hold samples so it is only monitored then
+    m_jitter_fifo = fifo;
+  }
+  if (jitterBufferIsAdaptive())
+  {
+      // The adaptive jitter buffer is tuned from the network statistics
+    AudioLatencyBudget::add(name() + ":jitter_buffer", fifo);
+  }
+  else
+  {
+    unsigned max_samples = jitter_buffer_delay * INTERNAL_SAMPLE_RATE / 1000;
+    AudioLatencyBudget::add(name() + ":jitter_buffer", fifo, max_samples / 4,
+                            max_samples);
   }
+  cfg().getValue(name(), "NET_STATS_INTERVAL", m_net_stats_interval);
+  unsigned siglev_report_interval = DEFAULT_SIGLEV_REPORT_INTERVAL;
+  cfg().getValue(name(), "SIGLEV_REPORT_INTERVAL", siglev_report_interval);
+  m_siglev_report_timer.setTimeout(siglev_report_interval);
 
   m_logic_con_out = new Async::AudioStreamStateDetector;
   m_logic_con_out->sigStreamStateChanged.connect(
@@ -295,6 +501,9 @@ bool ReflectorLogic::initialize(void)
   cfg().getValue(name(), "TG_SELECT_TIMEOUT", m_tg_select_timeout);
 
   m_event_handler = new EventHandler(event_handler_str, name());
+  unsigned event_handler_warn_time = 0;
+  cfg().getValue(name(), "EVENT_HANDLER_WARN_TIME", event_handler_warn_time);
+  m_event_handler->setWarnTime(event_handler_warn_time);
   if (LinkManager::hasInstance())
   {
     m_event_handler->playFile.connect(sigc::bind<0>(
@@ -369,6 +578,13 @@ bool ReflectorLogic::initialize(void)
 
   connect();
 
+  for (std::vector<ReflectorStandbyLink*>::iterator it=m_standby_links.begin();
+       it!=m_standby_links.end(); ++it)
+  {
+    (*it)->connect();
+  }
+  m_standby_timer.setEnable(!m_standby_links.empty());
+
   return true;
 } /* ReflectorLogic::initialize */
 
@@ -522,61 +738,45 @@ void ReflectorLogic::remoteReceivedPublishStateEvent(
 
   if (event_name == "Voter:sql_state")
   {
-    //MsgUdpSignalStrengthValues msg;
-    MsgSignalStrengthValues msg;
     std::istringstream is(data);
     Json::Value rx_arr;
     is >> rx_arr;
     for (Json::Value::ArrayIndex i = 0; i != rx_arr.size(); i++)
     {
       Json::Value& rx_data = rx_arr[i];
-      std::string name = rx_data.get("name", "").asString();
       std::string id_str = rx_data.get("id", "?").asString();
       if (id_str.size() != 1)
       {
         return;
       }
-      char id = id_str[0];
       int siglev = rx_data.get("siglev", 0).asInt();
-      siglev = std::min(std::max(siglev, 0), 100);
-      bool is_enabled = rx_data.get("enabled", false).asBool();
-      bool sql_open = rx_data.get("sql_open", false).asBool();
-      bool is_active = rx_data.get("active", false).asBool();
-      //MsgUdpSignalStrengthValues::Rx rx(id, siglev);
-      MsgSignalStrengthValues::Rx rx(id, siglev);
-      rx.setEnabled(is_enabled);
-      rx.setSqlOpen(sql_open);
-      rx.setActive(is_active);
-      msg.pushBack(rx);
+      RxState state;
+      state.siglev = std::min(std::max(siglev, 0), 100);
+      state.enabled = rx_data.get("enabled", false).asBool();
+      state.sql_open = rx_data.get("sql_open", false).asBool();
+      state.active = rx_data.get("active", false).asBool();
+      reportRxState(id_str[0], state);
     }
-    //sendUdpMsg(msg);
-    sendMsg(msg);
+    scheduleRxStateReport();
   }
   else if (event_name == "Rx:sql_state")
   {
-    //MsgUdpSignalStrengthValues msg;
-    MsgSignalStrengthValues msg;
     std::istringstream is(data);
     Json::Value rx_data;
     is >> rx_data;
-    std::string name = rx_data.get("name", "").asString();
     std::string id_str = rx_data.get("id", "?").asString();
     if (id_str.size() != 1)
     {
       return;
     }
-    char id = id_str[0];
     int siglev = rx_data.get("siglev", 0).asInt();
-    siglev = std::min(std::max(siglev, 0), 100);
-    bool sql_open = rx_data.get("sql_open", false).asBool();
-    //MsgUdpSignalStrengthValues::Rx rx(id, siglev);
-    MsgSignalStrengthValues::Rx rx(id, siglev);
-    rx.setEnabled(true);
-    rx.setSqlOpen(sql_open);
-    rx.setActive(sql_open);
-    msg.pushBack(rx);
-    //sendUdpMsg(msg);
-    sendMsg(msg);
+    RxState state;
+    state.siglev = std::min(std::max(siglev, 0), 100);
+    state.enabled = true;
+    state.sql_open = rx_data.get("sql_open", false).asBool();
+    state.active = state.sql_open;
+    reportRxState(id_str[0], state);
+    scheduleRxStateReport();
   }
   else if (event_name == "Tx:state")
   {
@@ -647,7 +847,14 @@ void ReflectorLogic::onConnected(void)
 {
   cout << name() << ": Connection established to " << m_con->remoteHost() << ":"
        << m_con->remotePort() << endl;
-  sendMsg(MsgProtoVer());
+  beginLogin();
+  m_con->setMaxFrameSize(ReflectorMsg::MAX_PREAUTH_FRAME_SIZE);
+} /* ReflectorLogic::onConnected */
+
+
+void ReflectorLogic::beginLogin(void)
+{
+  m_proto_minor_ver = MsgProtoVer::MINOR;
   m_udp_heartbeat_tx_cnt = UDP_HEARTBEAT_TX_CNT_RESET;
   m_udp_heartbeat_rx_cnt = UDP_HEARTBEAT_RX_CNT_RESET;
   m_tcp_heartbeat_tx_cnt = TCP_HEARTBEAT_TX_CNT_RESET;
@@ -655,10 +862,16 @@ void ReflectorLogic::onConnected(void)
   m_heartbeat_timer.setEnable(true);
   m_next_udp_tx_seq = 0;
   m_next_udp_rx_seq = 0;
+  m_net_stats.reset();
+  m_link_quality.reset();
+  m_login_frames.clear();
+  m_udp_ping_cnt = m_udp_ping_interval;
+  m_net_stats_cnt = m_net_stats_interval;
   timerclear(&m_last_talker_timestamp);
   m_con_state = STATE_EXPECT_AUTH_CHALLENGE;
-  m_con->setMaxFrameSize(ReflectorMsg::MAX_PREAUTH_FRAME_SIZE);
-} /* ReflectorLogic::onConnected */
+  m_session_resume_sent = false;
+  sendMsg(MsgProtoVer());
+} /* ReflectorLogic::beginLogin */
 
 
 void ReflectorLogic::onDisconnected(TcpConnection *con,
@@ -667,13 +880,43 @@ void ReflectorLogic::onDisconnected(TcpConnection *con,
   cout << name() << ": Disconnected from " << m_con->remoteHost() << ":"
        << m_con->remotePort() << ": "
        << TcpConnection::disconnectReasonStr(reason) << endl;
-  m_reconnect_timer.setTimeout(1000 + std::rand() % 5000);
-  m_reconnect_timer.setEnable(true);
+  scheduleReconnect();
   delete m_udp_sock;
   m_udp_sock = 0;
+  resetSessionState();
+} /* ReflectorLogic::onDisconnected */
+
+
+void ReflectorLogic::scheduleReconnect(void)
+{
+    // Use an exponential backoff with a random delay so that the nodes
+    // that lost their connection at the same time, like when the reflector
+    // is restarted, do not all reconnect at the same moment
+  m_reconnect_timer.setTimeout(
+      RECONNECT_MIN_DELAY + m_reconnect_rng() % m_reconnect_backoff);
+  m_reconnect_timer.setEnable(true);
+  m_reconnect_backoff *= 2;
+  if (m_reconnect_backoff > RECONNECT_BACKOFF_MAX)
+  {
+    m_reconnect_backoff = RECONNECT_BACKOFF_MAX;
+  }
+} /* ReflectorLogic::scheduleReconnect */
+
+
+void ReflectorLogic::resetSessionState(void)
+{
   m_next_udp_tx_seq = 0;
   m_next_udp_rx_seq = 0;
+  m_srv_enc_options.clear();
+  m_login_frames.clear();
+  m_standby_better_cnt = 0;
   m_heartbeat_timer.setEnable(false);
+    // Send the full receiver state to the reflector after reconnecting.
+    // Pending states are newer than the sent ones so they are kept.
+  m_siglev_report_timer.setEnable(false);
+  m_rx_state_pending.insert(m_rx_state_sent.begin(), m_rx_state_sent.end());
+  m_rx_state_sent.clear();
+  m_rx_state_changed = !m_rx_state_pending.empty();
   if (m_flush_timeout_timer.isEnabled())
   {
     m_flush_timeout_timer.setEnable(false);
@@ -685,7 +928,15 @@ void ReflectorLogic::onDisconnected(TcpConnection *con,
     timerclear(&m_last_talker_timestamp);
   }
   m_con_state = STATE_DISCONNECTED;
-} /* ReflectorLogic::onDisconnected */
+
+    // The sessions sharing this connection are gone too
+  MuxChannelMap channels;
+  channels.swap(m_mux_channels);
+  for (MuxChannelMap::iterator it=channels.begin(); it!=channels.end(); ++it)
+  {
+    it->second->sharedChannelClosed();
+  }
+} /* ReflectorLogic::resetSessionState */
 
 
 void ReflectorLogic::onFrameReceived(FramedTcpConnection *con,
@@ -716,6 +967,18 @@ void ReflectorLogic::onFrameReceived(FramedTcpConnection *con,
 
   m_tcp_heartbeat_rx_cnt = TCP_HEARTBEAT_RX_CNT_RESET;
 
+    // Keep the login messages so that the session can be handed over to a
+    // standby link when switching to another reflector
+  if (!m_standby_links.empty() &&
+      ReflectorStandbyLink::isLoginFrame(header.type()))
+  {
+    if (header.type() == MsgServerInfo::TYPE)
+    {
+      m_login_frames.clear();
+    }
+    m_login_frames.push_back(data);
+  }
+
   switch (header.type())
   {
     case MsgHeartbeat::TYPE:
@@ -735,6 +998,9 @@ void ReflectorLogic::onFrameReceived(FramedTcpConnection *con,
     case MsgServerInfo::TYPE:
       handleMsgServerInfo(ss);
       break;
+    case MsgCodecOptions::TYPE:
+      handleMsgCodecOptions(ss);
+      break;
     case MsgNodeList::TYPE:
       handleMsgNodeList(ss);
       break;
@@ -753,6 +1019,15 @@ void ReflectorLogic::onFrameReceived(FramedTcpConnection *con,
     case MsgRequestQsy::TYPE:
       handleMsgRequestQsy(ss);
       break;
+    case MsgEventBatch::TYPE:
+      handleMsgEventBatch(ss);
+      break;
+    case MsgSessionToken::TYPE:
+      handleMsgSessionToken(ss);
+      break;
+    case MsgMuxFrame::TYPE:
+      handleMsgMuxFrame(ss);
+      break;
     default:
       // Better just ignoring unknown messages for easier addition of protocol
       // messages while being backwards compatible
@@ -788,6 +1063,17 @@ void ReflectorLogic::handleMsgProtoVerDowngrade(std::istream& is)
     cerr << "*** ERROR[" << name() << "]: Could not unpack MsgProtoVerDowngrade" << endl;
     disconnect();
     return;
+  }
+    // Same major version means that we just have to avoid using the newer
+    // protocol features, like event batching
+  if ((msg.majorVer() == MsgProtoVer::MAJOR) &&
+      (msg.minorVer() < MsgProtoVer::MINOR))
+  {
+    cout << name() << ": Downgrading to protocol version "
+         << msg.majorVer() << "." << msg.minorVer() << endl;
+    m_proto_minor_ver = msg.minorVer();
+    sendMsg(MsgProtoVer(msg.majorVer(), msg.minorVer()));
+    return;
   }
   cout << name() << ": Server too old and we cannot downgrade to protocol version "
        << msg.majorVer() << "." << msg.minorVer() << " from "
@@ -799,7 +1085,10 @@ void ReflectorLogic::handleMsgProtoVerDowngrade(std::istream& is)
 
 void ReflectorLogic::handleMsgAuthChallenge(std::istream& is)
 {
-  if (m_con_state != STATE_EXPECT_AUTH_CHALLENGE)
+    // A new challenge is sent by the server if a session could not be
+    // resumed
+  if ((m_con_state != STATE_EXPECT_AUTH_CHALLENGE) &&
+      !((m_con_state == STATE_EXPECT_AUTH_OK) && m_session_resume_sent))
   {
     cerr << "*** ERROR[" << name() << "]: Unexpected MsgAuthChallenge\n";
     disconnect();
@@ -820,7 +1109,18 @@ void ReflectorLogic::handleMsgAuthChallenge(std::istream& is)
     disconnect();
     return;
   }
-  sendMsg(MsgAuthResponse(m_callsign, m_auth_key, challenge));
+  if (!m_session_token.empty())
+  {
+      // The token can only be used once
+    sendMsg(MsgSessionResume(m_callsign, m_session_token, challenge));
+    m_session_token.clear();
+    m_session_resume_sent = true;
+  }
+  else
+  {
+    sendMsg(MsgAuthResponse(m_callsign, m_auth_key, challenge));
+    m_session_resume_sent = false;
+  }
   m_con_state = STATE_EXPECT_AUTH_OK;
 } /* ReflectorLogic::handleMsgAuthChallenge */
 
@@ -835,7 +1135,10 @@ void ReflectorLogic::handleMsgAuthOk(void)
   }
   cout << name() << ": Authentication OK" << endl;
   m_con_state = STATE_EXPECT_SERVER_INFO;
-  m_con->setMaxFrameSize(ReflectorMsg::MAX_POSTAUTH_FRAME_SIZE);
+  if (m_con != 0)
+  {
+    m_con->setMaxFrameSize(ReflectorMsg::MAX_POSTAUTH_FRAME_SIZE);
+  }
 } /* ReflectorLogic::handleMsgAuthOk */
 
 
@@ -901,12 +1204,25 @@ void ReflectorLogic::handleMsgServerInfo(std::istream& is)
   }
   cout << endl;
 
-  delete m_udp_sock;
-  m_udp_sock = new UdpSocket;
-  m_udp_sock->dataReceived.connect(
-      mem_fun(*this, &ReflectorLogic::udpDatagramReceived));
+    // A reflector that offer more than one codec can transcode between them
+    // so it need to know which one we use
+  if (!selected_codec.empty() && (msg.codecs().size() > 1))
+  {
+    sendMsg(MsgSelectCodec(selected_codec));
+  }
+
+    // A session taken over from a standby link already have a UDP socket
+    // that the reflector know about. A shared session use the socket of the
+    // logic owning the connection.
+  if ((m_udp_sock == 0) && (m_mux_channel == 0))
+  {
+    m_udp_sock = new UdpSocket;
+    m_udp_sock->dataReceived.connect(
+        mem_fun(*this, &ReflectorLogic::udpDatagramReceived));
+  }
 
   m_con_state = STATE_CONNECTED;
+  m_reconnect_backoff = RECONNECT_BACKOFF_START;
 
   std::ostringstream node_info_os;
   Json::StreamWriterBuilder builder;
@@ -975,8 +1291,14 @@ void ReflectorLogic::handleMsgServerInfo(std::istream& is)
     sendMsg(MsgTgMonitor(
           std::set<uint32_t>(m_monitor_tgs.begin(), m_monitor_tgs.end())));
   }
+  scheduleRxStateReport();
   sendUdpMsg(MsgUdpHeartbeat());
 
+  for (std::vector<ReflectorLogic*>::iterator it=m_mux_members.begin();
+       it!=m_mux_members.end(); ++it)
+  {
+    (*it)->sharedSessionUp();
+  }
 } /* ReflectorLogic::handleMsgServerInfo */
 
 
@@ -1013,7 +1335,7 @@ void ReflectorLogic::handleMsgNodeJoined(std::istream& is)
     disconnect();
     return;
   }
-  cout << name() << ": Node joined: " << msg.callsign() << endl;
+  nodeJoined(msg.callsign());
 } /* ReflectorLogic::handleMsgNodeJoined */
 
 
@@ -1026,7 +1348,7 @@ void ReflectorLogic::handleMsgNodeLeft(std::istream& is)
     disconnect();
     return;
   }
-  cout << name() << ": Node left: " << msg.callsign() << endl;
+  nodeLeft(msg.callsign());
 } /* ReflectorLogic::handleMsgNodeLeft */
 
 
@@ -1039,13 +1361,117 @@ void ReflectorLogic::handleMsgTalkerStart(std::istream& is)
     disconnect();
     return;
   }
-  cout << name() << ": Talker start on TG #" << msg.tg() << ": "
-       << msg.callsign() << endl;
+  talkerStart(msg.tg(), msg.callsign());
+} /* ReflectorLogic::handleMsgTalkerStart */
+
+
+void ReflectorLogic::handleMsgTalkerStop(std::istream& is)
+{
+  MsgTalkerStop msg;
+  if (!msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << name() << "]: Could not unpack MsgTalkerStop\n";
+    disconnect();
+    return;
+  }
+  talkerStop(msg.tg(), msg.callsign());
+} /* ReflectorLogic::handleMsgTalkerStop */
+
+
+void ReflectorLogic::handleMsgEventBatch(std::istream& is)
+{
+  MsgEventBatch msg;
+  if (!msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << name() << "]: Could not unpack MsgEventBatch\n";
+    disconnect();
+    return;
+  }
+  const MsgEventBatch::Events& events = msg.events();
+  for (MsgEventBatch::Events::const_iterator it = events.begin();
+       it != events.end(); ++it)
+  {
+    switch (it->type())
+    {
+      case MsgNodeJoined::TYPE:
+        nodeJoined(it->callsign());
+        break;
+      case MsgNodeLeft::TYPE:
+        nodeLeft(it->callsign());
+        break;
+      case MsgTalkerStart::TYPE:
+        talkerStart(it->tg(), it->callsign());
+        break;
+      case MsgTalkerStop::TYPE:
+        talkerStop(it->tg(), it->callsign());
+        break;
+      default:
+        break;
+    }
+  }
+} /* ReflectorLogic::handleMsgEventBatch */
+
+
+void ReflectorLogic::handleMsgSessionToken(std::istream& is)
+{
+  MsgSessionToken msg;
+  if (!msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << name() << "]: Could not unpack MsgSessionToken\n";
+    disconnect();
+    return;
+  }
+  m_session_token = msg.token();
+} /* ReflectorLogic::handleMsgSessionToken */
+
+
+void ReflectorLogic::handleMsgMuxFrame(std::istream& is)
+{
+  MsgMuxFrame msg;
+  if (!msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << name() << "]: Could not unpack MsgMuxFrame\n";
+    disconnect();
+    return;
+  }
+  MuxChannelMap::iterator it = m_mux_channels.find(msg.channel());
+  if (it == m_mux_channels.end())
+  {
+      // A late message for a channel that we have already closed
+    return;
+  }
+  ReflectorLogic *member = it->second;
+  if (msg.frame().empty())
+  {
+    m_mux_channels.erase(it);
+    member->sharedChannelClosed();
+    return;
+  }
+  member->onFrameReceived(0, msg.frame());
+} /* ReflectorLogic::handleMsgMuxFrame */
+
+
+void ReflectorLogic::nodeJoined(const std::string& callsign)
+{
+  cout << name() << ": Node joined: " << callsign << endl;
+} /* ReflectorLogic::nodeJoined */
+
+
+void ReflectorLogic::nodeLeft(const std::string& callsign)
+{
+  cout << name() << ": Node left: " << callsign << endl;
+} /* ReflectorLogic::nodeLeft */
+
+
+void ReflectorLogic::talkerStart(uint32_t tg, const std::string& callsign)
+{
+  cout << name() << ": Talker start on TG #" << tg << ": "
+       << callsign << endl;
 
     // Select the incoming TG if idle
   if (m_tg_select_timeout_cnt == 0)
   {
-    selectTg(msg.tg(), "tg_remote_activation", !m_mute_first_tx_rem);
+    selectTg(tg, "tg_remote_activation", !m_mute_first_tx_rem);
   }
   else
   {
@@ -1057,39 +1483,51 @@ void ReflectorLogic::handleMsgTalkerStart(std::istream& is)
       selected_tg_prio = selected_tg_it->prio;
     }
     MonitorTgsSet::const_iterator talker_tg_it =
-      m_monitor_tgs.find(MonitorTgEntry(msg.tg()));
+      m_monitor_tgs.find(MonitorTgEntry(tg));
     if ((talker_tg_it != m_monitor_tgs.end()) &&
         (talker_tg_it->prio > selected_tg_prio) &&
         !m_tg_local_activity)
     {
       std::cout << name() << ": Activity on prioritized TG #"
-                << msg.tg() << ". Switching!" << std::endl;
-      selectTg(msg.tg(), "tg_remote_prio_activation", !m_mute_first_tx_rem);
+                << tg << ". Switching!" << std::endl;
+      selectTg(tg, "tg_remote_prio_activation", !m_mute_first_tx_rem);
     }
   }
 
   std::ostringstream ss;
-  ss << "talker_start " << msg.tg() << " " << msg.callsign();
+  ss << "talker_start " << tg << " " << callsign;
   processEvent(ss.str());
-} /* ReflectorLogic::handleMsgTalkerStart */
+} /* ReflectorLogic::talkerStart */
 
 
-void ReflectorLogic::handleMsgTalkerStop(std::istream& is)
+void ReflectorLogic::talkerStop(uint32_t tg, const std::string& callsign)
 {
-  MsgTalkerStop msg;
+  cout << name() << ": Talker stop on TG #" << tg << ": "
+       << callsign << endl;
+
+  std::ostringstream ss;
+  ss << "talker_stop " << tg << " " << callsign;
+  processEvent(ss.str());
+} /* ReflectorLogic::talkerStop */
+
+
+void ReflectorLogic::handleMsgCodecOptions(std::istream& is)
+{
+  MsgCodecOptions msg;
   if (!msg.unpack(is))
   {
-    cerr << "*** ERROR[" << name() << "]: Could not unpack MsgTalkerStop\n";
+    cerr << "*** ERROR[" << name() << "]: Could not unpack MsgCodecOptions\n";
     disconnect();
     return;
   }
-  cout << name() << ": Talker stop on TG #" << msg.tg() << ": "
-       << msg.callsign() << endl;
-
-  std::ostringstream ss;
-  ss << "talker_stop " << msg.tg() << " " << msg.callsign();
-  processEvent(ss.str());
-} /* ReflectorLogic::handleMsgTalkerStop */
+  if (msg.codec() != m_enc->name())
+  {
+    return;
+  }
+  m_srv_enc_options = msg.options();
+  applyServerEncOptions();
+  m_enc->printCodecParams();
+} /* ReflectorLogic::handleMsgCodecOptions */
 
 
 void ReflectorLogic::handleMsgRequestQsy(std::istream& is)
@@ -1136,6 +1574,11 @@ void ReflectorLogic::sendMsg(const ReflectorMsg& msg)
     disconnect();
     return;
   }
+  if (m_mux_channel != 0)
+  {
+    m_mux_owner->sendMsg(MsgMuxFrame(m_mux_channel, ss.str()));
+    return;
+  }
   if (m_con->write(ss.str().data(), ss.str().size()) == -1)
   {
     disconnect();
@@ -1147,6 +1590,7 @@ void ReflectorLogic::sendEncodedAudio(const void *buf, int count)
 {
   if (!isLoggedIn())
   {
+    m_tx_latency_mark = 0;
     return;
   }
 
@@ -1154,10 +1598,54 @@ void ReflectorLogic::sendEncodedAudio(const void *buf, int count)
   {
     m_flush_timeout_timer.setEnable(false);
   }
-  sendUdpMsg(MsgUdpAudio(buf, count));
+  uint64_t start = CpuTimedPassthrough::now();
+  if (m_tx_latency_mark != 0)
+  {
+    AudioLatencyTrace::record("encode", m_tx_latency_mark);
+    MsgUdpAudioLatencyMark latency_mark(m_tx_latency_mark);
+    m_tx_latency_mark = 0;
+    sendUdpMsg(MsgUdpAudio(buf, count), &latency_mark);
+  }
+  else
+  {
+    sendUdpMsg(MsgUdpAudio(buf, count));
+  }
+  m_enc_send_cpu_ns += CpuTimedPassthrough::now() - start;
+  m_udp_audio_tx_frames += 1;
 } /* ReflectorLogic::sendEncodedAudio */
 
 
+void ReflectorLogic::sendEncodedPacket(Async::AudioEncoder::Packet& packet)
+{
+    // A latency trace mark is appended to the message so those frames are
+    // sent the ordinary way
+  if (!isLoggedIn() || (udpSocket() == 0) || (m_tx_latency_mark != 0) ||
+      (packet.size() > numeric_limits<uint16_t>::max()))
+  {
+    sendEncodedAudio(packet.data(), packet.size());
+    return;
+  }
+
+  if (m_flush_timeout_timer.isEnabled())
+  {
+    m_flush_timeout_timer.setEnable(false);
+  }
+  uint64_t start = CpuTimedPassthrough::now();
+  m_udp_heartbeat_tx_cnt = UDP_HEARTBEAT_TX_CNT_RESET;
+
+    // The message is packed in place in front of the encoded frame
+  MsgUdpAudio::packDataSize(packet.prepend(MsgUdpAudio::DATA_SIZE_LEN),
+                            packet.size());
+  ReflectorUdpMsg::packHeader(packet.prepend(ReflectorUdpMsg::HEADER_SIZE),
+                              MsgUdpAudio::TYPE, m_client_id,
+                              m_next_udp_tx_seq++);
+  udpWrite(packet.begin(), packet.totalSize());
+
+  m_enc_send_cpu_ns += CpuTimedPassthrough::now() - start;
+  m_udp_audio_tx_frames += 1;
+} /* ReflectorLogic::sendEncodedPacket */
+
+
 void ReflectorLogic::flushEncodedAudio(void)
 {
   if (!isLoggedIn())
@@ -1204,59 +1692,122 @@ void ReflectorLogic::udpDatagramReceived(const IpAddress& addr, uint16_t port,
     return;
   }
 
-  if (header.clientId() != m_client_id)
+  if (header.type() == MsgUdpMuxDelivery::TYPE)
   {
-    cout << "*** WARNING[" << name()
-         << "]: UDP packet received with wrong client id "
-         << header.clientId() << ". Should be " << m_client_id << "." << endl;
+    handleMsgUdpMuxDelivery(header, ss);
     return;
   }
 
-    // Check sequence number
-  uint16_t udp_rx_seq_diff = header.sequenceNum() - m_next_udp_rx_seq;
-  if (udp_rx_seq_diff > 0x7fff) // Frame out of sequence (ignore)
+  ReflectorLogic *receiver = udpMsgReceiver(header.clientId());
+  if (receiver == 0)
   {
-    cout << name()
-         << ": Dropping out of sequence UDP frame with seq="
-         << header.sequenceNum() << endl;
+    cout << "*** WARNING[" << name()
+         << "]: UDP packet received with wrong client id "
+         << header.clientId() << ". Should be " << m_client_id << "." << endl;
     return;
   }
-  else if (udp_rx_seq_diff > 0) // Frame lost
-  {
-    cout << name() << ": UDP frame(s) lost. Expected seq="
-         << m_next_udp_rx_seq
-         << " but received " << header.sequenceNum()
-         << ". Resetting next expected sequence number to "
-         << (header.sequenceNum() + 1) << endl;
-  }
-  m_next_udp_rx_seq = header.sequenceNum() + 1;
+  receiver->handleUdpMsg(header, ss, true);
+} /* ReflectorLogic::udpDatagramReceived */
 
-  m_udp_heartbeat_rx_cnt = UDP_HEARTBEAT_RX_CNT_RESET;
 
-  switch (header.type())
+void ReflectorLogic::handleUdpMsg(const ReflectorUdpMsg& header,
+                                  std::istream& is, bool check_seq)
+{
+  bool frame_lost = false;
+  if (check_seq)
   {
-    case MsgUdpHeartbeat::TYPE:
+      // Check sequence number
+    uint16_t udp_rx_seq_diff = header.sequenceNum() - m_next_udp_rx_seq;
+    m_net_stats.packetReceived(static_cast<int16_t>(udp_rx_seq_diff));
+    if (udp_rx_seq_diff > 0x7fff) // Frame out of sequence (ignore)
+    {
+      cout << name()
+           << ": Dropping out of sequence UDP frame with seq="
+           << header.sequenceNum() << endl;
+      return;
+    }
+    else if (udp_rx_seq_diff > 0) // Frame lost
+    {
+      frame_lost = true;
+      cout << name() << ": UDP frame(s) lost. Expected seq="
+           << m_next_udp_rx_seq
+           << " but received " << header.sequenceNum()
+           << ". Resetting next expected sequence number to "
+           << (header.sequenceNum() + 1) << endl;
+    }
+    m_next_udp_rx_seq = header.sequenceNum() + 1;
+  }
+
+  m_udp_heartbeat_rx_cnt = UDP_HEARTBEAT_RX_CNT_RESET;
+
+  switch (header.type())
+  {
+    case MsgUdpHeartbeat::TYPE:
       break;
 
     case MsgUdpAudio::TYPE:
     {
       MsgUdpAudio msg;
-      if (!msg.unpack(ss))
+      if (!msg.unpack(is))
       {
         cerr << "*** WARNING[" << name() << "]: Could not unpack MsgUdpAudio\n";
         return;
       }
+      MsgUdpAudioLatencyMark latency_mark;
+      uint64_t mark = (latency_mark.unpack(is) && latency_mark.isValid())
+                      ? latency_mark.mark() : 0;
+      if (mark != 0)
+      {
+        AudioLatencyTrace::record("network", mark);
+      }
+      AudioLatencyTrace::Scope latency_scope(mark);
       if (!msg.audioData().empty())
       {
+        m_net_stats.packetArrived();
+        bool jb_underrun = false;
+        if ((m_jitter_fifo != 0) && timerisset(&m_last_talker_timestamp) &&
+            m_jitter_fifo->empty())
+        {
+          m_net_stats.jitterBufferUnderrun();
+          jb_underrun = true;
+        }
+        if (jitterBufferIsAdaptive() &&
+            (jb_underrun || !timerisset(&m_last_talker_timestamp)))
+        {
+          adaptJitterBuffer(jb_underrun);
+        }
         gettimeofday(&m_last_talker_timestamp, NULL);
-        m_dec->writeEncodedSamples(
-            &msg.audioData().front(), msg.audioData().size());
+        uint64_t dec_start = CpuTimedPassthrough::now();
+        if (frame_lost)
+        {
+            // Let the decoder try to recover the lost frame, e.g. using
+            // Opus inband FEC data, before decoding this frame
+          m_dec->writeEncodedSamplesAfterLoss(
+              &msg.audioData().front(), msg.audioData().size());
+        }
+        else
+        {
+          m_dec->writeEncodedSamples(
+              &msg.audioData().front(), msg.audioData().size());
+        }
+        m_dec_cpu_ns += CpuTimedPassthrough::now() - dec_start;
+        if (m_jitter_fifo != 0)
+        {
+          m_net_stats.jitterBufferFill(
+              m_jitter_fifo->samplesInFifo(true) * 1000 / INTERNAL_SAMPLE_RATE);
+        }
       }
       break;
     }
 
     case MsgUdpFlushSamples::TYPE:
-      m_dec->flushEncodedSamples();
+      m_net_stats.resetJitterReference();
+        // After a fast TG switch the stream of the old TG has already been
+        // ended locally so the flush sent by the reflector is redundant
+      if (!m_fast_tg_switch || timerisset(&m_last_talker_timestamp))
+      {
+        m_dec->flushEncodedSamples();
+      }
       timerclear(&m_last_talker_timestamp);
       break;
 
@@ -1264,6 +1815,27 @@ void ReflectorLogic::udpDatagramReceived(const IpAddress& addr, uint16_t port,
       m_enc->allEncodedSamplesFlushed();
       break;
 
+    case MsgUdpPing::TYPE:
+    {
+      MsgUdpPing msg;
+      if (msg.unpack(is))
+      {
+        sendUdpMsg(MsgUdpPong(msg.timestamp()));
+      }
+      break;
+    }
+
+    case MsgUdpPong::TYPE:
+    {
+      MsgUdpPong msg;
+      if (msg.unpack(is))
+      {
+        m_net_stats.pongReceived(msg.timestamp());
+        m_link_quality.pongReceived(msg.timestamp());
+      }
+      break;
+    }
+
     default:
       // Better ignoring unknown protocol messages for easier addition of new
       // messages while still being backwards compatible
@@ -1273,10 +1845,68 @@ void ReflectorLogic::udpDatagramReceived(const IpAddress& addr, uint16_t port,
       //     << header.type() << endl;
       break;
   }
-} /* ReflectorLogic::udpDatagramReceived */
+} /* ReflectorLogic::handleUdpMsg */
 
 
-void ReflectorLogic::sendUdpMsg(const ReflectorUdpMsg& msg)
+void ReflectorLogic::handleMsgUdpMuxDelivery(const ReflectorUdpMsg& header,
+                                             std::istream& is)
+{
+  MsgUdpMuxDelivery msg;
+  if (!msg.unpack(is))
+  {
+    cout << "*** WARNING[" << name()
+         << "]: Could not unpack MsgUdpMuxDelivery" << endl;
+    return;
+  }
+  const std::string body((std::istreambuf_iterator<char>(is)),
+                         std::istreambuf_iterator<char>());
+
+    // Only the first receiver check the sequence number since the
+    // message is sent in its sequence
+  ReflectorLogic *receiver = udpMsgReceiver(header.clientId());
+  if (receiver != 0)
+  {
+    ReflectorUdpMsg inner(msg.msgType(), header.clientId(),
+                          header.sequenceNum());
+    std::istringstream inner_is(body);
+    receiver->handleUdpMsg(inner, inner_is, true);
+  }
+  for (std::vector<uint16_t>::const_iterator it=msg.clientIds().begin();
+       it!=msg.clientIds().end(); ++it)
+  {
+    receiver = udpMsgReceiver(*it);
+    if (receiver != 0)
+    {
+      ReflectorUdpMsg inner(msg.msgType(), *it);
+      std::istringstream inner_is(body);
+      receiver->handleUdpMsg(inner, inner_is, false);
+    }
+  }
+} /* ReflectorLogic::handleMsgUdpMuxDelivery */
+
+
+ReflectorLogic* ReflectorLogic::udpMsgReceiver(uint32_t client_id)
+{
+  if (client_id == m_client_id)
+  {
+    return this;
+  }
+  for (MuxChannelMap::iterator it=m_mux_channels.begin();
+       it!=m_mux_channels.end(); ++it)
+  {
+    ReflectorLogic *member = it->second;
+    if (member->isLoggedIn() && (member->m_client_id == client_id))
+    {
+      return member;
+    }
+  }
+  return 0;
+} /* ReflectorLogic::udpMsgReceiver */
+
+
+
+void ReflectorLogic::sendUdpMsg(const ReflectorUdpMsg& msg,
+                                const Async::Msg *ext)
 {
   if (!isLoggedIn())
   {
@@ -1285,26 +1915,54 @@ void ReflectorLogic::sendUdpMsg(const ReflectorUdpMsg& msg)
 
   m_udp_heartbeat_tx_cnt = UDP_HEARTBEAT_TX_CNT_RESET;
 
-  if (m_udp_sock == 0)
+  if (udpSocket() == 0)
   {
     return;
   }
 
   ReflectorUdpMsg header(msg.type(), m_client_id, m_next_udp_tx_seq++);
   ostringstream ss;
-  if (!header.pack(ss) || !msg.pack(ss))
+  if (!header.pack(ss) || !msg.pack(ss) || ((ext != 0) && !ext->pack(ss)))
   {
     cerr << "*** ERROR[" << name()
          << "]: Failed to pack reflector TCP message\n";
     return;
   }
-  m_udp_sock->write(m_con->remoteHost(), m_con->remotePort(),
-                    ss.str().data(), ss.str().size());
+  udpWrite(ss.str().data(), ss.str().size());
 } /* ReflectorLogic::sendUdpMsg */
 
 
+void ReflectorLogic::udpWrite(const void *buf, size_t count)
+{
+  ReflectorLogic *session = (m_mux_channel != 0) ? m_mux_owner : this;
+  if ((session->m_udp_sock == 0) || (session->m_con == 0))
+  {
+    return;
+  }
+  session->m_udp_sock->write(session->m_con->remoteHost(),
+                             session->m_con->remotePort(), buf, count);
+} /* ReflectorLogic::udpWrite */
+
+
 void ReflectorLogic::connect(void)
 {
+  if ((m_mux_owner != 0) && (m_con == 0) && (m_mux_channel == 0))
+  {
+      // Wait for the owner to log in to find out if the reflector support
+      // shared sessions
+    if (!m_mux_owner->isLoggedIn())
+    {
+      return;
+    }
+    if (m_mux_owner->sharedSessionUsable())
+    {
+      openSharedChannel();
+      return;
+    }
+    cout << name() << ": The reflector does not support shared sessions. "
+            "Using a connection of our own." << endl;
+  }
+
   if (!isConnected())
   {
     cout << name() << ": Connecting to " << m_reflector_host << ":"
@@ -1325,6 +1983,16 @@ void ReflectorLogic::connect(void)
 
 void ReflectorLogic::disconnect(void)
 {
+  if (m_mux_channel != 0)
+  {
+    cout << name() << ": Closing the shared session" << endl;
+    m_mux_owner->closeMuxChannel(m_mux_channel);
+    m_mux_channel = 0;
+    scheduleReconnect();
+    resetSessionState();
+    return;
+  }
+
   if (m_con != 0)
   {
     if (m_con->isConnected())
@@ -1348,6 +2016,10 @@ void ReflectorLogic::reconnect(void)
 
 bool ReflectorLogic::isConnected(void) const
 {
+  if (m_mux_channel != 0)
+  {
+    return m_mux_owner->isConnected();
+  }
   return (m_con != 0) && m_con->isConnected();
 } /* ReflectorLogic::isConnected */
 
@@ -1380,6 +2052,18 @@ void ReflectorLogic::handleTimerTick(Async::Timer *t)
     }
   }
 
+  if ((m_net_stats_interval > 0) && (--m_net_stats_cnt == 0))
+  {
+    m_net_stats_cnt = m_net_stats_interval;
+    publishNetStats();
+  }
+
+    // The heartbeats of the owning logic keep a shared session alive
+  if (m_mux_channel != 0)
+  {
+    return;
+  }
+
   if (--m_udp_heartbeat_tx_cnt == 0)
   {
     sendUdpMsg(MsgUdpHeartbeat());
@@ -1390,6 +2074,16 @@ void ReflectorLogic::handleTimerTick(Async::Timer *t)
     sendMsg(MsgHeartbeat());
   }
 
+  if (--m_udp_ping_cnt == 0)
+  {
+    m_udp_ping_cnt = m_udp_ping_interval;
+    if (isLoggedIn())
+    {
+      m_link_quality.pingSent();
+    }
+    sendUdpMsg(MsgUdpPing(SvxLink::NetPathStats::timestampMs()));
+  }
+
   if (--m_udp_heartbeat_rx_cnt == 0)
   {
     cout << name() << ": UDP Heartbeat timeout" << endl;
@@ -1404,6 +2098,165 @@ void ReflectorLogic::handleTimerTick(Async::Timer *t)
 } /* ReflectorLogic::handleTimerTick */
 
 
+void ReflectorLogic::publishNetStats(void)
+{
+  if (!isLoggedIn())
+  {
+    return;
+  }
+
+  Json::Value stats(Json::objectValue);
+  stats["logic"] = name();
+  stats["rxPackets"] = Json::UInt64(m_net_stats.rxPackets());
+  stats["rxLost"] = Json::UInt64(m_net_stats.lostPackets());
+  stats["rxLate"] = Json::UInt64(m_net_stats.latePackets());
+  stats["rxJitterMs"] = m_net_stats.jitterMs();
+  if (m_net_stats.hasRtt())
+  {
+    stats["rttMs"] = m_net_stats.rttMs();
+    stats["rttMinMs"] = m_net_stats.rttMinMs();
+    stats["rttMaxMs"] = m_net_stats.rttMaxMs();
+    stats["rttAvgMs"] = m_net_stats.rttAvgMs();
+  }
+  if (m_jitter_fifo != 0)
+  {
+    Json::Value& jb = stats["jitterBuffer"];
+    jb["underruns"] = Json::UInt64(m_net_stats.jitterBufferUnderruns());
+    if (m_net_stats.hasJitterBufferFill())
+    {
+      jb["minMs"] = m_net_stats.jitterBufferMinMs();
+      jb["maxMs"] = m_net_stats.jitterBufferMaxMs();
+      jb["avgMs"] = m_net_stats.jitterBufferAvgMs();
+    }
+    if (jitterBufferIsAdaptive())
+    {
+      jb["targetMs"] = m_jb_target_delay;
+      jb["grows"] = Json::UInt64(m_jb_grow_cnt);
+    }
+    m_net_stats.resetJitterBufferFill();
+  }
+  Json::StreamWriterBuilder builder;
+  builder["commentStyle"] = "None";
+  builder["indentation"] = ""; //The JSON document is written on a single line
+  Json::StreamWriter* writer = builder.newStreamWriter();
+  std::ostringstream os;
+  writer->write(stats, &os);
+  delete writer;
+  publishStateEvent("Reflector:net_stats", os.str());
+} /* ReflectorLogic::publishNetStats */
+
+
+void ReflectorLogic::writeMetrics(Async::MetricsWriter& writer)
+{
+  Async::MetricsWriter::Labels labels(
+      Async::Metrics::labels("logic", name()));
+
+  writer.counter("svxlink_reflector_udp_rx_frames",
+      "Number of audio frames received from the reflector", labels,
+      m_net_stats.rxPackets());
+  writer.counter("svxlink_reflector_udp_tx_frames",
+      "Number of audio frames sent to the reflector", labels,
+      m_udp_audio_tx_frames);
+  writer.counter("svxlink_reflector_udp_lost_packets",
+      "Number of audio packets from the reflector lost in transit", labels,
+      m_net_stats.lostPackets());
+  writer.counter("svxlink_reflector_udp_late_packets",
+      "Number of audio packets from the reflector arriving out of order",
+      labels, m_net_stats.latePackets());
+  writer.gauge("svxlink_reflector_udp_jitter_seconds",
+      "Interarrival jitter for audio packets from the reflector", labels,
+      m_net_stats.jitterMs() / 1000.0);
+  if (m_net_stats.hasRtt())
+  {
+    writer.gauge("svxlink_reflector_rtt_seconds",
+        "The last measured round trip time to the reflector", labels,
+        m_net_stats.rttMs() / 1000.0);
+  }
+  if (m_jitter_fifo != 0)
+  {
+    writer.gauge("svxlink_reflector_jitter_buffer_seconds",
+        "Current jitter buffer fill", labels,
+        static_cast<double>(m_jitter_fifo->samplesInFifo(true)) /
+        INTERNAL_SAMPLE_RATE);
+    writer.counter("svxlink_reflector_jitter_buffer_underruns",
+        "Number of times the jitter buffer ran empty during a stream",
+        labels, m_net_stats.jitterBufferUnderruns());
+  }
+
+  if (!m_standby_links.empty())
+  {
+    writer.counter("svxlink_reflector_switches",
+        "Number of times the active reflector was switched", labels,
+        m_standby_switches);
+    for (std::vector<ReflectorStandbyLink*>::const_iterator
+           it=m_standby_links.begin(); it!=m_standby_links.end(); ++it)
+    {
+      const ReflectorStandbyLink *link = *it;
+      if (!link->quality().hasRtt())
+      {
+        continue;
+      }
+      std::ostringstream host_os;
+      host_os << link->host() << ":" << link->port();
+      Async::MetricsWriter::Labels link_labels(labels);
+      link_labels["reflector"] = host_os.str();
+      writer.gauge("svxlink_reflector_standby_rtt_seconds",
+          "Average round trip time to a standby reflector", link_labels,
+          link->quality().rttMs() / 1000.0);
+      writer.gauge("svxlink_reflector_standby_loss_ratio",
+          "Estimated ping loss towards a standby reflector", link_labels,
+          link->quality().loss());
+    }
+  }
+
+    // The time sending packets and running the receive audio pipe is not
+    // part of the codec cost. Audio leaving the decoder on a flush is not
+    // within a measured decode call so the difference is clamped at zero.
+  uint64_t enc_ns = (m_enc_cpu_ns > m_enc_send_cpu_ns)
+                    ? m_enc_cpu_ns - m_enc_send_cpu_ns : 0;
+  uint64_t dec_ns = (m_dec_cpu_ns > m_dec_downstream_cpu_ns)
+                    ? m_dec_cpu_ns - m_dec_downstream_cpu_ns : 0;
+  Async::MetricsWriter::Labels enc_labels(labels);
+  enc_labels["direction"] = "encode";
+  writer.counter("svxlink_reflector_codec_cpu_seconds",
+      "CPU time used by the audio codec", enc_labels, enc_ns / 1e9);
+  Async::MetricsWriter::Labels dec_labels(labels);
+  dec_labels["direction"] = "decode";
+  writer.counter("svxlink_reflector_codec_cpu_seconds",
+      "CPU time used by the audio codec", dec_labels, dec_ns / 1e9);
+} /* ReflectorLogic::writeMetrics */
+
+
+void ReflectorLogic::adaptJitterBuffer(bool underrun)
+{
+    // The lowest target delay that cover the measured arrival jitter
+  unsigned jitter_delay = static_cast<unsigned>(
+      JITTER_BUFFER_JITTER_FACTOR * m_net_stats.jitterMs() + 0.5);
+  unsigned target = m_jb_target_delay;
+  if (underrun)
+  {
+      // The buffer ran dry in the middle of a stream. Grow the delay right
+      // away. Setting the new level on the empty FIFO make it prebuffer again.
+    target += JITTER_BUFFER_GROW_STEP;
+    m_jb_grow_cnt += 1;
+  }
+  else if (target > JITTER_BUFFER_SHRINK_STEP)
+  {
+      // A new stream is starting. Shrinking is only done here, while the
+      // buffer is empty, so that no audio have to be thrown away.
+    target -= JITTER_BUFFER_SHRINK_STEP;
+  }
+  target = max(target, jitter_delay);
+  target = max(target, m_jb_min_delay);
+  target = min(target, m_jb_max_delay);
+  if (target != m_jb_target_delay)
+  {
+    m_jb_target_delay = target;
+    m_jitter_fifo->setPrebufSamples(target * INTERNAL_SAMPLE_RATE / 1000);
+  }
+} /* ReflectorLogic::adaptJitterBuffer */
+
+
 bool ReflectorLogic::setAudioCodec(const std::string& codec_name)
 {
   delete m_enc;
@@ -1417,8 +2270,10 @@ bool ReflectorLogic::setAudioCodec(const std::string& codec_name)
     assert(m_enc != 0);
     return false;
   }
-  m_enc->writeEncodedSamples.connect(
-      mem_fun(*this, &ReflectorLogic::sendEncodedAudio));
+  m_enc->setPacketHeadroom(
+      ReflectorUdpMsg::HEADER_SIZE + MsgUdpAudio::DATA_SIZE_LEN);
+  m_enc->writeEncodedPacket.connect(
+      mem_fun(*this, &ReflectorLogic::sendEncodedPacket));
   m_enc->flushEncodedSamples.connect(
       mem_fun(*this, &ReflectorLogic::flushEncodedAudio));
   m_enc_endpoint->registerSink(m_enc, false);
@@ -1436,6 +2291,7 @@ bool ReflectorLogic::setAudioCodec(const std::string& codec_name)
       m_enc->setOption(opt_name, opt_value);
     }
   }
+  applyServerEncOptions();
   m_enc->printCodecParams();
 
   AudioSink *sink = 0;
@@ -1480,6 +2336,24 @@ bool ReflectorLogic::setAudioCodec(const std::string& codec_name)
 } /* ReflectorLogic::setAudioCodec */
 
 
+void ReflectorLogic::applyServerEncOptions(void)
+{
+    // Options sent by the reflector server are only used if not overridden
+    // by the local configuration
+  string opt_prefix(m_enc->name());
+  opt_prefix += "_ENC_";
+  std::map<string, string>::const_iterator it;
+  for (it=m_srv_enc_options.begin(); it!=m_srv_enc_options.end(); ++it)
+  {
+    string local_value;
+    if (!cfg().getValue(name(), opt_prefix + it->first, local_value))
+    {
+      m_enc->setOption(it->first, it->second);
+    }
+  }
+} /* ReflectorLogic::applyServerEncOptions */
+
+
 bool ReflectorLogic::codecIsAvailable(const std::string &codec_name)
 {
   return AudioEncoder::isAvailable(codec_name) &&
@@ -1567,6 +2441,10 @@ void ReflectorLogic::selectTg(uint32_t tg, const std::string& event, bool unmute
 
   if (tg != m_selected_tg)
   {
+    if (m_fast_tg_switch)
+    {
+      fastTgSwitch(m_selected_tg);
+    }
     sendMsg(MsgSelectTG(tg));
     if (m_selected_tg != 0)
     {
@@ -1586,6 +2464,42 @@ void ReflectorLogic::selectTg(uint32_t tg, const std::string& event, bool unmute
 } /* ReflectorLogic::selectTg */
 
 
+void ReflectorLogic::fastTgSwitch(uint32_t old_tg)
+{
+    // The reflector end our talk on the old TG when it get the TG selection
+    // so there is no need to wait for it to acknowledge the flush
+  if (m_flush_timeout_timer.isEnabled())
+  {
+    flushTimeout();
+  }
+
+  if (!timerisset(&m_last_talker_timestamp))
+  {
+    return;
+  }
+
+    // Throw away the audio from the old TG that is still in the jitter
+    // buffer and end the stream right away instead of playing it out. The
+    // decoder state and the jitter buffer delay are kept so that the stream
+    // on the new TG start playing as soon as the current target delay has
+    // been buffered.
+  if (m_jitter_fifo != 0)
+  {
+    unsigned stale_ms =
+        m_jitter_fifo->samplesInFifo(true) * 1000 / INTERNAL_SAMPLE_RATE;
+    if (stale_ms > 0)
+    {
+      cout << name() << ": Dropping " << stale_ms
+           << "ms of buffered audio from TG #" << old_tg << endl;
+    }
+    m_jitter_fifo->clear();
+  }
+  m_net_stats.resetJitterReference();
+  m_dec->flushEncodedSamples();
+  timerclear(&m_last_talker_timestamp);
+} /* ReflectorLogic::fastTgSwitch */
+
+
 void ReflectorLogic::processEvent(const std::string& event)
 {
   m_event_handler->processEvent(name() + "::" + event);
@@ -1637,6 +2551,372 @@ void ReflectorLogic::checkTmpMonitorTimeout(void)
 } /* ReflectorLogic::checkTmpMonitorTimeout */
 
 
+bool ReflectorLogic::parseMonitorTgs(MonitorTgsSet& tgs)
+{
+  std::vector<std::string> monitor_tgs;
+  cfg().getValue(name(), "MONITOR_TGS", monitor_tgs);
+  for (std::vector<std::string>::iterator it=monitor_tgs.begin();
+       it!=monitor_tgs.end(); ++it)
+  {
+    std::istringstream is(*it);
+    MonitorTgEntry mte;
+    is >> mte.tg;
+    char modifier;
+    while (is >> modifier)
+    {
+      if (modifier == '+')
+      {
+        mte.prio += 1;
+      }
+      else
+      {
+        cerr << "*** ERROR: Illegal format for config variable MONITOR_TGS "
+             << "entry \"" << *it << "\"" << endl;
+        return false;
+      }
+    }
+    tgs.insert(mte);
+  }
+  return true;
+} /* ReflectorLogic::parseMonitorTgs */
+
+
+void ReflectorLogic::monitorTgsCfgUpdated(const std::string& value)
+{
+  MonitorTgsSet tgs;
+  if (!parseMonitorTgs(tgs))
+  {
+    return;
+  }
+
+    // Keep temporary monitors that are not configured permanently now
+  for (MonitorTgsSet::const_iterator it = m_monitor_tgs.begin();
+       it != m_monitor_tgs.end(); ++it)
+  {
+    if ((it->timeout > 0) && (tgs.count(*it) == 0))
+    {
+      tgs.insert(*it);
+    }
+  }
+  m_monitor_tgs.swap(tgs);
+
+  cout << name() << ": Setting MONITOR_TGS to " << value << endl;
+  sendMsg(MsgTgMonitor(std::set<uint32_t>(
+          m_monitor_tgs.begin(), m_monitor_tgs.end())));
+} /* ReflectorLogic::monitorTgsCfgUpdated */
+
+
+void ReflectorLogic::reportRxState(char id, const RxState& state)
+{
+    // Only receivers that have changed since the last report are sent
+  RxStateMap::const_iterator it = m_rx_state_sent.find(id);
+  if (it == m_rx_state_sent.end())
+  {
+    m_rx_state_changed = true;
+  }
+  else
+  {
+    const RxState& sent = it->second;
+    if ((state.enabled != sent.enabled) || (state.sql_open != sent.sql_open) ||
+        (state.active != sent.active))
+    {
+      m_rx_state_changed = true;
+    }
+    else if (state.siglev == sent.siglev)
+    {
+      m_rx_state_pending.erase(id);
+      return;
+    }
+  }
+  m_rx_state_pending[id] = state;
+} /* ReflectorLogic::reportRxState */
+
+
+void ReflectorLogic::scheduleRxStateReport(void)
+{
+  if (m_rx_state_pending.empty() || (m_con_state != STATE_CONNECTED))
+  {
+    return;
+  }
+
+    // Squelch and receiver state changes are sent at once. Changes in
+    // signal level only are coalesced and sent at most once per interval.
+  if (m_rx_state_changed || (m_siglev_report_timer.timeout() <= 0))
+  {
+    sendRxStateReport();
+  }
+  else if (!m_siglev_report_timer.isEnabled())
+  {
+    m_siglev_report_timer.setEnable(true);
+  }
+} /* ReflectorLogic::scheduleRxStateReport */
+
+
+void ReflectorLogic::sendRxStateReport(void)
+{
+  m_siglev_report_timer.setEnable(false);
+  if (m_rx_state_pending.empty() || (m_con_state != STATE_CONNECTED))
+  {
+    return;
+  }
+
+  MsgSignalStrengthValues msg;
+  for (RxStateMap::const_iterator it=m_rx_state_pending.begin();
+       it!=m_rx_state_pending.end(); ++it)
+  {
+    const RxState& state = it->second;
+    MsgSignalStrengthValues::Rx rx(it->first, state.siglev);
+    rx.setEnabled(state.enabled);
+    rx.setSqlOpen(state.sql_open);
+    rx.setActive(state.active);
+    msg.pushBack(rx);
+    m_rx_state_sent[it->first] = state;
+  }
+  m_rx_state_pending.clear();
+  m_rx_state_changed = false;
+  sendMsg(msg);
+} /* ReflectorLogic::sendRxStateReport */
+
+
+bool ReflectorLogic::parseStandbyHosts(void)
+{
+  std::vector<std::string> standby_hosts;
+  cfg().getValue(name(), "STANDBY_HOSTS", standby_hosts);
+  for (std::vector<std::string>::const_iterator it=standby_hosts.begin();
+       it!=standby_hosts.end(); ++it)
+  {
+    std::string host(*it);
+    uint16_t port = m_reflector_port;
+    std::string::size_type colon = host.rfind(':');
+    if (colon != std::string::npos)
+    {
+      std::istringstream is(host.substr(colon + 1));
+      if (!(is >> port) || !is.eof() || (port == 0))
+      {
+        cerr << "*** ERROR: Illegal port number in " << name()
+             << "/STANDBY_HOSTS: " << *it << endl;
+        return false;
+      }
+      host.erase(colon);
+    }
+    if (host.empty())
+    {
+      cerr << "*** ERROR: Empty host name in " << name()
+           << "/STANDBY_HOSTS" << endl;
+      return false;
+    }
+    m_standby_links.push_back(new ReflectorStandbyLink(
+          name(), host, port, m_callsign, m_auth_key));
+  }
+  if (!m_standby_links.empty())
+  {
+      // A fast ping rate on the active link is needed to detect a problem
+      // within a couple of seconds
+    m_udp_ping_interval = STANDBY_PING_INTERVAL;
+    cfg().getValue(name(), "STANDBY_SWITCH_MARGIN", m_standby_switch_margin);
+    cfg().getValue(name(), "STANDBY_SWITCH_HOLD", m_standby_switch_hold);
+  }
+  return true;
+} /* ReflectorLogic::parseStandbyHosts */
+
+
+void ReflectorLogic::checkStandbyLinks(void)
+{
+  ReflectorStandbyLink *best = 0;
+  for (std::vector<ReflectorStandbyLink*>::const_iterator
+         it=m_standby_links.begin(); it!=m_standby_links.end(); ++it)
+  {
+    ReflectorStandbyLink *link = *it;
+    if (link->isUsable(STANDBY_MAX_MISSED_PONGS) &&
+        ((best == 0) || (link->quality().score() < best->quality().score())))
+    {
+      best = link;
+    }
+  }
+  if (best == 0)
+  {
+    m_standby_better_cnt = 0;
+    return;
+  }
+
+    // Waiting for a reconnect means that the active reflector was lost
+  if (!isLoggedIn())
+  {
+    if (m_reconnect_timer.isEnabled())
+    {
+      switchReflector(best, "connection lost");
+    }
+    return;
+  }
+
+  if (m_link_quality.missedPongs() > STANDBY_MAX_MISSED_PONGS)
+  {
+    switchReflector(best, "not responding");
+    return;
+  }
+
+    // Only switch to a better reflector if it has been better for a while
+    // and no audio is passing through
+  if ((m_standby_switch_hold > 0) && m_link_quality.hasRtt() &&
+      (best->quality().score() + m_standby_switch_margin <
+       m_link_quality.score()))
+  {
+    m_standby_better_cnt += 1;
+  }
+  else
+  {
+    m_standby_better_cnt = 0;
+  }
+  if ((m_standby_better_cnt >= m_standby_switch_hold) &&
+      (m_standby_switch_hold > 0) && !timerisset(&m_last_talker_timestamp) &&
+      m_logic_con_in->isIdle())
+  {
+    switchReflector(best, "better link quality");
+  }
+} /* ReflectorLogic::checkStandbyLinks */
+
+
+void ReflectorLogic::switchReflector(ReflectorStandbyLink *link,
+                                     const char *reason)
+{
+  const std::string new_host(link->host());
+  uint16_t new_port = link->port();
+  cout << name() << ": Switching to reflector " << new_host << ":"
+       << new_port << " (" << reason << ")" << endl;
+
+  ReflectorStandbyLink::Session session;
+  link->release(session);
+
+  if (isLoggedIn())
+  {
+      // Keep the working connection as a standby link
+    m_con->connected.clear();
+    m_con->disconnected.clear();
+    m_con->frameReceived.clear();
+    m_udp_sock->dataReceived.clear();
+    ReflectorStandbyLink::Session old_session;
+    old_session.con = m_con;
+    old_session.udp_sock = m_udp_sock;
+    old_session.client_id = m_client_id;
+    old_session.next_udp_tx_seq = m_next_udp_tx_seq;
+    old_session.next_udp_rx_seq = m_next_udp_rx_seq;
+    old_session.login_frames = m_login_frames;
+    old_session.quality = m_link_quality;
+    m_con = 0;
+    m_udp_sock = 0;
+    resetSessionState();
+    link->adopt(m_reflector_host, m_reflector_port, old_session);
+  }
+  else
+  {
+    disconnect();
+    link->setReflector(m_reflector_host, m_reflector_port);
+  }
+  m_reconnect_timer.setEnable(false);
+  m_reconnect_backoff = RECONNECT_BACKOFF_START;
+
+  m_reflector_host = new_host;
+  m_reflector_port = new_port;
+  m_con = session.con;
+  m_con->connected.connect(
+      mem_fun(*this, &ReflectorLogic::onConnected));
+  m_con->disconnected.connect(
+      mem_fun(*this, &ReflectorLogic::onDisconnected));
+  m_con->frameReceived.connect(
+      mem_fun(*this, &ReflectorLogic::onFrameReceived));
+  m_udp_sock = session.udp_sock;
+  m_udp_sock->dataReceived.connect(
+      mem_fun(*this, &ReflectorLogic::udpDatagramReceived));
+  m_client_id = session.client_id;
+  m_next_udp_tx_seq = session.next_udp_tx_seq;
+  m_next_udp_rx_seq = session.next_udp_rx_seq;
+  m_link_quality = session.quality;
+  m_net_stats.reset();
+  m_udp_heartbeat_tx_cnt = UDP_HEARTBEAT_TX_CNT_RESET;
+  m_udp_heartbeat_rx_cnt = UDP_HEARTBEAT_RX_CNT_RESET;
+  m_tcp_heartbeat_tx_cnt = TCP_HEARTBEAT_TX_CNT_RESET;
+  m_tcp_heartbeat_rx_cnt = TCP_HEARTBEAT_RX_CNT_RESET;
+  m_udp_ping_cnt = m_udp_ping_interval;
+  m_net_stats_cnt = m_net_stats_interval;
+  m_session_token.clear();
+  m_session_resume_sent = false;
+  m_heartbeat_timer.setEnable(true);
+  m_standby_switches += 1;
+
+    // Replaying the login messages select the codec and the talk groups
+    // just like after a normal login
+  m_con_state = STATE_EXPECT_SERVER_INFO;
+  for (std::vector<std::vector<uint8_t> >::iterator
+         it=session.login_frames.begin();
+       (it!=session.login_frames.end()) && (m_con != 0); ++it)
+  {
+    onFrameReceived(m_con, *it);
+  }
+} /* ReflectorLogic::switchReflector */
+
+
+bool ReflectorLogic::sharedSessionUsable(void) const
+{
+  return isLoggedIn() && (m_proto_minor_ver >= SHARED_SESSION_MINOR_VER);
+} /* ReflectorLogic::sharedSessionUsable */
+
+
+void ReflectorLogic::openSharedChannel(void)
+{
+  m_reconnect_timer.setEnable(false);
+  m_mux_channel = m_mux_owner->openMuxChannel(this);
+  cout << name() << ": Logging in using the connection of "
+       << m_mux_owner->name() << endl;
+  beginLogin();
+} /* ReflectorLogic::openSharedChannel */
+
+
+uint16_t ReflectorLogic::openMuxChannel(ReflectorLogic *member)
+{
+    // A channel number is not reused right away so that a late message for
+    // a closed channel is not mistaken for a message to a new one
+  do
+  {
+    if (++m_next_mux_channel == 0)
+    {
+      m_next_mux_channel = 1;
+    }
+  } while (m_mux_channels.find(m_next_mux_channel) != m_mux_channels.end());
+  m_mux_channels[m_next_mux_channel] = member;
+  m_con->setMaxFrameSize(MsgMuxFrame::MAX_FRAME_SIZE);
+  return m_next_mux_channel;
+} /* ReflectorLogic::openMuxChannel */
+
+
+void ReflectorLogic::closeMuxChannel(uint16_t channel)
+{
+  if (m_mux_channels.erase(channel) > 0)
+  {
+    sendMsg(MsgMuxFrame(channel));
+  }
+} /* ReflectorLogic::closeMuxChannel */
+
+
+void ReflectorLogic::sharedSessionUp(void)
+{
+  if ((m_con == 0) && (m_mux_channel == 0))
+  {
+    connect();
+  }
+} /* ReflectorLogic::sharedSessionUp */
+
+
+void ReflectorLogic::sharedChannelClosed(void)
+{
+  cout << name() << ": Disconnected from the shared session of "
+       << m_mux_owner->name() << endl;
+  m_mux_channel = 0;
+  scheduleReconnect();
+  resetSessionState();
+} /* ReflectorLogic::sharedChannelClosed */
+
+
+
 /*
  * This file has not been truncated
  */
@@ -36,6 +36,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <sys/time.h>
 #include <string>
+#include <map>
+#include <vector>
+#include <random>
 #include <json/json.h>
 
 
@@ -52,6 +55,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncTimer.h>
 #include <AsyncAudioFifo.h>
 #include <AsyncAudioStreamStateDetector.h>
+#include <NetPathStats.h>
 
 
 /****************************************************************************
@@ -61,6 +65,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "LogicBase.h"
+#include "ReflectorStandbyLink.h"
 
 
 /****************************************************************************
@@ -73,6 +78,8 @@ namespace Async
 {
   class UdpSocket;
   class AudioValve;
+  class MetricsWriter;
+  class Msg;
 };
 
 class ReflectorMsg;
@@ -204,12 +211,40 @@ class ReflectorLogic : public LogicBase
     typedef Async::TcpClient<Async::FramedTcpConnection> FramedTcpClient;
     typedef std::set<MonitorTgEntry> MonitorTgsSet;
 
+    struct RxState
+    {
+      uint8_t siglev;
+      bool    enabled;
+      bool    sql_open;
+      bool    active;
+    };
+    typedef std::map<char, RxState> RxStateMap;
+    typedef std::map<std::string, ReflectorLogic*> SharedSessionMap;
+    typedef std::map<uint16_t, ReflectorLogic*> MuxChannelMap;
+
     static const unsigned UDP_HEARTBEAT_TX_CNT_RESET  = 15;
     static const unsigned UDP_HEARTBEAT_RX_CNT_RESET  = 60;
     static const unsigned TCP_HEARTBEAT_TX_CNT_RESET  = 10;
     static const unsigned TCP_HEARTBEAT_RX_CNT_RESET  = 15;
     static const unsigned DEFAULT_TG_SELECT_TIMEOUT   = 30;
     static const int      DEFAULT_TMP_MONITOR_TIMEOUT = 3600;
+    static const unsigned UDP_PING_CNT_RESET          = 10;
+    static const unsigned RECONNECT_MIN_DELAY         = 1000;
+    static const unsigned RECONNECT_BACKOFF_START     = 5000;
+    static const unsigned RECONNECT_BACKOFF_MAX       = 120000;
+    static const unsigned DEFAULT_NET_STATS_INTERVAL  = 60;
+    static const unsigned DEFAULT_SIGLEV_REPORT_INTERVAL = 250;
+    static const unsigned JITTER_BUFFER_JITTER_FACTOR = 4;
+    static const unsigned JITTER_BUFFER_GROW_STEP     = 20;
+    static const unsigned JITTER_BUFFER_SHRINK_STEP   = 5;
+    static const unsigned STANDBY_PING_INTERVAL       = 1;
+    static const unsigned STANDBY_MAX_MISSED_PONGS    = 3;
+    static const unsigned DEFAULT_STANDBY_SWITCH_MARGIN = 50;
+    static const unsigned DEFAULT_STANDBY_SWITCH_HOLD = 10;
+    static const uint16_t SHARED_SESSION_MINOR_VER    = 2;
+
+      // The logics with SHARE_SESSION set, keyed on reflector host and port
+    static SharedSessionMap           shared_sessions;
 
     std::string                       m_reflector_host;
     uint16_t                          m_reflector_port;
@@ -222,6 +257,8 @@ class ReflectorLogic : public LogicBase
     Async::AudioStreamStateDetector*  m_logic_con_in;
     Async::AudioStreamStateDetector*  m_logic_con_out;
     Async::Timer                      m_reconnect_timer;
+    unsigned                          m_reconnect_backoff;
+    std::minstd_rand                  m_reconnect_rng;
     uint16_t                          m_next_udp_tx_seq;
     uint16_t                          m_next_udp_rx_seq;
     Async::Timer                      m_heartbeat_timer;
@@ -253,10 +290,50 @@ class ReflectorLogic : public LogicBase
     bool                              m_mute_first_tx_rem;
     Async::Timer                      m_tmp_monitor_timer;
     int                               m_tmp_monitor_timeout;
+    std::map<std::string, std::string> m_srv_enc_options;
+    Async::AudioFifo*                 m_jitter_fifo;
+    bool                              m_fast_tg_switch;
+    SvxLink::NetPathStats             m_net_stats;
+    unsigned                          m_udp_ping_cnt;
+    unsigned                          m_udp_ping_interval;
+    unsigned                          m_net_stats_interval;
+    unsigned                          m_net_stats_cnt;
+    unsigned                          m_jb_min_delay;
+    unsigned                          m_jb_max_delay;
+    unsigned                          m_jb_target_delay;
+    uint64_t                          m_jb_grow_cnt;
+    uint64_t                          m_udp_audio_tx_frames;
+    uint64_t                          m_enc_cpu_ns;
+    uint64_t                          m_enc_send_cpu_ns;
+    uint64_t                          m_dec_cpu_ns;
+    uint64_t                          m_dec_downstream_cpu_ns;
+    uint64_t                          m_tx_latency_mark;
+    Async::Timer                      m_siglev_report_timer;
+    RxStateMap                        m_rx_state_sent;
+    RxStateMap                        m_rx_state_pending;
+    bool                              m_rx_state_changed;
+    std::string                       m_session_token;
+    bool                              m_session_resume_sent;
+    std::vector<ReflectorStandbyLink*> m_standby_links;
+    ReflectorLinkQuality              m_link_quality;
+    std::vector<std::vector<uint8_t>> m_login_frames;
+    Async::Timer                      m_standby_timer;
+    unsigned                          m_standby_switch_margin;
+    unsigned                          m_standby_switch_hold;
+    unsigned                          m_standby_better_cnt;
+    uint64_t                          m_standby_switches;
+    uint16_t                          m_proto_minor_ver;
+    ReflectorLogic*                   m_mux_owner;
+    uint16_t                          m_mux_channel;
+    std::vector<ReflectorLogic*>      m_mux_members;
+    MuxChannelMap                     m_mux_channels;
+    uint16_t                          m_next_mux_channel;
 
     ReflectorLogic(const ReflectorLogic&);
     ReflectorLogic& operator=(const ReflectorLogic&);
     void onConnected(void);
+    void beginLogin(void);
+    void scheduleReconnect(void);
     void onDisconnected(Async::TcpConnection *con,
                         Async::TcpConnection::DisconnectReason reason);
     void onFrameReceived(Async::FramedTcpConnection *con,
@@ -270,14 +347,34 @@ class ReflectorLogic : public LogicBase
     void handleMsgTalkerStart(std::istream& is);
     void handleMsgTalkerStop(std::istream& is);
     void handleMsgRequestQsy(std::istream& is);
+    void handleMsgEventBatch(std::istream& is);
+    void handleMsgSessionToken(std::istream& is);
+    void handleMsgMuxFrame(std::istream& is);
+    void nodeJoined(const std::string& callsign);
+    void nodeLeft(const std::string& callsign);
+    void talkerStart(uint32_t tg, const std::string& callsign);
+    void talkerStop(uint32_t tg, const std::string& callsign);
     void handleMsgAuthOk(void);
     void handleMsgServerInfo(std::istream& is);
+    void handleMsgCodecOptions(std::istream& is);
     void sendMsg(const ReflectorMsg& msg);
     void sendEncodedAudio(const void *buf, int count);
+    void sendEncodedPacket(Async::AudioEncoder::Packet& packet);
     void flushEncodedAudio(void);
     void udpDatagramReceived(const Async::IpAddress& addr, uint16_t port,
                              void *buf, int count);
-    void sendUdpMsg(const ReflectorUdpMsg& msg);
+    void handleUdpMsg(const ReflectorUdpMsg& header, std::istream& is,
+                      bool check_seq);
+    void handleMsgUdpMuxDelivery(const ReflectorUdpMsg& header,
+                                 std::istream& is);
+    ReflectorLogic* udpMsgReceiver(uint32_t client_id);
+    void sendUdpMsg(const ReflectorUdpMsg& msg, const Async::Msg *ext=0);
+    Async::UdpSocket* udpSocket(void) const
+    {
+      return (m_mux_channel != 0) ? m_mux_owner->m_udp_sock : m_udp_sock;
+    }
+    void udpWrite(const void *buf, size_t count);
+    void writeMetrics(Async::MetricsWriter& writer);
     void connect(void);
     void disconnect(void);
     void reconnect(void);
@@ -286,15 +383,35 @@ class ReflectorLogic : public LogicBase
     void allEncodedSamplesFlushed(void);
     void flushTimeout(Async::Timer *t=0);
     void handleTimerTick(Async::Timer *t);
+    void publishNetStats(void);
+    bool jitterBufferIsAdaptive(void) const { return m_jb_max_delay > 0; }
+    void adaptJitterBuffer(bool underrun);
     bool setAudioCodec(const std::string& codec_name);
+    void applyServerEncOptions(void);
     bool codecIsAvailable(const std::string &codec_name);
     void tgSelectTimerExpired(void);
     void onLogicConInStreamStateChanged(bool is_active, bool is_idle);
     void onLogicConOutStreamStateChanged(bool is_active, bool is_idle);
     void selectTg(uint32_t tg, const std::string& event, bool unmute);
+    void fastTgSwitch(uint32_t old_tg);
     void processEvent(const std::string& event);
     void processTgSelectionEvent(void);
     void checkTmpMonitorTimeout(void);
+    bool parseMonitorTgs(MonitorTgsSet& tgs);
+    void monitorTgsCfgUpdated(const std::string& value);
+    void reportRxState(char id, const RxState& state);
+    void scheduleRxStateReport(void);
+    void sendRxStateReport(void);
+    bool parseStandbyHosts(void);
+    void resetSessionState(void);
+    void checkStandbyLinks(void);
+    void switchReflector(ReflectorStandbyLink *link, const char *reason);
+    bool sharedSessionUsable(void) const;
+    void openSharedChannel(void);
+    uint16_t openMuxChannel(ReflectorLogic *member);
+    void closeMuxChannel(uint16_t channel);
+    void sharedSessionUp(void);
+    void sharedChannelClosed(void);
 
 };  /* class ReflectorLogic */
 
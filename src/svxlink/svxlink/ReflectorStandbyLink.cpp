@@ -0,0 +1,568 @@
+/**
+@file	 ReflectorStandbyLink.cpp
+@brief   A logged in standby connection to an alternative SvxReflector
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sstream>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncUdpSocket.h>
+#include <NetPathStats.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "ReflectorStandbyLink.h"
+#include "../reflector/ReflectorMsg.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+void ReflectorLinkQuality::reset(void)
+{
+  m_missed = 0;
+  m_has_rtt = false;
+  m_rtt_ms = 0.0;
+  m_loss = 0.0;
+} /* ReflectorLinkQuality::reset */
+
+
+void ReflectorLinkQuality::pingSent(void)
+{
+  if (m_missed > 0)
+  {
+    m_loss += AVG_ALPHA * (1.0 - m_loss);
+  }
+  m_missed += 1;
+} /* ReflectorLinkQuality::pingSent */
+
+
+void ReflectorLinkQuality::pongReceived(uint32_t timestamp)
+{
+  uint32_t rtt = SvxLink::NetPathStats::timestampMs() - timestamp;
+  if (m_has_rtt)
+  {
+    m_rtt_ms += AVG_ALPHA * (rtt - m_rtt_ms);
+  }
+  else
+  {
+    m_rtt_ms = rtt;
+    m_has_rtt = true;
+  }
+  if (m_missed > 0)
+  {
+    m_loss -= AVG_ALPHA * m_loss;
+    m_missed = 0;
+  }
+} /* ReflectorLinkQuality::pongReceived */
+
+
+bool ReflectorStandbyLink::isLoginFrame(unsigned type)
+{
+  return (type == MsgServerInfo::TYPE) || (type == MsgCodecOptions::TYPE) ||
+         (type == MsgSessionToken::TYPE);
+} /* ReflectorStandbyLink::isLoginFrame */
+
+
+ReflectorStandbyLink::ReflectorStandbyLink(const std::string& logic_name,
+                                           const std::string& host,
+                                           uint16_t port,
+                                           const std::string& callsign,
+                                           const std::string& auth_key)
+  : m_logic_name(logic_name), m_host(host), m_port(port),
+    m_callsign(callsign), m_auth_key(auth_key), m_state(STATE_IDLE),
+    m_reconnect_timer(RECONNECT_MIN_DELAY, Timer::TYPE_ONESHOT, false),
+    m_reconnect_backoff(RECONNECT_BACKOFF_START),
+    m_reconnect_rng(std::random_device()()),
+    m_heartbeat_timer(1000, Timer::TYPE_PERIODIC, false),
+    m_udp_heartbeat_rx_cnt(0), m_tcp_heartbeat_tx_cnt(0),
+    m_tcp_heartbeat_rx_cnt(0)
+{
+  m_reconnect_timer.expired.connect(
+      sigc::hide(mem_fun(*this, &ReflectorStandbyLink::reconnect)));
+  m_heartbeat_timer.expired.connect(
+      mem_fun(*this, &ReflectorStandbyLink::handleTimerTick));
+} /* ReflectorStandbyLink::ReflectorStandbyLink */
+
+
+ReflectorStandbyLink::~ReflectorStandbyLink(void)
+{
+  disconnect();
+} /* ReflectorStandbyLink::~ReflectorStandbyLink */
+
+
+void ReflectorStandbyLink::connect(void)
+{
+  if (m_session.con != 0)
+  {
+    return;
+  }
+  cout << name() << ": Connecting standby link" << endl;
+  m_reconnect_timer.setEnable(false);
+  m_session.con = new FramedTcpClient(m_host, m_port);
+  attach();
+  m_state = STATE_CONNECTING;
+  m_session.con->connect();
+} /* ReflectorStandbyLink::connect */
+
+
+void ReflectorStandbyLink::setReflector(const std::string& host,
+                                        uint16_t port)
+{
+  disconnect();
+  m_host = host;
+  m_port = port;
+  m_reconnect_backoff = RECONNECT_BACKOFF_START;
+  scheduleReconnect();
+} /* ReflectorStandbyLink::setReflector */
+
+
+bool ReflectorStandbyLink::isUsable(unsigned max_missed) const
+{
+  return (m_state == STATE_READY) && m_session.quality.hasRtt() &&
+         (m_session.quality.missedPongs() <= max_missed);
+} /* ReflectorStandbyLink::isUsable */
+
+
+void ReflectorStandbyLink::release(Session& session)
+{
+  detach();
+  m_heartbeat_timer.setEnable(false);
+  m_reconnect_timer.setEnable(false);
+  session = m_session;
+  m_session = Session();
+  m_state = STATE_IDLE;
+} /* ReflectorStandbyLink::release */
+
+
+void ReflectorStandbyLink::adopt(const std::string& host, uint16_t port,
+                                 Session& session)
+{
+  disconnect();
+  m_host = host;
+  m_port = port;
+  m_session = session;
+  session = Session();
+  attach();
+  m_state = STATE_READY;
+  m_reconnect_backoff = RECONNECT_BACKOFF_START;
+  m_udp_heartbeat_rx_cnt = UDP_HEARTBEAT_RX_CNT_RESET;
+  m_tcp_heartbeat_tx_cnt = TCP_HEARTBEAT_TX_CNT_RESET;
+  m_tcp_heartbeat_rx_cnt = TCP_HEARTBEAT_RX_CNT_RESET;
+  m_heartbeat_timer.setEnable(true);
+
+    // Leave all talk groups so that the reflector stop sending audio
+  sendMsg(MsgSelectTG(0));
+  sendMsg(MsgTgMonitor(std::set<uint32_t>()));
+  cout << name() << ": Now on standby" << endl;
+} /* ReflectorStandbyLink::adopt */
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+std::string ReflectorStandbyLink::name(void) const
+{
+  ostringstream ss;
+  ss << m_logic_name << "[" << m_host << ":" << m_port << "]";
+  return ss.str();
+} /* ReflectorStandbyLink::name */
+
+
+void ReflectorStandbyLink::attach(void)
+{
+  if (m_session.con != 0)
+  {
+    m_session.con->connected.connect(
+        mem_fun(*this, &ReflectorStandbyLink::onConnected));
+    m_session.con->disconnected.connect(
+        mem_fun(*this, &ReflectorStandbyLink::onDisconnected));
+    m_session.con->frameReceived.connect(
+        mem_fun(*this, &ReflectorStandbyLink::onFrameReceived));
+  }
+  if (m_session.udp_sock != 0)
+  {
+    m_session.udp_sock->dataReceived.connect(
+        mem_fun(*this, &ReflectorStandbyLink::udpDatagramReceived));
+  }
+} /* ReflectorStandbyLink::attach */
+
+
+void ReflectorStandbyLink::detach(void)
+{
+  if (m_session.con != 0)
+  {
+    m_session.con->connected.clear();
+    m_session.con->disconnected.clear();
+    m_session.con->frameReceived.clear();
+  }
+  if (m_session.udp_sock != 0)
+  {
+    m_session.udp_sock->dataReceived.clear();
+  }
+} /* ReflectorStandbyLink::detach */
+
+
+void ReflectorStandbyLink::disconnect(void)
+{
+  m_heartbeat_timer.setEnable(false);
+  m_reconnect_timer.setEnable(false);
+  detach();
+  delete m_session.udp_sock;
+  delete m_session.con;
+  m_session = Session();
+  m_state = STATE_IDLE;
+} /* ReflectorStandbyLink::disconnect */
+
+
+void ReflectorStandbyLink::reconnect(void)
+{
+    // The connection object cannot be deleted from within its own signal
+    // handlers so a failed connection is cleaned up here
+  disconnect();
+  connect();
+} /* ReflectorStandbyLink::reconnect */
+
+
+void ReflectorStandbyLink::scheduleReconnect(void)
+{
+    // Use the same randomized exponential backoff as the ReflectorLogic
+  m_reconnect_timer.setTimeout(
+      RECONNECT_MIN_DELAY + m_reconnect_rng() % m_reconnect_backoff);
+  m_reconnect_timer.setEnable(true);
+  m_reconnect_backoff *= 2;
+  if (m_reconnect_backoff > RECONNECT_BACKOFF_MAX)
+  {
+    m_reconnect_backoff = RECONNECT_BACKOFF_MAX;
+  }
+} /* ReflectorStandbyLink::scheduleReconnect */
+
+
+void ReflectorStandbyLink::onConnected(void)
+{
+  m_state = STATE_EXPECT_AUTH_CHALLENGE;
+  m_session.con->setMaxFrameSize(ReflectorMsg::MAX_PREAUTH_FRAME_SIZE);
+  m_tcp_heartbeat_tx_cnt = TCP_HEARTBEAT_TX_CNT_RESET;
+  m_tcp_heartbeat_rx_cnt = TCP_HEARTBEAT_RX_CNT_RESET;
+  m_udp_heartbeat_rx_cnt = UDP_HEARTBEAT_RX_CNT_RESET;
+  m_heartbeat_timer.setEnable(true);
+  sendMsg(MsgProtoVer());
+} /* ReflectorStandbyLink::onConnected */
+
+
+void ReflectorStandbyLink::onDisconnected(TcpConnection *con,
+                                          TcpConnection::DisconnectReason reason)
+{
+  cout << name() << ": Standby link disconnected: "
+       << TcpConnection::disconnectReasonStr(reason) << endl;
+  m_heartbeat_timer.setEnable(false);
+  delete m_session.udp_sock;
+  m_session.udp_sock = 0;
+  m_session.login_frames.clear();
+  m_session.quality.reset();
+  m_state = STATE_IDLE;
+  scheduleReconnect();
+} /* ReflectorStandbyLink::onDisconnected */
+
+
+void ReflectorStandbyLink::onFrameReceived(FramedTcpConnection *con,
+                                           std::vector<uint8_t>& data)
+{
+  stringstream ss;
+  ss.write(reinterpret_cast<const char*>(&data.front()), data.size());
+
+  ReflectorMsg header;
+  if (!header.unpack(ss))
+  {
+    cerr << "*** ERROR[" << name()
+         << "]: Unpacking failed for TCP message header\n";
+    m_session.con->disconnect();
+    onDisconnected(m_session.con, TcpConnection::DR_PROTOCOL_ERROR);
+    return;
+  }
+
+  m_tcp_heartbeat_rx_cnt = TCP_HEARTBEAT_RX_CNT_RESET;
+
+  if (isLoginFrame(header.type()))
+  {
+    if (header.type() == MsgServerInfo::TYPE)
+    {
+      m_session.login_frames.clear();
+    }
+    m_session.login_frames.push_back(data);
+  }
+
+  switch (header.type())
+  {
+    case MsgError::TYPE:
+    {
+      MsgError msg;
+      if (msg.unpack(ss))
+      {
+        cout << name() << ": Error message received from server: "
+             << msg.message() << endl;
+      }
+      m_session.con->disconnect();
+      onDisconnected(m_session.con, TcpConnection::DR_ORDERED_DISCONNECT);
+      break;
+    }
+    case MsgProtoVerDowngrade::TYPE:
+    {
+      MsgProtoVerDowngrade msg;
+      if (msg.unpack(ss) && (msg.majorVer() == MsgProtoVer::MAJOR) &&
+          (msg.minorVer() < MsgProtoVer::MINOR))
+      {
+        sendMsg(MsgProtoVer(msg.majorVer(), msg.minorVer()));
+        break;
+      }
+      cerr << "*** ERROR[" << name() << "]: Unsupported protocol version\n";
+      m_session.con->disconnect();
+      onDisconnected(m_session.con, TcpConnection::DR_PROTOCOL_ERROR);
+      break;
+    }
+    case MsgAuthChallenge::TYPE:
+      handleMsgAuthChallenge(ss);
+      break;
+    case MsgAuthOk::TYPE:
+      if (m_state == STATE_EXPECT_AUTH_OK)
+      {
+        m_state = STATE_EXPECT_SERVER_INFO;
+        m_session.con->setMaxFrameSize(ReflectorMsg::MAX_POSTAUTH_FRAME_SIZE);
+      }
+      break;
+    case MsgServerInfo::TYPE:
+      handleMsgServerInfo(ss);
+      break;
+    default:
+      // Node lists and talker events are of no interest to a standby link
+      break;
+  }
+} /* ReflectorStandbyLink::onFrameReceived */
+
+
+void ReflectorStandbyLink::handleMsgAuthChallenge(std::istream& is)
+{
+  MsgAuthChallenge msg;
+  if ((m_state != STATE_EXPECT_AUTH_CHALLENGE) || !msg.unpack(is) ||
+      (msg.challenge() == 0))
+  {
+    cerr << "*** ERROR[" << name() << "]: Unexpected MsgAuthChallenge\n";
+    m_session.con->disconnect();
+    onDisconnected(m_session.con, TcpConnection::DR_PROTOCOL_ERROR);
+    return;
+  }
+  sendMsg(MsgAuthResponse(m_callsign, m_auth_key, msg.challenge()));
+  m_state = STATE_EXPECT_AUTH_OK;
+} /* ReflectorStandbyLink::handleMsgAuthChallenge */
+
+
+void ReflectorStandbyLink::handleMsgServerInfo(std::istream& is)
+{
+  MsgServerInfo msg;
+  if ((m_state != STATE_EXPECT_SERVER_INFO) || !msg.unpack(is))
+  {
+    cerr << "*** ERROR[" << name() << "]: Unexpected MsgServerInfo\n";
+    m_session.con->disconnect();
+    onDisconnected(m_session.con, TcpConnection::DR_PROTOCOL_ERROR);
+    return;
+  }
+  m_session.client_id = msg.clientId();
+  m_session.next_udp_tx_seq = 0;
+  m_session.next_udp_rx_seq = 0;
+  m_session.quality.reset();
+  delete m_session.udp_sock;
+  m_session.udp_sock = new UdpSocket;
+  m_session.udp_sock->dataReceived.connect(
+      mem_fun(*this, &ReflectorStandbyLink::udpDatagramReceived));
+  m_state = STATE_READY;
+  m_reconnect_backoff = RECONNECT_BACKOFF_START;
+  cout << name() << ": Standby link logged in" << endl;
+
+    // Let the reflector learn our UDP port
+  sendUdpMsg(MsgUdpHeartbeat());
+} /* ReflectorStandbyLink::handleMsgServerInfo */
+
+
+void ReflectorStandbyLink::udpDatagramReceived(const IpAddress& addr,
+                                               uint16_t port,
+                                               void *buf, int count)
+{
+  if ((m_state != STATE_READY) || (addr != m_session.con->remoteHost()) ||
+      (port != m_session.con->remotePort()))
+  {
+    return;
+  }
+
+  stringstream ss;
+  ss.write(reinterpret_cast<const char *>(buf), count);
+
+  ReflectorUdpMsg header;
+  if (!header.unpack(ss) || (header.clientId() != m_session.client_id))
+  {
+    return;
+  }
+  m_session.next_udp_rx_seq = header.sequenceNum() + 1;
+  m_udp_heartbeat_rx_cnt = UDP_HEARTBEAT_RX_CNT_RESET;
+
+  switch (header.type())
+  {
+    case MsgUdpPing::TYPE:
+    {
+      MsgUdpPing msg;
+      if (msg.unpack(ss))
+      {
+        sendUdpMsg(MsgUdpPong(msg.timestamp()));
+      }
+      break;
+    }
+
+    case MsgUdpPong::TYPE:
+    {
+      MsgUdpPong msg;
+      if (msg.unpack(ss))
+      {
+        m_session.quality.pongReceived(msg.timestamp());
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+} /* ReflectorStandbyLink::udpDatagramReceived */
+
+
+void ReflectorStandbyLink::sendMsg(const ReflectorMsg& msg)
+{
+  if ((m_session.con == 0) || !m_session.con->isConnected())
+  {
+    return;
+  }
+  ostringstream ss;
+  ReflectorMsg header(msg.type());
+  if (!header.pack(ss) || !msg.pack(ss))
+  {
+    cerr << "*** ERROR[" << name()
+         << "]: Failed to pack reflector TCP message\n";
+    return;
+  }
+  m_session.con->write(ss.str().data(), ss.str().size());
+} /* ReflectorStandbyLink::sendMsg */
+
+
+void ReflectorStandbyLink::sendUdpMsg(const ReflectorUdpMsg& msg)
+{
+  if ((m_state != STATE_READY) || (m_session.udp_sock == 0))
+  {
+    return;
+  }
+  ReflectorUdpMsg header(msg.type(), m_session.client_id,
+                         m_session.next_udp_tx_seq++);
+  ostringstream ss;
+  if (!header.pack(ss) || !msg.pack(ss))
+  {
+    cerr << "*** ERROR[" << name()
+         << "]: Failed to pack reflector UDP message\n";
+    return;
+  }
+  m_session.udp_sock->write(m_session.con->remoteHost(),
+                            m_session.con->remotePort(),
+                            ss.str().data(), ss.str().size());
+} /* ReflectorStandbyLink::sendUdpMsg */
+
+
+void ReflectorStandbyLink::handleTimerTick(Async::Timer *t)
+{
+  if (--m_tcp_heartbeat_tx_cnt == 0)
+  {
+    m_tcp_heartbeat_tx_cnt = TCP_HEARTBEAT_TX_CNT_RESET;
+    sendMsg(MsgHeartbeat());
+  }
+
+  if (m_state == STATE_READY)
+  {
+      // The ping also act as UDP heartbeat towards the reflector
+    m_session.quality.pingSent();
+    sendUdpMsg(MsgUdpPing(SvxLink::NetPathStats::timestampMs()));
+
+    if (--m_udp_heartbeat_rx_cnt == 0)
+    {
+      cout << name() << ": UDP Heartbeat timeout" << endl;
+      m_session.con->disconnect();
+      onDisconnected(m_session.con, TcpConnection::DR_ORDERED_DISCONNECT);
+      return;
+    }
+  }
+
+  if (--m_tcp_heartbeat_rx_cnt == 0)
+  {
+    cout << name() << ": Heartbeat timeout" << endl;
+    m_session.con->disconnect();
+    onDisconnected(m_session.con, TcpConnection::DR_ORDERED_DISCONNECT);
+  }
+} /* ReflectorStandbyLink::handleTimerTick */
+
+
+
+/*
+ * This file has not been truncated
+ */
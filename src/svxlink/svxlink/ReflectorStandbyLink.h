@@ -0,0 +1,323 @@
+/**
+@file	 ReflectorStandbyLink.h
+@brief   A logged in standby connection to an alternative SvxReflector
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef REFLECTOR_STANDBY_LINK_INCLUDED
+#define REFLECTOR_STANDBY_LINK_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <random>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncTcpClient.h>
+#include <AsyncFramedTcpConnection.h>
+#include <AsyncTimer.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class UdpSocket;
+  class IpAddress;
+};
+
+class ReflectorMsg;
+class ReflectorUdpMsg;
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Track the quality of a reflector link using UDP ping round trips
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+The RTT is a moving average of the measured ping round trip times. A ping
+that is not answered before the next one is sent count as lost. The score
+combine the two so that links can be compared. Lower is better.
+*/
+class ReflectorLinkQuality
+{
+  public:
+    /**
+     * @brief   Forget all measurements
+     */
+    void reset(void);
+
+    /**
+     * @brief   Call this when a ping is sent
+     */
+    void pingSent(void);
+
+    /**
+     * @brief   Call this when a pong is received
+     * @param   timestamp The timestamp echoed back in the pong
+     */
+    void pongReceived(uint32_t timestamp);
+
+    /**
+     * @brief   The number of pings sent since the last pong was received
+     */
+    unsigned missedPongs(void) const { return m_missed; }
+
+    /**
+     * @brief   Check if at least one round trip have been measured
+     */
+    bool hasRtt(void) const { return m_has_rtt; }
+
+    /**
+     * @brief   The average round trip time in milliseconds
+     */
+    double rttMs(void) const { return m_rtt_ms; }
+
+    /**
+     * @brief   The estimated ping loss ratio, 0.0 to 1.0
+     */
+    double loss(void) const { return m_loss; }
+
+    /**
+     * @brief   A combined link cost in milliseconds, lower is better
+     */
+    double score(void) const { return m_rtt_ms + LOSS_PENALTY_MS * m_loss; }
+
+  private:
+    static constexpr double AVG_ALPHA       = 0.1;
+    static constexpr double LOSS_PENALTY_MS = 1000.0;
+
+    unsigned  m_missed  = 0;
+    bool      m_has_rtt = false;
+    double    m_rtt_ms  = 0.0;
+    double    m_loss    = 0.0;
+
+};  /* class ReflectorLinkQuality */
+
+
+/**
+@brief  A logged in standby connection to an alternative SvxReflector
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+A standby link logs in to a reflector using the same credentials as the
+ReflectorLogic but never select a talk group, so no audio is received. TCP
+and UDP heartbeats are kept up and the link quality is measured using a UDP
+ping every second. When the ReflectorLogic switch to this reflector the
+logged in connection is released to the logic, together with the login
+messages that it need to replay. The logic may hand a logged in connection
+back using adopt() when it switch away from a working reflector.
+*/
+class ReflectorStandbyLink : public sigc::trackable
+{
+  public:
+    typedef Async::TcpClient<Async::FramedTcpConnection> FramedTcpClient;
+
+    /**
+     * @brief   A logged in reflector session that is handed between owners
+     */
+    struct Session
+    {
+      FramedTcpClient*                  con = 0;
+      Async::UdpSocket*                 udp_sock = 0;
+      uint32_t                          client_id = 0;
+      uint16_t                          next_udp_tx_seq = 0;
+      uint16_t                          next_udp_rx_seq = 0;
+      std::vector<std::vector<uint8_t>> login_frames;
+      ReflectorLinkQuality              quality;
+    };
+
+    /**
+     * @brief   Check if a frame must be kept for a later login replay
+     * @param   type The message type of the frame
+     */
+    static bool isLoginFrame(unsigned type);
+
+    /**
+     * @brief   Constructor
+     * @param   logic_name  The name of the owning logic, used for printouts
+     * @param   host        The reflector host
+     * @param   port        The reflector port
+     * @param   callsign    The callsign to log in with
+     * @param   auth_key    The authentication key to log in with
+     */
+    ReflectorStandbyLink(const std::string& logic_name,
+                         const std::string& host, uint16_t port,
+                         const std::string& callsign,
+                         const std::string& auth_key);
+
+    /**
+     * @brief   Destructor
+     */
+    ~ReflectorStandbyLink(void);
+
+    /**
+     * @brief   Start connecting to the reflector
+     */
+    void connect(void);
+
+    /**
+     * @brief   Change reflector, drop the current connection if any
+     * @param   host The new reflector host
+     * @param   port The new reflector port
+     *
+     * A new connection attempt is made after a short delay.
+     */
+    void setReflector(const std::string& host, uint16_t port);
+
+    /**
+     * @brief   The reflector host this link connect to
+     */
+    const std::string& host(void) const { return m_host; }
+
+    /**
+     * @brief   The reflector port this link connect to
+     */
+    uint16_t port(void) const { return m_port; }
+
+    /**
+     * @brief   Check if the link is logged in and answer pings
+     * @param   max_missed The maximum number of unanswered pings
+     */
+    bool isUsable(unsigned max_missed) const;
+
+    /**
+     * @brief   The measured link quality
+     */
+    const ReflectorLinkQuality& quality(void) const
+    {
+      return m_session.quality;
+    }
+
+    /**
+     * @brief   Hand the logged in session over to a new owner
+     * @param   session Filled in with the session data
+     *
+     * After this call the link is idle until connect(), setReflector() or
+     * adopt() is called.
+     */
+    void release(Session& session);
+
+    /**
+     * @brief   Take over a logged in session
+     * @param   host    The reflector host that the session is connected to
+     * @param   port    The reflector port that the session is connected to
+     * @param   session The session data
+     *
+     * The current connection, if any, is dropped. The link leave all talk
+     * groups on the reflector so that no audio is received.
+     */
+    void adopt(const std::string& host, uint16_t port, Session& session);
+
+  private:
+    typedef enum
+    {
+      STATE_IDLE, STATE_CONNECTING, STATE_EXPECT_AUTH_CHALLENGE,
+      STATE_EXPECT_AUTH_OK, STATE_EXPECT_SERVER_INFO, STATE_READY
+    } State;
+
+    static const unsigned UDP_HEARTBEAT_RX_CNT_RESET  = 60;
+    static const unsigned TCP_HEARTBEAT_TX_CNT_RESET  = 10;
+    static const unsigned TCP_HEARTBEAT_RX_CNT_RESET  = 15;
+    static const unsigned RECONNECT_MIN_DELAY         = 1000;
+    static const unsigned RECONNECT_BACKOFF_START     = 5000;
+    static const unsigned RECONNECT_BACKOFF_MAX       = 120000;
+
+    const std::string                 m_logic_name;
+    std::string                       m_host;
+    uint16_t                          m_port;
+    const std::string                 m_callsign;
+    const std::string                 m_auth_key;
+    State                             m_state;
+    Session                           m_session;
+    Async::Timer                      m_reconnect_timer;
+    unsigned                          m_reconnect_backoff;
+    std::minstd_rand                  m_reconnect_rng;
+    Async::Timer                      m_heartbeat_timer;
+    unsigned                          m_udp_heartbeat_rx_cnt;
+    unsigned                          m_tcp_heartbeat_tx_cnt;
+    unsigned                          m_tcp_heartbeat_rx_cnt;
+
+    ReflectorStandbyLink(const ReflectorStandbyLink&);
+    ReflectorStandbyLink& operator=(const ReflectorStandbyLink&);
+    std::string name(void) const;
+    void attach(void);
+    void detach(void);
+    void disconnect(void);
+    void reconnect(void);
+    void scheduleReconnect(void);
+    void onConnected(void);
+    void onDisconnected(Async::TcpConnection *con,
+                        Async::TcpConnection::DisconnectReason reason);
+    void onFrameReceived(Async::FramedTcpConnection *con,
+                         std::vector<uint8_t>& data);
+    void handleMsgAuthChallenge(std::istream& is);
+    void handleMsgServerInfo(std::istream& is);
+    void udpDatagramReceived(const Async::IpAddress& addr, uint16_t port,
+                             void *buf, int count);
+    void sendMsg(const ReflectorMsg& msg);
+    void sendUdpMsg(const ReflectorUdpMsg& msg);
+    void handleTimerTick(Async::Timer *t);
+
+};  /* class ReflectorStandbyLink */
+
+
+#endif /* REFLECTOR_STANDBY_LINK_INCLUDED */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,569 @@
+/**
+@file   SoundPack.cpp
+@brief  Memory mapped packs of pre-decoded sound clips
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that handle sound packs. A sound pack is one file
+holding all the sound clips of a sound directory tree, decoded and indexed so
+that the clips can be played directly from a memory mapping.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <iostream>
+#include <fstream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "SoundPack.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+namespace {
+  const char MAGIC[8] = { 'S', 'V', 'X', 'S', 'P', 'A', 'C', 'K' };
+  const char *CLIP_EXTENSIONS[] = { ".wav", ".raw", ".gsm" };
+
+  uint64_t align8(uint64_t offset)
+  {
+    return (offset + 7) & ~static_cast<uint64_t>(7);
+  }
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+SoundPack& SoundPack::instance(void)
+{
+  static SoundPack the_pack;
+  return the_pack;
+} /* SoundPack::instance */
+
+
+bool SoundPack::write(const string& path, const string& root,
+                      unsigned sample_rate, const Clips& clips,
+                      string& errmsg)
+{
+  const string norm_root = normalizePath(root);
+
+  uint32_t bucket_cnt = 2;
+  while (bucket_cnt < 2 * clips.size())
+  {
+    bucket_cnt <<= 1;
+  }
+
+  Header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, MAGIC, sizeof(hdr.magic));
+  hdr.version = VERSION;
+  hdr.sample_rate = sample_rate;
+  hdr.entry_cnt = clips.size();
+  hdr.bucket_cnt = bucket_cnt;
+
+    // Lay out the file: header, buckets, entries, names and samples
+  const uint64_t entries_offset =
+    align8(sizeof(Header) + bucket_cnt * sizeof(uint32_t));
+  uint64_t names_offset = entries_offset + clips.size() * sizeof(Entry);
+  hdr.root_offset = names_offset;
+  hdr.root_len = norm_root.size();
+  string names(norm_root);
+
+  vector<uint32_t> buckets(bucket_cnt, 0);
+  vector<Entry> entries;
+  uint64_t sample_cnt = 0;
+  for (Clips::const_iterator it = clips.begin(); it != clips.end(); ++it)
+  {
+    const string& name = it->first;
+    Entry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.hash = hash(name.data(), name.size());
+    entry.name_offset = names_offset + names.size();
+    entry.name_len = name.size();
+    entry.first_sample = sample_cnt;
+    entry.sample_cnt = it->second.size();
+    names += name;
+    sample_cnt += it->second.size();
+
+    uint32_t bucket = entry.hash & (bucket_cnt - 1);
+    while (buckets[bucket] != 0)
+    {
+      bucket = (bucket + 1) & (bucket_cnt - 1);
+    }
+    entries.push_back(entry);
+    buckets[bucket] = entries.size();
+  }
+  if (names_offset + names.size() > 0xffffffffULL)
+  {
+    errmsg = "Too many clip names";
+    return false;
+  }
+  hdr.samples_offset = align8(names_offset + names.size());
+  hdr.file_size = hdr.samples_offset + sample_cnt * sizeof(short);
+
+    // Write to a temporary file which is then renamed so that a running
+    // process, that has the old pack mapped, is not hurt
+  const string tmp_path = path + ".tmp";
+  ofstream out(tmp_path.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!out.is_open())
+  {
+    errmsg = string("Could not open \"") + tmp_path + "\": " +
+             strerror(errno);
+    return false;
+  }
+  const char zeros[8] = { 0 };
+  out.write(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+  out.write(reinterpret_cast<const char *>(&buckets[0]),
+            buckets.size() * sizeof(buckets[0]));
+  out.write(zeros, entries_offset - sizeof(Header) -
+                   bucket_cnt * sizeof(uint32_t));
+  if (!entries.empty())
+  {
+    out.write(reinterpret_cast<const char *>(&entries[0]),
+              entries.size() * sizeof(entries[0]));
+  }
+  out.write(names.data(), names.size());
+  out.write(zeros, hdr.samples_offset - names_offset - names.size());
+  for (Clips::const_iterator it = clips.begin(); it != clips.end(); ++it)
+  {
+    if (!it->second.empty())
+    {
+      out.write(reinterpret_cast<const char *>(&it->second[0]),
+                it->second.size() * sizeof(short));
+    }
+  }
+  out.close();
+  if (out.fail())
+  {
+    errmsg = string("Could not write \"") + tmp_path + "\"";
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  if (rename(tmp_path.c_str(), path.c_str()) == -1)
+  {
+    errmsg = string("Could not rename \"") + tmp_path + "\" to \"" + path +
+             "\": " + strerror(errno);
+    unlink(tmp_path.c_str());
+    return false;
+  }
+
+  return true;
+
+} /* SoundPack::write */
+
+
+string SoundPack::normalizePath(const string& path)
+{
+  const bool is_absolute = !path.empty() && (path[0] == '/');
+  vector<string> comps;
+  string::size_type pos = 0;
+  while (pos <= path.size())
+  {
+    string::size_type end = path.find('/', pos);
+    if (end == string::npos)
+    {
+      end = path.size();
+    }
+    const string comp(path, pos, end - pos);
+    pos = end + 1;
+    if (comp.empty() || (comp == "."))
+    {
+      continue;
+    }
+    if (comp == "..")
+    {
+      if (!comps.empty() && (comps.back() != ".."))
+      {
+        comps.pop_back();
+        continue;
+      }
+      if (is_absolute)
+      {
+        continue;
+      }
+    }
+    comps.push_back(comp);
+  }
+
+  string norm(is_absolute ? "/" : "");
+  for (vector<string>::const_iterator it = comps.begin();
+       it != comps.end(); ++it)
+  {
+    if (it != comps.begin())
+    {
+      norm += "/";
+    }
+    norm += *it;
+  }
+  return norm.empty() ? "." : norm;
+} /* SoundPack::normalizePath */
+
+
+bool SoundPack::load(const string& path, unsigned sample_rate)
+{
+  pthread_mutex_lock(&m_mutex);
+  for (Packs::const_iterator it = m_packs.begin(); it != m_packs.end(); ++it)
+  {
+    if (it->path == path)
+    {
+      pthread_mutex_unlock(&m_mutex);
+      return true;
+    }
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+  {
+    cerr << "*** ERROR: Could not open sound pack \"" << path << "\": "
+         << strerror(errno) << endl;
+    return false;
+  }
+  struct stat st;
+  if ((fstat(fd, &st) == -1) || (st.st_size < (off_t)sizeof(Header)))
+  {
+    cerr << "*** ERROR: The sound pack \"" << path << "\" is too short\n";
+    ::close(fd);
+    return false;
+  }
+  void *addr = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED)
+  {
+    cerr << "*** ERROR: Could not map sound pack \"" << path << "\": "
+         << strerror(errno) << endl;
+    return false;
+  }
+
+  Pack pack;
+  pack.path = path;
+  pack.addr = static_cast<const char *>(addr);
+  pack.size = st.st_size;
+  pack.hdr = reinterpret_cast<const Header *>(pack.addr);
+  if (!validate(pack))
+  {
+    cerr << "*** ERROR: The file \"" << path
+         << "\" is not a valid sound pack\n";
+    munmap(addr, st.st_size);
+    return false;
+  }
+  if (pack.hdr->sample_rate != sample_rate)
+  {
+    cerr << "*** ERROR: The sound pack \"" << path << "\" has a sample rate "
+         << "of " << pack.hdr->sample_rate << "Hz but " << sample_rate
+         << "Hz is needed\n";
+    munmap(addr, st.st_size);
+    return false;
+  }
+  pack.root.assign(pack.addr + pack.hdr->root_offset, pack.hdr->root_len);
+  pack.buckets = reinterpret_cast<const uint32_t *>(pack.addr +
+                                                    sizeof(Header));
+  pack.entries = reinterpret_cast<const Entry *>(
+      pack.addr + align8(sizeof(Header) +
+                         pack.hdr->bucket_cnt * sizeof(uint32_t)));
+  pack.samples = reinterpret_cast<const short *>(
+      pack.addr + pack.hdr->samples_offset);
+
+    // Bring the whole pack into memory so that playing a clip for the
+    // first time does not have to wait for the disk
+  madvise(addr, st.st_size, MADV_WILLNEED);
+
+  pthread_mutex_lock(&m_mutex);
+  m_packs.push_back(pack);
+  pthread_mutex_unlock(&m_mutex);
+
+  cout << "Loaded sound pack \"" << path << "\" with "
+       << pack.hdr->entry_cnt << " clips for \"" << pack.root << "\"\n";
+
+  return true;
+
+} /* SoundPack::load */
+
+
+bool SoundPack::find(const string& path, const short*& samples, size_t& count)
+{
+  pthread_mutex_lock(&m_mutex);
+  bool found = findP(path, samples, count);
+  pthread_mutex_unlock(&m_mutex);
+  return found;
+} /* SoundPack::find */
+
+
+string SoundPack::findClip(const string& basename)
+{
+  const size_t ext_cnt = sizeof(CLIP_EXTENSIONS) / sizeof(*CLIP_EXTENSIONS);
+
+  pthread_mutex_lock(&m_mutex);
+  const bool have_packs = !m_packs.empty();
+  for (size_t i=0; have_packs && (i<ext_cnt); ++i)
+  {
+    const string path = basename + CLIP_EXTENSIONS[i];
+    const short *samples;
+    size_t count;
+    if (findP(path, samples, count))
+    {
+      pthread_mutex_unlock(&m_mutex);
+      return path;
+    }
+  }
+  pthread_mutex_unlock(&m_mutex);
+
+  for (size_t i=0; i<ext_cnt; ++i)
+  {
+    const string path = basename + CLIP_EXTENSIONS[i];
+    struct stat st;
+    if ((stat(path.c_str(), &st) == 0) && S_ISREG(st.st_mode))
+    {
+      return path;
+    }
+  }
+
+  return "";
+
+} /* SoundPack::findClip */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+SoundPack::SoundPack(void)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+} /* SoundPack::SoundPack */
+
+
+SoundPack::~SoundPack(void)
+{
+  for (Packs::const_iterator it = m_packs.begin(); it != m_packs.end(); ++it)
+  {
+    munmap(const_cast<char *>(it->addr), it->size);
+  }
+  pthread_mutex_destroy(&m_mutex);
+} /* SoundPack::~SoundPack */
+
+
+/*
+ * The 32 bit FNV-1a hash
+ */
+uint32_t SoundPack::hash(const char *str, size_t len)
+{
+  uint32_t h = 2166136261U;
+  for (size_t i=0; i<len; ++i)
+  {
+    h ^= static_cast<unsigned char>(str[i]);
+    h *= 16777619U;
+  }
+  return h;
+} /* SoundPack::hash */
+
+
+bool SoundPack::validate(const Pack& pack)
+{
+  const Header *hdr = pack.hdr;
+  if ((memcmp(hdr->magic, MAGIC, sizeof(MAGIC)) != 0) ||
+      (hdr->version != VERSION) || (hdr->file_size != pack.size))
+  {
+    return false;
+  }
+  if ((hdr->bucket_cnt == 0) || ((hdr->bucket_cnt & (hdr->bucket_cnt-1)) != 0)
+      || (hdr->bucket_cnt <= hdr->entry_cnt))
+  {
+    return false;
+  }
+
+  const uint64_t entries_offset =
+    align8(sizeof(Header) + uint64_t(hdr->bucket_cnt) * sizeof(uint32_t));
+  const uint64_t names_offset =
+    entries_offset + uint64_t(hdr->entry_cnt) * sizeof(Entry);
+  if ((names_offset > hdr->samples_offset) ||
+      (hdr->samples_offset > hdr->file_size) ||
+      ((hdr->samples_offset % sizeof(short)) != 0) ||
+      (hdr->root_offset < names_offset) ||
+      (uint64_t(hdr->root_offset) + hdr->root_len > hdr->samples_offset))
+  {
+    return false;
+  }
+
+  const uint32_t *buckets =
+    reinterpret_cast<const uint32_t *>(pack.addr + sizeof(Header));
+  for (uint32_t i=0; i<hdr->bucket_cnt; ++i)
+  {
+    if (buckets[i] > hdr->entry_cnt)
+    {
+      return false;
+    }
+  }
+
+  const uint64_t total_samples =
+    (hdr->file_size - hdr->samples_offset) / sizeof(short);
+  const Entry *entries =
+    reinterpret_cast<const Entry *>(pack.addr + entries_offset);
+  for (uint32_t i=0; i<hdr->entry_cnt; ++i)
+  {
+    const Entry& entry = entries[i];
+    if ((entry.name_offset < names_offset) ||
+        (uint64_t(entry.name_offset) + entry.name_len > hdr->samples_offset) ||
+        (entry.first_sample > total_samples) ||
+        (entry.sample_cnt > total_samples - entry.first_sample))
+    {
+      return false;
+    }
+  }
+
+  return true;
+
+} /* SoundPack::validate */
+
+
+bool SoundPack::findP(const string& path, const short*& samples,
+                      size_t& count)
+{
+  if (m_packs.empty())
+  {
+    return false;
+  }
+
+  const string norm = normalizePath(path);
+  for (Packs::const_iterator it = m_packs.begin(); it != m_packs.end(); ++it)
+  {
+    const Pack& pack = *it;
+    if ((norm.size() <= pack.root.size() + 1) ||
+        (norm.compare(0, pack.root.size(), pack.root) != 0) ||
+        (norm[pack.root.size()] != '/'))
+    {
+      continue;
+    }
+    const char *name = norm.c_str() + pack.root.size() + 1;
+    const size_t name_len = norm.size() - pack.root.size() - 1;
+    const uint32_t h = hash(name, name_len);
+    const uint32_t mask = pack.hdr->bucket_cnt - 1;
+    for (uint32_t bucket = h & mask; pack.buckets[bucket] != 0;
+         bucket = (bucket + 1) & mask)
+    {
+      const Entry& entry = pack.entries[pack.buckets[bucket] - 1];
+      if ((entry.hash == h) && (entry.name_len == name_len) &&
+          (memcmp(pack.addr + entry.name_offset, name, name_len) == 0))
+      {
+        samples = pack.samples + entry.first_sample;
+        count = entry.sample_cnt;
+        return true;
+      }
+    }
+  }
+
+  return false;
+
+} /* SoundPack::findP */
+
+
+
+/*
+ * This file has not been truncated
+ */
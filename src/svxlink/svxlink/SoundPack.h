@@ -0,0 +1,249 @@
+/**
+@file   SoundPack.h
+@brief  Memory mapped packs of pre-decoded sound clips
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that handle sound packs. A sound pack is one file
+holding all the sound clips of a sound directory tree, decoded and indexed so
+that the clips can be played directly from a memory mapping.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef SOUND_PACK_INCLUDED
+#define SOUND_PACK_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  Memory mapped packs of pre-decoded sound clips
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+A sound pack replace a directory tree of sound clip files, like
+/usr/share/svxlink/sounds/en_US. It is built using the svxsoundpack utility
+and holds the clips as 16 bit samples at the internal sample rate, so no
+decoding is needed at playback time. The file is memory mapped when it is
+loaded so playing a clip cause no system calls.
+
+A clip is looked up using the same path that would have been used to play
+the file, e.g. /usr/share/svxlink/sounds/en_US/Default/1.wav. The path is
+normalized, the directory the pack was built from is stripped off and the
+rest is looked up in a hash table in the pack.
+
+The pack file consist of a header, the hash table, the clip entries, the
+names and finally the samples. All values are stored in host byte order so a
+pack must be built on a host with the same byte order as the one using it.
+
+There is only one sound pack registry per process and it is shared by all
+logic cores. The functions may be called from the TCL event handler threads.
+*/
+class SoundPack
+{
+  public:
+    static const uint32_t VERSION = 1;
+
+    /**
+     * @brief   The header at the start of a sound pack file
+     */
+    struct Header
+    {
+      char      magic[8];       ///< Always "SVXSPACK"
+      uint32_t  version;        ///< The file format version
+      uint32_t  sample_rate;    ///< The sample rate of all clips
+      uint32_t  entry_cnt;      ///< The number of clips
+      uint32_t  bucket_cnt;     ///< The hash table size, a power of two
+      uint32_t  root_offset;    ///< The offset of the root directory name
+      uint32_t  root_len;       ///< The length of the root directory name
+      uint64_t  samples_offset; ///< The file offset of the first sample
+      uint64_t  file_size;      ///< The total size of the file
+    };
+
+    /**
+     * @brief   One clip in a sound pack
+     */
+    struct Entry
+    {
+      uint32_t  hash;           ///< The hash of the name
+      uint32_t  name_offset;    ///< The file offset of the name
+      uint32_t  name_len;       ///< The length of the name
+      uint32_t  reserved;
+      uint64_t  first_sample;   ///< The index of the first sample
+      uint64_t  sample_cnt;     ///< The number of samples in the clip
+    };
+
+    /**
+     * @brief   The clips to write to a pack, indexed by relative path
+     */
+    typedef std::map<std::string, std::vector<short> > Clips;
+
+    /**
+     * @brief   Get the process wide sound pack registry
+     * @returns Returns a reference to the registry
+     */
+    static SoundPack& instance(void);
+
+    /**
+     * @brief   Write a sound pack file
+     * @param   path        The path of the pack file to write
+     * @param   root        The directory that the pack replace
+     * @param   sample_rate The sample rate of the clips
+     * @param   clips       The clips to write
+     * @param   errmsg      Set to an error message on failure
+     * @returns Returns \em true on success or \em false on failure
+     */
+    static bool write(const std::string& path, const std::string& root,
+                      unsigned sample_rate, const Clips& clips,
+                      std::string& errmsg);
+
+    /**
+     * @brief   Normalize a path without looking at the file system
+     * @param   path The path to normalize
+     * @returns Returns the path with duplicated slashes, "." and ".."
+     *          components removed
+     */
+    static std::string normalizePath(const std::string& path);
+
+    /**
+     * @brief   Load a sound pack
+     * @param   path        The path to the pack file
+     * @param   sample_rate The sample rate that the clips must have
+     * @returns Returns \em true on success or \em false on failure
+     *
+     * Loading a pack that has already been loaded does nothing.
+     */
+    bool load(const std::string& path, unsigned sample_rate);
+
+    /**
+     * @brief   Find a clip in the loaded packs
+     * @param   path    The path to the sound clip file
+     * @param   samples Set to point at the first sample of the clip
+     * @param   count   Set to the number of samples in the clip
+     * @returns Returns \em true if the clip was found
+     *
+     * The samples stay valid as long as the process is running.
+     */
+    bool find(const std::string& path, const short*& samples, size_t& count);
+
+    /**
+     * @brief   Find a sound clip given its path without extension
+     * @param   basename The path to the clip without the file extension
+     * @returns Returns the path to play or an empty string if not found
+     *
+     * The .wav, .raw and .gsm extensions are tried in that order, first in
+     * the sound packs and then in the file system.
+     */
+    std::string findClip(const std::string& basename);
+
+  private:
+    struct Pack
+    {
+      std::string     path;
+      std::string     root;
+      const char      *addr;
+      size_t          size;
+      const Header    *hdr;
+      const uint32_t  *buckets;
+      const Entry     *entries;
+      const short     *samples;
+    };
+    typedef std::vector<Pack> Packs;
+
+    pthread_mutex_t   m_mutex;
+    Packs             m_packs;
+
+    SoundPack(void);
+    ~SoundPack(void);
+    SoundPack(const SoundPack&);
+    SoundPack& operator=(const SoundPack&);
+    static uint32_t hash(const char *str, size_t len);
+    static bool validate(const Pack& pack);
+    bool findP(const std::string& path, const short*& samples, size_t& count);
+
+};  /* class SoundPack */
+
+
+#endif /* SOUND_PACK_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,327 @@
+/**
+@file   VoiceMailIndex.cpp
+@brief  An in memory index of the voice mail spool
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that keeps track of the messages stored in the
+voice mail mailbox directories so that the TclVoiceMail module does not have
+to scan the directories on each mailbox query.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "VoiceMailIndex.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+namespace {
+  const char SUBJ_SUFFIX[] = "_subj.wav";
+  const size_t SUBJ_SUFFIX_LEN = sizeof(SUBJ_SUFFIX) - 1;
+
+  bool messageLess(const VoiceMailIndex::Message& lhs,
+                   const VoiceMailIndex::Message& rhs)
+  {
+    return lhs.basename < rhs.basename;
+  }
+}
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+VoiceMailIndex& VoiceMailIndex::instance(void)
+{
+  static VoiceMailIndex the_index;
+  return the_index;
+} /* VoiceMailIndex::instance */
+
+
+size_t VoiceMailIndex::count(const string& dir)
+{
+  pthread_mutex_lock(&m_mutex);
+  size_t cnt = mailbox(dir).msgs.size();
+  pthread_mutex_unlock(&m_mutex);
+  return cnt;
+} /* VoiceMailIndex::count */
+
+
+bool VoiceMailIndex::first(const string& dir, Message& msg)
+{
+  pthread_mutex_lock(&m_mutex);
+  const Messages& msgs = mailbox(dir).msgs;
+  bool found = !msgs.empty();
+  if (found)
+  {
+    msg = msgs.front();
+  }
+  pthread_mutex_unlock(&m_mutex);
+  return found;
+} /* VoiceMailIndex::first */
+
+
+VoiceMailIndex::Messages VoiceMailIndex::list(const string& dir)
+{
+  pthread_mutex_lock(&m_mutex);
+  Messages msgs(mailbox(dir).msgs);
+  pthread_mutex_unlock(&m_mutex);
+  return msgs;
+} /* VoiceMailIndex::list */
+
+
+void VoiceMailIndex::add(const string& basename)
+{
+  string dir, name;
+  splitPath(basename, dir, name);
+  pthread_mutex_lock(&m_mutex);
+  Mailbox& mbox = mailbox(dir);
+  Message msg(parseName(dir, name + SUBJ_SUFFIX));
+  Messages::iterator it =
+    lower_bound(mbox.msgs.begin(), mbox.msgs.end(), msg, messageLess);
+  if ((it == mbox.msgs.end()) || (it->basename != msg.basename))
+  {
+    mbox.msgs.insert(it, msg);
+  }
+  mbox.exists = dirStat(dir, mbox.mtime);
+  pthread_mutex_unlock(&m_mutex);
+} /* VoiceMailIndex::add */
+
+
+void VoiceMailIndex::remove(const string& basename)
+{
+  string dir, name;
+  splitPath(basename, dir, name);
+  pthread_mutex_lock(&m_mutex);
+  Mailbox& mbox = mailbox(dir);
+  Message msg;
+  msg.basename = dir + "/" + name;
+  Messages::iterator it =
+    lower_bound(mbox.msgs.begin(), mbox.msgs.end(), msg, messageLess);
+  if ((it != mbox.msgs.end()) && (it->basename == msg.basename))
+  {
+    mbox.msgs.erase(it);
+  }
+  mbox.exists = dirStat(dir, mbox.mtime);
+  pthread_mutex_unlock(&m_mutex);
+} /* VoiceMailIndex::remove */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+VoiceMailIndex::VoiceMailIndex(void)
+{
+  pthread_mutex_init(&m_mutex, NULL);
+} /* VoiceMailIndex::VoiceMailIndex */
+
+
+VoiceMailIndex::~VoiceMailIndex(void)
+{
+  pthread_mutex_destroy(&m_mutex);
+} /* VoiceMailIndex::~VoiceMailIndex */
+
+
+VoiceMailIndex::Mailbox& VoiceMailIndex::mailbox(const string& dir)
+{
+  struct timespec mtime = { 0, 0 };
+  bool exists = dirStat(dir, mtime);
+
+  Mailboxes::iterator it = m_mailboxes.find(dir);
+  if (it == m_mailboxes.end())
+  {
+    it = m_mailboxes.insert(make_pair(dir, Mailbox())).first;
+    scan(dir, it->second);
+  }
+  else if ((exists != it->second.exists) ||
+           (mtime.tv_sec != it->second.mtime.tv_sec) ||
+           (mtime.tv_nsec != it->second.mtime.tv_nsec))
+  {
+      // The directory has been changed by someone else
+    scan(dir, it->second);
+  }
+  it->second.exists = exists;
+  it->second.mtime = mtime;
+  return it->second;
+} /* VoiceMailIndex::mailbox */
+
+
+void VoiceMailIndex::scan(const string& dir, Mailbox& mbox)
+{
+  mbox.msgs.clear();
+  DIR *dirp = opendir(dir.c_str());
+  if (dirp == NULL)
+  {
+    return;
+  }
+  struct dirent *entry;
+  while ((entry = readdir(dirp)) != NULL)
+  {
+    string name(entry->d_name);
+    if ((name.size() > SUBJ_SUFFIX_LEN) &&
+        (name.compare(name.size() - SUBJ_SUFFIX_LEN, SUBJ_SUFFIX_LEN,
+                      SUBJ_SUFFIX) == 0))
+    {
+      mbox.msgs.push_back(parseName(dir, name));
+    }
+  }
+  closedir(dirp);
+  sort(mbox.msgs.begin(), mbox.msgs.end(), messageLess);
+} /* VoiceMailIndex::scan */
+
+
+bool VoiceMailIndex::dirStat(const string& dir, struct timespec& mtime)
+{
+  struct stat st;
+  if (stat(dir.c_str(), &st) != 0)
+  {
+    mtime.tv_sec = 0;
+    mtime.tv_nsec = 0;
+    return false;
+  }
+  mtime = st.st_mtim;
+  return true;
+} /* VoiceMailIndex::dirStat */
+
+
+VoiceMailIndex::Message VoiceMailIndex::parseName(const string& dir,
+                                                  const string& name)
+{
+    // The file name format is YYYYmmdd_HHMMSS_<sender>_subj.wav
+  Message msg;
+  string stem(name, 0, name.size() - SUBJ_SUFFIX_LEN);
+  msg.basename = dir + "/" + stem;
+  string::size_type sep = stem.rfind('_');
+  if ((sep != string::npos) && (sep == 15))
+  {
+    msg.timestamp = stem.substr(0, sep);
+    msg.sender = stem.substr(sep + 1);
+  }
+  return msg;
+} /* VoiceMailIndex::parseName */
+
+
+void VoiceMailIndex::splitPath(const string& basename, string& dir,
+                               string& name)
+{
+  string::size_type sep = basename.rfind('/');
+  if (sep == string::npos)
+  {
+    dir = ".";
+    name = basename;
+  }
+  else
+  {
+    dir = basename.substr(0, sep);
+    name = basename.substr(sep + 1);
+  }
+} /* VoiceMailIndex::splitPath */
+
+
+/*
+ * This file has not been truncated
+ */
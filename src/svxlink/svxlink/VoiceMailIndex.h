@@ -0,0 +1,198 @@
+/**
+@file   VoiceMailIndex.h
+@brief  An in memory index of the voice mail spool
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that keeps track of the messages stored in the
+voice mail mailbox directories so that the TclVoiceMail module does not have
+to scan the directories on each mailbox query.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef VOICE_MAIL_INDEX_INCLUDED
+#define VOICE_MAIL_INDEX_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <time.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  An in memory index of voice mail mailboxes
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+The voice mail module stores each message as a pair of files,
+<timestamp>_<sender>_subj.wav and <timestamp>_<sender>_mesg.wav, in a
+directory per user. This class keeps a sorted list of the messages in each
+mailbox directory. A directory is scanned the first time it is queried and
+after that the index is updated by the add and remove functions. If the
+modification time of the directory changes behind the back of the index, for
+example when a message is deleted manually, the directory is scanned again.
+
+There is only one index per process and it is shared by all logic cores. The
+functions may be called from the TCL event handler threads.
+*/
+class VoiceMailIndex
+{
+  public:
+    /**
+     * @brief   Information about a stored message
+     */
+    struct Message
+    {
+      std::string basename;   ///< The path without the _subj.wav suffix
+      std::string timestamp;  ///< The time of recording, YYYYmmdd_HHMMSS
+      std::string sender;     ///< The user id of the sender
+    };
+    typedef std::vector<Message> Messages;
+
+    /**
+     * @brief   Get the process wide voice mail index
+     * @returns Returns a reference to the index
+     */
+    static VoiceMailIndex& instance(void);
+
+    /**
+     * @brief   Get the number of messages in a mailbox
+     * @param   dir The mailbox directory
+     * @returns Returns the number of messages
+     */
+    size_t count(const std::string& dir);
+
+    /**
+     * @brief   Get the oldest message in a mailbox
+     * @param   dir The mailbox directory
+     * @param   msg Will be set to the oldest message
+     * @returns Returns \em true if there was a message or \em false if the
+     *          mailbox is empty
+     */
+    bool first(const std::string& dir, Message& msg);
+
+    /**
+     * @brief   Get all messages in a mailbox, oldest first
+     * @param   dir The mailbox directory
+     * @returns Returns a copy of the message list
+     */
+    Messages list(const std::string& dir);
+
+    /**
+     * @brief   Add a message that has been recorded
+     * @param   basename The message path without the _subj.wav suffix
+     */
+    void add(const std::string& basename);
+
+    /**
+     * @brief   Remove a message that has been deleted
+     * @param   basename The message path without the _subj.wav suffix
+     */
+    void remove(const std::string& basename);
+
+  private:
+    struct Mailbox
+    {
+      Messages          msgs;
+      struct timespec   mtime;
+      bool              exists;
+    };
+    typedef std::map<std::string, Mailbox> Mailboxes;
+
+    pthread_mutex_t   m_mutex;
+    Mailboxes         m_mailboxes;
+
+    VoiceMailIndex(void);
+    ~VoiceMailIndex(void);
+    VoiceMailIndex(const VoiceMailIndex&);
+    VoiceMailIndex& operator=(const VoiceMailIndex&);
+    Mailbox& mailbox(const std::string& dir);
+    void scan(const std::string& dir, Mailbox& mbox);
+    static bool dirStat(const std::string& dir, struct timespec& mtime);
+    static Message parseName(const std::string& dir, const std::string& name);
+    static void splitPath(const std::string& basename, std::string& dir,
+                          std::string& name);
+
+};  /* class VoiceMailIndex */
+
+
+#endif /* VOICE_MAIL_INDEX_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -22,10 +22,9 @@ proc playMsg {context msg} {
   global basedir
   global langdir
 
-  set candidates [glob -nocomplain "$langdir/$context/$msg.{wav,raw,gsm}" \
-                                   "$langdir/Default/$msg.{wav,raw,gsm}"];
-  if { [llength $candidates] > 0 } {
-    playFile [lindex $candidates 0];
+  set clip [findSoundClip "$langdir/$context/$msg" "$langdir/Default/$msg"];
+  if {$clip != ""} {
+    playFile $clip;
   } else {
     puts "*** WARNING: Could not find audio clip \"$msg\" in context \"$context\"";
   }
@@ -68,6 +67,24 @@ proc playSubcommands {context basename {header ""}} {
 }
 
 
+#
+# Play the announcements made by the given script as one composition. The
+# composition is rendered into a single sound clip that is cached under the
+# given key and replayed directly as long as the script make the same play
+# calls as the last time. The script is evaluated in the context of the
+# caller.
+#
+#   key     - A name for the composition, e.g. voice_id
+#   script  - The script that play the announcements
+#
+proc playComposed {key script} {
+  composeBegin $key
+  set ret [catch {uplevel 1 $script} result options]
+  composeEnd
+  return -options $options $result
+}
+
+
 #
 # Process the given event.
 # All TCL modules should use this function instead of calling playMsg etc
@@ -46,10 +46,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <dirent.h>
 #include <pwd.h>
 #include <grp.h>
+#include <time.h>
 
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <algorithm>
 #include <vector>
 #include <cstring>
@@ -65,9 +67,22 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncCppApplication.h>
 #include <AsyncConfig.h>
+#include <AsyncConfigWatch.h>
 #include <AsyncTimer.h>
 #include <AsyncFdWatch.h>
+#include <AsyncLogWriter.h>
 #include <AsyncAudioIO.h>
+#include <AsyncAudioProfiler.h>
+#include <AsyncAudioPerfCounters.h>
+#include <AsyncAudioLatencyTrace.h>
+#include <AsyncAudioLatencyBudget.h>
+#include <AsyncPty.h>
+#include <AsyncTcpServer.h>
+#include <AsyncHttpServerConnection.h>
+#include <AsyncMetrics.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncThreadScheduling.h>
+#include <AsyncAudioCpuFeatures.h>
 #include <LocationInfo.h>
 #include <common.h>
 #include <config.h>
@@ -86,6 +101,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "RepeaterLogic.h"
 #include "ReflectorLogic.h"
 #include "LinkManager.h"
+#include "EventHandler.h"
 
 
 
@@ -127,16 +143,17 @@ using namespace sigc;
 
 static void parse_arguments(int argc, const char **argv);
 static void stdinHandler(FdWatch *w);
-static void stdout_handler(FdWatch *w);
 static void initialize_logics(Config &cfg);
 static void sighup_handler(int signal);
+static void cfg_reloaded(bool success);
 static void sigterm_handler(int signal);
 static void handle_unix_signal(int signum);
-static bool logfile_open(void);
-static void logfile_reopen(const char *reason);
-static bool logfile_write_timestamp(void);
-static void logfile_write(const char *buf);
 static void logfile_flush(void);
+static void audio_profile_pty_handler(const void *buf, size_t count);
+static void startup_phase_done(const string& phase);
+static void metrics_http_client_connected(HttpServerConnection *con);
+static void metrics_http_request_received(HttpServerConnection *con,
+                                          HttpServerConnection::Request& req);
 
 
 /****************************************************************************
@@ -158,11 +175,15 @@ static char   	      	  *logfile_name = NULL;
 static char   	      	  *runasuser = NULL;
 static char   	      	  *config = NULL;
 static int    	      	  daemonize = 0;
-static int    	      	  logfd = -1;
 static vector<LogicBase*> logic_vec;
 static FdWatch	      	  *stdin_watch = 0;
-static FdWatch	      	  *stdout_watch = 0;
+static LogWriter          *log_writer = 0;
 static string         	  tstamp_format;
+static Pty                *audio_profile_pty = 0;
+static string             audio_profile_cmd;
+static TcpServer<HttpServerConnection> *metrics_http_server = 0;
+static struct timespec    startup_begin;
+static struct timespec    startup_phase_begin;
 
 
 /****************************************************************************
@@ -191,6 +212,9 @@ int main(int argc, char **argv)
 {
   setlocale(LC_ALL, "");
 
+  clock_gettime(CLOCK_MONOTONIC, &startup_begin);
+  startup_phase_begin = startup_begin;
+
   CppApplication app;
   app.catchUnixSignal(SIGHUP);
   app.catchUnixSignal(SIGINT);
@@ -204,7 +228,8 @@ int main(int argc, char **argv)
   if (logfile_name != 0)
   {
       /* Open the logfile */
-    if (!logfile_open())
+    log_writer = new LogWriter;
+    if (!log_writer->open(logfile_name))
     {
       exit(1);
     }
@@ -227,8 +252,10 @@ int main(int argc, char **argv)
       perror("fcntl(..., F_SETFL)");
       exit(1);
     }
-    stdout_watch = new FdWatch(pipefd[0], FdWatch::FD_WATCH_RD);
-    stdout_watch->activity.connect(sigc::ptr_fun(&stdout_handler));
+    if (!log_writer->start(pipefd[0]))
+    {
+      exit(1);
+    }
 
       /* Redirect stdout to the logpipe */
     if (dup2(pipefd[1], STDOUT_FILENO) == -1)
@@ -337,6 +364,10 @@ int main(int argc, char **argv)
   }
   
   tstamp_format = "%c";
+  if (log_writer != 0)
+  {
+    log_writer->setTimestampFormat(tstamp_format);
+  }
 
   Config cfg;
   string cfg_filename;
@@ -433,6 +464,10 @@ int main(int argc, char **argv)
   }
   
   cfg.getValue("GLOBAL", "TIMESTAMP_FORMAT", tstamp_format);
+  if (log_writer != 0)
+  {
+    log_writer->setTimestampFormat(tstamp_format);
+  }
   
   cout << PROGRAM_NAME " v" SVXLINK_VERSION
           " Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX\n\n";
@@ -443,8 +478,42 @@ int main(int argc, char **argv)
   cout << "GNU GPL (General Public License) version 2 or later.\n";
 
   cout << "\nUsing configuration file: " << main_cfg_filename << endl;
+  startup_phase_done("Reading configuration");
+
+  if (!ThreadScheduling::configure(cfg, "GLOBAL"))
+  {
+    exit(1);
+  }
   
   string value;
+  if (cfg.getValue("GLOBAL", "INTERNAL_SAMPLE_RATE", value))
+  {
+    int rate = atoi(value.c_str());
+    if (!AudioSampleRate::setInternal(rate))
+    {
+      cerr << "*** ERROR: Illegal internal sample rate specified for "
+              "config variable GLOBAL/INTERNAL_SAMPLE_RATE. Valid rates are "
+              "8000 and 16000\n";
+      exit(1);
+    }
+      // The sound card use the internal sample rate unless CARD_SAMPLE_RATE
+      // is set
+    AudioIO::setSampleRate(rate);
+    cout << "--- Using internal sample rate " << rate << "Hz\n";
+  }
+
+  if (cfg.getValue("GLOBAL", "DSP_SIMD", value))
+  {
+    if (!AudioCpuFeatures::setLimit(value))
+    {
+      cerr << "*** ERROR: Illegal value \"" << value << "\" for config "
+              "variable GLOBAL/DSP_SIMD. Valid values are native, scalar, "
+              "sse, sse2, avx, avx2, avx512 and neon\n";
+      exit(1);
+    }
+    cout << "--- Using SIMD features for DSP: "
+         << AudioCpuFeatures::toString(AudioCpuFeatures::enabled()) << endl;
+  }
   if (cfg.getValue("GLOBAL", "CARD_SAMPLE_RATE", value))
   {
     int rate = atoi(value.c_str());
@@ -458,21 +527,24 @@ int main(int argc, char **argv)
       AudioIO::setBlocksize(512);
       AudioIO::setBlockCount(2);
     }
-    #if INTERNAL_SAMPLE_RATE <= 8000
-    else if (rate == 8000)
+    else if ((rate == 8000) && (INTERNAL_SAMPLE_RATE <= 8000))
     {
       AudioIO::setBlocksize(256);
       AudioIO::setBlockCount(2);
     }
-    #endif
+    else if ((rate >= 11025) && (rate <= 192000))
+    {
+        // Other rates, like 44100, are converted using a resampler
+      AudioIO::setBlocksize((rate > 16000) ? 1024 : 512);
+      AudioIO::setBlockCount((rate > 16000) ? 4 : 2);
+    }
     else
     {
       cerr << "*** ERROR: Illegal sound card sample rate specified for "
       	      "config variable GLOBAL/CARD_SAMPLE_RATE. Valid rates are "
-	      #if INTERNAL_SAMPLE_RATE <= 8000
-	      "8000, "
-	      #endif
-	      "16000 and 48000\n";
+           << ((INTERNAL_SAMPLE_RATE <= 8000) ? "8000, " : "")
+           << "16000 and 48000 or, using a resampler, any rate between "
+              "11025 and 192000\n";
       exit(1);
     }
     AudioIO::setSampleRate(rate);
@@ -505,13 +577,76 @@ int main(int argc, char **argv)
     }
   }
 
+  bool event_script_cache = false;
+  cfg.getValue("GLOBAL", "EVENT_SCRIPT_CACHE", event_script_cache);
+  EventHandler::setScriptCacheEnabled(event_script_cache);
+
+  unsigned latency_trace_interval = 0;
+  cfg.getValue("GLOBAL", "AUDIO_LATENCY_TRACE", latency_trace_interval);
+  AudioLatencyTrace::setInterval(latency_trace_interval);
+
+  bool latency_budget = false;
+  cfg.getValue("GLOBAL", "LATENCY_BUDGET", latency_budget);
+  AudioLatencyBudget::setEnabled(latency_budget);
+
+  bool perf_counters = AudioPerfCounters::isEnabled();
+  cfg.getValue("GLOBAL", "AUDIO_PERF_COUNTERS", perf_counters);
+  if (perf_counters && !AudioPerfCounters::isAvailable())
+  {
+    cerr << "*** WARNING: GLOBAL/AUDIO_PERF_COUNTERS is set but the "
+            "performance counters are not compiled in. Rebuild with "
+            "USE_AUDIO_PROFILING=ON.\n";
+  }
+  AudioPerfCounters::setEnabled(perf_counters);
+
+  startup_phase_done("Global initialization");
+
   initialize_logics(cfg);
 
+  string audio_profile_pty_path;
+  cfg.getValue("GLOBAL", "AUDIO_PROFILE_PTY", audio_profile_pty_path);
+  if (!audio_profile_pty_path.empty())
+  {
+    audio_profile_pty = new Pty(audio_profile_pty_path);
+    if (!audio_profile_pty->open())
+    {
+      cerr << "*** ERROR: Could not open audio profile PTY "
+           << audio_profile_pty_path << " as specified in configuration "
+           << "variable GLOBAL/AUDIO_PROFILE_PTY" << endl;
+      exit(1);
+    }
+    audio_profile_pty->dataReceived.connect(
+        sigc::ptr_fun(&audio_profile_pty_handler));
+  }
+
+  string metrics_http_port;
+  cfg.getValue("GLOBAL", "METRICS_HTTP_PORT", metrics_http_port);
+  if (!metrics_http_port.empty())
+  {
+    metrics_http_server =
+      new TcpServer<HttpServerConnection>(metrics_http_port);
+    metrics_http_server->clientConnected.connect(
+        sigc::ptr_fun(&metrics_http_client_connected));
+      // Collect main loop statistics for the metrics. Warnings are only
+      // printed if explicitly enabled.
+    if (app.loopProfiler() == 0)
+    {
+      app.setLoopProfiling(true, 0);
+    }
+  }
+
   if (LinkManager::hasInstance())
   {
     LinkManager::instance()->allLogicsStarted();
   }
 
+  struct timespec startup_end;
+  clock_gettime(CLOCK_MONOTONIC, &startup_end);
+  cout << "--- Startup completed in "
+       << ((startup_end.tv_sec - startup_begin.tv_sec) * 1000 +
+           (startup_end.tv_nsec - startup_begin.tv_nsec) / 1000000)
+       << "ms" << endl;
+
   struct termios org_termios;
   if (logfile_name == 0)
   {
@@ -527,8 +662,27 @@ int main(int argc, char **argv)
     stdin_watch->activity.connect(sigc::ptr_fun(&stdinHandler));
   }
 
+  ConfigWatch cfg_watch(cfg);
+  bool cfg_auto_reload = false;
+  cfg.getValue("GLOBAL", "CFG_AUTO_RELOAD", cfg_auto_reload);
+  if (cfg_auto_reload)
+  {
+    cfg_watch.reloaded.connect(sigc::ptr_fun(&cfg_reloaded));
+    if (!cfg_watch.start())
+    {
+      cerr << "*** WARNING: Could not watch the configuration files for "
+              "changes\n";
+    }
+  }
+
   app.exec();
 
+  delete audio_profile_pty;
+  audio_profile_pty = 0;
+
+  delete metrics_http_server;
+  metrics_http_server = 0;
+
   LinkManager::deleteInstance();
   LocationInfo::deleteInstance();
 
@@ -540,9 +694,11 @@ int main(int argc, char **argv)
     tcsetattr(STDIN_FILENO, TCSANOW, &org_termios);
   }
 
-  if (stdout_watch != 0)
+  if (log_writer != 0)
   {
-    delete stdout_watch;
+    log_writer->stop();
+    delete log_writer;
+    log_writer = 0;
     close(pipefd[0]);
     close(pipefd[1]);
   }
@@ -554,11 +710,6 @@ int main(int argc, char **argv)
   }
   logic_vec.clear();
   
-  if (logfd != -1)
-  {
-    close(logfd);
-  }
-  
   return 0;
   
 } /* main */
@@ -671,6 +822,19 @@ static void stdinHandler(FdWatch *w)
     case '\n':
       putchar('\n');
       break;
+
+    case 'P':
+      AudioProfiler::report(cout);
+      if (AudioPerfCounters::isEnabled())
+      {
+        AudioPerfCounters::report(cout);
+      }
+      break;
+
+    case 'L':
+      AudioLatencyTrace::report(cout);
+      AudioLatencyBudget::report(cout);
+      break;
     
     case '0': case '1': case '2': case '3':
     case '4': case '5': case '6': case '7':
@@ -692,20 +856,51 @@ static void stdinHandler(FdWatch *w)
 }
 
 
-static void stdout_handler(FdWatch *w)
+static void audio_profile_pty_handler(const void *buf, size_t count)
 {
-  ssize_t len =  0;
-  do
+  const char *buffer = reinterpret_cast<const char*>(buf);
+  for (size_t i=0; i<count; ++i)
   {
-    char buf[256];
-    len = read(w->fd(), buf, sizeof(buf)-1);
-    if (len > 0)
+    const char &ch = buffer[i];
+    if ((ch != '\n') && (ch != '\r'))
+    {
+      audio_profile_cmd += ::toupper(ch);
+      continue;
+    }
+    if (audio_profile_cmd == "STATS")
+    {
+      ostringstream os;
+      AudioProfiler::report(os);
+      audio_profile_pty->write(os.str().c_str(), os.str().size());
+    }
+    else if (audio_profile_cmd == "PERF")
     {
-      buf[len] = 0;
-      logfile_write(buf);
+      ostringstream os;
+      AudioPerfCounters::report(os);
+      audio_profile_pty->write(os.str().c_str(), os.str().size());
     }
-  } while (len > 0);
-} /* stdout_handler  */
+    else if (audio_profile_cmd == "LATENCY")
+    {
+      ostringstream os;
+      AudioLatencyTrace::report(os);
+      AudioLatencyBudget::report(os);
+      audio_profile_pty->write(os.str().c_str(), os.str().size());
+    }
+    else if (audio_profile_cmd == "RESET")
+    {
+      AudioProfiler::reset();
+      AudioPerfCounters::reset();
+      AudioLatencyTrace::reset();
+    }
+    else if (!audio_profile_cmd.empty())
+    {
+      const char *msg =
+        "*** Unknown command. Use STATS, PERF, LATENCY or RESET.\n";
+      audio_profile_pty->write(msg, strlen(msg));
+    }
+    audio_profile_cmd.clear();
+  }
+} /* audio_profile_pty_handler */
 
 
 static void initialize_logics(Config &cfg)
@@ -772,9 +967,29 @@ static void initialize_logics(Config &cfg)
       delete logic;
       continue;
     }
+    startup_phase_done("Logic " + logic_name);
     
     logic_vec.push_back(logic);
   } while (comma != logics.end());
+
+    // Some initialization, like loading the event handler scripts, may
+    // continue in the background while the next logic is initialized. Wait
+    // for it to finish for all logics.
+  vector<LogicBase*>::iterator it = logic_vec.begin();
+  while (it != logic_vec.end())
+  {
+    LogicBase *logic = *it;
+    if (!logic->finishInitialize())
+    {
+      cerr << "*** ERROR: Could not initialize Logic object \""
+      	   << logic->name() << "\". Skipping...\n";
+      delete logic;
+      it = logic_vec.erase(it);
+      continue;
+    }
+    ++it;
+  }
+  startup_phase_done("Event handler scripts");
   
   if (logic_vec.size() == 0)
   {
@@ -784,6 +999,45 @@ static void initialize_logics(Config &cfg)
 } /* initialize_logics */
 
 
+static void startup_phase_done(const string& phase)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long ms = (now.tv_sec - startup_phase_begin.tv_sec) * 1000 +
+            (now.tv_nsec - startup_phase_begin.tv_nsec) / 1000000;
+  cout << "--- Startup: " << phase << " took " << ms << "ms" << endl;
+  startup_phase_begin = now;
+} /* startup_phase_done */
+
+
+static void metrics_http_client_connected(HttpServerConnection *con)
+{
+  con->requestReceived.connect(sigc::ptr_fun(&metrics_http_request_received));
+} /* metrics_http_client_connected */
+
+
+static void metrics_http_request_received(HttpServerConnection *con,
+                                          HttpServerConnection::Request& req)
+{
+  HttpServerConnection::Response res;
+  if ((req.method != "GET") && (req.method != "HEAD"))
+  {
+    res.setCode(501);
+    res.setContent("text/plain", req.method + ": Method not implemented\n");
+    con->write(res);
+    return;
+  }
+  if (req.target != "/metrics")
+  {
+    res.setCode(404);
+    res.setContent("text/plain", "Not found!\n");
+    con->write(res);
+    return;
+  }
+  Metrics::instance().writeHttpResponse(con, req);
+} /* metrics_http_request_received */
+
+
 static void sighup_handler(int signal)
 {
   if (logfile_name == 0)
@@ -791,10 +1045,24 @@ static void sighup_handler(int signal)
     cout << "Ignoring SIGHUP\n";
     return;
   }
-  logfile_reopen("SIGHUP received");
+  log_writer->reopen("SIGHUP received");
 } /* sighup_handler */
 
 
+static void cfg_reloaded(bool success)
+{
+  if (success)
+  {
+    cout << "Configuration reloaded\n";
+  }
+  else
+  {
+    cerr << "*** WARNING: Failed to reload the configuration. "
+            "Keeping the old configuration.\n";
+  }
+} /* cfg_reloaded */
+
+
 static void sigterm_handler(int signal)
 {
   const char *signame = 0;
@@ -813,7 +1081,7 @@ static void sigterm_handler(int signal)
   string msg("\n");
   msg += signame;
   msg += " received. Shutting down application...\n";
-  logfile_write(msg.c_str());
+  cout << msg << flush;
   Application::app().quit();
 } /* sigterm_handler */
 
@@ -833,127 +1101,13 @@ static void handle_unix_signal(int signum)
 } /* handle_unix_signal */
 
 
-static bool logfile_open(void)
-{
-  if (logfd != -1)
-  {
-    close(logfd);
-  }
-  
-  logfd = open(logfile_name, O_WRONLY | O_APPEND | O_CREAT, 00644);
-  if (logfd == -1)
-  {
-    cerr << "open(\"" << logfile_name << "\"): " << strerror(errno) << endl;
-    return false;
-  }
-
-  return true;
-  
-} /* logfile_open */
-
-
-static void logfile_reopen(const char *reason)
-{
-  logfile_write_timestamp();
-  string msg(reason);
-  msg += ". Reopening logfile\n";
-  if (write(logfd, msg.c_str(), msg.size()) == -1) {}
-
-  logfile_open();
-
-  logfile_write_timestamp();
-  msg = reason;
-  msg += ". Logfile reopened\n";
-  if (write(logfd, msg.c_str(), msg.size()) == -1) {}
-} /* logfile_reopen */
-
-
-static bool logfile_write_timestamp(void)
-{
-  if (!tstamp_format.empty())
-  {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    string fmt(tstamp_format);
-    const string frac_code("%f");
-    size_t pos = fmt.find(frac_code);
-    if (pos != string::npos)
-    {
-      stringstream ss;
-      ss << setfill('0') << setw(3) << (tv.tv_usec / 1000);
-      fmt.replace(pos, frac_code.length(), ss.str());
-    }
-    struct tm *tm = localtime(&tv.tv_sec);
-    char tstr[256];
-    size_t tlen = strftime(tstr, sizeof(tstr), fmt.c_str(), tm);
-    ssize_t ret = write(logfd, tstr, tlen);
-    if (ret != static_cast<ssize_t>(tlen))
-    {
-      return false;
-    }
-    ret = write(logfd, ": ", 2);
-    if (ret != 2)
-    {
-      return false;
-    }
-  }
-  return true;
-} /* logfile_write_timestamp */
-
-
-static void logfile_write(const char *buf)
-{
-  if (logfd == -1)
-  {
-    cout << buf;
-    return;
-  }
-  
-  const char *ptr = buf;
-  while (*ptr != 0)
-  {
-    static bool print_timestamp = true;
-    ssize_t ret;
-    
-    if (print_timestamp)
-    {
-      if (!logfile_write_timestamp())
-      {
-        logfile_reopen("Write error");
-        return;
-      }
-      print_timestamp = false;
-    }
-
-    size_t write_len = 0;
-    const char *nl = strchr(ptr, '\n');
-    if (nl != 0)
-    {
-      write_len = nl-ptr+1;
-      print_timestamp = true;
-    }
-    else
-    {
-      write_len = strlen(ptr);
-    }
-    ret = write(logfd, ptr, write_len);
-    if (ret != static_cast<ssize_t>(write_len))
-    {
-      logfile_reopen("Write error");
-      return;
-    }
-    ptr += write_len;
-  }
-} /* logfile_write */
-
-
 static void logfile_flush(void)
 {
   cout.flush();
   cerr.flush();
-  if (stdout_watch != 0)
+  if (log_writer != 0)
   {
-    stdout_handler(stdout_watch);
+    log_writer->flush();
   }
 } /*  logfile_flush */
 
@@ -0,0 +1,326 @@
+/**
+@file	 svxsoundpack.cpp
+@brief   Build a sound pack from a directory of sound clips
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+This application read all sound clips, .wav, .raw and .gsm files, in a sound
+clip directory tree and write them to one sound pack file. The sound pack is
+loaded by SvxLink using the MSG_SOUND_PACK configuration variable.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <popt.h>
+#include <string.h>
+#include <errno.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSampleRate.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "MsgHandler.h"
+#include "SoundPack.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define PROGRAM_NAME "svxsoundpack"
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static const char *parse_arguments(int argc, const char **argv);
+static bool add_dir(const string& dir, const string& rel,
+                    SoundPack::Clips& clips);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+static char *output_str = 0;
+static char *root_str = 0;
+static int sample_rate = DEFAULT_INTERNAL_SAMPLE_RATE;
+static int verbose = 0;
+
+
+/****************************************************************************
+ *
+ * MAIN
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  main
+ * Purpose:   Start everything...
+ * Input:     argc  - The number of arguments passed to this program
+ *    	      	      including the program name.
+ *    	      argv  - The arguments passed to this program. argv[0] is the
+ *    	      	      program name.
+ * Output:    Return 0 on success, else non-zero.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2026-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+int main(int argc, const char *argv[])
+{
+  const char *sound_dir = parse_arguments(argc, argv);
+  if ((sound_dir == 0) || (output_str == 0))
+  {
+    cerr << "Usage: " PROGRAM_NAME " --output=<pack file> [--root=<dir>] "
+            "[--sample-rate=<rate>] [--verbose] <sound clip directory>\n";
+    exit(1);
+  }
+  if (sample_rate <= 0)
+  {
+    cerr << "*** ERROR: Illegal sample rate " << sample_rate << endl;
+    exit(1);
+  }
+
+    // The clips are looked up using the path SvxLink would have played them
+    // from, which by default is the directory the pack is built from
+  const string root((root_str != 0) ? root_str : sound_dir);
+  if (root.empty() || (root[0] != '/'))
+  {
+    cerr << "*** ERROR: The root directory must be an absolute path. "
+            "Use --root to set it.\n";
+    exit(1);
+  }
+
+  SoundPack::Clips clips;
+  if (!add_dir(sound_dir, "", clips))
+  {
+    exit(1);
+  }
+
+  string errmsg;
+  if (!SoundPack::write(output_str, root, sample_rate, clips, errmsg))
+  {
+    cerr << "*** ERROR: " << errmsg << endl;
+    exit(1);
+  }
+
+  size_t sample_cnt = 0;
+  for (SoundPack::Clips::const_iterator it = clips.begin();
+       it != clips.end(); ++it)
+  {
+    sample_cnt += it->second.size();
+  }
+  cout << "Wrote " << clips.size() << " clips, "
+       << sample_cnt / sample_rate << " seconds of audio, to \""
+       << output_str << "\"\n";
+
+  return 0;
+
+} /* main */
+
+
+
+/****************************************************************************
+ *
+ * Functions
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  parse_arguments
+ * Purpose:   Parse the command line arguments.
+ * Input:     argc  - Number of arguments in the command line
+ *    	      argv  - Array of strings with the arguments
+ * Output:    Returns the sound clip directory or 0 if not given.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2026-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+static const char *parse_arguments(int argc, const char **argv)
+{
+  poptContext optCon;
+  const struct poptOption optionsTable[] =
+  {
+    POPT_AUTOHELP
+    {"output", 'o', POPT_ARG_STRING, &output_str, 0,
+            "The sound pack file to write", "<file>"},
+    {"root", 'r', POPT_ARG_STRING, &root_str, 0,
+            "The directory SvxLink will play the clips from "
+            "(default the sound clip directory)", "<dir>"},
+    {"sample-rate", 's', POPT_ARG_INT, &sample_rate, 0,
+            "The sample rate of the sound clips", "<rate>"},
+    {"verbose", 'v', POPT_ARG_NONE, &verbose, 0,
+            "Print the name of each clip added", NULL},
+    {NULL, 0, 0, NULL, 0}
+  };
+  int err;
+
+  optCon = poptGetContext(PROGRAM_NAME, argc, argv, optionsTable, 0);
+  poptReadDefaultConfig(optCon, 0);
+
+  err = poptGetNextOpt(optCon);
+  if (err != -1)
+  {
+    fprintf(stderr, "\t%s: %s\n",
+	    poptBadOption(optCon, POPT_BADOPTION_NOALIAS),
+	    poptStrerror(err));
+    exit(1);
+  }
+
+  static string sound_dir;
+  const char *arg = poptGetArg(optCon);
+  if (arg != 0)
+  {
+    sound_dir = arg;
+  }
+
+  poptFreeContext(optCon);
+
+  return sound_dir.empty() ? 0 : sound_dir.c_str();
+
+} /* parse_arguments */
+
+
+/*
+ * Decode all sound clips in the given directory and its subdirectories
+ */
+static bool add_dir(const string& dir, const string& rel,
+                    SoundPack::Clips& clips)
+{
+  DIR *dp = opendir(dir.c_str());
+  if (dp == 0)
+  {
+    cerr << "*** ERROR: Could not open sound clip directory \""
+         << dir << "\": " << strerror(errno) << endl;
+    return false;
+  }
+
+  bool ok = true;
+  struct dirent *ent;
+  while (ok && ((ent = readdir(dp)) != 0))
+  {
+    if (ent->d_name[0] == '.')
+    {
+      continue;
+    }
+    const string path = dir + "/" + ent->d_name;
+    const string name = rel + ent->d_name;
+    struct stat st;
+    if (stat(path.c_str(), &st) == -1)
+    {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode))
+    {
+      ok = add_dir(path, name + "/", clips);
+      continue;
+    }
+    const char *ext = strrchr(ent->d_name, '.');
+    if (!S_ISREG(st.st_mode) || (ext == 0) ||
+        ((strcmp(ext, ".wav") != 0) && (strcmp(ext, ".gsm") != 0) &&
+         (strcmp(ext, ".raw") != 0)))
+    {
+      continue;
+    }
+
+    vector<short>& samples = clips[name];
+    if (!MsgHandler::decodeClip(path, samples))
+    {
+      cerr << "*** WARNING: Could not decode sound clip \"" << path
+           << "\". Skipping it.\n";
+      clips.erase(name);
+      continue;
+    }
+    if (verbose)
+    {
+      cout << name << ": " << samples.size() << " samples\n";
+    }
+  }
+  closedir(dp);
+
+  return ok;
+
+} /* add_dir */
+
+
+
+/*
+ * This file has not been truncated
+ */
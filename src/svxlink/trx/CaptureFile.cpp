@@ -0,0 +1,224 @@
+/**
+@file   CaptureFile.cpp
+@brief  Read 16 bit audio captures from WAV or raw files
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <stdint.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSampleRate.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "CaptureFile.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define READ_BLOCK_SIZE 256
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+bool CaptureFile::open(const std::string &path, int raw_channels)
+{
+  m_ifs.open(path.c_str(), ios::in | ios::binary);
+  if (!m_ifs.is_open())
+  {
+    cerr << "*** ERROR: Could not open capture file \"" << path << "\": "
+         << strerror(errno) << endl;
+    return false;
+  }
+
+  char riff[12];
+  m_ifs.read(riff, sizeof(riff));
+  if (!m_ifs.good() || (memcmp(riff, "RIFF", 4) != 0) ||
+      (memcmp(riff + 8, "WAVE", 4) != 0))
+  {
+      // Not a WAV file. Read it as raw samples.
+    m_ifs.clear();
+    m_ifs.seekg(0);
+    m_channels = raw_channels;
+    return true;
+  }
+
+    // Find the data subchunk. The format subchunk is checked on the way.
+  for (;;)
+  {
+    unsigned char subchunk[8];
+    m_ifs.read(reinterpret_cast<char*>(subchunk), sizeof(subchunk));
+    if (!m_ifs.good())
+    {
+      cerr << "*** ERROR: No data found in WAV file \"" << path << "\"\n";
+      return false;
+    }
+    uint32_t size = subchunk[4] | (subchunk[5] << 8) |
+                    (subchunk[6] << 16) | (subchunk[7] << 24);
+    if (memcmp(subchunk, "data", 4) == 0)
+    {
+      if (m_channels == 0)
+      {
+        cerr << "*** ERROR: No format found in WAV file \"" << path
+             << "\"\n";
+        return false;
+      }
+      return true;
+    }
+    if ((memcmp(subchunk, "fmt ", 4) == 0) && (size >= 16))
+    {
+      unsigned char fmt[16];
+      m_ifs.read(reinterpret_cast<char*>(fmt), sizeof(fmt));
+      unsigned channels = fmt[2] | (fmt[3] << 8);
+      unsigned rate = fmt[4] | (fmt[5] << 8) | (fmt[6] << 16) | (fmt[7] << 24);
+      unsigned bits = fmt[14] | (fmt[15] << 8);
+      if ((fmt[0] != 1) || (fmt[1] != 0) || (channels == 0) ||
+          (rate != static_cast<unsigned>(INTERNAL_SAMPLE_RATE)) ||
+          (bits != 16))
+      {
+        cerr << "*** ERROR: The WAV file \"" << path << "\" must be "
+             << "16 bit PCM sampled at " << INTERNAL_SAMPLE_RATE << "Hz\n";
+        return false;
+      }
+      m_channels = channels;
+      size -= sizeof(fmt);
+    }
+    m_ifs.seekg(size + (size & 1), ios::cur);
+  }
+} /* CaptureFile::open */
+
+
+int CaptureFile::read(float *samples, int max_frames)
+{
+  int frames = 0;
+  while (frames < max_frames)
+  {
+    int16_t buf[READ_BLOCK_SIZE];
+    int cnt = min(max_frames - frames, READ_BLOCK_SIZE / m_channels);
+    m_ifs.read(reinterpret_cast<char*>(buf), cnt * m_channels * sizeof(*buf));
+    cnt = m_ifs.gcount() / (m_channels * sizeof(*buf));
+    if (cnt <= 0)
+    {
+      break;
+    }
+    for (int i=0; i<cnt*m_channels; ++i)
+    {
+      *samples++ = static_cast<float>(buf[i]) / 32768.0f;
+    }
+    frames += cnt;
+  }
+  return frames;
+} /* CaptureFile::read */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,150 @@
+/**
+@file   CaptureFile.h
+@brief  Read 16 bit audio captures from WAV or raw files
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef CAPTURE_FILE_INCLUDED
+#define CAPTURE_FILE_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <fstream>
+#include <string>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Read 16 bit audio captures from WAV or raw files
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class read captured audio, stored as 16 bit PCM samples at the internal
+sample rate, for the tools that run receiver measurements on recordings
+instead of on live audio. A WAV file may have any number of channels. A file
+without a RIFF/WAVE header is read as raw interleaved samples with the number
+of channels given to the open function.
+*/
+class CaptureFile
+{
+  public:
+    /**
+     * @brief   Default constructor
+     */
+    CaptureFile(void) : m_channels(0) {}
+
+    /**
+     * @brief   Open a capture file
+     * @param   path          The path to the file
+     * @param   raw_channels  The number of channels in a raw file
+     * @return  Returns \em true on success or else \em false
+     *
+     * An error message is printed if the file could not be opened or if a
+     * WAV file is not 16 bit PCM sampled at the internal sample rate.
+     */
+    bool open(const std::string &path, int raw_channels=1);
+
+    /**
+     * @brief   Get the number of channels in the file
+     * @return  Returns the number of channels
+     */
+    int channels(void) const { return m_channels; }
+
+    /**
+     * @brief   Read sample frames from the file
+     * @param   samples     The buffer to put interleaved samples in, which
+     *                      must hold max_frames * channels() samples
+     * @param   max_frames  The maximum number of frames to read
+     * @return  Returns the number of frames read, 0 at the end of the file
+     *
+     * The samples are converted to floats in the range -1.0 to 1.0.
+     */
+    int read(float *samples, int max_frames);
+
+  private:
+    std::ifstream m_ifs;
+    int           m_channels;
+
+    CaptureFile(const CaptureFile&);
+    CaptureFile& operator=(const CaptureFile&);
+
+};  /* class CaptureFile */
+
+
+#endif /* CAPTURE_FILE_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
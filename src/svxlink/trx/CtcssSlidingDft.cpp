@@ -0,0 +1,411 @@
+/**
+@file   CtcssSlidingDft.cpp
+@brief  A CTCSS detector using sliding DFTs on a decimated signal
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a CTCSS detector that evaluate a number of tones using
+sliding DFTs on a decimated signal, giving a new detection decision every few
+milliseconds.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cmath>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSampleRate.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "CtcssSlidingDft.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+const float CtcssSlidingDft::EIA_TONES[] =
+{
+   67.0,  69.3,  71.9,  74.4,  77.0,  79.7,  82.5,  85.4,  88.5,  91.5,
+   94.8,  97.4, 100.0, 103.5, 107.2, 110.9, 114.8, 118.8, 123.0, 127.3,
+  131.8, 136.5, 141.3, 146.2, 151.4, 156.7, 159.8, 162.2, 165.5, 167.9,
+  171.3, 173.8, 177.3, 179.9, 183.5, 186.2, 189.9, 192.8, 196.6, 199.5,
+  203.5, 206.5, 210.7, 218.1, 225.7, 229.1, 233.6, 241.8, 250.3, 254.1
+};
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+CtcssSlidingDft::CtcssSlidingDft(float bw_hz, float passband_bw_hz)
+  : bw(bw_hz), passband_bw(passband_bw_hz), win_len(0), win_pos(0),
+    energy(0.0), dec_fact(INTERNAL_SAMPLE_RATE / 1000), dec_sum(0.0f),
+    dec_cnt(0), hop_left(HOP_LEN), snr_left(0),
+    open_thresh(15.0f), close_thresh(9.0f),
+    detect_count(DEFAULT_DETECT_COUNT), undetect_count(DEFAULT_UNDETECT_COUNT),
+    strongest(-1)
+{
+  const float samp_rate = static_cast<float>(INTERNAL_SAMPLE_RATE) / dec_fact;
+  win_len = max(HOP_LEN, static_cast<int>(lrintf(samp_rate / bw)));
+  bw = samp_rate / win_len;
+  win.assign(win_len, 0.0f);
+  snr_left = win_len;
+} /* CtcssSlidingDft::CtcssSlidingDft */
+
+
+CtcssSlidingDft::~CtcssSlidingDft(void)
+{
+} /* CtcssSlidingDft::~CtcssSlidingDft */
+
+
+int CtcssSlidingDft::addTone(float fq)
+{
+  for (size_t i=0; i<tones.size(); ++i)
+  {
+    if (fabsf(tones[i].fq - fq) < 0.05f)
+    {
+      return i;
+    }
+  }
+
+  const double w = 2.0 * M_PI * fq * dec_fact / INTERNAL_SAMPLE_RATE;
+  bins.ph_re.push_back(1.0);
+  bins.ph_im.push_back(0.0);
+  bins.step_re.push_back(cos(w));
+  bins.step_im.push_back(-sin(w));
+  bins.rot_re.push_back(cos(w * win_len));
+  bins.rot_im.push_back(sin(w * win_len));
+  bins.sum_re.push_back(0.0);
+  bins.sum_im.push_back(0.0);
+  bins.pwr.push_back(0.0);
+
+  Tone tone;
+  tone.fq = fq;
+
+    // The gain of the sum and dump decimator at the tone frequency, divided
+    // by the sum length
+  const double a = M_PI * fq / INTERNAL_SAMPLE_RATE;
+  double gain = sin(a * dec_fact) / (dec_fact * sin(a));
+  tone.gain_comp = 1.0 / (gain * gain);
+
+  tone.snr = 0.0f;
+  tone.active = false;
+  tone.count = 0;
+  int idx = tones.size();
+  for (size_t i=0; i<tones.size(); ++i)
+  {
+    if (fabsf(tones[i].fq - fq) < bw)
+    {
+      tones[i].neighbours.push_back(idx);
+      tone.neighbours.push_back(i);
+    }
+  }
+  tones.push_back(tone);
+
+  return idx;
+} /* CtcssSlidingDft::addTone */
+
+
+void CtcssSlidingDft::addEiaTones(void)
+{
+  for (int i=0; i<EIA_TONE_CNT; ++i)
+  {
+    addTone(EIA_TONES[i]);
+  }
+} /* CtcssSlidingDft::addEiaTones */
+
+
+void CtcssSlidingDft::setThresholds(float open_thresh, float close_thresh)
+{
+  this->open_thresh = open_thresh;
+  this->close_thresh = close_thresh;
+} /* CtcssSlidingDft::setThresholds */
+
+
+void CtcssSlidingDft::setDetectDelay(int delay_ms)
+{
+  if (delay_ms > 0)
+  {
+    detect_count = max(1, (delay_ms + HOP_LEN - 1) / HOP_LEN);
+  }
+  else
+  {
+    detect_count = DEFAULT_DETECT_COUNT;
+  }
+} /* CtcssSlidingDft::setDetectDelay */
+
+
+void CtcssSlidingDft::setUndetectDelay(int delay_ms)
+{
+  if (delay_ms > 0)
+  {
+    undetect_count = max(1, (delay_ms + HOP_LEN - 1) / HOP_LEN);
+  }
+  else
+  {
+    undetect_count = DEFAULT_UNDETECT_COUNT;
+  }
+} /* CtcssSlidingDft::setUndetectDelay */
+
+
+void CtcssSlidingDft::reset(void)
+{
+  fill(win.begin(), win.end(), 0.0f);
+  win_pos = 0;
+  energy = 0.0;
+  dec_sum = 0.0f;
+  dec_cnt = 0;
+  hop_left = HOP_LEN;
+  snr_left = win_len;
+  for (vector<Tone>::iterator it = tones.begin(); it != tones.end(); ++it)
+  {
+    it->snr = 0.0f;
+    it->active = false;
+    it->count = 0;
+  }
+  fill(bins.ph_re.begin(), bins.ph_re.end(), 1.0);
+  fill(bins.ph_im.begin(), bins.ph_im.end(), 0.0);
+  fill(bins.sum_re.begin(), bins.sum_re.end(), 0.0);
+  fill(bins.sum_im.begin(), bins.sum_im.end(), 0.0);
+  strongest = -1;
+} /* CtcssSlidingDft::reset */
+
+
+int CtcssSlidingDft::writeSamples(const float *buf, int len)
+{
+  for (int i=0; i<len; ++i)
+  {
+    dec_sum += buf[i];
+    if (++dec_cnt == dec_fact)
+    {
+      processSample(dec_sum / dec_fact);
+      dec_sum = 0.0f;
+      dec_cnt = 0;
+    }
+  }
+  return len;
+} /* CtcssSlidingDft::writeSamples */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void CtcssSlidingDft::processSample(float x)
+{
+    // Slide the window one sample. For each tone, the bin is updated by
+    // adding the new sample and removing the oldest one, both mixed down
+    // using the phase they had when entering the window.
+  const float old_x = win[win_pos];
+  win[win_pos] = x;
+  if (++win_pos == win_len)
+  {
+    win_pos = 0;
+  }
+  energy += static_cast<double>(x) * x - static_cast<double>(old_x) * old_x;
+
+  const int cnt = tones.size();
+  double *ph_re = &bins.ph_re[0];
+  double *ph_im = &bins.ph_im[0];
+  double *sum_re = &bins.sum_re[0];
+  double *sum_im = &bins.sum_im[0];
+  const double *step_re = &bins.step_re[0];
+  const double *step_im = &bins.step_im[0];
+  const double *rot_re = &bins.rot_re[0];
+  const double *rot_im = &bins.rot_im[0];
+  for (int i=0; i<cnt; ++i)
+  {
+    double dr = x - old_x * rot_re[i];
+    double di = -old_x * rot_im[i];
+    double pr = ph_re[i];
+    double pi = ph_im[i];
+    sum_re[i] += pr * dr - pi * di;
+    sum_im[i] += pr * di + pi * dr;
+    ph_re[i] = pr * step_re[i] - pi * step_im[i];
+    ph_im[i] = pr * step_im[i] + pi * step_re[i];
+  }
+
+  if (--hop_left == 0)
+  {
+    hop_left = HOP_LEN;
+
+      // Keep the magnitude of the phasors from drifting
+    for (size_t i=0; i<tones.size(); ++i)
+    {
+      double mag = sqrt(bins.ph_re[i] * bins.ph_re[i] +
+                        bins.ph_im[i] * bins.ph_im[i]);
+      bins.ph_re[i] /= mag;
+      bins.ph_im[i] /= mag;
+    }
+
+    decide();
+  }
+} /* CtcssSlidingDft::processSample */
+
+
+void CtcssSlidingDft::decide(void)
+{
+  const double N = win_len;
+  const double Ppassband = max(energy, 0.0) / N;
+  const double noise_bins = (passband_bw - bw) / bw;
+
+  for (size_t i=0; i<tones.size(); ++i)
+  {
+    bins.pwr[i] = (bins.sum_re[i] * bins.sum_re[i] +
+                   bins.sum_im[i] * bins.sum_im[i]) * tones[i].gain_comp;
+  }
+
+  int new_strongest = -1;
+  for (size_t i=0; i<tones.size(); ++i)
+  {
+    Tone &tone = tones[i];
+
+      // Estimate the SNR in the same way as ToneDetector do it
+    double Ptone = 2.0 * bins.pwr[i] / (N * N);
+    double Pnoise = (Ppassband - Ptone) / noise_bins;
+    tone.snr = 70.0f;
+    if (Pnoise > 0.0)
+    {
+      tone.snr = (Ptone > 0.0) ? 10.0 * log10(Ptone / Pnoise) : -70.0f;
+    }
+
+      // A tone must also be stronger than all other evaluated tones within
+      // the detection bandwidth. With many tones evaluated, for example
+      // when scanning all EIA tones, this keep a strong tone from being
+      // detected as one of its neighbours.
+    bool is_peak = true;
+    for (size_t j=0; j<tone.neighbours.size() && is_peak; ++j)
+    {
+      is_peak = (bins.pwr[tone.neighbours[j]] <= bins.pwr[i]);
+    }
+
+    bool change = tone.active ? (!is_peak || (tone.snr < close_thresh))
+                              : (is_peak && (tone.snr > open_thresh));
+    tone.count = change ? tone.count + 1 : 0;
+    if (change && (tone.count >= (tone.active ? undetect_count
+                                              : detect_count)))
+    {
+      tone.active = !tone.active;
+      tone.count = 0;
+      activated(i, tone.active);
+    }
+
+    if (tone.active &&
+        ((new_strongest < 0) || (tone.snr > tones[new_strongest].snr)))
+    {
+      new_strongest = i;
+    }
+  }
+
+  if (new_strongest != strongest)
+  {
+    strongest = new_strongest;
+    strongestToneChanged((strongest >= 0) ? tones[strongest].fq : 0.0f);
+  }
+
+  snr_left -= HOP_LEN;
+  if ((snr_left <= 0) && !tones.empty())
+  {
+    snr_left += win_len;
+    snrUpdated(tones[0].snr);
+  }
+} /* CtcssSlidingDft::decide */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,316 @@
+/**
+@file   CtcssSlidingDft.h
+@brief  A CTCSS detector using sliding DFTs on a decimated signal
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a CTCSS detector that evaluate a number of tones using
+sliding DFTs on a decimated signal, giving a new detection decision every few
+milliseconds.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef CTCSS_SLIDING_DFT_INCLUDED
+#define CTCSS_SLIDING_DFT_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSink.h>
+#include <AsyncAudioSampleRate.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A CTCSS detector using sliding DFTs on a decimated signal
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This detector first decimate the incoming audio down to 1kHz sampling rate,
+using a simple sum and dump stage. The input should already have been band
+pass filtered to the CTCSS band. For each tone, a DFT bin over the latest
+window of samples is kept up to date using a sliding DFT, costing a couple of
+complex multiplications per tone and decimated sample. Every HOP_LEN decimated
+samples (10ms) the SNR of each tone is estimated in the same way as the
+"Estimated SNR" mode of the ToneDetector, comparing the tone power with the
+total passband power. A tone goes active when its SNR have been above the open
+threshold, and inactive when it has been below the close threshold, for the
+configured number of decisions.
+
+Since the window slide, the decision time resolution is the hop length and
+not the window length. Evaluating another tone is cheap so it is possible to
+scan all the 50 standard EIA CTCSS tones in one pass to find out which tone,
+if any, is present on the input.
+*/
+class CtcssSlidingDft : public sigc::trackable, public Async::AudioSink
+{
+  public:
+    /**
+     * @brief The 50 standard EIA CTCSS tone frequencies
+     */
+    static const float EIA_TONES[];
+
+    /**
+     * @brief The number of tones in EIA_TONES
+     */
+    static const int EIA_TONE_CNT = 50;
+
+    /**
+     * @brief 	Constuctor
+     * @param 	bw_hz The detection bandwidth in Hz
+     * @param   passband_bw_hz The bandwidth of the input band pass filter
+     *
+     * The detection bandwidth set the length of the sliding window. A
+     * narrower bandwidth give a longer window and so a slower detector.
+     */
+    CtcssSlidingDft(float bw_hz, float passband_bw_hz);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~CtcssSlidingDft(void);
+
+    /**
+     * @brief 	Add a tone to detect
+     * @param 	fq The tone frequency in Hz
+     * @return	Returns the index of the tone
+     *
+     * If the tone has already been added, the index of the existing tone is
+     * returned.
+     */
+    int addTone(float fq);
+
+    /**
+     * @brief 	Add all EIA tones that have not already been added
+     */
+    void addEiaTones(void);
+
+    /**
+     * @brief 	Get the number of tones that are evaluated
+     * @return	Returns the number of tones
+     */
+    int toneCount(void) const { return tones.size(); }
+
+    /**
+     * @brief 	Get the frequency of a tone
+     * @param 	idx The index of the tone
+     * @return	Returns the frequency of the tone in Hz
+     */
+    float toneFq(int idx) const { return tones[idx].fq; }
+
+    /**
+     * @brief 	Check if a tone is active
+     * @param 	idx The index of the tone
+     * @return	Returns \em true if the tone is active
+     */
+    bool isActive(int idx) const { return tones[idx].active; }
+
+    /**
+     * @brief 	Get the latest estimated SNR for a tone
+     * @param 	idx The index of the tone
+     * @return	Returns the SNR in dB
+     */
+    float lastSnr(int idx) const { return tones[idx].snr; }
+
+    /**
+     * @brief 	Get the index of the strongest active tone
+     * @return	Returns the tone index or -1 if no tone is active
+     */
+    int strongestTone(void) const { return strongest; }
+
+    /**
+     * @brief 	Set the SNR thresholds
+     * @param 	open_thresh The SNR in dB for a tone to go active
+     * @param 	close_thresh The SNR in dB for an active tone to go inactive
+     */
+    void setThresholds(float open_thresh, float close_thresh);
+
+    /**
+     * @brief 	Set the detection delay
+     * @param 	delay_ms The time the SNR must be over the open threshold
+     *
+     * If set to zero or less, the default delay will be used.
+     */
+    void setDetectDelay(int delay_ms);
+
+    /**
+     * @brief 	Set the undetection delay
+     * @param 	delay_ms The time the SNR must be under the close threshold
+     *
+     * If set to zero or less, the default delay will be used.
+     */
+    void setUndetectDelay(int delay_ms);
+
+    /**
+     * @brief 	Reset the detector
+     */
+    void reset(void);
+
+    /**
+     * @brief 	Write samples into the detector
+     * @param 	buf The buffer containing the samples
+     * @param 	len The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *buf, int len);
+
+    /**
+     * @brief 	Tell the sink to flush the previously written samples
+     */
+    virtual void flushSamples(void) { sourceAllSamplesFlushed(); }
+
+    /**
+     * @brief  A signal that is emitted when a tone changes state
+     * @param  idx The index of the tone
+     * @param  is_active \em true if the tone went active or \em false if not
+     */
+    sigc::signal<void, int, bool> activated;
+
+    /**
+     * @brief  A signal that is emitted when the strongest active tone change
+     * @param  fq The frequency of the tone or 0 if no tone is active
+     */
+    sigc::signal<void, float> strongestToneChanged;
+
+    /**
+     * @brief  A signal that is emitted when the SNR of the first tone change
+     * @param  snr The current SNR in dB
+     *
+     * To not flood receivers of this signal, it is emitted once for each
+     * window length and not for every decision.
+     */
+    sigc::signal<void, float> snrUpdated;
+
+  private:
+    static const int    HOP_LEN = 10;
+    static const int    DEFAULT_DETECT_COUNT = 3;
+    static const int    DEFAULT_UNDETECT_COUNT = 5;
+
+    struct Tone
+    {
+      float             fq;
+      float             gain_comp;  // Decimator gain compensation
+      float             snr;
+      bool              active;
+      int               count;
+      std::vector<int>  neighbours; // Other tones within the bandwidth
+    };
+
+      // The sliding DFT state is kept in separate arrays, one entry per
+      // tone, so that the update loop can be vectorized by the compiler
+    struct Bins
+    {
+      std::vector<double> ph_re;    // e^(-jwn) for the current sample
+      std::vector<double> ph_im;
+      std::vector<double> step_re;  // e^(-jw)
+      std::vector<double> step_im;
+      std::vector<double> rot_re;   // e^(jwN), the phase of x(n-N)
+      std::vector<double> rot_im;
+      std::vector<double> sum_re;   // The sliding DFT bin
+      std::vector<double> sum_im;
+      std::vector<double> pwr;      // Compensated bin power
+    };
+
+    float               bw;
+    float               passband_bw;
+    int                 win_len;
+    std::vector<Tone>   tones;
+    Bins                bins;
+    std::vector<float>  win;
+    int                 win_pos;
+    double              energy;
+    int                 dec_fact;   // Decimate to 1kHz
+    float               dec_sum;
+    int                 dec_cnt;
+    int                 hop_left;
+    int                 snr_left;
+    float               open_thresh;
+    float               close_thresh;
+    int                 detect_count;
+    int                 undetect_count;
+    int                 strongest;
+
+    CtcssSlidingDft(const CtcssSlidingDft&);
+    CtcssSlidingDft& operator=(const CtcssSlidingDft&);
+    void processSample(float x);
+    void decide(void);
+
+};  /* class CtcssSlidingDft */
+
+
+#endif /* CTCSS_SLIDING_DFT_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
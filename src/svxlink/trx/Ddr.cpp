@@ -51,6 +51,16 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iterator>
 #include <deque>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DDR_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DDR_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
 
 /****************************************************************************
  *
@@ -61,6 +71,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncConfig.h>
 #include <AsyncAudioSource.h>
 #include <AsyncTcpClient.h>
+#include <AsyncAudioCpuFeatures.h>
+#ifdef ASYNC_AUDIO_PROFILING
+#include <AsyncAudioPerfCounters.h>
+#endif
 
 
 /****************************************************************************
@@ -72,6 +86,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "Ddr.h"
 #include "WbRxRtlSdr.h"
 #include "DdrFilterCoeffs.h"
+#include "PolyphaseChannelizer.h"
 
 
 /****************************************************************************
@@ -101,6 +116,141 @@ using namespace Async;
  ****************************************************************************/
 
 namespace {
+  /**
+   * @brief Run a real valued decimating FIR filter over split complex samples
+   * @param out     The output samples
+   * @param num_out The number of output samples to produce
+   * @param coeff   The filter coefficients, in oldest to newest sample order
+   * @param len     The number of taps, a multiple of four
+   * @param xr      Real part of the samples for the first FIR sum
+   * @param xi      Imaginary part of the samples for the first FIR sum
+   * @param D       The decimation factor
+   *
+   * Output sample m is the FIR sum over xr[m*D]..xr[m*D+len-1] and the same
+   * for xi. The kernels are instantiated for the decimation factors used by
+   * the channelizers so that the input stride is a compile time constant.
+   */
+  typedef void (*FirDecFunc)(complex<float> *out, int num_out,
+                             const float *coeff, int len,
+                             const float *xr, const float *xi, int D);
+
+  template <int D>
+  void fir_dec_scalar_t(complex<float> *out, int num_out, const float *coeff,
+                      int len, const float *xr, const float *xi, int d=D)
+  {
+    for (int m=0; m<num_out; ++m, xr+=d, xi+=d)
+    {
+      float sr[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      float si[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for (int i=0; i<len; i+=4)
+      {
+        for (int k=0; k<4; ++k)
+        {
+          sr[k] += coeff[i+k] * xr[i+k];
+          si[k] += coeff[i+k] * xi[i+k];
+        }
+      }
+      out[m] = complex<float>((sr[0] + sr[1]) + (sr[2] + sr[3]),
+                              (si[0] + si[1]) + (si[2] + si[3]));
+    }
+  }
+
+#ifdef DDR_SIMD_X86
+  template <int D>
+  __attribute__((target("sse2")))
+  void fir_dec_sse2_t(complex<float> *out, int num_out, const float *coeff,
+                    int len, const float *xr, const float *xi, int d=D)
+  {
+    for (int m=0; m<num_out; ++m, xr+=d, xi+=d)
+    {
+      __m128 sr = _mm_setzero_ps();
+      __m128 si = _mm_setzero_ps();
+      for (int i=0; i<len; i+=4)
+      {
+        __m128 c = _mm_loadu_ps(coeff + i);
+        sr = _mm_add_ps(sr, _mm_mul_ps(c, _mm_loadu_ps(xr + i)));
+        si = _mm_add_ps(si, _mm_mul_ps(c, _mm_loadu_ps(xi + i)));
+      }
+        // Horizontal sums of both accumulators
+      __m128 lo = _mm_unpacklo_ps(sr, si);
+      __m128 hi = _mm_unpackhi_ps(sr, si);
+      __m128 s = _mm_add_ps(lo, hi);
+      s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+      _mm_storel_pi(reinterpret_cast<__m64*>(out + m), s);
+    }
+  }
+#endif
+
+#ifdef DDR_SIMD_NEON
+  template <int D>
+  void fir_dec_neon_t(complex<float> *out, int num_out, const float *coeff,
+                    int len, const float *xr, const float *xi, int d=D)
+  {
+    for (int m=0; m<num_out; ++m, xr+=d, xi+=d)
+    {
+      float32x4_t sr = vdupq_n_f32(0.0f);
+      float32x4_t si = vdupq_n_f32(0.0f);
+      for (int i=0; i<len; i+=4)
+      {
+        float32x4_t c = vld1q_f32(coeff + i);
+        sr = vmlaq_f32(sr, c, vld1q_f32(xr + i));
+        si = vmlaq_f32(si, c, vld1q_f32(xi + i));
+      }
+      float32x2_t s = vpadd_f32(
+          vadd_f32(vget_low_f32(sr), vget_high_f32(sr)),
+          vadd_f32(vget_low_f32(si), vget_high_f32(si)));
+      vst1_f32(reinterpret_cast<float*>(out + m), s);
+    }
+  }
+#endif
+
+#define DDR_FIR_DEC_DISPATCH(kernel) \
+  void kernel(complex<float> *out, int num_out, const float *coeff, \
+              int len, const float *xr, const float *xi, int D) \
+  { \
+    switch (D) \
+    { \
+      case 1: kernel ## _t<1>(out, num_out, coeff, len, xr, xi); break; \
+      case 2: kernel ## _t<2>(out, num_out, coeff, len, xr, xi); break; \
+      case 3: kernel ## _t<3>(out, num_out, coeff, len, xr, xi); break; \
+      case 4: kernel ## _t<4>(out, num_out, coeff, len, xr, xi); break; \
+      case 5: kernel ## _t<5>(out, num_out, coeff, len, xr, xi); break; \
+      case 6: kernel ## _t<6>(out, num_out, coeff, len, xr, xi); break; \
+      default: kernel ## _t<0>(out, num_out, coeff, len, xr, xi, D); break; \
+    } \
+  }
+
+  DDR_FIR_DEC_DISPATCH(fir_dec_scalar)
+#ifdef DDR_SIMD_X86
+  DDR_FIR_DEC_DISPATCH(fir_dec_sse2)
+#endif
+#ifdef DDR_SIMD_NEON
+  DDR_FIR_DEC_DISPATCH(fir_dec_neon)
+#endif
+
+  FirDecFunc fir_dec = 0;
+
+  void selectFirDec(void)
+  {
+    AudioCpuFeatures::addDispatcher(selectFirDec);
+#ifdef DDR_SIMD_X86
+    if (AudioCpuFeatures::has(AudioCpuFeatures::SSE2))
+    {
+      fir_dec = fir_dec_sse2;
+      return;
+    }
+#endif
+#ifdef DDR_SIMD_NEON
+    if (AudioCpuFeatures::has(AudioCpuFeatures::NEON))
+    {
+      fir_dec = fir_dec_neon;
+      return;
+    }
+#endif
+    fir_dec = fir_dec_scalar;
+  }
+
+
   template <class T>
   class Decimator
   {
@@ -185,6 +335,117 @@ namespace {
       vector<float>   coeff;
   };
 
+  /**
+   * The complex decimator is the work horse of the channelizers so it has a
+   * specialized implementation. The delay line is kept as separate real and
+   * imaginary arrays (SoA) in front of the current input block so that the
+   * FIR sums can be calculated directly from it, four taps at a time, using
+   * a SIMD kernel. The coefficients are stored reversed and zero padded to a
+   * multiple of four taps.
+   */
+  template <>
+  class Decimator<complex<float> >
+  {
+    public:
+      Decimator(void) : dec_fact(0), taps(0), len(0), gain(1.0f)
+      {
+        init();
+      }
+
+      Decimator(int dec_fact, const float *coeff, int taps)
+        : dec_fact(dec_fact), taps(taps), len(0), gain(1.0f)
+      {
+        init();
+        setDecimatorParams(dec_fact, coeff, taps);
+      }
+
+      int decFact(void) const { return dec_fact; }
+
+      void setDecimatorParams(int dec_fact, const float *coeff, int taps)
+      {
+        assert(taps >= dec_fact);
+
+        set_coeff.assign(coeff, coeff + taps);
+        this->dec_fact = dec_fact;
+        this->taps = taps;
+        len = (taps + 3) & ~3;
+        gain = 1.0f;
+        updateCoeff();
+
+        hist_r.assign(len - 1, 0.0f);
+        hist_i.assign(len - 1, 0.0f);
+      }
+
+      void setGain(double gain_adjust)
+      {
+        gain = pow(10.0, gain_adjust / 20.0);
+        updateCoeff();
+      }
+
+      void decimate(vector<complex<float> > &out,
+                    const vector<complex<float> > &in)
+      {
+          // this implementation assumes in.size() is a multiple of factor_M
+        assert(in.size() % dec_fact == 0);
+
+        int num_in = in.size();
+        int num_out = num_in / dec_fact;
+        out.resize(num_out);
+        if (num_in == 0)
+        {
+          return;
+        }
+
+          // Append the new samples, split into real and imaginary parts,
+          // after the len-1 samples of history from the last block
+        hist_r.resize(len - 1 + num_in);
+        hist_i.resize(len - 1 + num_in);
+        float *xr = &hist_r[len - 1];
+        float *xi = &hist_i[len - 1];
+        for (int i=0; i<num_in; ++i)
+        {
+          xr[i] = in[i].real();
+          xi[i] = in[i].imag();
+        }
+
+        fir_dec(&out[0], num_out, &rcoeff[0], len, &hist_r[dec_fact - 1],
+                &hist_i[dec_fact - 1], dec_fact);
+
+          // Keep the newest len-1 samples as history for the next block
+        copy(hist_r.end() - (len - 1), hist_r.end(), hist_r.begin());
+        copy(hist_i.end() - (len - 1), hist_i.end(), hist_i.begin());
+        hist_r.resize(len - 1);
+        hist_i.resize(len - 1);
+      }
+
+    private:
+      int             dec_fact;
+      int             taps;
+      int             len;
+      float           gain;
+      vector<float>   set_coeff;
+      vector<float>   rcoeff;
+      vector<float>   hist_r;
+      vector<float>   hist_i;
+
+      void init(void)
+      {
+        if (fir_dec == 0)
+        {
+          selectFirDec();
+        }
+      }
+
+      void updateCoeff(void)
+      {
+        rcoeff.assign(len, 0.0f);
+        for (int tap=0; tap<taps; ++tap)
+        {
+          rcoeff[len - 1 - tap] = gain * set_coeff[tap];
+        }
+      }
+  };
+
   template <class T>
   class DecimatorMS
   {
@@ -244,13 +505,13 @@ namespace {
       virtual int decFact(void) const { return d1.decFact() * d2.decFact(); }
       virtual void decimate(vector<T> &out, const vector<T> &in)
       {
-        vector<T> dec_samp1;
         d1.decimate(dec_samp1, in);
         d2.decimate(out, dec_samp1);
       }
 
     private:
       Decimator<T> &d1, &d2;
+      vector<T> dec_samp1;
   };
 
   template <class T>
@@ -266,7 +527,6 @@ namespace {
       }
       virtual void decimate(vector<T> &out, const vector<T> &in)
       {
-        vector<T> dec_samp1, dec_samp2;
         d1.decimate(dec_samp1, in);
         d2.decimate(dec_samp2, dec_samp1);
         d3.decimate(out, dec_samp2);
@@ -274,6 +534,7 @@ namespace {
 
     private:
       Decimator<T> &d1, &d2, &d3;
+      vector<T> dec_samp1, dec_samp2;
   };
 
   template <class T>
@@ -290,7 +551,6 @@ namespace {
       }
       virtual void decimate(vector<T> &out, const vector<T> &in)
       {
-        vector<T> dec_samp1, dec_samp2, dec_samp3;
         d1.decimate(dec_samp1, in);
         d2.decimate(dec_samp2, dec_samp1);
         d3.decimate(dec_samp3, dec_samp2);
@@ -299,6 +559,7 @@ namespace {
 
     private:
       Decimator<T> &d1, &d2, &d3, &d4;
+      vector<T> dec_samp1, dec_samp2, dec_samp3;
   };
 
   template <class T>
@@ -316,7 +577,6 @@ namespace {
       }
       virtual void decimate(vector<T> &out, const vector<T> &in)
       {
-        vector<T> dec_samp1, dec_samp2, dec_samp3, dec_samp4;
         d1.decimate(dec_samp1, in);
         d2.decimate(dec_samp2, dec_samp1);
         d3.decimate(dec_samp3, dec_samp2);
@@ -326,92 +586,313 @@ namespace {
 
     private:
       Decimator<T> &d1, &d2, &d3, &d4, &d5;
+      vector<T> dec_samp1, dec_samp2, dec_samp3, dec_samp4;
   };
 
+  template <class T>
+  DecimatorMS<T> *createDecimatorMS(const vector<Decimator<T>*> &stages)
+  {
+    switch (stages.size())
+    {
+      case 0:
+        return new DecimatorMS0<T>;
+      case 1:
+        return new DecimatorMS1<T>(*stages[0]);
+      case 2:
+        return new DecimatorMS2<T>(*stages[0], *stages[1]);
+      case 3:
+        return new DecimatorMS3<T>(*stages[0], *stages[1], *stages[2]);
+      case 4:
+        return new DecimatorMS4<T>(*stages[0], *stages[1], *stages[2],
+                                   *stages[3]);
+      case 5:
+        return new DecimatorMS5<T>(*stages[0], *stages[1], *stages[2],
+                                   *stages[3], *stages[4]);
+    }
+    assert(!"createDecimatorMS: Too many decimation stages");
+    return 0;
+  }
 
+
+  /**
+   * @brief Mix a block of complex samples with a rotating phasor
+   * @param out   The output buffer (may be the same as in)
+   * @param in    The input samples
+   * @param len   The number of samples to mix
+   * @param wr    Real part of the phasors for four consecutive samples
+   * @param wi    Imaginary part of the phasors for four consecutive samples
+   * @param s4r   Real part of the phasor step for four samples
+   * @param s4i   Imaginary part of the phasor step for four samples
+   *
+   * The phasors for sample n..n+3 are kept in separate lanes so that the
+   * kernels can process four samples per iteration. The phasor lanes are
+   * advanced by four sample steps after each iteration. The lanes are not
+   * written back since the caller reseeds them for each block.
+   */
+  typedef void (*NcoMixFunc)(complex<float> *out, const complex<float> *in,
+                             int len, const float *wr, const float *wi,
+                             float s4r, float s4i);
+
+  void nco_mix_scalar(complex<float> *out, const complex<float> *in,
+                      int len, const float *wr, const float *wi,
+                      float s4r, float s4i)
+  {
+    float pr[4] = { wr[0], wr[1], wr[2], wr[3] };
+    float pi[4] = { wi[0], wi[1], wi[2], wi[3] };
+    for (int i=0; i<len; i+=4)
+    {
+      int cnt = min(4, len - i);
+      for (int k=0; k<cnt; ++k)
+      {
+        float re = in[i+k].real();
+        float im = in[i+k].imag();
+        out[i+k] = complex<float>(re * pr[k] - im * pi[k],
+                                  re * pi[k] + im * pr[k]);
+      }
+      for (int k=0; k<4; ++k)
+      {
+        float r = pr[k] * s4r - pi[k] * s4i;
+        pi[k] = pr[k] * s4i + pi[k] * s4r;
+        pr[k] = r;
+      }
+    }
+  }
+
+#ifdef DDR_SIMD_X86
+  __attribute__((target("sse2")))
+  void nco_mix_sse2(complex<float> *out, const complex<float> *in,
+                    int len, const float *wr, const float *wi,
+                    float s4r, float s4i)
+  {
+    const float *src = reinterpret_cast<const float*>(in);
+    float *dst = reinterpret_cast<float*>(out);
+    __m128 pr = _mm_loadu_ps(wr);
+    __m128 pi = _mm_loadu_ps(wi);
+    const __m128 sr = _mm_set1_ps(s4r);
+    const __m128 si = _mm_set1_ps(s4i);
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+        // Deinterleave four complex samples into real and imaginary lanes
+      __m128 x0 = _mm_loadu_ps(src + 2 * i);
+      __m128 x1 = _mm_loadu_ps(src + 2 * i + 4);
+      __m128 re = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 im = _mm_shuffle_ps(x0, x1, _MM_SHUFFLE(3, 1, 3, 1));
+      __m128 ore = _mm_sub_ps(_mm_mul_ps(re, pr), _mm_mul_ps(im, pi));
+      __m128 oim = _mm_add_ps(_mm_mul_ps(re, pi), _mm_mul_ps(im, pr));
+      _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(ore, oim));
+      _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(ore, oim));
+      __m128 npr = _mm_sub_ps(_mm_mul_ps(pr, sr), _mm_mul_ps(pi, si));
+      pi = _mm_add_ps(_mm_mul_ps(pr, si), _mm_mul_ps(pi, sr));
+      pr = npr;
+    }
+    if (i < len)
+    {
+      float tr[4], ti[4];
+      _mm_storeu_ps(tr, pr);
+      _mm_storeu_ps(ti, pi);
+      nco_mix_scalar(out + i, in + i, len - i, tr, ti, s4r, s4i);
+    }
+  }
+#endif
+
+#ifdef DDR_SIMD_NEON
+  void nco_mix_neon(complex<float> *out, const complex<float> *in,
+                    int len, const float *wr, const float *wi,
+                    float s4r, float s4i)
+  {
+    const float *src = reinterpret_cast<const float*>(in);
+    float *dst = reinterpret_cast<float*>(out);
+    float32x4_t pr = vld1q_f32(wr);
+    float32x4_t pi = vld1q_f32(wi);
+    const float32x4_t sr = vdupq_n_f32(s4r);
+    const float32x4_t si = vdupq_n_f32(s4i);
+    int i = 0;
+    for (; i + 4 <= len; i += 4)
+    {
+      float32x4x2_t x = vld2q_f32(src + 2 * i);
+      float32x4x2_t o;
+      o.val[0] = vmlsq_f32(vmulq_f32(x.val[0], pr), x.val[1], pi);
+      o.val[1] = vmlaq_f32(vmulq_f32(x.val[0], pi), x.val[1], pr);
+      vst2q_f32(dst + 2 * i, o);
+      float32x4_t npr = vmlsq_f32(vmulq_f32(pr, sr), pi, si);
+      pi = vmlaq_f32(vmulq_f32(pr, si), pi, sr);
+      pr = npr;
+    }
+    if (i < len)
+    {
+      float tr[4], ti[4];
+      vst1q_f32(tr, pr);
+      vst1q_f32(ti, pi);
+      nco_mix_scalar(out + i, in + i, len - i, tr, ti, s4r, s4i);
+    }
+  }
+#endif
+
+  NcoMixFunc nco_mix = 0;
+
+  void selectNcoMix(void)
+  {
+    AudioCpuFeatures::addDispatcher(selectNcoMix);
+#ifdef DDR_SIMD_X86
+    if (AudioCpuFeatures::has(AudioCpuFeatures::SSE2))
+    {
+      nco_mix = nco_mix_sse2;
+      return;
+    }
+#endif
+#ifdef DDR_SIMD_NEON
+    if (AudioCpuFeatures::has(AudioCpuFeatures::NEON))
+    {
+      nco_mix = nco_mix_neon;
+      return;
+    }
+#endif
+    nco_mix = nco_mix_scalar;
+  }
+
+
+  /**
+   * @brief Frequency translate complex samples using an NCO
+   *
+   * The mixing phasor is generated by a phase accumulator which is kept in
+   * double precision and advanced one block at a time. Within a block the
+   * phasor is rotated in single precision, four samples per step, which
+   * keeps the amplitude and phase error well below the sample resolution.
+   * A zero offset is a pass-through that does not touch the samples.
+   */
   class Translate
   {
     public:
       Translate(unsigned samp_rate, int offset)
-        : samp_rate(samp_rate), n(0)
+        : samp_rate(samp_rate), active(false), rot(1.0, 0.0)
       {
+        if (nco_mix == 0)
+        {
+          selectNcoMix();
+        }
         setOffset(offset);
       }
 
       void setOffset(int offset)
       {
-        n = 0;
-        exp_lut.clear();
-        if (offset == 0)
+        rot = complex<double>(1.0, 0.0);
+        active = (offset != 0);
+        double omega = -2.0 * M_PI * offset / samp_rate;
+        for (int k=0; k<4; ++k)
         {
-          return;
+          step[k] = polar(1.0, omega * k);
         }
-        unsigned N = samp_rate / gcd(samp_rate, abs(offset));
-        //cout << "### Translate: offset=" << offset << " N=" << N << endl;
-        exp_lut.resize(N);
-        for (unsigned i=0; i<N; ++i)
+        complex<double> s4 = polar(1.0, omega * 4);
+        step4r = s4.real();
+        step4i = s4.imag();
+        step_blk = polar(1.0, omega * BLOCK_SIZE);
+        this->omega = omega;
+      }
+
+        // Translate the given samples in place
+      void iq_received(vector<WbRxRtlSdr::Sample> &samples)
+      {
+        if (active && !samples.empty())
         {
-          complex<float> e(0.0f, -2.0*M_PI*offset*i/samp_rate);
-          exp_lut[i] = exp(e);
+          process(&samples[0], &samples[0], samples.size());
         }
       }
 
-      void iq_received(vector<WbRxRtlSdr::Sample> &out,
-                       const vector<WbRxRtlSdr::Sample> &in)
+        // Translate into the out buffer. The input vector itself is returned
+        // when no translation is needed so that no copy has to be made.
+      const vector<WbRxRtlSdr::Sample> &iq_received(
+          vector<WbRxRtlSdr::Sample> &out,
+          const vector<WbRxRtlSdr::Sample> &in)
       {
-        if (exp_lut.size() > 0)
+        if (!active)
         {
-          out.clear();
-          out.reserve(in.size());
-          vector<WbRxRtlSdr::Sample>::const_iterator it;
-          for (it = in.begin(); it != in.end(); ++it)
-          {
-            out.push_back(*it * exp_lut[n]);
-            if (++n == exp_lut.size())
-            {
-              n = 0;
-            }
-          }
+          return in;
         }
-        else
+        out.resize(in.size());
+        if (!in.empty())
         {
-          out = in;
+          process(&out[0], &in[0], in.size());
         }
+        return out;
       }
 
     private:
-      unsigned samp_rate;
-      vector<complex<float> > exp_lut;
-      unsigned n;
-
-      /**
-       * @brief Find the greatest common divisor for two numbers
-       * @param dividend The larger number
-       * @param divisor The lesser number
-       *
-       * This function will return the greatest common divisor of the two given
-       * numbers. This implementation requires that the dividend is larger than
-       * the divisor.
-       */
-      unsigned gcd(unsigned dividend, unsigned divisor)
+      static const int BLOCK_SIZE = 64;
+
+      unsigned                samp_rate;
+      bool                    active;
+      double                  omega;
+      complex<double>         rot;
+      complex<double>         step[4];
+      complex<double>         step_blk;
+      float                   step4r;
+      float                   step4i;
+
+      void process(WbRxRtlSdr::Sample *out, const WbRxRtlSdr::Sample *in,
+                   int len)
       {
-        unsigned reminder = dividend % divisor;
-        if (reminder == 0)
+        int pos = 0;
+        while (pos < len)
         {
-          return divisor;
+          int cnt = min(static_cast<int>(BLOCK_SIZE), len - pos);
+          float wr[4], wi[4];
+          for (int k=0; k<4; ++k)
+          {
+            complex<double> w = rot * step[k];
+            wr[k] = w.real();
+            wi[k] = w.imag();
+          }
+          nco_mix(out + pos, in + pos, cnt, wr, wi, step4r, step4i);
+          if (cnt == BLOCK_SIZE)
+          {
+            rot *= step_blk;
+          }
+          else
+          {
+            rot *= polar(1.0, omega * cnt);
+          }
+          pos += cnt;
         }
-        return gcd(divisor, reminder);
+
+          // Remove the slow amplitude drift of the accumulated phasor
+        rot /= abs(rot);
       }
   }; /* Translate */
 
 
+  /**
+   * @brief Approximate atan2 in single precision
+   * @param y The imaginary part
+   * @param x The real part
+   * @return Returns the angle in radians, in the range -pi to pi
+   *
+   * A ninth order polynomial is used for the arctangent of the octant. The
+   * maximum error is about 1.2e-5 radians, which is far below the noise
+   * floor of the demodulated audio. The function is written without
+   * branches so that the compiler can vectorize loops calling it.
+   */
+  inline float fastAtan2(float y, float x)
+  {
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float a = min(ax, ay) / (max(ax, ay) + 1.0e-30f);
+    float s = a * a;
+    float r = ((((0.0208351f * s - 0.0851330f) * s + 0.1801410f) * s
+               - 0.3302995f) * s + 0.9998660f) * a;
+    r = (ay > ax) ? static_cast<float>(M_PI_2) - r : r;
+    r = (x < 0.0f) ? static_cast<float>(M_PI) - r : r;
+    return (y < 0.0f) ? -r : r;
+  }
+
+
   class AGC
   {
     public:
       AGC(float attack=1.0e1, float decay=1.0e-2, float max_gain=2.0e2,
           float reference=0.25f)
         : m_attack(attack), m_decay(decay), m_max_gain(max_gain),
-          m_reference(reference), m_gain(1.0f)
+          m_reference(reference), m_gain(1.0f), m_block_size(1)
       {
 
       }
@@ -420,9 +901,22 @@ namespace {
       void setDecay(float decay) { m_decay = decay; }
       void setAttack(float attack) { m_attack = attack; }
 
+        // With a block size larger than one, the gain is held constant
+        // over each block and the gain loop is run on the mean block power
+      void setBlockSize(unsigned block_size)
+      {
+        m_block_size = max(block_size, 1U);
+      }
+
       void iq_received(vector<WbRxRtlSdr::Sample> &out,
                        const vector<WbRxRtlSdr::Sample> &in)
       {
+        if (m_block_size > 1)
+        {
+          blockReceived(out, in);
+          return;
+        }
+
         out.clear();
         out.reserve(in.size());
         float P = 0.0f;
@@ -434,37 +928,70 @@ namespace {
           WbRxRtlSdr::Sample osamp = m_gain * samp;
           P = osamp.real() * osamp.real() + osamp.imag() * osamp.imag();
           out.push_back(osamp);
+          updateGain(P);
+        }
+        //cout << "### P=" << P << "  m_gain=" << m_gain << endl;
+      }
 
-          float err = m_reference - P;
-          float rate;
-          if (err > 0.0f)
-          {
-            rate = m_decay * err;
-          }
-          else
-          {
-            rate = m_attack * err;
-          }
-          m_gain += rate;
-          if (m_gain < 0.0f)
+    private:
+      float     m_attack;
+      float     m_decay;
+      float     m_max_gain;
+      float     m_reference;
+      float     m_gain;
+      unsigned  m_block_size;
+
+      void updateGain(float P)
+      {
+        float err = m_reference - P;
+        float rate;
+        if (err > 0.0f)
+        {
+          rate = m_decay * err;
+        }
+        else
+        {
+          rate = m_attack * err;
+        }
+        m_gain += rate;
+        if (m_gain < 0.0f)
+        {
+          m_gain = 0.0f;
+        }
+        else if (m_gain > m_max_gain)
+        {
+          m_gain = m_max_gain;
+        }
+      }
+
+      void blockReceived(vector<WbRxRtlSdr::Sample> &out,
+                         const vector<WbRxRtlSdr::Sample> &in)
+      {
+        out.resize(in.size());
+        const float *src = reinterpret_cast<const float *>(&in[0]);
+        float *dst = reinterpret_cast<float *>(&out[0]);
+        for (size_t pos = 0; pos < in.size(); pos += m_block_size)
+        {
+          size_t cnt = min(static_cast<size_t>(m_block_size),
+                           in.size() - pos);
+          float gain = m_gain;
+          float in_pwr = 0.0f;
+          for (size_t i = 2 * pos; i < 2 * (pos + cnt); ++i)
           {
-            m_gain = 0.0f;
+            in_pwr += src[i] * src[i];
+            dst[i] = gain * src[i];
           }
-          else if (m_gain > m_max_gain)
+          in_pwr /= cnt;
+
+            // Run the gain loop once per sample, as if all samples in the
+            // block had the mean block power, to keep the time constants
+          for (size_t i = 0; i < cnt; ++i)
           {
-            m_gain = m_max_gain;
+            updateGain(m_gain * m_gain * in_pwr);
           }
         }
-        //cout << "### P=" << P << "  m_gain=" << m_gain << endl;
       }
 
-    private:
-      float   m_attack;
-      float   m_decay;
-      float   m_max_gain;
-      float   m_reference;
-      float   m_gain;
-
   }; /* AGC */
 
 
@@ -503,7 +1030,7 @@ namespace {
   {
     public:
       DemodulatorFm(unsigned samp_rate, double max_dev)
-        : iold(1.0f), qold(1.0f),
+        : iold(1.0f), qold(1.0f), use_fast(false),
           audio_dec(2, coeff_dec_audio_32k_16k, coeff_dec_audio_32k_16k_cnt),
           dec(0)
       {
@@ -553,8 +1080,16 @@ namespace {
         dec->setGain(adj_db);
       }
 
+      void setFastDiscriminator(bool fast) { use_fast = fast; }
+
       void iq_received(vector<WbRxRtlSdr::Sample> samples)
       {
+        if (use_fast)
+        {
+          fastDiscriminator(samples);
+          return;
+        }
+
           // From article-sdr-is-qs.pdf: Watch your Is and Qs:
           //   FM = (Qn.In-1 - In.Qn-1)/(In.In-1 + Qn.Qn-1)
           //
@@ -586,9 +1121,42 @@ namespace {
     private:
       float iold;
       float qold;
+      bool  use_fast;
       Decimator<float> audio_dec_wb;
       Decimator<float> audio_dec;
       DecimatorMS<float> *dec;
+      vector<float> audio;
+      vector<float> dec_audio;
+
+      void fastDiscriminator(const vector<WbRxRtlSdr::Sample> &samples)
+      {
+          // The angle of the product of the sample and the conjugate of
+          // the previous sample does not depend on the signal amplitude so
+          // no normalization is needed
+        const size_t cnt = samples.size();
+        if (cnt == 0)
+        {
+          return;
+        }
+        audio.resize(cnt);
+        const float *iq = reinterpret_cast<const float *>(&samples[0]);
+        float *out = &audio[0];
+        out[0] = fastAtan2(iq[1]*iold - iq[0]*qold, iq[0]*iold + iq[1]*qold);
+        for (size_t idx=1; idx<cnt; ++idx)
+        {
+          float i = iq[2*idx];
+          float q = iq[2*idx+1];
+          float ip = iq[2*idx-2];
+          float qp = iq[2*idx-1];
+          out[idx] = fastAtan2(q*ip - i*qp, i*ip + q*qp);
+        }
+        iold = iq[2*cnt-2];
+        qold = iq[2*cnt-1];
+
+        dec_audio.clear();
+        dec->decimate(dec_audio, audio);
+        sinkWriteSamples(&dec_audio[0], dec_audio.size());
+      }
   };
 
 
@@ -596,29 +1164,55 @@ namespace {
   {
     public:
       DemodulatorAm(void)
+        : use_fast(false)
       {
         agc.setAttack(1.0e-0);
         agc.setDecay(1.0e-2);
         agc.setReference(1);
       }
 
+      void setFastEnvelope(bool fast)
+      {
+        use_fast = fast;
+        agc.setBlockSize(fast ? AGC_BLOCK_SIZE : 1);
+      }
+
       void iq_received(vector<WbRxRtlSdr::Sample> samples)
       {
-        vector<WbRxRtlSdr::Sample> gain_adjusted;
         agc.iq_received(gain_adjusted, samples);
 
-        vector<float> audio;
-        for (size_t idx=0; idx<gain_adjusted.size(); ++idx)
+        if (use_fast)
         {
-          complex<float> samp = gain_adjusted[idx];
-          float demod = abs(samp);
-          audio.push_back(demod);
+            // Plain single precision magnitude instead of the overflow safe
+            // hypot used by std::abs
+          audio.resize(gain_adjusted.size());
+          const float *iq = reinterpret_cast<const float *>(
+              gain_adjusted.empty() ? 0 : &gain_adjusted[0]);
+          for (size_t idx=0; idx<audio.size(); ++idx)
+          {
+            audio[idx] = sqrtf(iq[2*idx]*iq[2*idx] + iq[2*idx+1]*iq[2*idx+1]);
+          }
+        }
+        else
+        {
+          audio.clear();
+          for (size_t idx=0; idx<gain_adjusted.size(); ++idx)
+          {
+            complex<float> samp = gain_adjusted[idx];
+            float demod = abs(samp);
+            audio.push_back(demod);
+          }
         }
         sinkWriteSamples(&audio[0], audio.size());
       }
 
     private:
-      AGC              agc;
+      static const unsigned AGC_BLOCK_SIZE = 16;
+
+      AGC                         agc;
+      bool                        use_fast;
+      vector<WbRxRtlSdr::Sample>  gain_adjusted;
+      vector<float>               audio;
   };
 
 
@@ -695,13 +1289,13 @@ namespace {
         vector<WbRxRtlSdr::Sample> gain_adjusted;
         agc.iq_received(gain_adjusted, samples);
 
-        vector<WbRxRtlSdr::Sample> translated;
-        trans.iq_received(translated, gain_adjusted);
+        trans.iq_received(gain_adjusted);
 
         vector<float> audio;
         audio.reserve(gain_adjusted.size());
-        for (vector<WbRxRtlSdr::Sample>::const_iterator it = translated.begin();
-             it != translated.end();
+        for (vector<WbRxRtlSdr::Sample>::const_iterator it =
+               gain_adjusted.begin();
+             it != gain_adjusted.end();
              ++it)
         {
           float demod = it->real();
@@ -733,12 +1327,12 @@ namespace {
         vector<WbRxRtlSdr::Sample> gain_adjusted;
         agc.iq_received(gain_adjusted, samples);
 
-        vector<WbRxRtlSdr::Sample> translated;
-        trans.iq_received(translated, gain_adjusted);
+        trans.iq_received(gain_adjusted);
         vector<float> audio;
-        audio.reserve(translated.size());
-        for (vector<WbRxRtlSdr::Sample>::const_iterator it = translated.begin();
-             it != translated.end();
+        audio.reserve(gain_adjusted.size());
+        for (vector<WbRxRtlSdr::Sample>::const_iterator it =
+               gain_adjusted.begin();
+             it != gain_adjusted.end();
              ++it)
         {
           float demod = it->real();
@@ -770,10 +1364,16 @@ namespace {
       sigc::signal<void, const std::vector<RtlTcp::Sample>&> preDemod;
   };
 
+  /**
+   * The channelizers run a cascade of decimators. If the first decimation
+   * stage is done by the shared polyphase channelizer in the WBRX
+   * (pfb_input=true), the input is one bin output and the first stage is
+   * left out.
+   */
   class Channelizer960 : public Channelizer
   {
     public:
-      Channelizer960(void)
+      explicit Channelizer960(bool pfb_input=false)
         : dec_960k_192k(5, coeff_dec_960k_192k, coeff_dec_960k_192k_cnt),
           dec_192k_64k( 3, coeff_dec_192k_64k,  coeff_dec_192k_64k_cnt ),
           dec_64k_32k(  2, coeff_dec_64k_32k,   coeff_dec_64k_32k_cnt  ),
@@ -784,7 +1384,7 @@ namespace {
           ch_filt_6k(   1, coeff_nbam_channel,  coeff_nbam_channel_cnt ),
           ch_filt_3k(   1, coeff_ssb_channel,   coeff_ssb_channel_cnt  ),
           ch_filt_500(  1, coeff_cw_channel,    coeff_cw_channel_cnt   ),
-          dec(0)
+          dec(0), pfb_input(pfb_input)
       {
         setBw(BW_20K);
       }
@@ -798,48 +1398,50 @@ namespace {
       {
         delete dec;
         dec = 0;
+        vector<Decimator<complex<float> >*> stages;
+        stages.push_back(&dec_960k_192k);
         switch (bw)
         {
           case BW_WIDE:
-            dec = new DecimatorMS1<complex<float> >(dec_960k_192k);
-            return;
+            break;
           case BW_20K:
-            dec = new DecimatorMS4<complex<float> >(dec_960k_192k,
-                                                    dec_192k_64k,
-                                                    dec_64k_32k, 
-                                                    ch_filt);
-            return;
+            stages.push_back(&dec_192k_64k);
+            stages.push_back(&dec_64k_32k);
+            stages.push_back(&ch_filt);
+            break;
           case BW_10K:
-            dec = new DecimatorMS4<complex<float> >(dec_960k_192k,
-                                                    dec_192k_48k,
-                                                    dec_48k_16k,
-                                                    ch_filt_narr);
-            return;
+            stages.push_back(&dec_192k_48k);
+            stages.push_back(&dec_48k_16k);
+            stages.push_back(&ch_filt_narr);
+            break;
           case BW_6K:
-            dec = new DecimatorMS4<complex<float> >(dec_960k_192k,
-                                                    dec_192k_48k,
-                                                    dec_48k_16k,
-                                                    ch_filt_6k);
-            return;
+            stages.push_back(&dec_192k_48k);
+            stages.push_back(&dec_48k_16k);
+            stages.push_back(&ch_filt_6k);
+            break;
           case BW_3K:
-            dec = new DecimatorMS4<complex<float> >(dec_960k_192k,
-                                                    dec_192k_48k,
-                                                    dec_48k_16k,
-                                                    ch_filt_3k);
-            return;
+            stages.push_back(&dec_192k_48k);
+            stages.push_back(&dec_48k_16k);
+            stages.push_back(&ch_filt_3k);
+            break;
           case BW_500:
-            dec = new DecimatorMS4<complex<float> >(dec_960k_192k,
-                                                    dec_192k_48k,
-                                                    dec_48k_16k,
-                                                    ch_filt_500);
-            return;
+            stages.push_back(&dec_192k_48k);
+            stages.push_back(&dec_48k_16k);
+            stages.push_back(&ch_filt_500);
+            break;
+          default:
+            assert(!"Channelizer::setBw: Unknown bandwidth");
+        }
+        if (pfb_input)
+        {
+          stages.erase(stages.begin());
         }
-        assert(!"Channelizer::setBw: Unknown bandwidth");
+        dec = createDecimatorMS(stages);
       }
 
       virtual unsigned chSampRate(void) const
       {
-        return 960000 / dec->decFact();
+        return (pfb_input ? 192000 : 960000) / dec->decFact();
       }
 
       virtual void iq_received(vector<WbRxRtlSdr::Sample> &out,
@@ -861,12 +1463,13 @@ namespace {
       Decimator<complex<float> >    ch_filt_3k;
       Decimator<complex<float> >    ch_filt_500;
       DecimatorMS<complex<float> >  *dec;
+      bool                          pfb_input;
   };
 
   class Channelizer2400 : public Channelizer
   {
     public:
-      Channelizer2400(void)
+      explicit Channelizer2400(bool pfb_input=false)
         : dec_2400k_800k(3, coeff_dec_2400k_800k, coeff_dec_2400k_800k_cnt),
           dec_800k_160k (5, coeff_dec_800k_160k,  coeff_dec_800k_160k_cnt ),
           dec_160k_32k  (5, coeff_dec_160k_32k,   coeff_dec_160k_32k_cnt  ),
@@ -876,7 +1479,7 @@ namespace {
           ch_filt_6k    (1, coeff_nbam_channel,   coeff_nbam_channel_cnt  ),
           ch_filt_3k    (1, coeff_ssb_channel,    coeff_ssb_channel_cnt   ),
           ch_filt_500   (1, coeff_cw_channel,     coeff_cw_channel_cnt    ),
-          dec(0)
+          dec(0), pfb_input(pfb_input)
       {
         setBw(BW_20K);
       }
@@ -890,54 +1493,50 @@ namespace {
       {
         delete dec;
         dec = 0;
-
+        vector<Decimator<complex<float> >*> stages;
+        stages.push_back(&dec_2400k_800k);
+        stages.push_back(&dec_800k_160k);
         switch (bw)
         {
           case BW_WIDE:
-            dec = new DecimatorMS2<complex<float> >(dec_2400k_800k,
-                                                    dec_800k_160k);
-            return;
+            break;
           case BW_20K:
-            dec = new DecimatorMS4<complex<float> >(dec_2400k_800k,
-                                                    dec_800k_160k,
-                                                    dec_160k_32k, 
-                                                    ch_filt);
-            return;
+            stages.push_back(&dec_160k_32k);
+            stages.push_back(&ch_filt);
+            break;
           case BW_10K:
-            dec = new DecimatorMS5<complex<float> >(dec_2400k_800k,
-                                                    dec_800k_160k,
-                                                    dec_160k_32k, 
-                                                    dec_32k_16k,
-                                                    ch_filt_narr);
-            return;
+            stages.push_back(&dec_160k_32k);
+            stages.push_back(&dec_32k_16k);
+            stages.push_back(&ch_filt_narr);
+            break;
           case BW_6K:
-            dec = new DecimatorMS5<complex<float> >(dec_2400k_800k,
-                                                    dec_800k_160k,
-                                                    dec_160k_32k, 
-                                                    dec_32k_16k,
-                                                    ch_filt_6k);
-            return;
+            stages.push_back(&dec_160k_32k);
+            stages.push_back(&dec_32k_16k);
+            stages.push_back(&ch_filt_6k);
+            break;
           case BW_3K:
-            dec = new DecimatorMS5<complex<float> >(dec_2400k_800k,
-                                                    dec_800k_160k,
-                                                    dec_160k_32k,
-                                                    dec_32k_16k,
-                                                    ch_filt_3k);
-            return;
+            stages.push_back(&dec_160k_32k);
+            stages.push_back(&dec_32k_16k);
+            stages.push_back(&ch_filt_3k);
+            break;
           case BW_500:
-            dec = new DecimatorMS5<complex<float> >(dec_2400k_800k,
-                                                    dec_800k_160k,
-                                                    dec_160k_32k,
-                                                    dec_32k_16k,
-                                                    ch_filt_500);
-            return;
+            stages.push_back(&dec_160k_32k);
+            stages.push_back(&dec_32k_16k);
+            stages.push_back(&ch_filt_500);
+            break;
+          default:
+            assert(!"Channelizer::setBw: Unknown bandwidth");
         }
-        assert(!"Channelizer::setBw: Unknown bandwidth");
+        if (pfb_input)
+        {
+          stages.erase(stages.begin());
+        }
+        dec = createDecimatorMS(stages);
       }
 
       virtual unsigned chSampRate(void) const
       {
-        return 2400000 / dec->decFact();
+        return (pfb_input ? 800000 : 2400000) / dec->decFact();
       }
 
       virtual void iq_received(vector<WbRxRtlSdr::Sample> &out,
@@ -958,6 +1557,7 @@ namespace {
       Decimator<complex<float> >    ch_filt_3k;
       Decimator<complex<float> >    ch_filt_500;
       DecimatorMS<complex<float> >  *dec;
+      bool                          pfb_input;
   };
 
 }; /* anonymous namespace */
@@ -966,48 +1566,59 @@ namespace {
 class Ddr::Channel : public sigc::trackable, public Async::AudioSource
 {
   public:
-    Channel(int fq_offset, unsigned sample_rate)
+    Channel(int fq_offset, unsigned sample_rate, PolyphaseChannelizer *pfb)
       : sample_rate(sample_rate), channelizer(0),
         fm_demod(32000, 5000.0), ssb_demod(16000), cw_demod(16000), demod(0),
-        trans(sample_rate, fq_offset), enabled(true), ch_offset(0),
-        fq_offset(fq_offset)
+        trans(sample_rate, 0), enabled(true), ch_offset(0),
+        fq_offset(fq_offset), pfb(pfb), use_pfb(false), bin(0),
+        bin_acquired(false),
+        bin_trans((pfb != 0) ? pfb->binSampRate() : sample_rate, 0)
     {
     }
 
     ~Channel(void)
     {
+      if (bin_acquired)
+      {
+        pfb->releaseBin(bin);
+      }
       delete channelizer;
     }
 
     bool initialize(void)
     {
-      if (sample_rate == 2400000)
+      if (!createChannelizer(pfb != 0))
       {
-        channelizer = new Channelizer2400;
+        return false;
       }
-      else if (sample_rate == 960000)
+      if (pfb != 0)
       {
-        channelizer = new Channelizer960;
-      }
-      else
-      {
-        cout << "*** ERROR: Unsupported tuner sampling rate " << sample_rate
-             << ". Legal values are: 960000 and 2400000\n";
-        return false;
+        pfb->binsReceived.connect(mem_fun(*this, &Channel::binsReceived));
       }
       setModulation(Modulation::MOD_FM);
-      channelizer->preDemod.connect(preDemod.make_slot());
       return true;
     }
 
     void setFqOffset(int fq_offset)
     {
       this->fq_offset = fq_offset;
-      trans.setOffset(fq_offset - ch_offset);
+      if (!use_pfb)
+      {
+        trans.setOffset(fq_offset - ch_offset);
+      }
+      updateBin();
     }
 
     void setModulation(Modulation::Type mod)
     {
+        // A wideband FM channel does not fit inside one channelizer bin so
+        // it must be filtered out from the full wideband signal
+      bool pfb_input = (pfb != 0) && (mod != Modulation::MOD_WBFM);
+      if (pfb_input != use_pfb)
+      {
+        createChannelizer(pfb_input);
+      }
+
       demod = 0;
       ch_offset = 0;
       switch (mod)
@@ -1076,25 +1687,30 @@ class Ddr::Channel : public sigc::trackable, public Async::AudioSource
       return channelizer->chSampRate();
     }
 
-    void iq_received(vector<WbRxRtlSdr::Sample> samples)
+    void setFastDemod(bool fast)
     {
-      if (enabled)
+      fm_demod.setFastDiscriminator(fast);
+      am_demod.setFastEnvelope(fast);
+    }
+
+    void iq_received(const vector<WbRxRtlSdr::Sample> &samples)
+    {
+      if (enabled && !use_pfb)
       {
-        vector<WbRxRtlSdr::Sample> translated, channelized;
-        trans.iq_received(translated, samples);
-        channelizer->iq_received(channelized, translated);
-        demod->iq_received(channelized);
+        processChannel(trans, samples);
       }
     };
 
     void enable(void)
     {
       enabled = true;
+      updateBin();
     }
 
     void disable(void)
     {
       enabled = false;
+      updateBin();
     }
 
     bool isEnabled(void) const { return enabled; }
@@ -1113,6 +1729,99 @@ class Ddr::Channel : public sigc::trackable, public Async::AudioSource
     bool enabled;
     int ch_offset;
     int fq_offset;
+    PolyphaseChannelizer *pfb;
+    bool use_pfb;
+    int bin;
+    bool bin_acquired;
+    Translate bin_trans;
+    vector<WbRxRtlSdr::Sample> translated;
+    vector<WbRxRtlSdr::Sample> channelized;
+
+    bool createChannelizer(bool pfb_input)
+    {
+      delete channelizer;
+      channelizer = 0;
+      if (sample_rate == 2400000)
+      {
+        channelizer = new Channelizer2400(pfb_input);
+      }
+      else if (sample_rate == 960000)
+      {
+        channelizer = new Channelizer960(pfb_input);
+      }
+      else
+      {
+        cout << "*** ERROR: Unsupported tuner sampling rate " << sample_rate
+             << ". Legal values are: 960000 and 2400000\n";
+        return false;
+      }
+      channelizer->preDemod.connect(preDemod.make_slot());
+      use_pfb = pfb_input;
+      return true;
+    }
+
+      // Make sure that the channelizer bin closest to the channel frequency
+      // is acquired when the shared channelizer is in use. The remaining
+      // frequency offset is then corrected at the bin sampling rate.
+    void updateBin(void)
+    {
+      bool want_bin = use_pfb && enabled;
+      int offset = fq_offset - ch_offset;
+      int new_bin = want_bin ? pfb->findBin(offset) : 0;
+      if (bin_acquired && (!want_bin || (new_bin != bin)))
+      {
+        pfb->releaseBin(bin);
+        bin_acquired = false;
+      }
+      if (want_bin && !bin_acquired)
+      {
+        bin = new_bin;
+        pfb->acquireBin(bin);
+        bin_acquired = true;
+      }
+      if (want_bin)
+      {
+        bin_trans.setOffset(offset - pfb->binFq(bin, offset));
+      }
+    }
+
+    void binsReceived(void)
+    {
+      if (bin_acquired)
+      {
+        processChannel(bin_trans, pfb->binSamples(bin));
+      }
+    }
+
+      // Run the translation, channelizer and demodulator stages. When
+      // profiling, each stage is measured separately. The demodulator count
+      // include the audio pipe fed by the demodulator.
+    void processChannel(Translate &t, const vector<WbRxRtlSdr::Sample> &in)
+    {
+      const vector<WbRxRtlSdr::Sample> *ch_in;
+      {
+#ifdef ASYNC_AUDIO_PROFILING
+        static AudioPerfCounters::Stage *perf_stage =
+            AudioPerfCounters::stage("ddr translate");
+        AudioPerfCounters::Probe probe(perf_stage, in.size());
+#endif
+        ch_in = &t.iq_received(translated, in);
+      }
+      {
+#ifdef ASYNC_AUDIO_PROFILING
+        static AudioPerfCounters::Stage *perf_stage =
+            AudioPerfCounters::stage("ddr channelizer");
+        AudioPerfCounters::Probe probe(perf_stage, in.size());
+#endif
+        channelizer->iq_received(channelized, *ch_in);
+      }
+#ifdef ASYNC_AUDIO_PROFILING
+      static AudioPerfCounters::Stage *perf_stage =
+          AudioPerfCounters::stage("ddr demodulator");
+      AudioPerfCounters::Probe probe(perf_stage, channelized.size());
+#endif
+      demod->iq_received(channelized);
+    }
 }; /* Channel */
 
 
@@ -1167,6 +1876,11 @@ Ddr::Ddr(Config &cfg, const std::string& name)
 
 Ddr::~Ddr(void)
 {
+    // The channel must be deleted before unregistering from the WBRX since
+    // it may use the channelizer owned by the WBRX
+  delete channel;
+  channel = 0;
+
   if (rtl != 0)
   {
     rtl->unregisterDdr(this);
@@ -1178,8 +1892,6 @@ Ddr::~Ddr(void)
   {
     ddr_map.erase(it);
   }
-
-  delete channel;
 } /* Ddr::~Ddr */
 
 
@@ -1218,7 +1930,8 @@ bool Ddr::initialize(void)
   }
   rtl->registerDdr(this);
 
-  channel = new Channel(fq-rtl->centerFq(), rtl->sampleRate());
+  channel = new Channel(fq-rtl->centerFq(), rtl->sampleRate(),
+                        rtl->channelizer());
   if (!channel->initialize())
   {
     cout << "*** ERROR: Could not initialize channel object for receiver "
@@ -1228,6 +1941,9 @@ bool Ddr::initialize(void)
     return false;
   }
   channel->preDemod.connect(preDemod.make_slot());
+  bool fast_demod = false;
+  cfg.getValue(name(), "FAST_DEMOD", fast_demod);
+  channel->setFastDemod(fast_demod);
   rtl->iqReceived.connect(mem_fun(*channel, &Channel::iq_received));
   rtl->readyStateChanged.connect(readyStateChanged.make_slot());
 
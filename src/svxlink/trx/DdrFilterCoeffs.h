@@ -1107,6 +1107,92 @@ FILTER_COEFF(coeff_hilbert,
   -0.0000000000000037
 )
 
+/**
+ * n=40; fs=960000; fc=91200;
+ * b=fir1(n-1, fc/(fs/2), kaiser(n, 5));
+ *
+ * Prototype lowpass filter for the polyphase channelizer splitting a 960kHz
+ * wideband signal into 10 bins, 96kHz apart, at 192kHz sampling frequency.
+ * Flat within 0.2dB up to 58kHz. Below -54dB over 134kHz.
+ */
+FILTER_COEFF(coeff_pfb_960k,
+  -0.0004788914540381,
+  -0.0010902674503997,
+  -0.0015021240215465,
+  -0.0010883257095200,
+  0.0006498300460397,
+  0.0036265624679097,
+  0.0068459856842461,
+  0.0084826800493307,
+  0.0065109279836774,
+  -0.0002375508884263,
+  -0.0109888299672436,
+  -0.0224654631420769,
+  -0.0293015958266823,
+  -0.0255358278660248,
+  -0.0068008085820997,
+  0.0275720708636603,
+  0.0734268411890219,
+  0.1222578062122985,
+  0.1633254981649923,
+  0.1867914822468812,
+  0.1867914822468812,
+  0.1633254981649923,
+  0.1222578062122985,
+  0.0734268411890219,
+  0.0275720708636603,
+  -0.0068008085820997,
+  -0.0255358278660248,
+  -0.0293015958266823,
+  -0.0224654631420769,
+  -0.0109888299672436,
+  -0.0002375508884263,
+  0.0065109279836774,
+  0.0084826800493307,
+  0.0068459856842461,
+  0.0036265624679097,
+  0.0006498300460397,
+  -0.0010883257095200,
+  -0.0015021240215465,
+  -0.0010902674503997,
+  -0.0004788914540381
+)
+
+/**
+ * n=24; fs=2400000; fc=380000;
+ * b=fir1(n-1, fc/(fs/2), kaiser(n, 6));
+ *
+ * Prototype lowpass filter for the polyphase channelizer splitting a 2400kHz
+ * wideband signal into 6 bins, 400kHz apart, at 800kHz sampling frequency.
+ * Flat within 0.1dB up to 210kHz. Below -61dB over 590kHz.
+ */
+FILTER_COEFF(coeff_pfb_2400k,
+  -0.0003713686866623,
+  -0.0012141773242954,
+  -0.0000870862262267,
+  0.0053736864835496,
+  0.0106332248862807,
+  0.0034547600434859,
+  -0.0216401093290323,
+  -0.0445117933504827,
+  -0.0234172264344247,
+  0.0679716412359678,
+  0.2017775816810775,
+  0.3020308670207624,
+  0.3020308670207624,
+  0.2017775816810777,
+  0.0679716412359678,
+  -0.0234172264344247,
+  -0.0445117933504827,
+  -0.0216401093290323,
+  0.0034547600434859,
+  0.0106332248862807,
+  0.0053736864835496,
+  -0.0000870862262267,
+  -0.0012141773242954,
+  -0.0003713686866623
+)
+
 
 /****************************************************************************
  *
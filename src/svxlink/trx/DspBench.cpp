@@ -0,0 +1,644 @@
+/**
+@file   DspBench.cpp
+@brief  Microbenchmarks for the audio DSP building blocks
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This program measure how many samples per second a single CPU core can push
+through each of the DSP building blocks used in the SvxLink audio pipes: the
+decimators and interpolators using the SvxLink filter coefficients, the
+AudioFilter designs used in LocalRxBase and LocalTx, the frequency sampling
+filter, the compressor, the mixer, the tone detectors and all available audio
+codecs. The numbers can be used to measure the effect of optimizations and to
+catch performance regressions on different targets.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncCppApplication.h>
+#include <AsyncAudioSource.h>
+#include <AsyncAudioSink.h>
+#include <AsyncAudioPassthrough.h>
+#include <AsyncAudioDecimator.h>
+#include <AsyncAudioInterpolator.h>
+#include <AsyncAudioFilter.h>
+#include <AsyncAudioFsf.h>
+#include <AsyncAudioCompressor.h>
+#include <AsyncAudioMixer.h>
+#include <AsyncAudioEncoder.h>
+#include <AsyncAudioDecoder.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncAudioCpuFeatures.h>
+#include <AsyncAudioSampleOps.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "ToneDetector.h"
+#include "ToneDetectorBank.h"
+#include "CtcssSlidingDft.h"
+#include "multirate_filter_coeff.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define BLOCK_SIZE      256
+#define SIGNAL_SECONDS  1
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+/**
+ * An audio sink that throw away all samples but count them
+ */
+class NullSink : public AudioSink
+{
+  public:
+    NullSink(void) : cnt(0) {}
+    virtual int writeSamples(const float *samples, int count)
+    {
+      cnt += count;
+      return count;
+    }
+    virtual void flushSamples(void) { sourceAllSamplesFlushed(); }
+    unsigned long long cnt;
+};
+
+
+/**
+ * An audio source used to write the test signal into the object under test
+ */
+class BenchSource : public AudioSource
+{
+  public:
+    int write(const float *samples, int count)
+    {
+      return sinkWriteSamples(samples, count);
+    }
+    virtual void resumeOutput(void) {}
+    virtual void allSamplesFlushed(void) {}
+};
+
+
+/**
+ * The base class for a benchmark. The process function is called repeatedly
+ * with one block of the test signal and should return the number of samples
+ * that was processed.
+ */
+class Benchmark
+{
+  public:
+    Benchmark(const string& name, int rate) : m_name(name), m_rate(rate) {}
+    virtual ~Benchmark(void) {}
+    const string& name(void) const { return m_name; }
+    int rate(void) const { return m_rate; }
+    virtual unsigned process(const float *samples, int count) = 0;
+
+  private:
+    string  m_name;
+    int     m_rate;
+};
+
+
+/**
+ * Benchmark a single audio sink, which may also be an audio processor
+ */
+class SinkBenchmark : public Benchmark
+{
+  public:
+    SinkBenchmark(const string& name, int rate, AudioSink *sink,
+                  AudioSource *output=0)
+      : Benchmark(name, rate), sink(sink)
+    {
+      src.registerSink(sink);
+      if (output != 0)
+      {
+        output->registerSink(&null_sink);
+      }
+    }
+    virtual ~SinkBenchmark(void)
+    {
+      src.unregisterSink();
+      delete sink;
+    }
+    virtual unsigned process(const float *samples, int count)
+    {
+      return src.write(samples, count);
+    }
+
+  private:
+    BenchSource   src;
+    AudioSink     *sink;
+    NullSink      null_sink;
+};
+
+
+/**
+ * Benchmark the mixer using two active input streams
+ */
+class MixerBenchmark : public Benchmark
+{
+  public:
+    MixerBenchmark(const string& name, int rate) : Benchmark(name, rate)
+    {
+      src1.registerSink(&pass1);
+      src2.registerSink(&pass2);
+      mixer.addSource(&pass1);
+      mixer.addSource(&pass2);
+      mixer.registerSink(&null_sink);
+    }
+    virtual unsigned process(const float *samples, int count)
+    {
+      unsigned long long prev_cnt = null_sink.cnt;
+      src1.write(samples, count);
+      src2.write(samples, count);
+      mixer.resumeOutput();
+      return null_sink.cnt - prev_cnt;
+    }
+
+  private:
+    BenchSource       src1;
+    BenchSource       src2;
+    AudioPassthrough  pass1;
+    AudioPassthrough  pass2;
+    AudioMixer        mixer;
+    NullSink          null_sink;
+};
+
+
+/**
+ * Benchmark an audio encoder
+ */
+class EncoderBenchmark : public Benchmark
+{
+  public:
+    EncoderBenchmark(const string& name, int rate, AudioEncoder *enc)
+      : Benchmark(name, rate), enc(enc), bytes(0)
+    {
+      enc->writeEncodedSamples.connect(
+          sigc::mem_fun(*this, &EncoderBenchmark::onEncoded));
+      src.registerSink(enc);
+    }
+    virtual ~EncoderBenchmark(void)
+    {
+      src.unregisterSink();
+      delete enc;
+    }
+    virtual unsigned process(const float *samples, int count)
+    {
+      return src.write(samples, count);
+    }
+
+  private:
+    BenchSource         src;
+    AudioEncoder        *enc;
+    unsigned long long  bytes;
+
+    void onEncoded(const void *buf, int size) { bytes += size; }
+};
+
+
+/**
+ * Benchmark an audio decoder. The test signal is encoded once using the
+ * matching encoder. The encoded frames are then fed to the decoder in a loop.
+ */
+class DecoderBenchmark : public Benchmark
+{
+  public:
+    DecoderBenchmark(const string& name, int rate, const string& codec,
+                     const float *signal, int signal_len)
+      : Benchmark(name, rate), dec(AudioDecoder::create(codec)), next_frame(0)
+    {
+      AudioEncoder *enc = AudioEncoder::create(codec);
+      enc->writeEncodedSamples.connect(
+          sigc::mem_fun(*this, &DecoderBenchmark::onEncoded));
+      BenchSource src;
+      src.registerSink(enc);
+      for (int pos=0; pos+BLOCK_SIZE<=signal_len; pos+=BLOCK_SIZE)
+      {
+        src.write(signal+pos, BLOCK_SIZE);
+      }
+      src.unregisterSink();
+      delete enc;
+      dec->registerSink(&null_sink);
+    }
+    virtual ~DecoderBenchmark(void)
+    {
+      delete dec;
+    }
+    virtual unsigned process(const float *samples, int count)
+    {
+      if (frames.empty())
+      {
+        return 0;
+      }
+      unsigned long long prev_cnt = null_sink.cnt;
+      vector<char> &frame = frames[next_frame];
+      dec->writeEncodedSamples(&frame[0], frame.size());
+      next_frame = (next_frame + 1) % frames.size();
+      return null_sink.cnt - prev_cnt;
+    }
+
+  private:
+    AudioDecoder          *dec;
+    NullSink              null_sink;
+    vector<vector<char> > frames;
+    size_t                next_frame;
+
+    void onEncoded(const void *buf, int size)
+    {
+      const char *ptr = reinterpret_cast<const char *>(buf);
+      frames.push_back(vector<char>(ptr, ptr + size));
+    }
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void usage(const char *prog);
+static double cpuTime(void);
+static void makeSignal(vector<float>& signal, int rate);
+static void addProcessor(vector<Benchmark*>& benchmarks, const string& name,
+                         int rate, AudioSink *sink, AudioSource *output);
+static void addFilter(vector<Benchmark*>& benchmarks, const string& spec);
+static void createBenchmarks(vector<Benchmark*>& benchmarks);
+static void runBenchmark(Benchmark *bm, double min_time);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * MAIN
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  main
+ * Purpose:   Run the benchmarks selected on the command line
+ * Input:     argc  - The number of arguments passed to this program
+ *    	      	      including the program name.
+ *    	      argv  - The arguments passed to this program. argv[0] is the
+ *    	      	      program name.
+ * Output:    Return 0 on success, else non-zero.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2020-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+int main(int argc, const char **argv)
+{
+  CppApplication app;
+
+  double min_time = 0.5;
+  bool list_only = false;
+  vector<string> patterns;
+  for (int i=1; i<argc; ++i)
+  {
+    if ((strcmp(argv[i], "-t") == 0) && (i+1 < argc))
+    {
+      min_time = atof(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-l") == 0)
+    {
+      list_only = true;
+    }
+    else if ((strcmp(argv[i], "-s") == 0) && (i+1 < argc))
+    {
+      if (!AudioCpuFeatures::setLimit(argv[++i]))
+      {
+        cerr << "*** ERROR: Unknown SIMD limit \"" << argv[i] << "\"\n";
+        usage(argv[0]);
+        exit(1);
+      }
+    }
+    else if (argv[i][0] == '-')
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+    else
+    {
+      patterns.push_back(argv[i]);
+    }
+  }
+
+  vector<Benchmark*> benchmarks;
+  createBenchmarks(benchmarks);
+
+  if (!list_only)
+  {
+    cout << "CPU features: "
+         << AudioCpuFeatures::toString(AudioCpuFeatures::detected())
+         << "\nEnabled:      "
+         << AudioCpuFeatures::toString(AudioCpuFeatures::enabled())
+         << "\nSample ops:   " << AudioSampleOps::kernelName()
+         << "\n\n";
+    cout << left << setw(44) << "Benchmark" << right
+         << setw(8) << "Rate"
+         << setw(14) << "Samples/s"
+         << setw(12) << "Realtime" << endl;
+  }
+  for (vector<Benchmark*>::iterator it = benchmarks.begin();
+       it != benchmarks.end(); ++it)
+  {
+    bool selected = patterns.empty();
+    for (vector<string>::const_iterator pit = patterns.begin();
+         pit != patterns.end(); ++pit)
+    {
+      selected = selected || ((*it)->name().find(*pit) != string::npos);
+    }
+    if (selected && list_only)
+    {
+      cout << (*it)->name() << endl;
+    }
+    else if (selected)
+    {
+      runBenchmark(*it, min_time);
+    }
+    delete *it;
+  }
+
+  return 0;
+} /* main */
+
+
+/****************************************************************************
+ *
+ * Functions
+ *
+ ****************************************************************************/
+
+static void usage(const char *prog)
+{
+  cerr << "Usage: " << prog << " [-t <seconds>] [-l] [-s <simd limit>] "
+          "[<name pattern>...]\n"
+          "  -t  The minimum CPU time to spend on each benchmark "
+          "(default 0.5)\n"
+          "  -l  Only list the available benchmarks\n"
+          "  -s  Limit the SIMD features used by the kernels, e.g. scalar "
+          "or sse2\n"
+          "Only benchmarks with a name containing one of the given patterns "
+          "are run.\n";
+} /* usage */
+
+
+static double cpuTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1.0e9;
+} /* cpuTime */
+
+
+static void makeSignal(vector<float>& signal, int rate)
+{
+    // A voice band like test signal: a few tones plus noise at about -10dBFS
+  signal.resize(SIGNAL_SECONDS * rate);
+  srand(1);
+  for (size_t i=0; i<signal.size(); ++i)
+  {
+    float t = static_cast<float>(i) / rate;
+    float noise = 2.0f * rand() / RAND_MAX - 1.0f;
+    signal[i] = 0.1f * sinf(2.0f * M_PI * 440.0f * t) +
+                0.1f * sinf(2.0f * M_PI * 1750.0f * t) +
+                0.05f * sinf(2.0f * M_PI * 136.5f * t) +
+                0.05f * noise;
+  }
+} /* makeSignal */
+
+
+static void addProcessor(vector<Benchmark*>& benchmarks, const string& name,
+                         int rate, AudioSink *sink, AudioSource *output)
+{
+  benchmarks.push_back(new SinkBenchmark(name, rate, sink, output));
+} /* addProcessor */
+
+
+static void addFilter(vector<Benchmark*>& benchmarks, const string& spec)
+{
+  AudioFilter *filter = new AudioFilter(spec);
+  addProcessor(benchmarks, "AudioFilter " + spec, INTERNAL_SAMPLE_RATE,
+               filter, filter);
+} /* addFilter */
+
+
+static void createBenchmarks(vector<Benchmark*>& benchmarks)
+{
+  AudioDecimator *dec = new AudioDecimator(3, coeff_48_16_wide,
+                                           coeff_48_16_wide_taps);
+  addProcessor(benchmarks, "AudioDecimator 48->16 (coeff_48_16_wide)", 48000,
+               dec, dec);
+  dec = new AudioDecimator(2, coeff_16_8, coeff_16_8_taps);
+  addProcessor(benchmarks, "AudioDecimator 16->8 (coeff_16_8)", 16000,
+               dec, dec);
+
+  AudioInterpolator *ip = new AudioInterpolator(2, coeff_16_8,
+                                                coeff_16_8_taps);
+  addProcessor(benchmarks, "AudioInterpolator 8->16 (coeff_16_8)", 8000,
+               ip, ip);
+  ip = new AudioInterpolator(3, coeff_48_16_int, coeff_48_16_int_taps);
+  addProcessor(benchmarks, "AudioInterpolator 16->48 (coeff_48_16_int)",
+               16000, ip, ip);
+  ip = new AudioInterpolator(3, coeff_48_16, coeff_48_16_taps);
+  addProcessor(benchmarks, "AudioInterpolator 16->48 (coeff_48_16)",
+               16000, ip, ip);
+
+    // Filters used in LocalRxBase
+  addFilter(benchmarks, "BpCh12/-0.1/300-3500");
+  addFilter(benchmarks, "BpCh12/-0.1/300-5000");
+  addFilter(benchmarks, "LpCh9/-0.05/3500");
+  addFilter(benchmarks, "LpCh9/-0.05/5000");
+
+    // Filters used in LocalTx
+  addFilter(benchmarks, "LpCh9/-0.05/5500");
+  addFilter(benchmarks, "LpBu20/3500");
+  addFilter(benchmarks, "LpCh10/-0.5/4500");
+  addFilter(benchmarks, "LpBu3/5500 x HpBu1/3000");
+
+    // The frequency sampling filter used for AFSK in LocalTx
+  const size_t N = 128;
+  float coeff[N/2+1];
+  memset(coeff, 0, sizeof(coeff));
+  coeff[42] = 0.39811024;
+  coeff[43] = 1.0;
+  coeff[44] = 1.0;
+  coeff[45] = 1.0;
+  coeff[46] = 0.39811024;
+  AudioFsf *fsf = new AudioFsf(N, coeff);
+  addProcessor(benchmarks, "AudioFsf N=128", INTERNAL_SAMPLE_RATE, fsf, fsf);
+
+  AudioCompressor *comp = new AudioCompressor;
+  comp->setThreshold(-10);
+  comp->setRatio(0.25);
+  comp->setAttack(10);
+  comp->setDecay(100);
+  comp->setOutputGain(0);
+  addProcessor(benchmarks, "AudioCompressor", INTERNAL_SAMPLE_RATE,
+               comp, comp);
+
+  benchmarks.push_back(new MixerBenchmark("AudioMixer 2 sources",
+                                          INTERNAL_SAMPLE_RATE));
+
+  ToneDetector *det = new ToneDetector(1750, 50, 100);
+  det->setPeakThresh(13);
+  addProcessor(benchmarks, "ToneDetector 1750Hz", INTERNAL_SAMPLE_RATE,
+               det, 0);
+  det = new ToneDetector(136.5, 8.0f);
+  addProcessor(benchmarks, "ToneDetector CTCSS 136.5Hz",
+               INTERNAL_SAMPLE_RATE, det, 0);
+  ToneDetectorBank *det_bank = new ToneDetectorBank;
+  for (int i=0; i<50; ++i)
+  {
+    det_bank->addDetector(new ToneDetector(67.0f + 3.0f * i, 8.0f), true);
+  }
+  addProcessor(benchmarks, "ToneDetectorBank 50 CTCSS tones",
+               INTERNAL_SAMPLE_RATE, det_bank, 0);
+  CtcssSlidingDft *sdft = new CtcssSlidingDft(8.0f, 210.0f);
+  sdft->addEiaTones();
+  addProcessor(benchmarks, "CtcssSlidingDft 50 EIA tones",
+               INTERNAL_SAMPLE_RATE, sdft, 0);
+
+  vector<float> signal;
+  makeSignal(signal, INTERNAL_SAMPLE_RATE);
+  const char *codecs[] = { "RAW", "S16", "GSM", "SPEEX", "OPUS", 0 };
+  for (const char **codec = codecs; *codec != 0; ++codec)
+  {
+    if (AudioEncoder::isAvailable(*codec))
+    {
+      benchmarks.push_back(new EncoderBenchmark(
+            string("AudioEncoder ") + *codec, INTERNAL_SAMPLE_RATE,
+            AudioEncoder::create(*codec)));
+    }
+    if (AudioDecoder::isAvailable(*codec) && AudioEncoder::isAvailable(*codec))
+    {
+      benchmarks.push_back(new DecoderBenchmark(
+            string("AudioDecoder ") + *codec, INTERNAL_SAMPLE_RATE, *codec,
+            &signal[0], signal.size()));
+    }
+  }
+} /* createBenchmarks */
+
+
+static void runBenchmark(Benchmark *bm, double min_time)
+{
+  vector<float> signal;
+  makeSignal(signal, bm->rate());
+
+    // Warm up caches and filter state before starting the measurement
+  size_t pos = 0;
+  for (int i=0; i<10; ++i)
+  {
+    bm->process(&signal[pos], BLOCK_SIZE);
+    pos = (pos + BLOCK_SIZE) % (signal.size() - BLOCK_SIZE);
+  }
+
+  unsigned long long samples = 0;
+  double start = cpuTime();
+  double elapsed = 0.0;
+  do
+  {
+    for (int i=0; i<100; ++i)
+    {
+      samples += bm->process(&signal[pos], BLOCK_SIZE);
+      pos = (pos + BLOCK_SIZE) % (signal.size() - BLOCK_SIZE);
+    }
+    elapsed = cpuTime() - start;
+  } while (elapsed < min_time);
+
+  double rate = samples / elapsed;
+  cout << left << setw(44) << bm->name() << right
+       << setw(8) << bm->rate()
+       << setw(14) << static_cast<unsigned long long>(rate)
+       << setw(11) << setprecision(1) << fixed << rate / bm->rate() << "x"
+       << endl;
+} /* runBenchmark */
+
+
+/*
+ * This file has not been truncated
+ */
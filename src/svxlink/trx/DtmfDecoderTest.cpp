@@ -1,283 +1,575 @@
+/**
+@file   DtmfDecoderTest.cpp
+@brief  Compare the detection performance and cost of the DTMF decoders
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This program runs each of the software DTMF decoders over the same test vectors
+and reports the detection rate at a number of signal to noise ratios, the talk-
+off rate for voice like audio and the number of samples per second a single
+CPU core can process. Test vectors are synthesized, but recorded audio can be
+given on the command line too. The numbers can be used to choose a decoder for
+a site and to catch regressions when optimizing the decoders.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
 #include <iostream>
+#include <iomanip>
+#include <sstream>
 #include <string>
+#include <vector>
 #include <fstream>
+#include <algorithm>
+#include <functional>
 #include <cstdlib>
+#include <cstring>
 #include <cmath>
+#include <stdint.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
 
 #include <AsyncConfig.h>
+#include <AsyncAudioSink.h>
 #include <AsyncAudioNoiseAdder.h>
 #include <AsyncAudioFilter.h>
-#include <AsyncAudioPassthrough.h>
-#include <CppStdCompat.h>
+#include <AsyncAudioSampleRate.h>
+#include <common.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
 
 #include "DtmfDecoder.h"
 #include "DtmfEncoder.h"
 
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
 using namespace std;
 using namespace Async;
+using namespace SvxLink;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
 
+#define BLOCK_SIZE      256
 
-class FileWriter : public Async::AudioProcessor
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+/**
+ * An audio sink that collect all samples written to it
+ */
+class SampleCollector : public AudioSink
 {
   public:
-    FileWriter(const string &path)
-      : samppos(0)
+    SampleCollector(vector<float>& samples) : samples(samples) {}
+    virtual int writeSamples(const float *buf, int count)
     {
-      ofs.open(path.c_str(), ios::out | ios::binary);
-      if (ofs.fail())
-      {
-        cout << "Could not open output file: " << path << endl;
-        exit(1);
-      }
+      samples.insert(samples.end(), buf, buf + count);
+      return count;
     }
+    virtual void flushSamples(void) { sourceAllSamplesFlushed(); }
 
-    ~FileWriter(void)
-    {
-      ofs.close();
-    }
+  private:
+    vector<float>& samples;
+};
 
-    int sampPos(void) { return samppos; }
 
-  protected:
-    void processSamples(float *dest, const float *src, int count)
-    {
-      ofs.write(reinterpret_cast<const char*>(src), count * sizeof(*src));
-      for (int i=0; i<count; ++i)
-      {
-        dest[i] = src[i];
-      }
-      samppos += count;
-    }
+/**
+ * A test vector and the digits it contain, if any
+ */
+struct TestVector
+{
+  string        name;
+  vector<float> samples;
+  string        digits;
+  bool          is_talkoff;
+};
 
-  private:
-    ofstream ofs;
-    int samppos;
+
+/**
+ * The result of running one decoder over one test vector
+ */
+struct RunResult
+{
+  string        received;
+  double        cpu_time;
 };
 
 
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void usage(const char *prog);
+static double cpuTime(void);
+static void makeDigitVector(TestVector& vec, const string& digits,
+                            int digit_len, float snr_db);
+static void makeVoiceVector(TestVector& vec, float seconds);
+static bool readRawVector(TestVector& vec, const string& spec);
+static bool runDecoder(const string& type, const TestVector& vec,
+                       RunResult& res);
+static size_t lcsLength(const string& a, const string& b);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
 namespace {
-string send_digits = "00112233445566778899AABBCCDD**##";
-//string send_digits = "0123456789ABCD*#";
-//string send_digits = "1";
-string received_digits;
-FileWriter *fwriter = 0;
+  const string send_digits = "00112233445566778899AABBCCDD**##";
+  const int digit_power = -10;
+  string received_digits;
 
-void digit_detected(char ch, int duration)
-{
-  cout << " pos=" << fwriter->sampPos()
-       << " (" << (static_cast<float>(fwriter->sampPos()) / (60*16000)) << "m)";
-  cout << endl;
-  /*
-  cout << " digit=" << ch
-       << " duration=" << duration << endl;
-  */
-  received_digits += ch;
-}
+  void digit_detected(char ch, int duration)
+  {
+    received_digits += ch;
+  }
 };
 
 
-class FileReader : public AudioSource
+/****************************************************************************
+ *
+ * MAIN
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  main
+ * Purpose:   Run the DTMF decoder comparison
+ * Input:     argc  - The number of arguments passed to this program
+ *    	      	      including the program name.
+ *    	      argv  - The arguments passed to this program. argv[0] is the
+ *    	      	      program name.
+ * Output:    Return 0 if all decoders detected all digits at the highest
+ *            SNR, else non-zero.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2020-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+int main(int argc, const char **argv)
 {
-  public:
-    FileReader(void)
+  vector<string> decoders;
+  decoders.push_back("INTERNAL");
+  decoders.push_back("DH1DM");
+  vector<float> snrs;
+  snrs.push_back(30.0f);
+  snrs.push_back(20.0f);
+  snrs.push_back(15.0f);
+  snrs.push_back(10.0f);
+  snrs.push_back(5.0f);
+  int reps = 10;
+  int digit_len = 100;
+  float voice_seconds = 300.0f;
+  vector<string> files;
+  for (int i=1; i<argc; ++i)
+  {
+    if ((strcmp(argv[i], "-d") == 0) && (i+1 < argc))
     {
+      splitStr(decoders, argv[++i], ",");
     }
-
-    virtual ~FileReader(void)
+    else if ((strcmp(argv[i], "-s") == 0) && (i+1 < argc))
     {
-      ifs.close();
+      splitStr(snrs, argv[++i], ",");
     }
-
-    bool open(const string &path)
+    else if ((strcmp(argv[i], "-n") == 0) && (i+1 < argc))
     {
-      ifs.open(path.c_str(), ios::in | ios::binary);
-      if (ifs.fail())
-      {
-        cout << "Could not open input file: " << path << endl;
-        return false;
-      }
-      writeAudio();
-      return true;
+      reps = atoi(argv[++i]);
     }
-
-    virtual void resumeOutput(void)
+    else if ((strcmp(argv[i], "-l") == 0) && (i+1 < argc))
+    {
+      digit_len = atoi(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-t") == 0) && (i+1 < argc))
+    {
+      voice_seconds = atof(argv[++i]);
+    }
+    else if ((strcmp(argv[i], "-f") == 0) && (i+1 < argc))
     {
-      writeAudio();
+      files.push_back(argv[++i]);
     }
-    
+    else
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+  }
 
-  protected:
-    virtual void allSamplesFlushed(void)
+    // Set up the test vectors. The synthetic digit vectors come first with
+    // the highest SNR first.
+  sort(snrs.begin(), snrs.end(), greater<float>());
+  string digits;
+  for (int i=0; i<reps; ++i)
+  {
+    digits += send_digits;
+  }
+  vector<TestVector> vectors;
+  for (vector<float>::const_iterator it=snrs.begin(); it!=snrs.end(); ++it)
+  {
+    vectors.push_back(TestVector());
+    makeDigitVector(vectors.back(), digits, digit_len, *it);
+  }
+  if (voice_seconds > 0.0f)
+  {
+    vectors.push_back(TestVector());
+    makeVoiceVector(vectors.back(), voice_seconds);
+  }
+  for (vector<string>::const_iterator it=files.begin(); it!=files.end(); ++it)
+  {
+    vectors.push_back(TestVector());
+    if (!readRawVector(vectors.back(), *it))
     {
+      exit(1);
     }
+  }
 
-  private:
-    ifstream ifs;
+  cout << left << setw(10) << "Decoder" << setw(24) << "Test vector" << right
+       << setw(8) << "Digits" << setw(10) << "Detected" << setw(8) << "False"
+       << setw(12) << "Talk-off/h" << setw(14) << "Samples/s" << endl;
 
-    void writeAudio()
+  int ret = 0;
+  for (vector<string>::const_iterator dit=decoders.begin();
+       dit!=decoders.end(); ++dit)
+  {
+    unsigned long long tot_samples = 0;
+    double tot_time = 0.0;
+    for (vector<TestVector>::const_iterator vit=vectors.begin();
+         vit!=vectors.end(); ++vit)
     {
-      if (!ifs.good())
+      RunResult res;
+      if (!runDecoder(*dit, *vit, res))
       {
-        return;
+        exit(1);
       }
+      tot_samples += vit->samples.size();
+      tot_time += res.cpu_time;
 
-      int samp_written = 0;
-      do
+      cout << left << setw(10) << *dit << setw(24) << vit->name << right;
+      size_t hits = lcsLength(vit->digits, res.received);
+      size_t false_hits = res.received.size() - hits;
+      if (vit->is_talkoff)
       {
-        int16_t buf[256];
-        ifs.read(reinterpret_cast<char*>(buf), sizeof(buf));
-        int samp_cnt = ifs.gcount() / sizeof(*buf);
-        if (samp_cnt == 0)
-        {
-          break;
-        }
-        float samples[samp_cnt];
-        for (int i=0; i<samp_cnt; ++i)
-        {
-          samples[i] = static_cast<float>(buf[i]) / 32767.0f;
-        }
-        samp_written = sinkWriteSamples(samples, samp_cnt);
-        if (samp_written < 0)
-        {
-          cout << "*** ERROR: Could not write samples\n";
-          return;
-        }
-        int left =  samp_cnt - samp_written;
-        if (left > 0)
+        double hours = vit->samples.size() / (3600.0 * INTERNAL_SAMPLE_RATE);
+        cout << setw(8) << "-" << setw(10) << "-" << setw(8) << false_hits
+             << setw(12) << fixed << setprecision(1) << (false_hits / hours);
+      }
+      else
+      {
+        double rate = 100.0 * hits / vit->digits.size();
+        cout << setw(8) << vit->digits.size()
+             << setw(9) << fixed << setprecision(1) << rate << "%"
+             << setw(8) << false_hits << setw(12) << "-";
+        if ((vit == vectors.begin()) && (hits != vit->digits.size()))
         {
-          ifs.seekg(left, istream::cur);
+          ret = 1;
         }
-      } while ((samp_written > 0) && ifs.good());
+      }
+      cout << setw(14) << setprecision(0)
+           << (vit->samples.size() / res.cpu_time) << endl;
     }
-};
+    cout << left << setw(10) << *dit << setw(24) << "All vectors" << right
+         << setw(52) << fixed << setprecision(0) << (tot_samples / tot_time)
+         << endl;
+  }
 
+  return ret;
 
-class PowerPlotter : public Async::AudioPassthrough
-{
-  public:
-    PowerPlotter(void) : prev_power(0.0f) { }
+} /* main */
 
-    virtual int writeSamples(const float *samples, int count)
-    {
-      double power = 0.0;
-      for (int i=0; i<count; ++i)
-      {
-        power += samples[i] * samples[i];
-      }
-      power /= count;
-      power = ALPHA * power + (1-ALPHA) * prev_power;
-      prev_power = power;
-      cout << "pwr=" << power << endl;
-      return sinkWriteSamples(samples, count);
-    }
 
-  private:
-    static CONSTEXPR float ALPHA = 0.05;
-    float prev_power;
+/****************************************************************************
+ *
+ * Functions
+ *
+ ****************************************************************************/
 
-}; /* class PowerPlotter */
+static void usage(const char *prog)
+{
+  cerr << "Usage: " << prog << " [-d <decoders>] [-s <SNRs>] [-n <reps>] [-l <ms>] "
+                               "[-t <seconds>] [-f <file>[:<digits>]]...\n"
+       << "  -d  Comma separated list of DTMF_DEC_TYPE values to test "
+          "(default INTERNAL,DH1DM)\n"
+       << "  -s  Comma separated list of SNRs in dB for the synthetic digit "
+          "vectors\n"
+       << "  -n  How many times to send the " << send_digits.size()
+       << " digit test sequence for each SNR\n"
+       << "  -l  The length of the synthetic digits and the pauses between "
+          "them in\n"
+       << "      milliseconds (default 100)\n"
+       << "  -t  Length in seconds of the synthetic talk-off vector, "
+          "0 to skip it\n"
+       << "  -f  A recorded test vector, raw signed 16 bit samples at "
+       << INTERNAL_SAMPLE_RATE << "Hz, and the\n"
+       << "      digits it contain. Without digits it is used as a talk-off "
+          "vector.\n";
+} /* usage */
+
+
+static double cpuTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1.0e9;
+} /* cpuTime */
 
 
-int main()
+static void makeDigitVector(TestVector& vec, const string& digits,
+                            int digit_len, float snr_db)
 {
-  Config cfg;
-  cfg.setValue("Test", "DTMF_DEC_TYPE", "INTERNAL");
-  //cfg.setValue("Test", "DTMF_DEC_TYPE", "DH1DM");
-  //cfg.setValue("Test", "DTMF_MAX_FWD_TWIST", "6");
-  //cfg.setValue("Test", "DTMF_MAX_REV_TWIST", "6");
-  //cfg.setValue("Test", "DTMF_HANGTIME", "100");
-  cfg.setValue("Test", "DTMF_DEBUG", "1");
-
-  AudioSource *prev_src = 0;
-#define SIMULATE
-#ifdef SIMULATE
+  stringstream ss;
+  ss << "Digits SNR=" << snr_db << "dB";
+  vec.name = ss.str();
+  vec.digits = digits;
+  vec.is_talkoff = false;
+
+    // The SNR is given within the voice band so the noise level is adjusted
+    // for the part of the full band noise that the filter let through
+  float lo = 300.0f;
+  float hi = (INTERNAL_SAMPLE_RATE >= 16000) ? 5000.0f : 3400.0f;
+  float noise_pwr = digit_power - snr_db +
+                    10.0f * log10f(INTERNAL_SAMPLE_RATE / 2.0f / (hi - lo));
+
   DtmfEncoder enc;
-  enc.setDigitDuration(40);
-  enc.setDigitSpacing(40);
-  enc.setDigitPower(-10);
-  prev_src = &enc;
-
-  //float noise_pwr = 0;
-  //float noise_pwr = -10;
-  //float noise_pwr = -13;
-  //float noise_pwr = -16;
-  float noise_pwr = -22;
-  //float noise_pwr = -100;
-  noise_pwr += 10.0f * log10f(0.5f / 0.30f); // 300-5000Hz filter
-  //noise_pwr += 10.0f * log10f(0.5f / 0.18f); // 480-3400Hz filter
-  AudioNoiseAdder *noise_adder = new AudioNoiseAdder(noise_pwr);
-  prev_src->registerSink(noise_adder, true);
-  prev_src = noise_adder;
-
-  AudioFilter *voiceband_filter = new AudioFilter("BpCh10/-0.1/300-5000");
-  //AudioFilter *voiceband_filter = new AudioFilter("BpCh10/-0.1/480-3400");
-  prev_src->registerSink(voiceband_filter, true);
-  prev_src = voiceband_filter;
+  enc.setDigitDuration(digit_len);
+  enc.setDigitSpacing(digit_len);
+  AudioNoiseAdder noise_adder(noise_pwr);
+  enc.registerSink(&noise_adder);
+  ss.str("");
+  ss << "BpCh10/-0.1/" << lo << "-" << hi;
+  AudioFilter voiceband_filter(ss.str());
+  noise_adder.registerSink(&voiceband_filter);
+  SampleCollector collector(vec.samples);
+  voiceband_filter.registerSink(&collector);
+
+    // Send a silent digit before and after the test digits so that there is
+    // noise before the first and after the last digit
+  enc.setDigitPower(-100);
+  enc.send("0");
+  enc.setDigitPower(digit_power);
+  enc.send(digits);
+  enc.setDigitPower(-100);
+  enc.send("0");
+} /* makeDigitVector */
 
-  /*
-  PowerPlotter pp;
-  prev_src->registerSink(&pp);
-  prev_src = &pp;
-  */
-#else
-  FileReader rdr;
-  prev_src = &rdr;
-#endif
-
-  fwriter = new FileWriter("/tmp/samples.raw");
-  prev_src->registerSink(fwriter, true);
-  prev_src = fwriter;
 
-  DtmfDecoder *dec = DtmfDecoder::create(0, cfg, "Test");
-  if (!dec->initialize())
+static void makeVoiceVector(TestVector& vec, float seconds)
+{
+  stringstream ss;
+  ss << "Voice " << seconds << "s";
+  vec.name = ss.str();
+  vec.is_talkoff = true;
+
+    // A crude voice model: a pitch gliding between 90 and 250Hz with
+    // harmonics shaped by two formants that move between vowels, amplitude
+    // modulated at a syllable rate. Whistle like vowels with strong
+    // formants are what usually cause talk-off.
+  static const float formants[][2] = {
+    { 730, 1090 }, { 270, 2290 }, { 300, 870 }, { 530, 1840 }, { 570, 840 },
+    { 440, 1020 }, { 660, 1720 }, { 490, 1350 }
+  };
+  const int formant_cnt = sizeof(formants) / sizeof(formants[0]);
+  const float fs = INTERNAL_SAMPLE_RATE;
+  const int seg_len = INTERNAL_SAMPLE_RATE / 50;
+  const size_t len = static_cast<size_t>(seconds * fs);
+
+  srand(4711);
+  vec.samples.reserve(len);
+  float f0 = 150.0f;
+  float phase = 0.0f;
+  const float *formant = formants[0];
+  size_t syllable_left = 0;
+  float env_fq = 4.0f;
+  while (vec.samples.size() < len)
+  {
+    if (syllable_left == 0)
+    {
+      formant = formants[rand() % formant_cnt];
+      env_fq = 3.0f + 3.0f * rand() / RAND_MAX;
+      syllable_left = static_cast<size_t>(fs / env_fq);
+    }
+    f0 += 10.0f * (2.0f * rand() / RAND_MAX - 1.0f);
+    f0 = min(250.0f, max(90.0f, f0));
+    float amp[40];
+    int harm_cnt = min(40, static_cast<int>((fs / 2.0f - 200.0f) / f0));
+    for (int h=1; h<=harm_cnt; ++h)
+    {
+      float a = 0.0f;
+      for (int k=0; k<2; ++k)
+      {
+        float d = (h * f0 - formant[k]) / 80.0f;
+        a += 1.0f / (1.0f + d * d);
+      }
+      amp[h-1] = 0.05f * a / h;
+    }
+    for (int i=0; (i<seg_len) && (vec.samples.size()<len); ++i)
+    {
+      float env = sinf(M_PI * syllable_left * env_fq / fs);
+      float sample = 0.0f;
+      for (int h=1; h<=harm_cnt; ++h)
+      {
+        sample += amp[h-1] * sinf(h * phase);
+      }
+      vec.samples.push_back(env * env * sample);
+      phase += 2.0f * M_PI * f0 / fs;
+      if (phase > 2.0f * M_PI)
+      {
+        phase -= 2.0f * M_PI;
+      }
+      if (--syllable_left == 0)
+      {
+        break;
+      }
+    }
+  }
+} /* makeVoiceVector */
+
+
+static bool readRawVector(TestVector& vec, const string& spec)
+{
+  string path(spec);
+  string::size_type colon = spec.rfind(':');
+  if (colon != string::npos)
   {
-    cout << "*** ERROR: Could not initialize DTMF decoder\n";
-    exit(1);
+    path = spec.substr(0, colon);
+    vec.digits = spec.substr(colon + 1);
   }
-  dec->digitDeactivated.connect(sigc::ptr_fun(digit_detected));
-  prev_src->registerSink(dec, true);
-  prev_src = 0;
+  vec.name = path.substr(path.rfind('/') + 1);
+  vec.is_talkoff = vec.digits.empty();
 
-#ifdef SIMULATE
-  int tone_amp = enc.digitPower();
-  enc.setDigitPower(-100);
-  enc.send("0");
-  enc.setDigitPower(tone_amp);
-  string digits;
-  for (int i=0; i<50; ++i)
+  ifstream ifs(path.c_str(), ios::in | ios::binary);
+  if (ifs.fail())
   {
-    digits += send_digits;
+    cerr << "*** ERROR: Could not open input file: " << path << endl;
+    return false;
   }
-  enc.send(digits);
-  enc.setDigitPower(-100);
-  enc.send("0");
-#else
-  if (!rdr.open("/tmp/output.raw"))
-  //if (!rdr.open("/tmp/selected.raw"))
-  //if (!rdr.open("/tmp/false11.raw"))
+  int16_t buf[BLOCK_SIZE];
+  while (ifs.read(reinterpret_cast<char*>(buf), sizeof(buf)) ||
+         (ifs.gcount() > 0))
   {
-    exit(1);
+    int samp_cnt = ifs.gcount() / sizeof(*buf);
+    for (int i=0; i<samp_cnt; ++i)
+    {
+      vec.samples.push_back(static_cast<float>(buf[i]) / 32767.0f);
+    }
   }
-#endif
-  if (!received_digits.empty())
+  return true;
+} /* readRawVector */
+
+
+static bool runDecoder(const string& type, const TestVector& vec,
+                       RunResult& res)
+{
+  Config cfg;
+  cfg.setValue("Test", "DTMF_DEC_TYPE", type);
+  DtmfDecoder *dec = DtmfDecoder::create(0, cfg, "Test");
+  if ((dec == 0) || !dec->initialize())
   {
-    cout << "Digits detected(" << received_digits.size() << "): "
-         << received_digits << endl;
+    cerr << "*** ERROR: Could not initialize DTMF decoder " << type << endl;
+    delete dec;
+    return false;
   }
-#ifdef SIMULATE
-  if (received_digits != digits)
+  dec->digitDeactivated.connect(sigc::ptr_fun(digit_detected));
+
+  received_digits.clear();
+  double start = cpuTime();
+  for (size_t pos=0; pos<vec.samples.size(); pos+=BLOCK_SIZE)
   {
-    cout << "received(" << received_digits.size() << ") != sent("
-         << digits.size() << ") => "
-         << (100.0 * received_digits.size() / digits.size()) << "%\n";
-    return 1;
+    int count = min(static_cast<size_t>(BLOCK_SIZE), vec.samples.size() - pos);
+    dec->writeSamples(&vec.samples[pos], count);
   }
-#else
-  if (!received_digits.empty())
+  res.cpu_time = max(cpuTime() - start, 1.0e-9);
+  res.received = received_digits;
+
+  delete dec;
+  return true;
+} /* runDecoder */
+
+
+  /*
+   * The length of the longest common subsequence of the sent and received
+   * digits, which is the number of sent digits that was correctly detected
+   * in order. The rest of the received digits are false detections.
+   */
+static size_t lcsLength(const string& a, const string& b)
+{
+  vector<size_t> prev(b.size() + 1, 0);
+  vector<size_t> cur(b.size() + 1, 0);
+  for (size_t i=0; i<a.size(); ++i)
   {
-    return 1;
+    for (size_t j=0; j<b.size(); ++j)
+    {
+      cur[j+1] = (a[i] == b[j]) ? prev[j] + 1 : max(prev[j+1], cur[j]);
+    }
+    prev.swap(cur);
   }
-#endif
-  return 0;
-}
+  return prev[b.size()];
+} /* lcsLength */
+
+
 
+/*
+ * This file has not been truncated
+ */
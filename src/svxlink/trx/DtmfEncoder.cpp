@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <map>
 #include <utility>
 #include <cmath>
+#include <cstring>
 
 
 /****************************************************************************
@@ -294,6 +295,12 @@ void DtmfEncoder::playNextDigit(void)
   
   low_tone = tone_map[digit].first;
   high_tone = tone_map[digit].second;
+  low_osc.setFq(low_tone, sampling_rate);
+  low_osc.setAmplitude(tone_amp);
+  low_osc.reset();
+  high_osc.setFq(high_tone, sampling_rate);
+  high_osc.setAmplitude(tone_amp);
+  high_osc.reset();
   pos = 0;
   if (length <= 0)
   {
@@ -314,22 +321,26 @@ void DtmfEncoder::writeAudio(void)
   do
   {
     unsigned count = min(BLOCK_SIZE, length - pos);
-    for (unsigned i=0; i<count; ++i)
+    if (low_tone > 0)
     {
-      if (low_tone > 0)
-      {
-      	block[i] = tone_amp * sin(2 * M_PI * low_tone * pos / sampling_rate) +
-      		   tone_amp * sin(2 * M_PI * high_tone * pos / sampling_rate);
-      }
-      else
-      {
-      	block[i] = 0;
-      }
-      ++pos;
+        // Both tones are summed into the block in one pass each
+      low_osc.generate(block, count);
+      high_osc.addTo(block, count);
     }
+    else
+    {
+      memset(block, 0, count * sizeof(*block));
+    }
+    pos += count;
 
     ret = sinkWriteSamples(block, count);
     pos -= (count - ret);
+    if (low_tone > 0)
+    {
+      int unread = static_cast<int>(count) - ret;
+      low_osc.advance(-unread);
+      high_osc.advance(-unread);
+    }
   } while ((ret > 0) && (pos < length));
   
   if (pos == length)
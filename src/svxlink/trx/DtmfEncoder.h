@@ -47,6 +47,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncAudioSource.h>
+#include <AsyncAudioOscillator.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -223,6 +225,8 @@ class DtmfEncoder : public Async::AudioSource, sigc::trackable
     SendQueue   send_queue;
     unsigned    low_tone;
     unsigned    high_tone;
+    Async::AudioOscillator low_osc;
+    Async::AudioOscillator high_osc;
     unsigned    pos;
     unsigned    length;
     bool      	is_playing;
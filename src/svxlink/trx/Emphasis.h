@@ -45,6 +45,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncAudioFilter.h>
+#include <AsyncAudioSampleRate.h>
 //#include <AsyncAudioProcessor.h>
 #include <CppStdCompat.h>
 
@@ -177,21 +178,33 @@ class EmphasisBase : public Async::AudioFilter
     */
     
   protected:
-#if INTERNAL_SAMPLE_RATE == 16000
-      // 0dB gain, f1=300Hz, fs=16kHz
-    static CONSTEXPR double b0 = 0.058555891443177958410881700501704472117;
-    static CONSTEXPR double b1 = 0.052700302299058421340305358171463012695;
-    static CONSTEXPR double a0 = 1.0;
-    static CONSTEXPR double a1 = -0.88874380625776361330991903741960413754;
-#elif INTERNAL_SAMPLE_RATE == 8000
-      // 0dB gain, f1=300Hz, fs=8kHz
-    static CONSTEXPR double b0 = 0.110940380645014949334559162252844544128;
-    static CONSTEXPR double b1 = 0.099846342580711719416619587263994617388;
-    static CONSTEXPR double a0 = 1.0;
-    static CONSTEXPR double a1 = -0.789213276774273331248821250483160838485;
-#else
-#error "Only 16 and 8kHz sampling rate is supported by the pre- and de-emphasis filters."
-#endif
+    struct Coeffs
+    {
+      double b0;
+      double b1;
+      double a0;
+      double a1;
+    };
+
+      // Get the filter coefficients for the internal sample rate
+    static const Coeffs& coeffs(void)
+    {
+        // 0dB gain, f1=300Hz, fs=16kHz
+      static const Coeffs coeffs_16k = {
+        0.058555891443177958410881700501704472117,
+        0.052700302299058421340305358171463012695,
+        1.0,
+        -0.88874380625776361330991903741960413754
+      };
+        // 0dB gain, f1=300Hz, fs=8kHz
+      static const Coeffs coeffs_8k = {
+        0.110940380645014949334559162252844544128,
+        0.099846342580711719416619587263994617388,
+        1.0,
+        -0.789213276774273331248821250483160838485
+      };
+      return (INTERNAL_SAMPLE_RATE == 8000) ? coeffs_8k : coeffs_16k;
+    }
 
     static float outputGain(void) { return 12.0f; }
 
@@ -219,17 +232,22 @@ class PreemphasisFilter : public EmphasisBase
         // First we band pass filter the signal to get rid of high and low
         // frequency components. In the 8000 kHz case, only a high pass filter
         // is needed.
-#if INTERNAL_SAMPLE_RATE >= 16000
-      ss << "BpBu4/300-4300 x ";
-#elif INTERNAL_SAMPLE_RATE == 8000
-      ss << "HpBu4/300 x ";
-#endif
+      if (INTERNAL_SAMPLE_RATE >= 16000)
+      {
+        ss << "BpBu4/300-4300 x ";
+      }
+      else
+      {
+        ss << "HpBu4/300 x ";
+      }
 
         // Create the filter spec with inverted transfer function to cancel
         // out the de-emphasis filter. Also we need to normalize on b0 so that
         // we get a 1 as the y(0) coeffiient. This is required by the filter
         // library.
-      ss << (a0 / b0) << " " << (a1 / b0) << " / " << 1.0 << " " << (b1 / b0);
+      const Coeffs& c = coeffs();
+      ss << (c.a0 / c.b0) << " " << (c.a1 / c.b0) << " / " << 1.0 << " "
+         << (c.b1 / c.b0);
       if (!parseFilterSpec(ss.str()))
       {
         std::cerr << "***ERROR: Preemphasis filter creation error: "
@@ -264,7 +282,8 @@ class DeemphasisFilter : public EmphasisBase
       //ss << "HpCh6/-0.5/300 x ";
 
         // Create the filter specification
-      ss << b0 << " " << b1 << " / " << a0 << " " << a1;
+      const Coeffs& c = coeffs();
+      ss << c.b0 << " " << c.b1 << " / " << c.a0 << " " << c.a1;
       if (!parseFilterSpec(ss.str()))
       {
         std::cerr << "***ERROR: Deemphasis filter creation error: "
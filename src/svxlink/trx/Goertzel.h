@@ -360,6 +360,8 @@ class Goertzel
   protected:
     
   private:
+    friend class ToneDetectorBank;
+
     float cosw;
     float sinw;
     float two_cosw;
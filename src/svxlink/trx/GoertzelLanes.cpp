@@ -0,0 +1,394 @@
+/**
+@file   GoertzelLanes.cpp
+@brief  Run a number of Goertzel filters side by side
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains the SIMD kernels that step a number of Goertzel filters,
+stored in lanes, over a run of samples.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GOERTZEL_LANES_X86
+#include <xmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define GOERTZEL_LANES_NEON
+#include <arm_neon.h>
+#endif
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioCpuFeatures.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "GoertzelLanes.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+typedef void (*RunFunc)(float *q0, float *q1, const float *coeff,
+                        const float *const *src, int len, int lane_cnt);
+typedef void (*RunWindowedFunc)(float *q0, float *q1, const float *coeff,
+                                const float *src, const float *const *win,
+                                int len, int lane_cnt);
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void run_scalar(float *q0, float *q1, const float *coeff,
+                       const float *const *src, int len, int lane_cnt);
+static void run_windowed_scalar(float *q0, float *q1, const float *coeff,
+                                const float *src, const float *const *win,
+                                int len, int lane_cnt);
+#ifdef GOERTZEL_LANES_X86
+static void run_sse(float *q0, float *q1, const float *coeff,
+                    const float *const *src, int len, int lane_cnt)
+  __attribute__((target("sse")));
+static void run_windowed_sse(float *q0, float *q1, const float *coeff,
+                             const float *src, const float *const *win,
+                             int len, int lane_cnt)
+  __attribute__((target("sse")));
+#endif
+#ifdef GOERTZEL_LANES_NEON
+static void run_neon(float *q0, float *q1, const float *coeff,
+                     const float *const *src, int len, int lane_cnt);
+static void run_windowed_neon(float *q0, float *q1, const float *coeff,
+                              const float *src, const float *const *win,
+                              int len, int lane_cnt);
+#endif
+static void run_select(float *q0, float *q1, const float *coeff,
+                       const float *const *src, int len, int lane_cnt);
+static void run_windowed_select(float *q0, float *q1, const float *coeff,
+                                const float *src, const float *const *win,
+                                int len, int lane_cnt);
+static void select_kernels(void);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+static RunFunc run_func = run_select;
+static RunWindowedFunc run_windowed_func = run_windowed_select;
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+void GoertzelLanes::run(float *q0, float *q1, const float *coeff,
+                        const float *const *src, int len, int lane_cnt)
+{
+  run_func(q0, q1, coeff, src, len, lane_cnt);
+} /* GoertzelLanes::run */
+
+
+void GoertzelLanes::runWindowed(float *q0, float *q1, const float *coeff,
+                                const float *src, const float *const *win,
+                                int len, int lane_cnt)
+{
+  run_windowed_func(q0, q1, coeff, src, win, len, lane_cnt);
+} /* GoertzelLanes::runWindowed */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+
+
+
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+static void run_scalar(float *q0, float *q1, const float *coeff,
+                       const float *const *src, int len, int lane_cnt)
+{
+  for (int lane=0; lane<lane_cnt; ++lane)
+  {
+    float s0 = q0[lane];
+    float s1 = q1[lane];
+    const float c = coeff[lane];
+    const float *x = src[lane];
+    for (int i=0; i<len; ++i)
+    {
+      float s2 = s1;
+      s1 = s0;
+      s0 = c * s1 - s2 + x[i];
+    }
+    q0[lane] = s0;
+    q1[lane] = s1;
+  }
+} /* run_scalar */
+
+
+static void run_windowed_scalar(float *q0, float *q1, const float *coeff,
+                                const float *src, const float *const *win,
+                                int len, int lane_cnt)
+{
+  for (int lane=0; lane<lane_cnt; ++lane)
+  {
+    float s0 = q0[lane];
+    float s1 = q1[lane];
+    const float c = coeff[lane];
+    const float *w = win[lane];
+    for (int i=0; i<len; ++i)
+    {
+      float s2 = s1;
+      s1 = s0;
+      s0 = c * s1 - s2 + src[i] * w[i];
+    }
+    q0[lane] = s0;
+    q1[lane] = s1;
+  }
+} /* run_windowed_scalar */
+
+
+#ifdef GOERTZEL_LANES_X86
+static void run_sse(float *q0, float *q1, const float *coeff,
+                    const float *const *src, int len, int lane_cnt)
+{
+  for (int lane=0; lane<lane_cnt; lane+=4)
+  {
+    __m128 s0 = _mm_loadu_ps(q0 + lane);
+    __m128 s1 = _mm_loadu_ps(q1 + lane);
+    const __m128 c = _mm_loadu_ps(coeff + lane);
+    const float *x0 = src[lane];
+    const float *x1 = src[lane + 1];
+    const float *x2 = src[lane + 2];
+    const float *x3 = src[lane + 3];
+    for (int i=0; i<len; ++i)
+    {
+      __m128 x = _mm_setr_ps(x0[i], x1[i], x2[i], x3[i]);
+      __m128 s2 = s1;
+      s1 = s0;
+      s0 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, s1), s2), x);
+    }
+    _mm_storeu_ps(q0 + lane, s0);
+    _mm_storeu_ps(q1 + lane, s1);
+  }
+} /* run_sse */
+
+
+static void run_windowed_sse(float *q0, float *q1, const float *coeff,
+                             const float *src, const float *const *win,
+                             int len, int lane_cnt)
+{
+  for (int lane=0; lane<lane_cnt; lane+=4)
+  {
+    __m128 s0 = _mm_loadu_ps(q0 + lane);
+    __m128 s1 = _mm_loadu_ps(q1 + lane);
+    const __m128 c = _mm_loadu_ps(coeff + lane);
+    const float *w0 = win[lane];
+    const float *w1 = win[lane + 1];
+    const float *w2 = win[lane + 2];
+    const float *w3 = win[lane + 3];
+    for (int i=0; i<len; ++i)
+    {
+      __m128 w = _mm_setr_ps(w0[i], w1[i], w2[i], w3[i]);
+      __m128 x = _mm_mul_ps(_mm_set1_ps(src[i]), w);
+      __m128 s2 = s1;
+      s1 = s0;
+      s0 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c, s1), s2), x);
+    }
+    _mm_storeu_ps(q0 + lane, s0);
+    _mm_storeu_ps(q1 + lane, s1);
+  }
+} /* run_windowed_sse */
+#endif
+
+
+#ifdef GOERTZEL_LANES_NEON
+static void run_neon(float *q0, float *q1, const float *coeff,
+                     const float *const *src, int len, int lane_cnt)
+{
+  for (int lane=0; lane<lane_cnt; lane+=4)
+  {
+    float32x4_t s0 = vld1q_f32(q0 + lane);
+    float32x4_t s1 = vld1q_f32(q1 + lane);
+    const float32x4_t c = vld1q_f32(coeff + lane);
+    const float *x0 = src[lane];
+    const float *x1 = src[lane + 1];
+    const float *x2 = src[lane + 2];
+    const float *x3 = src[lane + 3];
+    for (int i=0; i<len; ++i)
+    {
+      float32x4_t x = vdupq_n_f32(x0[i]);
+      x = vsetq_lane_f32(x1[i], x, 1);
+      x = vsetq_lane_f32(x2[i], x, 2);
+      x = vsetq_lane_f32(x3[i], x, 3);
+      float32x4_t s2 = s1;
+      s1 = s0;
+      s0 = vaddq_f32(vsubq_f32(vmulq_f32(c, s1), s2), x);
+    }
+    vst1q_f32(q0 + lane, s0);
+    vst1q_f32(q1 + lane, s1);
+  }
+} /* run_neon */
+
+
+static void run_windowed_neon(float *q0, float *q1, const float *coeff,
+                              const float *src, const float *const *win,
+                              int len, int lane_cnt)
+{
+  for (int lane=0; lane<lane_cnt; lane+=4)
+  {
+    float32x4_t s0 = vld1q_f32(q0 + lane);
+    float32x4_t s1 = vld1q_f32(q1 + lane);
+    const float32x4_t c = vld1q_f32(coeff + lane);
+    const float *w0 = win[lane];
+    const float *w1 = win[lane + 1];
+    const float *w2 = win[lane + 2];
+    const float *w3 = win[lane + 3];
+    for (int i=0; i<len; ++i)
+    {
+      float32x4_t w = vdupq_n_f32(w0[i]);
+      w = vsetq_lane_f32(w1[i], w, 1);
+      w = vsetq_lane_f32(w2[i], w, 2);
+      w = vsetq_lane_f32(w3[i], w, 3);
+      float32x4_t x = vmulq_n_f32(w, src[i]);
+      float32x4_t s2 = s1;
+      s1 = s0;
+      s0 = vaddq_f32(vsubq_f32(vmulq_f32(c, s1), s2), x);
+    }
+    vst1q_f32(q0 + lane, s0);
+    vst1q_f32(q1 + lane, s1);
+  }
+} /* run_windowed_neon */
+#endif
+
+
+static void run_select(float *q0, float *q1, const float *coeff,
+                       const float *const *src, int len, int lane_cnt)
+{
+  select_kernels();
+  run_func(q0, q1, coeff, src, len, lane_cnt);
+} /* run_select */
+
+
+static void run_windowed_select(float *q0, float *q1, const float *coeff,
+                                const float *src, const float *const *win,
+                                int len, int lane_cnt)
+{
+  select_kernels();
+  run_windowed_func(q0, q1, coeff, src, win, len, lane_cnt);
+} /* run_windowed_select */
+
+
+static void select_kernels(void)
+{
+  AudioCpuFeatures::addDispatcher(select_kernels);
+#ifdef GOERTZEL_LANES_X86
+  if (AudioCpuFeatures::has(AudioCpuFeatures::SSE))
+  {
+    run_func = run_sse;
+    run_windowed_func = run_windowed_sse;
+    return;
+  }
+#endif
+#ifdef GOERTZEL_LANES_NEON
+  if (AudioCpuFeatures::has(AudioCpuFeatures::NEON))
+  {
+    run_func = run_neon;
+    run_windowed_func = run_windowed_neon;
+    return;
+  }
+#endif
+  run_func = run_scalar;
+  run_windowed_func = run_windowed_scalar;
+} /* select_kernels */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,152 @@
+/**
+@file   GoertzelLanes.h
+@brief  Run a number of Goertzel filters side by side
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains the SIMD kernels that step a number of Goertzel filters,
+stored in lanes, over a run of samples. They are shared by all detectors that
+evaluate many frequencies over the same audio.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef GOERTZEL_LANES_INCLUDED
+#define GOERTZEL_LANES_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Step a number of Goertzel filters side by side
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+The state of each Goertzel filter is stored in a lane of the q0, q1 and coeff
+arrays, the layout used by for example the Goertzel class being
+q0 = s(n-1), q1 = s(n-2) and coeff = 2*cos(w). Four lanes are processed by
+each SSE or NEON instruction if available, otherwise a plain C++
+implementation is used. The implementation is chosen at runtime.
+*/
+class GoertzelLanes
+{
+  public:
+    /**
+     * @brief   Round a lane count up to what the kernels require
+     * @param   lane_cnt The number of lanes that are actually used
+     * @return  Returns the number of lanes to allocate
+     *
+     * The padding lanes should be fed with zeros and can then be ignored.
+     */
+    static int paddedLaneCount(int lane_cnt) { return (lane_cnt + 3) & ~3; }
+
+    /**
+     * @brief   Step the filters over a run of samples
+     * @param   q0 The first state variable for each lane
+     * @param   q1 The second state variable for each lane
+     * @param   coeff The filter coefficient for each lane
+     * @param   src The input samples for each lane
+     * @param   len The number of samples to process
+     * @param   lane_cnt The number of lanes, a multiple of four
+     */
+    static void run(float *q0, float *q1, const float *coeff,
+                    const float *const *src, int len, int lane_cnt);
+
+    /**
+     * @brief   Step the filters over a run of samples applying a window
+     * @param   q0 The first state variable for each lane
+     * @param   q1 The second state variable for each lane
+     * @param   coeff The filter coefficient for each lane
+     * @param   src The input samples, the same for all lanes
+     * @param   win The window function samples for each lane
+     * @param   len The number of samples to process
+     * @param   lane_cnt The number of lanes, a multiple of four
+     *
+     * The input to lane l for sample i is src[i] * win[l][i].
+     */
+    static void runWindowed(float *q0, float *q1, const float *coeff,
+                            const float *src, const float *const *win,
+                            int len, int lane_cnt);
+
+  private:
+    GoertzelLanes(void);
+
+};  /* class GoertzelLanes */
+
+
+#endif /* GOERTZEL_LANES_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,311 @@
+/**
+@file	 HidrawDevice.cpp
+@brief   A shared, reference counted, linux/hidraw sound card GPIO device
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <cassert>
+#include <unistd.h>
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <sys/ioctl.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncApplication.h>
+#include <AsyncFdWatch.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "HidrawDevice.h"
+
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+HidrawDevice *HidrawDevice::instance(const string& path)
+{
+  DeviceMap::iterator it = devices().find(path);
+  if (it != devices().end())
+  {
+    it->second->m_refs += 1;
+    return it->second;
+  }
+
+  HidrawDevice *dev = new HidrawDevice(path);
+  if (!dev->open())
+  {
+    delete dev;
+    return 0;
+  }
+  devices()[path] = dev;
+  return dev;
+} /* HidrawDevice::instance */
+
+
+void HidrawDevice::destroy(void)
+{
+  assert(m_refs > 0);
+  if (--m_refs == 0)
+  {
+    devices().erase(m_path);
+    delete this;
+  }
+} /* HidrawDevice::destroy */
+
+
+bool HidrawDevice::setPin(char pin, bool high)
+{
+  m_out_dir |= pin;
+  if (high)
+  {
+    m_out_state |= pin;
+  }
+  else
+  {
+    m_out_state &= ~pin;
+  }
+
+  if (!m_write_pending)
+  {
+    m_write_pending = true;
+    Application::app().runTask(
+        mem_fun(*this, &HidrawDevice::writeOutputReport));
+  }
+
+  return m_write_ok;
+} /* HidrawDevice::setPin */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+HidrawDevice::DeviceMap& HidrawDevice::devices(void)
+{
+  static DeviceMap device_map;
+  return device_map;
+} /* HidrawDevice::devices */
+
+
+HidrawDevice::HidrawDevice(const string& path)
+  : m_path(path), m_refs(1), m_fd(-1), m_watch(0), m_in_state(0),
+    m_out_state(0), m_out_dir(0), m_write_pending(false), m_write_ok(true)
+{
+} /* HidrawDevice::HidrawDevice */
+
+
+HidrawDevice::~HidrawDevice(void)
+{
+    // Make sure that the last pin change, e.g. PTT off, reach the device
+  if (m_write_pending)
+  {
+    writeOutputReport();
+  }
+  delete m_watch;
+  if (m_fd >= 0)
+  {
+    close(m_fd);
+  }
+} /* HidrawDevice::~HidrawDevice */
+
+
+/**
+Initializing the sound card as linux/hidraw device
+For further information:
+  http://dmkeng.com
+  http://www.halicky.sk/om3cph/sb/CM108_DataSheet_v1.6.pdf
+  http://www.ti.com/lit/ml/sllu093/sllu093.pdf
+  http://www.ti.com/tool/usb-to-gpio
+*/
+bool HidrawDevice::open(void)
+{
+  if ((m_fd = ::open(m_path.c_str(), O_RDWR, 0)) < 0)
+  {
+    cerr << "*** ERROR: Could not open hidraw device " << m_path << ": "
+         << strerror(errno) << endl;
+    return false;
+  }
+
+  struct hidraw_devinfo hiddevinfo;
+  if ((ioctl(m_fd, HIDIOCGRAWINFO, &hiddevinfo) == -1) ||
+      (hiddevinfo.vendor != 0x0d8c))
+  {
+    cerr << "*** ERROR: unknown/unsupported sound chip detected on "
+         << m_path << endl;
+    return false;
+  }
+
+  cout << "--- Hidraw sound chip on " << m_path << " is ";
+  if (hiddevinfo.product == 0x000c)
+  {
+    cout << "CM108";
+  }
+  else if (hiddevinfo.product == 0x013c)
+  {
+    cout << "CM108A";
+  }
+  else if (hiddevinfo.product == 0x000e)
+  {
+    cout << "CM109";
+  }
+  else if (hiddevinfo.product == 0x013a)
+  {
+    cout << "CM119";
+  }
+  else
+  {
+    cout << "unknown";
+  }
+  cout << endl;
+
+  m_watch = new FdWatch(m_fd, FdWatch::FD_WATCH_RD);
+  m_watch->activity.connect(mem_fun(*this, &HidrawDevice::onActivity));
+
+  return true;
+} /* HidrawDevice::open */
+
+
+void HidrawDevice::onActivity(FdWatch *watch)
+{
+  char buf[5];
+  int rd = read(m_fd, buf, sizeof(buf));
+  if (rd <= 0)
+  {
+    cerr << "*** ERROR: reading hidraw device " << m_path << endl;
+    return;
+  }
+
+  m_in_state = buf[0];
+  inputChanged(m_in_state);
+} /* HidrawDevice::onActivity */
+
+
+void HidrawDevice::writeOutputReport(void)
+{
+  m_write_pending = false;
+
+    // The CM108 output report: report number, reserved, GPIO data,
+    // GPIO direction and SPDIF
+  char report[5] = {'\000', '\000', m_out_state, m_out_dir, '\000'};
+  m_write_ok = (write(m_fd, report, sizeof(report)) != -1);
+  if (!m_write_ok)
+  {
+    cerr << "*** ERROR: writing to hidraw device " << m_path << ": "
+         << strerror(errno) << endl;
+  }
+} /* HidrawDevice::writeOutputReport */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,206 @@
+/**
+@file	 HidrawDevice.h
+@brief   A shared, reference counted, linux/hidraw sound card GPIO device
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef HIDRAW_DEVICE_INCLUDED
+#define HIDRAW_DEVICE_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+#include <string>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class FdWatch;
+};
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+//namespace MyNameSpace
+//{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A shared linux/hidraw device for CM108 type sound card GPIO
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+A CM108 type USB sound card is often used for both PTT and squelch. This
+class make sure that a hidraw device is only opened once, no matter how many
+PttHidraw and SquelchHidraw objects that use it. Get a device object with
+the instance function and release it with destroy when done. The device is
+closed when the last user has released it.
+
+All input reports are read by one file descriptor watch and delivered to
+every user through the inputChanged signal. The state of all output pins is
+kept here so that one user setting its pin does not change the pins of the
+other users. Pin changes made during the same main loop iteration are sent
+to the device in one output report.
+*/
+class HidrawDevice : public sigc::trackable
+{
+  public:
+    /**
+     * @brief 	Get a shared device object
+     * @param 	path The path to the hidraw device, e.g. /dev/hidraw0
+     * @return	Returns the device object or 0 if it could not be opened
+     */
+    static HidrawDevice *instance(const std::string& path);
+
+    /**
+     * @brief   Release a device object obtained from instance
+     */
+    void destroy(void);
+
+    /**
+     * @brief   The path to the hidraw device
+     */
+    const std::string& path(void) const { return m_path; }
+
+    /**
+     * @brief   Set the state of an output (GPIO) pin
+     * @param   pin   The pin bit mask, e.g. 0x01 for GPIO1
+     * @param   high  Set to \em true to set the pin high
+     * @return  Returns \em false if the last write to the device failed
+     *
+     * The pin is configured as an output the first time that it is set.
+     * The output report is sent to the device when the main loop is
+     * reentered.
+     */
+    bool setPin(char pin, bool high);
+
+    /**
+     * @brief   Get the last received input pin state
+     * @return  Returns the first byte of the last input report
+     */
+    char inputState(void) const { return m_in_state; }
+
+    /**
+     * @brief   A signal that is emitted when an input report is received
+     * @param   state The first byte of the input report, one bit per pin
+     */
+    sigc::signal<void, char> inputChanged;
+
+  private:
+    typedef std::map<std::string, HidrawDevice*> DeviceMap;
+
+    std::string     m_path;
+    unsigned        m_refs;
+    int             m_fd;
+    Async::FdWatch* m_watch;
+    char            m_in_state;
+    char            m_out_state;
+    char            m_out_dir;
+    bool            m_write_pending;
+    bool            m_write_ok;
+
+    static DeviceMap& devices(void);
+
+    HidrawDevice(const std::string& path);
+    ~HidrawDevice(void);
+    HidrawDevice(const HidrawDevice&);
+    HidrawDevice& operator=(const HidrawDevice&);
+    bool open(void);
+    void onActivity(Async::FdWatch *watch);
+    void writeOutputReport(void);
+
+};  /* class HidrawDevice */
+
+
+//} /* namespace */
+
+#endif /* HIDRAW_DEVICE_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
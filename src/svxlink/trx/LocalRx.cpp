@@ -162,6 +162,17 @@ bool LocalRx::initialize(void)
     //       before continuing.
   audio_io = new AudioIO(audio_dev, audio_channel);
 
+  int audio_dev_blocksize = 0;
+  if (cfg.getValue(name(), "AUDIO_DEV_BLOCKSIZE", audio_dev_blocksize))
+  {
+    audio_io->setDeviceBlocksize(audio_dev_blocksize);
+  }
+  int audio_dev_block_count = 0;
+  if (cfg.getValue(name(), "AUDIO_DEV_BLOCK_COUNT", audio_dev_block_count))
+  {
+    audio_io->setDeviceBlockCount(audio_dev_block_count);
+  }
+
   if (!LocalRxBase::initialize())
   {
     return false;
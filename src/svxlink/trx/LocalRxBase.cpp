@@ -57,12 +57,17 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioAmp.h>
 #include <AsyncAudioPassthrough.h>
 #include <AsyncAudioDecimator.h>
+#include <AsyncAudioResampler.h>
 #include <AsyncAudioClipper.h>
 #include <AsyncAudioCompressor.h>
 #include <AsyncAudioFifo.h>
 #include <AsyncAudioStreamStateDetector.h>
 #include <AsyncAudioFsf.h>
+#include <AsyncAudioProcessorChain.h>
 #include <AsyncUdpSocket.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncAudioLatencyTrace.h>
+#include <AsyncAudioWorkerPool.h>
 #include <common.h>
 
 
@@ -75,6 +80,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "SigLevDet.h"
 #include "DtmfDecoder.h"
 #include "ToneDetector.h"
+#include "ToneDetectorBank.h"
 #include "SquelchCtcss.h"
 #include "LocalRxBase.h"
 #include "multirate_filter_coeff.h"
@@ -106,6 +112,7 @@ using namespace Async;
 #define DTMF_MUTING_POST      200
 #define TONE_1750_MUTING_PRE  75
 #define TONE_1750_MUTING_POST 100
+#define DETECTOR_WARMUP       200
 
 
 /****************************************************************************
@@ -147,6 +154,87 @@ class PeakMeter : public AudioPassthrough
 };
 
 
+/**
+ * A gate used to put the voiceband filter and the detectors after it to
+ * sleep. While asleep, the most recent audio is kept in a history buffer
+ * which is fed through the detectors when waking up so that filters are
+ * settled and tones that started just before wake up are detected. When
+ * going to sleep, a block of silence is written so that all detectors are
+ * left in an idle state.
+ */
+class DetectorGate : public AudioSink, public AudioSource
+{
+  public:
+    explicit DetectorGate(int warmup_len)
+      : hist(warmup_len, 0.0f), hist_pos(0), is_awake(false) {}
+
+    bool isAwake(void) const { return is_awake; }
+
+    void setAwake(bool awake)
+    {
+      if (awake == is_awake)
+      {
+        return;
+      }
+      is_awake = awake;
+      if (is_awake)
+      {
+        sinkWriteSamples(&hist[hist_pos], hist.size() - hist_pos);
+        sinkWriteSamples(&hist[0], hist_pos);
+      }
+      else
+      {
+        fill(hist.begin(), hist.end(), 0.0f);
+        hist_pos = 0;
+        sinkWriteSamples(&hist[0], hist.size());
+      }
+    }
+
+    virtual int writeSamples(const float *samples, int count)
+    {
+      if (is_awake)
+      {
+        return sinkWriteSamples(samples, count);
+      }
+
+      const int hist_len = hist.size();
+      if (count >= hist_len)
+      {
+        memcpy(&hist[0], samples + count - hist_len,
+               hist_len * sizeof(*samples));
+        hist_pos = 0;
+        return count;
+      }
+      int first = min(count, hist_len - hist_pos);
+      memcpy(&hist[hist_pos], samples, first * sizeof(*samples));
+      memcpy(&hist[0], samples + first, (count - first) * sizeof(*samples));
+      hist_pos = (hist_pos + count) % hist_len;
+      return count;
+    }
+
+    virtual void flushSamples(void)
+    {
+      if (is_awake)
+      {
+        sinkFlushSamples();
+      }
+      else
+      {
+        sourceAllSamplesFlushed();
+      }
+    }
+
+    virtual void resumeOutput(void) { sourceResumeOutput(); }
+    virtual void allSamplesFlushed(void) { sourceAllSamplesFlushed(); }
+
+  private:
+    vector<float> hist;
+    int           hist_pos;
+    bool          is_awake;
+
+};
+
+
 class AudioUdpSink : public UdpSocket, public AudioSink
 {
   public:
@@ -233,10 +321,11 @@ namespace {
 LocalRxBase::LocalRxBase(Config &cfg, const std::string& name)
   : Rx(cfg, name), mute_state(MUTE_ALL),
     squelch_det(0), siglevdet(0), /* siglev_offset(0.0), siglev_slope(1.0), */
-    tone_dets(0), sql_valve(0), delay(0), sql_tail_elim(0),
-    preamp_gain(0), mute_valve(0), sql_hangtime(0), sql_extended_hangtime(0),
+    tone_dets(0), tone_det_bank(0), sql_valve(0), delay(0), sql_tail_elim(0),
+    preamp_gain(0), preamp(0), mute_valve(0), sql_hangtime(0), sql_extended_hangtime(0),
     sql_extended_hangtime_thresh(0), input_fifo(0), dtmf_muting_pre(0),
-    ob_afsk_deframer(0), ib_afsk_deframer(0), audio_dev_keep_open(false)
+    ob_afsk_deframer(0), ib_afsk_deframer(0), audio_dev_keep_open(false),
+    det_gate(0), sql_gated_detectors(false)
 {
 } /* LocalRxBase::LocalRxBase */
 
@@ -310,31 +399,66 @@ bool LocalRxBase::initialize(void)
     raw_audio_splitter->addSink(udp, true);
   }
   
-    // If a preamp was configured, create it
-  if (preamp_gain != 0)
-  {
-    AudioAmp *preamp = new AudioAmp;
-    preamp->setGain(preamp_gain);
-    prev_src->registerSink(preamp, true);
-    prev_src = preamp;
-  }
+    // Audio processors that follow directly after each other are run
+    // through an AudioProcessorChain so that each block of samples pass
+    // through all of them in one go. The chain is put into the audio pipe
+    // at the end of each linear run, unless it is empty.
+  AudioProcessorChain *proc_chain = new AudioProcessorChain;
+
+    // Always create the preamp so that the gain can be changed at runtime
+  preamp = new AudioAmp;
+  preamp->setGain(preamp_gain);
+  proc_chain->addProcessor(preamp, true);
   
     // If a peak meter was configured, create it
   if (peak_meter)
   {
+    if (!proc_chain->empty())
+    {
+      prev_src->registerSink(proc_chain, true);
+      prev_src = proc_chain;
+      proc_chain = new AudioProcessorChain;
+    }
     PeakMeter *peak_meter = new PeakMeter(name());
     prev_src->registerSink(peak_meter, true);
     prev_src = peak_meter;
   }
   
-    // If the sound card sample rate is higher than 16kHz (48kHz assumed),
-    // decimate it down to 16kHz
-  if (audioSampleRate() > 16000)
+    // If the sound card sample rate is 48kHz, decimate it down to 16kHz
+  int rate = audioSampleRate();
+  if (rate == 48000)
   {
     AudioDecimator *d1 = new AudioDecimator(3, coeff_48_16_wide,
 					    coeff_48_16_wide_taps);
-    prev_src->registerSink(d1, true);
-    prev_src = d1;
+    proc_chain->addProcessor(d1, true);
+    rate = 16000;
+  }
+  if (!proc_chain->empty())
+  {
+    prev_src = addProcessor(prev_src, proc_chain);
+    if (prev_src == 0)
+    {
+      return false;
+    }
+  }
+  else
+  {
+    delete proc_chain;
+  }
+
+    // Other sound card sample rates, like 44.1kHz, are resampled to 16kHz.
+    // Low rates are resampled to 8kHz if that is the internal sample rate.
+  if ((rate != 16000) && (rate != 8000))
+  {
+    int new_rate = 16000;
+    if ((INTERNAL_SAMPLE_RATE == 8000) && (rate < 16000))
+    {
+      new_rate = 8000;
+    }
+    AudioResampler *resampler = new AudioResampler(rate, new_rate);
+    prev_src->registerSink(resampler, true);
+    prev_src = resampler;
+    rate = new_rate;
   }
 
   AudioSplitter *siglevdet_splitter = 0;
@@ -358,18 +482,17 @@ bool LocalRxBase::initialize(void)
   mute_valve->setOpen(true);
   siglevdet_splitter->addSink(mute_valve, true);
   prev_src = mute_valve;
+
+  proc_chain = new AudioProcessorChain;
   
-#if (INTERNAL_SAMPLE_RATE != 16000)
     // If the sound card sample rate is higher than 8kHz (16 or 48kHz assumed)
     // decimate it down to 8kHz.
     // 16kHz audio to other consumers.
-  if (audioSampleRate() > 8000)
+  if ((INTERNAL_SAMPLE_RATE != 16000) && (rate > 8000))
   {
     AudioDecimator *d2 = new AudioDecimator(2, coeff_16_8, coeff_16_8_taps);
-    prev_src->registerSink(d2, true);
-    prev_src = d2;
+    proc_chain->addProcessor(d2, true);
   }
-#endif
 
     // If a deemphasis filter was configured, create it
   if (deemphasis)
@@ -382,9 +505,21 @@ bool LocalRxBase::initialize(void)
     //deemph_filt->setOutputGain(7.0f);
 
     DeemphasisFilter *deemph_filt = new DeemphasisFilter;
-    prev_src->registerSink(deemph_filt, true);
-    prev_src = deemph_filt;
+    proc_chain->addProcessor(deemph_filt, true);
   }
+  if (!proc_chain->empty())
+  {
+    prev_src = addProcessor(prev_src, proc_chain);
+    if (prev_src == 0)
+    {
+      return false;
+    }
+  }
+  else
+  {
+    delete proc_chain;
+  }
+  proc_chain = 0;
   
     // Create a splitter to distribute full bandwidth audio to all consumers
   AudioSplitter *fullband_splitter = new AudioSplitter;
@@ -510,16 +645,27 @@ bool LocalRxBase::initialize(void)
   tone_dets = new AudioSplitter;
   prev_src->registerSink(tone_dets, true);
   prev_src = tone_dets;
+  tone_det_bank = new ToneDetectorBank;
+  tone_dets->addSink(tone_det_bank, true);
+
+    // The voiceband filter and everything after it is only needed when the
+    // receiver is unmuted. Optionally they may also sleep while the squelch
+    // is closed. Tone detectors added using addToneDetector always run.
+  cfg().getValue(name(), "SQL_GATED_DETECTORS", sql_gated_detectors);
+  det_gate = new DetectorGate(DETECTOR_WARMUP * INTERNAL_SAMPLE_RATE / 1000);
+  prev_src->registerSink(det_gate, true);
+  prev_src = det_gate;
 
     // Filter out the voice band, removing high- and subaudible frequencies,
     // for example CTCSS.
-#if (INTERNAL_SAMPLE_RATE == 16000)
-  AudioFilter *voiceband_filter = new AudioFilter("BpCh12/-0.1/300-5000");
-#else
-  AudioFilter *voiceband_filter = new AudioFilter("BpCh12/-0.1/300-3500");
-#endif
-  prev_src->registerSink(voiceband_filter, true);
-  prev_src = voiceband_filter;
+  AudioFilter *voiceband_filter = new AudioFilter(
+      (INTERNAL_SAMPLE_RATE == 16000) ? "BpCh12/-0.1/300-5000"
+                                      : "BpCh12/-0.1/300-3500");
+  prev_src = addProcessor(prev_src, voiceband_filter);
+  if (prev_src == 0)
+  {
+    return false;
+  }
 
     // Create an audio splitter to distribute the voiceband audio to all
     // other consumers
@@ -588,11 +734,15 @@ bool LocalRxBase::initialize(void)
     // elimination), create it
   if (delay_line_len > 0)
   {
-    delay = new AudioDelayLine(delay_line_len);
+    bool delay_line_s16 = false;
+    cfg().getValue(name(), "DELAY_LINE_S16", delay_line_s16);
+    delay = new AudioDelayLine(delay_line_len, delay_line_s16);
     prev_src->registerSink(delay, true);
     prev_src = delay;
   }
 
+  proc_chain = new AudioProcessorChain;
+
     // Add a limiter to smoothly limiting the audio before hard clipping it
   AudioCompressor *limit = new AudioCompressor;
   limit->setThreshold(-1);
@@ -600,23 +750,29 @@ bool LocalRxBase::initialize(void)
   limit->setAttack(2);
   limit->setDecay(20);
   limit->setOutputGain(1);
-  prev_src->registerSink(limit, true);
-  prev_src = limit;
+  proc_chain->addProcessor(limit, true);
 
     // Clip audio to limit its amplitude
   AudioClipper *clipper = new AudioClipper;
   clipper->setClipLevel(0.98);
-  prev_src->registerSink(clipper, true);
-  prev_src = clipper;
+  proc_chain->addProcessor(clipper, true);
 
     // Remove high frequencies generated by the previous clipping
-#if (INTERNAL_SAMPLE_RATE == 16000)
-  AudioFilter *splatter_filter = new AudioFilter("LpCh9/-0.05/5000");
-#else
-  AudioFilter *splatter_filter = new AudioFilter("LpCh9/-0.05/3500");
-#endif
-  prev_src->registerSink(splatter_filter, true);
-  prev_src = splatter_filter;
+  AudioFilter *splatter_filter = new AudioFilter(
+      (INTERNAL_SAMPLE_RATE == 16000) ? "LpCh9/-0.05/5000"
+                                      : "LpCh9/-0.05/3500");
+  proc_chain->addProcessor(splatter_filter, true);
+  prev_src = addProcessor(prev_src, proc_chain);
+  proc_chain = 0;
+  if (prev_src == 0)
+  {
+    return false;
+  }
+
+    // Record the latency of sampled blocks leaving the receiver
+  AudioLatencyStage *latency_stage = new AudioLatencyStage("rx");
+  prev_src->registerSink(latency_stage, true);
+  prev_src = latency_stage;
   
     // Set the previous audio pipe object to handle audio distribution for
     // the LocalRxBase class
@@ -665,6 +821,7 @@ void LocalRxBase::setMuteState(MuteState new_mute_state)
             delay->clear();
           }
           sql_valve->setOpen(false);
+          updateDetectorActivation();
           break;
 
         case MUTE_ALL:  // MUTE_CONTENT -> MUTE_ALL
@@ -694,6 +851,7 @@ void LocalRxBase::setMuteState(MuteState new_mute_state)
           break;
 
         case MUTE_NONE:   // MUTE_CONTENT -> MUTE_NONE
+          updateDetectorActivation();
           if (squelchIsOpen())
           {
             sql_valve->setOpen(true);
@@ -718,7 +876,7 @@ bool LocalRxBase::addToneDetector(float fq, int bw, float thresh,
   det->setPeakThresh(thresh);
   det->detected.connect(toneDetected.make_slot());
   
-  tone_dets->addSink(det, true);
+  tone_det_bank->addDetector(det, true);
   
   return true;
 
@@ -745,6 +903,8 @@ void LocalRxBase::reset(void)
 {
   setMuteState(Rx::MUTE_ALL);
   tone_dets->removeAllSinks();
+  tone_det_bank = new ToneDetectorBank;
+  tone_dets->addSink(tone_det_bank, true);
   if (delay != 0)
   {
     delay->mute(false);
@@ -767,6 +927,30 @@ void LocalRxBase::reset(void)
  *
  ****************************************************************************/
 
+AudioSource *LocalRxBase::addProcessor(AudioSource *src, AudioProcessor *proc)
+{
+    // When a DSP worker pool has been started, e.g. by RemoteTrx, the
+    // processor is run on one of its threads instead of the main thread
+  AudioWorkerPool *pool = AudioWorkerPool::shared();
+  if (pool == 0)
+  {
+    src->registerSink(proc, true);
+    return proc;
+  }
+
+  AudioWorkerStage *stage = new AudioWorkerStage(pool, proc, true);
+  if (!stage->initOk())
+  {
+    cerr << "*** ERROR: Could not set up audio worker stage for RX \""
+         << name() << "\"\n";
+    delete stage;
+    return 0;
+  }
+  src->registerSink(stage, true);
+  return stage;
+} /* LocalRxBase::addProcessor */
+
+
 void LocalRxBase::sel5Detected(std::string sequence)
 {
   if (mute_state == MUTE_NONE)
@@ -850,6 +1034,7 @@ void LocalRxBase::onSquelchOpen(bool is_open)
     {
       delay->clear();
     }
+    updateDetectorActivation();
     setSquelchState(true);
     if (mute_state == MUTE_NONE)
     {
@@ -873,6 +1058,7 @@ void LocalRxBase::onSquelchOpen(bool is_open)
     {
       sql_valve->setOpen(false);
     }
+    updateDetectorActivation();
     siglevdet->setIntegrationTime(0);
     siglevdet->setContinuousUpdateInterval(0);
   }
@@ -960,10 +1146,30 @@ void LocalRxBase::cfgUpdated(const std::string& section, const std::string& tag)
                 << sql_extended_hangtime_thresh
                 << " for receiver " << name() << std::endl;
     }
+    else if (tag == "PREAMP")
+    {
+      if (cfg().getValue(name(), "PREAMP", preamp_gain))
+      {
+        preamp->setGain(preamp_gain);
+        std::cout << "Setting PREAMP to " << preamp_gain
+                  << " for receiver " << name() << std::endl;
+      }
+    }
   }
 } /* LocalRxBase::cfgUpdated */
 
 
+void LocalRxBase::updateDetectorActivation(void)
+{
+  if (det_gate == 0)
+  {
+    return;
+  }
+  det_gate->setAwake((mute_state == MUTE_NONE) &&
+                     (!sql_gated_detectors || squelch_det->isOpen()));
+} /* LocalRxBase::updateDetectorActivation */
+
+
 /*
  * This file has not been truncated
  */
@@ -73,12 +73,16 @@ namespace Async
 {
   class Config;
   class AudioSplitter;
+  class AudioAmp;
   class AudioValve;
   class AudioFifo;
+  class AudioProcessor;
 };
 
 class Squelch;
 class HdlcDeframer;
+class ToneDetectorBank;
+class DetectorGate;
 
 
 /****************************************************************************
@@ -192,7 +196,7 @@ class LocalRxBase : public Rx
      *
      * This signal will be emitted as soon as a new SNR value for the CTCSS
      * tone has been calculated. The signal will only be emitted when
-     * CTCSS_MODE is set to 2 or 3.
+     * CTCSS_MODE is set to 2, 3 or 4.
      */
     sigc::signal<void, float> ctcssSnrUpdated;
     
@@ -241,10 +245,12 @@ class LocalRxBase : public Rx
     Squelch   	      	      	*squelch_det;
     SigLevDet 	      	        *siglevdet;
     Async::AudioSplitter      	*tone_dets;
+    ToneDetectorBank            *tone_det_bank;
     Async::AudioValve 	        *sql_valve;
     Async::AudioDelayLine     	*delay;
     int       	      	      	sql_tail_elim;
     float            	      	preamp_gain;
+    Async::AudioAmp             *preamp;
     Async::AudioValve 	      	*mute_valve;
     unsigned                    sql_hangtime;
     unsigned                    sql_extended_hangtime;
@@ -254,8 +260,12 @@ class LocalRxBase : public Rx
     HdlcDeframer *              ob_afsk_deframer;
     HdlcDeframer *              ib_afsk_deframer;
     bool                        audio_dev_keep_open;
+    DetectorGate                *det_gate;
+    bool                        sql_gated_detectors;
 
     int audioRead(float *samples, int count);
+    Async::AudioSource *addProcessor(Async::AudioSource *src,
+                                     Async::AudioProcessor *proc);
     void dtmfDigitActivated(char digit);
     void dataFrameReceived(std::vector<uint8_t> frame);
     void dataFrameReceivedIb(std::vector<uint8_t> frame);
@@ -269,6 +279,7 @@ class LocalRxBase : public Rx
     void rxReadyStateChanged(void);
     void publishSquelchState(void);
     void cfgUpdated(const std::string& section, const std::string& tag);
+    void updateDetectorActivation(void);
 
 };  /* class LocalRxBase */
 
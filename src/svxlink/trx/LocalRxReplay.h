@@ -0,0 +1,138 @@
+/**
+@file   LocalRxReplay.h
+@brief  A local receiver fed with audio by the application
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef LOCAL_RX_REPLAY_INCLUDED
+#define LOCAL_RX_REPLAY_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioPassthrough.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "LocalRxBase.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A local receiver fed with audio by the application
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This is a local receiver, configured just like any other local receiver,
+where the audio is written by the application instead of being read from a
+sound card. It is used by the tools that run receiver measurements on
+recorded audio as fast as the CPU allow. The audio must be sampled at the
+internal sample rate.
+*/
+class LocalRxReplay : public LocalRxBase
+{
+  public:
+    /**
+     * @brief 	Constructor
+     * @param 	cfg   The configuration object to use
+     * @param 	name  The name of the receiver configuration section
+     */
+    LocalRxReplay(Async::Config &cfg, const std::string &name)
+      : LocalRxBase(cfg, name) {}
+
+    /**
+     * @brief 	Write audio into the receiver chain
+     * @param 	samples The samples to write
+     * @param 	count   The number of samples to write
+     * @return	Returns the number of samples accepted
+     */
+    int write(const float *samples, int count)
+    {
+      return m_src.writeSamples(samples, count);
+    }
+
+  protected:
+    virtual bool audioOpen(void) { return true; }
+    virtual void audioClose(void) {}
+    virtual int audioSampleRate(void) { return INTERNAL_SAMPLE_RATE; }
+    virtual Async::AudioSource *audioSource(void) { return &m_src; }
+
+  private:
+    Async::AudioPassthrough m_src;
+
+};  /* class LocalRxReplay */
+
+
+#endif /* LOCAL_RX_REPLAY_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -30,7 +30,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <cctype>
 #include <iostream>
+#include <vector>
 
 
 /****************************************************************************
@@ -41,6 +46,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncConfig.h>
 #include <AsyncAudioPacer.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncAudioProcessor.h>
+#include <AsyncAudioNoiseGenerator.h>
 
 
 /****************************************************************************
@@ -77,6 +85,162 @@ using namespace Async;
  *
  ****************************************************************************/
 
+/**
+ * Shape the simulated receiver signal to give a more realistic load. The
+ * signal can be keyed on and off periodically, the tone can be replaced by a
+ * voice like signal and a CTCSS tone and DTMF digits can be added. When no
+ * options are set the samples are passed through unmodified.
+ */
+class LocalRxSim::Shaper : public AudioProcessor
+{
+  public:
+    Shaper(unsigned seed)
+      : rate(INTERNAL_SAMPLE_RATE), noise(seed), t(0), key_interval(0),
+        key_duration(0), voice(false), voice_gain(0.0f), lp_hi(0.0f),
+        lp_lo(0.0f), ctcss_inc(0.0f), ctcss_amp(0.0f), ctcss_arg(0.0f),
+        dtmf_amp(0.0f), env_arg(0.0f), noise_sigma(0.0f)
+    {
+    }
+
+    void setKeying(unsigned interval_ms, unsigned duration_ms)
+    {
+      key_interval = static_cast<unsigned long long>(interval_ms) * rate / 1000;
+      key_duration = static_cast<unsigned long long>(duration_ms) * rate / 1000;
+    }
+
+    void setVoice(float pwr_db)
+    {
+      voice = true;
+
+        // Measure the power of the filtered noise to be able to set the
+        // requested level
+      double pwr = 0.0;
+      const int cnt = rate;
+      for (int i=0; i<cnt; ++i)
+      {
+        float x = voiceSample();
+        pwr += x * x;
+      }
+      voice_gain = sqrt(pow(10.0, pwr_db / 10.0) / 2.0 / (pwr / cnt));
+    }
+
+    void setNoise(float pwr_db)
+    {
+      noise_sigma = sqrtf(powf(10.0f, pwr_db / 10.0f) / 2.0f);
+    }
+
+    void setCtcss(float fq, float pwr_db)
+    {
+      ctcss_inc = 2.0f * M_PI * fq / rate;
+      ctcss_amp = sqrtf(2.0f * powf(10.0f, pwr_db / 10.0f) / 2.0f);
+    }
+
+    bool setDtmf(const string& digits, float pwr_db)
+    {
+      static const char keys[] = "123A456B789C*0#D";
+      static const float row_fqs[] = { 697, 770, 852, 941 };
+      static const float col_fqs[] = { 1209, 1336, 1477, 1633 };
+      dtmf_tones.clear();
+      for (string::const_iterator it=digits.begin(); it!=digits.end(); ++it)
+      {
+        const char *key = strchr(keys, toupper(*it));
+        if ((*it == '\0') || (key == 0))
+        {
+          return false;
+        }
+        const int idx = key - keys;
+        dtmf_tones.push_back(2.0f * M_PI * row_fqs[idx / 4] / rate);
+        dtmf_tones.push_back(2.0f * M_PI * col_fqs[idx % 4] / rate);
+      }
+      dtmf_amp = sqrtf(2.0f * powf(10.0f, pwr_db / 10.0f) / 2.0f);
+      return true;
+    }
+
+  protected:
+    virtual void processSamples(float *dest, const float *src, int count)
+    {
+      const unsigned long long dtmf_start = rate * DTMF_DELAY_MS / 1000;
+      const unsigned long long dtmf_tone = rate * DTMF_TONE_MS / 1000;
+      const unsigned long long dtmf_period = 2 * dtmf_tone;
+      for (int i=0; i<count; ++i, ++t)
+      {
+        const unsigned long long pos =
+          (key_interval > 0) ? (t % key_interval) : t;
+        if ((key_interval > 0) && (pos >= key_duration))
+        {
+          dest[i] = 0.0f;
+          continue;
+        }
+
+        float sample = voice ? voice_gain * voiceSample() : src[i];
+
+        if (ctcss_amp > 0.0f)
+        {
+          sample += ctcss_amp * sinf(ctcss_arg);
+          ctcss_arg += ctcss_inc;
+          ctcss_arg = (ctcss_arg > 2.0f * M_PI)
+            ? ctcss_arg - 2.0f * M_PI : ctcss_arg;
+        }
+
+        if (!dtmf_tones.empty() && (pos >= dtmf_start))
+        {
+          const unsigned long long dpos = pos - dtmf_start;
+          const size_t digit = dpos / dtmf_period;
+          if ((2 * digit < dtmf_tones.size()) &&
+              (dpos % dtmf_period < dtmf_tone))
+          {
+            const float n = static_cast<float>(dpos % dtmf_period);
+            sample += dtmf_amp * (sinf(dtmf_tones[2 * digit] * n) +
+                                  sinf(dtmf_tones[2 * digit + 1] * n));
+          }
+        }
+
+        dest[i] = sample;
+      }
+
+        // The receiver noise is there whether the station is keyed or not
+      if (noise_sigma > 0.0f)
+      {
+        noise.add(dest, dest, count, noise_sigma);
+      }
+    }
+
+  private:
+    static const unsigned DTMF_DELAY_MS = 500;
+    static const unsigned DTMF_TONE_MS  = 100;
+
+    const unsigned      rate;
+    AudioNoiseGenerator noise;
+    unsigned long long  t;
+    unsigned long long  key_interval;
+    unsigned long long  key_duration;
+    bool                voice;
+    float               voice_gain;
+    float               lp_hi;
+    float               lp_lo;
+    float               ctcss_inc;
+    float               ctcss_amp;
+    float               ctcss_arg;
+    std::vector<float>  dtmf_tones;
+    float               dtmf_amp;
+    float               env_arg;
+    float               noise_sigma;
+
+      // Speech band noise, 300-3000Hz, amplitude modulated at a syllabic
+      // rate of 4Hz
+    float voiceSample(void)
+    {
+      const float a_hi = expf(-2.0f * M_PI * 3000.0f / rate);
+      const float a_lo = expf(-2.0f * M_PI * 300.0f / rate);
+      const float x = noise.gaussian();
+      lp_hi = a_hi * lp_hi + (1.0f - a_hi) * x;
+      lp_lo = a_lo * lp_lo + (1.0f - a_lo) * x;
+      env_arg += 2.0f * M_PI * 4.0f / rate;
+      env_arg = (env_arg > 2.0f * M_PI) ? env_arg - 2.0f * M_PI : env_arg;
+      return (lp_hi - lp_lo) * (0.6f + 0.4f * sinf(env_arg));
+    }
+};  /* class LocalRxSim::Shaper */
+
 
 
 /****************************************************************************
@@ -111,7 +275,7 @@ unsigned int LocalRxSim::next_seed = 0;
  ****************************************************************************/
 
 LocalRxSim::LocalRxSim(Config &cfg, const std::string& name)
-  : LocalRxBase(cfg, name), cfg(cfg), pacer(0)
+  : LocalRxBase(cfg, name), cfg(cfg), shaper(0), pacer(0)
 {
 } /* LocalRxSim::LocalRxSim */
 
@@ -127,6 +291,12 @@ bool LocalRxSim::initialize(void)
   cfg.getValue(name(), "SIM_TONE_FQ", tone_fq);
   audio_gen.setFq(tone_fq);
 
+  shaper = new Shaper(next_seed++);
+
+  float sim_tone_pwr_db = -20.0f;
+  cfg.getValue(name(), "SIM_TONE_PWR", sim_tone_pwr_db);
+  audio_gen.setPower(sim_tone_pwr_db);
+
   string waveform("SIN");
   cfg.getValue(name(), "SIM_WAVEFORM", waveform);
   if (waveform == "SIN")
@@ -137,20 +307,67 @@ bool LocalRxSim::initialize(void)
   {
     audio_gen.setWaveform(AudioGenerator::SQUARE);
   }
+  else if (waveform == "VOICE")
+  {
+    shaper->setVoice(sim_tone_pwr_db);
+  }
   else
   {
     cerr << "*** ERROR: Unknown waveform specified in "
          << name() << "/" << "SIM_WAVEFORM (\"" << waveform 
-         << "\"). Valid values are: SIN, SQUARE.\n";
+         << "\"). Valid values are: SIN, SQUARE, VOICE.\n";
+    delete shaper;
+    shaper = 0;
     return false;
   }
 
-  float sim_tone_pwr_db = -20.0f;
-  cfg.getValue(name(), "SIM_TONE_PWR", sim_tone_pwr_db);
-  audio_gen.setPower(sim_tone_pwr_db);
+  unsigned key_interval = 0;
+  unsigned key_duration = 0;
+  cfg.getValue(name(), "SIM_KEY_INTERVAL", key_interval);
+  cfg.getValue(name(), "SIM_KEY_DURATION", key_duration);
+  if ((key_interval > 0) && ((key_duration == 0) ||
+                             (key_duration > key_interval)))
+  {
+    cerr << "*** ERROR: " << name() << "/SIM_KEY_DURATION must be between "
+         << "1 and SIM_KEY_INTERVAL (" << key_interval << ")\n";
+    delete shaper;
+    shaper = 0;
+    return false;
+  }
+  shaper->setKeying(key_interval, key_duration);
+
+  float ctcss_fq = 0.0f;
+  cfg.getValue(name(), "SIM_CTCSS_FQ", ctcss_fq);
+  if (ctcss_fq > 0.0f)
+  {
+    float ctcss_pwr_db = -25.0f;
+    cfg.getValue(name(), "SIM_CTCSS_PWR", ctcss_pwr_db);
+    shaper->setCtcss(ctcss_fq, ctcss_pwr_db);
+  }
+
+  float noise_pwr_db = 0.0f;
+  if (cfg.getValue(name(), "SIM_NOISE_PWR", noise_pwr_db))
+  {
+    shaper->setNoise(noise_pwr_db);
+  }
+
+  string dtmf_digits;
+  cfg.getValue(name(), "SIM_DTMF", dtmf_digits);
+  float dtmf_pwr_db = -15.0f;
+  cfg.getValue(name(), "SIM_DTMF_PWR", dtmf_pwr_db);
+  if (!shaper->setDtmf(dtmf_digits, dtmf_pwr_db))
+  {
+    cerr << "*** ERROR: Illegal DTMF digits in " << name()
+         << "/SIM_DTMF (\"" << dtmf_digits << "\"). Valid digits are: "
+         << "0-9, A-D, * and #.\n";
+    delete shaper;
+    shaper = 0;
+    return false;
+  }
 
   pacer = new Async::AudioPacer(INTERNAL_SAMPLE_RATE, 128, 0);
-  audio_gen.registerSink(pacer, true);
+  audio_gen.registerSink(shaper, true);
+  shaper->registerSink(pacer, true);
 
   if (!LocalRxBase::initialize())
   {
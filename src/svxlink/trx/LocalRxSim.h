@@ -173,10 +173,13 @@ class LocalRxSim : public LocalRxBase
     virtual Async::AudioSource *audioSource(void);
     
   private:
+    class Shaper;
+
     static unsigned int next_seed;
 
     Async::Config         &cfg;
     Async::AudioGenerator audio_gen;
+    Shaper                *shaper;
     Async::AudioPacer     *pacer;
 };  /* class LocalRxSim */
 
@@ -42,6 +42,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <unistd.h>
 
 #include <iostream>
+#include <sstream>
 #include <cstdio>
 #include <cstring>
 #include <algorithm>
@@ -49,6 +50,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <limits>
 
 #include <sigc++/sigc++.h>
+#include <json/json.h>
 
 
 /****************************************************************************
@@ -60,13 +62,16 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioIO.h>
 #include <AsyncConfig.h>
 #include <AsyncAudioClipper.h>
+#include <AsyncAudioProcessorChain.h>
 #include <AsyncAudioCompressor.h>
 #include <AsyncAudioFilter.h>
 #include <AsyncAudioSelector.h>
 #include <AsyncAudioValve.h>
 #include <AsyncAudioPassthrough.h>
 #include <AsyncAudioFifo.h>
+#include <AsyncAudioOscillator.h>
 #include <AsyncAudioInterpolator.h>
+#include <AsyncAudioResampler.h>
 #include <AsyncAudioAmp.h>
 #include <AsyncAudioMixer.h>
 #include <AsyncAudioDebugger.h>
@@ -75,6 +80,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <HdlcFramer.h>
 #include <AfskModulator.h>
 #include <AsyncAudioFsf.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -87,6 +93,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "DtmfEncoder.h"
 #include "multirate_filter_coeff.h"
 #include "PttCtrl.h"
+#include "PlayoutBuffer.h"
 #include "SigLevDetAfsk.h"
 #include "Rx.h"
 #include "Emphasis.h"
@@ -125,8 +132,8 @@ class SineGenerator : public Async::AudioSource
 {
   public:
     explicit SineGenerator(const string& audio_dev, int channel)
-      : audio_io(audio_dev, channel), pos(0), fq(0.0), level(0.0),
-        sample_rate(0), audio_dev_keep_open(false)
+      : audio_io(audio_dev, channel), fq(0.0), sample_rate(0),
+        audio_dev_keep_open(false)
     {
       sample_rate = audio_io.sampleRate();
       audio_io.registerSource(this);
@@ -140,11 +147,12 @@ class SineGenerator : public Async::AudioSource
     void setFq(double tone_fq)
     {
       fq = tone_fq;
+      osc.setFq(fq, sample_rate);
     }
     
     void setLevel(int level_percent)
     {
-      level = level_percent / 100.0;
+      osc.setAmplitude(level_percent / 100.0);
     }
 
     void setKeepOpen(bool keep_open)
@@ -163,7 +171,7 @@ class SineGenerator : public Async::AudioSource
       {
       	if (audio_io.open(AudioIO::MODE_WR))
         {
-          pos = 0;
+          osc.reset();
           writeSamples();
         }
       }
@@ -190,10 +198,9 @@ class SineGenerator : public Async::AudioSource
     static const int BLOCK_SIZE = 128;
     
     AudioIO   audio_io;
-    unsigned  pos;
     double    fq;
-    double    level;
     int       sample_rate;
+    AudioOscillator osc;
     bool      audio_dev_keep_open;
     
     void writeSamples(void)
@@ -201,12 +208,9 @@ class SineGenerator : public Async::AudioSource
       int written;
       do {
 	float buf[BLOCK_SIZE];
-	for (int i=0; i<BLOCK_SIZE; ++i)
-	{
-      	  buf[i] = level * sin(2 * M_PI * fq * (pos+i) / sample_rate);
-	}
+	osc.generate(buf, BLOCK_SIZE);
 	written = sinkWriteSamples(buf, BLOCK_SIZE);
-	pos += written;
+	osc.advance(written - BLOCK_SIZE);
       } while (written != 0);
     }
     
@@ -250,7 +254,8 @@ LocalTx::LocalTx(Config& cfg, const string& name)
     fsk_mod(0), /*fsk_valve(0),*/ input_handler(0), ptt_ctrl(0),
     audio_valve(0), siglev_sine_gen(0), ptt_hangtimer(0), ptt(0),
     last_rx_id(Rx::ID_UNKNOWN), fsk_first_packet_transmitted(false),
-    hdlc_framer_ib(0), fsk_mod_ib(0), ctrl_pty(0), audio_dev_keep_open(false)
+    hdlc_framer_ib(0), fsk_mod_ib(0), ctrl_pty(0), audio_dev_keep_open(false),
+    master_gain_stage(0), processed_input(0), latency_monitor(0)
 {
 
 } /* LocalTx::LocalTx */
@@ -266,6 +271,7 @@ LocalTx::~LocalTx(void)
   
   clearHandler();
   delete input_handler;
+  delete processed_input;
   delete selector;
   delete dtmf_encoder;
   delete fsk_mod;
@@ -378,6 +384,17 @@ bool LocalTx::initialize(void)
   }
 #endif
 
+  int audio_dev_blocksize = 0;
+  if (cfg.getValue(name(), "AUDIO_DEV_BLOCKSIZE", audio_dev_blocksize))
+  {
+    audio_io->setDeviceBlocksize(audio_dev_blocksize);
+  }
+  int audio_dev_block_count = 0;
+  if (cfg.getValue(name(), "AUDIO_DEV_BLOCK_COUNT", audio_dev_block_count))
+  {
+    audio_io->setDeviceBlockCount(audio_dev_block_count);
+  }
+
   cfg.getValue(name(), "AUDIO_DEV_KEEP_OPEN", audio_dev_keep_open);
   if (audio_dev_keep_open && !audio_io->open(AudioIO::MODE_WR))
   {
@@ -401,8 +418,9 @@ bool LocalTx::initialize(void)
     //audio_io->setGain((100.0 - level) / 100.0);
   }
 
-#if INTERNAL_SAMPLE_RATE >= 16000
-  if (cfg.getValue(name(), "TONE_SIGLEV_MAP", value))
+    // The siglev tones are above the audio band of a narrowband system
+  if ((INTERNAL_SAMPLE_RATE >= 16000) &&
+      cfg.getValue(name(), "TONE_SIGLEV_MAP", value))
   {
     int siglev_level = 10;
     cfg.getValue(name(), "TONE_SIGLEV_LEVEL", siglev_level, true);
@@ -420,7 +438,6 @@ bool LocalTx::initialize(void)
            << "contain exactly ten comma separated siglev values.\n";
     }
   }
-#endif
 
   bool ob_afsk_enable = false;
   cfg.getValue(name(), "OB_AFSK_ENABLE", ob_afsk_enable);
@@ -441,6 +458,21 @@ bool LocalTx::initialize(void)
   setHandler(input_handler);
   prev_src = input_handler;
   
+    // Delay each talk spurt to line up with the other transmitters in a
+    // simulcast group
+  unsigned simulcast_delay = 0;
+  cfg.getValue(name(), "SIMULCAST_DELAY", simulcast_delay);
+  if (simulcast_delay > 0)
+  {
+    PlayoutBuffer *playout = new PlayoutBuffer(name(), simulcast_delay);
+    playout->setDelay(simulcast_delay);
+    int simulcast_tx_offset = 0;
+    cfg.getValue(name(), "SIMULCAST_TX_OFFSET", simulcast_tx_offset);
+    playout->setOffset(simulcast_tx_offset);
+    prev_src->registerSink(playout, true);
+    prev_src = playout;
+  }
+
   /*
   AudioCompressor *comp = new AudioCompressor;
   comp->setThreshold(-10);
@@ -452,54 +484,12 @@ bool LocalTx::initialize(void)
   prev_src = comp;
   */
   
-    // If preemphasis is enabled, create the preemphasis filter
-  if (cfg.getValue(name(), "PREEMPHASIS", value) && (atoi(value.c_str()) != 0))
-  {
-    //AudioFilter *preemph = new AudioFilter("HsBq1/0.05/36/3500");
-    //preemph->setOutputGain(-9.0f);
-    /*
-#if INTERNAL_SAMPLE_RATE < 16000
-    AudioFilter *preemph = new AudioFilter("LpBu1/3000 x HpBu1/3000");
-    preemph->setOutputGain(26);
-#else
-    AudioFilter *preemph = new AudioFilter("LpBu3/5500 x HpBu1/3000");
-    preemph->setOutputGain(21);
-#endif
-    */
+    // The preemphasis filter, the clipper and the splatter filter are run
+    // as one processing stage
+  AudioProcessorChain *tx_chain = createProcessorChain();
+  prev_src->registerSink(tx_chain, true);
+  prev_src = tx_chain;
 
-    PreemphasisFilter *preemph = new PreemphasisFilter;
-    prev_src->registerSink(preemph, true);
-    prev_src = preemph;
-  }
-  
-  /*
-  AudioCompressor *limit = new AudioCompressor;
-  limit->setThreshold(-1);
-  limit->setRatio(0.1);
-  limit->setAttack(2);
-  limit->setDecay(20);
-  limit->setOutputGain(1);
-  prev_src->registerSink(limit, true);
-  prev_src = limit;
-  */
-  
-    // Clip audio to limit its amplitude
-  AudioClipper *clipper = new AudioClipper;
-  prev_src->registerSink(clipper, true);
-  prev_src = clipper;
-  
-#if 1
-    // Filter out high frequencies generated by the previous clipping
-#if (INTERNAL_SAMPLE_RATE == 16000)
-  //AudioFilter *splatter_filter = new AudioFilter("LpBu10/5500");
-  AudioFilter *splatter_filter = new AudioFilter("LpCh9/-0.05/5500");
-#else
-  AudioFilter *splatter_filter = new AudioFilter("LpBu20/3500");
-#endif
-  prev_src->registerSink(splatter_filter, true);
-  prev_src = splatter_filter;
-#endif
-  
     // Create a valve so that we can control when to transmit audio
   #if USE_AUDIO_VALVE
   audio_valve = new AudioValve;
@@ -655,40 +645,62 @@ bool LocalTx::initialize(void)
   prev_src->registerSink(ptt_ctrl, true);
   prev_src = ptt_ctrl;
 
+    // Always create the master gain stage so that the gain can be changed
+    // at runtime
   float master_gain = 0.0f;
-  if (cfg.getValue(name(), "MASTER_GAIN", master_gain))
+  cfg.getValue(name(), "MASTER_GAIN", master_gain);
+  master_gain_stage = new AudioAmp;
+  master_gain_stage->setGain(master_gain);
+  prev_src->registerSink(master_gain_stage, true);
+  prev_src = master_gain_stage;
+  cfg.subscribeValue<float>(name(), "MASTER_GAIN",
+      mem_fun(*this, &LocalTx::setMasterGain));
+
+  const int card_rate = audio_io->sampleRate();
+  if ((card_rate != 8000) && (card_rate != 16000) && (card_rate != 48000))
   {
-    AudioAmp *master_gain_stage = new AudioAmp;
-    master_gain_stage->setGain(master_gain);
-    prev_src->registerSink(master_gain_stage, true);
-    prev_src = master_gain_stage;
+      // Other sound card sample rates, like 44.1kHz, are resampled directly
+      // from the internal sample rate
+    AudioResampler *resampler =
+      new AudioResampler(INTERNAL_SAMPLE_RATE, card_rate);
+    prev_src->registerSink(resampler, true);
+    prev_src = resampler;
   }
-
-#if (INTERNAL_SAMPLE_RATE != 16000)  
-  if (audio_io->sampleRate() > 8000)
+  else
   {
-      // Interpolate sample rate to 16kHz
-    AudioInterpolator *i1 = new AudioInterpolator(2, coeff_16_8,
-                                                  coeff_16_8_taps);
-    prev_src->registerSink(i1, true);
-    prev_src = i1;
-  }
-#endif
+    if ((INTERNAL_SAMPLE_RATE != 16000) && (card_rate > 8000))
+    {
+        // Interpolate sample rate to 16kHz
+      AudioInterpolator *i1 = new AudioInterpolator(2, coeff_16_8,
+                                                    coeff_16_8_taps);
+      prev_src->registerSink(i1, true);
+      prev_src = i1;
+    }
 
-  if (audio_io->sampleRate() > 16000)
-  {
-      // Interpolate sample rate to 48kHz
-#if (INTERNAL_SAMPLE_RATE == 8000)
-    AudioInterpolator *i2 = new AudioInterpolator(3, coeff_48_16_int,
-                                                  coeff_48_16_int_taps);
-#else
-    AudioInterpolator *i2 = new AudioInterpolator(3, coeff_48_16,
-                                                  coeff_48_16_taps);
-#endif
-    prev_src->registerSink(i2, true);
-    prev_src = i2;
+    if (card_rate > 16000)
+    {
+        // Interpolate sample rate to 48kHz
+      AudioInterpolator *i2 = 0;
+      if (INTERNAL_SAMPLE_RATE == 8000)
+      {
+        i2 = new AudioInterpolator(3, coeff_48_16_int, coeff_48_16_int_taps);
+      }
+      else
+      {
+        i2 = new AudioInterpolator(3, coeff_48_16, coeff_48_16_taps);
+      }
+      prev_src->registerSink(i2, true);
+      prev_src = i2;
+    }
   }
   
+    // Measure the PTT and audio latencies just before the audio device
+  latency_monitor = new TxLatencyMonitor(name(), audio_io);
+  latency_monitor->transmissionMeasured.connect(
+      mem_fun(*this, &LocalTx::publishLatencies));
+  prev_src->registerSink(latency_monitor, true);
+  prev_src = latency_monitor;
+
     // Finally connect the whole audio pipe to the audio device
   prev_src->registerSink(audio_io, true);
 
@@ -771,7 +783,11 @@ void LocalTx::setTransmittedSignalStrength(char rx_id, float siglev)
   //     << " siglev=" << siglev
   //     << endl;
 
-#if INTERNAL_SAMPLE_RATE >= 16000
+  if (INTERNAL_SAMPLE_RATE < 16000)
+  {
+    return;
+  }
+
   if (hdlc_framer != 0)
   {
     fsk_trailer_transmitted = false;
@@ -822,7 +838,6 @@ void LocalTx::setTransmittedSignalStrength(char rx_id, float siglev)
 
     siglev_sine_gen->enable(false);
   }
-#endif
 } /* LocalTx::setTransmittedSignalLevel */
 
 
@@ -860,6 +875,32 @@ void LocalTx::setModulation(Modulation::Type mod)
 } /* LocalTx::setModulation */
 
 
+std::string LocalTx::audioProcessingKey(void) const
+{
+    // The processing chain only depend on the preemphasis setting since the
+    // internal sample rate is the same for all transmitters
+  return preemphasisEnabled() ? "LocalTx:PREEMPHASIS" : "LocalTx";
+} /* LocalTx::audioProcessingKey */
+
+
+AudioProcessor* LocalTx::createAudioProcessor(void) const
+{
+  return createProcessorChain();
+} /* LocalTx::createAudioProcessor */
+
+
+AudioSink* LocalTx::processedAudioInput(void)
+{
+  if ((processed_input == 0) && (selector != 0))
+  {
+    processed_input = new AudioPassthrough;
+    selector->addSource(processed_input);
+    selector->enableAutoSelect(processed_input, 0);
+  }
+  return processed_input;
+} /* LocalTx::processedAudioInput */
+
+
 /****************************************************************************
  *
  * Protected member functions
@@ -882,6 +923,7 @@ void LocalTx::transmit(bool do_transmit)
     fsk_trailer_transmitted = false;
 
     setIsTransmitting(true);
+    latency_monitor->transmitterOn();
 
     if (!audio_io->open(AudioIO::MODE_WR))
     {
@@ -909,6 +951,8 @@ void LocalTx::transmit(bool do_transmit)
   }
   else
   {
+    latency_monitor->transmitterOff();
+
     if (!audio_dev_keep_open)
     {
       audio_io->close();
@@ -988,6 +1032,15 @@ bool LocalTx::setPtt(bool tx, bool with_hangtime)
     return false;
   }
 
+  if (tx)
+  {
+    latency_monitor->pttAsserted();
+  }
+  else
+  {
+    latency_monitor->pttReleased();
+  }
+
   return true;
 
 } /* LocalTx::setPtt */
@@ -1040,6 +1093,14 @@ bool LocalTx::preTransmitterStateChange(bool do_transmit)
 } /* LocalTx::preTransmitterStateChange */
 
 
+void LocalTx::setMasterGain(const float& gain)
+{
+  master_gain_stage->setGain(gain);
+  cout << "Setting MASTER_GAIN to " << gain << " for transmitter "
+       << name() << endl;
+} /* LocalTx::setMasterGain */
+
+
 void LocalTx::sendFskSiglev(char rxid, uint8_t siglev)
 {
   //cout << "### LocalTx::sendFskSiglev: rxid=" << rxid
@@ -1087,6 +1148,102 @@ void LocalTx::sendFskDtmf(const string &digits, unsigned duration)
 } /* LocalTx::sendFskDtmf */
 
 
+bool LocalTx::preemphasisEnabled(void) const
+{
+  string value;
+  return cfg.getValue(name(), "PREEMPHASIS", value) &&
+         (atoi(value.c_str()) != 0);
+} /* LocalTx::preemphasisEnabled */
+
+
+AudioProcessorChain* LocalTx::createProcessorChain(void) const
+{
+  AudioProcessorChain *tx_chain = new AudioProcessorChain;
+
+    // If preemphasis is enabled, create the preemphasis filter
+  if (preemphasisEnabled())
+  {
+    //AudioFilter *preemph = new AudioFilter("HsBq1/0.05/36/3500");
+    //preemph->setOutputGain(-9.0f);
+    /*
+#if INTERNAL_SAMPLE_RATE < 16000
+    AudioFilter *preemph = new AudioFilter("LpBu1/3000 x HpBu1/3000");
+    preemph->setOutputGain(26);
+#else
+    AudioFilter *preemph = new AudioFilter("LpBu3/5500 x HpBu1/3000");
+    preemph->setOutputGain(21);
+#endif
+    */
+
+    PreemphasisFilter *preemph = new PreemphasisFilter;
+    tx_chain->addProcessor(preemph, true);
+  }
+  
+  /*
+  AudioCompressor *limit = new AudioCompressor;
+  limit->setThreshold(-1);
+  limit->setRatio(0.1);
+  limit->setAttack(2);
+  limit->setDecay(20);
+  limit->setOutputGain(1);
+  prev_src->registerSink(limit, true);
+  prev_src = limit;
+  */
+  
+    // Clip audio to limit its amplitude
+  AudioClipper *clipper = new AudioClipper;
+  tx_chain->addProcessor(clipper, true);
+  
+#if 1
+    // Filter out high frequencies generated by the previous clipping
+  AudioFilter *splatter_filter = 0;
+  if (INTERNAL_SAMPLE_RATE == 16000)
+  {
+    //splatter_filter = new AudioFilter("LpBu10/5500");
+    splatter_filter = new AudioFilter("LpCh9/-0.05/5500");
+  }
+  else
+  {
+    splatter_filter = new AudioFilter("LpBu20/3500");
+  }
+  tx_chain->addProcessor(splatter_filter, true);
+#endif
+
+  return tx_chain;
+} /* LocalTx::createProcessorChain */
+
+
+void LocalTx::publishLatencies(const TxLatencyMonitor::Latencies& latencies)
+{
+  Json::Value tx(Json::objectValue);
+  tx["name"] = name();
+  if (latencies.keyup_ms >= 0.0)
+  {
+    tx["keyupMs"] = latencies.keyup_ms;
+  }
+  if (latencies.audio_start_ms >= 0.0)
+  {
+    tx["audioStartMs"] = latencies.audio_start_ms;
+  }
+  if (latencies.air_ms >= 0.0)
+  {
+    tx["airMs"] = latencies.air_ms;
+  }
+  if (latencies.release_ms >= 0.0)
+  {
+    tx["releaseMs"] = latencies.release_ms;
+  }
+  Json::StreamWriterBuilder builder;
+  builder["commentStyle"] = "None";
+  builder["indentation"] = ""; //The JSON document is written on a single line
+  Json::StreamWriter* writer = builder.newStreamWriter();
+  stringstream os;
+  writer->write(tx, &os);
+  delete writer;
+  publishStateEvent("Tx:latency", os.str());
+} /* LocalTx::publishLatencies */
+
+
 
 /*
  * This file has not been truncated
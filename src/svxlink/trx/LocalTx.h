@@ -57,6 +57,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <RefCountingPty.h>
 #include "Tx.h"
+#include "TxLatencyMonitor.h"
 
 
 /****************************************************************************
@@ -76,6 +77,8 @@ namespace Async
   class AudioValve;
   class AudioPassthrough;
   class AudioMixer;
+  class AudioAmp;
+  class AudioProcessorChain;
 };
 
 class DtmfEncoder;
@@ -207,6 +210,24 @@ class LocalTx : public Tx
      */
     void setModulation(Modulation::Type mod);
 
+    /**
+     * @brief   Get a key identifying the audio processing front end
+     * @return  Returns a key identifying the preemphasis/clipper stage
+     */
+    std::string audioProcessingKey(void) const;
+
+    /**
+     * @brief   Create a copy of the audio processing front end
+     * @return  Returns a new preemphasis/clipper processing chain
+     */
+    Async::AudioProcessor* createAudioProcessor(void) const;
+
+    /**
+     * @brief   Get the input for audio that has already been processed
+     * @return  Returns an audio sink feeding the stages after the clipper
+     */
+    Async::AudioSink* processedAudioInput(void);
+
   private:
     Async::Config     	    &cfg;
     Async::AudioIO    	    *audio_io;
@@ -236,6 +257,9 @@ class LocalTx : public Tx
     AfskModulator           *fsk_mod_ib;
     RefCountingPty          *ctrl_pty;
     bool                    audio_dev_keep_open;
+    Async::AudioAmp         *master_gain_stage;
+    Async::AudioPassthrough *processed_input;
+    TxLatencyMonitor        *latency_monitor;
     
     void txTimeoutOccured(Async::Timer *t);
     bool setPtt(bool tx, bool with_hangtime=false);
@@ -243,8 +267,12 @@ class LocalTx : public Tx
     void allDtmfDigitsSent(void);
     void pttHangtimeExpired(Async::Timer *t);
     bool preTransmitterStateChange(bool do_transmit);
+    void setMasterGain(const float& gain);
     void sendFskSiglev(char rxid, uint8_t siglev);
     void sendFskDtmf(const std::string &digits, unsigned duration);
+    bool preemphasisEnabled(void) const;
+    Async::AudioProcessorChain* createProcessorChain(void) const;
+    void publishLatencies(const TxLatencyMonitor::Latencies& latencies);
 
 };  /* class LocalTx */
 
@@ -34,6 +34,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <iostream>
 #include <algorithm>
+#include <map>
+#include <vector>
 
 
 /****************************************************************************
@@ -43,6 +45,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncAudioSplitter.h>
+#include <AsyncAudioProcessor.h>
 #include <json/json.h>
 
 
@@ -177,8 +180,6 @@ bool MultiTx::initialize(void)
       tx->transmitterStateChange.connect(
       	      hide(mem_fun(*this, &MultiTx::onTransmitterStateChange)));
       
-      splitter->addSink(tx);
-      
       txs.push_back(tx);
     }
     if (comma == transmitters.end())
@@ -189,6 +190,7 @@ bool MultiTx::initialize(void)
     ++start;
   }
   
+  connectTransmitters();
   setHandler(splitter);
   
   return true;
@@ -324,6 +326,70 @@ void MultiTx::txStateDelayExpired(void)
 } /* MultiTx::txStateDelayExpired */
 
 
+void MultiTx::connectTransmitters(void)
+{
+    // Group the transmitters on their audio processing front ends
+  typedef std::map<std::string, std::vector<Tx*> > ProcGroups;
+  ProcGroups groups;
+  list<Tx *>::iterator it;
+  for (it=txs.begin(); it!=txs.end(); ++it)
+  {
+    string key = (*it)->audioProcessingKey();
+    if (!key.empty())
+    {
+      groups[key].push_back(*it);
+    }
+  }
+
+  for (it=txs.begin(); it!=txs.end(); ++it)
+  {
+    Tx *tx = *it;
+    ProcGroups::iterator git = groups.find(tx->audioProcessingKey());
+    if ((git == groups.end()) || (git->second.size() < 2))
+    {
+      splitter->addSink(tx);
+      continue;
+    }
+    std::vector<Tx*> &group = git->second;
+    if (group.front() != tx)
+    {
+      continue;
+    }
+
+      // Run the processing once for the whole group and split the audio up
+      // after it
+    AudioProcessor *proc = tx->createAudioProcessor();
+    AudioSplitter *proc_splitter = 0;
+    if (proc != 0)
+    {
+      splitter->addSink(proc, true);
+      proc_splitter = new AudioSplitter;
+      proc->registerSink(proc_splitter, true);
+      cout << "\tSharing audio processing between transmitters:";
+    }
+    std::vector<Tx*>::iterator gtx;
+    for (gtx=group.begin(); gtx!=group.end(); ++gtx)
+    {
+      AudioSink *input = (proc_splitter != 0)
+          ? (*gtx)->processedAudioInput() : 0;
+      if (input != 0)
+      {
+        proc_splitter->addSink(input);
+        cout << " " << (*gtx)->name();
+      }
+      else
+      {
+        splitter->addSink(*gtx);
+      }
+    }
+    if (proc != 0)
+    {
+      cout << endl;
+    }
+  }
+} /* MultiTx::connectTransmitters */
+
+
 /*
  * This file has not been truncated
  */
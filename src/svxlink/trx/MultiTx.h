@@ -117,6 +117,10 @@ namespace Async
 @date   2008-07-08
 
 This class make it possible to configure multiple transmitters for one logic.
+Transmitters that have identical audio processing front ends, as reported by
+Tx::audioProcessingKey, will share one instance of the processing. The audio
+is split up after the shared processing so only the per transmitter stages,
+like level adjustment and PTT control, are run for each transmitter.
 */
 class MultiTx : public Tx
 {
@@ -197,6 +201,7 @@ class MultiTx : public Tx
     MultiTx& operator=(const MultiTx&);
     void onTransmitterStateChange(void);
     void txStateDelayExpired(void);
+    void connectTransmitters(void);
     
 };  /* class MultiTx */
 
@@ -47,6 +47,11 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncConfig.h>
 #include <AsyncAudioDecoder.h>
+#include <AsyncAudioDecodeScheduler.h>
+#include <AsyncAudioJitterFifo.h>
+#include <AsyncAudioPacer.h>
+#include <AsyncTimer.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -136,7 +141,9 @@ NetRx::NetRx(Config &cfg, const string& name)
     log_disconnects_once(false), log_disconnect(true),
     last_signal_strength(0.0), last_sql_rx_id(Rx::ID_UNKNOWN),
     unflushed_samples(false), sql_is_open(false), audio_dec(0), fq(0),
-    modulation(Modulation::MOD_UNKNOWN)
+    modulation(Modulation::MOD_UNKNOWN), flush_guard_timer(0),
+    jitter_fifo(0), net_stats_timer(0), audio_needed(true),
+    audio_lookback_ms(0), jitter_buffer_ms(0)
 {
 } /* NetRx::NetRx */
 
@@ -144,7 +151,13 @@ NetRx::NetRx(Config &cfg, const string& name)
 NetRx::~NetRx(void)
 {
   clearHandler();
+  if (audio_dec != 0)
+  {
+    AudioDecodeScheduler::instance()->cancel(audio_dec);
+  }
   delete audio_dec;
+  delete flush_guard_timer;
+  delete net_stats_timer;
   
   tcp_con->deleteInstance();
   
@@ -214,13 +227,56 @@ bool NetRx::initialize(void)
     }
   }
   audio_dec->printCodecParams();
-  setHandler(audio_dec);
+
+  flush_guard_timer = new Timer(NET_TRX_UDP_FLUSH_GUARD);
+  flush_guard_timer->setEnable(false);
+  flush_guard_timer->expired.connect(
+      mem_fun(*this, &NetRx::flushGuardExpired));
+
+  bool udp_audio = false;
+  cfg.getValue(name(), "UDP_AUDIO", udp_audio);
+  if (udp_audio)
+  {
+      // Audio datagrams arrive with jitter so they are buffered and then
+      // paced out in real time
+    unsigned jitter_buffer = 100;
+    cfg.getValue(name(), "JITTER_BUFFER", jitter_buffer);
+    jitter_buffer_ms = jitter_buffer;
+    jitter_fifo =
+        new AudioJitterFifo(4 * jitter_buffer * INTERNAL_SAMPLE_RATE / 1000);
+    bool drift_comp = false;
+    cfg.getValue(name(), "DRIFT_COMPENSATION", drift_comp);
+    jitter_fifo->setDriftCompensation(drift_comp);
+    audio_dec->registerSink(jitter_fifo, true);
+    AudioPacer *pacer = new AudioPacer(INTERNAL_SAMPLE_RATE, 256,
+                                       jitter_buffer);
+    jitter_fifo->registerSink(pacer, true);
+    setHandler(pacer);
+
+    unsigned net_stats_interval = 60;
+    cfg.getValue(name(), "NET_STATS_INTERVAL", net_stats_interval);
+    if (net_stats_interval > 0)
+    {
+      net_stats_timer = new Timer(1000 * net_stats_interval,
+                                  Timer::TYPE_PERIODIC);
+      net_stats_timer->expired.connect(
+          mem_fun(*this, &NetRx::publishNetStats));
+    }
+  }
+  else
+  {
+    setHandler(audio_dec);
+  }
   
   tcp_con = NetTrxTcpClient::instance(host, atoi(tcp_port.c_str()));
   if (tcp_con == 0)
   {
     return false;
   }
+  if (udp_audio)
+  {
+    tcp_con->enableUdpAudio(atoi(udp_port.c_str()));
+  }
   tcp_con->setAuthKey(auth_key);
   tcp_con->isReady.connect(mem_fun(*this, &NetRx::connectionReady));
   tcp_con->msgReceived.connect(mem_fun(*this, &NetRx::handleMsg));
@@ -248,7 +304,7 @@ void NetRx::setMuteState(Rx::MuteState new_mute_state)
         case MUTE_CONTENT:  // MUTE_NONE -> MUTE_CONTENT
           if (unflushed_samples)
           {
-            audio_dec->flushEncodedSamples();
+            flushAudio();
           }
           break;
 
@@ -309,7 +365,7 @@ void NetRx::reset(void)
   
   if (unflushed_samples)
   {
-    audio_dec->flushEncodedSamples();
+    flushAudio();
   }
   else
   {
@@ -338,6 +394,29 @@ void NetRx::setModulation(Modulation::Type mod)
 } /* NetRx::setModulation */
 
 
+void NetRx::setAudioNeeded(bool is_needed)
+{
+  if (is_needed == audio_needed)
+  {
+    return;
+  }
+  audio_needed = is_needed;
+  if (audio_needed)
+  {
+    decodeLookback();
+  }
+} /* NetRx::setAudioNeeded */
+
+
+void NetRx::setAudioLookback(unsigned lookback_ms)
+{
+  audio_lookback_ms = lookback_ms;
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  pruneLookback(now);
+} /* NetRx::setAudioLookback */
+
+
 
 /****************************************************************************
  *
@@ -422,7 +501,7 @@ void NetRx::connectionReady(bool is_ready)
     sql_is_open = false;
     if (unflushed_samples)
     {
-      audio_dec->flushEncodedSamples();
+      flushAudio();
     }
     else
     {
@@ -446,13 +525,18 @@ void NetRx::handleMsg(Msg *msg)
         sql_is_open = sql_msg->isOpen();
         if (sql_msg->isOpen())
         {
+          flush_guard_timer->setEnable(false);
           setSquelchState(true);
         }
         else
         {
-          if (unflushed_samples)
+          if (unflushed_samples && tcp_con->udpAudioActive())
+          {
+            flush_guard_timer->setEnable(true);
+          }
+          else if (unflushed_samples)
           {
-            audio_dec->flushEncodedSamples();
+            flushAudio();
           }
           else
           {
@@ -498,11 +582,33 @@ void NetRx::handleMsg(Msg *msg)
     
     case MsgAudio::TYPE:
     {
-      if ((mute_state == Rx::MUTE_NONE) && sql_is_open)
+      if ((mute_state == Rx::MUTE_NONE) &&
+          (sql_is_open || flush_guard_timer->isEnabled()))
       {
+        if (flush_guard_timer->isEnabled())
+        {
+          flush_guard_timer->reset();
+        }
 	MsgAudio *audio_msg = reinterpret_cast<MsgAudio*>(msg);
+        if ((jitter_fifo != 0) && unflushed_samples && jitter_fifo->empty())
+        {
+          jitter_buffer_stats.jitterBufferUnderrun();
+        }
 	unflushed_samples = true;
-        audio_dec->writeEncodedSamples(audio_msg->buf(), audio_msg->size());
+        if (audio_needed)
+        {
+          AudioDecodeScheduler::instance()->writeEncodedSamples(
+              audio_dec, audio_msg->buf(), audio_msg->size());
+        }
+        else
+        {
+          storeLookback(audio_msg->buf(), audio_msg->size());
+        }
+        if (jitter_fifo != 0)
+        {
+          jitter_buffer_stats.jitterBufferFill(
+              jitter_fifo->samplesInFifo() * 1000 / INTERNAL_SAMPLE_RATE);
+        }
       }
       break;
     }
@@ -565,6 +671,112 @@ void NetRx::publishSquelchState(void)
 } /* NetRx::publishSquelchState */
 
 
+void NetRx::flushAudio(void)
+{
+  flush_guard_timer->setEnable(false);
+  lookback.clear();
+  AudioDecodeScheduler::instance()->flushEncodedSamples(audio_dec);
+} /* NetRx::flushAudio */
+
+
+void NetRx::flushGuardExpired(Timer *t)
+{
+  flushAudio();
+} /* NetRx::flushGuardExpired */
+
+
+void NetRx::storeLookback(const void *buf, int size)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  const char *data = reinterpret_cast<const char *>(buf);
+  lookback.push_back(LookbackFrame());
+  lookback.back().rx_time = now;
+  lookback.back().data.assign(data, data + size);
+  pruneLookback(now);
+} /* NetRx::storeLookback */
+
+
+void NetRx::pruneLookback(const struct timeval &now)
+{
+    // When receiving UDP audio the decoded audio is paced out through the
+    // jitter buffer so replaying more than that would just add latency
+  unsigned max_ms = audio_lookback_ms;
+  if ((jitter_fifo != 0) && (jitter_buffer_ms < max_ms))
+  {
+    max_ms = jitter_buffer_ms;
+  }
+  while (!lookback.empty())
+  {
+    struct timeval age;
+    timersub(&now, &lookback.front().rx_time, &age);
+    if (age.tv_sec * 1000 + age.tv_usec / 1000 < static_cast<long>(max_ms))
+    {
+      break;
+    }
+    lookback.pop_front();
+  }
+} /* NetRx::pruneLookback */
+
+
+void NetRx::decodeLookback(void)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  pruneLookback(now);
+  Lookback::const_iterator it;
+  for (it=lookback.begin(); it!=lookback.end(); ++it)
+  {
+    AudioDecodeScheduler::instance()->writeEncodedSamples(
+        audio_dec, &it->data[0], it->data.size());
+  }
+  lookback.clear();
+} /* NetRx::decodeLookback */
+
+
+void NetRx::publishNetStats(Timer *t)
+{
+  if (!tcp_con->udpAudioActive())
+  {
+    return;
+  }
+
+    // The jitter buffer statistics belong to this receiver while the path
+    // statistics are shared by all users of the connection
+  const SvxLink::NetPathStats& net_stats = tcp_con->netStats();
+  Json::Value stats(Json::objectValue);
+  stats["name"] = name();
+  stats["rxPackets"] = Json::UInt64(net_stats.rxPackets());
+  stats["rxLost"] = Json::UInt64(net_stats.lostPackets());
+  stats["rxLate"] = Json::UInt64(net_stats.latePackets());
+  stats["rxJitterMs"] = net_stats.jitterMs();
+  if (net_stats.hasRtt())
+  {
+    stats["rttMs"] = net_stats.rttMs();
+    stats["rttMinMs"] = net_stats.rttMinMs();
+    stats["rttMaxMs"] = net_stats.rttMaxMs();
+    stats["rttAvgMs"] = net_stats.rttAvgMs();
+  }
+  Json::Value& jb = stats["jitterBuffer"];
+  jb["underruns"] = Json::UInt64(jitter_buffer_stats.jitterBufferUnderruns());
+  if (jitter_buffer_stats.hasJitterBufferFill())
+  {
+    jb["minMs"] = jitter_buffer_stats.jitterBufferMinMs();
+    jb["maxMs"] = jitter_buffer_stats.jitterBufferMaxMs();
+    jb["avgMs"] = jitter_buffer_stats.jitterBufferAvgMs();
+  }
+  jitter_buffer_stats.resetJitterBufferFill();
+  Json::StreamWriterBuilder builder;
+  builder["commentStyle"] = "None";
+  builder["indentation"] = ""; //The JSON document is written on a single line
+  Json::StreamWriter* writer = builder.newStreamWriter();
+  stringstream os;
+  writer->write(stats, &os);
+  delete writer;
+  publishStateEvent("Rx:net_stats", os.str());
+} /* NetRx::publishNetStats */
+
+
 
 /*
  * This file has not been truncated
@@ -38,6 +38,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sigc++/sigc++.h>
 
 #include <string>
+#include <deque>
+#include <vector>
+#include <sys/time.h>
 
 
 /****************************************************************************
@@ -48,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <AsyncConfig.h>
 #include <AsyncTcpConnection.h>
+#include <NetPathStats.h>
 
 
 /****************************************************************************
@@ -73,6 +77,8 @@ namespace NetTrxMsg
 namespace Async
 {
   class AudioDecoder;
+  class AudioJitterFifo;
+  class Timer;
 };
 
 /****************************************************************************
@@ -190,6 +196,28 @@ class NetRx : public Rx
      */
     virtual void setModulation(Modulation::Type mod);
 
+    /**
+     * @brief   Tell the receiver if its audio is needed or not
+     * @param   is_needed Set to \em false if the audio will not be used
+     *
+     * A receiver that is told that its audio is not needed may skip
+     * processing, like decoding, of received audio. Squelch and signal
+     * level handling must still work as usual.
+     */
+    virtual void setAudioNeeded(bool is_needed);
+
+    /**
+     * @brief   Set how much audio to keep while the audio is not needed
+     * @param   lookback_ms The lookback time in milliseconds
+     *
+     * When the audio is not needed, received encoded audio frames are kept
+     * for the given time instead of being decoded. When the audio becomes
+     * needed again the kept frames are decoded so that a delay line after
+     * the receiver will get the most recent audio. Zero, the default, means
+     * that audio is dropped while not needed.
+     */
+    virtual void setAudioLookback(unsigned lookback_ms);
+
     /**
      * @brief Resume audio output to the sink
      *
@@ -202,6 +230,13 @@ class NetRx : public Rx
   protected:
 
   private:
+    struct LookbackFrame
+    {
+      struct timeval    rx_time;
+      std::vector<char> data;
+    };
+    typedef std::deque<LookbackFrame> Lookback;
+
     Async::Config     	&cfg;
     Rx::MuteState       mute_state;
     NetTrxTcpClient  	*tcp_con;
@@ -215,12 +250,26 @@ class NetRx : public Rx
     Async::AudioDecoder *audio_dec;
     unsigned            fq;
     Modulation::Type    modulation;
+    Async::Timer        *flush_guard_timer;
+    Async::AudioJitterFifo *jitter_fifo;
+    SvxLink::NetPathStats jitter_buffer_stats;
+    Async::Timer        *net_stats_timer;
+    bool                audio_needed;
+    unsigned            audio_lookback_ms;
+    unsigned            jitter_buffer_ms;
+    Lookback            lookback;
 
     void connectionReady(bool is_ready);
     void handleMsg(NetTrxMsg::Msg *msg);
     void sendMsg(NetTrxMsg::Msg *msg);
     void allEncodedSamplesFlushed(void);
     void publishSquelchState(void);
+    void flushAudio(void);
+    void flushGuardExpired(Async::Timer *t);
+    void publishNetStats(Async::Timer *t);
+    void storeLookback(const void *buf, int size);
+    void pruneLookback(const struct timeval &now);
+    void decodeLookback(void);
 
 };  /* class NetRx */
 
@@ -37,6 +37,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <cassert>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 #include <iostream>
 #include <vector>
 #include <utility>
@@ -98,6 +100,18 @@ namespace NetTrxMsg
 #define NET_TRX_DEFAULT_TCP_PORT   "5210"
 #define NET_TRX_DEFAULT_UDP_PORT   NET_TRX_DEFAULT_TCP_PORT
 
+  // When audio is sent over UDP, a flush or squelch close message on the TCP
+  // connection may overtake the last audio datagrams. The receiver therefore
+  // wait until no audio has been received for this many milliseconds before
+  // acting on it.
+#define NET_TRX_UDP_FLUSH_GUARD    100
+
+  // A heartbeat datagram is sent this often (ms) on the UDP audio channel.
+  // When nothing has been received over UDP for NET_TRX_UDP_TIMEOUT ms, audio
+  // is sent over the TCP connection again.
+#define NET_TRX_UDP_HEARTBEAT_INTERVAL  1000
+#define NET_TRX_UDP_TIMEOUT             5000
+
 
 /****************************************************************************
  *
@@ -173,7 +187,11 @@ class MsgProtoVer : public Msg
   public:
     static const unsigned TYPE  = 0;
     static const uint16_t MAJOR = 2;
-    static const uint16_t MINOR = 7;
+    static const uint16_t MINOR = 10;
+    static const uint16_t MIN_MINOR = 7;        // Oldest compatible version
+    static const uint16_t UDP_AUDIO_MINOR = 8;  // First with UDP audio
+    static const uint16_t SIGLEV_STREAM_MINOR = 9; // First with UDP siglev
+    static const uint16_t PLAYOUT_DEADLINE_MINOR = 10; // First with deadlines
     MsgProtoVer(void)
       : Msg(TYPE, sizeof(MsgProtoVer)), m_major(MAJOR),
         m_minor(MINOR) {}
@@ -277,6 +295,53 @@ class MsgAuthOk : public Msg
 };  /* MsgAuthOk */
 
 
+/**
+ * Sent by the client to ask the server for a UDP audio channel
+ */
+class MsgUdpSetupRequest : public Msg
+{
+  public:
+    static const unsigned TYPE = 13;
+    MsgUdpSetupRequest(void) : Msg(TYPE, sizeof(MsgUdpSetupRequest)) {}
+
+};  /* MsgUdpSetupRequest */
+
+
+/**
+ * Sent by the server when a UDP audio channel has been set up. The token
+ * must be present in all UDP datagrams exchanged during the session.
+ */
+class MsgUdpSetup : public Msg
+{
+  public:
+    static const unsigned TYPE = 14;
+    MsgUdpSetup(void) : Msg(TYPE, sizeof(MsgUdpSetup))
+    {
+      gcry_create_nonce(&m_token, sizeof(m_token));
+    }
+    uint32_t token(void) const { return m_token; }
+
+  private:
+    uint32_t m_token;
+
+};  /* MsgUdpSetup */
+
+
+/**
+ * Sent by the client to ask the server to put signal level updates in the
+ * UDP audio datagrams, using UdpMsg::TYPE_AUDIO_SIGLEV, instead of sending
+ * a MsgSiglevUpdate for each update while audio is flowing.
+ */
+class MsgSiglevStreamRequest : public Msg
+{
+  public:
+    static const unsigned TYPE = 15;
+    MsgSiglevStreamRequest(void)
+      : Msg(TYPE, sizeof(MsgSiglevStreamRequest)) {}
+
+};  /* MsgSiglevStreamRequest */
+
+
 
 
 
@@ -429,6 +494,146 @@ class MsgAudio : public Msg
 }; /* MsgAudio */
 
 
+/**
+ * The fixed size part of a MsgAudio message. It is sent in front of an audio
+ * payload that is stored elsewhere, like in the encoder output buffer, so
+ * that a full MsgAudio does not have to be built for each audio frame.
+ */
+class MsgAudioHeader : public Msg
+{
+  public:
+    MsgAudioHeader(int size)
+      : Msg(MsgAudio::TYPE, sizeof(MsgAudioHeader) + size), m_size(size)
+    {
+      assert(size <= MsgAudio::BUFSIZE);
+    }
+
+  private:
+    int     m_size;
+
+}; /* MsgAudioHeader */
+
+
+/**
+ * The header of all datagrams sent on the UDP audio channel. An audio
+ * datagram carry a complete MsgAudio message directly after the header so
+ * that the receiver can handle it in place. The sequence number is incremented for each datagram sent so that
+ * late and duplicated datagrams can be thrown away by the receiver.
+ */
+class UdpMsg
+{
+  public:
+    static const uint16_t TYPE_HEARTBEAT  = 0;
+    static const uint16_t TYPE_AUDIO      = 1;
+      // The ping and pong datagrams carry a uint32_t timestamp after the
+      // header. A ping is answered by a pong carrying the same timestamp.
+      // Older versions ignore unknown datagram types.
+    static const uint16_t TYPE_PING       = 2;
+    static const uint16_t TYPE_PONG       = 3;
+      // A latency mark datagram carry a uint64_t Async::AudioLatencyTrace
+      // capture mark after the header. It is sent just before the audio
+      // datagram that it belong to.
+    static const uint16_t TYPE_LATENCY_MARK = 4;
+      // An audio datagram with a UdpSiglevStream after the MsgAudio message.
+      // It is only sent to clients that have sent a MsgSiglevStreamRequest.
+    static const uint16_t TYPE_AUDIO_SIGLEV = 5;
+      // A playout deadline datagram carry a uint64_t wall clock time, in
+      // nanoseconds since the epoch, after the header. It is the time when
+      // the first sample of the current talk spurt should be transmitted.
+      // It is sent just before each audio datagram in the talk spurt.
+    static const uint16_t TYPE_PLAYOUT_DEADLINE = 6;
+    UdpMsg(uint16_t type, uint16_t seq, uint32_t token)
+      : m_type(type), m_seq(seq), m_token(token) {}
+    uint16_t type(void) const { return m_type; }
+    uint16_t seq(void) const { return m_seq; }
+    uint32_t token(void) const { return m_token; }
+
+  private:
+    uint16_t m_type;
+    uint16_t m_seq;
+    uint32_t m_token;
+
+}; /* UdpMsg */
+
+
+/**
+ * The signal level updates that occurred since the last audio datagram was
+ * sent. The levels are quantized to steps of 0.1. The first level is stored
+ * as a 16 bit value and the following ones as 8 bit differences to the
+ * previous level. All levels in a stream belong to the same squelch RX id.
+ * A level that does not fit, since the stream is full, the RX id differ or
+ * it differ too much from the previous level, is rejected by add. Each
+ * datagram is decoded on its own so a lost datagram only lose its own
+ * levels.
+ */
+class UdpSiglevStream
+{
+  public:
+    static const unsigned MAX_LEVELS = 32;
+    UdpSiglevStream(void) : m_cnt(0), m_last(0) {}
+    bool empty(void) const { return m_cnt == 0; }
+    void clear(void) { m_cnt = 0; }
+    bool add(float siglev, char sql_rx_id)
+    {
+      int q = static_cast<int>(floorf(siglev * 10.0f + 0.5f));
+      q = std::max(-32768, std::min(32767, q));
+      if (m_cnt == 0)
+      {
+        int16_t first = q;
+        m_buf[0] = sql_rx_id;
+        memcpy(m_buf + 2, &first, sizeof(first));
+        m_last = q;
+      }
+      else if ((m_cnt == MAX_LEVELS) ||
+               (m_buf[0] != static_cast<uint8_t>(sql_rx_id)) ||
+               (q - m_last < -128) || (q - m_last > 127))
+      {
+        return false;
+      }
+      else
+      {
+        int8_t diff = q - m_last;
+        m_buf[3 + m_cnt] = static_cast<uint8_t>(diff);
+        m_last = q;
+      }
+      m_buf[1] = ++m_cnt;
+      return true;
+    }
+    const void *data(void) const { return m_buf; }
+    size_t size(void) const { return (m_cnt > 0) ? 3 + m_cnt : 0; }
+
+      // Decode a stream into levels. Returns the number of levels or -1 if
+      // the data is malformed.
+    static int decode(const void *buf, size_t len, char& sql_rx_id,
+                      float *levels)
+    {
+      const uint8_t *p = static_cast<const uint8_t*>(buf);
+      if ((len < 4) || (p[1] == 0) || (p[1] > MAX_LEVELS) ||
+          (len != 3u + p[1]))
+      {
+        return -1;
+      }
+      sql_rx_id = static_cast<char>(p[0]);
+      int16_t first;
+      memcpy(&first, p + 2, sizeof(first));
+      int level = first;
+      levels[0] = level / 10.0f;
+      for (unsigned i=1; i<p[1]; ++i)
+      {
+        level += static_cast<int8_t>(p[3 + i]);
+        levels[i] = level / 10.0f;
+      }
+      return p[1];
+    }
+
+  private:
+    uint8_t   m_buf[3 + MAX_LEVELS];
+    unsigned  m_cnt;
+    int       m_last;
+
+}; /* UdpSiglevStream */
+
+
 
 /******************************** RX Messages ********************************/
 
@@ -698,6 +903,25 @@ class MsgSetTxModulation : public Msg
 }; /* MsgSetTxModulation */
 
 
+/**
+ * The wall clock time, in nanoseconds since the epoch, when the first sample
+ * of the talk spurt should be transmitted. It is sent just before the first
+ * audio message of the talk spurt when audio is sent over TCP.
+ */
+class MsgPlayoutDeadline : public Msg
+{
+  public:
+    static const unsigned TYPE = 307;
+    MsgPlayoutDeadline(uint64_t deadline)
+      : Msg(TYPE, sizeof(MsgPlayoutDeadline)), m_deadline(deadline) {}
+    uint64_t deadline(void) const { return m_deadline; }
+
+  private:
+    uint64_t  m_deadline;
+
+}; /* MsgPlayoutDeadline */
+
+
 
 class MsgTxTimeout : public Msg
 {
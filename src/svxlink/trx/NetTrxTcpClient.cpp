@@ -43,6 +43,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncTimer.h>
+#include <AsyncUdpSocket.h>
+#include <AsyncAudioLatencyTrace.h>
 
 
 /****************************************************************************
@@ -183,9 +185,24 @@ void NetTrxTcpClient::deleteInstance(void)
 } /* NetTrxTcpClient::deleteInstance */
 
 
+void NetTrxTcpClient::enableUdpAudio(uint16_t port)
+{
+  if (udp_port == 0)
+  {
+    udp_port = port;
+  }
+} /* NetTrxTcpClient::enableUdpAudio */
+
+
 void NetTrxTcpClient::sendMsg(Msg *msg)
 {
-  if (state == STATE_READY)
+  if ((state == STATE_READY) && (msg->type() == MsgAudio::TYPE))
+  {
+    MsgAudio *audio_msg = reinterpret_cast<MsgAudio*>(msg);
+    sendAudio(audio_msg->buf(), audio_msg->size());
+    delete msg;
+  }
+  else if (state == STATE_READY)
   {
     sendMsgP(msg);
   }
@@ -196,6 +213,59 @@ void NetTrxTcpClient::sendMsg(Msg *msg)
 } /* NetTrxTcpClient::sendMsg */
 
 
+void NetTrxTcpClient::sendAudio(const void *buf, int size)
+{
+  if (state != STATE_READY)
+  {
+    return;
+  }
+
+  MsgAudioHeader hdr(size);
+  struct iovec iov[2];
+  iov[0].iov_base = &hdr;
+  iov[0].iov_len = sizeof(hdr);
+  iov[1].iov_base = const_cast<void*>(buf);
+  iov[1].iov_len = size;
+  if (udp_active)
+  {
+      // A sampled latency trace mark is sent just before the audio
+    if (AudioLatencyTrace::current() != 0)
+    {
+      uint64_t mark = AudioLatencyTrace::current();
+      struct iovec mark_iov;
+      mark_iov.iov_base = &mark;
+      mark_iov.iov_len = sizeof(mark);
+      sendUdpMsg(UdpMsg::TYPE_LATENCY_MARK, &mark_iov, 1);
+    }
+    if ((playout_deadline != 0) && playoutDeadlineSupported())
+    {
+      struct iovec deadline_iov;
+      deadline_iov.iov_base = &playout_deadline;
+      deadline_iov.iov_len = sizeof(playout_deadline);
+      sendUdpMsg(UdpMsg::TYPE_PLAYOUT_DEADLINE, &deadline_iov, 1);
+    }
+    sendUdpMsg(UdpMsg::TYPE_AUDIO, iov, 2);
+  }
+  else
+  {
+    if ((playout_deadline != 0) && !playout_deadline_sent &&
+        playoutDeadlineSupported())
+    {
+      sendMsgP(new MsgPlayoutDeadline(playout_deadline));
+      playout_deadline_sent = true;
+    }
+    writeMsg(iov, 2, hdr.size());
+  }
+} /* NetTrxTcpClient::sendAudio */
+
+
+void NetTrxTcpClient::setPlayoutDeadline(uint64_t deadline)
+{
+  playout_deadline = deadline;
+  playout_deadline_sent = false;
+} /* NetTrxTcpClient::setPlayoutDeadline */
+
+
 
 /****************************************************************************
  *
@@ -207,7 +277,11 @@ NetTrxTcpClient::NetTrxTcpClient(const std::string& remote_host,
       	      	      	      	 uint16_t remote_port, size_t recv_buf_len)
   : TcpClient<>(remote_host, remote_port, recv_buf_len), recv_cnt(0),
     recv_exp(0), reconnect_timer(0), last_msg_timestamp(), heartbeat_timer(0),
-    user_cnt(0), state(STATE_DISC), disc_reason(DR_SYSTEM_ERROR)
+    user_cnt(0), state(STATE_DISC), disc_reason(DR_SYSTEM_ERROR),
+    remote_minor(0), udp_port(0), udp_sock(0), udp_heartbeat_timer(0),
+    udp_token(0), udp_tx_seq(0), udp_rx_seq(0), udp_active(false),
+    last_udp_timestamp(), udp_ping_cnt(0), udp_latency_mark(0),
+    playout_deadline(0), playout_deadline_sent(false)
 {
   connected.connect(mem_fun(*this, &NetTrxTcpClient::tcpConnected));
   disconnected.connect(mem_fun(*this, &NetTrxTcpClient::tcpDisconnected));
@@ -221,13 +295,21 @@ NetTrxTcpClient::NetTrxTcpClient(const std::string& remote_host,
   heartbeat_timer->setEnable(false);
   heartbeat_timer->expired.connect(mem_fun(*this, &NetTrxTcpClient::heartbeat));
   
+  udp_heartbeat_timer = new Timer(NET_TRX_UDP_HEARTBEAT_INTERVAL,
+                                  Timer::TYPE_PERIODIC);
+  udp_heartbeat_timer->setEnable(false);
+  udp_heartbeat_timer->expired.connect(
+      mem_fun(*this, &NetTrxTcpClient::udpHeartbeat));
+
 } /* NetTrxTcpClient::NetTrxTcpClient */
 
 
 NetTrxTcpClient::~NetTrxTcpClient(void)
 {
+  closeUdp();
   delete reconnect_timer;
   delete heartbeat_timer;
+  delete udp_heartbeat_timer;
 } /* NetTrxTcpClient::~NetTrxTcpClient */
 
 
@@ -256,6 +338,7 @@ void NetTrxTcpClient::tcpDisconnected(TcpConnection *con,
   disc_reason = reason;
   recv_exp = 0;
   state = STATE_DISC;
+  closeUdp();
   reconnect_timer->setEnable(true);
   heartbeat_timer->setEnable(false);
   isReady(false);
@@ -275,6 +358,27 @@ int NetTrxTcpClient::tcpDataReceived(TcpConnection *con, void *data, int size)
   char *buf = static_cast<char*>(data);
   while (size > 0)
   {
+      // Handle messages that are complete in the receive buffer of the
+      // connection in place. Only partially received messages are copied.
+    if ((recv_cnt == 0) && (recv_exp == sizeof(Msg)) &&
+        (static_cast<unsigned>(size) >= sizeof(Msg)))
+    {
+      Msg *msg = reinterpret_cast<Msg*>(buf);
+      if ((msg->size() >= sizeof(Msg)) &&
+          (msg->size() <= static_cast<unsigned>(size)) &&
+          (msg->size() <= sizeof(recv_buf)))
+      {
+        size -= msg->size();
+        buf += msg->size();
+        handleMsg(msg);
+        if (state == STATE_DISC)
+        {
+          return orig_size;
+        }
+        continue;
+      }
+    }
+
     unsigned read_cnt = min(static_cast<unsigned>(size), recv_exp-recv_cnt);
     if (recv_cnt+read_cnt > sizeof(recv_buf))
     {
@@ -351,7 +455,7 @@ void NetTrxTcpClient::handleMsg(Msg *msg)
         MsgProtoVer *ver_msg = reinterpret_cast<MsgProtoVer *>(msg);
         if ((msg->size() != sizeof(MsgProtoVer)) ||
             (ver_msg->majorVer() != MsgProtoVer::MAJOR) ||
-            (ver_msg->minorVer() != MsgProtoVer::MINOR))
+            (ver_msg->minorVer() < MsgProtoVer::MIN_MINOR))
         {
           cerr << "*** ERROR: Incompatible protocol version. Disconnecting from "
                << remoteHost().toString() << ":" << remotePort() << "...\n";
@@ -361,6 +465,7 @@ void NetTrxTcpClient::handleMsg(Msg *msg)
         cout << remoteHost().toString() << ":" << remotePort()
              << ": RemoteTrx protocol version " << ver_msg->majorVer() << "."
              << ver_msg->minorVer() << endl;
+        remote_minor = ver_msg->minorVer();
         state = STATE_AUTH_WAIT;
       }
       else
@@ -398,6 +503,15 @@ void NetTrxTcpClient::handleMsg(Msg *msg)
           return;
         }
         state = STATE_READY;
+        playout_deadline_sent = false;
+        if ((udp_port > 0) && (remote_minor >= MsgProtoVer::UDP_AUDIO_MINOR))
+        {
+          sendMsgP(new MsgUdpSetupRequest);
+          if (remote_minor >= MsgProtoVer::SIGLEV_STREAM_MINOR)
+          {
+            sendMsgP(new MsgSiglevStreamRequest);
+          }
+        }
         isReady(true);
       }
       return;
@@ -415,6 +529,20 @@ void NetTrxTcpClient::handleMsg(Msg *msg)
       break;
     }
     
+    case MsgUdpSetup::TYPE:
+    {
+      if (msg->size() != sizeof(MsgUdpSetup))
+      {
+        cerr << "*** ERROR: Protocol error. Wrong length of "
+                "MsgUdpSetup message. Disconnecting from "
+             << remoteHost().toString() << ":" << remotePort() << "...\n";
+        localDisconnect();
+        return;
+      }
+      setupUdp(reinterpret_cast<MsgUdpSetup*>(msg)->token());
+      break;
+    }
+
     case MsgProtoVer::TYPE:
     case MsgAuthChallenge::TYPE:
     case MsgAuthOk::TYPE:
@@ -467,8 +595,20 @@ void NetTrxTcpClient::sendMsgP(Msg *msg)
 {
   assert(isConnected());
 
-  int written = write(msg, msg->size());
-  if (written != static_cast<int>(msg->size()))
+  struct iovec iov;
+  iov.iov_base = msg;
+  iov.iov_len = msg->size();
+  writeMsg(&iov, 1, msg->size());
+  delete msg;
+  
+} /* NetTrxTcpClient::sendMsgP */
+
+
+void NetTrxTcpClient::writeMsg(const struct iovec *iov, int iovcnt,
+                               unsigned size)
+{
+  int written = write(iov, iovcnt);
+  if (written != static_cast<int>(size))
   {
     if (written == -1)
     {
@@ -482,10 +622,203 @@ void NetTrxTcpClient::sendMsgP(Msg *msg)
     disconnect();
     disconnected(this, TcpConnection::DR_ORDERED_DISCONNECT);
   }
-  
-  delete msg;
-  
-} /* NetTrxTcpClient::sendMsgP */
+} /* NetTrxTcpClient::writeMsg */
+
+
+void NetTrxTcpClient::setupUdp(uint32_t token)
+{
+  closeUdp();
+  udp_sock = new UdpSocket;
+  if (!udp_sock->initOk())
+  {
+    cerr << "*** WARNING: Could not create UDP socket for audio to "
+         << remoteHost().toString() << ":" << udp_port
+         << ". Using TCP for audio.\n";
+    closeUdp();
+    return;
+  }
+  udp_sock->dataReceived.connect(
+      mem_fun(*this, &NetTrxTcpClient::udpDataReceived));
+  udp_token = token;
+  udp_tx_seq = 0;
+  udp_rx_seq = 0;
+  timerclear(&last_udp_timestamp);
+  net_stats.reset();
+  udp_ping_cnt = UDP_PING_CNT_RESET;
+  udp_heartbeat_timer->setEnable(true);
+
+    // The server learn our address from the first datagram it receive
+  sendUdpMsg(UdpMsg::TYPE_HEARTBEAT);
+} /* NetTrxTcpClient::setupUdp */
+
+
+void NetTrxTcpClient::closeUdp(void)
+{
+  if (udp_active)
+  {
+    cout << remoteHost().toString() << ":" << remotePort()
+         << ": Using TCP for audio\n";
+  }
+  udp_active = false;
+  udp_heartbeat_timer->setEnable(false);
+  delete udp_sock;
+  udp_sock = 0;
+} /* NetTrxTcpClient::closeUdp */
+
+
+void NetTrxTcpClient::sendUdpMsg(uint16_t type, const struct iovec *iov,
+                                 int iovcnt)
+{
+  if (udp_sock == 0)
+  {
+    return;
+  }
+  assert(iovcnt <= 2);
+  UdpMsg hdr(type, udp_tx_seq++, udp_token);
+  struct iovec dgram_iov[3];
+  dgram_iov[0].iov_base = &hdr;
+  dgram_iov[0].iov_len = sizeof(hdr);
+  for (int i=0; i<iovcnt; ++i)
+  {
+    dgram_iov[i+1] = iov[i];
+  }
+  udp_sock->write(remoteHost(), udp_port, dgram_iov, iovcnt + 1);
+} /* NetTrxTcpClient::sendUdpMsg */
+
+
+void NetTrxTcpClient::udpDataReceived(const IpAddress& addr, uint16_t port,
+                                      void *buf, int count)
+{
+  if ((state != STATE_READY) || (addr != remoteHost()) ||
+      (port != udp_port) || (count < static_cast<int>(sizeof(UdpMsg))))
+  {
+    return;
+  }
+  UdpMsg hdr(0, 0, 0);
+  memcpy(&hdr, buf, sizeof(hdr));
+  if (hdr.token() != udp_token)
+  {
+    return;
+  }
+
+    // Throw away late or duplicated datagrams
+  int16_t seq_diff = hdr.seq() - udp_rx_seq;
+  if (timerisset(&last_udp_timestamp))
+  {
+    net_stats.packetReceived(seq_diff);
+    if (seq_diff < 0)
+    {
+      return;
+    }
+  }
+  udp_rx_seq = hdr.seq() + 1;
+  gettimeofday(&last_udp_timestamp, NULL);
+  if (!udp_active)
+  {
+    cout << remoteHost().toString() << ":" << remotePort()
+         << ": Using UDP for audio\n";
+    udp_active = true;
+  }
+
+    // The audio message is handled directly in the datagram buffer
+  unsigned len = count - sizeof(hdr);
+  char *payload = static_cast<char*>(buf) + sizeof(hdr);
+  Msg *msg = reinterpret_cast<Msg*>(payload);
+  if ((hdr.type() == UdpMsg::TYPE_AUDIO) &&
+      (len >= sizeof(MsgAudioHeader)) && (len <= sizeof(MsgAudio)) &&
+      (msg->type() == MsgAudio::TYPE) && (msg->size() == len) &&
+      (sizeof(MsgAudioHeader) +
+       reinterpret_cast<MsgAudio*>(msg)->size() == len))
+  {
+    handleUdpAudio(msg);
+  }
+  else if ((hdr.type() == UdpMsg::TYPE_AUDIO_SIGLEV) &&
+           (len >= sizeof(MsgAudioHeader)) &&
+           (msg->type() == MsgAudio::TYPE) && (msg->size() < len) &&
+           (msg->size() <= sizeof(MsgAudio)) &&
+           (sizeof(MsgAudioHeader) +
+            reinterpret_cast<MsgAudio*>(msg)->size() == msg->size()))
+  {
+      // The signal levels were measured before the audio in the datagram was
+      // sent so they are handled first
+    char sql_rx_id = 0;
+    float levels[UdpSiglevStream::MAX_LEVELS];
+    int cnt = UdpSiglevStream::decode(payload + msg->size(),
+                                      len - msg->size(), sql_rx_id, levels);
+    if (cnt > 0)
+    {
+      for (int i=0; i<cnt; ++i)
+      {
+        MsgSiglevUpdate siglev_msg(levels[i], sql_rx_id);
+        handleMsg(&siglev_msg);
+      }
+      handleUdpAudio(msg);
+    }
+  }
+  else if ((hdr.type() == UdpMsg::TYPE_LATENCY_MARK) &&
+           (len == sizeof(udp_latency_mark)))
+  {
+    memcpy(&udp_latency_mark, payload, sizeof(udp_latency_mark));
+  }
+  else if ((hdr.type() == UdpMsg::TYPE_PING) && (len == sizeof(uint32_t)))
+  {
+    struct iovec iov;
+    iov.iov_base = payload;
+    iov.iov_len = len;
+    sendUdpMsg(UdpMsg::TYPE_PONG, &iov, 1);
+  }
+  else if ((hdr.type() == UdpMsg::TYPE_PONG) && (len == sizeof(uint32_t)))
+  {
+    uint32_t timestamp;
+    memcpy(&timestamp, payload, sizeof(timestamp));
+    net_stats.pongReceived(timestamp);
+  }
+} /* NetTrxTcpClient::udpDataReceived */
+
+
+void NetTrxTcpClient::handleUdpAudio(Msg *msg)
+{
+  net_stats.packetArrived();
+  AudioLatencyTrace::Scope latency_scope(udp_latency_mark);
+  if (udp_latency_mark != 0)
+  {
+    AudioLatencyTrace::record("nettrx", udp_latency_mark);
+    udp_latency_mark = 0;
+  }
+  handleMsg(msg);
+} /* NetTrxTcpClient::handleUdpAudio */
+
+
+void NetTrxTcpClient::udpHeartbeat(Timer *t)
+{
+  sendUdpMsg(UdpMsg::TYPE_HEARTBEAT);
+
+  if (--udp_ping_cnt == 0)
+  {
+    udp_ping_cnt = UDP_PING_CNT_RESET;
+    uint32_t timestamp = SvxLink::NetPathStats::timestampMs();
+    struct iovec iov;
+    iov.iov_base = &timestamp;
+    iov.iov_len = sizeof(timestamp);
+    sendUdpMsg(UdpMsg::TYPE_PING, &iov, 1);
+  }
+
+  if (udp_active)
+  {
+    struct timeval diff_tv;
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    timersub(&now, &last_udp_timestamp, &diff_tv);
+    int diff_ms = diff_tv.tv_sec * 1000 + diff_tv.tv_usec / 1000;
+    if (diff_ms > NET_TRX_UDP_TIMEOUT)
+    {
+      cerr << "*** WARNING: UDP audio timeout from "
+           << remoteHost().toString() << ":" << udp_port
+           << ". Falling back to TCP.\n";
+      udp_active = false;
+    }
+  }
+} /* NetTrxTcpClient::udpHeartbeat */
 
 
 
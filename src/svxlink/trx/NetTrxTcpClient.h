@@ -49,6 +49,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncTcpClient.h>
+#include <NetPathStats.h>
 
 
 /****************************************************************************
@@ -69,6 +70,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 namespace Async
 {
   class Timer;
+  class UdpSocket;
 };
 
 
@@ -147,11 +149,71 @@ class NetTrxTcpClient : public Async::TcpClient<>
      */
     void setAuthKey(const std::string &key) { auth_key = key; }
     
+    /**
+     * @brief Ask the server for a UDP audio channel
+     * @param port The UDP port on the remote host to send datagrams to
+     *
+     * When the server support it, a UDP audio channel is set up each time
+     * the connection has been established. All MsgAudio messages are then
+     * sent as UDP datagrams, as long as datagrams are being received from
+     * the server. If the UDP channel stop working, audio is sent over the
+     * TCP connection again. Audio received over UDP is emitted through the
+     * msgReceived signal just like audio received over TCP.
+     */
+    void enableUdpAudio(uint16_t port);
+
+    /**
+     * @brief Find out if audio is currently sent over the UDP channel
+     * @return Returns \em true if the UDP audio channel is working
+     */
+    bool udpAudioActive(void) const { return udp_active; }
+
+    /**
+     * @brief Get the statistics for the UDP audio channel
+     * @return Returns the network path statistics
+     *
+     * The statistics are reset each time the UDP channel is set up.
+     */
+    const SvxLink::NetPathStats& netStats(void) const { return net_stats; }
+
     /**
      * @brief Send a message over the connection
      * @param msg The message to send
      */
     void sendMsg(NetTrxMsg::Msg *msg);
+
+    /**
+     * @brief Send an audio frame over the connection
+     * @param buf   The encoded audio data to send
+     * @param size  The number of bytes in buf, at most MsgAudio::BUFSIZE
+     *
+     * This function send the same thing as a MsgAudio message but the data is
+     * sent directly from the given buffer, after a separate message header,
+     * so that the audio data does not have to be copied into a message first.
+     */
+    void sendAudio(const void *buf, int size);
+
+    /**
+     * @brief Set the playout deadline for the audio that is sent
+     * @param deadline The wall clock time, in nanoseconds since the epoch,
+     *                 when the first sample of the talk spurt should be
+     *                 transmitted. Set to 0 to stop sending deadlines.
+     *
+     * The deadline is sent in front of the audio of the talk spurt. Over
+     * UDP it is repeated before each audio datagram so that a lost datagram
+     * does not lose the deadline. Deadlines are not sent to servers that are
+     * too old to support them.
+     */
+    void setPlayoutDeadline(uint64_t deadline);
+
+    /**
+     * @brief Find out if the server support playout deadlines
+     * @return Returns \em true if the connected server support deadlines
+     */
+    bool playoutDeadlineSupported(void) const
+    {
+      return remote_minor >= NetTrxMsg::MsgProtoVer::PLAYOUT_DEADLINE_MINOR;
+    }
     
     /**
      * @brief Get the reason for the last disconnect
@@ -201,6 +263,7 @@ class NetTrxTcpClient : public Async::TcpClient<>
     } State;
     
     static const int RECV_BUF_SIZE = 4096;
+    static const unsigned UDP_PING_CNT_RESET = 5;
     static Clients clients;
 
     char      	    recv_buf[RECV_BUF_SIZE];
@@ -213,6 +276,20 @@ class NetTrxTcpClient : public Async::TcpClient<>
     std::string     auth_key;
     State           state;
     DiscReason      disc_reason;
+    uint16_t        remote_minor;
+    uint16_t        udp_port;
+    Async::UdpSocket *udp_sock;
+    Async::Timer    *udp_heartbeat_timer;
+    uint32_t        udp_token;
+    uint16_t        udp_tx_seq;
+    uint16_t        udp_rx_seq;
+    bool            udp_active;
+    struct timeval  last_udp_timestamp;
+    SvxLink::NetPathStats net_stats;
+    unsigned        udp_ping_cnt;
+    uint64_t        udp_latency_mark;
+    uint64_t        playout_deadline;
+    bool            playout_deadline_sent;
     
     NetTrxTcpClient(const NetTrxTcpClient&);
     NetTrxTcpClient& operator=(const NetTrxTcpClient&);
@@ -225,6 +302,14 @@ class NetTrxTcpClient : public Async::TcpClient<>
     void heartbeat(Async::Timer *t);
     void localDisconnect(void);
     void sendMsgP(NetTrxMsg::Msg *msg);
+    void writeMsg(const struct iovec *iov, int iovcnt, unsigned size);
+    void setupUdp(uint32_t token);
+    void closeUdp(void);
+    void sendUdpMsg(uint16_t type, const struct iovec *iov=0, int iovcnt=0);
+    void udpDataReceived(const Async::IpAddress& addr, uint16_t port,
+                         void *buf, int count);
+    void handleUdpAudio(NetTrxMsg::Msg *msg);
+    void udpHeartbeat(Async::Timer *t);
 
 };  /* class NetTrxTcpClient */
 
@@ -47,6 +47,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncConfig.h>
 #include <AsyncAudioPacer.h>
 #include <AsyncAudioEncoder.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -58,6 +59,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "NetTx.h"
 #include "NetTrxMsg.h"
 #include "NetTrxTcpClient.h"
+#include "PlayoutBuffer.h"
 
 
 /****************************************************************************
@@ -123,7 +125,8 @@ NetTx::NetTx(Config &cfg, const string& name)
     log_disconnect(true), mode(Tx::TX_OFF),
     ctcss_enable(false), pacer(0), is_connected(false), pending_flush(false),
     unflushed_samples(false), audio_enc(0), fq(0),
-    modulation(Modulation::MOD_UNKNOWN)
+    modulation(Modulation::MOD_UNKNOWN), simulcast_delay(0),
+    in_talk_spurt(false)
 {
 } /* NetTx::NetTx */
 
@@ -160,6 +163,8 @@ bool NetTx::initialize(void)
   
   cfg.getValue(name(), "LOG_DISCONNECTS_ONCE", log_disconnects_once);
 
+  cfg.getValue(name(), "SIMULCAST_DELAY", simulcast_delay);
+
   string audio_enc_name;
   cfg.getValue(name(), "CODEC", audio_enc_name);
   if (audio_enc_name.empty())
@@ -206,6 +211,12 @@ bool NetTx::initialize(void)
   {
     return false;
   }
+  bool udp_audio = false;
+  cfg.getValue(name(), "UDP_AUDIO", udp_audio);
+  if (udp_audio)
+  {
+    tcp_con->enableUdpAudio(atoi(udp_port.c_str()));
+  }
   tcp_con->setAuthKey(auth_key);
   tcp_con->isReady.connect(mem_fun(*this, &NetTx::connectionReady));
   tcp_con->msgReceived.connect(mem_fun(*this, &NetTx::handleMsg));
@@ -291,6 +302,21 @@ void NetTx::setModulation(Modulation::Type mod)
 } /* NetTx::setModulation */
 
 
+int NetTx::writeSamples(const float *samples, int count)
+{
+  if ((simulcast_delay > 0) && !in_talk_spurt)
+  {
+      // All transmitters in a simulcast group get their audio at the same
+      // time so the deadline is taken from when the audio enter the
+      // transmitter, before any pacing or encoding delay
+    in_talk_spurt = true;
+    tcp_con->setPlayoutDeadline(
+        PlayoutBuffer::now() + simulcast_delay * 1000000ULL);
+  }
+  return Tx::writeSamples(samples, count);
+} /* NetTx::writeSamples */
+
+
 
 /****************************************************************************
  *
@@ -335,6 +361,13 @@ void NetTx::connectionReady(bool is_ready)
       sendMsg(msg);
     }
 
+    if ((simulcast_delay > 0) && !tcp_con->playoutDeadlineSupported())
+    {
+      cerr << "*** WARNING: The remote transmitter for " << name()
+           << " does not support playout deadlines. SIMULCAST_DELAY will "
+              "have no effect.\n";
+    }
+
     MsgAudioCodecSelect *msg = new MsgTxAudioCodecSelect(audio_enc->name());
     cout << name() << ": Requesting CODEC \"" << msg->name() << "\"\n";
     string opt_prefix(audio_enc->name());
@@ -427,8 +460,7 @@ void NetTx::writeEncodedSamples(const void *buf, int size)
     {
       const int bufsize = MsgAudio::BUFSIZE;
       int len = min(size, bufsize);
-      MsgAudio *msg = new MsgAudio(ptr, len);
-      sendMsg(msg);
+      tcp_con->sendAudio(ptr, len);
       size -= len;
       ptr += len;
     }
@@ -445,6 +477,7 @@ void NetTx::writeEncodedSamples(const void *buf, int size)
 
 void NetTx::flushEncodedSamples(void)
 {
+  in_talk_spurt = false;
   if (is_connected)
   {
     MsgFlush *msg = new MsgFlush;
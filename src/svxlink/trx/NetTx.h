@@ -199,6 +199,17 @@ class NetTx : public Tx
      */
     virtual void setModulation(Modulation::Type mod);
 
+    /**
+     * @brief 	Write samples into the transmitter
+     * @param 	samples The buffer containing the samples
+     * @param 	count   The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     *
+     * When SIMULCAST_DELAY is set, the first sample of each talk spurt get
+     * a playout deadline that is sent to the remote transmitter.
+     */
+    virtual int writeSamples(const float *samples, int count);
+
   protected:
 
   private:
@@ -215,6 +226,8 @@ class NetTx : public Tx
     Async::AudioEncoder   *audio_enc;
     unsigned              fq;
     Modulation::Type      modulation;
+    unsigned              simulcast_delay;
+    bool                  in_talk_spurt;
     
     void connectionReady(bool is_ready);
     void handleMsg(NetTrxMsg::Msg *msg);
@@ -0,0 +1,259 @@
+/**
+@file	 PlayoutBuffer.cpp
+@brief   Hold transmitter audio until a given wall clock playout time
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioFifo.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncTimer.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "PlayoutBuffer.h"
+
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+uint64_t PlayoutBuffer::now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+} /* PlayoutBuffer::now */
+
+
+PlayoutBuffer::PlayoutBuffer(const string& name, unsigned max_delay_ms)
+  : name(name), max_delay_ms(max_delay_ms), delay_ms(0), offset_ms(0),
+    fifo(0), timer(0), deadline(0), have_deadline(false), is_active(false)
+{
+  fifo = new AudioFifo((max_delay_ms + 500) * INTERNAL_SAMPLE_RATE / 1000);
+  fifo->registerSink(&valve);
+  valve.setBlockWhenClosed(true);
+  valve.setOpen(true);
+  AudioSink::setHandler(fifo);
+  AudioSource::setHandler(&valve);
+
+  timer = new Timer(0, Timer::TYPE_ONESHOT, false);
+  timer->expired.connect(
+      sigc::mem_fun(*this, &PlayoutBuffer::deadlineReached));
+} /* PlayoutBuffer::PlayoutBuffer */
+
+
+PlayoutBuffer::~PlayoutBuffer(void)
+{
+  AudioSink::clearHandler();
+  AudioSource::clearHandler();
+  delete timer;
+  delete fifo;
+} /* PlayoutBuffer::~PlayoutBuffer */
+
+
+void PlayoutBuffer::setDeadline(uint64_t deadline_ns)
+{
+  if (deadline_ns == deadline)
+  {
+    return;
+  }
+  deadline = deadline_ns;
+  have_deadline = true;
+  schedule();
+} /* PlayoutBuffer::setDeadline */
+
+
+void PlayoutBuffer::reset(void)
+{
+  timer->setEnable(false);
+  fifo->clear();
+  valve.setOpen(true);
+  have_deadline = false;
+  is_active = false;
+} /* PlayoutBuffer::reset */
+
+
+int PlayoutBuffer::writeSamples(const float *samples, int count)
+{
+  if (!is_active)
+  {
+    is_active = true;
+    if (!have_deadline && (delay_ms > 0))
+    {
+      deadline = now() + delay_ms * 1000000ULL;
+      have_deadline = true;
+      schedule();
+    }
+  }
+  return fifo->writeSamples(samples, count);
+} /* PlayoutBuffer::writeSamples */
+
+
+void PlayoutBuffer::allSamplesFlushed(void)
+{
+  valve.allSamplesFlushed();
+  if (valve.isIdle())
+  {
+      // The talk spurt has ended. The next one need a new deadline.
+    is_active = false;
+    have_deadline = false;
+  }
+} /* PlayoutBuffer::allSamplesFlushed */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+void PlayoutBuffer::schedule(void)
+{
+  timer->setEnable(false);
+
+  int64_t wait_ns = static_cast<int64_t>(deadline - now()) -
+                    static_cast<int64_t>(offset_ms) * 1000000LL;
+  if (wait_ns <= 0)
+  {
+    if (wait_ns <= -1000000LL)
+    {
+      cerr << "*** WARNING: " << name << ": Audio arrived "
+           << (-wait_ns / 1000000LL) << "ms after its playout deadline\n";
+    }
+    valve.setOpen(true);
+    return;
+  }
+
+  int64_t wait_ms = (wait_ns + 500000LL) / 1000000LL;
+  if (wait_ms > max_delay_ms)
+  {
+    cerr << "*** WARNING: " << name << ": Playout deadline " << wait_ms
+         << "ms into the future ignored. Is the clock synchronized?\n";
+    valve.setOpen(true);
+    return;
+  }
+
+  valve.setOpen(false);
+  timer->setTimeout(wait_ms);
+  timer->setEnable(true);
+} /* PlayoutBuffer::schedule */
+
+
+void PlayoutBuffer::deadlineReached(Timer *t)
+{
+  valve.setOpen(true);
+} /* PlayoutBuffer::deadlineReached */
+
+
+
+/*
+ * This file has not been truncated
+ */
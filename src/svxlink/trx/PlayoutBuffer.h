@@ -0,0 +1,232 @@
+/**
+@file	 PlayoutBuffer.h
+@brief   Hold transmitter audio until a given wall clock playout time
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef PLAYOUT_BUFFER_INCLUDED
+#define PLAYOUT_BUFFER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <stdint.h>
+
+#include <string>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSink.h>
+#include <AsyncAudioSource.h>
+#include <AsyncAudioValve.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class AudioFifo;
+  class Timer;
+};
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+//namespace MyNameSpace
+//{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Hold transmitter audio until a given wall clock playout time
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class is used to align the audio of simulcast transmitters, that is
+transmitters at different sites that carry the same audio. Each talk spurt
+is given a playout deadline, the wall clock time when its first sample should
+be transmitted. The audio is held in a FIFO until the deadline and is then
+let through as it arrive. A transmitter that get its audio later than the
+others thereby only buffer what is needed to line up with them.
+
+The deadline is either set explicitly using setDeadline, e.g. from a deadline
+received over the network, or it is set to the time the first sample of the
+talk spurt arrive plus a fixed delay. The deadline is given in nanoseconds
+since the epoch, as returned by the now function. All transmitters must use
+a synchronized wall clock, e.g. by running NTP, PTP or GPS disciplined
+clocks, for the alignment to work.
+
+An offset may be set to compensate for the audio delay after this object,
+like sound card buffering, which may differ between transmitter sites. The
+audio is let through the offset number of milliseconds before the deadline.
+*/
+class PlayoutBuffer : public Async::AudioSink, public Async::AudioSource,
+                      public sigc::trackable
+{
+  public:
+    /**
+     * @brief   Get the current wall clock time
+     * @return  Returns the number of nanoseconds since the epoch
+     */
+    static uint64_t now(void);
+
+    /**
+     * @brief 	Constructor
+     * @param 	name          The name used in printouts
+     * @param 	max_delay_ms  The longest time to hold audio for a deadline
+     */
+    PlayoutBuffer(const std::string& name, unsigned max_delay_ms);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~PlayoutBuffer(void);
+
+    /**
+     * @brief   Set a fixed playout delay
+     * @param   delay_ms The delay in milliseconds, 0 to disable
+     *
+     * Talk spurts that have not been given a deadline through setDeadline,
+     * when their first sample arrive, get a deadline that is the arrival
+     * time of the first sample plus this delay.
+     */
+    void setDelay(unsigned delay_ms) { this->delay_ms = delay_ms; }
+
+    /**
+     * @brief   Set the playout offset
+     * @param   offset_ms The number of milliseconds to play before the
+     *                    deadline
+     */
+    void setOffset(int offset_ms) { this->offset_ms = offset_ms; }
+
+    /**
+     * @brief   Set the playout deadline for the current talk spurt
+     * @param   deadline_ns The deadline in nanoseconds since the epoch
+     *
+     * Setting the same deadline more than once has no effect so a deadline
+     * that is repeated in every audio packet can be given for each packet.
+     */
+    void setDeadline(uint64_t deadline_ns);
+
+    /**
+     * @brief   Throw away all buffered audio and forget the deadline
+     */
+    void reset(void);
+
+    /**
+     * @brief 	Write samples into this audio sink
+     * @param 	samples The buffer containing the samples
+     * @param 	count   The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *samples, int count);
+
+    /**
+     * @brief 	The registered sink has flushed all samples
+     */
+    virtual void allSamplesFlushed(void);
+
+  private:
+    const std::string name;
+    const unsigned    max_delay_ms;
+    unsigned          delay_ms;
+    int               offset_ms;
+    Async::AudioFifo  *fifo;
+    Async::AudioValve valve;
+    Async::Timer      *timer;
+    uint64_t          deadline;
+    bool              have_deadline;
+    bool              is_active;
+
+    PlayoutBuffer(const PlayoutBuffer&);
+    PlayoutBuffer& operator=(const PlayoutBuffer&);
+    void schedule(void);
+    void deadlineReached(Async::Timer *t);
+
+};  /* class PlayoutBuffer */
+
+
+//} /* namespace */
+
+#endif /* PLAYOUT_BUFFER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
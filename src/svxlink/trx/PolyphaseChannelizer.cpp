@@ -0,0 +1,498 @@
+/**
+@file   PolyphaseChannelizer.cpp
+@brief  A polyphase filter bank channelizer for wideband receivers
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that split a wideband I/Q signal into a number of
+equally spaced frequency bins in one pass, using a shared polyphase lowpass
+filter and a DFT evaluated only for the bins that are in use.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "PolyphaseChannelizer.h"
+#include "DdrFilterCoeffs.h"
+#ifdef HAS_OPENCL_SUPPORT
+#include "PolyphaseChannelizerCl.h"
+#endif
+#ifdef ASYNC_AUDIO_PROFILING
+#include <AsyncAudioPerfCounters.h>
+#endif
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+bool PolyphaseChannelizer::isSupported(unsigned samp_rate)
+{
+  return (samp_rate == 960000) || (samp_rate == 2400000);
+} /* PolyphaseChannelizer::isSupported */
+
+
+PolyphaseChannelizer::PolyphaseChannelizer(unsigned samp_rate)
+  : m_samp_rate(samp_rate), m_bin_cnt(0), m_dec_fact(0), m_coeff(0),
+    m_taps(0), m_next(0), m_odd_output(false), m_cl(0), m_cl_slot(0),
+    m_cl_pending(false)
+{
+  assert(isSupported(samp_rate));
+
+    // The decimation factor is the same as for the first decimation stage
+    // in the DDR channelizers so that the bin outputs can be fed into the
+    // rest of the DDR decimation chain.
+  if (samp_rate == 960000)
+  {
+    m_dec_fact = 5;
+    m_coeff = coeff_pfb_960k;
+    m_taps = coeff_pfb_960k_cnt;
+  }
+  else
+  {
+    m_dec_fact = 3;
+    m_coeff = coeff_pfb_2400k;
+    m_taps = coeff_pfb_2400k_cnt;
+  }
+  m_bin_cnt = 2 * m_dec_fact;
+  assert(m_taps % m_bin_cnt == 0);
+
+  m_buf.assign(m_taps - 1, Sample(0.0f));
+  m_next = m_taps - 1 + m_dec_fact - 1;
+  m_bin_users.assign(m_bin_cnt, 0);
+  m_bin_out.resize(m_bin_cnt);
+  m_poly.resize(m_bin_cnt);
+
+    // The twiddle factors for bin index k, phase p: exp(j*2*pi*k*p/M)
+  m_twiddle.resize(m_bin_cnt);
+  for (int k=0; k<m_bin_cnt; ++k)
+  {
+    m_twiddle[k].resize(m_bin_cnt);
+    for (int p=0; p<m_bin_cnt; ++p)
+    {
+      m_twiddle[k][p] = polar(1.0f, static_cast<float>(
+            2.0 * M_PI * k * p / m_bin_cnt));
+    }
+  }
+} /* PolyphaseChannelizer::PolyphaseChannelizer */
+
+
+PolyphaseChannelizer::~PolyphaseChannelizer(void)
+{
+#ifdef HAS_OPENCL_SUPPORT
+  delete m_cl;
+#endif
+} /* PolyphaseChannelizer::~PolyphaseChannelizer */
+
+
+int PolyphaseChannelizer::findBin(int fq_offset) const
+{
+  double bin_width = static_cast<double>(m_samp_rate) / m_bin_cnt;
+  int bin = static_cast<int>(lround(fq_offset / bin_width));
+  if (bin >= m_bin_cnt / 2)
+  {
+    bin -= m_bin_cnt;
+  }
+  else if (bin < -m_bin_cnt / 2)
+  {
+    bin += m_bin_cnt;
+  }
+  return bin;
+} /* PolyphaseChannelizer::findBin */
+
+
+int PolyphaseChannelizer::binFq(int bin, int fq_offset) const
+{
+  int bin_width = m_samp_rate / m_bin_cnt;
+  int fq = bin * bin_width;
+  if ((bin == -m_bin_cnt / 2) && (fq_offset > 0))
+  {
+    fq = -fq;
+  }
+  return fq;
+} /* PolyphaseChannelizer::binFq */
+
+
+void PolyphaseChannelizer::acquireBin(int bin)
+{
+  if (m_bin_users[binIndex(bin)]++ == 0)
+  {
+    updateActiveBins();
+  }
+} /* PolyphaseChannelizer::acquireBin */
+
+
+void PolyphaseChannelizer::releaseBin(int bin)
+{
+  int idx = binIndex(bin);
+  assert(m_bin_users[idx] > 0);
+  if (--m_bin_users[idx] == 0)
+  {
+    m_bin_out[idx].clear();
+    updateActiveBins();
+  }
+} /* PolyphaseChannelizer::releaseBin */
+
+
+const vector<PolyphaseChannelizer::Sample>&
+PolyphaseChannelizer::binSamples(int bin) const
+{
+  return m_bin_out[binIndex(bin)];
+} /* PolyphaseChannelizer::binSamples */
+
+
+void PolyphaseChannelizer::iqReceived(const vector<Sample> &in)
+{
+  if (m_active_bins.empty())
+  {
+#ifdef HAS_OPENCL_SUPPORT
+    if (m_cl_pending && !clEmitPending())
+    {
+      clFailed(-1);
+    }
+#endif
+    return;
+  }
+
+  m_buf.insert(m_buf.end(), in.begin(), in.end());
+
+  size_t out_cnt = 0;
+  if (m_next < m_buf.size())
+  {
+    out_cnt = (m_buf.size() - m_next + m_dec_fact - 1) / m_dec_fact;
+  }
+
+#ifdef HAS_OPENCL_SUPPORT
+  if (m_cl != 0)
+  {
+    clReceived(out_cnt);
+    return;
+  }
+#endif
+
+  {
+#ifdef ASYNC_AUDIO_PROFILING
+    static Async::AudioPerfCounters::Stage *perf_stage =
+        Async::AudioPerfCounters::stage("ddr polyphase channelizer");
+    Async::AudioPerfCounters::Probe probe(perf_stage, in.size());
+#endif
+    calcBlock(&m_buf[0], m_next, out_cnt, m_odd_output, m_active_bins);
+  }
+  m_next += out_cnt * m_dec_fact;
+  m_odd_output = m_odd_output != ((out_cnt & 1) != 0);
+
+    // Keep the history needed for the next block
+  size_t keep = m_taps - 1;
+  size_t drop = m_buf.size() - keep;
+  m_buf.erase(m_buf.begin(), m_buf.begin() + drop);
+  m_next -= drop;
+
+  binsReceived();
+} /* PolyphaseChannelizer::iqReceived */
+
+
+bool PolyphaseChannelizer::useOpenCl(const std::string& device)
+{
+#ifdef HAS_OPENCL_SUPPORT
+  delete m_cl;
+  m_cl = new PolyphaseChannelizerCl(m_coeff, m_taps, m_bin_cnt, m_dec_fact);
+  if (!m_cl->initialize(device))
+  {
+    delete m_cl;
+    m_cl = 0;
+    return false;
+  }
+  cout << "Running the polyphase channelizer on OpenCL device \""
+       << m_cl->deviceName() << "\"\n";
+  return true;
+#else
+  (void)device;
+  cerr << "*** WARNING: OpenCL support is not compiled in. The polyphase "
+          "channelizer will run on the CPU.\n";
+  return false;
+#endif
+} /* PolyphaseChannelizer::useOpenCl */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+int PolyphaseChannelizer::binIndex(int bin) const
+{
+  assert((bin >= -m_bin_cnt / 2) && (bin < m_bin_cnt / 2));
+  return (bin + m_bin_cnt) % m_bin_cnt;
+} /* PolyphaseChannelizer::binIndex */
+
+
+void PolyphaseChannelizer::updateActiveBins(void)
+{
+  m_active_bins.clear();
+  for (int k=0; k<m_bin_cnt; ++k)
+  {
+    if (m_bin_users[k] > 0)
+    {
+      m_active_bins.push_back(k);
+    }
+  }
+} /* PolyphaseChannelizer::updateActiveBins */
+
+
+void PolyphaseChannelizer::calcBlock(const Sample *buf, size_t first,
+                                     size_t out_cnt, bool odd,
+                                     const vector<int>& bins)
+{
+  for (vector<int>::const_iterator it = bins.begin(); it != bins.end(); ++it)
+  {
+    m_bin_out[*it].clear();
+    m_bin_out[*it].reserve(out_cnt);
+  }
+
+  const int M = m_bin_cnt;
+  for (size_t n=0; n<out_cnt; ++n)
+  {
+      // Run the polyphase filter branches. Branch p use the filter taps
+      // p, p+M, p+2M... on the samples going backwards from the newest one.
+    const Sample *x = buf + first + n * m_dec_fact;
+    for (int p=0; p<M; ++p)
+    {
+      Sample sum(0.0f);
+      for (int l=p; l<m_taps; l+=M)
+      {
+        sum += m_coeff[l] * x[-l];
+      }
+      m_poly[p] = sum;
+    }
+
+      // Evaluate the DFT for each bin in use. Since D=M/2, the output of odd
+      // bins must be negated on every other output sample.
+    for (vector<int>::const_iterator it = bins.begin(); it != bins.end(); ++it)
+    {
+      const int k = *it;
+      const vector<Sample> &tw = m_twiddle[k];
+      Sample sum(0.0f);
+      for (int p=0; p<M; ++p)
+      {
+        sum += m_poly[p] * tw[p];
+      }
+      if (odd && (k & 1))
+      {
+        sum = -sum;
+      }
+      m_bin_out[k].push_back(sum);
+    }
+    odd = !odd;
+  }
+} /* PolyphaseChannelizer::calcBlock */
+
+
+#ifdef HAS_OPENCL_SUPPORT
+void PolyphaseChannelizer::clReceived(size_t out_cnt)
+{
+    // Hand the buffer over to the job and keep only the filter history. The
+    // job buffer must stay untouched until the device is done with it.
+  ClJob &job = m_cl_jobs[m_cl_slot];
+  job.buf.swap(m_buf);
+  job.first = m_next;
+  job.out_cnt = out_cnt;
+  job.odd = m_odd_output;
+  job.bins = m_active_bins;
+  size_t keep = m_taps - 1;
+  m_buf.assign(job.buf.end() - keep, job.buf.end());
+  m_next = m_next + out_cnt * m_dec_fact - (job.buf.size() - keep);
+  m_odd_output = m_odd_output != ((out_cnt & 1) != 0);
+
+  const int cur_slot = m_cl_slot;
+  if (!m_cl->submit(cur_slot, &job.buf[0], job.buf.size(), job.first,
+                    job.out_cnt, job.odd, job.bins))
+  {
+    clFailed(cur_slot);
+    return;
+  }
+
+    // While the device work on this block, the previous one is emitted
+  if (m_cl_pending && !clEmitPending())
+  {
+    clFailed(cur_slot);
+    return;
+  }
+  m_cl_pending = true;
+  m_cl_slot = 1 - cur_slot;
+} /* PolyphaseChannelizer::clReceived */
+
+
+bool PolyphaseChannelizer::clEmitPending(void)
+{
+    // The pending block is always in the slot not used by the next submit
+  const int slot = 1 - m_cl_slot;
+  const vector<Sample> *result = m_cl->wait(slot);
+  if (result == 0)
+  {
+    return false;
+  }
+  m_cl_pending = false;
+
+  const ClJob &job = m_cl_jobs[slot];
+  for (size_t b=0; b<job.bins.size(); ++b)
+  {
+    const int k = job.bins[b];
+    if (m_bin_users[k] > 0)
+    {
+      vector<Sample>::const_iterator begin = result->begin() + b * job.out_cnt;
+      m_bin_out[k].assign(begin, begin + job.out_cnt);
+    }
+  }
+  binsReceived();
+  return true;
+} /* PolyphaseChannelizer::clEmitPending */
+
+
+void PolyphaseChannelizer::clFailed(int cur_slot)
+{
+  cerr << "*** WARNING: The OpenCL polyphase channelizer failed. Falling "
+          "back to the CPU.\n";
+  delete m_cl;
+  m_cl = 0;
+
+    // Calculate the blocks that were not emitted on the CPU, oldest first
+  vector<int> bins;
+  if (m_cl_pending)
+  {
+    const ClJob &prev = m_cl_jobs[1 - m_cl_slot];
+    stillActive(bins, prev.bins);
+    calcBlock(&prev.buf[0], prev.first, prev.out_cnt, prev.odd, bins);
+    binsReceived();
+    m_cl_pending = false;
+  }
+  if (cur_slot >= 0)
+  {
+    const ClJob &cur = m_cl_jobs[cur_slot];
+    stillActive(bins, cur.bins);
+    calcBlock(&cur.buf[0], cur.first, cur.out_cnt, cur.odd, bins);
+    binsReceived();
+  }
+} /* PolyphaseChannelizer::clFailed */
+
+
+void PolyphaseChannelizer::stillActive(vector<int>& active,
+                                       const vector<int>& bins) const
+{
+  active.clear();
+  for (vector<int>::const_iterator it = bins.begin(); it != bins.end(); ++it)
+  {
+    if (m_bin_users[*it] > 0)
+    {
+      active.push_back(*it);
+    }
+  }
+} /* PolyphaseChannelizer::stillActive */
+#endif /* HAS_OPENCL_SUPPORT */
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,280 @@
+/**
+@file   PolyphaseChannelizer.h
+@brief  A polyphase filter bank channelizer for wideband receivers
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that split a wideband I/Q signal into a number of
+equally spaced frequency bins in one pass, using a shared polyphase lowpass
+filter and a DFT evaluated only for the bins that are in use.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef POLYPHASE_CHANNELIZER_INCLUDED
+#define POLYPHASE_CHANNELIZER_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+#include <vector>
+#include <complex>
+#include <string>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+class PolyphaseChannelizerCl;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A polyphase filter bank channelizer
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class split a wideband I/Q signal, sampled at fs, into M frequency bins
+spaced fs/M apart. Each bin is filtered using a common prototype lowpass
+filter and decimated by D=M/2, so the bins overlap by a factor of two. That
+way any narrowband channel will fall completely within one bin, with some
+residual frequency offset of at most fs/(2M).
+
+The prototype filter is run once for each decimated output sample, no matter
+how many bins are in use, and each used bin only cost M complex multiply
+accumulates per output sample. This make it cheap to receive many channels
+from the same wideband receiver.
+
+Bins are numbered from -M/2 to M/2-1 where bin k is centered on k*fs/M. Only
+bins that have been acquired using acquireBin are calculated.
+*/
+class PolyphaseChannelizer
+{
+  public:
+    typedef std::complex<float> Sample;
+
+    /**
+     * @brief   Check if a wideband sampling rate is supported
+     * @param   samp_rate The wideband sampling rate
+     * @return  Returns \em true if the sampling rate is supported
+     */
+    static bool isSupported(unsigned samp_rate);
+
+    /**
+     * @brief 	Constructor
+     * @param   samp_rate The sampling rate of the wideband signal
+     */
+    explicit PolyphaseChannelizer(unsigned samp_rate);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~PolyphaseChannelizer(void);
+
+    /**
+     * @brief   The number of bins
+     * @return  Returns the number of frequency bins, M
+     */
+    int binCount(void) const { return m_bin_cnt; }
+
+    /**
+     * @brief   The decimation factor
+     * @return  Returns the decimation factor, D
+     */
+    int decFact(void) const { return m_dec_fact; }
+
+    /**
+     * @brief   The sampling rate of the bin outputs
+     * @return  Returns the sampling rate in Hz of each bin output
+     */
+    unsigned binSampRate(void) const { return m_samp_rate / m_dec_fact; }
+
+    /**
+     * @brief   Find the best bin for a given frequency offset
+     * @param   fq_offset The offset in Hz from the wideband center frequency
+     * @return  Returns the bin number
+     */
+    int findBin(int fq_offset) const;
+
+    /**
+     * @brief   Get the frequency offset of the center of a bin
+     * @param   bin       The bin number, as returned by findBin
+     * @param   fq_offset The offset that was given to findBin
+     * @return  Returns the center of the bin in Hz, closest to fq_offset
+     *
+     * The bin at -M/2 is centered on both -fs/2 and fs/2. The given
+     * frequency offset is used to select which one to return.
+     */
+    int binFq(int bin, int fq_offset) const;
+
+    /**
+     * @brief   Start calculating a bin
+     * @param   bin The bin number
+     *
+     * Calls to acquireBin and releaseBin are reference counted so multiple
+     * users can share the same bin.
+     */
+    void acquireBin(int bin);
+
+    /**
+     * @brief   Stop calculating a bin
+     * @param   bin The bin number
+     */
+    void releaseBin(int bin);
+
+    /**
+     * @brief   Get the latest block of samples for a bin
+     * @param   bin The bin number
+     * @return  Returns the samples calculated for the given bin
+     *
+     * This function should be called from a handler connected to the
+     * binsReceived signal. Bins that have not been acquired are empty.
+     */
+    const std::vector<Sample>& binSamples(int bin) const;
+
+    /**
+     * @brief   Process a block of wideband samples
+     * @param   in The wideband samples
+     *
+     * When all acquired bins have been calculated, the binsReceived signal
+     * is emitted.
+     */
+    void iqReceived(const std::vector<Sample> &in);
+
+    /**
+     * @brief   Run the channelizer on an OpenCL device
+     * @param   device Part of the device name to use or empty for the first
+     *                 GPU or accelerator found
+     * @return  Returns \em true on success or \em false if the CPU is used
+     *
+     * The blocks are pipelined so that the device calculate one block while
+     * the bin outputs of the previous block are processed on the host. That
+     * add one block of latency. If the device fail later on, the channelizer
+     * fall back to the CPU without losing any samples. This function should
+     * be called before any samples have been processed.
+     */
+    bool useOpenCl(const std::string& device);
+
+    /**
+     * @brief   Check if the channelizer run on an OpenCL device
+     */
+    bool isUsingOpenCl(void) const { return m_cl != 0; }
+
+    /**
+     * @brief   A signal that is emitted when new bin output is available
+     */
+    sigc::signal<void> binsReceived;
+
+  private:
+    struct ClJob
+    {
+      std::vector<Sample> buf;
+      size_t              first;
+      size_t              out_cnt;
+      bool                odd;
+      std::vector<int>    bins;
+    };
+
+    unsigned                          m_samp_rate;
+    int                               m_bin_cnt;
+    int                               m_dec_fact;
+    const float*                      m_coeff;
+    int                               m_taps;
+    std::vector<Sample>               m_buf;
+    size_t                            m_next;
+    bool                              m_odd_output;
+    std::vector<int>                  m_bin_users;
+    std::vector<int>                  m_active_bins;
+    std::vector<std::vector<Sample> > m_twiddle;
+    std::vector<std::vector<Sample> > m_bin_out;
+    std::vector<Sample>               m_poly;
+    PolyphaseChannelizerCl*           m_cl;
+    ClJob                             m_cl_jobs[2];
+    int                               m_cl_slot;
+    bool                              m_cl_pending;
+
+    PolyphaseChannelizer(const PolyphaseChannelizer&);
+    PolyphaseChannelizer& operator=(const PolyphaseChannelizer&);
+    int binIndex(int bin) const;
+    void updateActiveBins(void);
+    void calcBlock(const Sample *buf, size_t first, size_t out_cnt, bool odd,
+                   const std::vector<int>& bins);
+    void clReceived(size_t out_cnt);
+    bool clEmitPending(void);
+    void clFailed(int cur_slot);
+    void stillActive(std::vector<int>& active,
+                     const std::vector<int>& bins) const;
+
+};  /* class PolyphaseChannelizer */
+
+
+#endif /* POLYPHASE_CHANNELIZER_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -0,0 +1,492 @@
+/**
+@file   PolyphaseChannelizerCl.cpp
+@brief  An OpenCL compute backend for the polyphase channelizer
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "PolyphaseChannelizerCl.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define WORK_GROUP_SIZE 64
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+/*
+ * The same calculation as in PolyphaseChannelizer::calcBlock. BIN_CNT, TAPS
+ * and DEC_FACT are given as build options so that the loops can be unrolled
+ * by the compiler.
+ */
+static const char *kernel_src =
+  "__kernel void pfb(__global const float2 *x, uint first, uint out_cnt,\n"
+  "                  uint odd, __constant float *coeff,\n"
+  "                  __constant float2 *twiddle, __constant int *bins,\n"
+  "                  uint bin_use_cnt, __global float2 *out)\n"
+  "{\n"
+  "  const uint n = get_global_id(0);\n"
+  "  if (n >= out_cnt)\n"
+  "  {\n"
+  "    return;\n"
+  "  }\n"
+  "  __global const float2 *xn = x + first + n * DEC_FACT;\n"
+  "  float2 poly[BIN_CNT];\n"
+  "  for (int p=0; p<BIN_CNT; ++p)\n"
+  "  {\n"
+  "    float2 sum = (float2)(0.0f, 0.0f);\n"
+  "    for (int l=p; l<TAPS; l+=BIN_CNT)\n"
+  "    {\n"
+  "      sum += coeff[l] * xn[-l];\n"
+  "    }\n"
+  "    poly[p] = sum;\n"
+  "  }\n"
+  "  const int negate = (odd + n) & 1;\n"
+  "  for (uint b=0; b<bin_use_cnt; ++b)\n"
+  "  {\n"
+  "    const int k = bins[b];\n"
+  "    __constant float2 *tw = twiddle + k * BIN_CNT;\n"
+  "    float2 sum = (float2)(0.0f, 0.0f);\n"
+  "    for (int p=0; p<BIN_CNT; ++p)\n"
+  "    {\n"
+  "      sum += (float2)(poly[p].x * tw[p].x - poly[p].y * tw[p].y,\n"
+  "                      poly[p].x * tw[p].y + poly[p].y * tw[p].x);\n"
+  "    }\n"
+  "    out[b * out_cnt + n] = (negate && (k & 1)) ? -sum : sum;\n"
+  "  }\n"
+  "}\n";
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+PolyphaseChannelizerCl::PolyphaseChannelizerCl(const float *coeff, int taps,
+                                               int bin_cnt, int dec_fact)
+  : m_coeff(coeff), m_taps(taps), m_bin_cnt(bin_cnt), m_dec_fact(dec_fact),
+    m_context(0), m_queue(0), m_program(0), m_kernel(0), m_coeff_mem(0),
+    m_twiddle_mem(0)
+{
+  for (int i=0; i<SLOT_CNT; ++i)
+  {
+    Slot &slot = m_slots[i];
+    slot.in = 0;
+    slot.in_size = 0;
+    slot.out = 0;
+    slot.out_size = 0;
+    slot.bins = 0;
+    slot.done = 0;
+  }
+} /* PolyphaseChannelizerCl::PolyphaseChannelizerCl */
+
+
+PolyphaseChannelizerCl::~PolyphaseChannelizerCl(void)
+{
+  if (m_queue != 0)
+  {
+    clFinish(m_queue);
+  }
+  for (int i=0; i<SLOT_CNT; ++i)
+  {
+    Slot &slot = m_slots[i];
+    if (slot.done != 0) clReleaseEvent(slot.done);
+    if (slot.bins != 0) clReleaseMemObject(slot.bins);
+    if (slot.out != 0) clReleaseMemObject(slot.out);
+    if (slot.in != 0) clReleaseMemObject(slot.in);
+  }
+  if (m_twiddle_mem != 0) clReleaseMemObject(m_twiddle_mem);
+  if (m_coeff_mem != 0) clReleaseMemObject(m_coeff_mem);
+  if (m_kernel != 0) clReleaseKernel(m_kernel);
+  if (m_program != 0) clReleaseProgram(m_program);
+  if (m_queue != 0) clReleaseCommandQueue(m_queue);
+  if (m_context != 0) clReleaseContext(m_context);
+} /* PolyphaseChannelizerCl::~PolyphaseChannelizerCl */
+
+
+bool PolyphaseChannelizerCl::initialize(const std::string& device)
+{
+  cl_device_id id = 0;
+  if (!selectDevice(device, &id))
+  {
+    return false;
+  }
+
+  cl_int err = CL_SUCCESS;
+  m_context = clCreateContext(0, 1, &id, 0, 0, &err);
+  if (!check(err, "clCreateContext"))
+  {
+    return false;
+  }
+  m_queue = clCreateCommandQueue(m_context, id, 0, &err);
+  if (!check(err, "clCreateCommandQueue") || !buildKernel(id))
+  {
+    return false;
+  }
+
+  vector<cl_float2> twiddle(m_bin_cnt * m_bin_cnt);
+  for (int k=0; k<m_bin_cnt; ++k)
+  {
+    for (int p=0; p<m_bin_cnt; ++p)
+    {
+      const double arg = 2.0 * M_PI * k * p / m_bin_cnt;
+      twiddle[k * m_bin_cnt + p].s[0] = static_cast<float>(cos(arg));
+      twiddle[k * m_bin_cnt + p].s[1] = static_cast<float>(sin(arg));
+    }
+  }
+  m_coeff_mem = clCreateBuffer(m_context,
+      CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, m_taps * sizeof(float),
+      const_cast<float *>(m_coeff), &err);
+  if (!check(err, "clCreateBuffer"))
+  {
+    return false;
+  }
+  m_twiddle_mem = clCreateBuffer(m_context,
+      CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+      twiddle.size() * sizeof(cl_float2), &twiddle[0], &err);
+  if (!check(err, "clCreateBuffer"))
+  {
+    return false;
+  }
+  for (int i=0; i<SLOT_CNT; ++i)
+  {
+    m_slots[i].bins = clCreateBuffer(m_context, CL_MEM_READ_ONLY,
+        m_bin_cnt * sizeof(cl_int), 0, &err);
+    if (!check(err, "clCreateBuffer"))
+    {
+      return false;
+    }
+  }
+
+  return true;
+} /* PolyphaseChannelizerCl::initialize */
+
+
+bool PolyphaseChannelizerCl::submit(int slot_idx, const Sample *buf,
+                                    size_t buf_len, size_t first,
+                                    size_t out_cnt, bool odd,
+                                    const std::vector<int>& bins)
+{
+  assert((slot_idx >= 0) && (slot_idx < SLOT_CNT));
+  assert(!bins.empty() && (bins.size() <= static_cast<size_t>(m_bin_cnt)));
+  assert((out_cnt == 0) || (first + (out_cnt - 1) * m_dec_fact < buf_len));
+  Slot &slot = m_slots[slot_idx];
+
+  if (slot.done != 0)
+  {
+    clReleaseEvent(slot.done);
+    slot.done = 0;
+  }
+  slot.result.resize(bins.size() * out_cnt);
+  if (out_cnt == 0)
+  {
+    return true;
+  }
+
+  const size_t in_bytes = buf_len * sizeof(Sample);
+  const size_t out_bytes = slot.result.size() * sizeof(Sample);
+  if (!reserve(&slot.in, &slot.in_size, in_bytes, CL_MEM_READ_ONLY) ||
+      !reserve(&slot.out, &slot.out_size, out_bytes, CL_MEM_WRITE_ONLY))
+  {
+    return false;
+  }
+
+  vector<cl_int> bin_idx(bins.begin(), bins.end());
+  cl_uint bin_use_cnt = bin_idx.size();
+  cl_uint first_arg = first;
+  cl_uint out_cnt_arg = out_cnt;
+  cl_uint odd_arg = odd ? 1 : 0;
+
+    // The bins buffer is small so it is written blocking. That also make
+    // sure the local vector is not referenced after return.
+  cl_int err = clEnqueueWriteBuffer(m_queue, slot.bins, CL_TRUE, 0,
+      bin_idx.size() * sizeof(cl_int), &bin_idx[0], 0, 0, 0);
+  if (!check(err, "clEnqueueWriteBuffer"))
+  {
+    return false;
+  }
+  err = clEnqueueWriteBuffer(m_queue, slot.in, CL_FALSE, 0, in_bytes,
+                             buf, 0, 0, 0);
+  if (!check(err, "clEnqueueWriteBuffer"))
+  {
+    return false;
+  }
+
+  err  = clSetKernelArg(m_kernel, 0, sizeof(cl_mem), &slot.in);
+  err |= clSetKernelArg(m_kernel, 1, sizeof(cl_uint), &first_arg);
+  err |= clSetKernelArg(m_kernel, 2, sizeof(cl_uint), &out_cnt_arg);
+  err |= clSetKernelArg(m_kernel, 3, sizeof(cl_uint), &odd_arg);
+  err |= clSetKernelArg(m_kernel, 4, sizeof(cl_mem), &m_coeff_mem);
+  err |= clSetKernelArg(m_kernel, 5, sizeof(cl_mem), &m_twiddle_mem);
+  err |= clSetKernelArg(m_kernel, 6, sizeof(cl_mem), &slot.bins);
+  err |= clSetKernelArg(m_kernel, 7, sizeof(cl_uint), &bin_use_cnt);
+  err |= clSetKernelArg(m_kernel, 8, sizeof(cl_mem), &slot.out);
+  if (!check(err, "clSetKernelArg"))
+  {
+    return false;
+  }
+
+  size_t global_size = (out_cnt + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE *
+                       WORK_GROUP_SIZE;
+  size_t local_size = WORK_GROUP_SIZE;
+  err = clEnqueueNDRangeKernel(m_queue, m_kernel, 1, 0, &global_size,
+                               &local_size, 0, 0, 0);
+  if (!check(err, "clEnqueueNDRangeKernel"))
+  {
+    return false;
+  }
+  err = clEnqueueReadBuffer(m_queue, slot.out, CL_FALSE, 0, out_bytes,
+                            &slot.result[0], 0, 0, &slot.done);
+  if (!check(err, "clEnqueueReadBuffer"))
+  {
+    return false;
+  }
+  return check(clFlush(m_queue), "clFlush");
+} /* PolyphaseChannelizerCl::submit */
+
+
+const vector<PolyphaseChannelizerCl::Sample> *PolyphaseChannelizerCl::wait(
+    int slot_idx)
+{
+  assert((slot_idx >= 0) && (slot_idx < SLOT_CNT));
+  Slot &slot = m_slots[slot_idx];
+  if ((slot.done != 0) && !check(clWaitForEvents(1, &slot.done),
+                                 "clWaitForEvents"))
+  {
+    return 0;
+  }
+  return &slot.result;
+} /* PolyphaseChannelizerCl::wait */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+bool PolyphaseChannelizerCl::selectDevice(const std::string& device,
+                                          cl_device_id *id)
+{
+  cl_uint platform_cnt = 0;
+  if ((clGetPlatformIDs(0, 0, &platform_cnt) != CL_SUCCESS) ||
+      (platform_cnt == 0))
+  {
+    cerr << "*** WARNING: No OpenCL platform found\n";
+    return false;
+  }
+  vector<cl_platform_id> platforms(platform_cnt);
+  clGetPlatformIDs(platform_cnt, &platforms[0], 0);
+
+    // Without a device name, only GPUs and accelerators are considered
+    // since the CPU implementation is better than OpenCL on the CPU
+  const cl_device_type type = device.empty()
+    ? (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_ACCELERATOR)
+    : CL_DEVICE_TYPE_ALL;
+  for (size_t i=0; i<platforms.size(); ++i)
+  {
+    cl_uint device_cnt = 0;
+    if ((clGetDeviceIDs(platforms[i], type, 0, 0, &device_cnt) !=
+         CL_SUCCESS) || (device_cnt == 0))
+    {
+      continue;
+    }
+    vector<cl_device_id> devices(device_cnt);
+    clGetDeviceIDs(platforms[i], type, device_cnt, &devices[0], 0);
+    for (size_t j=0; j<devices.size(); ++j)
+    {
+      char name[256] = "";
+      clGetDeviceInfo(devices[j], CL_DEVICE_NAME, sizeof(name) - 1, name, 0);
+      if (device.empty() || (string(name).find(device) != string::npos))
+      {
+        *id = devices[j];
+        m_device_name = name;
+        return true;
+      }
+    }
+  }
+
+  if (device.empty())
+  {
+    cerr << "*** WARNING: No OpenCL GPU or accelerator device found\n";
+  }
+  else
+  {
+    cerr << "*** WARNING: No OpenCL device matching \"" << device
+         << "\" found\n";
+  }
+  return false;
+} /* PolyphaseChannelizerCl::selectDevice */
+
+
+bool PolyphaseChannelizerCl::buildKernel(cl_device_id id)
+{
+  cl_int err = CL_SUCCESS;
+  m_program = clCreateProgramWithSource(m_context, 1, &kernel_src, 0, &err);
+  if (!check(err, "clCreateProgramWithSource"))
+  {
+    return false;
+  }
+
+  ostringstream ss;
+  ss << "-cl-fast-relaxed-math -DBIN_CNT=" << m_bin_cnt
+     << " -DTAPS=" << m_taps << " -DDEC_FACT=" << m_dec_fact;
+  err = clBuildProgram(m_program, 1, &id, ss.str().c_str(), 0, 0);
+  if (err != CL_SUCCESS)
+  {
+    char log[4096] = "";
+    clGetProgramBuildInfo(m_program, id, CL_PROGRAM_BUILD_LOG,
+                          sizeof(log) - 1, log, 0);
+    cerr << "*** WARNING: Could not build the OpenCL channelizer kernel: "
+         << log << endl;
+    return false;
+  }
+
+  m_kernel = clCreateKernel(m_program, "pfb", &err);
+  return check(err, "clCreateKernel");
+} /* PolyphaseChannelizerCl::buildKernel */
+
+
+bool PolyphaseChannelizerCl::reserve(cl_mem *mem, size_t *cur_size,
+                                     size_t size, cl_mem_flags flags)
+{
+  if ((*mem != 0) && (*cur_size >= size))
+  {
+    return true;
+  }
+  if (*mem != 0)
+  {
+    clReleaseMemObject(*mem);
+    *mem = 0;
+    *cur_size = 0;
+  }
+
+    // Allocate some extra to avoid reallocation on small variations in
+    // block size
+  size += size / 4;
+  cl_int err = CL_SUCCESS;
+  *mem = clCreateBuffer(m_context, flags, size, 0, &err);
+  if (!check(err, "clCreateBuffer"))
+  {
+    *mem = 0;
+    return false;
+  }
+  *cur_size = size;
+  return true;
+} /* PolyphaseChannelizerCl::reserve */
+
+
+bool PolyphaseChannelizerCl::check(cl_int err, const char *what)
+{
+  if (err != CL_SUCCESS)
+  {
+    cerr << "*** WARNING: OpenCL call " << what << " failed with error "
+         << err << endl;
+    return false;
+  }
+  return true;
+} /* PolyphaseChannelizerCl::check */
+
+
+/*
+ * This file has not been truncated
+ */
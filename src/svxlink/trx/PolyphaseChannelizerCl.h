@@ -0,0 +1,220 @@
+/**
+@file   PolyphaseChannelizerCl.h
+@brief  An OpenCL compute backend for the polyphase channelizer
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This file contains a class that run the polyphase filter bank and the bin DFT
+of the PolyphaseChannelizer on an OpenCL device, typically a GPU.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+#ifndef POLYPHASE_CHANNELIZER_CL_INCLUDED
+#define POLYPHASE_CHANNELIZER_CL_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#define CL_TARGET_OPENCL_VERSION 120
+#include <CL/cl.h>
+
+#include <vector>
+#include <complex>
+#include <string>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	An OpenCL compute backend for the polyphase channelizer
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+One work item calculate one decimated output sample. It run all polyphase
+filter branches and then evaluate the DFT for each bin in use. The result is
+the same as the one calculated by the PolyphaseChannelizer on the CPU, apart
+from rounding.
+
+There are two job slots, each with its own device buffers, so that one block
+can be uploaded and calculated while the result of the previous block is
+being used on the host. All calls are asynchronous except for wait. If any
+OpenCL call fail, a warning is printed and the failure is returned. The
+caller is then expected to delete this object and calculate the job on the CPU.
+*/
+class PolyphaseChannelizerCl
+{
+  public:
+    typedef std::complex<float> Sample;
+
+    /**
+     * @brief   The number of job slots
+     */
+    static const int SLOT_CNT = 2;
+
+    /**
+     * @brief 	Constructor
+     * @param   coeff     The prototype filter coefficients
+     * @param   taps      The number of filter coefficients
+     * @param   bin_cnt   The number of bins, M
+     * @param   dec_fact  The decimation factor, D
+     */
+    PolyphaseChannelizerCl(const float *coeff, int taps, int bin_cnt,
+                           int dec_fact);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~PolyphaseChannelizerCl(void);
+
+    /**
+     * @brief   Select a device and build the kernel
+     * @param   device Part of the device name to look for or empty for the
+     *                 first GPU or accelerator found
+     * @return  Returns \em true on success or \em false on failure
+     */
+    bool initialize(const std::string& device);
+
+    /**
+     * @brief   The name of the selected device
+     */
+    const std::string& deviceName(void) const { return m_device_name; }
+
+    /**
+     * @brief   Start calculating a block
+     * @param   slot    The job slot to use, 0 to SLOT_CNT-1
+     * @param   buf     The wideband samples, including filter history
+     * @param   buf_len The number of samples in buf
+     * @param   first   The index in buf of the newest sample of the first
+     *                  output
+     * @param   out_cnt The number of outputs to calculate
+     * @param   odd     \em true if the first output is an odd output
+     * @param   bins    The bin indices, 0 to M-1, to calculate
+     * @return  Returns \em true on success or \em false on failure
+     *
+     * The buf vector must be left unmodified until wait has been called for
+     * the slot.
+     */
+    bool submit(int slot, const Sample *buf, size_t buf_len, size_t first,
+                size_t out_cnt, bool odd, const std::vector<int>& bins);
+
+    /**
+     * @brief   Wait for a block to be calculated
+     * @param   slot  The job slot given to submit
+     * @return  Returns the outputs on success or 0 on failure
+     *
+     * The outputs are stored bin by bin, in the order that the bins were
+     * given to submit, with out_cnt samples for each bin. The returned
+     * buffer is valid until the slot is submitted again.
+     */
+    const std::vector<Sample> *wait(int slot);
+
+  private:
+    struct Slot
+    {
+      cl_mem              in;
+      size_t              in_size;
+      cl_mem              out;
+      size_t              out_size;
+      cl_mem              bins;
+      cl_event            done;
+      std::vector<Sample> result;
+    };
+
+    const float*      m_coeff;
+    const int         m_taps;
+    const int         m_bin_cnt;
+    const int         m_dec_fact;
+    std::string       m_device_name;
+    cl_context        m_context;
+    cl_command_queue  m_queue;
+    cl_program        m_program;
+    cl_kernel         m_kernel;
+    cl_mem            m_coeff_mem;
+    cl_mem            m_twiddle_mem;
+    Slot              m_slots[SLOT_CNT];
+
+    PolyphaseChannelizerCl(const PolyphaseChannelizerCl&);
+    PolyphaseChannelizerCl& operator=(const PolyphaseChannelizerCl&);
+    bool selectDevice(const std::string& device, cl_device_id *id);
+    bool buildKernel(cl_device_id id);
+    bool reserve(cl_mem *mem, size_t *cur_size, size_t size,
+                 cl_mem_flags flags);
+    bool check(cl_int err, const char *what);
+
+};  /* class PolyphaseChannelizerCl */
+
+
+#endif /* POLYPHASE_CHANNELIZER_CL_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
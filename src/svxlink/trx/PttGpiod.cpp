@@ -0,0 +1,235 @@
+/**
+@file   PttGpiod.cpp
+@brief  A PTT hardware controller using a line on a GPIO character device
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a PTT hardware controller that use the Linux GPIO character
+device to set the state of a GPIO output line.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncConfig.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "PttGpiod.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+PttGpiod::PttGpiod(void)
+  : fd(-1)
+{
+} /* PttGpiod::PttGpiod */
+
+
+PttGpiod::~PttGpiod(void)
+{
+  if (fd >= 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+} /* PttGpiod::~PttGpiod */
+
+
+bool PttGpiod::initialize(Async::Config &cfg, const std::string name)
+{
+  string chip = "gpiochip0";
+  cfg.getValue(name, "PTT_GPIOD_CHIP", chip);
+  if (chip.find('/') == string::npos)
+  {
+    chip = "/dev/" + chip;
+  }
+
+  string line;
+  if (!cfg.getValue(name, "PTT_GPIOD_LINE", line) || line.empty())
+  {
+    cerr << "*** ERROR: Config variable " << name
+         << "/PTT_GPIOD_LINE not set\n";
+    return false;
+  }
+  bool active_low = false;
+  if ((line.size() > 1) && (line[0] == '!'))
+  {
+    active_low = true;
+    line.erase(0, 1);
+  }
+  char *endptr = 0;
+  unsigned long offset = strtoul(line.c_str(), &endptr, 10);
+  if ((endptr == line.c_str()) || (*endptr != '\0'))
+  {
+    cerr << "*** ERROR: Invalid line number in " << name
+         << "/PTT_GPIOD_LINE=" << line << endl;
+    return false;
+  }
+
+  int chip_fd = open(chip.c_str(), O_RDONLY | O_CLOEXEC);
+  if (chip_fd < 0)
+  {
+    cerr << "*** ERROR: Could not open GPIO chip " << chip
+         << " specified in " << name << "/PTT_GPIOD_CHIP: "
+         << strerror(errno) << endl;
+    return false;
+  }
+
+    // Request the line as an output with the transmitter off. Active low is
+    // handled by the kernel.
+  struct gpiohandle_request req;
+  memset(&req, 0, sizeof(req));
+  req.lineoffsets[0] = offset;
+  req.lines = 1;
+  req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+  if (active_low)
+  {
+    req.flags |= GPIOHANDLE_REQUEST_ACTIVE_LOW;
+  }
+  req.default_values[0] = 0;
+  strncpy(req.consumer_label, "svxlink-ptt", sizeof(req.consumer_label) - 1);
+  int ret = ioctl(chip_fd, GPIO_GET_LINEHANDLE_IOCTL, &req);
+  int err = errno;
+  close(chip_fd);
+  if (ret < 0)
+  {
+    cerr << "*** ERROR: Could not request GPIO line " << offset << " on "
+         << chip << " for writing in transmitter " << name << ": "
+         << strerror(err) << endl;
+    return false;
+  }
+  fd = req.fd;
+
+  return true;
+} /* PttGpiod::initialize */
+
+
+bool PttGpiod::setTxOn(bool tx_on)
+{
+  //cerr << "### PttGpiod::setTxOn(" << (tx_on ? "true" : "false") << ")\n";
+
+  struct gpiohandle_data data;
+  memset(&data, 0, sizeof(data));
+  data.values[0] = tx_on ? 1 : 0;
+  return ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data) == 0;
+} /* PttGpiod::setTxOn */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+
+
+/*
+ * This file has not been truncated
+ */
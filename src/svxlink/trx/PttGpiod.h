@@ -0,0 +1,149 @@
+/**
+@file   PttGpiod.h
+@brief  A PTT hardware controller using a line on a GPIO character device
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a PTT hardware controller that use the Linux GPIO character
+device to set the state of a GPIO output line.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef PTT_GPIOD_INCLUDED
+#define PTT_GPIOD_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <string>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "Ptt.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A PTT hardware controller using a line on a GPIO character device
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+The GPIO line is requested from the Linux GPIO character device
+(/dev/gpiochipN) once during initialization. Setting the PTT state is then a
+single ioctl instead of opening and writing a sysfs file.
+*/
+class PttGpiod : public Ptt
+{
+  public:
+    struct Factory : public PttFactory<PttGpiod>
+    {
+      Factory(void) : PttFactory<PttGpiod>("GPIOD") {}
+    };
+
+    /**
+     * @brief 	Default constructor
+     */
+    PttGpiod(void);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~PttGpiod(void);
+
+    /**
+     * @brief 	Initialize the PTT hardware
+     * @param 	cfg An initialized config object
+     * @param   name The name of the config section to read config from
+     * @returns Returns \em true on success or else \em false
+     */
+    virtual bool initialize(Async::Config &cfg, const std::string name);
+
+    /**
+     * @brief 	Set the state of the PTT, TX on or off
+     * @param 	tx_on Set to \em true to turn the transmitter on
+     * @returns Returns \em true on success or else \em false
+     */
+    virtual bool setTxOn(bool tx_on);
+
+  protected:
+
+  private:
+    int   fd;
+
+    PttGpiod(const PttGpiod&);
+    PttGpiod& operator=(const PttGpiod&);
+
+};  /* class PttGpiod */
+
+
+#endif /* PTT_GPIOD_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -33,10 +33,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <iostream>
-#include <unistd.h>
-#include <fcntl.h>
-#include <linux/hidraw.h>
-#include <sys/ioctl.h>
+#include <map>
 
 
 /****************************************************************************
@@ -54,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "PttHidraw.h"
+#include "HidrawDevice.h"
 
 
 
@@ -115,17 +113,17 @@ using namespace Async;
  ****************************************************************************/
 
 PttHidraw::PttHidraw(void)
-  : active_low(false), fd(-1), pin(0)
+  : active_low(false), dev(0), pin(0)
 {
 } /* PttHidraw::PttHidraw */
 
 
 PttHidraw::~PttHidraw(void)
 {
-  if (fd >= 0)
+  if (dev != 0)
   {
-    close(fd);
-    fd = -1;
+    dev->destroy();
+    dev = 0;
   }
 } /* PttHidraw::~PttHidraw */
 
@@ -153,45 +151,6 @@ bool PttHidraw::initialize(Async::Config &cfg, const std::string name)
     return false;
   }
 
-  if ((fd = open(hidraw_dev.c_str(), O_WRONLY, 0)) < 0)
-  {
-    cerr << "*** ERROR: Can't open port " << hidraw_dev << endl;
-    return false;
-  }
-
-  struct hidraw_devinfo hiddevinfo;
-  if ((ioctl(fd, HIDIOCGRAWINFO, &hiddevinfo) != -1) &&
-      (hiddevinfo.vendor == 0x0d8c))
-  {
-    cout << "--- Hidraw sound chip is ";
-    if (hiddevinfo.product == 0x000c)
-    {
-      cout << "CM108";
-    }
-    else if (hiddevinfo.product == 0x013c)
-    {
-      cout << "CM108A";
-    }
-    else if (hiddevinfo.product == 0x000e)
-    {
-      cout << "CM109";
-    }
-    else if (hiddevinfo.product == 0x013a)
-    {
-      cout << "CM119";
-    }
-    else
-    {
-      cout << "unknown";
-    }
-    cout << endl;
-  }
-  else
-  {
-    cerr << "*** ERROR: unknown/unsupported sound chip detected...\n";
-    return false;
-  }
-
   if (hidraw_pin[0] == '!')
   {
     active_low = true;
@@ -207,6 +166,12 @@ bool PttHidraw::initialize(Async::Config &cfg, const std::string name)
   }
   pin = (*it).second;
 
+  dev = HidrawDevice::instance(hidraw_dev);
+  if (dev == 0)
+  {
+    return false;
+  }
+
   return true;
 } /* PttHidraw::initialize */
 
@@ -215,15 +180,7 @@ bool PttHidraw::setTxOn(bool tx_on)
 {
   //cerr << "### PttHidraw::setTxOn(" << (tx_on ? "true" : "false") << ")\n";
 
-  char a[5] = {'\000', '\000',
-              (tx_on ^ active_low ? pin : '\000'), pin, '\000'};
-
-  if (write(fd, a, sizeof(a)) == -1)
-  {
-    return false;
-  }
-
-  return true;
+  return dev->setPin(pin, tx_on ^ active_low);
 } /* PttHidraw::setTxOn */
 
 
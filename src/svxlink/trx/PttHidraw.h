@@ -60,6 +60,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+class HidrawDevice;
 
 
 /****************************************************************************
@@ -141,10 +142,9 @@ class PttHidraw : public Ptt
   protected:
 
   private:
-    bool active_low;
-
-    int   fd;
-    char  pin;
+    bool          active_low;
+    HidrawDevice* dev;
+    char          pin;
 
     PttHidraw(const PttHidraw&);
     PttHidraw& operator=(const PttHidraw&);
@@ -0,0 +1,169 @@
+/**
+@file   RtlReplay.cpp
+@brief  An RtlSdr implementation that replay recorded I/Q samples
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "RtlReplay.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+RtlReplay::RtlReplay(const string &path)
+  : path(path), file(NULL)
+{
+  file = fopen(path.c_str(), "rb");
+  if (file == NULL)
+  {
+    cerr << "*** ERROR: Could not open I/Q replay file \"" << path
+         << "\": " << strerror(errno) << endl;
+  }
+} /* RtlReplay::RtlReplay */
+
+
+RtlReplay::~RtlReplay(void)
+{
+  if (file != NULL)
+  {
+    fclose(file);
+  }
+} /* RtlReplay::~RtlReplay */
+
+
+size_t RtlReplay::replayBlock(void)
+{
+  if (file == NULL)
+  {
+    return 0;
+  }
+
+  buf.resize(blockSize());
+  size_t len = fread(&buf[0], 1, buf.size(), file);
+  len &= ~static_cast<size_t>(1);   // Only whole I/Q samples
+  if (len == 0)
+  {
+    return 0;
+  }
+  handleIq(reinterpret_cast<const complex<uint8_t>*>(&buf[0]), len / 2);
+  return len / 2;
+} /* RtlReplay::replayBlock */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+
+
+/*
+ * This file has not been truncated
+ */
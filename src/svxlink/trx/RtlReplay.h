@@ -0,0 +1,163 @@
+/**
+@file   RtlReplay.h
+@brief  An RtlSdr implementation that replay recorded I/Q samples
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef RTL_REPLAY_INCLUDED
+#define RTL_REPLAY_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "RtlSdr.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief  An RtlSdr implementation that replay recorded I/Q samples
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This class read I/Q samples from a file instead of from a real RTL2832u
+dongle. The file should contain raw unsigned 8 bit interleaved I/Q samples,
+which is the format written by the rtl_sdr utility. No samples are read
+automatically. The application call the replayBlock function to push the next
+block of samples through the receiver chain, as fast as it want to.
+All tuner settings are silently ignored.
+*/
+class RtlReplay : public RtlSdr
+{
+  public:
+    /**
+     * @brief 	Constructor
+     * @param   path The path to the file to read I/Q samples from
+     */
+    explicit RtlReplay(const std::string &path);
+
+    /**
+     * @brief 	Destructor
+     */
+    virtual ~RtlReplay(void);
+
+    /**
+     * @brief   Find out if the replay file is ready for reading
+     * @returns Returns \em true if the replay file has been opened
+     */
+    virtual bool isReady(void) const { return file != NULL; }
+
+    /**
+     * @brief   Return a string which identifies the replay source
+     * @returns Returns the path to the replay file
+     */
+    virtual const std::string displayName(void) const { return path; }
+
+    /**
+     * @brief   Replay the next block of samples
+     * @returns Returns the number of I/Q samples replayed, 0 at end of file
+     *
+     * The block size is the same as for a real dongle, 10ms worth of samples
+     * at the configured sample rate.
+     */
+    size_t replayBlock(void);
+
+  protected:
+    virtual void handleSetTunerIfGain(uint16_t stage, int16_t gain) {}
+    virtual void handleSetCenterFq(uint32_t fq) {}
+    virtual void handleSetSampleRate(uint32_t rate) {}
+    virtual void handleSetGainMode(uint32_t mode) {}
+    virtual void handleSetGain(int32_t gain) {}
+    virtual void handleSetFqCorr(int corr) {}
+    virtual void handleEnableTestMode(bool enable) {}
+    virtual void handleEnableDigitalAgc(bool enable) {}
+
+  private:
+    std::string           path;
+    FILE                  *file;
+    std::vector<uint8_t>  buf;
+
+    RtlReplay(const RtlReplay&);
+    RtlReplay& operator=(const RtlReplay&);
+
+};  /* class RtlReplay */
+
+
+#endif /* RTL_REPLAY_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
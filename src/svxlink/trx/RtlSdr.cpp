@@ -37,6 +37,17 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iterator>
 #include <algorithm>
 #include <iostream>
+#include <cmath>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define RTLSDR_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RTLSDR_SIMD_NEON
+#include <arm_neon.h>
+#endif
 
 
 /****************************************************************************
@@ -81,6 +92,31 @@ using namespace std;
  *
  ****************************************************************************/
 
+namespace {
+    // Correction applied to the samples while they are converted. Each
+    // converted value x/127.5 get offset[0] (I) or offset[1] (Q) added.
+    // Then Q is replaced by cross * I + gain * Q.
+  struct IqCorrection
+  {
+    float offset[2];
+    float cross;
+    float gain;
+  };
+
+    // Lookup table for the scalar conversion
+  struct IqLut
+  {
+    float value[256];
+    IqLut(void)
+    {
+      for (int i=0; i<256; ++i)
+      {
+        value[i] = i / 127.5f;
+      }
+    }
+  };
+}
+
 
 
 /****************************************************************************
@@ -89,6 +125,9 @@ using namespace std;
  *
  ****************************************************************************/
 
+static bool convert_iq(const uint8_t *in, float *out, size_t count,
+                       const IqCorrection& corr, float *sum);
+
 
 
 /****************************************************************************
@@ -106,6 +145,12 @@ using namespace std;
  *
  ****************************************************************************/
 
+static const IqLut iq_lut;
+
+  // The DC offset estimate follow the mean of each block with this weight.
+  // With 10ms blocks the time constant is about one second.
+static const float DC_OFFSET_ALPHA = 0.01f;
+
 
 
 /****************************************************************************
@@ -119,8 +164,10 @@ RtlSdr::RtlSdr(void)
     tuner_type(TUNER_UNKNOWN), center_fq_set(false), center_fq(100000000),
     samp_rate_set(false), gain_mode(-1), gain(GAIN_UNSET), fq_corr_set(false),
     fq_corr(0), test_mode_set(false), test_mode(false),
-    use_digital_agc_set(false), use_digital_agc(false), dist_print_cnt(-1)
+    use_digital_agc_set(false), use_digital_agc(false), dist_print_cnt(-1),
+    dc_removal(false), iq_cross(0.0f), iq_gain(1.0f)
 {
+  dc_offset[0] = dc_offset[1] = 0.0f;
   for (unsigned i=0; i<MAX_IF_GAIN_STAGES; ++i)
   {
     tuner_if_gain[i] = GAIN_UNSET;
@@ -139,6 +186,23 @@ void RtlSdr::enableDistPrint(bool enable)
 } /* RtlSdr::enableDistPrint */
 
 
+void RtlSdr::enableDcOffsetRemoval(bool enable)
+{
+  dc_removal = enable;
+  dc_offset[0] = dc_offset[1] = 0.0f;
+} /* RtlSdr::enableDcOffsetRemoval */
+
+
+void RtlSdr::setIqImbalance(float gain, float phase)
+{
+    // Q = gain * sin(t + phase) is corrected to sin(t) using
+    // Q' = (Q / gain - I * sin(phase)) / cos(phase)
+  float phi = phase * M_PI / 180.0f;
+  iq_cross = -tanf(phi);
+  iq_gain = 1.0f / (gain * cosf(phi));
+} /* RtlSdr::setIqImbalance */
+
+
 void RtlSdr::setCenterFq(uint32_t fq)
 {
   center_fq = fq;
@@ -280,20 +344,31 @@ void RtlSdr::handleIq(const complex<uint8_t> *samples, int samp_count)
 {
   //cout << "RtlSdr::handleIq: samp_count=" << samp_count << endl;
 
-  vector<Sample> iq;
-  iq.reserve(samp_count);
-  for (int idx=0; idx<samp_count; ++idx)
+    // The sample buffer is reused between blocks to avoid an allocation
+    // for each block. The interleaved I/Q bytes are converted straight into
+    // the interleaved float components of the complex samples.
+  iq_buf.resize(samp_count);
+  IqCorrection corr;
+  corr.offset[0] = -1.0f - dc_offset[0];
+  corr.offset[1] = -1.0f - dc_offset[1];
+  corr.cross = iq_cross;
+  corr.gain = iq_gain;
+  float sum[2] = {0.0f, 0.0f};
+  bool clipped = convert_iq(reinterpret_cast<const uint8_t*>(samples),
+                            reinterpret_cast<float*>(&iq_buf[0]),
+                            2 * samp_count, corr, dc_removal ? sum : 0);
+  if (dc_removal && (samp_count > 0))
   {
-    if ((dist_print_cnt == 0) &&
-        ((samples[idx].real() == 255) || (samples[idx].imag() == 255)))
+      // The DC offset found in this block is removed from the next one
+    for (int i=0; i<2; ++i)
     {
-      dist_print_cnt = samp_rate;
+      float mean = sum[i] / samp_count - 1.0f;
+      dc_offset[i] += DC_OFFSET_ALPHA * (mean - dc_offset[i]);
     }
-    float i = samples[idx].real();
-    i = i / 127.5f - 1.0f;
-    float q = samples[idx].imag();
-    q = q / 127.5f - 1.0f;
-    iq.push_back(complex<float>(i, q));
+  }
+  if ((dist_print_cnt == 0) && clipped)
+  {
+    dist_print_cnt = samp_rate;
   }
 
   if (dist_print_cnt > 0)
@@ -310,7 +385,7 @@ void RtlSdr::handleIq(const complex<uint8_t> *samples, int samp_count)
     }
   }
 
-  iqReceived(iq);
+  iqReceived(iq_buf);
 } /* RtlSdr::handleIq */
 
 
@@ -441,6 +516,122 @@ int RtlSdr::dataReceived(Async::TcpConnection *con, void *buf, int count)
 #endif
 
 
+
+/**
+ * @brief   Convert unsigned 8 bit I/Q values to floats in the range [-1, 1]
+ * @param   in    The interleaved I/Q values to convert
+ * @param   out   The buffer to store the interleaved converted values in
+ * @param   count The number of values to convert, I and Q counted separately
+ * @param   corr  DC offset and I/Q imbalance correction to apply
+ * @param   sum   If not null, the sums of the I and Q values divided by
+ *                127.5, before correction, are added to sum[0] and sum[1]
+ * @return  Returns \em true if any of the values was at full scale (255)
+ *
+ * The conversion, the correction and the summing is done in a single pass
+ * using SSE2 or NEON if available. The remaining values are handled using a
+ * lookup table.
+ */
+static bool convert_iq(const uint8_t *in, float *out, size_t count,
+                       const IqCorrection& corr, float *sum)
+{
+  size_t idx = 0;
+  bool clipped = false;
+  float acc[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+#if defined(RTLSDR_SIMD_X86)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i full = _mm_set1_epi8(static_cast<char>(0xff));
+  const __m128 scale = _mm_set1_ps(1.0f / 127.5f);
+  const __m128 offset = _mm_setr_ps(corr.offset[0], corr.offset[1],
+                                    corr.offset[0], corr.offset[1]);
+  const __m128 gain = _mm_setr_ps(1.0f, corr.gain, 1.0f, corr.gain);
+  const __m128 cross = _mm_setr_ps(0.0f, corr.cross, 0.0f, corr.cross);
+  __m128i clip = zero;
+  __m128 vsum = _mm_setzero_ps();
+  for (; idx + 16 <= count; idx += 16)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + idx));
+    clip = _mm_or_si128(clip, _mm_cmpeq_epi8(v, full));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+    __m128 f[4];
+    f[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+    f[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+    f[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+    f[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+    for (int i=0; i<4; ++i)
+    {
+      __m128 x = _mm_mul_ps(f[i], scale);
+      vsum = _mm_add_ps(vsum, x);
+      x = _mm_add_ps(x, offset);
+        // Swap I and Q so that I end up in the Q lanes
+      __m128 swapped = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1));
+      x = _mm_add_ps(_mm_mul_ps(x, gain), _mm_mul_ps(swapped, cross));
+      _mm_storeu_ps(out + idx + 4 * i, x);
+    }
+  }
+  clipped = (_mm_movemask_epi8(clip) != 0);
+  _mm_storeu_ps(acc, vsum);
+#elif defined(RTLSDR_SIMD_NEON)
+  const float32x4_t scale = vdupq_n_f32(1.0f / 127.5f);
+  const float offset_arr[4] = {corr.offset[0], corr.offset[1],
+                               corr.offset[0], corr.offset[1]};
+  const float gain_arr[4] = {1.0f, corr.gain, 1.0f, corr.gain};
+  const float cross_arr[4] = {0.0f, corr.cross, 0.0f, corr.cross};
+  const float32x4_t offset = vld1q_f32(offset_arr);
+  const float32x4_t gain = vld1q_f32(gain_arr);
+  const float32x4_t cross = vld1q_f32(cross_arr);
+  uint8x16_t clip = vdupq_n_u8(0);
+  float32x4_t vsum = vdupq_n_f32(0.0f);
+  for (; idx + 16 <= count; idx += 16)
+  {
+    uint8x16_t v = vld1q_u8(in + idx);
+    clip = vorrq_u8(clip, vceqq_u8(v, vdupq_n_u8(0xff)));
+    uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+    float32x4_t f[4];
+    f[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo)));
+    f[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo)));
+    f[2] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi)));
+    f[3] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi)));
+    for (int i=0; i<4; ++i)
+    {
+      float32x4_t x = vmulq_f32(f[i], scale);
+      vsum = vaddq_f32(vsum, x);
+      x = vaddq_f32(x, offset);
+        // Swap I and Q so that I end up in the Q lanes
+      float32x4_t swapped = vrev64q_f32(x);
+      x = vmlaq_f32(vmulq_f32(x, gain), swapped, cross);
+      vst1q_f32(out + idx + 4 * i, x);
+    }
+  }
+  uint8x8_t c = vorr_u8(vget_low_u8(clip), vget_high_u8(clip));
+  clipped = (vget_lane_u64(vreinterpret_u64_u8(c), 0) != 0);
+  vst1q_f32(acc, vsum);
+#endif
+  acc[0] += acc[2];
+  acc[1] += acc[3];
+  for (; idx + 1 < count; idx += 2)
+  {
+    clipped = clipped || (in[idx] == 255) || (in[idx + 1] == 255);
+    float i = iq_lut.value[in[idx]];
+    float q = iq_lut.value[in[idx + 1]];
+    acc[0] += i;
+    acc[1] += q;
+    i += corr.offset[0];
+    q += corr.offset[1];
+    out[idx] = i;
+    out[idx + 1] = corr.cross * i + corr.gain * q;
+  }
+  if (sum != 0)
+  {
+    sum[0] += acc[0];
+    sum[1] += acc[1];
+  }
+  return clipped;
+} /* convert_iq */
+
+
+
 /*
  * This file has not been truncated
  */
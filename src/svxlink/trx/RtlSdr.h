@@ -148,6 +148,25 @@ class RtlSdr : public sigc::trackable
      */
     void enableDistPrint(bool enable);
 
+    /**
+     * @brief   Enable or disable DC offset removal
+     * @param   enable Set to \em true to enable DC offset removal
+     *
+     * The DC offset of the I and Q components is estimated from the mean of
+     * the received blocks and is subtracted while the samples are converted.
+     */
+    void enableDcOffsetRemoval(bool enable);
+
+    /**
+     * @brief   Set the I/Q imbalance correction
+     * @param   gain  The amplitude of Q relative to I
+     * @param   phase The phase error of Q relative to I, in degrees
+     *
+     * The correction is applied while the samples are converted. Use a gain
+     * of 1 and a phase of 0 to disable the correction.
+     */
+    void setIqImbalance(float gain, float phase);
+
     /**
      * @brief   Set the center frequency of the tuner
      * @param   fq The new center frequency, in Hz, to set
@@ -294,9 +313,11 @@ class RtlSdr : public sigc::trackable
      *
      * Connecting to this signal is the way to get samples from the DVB-T
      * dongle. The format is a vector of complex floats (I/Q) with a range from
-     * -1 to 1.
+     * -1 to 1. The same sample buffer is handed to all connected receivers
+     * and it is reused for the next block so it must not be referenced after
+     * the handler has returned.
      */
-    sigc::signal<void, std::vector<Sample> > iqReceived;
+    sigc::signal<void, const std::vector<Sample>&> iqReceived;
     
     /**
      * @brief   A signal that is emitted when the ready state changes
@@ -416,6 +437,11 @@ class RtlSdr : public sigc::trackable
     bool              use_digital_agc_set;
     bool              use_digital_agc;
     int               dist_print_cnt;
+    bool              dc_removal;
+    float             dc_offset[2];
+    float             iq_cross;
+    float             iq_gain;
+    std::vector<Sample> iq_buf;
 
     RtlSdr(const RtlSdr&);
     RtlSdr& operator=(const RtlSdr&);
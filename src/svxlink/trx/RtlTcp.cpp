@@ -121,6 +121,7 @@ RtlTcp::RtlTcp(const string &remote_host, uint16_t remote_port)
   : con(remote_host, remote_port, blockSize()),
     reconnect_timer(1000, Timer::TYPE_PERIODIC)
 {
+  con.setMaxRecvBufLen(MAX_RECV_BLOCKS * blockSize());
   con.dataReceived.connect(mem_fun(*this, &RtlTcp::dataReceived));
   con.connected.connect(mem_fun(*this, &RtlTcp::connected));
   con.disconnected.connect(mem_fun(*this, &RtlTcp::disconnected));
@@ -164,6 +165,7 @@ void RtlTcp::handleSetCenterFq(uint32_t fq)
 void RtlTcp::handleSetSampleRate(uint32_t rate)
 {
   con.setRecvBufLen(blockSize());
+  con.setMaxRecvBufLen(MAX_RECV_BLOCKS * blockSize());
   sendCommand(2, rate);
 } /* RtlTcp::handleSetSampleRate */
 
@@ -295,17 +297,19 @@ int RtlTcp::dataReceived(Async::TcpConnection *con, void *buf, int count)
     return 12;
   }
 
-  if (static_cast<size_t>(count) < blockSize())
+    // Handle all complete blocks that have been received
+  char *ptr = reinterpret_cast<char *>(buf);
+  int processed = 0;
+  while (static_cast<size_t>(count - processed) >= blockSize())
   {
-    return 0;
+    int samp_count = blockSize() / 2;
+    complex<uint8_t> *samples =
+      reinterpret_cast<complex<uint8_t>*>(ptr + processed);
+    handleIq(samples, samp_count);
+    processed += 2 * samp_count;
   }
-  count = blockSize();
 
-  int samp_count = count / 2;
-  complex<uint8_t> *samples = reinterpret_cast<complex<uint8_t>*>(buf);
-  handleIq(samples, samp_count);
-
-  return 2 * samp_count;
+  return processed;
 } /* RtlTcp::dataReceived */
 
 
@@ -222,6 +222,8 @@ class RtlTcp : public RtlSdr
 
     
   private:
+    static const size_t MAX_RECV_BLOCKS = 8;
+
     Async::TcpClient<>  con;
     Async::Timer        reconnect_timer;
 
@@ -39,10 +39,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <sstream>
 #include <iostream>
 #include <cassert>
-#include <queue>
+#include <vector>
+#include <atomic>
 #include <unistd.h>
 #include <stdio.h>
 #include <errno.h>
+#include <sys/eventfd.h>
 
 
 /****************************************************************************
@@ -52,6 +54,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncFdWatch.h>
+#include <AsyncThreadScheduling.h>
 
 
 /****************************************************************************
@@ -93,177 +96,194 @@ class RtlUsb::SampleBuffer : public sigc::trackable
 {
   public:
     SampleBuffer(uint32_t block_size)
-      : block_size(block_size), buf(0), buf_cnt(0), watch(0)
+      : block_capacity(max(block_size, MAX_BLOCK_SIZE)), blocks(0),
+        buf_cnt(0), cur_block_size(0), dropping(false),
+        block_size(block_size), head(0), tail(0), notify_pending(false),
+        writer_stopped(false), overrun_cnt(0), reported_overrun_cnt(0),
+        notifier_fd(-1), watch(0)
     {
-      pthread_mutex_init(&mutex, NULL);
+      blocks = new uint8_t[NUM_BLOCKS * block_capacity];
 
-      buf = new uint8_t[block_size];
-
-      int r = pipe(signal_pipe);
-      assert (r == 0);
-      watch = new FdWatch(signal_pipe[0], FdWatch::FD_WATCH_RD);
+      notifier_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      assert(notifier_fd >= 0);
+      watch = new FdWatch(notifier_fd, FdWatch::FD_WATCH_RD);
       watch->activity.connect(
           sigc::hide(mem_fun(*this, &SampleBuffer::removeSamples)));
     }
 
     ~SampleBuffer(void)
     {
-      pthread_mutex_destroy(&mutex);
-      delete [] buf;
-      buf = 0;
-      while (!block_queue.empty())
-      {
-        delete [] block_queue.front();
-        block_queue.pop();
-      }
-      closeReadPipe();
-      closeWritePipe();
-    }
-
-    void closeWritePipe(void)
-    {
-      if (signal_pipe[1] != -1)
-      {
-        if (close(signal_pipe[1]) != 0)
-        {
-          cerr << "*** ERROR: Close error on write end of SampleBuffer pipe: "
-               << strerror(errno) << "\n";
-        }
-        signal_pipe[1] = -1;
-      }
+      closeNotifier();
+      delete [] blocks;
+      blocks = 0;
     }
 
-    void closeReadPipe(void)
+      // Called by the reader thread when it exits. The main thread is
+      // notified when all blocks have been handled.
+    void setWriterStopped(void)
     {
-      delete watch;
-      watch = 0;
-      if (signal_pipe[0] != -1)
-      {
-        if (close(signal_pipe[0]) != 0)
-        {
-          cerr << "*** ERROR: Close error on read end of SampleBuffer pipe: "
-               << strerror(errno) << endl;
-        }
-        signal_pipe[0] = -1;
-      }
+      writer_stopped.store(true, memory_order_release);
+      notify(true);
     }
 
     void setBlockSize(uint32_t new_block_size)
     {
-      lockMutex();
-      block_size = new_block_size;
-      while (!block_queue.empty())
-      {
-        delete block_queue.front();
-        block_queue.pop();
-      }
-      delete [] buf;
-      buf = new uint8_t[block_size];
-      buf_cnt = 0;
-      unlockMutex();
-    }
-
-    void clear(void)
-    {
-      lockMutex();
-      while (!block_queue.empty())
+      if (new_block_size > block_capacity)
       {
-        delete [] block_queue.front();
-        block_queue.pop();
+        cerr << "*** WARNING: RTL block size " << new_block_size
+             << " is larger than the sample buffer block capacity "
+             << block_capacity << ". Using the smaller size.\n";
+        new_block_size = block_capacity;
       }
-      buf_cnt = 0;
-      unlockMutex();
+        // The reader thread start using the new size at the next block
+      block_size.store(new_block_size, memory_order_relaxed);
     }
 
+      // Called by the reader thread. Samples are copied straight into the
+      // preallocated ring. A block is dropped if the ring is full.
     bool addSamples(const unsigned char *samples, uint32_t len)
     {
-      lockMutex();
       while (len > 0)
       {
-        uint32_t cpy_cnt = min(block_size - buf_cnt, len);
-        memcpy(buf + buf_cnt, samples, cpy_cnt);
+        unsigned h = head.load(memory_order_relaxed);
+        if (buf_cnt == 0)
+        {
+          cur_block_size = block_size.load(memory_order_relaxed);
+          dropping =
+            (h - tail.load(memory_order_acquire) >= NUM_BLOCKS);
+        }
+        uint32_t cpy_cnt = min(cur_block_size - buf_cnt, len);
+        if (!dropping)
+        {
+          memcpy(blockBuf(h) + buf_cnt, samples, cpy_cnt);
+        }
         buf_cnt += cpy_cnt;
         len -= cpy_cnt;
         samples += cpy_cnt;
-        if (buf_cnt >= block_size)
+        if (buf_cnt >= cur_block_size)
         {
-          block_queue.push(buf);
-          buf = new uint8_t[block_size];
           buf_cnt = 0;
-          unlockMutex();
-          if (write(signal_pipe[1], "S", 1) != 1)
+          if (dropping)
+          {
+            overrun_cnt.fetch_add(1, memory_order_relaxed);
+            continue;
+          }
+          block_len[h % NUM_BLOCKS] = cur_block_size;
+          head.store(h + 1, memory_order_release);
+          if (!notify(false))
           {
             return false;
           }
-          lockMutex();
         }
       }
-      unlockMutex();
       return true;
     }
 
     sigc::signal<void, complex<uint8_t>*, int> handleIq;
-    sigc::signal<void> writePipeClosed;
+    sigc::signal<void> writerStopped;
 
   private:
-    uint32_t          block_size;
-    uint8_t           *buf;
-    uint32_t          buf_cnt;
-    pthread_mutex_t   mutex;
-    int               signal_pipe[2];
-    FdWatch           *watch;
-    queue<uint8_t*>   block_queue;
-
-    void lockMutex(void)
+      // Must be a power of two so that the unsigned index wrap around
+      // work. 32 blocks of 10ms give 320ms of buffering.
+    static const unsigned NUM_BLOCKS = 32;
+      // The largest block size, 10ms at the max RTL sample rate 3.2MS/s
+    static const uint32_t MAX_BLOCK_SIZE = 2 * 3200000 / 100;
+
+    const uint32_t          block_capacity;
+    uint8_t                 *blocks;
+    uint32_t                block_len[NUM_BLOCKS];
+
+      // Only used by the reader thread
+    uint32_t                buf_cnt;
+    uint32_t                cur_block_size;
+    bool                    dropping;
+
+    std::atomic<uint32_t>   block_size;
+    std::atomic<unsigned>   head;
+    std::atomic<unsigned>   tail;
+    std::atomic<bool>       notify_pending;
+    std::atomic<bool>       writer_stopped;
+    std::atomic<unsigned long> overrun_cnt;
+    unsigned long           reported_overrun_cnt;
+    int                     notifier_fd;
+    FdWatch                 *watch;
+
+    uint8_t *blockBuf(unsigned idx)
+    {
+      return blocks + (idx % NUM_BLOCKS) * block_capacity;
+    }
+
+      // Wake up the main thread. Wakeups are combined so that the eventfd
+      // is only written when the main thread has handled the last one.
+    bool notify(bool force)
     {
-      int r = pthread_mutex_lock(&mutex);
-      if (r != 0)
+      if ((notify_pending.exchange(true) && !force) || (notifier_fd < 0))
       {
-        cerr << "*** ERROR: pthread_mutex_lock failed: "
-             << strerror(r) << endl;
-        abort();
+        return true;
+      }
+      uint64_t one = 1;
+      if (write(notifier_fd, &one, sizeof(one)) != sizeof(one))
+      {
+        notify_pending = false;
+        return errno == EAGAIN;
       }
+      return true;
     }
 
-    void unlockMutex(void)
+    void closeNotifier(void)
     {
-      int r = pthread_mutex_unlock(&mutex);
-      if (r != 0)
+      delete watch;
+      watch = 0;
+      if (notifier_fd != -1)
       {
-        cerr << "*** ERROR: pthread_mutex_unlock failed: "
-             << strerror(r) << endl;
-        abort();
+        if (close(notifier_fd) != 0)
+        {
+          cerr << "*** ERROR: Close error on SampleBuffer eventfd: "
+               << strerror(errno) << endl;
+        }
+        notifier_fd = -1;
       }
     }
 
     void removeSamples(void)
     {
-      char read_buf[64];
-      int r = read(signal_pipe[0], read_buf, sizeof(read_buf));
-      if (r == 0)
+      uint64_t cnt;
+      if ((read(notifier_fd, &cnt, sizeof(cnt)) < 0) && (errno != EAGAIN))
       {
-        closeReadPipe();
-        writePipeClosed();
-        return;
+        cerr << "*** ERROR: Error while reading SampleBuffer eventfd\n";
+        abort();
       }
-      else if (r <= 0)
+        // Use an atomic exchange to order the clear of the flag before the
+        // read of the head index below
+      notify_pending.exchange(false);
+
+      unsigned t = tail.load(memory_order_relaxed);
+      while (t != head.load(memory_order_acquire))
       {
-        cerr << "*** ERROR: Error while reading SampleBuffer signal pipe\n";
-        abort();
+        complex<uint8_t> *samples =
+          reinterpret_cast<complex<uint8_t>*>(blockBuf(t));
+        handleIq(samples, block_len[t % NUM_BLOCKS] / 2);
+          // Give the block back to the reader thread
+        tail.store(++t, memory_order_release);
+      }
+
+      unsigned long overruns = overrun_cnt.load(memory_order_relaxed);
+      if (overruns != reported_overrun_cnt)
+      {
+        cerr << "*** WARNING: RTL sample buffer overrun. "
+             << (overruns - reported_overrun_cnt)
+             << " sample block(s) dropped\n";
+        reported_overrun_cnt = overruns;
       }
 
-      lockMutex();
-      while (!block_queue.empty())
+        // The eventfd is not closed until the buffer is deleted since the
+        // reader thread may still be writing to it
+      if (writer_stopped.load(memory_order_acquire) &&
+          (t == head.load(memory_order_acquire)))
       {
-        uint8_t *buf = block_queue.front();
-        block_queue.pop();
-        unlockMutex();
-        complex<uint8_t> *samples = reinterpret_cast<complex<uint8_t>*>(buf);
-        handleIq(samples, block_size / 2);
-        delete [] buf;
-        lockMutex();
+        watch->setEnabled(false);
+        writerStopped();
       }
-      unlockMutex();
     }
 };
 
@@ -519,6 +539,7 @@ void RtlUsb::handleEnableDigitalAgc(bool enable)
 
 void *RtlUsb::startRtlReader(void *data)
 {
+  ThreadScheduling::applyToCurrentThread(ThreadScheduling::ROLE_SDR);
   RtlUsb *rtl = reinterpret_cast<RtlUsb*>(data);
   assert(rtl != 0);
   rtl->rtlReader();
@@ -583,7 +604,7 @@ void RtlUsb::rtlReader(void)
   {
     cerr << "*** WARNING: Failed to read samples from RTL dongle\n";
   }
-  sample_buf->closeWritePipe();
+  sample_buf->setWriterStopped();
 } /* RtlUsb::rtlReader */
 
 
@@ -671,7 +692,7 @@ void RtlUsb::initializeDongle(void)
 
   sample_buf = new SampleBuffer(blockSize());
   sample_buf->handleIq.connect(mem_fun(*this, &RtlUsb::handleIq));
-  sample_buf->writePipeClosed.connect(mem_fun(*this, &RtlUsb::verboseClose));
+  sample_buf->writerStopped.connect(mem_fun(*this, &RtlUsb::verboseClose));
 
   r = pthread_create(&rtl_reader_thread, NULL, startRtlReader, this);
   if (r != 0)
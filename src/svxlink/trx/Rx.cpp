@@ -60,6 +60,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "DummyRxTx.h"
 #include "Ddr.h"
 #include "LocalRxSim.h"
+#include "SharedRx.h"
 
 
 
@@ -266,43 +267,12 @@ RxFactory::~RxFactory(void)
 
 Rx *RxFactory::createNamedRx(Config& cfg, const string& name)
 {
-  LocalRxFactory local_rx_factory;
-  VoterFactory voter_factory;
-  NetRxFactory net_rx_factory;
-  DummyRxFactory dummy_rx_factory;
-  DdrFactory ddr_rx_factory;
-  LocalRxSimFactory local_rx_sim_factory;
-  
-  string rx_type;
-  if (name != "NONE")
-  {
-    if (!cfg.getValue(name, "TYPE", rx_type))
-    {
-      cerr << "*** ERROR: Config variable " << name << "/TYPE not set\n";
-      return 0;
-    }
-  }
-  else
-  {
-    rx_type = "Dummy";
-  }
-  
-  map<string, RxFactory*>::iterator it;
-  it = rx_factories.find(rx_type);
-  if (it == rx_factories.end())
+  bool shared = false;
+  if ((name != "NONE") && cfg.getValue(name, "SHARED", shared) && shared)
   {
-    cerr << "*** ERROR: Unknown RX type \"" << rx_type << "\" specified for "
-         << "receiver " << name << ". Legal values are: ";
-    for (it=rx_factories.begin(); it!=rx_factories.end(); ++it)
-    {
-      cerr << "\"" << (*it).first << "\" ";
-    }
-    cerr << endl;
-    return 0;
+    return new SharedRx(cfg, name);
   }
-  
-  return (*it).second->createRx(cfg, name);
-
+  return createUnsharedRx(cfg, name);
 } /* RxFactory::createNamedRx */
 
 
@@ -342,6 +312,48 @@ void Rx::setSquelchState(bool is_open)
  *
  ****************************************************************************/
 
+Rx *RxFactory::createUnsharedRx(Config& cfg, const string& name)
+{
+  LocalRxFactory local_rx_factory;
+  VoterFactory voter_factory;
+  NetRxFactory net_rx_factory;
+  DummyRxFactory dummy_rx_factory;
+  DdrFactory ddr_rx_factory;
+  LocalRxSimFactory local_rx_sim_factory;
+  
+  string rx_type;
+  if (name != "NONE")
+  {
+    if (!cfg.getValue(name, "TYPE", rx_type))
+    {
+      cerr << "*** ERROR: Config variable " << name << "/TYPE not set\n";
+      return 0;
+    }
+  }
+  else
+  {
+    rx_type = "Dummy";
+  }
+  
+  map<string, RxFactory*>::iterator it;
+  it = rx_factories.find(rx_type);
+  if (it == rx_factories.end())
+  {
+    cerr << "*** ERROR: Unknown RX type \"" << rx_type << "\" specified for "
+         << "receiver " << name << ". Legal values are: ";
+    for (it=rx_factories.begin(); it!=rx_factories.end(); ++it)
+    {
+      cerr << "\"" << (*it).first << "\" ";
+    }
+    cerr << endl;
+    return 0;
+  }
+  
+  return (*it).second->createRx(cfg, name);
+
+} /* RxFactory::createUnsharedRx */
+
+
 void Rx::sqlTimeout(Timer *t)
 {
   cerr << "*** WARNING: The squelch was open for too long for receiver "
@@ -240,6 +240,26 @@ class Rx : public sigc::trackable, public Async::AudioSource
      */
     virtual void setModulation(Modulation::Type mod) {}
 
+    /**
+     * @brief   Tell the receiver if its audio is needed or not
+     * @param   is_needed Set to \em false if the audio will not be used
+     *
+     * A receiver that is told that its audio is not needed may skip
+     * processing, like decoding, of received audio. Squelch and signal
+     * level handling must still work as usual.
+     */
+    virtual void setAudioNeeded(bool is_needed) {}
+
+    /**
+     * @brief   Set how much audio to keep while the audio is not needed
+     * @param   lookback_ms The lookback time in milliseconds
+     *
+     * A receiver that skips audio processing when the audio is not needed
+     * may keep the most recent audio for this long so that it can be
+     * delivered when the audio becomes needed again.
+     */
+    virtual void setAudioLookback(unsigned lookback_ms) {}
+
     /**
      * @brief 	A signal that indicates if the squelch is open or not
      * @param 	is_open \em True if the squelch is open or \em false if not
@@ -333,6 +353,10 @@ class RxFactory
   
   private:
     static std::map<std::string, RxFactory*> rx_factories;
+
+    static Rx *createUnsharedRx(Async::Config& cfg, const std::string& name);
+
+    friend class SharedRx;
     
     std::string m_name;
 
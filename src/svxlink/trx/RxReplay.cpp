@@ -0,0 +1,477 @@
+/**
+@file   RxReplay.cpp
+@brief  Replay recorded audio or I/Q captures through a configured receiver
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This program feed a recorded capture through a complete receiver chain,
+configured just like in svxlink.conf, as fast as the CPU allow. Audio
+captures, 16 bit mono WAV or raw files at the internal sample rate, are fed
+through the LocalRxBase chain (filters, squelch, DTMF, tone and selcall
+detectors and signal level detector). For a Ddr receiver the capture is read
+through a WbRx section of TYPE RtlReplay. All decoded events are logged with a
+timestamp and a checksum of the event log is printed, together with the number
+of samples per second processed. The checksum can be compared between runs to
+catch regressions in the DSP code.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncCppApplication.h>
+#include <AsyncConfig.h>
+#include <AsyncAudioSink.h>
+#include <AsyncAudioSampleRate.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "Rx.h"
+#include "LocalRxReplay.h"
+#include "CaptureFile.h"
+#include "WbRxRtlSdr.h"
+#include "RtlReplay.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+#define MAX_BLOCK_SIZE  (AudioSampleRate::MAX / 100)
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+/**
+ * An audio sink that throw away all samples
+ */
+class NullSink : public AudioSink
+{
+  public:
+    virtual int writeSamples(const float *samples, int count)
+    {
+      return count;
+    }
+    virtual void flushSamples(void) { sourceAllSamplesFlushed(); }
+};
+
+
+/**
+ * Log all events emitted by a receiver together with a timestamp
+ */
+class EventLog : public sigc::trackable
+{
+  public:
+    EventLog(Rx *rx, bool verbose)
+      : verbose(verbose), time_ms(0), sql_cnt(0), dtmf_cnt(0), tone_cnt(0),
+        sel5_cnt(0), siglev_cnt(0), hash(14695981039346656037ULL)
+    {
+      rx->squelchOpen.connect(mem_fun(*this, &EventLog::onSquelchOpen));
+      rx->dtmfDigitDetected.connect(mem_fun(*this, &EventLog::onDtmfDigit));
+      rx->toneDetected.connect(mem_fun(*this, &EventLog::onToneDetected));
+      rx->selcallSequenceDetected.connect(
+          mem_fun(*this, &EventLog::onSelcall));
+      rx->signalLevelUpdated.connect(
+          mem_fun(*this, &EventLog::onSignalLevelUpdated));
+    }
+
+    void setTime(unsigned long long ms) { time_ms = ms; }
+    unsigned long long checksum(void) const { return hash; }
+
+    bool                verbose;
+    unsigned long long  time_ms;
+    unsigned            sql_cnt;
+    unsigned            dtmf_cnt;
+    unsigned            tone_cnt;
+    unsigned            sel5_cnt;
+    unsigned            siglev_cnt;
+
+  private:
+    unsigned long long  hash;
+
+    void onSquelchOpen(bool is_open)
+    {
+      ++sql_cnt;
+      ostringstream ss;
+      ss << "SQL " << (is_open ? "OPEN" : "CLOSED");
+      log(ss.str());
+    }
+
+    void onDtmfDigit(char digit, int duration)
+    {
+      ++dtmf_cnt;
+      ostringstream ss;
+      ss << "DTMF " << digit << " " << duration;
+      log(ss.str());
+    }
+
+    void onToneDetected(float fq)
+    {
+      ++tone_cnt;
+      ostringstream ss;
+      ss << "TONE " << fixed << setprecision(1) << fq;
+      log(ss.str());
+    }
+
+    void onSelcall(string sequence)
+    {
+      ++sel5_cnt;
+      log("SEL5 " + sequence);
+    }
+
+    void onSignalLevelUpdated(float siglev)
+    {
+      ++siglev_cnt;
+      ostringstream ss;
+      ss << "SIGLEV " << fixed << setprecision(0) << siglev;
+      log(ss.str());
+    }
+
+    void log(const string &event)
+    {
+      ostringstream ss;
+      ss << time_ms << " " << event << "\n";
+      const string line(ss.str());
+      if (verbose)
+      {
+        cout << line;
+      }
+        // 64 bit FNV-1a
+      for (string::const_iterator it=line.begin(); it!=line.end(); ++it)
+      {
+        hash ^= static_cast<unsigned char>(*it);
+        hash *= 1099511628211ULL;
+      }
+    }
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+static void usage(const char *prog);
+static unsigned long long replayAudio(LocalRxReplay *rx, EventLog &log,
+                                      const string &path);
+static unsigned long long replayIq(Config &cfg, const string &rx_name,
+                                   EventLog &log, unsigned &rate);
+static double wallTime(void);
+static double cpuTime(void);
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * MAIN
+ *
+ ****************************************************************************/
+
+/*
+ *----------------------------------------------------------------------------
+ * Function:  main
+ * Purpose:   Replay a capture through the receiver given on the command line
+ * Input:     argc  - The number of arguments passed to this program
+ *    	      	      including the program name.
+ *    	      argv  - The arguments passed to this program. argv[0] is the
+ *    	      	      program name.
+ * Output:    Return 0 on success, else non-zero.
+ * Author:    Tobias Blomberg, SM0SVX
+ * Created:   2020-10-14
+ * Remarks:
+ * Bugs:
+ *----------------------------------------------------------------------------
+ */
+int main(int argc, const char **argv)
+{
+  CppApplication app;
+
+  bool verbose = false;
+  vector<string> args;
+  for (int i=1; i<argc; ++i)
+  {
+    if (strcmp(argv[i], "-v") == 0)
+    {
+      verbose = true;
+    }
+    else if (argv[i][0] == '-')
+    {
+      usage(argv[0]);
+      exit(1);
+    }
+    else
+    {
+      args.push_back(argv[i]);
+    }
+  }
+  if ((args.size() < 2) || (args.size() > 3))
+  {
+    usage(argv[0]);
+    exit(1);
+  }
+  const string &cfg_file = args[0];
+  const string &rx_name = args[1];
+
+  Config cfg;
+  if (!cfg.open(cfg_file))
+  {
+    cerr << "*** ERROR: Could not open configuration file: "
+         << cfg_file << endl;
+    exit(1);
+  }
+
+  string rx_type;
+  cfg.getValue(rx_name, "TYPE", rx_type);
+  bool is_iq = (rx_type == "Ddr");
+  if (!is_iq && (args.size() != 3))
+  {
+    cerr << "*** ERROR: An audio capture file must be given for receiver "
+         << "type \"" << rx_type << "\"\n";
+    exit(1);
+  }
+
+  double wall_start = wallTime();
+  double cpu_start = cpuTime();
+  Rx *rx = 0;
+  EventLog *log = 0;
+  unsigned long long sample_cnt = 0;
+  unsigned rate = INTERNAL_SAMPLE_RATE;
+  NullSink null_sink;
+  if (is_iq)
+  {
+      // The capture file is given in the WbRx section, FILE=...
+    rx = RxFactory::createNamedRx(cfg, rx_name);
+    if ((rx == 0) || !rx->initialize())
+    {
+      cerr << "*** ERROR: Could not initialize receiver " << rx_name << endl;
+      exit(1);
+    }
+    log = new EventLog(rx, verbose);
+    rx->registerSink(&null_sink);
+    rx->setMuteState(Rx::MUTE_NONE);
+    sample_cnt = replayIq(cfg, rx_name, *log, rate);
+  }
+  else
+  {
+    LocalRxReplay *replay_rx = new LocalRxReplay(cfg, rx_name);
+    rx = replay_rx;
+    if (!rx->initialize())
+    {
+      cerr << "*** ERROR: Could not initialize receiver " << rx_name << endl;
+      exit(1);
+    }
+    log = new EventLog(rx, verbose);
+    rx->registerSink(&null_sink);
+    rx->setMuteState(Rx::MUTE_NONE);
+    sample_cnt = replayAudio(replay_rx, *log, args[2]);
+  }
+  double wall_time = wallTime() - wall_start;
+  double cpu_time = cpuTime() - cpu_start;
+
+  double audio_time = static_cast<double>(sample_cnt) / rate;
+  cout << "Samples:      " << sample_cnt << " @ " << rate << "Hz ("
+       << fixed << setprecision(3) << audio_time << "s)\n";
+  cout << "Wall time:    " << wall_time << "s\n";
+  cout << "CPU time:     " << cpu_time << "s\n";
+  if (cpu_time > 0.0)
+  {
+    cout << "Samples/s:    " << setprecision(0) << (sample_cnt / cpu_time)
+         << "\n";
+    cout << "Realtime:     " << setprecision(1) << (audio_time / cpu_time)
+         << "x\n";
+  }
+  cout << "Events:       squelch=" << log->sql_cnt
+       << " dtmf=" << log->dtmf_cnt
+       << " tone=" << log->tone_cnt
+       << " sel5=" << log->sel5_cnt
+       << " siglev=" << log->siglev_cnt << "\n";
+  cout << "Checksum:     " << hex << setw(16) << setfill('0')
+       << log->checksum() << dec << endl;
+
+  delete log;
+  delete rx;
+
+  return (sample_cnt > 0) ? 0 : 1;
+} /* main */
+
+
+/****************************************************************************
+ *
+ * Functions
+ *
+ ****************************************************************************/
+
+static void usage(const char *prog)
+{
+  cerr << "Usage: " << prog
+       << " [-v] <config file> <rx section> [<capture file>]\n"
+          "  -v  Print all decoded events\n"
+          "The capture file is a 16 bit mono WAV or raw file sampled at "
+       << INTERNAL_SAMPLE_RATE << "Hz.\n"
+          "For a Ddr receiver, the I/Q capture is given by the FILE "
+          "variable in a\nWbRx section of TYPE RtlReplay.\n";
+} /* usage */
+
+
+static unsigned long long replayAudio(LocalRxReplay *rx, EventLog &log,
+                                      const string &path)
+{
+  CaptureFile file;
+  if (!file.open(path))
+  {
+    return 0;
+  }
+  if (file.channels() != 1)
+  {
+    cerr << "*** ERROR: The capture file \"" << path << "\" must be mono\n";
+    return 0;
+  }
+
+  unsigned long long sample_cnt = 0;
+  const int block_size = INTERNAL_SAMPLE_RATE / 100;
+  float samples[MAX_BLOCK_SIZE];
+  for (;;)
+  {
+    int cnt = file.read(samples, block_size);
+    if (cnt <= 0)
+    {
+      break;
+    }
+    log.setTime(sample_cnt * 1000 / INTERNAL_SAMPLE_RATE);
+    rx->write(samples, cnt);
+    sample_cnt += cnt;
+  }
+
+  return sample_cnt;
+} /* replayAudio */
+
+
+static unsigned long long replayIq(Config &cfg, const string &rx_name,
+                                   EventLog &log, unsigned &rate)
+{
+  string wbrx_name;
+  cfg.getValue(rx_name, "WBRX", wbrx_name);
+  WbRxRtlSdr *wbrx = WbRxRtlSdr::instance(cfg, wbrx_name);
+  RtlReplay *replay = (wbrx != 0) ?
+      dynamic_cast<RtlReplay*>(wbrx->device()) : 0;
+  if (replay == 0)
+  {
+    cerr << "*** ERROR: The WbRx section \"" << wbrx_name << "\" of "
+         << "receiver " << rx_name << " must be of TYPE RtlReplay\n";
+    return 0;
+  }
+
+  rate = replay->sampleRate();
+  unsigned long long sample_cnt = 0;
+  for (;;)
+  {
+    log.setTime(sample_cnt * 1000 / rate);
+    size_t cnt = replay->replayBlock();
+    if (cnt == 0)
+    {
+      break;
+    }
+    sample_cnt += cnt;
+  }
+
+  return sample_cnt;
+} /* replayIq */
+
+
+static double wallTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1.0e9;
+} /* wallTime */
+
+
+static double cpuTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1.0e9;
+} /* cpuTime */
+
+
+/*
+ * This file has not been truncated
+ */
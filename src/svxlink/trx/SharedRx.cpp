@@ -0,0 +1,443 @@
+/**
+@file	 SharedRx.cpp
+@brief   A receiver that share one receiver instance between several users
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <list>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSplitter.h>
+#include <AsyncAudioValve.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "SharedRx.h"
+
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+struct SharedRx::Shared
+{
+  Rx*                 rx;
+  AudioSplitter*      splitter;
+  list<SharedRx*>     users;
+  bool                init_ok;
+
+  Shared(void) : rx(0), splitter(0), init_ok(false) {}
+  ~Shared(void)
+  {
+    delete rx;
+    delete splitter;
+  }
+};
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+SharedRx::SharedRx(Config& cfg, const string& name)
+  : Rx(cfg, name), shared(0), valve(0), mute_state(MUTE_ALL),
+    audio_needed(true)
+{
+    // Squelch state changes are printed by the shared receiver
+  Rx::setVerbose(false);
+} /* SharedRx::SharedRx */
+
+
+SharedRx::~SharedRx(void)
+{
+  clearHandler();
+  if (shared != 0)
+  {
+    if (valve != 0)
+    {
+      shared->splitter->removeSink(valve);
+    }
+    shared->users.remove(this);
+    if (shared->users.empty())
+    {
+      sharedMap().erase(name());
+      delete shared;
+    }
+    else
+    {
+      shared->users.front()->updateSharedState();
+    }
+    shared = 0;
+  }
+  delete valve;
+} /* SharedRx::~SharedRx */
+
+
+bool SharedRx::initialize(void)
+{
+  if (shared != 0)
+  {
+    return shared->init_ok;
+  }
+
+  if (!Rx::initialize())
+  {
+    return false;
+  }
+
+  SharedMap::iterator it = sharedMap().find(name());
+  if (it != sharedMap().end())
+  {
+    shared = it->second;
+  }
+  else
+  {
+    shared = new Shared;
+    sharedMap()[name()] = shared;
+    shared->rx = RxFactory::createUnsharedRx(cfg(), name());
+    if ((shared->rx != 0) && shared->rx->initialize())
+    {
+      shared->init_ok = true;
+      shared->splitter = new AudioSplitter;
+      shared->rx->registerSink(shared->splitter);
+    }
+    else
+    {
+      cerr << "*** ERROR: Could not initialize shared RX \"" << name()
+           << "\"\n";
+    }
+  }
+  shared->users.push_back(this);
+
+  if (!shared->init_ok)
+  {
+    return false;
+  }
+
+  valve = new AudioValve;
+  valve->setOpen(false);
+  shared->splitter->addSink(valve);
+  setHandler(valve);
+
+  Rx *rx = shared->rx;
+  rx->squelchOpen.connect(mem_fun(*this, &SharedRx::onSquelchOpen));
+  rx->dtmfDigitDetected.connect(
+      mem_fun(*this, &SharedRx::onDtmfDigitDetected));
+  rx->selcallSequenceDetected.connect(
+      mem_fun(*this, &SharedRx::onSelcallSequenceDetected));
+  rx->toneDetected.connect(mem_fun(*this, &SharedRx::onToneDetected));
+  rx->dataReceived.connect(mem_fun(*this, &SharedRx::onDataReceived));
+  rx->signalLevelUpdated.connect(signalLevelUpdated.make_slot());
+  rx->publishStateEvent.connect(publishStateEvent.make_slot());
+  rx->readyStateChanged.connect(readyStateChanged.make_slot());
+
+  updateSharedState();
+
+  return true;
+
+} /* SharedRx::initialize */
+
+
+void SharedRx::setVerbose(bool verbose)
+{
+  if ((shared != 0) && shared->init_ok)
+  {
+    shared->rx->setVerbose(verbose);
+  }
+} /* SharedRx::setVerbose */
+
+
+void SharedRx::setMuteState(MuteState new_mute_state)
+{
+  if (new_mute_state == mute_state)
+  {
+    return;
+  }
+  mute_state = new_mute_state;
+
+  if ((shared == 0) || !shared->init_ok)
+  {
+    return;
+  }
+
+    // Unmute the shared receiver before looking at its squelch state
+  updateSharedState();
+  valve->setOpen(mute_state == MUTE_NONE);
+  setSquelchState((mute_state != MUTE_ALL) && shared->rx->squelchIsOpen());
+} /* SharedRx::setMuteState */
+
+
+bool SharedRx::addToneDetector(float fq, int bw, float thresh,
+                               int required_duration)
+{
+  if ((shared == 0) || !shared->init_ok)
+  {
+    return false;
+  }
+  return shared->rx->addToneDetector(fq, bw, thresh, required_duration);
+} /* SharedRx::addToneDetector */
+
+
+float SharedRx::signalStrength(void) const
+{
+  if ((shared == 0) || !shared->init_ok)
+  {
+    return 0;
+  }
+  return shared->rx->signalStrength();
+} /* SharedRx::signalStrength */
+
+
+char SharedRx::sqlRxId(void) const
+{
+  if ((shared == 0) || !shared->init_ok)
+  {
+    return ID_UNKNOWN;
+  }
+  return shared->rx->sqlRxId();
+} /* SharedRx::sqlRxId */
+
+
+void SharedRx::reset(void)
+{
+  if ((shared == 0) || !shared->init_ok)
+  {
+    return;
+  }
+  if (shared->users.size() == 1)
+  {
+    shared->rx->reset();
+  }
+  setSquelchState((mute_state != MUTE_ALL) && shared->rx->squelchIsOpen());
+} /* SharedRx::reset */
+
+
+bool SharedRx::isReady(void) const
+{
+  return (shared != 0) && shared->init_ok && shared->rx->isReady();
+} /* SharedRx::isReady */
+
+
+void SharedRx::setFq(unsigned fq)
+{
+  if ((shared != 0) && shared->init_ok)
+  {
+    shared->rx->setFq(fq);
+  }
+} /* SharedRx::setFq */
+
+
+void SharedRx::setModulation(Modulation::Type mod)
+{
+  if ((shared != 0) && shared->init_ok)
+  {
+    shared->rx->setModulation(mod);
+  }
+} /* SharedRx::setModulation */
+
+
+void SharedRx::setAudioNeeded(bool is_needed)
+{
+  audio_needed = is_needed;
+  if ((shared != 0) && shared->init_ok)
+  {
+    updateSharedState();
+  }
+} /* SharedRx::setAudioNeeded */
+
+
+void SharedRx::setAudioLookback(unsigned lookback_ms)
+{
+  if ((shared != 0) && shared->init_ok)
+  {
+    shared->rx->setAudioLookback(lookback_ms);
+  }
+} /* SharedRx::setAudioLookback */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+/*
+ * Set the shared receiver to the least muted state of all users and tell it
+ * that audio is needed if any user need it.
+ */
+void SharedRx::updateSharedState(void)
+{
+  if (!shared->init_ok)
+  {
+    return;
+  }
+
+  MuteState shared_mute_state = MUTE_ALL;
+  bool shared_audio_needed = false;
+  for (list<SharedRx*>::const_iterator it = shared->users.begin();
+       it != shared->users.end(); ++it)
+  {
+    shared_mute_state = min(shared_mute_state, (*it)->mute_state);
+    shared_audio_needed = shared_audio_needed || (*it)->audio_needed;
+  }
+  shared->rx->setMuteState(shared_mute_state);
+  shared->rx->setAudioNeeded(shared_audio_needed);
+} /* SharedRx::updateSharedState */
+
+
+void SharedRx::onSquelchOpen(bool is_open)
+{
+  if (mute_state != MUTE_ALL)
+  {
+    setSquelchState(is_open);
+  }
+} /* SharedRx::onSquelchOpen */
+
+
+void SharedRx::onDtmfDigitDetected(char digit, int duration)
+{
+  if (mute_state == MUTE_NONE)
+  {
+    dtmfDigitDetected(digit, duration);
+  }
+} /* SharedRx::onDtmfDigitDetected */
+
+
+void SharedRx::onSelcallSequenceDetected(std::string sequence)
+{
+  if (mute_state == MUTE_NONE)
+  {
+    selcallSequenceDetected(sequence);
+  }
+} /* SharedRx::onSelcallSequenceDetected */
+
+
+void SharedRx::onToneDetected(float fq)
+{
+  if (mute_state == MUTE_NONE)
+  {
+    toneDetected(fq);
+  }
+} /* SharedRx::onToneDetected */
+
+
+void SharedRx::onDataReceived(std::vector<uint8_t>& data)
+{
+  if (mute_state == MUTE_NONE)
+  {
+    dataReceived(data);
+  }
+} /* SharedRx::onDataReceived */
+
+
+SharedRx::SharedMap& SharedRx::sharedMap(void)
+{
+  static SharedMap shared_map;
+  return shared_map;
+} /* SharedRx::sharedMap */
+
+
+
+/*
+ * This file has not been truncated
+ */
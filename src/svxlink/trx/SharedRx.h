@@ -0,0 +1,261 @@
+/**
+@file	 SharedRx.h
+@brief   A receiver that share one receiver instance between several users
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef SHARED_RX_INCLUDED
+#define SHARED_RX_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "Rx.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class AudioValve;
+};
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+//namespace MyNameSpace
+//{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A receiver that share one receiver instance between several users
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+When SHARED=1 is set in a receiver configuration section, the RX factory
+return a SharedRx object instead of creating a new receiver each time the
+section is asked for. All SharedRx objects for the same section use one
+receiver instance, created by the first one to be initialized and deleted
+when the last one is deleted. The audio processing, squelch and DTMF
+decoding is thereby only done once no matter how many logic cores that use
+the receiver.
+
+The audio from the shared receiver is split to all users. Each user has its
+own mute state. The shared receiver is muted to the least muted state of all
+users and each user mute the audio and events that it get on its own. Changes
+of the receiver frequency, modulation and tone detectors affect all users.
+*/
+class SharedRx : public Rx
+{
+  public:
+    /**
+     * @brief 	Constructor
+     * @param 	cfg   The configuration object to use
+     * @param 	name  The name of the receiver configuration section
+     */
+    SharedRx(Async::Config& cfg, const std::string& name);
+
+    /**
+     * @brief 	Destructor
+     */
+    virtual ~SharedRx(void);
+
+    /**
+     * @brief 	Initialize the receiver object
+     * @return 	Return \em true on success, or \em false on failure
+     *
+     * The shared receiver is created and initialized by the first
+     * SharedRx object for a configuration section to be initialized.
+     */
+    virtual bool initialize(void);
+
+    /**
+     * @brief 	Set the verbosity level of the receiver
+     * @param	verbose Set to \em false to keep the rx from printing things
+     */
+    virtual void setVerbose(bool verbose);
+
+    /**
+     * @brief 	Set the mute state for this receiver
+     * @param 	new_mute_state The new mute state to set
+     */
+    virtual void setMuteState(MuteState new_mute_state);
+
+    /**
+     * @brief 	Add a tone detector to the receiver
+     * @param 	fq    The tone frequency to detect
+     * @param 	bw    The bandwidth of the detector
+     * @param 	thresh The detection threshold in dB SNR
+     * @param 	required_duration The required time in milliseconds that
+     *	      	the tone must be active for activity to be reported.
+     * @return	Return \em true if the Rx is capable of tone detection or
+     *	      	\em false if it's not.
+     */
+    virtual bool addToneDetector(float fq, int bw, float thresh,
+                                 int required_duration);
+
+    /**
+     * @brief 	Read the current signal strength
+     * @return	Returns the signal strength
+     */
+    virtual float signalStrength(void) const;
+
+    /**
+     * @brief 	Find out RX ID of last receiver with squelch activity
+     * @returns Returns the RX ID
+     */
+    virtual char sqlRxId(void) const;
+
+    /**
+     * @brief 	Reset the receiver object to its default settings
+     *
+     * The shared receiver is only reset if this is its only user.
+     */
+    virtual void reset(void);
+
+    /**
+     * @brief   Check if the receiver is ready to be used
+     * @return  Returns \em true if the receiver is ready
+     */
+    virtual bool isReady(void) const;
+
+    /**
+     * @brief   Set the receiver frequency
+     * @param   fq The frequency in Hz
+     */
+    virtual void setFq(unsigned fq);
+
+    /**
+     * @brief   Set the receiver modulation mode
+     * @param   mod The modulation to set
+     */
+    virtual void setModulation(Modulation::Type mod);
+
+    /**
+     * @brief   Tell the receiver if audio is needed or not
+     * @param   is_needed Set to \em true if audio is needed
+     *
+     * The shared receiver is told that audio is needed if any user need it.
+     */
+    virtual void setAudioNeeded(bool is_needed);
+
+    /**
+     * @brief   Set the audio lookback time
+     * @param   lookback_ms The lookback time in milliseconds
+     */
+    virtual void setAudioLookback(unsigned lookback_ms);
+
+  private:
+    struct Shared;
+    typedef std::map<std::string, Shared*> SharedMap;
+
+    Shared*           shared;
+    Async::AudioValve *valve;
+    MuteState         mute_state;
+    bool              audio_needed;
+
+    SharedRx(const SharedRx&);
+    SharedRx& operator=(const SharedRx&);
+    static SharedMap& sharedMap(void);
+    void updateSharedState(void);
+    void onSquelchOpen(bool is_open);
+    void onDtmfDigitDetected(char digit, int duration);
+    void onSelcallSequenceDetected(std::string sequence);
+    void onToneDetected(float fq);
+    void onDataReceived(std::vector<uint8_t>& data);
+
+};  /* class SharedRx */
+
+
+//} /* namespace */
+
+#endif /* SHARED_RX_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
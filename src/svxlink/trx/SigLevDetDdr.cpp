@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -44,6 +45,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncConfig.h>
+#include <AsyncAudioSampleOps.h>
 
 
 /****************************************************************************
@@ -214,12 +216,18 @@ float SigLevDetDdr::siglevIntegrated(void) const
 
 void SigLevDetDdr::processSamples(const vector<RtlTcp::Sample> &samples)
 {
-  for (vector<RtlTcp::Sample>::const_iterator it = samples.begin();
-       it != samples.end();
-       ++it)
+  unsigned pos = 0;
+  while (pos < samples.size())
   {
-    pwr_sum += it->real() * it->real() + it->imag() * it->imag();
-    if (++block_idx == block_size)
+      // A complex sample is stored as two floats, real part first, so the
+      // power of a run of I/Q samples is the energy of twice as many floats
+    unsigned len = min(block_size - block_idx,
+                       static_cast<unsigned>(samples.size() - pos));
+    const float *iq = reinterpret_cast<const float*>(&samples[pos]);
+    pwr_sum += AudioSampleOps::energy(iq, 2 * len);
+    block_idx += len;
+    pos += len;
+    if (block_idx == block_size)
     {
       last_siglev = offset + slope * 10.0 * log10(pwr_sum / block_size);
       siglev_values.push_back(last_siglev);
@@ -34,6 +34,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <cmath>
 #include <limits>
+#include <algorithm>
 //#include <iostream>
 
 
@@ -44,6 +45,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncAudioFilter.h>
+#include <AsyncAudioSampleOps.h>
 #include <AsyncSigCAudioSink.h>
 #include <AsyncConfig.h>
 
@@ -227,7 +229,7 @@ float SigLevDetNoise::lastSiglev(void) const
     return 0.0f;
   }
 
-  return offset - slope * log10(*ss_idx.back());
+  return siglev;
 
 } /* SigLevDetNoise::lastSiglev */
 
@@ -291,12 +293,16 @@ void SigLevDetNoise::reset(void)
 
 int SigLevDetNoise::processSamples(float *samples, int count)
 {
-  for (int i=0; i<count; ++i)
+  int pos = 0;
+  while (pos < count)
   {
-    const float &sample = samples[i];
-    const double square = sample * sample;
-    ss += square;
-    if (++ss_cnt >= block_len)
+      // Sum up the energy in the rest of the current block in one go
+    unsigned len = min(block_len - ss_cnt,
+                       static_cast<unsigned>(count - pos));
+    ss += AudioSampleOps::energy(samples + pos, len);
+    ss_cnt += len;
+    pos += len;
+    if (ss_cnt >= block_len)
     {
       SsSetIter it = ss_values.insert(ss);
       ss_idx.push_back(it);
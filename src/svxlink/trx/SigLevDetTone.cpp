@@ -35,6 +35,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iostream>
 #include <cstdio>
 #include <cstdlib>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -46,6 +47,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncConfig.h>
 #include <AsyncSigCAudioSink.h>
 #include <AsyncAudioFilter.h>
+#include <AsyncAudioSampleOps.h>
 #include <common.h>
 
 
@@ -300,18 +302,27 @@ float SigLevDetTone::siglevIntegrated(void) const
 
 int SigLevDetTone::processSamples(const float *samples, int count)
 {
-  for (int i=0; i<count; ++i)
+  int pos = 0;
+  while (pos < count)
   {
-    const float &sample = samples[i];
-
-    passband_energy += sample * sample;
-
-    for (int detno=0; detno < 10; ++detno)
+      // Process the rest of the current block. The passband energy is
+      // calculated for the whole run in one go.
+    const float *block = samples + pos;
+    unsigned len = min(BLOCK_SIZE - block_idx,
+                       static_cast<unsigned>(count - pos));
+    passband_energy += AudioSampleOps::energy(block, len);
+    for (unsigned i=0; i<len; ++i)
     {
-      det[detno]->calc(sample);
+      const float sample = block[i];
+      for (int detno=0; detno < 10; ++detno)
+      {
+        det[detno]->calc(sample);
+      }
     }
-    
-    if (++block_idx == BLOCK_SIZE)
+    block_idx += len;
+    pos += len;
+
+    if (block_idx == BLOCK_SIZE)
     {
       float max = 0.0f;
       int max_idx = -1;
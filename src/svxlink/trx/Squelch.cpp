@@ -54,6 +54,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include "SquelchSigLev.h"
 #include "SquelchEvDev.h"
 #include "SquelchGpio.h"
+#ifdef HAS_GPIOD_SUPPORT
+#include "SquelchGpiod.h"
+#endif
 #include "SquelchCombine.h"
 #include "SquelchPty.h"
 #include "SquelchOpen.h"
@@ -137,6 +140,9 @@ Squelch* createSquelch(const std::string& sql_name)
   static SquelchSpecificFactory<SquelchPty> pty_factory;
 #ifdef HAS_HIDRAW_SUPPORT
   static SquelchSpecificFactory<SquelchHidraw> hidraw_factory;
+#endif
+#ifdef HAS_GPIOD_SUPPORT
+  static SquelchSpecificFactory<SquelchGpiod> gpiod_factory;
 #endif
   static SquelchSpecificFactory<SquelchCombine> combine_factory;
 
@@ -51,6 +51,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncConfig.h>
 #include <AsyncAudioSink.h>
 #include <AsyncFactory.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
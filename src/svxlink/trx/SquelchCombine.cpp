@@ -90,8 +90,7 @@ class SquelchCombine::Node
     virtual void setSqlTimeout(int timeout) = 0;
     virtual void reset(void) = 0;
     virtual void writeSamples(const float *samples, int count) = 0;
-    virtual bool isOpen(void) const = 0;
-    sigc::signal<void, bool> squelchOpen;
+    virtual void compile(SquelchCombine& comb, int parent) = 0;
 
   private:
     std::string m_name;
@@ -130,8 +129,6 @@ class SquelchCombine::LeafNode : public SquelchCombine::Node
       return true;
     }
 
-    virtual bool isOpen(void) { return m_squelch->isOpen(); }
-
     virtual void setStartDelay(int delay) { m_squelch->setStartDelay(delay); }
 
     virtual void setHangtime(int hang) { m_squelch->setHangtime(hang); }
@@ -171,7 +168,19 @@ class SquelchCombine::LeafNode : public SquelchCombine::Node
       } while (pos < count);
     }
 
-    virtual bool isOpen(void) const { return m_squelch->isOpen(); }
+    virtual void compile(SquelchCombine& comb, int parent)
+    {
+      int idx = comb.addOp(OP_LEAF, parent, this);
+      squelchOpen.connect(
+          sigc::bind(sigc::mem_fun(comb, &SquelchCombine::onLeafOpen), idx));
+    }
+
+    bool isOpen(void) const
+    {
+      return (m_squelch != nullptr) && m_squelch->isOpen();
+    }
+
+    sigc::signal<void, bool> squelchOpen;
 
   private:
     Squelch* m_squelch = nullptr;
@@ -182,10 +191,7 @@ class SquelchCombine::UnaryOpNode : public SquelchCombine::Node
 {
   public:
     UnaryOpNode(const std::string& name, Node *node)
-      : Node(name), m_node(node)
-    {
-      m_node->squelchOpen.connect(squelchOpen.make_slot());
-    }
+      : Node(name), m_node(node) {}
 
     virtual ~UnaryOpNode(void)
     {
@@ -253,7 +259,11 @@ class SquelchCombine::UnaryOpNode : public SquelchCombine::Node
 struct SquelchCombine::NegationOpNode : public SquelchCombine::UnaryOpNode
 {
   NegationOpNode(Node* node) : UnaryOpNode("NOT", node) {}
-  virtual bool isOpen(void) const { return !m_node->isOpen(); }
+
+  virtual void compile(SquelchCombine& comb, int parent)
+  {
+    m_node->compile(comb, comb.addOp(OP_NOT, parent));
+  }
 }; /* SquelchCombine::NegationOpNode */
 
 
@@ -261,13 +271,7 @@ class SquelchCombine::BinaryOpNode : public SquelchCombine::Node
 {
   public:
     BinaryOpNode(const std::string& n, Node* l, Node* r)
-      : Node(n), m_left(l), m_right(r)
-    {
-      m_left->squelchOpen.connect(
-          sigc::mem_fun(*this, &BinaryOpNode::onSquelchOpen));
-      m_right->squelchOpen.connect(
-          sigc::mem_fun(*this, &BinaryOpNode::onSquelchOpen));
-    }
+      : Node(n), m_left(l), m_right(r) {}
 
     virtual ~BinaryOpNode(void)
     {
@@ -339,14 +343,21 @@ class SquelchCombine::BinaryOpNode : public SquelchCombine::Node
       m_right->writeSamples(samples, count);
     }
 
-    void onSquelchOpen(bool is_open)
-    {
-      squelchOpen(isOpen());
-    }
-
   protected:
     Node* m_left;
     Node* m_right;
+
+      // Chains of the same operator, like "A | B | C", are flattened into
+      // one operation with many inputs
+    void compileOp(SquelchCombine& comb, OpType type, int parent)
+    {
+      if ((parent < 0) || (comb.m_ops[parent].type != type))
+      {
+        parent = comb.addOp(type, parent);
+      }
+      m_left->compile(comb, parent);
+      m_right->compile(comb, parent);
+    }
 }; /* SquelchCombine::BinaryOpNode */
 
 
@@ -354,9 +365,9 @@ struct SquelchCombine::OrOpNode : public SquelchCombine::BinaryOpNode
 {
   OrOpNode(Node* l, Node* r) : BinaryOpNode("OR", l, r) {}
 
-  virtual bool isOpen(void) const
+  virtual void compile(SquelchCombine& comb, int parent)
   {
-    return m_left->isOpen() || m_right->isOpen();
+    compileOp(comb, OP_OR, parent);
   }
 }; /* SquelchCombine::OrOpNode */
 
@@ -365,9 +376,9 @@ struct SquelchCombine::AndOpNode : public SquelchCombine::BinaryOpNode
 {
   AndOpNode(Node* l, Node* r) : BinaryOpNode("AND", l, r) {}
 
-  virtual bool isOpen(void) const
+  virtual void compile(SquelchCombine& comb, int parent)
   {
-    return m_left->isOpen() && m_right->isOpen();
+    compileOp(comb, OP_AND, parent);
   }
 }; /* SquelchCombine::AndOpNode */
 
@@ -452,10 +463,16 @@ bool SquelchCombine::initialize(Async::Config& cfg,
   m_comb->print(std::cout);
   std::cout << std::endl;
 
-  m_comb->squelchOpen.connect(
-      sigc::mem_fun(*this, &SquelchCombine::onSquelchOpen));
+  m_ops.clear();
+  m_comb->compile(*this, -1);
 
-  return m_comb->initialize(cfg) && Squelch::initialize(cfg, rx_name);
+  if (!m_comb->initialize(cfg) || !Squelch::initialize(cfg, rx_name))
+  {
+    return false;
+  }
+  evaluate();
+
+  return true;
 } /* SquelchCombine::initialize */
 
 
@@ -499,6 +516,7 @@ void SquelchCombine::reset(void)
 {
   m_comb->reset();
   m_is_open = false;
+  evaluate();
 } /* SquelchCombine::reset */
 
 
@@ -685,6 +703,81 @@ SquelchCombine::Node* SquelchCombine::parseExpression(void)
 } /* SquelchCombine::parseExpresseion */
 
 
+int SquelchCombine::addOp(OpType type, int parent, const LeafNode* leaf)
+{
+  Op op;
+  op.type = type;
+  op.parent = parent;
+  op.leaf = leaf;
+  m_ops.push_back(op);
+  if (parent >= 0)
+  {
+    m_ops[parent].inputs += 1;
+  }
+  return m_ops.size() - 1;
+} /* SquelchCombine::addOp */
+
+
+void SquelchCombine::evaluate(void)
+{
+  if (m_ops.empty())
+  {
+    return;
+  }
+
+    // Operations are stored in preorder so all inputs of an operation have
+    // higher indices than the operation itself. Walking the table backwards
+    // will thus evaluate every operation after all of its inputs.
+  for (Ops::iterator it = m_ops.begin(); it != m_ops.end(); ++it)
+  {
+    it->true_cnt = 0;
+  }
+  for (Ops::reverse_iterator it = m_ops.rbegin(); it != m_ops.rend(); ++it)
+  {
+    it->value = (it->type == OP_LEAF) ? it->leaf->isOpen() : opValue(*it);
+    if (it->value && (it->parent >= 0))
+    {
+      m_ops[it->parent].true_cnt += 1;
+    }
+  }
+  onSquelchOpen(m_ops.front().value);
+} /* SquelchCombine::evaluate */
+
+
+void SquelchCombine::onLeafOpen(bool is_open, int idx)
+{
+  if (m_ops[idx].value == is_open)
+  {
+    return;
+  }
+  m_ops[idx].value = is_open;
+
+    // Propagate the change towards the root, stopping as soon as an
+    // operation does not change its value
+  for (int parent = m_ops[idx].parent; parent >= 0;
+       parent = m_ops[parent].parent)
+  {
+    Op& op = m_ops[parent];
+    if (is_open)
+    {
+      op.true_cnt += 1;
+    }
+    else
+    {
+      op.true_cnt -= 1;
+    }
+    bool value = opValue(op);
+    if (value == op.value)
+    {
+      return;
+    }
+    op.value = is_open = value;
+  }
+
+  onSquelchOpen(m_ops.front().value);
+} /* SquelchCombine::onLeafOpen */
+
+
 void SquelchCombine::onSquelchOpen(bool is_open)
 {
   if (m_is_open != is_open)
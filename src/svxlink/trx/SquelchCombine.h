@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include <string>
 #include <deque>
+#include <vector>
 
 
 /****************************************************************************
@@ -253,8 +254,28 @@ class SquelchCombine : public Squelch
     struct OrOpNode;
     struct AndOpNode;
 
+      // The expression tree is compiled into a flat table of operations
+      // where each operation keeps track of how many of its inputs are true.
+      // A change in a child squelch is then propagated upwards only as far
+      // as it actually changes the value of an operation.
+    typedef enum
+    {
+      OP_LEAF, OP_NOT, OP_AND, OP_OR
+    } OpType;
+    struct Op
+    {
+      OpType          type      = OP_LEAF;
+      int             parent    = -1;
+      unsigned        inputs    = 0;
+      unsigned        true_cnt  = 0;
+      bool            value     = false;
+      const LeafNode* leaf      = nullptr;
+    };
+    typedef std::vector<Op> Ops;
+
     Tokens  m_tokens;
     Node*   m_comb    = nullptr;
+    Ops     m_ops;
     bool    m_is_open = false;
 
     bool tokenize(const std::string& expr);
@@ -263,8 +284,22 @@ class SquelchCombine : public Squelch
     Node* parseAndExpression(void);
     Node* parseOrExpression(void);
     Node* parseExpression(void);
+    int addOp(OpType type, int parent, const LeafNode* leaf=nullptr);
+    void evaluate(void);
+    void onLeafOpen(bool is_open, int idx);
     void onSquelchOpen(bool is_open);
 
+    static bool opValue(const Op& op)
+    {
+      switch (op.type)
+      {
+        case OP_NOT:  return op.true_cnt == 0;
+        case OP_AND:  return op.true_cnt == op.inputs;
+        case OP_OR:   return op.true_cnt > 0;
+        default:      return op.value;
+      }
+    }
+
 };  /* class SquelchCombine */
 
 
@@ -59,6 +59,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "ToneDetector.h"
+#include "ToneDetectorBank.h"
+#include "CtcssSlidingDft.h"
 #include "Squelch.h"
 
 
@@ -129,14 +131,15 @@ class SquelchCtcss : public Squelch
      * @brief 	Default constuctor
      */
     explicit SquelchCtcss(void)
-      : m_splitter(0), m_active_det(0), m_ctcss_snr_offset(0.0f) {}
+      : m_sink(0), m_active_det(0), m_ctcss_snr_offset(0.0f), m_sdft(0),
+        m_sdft_tone_cnt(0), m_active_tone(-1) {}
 
     /**
      * @brief 	Destructor
      */
     virtual ~SquelchCtcss(void)
     {
-      delete m_splitter;
+      delete m_sink;
     }
 
     /**
@@ -210,7 +213,19 @@ class SquelchCtcss : public Squelch
 	return false;
       }
 
-      m_splitter = new Async::AudioSplitter;
+      if (ctcss_mode == 4)
+      {
+        //std::cout << "### CTCSS mode: Sliding DFT\n";
+        initSlidingDft(cfg, rx_name, ctcss_fqs, open_thresh, close_thresh,
+                       bpf_low, bpf_high);
+        return Squelch::initialize(cfg, rx_name);
+      }
+
+        // All tone detectors are run by one detector bank, fed through one
+        // shared CTCSS band pass filter in the modes that use it
+      ToneDetectorBank *det_bank = new ToneDetectorBank;
+      m_sink = det_bank;
+      bool use_bpf = false;
 
       for (FqList::const_iterator it = ctcss_fqs.begin();
            it != ctcss_fqs.end(); ++it)
@@ -232,12 +247,8 @@ class SquelchCtcss : public Squelch
         {
           det->snrUpdated.connect(snrUpdated.make_slot());
         }
-        Async::AudioSink *sink = det;
-
         m_dets.push_back(det);
-
-        std::stringstream filter_spec;
-        filter_spec << "BpBu8/" << bpf_low << "-" << bpf_high;
+        det_bank->addDetector(det, true);
 
         switch (ctcss_mode)
         {
@@ -268,11 +279,7 @@ class SquelchCtcss : public Squelch
             det->setUndetectStableCountThresh(2);
             //det->setUndetectPhaseBwThresh(4.0f, 16.0f);
 
-              // Set up CTCSS band pass filter
-            Async::AudioFilter *filter =
-              new Async::AudioFilter(filter_spec.str());
-            filter->registerSink(det, true);
-            sink = filter;
+            use_bpf = true;
             break;
           }
 
@@ -294,16 +301,21 @@ class SquelchCtcss : public Squelch
             det->setUndetectSnrThresh(close_thresh, bpf_high - bpf_low);
             det->setUndetectStableCountThresh(2);
 
-              // Set up CTCSS band pass filter
-            Async::AudioFilter *filter =
-              new Async::AudioFilter(filter_spec.str());
-            filter->registerSink(det, true);
-            sink = filter;
+            use_bpf = true;
             break;
           }
         }
+      }
 
-        m_splitter->addSink(sink, true);
+      if (use_bpf)
+      {
+          // Set up CTCSS band pass filter
+        std::stringstream filter_spec;
+        filter_spec << "BpBu8/" << bpf_low << "-" << bpf_high;
+        Async::AudioFilter *filter =
+          new Async::AudioFilter(filter_spec.str());
+        filter->registerSink(det_bank, true);
+        m_sink = filter;
       }
 
       bool debug = false;
@@ -331,6 +343,11 @@ class SquelchCtcss : public Squelch
         (*it)->reset();
       }
       m_active_det = 0;
+      if (m_sdft != 0)
+      {
+        m_sdft->reset();
+      }
+      m_active_tone = -1;
       Squelch::reset();
     }
 
@@ -344,6 +361,10 @@ class SquelchCtcss : public Squelch
       {
         (*it)->setDetectDelay(delay);
       }
+      if (m_sdft != 0)
+      {
+        m_sdft->setDetectDelay(delay);
+      }
     }
 
     /**
@@ -352,10 +373,20 @@ class SquelchCtcss : public Squelch
      *
      * This signal will be emitted as soon as a new SNR value for the CTCSS
      * tone has been calculated. The signal will only be emitted when
-     * CTCSS_MODE is set to 2 or 3.
+     * CTCSS_MODE is set to 2, 3 or 4.
      */
     sigc::signal<void, float> snrUpdated;
 
+    /**
+     * @brief  A signal that is emitted when the strongest received tone change
+     * @param  fq The tone frequency or 0 if no tone is received
+     *
+     * This signal will only be emitted when CTCSS_MODE is set to 4. With
+     * CTCSS_SCAN_TONES enabled, all EIA tones are considered and not just
+     * the configured ones.
+     */
+    sigc::signal<void, float> toneDetected;
+
   protected:
     /**
      * @brief 	Process the incoming samples in the squelch detector
@@ -365,7 +396,7 @@ class SquelchCtcss : public Squelch
      */
     int processSamples(const float *samples, int count)
     {
-      return m_splitter->writeSamples(samples, count);
+      return m_sink->writeSamples(samples, count);
     }
 
     /**
@@ -378,15 +409,22 @@ class SquelchCtcss : public Squelch
       {
         (*it)->setUndetectDelay(hang);
       }
+      if (m_sdft != 0)
+      {
+        m_sdft->setUndetectDelay(hang);
+      }
     }
 
   private:
     typedef std::vector<ToneDetector*> DetList;
 
     DetList                 m_dets;
-    Async::AudioSplitter *  m_splitter;
+    Async::AudioSink *      m_sink;
     ToneDetector *          m_active_det;
     float                   m_ctcss_snr_offset;
+    CtcssSlidingDft *       m_sdft;
+    int                     m_sdft_tone_cnt;
+    int                     m_active_tone;
 
     SquelchCtcss(const SquelchCtcss&);
     SquelchCtcss& operator=(const SquelchCtcss&);
@@ -411,6 +449,98 @@ class SquelchCtcss : public Squelch
       }
     }
 
+    void initSlidingDft(Async::Config& cfg, const std::string& rx_name,
+                        const std::vector<float>& ctcss_fqs,
+                        float open_thresh, float close_thresh,
+                        unsigned bpf_low, unsigned bpf_high)
+    {
+      m_sdft = new CtcssSlidingDft(8.0f, bpf_high - bpf_low);
+      m_sdft->setThresholds(open_thresh, close_thresh);
+      for (std::vector<float>::const_iterator it = ctcss_fqs.begin();
+           it != ctcss_fqs.end(); ++it)
+      {
+        m_sdft->addTone(*it);
+      }
+      m_sdft_tone_cnt = m_sdft->toneCount();
+
+        // Optionally evaluate all EIA tones too. Apart from making it
+        // possible to report which tone is received, the configured tones
+        // must then also be stronger than their EIA neighbours.
+      bool scan = false;
+      cfg.getValue(rx_name, "CTCSS_SCAN_TONES", scan);
+      if (scan)
+      {
+        m_sdft->addEiaTones();
+        m_sdft->strongestToneChanged.connect(
+            sigc::mem_fun(*this, &SquelchCtcss::printStrongestTone));
+      }
+
+      m_sdft->activated.connect(
+          sigc::mem_fun(*this, &SquelchCtcss::checkToneActivated));
+      m_sdft->snrUpdated.connect(snrUpdated.make_slot());
+      m_sdft->strongestToneChanged.connect(toneDetected.make_slot());
+
+      bool debug = false;
+      cfg.getValue(rx_name, "CTCSS_DEBUG", debug);
+      if (debug)
+      {
+        m_sdft->snrUpdated.connect(
+            sigc::mem_fun(*this, &SquelchCtcss::printSlidingDftSnr));
+      }
+
+      std::stringstream filter_spec;
+      filter_spec << "BpBu8/" << bpf_low << "-" << bpf_high;
+      Async::AudioFilter *filter = new Async::AudioFilter(filter_spec.str());
+      filter->registerSink(m_sdft, true);
+      m_sink = filter;
+    }
+
+    void checkToneActivated(int idx, bool is_active)
+    {
+      if (idx >= m_sdft_tone_cnt)
+      {
+        return;
+      }
+      if (is_active)
+      {
+        if (m_active_tone < 0)
+        {
+          m_active_tone = idx;
+          setSignalDetected(true);
+        }
+      }
+      else
+      {
+        if (m_active_tone == idx)
+        {
+          m_active_tone = -1;
+          setSignalDetected(false);
+        }
+      }
+    }
+
+    void printStrongestTone(float fq)
+    {
+      if (fq > 0.0f)
+      {
+        std::cout << rxName() << ": CTCSS tone " << std::fixed
+                  << std::setprecision(1) << fq << "Hz received\n";
+      }
+    }
+
+    void printSlidingDftSnr(float level)
+    {
+      std::ostringstream os;
+      os << rxName() << ": ";
+      for (int i=0; i<m_sdft_tone_cnt; ++i)
+      {
+        float snr = m_sdft->lastSnr(i) - m_ctcss_snr_offset;
+        os << std::setw(4) << static_cast<int>(roundf(snr))
+          << ":" << std::fixed << std::setprecision(1) << m_sdft->toneFq(i);
+      }
+      std::cout << os.str() << std::endl;
+    }
+
     void printSnr(float level)
     {
       std::ostringstream os;
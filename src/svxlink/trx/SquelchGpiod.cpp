@@ -0,0 +1,275 @@
+/**
+@file   SquelchGpiod.cpp
+@brief  A squelch detector that read squelch state from a GPIO character device
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a squelch detector that use the Linux GPIO character device
+to get an event each time the squelch GPIO line change state.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncFdWatch.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "SquelchGpiod.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+SquelchGpiod::SquelchGpiod(void)
+  : fd(-1), watch(0)
+{
+} /* SquelchGpiod::SquelchGpiod */
+
+
+SquelchGpiod::~SquelchGpiod(void)
+{
+  delete watch;
+  watch = 0;
+  if (fd >= 0)
+  {
+    close(fd);
+    fd = -1;
+  }
+} /* SquelchGpiod::~SquelchGpiod */
+
+
+bool SquelchGpiod::initialize(Async::Config& cfg, const std::string& rx_name)
+{
+  if (!Squelch::initialize(cfg, rx_name))
+  {
+    return false;
+  }
+
+  string chip = "gpiochip0";
+  cfg.getValue(rx_name, "SQL_GPIOD_CHIP", chip);
+  if (chip.find('/') == string::npos)
+  {
+    chip = "/dev/" + chip;
+  }
+
+  string line;
+  if (!cfg.getValue(rx_name, "SQL_GPIOD_LINE", line) || line.empty())
+  {
+    cerr << "*** ERROR: Config variable " << rx_name
+         << "/SQL_GPIOD_LINE not set or invalid\n";
+    return false;
+  }
+  bool active_low = false;
+  if ((line.size() > 1) && (line[0] == '!'))
+  {
+    active_low = true;
+    line.erase(0, 1);
+  }
+  char *endptr = 0;
+  unsigned long offset = strtoul(line.c_str(), &endptr, 10);
+  if ((endptr == line.c_str()) || (*endptr != '\0'))
+  {
+    cerr << "*** ERROR: Invalid line number in " << rx_name
+         << "/SQL_GPIOD_LINE=" << line << endl;
+    return false;
+  }
+
+  int chip_fd = open(chip.c_str(), O_RDONLY | O_CLOEXEC);
+  if (chip_fd < 0)
+  {
+    cerr << "*** ERROR: Could not open GPIO chip " << chip
+         << " specified in " << rx_name << "/SQL_GPIOD_CHIP: "
+         << strerror(errno) << endl;
+    return false;
+  }
+
+    // Request events for both edges. Active low is handled by the kernel so
+    // the line value read below is the logical squelch state.
+  struct gpioevent_request req;
+  memset(&req, 0, sizeof(req));
+  req.lineoffset = offset;
+  req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+  if (active_low)
+  {
+    req.handleflags |= GPIOHANDLE_REQUEST_ACTIVE_LOW;
+  }
+  req.eventflags = GPIOEVENT_REQUEST_BOTH_EDGES;
+  strncpy(req.consumer_label, "svxlink-sql", sizeof(req.consumer_label) - 1);
+  int ret = ioctl(chip_fd, GPIO_GET_LINEEVENT_IOCTL, &req);
+  int err = errno;
+  close(chip_fd);
+  if (ret < 0)
+  {
+    cerr << "*** ERROR: Could not request events for GPIO line " << offset
+         << " on " << chip << " in receiver " << rx_name << ": "
+         << strerror(err) << endl;
+    return false;
+  }
+  fd = req.fd;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  watch = new FdWatch(fd, FdWatch::FD_WATCH_RD);
+  watch->activity.connect(mem_fun(*this, &SquelchGpiod::lineEvent));
+
+  return readLineValue();
+} /* SquelchGpiod::initialize */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+/**
+ * @brief  Called when the kernel has reported one or more edges on the line
+ *
+ * All queued events are read and discarded. The current line value is then
+ * read to get the squelch state so that quick toggles that have already
+ * settled do not cause extra squelch transitions.
+ */
+void SquelchGpiod::lineEvent(FdWatch *w)
+{
+  struct gpioevent_data ev;
+  ssize_t cnt;
+  while ((cnt = read(fd, &ev, sizeof(ev))) == sizeof(ev))
+  {
+  }
+  if ((cnt < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK))
+  {
+    cerr << "*** WARNING: SquelchGpiod::lineEvent: read failed: "
+         << strerror(errno) << endl;
+  }
+  readLineValue();
+} /* SquelchGpiod::lineEvent */
+
+
+bool SquelchGpiod::readLineValue(void)
+{
+  struct gpiohandle_data data;
+  memset(&data, 0, sizeof(data));
+  if (ioctl(fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0)
+  {
+    cerr << "*** WARNING: SquelchGpiod::readLineValue: ioctl failed: "
+         << strerror(errno) << endl;
+    return false;
+  }
+
+  bool is_active = (data.values[0] != 0);
+  if (signalDetected() != is_active)
+  {
+    setSignalDetected(is_active);
+  }
+  return true;
+} /* SquelchGpiod::readLineValue */
+
+
+/*
+ * This file has not been truncated
+ */
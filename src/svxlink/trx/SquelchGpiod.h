@@ -0,0 +1,151 @@
+/**
+@file   SquelchGpiod.h
+@brief  A squelch detector that read squelch state from a GPIO character device
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a squelch detector that use the Linux GPIO character device
+to get an event each time the squelch GPIO line change state.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef SQUELCH_GPIOD_INCLUDED
+#define SQUELCH_GPIOD_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <string>
+#include <sigc++/sigc++.h>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "Squelch.h"
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class FdWatch;
+};
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	A squelch detector that read squelch state from a GPIO character device
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This squelch detector read the squelch indicator signal from a GPIO input line
+using the Linux GPIO character device (/dev/gpiochipN). The kernel report each
+edge on the line through a file descriptor which is watched by the main loop,
+so squelch changes are handled immediately without polling. A high level
+(3.3V) will be interpreted as squelch open and a low level (GND) will be
+interpreted as squelch close, unless the line is configured as active low.
+*/
+class SquelchGpiod : public Squelch
+{
+  public:
+      /// The name of this class when used by the object factory
+    static constexpr const char* OBJNAME = "GPIOD";
+
+    /**
+     * @brief 	Default constuctor
+     */
+    SquelchGpiod(void);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~SquelchGpiod(void);
+
+    /**
+     * @brief 	Initialize the squelch detector
+     * @param 	cfg A previsously initialized config object
+     * @param 	rx_name The name of the RX (config section name)
+     * @return	Returns \em true on success or else \em false
+     */
+    bool initialize(Async::Config& cfg, const std::string& rx_name);
+
+  protected:
+
+  private:
+    int             fd;
+    Async::FdWatch  *watch;
+
+    SquelchGpiod(const SquelchGpiod&);
+    SquelchGpiod& operator=(const SquelchGpiod&);
+    void lineEvent(Async::FdWatch *w);
+    bool readLineValue(void);
+
+};  /* class SquelchGpiod */
+
+
+#endif /* SQUELCH_GPIOD_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -33,12 +33,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
-#include <cstring>
-#include <cerrno>
-#include <unistd.h>
-#include <fcntl.h>
-#include <linux/hidraw.h>
-#include <sys/ioctl.h>
+#include <iostream>
+#include <map>
 
 
 /****************************************************************************
@@ -47,7 +43,6 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
-#include <AsyncFdWatch.h>
 
 
 /****************************************************************************
@@ -57,6 +52,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "SquelchHidraw.h"
+#include "HidrawDevice.h"
 
 
 
@@ -119,30 +115,21 @@ using namespace Async;
  ****************************************************************************/
 
 SquelchHidraw::SquelchHidraw(void)
-  : fd(-1), watch(0), active_low(false), pin(0)
+  : dev(0), active_low(false), pin(0)
 {
 } /* SquelchHidraw::SquelchHidraw */
 
 
 SquelchHidraw::~SquelchHidraw(void)
 {
-  delete watch;
-  if (fd >= 0)
+  if (dev != 0)
   {
-    close(fd);
-    fd = -1;
+    dev->destroy();
+    dev = 0;
   }
 } /* SquelchHidraw::~SquelchHidraw */
 
 
-/**
-Initializing the sound card as linux/hidraw device
-For further information:
-  http://dmkeng.com
-  http://www.halicky.sk/om3cph/sb/CM108_DataSheet_v1.6.pdf
-  http://www.ti.com/lit/ml/sllu093/sllu093.pdf
-  http://www.ti.com/tool/usb-to-gpio
-*/
 bool SquelchHidraw::initialize(Async::Config& cfg, const std::string& rx_name)
 {
   if (!Squelch::initialize(cfg, rx_name))
@@ -187,50 +174,13 @@ bool SquelchHidraw::initialize(Async::Config& cfg, const std::string& rx_name)
   }
   pin = (*it).second;
 
-  if ((fd = open(devicename.c_str(), O_RDWR, 0)) < 0)
-  {
-    cout << "*** ERROR: Could not open event device " << devicename
-         << " specified in " << rx_name << "/HID_DEVICE: "
-         << strerror(errno) << endl;
-    return false;
-  }
-
-  struct hidraw_devinfo hiddevinfo;
-  if ((ioctl(fd, HIDIOCGRAWINFO, &hiddevinfo) != -1) &&
-      (hiddevinfo.vendor == 0x0d8c))
+  dev = HidrawDevice::instance(devicename);
+  if (dev == 0)
   {
-    cout << "--- Hidraw sound chip is ";
-    if (hiddevinfo.product == 0x000c)
-    {
-      cout << "CM108";
-    }
-    else if (hiddevinfo.product == 0x013c)
-    {
-      cout << "CM108A";
-    }
-    else if (hiddevinfo.product == 0x000e)
-    {
-      cout << "CM109";
-    }
-    else if (hiddevinfo.product == 0x013a)
-    {
-      cout << "CM119";
-    }
-    else
-    {
-      cout << "unknown";
-    }
-    cout << endl;
-  }
-  else
-  {
-    cout << "*** ERROR: unknown/unsupported sound chip detected...\n";
     return false;
   }
-
-  watch = new Async::FdWatch(fd, Async::FdWatch::FD_WATCH_RD);
-  assert(watch != 0);
-  watch->activity.connect(mem_fun(*this, &SquelchHidraw::hidrawActivity));
+  dev->inputChanged.connect(
+      mem_fun(*this, &SquelchHidraw::hidrawInputChanged));
 
   return true;
 }
@@ -255,19 +205,11 @@ bool SquelchHidraw::initialize(Async::Config& cfg, const std::string& rx_name)
  * @brief  Called when state of Hidraw port has been changed
  *
  */
-void SquelchHidraw::hidrawActivity(FdWatch *watch)
+void SquelchHidraw::hidrawInputChanged(char state)
 {
-  char buf[5];
-  int rd = read(fd, buf, sizeof(buf));
-  if (rd < 0)
-  {
-    cerr << "*** ERROR: reading HID_DEVICE\n";
-    return;
-  }
-
-  bool pin_high = buf[0] & pin;
+  bool pin_high = state & pin;
   setSignalDetected(pin_high != active_low);
-} /* SquelchHidraw::hidrawActivity */
+} /* SquelchHidraw::hidrawInputChanged */
 
 
 
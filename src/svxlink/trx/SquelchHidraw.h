@@ -66,6 +66,8 @@ namespace Async
   class Timer;
 };
 
+class HidrawDevice;
+
 
 /****************************************************************************
  *
@@ -143,14 +145,13 @@ class SquelchHidraw : public Squelch
   protected:
 
   private:
-    int             fd;
-    Async::FdWatch  *watch;
+    HidrawDevice*   dev;
     bool            active_low;
     char            pin;
 
     SquelchHidraw(const SquelchHidraw&);
     SquelchHidraw& operator=(const SquelchHidraw&);
-    void hidrawActivity(Async::FdWatch *watch);
+    void hidrawInputChanged(char state);
 
 };  /* class SquelchGpio */
 
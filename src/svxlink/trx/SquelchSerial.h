@@ -235,6 +235,20 @@ class SquelchSerial : public Squelch
         return false;
       }
 
+        // Let the serial port tell us when the pin change state instead of
+        // reading it for every audio block
+      if (serial->enablePinEvents(true))
+      {
+        serial->pinChanged.connect(
+            sigc::mem_fun(*this, &SquelchSerial::onPinChanged));
+      }
+      else
+      {
+        std::cerr << "*** WARNING: Could not enable pin events for serial "
+                     "port " << serial_port << " in squelch detector for "
+                  << rx_name << ". Polling the pin instead.\n";
+      }
+
       return true;
     }
 
@@ -247,6 +261,8 @@ class SquelchSerial : public Squelch
      */
     int processSamples(const float *samples, int count)
     {
+        // With pin events enabled getPin just return the last reported
+        // state, which also restore the state after a squelch reset
       bool is_set = false;
       if (!serial->getPin(sql_pin, is_set))
       {
@@ -265,6 +281,14 @@ class SquelchSerial : public Squelch
     SquelchSerial(const SquelchSerial&);
     SquelchSerial& operator=(const SquelchSerial&);
 
+    void onPinChanged(Async::Serial::Pin pin, bool is_set)
+    {
+      if (pin == sql_pin)
+      {
+        setSignalDetected(is_set == sql_pin_act_lvl);
+      }
+    }
+
     bool setPins(const Async::Config &cfg, const std::string &rx_name)
     {
       std::string pins;
@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <cstdlib>
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 
 
 /****************************************************************************
@@ -44,6 +45,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
+#include <AsyncAudioSampleOps.h>
 
 
 /****************************************************************************
@@ -116,15 +119,16 @@ using namespace Async;
 
 
 SquelchVox::SquelchVox(void)
-  : buf(0), buf_size(0), head(0), sum(0), up_thresh(0), down_thresh(0)
+  : blk_energy(0), blk_cnt(0), blk_len(1), head(0), partial(0), partial_cnt(0),
+    sum(0), up_thresh(0), down_thresh(0)
 {
 } /* SquelchVox::SquelchVox */
 
 
 SquelchVox::~SquelchVox(void)
 {
-  delete [] buf;
-  buf = 0;
+  delete [] blk_energy;
+  blk_energy = 0;
 } /* SquelchVox::~SquelchVox */
 
 
@@ -142,12 +146,12 @@ bool SquelchVox::initialize(Config& cfg, const string& rx_name)
       	 << "/VOX_FILTER_DEPTH not set\n";
     return false;
   }
-  buf_size = INTERNAL_SAMPLE_RATE * atoi(value.c_str()) / 1000;
-  buf = new float[buf_size];
-  for (int i=0; i<buf_size; ++i)
-  {
-    buf[i] = 0;
-  }
+    // The energy is summed up in blocks of one millisecond and the window
+    // is moved one whole block at a time
+  blk_len = max(1, static_cast<int>(INTERNAL_SAMPLE_RATE / 1000));
+  blk_cnt = max(1, atoi(value.c_str()));
+  blk_energy = new double[blk_cnt];
+  fill_n(blk_energy, blk_cnt, 0.0);
 
   short vox_thresh = 0;
   if (!cfg.getValue(rx_name, "VOX_THRESH", vox_thresh))
@@ -180,19 +184,18 @@ bool SquelchVox::initialize(Config& cfg, const string& rx_name)
 
 void SquelchVox::setVoxThreshold(short thresh)
 {
-  up_thresh = pow(thresh / 10000.0, 2) * buf_size;
-  down_thresh = pow(thresh / 10000.0, 2) * buf_size;
+  up_thresh = pow(thresh / 10000.0, 2) * blk_cnt * blk_len;
+  down_thresh = pow(thresh / 10000.0, 2) * blk_cnt * blk_len;
 } /* SquelchVox::setVoxThreshold */
 
 
 void SquelchVox::reset(void)
 {
-  for (int i=0; i<buf_size; ++i)
-  {
-    buf[i] = 0;
-  }
+  fill_n(blk_energy, blk_cnt, 0.0);
   sum = 0;
   head = 0;
+  partial = 0;
+  partial_cnt = 0;
   Squelch::reset();
 } /* SquelchVox::reset */
 
@@ -206,18 +209,39 @@ void SquelchVox::reset(void)
 
 int SquelchVox::processSamples(const float *samples, int count)
 {
-  int start_pos = 0;
-  if (buf_size < count)
+  bool blk_done = false;
+  int pos = 0;
+  while (pos < count)
   {
-    start_pos = count - buf_size;
+    const int len = min(blk_len - partial_cnt, count - pos);
+    partial += AudioSampleOps::energy(samples + pos, len);
+    partial_cnt += len;
+    pos += len;
+    if (partial_cnt == blk_len)
+    {
+      sum += partial - blk_energy[head];
+      blk_energy[head] = partial;
+      partial = 0;
+      partial_cnt = 0;
+      blk_done = true;
+      if (++head >= blk_cnt)
+      {
+          // Recalculate the sum once per window so that rounding errors do
+          // not accumulate
+        head = 0;
+        sum = 0;
+        for (int i=0; i<blk_cnt; ++i)
+        {
+          sum += blk_energy[i];
+        }
+      }
+    }
   }
 
-  for (int i=start_pos; i<count; ++i)
+    // The squelch state can only change when the window has moved
+  if (!blk_done)
   {
-    sum -= buf[head];
-    buf[head] = samples[i] * samples[i];
-    sum += buf[head];
-    head = (head >= buf_size-1) ? 0 : head + 1;
+    return count;
   }
 
   if (signalDetected())
@@ -107,6 +107,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 @brief	Implements an audio level triggered squelch
 @author Tobias Blomberg
 @date   2004-02-15
+
+The squelch open when the energy of the audio over the last VOX_FILTER_DEPTH
+milliseconds exceed the threshold. The energy is calculated in blocks of one
+millisecond and the squelch state is only evaluated when a block is complete.
 */
 class SquelchVox : public Squelch
 {
@@ -150,9 +154,12 @@ class SquelchVox : public Squelch
     int processSamples(const float *samples, int count);
 
   private:
-    float   *buf;
-    int     buf_size;
+    double  *blk_energy;
+    int     blk_cnt;
+    int     blk_len;
     int     head;
+    double  partial;
+    int     partial_cnt;
     double  sum;
     double  up_thresh;
     double  down_thresh;
@@ -34,6 +34,17 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <iomanip>
 #include <cmath>
 #include <cstring>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SVX_SW_DTMF_X86
+#include <xmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SVX_SW_DTMF_NEON
+#include <arm_neon.h>
+#endif
 
 
 /****************************************************************************
@@ -43,6 +54,9 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <AsyncSigCAudioSink.h>
+#include <AsyncAudioSampleOps.h>
+#include <AsyncAudioSampleRate.h>
+#include <AsyncAudioCpuFeatures.h>
 
 
 /****************************************************************************
@@ -71,6 +85,13 @@ using namespace Async;
  *
  ****************************************************************************/
 
+  /*
+   * Step eight Goertzel filters, one per lane, over a block of samples. All
+   * lanes are fed the same samples.
+   */
+typedef void (*Goertzel8Func)(float *q0, float *q1, const float *coeff,
+                              const float *samples, int len);
+
 
 
 /****************************************************************************
@@ -87,6 +108,20 @@ using namespace Async;
  *
  ****************************************************************************/
 
+static void goertzel8_scalar(float *q0, float *q1, const float *coeff,
+                             const float *samples, int len);
+#ifdef SVX_SW_DTMF_X86
+static void goertzel8_sse(float *q0, float *q1, const float *coeff,
+                          const float *samples, int len)
+  __attribute__((target("sse")));
+#endif
+#ifdef SVX_SW_DTMF_NEON
+static void goertzel8_neon(float *q0, float *q1, const float *coeff,
+                           const float *samples, int len);
+#endif
+static void goertzel8_select(float *q0, float *q1, const float *coeff,
+                             const float *samples, int len);
+static void select_goertzel8(void);
 
 
 /****************************************************************************
@@ -116,6 +151,8 @@ namespace {
   static const float col_fqs[] = { 1209, 1336, 1477, 1633 };
 };
 
+static Goertzel8Func goertzel8 = goertzel8_select;
+
 
 /****************************************************************************
  *
@@ -125,7 +162,9 @@ namespace {
 
 SvxSwDtmfDecoder::SvxSwDtmfDecoder(Config &cfg, const string &name)
   : DtmfDecoder(cfg, name), twist_nrm_thresh(0), twist_rev_thresh(0),
-    row(8), col(8), block_size(0), block_pos(0), det_cnt(0), undet_cnt(0),
+    row(8), col(8), block_size(20 * INTERNAL_SAMPLE_RATE / 1000),
+    step_size(10 * INTERNAL_SAMPLE_RATE / 1000),
+    energy_thresh(1e-6 * block_size), block_pos(0), det_cnt(0), undet_cnt(0),
     last_digit_active(0), min_det_cnt(DEFAULT_MIN_DET_CNT),
     min_undet_cnt(DEFAULT_MIN_UNDET_CNT), det_state(STATE_IDLE),
     det_cnt_weight(0), duration(0), undet_thresh(0), debug(false),
@@ -148,18 +187,28 @@ SvxSwDtmfDecoder::SvxSwDtmfDecoder(Config &cfg, const string &name)
     col[i+4].initialize(3.0f * col_fqs[i]); // Third overtone
   }
 
+    // Goertzel coefficients for the vectorized row and column detectors,
+    // calculated in the same way as in the Goertzel class
+  for (size_t i=0; i<4; ++i)
+  {
+    float w = 2.0f * M_PI * (row_fqs[i] / (float)INTERNAL_SAMPLE_RATE);
+    goertzel_coeff[i] = 2.0f * cosf(w);
+    w = 2.0f * M_PI * (col_fqs[i] / (float)INTERNAL_SAMPLE_RATE);
+    goertzel_coeff[i+4] = 2.0f * cosf(w);
+  }
+
     // Initialize window function
-  for (size_t n=0; n<BLOCK_SIZE; ++n)
+  for (size_t n=0; n<block_size; ++n)
   {
       // Hamming window
-    win[n] = 0.53836 - 0.46164 * cosf(2.0f * M_PI * n / (BLOCK_SIZE - 1));
+    win[n] = 0.53836 - 0.46164 * cosf(2.0f * M_PI * n / (block_size - 1));
       // Hann window
-    //win[n] = 0.5 - 0.5 * cosf(2.0f * M_PI * n / (BLOCK_SIZE - 1));
+    //win[n] = 0.5 - 0.5 * cosf(2.0f * M_PI * n / (block_size - 1));
       // Rectangular window
     //win[n] = 1.0f;
     win_pwr_comp += win[n] * win[n];
   }
-  win_pwr_comp /= BLOCK_SIZE;
+  win_pwr_comp /= block_size;
   win_pwr_comp = 1.0f / win_pwr_comp;
 } /* SvxSwDtmfDecoder::SvxSwDtmfDecoder */
 
@@ -191,8 +240,8 @@ bool SvxSwDtmfDecoder::initialize(void)
 
   if (hangtime() > 0)
   {
-    const size_t block_size_ms = 1000 * BLOCK_SIZE / INTERNAL_SAMPLE_RATE;
-    const size_t step_size_ms = 1000 * STEP_SIZE / INTERNAL_SAMPLE_RATE;
+    const size_t block_size_ms = 1000 * block_size / INTERNAL_SAMPLE_RATE;
+    const size_t step_size_ms = 1000 * step_size / INTERNAL_SAMPLE_RATE;
     min_undet_cnt = 1;
     if (hangtime() > block_size_ms)
     {
@@ -209,18 +258,22 @@ bool SvxSwDtmfDecoder::initialize(void)
 
 int SvxSwDtmfDecoder::writeSamples(const float *buf, int len)
 {
-  for (int i = 0; i < len; i++)
+  int pos = 0;
+  while (pos < len)
   {
-    block[block_pos] = buf[i];
-    if (++block_pos >= BLOCK_SIZE)
+    size_t cnt = min(block_size - block_pos, static_cast<size_t>(len - pos));
+    memcpy(block + block_pos, buf + pos, cnt * sizeof(*buf));
+    block_pos += cnt;
+    pos += cnt;
+    if (block_pos >= block_size)
     {
       processBlock();
-      if (STEP_SIZE < BLOCK_SIZE)
+      if (step_size < block_size)
       {
-        memmove(block, block + STEP_SIZE,
-                (BLOCK_SIZE - STEP_SIZE) * sizeof(*buf));
+        memmove(block, block + step_size,
+                (block_size - step_size) * sizeof(*buf));
       }
-      block_pos = BLOCK_SIZE - STEP_SIZE;
+      block_pos = block_size - step_size;
     }
   }
 
@@ -243,38 +296,34 @@ int SvxSwDtmfDecoder::writeSamples(const float *buf, int len)
 
 void SvxSwDtmfDecoder::processBlock(void)
 {
-    // Reset all Goertzel objects
-  row[0].reset();
-  row[1].reset();
-  row[2].reset();
-  row[3].reset();
-  col[0].reset();
-  col[1].reset();
-  col[2].reset();
-  col[3].reset();
-
-    // Calculate the total block energy and energy for all individual
-    // Goertzel detectors over the block
-  double block_energy = 0.0;
-  for (size_t i=0; i<BLOCK_SIZE; ++i)
+    // Apply the window function and calculate the total block energy
+  for (size_t i=0; i<block_size; ++i)
   {
-    float sample = block[i] * win[i];
-    block_energy += sample * sample;
-    row[0].calc(sample);
-    row[1].calc(sample);
-    row[2].calc(sample);
-    row[3].calc(sample);
-    col[0].calc(sample);
-    col[1].calc(sample);
-    col[2].calc(sample);
-    col[3].calc(sample);
+    wblock[i] = block[i] * win[i];
+  }
+  double block_energy = AudioSampleOps::energy(wblock, block_size);
+
+    // Calculate the magnitude squared for the four row detectors (0-3) and
+    // the four column detectors (4-7) in one pass. This is only done if the
+    // block energy is high enough for a digit to be possible at all.
+  float ms[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+  if (block_energy > energy_thresh)
+  {
+    float q0[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    float q1[8] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+    goertzel8(q0, q1, goertzel_coeff, wblock, block_size);
+    for (size_t i=0; i<8; ++i)
+    {
+      ms[i] = WIN_ENB * (q0[i] * q0[i] + q1[i] * q1[i]
+                         - q0[i] * q1[i] * goertzel_coeff[i]);
+    }
   }
   ios_base::fmtflags orig_cout_flags(cout.flags());
   if (debug)
   {
     cout << setprecision(2) << fixed;
     cout << "### pwr=" << setw(6) 
-         << 10.0f * log10f(2 * win_pwr_comp * block_energy / BLOCK_SIZE)
+         << 10.0f * log10f(2 * win_pwr_comp * block_energy / block_size)
          << "dB";
   }
 
@@ -294,14 +343,14 @@ void SvxSwDtmfDecoder::processBlock(void)
   size_t max_col_idx = 0;
   float max_row_ms = 0.0f;
   float max_col_ms = 0.0f;
-  if (block_energy > ENERGY_THRESH)
+  if (block_energy > energy_thresh)
   {
     float rel_energy = 0.0f;
     float row_sum = 0.0f;
     float col_sum = 0.0f;
     for (size_t i = 0; i < 4; ++i)
     {
-      const float row_ms = WIN_ENB * row[i].magnitudeSquared();
+      const float row_ms = ms[i];
       if (row_ms > max_row_ms)
       {
         max_row_ms = row_ms;
@@ -309,7 +358,7 @@ void SvxSwDtmfDecoder::processBlock(void)
       }
       row_sum += row_ms;
 
-      const float col_ms = WIN_ENB * col[i].magnitudeSquared();
+      const float col_ms = ms[i+4];
       if (col_ms > max_col_ms)
       {
         max_col_ms = col_ms;
@@ -318,7 +367,7 @@ void SvxSwDtmfDecoder::processBlock(void)
       col_sum += col_ms;
     }
 
-    rel_energy = 2 * (max_row_ms + max_col_ms) / (BLOCK_SIZE * block_energy);
+    rel_energy = 2 * (max_row_ms + max_col_ms) / (block_size * block_energy);
     //cout << " row=" << max_row_idx << " col=" << max_col_idx;
     const float twist = max_row_ms / max_col_ms;
     const float row_group_rel = max_row_ms / row_sum;
@@ -387,9 +436,9 @@ void SvxSwDtmfDecoder::processBlock(void)
                 INTERNAL_SAMPLE_RATE);
     row[max_row_idx+4].reset();
     col[max_col_idx+4].reset();
-    for (size_t i=0; i<BLOCK_SIZE; ++i)
+    for (size_t i=0; i<block_size; ++i)
     {
-      float sample = block[i] * win[i];
+      const float sample = wblock[i];
       im.calc(sample);
       row[max_row_idx+4].calc(sample);
       col[max_col_idx+4].calc(sample);
@@ -433,7 +482,7 @@ void SvxSwDtmfDecoder::processBlock(void)
     complex<double> row_sum = 0;
     complex<double> col_sum = 0;
     size_t samp_cnt = 0;
-    for (size_t i=1; i<BLOCK_SIZE; ++i)
+    for (size_t i=1; i<block_size; ++i)
     {
       max_row.calc(block[i]);
       max_col.calc(block[i]);
@@ -553,8 +602,9 @@ void SvxSwDtmfDecoder::processBlock(void)
       {
         if (++undet_cnt >= undet_thresh)
         {
-          const int first_block_time = 1000 * BLOCK_SIZE / INTERNAL_SAMPLE_RATE;
-          const int block_time = 1000 * STEP_SIZE / INTERNAL_SAMPLE_RATE;
+          const int first_block_time =
+              1000 * block_size / INTERNAL_SAMPLE_RATE;
+          const int block_time = 1000 * step_size / INTERNAL_SAMPLE_RATE;
           const int dur_ms = first_block_time + block_time * (duration - 1);
           if (debug)
           {
@@ -586,6 +636,118 @@ void SvxSwDtmfDecoder::DtmfGoertzel::initialize(float freq)
 } /* SvxSwDtmfDecoder::DtmfGoertzel::initialize */
 
 
+
+/****************************************************************************
+ *
+ * Local functions
+ *
+ ****************************************************************************/
+
+static void goertzel8_scalar(float *q0, float *q1, const float *coeff,
+                             const float *samples, int len)
+{
+  for (int lane=0; lane<8; ++lane)
+  {
+    float s0 = q0[lane];
+    float s1 = q1[lane];
+    const float c = coeff[lane];
+    for (int i=0; i<len; ++i)
+    {
+      float s2 = s1;
+      s1 = s0;
+      s0 = c * s1 - s2 + samples[i];
+    }
+    q0[lane] = s0;
+    q1[lane] = s1;
+  }
+} /* goertzel8_scalar */
+
+
+#ifdef SVX_SW_DTMF_X86
+static void goertzel8_sse(float *q0, float *q1, const float *coeff,
+                          const float *samples, int len)
+{
+  __m128 s0a = _mm_loadu_ps(q0);
+  __m128 s0b = _mm_loadu_ps(q0 + 4);
+  __m128 s1a = _mm_loadu_ps(q1);
+  __m128 s1b = _mm_loadu_ps(q1 + 4);
+  const __m128 ca = _mm_loadu_ps(coeff);
+  const __m128 cb = _mm_loadu_ps(coeff + 4);
+  for (int i=0; i<len; ++i)
+  {
+    const __m128 x = _mm_set1_ps(samples[i]);
+    __m128 s2a = s1a;
+    __m128 s2b = s1b;
+    s1a = s0a;
+    s1b = s0b;
+    s0a = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(ca, s1a), s2a), x);
+    s0b = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(cb, s1b), s2b), x);
+  }
+  _mm_storeu_ps(q0, s0a);
+  _mm_storeu_ps(q0 + 4, s0b);
+  _mm_storeu_ps(q1, s1a);
+  _mm_storeu_ps(q1 + 4, s1b);
+} /* goertzel8_sse */
+#endif
+
+
+#ifdef SVX_SW_DTMF_NEON
+static void goertzel8_neon(float *q0, float *q1, const float *coeff,
+                           const float *samples, int len)
+{
+  float32x4_t s0a = vld1q_f32(q0);
+  float32x4_t s0b = vld1q_f32(q0 + 4);
+  float32x4_t s1a = vld1q_f32(q1);
+  float32x4_t s1b = vld1q_f32(q1 + 4);
+  const float32x4_t ca = vld1q_f32(coeff);
+  const float32x4_t cb = vld1q_f32(coeff + 4);
+  for (int i=0; i<len; ++i)
+  {
+    const float32x4_t x = vdupq_n_f32(samples[i]);
+    float32x4_t s2a = s1a;
+    float32x4_t s2b = s1b;
+    s1a = s0a;
+    s1b = s0b;
+    s0a = vaddq_f32(vsubq_f32(vmulq_f32(ca, s1a), s2a), x);
+    s0b = vaddq_f32(vsubq_f32(vmulq_f32(cb, s1b), s2b), x);
+  }
+  vst1q_f32(q0, s0a);
+  vst1q_f32(q0 + 4, s0b);
+  vst1q_f32(q1, s1a);
+  vst1q_f32(q1 + 4, s1b);
+} /* goertzel8_neon */
+#endif
+
+
+static void goertzel8_select(float *q0, float *q1, const float *coeff,
+                             const float *samples, int len)
+{
+  select_goertzel8();
+  goertzel8(q0, q1, coeff, samples, len);
+} /* goertzel8_select */
+
+
+static void select_goertzel8(void)
+{
+  AudioCpuFeatures::addDispatcher(select_goertzel8);
+#ifdef SVX_SW_DTMF_X86
+  if (AudioCpuFeatures::has(AudioCpuFeatures::SSE))
+  {
+    goertzel8 = goertzel8_sse;
+    return;
+  }
+#endif
+#ifdef SVX_SW_DTMF_NEON
+  if (AudioCpuFeatures::has(AudioCpuFeatures::NEON))
+  {
+    goertzel8 = goertzel8_neon;
+    return;
+  }
+#endif
+  goertzel8 = goertzel8_scalar;
+} /* select_goertzel8 */
+
+
 /*
  * This file has not been truncated
  */
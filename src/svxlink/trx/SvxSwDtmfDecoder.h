@@ -46,6 +46,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
 #include <CppStdCompat.h>
 
 
@@ -184,9 +185,8 @@ class SvxSwDtmfDecoder : public DtmfDecoder
     static CONSTEXPR size_t DET_CNT_LO_WEIGHT = 1;
     static CONSTEXPR size_t DEFAULT_MIN_DET_CNT = 2*DET_CNT_HI_WEIGHT;
     static CONSTEXPR size_t DEFAULT_MIN_UNDET_CNT = 3;
-    static CONSTEXPR size_t BLOCK_SIZE = 20*INTERNAL_SAMPLE_RATE/1000; // 20ms
-    static CONSTEXPR size_t STEP_SIZE = 10*INTERNAL_SAMPLE_RATE/1000; // 10ms
-    static CONSTEXPR float ENERGY_THRESH = 1e-6*BLOCK_SIZE; // Min pb energy
+    static CONSTEXPR size_t MAX_BLOCK_SIZE =
+        20*Async::AudioSampleRate::MAX/1000; // 20ms at the highest rate
     static CONSTEXPR float REL_THRESH_LO = 0.5; // Tone/pb pwr low thresh
     static CONSTEXPR float REL_THRESH_MED = 0.73; // Tone/pb pwr medium thresh
     static CONSTEXPR float REL_THRESH_HI = 0.9; // Tone/pb pwr high thresh
@@ -200,8 +200,10 @@ class SvxSwDtmfDecoder : public DtmfDecoder
     float twist_rev_thresh;
     std::vector<DtmfGoertzel> row;
     std::vector<DtmfGoertzel> col;
-    float block[BLOCK_SIZE];
-    size_t block_size;
+    float block[MAX_BLOCK_SIZE];
+    size_t block_size;            // 20ms
+    size_t step_size;             // 10ms
+    float energy_thresh;          // Min passband energy
     size_t block_pos;
     size_t det_cnt;
     size_t undet_cnt;
@@ -211,7 +213,9 @@ class SvxSwDtmfDecoder : public DtmfDecoder
     DetState det_state;
     size_t det_cnt_weight;
     int duration;
-    float win[BLOCK_SIZE];
+    float win[MAX_BLOCK_SIZE];
+    float wblock[MAX_BLOCK_SIZE];
+    float goertzel_coeff[8];
     size_t undet_thresh;
     bool debug;
     float win_pwr_comp;
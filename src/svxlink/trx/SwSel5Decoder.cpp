@@ -47,6 +47,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
+#include <AsyncConfig.h>
 
 
 /****************************************************************************
@@ -56,6 +58,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include "SwSel5Decoder.h"
+#include "GoertzelLanes.h"
 
 
 
@@ -89,6 +92,11 @@ using namespace Async;
 #define SEL5_BANDWIDTH              35     /* 35Hz */
 #define SEL5_BLOCK_LENGTH           (INTERNAL_SAMPLE_RATE / 1000)
 
+// When decoding more than one standard, the same sequence may be found by
+// more than one of them a few milliseconds apart. Identical sequences
+// detected within this number of detection blocks are only reported once.
+#define SEL5_DUPLICATE_BLOCKS       100    /* 100ms */
+
 
 /****************************************************************************
  *
@@ -120,6 +128,86 @@ using namespace Async;
  *
  ****************************************************************************/
 
+namespace {
+  typedef struct
+  {
+    const char *type;
+    const char *tonedef;
+    float       tones[16];
+  } Sel5Standard;
+
+  /*  the tones for each mode
+   *                   0        1         2        3        4        5
+   *                   6        7         8        9        A        B
+   *                   C        D         E        F
+  */
+  const Sel5Standard sel5_standards[] =
+  {
+    { "ZVEI1", "0123456789ABCDEF",
+      { 2400.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f, 1530.0f,
+        1670.0f, 1830.0f, 2000.0f, 2200.0f, 2800.0f,  810.0f,
+         970.0f,  885.0f, 2600.0f,  680.0f } },
+    { "ZVEI2", "0123456789ABCDEF",
+      { 2400.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f, 1530.0f,
+        1670.0f, 1830.0f, 2000.0f, 2200.0f,  885.0f,  810.0f,
+         740.0f,  680.0f,  970.0f, 2600.0f } },
+    { "ZVEI3", "0123456789ABCDEF",
+      { 2200.0f,  970.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f,
+        1530.0f, 1670.0f, 1830.0f, 2000.0f,  885.0f,  810.0f,
+         740.0f,  680.0f, 2400.0f, 2600.0f } },
+    { "PZVEI", "0123456789ABCDEF",
+      { 2400.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f, 1530.0f,
+        1670.0f, 1830.0f, 2000.0f, 2200.0f,  970.0f,  810.0f,
+        2800.0f,  885.0f, 2600.0f,  680.0f } },
+    { "DZVEI", "0123456789ABCDEF",
+      { 2200.0f,  970.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f,
+        1530.0f, 1670.0f, 1830.0f, 2000.0f,  825.0f,  740.0f,
+        2600.0f,  885.0f, 2400.0f,  680.0f } },
+    { "PDZVEI", "0123456789ABCDE",
+      { 2200.0f,  970.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f,
+        1530.0f, 1670.0f, 1830.0f, 2000.0f,  825.0f,  886.0f,
+        2600.0f,  856.0f, 2400.0f } },
+    { "EEA", "0123456789ABCDEF",
+      { 1981.0f, 1124.0f, 1197.0f, 1275.0f, 1358.0f, 1446.0f,
+        1540.0f, 1640.0f, 1747.0f, 1860.0f, 1055.0f,  930.0f,
+        2400.0f,  991.0f, 2110.0f, 2047.0f } },
+    { "EIA", "0123456789ABCDEF",
+      {  600.0f,  741.0f,  882.0f, 1023.0f, 1164.0f, 1305.0f,
+        1446.0f, 1587.0f, 1728.0f, 1869.0f, 2151.0f, 2433.0f,
+        2010.0f, 2292.0f,  459.0f, 1091.0f } },
+    { "VDEW", "0123456789ABCDE",
+      { 2280.0f,  370.0f,  450.0f,  550.0f,  675.0f,  825.0f,
+        1010.0f, 1240.0f, 1520.0f, 1860.0f, 2000.0f, 2100.0f,
+        2200.0f, 2300.0f, 2400.0f } },
+    { "CCIR", "0123456789ABCDEF",
+      { 1981.0f, 1124.0f, 1197.0f, 1275.0f, 1358.0f, 1446.0f,
+        1540.0f, 1640.0f, 1747.0f, 1860.0f, 2400.0f,  930.0f,
+        2247.0f,  991.0f, 2110.0f, 1055.0f } },
+    { "PCCIR", "0123456789ABCDE",
+      { 1981.0f, 1124.0f, 1197.0f, 1275.0f, 1358.0f, 1446.0f,
+        1540.0f, 1640.0f, 1747.0f, 1860.0f, 1050.0f,  930.0f,
+        2247.0f,  991.0f, 2110.0f, 1055.0f } },
+    { "CCITT", "0123456789ABCDE",
+      {  400.0f,  679.0f,  770.0f,  852.0f,  941.0f, 1209.0f,
+        1335.0f, 1477.0f, 1633.0f, 1800.0f, 1900.0f, 2000.0f,
+        2100.0f, 2220.0f, 2300.0f } },
+    { "NATEL", "0123456789ABCDEF",
+      { 1633.0f,  631.0f,  697.0f,  770.0f,  852.0f,  941.0f,
+        1040.0f, 1209.0f, 1336.0f, 1477.0f, 1995.0f,  571.0f,
+        2205.0f, 2437.0f, 1805.0f, 2694.0f } },
+    { "EURO", "0123456789ABCDEF",
+      {  979.8f,  903.1f,  832.5f,  764.4f,  707.4f,  652.0f,
+         601.0f,  554.0f,  510.7f,  470.8f,  433.9f,  400.0f,
+         368.7f,  393.9f, 1062.9f,  313.3f } },
+    { "MODAT", "0123456789E",
+      {  637.5f,  787.5f,  937.5f, 1087.5f, 1237.5f, 1387.5f,
+        1537.5f, 1687.5f, 1837.5f, 1987.5f,  487.5f } },
+    { "AUTOA", "0123456789BE",
+      { 1962.0f,  764.0f,  848.0f,  942.0f, 1047.0f, 1163.0f,
+        1292.0f, 1436.0f, 1595.0f, 1770.0f, 2430.0f, 2188.0f } },
+  };
+};
+
 
 
 /****************************************************************************
@@ -129,15 +217,14 @@ using namespace Async;
  ****************************************************************************/
 
 SwSel5Decoder::SwSel5Decoder(Config &cfg, const string &name)
-  : Sel5Decoder(cfg, name), sel5_table(0), samples_left(SEL5_BLOCK_LENGTH),
-    last_hit(0), last_stable(0), stable_timer(0), active_timer(0), arr_len(0)
+  : Sel5Decoder(cfg, name), samples_left(SEL5_BLOCK_LENGTH),
+    last_sequence_age(SEL5_DUPLICATE_BLOCKS)
 {
 } /* SwSel5Decoder::SwSel5Decoder */
 
 
 SwSel5Decoder::~SwSel5Decoder(void)
 {
-  delete [] sel5_table;
 } /* SwSel5Decoder::~SwSel5Decoder */
 
 
@@ -148,182 +235,39 @@ bool SwSel5Decoder::initialize(void)
     return false;
   }
 
-  float tones[16];
-  /*  the tones for each mode
-   *                   0        1         2        3        4        5
-   *                   6        7         8        9        A        B
-   *                   C        D         E        F
-  */
-  float zvei1[] = { 2400.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f, 1530.0f,
-                    1670.0f, 1830.0f, 2000.0f, 2200.0f, 2800.0f,  810.0f,
-                     970.0f,  885.0f, 2600.0f,  680.0f
-                   };
-  float zvei2[] = { 2400.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f, 1530.0f,
-                     1670.0f, 1830.0f, 2000.0f, 2200.0f, 885.0f,   810.0f,
-                      740.0f,  680.0f,  970.0f, 2600.0f
-                   };
-  float zvei3[] = { 2200.0f, 970.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f,
-                     1530.0f,1670.0f, 1830.0f, 2000.0f,  885.0f,  810.0f,
-                      740.0f, 680.0f, 2400.0f, 2600.0f
-                   };
-  float ccir[]  = { 1981.0f, 1124.0f, 1197.0f, 1275.0f, 1358.0f, 1446.0f,
-                     1540.0f, 1640.0f, 1747.0f, 1860.0f, 2400.0f,  930.0f,
-                     2247.0f,  991.0f, 2110.0f, 1055.0f
-                   };
-  float pccir[] = { 1981.0f, 1124.0f, 1197.0f, 1275.0f, 1358.0f, 1446.0f,
-                     1540.0f, 1640.0f, 1747.0f, 1860.0f, 1050.0f,  930.0f,
-                     2247.0f,  991.0f, 2110.0f, 1055.0f
-                   };
-  float eea[]   = { 1981.0f, 1124.0f, 1197.0f, 1275.0f, 1358.0f, 1446.0f,
-                    1540.0f, 1640.0f, 1747.0f, 1860.0f, 1055.0f,  930.0f,
-                    2400.0f,  991.0f, 2110.0f, 2047.0f
-                   };
-  float eia[]   = {  600.0f,  741.0f,  882.0f, 1023.0f, 1164.0f, 1305.0f,
-                    1446.0f, 1587.0f, 1728.0f, 1869.0f, 2151.0f, 2433.0f,
-                    2010.0f, 2292.0f,  459.0f, 1091.0f
-                   };
-  float dzvei[] = { 2200.0f,  970.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f,
-                    1530.0f, 1670.0f, 1830.0f, 2000.0f,  825.0f,  740.0f,
-                    2600.0f,  885.0f, 2400.0f,  680.0f
-                   };
-  float pzvei[] = { 2400.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f, 1530.0f,
-                    1670.0f, 1830.0f, 2000.0f, 2200.0f,  970.0f,  810.0f,
-                    2800.0f,  885.0f, 2600.0f,  680.0f
-                   };
-  float pdzvei[]= { 2200.0f, 970.0f, 1060.0f, 1160.0f, 1270.0f, 1400.0f,
-                     1530.0f,1670.0f, 1830.0f, 2000.0f,  825.0f,  886.0f,
-                     2600.0f, 856.0f, 2400.0f
-                   };
-  float vdew[] =  { 2280.0f,  370.0f,  450.0f,  550.0f,  675.0f,  825.0f,
-                     1010.0f, 1240.0f, 1520.0f, 1860.0f, 2000.0f, 2100.0f,
-                     2200.0f, 2300.0f, 2400.0f
-                   };
-  float ccitt[] = {  400.0f,  679.0f,  770.0f,  852.0f,  941.0f, 1209.0f,
-                     1335.0f, 1477.0f, 1633.0f, 1800.0f, 1900.0f, 2000.0f,
-                     2100.0f, 2220.0f, 2300.0f
-                   };
-  float euro[] =  {  979.8f,  903.1f,  832.5f,  764.4f,  707.4f,  652.0f,
-                     601.0f,  554.0f,  510.7f,  470.8f,  433.9f,  400.0f,
-                     368.7f,  393.9f, 1062.9f,  313.3f
-                   };
-  float natel[] = { 1633.0f,  631.0f,  697.0f,  770.0f,  852.0f,  941.0f,
-                     1040.0f, 1209.0f, 1336.0f, 1477.0f, 1995.0f,  571.0f,
-                     2205.0f, 2437.0f, 1805.0f, 2694.0f
-                   };
-  float modat[] = {  637.5f,  787.5f,  937.5f, 1087.5f, 1237.5f, 1387.5f,
-                     1537.5f, 1687.5f, 1837.5f, 1987.5f, 487.5f
-                   };
-  float autoa[] = { 1962.0f,  764.0f,  848.0f,  942.0f, 1047.0f, 1163.0f,
-                     1292.0f, 1436.0f, 1595.0f, 1770.0f, 2430.0f,
-                     2188.0f
-                   };
-
-  string value;
-  string tonedef = "0123456789";
-
-  cfg().getValue(name(), "SEL5_TYPE", value);
-  if (value == "ZVEI1")
-  {
-     memcpy(tones, zvei1, sizeof(zvei1));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "ZVEI2")
+    // More than one standard may be given as a comma separated list. Tones
+    // that are used by more than one standard are only evaluated once.
+  vector<string> types;
+  cfg().getValue(name(), "SEL5_TYPE", types);
+  for (vector<string>::const_iterator it=types.begin(); it!=types.end(); ++it)
   {
-     memcpy(tones, zvei2, sizeof(zvei2));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "ZVEI3")
-  {
-     memcpy(tones, zvei3, sizeof(zvei3));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "PZVEI")
-  {
-     memcpy(tones, pzvei, sizeof(pzvei));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "DZVEI")
-  {
-     memcpy(tones, dzvei, sizeof(dzvei));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "PDZVEI")
-  {
-     memcpy(tones, pdzvei, sizeof(pdzvei));
-     tonedef += "ABCDE";
-  }
-  else if (value == "EEA")
-  {
-     memcpy(tones, eea, sizeof(eea));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "EIA")
-  {
-     memcpy(tones, eia, sizeof(eia));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "VDEW")
-  {
-     memcpy(tones, vdew, sizeof(vdew));
-     tonedef += "ABCDE";
-  }
-  else if (value == "CCIR" || value == "CCIR1" ||
-            value == "CCIR2")
-  {
-     memcpy(tones, ccir, sizeof(ccir));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "PCCIR")
-  {
-     memcpy(tones, pccir, sizeof(pccir));
-     tonedef += "ABCDE";
-  }
-  else if (value == "CCITT")
-  {
-     memcpy(tones, ccitt, sizeof(ccitt));
-     tonedef += "ABCDE";
-  }
-  else if (value == "NATEL")
-  {
-     memcpy(tones, natel, sizeof(natel));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "EURO")
-  {
-     memcpy(tones, euro, sizeof(euro));
-     tonedef += "ABCDEF";
-  }
-  else if (value == "MODAT")
-  {
-     memcpy(tones, modat, sizeof(modat));
-     tonedef += "E";
-  }
-  else if (value == "AUTOA")
-  {
-     memcpy(tones, autoa, sizeof(autoa));
-     tonedef += "BE";
+    if (!addVariant(*it))
+    {
+      cout << "*** WARNING: Unknown Sel5 type \"" << *it << "\" ignored\n";
+    }
   }
-  else
+  if (variants.empty())
   {
      cout << "*** WARNING: No/wrong Sel5 type defined, using default\n";
-     value = "ZVEI1";
-     memcpy(tones, zvei1, sizeof(zvei1));
-     tonedef += "ABCDEF";
+     addVariant("ZVEI1");
   }
 
-  arr_len = tonedef.length() - 1;
-  sel5_table = new char[arr_len + 1];
-  strcpy(sel5_table, tonedef.c_str());
-
-  cout << "Starting " << value << " decoder" << endl;
-
-  memset(row_energy, 0, sizeof(row_energy));
+  for (vector<Variant>::const_iterator it=variants.begin();
+       it!=variants.end(); ++it)
+  {
+    cout << "Starting " << it->type << " decoder" << endl;
+  }
 
-  /* Init row detectors */
-  for (int a=0; a<=arr_len; a++)
+    /* Set up the Goertzel filter lanes, padded by lanes fed with zeros */
+  int lane_cnt = GoertzelLanes::paddedLaneCount(row_out.size());
+  zero_win.assign(SEL5_BLOCK_LENGTH, 0.0f);
+  lane_q0.assign(lane_cnt, 0.0f);
+  lane_q1.assign(lane_cnt, 0.0f);
+  lane_coeff.assign(lane_cnt, 0.0f);
+  lane_win.assign(lane_cnt, &zero_win[0]);
+  for (size_t lane=0; lane<row_out.size(); ++lane)
   {
-     goertzelInit(&row_out[a],    tones[a], SEL5_BANDWIDTH, 0.0f);
-     goertzelInit(&row_out[a+20], tones[a], SEL5_BANDWIDTH, 0.5f);
+    lane_coeff[lane] = row_out[lane].fac;
   }
 
   return true;
@@ -333,38 +277,46 @@ bool SwSel5Decoder::initialize(void)
 
 int SwSel5Decoder::writeSamples(const float *buf, int len)
 {
-    int k;
-    for (int i = 0; i < len; i++)
+  int pos = 0;
+  while (pos < len)
+  {
+      /* Find the longest run of samples that does not pass the end of the
+         detection interval or the end of a block for any tone detector */
+    int run_len = min(len - pos, samples_left);
+    for (size_t lane=0; lane<row_out.size(); ++lane)
     {
-        float v1;
-        float famp = *(buf++);
-
-        for (k=0; k<=arr_len; k++)
-        {
-          v1 = row_out[k].v2;
-          row_out[k].v2 = row_out[k].v3;
-          row_out[k].v3 = row_out[k].fac * row_out[k].v2 - v1 +
-			  famp * *(row_out[k].win++);
-        }
+      const GoertzelState &s = row_out[lane];
+      run_len = min(run_len, s.samples_left);
+      lane_win[lane] = &s.window_table[s.block_length - s.samples_left];
+    }
 
-        /* Row result calculators */
-        for (k=0; k<=arr_len; k++)
-        {
-          if (--row_out[k].samples_left == 0)
-              row_energy[k] = goertzelResult(&row_out[k]);
+    GoertzelLanes::runWindowed(&lane_q0[0], &lane_q1[0], &lane_coeff[0],
+                               buf + pos, &lane_win[0], run_len,
+                               lane_q0.size());
+    pos += run_len;
 
-          if (--row_out[k+20].samples_left == 0)
-            row_energy[k] = goertzelResult(&row_out[k+20]);
-        }
+      /* Row result calculators */
+    for (size_t lane=0; lane<row_out.size(); ++lane)
+    {
+      GoertzelState &s = row_out[lane];
+      s.samples_left -= run_len;
+      if (s.samples_left == 0)
+      {
+        tone_energy[s.tone] = goertzelResult(lane);
+      }
+    }
 
-         /* Now we are at the end of the detection block */
-        if (--samples_left == 0)
-            Sel5Receive();
+      /* Now we are at the end of the detection block */
+    samples_left -= run_len;
+    if (samples_left == 0)
+    {
+      Sel5Receive();
     }
+  }
 
-    return len;
+  return len;
 
-} /* SwDtmfDecoder::writeSamples */
+} /* SwSel5Decoder::writeSamples */
 
 
 /****************************************************************************
@@ -380,30 +332,118 @@ int SwSel5Decoder::writeSamples(const float *buf, int len)
  *
  ****************************************************************************/
 
-void SwSel5Decoder::Sel5Receive(void)
+bool SwSel5Decoder::addVariant(const std::string &type)
+{
+  string std_type(type);
+  if ((std_type == "CCIR1") || (std_type == "CCIR2"))
+  {
+    std_type = "CCIR";
+  }
+
+  const size_t std_cnt = sizeof(sel5_standards) / sizeof(sel5_standards[0]);
+  const Sel5Standard *sel5_std = 0;
+  for (size_t i=0; i<std_cnt; ++i)
+  {
+    if (std_type == sel5_standards[i].type)
+    {
+      sel5_std = &sel5_standards[i];
+      break;
+    }
+  }
+  if (sel5_std == 0)
+  {
+    return false;
+  }
+
+  Variant v;
+  v.type = type;
+  v.sel5_table = sel5_std->tonedef;
+  v.arr_len = v.sel5_table.length() - 1;
+  v.last_hit = 0;
+  v.last_stable = 0;
+  v.stable_timer = 0;
+  v.active_timer = 0;
+  for (size_t i=0; i<v.sel5_table.length(); ++i)
+  {
+    v.tones.push_back(addTone(sel5_std->tones[i]));
+  }
+  variants.push_back(v);
+
+  return true;
+
+} /* SwSel5Decoder::addVariant */
+
+
+int SwSel5Decoder::addTone(float freq)
 {
+  vector<float>::const_iterator it = find(tone_fq.begin(), tone_fq.end(), freq);
+  if (it != tone_fq.end())
+  {
+    return it - tone_fq.begin();
+  }
+
+  int tone = tone_fq.size();
+  tone_fq.push_back(freq);
+  tone_energy.push_back(0.0f);
+
+    /* Init two detectors per tone, offset by half a block */
+  GoertzelState s;
+  s.tone = tone;
+  goertzelInit(&s, freq, SEL5_BANDWIDTH, 0.0f);
+  row_out.push_back(s);
+  s.window_table.clear();
+  goertzelInit(&s, freq, SEL5_BANDWIDTH, 0.5f);
+  row_out.push_back(s);
 
-    /* Find the peak row and the peak column */
-    int best_row = findMaxIndex(row_energy);
+  return tone;
+
+} /* SwSel5Decoder::addTone */
+
+
+void SwSel5Decoder::Sel5Receive(void)
+{
+  vector<string> detected;
+  for (vector<Variant>::iterator it=variants.begin(); it!=variants.end(); ++it)
+  {
+      /* Find the peak row and the peak column */
+    int best_row = findMaxIndex(*it);
 
     uint8_t hit = 0;
-    /* Valid index test */
+      /* Valid index test */
     if (best_row >= 0)
     {
         /* Got a hit */
-        hit = sel5_table[best_row];
+      hit = it->sel5_table[best_row];
     }
 
-    /* Call the post-processing function. */
-    Sel5PostProcess(hit);
+      /* Call the post-processing function. */
+    Sel5PostProcess(*it, hit, detected);
+  }
+
+    /* A sequence that is valid in more than one of the standards is only
+       reported once */
+  if (last_sequence_age < SEL5_DUPLICATE_BLOCKS)
+  {
+    ++last_sequence_age;
+  }
+  for (vector<string>::iterator it=detected.begin(); it!=detected.end(); ++it)
+  {
+    if ((*it != last_sequence) || (last_sequence_age >= SEL5_DUPLICATE_BLOCKS))
+    {
+      sequenceDetected(*it);
+      last_sequence = *it;
+    }
+    last_sequence_age = 0;
+  }
 
     /* Reset the sample counter. */
-    samples_left = SEL5_BLOCK_LENGTH;
+  samples_left = SEL5_BLOCK_LENGTH;
 
 } /* SwSel5Decoder::Sel5Receive */
 
 
-void SwSel5Decoder::Sel5PostProcess(uint8_t hit)
+void SwSel5Decoder::Sel5PostProcess(Variant &v, uint8_t hit,
+                                    vector<string> &detected)
 {
 
   /* This function is called when a complete block has been received. */
@@ -411,39 +451,39 @@ void SwSel5Decoder::Sel5PostProcess(uint8_t hit)
   {
 //    cout << "hit: " << hit << endl;
 
-    if (last_hit != hit) active_timer = 0;
+    if (v.last_hit != hit) v.active_timer = 0;
 
     /* we need some successfully detects to ensure that a tone has really been
        detected */
-    if (active_timer++ > 10 && last_stable != hit)
+    if (v.active_timer++ > 10 && v.last_stable != hit)
     {
 
        /* 'E' the the repeat tone  */
-       if (hit == 'E') dec_digits += last_stable;
-         else dec_digits += hit;
+       if (hit == 'E') v.dec_digits += v.last_stable;
+         else v.dec_digits += hit;
 
        /* the last successfully detected digit */
-       last_stable = hit;
+       v.last_stable = hit;
     }
 
     /* save the last hit */
-    last_hit = hit;
-    stable_timer = 0;
+    v.last_hit = hit;
+    v.stable_timer = 0;
   }
 
   /* detecting end of sequence */
-  if (!hit && stable_timer++ > 120)
+  if (!hit && v.stable_timer++ > 120)
   {
     /* we need at least 4 digits */
-    if (dec_digits.length() > 3)
+    if (v.dec_digits.length() > 3)
     {
-       sequenceDetected(dec_digits);
-//       cout << "Sel5 sequence detected: " << dec_digits << endl;
+       detected.push_back(v.dec_digits);
+//       cout << "Sel5 sequence detected: " << v.dec_digits << endl;
     }
-    active_timer = 0;
-    stable_timer = 0;
-    dec_digits = "";
-    last_hit = 0;
+    v.active_timer = 0;
+    v.stable_timer = 0;
+    v.dec_digits = "";
+    v.last_hit = 0;
   }
 
 } /* SwSel5Decoder::Sel5PostProcess */
@@ -457,8 +497,6 @@ void SwSel5Decoder::goertzelInit(GoertzelState *s, float freq, float bw, float o
     s->scale_factor = 1.0e6f / (s->block_length * s->block_length);
     /* Init detector frequency. */
     s->fac = 2.0f * cosf(2.0f * M_PI * freq / INTERNAL_SAMPLE_RATE);
-    /* Reset the tone detector state. */
-    s->v2 = s->v3 = 0.0f;
     s->samples_left = static_cast<int>(s->block_length * (1.0f - offset));
     /* Hamming window */
     for (int i = 0; i < s->block_length; i++)
@@ -466,46 +504,48 @@ void SwSel5Decoder::goertzelInit(GoertzelState *s, float freq, float bw, float o
         s->window_table.push_back(
            0.54 - 0.46 * cosf(2.0f * M_PI * i / (s->block_length - 1)));
     }
-    /* Point to the first table entry */
-    s->win = s->window_table.begin();
 
 } /* SwSel5Decoder::goertzelInit */
 
 
-float SwSel5Decoder::goertzelResult(GoertzelState *s)
+float SwSel5Decoder::goertzelResult(size_t lane)
 {
-    float v1, res;
+    GoertzelState *s = &row_out[lane];
+    float v1, v2, v3, res;
 
+    /* Fetch the filter state from the lanes. */
+    v3 = lane_q0[lane];
+    v2 = lane_q1[lane];
     /* Push a zero through the process to finish things off. */
-    v1 = s->v2;
-    s->v2 = s->v3;
-    s->v3 = s->fac*s->v2 - v1;
+    v1 = v2;
+    v2 = v3;
+    v3 = s->fac*v2 - v1;
     /* Now calculate the non-recursive side of the filter. */
     /* The result here is not scaled down to allow for the magnification
        effect of the filter (the usual DFT magnification effect). */
-    res = (s->v3*s->v3 + s->v2*s->v2 - s->v2*s->v3*s->fac) * s->scale_factor;
+    res = (v3*v3 + v2*v2 - v2*v3*s->fac) * s->scale_factor;
     /* Reset the tone detector state. */
-    s->v2 = s->v3 = 0.0f;
+    lane_q0[lane] = lane_q1[lane] = 0.0f;
     s->samples_left = s->block_length;
-    s->win = s->window_table.begin();
     /* Return the calculated signal level. */
     return res;
 
 } /* SwSel5Decoder::goertzelResult */
 
 
-int SwSel5Decoder::findMaxIndex(const float f[])
+int SwSel5Decoder::findMaxIndex(const Variant &v)
 {
     float threshold = 1.0f;
     int idx = -1;
     int i;
 
     /* Peak search */
-    for (i = 0; i < arr_len; i++)
+    for (i = 0; i < v.arr_len; i++)
     {
-        if (f[i] > threshold)
+        const float f = tone_energy[v.tones[i]];
+        if (f > threshold)
         {
-            threshold = f[i];
+            threshold = f;
             idx = i;
         }
     }
@@ -515,9 +555,9 @@ int SwSel5Decoder::findMaxIndex(const float f[])
     /* Peak test */
     threshold *= 1.0f / SEL5_RELATIVE_PEAK;
 
-    for (i = 0; i < arr_len; i++)
+    for (i = 0; i < v.arr_len; i++)
     {
-        if (idx != i && f[i] > threshold)
+        if (idx != i && tone_energy[v.tones[i]] > threshold)
             return -1;
     }
     return idx;
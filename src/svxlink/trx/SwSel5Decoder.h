@@ -36,6 +36,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <vector>
+#include <string>
 #include <stdint.h>
 #include <sigc++/sigc++.h>
 
@@ -139,48 +140,75 @@ class SwSel5Decoder : public Sel5Decoder
 
   private:
 
-    // Tone detection descriptor
+    // Tone detection descriptor. The filter state itself is kept in the
+    // lane vectors below so that all filters can be run in one sweep.
     typedef struct
     {
-      float v2;
-      float v3;
+      int tone;
       float fac;
       float scale_factor;
       std::vector<float> window_table;
-      std::vector<float>::const_iterator win;
       int samples_left;
       int block_length;
     } GoertzelState;
 
-    /*! Tone detector working states for the row tones. */
-    GoertzelState row_out[36];
-
-    /* tone-digit table*/
-    char *sel5_table;
-
-    /*! Row tone signal level values. */
-    float row_energy[16];
+    // Decoding state for one of the configured Sel5 standards
+    typedef struct
+    {
+      /* the name of the standard */
+      std::string type;
+      /* tone-digit table*/
+      std::string sel5_table;
+      /* index into tone_energy for each digit */
+      std::vector<int> tones;
+      /*! the length of the tone definition */
+      int arr_len;
+      /*! The result of the last tone analysis. */
+      uint8_t last_hit;
+      /*! This is the last stable tone digit. */
+      uint8_t last_stable;
+      /*! The detection timer advances when the input is stable. */
+      int stable_timer;
+      /*! The active timer is reset when a new non-zero digit is detected. */
+      int active_timer;
+      /*! the detected Sel5 sequence */
+      std::string dec_digits;
+    } Variant;
+
+    /*! The frequencies of all tones used by the configured standards. */
+    std::vector<float> tone_fq;
+
+    /*! Tone signal level values. */
+    std::vector<float> tone_energy;
+
+    /*! Tone detector working states, two for each tone. */
+    std::vector<GoertzelState> row_out;
+
+    /*! Goertzel filter states and coefficients, one lane per detector. */
+    std::vector<float> lane_q0;
+    std::vector<float> lane_q1;
+    std::vector<float> lane_coeff;
+    std::vector<const float *> lane_win;
+    std::vector<float> zero_win;
+
+    /*! The configured Sel5 standards. */
+    std::vector<Variant> variants;
 
     /*! Remaining sample count in the current detection interval. */
     int samples_left;
-    /*! The result of the last tone analysis. */
-    uint8_t last_hit;
-    /*! This is the last stable tone digit. */
-    uint8_t last_stable;
-    /*! The detection timer advances when the input is stable. */
-    int stable_timer;
-    /*! The active timer is reset when a new non-zero digit is detected. */
-    int active_timer;
-    /*! the detected Sel5 sequence */
-    std::string dec_digits;
-    /*! the length of the tone definition */
-    int arr_len;
 
+    /*! The last reported sequence and the detection blocks since then. */
+    std::string last_sequence;
+    int last_sequence_age;
+
+    bool addVariant(const std::string &type);
+    int addTone(float freq);
     void Sel5Receive(void);
-    void Sel5PostProcess(uint8_t hit);
+    void Sel5PostProcess(Variant &v, uint8_t hit,
+                         std::vector<std::string> &detected);
     void goertzelInit(GoertzelState *s, float freq, float bw, float offset);
-    float goertzelResult(GoertzelState *s);
-    int findMaxIndex(const float f[]);
+    float goertzelResult(size_t lane);
+    int findMaxIndex(const Variant &v);
 
 };  /* class SwSel5Decoder */
 
@@ -47,6 +47,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -682,6 +683,83 @@ void ToneDetector::setActivated(bool activated)
 } /* ToneDetector::setActivated */
 
 
+int ToneDetector::runLength(int len) const
+{
+  len = min(len, samples_left);
+  if (phase_check_left > 0)
+  {
+    len = min(len, phase_check_left);
+  }
+  return len;
+} /* ToneDetector::runLength */
+
+
+int ToneDetector::goertzelCount(void) const
+{
+  return (par->peak_thresh > 0.0f) ? 3 : 1;
+} /* ToneDetector::goertzelCount */
+
+
+Goertzel &ToneDetector::goertzel(int idx)
+{
+  switch (idx)
+  {
+    case 1:
+      return par->lower;
+    case 2:
+      return par->upper;
+    default:
+      return par->center;
+  }
+} /* ToneDetector::goertzel */
+
+
+const float *ToneDetector::windowSamples(const float *buf, int len,
+                                         vector<float> &wbuf,
+                                         double &energy) const
+{
+    // Without windowing the samples are used as is and the energy given by
+    // the caller, calculated on the same samples, is kept
+  if (!par->use_windowing)
+  {
+    return buf;
+  }
+
+  wbuf.resize(len);
+  energy = 0.0;
+  vector<float>::const_iterator w = win;
+  for (int i = 0; i < len; i++)
+  {
+    float famp = buf[i] * *(w++);
+    energy += famp * famp;
+    wbuf[i] = famp;
+  }
+  return &wbuf[0];
+} /* ToneDetector::windowSamples */
+
+
+void ToneDetector::advance(int len, double energy)
+{
+  if (par->use_windowing)
+  {
+    win += len;
+  }
+  passband_energy += energy;
+  samples_left -= len;
+
+  if ((phase_check_left > 0) && ((phase_check_left -= len) == 0))
+  {
+    phaseCheck();
+    phase_check_left = par->period_block_len;
+  }
+
+  if (samples_left == 0)
+  {
+    postProcess();
+  }
+} /* ToneDetector::advance */
+
+
 /*
  * This file has not been truncated
  */
@@ -63,6 +63,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+class Goertzel;
 
 
 /****************************************************************************
@@ -460,6 +461,8 @@ class ToneDetector : public sigc::trackable, public Async::AudioSink
     sigc::signal<void, float> snrUpdated;
     
   private:
+    friend class ToneDetectorBank;
+
     struct DetectorParams;
 
     static CONSTEXPR bool   DEFAULT_USE_WINDOWING	= true;
@@ -490,6 +493,15 @@ class ToneDetector : public sigc::trackable, public Async::AudioSink
     void postProcess(void);
     void setActivated(bool activated);
 
+      // Used by ToneDetectorBank to run the detector in a bank
+    int runLength(int len) const;
+    int goertzelCount(void) const;
+    Goertzel &goertzel(int idx);
+    const float *windowSamples(const float *buf, int len,
+                               std::vector<float> &wbuf,
+                               double &energy) const;
+    void advance(int len, double energy);
+
 };  /* class ToneDetector */
 
 
@@ -0,0 +1,284 @@
+/**
+@file   ToneDetectorBank.cpp
+@brief  Run a number of tone detectors in one pass over the samples
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that feed a number of tone detectors with the same
+audio, running all their Goertzel filters side by side in one sweep over each
+block of samples.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <cassert>
+#include <algorithm>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "ToneDetectorBank.h"
+#include "ToneDetector.h"
+#include "Goertzel.h"
+#include "GoertzelLanes.h"
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+ToneDetectorBank::ToneDetectorBank(void)
+{
+} /* ToneDetectorBank::ToneDetectorBank */
+
+
+ToneDetectorBank::~ToneDetectorBank(void)
+{
+  for (Members::iterator it = dets.begin(); it != dets.end(); ++it)
+  {
+    if (it->managed)
+    {
+      delete it->det;
+    }
+  }
+} /* ToneDetectorBank::~ToneDetectorBank */
+
+
+void ToneDetectorBank::addDetector(ToneDetector *det, bool managed)
+{
+  assert(det != 0);
+  Member member;
+  member.det = det;
+  member.managed = managed;
+  member.first_lane = 0;
+  member.lane_cnt = 0;
+  member.energy = 0.0;
+  dets.push_back(member);
+} /* ToneDetectorBank::addDetector */
+
+
+void ToneDetectorBank::removeDetector(ToneDetector *det)
+{
+  for (Members::iterator it = dets.begin(); it != dets.end(); ++it)
+  {
+    if (it->det == det)
+    {
+      dets.erase(it);
+      return;
+    }
+  }
+} /* ToneDetectorBank::removeDetector */
+
+
+int ToneDetectorBank::writeSamples(const float *buf, int len)
+{
+  int pos = 0;
+  while ((pos < len) && !dets.empty())
+  {
+      // Find the longest run of samples that will not pass a block boundary
+      // or phase check point of any of the detectors
+    int run_len = len - pos;
+    for (Members::const_iterator it = dets.begin(); it != dets.end(); ++it)
+    {
+      run_len = it->det->runLength(run_len);
+    }
+
+      // The detector state may change at each boundary, for example
+      // switching between the detect and undetect parameters, so the lanes
+      // are set up again for each run
+    int lane_cnt = setupLanes();
+    processRun(buf + pos, run_len, lane_cnt);
+
+    for (size_t i=0; i<dets.size(); ++i)
+    {
+      dets[i].det->advance(run_len, dets[i].energy);
+    }
+    pos += run_len;
+  }
+
+  return len;
+
+} /* ToneDetectorBank::writeSamples */
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+int ToneDetectorBank::setupLanes(void)
+{
+  int lane_cnt = 0;
+  for (Members::iterator it = dets.begin(); it != dets.end(); ++it)
+  {
+    it->first_lane = lane_cnt;
+    it->lane_cnt = it->det->goertzelCount();
+    lane_cnt += it->lane_cnt;
+  }
+
+    // Pad to a whole number of SIMD vectors. The padding lanes are fed
+    // with zeros and never read back.
+  lane_cnt = GoertzelLanes::paddedLaneCount(lane_cnt);
+  q0.assign(lane_cnt, 0.0f);
+  q1.assign(lane_cnt, 0.0f);
+  coeff.assign(lane_cnt, 0.0f);
+  lane_src.resize(lane_cnt);
+
+  for (Members::iterator it = dets.begin(); it != dets.end(); ++it)
+  {
+    for (int k=0; k<it->lane_cnt; ++k)
+    {
+      const Goertzel &g = it->det->goertzel(k);
+      int lane = it->first_lane + k;
+      q0[lane] = g.q0;
+      q1[lane] = g.q1;
+      coeff[lane] = g.two_cosw;
+    }
+  }
+
+  return lane_cnt;
+
+} /* ToneDetectorBank::setupLanes */
+
+
+void ToneDetectorBank::processRun(const float *buf, int len, int lane_cnt)
+{
+    // The passband energy of the raw input, used by all detectors that do
+    // not apply a window
+  double raw_energy = 0.0;
+  for (int i=0; i<len; ++i)
+  {
+    raw_energy += buf[i] * buf[i];
+  }
+
+  if (zeros.size() < static_cast<size_t>(len))
+  {
+    zeros.resize(len, 0.0f);
+  }
+  fill(lane_src.begin(), lane_src.end(), &zeros[0]);
+
+  for (Members::iterator it = dets.begin(); it != dets.end(); ++it)
+  {
+    it->energy = raw_energy;
+    const float *src = it->det->windowSamples(buf, len, it->wbuf, it->energy);
+    for (int k=0; k<it->lane_cnt; ++k)
+    {
+      lane_src[it->first_lane + k] = src;
+    }
+  }
+
+  GoertzelLanes::run(&q0[0], &q1[0], &coeff[0], &lane_src[0], len, lane_cnt);
+
+  for (Members::iterator it = dets.begin(); it != dets.end(); ++it)
+  {
+    for (int k=0; k<it->lane_cnt; ++k)
+    {
+      Goertzel &g = it->det->goertzel(k);
+      g.q0 = q0[it->first_lane + k];
+      g.q1 = q1[it->first_lane + k];
+    }
+  }
+} /* ToneDetectorBank::processRun */
+
+
+
+/*
+ * This file has not been truncated
+ */
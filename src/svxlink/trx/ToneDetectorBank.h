@@ -0,0 +1,202 @@
+/**
+@file   ToneDetectorBank.h
+@brief  Run a number of tone detectors in one pass over the samples
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+This file contains a class that feed a number of tone detectors with the same
+audio, running all their Goertzel filters side by side in one sweep over each
+block of samples.
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2020 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef TONE_DETECTOR_BANK_INCLUDED
+#define TONE_DETECTOR_BANK_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioSink.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+class ToneDetector;
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Run a number of tone detectors in one pass over the samples
+@author Tobias Blomberg / SM0SVX
+@date   2020-10-14
+
+When a number of tone detectors are fed with the same audio, it is cheaper to
+let this class run them instead of adding each of them to an audio splitter.
+The Goertzel filters of all detectors (the center bin and, if the peak
+threshold is used, the neighbour bins) are stepped side by side, four filters
+per SIMD instruction, over each run of samples up to the next block boundary
+of any of the detectors. Detectors that do not use windowing read the input
+samples directly so no copying is needed for them. The detectors themselves
+work just as before. Their thresholds, detection delays and signals are all
+unchanged.
+
+\code
+  ToneDetectorBank *bank = new ToneDetectorBank;
+  ToneDetector *det = new ToneDetector(1750, 50, 100);
+  det->detected.connect(...);
+  bank->addDetector(det, true);
+  splitter->addSink(bank, true);
+\endcode
+*/
+class ToneDetectorBank : public sigc::trackable, public Async::AudioSink
+{
+  public:
+    /**
+     * @brief 	Default constructor
+     */
+    ToneDetectorBank(void);
+
+    /**
+     * @brief 	Destructor
+     *
+     * All detectors that was added as managed will be deleted.
+     */
+    ~ToneDetectorBank(void);
+
+    /**
+     * @brief 	Add a tone detector to the bank
+     * @param 	det The tone detector to add
+     * @param 	managed Set to \em true to delete the detector with the bank
+     *
+     * The detector must not be fed with audio from anywhere else while it
+     * is a member of the bank.
+     */
+    void addDetector(ToneDetector *det, bool managed=false);
+
+    /**
+     * @brief 	Remove a tone detector from the bank
+     * @param 	det The tone detector to remove
+     *
+     * The detector will not be deleted, even if it was added as managed.
+     * A detector must not be removed from within one of its signal handlers.
+     */
+    void removeDetector(ToneDetector *det);
+
+    /**
+     * @brief 	Get the number of detectors in the bank
+     * @return	Returns the number of detectors
+     */
+    int detectorCount(void) const { return dets.size(); }
+
+    /**
+     * @brief 	Write samples into the tone detector bank
+     * @param 	buf The buffer containing the samples
+     * @param 	len The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *buf, int len);
+
+    /**
+     * @brief 	Tell the sink to flush the previously written samples
+     */
+    virtual void flushSamples(void) { sourceAllSamplesFlushed(); }
+
+  private:
+    struct Member
+    {
+      ToneDetector        *det;
+      bool                managed;
+      int                 first_lane;
+      int                 lane_cnt;
+      double              energy;
+      std::vector<float>  wbuf;
+    };
+    typedef std::vector<Member> Members;
+
+    Members                   dets;
+    std::vector<float>        q0;
+    std::vector<float>        q1;
+    std::vector<float>        coeff;
+    std::vector<const float*> lane_src;
+    std::vector<float>        zeros;
+
+    ToneDetectorBank(const ToneDetectorBank&);
+    ToneDetectorBank& operator=(const ToneDetectorBank&);
+    int setupLanes(void);
+    void processRun(const float *buf, int len, int lane_cnt);
+
+};  /* class ToneDetectorBank */
+
+
+#endif /* TONE_DETECTOR_BANK_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
@@ -67,6 +67,10 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  *
  ****************************************************************************/
 
+namespace Async
+{
+  class AudioProcessor;
+};
 
 
 /****************************************************************************
@@ -236,6 +240,39 @@ class Tx : public sigc::trackable, public Async::AudioSink
      */
     virtual void setModulation(Modulation::Type mod) {}
 
+    /**
+     * @brief   Get a key identifying the audio processing front end
+     * @return  Returns a key or an empty string if it cannot be shared
+     *
+     * Transmitters returning the same non-empty key run identical audio
+     * processing on the audio written to them. A user feeding many
+     * transmitters with the same audio, like the MultiTx, can then run the
+     * processing once using createAudioProcessor and write the result to the
+     * processedAudioInput of each transmitter.
+     */
+    virtual std::string audioProcessingKey(void) const { return ""; }
+
+    /**
+     * @brief   Create a copy of the audio processing front end
+     * @return  Returns a new audio processor or 0 if not supported
+     *
+     * The caller will own the returned object.
+     */
+    virtual Async::AudioProcessor* createAudioProcessor(void) const
+    {
+      return 0;
+    }
+
+    /**
+     * @brief   Get the input for audio that has already been processed
+     * @return  Returns an audio sink or 0 if not supported
+     *
+     * Audio written to this sink bypass the audio processing front end. It
+     * should have been processed by a processor returned from
+     * createAudioProcessor.
+     */
+    virtual Async::AudioSink* processedAudioInput(void) { return 0; }
+
     /**
      * @brief 	This signal is emitted when the tx timeout timer expires
      *
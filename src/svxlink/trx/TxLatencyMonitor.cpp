@@ -0,0 +1,297 @@
+/**
+@file	 TxLatencyMonitor.cpp
+@brief   Measure the PTT and audio latencies of a local transmitter
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <time.h>
+
+#include <algorithm>
+#include <vector>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioIO.h>
+#include <AsyncMetrics.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+#include "TxLatencyMonitor.h"
+
+
+
+/****************************************************************************
+ *
+ * Namespaces to use
+ *
+ ****************************************************************************/
+
+using namespace std;
+using namespace Async;
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+namespace {
+    // Histogram bucket upper limits in milliseconds
+  const unsigned BUCKET_LIMITS_MS[] = {
+    5, 10, 20, 50, 100, 200, 300, 500, 1000, 2000, 5000
+  };
+};
+
+
+/****************************************************************************
+ *
+ * Local class definitions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Prototypes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+
+/****************************************************************************
+ *
+ * Local Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Public member functions
+ *
+ ****************************************************************************/
+
+TxLatencyMonitor::TxLatencyMonitor(const string& tx_name, AudioIO *audio_io)
+  : tx_name(tx_name), audio_io(audio_io), ptt_on(false),
+    wait_for_ptt(false), wait_for_audio(false), wait_for_release(false),
+    tx_on_ns(0), tx_off_ns(0)
+{
+  Metrics::instance().collect.connect(
+      sigc::mem_fun(*this, &TxLatencyMonitor::writeMetrics));
+} /* TxLatencyMonitor::TxLatencyMonitor */
+
+
+TxLatencyMonitor::~TxLatencyMonitor(void)
+{
+} /* TxLatencyMonitor::~TxLatencyMonitor */
+
+
+void TxLatencyMonitor::transmitterOn(void)
+{
+  tx_on_ns = now();
+  last_tx = Latencies();
+  wait_for_audio = true;
+  wait_for_release = false;
+
+    // If the PTT is still asserted, e.g. during the PTT hangtime, there is
+    // no key-up to measure
+  wait_for_ptt = !ptt_on;
+} /* TxLatencyMonitor::transmitterOn */
+
+
+void TxLatencyMonitor::pttAsserted(void)
+{
+  if (wait_for_ptt)
+  {
+    wait_for_ptt = false;
+    last_tx.keyup_ms = (now() - tx_on_ns) / 1.0e6;
+    keyup_stats.record(last_tx.keyup_ms);
+  }
+  ptt_on = true;
+} /* TxLatencyMonitor::pttAsserted */
+
+
+void TxLatencyMonitor::transmitterOff(void)
+{
+  tx_off_ns = now();
+  wait_for_ptt = false;
+  wait_for_audio = false;
+  wait_for_release = ptt_on;
+} /* TxLatencyMonitor::transmitterOff */
+
+
+void TxLatencyMonitor::pttReleased(void)
+{
+  if (!ptt_on)
+  {
+    return;
+  }
+  ptt_on = false;
+  wait_for_ptt = false;
+
+    // A PTT released while still transmitting is a transmitter timeout. No
+    // release time is recorded for that case.
+  if (wait_for_release)
+  {
+    wait_for_release = false;
+    last_tx.release_ms = (now() - tx_off_ns) / 1.0e6;
+    release_stats.record(last_tx.release_ms);
+  }
+  transmissionMeasured(last_tx);
+} /* TxLatencyMonitor::pttReleased */
+
+
+int TxLatencyMonitor::writeSamples(const float *samples, int count)
+{
+  if (wait_for_audio && (count > 0))
+  {
+    wait_for_audio = false;
+    last_tx.audio_start_ms = (now() - tx_on_ns) / 1.0e6;
+    audio_start_stats.record(last_tx.audio_start_ms);
+
+      // The samples already queued for the audio device will be played
+      // before the ones written now
+    const int queued = audio_io->samplesToWrite();
+    if (queued >= 0)
+    {
+      last_tx.air_ms = last_tx.audio_start_ms +
+                       1000.0 * queued / audio_io->sampleRate();
+      air_stats.record(last_tx.air_ms);
+    }
+  }
+  return AudioPassthrough::writeSamples(samples, count);
+} /* TxLatencyMonitor::writeSamples */
+
+
+
+/****************************************************************************
+ *
+ * Protected member functions
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Private member functions
+ *
+ ****************************************************************************/
+
+TxLatencyMonitor::Stats::Stats(void)
+  : count(0), sum_ms(0.0)
+{
+  std::fill_n(buckets, BUCKET_CNT, 0);
+} /* TxLatencyMonitor::Stats::Stats */
+
+
+void TxLatencyMonitor::Stats::record(double ms)
+{
+  count += 1;
+  sum_ms += ms;
+  for (size_t i=0; i<BUCKET_CNT; ++i)
+  {
+    if (ms <= BUCKET_LIMITS_MS[i])
+    {
+      buckets[i] += 1;
+      break;
+    }
+  }
+} /* TxLatencyMonitor::Stats::record */
+
+
+void TxLatencyMonitor::Stats::write(MetricsWriter& writer, const string& name,
+                                    const string& help,
+                                    const string& tx_name) const
+{
+  vector<MetricsWriter::Bucket> b;
+  uint64_t cumulative = 0;
+  for (size_t i=0; i<BUCKET_CNT; ++i)
+  {
+    cumulative += buckets[i];
+    b.push_back(MetricsWriter::Bucket(BUCKET_LIMITS_MS[i] / 1000.0,
+                                      cumulative));
+  }
+  writer.histogram(name, help, Metrics::labels("tx", tx_name), b, count,
+                   sum_ms / 1000.0);
+} /* TxLatencyMonitor::Stats::write */
+
+
+uint64_t TxLatencyMonitor::now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+} /* TxLatencyMonitor::now */
+
+
+void TxLatencyMonitor::writeMetrics(MetricsWriter& writer)
+{
+  keyup_stats.write(writer, "svxlink_tx_ptt_keyup_seconds",
+      "Time from transmitter on until the PTT has been asserted", tx_name);
+  audio_start_stats.write(writer, "svxlink_tx_audio_start_seconds",
+      "Time from transmitter on until the first audio reach the audio device",
+      tx_name);
+  air_stats.write(writer, "svxlink_tx_air_latency_seconds",
+      "Estimated time from transmitter on until the first audio is on air",
+      tx_name);
+  release_stats.write(writer, "svxlink_tx_ptt_release_seconds",
+      "Time from transmitter off until the PTT has been released", tx_name);
+} /* TxLatencyMonitor::writeMetrics */
+
+
+
+/*
+ * This file has not been truncated
+ */
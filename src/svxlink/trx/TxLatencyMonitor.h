@@ -0,0 +1,257 @@
+/**
+@file	 TxLatencyMonitor.h
+@brief   Measure the PTT and audio latencies of a local transmitter
+@author  Tobias Blomberg / SM0SVX
+@date	 2026-10-14
+
+\verbatim
+SvxLink - A Multi Purpose Voice Services System for Ham Radio Use
+Copyright (C) 2003-2026 Tobias Blomberg / SM0SVX
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+\endverbatim
+*/
+
+#ifndef TX_LATENCY_MONITOR_INCLUDED
+#define TX_LATENCY_MONITOR_INCLUDED
+
+
+/****************************************************************************
+ *
+ * System Includes
+ *
+ ****************************************************************************/
+
+#include <sigc++/sigc++.h>
+#include <stdint.h>
+
+#include <string>
+
+
+/****************************************************************************
+ *
+ * Project Includes
+ *
+ ****************************************************************************/
+
+#include <AsyncAudioPassthrough.h>
+
+
+/****************************************************************************
+ *
+ * Local Includes
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Forward declarations
+ *
+ ****************************************************************************/
+
+namespace Async
+{
+  class AudioIO;
+  class MetricsWriter;
+};
+
+
+/****************************************************************************
+ *
+ * Namespace
+ *
+ ****************************************************************************/
+
+//namespace MyNameSpace
+//{
+
+
+/****************************************************************************
+ *
+ * Forward declarations of classes inside of the declared namespace
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Defines & typedefs
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Exported Global Variables
+ *
+ ****************************************************************************/
+
+
+
+/****************************************************************************
+ *
+ * Class definitions
+ *
+ ****************************************************************************/
+
+/**
+@brief	Measure the PTT and audio latencies of a local transmitter
+@author Tobias Blomberg / SM0SVX
+@date   2026-10-14
+
+This class is put last in the audio pipe of a LocalTx, just before the
+AudioIO object. The transmitter tell it when it decide to transmit, when the
+PTT has actually been asserted and so on. The following is then measured for
+each transmission, all relative to the time when the transmitter was turned
+on:
+
+  - Key-up: The time until the PTT hardware has been asserted. This include
+    the time it take to open the audio device.
+  - Audio start: The time until the first audio sample reach the audio
+    device. This is where TX_DELAY show up.
+  - Air: The audio start time plus the time it take to play the samples
+    already queued in the AudioIO object and in the audio device. This is an
+    estimate of when the first audio sample is actually transmitted.
+
+The release time, from the transmitter being turned off until the PTT has
+been released, is also measured. It include the PTT hangtime, if one is
+configured.
+
+Statistics are exported as histograms through Async::Metrics. The
+transmissionMeasured signal is emitted when the PTT has been released so
+that the latencies of each transmission can be reported.
+*/
+class TxLatencyMonitor : public Async::AudioPassthrough, public sigc::trackable
+{
+  public:
+    /**
+     * @brief The measurements made for one transmission
+     *
+     * A value that could not be measured, e.g. the key-up time when the PTT
+     * was still asserted since the last transmission, is negative.
+     */
+    struct Latencies
+    {
+      double keyup_ms;        ///< Transmitter on until PTT asserted
+      double audio_start_ms;  ///< Transmitter on until first audio sample
+      double air_ms;          ///< Transmitter on until audio on air
+      double release_ms;      ///< Transmitter off until PTT released
+      Latencies(void)
+        : keyup_ms(-1.0), audio_start_ms(-1.0), air_ms(-1.0),
+          release_ms(-1.0) {}
+    };
+
+    /**
+     * @brief 	Constructor
+     * @param 	tx_name   The name of the transmitter, used as metrics label
+     * @param 	audio_io  The audio output of the transmitter
+     */
+    TxLatencyMonitor(const std::string& tx_name, Async::AudioIO *audio_io);
+
+    /**
+     * @brief 	Destructor
+     */
+    ~TxLatencyMonitor(void);
+
+    /**
+     * @brief   Tell the monitor that the transmitter has been turned on
+     */
+    void transmitterOn(void);
+
+    /**
+     * @brief   Tell the monitor that the PTT hardware has been asserted
+     */
+    void pttAsserted(void);
+
+    /**
+     * @brief   Tell the monitor that the transmitter has been turned off
+     */
+    void transmitterOff(void);
+
+    /**
+     * @brief   Tell the monitor that the PTT hardware has been released
+     */
+    void pttReleased(void);
+
+    /**
+     * @brief   Get the measurements for the last transmission
+     * @return  Returns the latencies of the last, or ongoing, transmission
+     */
+    const Latencies& last(void) const { return last_tx; }
+
+    /**
+     * @brief 	Write samples into this audio sink
+     * @param 	samples The buffer containing the samples
+     * @param 	count   The number of samples in the buffer
+     * @return	Returns the number of samples that has been taken care of
+     */
+    virtual int writeSamples(const float *samples, int count);
+
+    /**
+     * @brief A signal that is emitted when a transmission has been measured
+     * @param latencies The measurements made for the transmission
+     *
+     * This signal is emitted when the PTT has been released.
+     */
+    sigc::signal<void, const Latencies&> transmissionMeasured;
+
+  private:
+    struct Stats
+    {
+      static const size_t BUCKET_CNT = 11;
+      uint64_t  count;
+      double    sum_ms;
+      uint64_t  buckets[BUCKET_CNT];
+      Stats(void);
+      void record(double ms);
+      void write(Async::MetricsWriter& writer, const std::string& name,
+                 const std::string& help, const std::string& tx_name) const;
+    };
+
+    const std::string tx_name;
+    Async::AudioIO*   audio_io;
+    bool              ptt_on;
+    bool              wait_for_ptt;
+    bool              wait_for_audio;
+    bool              wait_for_release;
+    uint64_t          tx_on_ns;
+    uint64_t          tx_off_ns;
+    Latencies         last_tx;
+    Stats             keyup_stats;
+    Stats             audio_start_stats;
+    Stats             air_stats;
+    Stats             release_stats;
+
+    TxLatencyMonitor(const TxLatencyMonitor&);
+    TxLatencyMonitor& operator=(const TxLatencyMonitor&);
+    static uint64_t now(void);
+    void writeMetrics(Async::MetricsWriter& writer);
+
+};  /* class TxLatencyMonitor */
+
+
+//} /* namespace */
+
+#endif /* TX_LATENCY_MONITOR_INCLUDED */
+
+
+
+/*
+ * This file has not been truncated
+ */
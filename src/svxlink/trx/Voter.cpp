@@ -57,6 +57,7 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 #include <AsyncAudioValve.h>
 #include <AsyncPty.h>
 #include <AsyncPtyStreamBuf.h>
+#include <AsyncAudioSampleRate.h>
 
 
 /****************************************************************************
@@ -112,7 +113,8 @@ class Voter::SatRx : public AudioSource, public sigc::trackable
     SatRx(Config &cfg, const string &rx_name, int id, int fifo_length_ms)
       : rx_id(id), rx(0), fifo(0), sql_open(false), enabled(true),
         mute_state(Rx::MUTE_ALL), // FIXME: Set this from the Rx object
-        sql_open_delay(0)
+        sql_open_delay(0), is_ranked(false), select_cnt(0),
+        audio_needed(true)
     {
       rx = RxFactory::createNamedRx(cfg, rx_name);
       if (rx != 0)
@@ -140,6 +142,7 @@ class Voter::SatRx : public AudioSource, public sigc::trackable
 	  prev_src->registerSink(fifo);
 	  prev_src = fifo;
 	  valve.setBlockWhenClosed(true);
+	  rx->setAudioLookback(fifo_length_ms);
 	}
 	else
 	{
@@ -252,6 +255,28 @@ class Voter::SatRx : public AudioSource, public sigc::trackable
       sql_open_delay = new_sql_open_delay;
     }
     unsigned sqlOpenDelay(void) const { return sql_open_delay; }
+
+    void setRankPos(SatRxRanking::iterator pos)
+    {
+      rank_pos = pos;
+      is_ranked = true;
+    }
+    void clearRankPos(void) { is_ranked = false; }
+    bool isRanked(void) const { return is_ranked; }
+    SatRxRanking::iterator rankPos(void) const { return rank_pos; }
+
+    void incSelectCount(void) { ++select_cnt; }
+    void resetSelectCount(void) { select_cnt = 0; }
+    unsigned long selectCount(void) const { return select_cnt; }
+
+    void setAudioNeeded(bool is_needed)
+    {
+      if (is_needed != audio_needed)
+      {
+        audio_needed = is_needed;
+        rx->setAudioNeeded(is_needed);
+      }
+    }
     
     signal<void, char, int>  	dtmfDigitDetected;
     signal<void, string>  	selcallSequenceDetected;
@@ -282,6 +307,10 @@ class Voter::SatRx : public AudioSource, public sigc::trackable
     bool          enabled;
     Rx::MuteState mute_state;
     unsigned      sql_open_delay;
+    SatRxRanking::iterator rank_pos;
+    bool          is_ranked;
+    unsigned long select_cnt;
+    bool          audio_needed;
     
     void onDtmfDigitDetected(char digit, int duration)
     {
@@ -375,7 +404,8 @@ class Voter::SatRx : public AudioSource, public sigc::trackable
 
 Voter::Voter(Config &cfg, const std::string& name)
   : Rx(cfg, name), cfg(cfg), m_verbose(true), selector(0),
-    sm(Macho::State<Top>(this)), is_processing_event(false), command_pty(0)
+    sm(Macho::State<Top>(this)), is_processing_event(false), command_pty(0),
+    best_siglev(0.0f)
 {
   Rx::setVerbose(false);
 } /* Voter::Voter */
@@ -646,12 +676,14 @@ void Voter::satSquelchOpen(bool is_open, SatRx *srx)
 {
   //cout << "Voter::satSquelchOpen: is_open=" << (is_open ? "TRUE" : "FALSE")
   //     << " srx=" << srx->name() << endl;
+  updateRanking(srx, is_open, srx->signalStrength());
   dispatchEvent(Macho::Event(&Top::satSquelchOpen, srx, is_open));
 } /* Voter::satSquelchOpen */
 
 
 void Voter::satSignalLevelUpdated(float siglev, SatRx *srx)
 {
+  updateRanking(srx, true, siglev);
   dispatchEvent(Macho::Event(&Top::satSignalLevelUpdated, srx, siglev));
 } /* Voter::satSignalLevelUpdated */
 
@@ -723,22 +755,134 @@ void Voter::printSquelchState(void)
 
 Voter::SatRx *Voter::findBestRx(void) const
 {
-  float best_rx_siglev = 0.0f;
-  SatRx *best_rx = 0;
-  list<SatRx *>::const_iterator it;
-  for (it=rxs.begin(); it!=rxs.end(); ++it)
+  if (rx_ranking.empty())
+  {
+    return 0;
+  }
+  return rx_ranking.rbegin()->second;
+} /* Voter::findBestRx */
+
+
+void Voter::updateRanking(SatRx *srx, bool is_open, float siglev)
+{
+    // The ranking only contain receivers with an open squelch. It is updated
+    // incrementally on each signal level and squelch update so that the best
+    // receiver can be found without scanning all receivers.
+  if (srx->isRanked())
+  {
+    rx_ranking.erase(srx->rankPos());
+    srx->clearRankPos();
+  }
+  if (is_open)
+  {
+    srx->setRankPos(rx_ranking.insert(make_pair(siglev, srx)));
+  }
+  ++stats.rank_update_cnt;
+
+    // Only receivers that are close enough to the best one to ever be
+    // selected need to decode their audio. All receivers are reevaluated
+    // when the best signal level change.
+  float new_best_siglev = rx_ranking.empty() ? 0.0f :
+                          rx_ranking.rbegin()->first;
+  if (new_best_siglev != best_siglev)
   {
-    if ((*it)->squelchIsOpen() &&
-	((best_rx == 0) || ((*it)->signalStrength() > best_rx_siglev)))
+    best_siglev = new_best_siglev;
+    list<SatRx *>::iterator it;
+    for (it=rxs.begin(); it!=rxs.end(); ++it)
     {
-      best_rx = *it;
-      best_rx_siglev = (*it)->signalStrength();
+      updateAudioNeeded(*it);
     }
   }
-  
-  return best_rx;
-  
-} /* Voter::findBestRx */
+  else
+  {
+    updateAudioNeeded(srx);
+  }
+} /* Voter::updateRanking */
+
+
+void Voter::updateAudioNeeded(SatRx *srx)
+{
+  srx->setAudioNeeded(!srx->isRanked() ||
+                      (srx->rankPos()->first * sm->hysteresis() >=
+                       best_siglev));
+} /* Voter::updateAudioNeeded */
+
+
+void Voter::voteStarted(void)
+{
+  stats.vote_pending = true;
+  gettimeofday(&stats.vote_start, NULL);
+} /* Voter::voteStarted */
+
+
+void Voter::voteFinished(SatRx *srx)
+{
+  srx->incSelectCount();
+  if (!stats.vote_pending)
+  {
+    return;
+  }
+  stats.vote_pending = false;
+
+  struct timeval now, diff;
+  gettimeofday(&now, NULL);
+  timersub(&now, &stats.vote_start, &diff);
+  unsigned latency = diff.tv_sec * 1000 + diff.tv_usec / 1000;
+  if ((stats.vote_cnt == 0) || (latency < stats.latency_min))
+  {
+    stats.latency_min = latency;
+  }
+  if (latency > stats.latency_max)
+  {
+    stats.latency_max = latency;
+  }
+  stats.latency_sum += latency;
+  ++stats.vote_cnt;
+} /* Voter::voteFinished */
+
+
+void Voter::activeRxSwitched(SatRx *srx)
+{
+  srx->incSelectCount();
+  ++stats.switch_cnt;
+} /* Voter::activeRxSwitched */
+
+
+void Voter::writeStats(void)
+{
+  Json::Value event(Json::objectValue);
+  event["votes"] = static_cast<Json::UInt64>(stats.vote_cnt);
+  Json::Value latency(Json::objectValue);
+  latency["min"] = stats.latency_min;
+  latency["avg"] = (stats.vote_cnt > 0)
+    ? static_cast<unsigned>(stats.latency_sum / stats.vote_cnt) : 0U;
+  latency["max"] = stats.latency_max;
+  event["vote_latency_ms"] = latency;
+  event["switches"] = static_cast<Json::UInt64>(stats.switch_cnt);
+  event["revotes"] = static_cast<Json::UInt64>(stats.revote_cnt);
+  event["rank_updates"] = static_cast<Json::UInt64>(stats.rank_update_cnt);
+  event["sql_open"] = static_cast<Json::UInt64>(rx_ranking.size());
+  Json::Value rx_list(Json::arrayValue);
+  list<SatRx *>::const_iterator it;
+  for (it=rxs.begin(); it!=rxs.end(); ++it)
+  {
+    Json::Value rx(Json::objectValue);
+    rx["name"] = (*it)->name();
+    rx["selected"] = static_cast<Json::UInt64>((*it)->selectCount());
+    rx_list.append(rx);
+  }
+  event["rx"] = rx_list;
+
+  Json::StreamWriterBuilder builder;
+  builder["commentStyle"] = "None";
+  builder["indentation"] = ""; //The JSON document is written on a single line
+  Json::StreamWriter* writer = builder.newStreamWriter();
+  PtyStreamBuf psb(command_pty);
+  ostream os(&psb);
+  writer->write(event, &os);
+  delete writer;
+  os << endl;
+} /* Voter::writeStats */
 
 
 
@@ -798,41 +942,17 @@ void Voter::Top::setMuteState(Rx::MuteState new_mute_state)
 void Voter::Top::satSquelchOpen(SatRx *srx, bool is_open)
 {
   assert(srx != 0);
-  
-  if (bestSrx() == 0)
-  {
-    assert(is_open);
-    box().best_srx = srx;
-  }
-  else if (srx == bestSrx())
-  {
-    if (!is_open)
-    {
-      box().best_srx = voter().findBestRx();
-    }
-  }
-  else
-  {
-    if (is_open &&
-        (srx->signalStrength() > bestSrx()->signalStrength()))
-    {
-      box().best_srx = srx;
-    }
-  }
+  box().best_srx = voter().findBestRx();
 } /* Voter::Top::satSquelchOpen */
 
 
 void Voter::Top::satSignalLevelUpdated(SatRx *srx, float siglev)
 {
   assert(srx != 0);
-  assert(bestSrx() != 0);
   assert(srx->squelchIsOpen());
   
-  if (!bestSrx()->squelchIsOpen() ||
-      (siglev > bestSrx()->signalStrength()))
-  {
-    box().best_srx = srx;
-  }
+  box().best_srx = voter().findBestRx();
+  assert(bestSrx() != 0);
 
   if (srx == activeSrx())
   {
@@ -946,6 +1066,7 @@ void Voter::Idle::satSquelchOpen(SatRx *srx, bool is_open)
   SUPER::satSquelchOpen(srx, is_open);
   if (is_open)
   {
+    voter().voteStarted();
     if (srx->signalStrength() * hysteresis() > 100.0f)
     {
       setState<ActiveRxSelected>(bestSrx());
@@ -1025,6 +1146,7 @@ void Voter::ActiveRxSelected::init(SatRx *srx)
 {
   assert(srx != 0);
   box().active_srx = srx;
+  voter().voteFinished(srx);
   if (muteState() == MUTE_CONTENT)
   {
     voter().muteAll(MUTE_CONTENT);
@@ -1063,6 +1185,10 @@ char Voter::ActiveRxSelected::sqlRxId(void)
 
 void Voter::ActiveRxSelected::changeActiveSrx(SatRx *srx)
 {
+  if (srx != activeSrx())
+  {
+    voter().activeRxSwitched(srx);
+  }
   voter().selector->selectSource(srx);
   activeSrx()->setMuteState(MUTE_CONTENT);
   box().active_srx = srx;
@@ -1213,6 +1339,7 @@ void Voter::Receiving::exit(void)
 void Voter::Receiving::timerExpired(void)
 {
   voter().printSquelchState();
+  ++voter().stats.revote_cnt;
   
   assert(activeSrx() != 0);
   //assert(bestSrx() != 0);
@@ -1370,6 +1497,20 @@ void Voter::handlePtyCommand(const std::string &full_command)
     }
     setRxEnabled(rx_name, false);
   }
+  else if (command == "STATS") // Write voting statistics to the PTY
+  {
+    writeStats();
+    string arg;
+    if ((is >> arg) && (arg == "RESET"))
+    {
+      stats = VoteStats();
+      list<SatRx *>::iterator it;
+      for (it=rxs.begin(); it!=rxs.end(); ++it)
+      {
+        (*it)->resetSelectCount();
+      }
+    }
+  }
   else
   {
     cerr << "*** WARNING: Unknown voter PTY command received: \""
@@ -36,6 +36,8 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
  ****************************************************************************/
 
 #include <list>
+#include <map>
+#include <sys/time.h>
 
 
 /****************************************************************************
@@ -202,6 +204,30 @@ class Voter : public Rx
 
     class SatRx;
 
+      // Satellite receivers with an open squelch, ordered by signal level
+    typedef std::multimap<float, SatRx *> SatRxRanking;
+
+    struct VoteStats
+    {
+      VoteStats(void)
+        : vote_cnt(0), switch_cnt(0), revote_cnt(0), rank_update_cnt(0),
+          latency_sum(0), latency_min(0), latency_max(0), vote_pending(false)
+      {
+        vote_start.tv_sec = 0;
+        vote_start.tv_usec = 0;
+      }
+
+      unsigned long     vote_cnt;
+      unsigned long     switch_cnt;
+      unsigned long     revote_cnt;
+      unsigned long     rank_update_cnt;
+      unsigned long     latency_sum;
+      unsigned          latency_min;
+      unsigned          latency_max;
+      bool              vote_pending;
+      struct timeval    vote_start;
+    };
+
     TOPSTATE(Top)
     {
       typedef std::list<sigc::slot<void> > SlotList;
@@ -413,6 +439,9 @@ class Voter : public Rx
     EventQueue		  event_queue;
     Async::Pty            *command_pty;
     std::string           command_buf;
+    SatRxRanking          rx_ranking;
+    float                 best_siglev;
+    VoteStats             stats;
     
     void dispatchEvent(Macho::IEvent<Top> *event);
     void satSquelchOpen(bool is_open, SatRx *rx);
@@ -423,6 +452,12 @@ class Voter : public Rx
     void resetAll(void);
     void printSquelchState(void);
     SatRx *findBestRx(void) const;
+    void updateRanking(SatRx *srx, bool is_open, float siglev);
+    void updateAudioNeeded(SatRx *srx);
+    void voteStarted(void);
+    void voteFinished(SatRx *srx);
+    void activeRxSwitched(SatRx *srx);
+    void writeStats(void);
     void onCommandPtyInput(const void *buf, size_t count);
     void handlePtyCommand(const std::string &full_command);
     void setRxEnabled(const std::string &rx_name, bool do_enable);
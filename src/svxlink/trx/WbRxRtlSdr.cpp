@@ -57,10 +57,12 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "WbRxRtlSdr.h"
 #include "RtlTcp.h"
+#include "RtlReplay.h"
 #ifdef HAS_RTLSDR_SUPPORT
 #include "RtlUsb.h"
 #endif
 #include "Ddr.h"
+#include "PolyphaseChannelizer.h"
 
 
 
@@ -136,7 +138,7 @@ WbRxRtlSdr *WbRxRtlSdr::instance(Async::Config &cfg, const string &name)
 
 
 WbRxRtlSdr::WbRxRtlSdr(Async::Config &cfg, const string &name)
-  : auto_tune_enabled(true), m_name(name), xvrtr_offset(0)
+  : rtl(0), pfb(0), auto_tune_enabled(true), m_name(name), xvrtr_offset(0)
 {
   //cout << "### Initializing WBRX " << name << endl;
 
@@ -153,6 +155,12 @@ WbRxRtlSdr::WbRxRtlSdr(Async::Config &cfg, const string &name)
     //cout << "###   PORT        = " << tcp_port << endl;
     rtl = new RtlTcp(remote_host, tcp_port);
   }
+  else if (rtl_type == "RtlReplay")
+  {
+    string replay_file;
+    cfg.getValue(name, "FILE", replay_file);
+    rtl = new RtlReplay(replay_file);
+  }
 #ifdef HAS_RTLSDR_SUPPORT
   else if (rtl_type == "RtlUsb")
   {
@@ -176,6 +184,28 @@ WbRxRtlSdr::WbRxRtlSdr(Async::Config &cfg, const string &name)
   rtl->readyStateChanged.connect(
       mem_fun(*this, &WbRxRtlSdr::rtlReadyStateChanged));
 
+  bool use_pfb = true;
+  cfg.getValue(name, "PFB_CHANNELIZER", use_pfb);
+  if (use_pfb && PolyphaseChannelizer::isSupported(sample_rate))
+  {
+    pfb = new PolyphaseChannelizer(sample_rate);
+    rtl->iqReceived.connect(
+        sigc::mem_fun(*pfb, &PolyphaseChannelizer::iqReceived));
+
+    bool use_opencl = false;
+    cfg.getValue(name, "PFB_OPENCL", use_opencl);
+    if (use_opencl)
+    {
+      string opencl_device;
+      cfg.getValue(name, "PFB_OPENCL_DEVICE", opencl_device);
+      if (!pfb->useOpenCl(opencl_device))
+      {
+        cerr << "*** WARNING: " << name << ": Could not use OpenCL for the "
+                "polyphase channelizer. Using the CPU instead.\n";
+      }
+    }
+  }
+
   int fq_corr = 0;
   if (cfg.getValue(name, "FQ_CORR", fq_corr) && (fq_corr != 0))
   {
@@ -205,6 +235,22 @@ WbRxRtlSdr::WbRxRtlSdr(Async::Config &cfg, const string &name)
   bool peak_meter = false;
   cfg.getValue(name, "PEAK_METER", peak_meter);
   rtl->enableDistPrint(peak_meter);
+
+  bool dc_offset_removal = false;
+  cfg.getValue(name, "DC_OFFSET_REMOVAL", dc_offset_removal);
+  rtl->enableDcOffsetRemoval(dc_offset_removal);
+
+  float iq_gain_imbalance = 1.0f;
+  cfg.getValue(name, "IQ_GAIN_IMBALANCE", iq_gain_imbalance);
+  float iq_phase_imbalance = 0.0f;
+  cfg.getValue(name, "IQ_PHASE_IMBALANCE", iq_phase_imbalance);
+  if (iq_gain_imbalance <= 0.0f)
+  {
+    cerr << "*** WARNING: " << name << "/IQ_GAIN_IMBALANCE must be larger "
+            "than zero. Ignoring it.\n";
+    iq_gain_imbalance = 1.0f;
+  }
+  rtl->setIqImbalance(iq_gain_imbalance, iq_phase_imbalance);
 } /* WbRxRtlSdr::WbRxRtlSdr */
 
 
@@ -212,6 +258,8 @@ WbRxRtlSdr::~WbRxRtlSdr(void)
 {
   delete rtl;
   rtl = 0;
+  delete pfb;
+  pfb = 0;
 } /* WbRxRtlSdr::~WbRxRtlSdr */
 
 
@@ -71,6 +71,7 @@ namespace Async
 };
 class RtlSdr;
 class Ddr;
+class PolyphaseChannelizer;
 
 
 /****************************************************************************
@@ -195,15 +196,38 @@ class WbRxRtlSdr : public sigc::trackable
      */
     bool isReady(void) const;
 
+    /**
+     * @brief   Get the shared channelizer for this wideband receiver
+     * @returns Returns the channelizer or 0 if not available
+     *
+     * The shared polyphase channelizer split the wideband signal into a
+     * number of bins in one pass. A DDR can pick the bin closest to its
+     * frequency instead of filtering the full wideband signal by itself.
+     * The channelizer is not available for unsupported sampling rates or if
+     * it has been disabled using the PFB_CHANNELIZER configuration variable.
+     */
+    PolyphaseChannelizer *channelizer(void) const { return pfb; }
+
+    /**
+     * @brief   Get the underlying RTL device object
+     * @returns Returns the RtlSdr object used by this wideband receiver
+     *
+     * This is mainly useful for tools that need to drive a replay device
+     * (TYPE=RtlReplay) directly.
+     */
+    RtlSdr *device(void) const { return rtl; }
+
     /**
      * @brief   A signal that is emitted when new samples have been received
      * @param   samples A vector of received samples
      *
      * Connecting to this signal is the way to get samples from the DVB-T
      * dongle. The format is a vector of complex floats (I/Q) with a range from
-     * -1 to 1.
+     * -1 to 1. The same sample buffer is handed to all connected receivers
+     * and it is reused for the next block so it must not be referenced after
+     * the handler has returned.
      */
-    sigc::signal<void, std::vector<Sample> > iqReceived;
+    sigc::signal<void, const std::vector<Sample>&> iqReceived;
     
     /**
      * @brief   A signal that is emitted when the ready state changes
@@ -219,6 +243,7 @@ class WbRxRtlSdr : public sigc::trackable
     static InstanceMap instances;
 
     RtlSdr *rtl;
+    PolyphaseChannelizer *pfb;
     Ddrs ddrs;
     bool auto_tune_enabled;
     std::string m_name;